@@ -7,16 +7,20 @@ libdrgn bindings
 Don't use this module directly. Instead, use the drgn package.
 """
 
+import array
 import enum
 import os
 from typing import (
     Any,
     Callable,
     Dict,
+    IO,
     Iterable,
     Iterator,
+    List,
     Optional,
     Sequence,
+    Tuple,
     Union,
     overload,
 )
@@ -33,6 +37,17 @@ class Program:
     This class can be constructed directly, but it is usually more convenient
     to use one of the :ref:`api-program-constructors`.
 
+    A program and its objects may be used from multiple threads, e.g., with
+    :mod:`concurrent.futures`. The memory reading methods (:meth:`read()`,
+    :meth:`read_batch()`, and :meth:`read_u8()` and friends) and
+    :meth:`Object.format_()` release the global interpreter lock, so multiple
+    threads may run them on the same program concurrently. So do methods
+    which may run for a long time, like :meth:`load_debug_info()` and
+    :meth:`stack_trace()`, so that other threads can run Python code in the
+    meantime, but only one of those runs on a given program at a time.
+    Debugging information must not be loaded while other threads are using
+    the program.
+
     :param platform: The platform of the program, or ``None`` if it should be
         determined automatically when a core dump or symbol file is added.
     """
@@ -58,6 +73,88 @@ class Program:
     this is determined from the language of ``main`` in the program, falling
     back to :attr:`Language.C`. This heuristic may change in the future.
     """
+    memory_cache_size: int
+    """
+    Maximum size in bytes of the cache of recently read memory pages.
+
+    Small reads are served from this cache so that repeatedly reading nearby
+    addresses only reads the underlying memory once. This defaults to 16 MiB
+    for core dumps and 0 (disabled) otherwise, since the memory of a running
+    program may change at any time. The size is rounded down to a multiple of
+    the page size. Setting it discards the current contents of the cache.
+    """
+    frame_pointer_unwinding: bool
+    """
+    Whether to unwind stack traces by following frame pointers.
+
+    This is much faster than the default unwinder, but it is only correct for
+    programs compiled with frame pointers (e.g., ``-fno-omit-frame-pointer`` or
+    ``CONFIG_FRAME_POINTER``). For the Linux kernel, each frame pointer must be
+    within the stack of the task. Frames where the chain of frame pointers looks
+    broken are unwound with the default unwinder instead. This is only supported
+    on x86-64 and defaults to ``False``.
+    """
+    epoch: int
+    """
+    Counter which is incremented whenever state derived from this program may
+    be stale.
+
+    The epoch is incremented when debugging information is loaded, when
+    :meth:`bump_epoch()` is called, and, for running programs, lazily once
+    :attr:`epoch_interval` has elapsed. Helpers decorated with
+    :func:`drgn.helpers.memoize()` are recomputed when it changes.
+    """
+    epoch_interval: Optional[float]
+    """
+    Number of seconds after which the :attr:`epoch` of a running program is
+    incremented automatically, or ``None`` to only increment it explicitly.
+    This has no effect on core dumps. Defaults to ``None``.
+    """
+    max_read_bytes_per_second: Optional[int]
+    """
+    Maximum average number of bytes of memory to read from the program per
+    second, or ``None`` for no limit.
+
+    This is meant for running programs and live kernels, where heavy reading
+    can disturb the target. Reads may go up to 100 milliseconds' worth of the
+    limit over it in a burst, then wait. Reads served from the memory cache
+    (see :attr:`memory_cache_size`) don't count. Reads on threads using
+    :func:`set_background_reads()` also wait to leave half of a burst for
+    other reads. Defaults to ``None``.
+    """
+    max_reads_per_second: Optional[int]
+    """
+    Maximum average number of reads of memory from the program per second, or
+    ``None`` for no limit. This behaves like
+    :attr:`max_read_bytes_per_second`.
+
+    While this is set and :attr:`memory_cache_size` is 0, small reads within
+    a page read the whole page, and other small reads of the same page shortly
+    after it are served from that copy instead of waiting for another read.
+    Defaults to ``None``.
+    """
+    profiling: bool
+    """
+    Whether to count calls and time spent in libdrgn operations, which are
+    returned by :meth:`profile_stats()`. Enabling this resets the counts. It
+    defaults to ``False``.
+    """
+    pickle_id: int
+    """
+    Identifier of this program in pickles.
+
+    :class:`Program`, :class:`Object`, and :class:`Type` can be pickled, e.g.,
+    to pass them to or from :mod:`multiprocessing` workers. A pickled program
+    is only a reference to the program with the same pickle ID in the process
+    which unpickles it. Processes forked after the ID was assigned (it is
+    assigned the first time that the program is pickled or this is read)
+    inherit it. Otherwise, the receiving process should load the same program
+    and set this to the ID from the sending process.
+
+    Pickled objects contain their address or value and the name of their type,
+    which is looked up once per receiving program. Objects with anonymous
+    types can't be pickled.
+    """
     def __getitem__(self, name: str) -> Object:
         """
         Implement ``self[name]``. Get the object (variable, constant, or
@@ -151,17 +248,117 @@ class Program:
             the given file
         """
         ...
+    def names(
+        self,
+        prefix: str = "",
+        *,
+        glob: Optional[str] = None,
+        flags: FindNameFlags = FindNameFlags.ANY,
+    ) -> List[str]:
+        """
+        Get the names of types and objects in the program's debugging
+        information, in sorted order.
+
+        This is meant for completion and discovery, so it is fast even for
+        large programs: names are kept in a sorted list which is built the
+        first time this is called after debugging information is loaded.
+
+        >>> prog.names("jiffies")
+        ['jiffies', 'jiffies_64', 'jiffies_lock', ...]
+        >>> prog.names(glob="*_cachep", flags=FindNameFlags.VARIABLE)
+        ['anon_vma_cachep', 'bio_integrity_cachep', ...]
+
+        Only debugging information that has already been indexed is searched,
+        so names in files which are loaded lazily (e.g., split DWARF) may be
+        missing until they are first used.
+
+        :param prefix: Only return names starting with this.
+        :param glob: Only return names matching this shell wildcard pattern
+            (see :func:`fnmatch.fnmatchcase()`).
+        :param flags: Kinds of definitions to return names of. A name is
+            returned if it has a definition of any of the given kinds.
+        """
+        ...
+    # expr is positional-only.
+    def eval(self, expr: str, **variables: Object) -> Object:
+        """
+        Evaluate an expression in the language of the program.
+
+        >>> prog.eval("task->mm->mmap->vm_start", task=task)
+        Object(prog, 'unsigned long', value=140737488351232)
+
+        For C, this supports identifiers, integer literals, member access
+        (``.`` and ``->``), subscripts, casts, unary operators (``+``, ``-``,
+        ``~``, ``!``, ``*``, and ``&``), and binary arithmetic, bitwise,
+        comparison, and logical operators. Identifiers which are not given in
+        *variables* are looked up as with :meth:`object()`.
+
+        Expressions are parsed once and cached by the program, so evaluating
+        the same expression with the same variable names repeatedly (e.g., in
+        a loop) is faster than the equivalent chain of :class:`Object`
+        operations.
+
+        :param expr: Expression string.
+        :param variables: Objects to bind to names in the expression.
+        :raises SyntaxError: if the expression is invalid
+        :raises LookupError: if an identifier is not found
+        """
+        ...
     # address_or_name is positional-only.
     def symbol(self, address_or_name: Union[int, str]) -> Symbol:
         """
         Get the symbol containing the given address, or the global symbol with
         the given name.
 
+        Lookups by address return the same :class:`Symbol` object for the same
+        symbol as long as a reference to it is held, so repeated lookups don't
+        allocate.
+
         :param address_or_name: The address or name.
         :raises LookupError: if no symbol contains the given address or matches
             the given name
         """
         ...
+    def symbolize(
+        self, addresses: Union[Sequence[int], array.array]
+    ) -> List[Optional[Symbol]]:
+        """
+        Get the symbols containing many addresses at once.
+
+        This is equivalent to ``[prog.symbol(address) for address in
+        addresses]``, except that addresses that aren't in a symbol result in
+        ``None`` instead of an exception, and it is much faster for many
+        addresses. Like with :meth:`symbol()`, addresses in the same symbol
+        share the same :class:`Symbol` object.
+
+        >>> syms = prog.symbolize([0xffffffff8a8b0a04, 0xffffffff8a8b0a10, 0])
+        >>> syms[0]
+        Symbol(name='schedule', address=0xffffffff8a8b09f0, size=0x92)
+        >>> syms[0] is syms[1], syms[2]
+        (True, None)
+
+        :param addresses: Sequence of addresses, or a buffer of unsigned 64-bit
+            integers, like ``array.array("Q")``.
+        """
+        ...
+    def source_lines(
+        self, addresses: Union[Sequence[int], array.array]
+    ) -> List[Optional[Tuple[str, int, int]]]:
+        """
+        Get the source code locations of many addresses at once.
+
+        Each location is a ``(filename, line, column)`` tuple, or ``None`` if
+        the address doesn't have line number information. The line number
+        information of each module is decoded into a table the first time an
+        address in that module is looked up, so later lookups are fast.
+
+        >>> prog.source_lines([0xffffffff8a8b0a04, 0])
+        [('kernel/sched/core.c', 4160, 2), None]
+
+        :param addresses: Sequence of addresses, or a buffer of unsigned 64-bit
+            integers, like ``array.array("Q")``.
+        """
+        ...
     def stack_trace(self, thread: Union[Object, int]) -> StackTrace:
         """
         Get the stack trace for the given thread in the program.
@@ -180,13 +377,63 @@ class Program:
         that task. See :func:`drgn.helpers.linux.pid.find_task()`.
 
         This is implemented for the Linux kernel (both live and core dumps) as
-        well as userspace core dumps; it is not yet implemented for live
-        userspace processes.
+        well as userspace programs (both live and core dumps). For a live
+        process, the thread is only stopped for long enough to read its
+        registers and copy the top of its stack, which is then unwound while
+        the thread runs. This makes it cheap enough to sample the stacks of
+        production services.
 
         :param thread: Thread ID, ``struct pt_regs`` object, or
             ``struct task_struct *`` object.
         """
         ...
+    def stack_traces(
+        self, threads: Optional[Iterable[Union[Object, int]]] = None
+    ) -> Dict[int, StackTrace]:
+        """
+        Get the stack traces for many threads in the program at once.
+
+        This is much faster than calling :meth:`stack_trace()` for each thread,
+        which makes it suitable for dumping every stack in a large kernel core
+        dump:
+
+        >>> for tid, trace in prog.stack_traces().items():
+        ...     print(tid)
+        ...     print(trace)
+
+        Threads that don't exist or can't be unwound (e.g., running tasks in
+        the live kernel) are left out of the result.
+
+        :param threads: Thread IDs or ``struct task_struct *`` objects. If
+            ``None``, all threads are unwound: for the Linux kernel, every task
+            in the initial PID namespace, for core dumps, every thread in the
+            core dump, and for live processes, every thread in the process.
+        :return: Dictionary from thread ID to stack trace.
+        """
+    def stack_trace_groups(
+        self, threads: Optional[Iterable[Union[Object, int]]] = None
+    ) -> List[Tuple[StackTrace, List[int]]]:
+        """
+        Get the stack traces for many threads in the program, grouping threads
+        with identical stack traces.
+
+        Threads are in the same group if their stack traces have the same
+        program counters. Most threads are usually in a few places, so this is
+        a compact summary of what every thread is doing:
+
+        >>> for trace, tids in prog.stack_trace_groups():
+        ...     print(f"{len(tids)} threads: {tids}")
+        ...     print(trace)
+
+        This is faster than grouping the result of :meth:`stack_traces()`,
+        and only one stack trace is kept for each group.
+
+        :param threads: Same as for :meth:`stack_traces()`.
+        :return: List of ``(trace, tids)`` tuples, where ``trace`` is the stack
+            trace shared by the threads in ``tids``. The groups are sorted from
+            the most threads to the fewest.
+        """
+        ...
     def type(self, name: str, filename: Optional[str] = None) -> Type:
         """
         Get the type with the given name.
@@ -216,6 +463,73 @@ class Program:
         :param lang: :attr:`Type.language`
         """
         ...
+    def member_path(self, type: Union[str, Type], member: str) -> MemberPath:
+        """
+        Resolve a member designator in a type once so that it can be applied
+        to many objects.
+
+        The designator may include one or more member references and zero or
+        more array subscripts, as accepted by ``offsetof()`` in C.
+
+        >>> path = prog.member_path('struct task_struct', 'se.avg.load_avg')
+        >>> path.apply(task)
+        (unsigned long)1024
+
+        :param type: The structure, union, class, or array type containing the
+            member.
+        :param member: The member designator, e.g., ``'a.b[3].c'``.
+        :raises TypeError: if a member reference is applied to a type which is
+            not a structure, union, or class type, or a subscript is applied to
+            a type which is not an array type
+        :raises LookupError: if a member is not found
+        """
+        ...
+    def read_field_array(
+        self, type: Union[str, Type], member: str, addresses: Iterable[int]
+    ) -> array.array:
+        """
+        Read a scalar member from many objects of the same type.
+
+        This is equivalent to reading the member from an object at each
+        address, but the member designator is only resolved once and the
+        reads are batched like :meth:`read_batch()`.
+
+        >>> addresses = [task.value_() for task in for_each_task(prog)]
+        >>> prog.read_field_array('struct task_struct', 'se.vruntime', addresses)
+        array('Q', [5298049437, 5299513570, ...])
+
+        :param type: The structure, union, or class type containing the
+            member.
+        :param member: The member designator; see :meth:`member_path()`.
+        :param addresses: Addresses of the objects containing the member.
+        :return: Array of the values with type code ``'q'`` for signed
+            integers, ``'Q'`` for unsigned integers, booleans, and pointers,
+            or ``'d'`` for floating-point numbers. Bit fields are extracted
+            and sign-extended like they would be for an :class:`Object`.
+        :raises TypeError: if the member does not have a scalar type
+        :raises FaultError: if any of the reads are invalid
+        """
+        ...
+    def enumerator(
+        self, type: Union[str, Type], value: int
+    ) -> Optional[TypeEnumerator]:
+        """
+        Find the enumerator of an enumerated type with the given value.
+
+        This is the reverse of looking up an enumerator by name. Large
+        enumerated types are indexed by value the first time they are
+        searched, so this is fast even when called for many values.
+
+        >>> prog.enumerator('enum pid_type', 1)
+        TypeEnumerator('PIDTYPE_TGID', 1)
+
+        :param type: The enumerated type.
+        :param value: The value to find.
+        :return: The first enumerator with the given value, or ``None`` if
+            there is none.
+        :raises TypeError: if *type* is not a complete enumerated type
+        """
+        ...
     def read(self, address: int, size: int, physical: bool = False) -> bytes:
         """
         Read *size* bytes of memory starting at *address* in the program. The
@@ -236,6 +550,245 @@ class Program:
         :raises ValueError: if *size* is negative
         """
         ...
+    def try_read(
+        self, address: int, size: int, physical: bool = False
+    ) -> Optional[bytes]:
+        """
+        Read *size* bytes of memory starting at *address* in the program if
+        the range is readable.
+
+        This is like :meth:`read()`, but it returns ``None`` instead of raising
+        :exc:`FaultError`. It is much faster when many reads are expected to
+        fail, e.g., when scanning sparse memory for valid pointers.
+
+        >>> prog.try_read(0, 8)
+        >>> prog.try_read(0xffffffffbe012b40, 4)
+        b'swap'
+
+        :param address: The starting address.
+        :param size: The number of bytes to read.
+        :param physical: Whether *address* is a physical memory address.
+        :return: The memory, or ``None`` if the address range is invalid.
+        :raises ValueError: if *size* is negative
+        """
+        ...
+    def read_into(self, buffer: Any, address: int, physical: bool = False) -> None:
+        """
+        Read memory starting at *address* in the program into a writable
+        buffer, e.g., a :class:`bytearray`, :class:`mmap.mmap`, or NumPy
+        array. The size of the read is the size of the buffer in bytes.
+
+        This avoids allocating and copying into a new :class:`bytes` object,
+        which matters for large reads.
+
+        >>> buf = bytearray(16)
+        >>> prog.read_into(buf, 0xffffffffbe012b40)
+        >>> buf
+        bytearray(b'swapper/0\x00\x00\x00\x00\x00\x00\x00')
+
+        :param buffer: Contiguous, writable buffer.
+        :param address: The starting address.
+        :param physical: Whether *address* is a physical memory address.
+        :raises FaultError: if the address range is invalid; see
+            :meth:`read()`. Part of the buffer may have been overwritten.
+        :raises TypeError: if *buffer* is not writable or is not contiguous
+        """
+        ...
+    def read_view(
+        self, address: int, size: int, physical: bool = False
+    ) -> memoryview:
+        """
+        Read *size* bytes of memory starting at *address* in the program as a
+        read-only :class:`memoryview`.
+
+        If the memory is in a core dump which drgn has mapped into memory (an
+        uncompressed ELF core dump, e.g., ``/proc/vmcore`` saved with ``cp``),
+        the view is directly onto the mapping, so nothing is copied. Otherwise,
+        it is a view of the result of :meth:`read()`. The view keeps the
+        program alive.
+
+        >>> bytes(prog.read_view(0xffffffffbe012b40, 4))
+        b'swap'
+
+        :param address: The starting address.
+        :param size: The number of bytes to read.
+        :param physical: Whether *address* is a physical memory address.
+        :raises FaultError: if the address range is invalid; see
+            :meth:`read()`
+        :raises ValueError: if *size* is negative
+        """
+        ...
+    def read_batch(
+        self, requests: Iterable[Union[Tuple[int, int], Tuple[int, int, bool]]]
+    ) -> List[bytes]:
+        """
+        Read multiple ranges of memory in the program.
+
+        This is equivalent to calling :meth:`read()` for each request, but it
+        is more efficient for many small reads: requests which overlap or are
+        adjacent are merged into one read.
+
+        >>> prog.read_batch([(0xffffffffbe012b40, 4), (0xffffffffbe012b44, 4)])
+        [b'swap', b'per/']
+
+        :param requests: ``(address, size)`` or ``(address, size, physical)``
+            tuples with the same meaning as the parameters to :meth:`read()`.
+        :return: The memory read for each request, in the same order as
+            *requests*.
+        :raises FaultError: if any address range is invalid; see
+            :meth:`read()`
+        :raises ValueError: if any size is negative
+        """
+        ...
+    def prefetch(self, address: int, size: int, physical: bool = False) -> None:
+        """
+        Hint that memory will be read soon.
+
+        This returns immediately, and the memory is read into the memory read
+        cache in the background. Walks which are slow because every read waits
+        for I/O (e.g., from a remote target or a compressed core dump) can
+        prefetch the next thing that they will read before processing the
+        current one so that the I/O overlaps with the processing. The linked
+        list and red-black tree iterators do this automatically.
+
+        >>> prog.prefetch(next_node.value_(), 64)
+
+        Hints are ignored if the memory read cache is disabled or if the
+        program has memory segments added by :meth:`add_memory_segment()`.
+        Memory which can't be read is skipped silently, and if too many hints
+        are pending, the oldest ones are dropped.
+
+        :param address: The starting address.
+        :param size: The number of bytes to prefetch.
+        :param physical: Whether *address* is a physical memory address.
+        :raises ValueError: if *size* is negative
+        """
+        ...
+    def prefetch_many(
+        self, ranges: Iterable[Union[Tuple[int, int], Tuple[int, int, bool]]]
+    ) -> None:
+        """
+        Hint that multiple ranges of memory will be read soon.
+
+        This is equivalent to calling :meth:`prefetch()` for each range.
+
+        :param ranges: ``(address, size)`` or ``(address, size, physical)``
+            tuples with the same meaning as the parameters to
+            :meth:`prefetch()`.
+        :raises ValueError: if any size is negative
+        """
+        ...
+    def search_memory(
+        self,
+        pattern: bytes,
+        physical: bool = True,
+        mask: Optional[bytes] = None,
+        *,
+        alignment: int = 1,
+    ) -> Iterator[int]:
+        """
+        Search all of the memory of the program for a pattern.
+
+        The memory segments are read in large chunks which are searched in
+        parallel. Memory which can't be read is skipped.
+
+        >>> hex(next(prog.search_memory(b'swapper/0', physical=False)))
+        '0xffffffffbe012b40'
+
+        :param pattern: Bytes to search for. This may be up to 4096 bytes long.
+        :param physical: Whether to search physical memory instead of virtual
+            memory.
+        :param mask: Bits of *pattern* which must match, or ``None`` if every
+            bit must match. This must be the same length as *pattern*.
+        :param alignment: Only return matches at multiples of this, which must
+            be a power of two.
+        :return: Iterator over the addresses of the matches, in increasing
+            order. Matches may overlap.
+        :raises ValueError: if *pattern* is empty or too long, *mask* is not
+            the same length as *pattern*, or *alignment* is not a power of two
+        """
+        ...
+    def build_pointer_index(
+        self, ranges: Optional[Iterable[Tuple[int, int]]] = None
+    ) -> PointerIndex:
+        """
+        Build an index of the pointers stored in the program's memory.
+
+        Every aligned, word-sized value in the scanned memory which is an
+        address in a virtual memory segment of the program is indexed. The
+        memory is read in large chunks which are scanned in parallel, and
+        unreadable memory is skipped. This can take a while for a large
+        program, so the index can be saved with :meth:`PointerIndex.save()`
+        and loaded again with :meth:`load_pointer_index()`.
+
+        >>> index = prog.build_pointer_index()
+        >>> task = find_task(prog, 1)
+        >>> [hex(source) for source, target in index.find(task.value_())][:2]
+        ['0xffffffffbe012958', '0xffff9ba4c0b8c7d8']
+
+        :param ranges: ``(address, size)`` tuples of the virtual address ranges
+            to scan, e.g., the slabs of a slab cache. Defaults to all virtual
+            memory segments.
+        :raises ValueError: if the program platform is not known
+        """
+        ...
+    def load_pointer_index(
+        self, path: Union[str, bytes, os.PathLike]
+    ) -> PointerIndex:
+        """
+        Load a pointer index saved by :meth:`PointerIndex.save()`.
+
+        :param path: Index file path.
+        :raises ValueError: if the file is not a pointer index or its word
+            size does not match the program
+        """
+        ...
+    def hash_memory(
+        self,
+        physical: bool = True,
+        ranges: Optional[Iterable[Tuple[int, int]]] = None,
+    ) -> MemoryHashes:
+        """
+        Hash the program's memory page by page so that it can be compared to
+        another image of the same program, e.g., a core dump from a good run
+        and one from a bad run.
+
+        The memory is read in large chunks which are hashed in parallel.
+        Memory which cannot be read or which was excluded from a core dump is
+        skipped.
+
+        >>> good.hash_memory().diff(bad.hash_memory())
+        [(4096, 8192), (1048576, 4096)]
+
+        To find what changed in a running program, keep the hashes from
+        earlier and compare them to new hashes of the same program.
+
+        :param physical: Whether to hash physical memory instead of virtual
+            memory.
+        :param ranges: ``(address, size)`` tuples of the address ranges to
+            hash. Defaults to all memory segments.
+        """
+        ...
+    def watch(self, objects: Iterable[Object]) -> Watch:
+        """
+        Watch objects in the program's memory for changes, e.g., counters in
+        a running kernel.
+
+        The objects are registered once. Objects which are in the same page
+        or close together are read together, so each
+        :meth:`Watch.sample()` only reads the memory that is needed with as
+        few reads as possible.
+
+        >>> watch = prog.watch([prog["nr_threads"], prog["total_forks"]])
+        >>> watch.sample()
+        [(0, Object(prog, 'int', value=192)), (1, Object(prog, ...))]
+        >>> watch.sample()
+        [(1, Object(prog, 'unsigned long', value=8012))]
+
+        :param objects: Reference objects to watch.
+        :raises ValueError: if any of the objects is not a reference
+        """
+        ...
     def read_u8(self, address: int, physical: bool = False) -> int: ...
     def read_u16(self, address: int, physical: bool = False) -> int: ...
     def read_u32(self, address: int, physical: bool = False) -> int: ...
@@ -260,12 +813,166 @@ class Program:
         :raises FaultError: if the address is invalid; see :meth:`read()`
         """
         ...
+    def read_u8_array(
+        self, address: int, count: int, physical: bool = False
+    ) -> array.array: ...
+    def read_u16_array(
+        self, address: int, count: int, physical: bool = False
+    ) -> array.array: ...
+    def read_u32_array(
+        self, address: int, count: int, physical: bool = False
+    ) -> array.array: ...
+    def read_u64_array(
+        self, address: int, count: int, physical: bool = False
+    ) -> array.array: ...
+    def read_word_array(
+        self, address: int, count: int, physical: bool = False
+    ) -> array.array:
+        """
+        Read an array of unsigned integers from the program's memory in the
+        program's byte order.
+
+        This reads the whole array at once, so it is much faster than calling
+        :meth:`read_u64()` or :meth:`read_word()` for each element, e.g., to
+        read a table of pointers:
+
+        >>> prog.read_word_array(0xffff8cb3c7f4a000, 4)
+        array('Q', [0, 18446624287354396672, 0, 18446624287350489088])
+
+        :meth:`read_u8_array()`, :meth:`read_u16_array()`,
+        :meth:`read_u32_array()`, and :meth:`read_u64_array()` read 8-, 16-,
+        32-, or 64-bit unsigned integers and return an array with type code
+        ``'B'``, ``'H'``, ``'I'``, or ``'Q'``, respectively.
+        :meth:`read_word_array()` reads program word-sized unsigned integers
+        and returns an array with type code ``'Q'``.
+
+        :param address: Address of the first integer.
+        :param count: Number of integers to read.
+        :param physical: Whether *address* is a physical memory address; see
+            :meth:`read()`.
+        :raises FaultError: if the address range is invalid; see :meth:`read()`
+        :raises ValueError: if *count* is negative
+        """
+        ...
+    def invalidate_memory_cache(self) -> None:
+        """
+        Discard the contents of the memory cache, including snapshots made by
+        :meth:`Object.snapshot_()`. If the cache is enabled for a running
+        program, this should be called whenever its memory may have changed.
+        """
+        ...
+    def bump_epoch(self) -> None:
+        """
+        Increment :attr:`epoch`, discarding everything that was memoized in
+        the previous epoch, including internal caches such as the per-CPU
+        offsets. For running programs, this should be called when the state
+        that helpers cache (e.g., the kernel configuration or the set of
+        possible CPUs) may have changed.
+        """
+        ...
+    def stats(self) -> Dict[str, int]:
+        """
+        Get statistics about how this program's memory has been read.
+
+        This is useful for finding out what a slow script is spending its
+        time on. The keys are:
+
+        * ``reads``, ``read_bytes``, ``read_ns``: reads of the program's
+          memory (including internal reads, e.g., for address translation),
+          bytes read, and nanoseconds spent
+        * ``cache_hits``, ``cache_misses``, ``cache_readaheads``: pages found
+          or not found in the memory cache (see :attr:`memory_cache_size`),
+          and times it read ahead
+        * ``snapshot_hits``: reads served from a snapshot (see
+          :meth:`Object.snapshot_()`)
+        * ``file_syscalls``, ``file_bytes``: system calls made and bytes read
+          from core dump or ``/proc`` files
+        * ``process_syscalls``, ``process_bytes``: system calls made and bytes
+          read from a running process
+        * ``process_map_faults``, ``process_map_refreshes``,
+          ``process_file_bytes``: reads of a running process which faulted
+          because the address isn't in its memory map (without a system call),
+          times its memory map was read, and bytes read from the files that
+          it maps instead of from the process
+        * ``kdump_reads``, ``kdump_bytes``, ``kdump_ns``: reads, bytes, and
+          nanoseconds spent reading kdump files
+        * ``translations``, ``translation_cache_hits``, ``pgtable_walks``:
+          reads which translated virtual addresses in the Linux kernel,
+          translations found in the cache, and mappings looked up by walking
+          page tables
+        * ``decompression_cache_hits``, ``decompressions``,
+          ``decompressed_bytes``: reads of a compressed core dump served from
+          already decompressed chunks, frames decompressed, and bytes
+          decompressed
+        * ``remote_packets``, ``remote_bytes``: memory read packets sent to and
+          bytes read from a remote target
+        * ``throttle_waits``, ``throttle_ns``: times that reads waited for
+          :attr:`max_read_bytes_per_second` or :attr:`max_reads_per_second`
+          and nanoseconds spent waiting
+        * ``coalesced_reads``: small reads served from a page read shortly
+          before while :attr:`max_reads_per_second` is set
+
+        More keys may be added in the future.
+        """
+        ...
+    def reset_stats(self) -> None:
+        """Reset all of the statistics returned by :meth:`stats()` to zero."""
+        ...
+    def profile_stats(self) -> Dict[str, Tuple[int, int]]:
+        """
+        Get the number of calls to and nanoseconds spent in libdrgn operations
+        since :attr:`profiling` was enabled.
+
+        Each value is a ``(calls, ns)`` tuple. Times are inclusive, so, e.g.,
+        the time of a type lookup includes the time spent parsing DWARF for
+        it. Time spent reading memory is returned by :meth:`stats()` instead.
+        The keys are:
+
+        * ``type_finds``: type lookups, e.g., :meth:`type()`
+        * ``member_lookups``: structure, union, and class member lookups
+        * ``object_finds``: object lookups, e.g., :meth:`object()`
+        * ``symbol_lookups``: symbol lookups by name or address
+        * ``dwarf_types``: types parsed from DWARF (time is only counted for
+          the outermost type)
+        * ``objects``: :class:`Object`\ s created (time is not counted)
+
+        More keys may be added in the future.
+        """
+        ...
+    def memory_usage(self) -> Dict[str, int]:
+        """
+        Get the number of bytes of memory allocated by each part of this
+        program.
+
+        This is useful for finding out what is using memory in a large
+        session. The keys are:
+
+        * ``dwarf_index``: the index of DWARF debugging information names
+        * ``dwarf_types``: types parsed from DWARF and the caches mapping
+          DWARF entries to them
+        * ``type_index``: caches of created pointer and array types, members,
+          enumerators, type names, and type layouts
+        * ``symbols``: symbol tables and caches, including ``/proc/kallsyms``
+        * ``prstatus``: the index of thread registers in a core dump
+        * ``memory_segments``: registered memory segments
+        * ``memory_cache``: the memory read cache (see
+          :attr:`memory_cache_size`), object snapshots, and address
+          translation and path caches
+        * ``total``: the sum of all of the above
+
+        Only memory allocated by drgn itself is counted. Memory used by
+        elfutils, mapped files, and Python objects is not included. More keys
+        may be added in the future.
+        """
+        ...
     def add_memory_segment(
         self,
         address: int,
         size: int,
         read_fn: Callable[[int, int, int, bool], bytes],
         physical: bool = False,
+        *,
+        block_size: Optional[int] = None,
     ) -> None:
         """
         Define a region of memory in the program.
@@ -273,6 +980,17 @@ class Program:
         If it overlaps a previously registered segment, the new segment takes
         precedence.
 
+        Every call to *read_fn* crosses from C into Python, which is slow if
+        it is called for many small reads. If *block_size* is given, reads
+        from the segment are served from the memory cache (see
+        :attr:`memory_cache_size`), which is enabled with the default size for
+        core dumps if it is disabled. When part of the segment that isn't
+        cached is read, *read_fn* is instead called once for the whole block
+        of *block_size* bytes aligned to *block_size* which contains it
+        (clipped to the whole 4096-byte pages in the segment), and the block
+        is cached. Blocks larger than a quarter of the cache are not read at
+        once.
+
         :param address: Address of the segment.
         :param size: Size of the segment in bytes.
         :param physical: Whether to add a physical memory segment. If
@@ -283,10 +1001,15 @@ class Program:
             the address is physical: ``(address, count, offset, physical)``. It
             should return the requested number of bytes as :class:`bytes` or
             another :ref:`buffer <python:binaryseq>` type.
+        :param block_size: Size of the blocks to read at once in bytes. Must be
+            a multiple of 4096.
         """
         ...
     def add_type_finder(
-        self, fn: Callable[[TypeKind, str, Optional[str]], Type]
+        self,
+        fn: Callable[[TypeKind, str, Optional[str]], Type],
+        *,
+        memoize: bool = True,
     ) -> None:
         """
         Register a callback for finding types in the program.
@@ -295,13 +1018,22 @@ class Program:
         until the type is found. So, more recently added callbacks take
         precedence.
 
+        By default, the result of each call, including ``None``, is remembered,
+        and the callback is not called with the same arguments again.
+
         :param fn: Callable taking a :class:`TypeKind`, name, and filename:
             ``(kind, name, filename)``. The filename should be matched with
             :func:`filename_matches()`. This should return a :class:`Type`.
+        :param memoize: Whether to remember the results of *fn*. This should
+            be ``False`` if *fn* may return a different result for the same
+            arguments later.
         """
         ...
     def add_object_finder(
-        self, fn: Callable[[Program, str, FindObjectFlags, Optional[str]], Object]
+        self,
+        fn: Callable[[Program, str, FindObjectFlags, Optional[str]], Object],
+        *,
+        memoize: bool = True,
     ) -> None:
         """
         Register a callback for finding objects in the program.
@@ -310,10 +1042,17 @@ class Program:
         until the object is found. So, more recently added callbacks take
         precedence.
 
+        By default, a copy of the object returned by each call, or ``None``, is
+        remembered, and the callback is not called with the same arguments
+        again.
+
         :param fn: Callable taking a program, name, :class:`FindObjectFlags`,
             and filename: ``(prog, name, flags, filename)``. The filename
             should be matched with :func:`filename_matches()`. This should
             return an :class:`Object`.
+        :param memoize: Whether to remember the results of *fn*. This should
+            be ``False`` if *fn* may return a different result for the same
+            arguments later, e.g., a value object read from a running program.
         """
         ...
     def set_core_dump(self, path: Union[str, bytes, os.PathLike]) -> None:
@@ -324,6 +1063,9 @@ class Program:
         mapped executable and libraries. It does not load any debugging
         symbols; see :meth:`load_default_debug_info()`.
 
+        The core dump may be compressed with xz, zstd, or LZ4, in which case
+        memory is decompressed as it is read.
+
         :param path: Core dump file path.
         """
         ...
@@ -344,14 +1086,114 @@ class Program:
         executable and libraries. It does not load any debugging symbols; see
         :meth:`load_default_debug_info()`.
 
+        Reads of addresses which aren't in the memory map of the process
+        (``/proc/pid/maps``) fail without reading from the process, and reads
+        of unmodified read-only file mappings are served from the file. The
+        map is read again when a read fails or when an unmapped address is
+        read more than 10 milliseconds after the map was last read. Call
+        :meth:`invalidate_memory_cache()` to make the next read see mappings
+        that were just created.
+
         :param pid: Process ID.
         """
         ...
+    def set_remote(self, address: str) -> None:
+        """
+        Set the program to a remote target which speaks the GDB remote serial
+        protocol, e.g., ``gdbserver``, the GDB stub of QEMU, or a small agent
+        which implements the ``qSupported``, ``QStartNoAckMode``, and ``m``
+        packets.
+
+        Only memory is read from the target. Reads are cached (see
+        :attr:`memory_cache_size`), and the reads of
+        :meth:`read_batch()` are pipelined if the target supports
+        no-acknowledgment mode. Debugging symbols are not found automatically;
+        they must be given to :meth:`load_debug_info()`.
+
+        :param address: ``HOST:PORT`` for TCP (with the host in brackets if it
+            is an IPv6 address) or ``vsock:CID:PORT`` for vsock.
+        """
+        ...
+    def set_memory_trace(self, path: Union[str, bytes, os.PathLike]) -> None:
+        """
+        Set the program to a memory trace recorded by :meth:`record_memory()`.
+
+        Reads of memory that was recorded return the most recently recorded
+        data, and reads of anything else raise a :class:`FaultError`. The
+        platform, flags (other than :attr:`ProgramFlags.IS_LIVE`), and Linux
+        kernel information of the recorded program are restored, so debugging
+        information is loaded the same way as for the original program.
+
+        This makes it possible to run a script against the same memory as a
+        core dump or kernel that can't be shared, e.g., to profile it.
+
+        :param path: Memory trace file path.
+        """
+        ...
+    def record_memory(
+        self, path: Union[str, bytes, os.PathLike], *, pages: bool = False
+    ) -> None:
+        """
+        Start recording every read from the program's memory to a trace file
+        that can be replayed with :meth:`set_memory_trace()`.
+
+        Data that is the same as the last read of the same address range is
+        only written once. Values like the per-CPU offsets of the Linux kernel
+        are only read from memory the first time they are needed, so recording
+        should start before the program is used. Registers saved in core dump
+        notes (e.g., for the stack trace of the crashed thread) are not
+        recorded.
+
+        If *pages* is true, reads only mark the pages that they touch, and the
+        current contents of those pages (and of ranges added with
+        :meth:`record_memory_range()`) are written when recording stops. This
+        makes a snapshot of, e.g., a live kernel: after one pass of a script,
+        later runs can use the trace as a frozen view at core dump speed
+        without touching the kernel again.
+
+        >>> prog.record_memory("snapshot", pages=True)
+        >>> run_analysis(prog)
+        >>> prog.stop_recording_memory()
+        >>> snapshot = Program()
+        >>> snapshot.set_memory_trace("snapshot")
+
+        The program's memory and platform must already be set.
+
+        :param path: Memory trace file path. It is created or truncated.
+        :param pages: Whether to record the touched pages instead of reads.
+        """
+        ...
+    def record_memory_range(
+        self, address: int, size: int, physical: bool = False
+    ) -> None:
+        """
+        Add the pages of a range of memory to a recording started by
+        :meth:`record_memory()` with ``pages=True``, whether or not they are
+        read. Parts of the range that can't be read when recording stops are
+        left out.
+
+        :param address: Starting address.
+        :param size: Size of the range in bytes.
+        :param physical: Whether *address* is a physical memory address.
+        :raises ValueError: if the program is not recording pages
+        """
+        ...
+    def stop_recording_memory(self) -> None:
+        """
+        Stop recording reads started by :meth:`record_memory()` and finish
+        writing the trace file. If recording pages, this reads the recorded
+        pages and writes them to the trace.
+
+        :raises ValueError: if the program is not recording
+        """
+        ...
     def load_debug_info(
         self,
         paths: Optional[Iterable[Union[str, bytes, os.PathLike]]] = None,
         default: bool = False,
         main: bool = False,
+        *,
+        background: bool = False,
     ) -> None:
         """
         Load debugging information for a list of executable or library files.
@@ -375,6 +1217,11 @@ class Program:
             For the Linux kernel, this tries to load ``vmlinux``.
 
             This is currently ignored for userspace programs.
+        :param background: Index the debugging information in a background
+            thread and return once the files have been found. For the Linux
+            kernel, ``vmlinux`` is still indexed before returning. Lookups
+            wait for indexing to finish. Errors from indexing are raised by
+            :meth:`wait_for_debug_info()` instead.
         :raises MissingDebugInfoError: if debugging information was not
             available for some files; other files with debugging information
             are still loaded
@@ -388,6 +1235,110 @@ class Program:
         This is equivalent to ``load_debug_info(None, True)``.
         """
         ...
+    def load_btf(
+        self, path: Optional[Union[str, bytes, os.PathLike]] = None
+    ) -> None:
+        """
+        Load type information for the Linux kernel from BPF Type Format (BTF)
+        instead of DWARF debugging information.
+
+        BTF is much smaller and faster to load than DWARF, so this is useful
+        for kernels built with ``CONFIG_DEBUG_INFO_BTF`` when debugging
+        information isn't installed. However, it only describes types,
+        functions, and per-CPU variables, without source files. Function and
+        variable addresses are looked up in ``/proc/kallsyms``, so they are
+        only available for the running kernel.
+
+        Types and objects in the BTF take precedence over ones in debugging
+        information loaded before this is called.
+
+        :param path: Path of the raw BTF file. Defaults to
+            ``/sys/kernel/btf/vmlinux``.
+        """
+        ...
+    def wait_for_debug_info(self) -> None:
+        """
+        Wait for debugging information loaded with
+        ``load_debug_info(..., background=True)`` to be indexed.
+
+        :raises MissingDebugInfoError: if debugging information was not
+            available for some files; other files with debugging information
+            are still loaded
+        """
+        ...
+    def debug_info_stats(self) -> Dict[str, Any]:
+        """
+        Get statistics about how this program's debugging information was
+        loaded.
+
+        This is useful for finding out why loading debugging information is
+        slow. Times are accumulated over every load. The keys are:
+
+        * ``report_ns``: nanoseconds spent finding and reporting files
+        * ``read_ns``, ``read_cpu_ns``: nanoseconds of wall time and of CPU
+          time (summed over all threads) spent applying relocations and
+          reading compilation unit headers
+        * ``index_ns``, ``index_cpu_ns``: nanoseconds of wall time and of CPU
+          time spent indexing DIEs
+        * ``cache_write_ns``: nanoseconds spent writing the index cache
+        * ``modules``, ``cus``, ``dies``, ``debug_info_bytes``: modules,
+          compilation units (not including ones read from the index cache),
+          and DIEs indexed, and bytes of ``.debug_info`` processed
+        * ``module_stats``: list of dictionaries for each indexed module, in
+          the order they were indexed, with the keys ``name``, ``read_ns``,
+          ``relocate_ns``, ``index_ns`` (summed over the threads that indexed
+          the module), ``cus``, ``dies``, ``debug_info_bytes``, and ``cached``
+          (whether it was read from the index cache)
+
+        This waits for debugging information being loaded in the background.
+        """
+        ...
+    def set_debug_info_progress(
+        self, fn: Optional[Callable[[Dict[str, Any], int, int], None]]
+    ) -> None:
+        """
+        Set a callback to report progress while debugging information is
+        indexed by :meth:`load_debug_info()`.
+
+        The callback is called each time a module has been indexed with the
+        statistics of the module (in the format of the ``module_stats``
+        entries of :meth:`debug_info_stats()`), the number of modules indexed so far,
+        and the total number of modules being indexed. It may be called from
+        another thread. Exceptions raised by the callback are printed and
+        ignored.
+
+        A callback cannot be used with ``load_debug_info(...,
+        background=True)``.
+
+        :param fn: Callback, or ``None`` to stop reporting progress.
+        """
+        ...
+    def share_debug_info(self, other: Program) -> None:
+        """
+        Share debugging information files with another program.
+
+        This is useful for analyzing many programs running the same binaries
+        in one process, e.g., many vmcores from the same kernel build. Files
+        with the same build ID are opened and decompressed once and shared by
+        all of the programs, but each program keeps its own load addresses
+        (e.g., KASLR offsets). Kernel modules are not shared.
+
+        Only files loaded after this is called are shared, so it should be
+        called before :meth:`load_debug_info()`:
+
+        >>> prog1.set_core_dump("vmcore1")
+        >>> prog2.set_core_dump("vmcore2")
+        >>> prog2.share_debug_info(prog1)
+        >>> prog1.load_default_debug_info()
+        >>> prog2.load_default_debug_info()
+
+        If this program was sharing debugging information with other programs,
+        it stops. Programs sharing debugging information must not load it
+        concurrently.
+
+        :param other: Program to share with.
+        """
+        ...
     cache: dict
     """
     Dictionary for caching program metadata.
@@ -409,6 +1360,9 @@ class Program:
                 return prog['foo']
             else:
                 return prog['bar']
+
+    :func:`drgn.helpers.memoize()` does this automatically and also
+    recomputes the value when :attr:`epoch` changes.
     """
 
 class ProgramFlags(enum.Flag):
@@ -437,6 +1391,26 @@ class FindObjectFlags(enum.Flag):
     VARIABLE = ...
     ANY = ...
 
+class FindNameFlags(enum.Flag):
+    """
+    ``FindNameFlags`` are flags for :meth:`Program.names()` selecting which
+    kinds of definitions to list names of.
+    """
+
+    CONSTANT = ...
+    FUNCTION = ...
+    VARIABLE = ...
+    OBJECT = ...
+    """Constants, functions, and variables."""
+
+    TYPE = ...
+    """Typedefs and base types."""
+
+    TAG = ...
+    """Structure, union, class, and enumerated type tags."""
+
+    ANY = ...
+
 def filename_matches(haystack: Optional[str], needle: Optional[str]) -> bool:
     """
     Return whether a filename containing a definition (*haystack*) matches a
@@ -454,6 +1428,48 @@ def filename_matches(haystack: Optional[str], needle: Optional[str]) -> bool:
     """
     ...
 
+def set_num_threads(num_threads: int) -> None:
+    """
+    Set the maximum number of threads that drgn uses for parallel work, like
+    indexing debugging information. This applies to the whole process.
+
+    The default is the value of the ``DRGN_NUM_THREADS`` environment variable
+    if it is set, otherwise the number of CPUs (or ``OMP_NUM_THREADS``).
+
+    :param num_threads: Maximum number of threads, or 0 to restore the
+        default.
+    """
+    ...
+
+def get_num_threads() -> int:
+    """
+    Get the maximum number of threads that drgn uses for parallel work. See
+    :func:`set_num_threads()`.
+    """
+    ...
+
+def set_background_reads(background: bool) -> bool:
+    """
+    Set whether memory reads made by the current thread are background reads.
+
+    Background reads, like scans over many objects, yield to other reads when
+    the memory reads of a program are limited by
+    :attr:`Program.max_read_bytes_per_second` or
+    :attr:`Program.max_reads_per_second`, so that interactive lookups on other
+    threads aren't stuck behind them. This has no effect on programs without
+    a limit.
+
+    >>> old = drgn.set_background_reads(True)
+    >>> try:
+    ...     scan(prog)
+    ... finally:
+    ...     drgn.set_background_reads(old)
+
+    :param background: Whether reads are background reads.
+    :return: Whether reads were background reads before.
+    """
+    ...
+
 def program_from_core_dump(path: Union[str, bytes, os.PathLike]) -> Program:
     """
     Create a :class:`Program` from a core dump file. The type of program (e.g.,
@@ -628,6 +1644,14 @@ class Object:
     coerce an object to the appropriate Python type (e.g., :func:`hex()`,
     :func:`round()`, and :meth:`list subscripting <object.__getitem__>`).
 
+    Objects with a structure, union, class, array, or complex type support the
+    :ref:`buffer protocol <bufferobjects>`, which exposes the raw bytes of the
+    object in the program's byte order without creating a Python object for
+    every element. For example, ``memoryview(obj)`` or
+    ``numpy.frombuffer(obj, dtype)`` can be used to read a large array. A
+    reference object is read once when the buffer is requested. Buffers are
+    read-only.
+
     Object attributes and methods are named with a trailing underscore to avoid
     conflicting with structure, union, or class members. The attributes and
     methods always take precedence; use :meth:`member_()` if there is a
@@ -734,7 +1758,7 @@ class Object:
         :raises TypeError: if this object is not an array with complete type
         """
         ...
-    def value_(self) -> Any:
+    def value_(self, *, lazy: bool = False) -> Any:
         """
         Get the value of this object as a Python object.
 
@@ -745,6 +1769,12 @@ class Object:
         returns a ``dict`` of members. For arrays, this returns a ``list`` of
         values.
 
+        :param lazy: If ``True``, structures and unions are returned as a
+            read-only :class:`collections.abc.Mapping` and arrays as a
+            read-only :class:`collections.abc.Sequence` which read and convert
+            members or elements only when they are accessed. This avoids
+            reading all of a large object when only part of it is needed.
+
         :raises FaultError: if reading the object causes a bad memory access
         :raises TypeError: if this object has an unreadable type (e.g.,
             ``void``)
@@ -783,6 +1813,39 @@ class Object:
             given name
         """
         ...
+    def member_value_(self, name: str) -> Any:
+        """
+        Get the value of a member of this object.
+
+        ``obj.member_value_(name)`` is equivalent to
+        ``obj.member_(name).value_()``, but it doesn't create an intermediate
+        :class:`Object`.
+
+        :param name: Name of the member.
+        :raises TypeError: if this object is not a structure, union, class, or
+            a pointer to one of those
+        :raises LookupError: if this object does not have a member with the
+            given name
+        """
+        ...
+    def read_members_(self, *names: str) -> Tuple[Any, ...]:
+        """
+        Get the values of several members of this object.
+
+        This is equivalent to ``tuple(obj.member_value_(name) for name in
+        names)``, but the members are read from memory with a single read when
+        they are close together.
+
+        >>> task.read_members_('pid', 'comm', 'flags')
+        (1, b'systemd', 4194560)
+
+        :param names: Names of the members.
+        :raises TypeError: if this object is not a structure, union, class, or
+            a pointer to one of those
+        :raises LookupError: if this object does not have a member with one of
+            the given names
+        """
+        ...
     def address_of_(self) -> Object:
         """
         Get a pointer to this object.
@@ -809,6 +1872,28 @@ class Object:
         As opposed to :meth:`value_()`, this returns an ``Object``, not a
         standard Python type.
 
+        :raises FaultError: if reading this object causes a bad memory access
+        :raises TypeError: if this object has an unreadable type (e.g.,
+            ``void``)
+        """
+        ...
+    def snapshot_(self) -> Object:
+        """
+        Read this object from memory once and serve later reads within it from
+        that copy.
+
+        This is useful when accessing many members of a large reference object:
+
+        >>> task = prog['init_task'].snapshot_()
+        >>> task.pid, task.tgid, task.comm
+
+        Until :meth:`Program.invalidate_memory_cache()` is called, members and
+        elements of this object (and of any other reference to the same
+        memory) read the snapshotted data instead of the program's current
+        memory. Only a few of the most recent snapshots are kept. If this
+        object is a value, this does nothing.
+
+        :return: This object.
         :raises FaultError: if reading this object causes a bad memory access
         :raises TypeError: if this object has an unreadable type (e.g.,
             ``void``)
@@ -831,7 +1916,13 @@ class Object:
         element_indices: Optional[bool] = None,
         implicit_members: Optional[bool] = None,
         implicit_elements: Optional[bool] = None,
-    ) -> str:
+        file: Union[int, IO[str], Callable[[str], Any], None] = None,
+        max_elements: Optional[int] = None,
+        max_depth: Optional[int] = None,
+        max_bytes: Optional[int] = None,
+        follow_pointers: Optional[int] = None,
+        max_dereference_bytes: Optional[int] = None,
+    ) -> Optional[str]:
         """
         Format this object in programming language syntax.
 
@@ -887,6 +1978,76 @@ class Object:
             Defaults to ``True``.
         :param implicit_elements: Include array elements which have an implicit
             value (i.e., for C, zero-initialized). Defaults to ``False``.
+        :param file: If given, write the output to this instead of returning
+            it. This may be a file descriptor, an object with a ``write()``
+            method (like a text file), or a callable which is passed each
+            chunk of output as a ``str``. Output is written in chunks as it is
+            formatted, so the whole string is never held in memory at once.
+            Formatting a large array or structure this way uses much less
+            memory as long as it is broken over multiple lines.
+        :param max_elements: Format at most this many elements of each array,
+            followed by ``...`` if there are more. Defaults to no limit.
+        :param max_depth: Format structure, union, class, and array
+            initializers nested more than this deep as ``{...}``. For example,
+            ``max_depth=1`` shows the members of this object but not their
+            members. Defaults to no limit.
+        :param max_bytes: Once about this many bytes of output have been
+            formatted, replace the remaining members and elements with
+            ``...``. Defaults to no limit.
+        :param follow_pointers: Dereference pointers in this object (e.g.,
+            structure members) up to this many levels deep, as *dereference*
+            does for this object. A pointer to an address that was already
+            dereferenced is shown with ``/* shown above */`` instead of being
+            dereferenced again, so cyclic structures like linked lists
+            terminate. NULL pointers are not followed. Defaults to 0.
+        :param max_dereference_bytes: Stop following pointers once the objects
+            they point to total this many bytes. Defaults to no limit.
+
+        Parts of the object that are left out because of *max_elements*,
+        *max_depth*, or *max_bytes* are not read from memory, so these are
+        useful for quickly looking at very large objects.
+
+        :return: The formatted string, or ``None`` if *file* was given.
+        """
+        ...
+    def json_(
+        self,
+        *,
+        max_elements: Optional[int] = None,
+        max_depth: Optional[int] = None,
+        max_bytes: Optional[int] = None,
+    ) -> str:
+        """
+        Serialize this object as JSON, including type names and addresses.
+
+        >>> json.loads(prog['init_task'].pid.json_())
+        {'type': 'pid_t', 'address': 18446744071655786920, 'value': 0}
+
+        Each object is represented as a JSON object with ``"type"`` (the type
+        name), ``"address"`` (``None`` for values and bit fields), and
+        ``"value"``. Integers, floating-point numbers, enumerated values, and
+        pointers are numbers (non-finite floating-point numbers are ``null``),
+        booleans are booleans, and functions are ``null``. Structures, unions,
+        and classes are arrays of member objects, which also have a ``"name"``
+        (``None`` for unnamed members; members of unnamed structures and
+        unions are flattened into their parent). Arrays are arrays of element
+        objects. Enumerated values also have an ``"enumerator"`` if the value
+        has a name. Pointers are not dereferenced.
+
+        This is much faster than building the equivalent structure with
+        :meth:`value_()` in Python.
+
+        :param max_elements: Include at most this many elements of each array.
+            Defaults to no limit.
+        :param max_depth: Replace the value of structures, unions, classes,
+            and arrays nested more than this deep with ``null``. Defaults to
+            no limit.
+        :param max_bytes: Once about this many bytes of output have been
+            produced, omit the remaining members and elements. Defaults to no
+            limit.
+
+        Arrays, structures, unions, and classes with members or elements left
+        out because of a limit have ``"truncated": true``.
         """
         ...
     def __iter__(self) -> Iterator[Object]: ...
@@ -992,6 +2153,170 @@ def container_of(ptr: Object, type: Union[str, Type], member: str) -> Object:
     """
     ...
 
+def format_objects(
+    objects: Iterable[Object],
+    *,
+    columns: Optional[int] = None,
+    dereference: Optional[bool] = None,
+    symbolize: Optional[bool] = None,
+    string: Optional[bool] = None,
+    char: Optional[bool] = None,
+    type_name: Optional[bool] = None,
+    member_type_names: Optional[bool] = None,
+    element_type_names: Optional[bool] = None,
+    members_same_line: Optional[bool] = None,
+    elements_same_line: Optional[bool] = None,
+    member_names: Optional[bool] = None,
+    element_indices: Optional[bool] = None,
+    implicit_members: Optional[bool] = None,
+    implicit_elements: Optional[bool] = None,
+    max_elements: Optional[int] = None,
+    max_depth: Optional[int] = None,
+    max_bytes: Optional[int] = None,
+    follow_pointers: Optional[int] = None,
+    max_dereference_bytes: Optional[int] = None,
+) -> List[str]:
+    """
+    Format many objects at once.
+
+    This returns the same strings as calling :meth:`Object.format_()` with
+    the same options on each object, in the same order, but the objects are
+    formatted in parallel on libdrgn's threads (see :func:`set_num_threads()`)
+    without holding the GIL. Cached types and type names are shared between
+    the threads.
+
+    >>> format_objects([prog['jiffies'], prog['init_task'].pid])
+    ['(volatile unsigned long)4294937296', '(pid_t)0']
+
+    Memory readers, type finders, and object finders implemented in Python
+    need the GIL, so formatting objects that use them is serialized.
+
+    :param objects: Objects to format. They must all be from the same program.
+    :raises ValueError: if the objects are from different programs
+    :raises FaultError: if reading an object fails. If more than one object
+        fails, the error for the earliest one is raised.
+    """
+    ...
+
+class MemberPath:
+    """
+    A ``MemberPath`` is a member designator resolved against a type by
+    :meth:`Program.member_path()`. Applying it does not need to look up any
+    members, so it is cheaper than the equivalent chain of member accesses and
+    subscripts when it is used repeatedly (e.g., in a loop).
+    """
+
+    container_type: Type
+    """Type that the path was resolved in."""
+
+    designator: str
+    """Member designator that was resolved."""
+
+    type: Type
+    """Type of the designated member."""
+
+    bit_offset: int
+    """
+    Offset of the designated member in bits from the beginning of
+    :attr:`container_type`.
+    """
+
+    bit_field_size: int
+    """
+    Size in bits of the designated member if it is a bit field, zero otherwise.
+    """
+    def apply(self, obj: Union[Object, int]) -> Object:
+        """
+        Get the designated member of an object.
+
+        :param obj: An object of :attr:`container_type`, a pointer to one (in
+            which case the pointer is dereferenced), or the address of one.
+        """
+        ...
+
+class PointerIndex:
+    """
+    A ``PointerIndex`` maps addresses to the locations in memory which point
+    to them. It is created with :meth:`Program.build_pointer_index()` or
+    :meth:`Program.load_pointer_index()`.
+
+    ``len(index)`` is the number of pointers in the index.
+    """
+
+    def __len__(self) -> int: ...
+    def find(self, address: int, size: int = 1) -> List[Tuple[int, int]]:
+        """
+        Find the pointers to an address range.
+
+        :param address: Start of the range.
+        :param size: Size of the range in bytes, e.g., the size of an object
+            to find all of the pointers into it.
+        :return: ``(source, target)`` tuples of the address of each pointer
+            and its value, sorted by target and then by source.
+        """
+        ...
+    def save(self, path: Union[str, bytes, os.PathLike]) -> None:
+        """
+        Save this index to a file, e.g., next to the core dump that it was
+        built from.
+
+        :param path: Index file path.
+        """
+        ...
+
+class MemoryHashes:
+    """
+    A ``MemoryHashes`` is a hash of each page of a program's memory. It is
+    created with :meth:`Program.hash_memory()`.
+
+    Pages are compared by their 64-bit hashes, so a change could be missed in
+    the unlikely event of a hash collision. Hashes cannot be saved, because
+    they are only stable within one process.
+
+    ``len(hashes)`` is the number of pages that were hashed.
+    """
+
+    physical: bool
+    """Whether the hashes are of physical memory."""
+    def __len__(self) -> int: ...
+    def diff(self, other: MemoryHashes) -> List[Tuple[int, int]]:
+        """
+        Find the memory which differs between these hashes and other hashes.
+
+        Memory which could only be read in one of them is considered
+        different. The helpers in :mod:`drgn.helpers.linux.diff` can describe
+        what the regions contain.
+
+        :param other: Hashes to compare to.
+        :return: ``(address, size)`` tuples of the regions which differ,
+            sorted by address. Adjacent regions are merged.
+        :raises ValueError: if one of the hashes is of physical memory and the
+            other is of virtual memory
+        """
+        ...
+
+class Watch:
+    """
+    A ``Watch`` samples a set of objects in a program's memory. It is created
+    with :meth:`Program.watch()`.
+
+    ``len(watch)`` is the number of watched objects.
+    """
+
+    def __len__(self) -> int: ...
+    def sample(self) -> List[Tuple[int, Object]]:
+        """
+        Read the watched objects again.
+
+        :return: ``(index, value)`` tuples of the objects whose values changed
+            since the previous sample, in the order that they were passed to
+            :meth:`Program.watch()`. The value is the new value of the
+            object. Every object is returned by the first sample.
+        :raises FaultError: if any of the objects could not be read. The
+            next sample is compared to the last successful one.
+        """
+        ...
+
 class Symbol:
     """
     A ``Symbol`` represents an entry in the symbol table of a program, i.e., an
@@ -1066,6 +2391,17 @@ class StackFrame:
         instruction instead of the return address.
         """
         ...
+    def source(self) -> Tuple[str, int, int]:
+        """
+        Get the source code location of this stack frame as a ``(filename,
+        line, column)`` tuple. The line and column are 0 if they are not known.
+
+        Like :meth:`symbol()`, this uses the call instruction for function
+        calls.
+
+        :raises LookupError: if the location is not known
+        """
+        ...
     def register(self, reg: Union[str, int, Register]) -> int:
         """
         Get the value of the given register at this stack frame. The register
@@ -1637,6 +2973,7 @@ class OutOfBoundsError(Exception):
 _with_libkdumpfile: bool
 
 def _linux_helper_read_vm(prog, pgtable, address, size): ...
+def _linux_helper_vm_translation(prog, pgtable): ...
 def _linux_helper_radix_tree_lookup(root, index): ...
 def _linux_helper_idr_find(idr, id): ...
 def _linux_helper_find_pid(ns, pid): ...
@@ -1644,3 +2981,42 @@ def _linux_helper_pid_task(pid, pid_type): ...
 def _linux_helper_find_task(ns, pid): ...
 def _linux_helper_task_state_to_char(task): ...
 def _linux_helper_pgtable_l5_enabled(prog): ...
+def _linux_helper_list_for_each(head, reverse=False): ...
+def _linux_helper_list_for_each_entry(type, head, member, reverse=False): ...
+def _linux_helper_hlist_for_each(head): ...
+def _linux_helper_hlist_for_each_entry(type, head, member): ...
+def _linux_helper_rbtree_inorder_for_each(root): ...
+def _linux_helper_rbtree_inorder_for_each_entry(type, root, member): ...
+def _linux_helper_rb_find(type, root, member, key, key_member): ...
+def _linux_helper_radix_tree_for_each(root): ...
+def _linux_helper_idr_for_each(idr, type=None): ...
+def _linux_helper_for_each_pid(ns): ...
+def _linux_helper_for_each_task(ns): ...
+def _linux_helper_for_each_page(prog, flags=0): ...
+def _linux_helper_page_pfns(prog, flags=0): ...
+def _linux_helper_per_cpu_ptr(ptr, cpu): ...
+def _linux_helper_per_cpu_ptrs(ptr, mask=None): ...
+def _linux_helper_percpu_sum(ptr, mask=None): ...
+def _linux_helper_slab_cache_for_each_allocated_object(
+    slab_cache, type, cpu_freelists=True
+): ...
+def _linux_helper_d_path(path_or_vfsmnt, dentry=None): ...
+def _linux_helper_dentry_path(dentry): ...
+def _linux_helper_task_snapshot(ns, fields): ...
+def _linux_helper_task_args(ns, tasks=None, *, cmdline=True, environ=True): ...
+def _linux_helper_ftrace_events(prog, buffer=None): ...
+def _linux_helper_sock_table(prog, udp=False, info=False): ...
+def _linux_helper_sb_inodes(sb, info=False, page_cache=False): ...
+def _linux_helper_cgroup_walk(css, fields=(), type=None): ...
+def _linux_helper_btf_type_name(btf, type_id): ...
+def _linux_helper_btf_type(btf, type_id): ...
+def _linux_helper_blk_mq_inflight(q): ...
+def _linux_helper_filter_tasks(ns, *, state=None, comm=None, pids=None, tgids=None): ...
+def _linux_helper_cache_pids(ns): ...
+def _linux_helper_pending_timers(prog): ...
+def _linux_helper_page_owner_stacks(prog): ...
+def _linux_helper_runqueues(prog): ...
+def _linux_helper_task_rss(ns): ...
+def _linux_helper_memcg_usage(css): ...
+def _linux_helper_vmalloc_areas(prog, by_caller=False): ...
+def _glibc_helper_malloc_walk(prog, min_size=0, max_size=None, chunks=False): ...
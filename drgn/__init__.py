@@ -48,14 +48,18 @@ import types
 from _drgn import (
     Architecture,
     FaultError,
+    FindNameFlags,
     FindObjectFlags,
     Language,
+    MemberPath,
+    MemoryHashes,
     MissingDebugInfoError,
     NULL,
     Object,
     OutOfBoundsError,
     Platform,
     PlatformFlags,
+    PointerIndex,
     PrimitiveType,
     Program,
     ProgramFlags,
@@ -69,6 +73,7 @@ from _drgn import (
     TypeKind,
     TypeMember,
     TypeParameter,
+    Watch,
     _with_libkdumpfile,
     array_type,
     bool_type,
@@ -79,7 +84,9 @@ from _drgn import (
     enum_type,
     filename_matches,
     float_type,
+    format_objects,
     function_type,
+    get_num_threads,
     host_platform,
     int_type,
     pointer_type,
@@ -87,6 +94,8 @@ from _drgn import (
     program_from_kernel,
     program_from_pid,
     reinterpret,
+    set_background_reads,
+    set_num_threads,
     sizeof,
     struct_type,
     typedef_type,
@@ -98,14 +107,18 @@ from _drgn import (
 __all__ = (
     "Architecture",
     "FaultError",
+    "FindNameFlags",
     "FindObjectFlags",
     "Language",
+    "MemberPath",
+    "MemoryHashes",
     "MissingDebugInfoError",
     "NULL",
     "Object",
     "OutOfBoundsError",
     "Platform",
     "PlatformFlags",
+    "PointerIndex",
     "PrimitiveType",
     "Program",
     "ProgramFlags",
@@ -119,6 +132,7 @@ __all__ = (
     "TypeKind",
     "TypeMember",
     "TypeParameter",
+    "Watch",
     "array_type",
     "bool_type",
     "cast",
@@ -129,7 +143,9 @@ __all__ = (
     "execscript",
     "filename_matches",
     "float_type",
+    "format_objects",
     "function_type",
+    "get_num_threads",
     "host_platform",
     "int_type",
     "pointer_type",
@@ -137,6 +153,8 @@ __all__ = (
     "program_from_kernel",
     "program_from_pid",
     "reinterpret",
+    "set_background_reads",
+    "set_num_threads",
     "sizeof",
     "struct_type",
     "typedef_type",
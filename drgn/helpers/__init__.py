@@ -6,8 +6,8 @@ Helpers
 -------
 
 The ``drgn.helpers`` package contains subpackages which provide helpers for
-working with particular types of programs. Currently, there are only helpers
-for the Linux kernel. In the future, there may be helpers for, e.g., glibc and
+working with particular types of programs. Currently, there are helpers for
+the Linux kernel and for glibc. In the future, there may be helpers for, e.g.,
 libstdc++.
 
 Parameter types and return types are :class:`drgn.Object` unless noted
@@ -22,11 +22,14 @@ useful for scripts or for implementing other helpers.
 """
 
 import enum
+import functools
 import typing
-from typing import Container, Iterable, List, Tuple
+from typing import Any, Callable, Container, Iterable, List, Tuple, TypeVar
 
 from drgn import Type
 
+_T = TypeVar("_T")
+
 
 def escape_ascii_character(
     c: int,
@@ -117,3 +120,44 @@ def enum_type_to_class(
         if name not in exclude
     ]
     return enum.IntEnum(name, enumerators)  # type: ignore  # python/mypy#4865
+
+
+def memoize(func: Callable[..., _T]) -> Callable[..., _T]:
+    """
+    Decorator which caches the return value of a helper in
+    :attr:`drgn.Program.cache` until :attr:`drgn.Program.epoch` changes.
+
+    The first argument of the helper must be the :class:`drgn.Program`, and
+    the remaining arguments must be hashable. The helper is called at most once
+    per epoch for each combination of arguments. Exceptions aren't cached.
+
+    .. code-block:: python3
+
+        @memoize
+        def tcp_state_class(prog):
+            return enum_type_to_class(
+                prog.type("enum tcp_state"), "TcpState", prefix="TCP_"
+            )
+
+    For a running program, set :attr:`drgn.Program.epoch_interval` or call
+    :meth:`drgn.Program.bump_epoch()` so that memoized values don't go stale.
+    """
+
+    @functools.wraps(func)
+    def wrapper(prog: Any, *args: Any, **kwargs: Any) -> _T:
+        key: Any = (args, frozenset(kwargs.items())) if kwargs else args
+        epoch = prog.epoch
+        entry = prog.cache.get(wrapper)
+        if entry is None or entry[0] != epoch:
+            entry = (epoch, {})
+            prog.cache[wrapper] = entry
+        values = entry[1]
+        try:
+            return values[key]
+        except KeyError:
+            pass
+        value = func(prog, *args, **kwargs)
+        values[key] = value
+        return value
+
+    return wrapper
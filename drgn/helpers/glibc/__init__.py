@@ -0,0 +1,27 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+"""
+glibc
+-----
+
+The ``drgn.helpers.glibc`` package contains modules for working with data
+structures in userspace programs using the GNU C Library. As with
+:mod:`drgn.helpers.linux`, the helpers are available from the individual
+modules in which they are defined and from this top-level package.
+"""
+
+import importlib
+import pkgutil
+
+
+__all__ = []
+for _module_info in pkgutil.iter_modules(
+    __path__,  # type: ignore[name-defined]  # python/mypy#1422
+    prefix=__name__ + ".",
+):
+    _submodule = importlib.import_module(_module_info.name)
+    _submodule_all = getattr(_submodule, "__all__", ())
+    __all__.extend(_submodule_all)
+    for _name in _submodule_all:
+        globals()[_name] = getattr(_submodule, _name)
@@ -0,0 +1,86 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+"""
+Malloc
+------
+
+The ``drgn.helpers.glibc.malloc`` module provides helpers for profiling the
+glibc malloc heap of a userspace program. The heap is walked in libdrgn, which
+reads it in large blocks and decodes the chunk headers natively, so these
+helpers are practical for heaps with millions of chunks.
+
+The program must have debugging symbols for glibc (in particular, for
+``main_arena`` and ``mp_``). Chunks satisfied directly with ``mmap()`` are not
+part of any arena and are not found. Chunks cached in a thread's tcache look
+allocated to the heap and are counted as in use.
+"""
+
+from typing import Dict, Iterator, List, NamedTuple, Optional, Tuple
+
+from _drgn import _glibc_helper_malloc_walk
+from drgn import Program
+
+__all__ = (
+    "MallocStats",
+    "for_each_malloc_chunk",
+    "malloc_stats",
+)
+
+
+class MallocStats(NamedTuple):
+    """Statistics about the glibc malloc heap returned by :func:`malloc_stats()`."""
+
+    arenas: int
+    """Number of arenas, including ``main_arena``."""
+    heaps: int
+    """Number of ``mmap()``-ed heaps belonging to thread arenas."""
+    in_use_chunks: int
+    """Number of allocated chunks."""
+    in_use_bytes: int
+    """Total size of allocated chunks, including chunk headers."""
+    free_chunks: int
+    """Number of free chunks, including chunks in fastbins."""
+    free_bytes: int
+    """Total size of free chunks (not including the top chunks)."""
+    fastbin_chunks: int
+    """Number of free chunks which are in fastbins."""
+    fastbin_bytes: int
+    """Total size of free chunks which are in fastbins."""
+    top_bytes: int
+    """Total size of the top chunks of all arenas."""
+    size_classes: List[Tuple[int, int]]
+    """
+    List of ``(chunk_size, count)`` pairs for allocated chunks, sorted by chunk
+    size.
+    """
+
+
+def malloc_stats(prog: Program) -> MallocStats:
+    """
+    Walk every arena of the glibc malloc heap and return statistics about the
+    allocated and free chunks.
+
+    :param prog: Userspace program.
+    """
+    stats: Dict = _glibc_helper_malloc_walk(prog)[0]
+    return MallocStats(**stats)
+
+
+def for_each_malloc_chunk(
+    prog: Program, min_size: int = 0, max_size: Optional[int] = None
+) -> Iterator[Tuple[int, int]]:
+    """
+    Iterate over the allocated chunks of the glibc malloc heap, optionally only
+    those with a usable size in a given range (e.g., a single size class).
+
+    :param prog: Userspace program.
+    :param min_size: Minimum usable size of chunks to return.
+    :param max_size: Maximum usable size of chunks to return, or ``None`` for
+        no maximum.
+    :return: Iterator of ``(address, usable_size)`` tuples, where ``address``
+        is the address returned by ``malloc()``.
+    """
+    return iter(
+        _glibc_helper_malloc_walk(prog, min_size, max_size, chunks=True)[1]
+    )
@@ -30,17 +30,67 @@ Translates to the following code in Python:
         do_something_with(pos)
 """
 
+import ast
 import importlib
+import os.path
 import pkgutil
+import re
+import sys
+from typing import Any, Dict, List, Optional, Tuple
 
+# Submodules are imported on first use of one of their helpers (PEP 562), so
+# importing a single helper doesn't import every subsystem. To know which
+# submodule defines which helper without importing them all, their __all__
+# tuples are read from the source.
+_ALL_RE = re.compile(r"^__all__ = (\([^)]*\))", re.MULTILINE)
 
-__all__ = []
+
+def _find_all(module_info: pkgutil.ModuleInfo) -> Optional[Tuple[str, ...]]:
+    path = getattr(module_info.module_finder, "path", None)
+    if path is None or module_info.ispkg:
+        return None
+    filename = module_info.name.rpartition(".")[2] + ".py"
+    try:
+        with open(os.path.join(path, filename), "r") as f:
+            match = _ALL_RE.search(f.read())
+        if not match:
+            return None
+        return tuple(ast.literal_eval(match.group(1)))
+    except (OSError, SyntaxError, ValueError):
+        return None
+
+
+__all__: List[str] = []
+_lazy: Dict[str, str] = {}
 for _module_info in pkgutil.iter_modules(
     __path__,  # type: ignore[name-defined]  # python/mypy#1422
     prefix=__name__ + ".",
 ):
-    _submodule = importlib.import_module(_module_info.name)
-    _submodule_all = getattr(_submodule, "__all__", ())
+    # Module __getattr__() requires Python 3.7.
+    if sys.version_info >= (3, 7):
+        _submodule_all = _find_all(_module_info)
+    else:
+        _submodule_all = None
+    if _submodule_all is None:
+        _submodule = importlib.import_module(_module_info.name)
+        _submodule_all = getattr(_submodule, "__all__", ())
+        for _name in _submodule_all:
+            globals()[_name] = getattr(_submodule, _name)
+    else:
+        for _name in _submodule_all:
+            _lazy[_name] = _module_info.name
     __all__.extend(_submodule_all)
-    for _name in _submodule_all:
-        globals()[_name] = getattr(_submodule, _name)
+
+
+def __getattr__(name: str) -> Any:
+    try:
+        module_name = _lazy[name]
+    except KeyError:
+        raise AttributeError(f"module {__name__!r} has no attribute {name!r}") from None
+    value = getattr(importlib.import_module(module_name), name)
+    globals()[name] = value
+    return value
+
+
+def __dir__() -> List[str]:
+    return sorted(set(globals()) | set(__all__))
@@ -10,12 +10,14 @@ Linux block layer, including disks (``struct gendisk``) and partitions
 (``struct hd_struct``).
 """
 
+from _drgn import _linux_helper_blk_mq_inflight
 from drgn import container_of
-from drgn.helpers import escape_ascii_string
+from drgn.helpers import escape_ascii_string, memoize
 from drgn.helpers.linux.device import MAJOR, MINOR, MKDEV
 from drgn.helpers.linux.list import list_for_each_entry
 
 __all__ = (
+    "blk_mq_inflight",
     "disk_devt",
     "disk_name",
     "for_each_disk",
@@ -47,18 +49,18 @@ def disk_name(disk):
     return disk.disk_name.string_()
 
 
+@memoize
+def _knode_class_in_device_private(prog):
+    # We need a proper has_member(), but this is fine for now.
+    return any(
+        member.name == "knode_class"
+        for member in prog.type("struct device_private").members
+    )
+
+
 def _for_each_block_device(prog):
-    try:
-        class_in_private = prog.cache["knode_class_in_device_private"]
-    except KeyError:
-        # We need a proper has_member(), but this is fine for now.
-        class_in_private = any(
-            member.name == "knode_class"
-            for member in prog.type("struct device_private").members
-        )
-        prog.cache["knode_class_in_device_private"] = class_in_private
     devices = prog["block_class"].p.klist_devices.k_list.address_of_()
-    if class_in_private:
+    if _knode_class_in_device_private(prog):
         for device_private in list_for_each_entry(
             "struct device_private", devices, "knode_class.n_node"
         ):
@@ -88,6 +90,30 @@ def print_disks(prog):
         print(f"{major}:{minor} {name} ({disk.type_.type_name()})0x{disk.value_():x}")
 
 
+def blk_mq_inflight(q):
+    """
+    .. c:function:: blk_mq_inflight(struct request_queue *q)
+
+    Get the requests of a blk-mq request queue which are in flight, i.e.,
+    which were issued to the driver and haven't completed.
+
+    The request arrays of the queue's tags are read in bulk and the requests
+    are read natively, so this is fast even for queues with thousands of tags.
+    For example, to find the oldest in-flight request on the system:
+
+    >>> requests = [
+    ...     req for disk in for_each_disk(prog) for req in blk_mq_inflight(disk.queue)
+    ... ]
+    >>> oldest = min(requests, key=lambda req: req[2], default=None)
+
+    :return: List of (``struct request *`` object, ``struct gendisk *``
+        object, ``start_time_ns``, ``io_start_time_ns``, sector, length in
+        bytes, ``cmd_flags``) tuples. ``io_start_time_ns`` is 0 if the kernel
+        doesn't record it.
+    """
+    return _linux_helper_blk_mq_inflight(q)
+
+
 def part_devt(part):
     """
     .. c:function:: dev_t part_devt(struct hd_struct *part)
@@ -13,7 +13,7 @@ etc.
 
 import itertools
 
-from drgn import cast
+from _drgn import _linux_helper_btf_type, _linux_helper_btf_type_name
 from drgn.helpers.linux.idr import idr_for_each
 from drgn.helpers.linux.list import list_for_each_entry
 
@@ -21,11 +21,46 @@ from drgn.helpers.linux.list import list_for_each_entry
 __all__ = (
     "bpf_map_for_each",
     "bpf_prog_for_each",
+    "btf_type",
+    "btf_type_name",
     "cgroup_bpf_prog_for_each",
     "cgroup_bpf_prog_for_each_effective",
 )
 
 
+def btf_type_name(btf, type_id):
+    """
+    .. c:function:: const char *btf_type_name(struct btf *btf, u32 type_id)
+
+    Get the name of a type (or function or variable) in the given BTF (e.g.,
+    ``bpf_prog->aux->btf``).
+
+    The BTF is read from memory in bulk and indexed the first time it is used,
+    and it is cached until its data changes, so looking up many names in the
+    same BTF is cheap.
+
+    :param type_id: BTF type ID.
+    :return: The name, or ``None`` if the type is anonymous or the ID is not
+        valid.
+    :rtype: str or None
+    """
+    return _linux_helper_btf_type_name(btf, type_id)
+
+
+def btf_type(btf, type_id):
+    """
+    .. c:function:: btf_type(struct btf *btf, u32 type_id)
+
+    Get a type in the given BTF as a :class:`drgn.Type`. Like
+    :func:`btf_type_name()`, the BTF is cached. Functions are returned as
+    their function type.
+
+    :param type_id: BTF type ID.
+    :rtype: Type
+    """
+    return _linux_helper_btf_type(btf, type_id)
+
+
 def bpf_map_for_each(prog):
     """
     .. c:function:: bpf_map_for_each(prog)
@@ -34,8 +69,8 @@ def bpf_map_for_each(prog):
 
     :return: Iterator of ``struct bpf_map *`` objects.
     """
-    for nr, entry in idr_for_each(prog["map_idr"]):
-        yield cast("struct bpf_map *", entry)
+    for nr, entry in idr_for_each(prog["map_idr"], "struct bpf_map *"):
+        yield entry
 
 
 def bpf_prog_for_each(prog):
@@ -46,8 +81,8 @@ def bpf_prog_for_each(prog):
 
     :return: Iterator of ``struct bpf_prog *`` objects.
     """
-    for nr, entry in idr_for_each(prog["prog_idr"]):
-        yield cast("struct bpf_prog *", entry)
+    for nr, entry in idr_for_each(prog["prog_idr"], "struct bpf_prog *"):
+        yield entry
 
 
 def cgroup_bpf_prog_for_each(cgrp, bpf_attach_type):
@@ -10,8 +10,11 @@ cgroup interface in :linux:`include/linux/cgroup.h`. Only cgroup v2 is
 supported.
 """
 
+from array import array
+from typing import Any, Dict
 
-from drgn import NULL, cast, container_of
+from _drgn import _linux_helper_cgroup_walk, _linux_helper_memcg_usage
+from drgn import NULL, Object, Program, cast, container_of
 from drgn.helpers.linux.kernfs import kernfs_name, kernfs_path
 from drgn.helpers.linux.list import list_for_each_entry
 
@@ -19,10 +22,12 @@ __all__ = (
     "cgroup_name",
     "cgroup_parent",
     "cgroup_path",
+    "cgroup_walk",
     "css_for_each_child",
     "css_for_each_descendant_pre",
     "css_next_child",
     "css_next_descendant_pre",
+    "memcg_usage",
     "sock_cgroup_ptr",
 )
 
@@ -156,3 +161,100 @@ def css_for_each_descendant_pre(css):
     :return: Iterator of ``struct cgroup_subsys_state *`` objects.
     """
     return _css_for_each_impl(css_next_descendant_pre, css)
+
+
+def cgroup_walk(css, fields=(), type="struct cgroup"):
+    """
+    .. c:function:: cgroup_walk(struct cgroup_subsys_state *css, fields, type)
+
+    Iterate through the given css's descendants in pre-order, like
+    :func:`css_for_each_descendant_pre()`, along with their depths, names, and
+    a selection of fields.
+
+    The hierarchy is walked natively, with one read per cgroup covering the
+    list links and all of the requested fields, so this is much faster than
+    :func:`css_for_each_descendant_pre()` and :func:`cgroup_name()` for
+    hierarchies with many cgroups. For example, to print the memory usage of
+    every memory cgroup:
+
+    >>> root = prog["root_mem_cgroup"].css.address_of_()
+    >>> for memcg, depth, name, (usage,) in cgroup_walk(
+    ...     root, ["memory.usage.counter"], "struct mem_cgroup"
+    ... ):
+    ...     print("  " * depth + name.decode(), usage)
+    ...
+    / 1048576
+      system.slice 524288
+        sshd.service 2048
+
+    :param fields: Member designators of integer fields to read from each
+        cgroup (e.g., ``"memory.usage.counter"``).
+    :param type: Name of the type containing the ``struct
+        cgroup_subsys_state`` of each cgroup, e.g., ``"struct cgroup"`` for
+        the css of the default hierarchy, or ``"struct mem_cgroup"`` for the
+        css of the memory controller. The first member with type ``struct
+        cgroup_subsys_state`` is used.
+    :return: Iterator of (``type *`` object, depth below *css*, name,
+        tuple of the values of *fields*) tuples. The name is ``bytes``.
+    """
+    online = css.prog_["CSS_ONLINE"].value_()
+    for obj, depth, flags, name, values in _linux_helper_cgroup_walk(
+        css, fields, type
+    ):
+        if flags & online:
+            yield obj, depth, name, values
+
+
+def memcg_usage(prog_or_css) -> Dict[str, Any]:
+    """
+    Get the memory usage of every memory cgroup.
+
+    The hierarchy is walked natively like :func:`cgroup_walk()`, and the
+    per-CPU charge stocks of every CPU are read in one batch, so this is fast
+    even with tens of thousands of memory cgroups. Memory cgroups which are
+    offline but still have memory charged to them are included.
+
+    >>> table = memcg_usage(prog)
+    >>> for name, usage, stock in zip(table["name"], table["usage"], table["stock"]):
+    ...     print(name.decode(), usage - stock)
+    ...
+    / 1048576
+    system.slice 524288
+    sshd.service 2048
+
+    :param prog_or_css: ``struct cgroup_subsys_state *`` object of the memory
+        controller of the root of the walk, or :class:`Program` to walk every
+        memory cgroup (starting from ``root_mem_cgroup``).
+    :return: Mapping from the column name to a list (for ``name``) or an
+        array with type code ``"Q"`` (for the others), with a value for each
+        memory cgroup in pre-order. The columns are:
+
+        * ``memcg``: address of the ``struct mem_cgroup``.
+        * ``depth``: depth below the root of the walk.
+        * ``name``: name of the cgroup, as ``bytes``.
+        * ``online``: 1 if the memory cgroup is online, 0 otherwise.
+        * ``usage``: pages charged to the memory cgroup (``memory.usage``).
+        * ``stock``: pages included in ``usage`` which are precharged in the
+          per-CPU charge stocks but not in use yet. The pages in use are
+          ``usage - stock``.
+    """
+    if isinstance(prog_or_css, Program):
+        prog = prog_or_css
+        css = prog["root_mem_cgroup"].css.address_of_()
+    else:
+        prog = prog_or_css.prog_
+        css = prog_or_css
+    online = prog["CSS_ONLINE"].value_()
+    table = _linux_helper_memcg_usage(css)
+    ret: Dict[str, Any] = {}
+    for name, data in table.items():
+        if name == "name":
+            ret[name] = data
+        elif name == "flags":
+            flags = array("Q")
+            flags.frombytes(data)
+            ret["online"] = array("Q", [1 if f & online else 0 for f in flags])
+        else:
+            ret[name] = array("Q")
+            ret[name].frombytes(data)
+    return ret
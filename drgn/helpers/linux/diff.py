@@ -0,0 +1,80 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+"""
+Memory Diffs
+------------
+
+The ``drgn.helpers.linux.diff`` module provides helpers for describing the
+memory which differs between two images of the Linux kernel, as found by
+:meth:`drgn.MemoryHashes.diff()`.
+"""
+
+from typing import Iterable, Iterator, Optional, Tuple
+
+from drgn import Object, Program
+from drgn.helpers.linux.mm import compound_head, page_to_virt, virt_to_page
+from drgn.helpers.linux.slab import find_containing_slab_cache
+
+__all__ = (
+    "describe_memory_diff",
+    "identify_address",
+)
+
+
+def identify_address(prog: Program, addr) -> Optional[str]:
+    """
+    Describe what an address is part of: either a symbol or an object in a
+    slab cache.
+
+    >>> identify_address(prog, 0xffffffffbe012958)
+    'symbol: init_task+0x18'
+    >>> identify_address(prog, 0xffff905e41404010)
+    'slab object: dentry+0x10'
+
+    :param addr: ``void *``
+    :type addr: Object or int
+    :return: Description, or ``None`` if the address is not recognized.
+    """
+    if isinstance(addr, Object):
+        addr = addr.value_()
+    try:
+        sym = prog.symbol(addr)
+    except LookupError:
+        pass
+    else:
+        return f"symbol: {sym.name}+{hex(addr - sym.address)}"
+    cache = find_containing_slab_cache(prog, addr)
+    if cache:
+        slab = page_to_virt(compound_head(virt_to_page(prog, addr))).value_()
+        offset = (addr - slab) % cache.size.value_()
+        return f"slab object: {cache.name.string_().decode()}+{hex(offset)}"
+    return None
+
+
+def describe_memory_diff(
+    prog: Program, regions: Iterable[Tuple[int, int]], physical: bool = True
+) -> Iterator[Tuple[int, int, Optional[str]]]:
+    """
+    Describe the regions of memory which differ between two images of the
+    kernel.
+
+    >>> regions = good.hash_memory().diff(bad.hash_memory())
+    >>> for address, size, what in describe_memory_diff(bad, regions):
+    ...     print(hex(address), size, what)
+    ...
+    0x3a404000 64 slab object: dentry+0x0
+    0x3a41f000 4096 None
+
+    Physical addresses are described by their directly mapped virtual
+    addresses. Only the start of each region is identified.
+
+    :param regions: ``(address, size)`` tuples as returned by
+        :meth:`drgn.MemoryHashes.diff()`.
+    :param physical: Whether the regions are of physical memory.
+    :return: Iterator of ``(address, size, description)`` tuples, where the
+        description is as returned by :func:`identify_address()`.
+    """
+    page_offset = prog["PAGE_OFFSET"].value_() if physical else 0
+    for address, size in regions:
+        yield address, size, identify_address(prog, page_offset + address)
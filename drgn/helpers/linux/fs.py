@@ -11,6 +11,11 @@ Linux virtual filesystem (VFS) layer, including mounts, dentries, and inodes.
 
 import os
 
+from _drgn import (
+    _linux_helper_d_path,
+    _linux_helper_dentry_path,
+    _linux_helper_sb_inodes,
+)
 from drgn import Object, Program, container_of
 from drgn.helpers import escape_ascii_string
 from drgn.helpers.linux.list import (
@@ -26,6 +31,8 @@ __all__ = (
     "dentry_path",
     "inode_path",
     "inode_paths",
+    "for_each_sb_inode",
+    "sb_inode_table",
     "mount_src",
     "mount_dst",
     "mount_fstype",
@@ -132,55 +139,24 @@ def d_path(path_or_vfsmnt, dentry=None):
 
     Return the full path of a dentry given a ``struct path *`` or a mount and a
     dentry.
-    """
-    type_name = str(path_or_vfsmnt.type_.type_name())
-    if type_name == "struct path" or type_name == "struct path *":
-        vfsmnt = path_or_vfsmnt.mnt
-        dentry = path_or_vfsmnt.dentry.read_()
-    else:
-        vfsmnt = path_or_vfsmnt
-        dentry = dentry.read_()
-    mnt = container_of(vfsmnt, "struct mount", "mnt")
 
-    d_op = dentry.d_op.read_()
-    if d_op and d_op.d_dname:
-        return None
-
-    components = []
-    while True:
-        if dentry == mnt.mnt.mnt_root:
-            mnt_parent = mnt.mnt_parent.read_()
-            if mnt == mnt_parent:
-                break
-            dentry = mnt.mnt_mountpoint.read_()
-            mnt = mnt_parent
-            continue
-        d_parent = dentry.d_parent.read_()
-        if dentry == d_parent:
-            break
-        components.append(dentry.d_name.name.string_())
-        components.append(b"/")
-        dentry = d_parent
-    if components:
-        return b"".join(reversed(components))
-    else:
-        return b"/"
+    While the memory cache is enabled (see
+    :attr:`drgn.Program.memory_cache_size`), which it is by default for core
+    dumps, the path of every dentry walked is cached, so paths with a common
+    prefix only walk it once. The cached paths are discarded along with the
+    memory cache (e.g., by :meth:`drgn.Program.invalidate_memory_cache()`).
+    """
+    return _linux_helper_d_path(path_or_vfsmnt, dentry)
 
 
 def dentry_path(dentry):
     """
     .. c:function:: char *dentry_path(struct dentry *dentry)
 
-    Return the path of a dentry from the root of its filesystem.
+    Return the path of a dentry from the root of its filesystem. This uses the
+    same cache as :func:`d_path()`.
     """
-    components = []
-    while True:
-        d_parent = dentry.d_parent.read_()
-        if dentry == d_parent:
-            break
-        components.append(dentry.d_name.name.string_())
-        dentry = d_parent
-    return b"/".join(reversed(components))
+    return _linux_helper_dentry_path(dentry)
 
 
 def inode_path(inode):
@@ -213,6 +189,59 @@ def inode_paths(inode):
     )
 
 
+def for_each_sb_inode(sb):
+    """
+    .. c:function:: for_each_sb_inode(struct super_block *sb)
+
+    Iterate over all of the inodes of a superblock (i.e., the ``s_inodes``
+    list). The list is walked natively, so this is much faster than
+    :func:`~drgn.helpers.linux.list.list_for_each_entry()` for superblocks
+    with many inodes.
+
+    :return: Iterator of ``struct inode *`` objects.
+    """
+    return iter(_linux_helper_sb_inodes(sb))
+
+
+def sb_inode_table(sb, page_cache=False):
+    """
+    .. c:function:: sb_inode_table(struct super_block *sb, bool page_cache)
+
+    Get a table of the inodes of a superblock and their page cache usage.
+
+    Each inode is read natively with a single read and no objects are
+    created, so this scales to superblocks with tens of millions of cached
+    inodes. For example, to find the inodes using the most page cache:
+
+    >>> table = sb_inode_table(sb)
+    >>> top = sorted(zip(table["nrpages"], table["inode"]), reverse=True)[:3]
+    >>> for nrpages, inode in top:
+    ...     inode = Object(prog, "struct inode *", value=inode)
+    ...     print(nrpages, inode_path(inode))
+    ...
+    262144 b'/var/lib/db/data.0'
+    65536 b'/usr/lib/locale/locale-archive'
+    4096 b'/usr/bin/python3.8'
+
+    :param page_cache: Whether to also walk the page cache of each inode and
+        count its entries. This is slower, but it reports what is actually in
+        the page cache rather than the kernel's count.
+    :return: Mapping from the column name to a list with a value for each
+        inode. The columns are:
+
+        * ``inode``: address of the ``struct inode``.
+        * ``ino``: inode number.
+        * ``nrpages``: number of pages in the page cache (``i_mapping->nrpages``).
+        * ``page_entries`` (only if *page_cache* is true): number of pages or
+          folios found in the page cache.
+        * ``value_entries`` (only if *page_cache* is true): number of value
+          entries (e.g., shadow entries of evicted pages) found in the page
+          cache.
+    :rtype: dict[str, list[int]]
+    """
+    return _linux_helper_sb_inodes(sb, info=True, page_cache=page_cache)
+
+
 def mount_src(mnt):
     """
     .. c:function:: char *mount_src(struct mount *mnt)
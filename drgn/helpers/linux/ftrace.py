@@ -0,0 +1,153 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+"""
+Tracing
+-------
+
+The ``drgn.helpers.linux.ftrace`` module provides helpers for getting the
+events recorded in the Linux kernel tracing (ftrace) ring buffer, e.g., the
+last events before a crash.
+"""
+
+import types
+from typing import Any, Dict, List, Mapping, Optional, Tuple
+
+from _drgn import _linux_helper_ftrace_events
+from drgn import Object, PlatformFlags
+from drgn.helpers import memoize
+from drgn.helpers.linux.list import list_for_each_entry
+
+
+__all__ = (
+    "decode_ftrace_event",
+    "ftrace_event_formats",
+    "ftrace_events",
+)
+
+
+def ftrace_events(
+    prog, buffer: Optional[Object] = None
+) -> List[Tuple[int, int, int, bytes]]:
+    """
+    Get the events in a tracing ring buffer.
+
+    The buffer pages of all CPUs are read in bulk and decoded natively, so
+    this is fast even for very large buffers. Events which were already
+    consumed from ``trace_pipe`` and buffer pages which are not in the core
+    dump are skipped.
+
+    >>> for cpu, timestamp, type, data in ftrace_events(prog)[-2:]:
+    ...     print(cpu, timestamp, ftrace_event_formats(prog)[type][1])
+    ...
+    3 1048903528989 sched_switch
+    3 1048903531810 sys_enter
+
+    :param buffer: ``struct trace_buffer *`` (or ``struct ring_buffer *``
+        before Linux 5.6) object. Defaults to the buffer of the top-level
+        tracing instance.
+    :return: ``(cpu, timestamp, type, data)`` tuples sorted by timestamp,
+        where ``timestamp`` is in units of the trace clock (nanoseconds by
+        default), ``type`` is the event type (see
+        :func:`ftrace_event_formats()`), and ``data`` is the raw event record,
+        including the common fields.
+    """
+    byteorder = (
+        "little"
+        if prog.platform.flags & PlatformFlags.IS_LITTLE_ENDIAN
+        else "big"
+    )
+    return [
+        (cpu, timestamp, int.from_bytes(data[:2], byteorder), data)
+        for cpu, timestamp, data in _linux_helper_ftrace_events(prog, buffer)
+    ]
+
+
+def _ftrace_fields(head: Object) -> List[Tuple[str, str, int, int, bool]]:
+    return [
+        (
+            field.name.string_().decode(),
+            field.type.string_().decode(),
+            field.offset.value_(),
+            field.size.value_(),
+            bool(field.is_signed),
+        )
+        for field in list_for_each_entry("struct ftrace_event_field", head, "link")
+    ]
+
+
+@memoize
+def ftrace_event_formats(
+    prog,
+) -> Mapping[int, Tuple[str, str, List[Tuple[str, str, int, int, bool]]]]:
+    """
+    Get the formats of the trace events that the kernel knows about, as a
+    mapping from the event type to the format. This is read once and cached.
+
+    >>> ftrace_event_formats(prog)[316]
+    ('sched', 'sched_switch', [('common_type', 'unsigned short', 0, 2, False), ...])
+
+    :return: Mapping from event type to ``(system, name, fields)``, where
+        ``fields`` is a list of ``(name, type, offset, size, is_signed)``,
+        including the common fields.
+    """
+    try:
+        tracepoint_flag = prog["TRACE_EVENT_FL_TRACEPOINT"].value_()
+    except KeyError:
+        tracepoint_flag = 0
+    common_fields = _ftrace_fields(prog["ftrace_common_fields"].address_of_())
+    formats = {}
+    for call in list_for_each_entry(
+        "struct trace_event_call", prog["ftrace_events"].address_of_(), "list"
+    ):
+        if call.flags & tracepoint_flag:
+            name = call.tp.name
+        else:
+            name = call.name
+        system = call.member_("class").system
+        formats[call.event.type.value_()] = (
+            system.string_().decode() if system else "",
+            name.string_().decode(),
+            common_fields
+            + _ftrace_fields(call.member_("class").fields.address_of_()),
+        )
+
+    return types.MappingProxyType(formats)
+
+
+def decode_ftrace_event(prog, data: bytes) -> Dict[str, Any]:
+    """
+    Decode the fields of a raw event record returned by
+    :func:`ftrace_events()` using :func:`ftrace_event_formats()`.
+
+    >>> cpu, timestamp, type, data = ftrace_events(prog)[-2]
+    >>> fields = decode_ftrace_event(prog, data)
+    >>> fields["prev_pid"], fields["next_comm"]
+    (1, b'kworker/3:1\\x00\\x00\\x00\\x00\\x00')
+
+    :return: Mapping from field name to value. Integer fields are decoded as
+        :class:`int`. Other fields, including dynamic arrays (``__data_loc``),
+        are returned as :class:`bytes`.
+    """
+    byteorder = (
+        "little"
+        if prog.platform.flags & PlatformFlags.IS_LITTLE_ENDIAN
+        else "big"
+    )
+    type = int.from_bytes(data[:2], byteorder)
+    result: Dict[str, Any] = {}
+    for name, field_type, offset, size, is_signed in ftrace_event_formats(prog)[
+        type
+    ][2]:
+        value = data[offset : offset + size]
+        if field_type.startswith(("__data_loc", "__rel_loc")):
+            loc = int.from_bytes(value, byteorder)
+            start = loc & 0xFFFF
+            if field_type.startswith("__rel_loc"):
+                start += offset + size
+            result[name] = data[start : start + (loc >> 16)]
+        elif "[" not in field_type and size in (1, 2, 4, 8):
+            result[name] = int.from_bytes(value, byteorder, signed=is_signed)
+        else:
+            result[name] = value
+    return result
@@ -11,8 +11,7 @@ an ID to a pointer. This currently only supports Linux v4.11+; before this,
 IDRs were not based on radix trees.
 """
 
-from drgn.helpers.linux.radixtree import radix_tree_for_each, radix_tree_lookup
-from _drgn import _linux_helper_idr_find
+from _drgn import _linux_helper_idr_find, _linux_helper_idr_for_each
 
 
 __all__ = (
@@ -31,18 +30,17 @@ def idr_find(idr, id):
     return _linux_helper_idr_find(idr, id)
 
 
-def idr_for_each(idr):
+def idr_for_each(idr, type=None):
     """
     .. c:function:: idr_for_each(struct idr *idr)
 
     Iterate over all of the entries in an IDR.
 
+    :param idr: ``struct idr *`` object, or a ``struct idr`` reference.
+    :param type: If given, the entries are returned as this pointer type instead
+        of ``void *``.
+    :type type: str or Type
     :return: Iterator of (index, ``void *``) tuples.
     :rtype: Iterator[tuple[int, Object]]
     """
-    try:
-        base = idr.idr_base.value_()
-    except AttributeError:
-        base = 0
-    for index, entry in radix_tree_for_each(idr.idr_rt.address_of_()):
-        yield index + base, entry
+    return _linux_helper_idr_for_each(idr, type)
@@ -13,9 +13,12 @@ import gzip
 import types
 from typing import Mapping
 
+from drgn.helpers import memoize
+
 __all__ = ("get_kconfig",)
 
 
+@memoize
 def get_kconfig(prog) -> Mapping[str, str]:
     """
     Get the kernel build configuration as a mapping from the option name to the
@@ -29,11 +32,6 @@ def get_kconfig(prog) -> Mapping[str, str]:
     This is only supported if the kernel was compiled with ``CONFIG_IKCONFIG``.
     Note that most Linux distributions do not enable this option.
     """
-    try:
-        return prog.cache["kconfig_map"]
-    except KeyError:
-        pass
-
     try:
         start = prog.symbol("kernel_config_data").address
         size = prog.symbol("kernel_config_data_end").address - start
@@ -62,6 +60,4 @@ def get_kconfig(prog) -> Mapping[str, str]:
             kconfig[name] = value
 
     # Make result mapping 'immutable', so changes cannot propagate to the cache
-    result = types.MappingProxyType(kconfig)
-    prog.cache["kconfig_map"] = result
-    return result
+    return types.MappingProxyType(kconfig)
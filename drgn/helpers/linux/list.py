@@ -10,6 +10,12 @@ doubly-linked list implementations (``struct list_head`` and ``struct
 hlist_head``) in :linux:`include/linux/list.h`.
 """
 
+from _drgn import (
+    _linux_helper_hlist_for_each,
+    _linux_helper_hlist_for_each_entry,
+    _linux_helper_list_for_each,
+    _linux_helper_list_for_each_entry,
+)
 from drgn import NULL, container_of
 
 
@@ -118,11 +124,7 @@ def list_for_each(head):
 
     :return: Iterator of ``struct list_head *`` objects.
     """
-    head = head.read_()
-    pos = head.next.read_()
-    while pos != head:
-        yield pos
-        pos = pos.next.read_()
+    return _linux_helper_list_for_each(head)
 
 
 def list_for_each_reverse(head):
@@ -133,11 +135,7 @@ def list_for_each_reverse(head):
 
     :return: Iterator of ``struct list_head *`` objects.
     """
-    head = head.read_()
-    pos = head.prev.read_()
-    while pos != head:
-        yield pos
-        pos = pos.prev.read_()
+    return _linux_helper_list_for_each(head, reverse=True)
 
 
 def list_for_each_entry(type, head, member):
@@ -149,8 +147,7 @@ def list_for_each_entry(type, head, member):
 
     :return: Iterator of ``type *`` objects.
     """
-    for pos in list_for_each(head):
-        yield container_of(pos, type, member)
+    return _linux_helper_list_for_each_entry(type, head, member)
 
 
 def list_for_each_entry_reverse(type, head, member):
@@ -162,8 +159,7 @@ def list_for_each_entry_reverse(type, head, member):
 
     :return: Iterator of ``type *`` objects.
     """
-    for pos in list_for_each_reverse(head):
-        yield container_of(pos, type, member)
+    return _linux_helper_list_for_each_entry(type, head, member, reverse=True)
 
 
 def hlist_empty(head):
@@ -183,10 +179,7 @@ def hlist_for_each(head):
 
     :return: Iterator of ``struct hlist_node *`` objects.
     """
-    pos = head.first.read_()
-    while pos:
-        yield pos
-        pos = pos.next.read_()
+    return _linux_helper_hlist_for_each(head)
 
 
 def hlist_for_each_entry(type, head, member):
@@ -198,5 +191,4 @@ def hlist_for_each_entry(type, head, member):
 
     :return: Iterator of ``type *`` objects.
     """
-    for pos in hlist_for_each(head):
-        yield container_of(pos, type, member)
+    return _linux_helper_hlist_for_each_entry(type, head, member)
@@ -10,9 +10,20 @@ Linux memory management (MM) subsystem. Only x86-64 support is currently
 implemented.
 """
 
-from typing import List
-
-from _drgn import _linux_helper_read_vm, _linux_helper_pgtable_l5_enabled
+from array import array
+from typing import Any, Dict, List, Tuple
+
+from _drgn import (
+    _linux_helper_for_each_page,
+    _linux_helper_page_owner_stacks,
+    _linux_helper_page_pfns,
+    _linux_helper_pgtable_l5_enabled,
+    _linux_helper_read_vm,
+    _linux_helper_task_args,
+    _linux_helper_task_rss,
+    _linux_helper_vm_translation,
+    _linux_helper_vmalloc_areas,
+)
 from drgn import Object, cast
 
 
@@ -20,15 +31,23 @@ __all__ = (
     "access_process_vm",
     "access_remote_vm",
     "cmdline",
+    "compound_head",
     "environ",
     "for_each_page",
+    "page_owner_stacks",
+    "page_pfns",
     "page_to_pfn",
     "page_to_virt",
     "pfn_to_page",
     "pfn_to_virt",
     "pgtable_l5_enabled",
+    "task_args",
+    "task_rss",
     "virt_to_page",
     "virt_to_pfn",
+    "vm_translation",
+    "vmalloc_areas",
+    "vmalloc_callers",
 )
 
 
@@ -41,15 +60,66 @@ def pgtable_l5_enabled(prog):
     return _linux_helper_pgtable_l5_enabled(prog)
 
 
-def for_each_page(prog):
+def for_each_page(prog, flags=0):
     """
     Iterate over all pages in the system.
 
+    Parts of the memory map which are not populated (e.g., memory holes) are
+    skipped.
+
+    :param flags: If given, only return pages with all of these page flags set,
+        e.g., ``1 << prog["PG_slab"]``.
     :return: Iterator of ``struct page *`` objects.
     """
-    vmemmap = prog["vmemmap"]
-    for i in range(prog["max_pfn"]):
-        yield vmemmap + i
+    return _linux_helper_for_each_page(prog, flags)
+
+
+def page_pfns(prog, flags=0) -> array:
+    """
+    Get the page frame numbers (PFNs) of all pages in the system, or only of
+    the pages with all of the given page flags set. This is faster than
+    :func:`for_each_page()` when only the PFNs are needed.
+
+    >>> pfns = page_pfns(prog, 1 << prog["PG_slab"])
+    >>> len(pfns)
+    248721
+
+    :param flags: Page flags to filter by.
+    :return: Array of PFNs with type code ``"Q"``.
+    """
+    pfns = array("Q")
+    pfns.frombytes(_linux_helper_page_pfns(prog, flags))
+    return pfns
+
+
+def page_owner_stacks(prog) -> List[Tuple[int, Tuple[int, ...], int, int]]:
+    """
+    Get the stacks that allocated the pages which are currently allocated,
+    as recorded by ``page_owner``.
+
+    This requires the kernel to be built with ``CONFIG_PAGE_OWNER`` and booted
+    with ``page_owner=on``. The ``page_ext`` entries of the whole memory map
+    are read in bulk and decoded natively, and each distinct stack depot handle
+    is resolved once, so this is fast even with millions of pages.
+
+    >>> for handle, pcs, allocations, pages in page_owner_stacks(prog)[:1]:
+    ...     print(allocations, pages)
+    ...     for sym in prog.symbolize(pcs):
+    ...         print(sym.name if sym else "???")
+    ...
+    18342 18342
+    __alloc_pages
+    alloc_pages
+    ...
+
+    :return: List of ``(handle, pcs, allocations, pages)`` tuples sorted by
+        decreasing number of pages, where ``handle`` is the stack depot
+        handle of the allocation stack (0 if it wasn't saved), ``pcs`` is
+        the tuple of program counters of the stack, innermost first,
+        ``allocations`` is the number of allocations from the stack, and
+        ``pages`` is the total number of pages in those allocations.
+    """
+    return _linux_helper_page_owner_stacks(prog)
 
 
 def page_to_pfn(page):
@@ -128,7 +198,24 @@ def virt_to_page(prog_or_addr, addr=None):
     return pfn_to_page(virt_to_pfn(prog_or_addr, addr))
 
 
-def access_process_vm(task, address, size) -> bytes:
+def compound_head(page):
+    """
+    .. c:function:: struct page *compound_head(struct page *page)
+
+    Get the head page of a compound page. A page which is not a tail page is
+    its own head.
+    """
+    try:
+        head = page.compound_head.value_()
+    except AttributeError:
+        # Kernels before 4.6 mark tail pages differently; treat them as heads.
+        return page
+    if head & 1:
+        return Object(page.prog_, page.type_, value=head - 1)
+    return page
+
+
+def access_process_vm(task, address, size, translation=None) -> bytes:
     """
     .. c:function:: char *access_process_vm(struct task_struct *task, void *address, size_t size)
 
@@ -137,11 +224,17 @@ def access_process_vm(task, address, size) -> bytes:
     >>> task = find_task(prog, 1490152)
     >>> access_process_vm(task, 0x7f8a62b56da0, 12)
     b'hello, world'
+
+    :param translation: Translations of the task's ``mm_struct`` from
+        :func:`vm_translation()` to use and add to. By default, the page table
+        is walked for every read.
     """
+    if translation is not None:
+        return translation.read(address, size)
     return _linux_helper_read_vm(task.prog_, task.mm.pgd, address, size)
 
 
-def access_remote_vm(mm, address, size) -> bytes:
+def access_remote_vm(mm, address, size, translation=None) -> bytes:
     """
     .. c:function:: char *access_remote_vm(struct mm_struct *mm, void *address, size_t size)
 
@@ -152,11 +245,43 @@ def access_remote_vm(mm, address, size) -> bytes:
     >>> task = find_task(prog, 1490152)
     >>> access_remote_vm(task.mm, 0x7f8a62b56da0, 12)
     b'hello, world'
+
+    :param translation: See :func:`access_process_vm()`.
     """
+    if translation is not None:
+        return translation.read(address, size)
     return _linux_helper_read_vm(mm.prog_, mm.pgd, address, size)
 
 
-def cmdline(task) -> List[bytes]:
+def vm_translation(mm):
+    """
+    Create a cache of the address translations of a virtual address space.
+
+    Reading from many places in a process with :func:`access_remote_vm()`
+    walks the page table for every read. The returned object keeps the
+    translations instead. Its ``read(address, size)`` method is like
+    :func:`access_remote_vm()`, and its ``fill(address, size)`` method
+    translates a whole range (e.g., a VMA) in one walk of the page table.
+
+    The translations are never discarded, so for a running kernel, the object
+    should only be kept for as long as the page table is not expected to
+    change.
+
+    >>> task = find_task(prog, 1495216)
+    >>> translation = vm_translation(task.mm)
+    >>> start = task.mm.arg_start.value_()
+    >>> translation.fill(start, task.mm.env_end.value_() - start)
+    >>> cmdline(task, translation)
+    [b'vim', b'drgn/helpers/linux/mm.py']
+    >>> environ(task, translation)
+    [b'HOME=/root', b'PATH=/usr/local/sbin:/usr/local/bin:/usr/bin']
+
+    :param mm: ``struct mm_struct *``
+    """
+    return _linux_helper_vm_translation(mm.prog_, mm.pgd)
+
+
+def cmdline(task, translation=None) -> List[bytes]:
     """
     Get the list of command line arguments of a task.
 
@@ -167,14 +292,17 @@ def cmdline(task) -> List[bytes]:
 
         $ tr '\\0' ' ' < /proc/1495216/cmdline
         vim drgn/helpers/linux/mm.py
+
+    :param translation: See :func:`access_process_vm()`.
     """
     mm = task.mm.read_()
     arg_start = mm.arg_start.value_()
     arg_end = mm.arg_end.value_()
-    return access_remote_vm(mm, arg_start, arg_end - arg_start).split(b"\0")[:-1]
+    data = access_remote_vm(mm, arg_start, arg_end - arg_start, translation)
+    return data.split(b"\0")[:-1]
 
 
-def environ(task) -> List[bytes]:
+def environ(task, translation=None) -> List[bytes]:
     """
     Get the list of environment variables of a task.
 
@@ -187,8 +315,152 @@ def environ(task) -> List[bytes]:
         HOME=/root
         PATH=/usr/local/sbin:/usr/local/bin:/usr/bin
         LOGNAME=root
+
+    :param translation: See :func:`access_process_vm()`.
     """
     mm = task.mm.read_()
     env_start = mm.env_start.value_()
     env_end = mm.env_end.value_()
-    return access_remote_vm(mm, env_start, env_end - env_start).split(b"\0")[:-1]
+    data = access_remote_vm(mm, env_start, env_end - env_start, translation)
+    return data.split(b"\0")[:-1]
+
+
+def task_args(prog_or_ns, tasks=None, *, cmdline=True, environ=True):
+    """
+    Get the command line arguments and/or environment variables of many tasks.
+
+    This is equivalent to calling :func:`cmdline()` and :func:`environ()` for
+    each task, but much faster for a large number of tasks: the ``mm`` of each
+    task is read in batches, threads sharing an ``mm`` are only read once, and
+    the page table of each ``mm`` is walked only once for both.
+
+    >>> for task, args, _ in task_args(prog, environ=False):
+    ...     print(task.pid.value_(), args)
+    ...
+    1 [b'/sbin/init']
+    2 None
+    ...
+
+    :param prog_or_ns: ``struct pid_namespace *`` object or :class:`Program`
+        (in which case its initial PID namespace is used).
+    :param tasks: ``struct task_struct *`` objects to read. If ``None``, every
+        task in the PID namespace is read.
+    :param cmdline: Whether to get the command line arguments.
+    :param environ: Whether to get the environment variables.
+    :return: List of ``(task, cmdline, environ)`` tuples, one per task, where
+        ``cmdline`` and ``environ`` are lists like :func:`cmdline()` and
+        :func:`environ()` return. They are ``None`` if they were not requested,
+        the task has no ``mm`` (e.g., kernel threads), or the memory could not
+        be read (e.g., it is not in the core dump).
+    :rtype: list[tuple[Object, Optional[list[bytes]], Optional[list[bytes]]]]
+    """
+    return [
+        (
+            task,
+            None if args is None else args.split(b"\0")[:-1],
+            None if env is None else env.split(b"\0")[:-1],
+        )
+        for task, args, env in _linux_helper_task_args(
+            prog_or_ns, tasks, cmdline=cmdline, environ=environ
+        )
+    ]
+
+
+def task_rss(prog_or_ns) -> Dict[str, array]:
+    """
+    Get the exact resident set size (RSS) of every task.
+
+    The RSS that the kernel reports (e.g., in ``/proc/pid/statm``) is
+    approximate: it leaves out the changes that haven't been folded into the
+    counters of the ``mm`` yet. Since Linux 6.2, those are per-CPU counts,
+    and before that, they are cached by each thread. This includes them. Each
+    ``mm`` is read once, no matter how many threads share it, and the per-CPU
+    counts of every ``mm`` are read in large batches, so this is fast even for
+    hundreds of thousands of tasks.
+
+    >>> table = task_rss(prog)
+    >>> top = sorted(range(len(table["task"])), key=table["rss"].__getitem__)
+    >>> for i in top[-2:]:
+    ...     task = Object(prog, "struct task_struct *", table["task"][i])
+    ...     print(task.comm.string_().decode(), table["rss"][i])
+    ...
+    mysqld 981233
+    java 1630412
+
+    :param prog_or_ns: ``struct pid_namespace *`` object or :class:`Program`
+        (in which case its initial PID namespace is used).
+    :return: Mapping from the column name to an array with type code ``"Q"``
+        with a value for each task. Threads sharing an ``mm`` all have the
+        same values. The columns are:
+
+        * ``task``: address of the ``struct task_struct``.
+        * ``mm``: address of the ``struct mm_struct``, or 0 for kernel
+          threads.
+        * ``file``: resident file pages.
+        * ``anon``: resident anonymous pages.
+        * ``shmem``: resident shared memory pages (0 before Linux 4.5).
+        * ``rss``: total resident pages.
+    """
+    return {
+        name: _uint64_array(data)
+        for name, data in _linux_helper_task_rss(prog_or_ns).items()
+    }
+
+
+def vmalloc_areas(prog) -> Dict[str, List[Any]]:
+    """
+    Get a table of every vmalloc area.
+
+    This is the information in ``/proc/vmallocinfo``. The busy tree of
+    ``struct vmap_area`` is walked natively (including the per-node trees
+    since Linux 6.9), each area and its ``struct vm_struct`` are read in
+    batches, and the callers are symbolized in bulk.
+
+    >>> table = vmalloc_areas(prog)
+    >>> sum(table["pages"])
+    41235
+
+    :return: Mapping from the column name to a list with a value for each
+        area, sorted by address. The columns are:
+
+        * ``address``: start address of the area.
+        * ``size``: size of the area in bytes, including the guard page if
+          it has one.
+        * ``caller``: address of the code that created the area, or 0 if
+          the area is not in use by a ``struct vm_struct``.
+        * ``symbol``: name of the caller, or ``None`` if it is not known.
+        * ``pages``: number of pages allocated by ``vmalloc()`` for the area.
+        * ``vm``: address of the ``struct vm_struct``, or 0 if there isn't
+          one (e.g., for ``vm_map_ram()`` areas).
+        * ``flags``: ``VM_*`` flags of the ``struct vm_struct``.
+    """
+    return _linux_helper_vmalloc_areas(prog)
+
+
+def vmalloc_callers(prog) -> Dict[str, List[Any]]:
+    """
+    Get the vmalloc usage of every caller, like :func:`vmalloc_areas()`
+    aggregated by the ``caller`` column, but without building a row for each
+    area.
+
+    >>> table = vmalloc_callers(prog)
+    >>> list(zip(table["symbol"], table["pages"]))[:2]
+    [('module_alloc', 8841), ('alloc_large_system_hash', 6160)]
+
+    :return: Mapping from the column name to a list with a value for each
+        caller, sorted by decreasing size. The columns are:
+
+        * ``caller``: address of the caller. Areas without a ``struct
+          vm_struct`` are counted under caller 0.
+        * ``symbol``: name of the caller, or ``None`` if it is not known.
+        * ``areas``: number of areas created by the caller.
+        * ``size``: total size of the areas in bytes.
+        * ``pages``: total number of pages allocated for the areas.
+    """
+    return _linux_helper_vmalloc_areas(prog, by_caller=True)
+
+
+def _uint64_array(data: bytes) -> array:
+    ret = array("Q")
+    ret.frombytes(data)
+    return ret
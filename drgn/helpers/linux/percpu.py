@@ -10,13 +10,18 @@ per-CPU allocations from :linux:`include/linux/percpu.h` and per-CPU counters
 from :linux:`include/linux/percpu_counter.h`.
 """
 
-from drgn import Object
-from drgn.helpers.linux.cpumask import for_each_online_cpu
+from _drgn import (
+    _linux_helper_per_cpu_ptr,
+    _linux_helper_per_cpu_ptrs,
+    _linux_helper_percpu_sum,
+)
 
 
 __all__ = (
     "per_cpu_ptr",
+    "per_cpu_ptrs",
     "percpu_counter_sum",
+    "percpu_sum",
 )
 
 
@@ -26,8 +31,32 @@ def per_cpu_ptr(ptr, cpu):
 
     Return the per-CPU pointer for a given CPU.
     """
-    offset = ptr.prog_["__per_cpu_offset"][cpu].value_()
-    return Object(ptr.prog_, ptr.type_, value=ptr.value_() + offset)
+    return _linux_helper_per_cpu_ptr(ptr, cpu)
+
+
+def per_cpu_ptrs(ptr, mask=None):
+    """
+    .. c:function:: dict per_cpu_ptrs(type __percpu *ptr, struct cpumask *mask)
+
+    Return a dictionary mapping each CPU in a CPU mask to the per-CPU pointer
+    for that CPU. The per-CPU offsets and the mask are each read only once.
+
+    :param mask: ``struct cpumask *`` or ``struct cpumask``. If omitted or
+        ``None``, the online CPU mask is used.
+    """
+    return _linux_helper_per_cpu_ptrs(ptr, mask)
+
+
+def percpu_sum(ptr, mask=None):
+    """
+    .. c:function:: s64 percpu_sum(type __percpu *ptr, struct cpumask *mask)
+
+    Return the sum of a per-CPU integer over each CPU in a CPU mask.
+
+    :param ptr: Per-CPU pointer to an integer type.
+    :param mask: See :func:`per_cpu_ptrs()`.
+    """
+    return _linux_helper_percpu_sum(ptr, mask)
 
 
 def percpu_counter_sum(fbc):
@@ -36,8 +65,4 @@ def percpu_counter_sum(fbc):
 
     Return the sum of a per-CPU counter.
     """
-    ret = fbc.count.value_()
-    ptr = fbc.counters
-    for cpu in for_each_online_cpu(fbc.prog_):
-        ret += per_cpu_ptr(ptr, cpu)[0].value_()
-    return ret
+    return fbc.count.value_() + percpu_sum(fbc.counters)
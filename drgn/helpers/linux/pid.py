@@ -9,16 +9,18 @@ The ``drgn.helpers.linux.pid`` module provides helpers for looking up process
 IDs and processes.
 """
 
-from drgn import NULL, Program, cast, container_of
-from drgn.helpers.linux.idr import idr_find, idr_for_each
-from drgn.helpers.linux.list import hlist_for_each_entry
 from _drgn import (
+    _linux_helper_cache_pids,
     _linux_helper_find_pid,
+    _linux_helper_filter_tasks,
     _linux_helper_find_task,
+    _linux_helper_for_each_pid,
+    _linux_helper_for_each_task,
     _linux_helper_pid_task,
 )
 
 __all__ = (
+    "cache_pids",
     "find_pid",
     "find_task",
     "for_each_pid",
@@ -27,6 +29,21 @@ __all__ = (
 )
 
 
+def cache_pids(prog_or_ns):
+    """
+    Cache every PID in the given namespace (or the initial PID namespace if
+    given a :class:`Program`) so that later calls to :func:`find_pid()` and
+    :func:`find_task()` for it are dictionary lookups instead of walks of the
+    kernel's PID structures. This is worthwhile when looking up many PIDs,
+    e.g., to join other data by PID.
+
+    The cache is discarded by :meth:`Program.invalidate_memory_cache()`. For a
+    core dump, it never becomes stale. For a live kernel, call this again
+    after invalidating the memory cache to refresh it.
+    """
+    _linux_helper_cache_pids(prog_or_ns)
+
+
 def find_pid(prog_or_ns, nr):
     """
     .. c:function:: struct pid *find_pid(struct pid_namespace *ns, int nr)
@@ -47,23 +64,7 @@ def for_each_pid(prog_or_ns):
 
     :return: Iterator of ``struct pid *`` objects.
     """
-    if isinstance(prog_or_ns, Program):
-        prog = prog_or_ns
-        ns = prog_or_ns["init_pid_ns"].address_of_()
-    else:
-        prog = prog_or_ns.prog_
-        ns = prog_or_ns
-    if hasattr(ns, "idr"):
-        for nr, entry in idr_for_each(ns.idr):
-            yield cast("struct pid *", entry)
-    else:
-        pid_hash = prog["pid_hash"]
-        for i in range(1 << prog["pidhash_shift"].value_()):
-            for upid in hlist_for_each_entry(
-                "struct upid", pid_hash[i].address_of_(), "pid_chain"
-            ):
-                if upid.ns == ns:
-                    yield container_of(upid, "struct pid", f"numbers[{int(ns.level)}]")
+    return _linux_helper_for_each_pid(prog_or_ns)
 
 
 def pid_task(pid, pid_type):
@@ -86,21 +87,56 @@ def find_task(prog_or_ns, pid):
     return _linux_helper_find_task(prog_or_ns, pid)
 
 
-def for_each_task(prog_or_ns):
+def _task_id_ranges(ids):
+    if isinstance(ids, (int, range)):
+        ids = (ids,)
+    ranges = []
+    for id in ids:
+        if isinstance(id, range):
+            if id.step != 1:
+                raise ValueError("ID range step must be 1")
+            if id:
+                ranges.append((id.start, id.stop - 1))
+        else:
+            ranges.append((id, id))
+    return ranges
+
+
+def for_each_task(prog_or_ns, *, state=None, comm=None, pid=None, tgid=None):
     """
     .. c:function:: for_each_task(struct pid_namespace *ns)
 
     Iterate over all of the tasks visible in the given namespace. If given a
     :class:`Program` instead, the initial PID namespace is used.
 
+    The tasks can be filtered by the following keyword arguments. The filters
+    are evaluated without creating an object for every task, so this is much
+    faster than filtering the tasks in Python.
+
+    :param state: Only include tasks with one of these state characters (see
+        :func:`~drgn.helpers.linux.sched.task_state_to_char()`), e.g.,
+        ``"D"`` or ``("R", "D")``.
+    :param comm: Only include tasks whose command name matches this shell
+        wildcard pattern, e.g., ``"kworker/*"``.
+    :param pid: Only include tasks whose ``task->pid`` (the thread ID in the
+        initial namespace) is this ``int``, in this :class:`range`, or in an
+        iterable of those.
+    :param tgid: Like *pid*, but for ``task->tgid`` (the process ID).
     :return: Iterator of ``struct task_struct *`` objects.
     """
-    if isinstance(prog_or_ns, Program):
-        prog = prog_or_ns
-    else:
-        prog = prog_or_ns.prog_
-    PIDTYPE_PID = prog["PIDTYPE_PID"].value_()
-    for pid in for_each_pid(prog_or_ns):
-        task = pid_task(pid, PIDTYPE_PID)
-        if task:
-            yield task
+    if state is None and comm is None and pid is None and tgid is None:
+        return _linux_helper_for_each_task(prog_or_ns)
+    pids = None if pid is None else _task_id_ranges(pid)
+    tgids = None if tgid is None else _task_id_ranges(tgid)
+    # An empty list of ranges matches nothing, but libdrgn ignores it.
+    if pids == [] or tgids == []:
+        return iter(())
+    return iter(
+        _linux_helper_filter_tasks(
+            prog_or_ns,
+            state=None if state is None else "".join(state),
+            comm=comm,
+            pids=pids,
+            tgids=tgids,
+        )
+    )
@@ -9,6 +9,11 @@ The ``drgn.helpers.linux.rbtree`` module provides helpers for working with
 red-black trees from :linux:`include/linux/rbtree.h`.
 """
 
+from _drgn import (
+    _linux_helper_rb_find,
+    _linux_helper_rbtree_inorder_for_each,
+    _linux_helper_rbtree_inorder_for_each_entry,
+)
 from drgn import Object, NULL, container_of
 
 
@@ -142,14 +147,7 @@ def rbtree_inorder_for_each(root):
 
     :return: Iterator of ``struct rb_node *`` objects.
     """
-
-    def aux(node):
-        if node:
-            yield from aux(node.rb_left.read_())
-            yield node
-            yield from aux(node.rb_right.read_())
-
-    yield from aux(root.rb_node.read_())
+    return _linux_helper_rbtree_inorder_for_each(root)
 
 
 def rbtree_inorder_for_each_entry(type, root, member):
@@ -162,8 +160,7 @@ def rbtree_inorder_for_each_entry(type, root, member):
 
     :return: Iterator of ``type *`` objects.
     """
-    for node in rbtree_inorder_for_each(root):
-        yield container_of(node, type, member)
+    return _linux_helper_rbtree_inorder_for_each_entry(type, root, member)
 
 
 def rb_find(type, root, member, key, cmp):
@@ -176,9 +173,18 @@ def rb_find(type, root, member, key, cmp):
     matches the entry. This returns a ``NULL`` object if no entry matches the
     key.
 
+    If the tree is sorted in ascending order by an integer member of the
+    entry, *cmp* may instead be the name of that member, and *key* must be an
+    integer. The search is then done without calling back into Python for
+    each node:
+
+    >>> rb_find("struct vmap_area", root, "rb_node", addr, "va_start")
+
     Note that this function does not have an analogue in the Linux kernel
     source code, as tree searches are all open-coded.
     """
+    if isinstance(cmp, str):
+        return _linux_helper_rb_find(type, root, member, key, cmp)
     node = root.rb_node.read_()
     while node:
         entry = container_of(node, type, member)
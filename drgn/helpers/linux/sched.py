@@ -9,10 +9,20 @@ The ``drgn.helpers.linux.sched`` module provides helpers for working with the
 Linux CPU scheduler.
 """
 
-from _drgn import _linux_helper_task_state_to_char
+from typing import Any, Dict, List, Tuple
 
+from _drgn import (
+    _linux_helper_runqueues,
+    _linux_helper_task_snapshot,
+    _linux_helper_task_state_to_char,
+)
 
-__all__ = ("task_state_to_char",)
+
+__all__ = (
+    "runqueue_snapshot",
+    "task_snapshot",
+    "task_state_to_char",
+)
 
 
 def task_state_to_char(task):
@@ -27,3 +37,90 @@ def task_state_to_char(task):
     :rtype: str
     """
     return _linux_helper_task_state_to_char(task)
+
+
+def task_snapshot(
+    prog_or_ns, fields=("pid", "tgid", "comm", "state", "utime", "stime", "rss")
+):
+    """
+    Get a snapshot of selected fields of every task in a PID namespace.
+
+    This is much faster than iterating over :func:`for_each_task()
+    <drgn.helpers.linux.pid.for_each_task>` and reading each member
+    individually: the needed members of each task are read with a small number
+    of batched memory reads.
+
+    The available fields are:
+
+    * ``"task"``: the ``struct task_struct *`` itself
+    * ``"pid"``, ``"tgid"``, ``"utime"``, ``"stime"``: the members of the same
+      name, as ``int``
+    * ``"comm"``: the task's command name, as ``bytes``
+    * ``"state"``: the task's state character (see
+      :func:`task_state_to_char()`), as ``str``
+    * ``"rss"``: the resident set size of the task's ``struct mm_struct`` in
+      pages, as ``int`` (0 for kernel threads)
+
+    >>> task_snapshot(prog, ("pid", "comm"))[:2]
+    [(0, b'swapper/0'), (1, b'systemd')]
+
+    :param prog_or_ns: ``struct pid_namespace *`` object, or :class:`Program`
+        to use initial PID namespace.
+    :param fields: Names of the fields to get for each task.
+    :return: List of tuples containing the requested fields in the given order,
+        one per task.
+    :rtype: list[tuple]
+    """
+    return _linux_helper_task_snapshot(prog_or_ns, fields)
+
+
+def runqueue_snapshot(prog) -> Tuple[Dict[str, List[Any]], Dict[str, List[Any]]]:
+    """
+    Get a snapshot of the runqueue of every online CPU.
+
+    Each ``struct rq`` is read in one read, and the CFS, real-time, and
+    deadline runqueues are walked natively, including the runqueues of task
+    groups, so this is much faster than walking them with
+    :func:`~drgn.helpers.linux.rbtree.rbtree_inorder_for_each_entry()` and
+    :func:`~drgn.helpers.linux.list.list_for_each_entry()`. On a live kernel,
+    the runqueues change while they are being read, so the snapshot is only
+    approximate.
+
+    >>> cpus, tasks = runqueue_snapshot(prog)
+    >>> cpus["nr_running"]
+    [1, 3, 0, 1]
+    >>> [hex(task) for cpu, task in zip(tasks["cpu"], tasks["task"]) if cpu == 1]
+    ['0xffff8f4cc3b1a580', '0xffff8f4cc2a9d280', '0xffff8f4cc0f32f00']
+
+    :return: Tuple of two mappings from a column name to a list with a value
+        for each row. The first has a row for each CPU, with the columns:
+
+        * ``cpu``: CPU number.
+        * ``rq``: address of the CPU's ``struct rq``.
+        * ``curr``: address of the ``struct task_struct`` running on the CPU.
+        * ``nr_running``, ``cfs_nr_running``, ``rt_nr_running``,
+          ``dl_nr_running``: number of runnable tasks in total and in each
+          scheduling class.
+        * ``cfs_load_weight``: total load weight of the CFS runqueue.
+        * ``cfs_load_avg``: average load of the CFS runqueue, or 0 if the
+          kernel doesn't track it.
+        * ``clock``: runqueue clock, in nanoseconds.
+
+        The second has a row for each task on a runqueue, grouped by CPU. For
+        each CPU, the CFS tasks are first, in virtual runtime order except that
+        the running task comes before the queued tasks of its runqueue,
+        followed by the real-time tasks in priority order and the deadline
+        tasks in deadline order. If the running task is not on any of these runqueues (e.g., it
+        is the idle task), it is last. The columns are:
+
+        * ``cpu``: CPU number.
+        * ``task``: address of the ``struct task_struct``.
+        * ``class``: scheduling class: ``"fair"``, ``"rt"``, ``"dl"``,
+          ``"idle"``, ``"stop"``, or ``"other"``.
+        * ``prio``: priority of the task (``task->prio``).
+        * ``vruntime``: virtual runtime for CFS tasks, otherwise ``None``.
+        * ``deadline``: absolute deadline for deadline tasks, otherwise
+          ``None``.
+        * ``current``: whether the task is running on the CPU.
+    """
+    return _linux_helper_runqueues(prog)
@@ -0,0 +1,99 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+"""
+Slab Allocator
+--------------
+
+The ``drgn.helpers.linux.slab`` module provides helpers for working with the
+Linux slab allocator. Only SLUB is currently supported.
+"""
+
+from _drgn import _linux_helper_slab_cache_for_each_allocated_object
+from drgn import FaultError, NULL, Object, cast
+from drgn.helpers.linux.list import list_for_each_entry
+from drgn.helpers.linux.mm import compound_head, virt_to_page
+
+__all__ = (
+    "find_containing_slab_cache",
+    "find_slab_cache",
+    "for_each_slab_cache",
+    "slab_cache_for_each_allocated_object",
+)
+
+
+def for_each_slab_cache(prog):
+    """
+    Iterate over all slab caches.
+
+    :return: Iterator of ``struct kmem_cache *`` objects.
+    """
+    return list_for_each_entry(
+        "struct kmem_cache", prog["slab_caches"].address_of_(), "list"
+    )
+
+
+def find_slab_cache(prog, name):
+    """
+    Return the slab cache with the given name.
+
+    :param name: Slab cache name (e.g., ``b"kmalloc-256"``).
+    :type name: str or bytes
+    :return: ``struct kmem_cache *``, or ``None`` if not found.
+    """
+    if isinstance(name, str):
+        name = name.encode()
+    for s in for_each_slab_cache(prog):
+        if s.name.string_() == name:
+            return s
+    return None
+
+
+def find_containing_slab_cache(prog, addr):
+    """
+    Get the slab cache that an address was allocated from.
+
+    >>> find_containing_slab_cache(prog, 0xffff905e41404000).name
+    (const char *)0xffffffffbd8e1bb3 = "dentry"
+
+    :param addr: ``void *``
+    :type addr: Object or int
+    :return: ``struct kmem_cache *``, or a ``NULL`` pointer if the address is
+        not directly mapped or is not in a slab.
+    """
+    if isinstance(addr, Object):
+        addr = addr.value_()
+    page_offset = prog["PAGE_OFFSET"].value_()
+    if not page_offset <= addr < page_offset + (prog["max_pfn"].value_() << 12):
+        return NULL(prog, "struct kmem_cache *")
+    try:
+        page = compound_head(virt_to_page(prog, addr))
+        if not page.flags.value_() & (1 << prog["PG_slab"].value_()):
+            return NULL(prog, "struct kmem_cache *")
+        return cast("struct kmem_cache *", page.slab_cache.read_())
+    except FaultError:
+        return NULL(prog, "struct kmem_cache *")
+
+
+def slab_cache_for_each_allocated_object(slab_cache, type, cpu_freelists=True):
+    """
+    Iterate over all allocated objects in a slab cache.
+
+    Every slab of the cache is read once, and the free objects are computed by
+    walking its freelist.
+
+    >>> dentry_cache = find_slab_cache(prog, "dentry")
+    >>> next(slab_cache_for_each_allocated_object(dentry_cache, "struct dentry"))
+    (struct dentry *)0xffff905e41404000
+
+    :param slab_cache: ``struct kmem_cache *``
+    :param type: Type of the objects in the cache.
+    :type type: str or Type
+    :param cpu_freelists: Whether to also exclude objects on the per-CPU
+        freelists. These are only accurate if the kernel is not running (e.g.,
+        for a core dump).
+    :return: Iterator of ``type *`` objects.
+    """
+    return _linux_helper_slab_cache_for_each_allocated_object(
+        slab_cache, type, cpu_freelists
+    )
@@ -9,9 +9,16 @@ The ``drgn.helpers.linux.tcp`` module provides helpers for working with the TCP
 protocol in the Linux kernel.
 """
 
-from drgn import cast
+from typing import Any, Dict, Iterator, List
 
-__all__ = ("sk_tcpstate",)
+from _drgn import _linux_helper_sock_table
+from drgn import Object, cast
+
+__all__ = (
+    "sk_tcpstate",
+    "tcp_for_each_sock",
+    "tcp_sock_table",
+)
 
 
 def sk_tcpstate(sk):
@@ -21,3 +28,50 @@ def sk_tcpstate(sk):
     Return the TCP protocol state of a socket.
     """
     return cast(sk.prog_["TCP_ESTABLISHED"].type_, sk.__sk_common.skc_state)
+
+
+def tcp_for_each_sock(prog) -> Iterator[Object]:
+    """
+    Iterate over all TCP sockets: listening sockets, established sockets,
+    and time-wait and request sockets (which are not full ``struct sock``\\ s;
+    see :func:`~drgn.helpers.linux.net.sk_fullsock()`).
+
+    The hash bucket arrays of ``tcp_hashinfo`` are read in bulk and walked
+    natively, which is much faster than iterating over the buckets in Python.
+
+    :return: Iterator of ``struct sock *`` objects.
+    """
+    return iter(_linux_helper_sock_table(prog))
+
+
+def tcp_sock_table(prog) -> Dict[str, List[Any]]:
+    """
+    Get a table of the connection information of all TCP sockets.
+
+    This is like reading the members of each socket from
+    :func:`tcp_for_each_sock()`, but each socket is read once natively and no
+    objects are created, so it scales to millions of sockets.
+
+    >>> import ipaddress
+    >>> table = tcp_sock_table(prog)
+    >>> for saddr, sport in zip(table["saddr"], table["sport"]):
+    ...     print(ipaddress.ip_address(saddr), sport)
+    ...
+    127.0.0.1 631
+    ::1 631
+    ...
+
+    :return: Mapping from the column name to a list with a value for each
+        socket. The columns are:
+
+        * ``sock``: address of the ``struct sock``.
+        * ``family``: address family (e.g., ``socket.AF_INET``).
+        * ``state``: TCP state (e.g., ``prog["TCP_ESTABLISHED"]``).
+        * ``saddr``, ``daddr``: local and remote addresses as 4 (IPv4) or
+          16 (IPv6) :class:`bytes` in network byte order, or empty for
+          other families.
+        * ``sport``, ``dport``: local and remote ports.
+        * ``cgroup``: address of the ``struct cgroup`` of the socket, or 0
+          if it is not known (e.g., for time-wait sockets).
+    """
+    return _linux_helper_sock_table(prog, info=True)
@@ -0,0 +1,54 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+"""
+Timers
+------
+
+The ``drgn.helpers.linux.timer`` module provides helpers for working with
+kernel timers: timer lists (``struct timer_list``) in the timer wheel and
+high-resolution timers (``struct hrtimer``).
+"""
+
+from typing import Any, Dict, List
+
+from _drgn import _linux_helper_pending_timers
+
+__all__ = ("pending_timers",)
+
+
+def pending_timers(prog) -> Dict[str, List[Any]]:
+    """
+    Get a table of every pending timer on every online CPU.
+
+    The timer wheel buckets of ``timer_bases`` and the red-black trees of
+    ``hrtimer_bases`` are walked natively, each timer is read once, and the
+    callbacks are symbolized in bulk, so this is fast even on machines with
+    many CPUs and timers. This requires Linux 4.8 or newer.
+
+    >>> from collections import Counter
+    >>> table = pending_timers(prog)
+    >>> Counter(table["symbol"]).most_common(3)
+    [('hrtimer_wakeup', 112), ('delayed_work_timer_fn', 58), ('tcp_keepalive_timer', 9)]
+
+    :return: Mapping from the column name to a list with a value for each
+        timer. Timers are grouped by CPU, with the timer lists of each CPU
+        before its hrtimers. The columns are:
+
+        * ``timer``: address of the ``struct timer_list`` or ``struct
+          hrtimer``.
+        * ``type``: ``"timer_list"`` or ``"hrtimer"``.
+        * ``cpu``: CPU that the timer is queued on.
+        * ``base``: index of the timer base (e.g., ``prog["BASE_STD"]``) for
+          timer lists, or of the clock base (e.g.,
+          ``prog["HRTIMER_BASE_MONOTONIC"]``) for hrtimers.
+        * ``expires``: expiry time, in jiffies for timer lists or in
+          nanoseconds of the clock base's clock for hrtimers.
+        * ``function``: address of the callback.
+        * ``symbol``: name of the callback, or ``None`` if it is not known.
+        * ``owner``: for well-known callbacks, the address of the object
+          waiting for the timer: the ``struct task_struct`` for
+          ``hrtimer_wakeup()`` and ``process_timeout()``, or the ``struct
+          delayed_work`` for ``delayed_work_timer_fn()``. Otherwise, 0.
+    """
+    return _linux_helper_pending_timers(prog)
@@ -0,0 +1,37 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+"""
+UDP
+---
+
+The ``drgn.helpers.linux.udp`` module provides helpers for working with the UDP
+protocol in the Linux kernel.
+"""
+
+from typing import Any, Dict, Iterator, List
+
+from _drgn import _linux_helper_sock_table
+from drgn import Object
+
+__all__ = (
+    "udp_for_each_sock",
+    "udp_sock_table",
+)
+
+
+def udp_for_each_sock(prog) -> Iterator[Object]:
+    """
+    Iterate over all UDP sockets in ``udp_table``.
+
+    :return: Iterator of ``struct sock *`` objects.
+    """
+    return iter(_linux_helper_sock_table(prog, udp=True))
+
+
+def udp_sock_table(prog) -> Dict[str, List[Any]]:
+    """
+    Get a table of the connection information of all UDP sockets. See
+    :func:`~drgn.helpers.linux.tcp.tcp_sock_table()` for the columns.
+    """
+    return _linux_helper_sock_table(prog, udp=True, info=True)
@@ -12,6 +12,7 @@ in the Linux kernel.
 import operator
 
 from drgn import NULL, Object
+from drgn.helpers import memoize
 from drgn.helpers.linux.list import hlist_for_each_entry
 
 __all__ = (
@@ -26,6 +27,20 @@ def _kuid_val(uid):
     return operator.index(uid)
 
 
+@memoize
+def _uidhashentry(prog):
+    uidhash_table = prog["uidhash_table"]
+    uidhash_sz = len(uidhash_table)
+    uidhash_bits = uidhash_sz.bit_length() - 1
+    uidhash_mask = uidhash_sz - 1
+
+    def uidhashentry(uid):
+        hash = ((uid >> uidhash_bits) + uid) & uidhash_mask
+        return uidhash_table + hash
+
+    return uidhashentry
+
+
 def find_user(prog, uid):
     """
     .. c:function:: struct user_struct *find_user(kuid_t uid)
@@ -33,23 +48,9 @@ def find_user(prog, uid):
     Return the user structure with the given UID, which may be a ``kuid_t`` or
     an integer.
     """
-    try:
-        uidhashentry = prog.cache["uidhashentry"]
-    except KeyError:
-        uidhash_table = prog["uidhash_table"]
-        uidhash_sz = len(uidhash_table)
-        uidhash_bits = uidhash_sz.bit_length() - 1
-        uidhash_mask = uidhash_sz - 1
-
-        def uidhashentry(uid):
-            hash = ((uid >> uidhash_bits) + uid) & uidhash_mask
-            return uidhash_table + hash
-
-        prog.cache["uidhashentry"] = uidhashentry
-
     uid = _kuid_val(uid)
     for user in hlist_for_each_entry(
-        "struct user_struct", uidhashentry(uid), "uidhash_node"
+        "struct user_struct", _uidhashentry(prog)(uid), "uidhash_node"
     ):
         if user.uid.val == uid:
             return user
@@ -0,0 +1,183 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+"""
+Batch mode for the drgn CLI
+
+Batch mode runs one script against many core dumps. The core dumps are grouped
+by kernel release. Debugging information is loaded and indexed once per group,
+by the first core dump in the group. The other core dumps in the group share
+its files with Program.share_debug_info() and get its index from the index
+cache.
+
+Debugging information is loaded in the parent one core dump at a time. Each
+script then runs in a forked worker, with a limited number running at once. The
+result for each core dump is printed to standard output as one line of JSON
+containing the core dump path, the kernel release, and the script's exit
+status, standard output, and standard error.
+"""
+
+import json
+import os
+import sys
+import tempfile
+from typing import (
+    IO,
+    Any,
+    Dict,
+    Iterable,
+    List,
+    NamedTuple,
+    NoReturn,
+    Optional,
+    Tuple,
+)
+
+import drgn
+from drgn.internal.forkserver import run_script
+
+
+# Core dumps which aren't of the Linux kernel are keyed by their path, so they
+# each get their own group.
+_GroupKey = Tuple[Optional[str], Optional[str]]
+
+
+class _Worker(NamedTuple):
+    core: str
+    release: Optional[str]
+    out: IO[bytes]
+    err: IO[bytes]
+
+
+def _emit(
+    core: str, release: Optional[str], status: int, stdout: str, stderr: str
+) -> None:
+    result: Dict[str, Any] = {
+        "core": core,
+        "kernel": release,
+        "status": status,
+        "stdout": stdout,
+        "stderr": stderr,
+    }
+    sys.stdout.write(json.dumps(result) + "\n")
+    sys.stdout.flush()
+
+
+def _kernel_release(prog: drgn.Program) -> Optional[str]:
+    if not prog.flags & drgn.ProgramFlags.IS_LINUX_KERNEL:
+        return None
+    return prog["UTS_RELEASE"].string_().decode()
+
+
+def _group_cores(cores: Iterable[str]) -> Tuple[Dict[_GroupKey, List[str]], int]:
+    groups: Dict[_GroupKey, List[str]] = {}
+    failed = 0
+    for core in cores:
+        try:
+            prog = drgn.Program()
+            prog.set_core_dump(core)
+            release = _kernel_release(prog)
+        except Exception as e:
+            _emit(core, None, 1, "", f"could not open core dump: {e}\n")
+            failed += 1
+            continue
+        key = (release, None) if release is not None else (None, core)
+        groups.setdefault(key, []).append(core)
+    return groups, failed
+
+
+def _run_worker(
+    prog: drgn.Program, argv: List[str], out: IO[bytes], err: IO[bytes]
+) -> NoReturn:
+    status = 1
+    try:
+        fd = os.open(os.devnull, os.O_RDONLY)
+        os.dup2(fd, 0)
+        os.close(fd)
+        os.dup2(out.fileno(), 1)
+        os.dup2(err.fileno(), 2)
+        status = run_script(prog, argv)
+    finally:
+        os._exit(status)
+
+
+def _reap(workers: Dict[int, _Worker]) -> int:
+    pid, wstatus = os.wait()
+    worker = workers.pop(pid)
+    message = ""
+    if os.WIFSIGNALED(wstatus):
+        status = -os.WTERMSIG(wstatus)
+        message = f"worker was killed by signal {-status}\n"
+    else:
+        status = os.WEXITSTATUS(wstatus)
+    outputs = []
+    for f in (worker.out, worker.err):
+        f.seek(0)
+        outputs.append(f.read().decode(errors="replace"))
+        f.close()
+    _emit(worker.core, worker.release, status, outputs[0], outputs[1] + message)
+    return status
+
+
+def run_batch(
+    cores: Iterable[str],
+    argv: List[str],
+    symbols: Optional[List[str]],
+    default_symbols: Dict[str, bool],
+    jobs: int,
+    quiet: bool,
+) -> NoReturn:
+    """
+    Run a script against each of the given core dumps and exit with status 1
+    if it failed for any of them.
+
+    :param cores: Core dump paths.
+    :param argv: Script path and arguments.
+    :param symbols: Additional debugging symbol files to load for every core
+        dump.
+    :param default_symbols: Keyword arguments to pass to
+        :meth:`drgn.Program.load_debug_info()`.
+    :param jobs: Maximum number of scripts to run at once.
+    :param quiet: Whether to leave warnings about missing debugging
+        information out of the results.
+    """
+    groups, failed = _group_cores(cores)
+    workers: Dict[int, _Worker] = {}
+    for (release, _), group in groups.items():
+        template = None
+        for core in group:
+            err = tempfile.TemporaryFile()
+            try:
+                prog = drgn.Program()
+                prog.set_core_dump(core)
+                if template is not None:
+                    prog.share_debug_info(template)
+                try:
+                    prog.load_debug_info(symbols, **default_symbols)
+                except drgn.MissingDebugInfoError as e:
+                    if not quiet:
+                        err.write(f"{e}\n".encode())
+            except Exception as e:
+                err.close()
+                _emit(core, release, 1, "", f"could not load core dump: {e}\n")
+                failed += 1
+                continue
+            if template is None:
+                template = prog
+
+            while len(workers) >= jobs:
+                if _reap(workers):
+                    failed += 1
+            out = tempfile.TemporaryFile()
+            err.flush()
+            sys.stdout.flush()
+            sys.stderr.flush()
+            pid = os.fork()
+            if pid == 0:
+                _run_worker(prog, argv, out, err)
+            workers[pid] = _Worker(core, release, out, err)
+            del prog
+    while workers:
+        if _reap(workers):
+            failed += 1
+    sys.exit(1 if failed else 0)
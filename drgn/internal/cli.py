@@ -18,6 +18,37 @@ from typing import Any, Dict
 import drgn
 
 
+def run_profiled(prog: drgn.Program, path: str, init_globals: Dict[str, Any]) -> None:
+    import cProfile
+    import pstats
+
+    prog.reset_stats()
+    prog.profiling = True
+    profiler = cProfile.Profile()
+    try:
+        profiler.runcall(
+            runpy.run_path, path, init_globals=init_globals, run_name="__main__"
+        )
+    finally:
+        prog.profiling = False
+        pstats.Stats(profiler, stream=sys.stderr).sort_stats("cumulative").print_stats(
+            25
+        )
+        rows = list(prog.profile_stats().items())
+        stats = prog.stats()
+        rows.append(("memory_reads", (stats["reads"], stats["read_ns"])))
+        print(
+            f"{'libdrgn operation':<20} {'calls':>12} {'total ms':>12} {'us/call':>12}",
+            file=sys.stderr,
+        )
+        for name, (calls, ns) in rows:
+            per_call = f"{ns / calls / 1000:.2f}" if calls and ns else ""
+            print(
+                f"{name:<20} {calls:>12} {ns / 1e6:>12.3f} {per_call:>12}",
+                file=sys.stderr,
+            )
+
+
 def displayhook(value: Any) -> None:
     if value is None:
         return
@@ -41,6 +72,29 @@ def displayhook(value: Any) -> None:
     setattr(builtins, "_", value)
 
 
+def load_btf_fallback(prog: drgn.Program, quiet: bool) -> None:
+    # If there is no debugging information for the running kernel itself, BTF
+    # still provides its types.
+    live_kernel = drgn.ProgramFlags.IS_LINUX_KERNEL | drgn.ProgramFlags.IS_LIVE
+    if (prog.flags & live_kernel) != live_kernel or not os.path.exists(
+        "/sys/kernel/btf/vmlinux"
+    ):
+        return
+    try:
+        prog.type("struct task_struct")
+        return
+    except LookupError:
+        pass
+    try:
+        prog.load_btf()
+    except Exception as e:
+        if not quiet:
+            print(f"could not load BTF: {e}", file=sys.stderr)
+    else:
+        if not quiet:
+            print("using BTF type information", file=sys.stderr)
+
+
 def main() -> None:
     drgn_version = pkg_resources.get_distribution("drgn").version
     python_version = ".".join(str(v) for v in sys.version_info[:3])
@@ -64,6 +118,21 @@ def main() -> None:
         type=int,
         help="debug the running process with the given PID",
     )
+    program_group.add_argument(
+        "--remote",
+        metavar="ADDRESS",
+        type=str,
+        help="debug the memory of a target speaking the GDB remote protocol at "
+        "HOST:PORT or vsock:CID:PORT; debugging symbols must be given with -s",
+    )
+    program_group.add_argument(
+        "--batch",
+        metavar="FILE",
+        type=str,
+        help="run the script against each core dump listed in the given file "
+        "(one path per line, or - for standard input) and print the results as "
+        "JSON lines; debugging symbols are loaded once per kernel release",
+    )
 
     symbol_group = parser.add_argument_group("debugging symbols")
     symbol_group.add_argument(
@@ -91,12 +160,43 @@ def main() -> None:
         help="don't load any debugging symbols that were not explicitly added with -s",
     )
 
+    server_group = parser.add_argument_group(
+        "fork server"
+    ).add_mutually_exclusive_group()
+    server_group.add_argument(
+        "--server",
+        metavar="SOCKET",
+        type=str,
+        help="load debugging symbols once, then listen on the given Unix socket and "
+        "run each script sent with --connect in a forked copy of this process",
+    )
+    server_group.add_argument(
+        "--connect",
+        metavar="SOCKET",
+        type=str,
+        help="run the script in the server listening on the given Unix socket; "
+        "the program and debugging symbols are the server's",
+    )
+
+    parser.add_argument(
+        "-j",
+        "--jobs",
+        metavar="N",
+        type=int,
+        help="with --batch, run up to N scripts at once (default: number of CPUs)",
+    )
     parser.add_argument(
         "-q",
         "--quiet",
         action="store_true",
         help="don't print non-fatal warnings (e.g., about missing debugging information)",
     )
+    parser.add_argument(
+        "--profile",
+        action="store_true",
+        help="profile the script and print where it spent its time, "
+        "including calls into libdrgn, to standard error",
+    )
     parser.add_argument(
         "script",
         metavar="ARG",
@@ -108,25 +208,75 @@ def main() -> None:
 
     args = parser.parse_args()
 
+    if args.connect is not None:
+        if not args.script:
+            parser.error("--connect requires a script")
+        from drgn.internal.forkserver import connect
+
+        connect(args.connect, args.script)
+    if args.server is not None and args.script:
+        parser.error("--server cannot be used with a script")
+    if args.profile and not args.script:
+        parser.error("--profile requires a script")
+    if args.batch is not None:
+        if not args.script:
+            parser.error("--batch requires a script")
+        if args.server is not None or args.profile:
+            parser.error("--batch cannot be used with --server or --profile")
+    elif args.jobs is not None:
+        parser.error("--jobs requires --batch")
+    if args.jobs is not None and args.jobs < 1:
+        parser.error("--jobs must be positive")
+    if args.default_symbols is None:
+        args.default_symbols = {"default": True, "main": True}
+
+    if args.batch is not None:
+        from drgn.internal.batch import run_batch
+
+        if args.batch == "-":
+            lines = sys.stdin.read().splitlines()
+        else:
+            with open(args.batch) as f:
+                lines = f.read().splitlines()
+        run_batch(
+            [line.strip() for line in lines if line.strip()],
+            args.script,
+            args.symbols,
+            args.default_symbols,
+            args.jobs or os.cpu_count() or 1,
+            args.quiet,
+        )
+
     prog = drgn.Program()
     if args.core is not None:
         prog.set_core_dump(args.core)
     elif args.pid is not None:
         prog.set_pid(args.pid or os.getpid())
+    elif args.remote is not None:
+        prog.set_remote(args.remote)
     else:
         prog.set_kernel()
-    if args.default_symbols is None:
-        args.default_symbols = {"default": True, "main": True}
     try:
         prog.load_debug_info(args.symbols, **args.default_symbols)
     except drgn.MissingDebugInfoError as e:
         if not args.quiet:
             print(str(e), file=sys.stderr)
+        load_btf_fallback(prog, args.quiet)
+
+    if args.server is not None:
+        from drgn.internal.forkserver import serve
+
+        serve(prog, args.server)
 
     init_globals: Dict[str, Any] = {"prog": prog}
     if args.script:
         sys.argv = args.script
-        runpy.run_path(args.script[0], init_globals=init_globals, run_name="__main__")
+        if args.profile:
+            run_profiled(prog, args.script[0], init_globals)
+        else:
+            runpy.run_path(
+                args.script[0], init_globals=init_globals, run_name="__main__"
+            )
     else:
         import atexit
         import readline
@@ -0,0 +1,174 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+"""
+Fork server for the drgn CLI
+
+The server loads and indexes debugging information once and then listens on a
+Unix socket. For each connection, it forks a child which runs a script against
+its copy-on-write copy of the program, so scripts start without loading
+anything.
+
+The client sends one message containing the script arguments and working
+directory as JSON along with its standard input, output, and error file
+descriptors. The child replies with a message containing its PID, so that the
+client can forward signals to it, and another containing the exit status when
+the script finishes.
+"""
+
+import array
+import json
+import os
+import runpy
+import signal
+import socket
+import sys
+import traceback
+from typing import Any, Dict, List, NoReturn
+
+import drgn
+
+
+_MAX_REQUEST_SIZE = 1024 * 1024
+_NUM_FDS = 3
+
+
+def _recv_request(conn: socket.socket) -> Dict[str, Any]:
+    fds = array.array("i")
+    msg, ancdata, flags, addr = conn.recvmsg(
+        _MAX_REQUEST_SIZE, socket.CMSG_SPACE(_NUM_FDS * fds.itemsize)
+    )
+    for level, type, data in ancdata:
+        if level == socket.SOL_SOCKET and type == socket.SCM_RIGHTS:
+            fds.frombytes(data[: len(data) - (len(data) % fds.itemsize)])
+    try:
+        if flags & (socket.MSG_TRUNC | socket.MSG_CTRUNC) or len(fds) != _NUM_FDS:
+            raise ValueError("malformed request")
+        request = json.loads(msg)
+    except ValueError:
+        for fd in fds:
+            os.close(fd)
+        raise
+    request["fds"] = list(fds)
+    return request
+
+
+def run_script(prog: drgn.Program, argv: List[str]) -> int:
+    """
+    Run a script in this process like the CLI does and return its exit status
+    instead of exiting. Uncaught exceptions are printed to standard error.
+
+    :param prog: Program to pass to the script as ``prog``.
+    :param argv: Script path and arguments.
+    """
+    status = 1
+    sys.argv = argv
+    try:
+        runpy.run_path(argv[0], init_globals={"prog": prog}, run_name="__main__")
+        status = 0
+    except SystemExit as e:
+        if e.code is None:
+            status = 0
+        elif isinstance(e.code, int):
+            status = e.code
+        else:
+            print(e.code, file=sys.stderr)
+    except BaseException:
+        traceback.print_exc()
+    sys.stdout.flush()
+    sys.stderr.flush()
+    return status
+
+
+def _run_child(
+    prog: drgn.Program, conn: socket.socket, request: Dict[str, Any]
+) -> NoReturn:
+    status = 1
+    try:
+        conn.sendall(json.dumps({"pid": os.getpid()}).encode())
+        signal.signal(signal.SIGCHLD, signal.SIG_DFL)
+        signal.signal(signal.SIGINT, signal.default_int_handler)
+        for i, fd in enumerate(request["fds"]):
+            os.dup2(fd, i)
+            os.close(fd)
+        os.chdir(request["cwd"])
+        # Anything that the server read from a running program may be stale.
+        if prog.flags & drgn.ProgramFlags.IS_LIVE:
+            prog.invalidate_memory_cache()
+        status = run_script(prog, request["argv"])
+        conn.sendall(json.dumps({"status": status}).encode())
+    finally:
+        os._exit(status)
+
+
+def serve(prog: drgn.Program, path: str) -> NoReturn:
+    """
+    Run scripts sent by :func:`connect()` to the socket at the given path
+    forever.
+
+    :param prog: Program with debugging information already loaded.
+    :param path: Path of the Unix socket to create.
+    """
+    try:
+        os.unlink(path)
+    except FileNotFoundError:
+        pass
+    listener = socket.socket(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+    listener.bind(path)
+    listener.listen(socket.SOMAXCONN)
+    # Children report their status to the client, so they don't need to be
+    # waited for.
+    signal.signal(signal.SIGCHLD, signal.SIG_IGN)
+    while True:
+        conn, _ = listener.accept()
+        try:
+            request = _recv_request(conn)
+        except (OSError, ValueError) as e:
+            print(f"could not read request: {e}", file=sys.stderr)
+            conn.close()
+            continue
+        sys.stdout.flush()
+        sys.stderr.flush()
+        pid = os.fork()
+        if pid == 0:
+            listener.close()
+            _run_child(prog, conn, request)
+        for fd in request["fds"]:
+            os.close(fd)
+        conn.close()
+
+
+def connect(path: str, argv: List[str]) -> NoReturn:
+    """
+    Run a script in the server listening on the given path and exit with its
+    exit status.
+
+    :param path: Path of the server's Unix socket.
+    :param argv: Script path and arguments.
+    """
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+    sock.connect(path)
+    request = json.dumps({"argv": argv, "cwd": os.getcwd()}).encode()
+    sock.sendmsg(
+        [request],
+        [(socket.SOL_SOCKET, socket.SCM_RIGHTS, array.array("i", range(_NUM_FDS)))],
+    )
+    msg = sock.recv(4096)
+    if not msg:
+        sys.exit("drgn server closed the connection")
+    pid = json.loads(msg)["pid"]
+
+    # The script runs in a child of the server, so forward signals from the
+    # terminal to it.
+    def forward_signal(signum: int, frame: Any) -> None:
+        try:
+            os.kill(pid, signum)
+        except OSError:
+            pass
+
+    for signum in (signal.SIGINT, signal.SIGTERM, signal.SIGHUP):
+        signal.signal(signum, forward_signal)
+    msg = sock.recv(4096)
+    if not msg:
+        sys.exit("drgn server closed the connection")
+    sys.exit(json.loads(msg)["status"])
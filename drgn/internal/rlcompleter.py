@@ -9,6 +9,8 @@ import keyword
 import readline
 from typing import Any, Dict, List, Optional
 
+from drgn import FindNameFlags, Program
+
 
 _EXPR_RE = re.compile(
     r"""
@@ -32,6 +34,9 @@ _EXPR_RE = re.compile(
     re.VERBOSE,
 )
 
+# Object name in a subscript of a Program, e.g., prog["jiff
+_PROGRAM_KEY_RE = re.compile(r"""(\w+(?:\.\w+)*)\[(["'])(\w*)""")
+
 
 class Completer:
     """
@@ -57,7 +62,9 @@ class Completer:
                 return None
 
         if state == 0:
-            if "." in text:
+            if "[" in text:
+                self._matches = self._program_key_matches(text)
+            elif "." in text:
                 self._matches = self._expr_matches(text)
             else:
                 self._matches = self._global_matches(text)
@@ -67,6 +74,24 @@ class Completer:
         else:
             return None
 
+    def _program_key_matches(self, text: str) -> List[str]:
+        m = _PROGRAM_KEY_RE.fullmatch(text)
+        if not m:
+            return self._expr_matches(text)
+
+        expr, quote, prefix = m.group(1, 2, 3)
+        try:
+            prog = eval(expr, self._namespace)
+        except Exception:
+            return []
+        if not isinstance(prog, Program):
+            return []
+        try:
+            names = prog.names(prefix, flags=FindNameFlags.OBJECT)
+        except Exception:
+            return []
+        return [f"{expr}[{quote}{name}{quote}]" for name in names]
+
     def _expr_matches(self, text: str) -> List[str]:
         m = _EXPR_RE.fullmatch(text)
         if not m:
@@ -0,0 +1,155 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+"""
+Parallel Processing
+-------------------
+
+The ``drgn.parallel`` module applies a function to many items on multiple
+CPUs, e.g., to scan every task, page, or socket in the Linux kernel.
+
+The items are split into shards, and each shard is processed by a child process
+forked from the caller. The children share the program and any debugging
+information that it has already loaded with the parent, so nothing is reloaded,
+and the items and the function are inherited rather than sent to them. This
+means that the function can be any callable, including a lambda or closure.
+Only the results are sent back, so they must be picklable. :class:`drgn.Object`,
+:class:`drgn.Type`, and :class:`drgn.Program` can be pickled for this; see
+:attr:`drgn.Program.pickle_id`.
+
+For example, to find every task which is a kernel thread:
+
+.. code-block:: python3
+
+    import drgn.parallel
+    from drgn.helpers.linux.pid import for_each_task
+
+    kthreads = [
+        task for task in drgn.parallel.map(
+            lambda task: task if not task.mm else None, for_each_task(prog)
+        )
+        if task is not None
+    ]
+"""
+
+import itertools
+import multiprocessing
+import os
+from typing import (
+    Any,
+    Callable,
+    Dict,
+    Iterable,
+    Iterator,
+    List,
+    Optional,
+    Tuple,
+    TypeVar,
+)
+
+from drgn import Object, Program
+
+__all__ = (
+    "imap",
+    "map",
+)
+
+
+T = TypeVar("T")
+U = TypeVar("U")
+
+
+# Work for each call which is running, by token. Workers are forked after this
+# is set, so they inherit it.
+_work: Dict[int, Tuple[Callable[[Any], Any], List[Any]]] = {}
+_next_token = itertools.count()
+
+
+def _run_shard(args: Tuple[int, int, int]) -> List[Any]:
+    token, start, stop = args
+    func, items = _work[token]
+    return [func(item) for item in items[start:stop]]
+
+
+def imap(
+    func: Callable[[T], U],
+    iterable: Iterable[T],
+    *,
+    processes: Optional[int] = None,
+    chunksize: Optional[int] = None,
+    prog: Optional[Program] = None,
+) -> Iterator[U]:
+    """
+    Apply a function to every item of an iterable in parallel, returning an
+    iterator of the results in the same order as the items.
+
+    Results are returned as soon as each shard finishes, so the caller can
+    start processing them before every item has been processed. The iterable
+    is read completely before any work starts.
+
+    :param func: Function to apply.
+    :param iterable: Items to apply *func* to.
+    :param processes: Number of processes to use. This defaults to
+        :func:`os.cpu_count()`.
+    :param chunksize: Number of items in each shard. The default is chosen so
+        that there are about four shards per process.
+    :param prog: Program whose objects *func* may return. Programs of
+        :class:`drgn.Object` items are found automatically, so this is only
+        needed if the items aren't objects.
+    """
+    items = list(iterable)
+    if processes is None:
+        processes = os.cpu_count() or 1
+    if processes < 1:
+        raise ValueError("processes must be at least 1")
+    if chunksize is None:
+        chunksize, extra = divmod(len(items), processes * 4)
+        if extra:
+            chunksize += 1
+    chunksize = max(chunksize, 1)
+    if processes == 1 or len(items) <= chunksize:
+        for item in items:
+            yield func(item)
+        return
+
+    # Results referring to a program are pickled with its pickle ID, which must
+    # be assigned before forking so that the children inherit it.
+    progs = {} if prog is None else {id(prog): prog}
+    for item in items:
+        if isinstance(item, Object):
+            progs.setdefault(id(item.prog_), item.prog_)
+    for p in progs.values():
+        p.pickle_id
+
+    token = next(_next_token)
+    _work[token] = (func, items)
+    try:
+        shards = [
+            (token, start, start + chunksize)
+            for start in range(0, len(items), chunksize)
+        ]
+        ctx = multiprocessing.get_context("fork")
+        with ctx.Pool(min(processes, len(shards))) as pool:
+            for results in pool.imap(_run_shard, shards):
+                yield from results
+    finally:
+        del _work[token]
+
+
+def map(
+    func: Callable[[T], U],
+    iterable: Iterable[T],
+    *,
+    processes: Optional[int] = None,
+    chunksize: Optional[int] = None,
+    prog: Optional[Program] = None,
+) -> List[U]:
+    """
+    Apply a function to every item of an iterable in parallel, returning a list
+    of the results in the same order as the items.
+
+    This takes the same parameters as :func:`imap()`.
+    """
+    return list(
+        imap(func, iterable, processes=processes, chunksize=chunksize, prog=prog)
+    )
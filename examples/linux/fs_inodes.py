@@ -3,8 +3,7 @@
 
 """List the paths of all inodes cached in a given filesystem"""
 
-from drgn.helpers.linux.fs import for_each_mount, inode_path
-from drgn.helpers.linux.list import list_for_each_entry
+from drgn.helpers.linux.fs import for_each_mount, for_each_sb_inode, inode_path
 import os
 import sys
 import time
@@ -23,9 +22,7 @@ if mnt is None:
 
 sb = mnt.mnt.mnt_sb
 
-for inode in list_for_each_entry(
-    "struct inode", sb.s_inodes.address_of_(), "i_sb_list"
-):
+for inode in for_each_sb_inode(sb):
     try:
         print(os.fsdecode(inode_path(inode)))
     except ValueError:
@@ -3,11 +3,9 @@
 
 """A simplified implementation of ps(1) using drgn"""
 
-from drgn.helpers.linux.pid import for_each_task
+from drgn.helpers.linux.sched import task_snapshot
 
 
 print("PID        COMM")
-for task in for_each_task(prog):
-    pid = task.pid.value_()
-    comm = task.comm.string_().decode()
-    print(f"{pid:<10} {comm}")
+for pid, comm in task_snapshot(prog, ("pid", "comm")):
+    print(f"{pid:<10} {comm.decode()}")
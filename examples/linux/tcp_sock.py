@@ -7,16 +7,14 @@ import ipaddress
 import socket
 import struct
 
-from drgn import cast, container_of
+from drgn import cast
 from drgn.helpers import enum_type_to_class
 from drgn.helpers.linux import (
     cgroup_path,
-    hlist_for_each,
-    hlist_nulls_empty,
     sk_fullsock,
-    sk_nulls_for_each,
     sk_tcpstate,
     sock_cgroup_ptr,
+    tcp_for_each_sock,
 )
 
 
@@ -89,18 +87,5 @@ def _print_sk(sk):
     #   print(cgrp)
 
 
-tcp_hashinfo = prog.object("tcp_hashinfo")
-
-# 1. Iterate over all TCP sockets in TCP_LISTEN state.
-for ilb in tcp_hashinfo.listening_hash:
-    for pos in hlist_for_each(ilb.head):
-        sk = container_of(pos, "struct sock", "__sk_common.skc_node")
-        _print_sk(sk)
-
-# 2. And all other TCP sockets.
-for i in range(tcp_hashinfo.ehash_mask + 1):
-    head = tcp_hashinfo.ehash[i].chain
-    if hlist_nulls_empty(head):
-        continue
-    for sk in sk_nulls_for_each(head):
-        _print_sk(sk)
+for sk in tcp_for_each_sock(prog):
+    _print_sk(sk)
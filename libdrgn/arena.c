@@ -0,0 +1,89 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/* Size of the chunks that most allocations come from. */
+#define DRGN_ARENA_CHUNK_SIZE (64 * 1024)
+
+struct drgn_arena_chunk {
+	struct drgn_arena_chunk *next;
+	alignas(max_align_t) char data[];
+};
+
+/* Free the chunks in a list up to but not including end. */
+static void drgn_arena_free_chunks(struct drgn_arena_chunk *chunk,
+				   struct drgn_arena_chunk *end)
+{
+	struct drgn_arena_chunk *next;
+
+	for (; chunk != end; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+}
+
+void drgn_arena_deinit(struct drgn_arena *arena)
+{
+	drgn_arena_free_chunks(arena->chunks, NULL);
+	drgn_arena_free_chunks(arena->large_chunks, NULL);
+}
+
+void drgn_arena_rewind(struct drgn_arena *arena, struct drgn_arena_mark mark)
+{
+	drgn_arena_free_chunks(arena->chunks, mark.chunks);
+	drgn_arena_free_chunks(arena->large_chunks, mark.large_chunks);
+	arena->chunks = mark.chunks;
+	arena->large_chunks = mark.large_chunks;
+	arena->ptr = mark.ptr;
+	arena->end = (mark.chunks ?
+		      mark.chunks->data + DRGN_ARENA_CHUNK_SIZE : NULL);
+	arena->size = mark.size;
+}
+
+void *drgn_arena_alloc_slow(struct drgn_arena *arena, size_t size)
+{
+	struct drgn_arena_chunk *chunk;
+
+	if (size > SIZE_MAX - sizeof(*chunk))
+		return NULL;
+	/*
+	 * Large allocations get their own chunk on a separate list so that the
+	 * rest of the current chunk isn't wasted.
+	 */
+	if (size > DRGN_ARENA_CHUNK_SIZE / 4) {
+		chunk = malloc(sizeof(*chunk) + size);
+		if (!chunk)
+			return NULL;
+		arena->size += sizeof(*chunk) + size;
+		chunk->next = arena->large_chunks;
+		arena->large_chunks = chunk;
+		return chunk->data;
+	}
+
+	chunk = malloc(sizeof(*chunk) + DRGN_ARENA_CHUNK_SIZE);
+	if (!chunk)
+		return NULL;
+	arena->size += sizeof(*chunk) + DRGN_ARENA_CHUNK_SIZE;
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	arena->ptr = chunk->data + size;
+	arena->end = chunk->data + DRGN_ARENA_CHUNK_SIZE;
+	return chunk->data;
+}
+
+void *drgn_arena_memdup_array(struct drgn_arena *arena, const void *src,
+			      size_t nmemb, size_t size)
+{
+	void *ret;
+
+	if (!nmemb)
+		return NULL;
+	ret = drgn_arena_alloc_array(arena, nmemb, size);
+	if (ret)
+		memcpy(ret, src, nmemb * size);
+	return ret;
+}
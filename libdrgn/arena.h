@@ -0,0 +1,151 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Arena allocator.
+ *
+ * See @ref Arenas.
+ */
+
+#ifndef DRGN_ARENA_H
+#define DRGN_ARENA_H
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup Arenas Arenas
+ *
+ * Arena allocator.
+ *
+ * A @ref drgn_arena hands out memory from large chunks by bumping a pointer.
+ * Allocations can't be freed individually; everything is freed at once by
+ * @ref drgn_arena_deinit(). This is useful for many small objects that live as
+ * long as their owner, like parsed types.
+ *
+ * Everything allocated after a point can also be freed by saving a @ref
+ * drgn_arena_mark and passing it to @ref drgn_arena_rewind() later, e.g., to
+ * undo the allocations of an operation that failed partway through.
+ *
+ * @{
+ */
+
+struct drgn_arena_chunk;
+
+/** Arena allocator. */
+struct drgn_arena {
+	/** Allocated chunks, most recent (i.e., the current chunk) first. */
+	struct drgn_arena_chunk *chunks;
+	/** Chunks holding a single large allocation, most recent first. */
+	struct drgn_arena_chunk *large_chunks;
+	/** Next free byte in the current chunk. */
+	char *ptr;
+	/** End of the current chunk. */
+	char *end;
+	/** Total size of the allocated chunks in bytes. */
+	size_t size;
+};
+
+/** Initializer for a @ref drgn_arena. */
+#define DRGN_ARENA_INIT { NULL, NULL, NULL, NULL, 0 }
+
+/** Initialize a @ref drgn_arena. */
+static inline void drgn_arena_init(struct drgn_arena *arena)
+{
+	arena->chunks = arena->large_chunks = NULL;
+	arena->ptr = arena->end = NULL;
+	arena->size = 0;
+}
+
+/** Saved position in a @ref drgn_arena. See @ref drgn_arena_rewind(). */
+struct drgn_arena_mark {
+	struct drgn_arena_chunk *chunks;
+	struct drgn_arena_chunk *large_chunks;
+	char *ptr;
+	size_t size;
+};
+
+/** Get the current position in a @ref drgn_arena. */
+static inline struct drgn_arena_mark drgn_arena_mark(struct drgn_arena *arena)
+{
+	return (struct drgn_arena_mark){
+		.chunks = arena->chunks,
+		.large_chunks = arena->large_chunks,
+		.ptr = arena->ptr,
+		.size = arena->size,
+	};
+}
+
+/**
+ * Free everything allocated from a @ref drgn_arena since a @ref
+ * drgn_arena_mark was saved.
+ *
+ * Marks saved after @p mark are invalidated.
+ */
+void drgn_arena_rewind(struct drgn_arena *arena, struct drgn_arena_mark mark);
+
+/** Get the number of bytes allocated by a @ref drgn_arena. */
+static inline size_t drgn_arena_memory_usage(struct drgn_arena *arena)
+{
+	return arena->size;
+}
+
+/** Free all memory allocated from a @ref drgn_arena. */
+void drgn_arena_deinit(struct drgn_arena *arena);
+
+void *drgn_arena_alloc_slow(struct drgn_arena *arena, size_t size);
+
+/**
+ * Allocate memory from a @ref drgn_arena.
+ *
+ * The memory is suitably aligned for any type and is not initialized.
+ *
+ * @return The allocated memory, or @c NULL if we couldn't allocate memory.
+ */
+static inline void *drgn_arena_alloc(struct drgn_arena *arena, size_t size)
+{
+	size_t padding = -(uintptr_t)arena->ptr & (alignof(max_align_t) - 1);
+
+	if (size <= (size_t)(arena->end - arena->ptr) &&
+	    padding <= (size_t)(arena->end - arena->ptr) - size) {
+		void *ret = arena->ptr + padding;
+
+		arena->ptr += padding + size;
+		return ret;
+	}
+	return drgn_arena_alloc_slow(arena, size);
+}
+
+/**
+ * Allocate an array from a @ref drgn_arena.
+ *
+ * @return The allocated array, or @c NULL if we couldn't allocate memory or
+ * the size overflowed.
+ */
+static inline void *drgn_arena_alloc_array(struct drgn_arena *arena,
+					   size_t nmemb, size_t size)
+{
+	size_t bytes;
+
+	if (__builtin_mul_overflow(nmemb, size, &bytes))
+		return NULL;
+	return drgn_arena_alloc(arena, bytes);
+}
+
+/**
+ * Copy an array into a @ref drgn_arena.
+ *
+ * @return The copy, or @c NULL if we couldn't allocate memory. If @p nmemb is
+ * zero, this returns @c NULL without allocating, which is not an error.
+ */
+void *drgn_arena_memdup_array(struct drgn_arena *arena, const void *src,
+			      size_t nmemb, size_t size);
+
+/** @} */
+
+#endif /* DRGN_ARENA_H */
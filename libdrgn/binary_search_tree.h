@@ -25,7 +25,9 @@
  * is generic, strongly typed (entries have a static type, not <tt>void *</tt>),
  * and doesn't have any function pointer overhead. Currently, only splay trees
  * are implemented, but this may be extended to support other variants like
- * red-black trees or AVL trees.
+ * red-black trees or AVL trees. Note that splay trees modify the tree on every
+ * search; for a map which is searched much more often than it is modified,
+ * consider an @ref OrderedIndices "ordered index" built from the tree.
  *
  * Entries are allocated separately from this interface. The interface is
  * intrusive, i.e., entries must embed a @ref binary_tree_node.
@@ -46,7 +48,7 @@
  *                           cmp_func, splay)
  * @endcode
  *
- * @sa HashTables
+ * @sa HashTables, OrderedIndices
  *
  * @{
  */
@@ -0,0 +1,1245 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "internal.h"
+#include "btf.h"
+#include "kallsyms.h"
+#include "language.h"
+#include "program.h"
+#include "type.h"
+#include "type_index.h"
+#include "vector.h"
+
+/*
+ * The BTF format is defined in include/uapi/linux/btf.h in the Linux kernel
+ * source tree. Only the parts that we need are defined here.
+ */
+#define BTF_MAGIC 0xeb9f
+#define BTF_VERSION 1
+
+enum {
+	BTF_KIND_UNKN,
+	BTF_KIND_INT,
+	BTF_KIND_PTR,
+	BTF_KIND_ARRAY,
+	BTF_KIND_STRUCT,
+	BTF_KIND_UNION,
+	BTF_KIND_ENUM,
+	BTF_KIND_FWD,
+	BTF_KIND_TYPEDEF,
+	BTF_KIND_VOLATILE,
+	BTF_KIND_CONST,
+	BTF_KIND_RESTRICT,
+	BTF_KIND_FUNC,
+	BTF_KIND_FUNC_PROTO,
+	BTF_KIND_VAR,
+	BTF_KIND_DATASEC,
+	BTF_KIND_FLOAT,
+	BTF_KIND_DECL_TAG,
+	BTF_KIND_TYPE_TAG,
+	BTF_KIND_ENUM64,
+};
+
+#define BTF_INT_SIGNED (1 << 0)
+#define BTF_INT_BOOL (1 << 2)
+
+struct btf_header {
+	uint16_t magic;
+	uint8_t version;
+	uint8_t flags;
+	uint32_t hdr_len;
+	uint32_t type_off;
+	uint32_t type_len;
+	uint32_t str_off;
+	uint32_t str_len;
+};
+
+struct btf_type {
+	uint32_t name_off;
+	uint32_t info;
+	union {
+		uint32_t size;
+		uint32_t type;
+	};
+};
+
+struct btf_array {
+	uint32_t type;
+	uint32_t index_type;
+	uint32_t nelems;
+};
+
+struct btf_member {
+	uint32_t name_off;
+	uint32_t type;
+	uint32_t offset;
+};
+
+struct btf_enum {
+	uint32_t name_off;
+	int32_t val;
+};
+
+struct btf_enum64 {
+	uint32_t name_off;
+	uint32_t val_lo32;
+	uint32_t val_hi32;
+};
+
+struct btf_param {
+	uint32_t name_off;
+	uint32_t type;
+};
+
+static inline int btf_kind(const struct btf_type *t)
+{
+	return (t->info >> 24) & 0x1f;
+}
+
+static inline uint16_t btf_vlen(const struct btf_type *t)
+{
+	return t->info & 0xffff;
+}
+
+static inline bool btf_kind_flag(const struct btf_type *t)
+{
+	return t->info >> 31;
+}
+
+static struct hash_pair
+drgn_btf_name_key_hash(const struct drgn_btf_name_key *key)
+{
+	size_t hash;
+
+	hash = hash_bytes(key->name.str, key->name.len);
+	hash = hash_combine(hash, key->ns);
+	return hash_pair_from_avalanching_hash(hash);
+}
+
+static bool drgn_btf_name_key_eq(const struct drgn_btf_name_key *a,
+				 const struct drgn_btf_name_key *b)
+{
+	return a->ns == b->ns && string_eq(&a->name, &b->name);
+}
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_btf_name_map, drgn_btf_name_key_hash,
+			    drgn_btf_name_key_eq)
+DEFINE_VECTOR(btf_type_vector, const char *)
+
+static inline const struct btf_type *drgn_btf_type_at(struct drgn_btf *btf,
+						      uint32_t id)
+{
+	return (const struct btf_type *)btf->types[id];
+}
+
+/* Get a name from the string section, or NULL if it is empty. */
+static inline const char *drgn_btf_name(struct drgn_btf *btf,
+					uint32_t name_off)
+{
+	const char *name = &btf->strings[name_off];
+
+	return *name ? name : NULL;
+}
+
+static struct drgn_error *read_btf_file(const char *path, char **buf_ret,
+					size_t *size_ret)
+{
+	struct drgn_error *err;
+	int fd;
+	char *buf = NULL;
+	size_t size = 0, capacity = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return drgn_error_create_os("open", errno, path);
+	for (;;) {
+		ssize_t r;
+
+		if (size == capacity) {
+			char *tmp;
+
+			capacity = capacity ? capacity * 2 : 1024 * 1024;
+			tmp = realloc(buf, capacity);
+			if (!tmp) {
+				err = &drgn_enomem;
+				goto err;
+			}
+			buf = tmp;
+		}
+		r = read(fd, buf + size, capacity - size);
+		if (r == -1) {
+			if (errno == EINTR)
+				continue;
+			err = drgn_error_create_os("read", errno, path);
+			goto err;
+		}
+		if (r == 0)
+			break;
+		size += r;
+	}
+	close(fd);
+	*buf_ret = buf;
+	*size_ret = size;
+	return NULL;
+
+err:
+	free(buf);
+	close(fd);
+	return err;
+}
+
+static bool drgn_btf_is_declaration(struct drgn_btf *btf, uint32_t id)
+{
+	const struct btf_type *t = drgn_btf_type_at(btf, id);
+
+	switch (btf_kind(t)) {
+	case BTF_KIND_FWD:
+		return true;
+	case BTF_KIND_ENUM:
+	case BTF_KIND_ENUM64:
+		return btf_vlen(t) == 0;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Add a name to drgn_btf::names. A complete definition replaces an earlier
+ * declaration; otherwise, the first type with a given name wins.
+ */
+static struct drgn_error *drgn_btf_add_name(struct drgn_btf *btf,
+					    enum drgn_btf_namespace ns,
+					    uint32_t name_off, uint32_t id)
+{
+	const char *name = drgn_btf_name(btf, name_off);
+	struct drgn_btf_name_map_entry entry;
+	struct hash_pair hp;
+	struct drgn_btf_name_map_iterator it;
+
+	if (!name)
+		return NULL;
+	entry.key.name.str = name;
+	entry.key.name.len = strlen(name);
+	entry.key.ns = ns;
+	entry.value = id;
+	hp = drgn_btf_name_map_hash(&entry.key);
+	it = drgn_btf_name_map_search_hashed(&btf->names, &entry.key, hp);
+	if (it.entry) {
+		if (ns != DRGN_BTF_NAMESPACE_OBJECT &&
+		    drgn_btf_is_declaration(btf, it.entry->value) &&
+		    !drgn_btf_is_declaration(btf, id))
+			it.entry->value = id;
+		return NULL;
+	}
+	if (drgn_btf_name_map_insert_searched(&btf->names, &entry, hp,
+					      NULL) == -1)
+		return &drgn_enomem;
+	return NULL;
+}
+
+/*
+ * Check that the variable-length data of each type is in bounds and index the
+ * type names.
+ */
+static struct drgn_error *drgn_btf_index_types(struct drgn_btf *btf,
+					       const char *p, const char *end)
+{
+	struct drgn_error *err;
+	struct btf_type_vector types = VECTOR_INIT;
+
+	/* Type ID 0 is void. */
+	if (!btf_type_vector_append(&types, &(const char *){ NULL })) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	while (p < end) {
+		const struct btf_type *t = (const struct btf_type *)p;
+		uint32_t id = types.size;
+		size_t extra;
+		uint16_t i;
+
+		if (end - p < sizeof(*t))
+			goto eof;
+		if (t->name_off >= btf->strings_size) {
+			err = drgn_error_format(DRGN_ERROR_OTHER,
+						"BTF type %" PRIu32 " has invalid name offset",
+						id);
+			goto err;
+		}
+		switch (btf_kind(t)) {
+		case BTF_KIND_INT:
+		case BTF_KIND_VAR:
+		case BTF_KIND_DECL_TAG:
+			extra = sizeof(uint32_t);
+			break;
+		case BTF_KIND_ARRAY:
+			extra = sizeof(struct btf_array);
+			break;
+		case BTF_KIND_STRUCT:
+		case BTF_KIND_UNION:
+			extra = btf_vlen(t) * sizeof(struct btf_member);
+			break;
+		case BTF_KIND_ENUM:
+			extra = btf_vlen(t) * sizeof(struct btf_enum);
+			break;
+		case BTF_KIND_ENUM64:
+			extra = btf_vlen(t) * sizeof(struct btf_enum64);
+			break;
+		case BTF_KIND_FUNC_PROTO:
+			extra = btf_vlen(t) * sizeof(struct btf_param);
+			break;
+		case BTF_KIND_DATASEC:
+			/* struct btf_var_secinfo is three 32-bit words. */
+			extra = btf_vlen(t) * 3 * sizeof(uint32_t);
+			break;
+		case BTF_KIND_PTR:
+		case BTF_KIND_FWD:
+		case BTF_KIND_TYPEDEF:
+		case BTF_KIND_VOLATILE:
+		case BTF_KIND_CONST:
+		case BTF_KIND_RESTRICT:
+		case BTF_KIND_FUNC:
+		case BTF_KIND_FLOAT:
+		case BTF_KIND_TYPE_TAG:
+			extra = 0;
+			break;
+		default:
+			err = drgn_error_format(DRGN_ERROR_OTHER,
+						"BTF type %" PRIu32 " has unknown kind %d",
+						id, btf_kind(t));
+			goto err;
+		}
+		if (end - p - sizeof(*t) < extra)
+			goto eof;
+
+		switch (btf_kind(t)) {
+		case BTF_KIND_STRUCT:
+			err = drgn_btf_add_name(btf, DRGN_BTF_NAMESPACE_STRUCT,
+						t->name_off, id);
+			break;
+		case BTF_KIND_UNION:
+			err = drgn_btf_add_name(btf, DRGN_BTF_NAMESPACE_UNION,
+						t->name_off, id);
+			break;
+		case BTF_KIND_FWD:
+			err = drgn_btf_add_name(btf,
+						btf_kind_flag(t) ?
+						DRGN_BTF_NAMESPACE_UNION :
+						DRGN_BTF_NAMESPACE_STRUCT,
+						t->name_off, id);
+			break;
+		case BTF_KIND_ENUM:
+		case BTF_KIND_ENUM64: {
+			/* Both have the name offset first. */
+			size_t enumerator_size =
+				btf_kind(t) == BTF_KIND_ENUM ?
+				sizeof(struct btf_enum) :
+				sizeof(struct btf_enum64);
+
+			err = drgn_btf_add_name(btf, DRGN_BTF_NAMESPACE_ENUM,
+						t->name_off, id);
+			for (i = 0; !err && i < btf_vlen(t); i++) {
+				uint32_t name_off;
+
+				memcpy(&name_off,
+				       p + sizeof(*t) + i * enumerator_size,
+				       sizeof(name_off));
+				if (name_off >= btf->strings_size) {
+					err = drgn_error_format(DRGN_ERROR_OTHER,
+								"BTF type %" PRIu32 " has invalid enumerator name offset",
+								id);
+					break;
+				}
+				err = drgn_btf_add_name(btf,
+							DRGN_BTF_NAMESPACE_OBJECT,
+							name_off, id);
+			}
+			break;
+		}
+		case BTF_KIND_INT:
+		case BTF_KIND_FLOAT:
+		case BTF_KIND_TYPEDEF:
+			err = drgn_btf_add_name(btf,
+						DRGN_BTF_NAMESPACE_ORDINARY,
+						t->name_off, id);
+			break;
+		case BTF_KIND_FUNC:
+		case BTF_KIND_VAR:
+			err = drgn_btf_add_name(btf, DRGN_BTF_NAMESPACE_OBJECT,
+						t->name_off, id);
+			break;
+		default:
+			err = NULL;
+			break;
+		}
+		if (err)
+			goto err;
+
+		if (!btf_type_vector_append(&types, &p)) {
+			err = &drgn_enomem;
+			goto err;
+		}
+		p += sizeof(*t) + extra;
+	}
+	btf_type_vector_shrink_to_fit(&types);
+	btf->types = types.data;
+	btf->num_types = types.size;
+	return NULL;
+
+eof:
+	err = drgn_error_format(DRGN_ERROR_OTHER,
+				"BTF type %zu is truncated", types.size);
+err:
+	btf_type_vector_deinit(&types);
+	return err;
+}
+
+/* Validate the header of BTF data and index its types. */
+static struct drgn_error *drgn_btf_init_data(struct drgn_btf *btf,
+					     size_t size, const char *name)
+{
+	struct drgn_error *err;
+	struct btf_header hdr;
+	const char *types_start;
+
+	if (size < sizeof(hdr)) {
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "%s: BTF header is truncated", name);
+	}
+	memcpy(&hdr, btf->data, sizeof(hdr));
+	if (hdr.magic != BTF_MAGIC) {
+		/* Byte-swapped BTF would also end up here. */
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "%s: invalid BTF magic", name);
+	}
+	if (hdr.version != BTF_VERSION) {
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "%s: unknown BTF version %u", name,
+					 hdr.version);
+	}
+	if (hdr.hdr_len < sizeof(hdr) || hdr.hdr_len > size ||
+	    hdr.hdr_len % 4 || hdr.type_off % 4 ||
+	    hdr.type_off > size - hdr.hdr_len ||
+	    hdr.type_len > size - hdr.hdr_len - hdr.type_off ||
+	    hdr.str_off > size - hdr.hdr_len ||
+	    hdr.str_len > size - hdr.hdr_len - hdr.str_off ||
+	    (hdr.str_len &&
+	     btf->data[hdr.hdr_len + hdr.str_off + hdr.str_len - 1])) {
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "%s: invalid BTF header", name);
+	}
+	if (!hdr.str_len) {
+		/* Every type needs at least the empty string. */
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "%s: BTF has empty string section",
+					 name);
+	}
+	btf->strings = btf->data + hdr.hdr_len + hdr.str_off;
+	btf->strings_size = hdr.str_len;
+
+	types_start = btf->data + hdr.hdr_len + hdr.type_off;
+	err = drgn_btf_index_types(btf, types_start,
+				   types_start + hdr.type_len);
+	if (err) {
+		struct drgn_error *err2;
+
+		err2 = drgn_error_format(err->code, "%s: %s", name,
+					 err->message);
+		drgn_error_destroy(err);
+		return err2;
+	}
+
+	btf->parsed = calloc(btf->num_types, sizeof(*btf->parsed));
+	if (!btf->parsed)
+		return &drgn_enomem;
+	return NULL;
+}
+
+static struct drgn_btf *drgn_btf_alloc(struct drgn_program *prog)
+{
+	struct drgn_btf *btf;
+
+	btf = calloc(1, sizeof(*btf));
+	if (!btf)
+		return NULL;
+	btf->prog = prog;
+	drgn_btf_name_map_init(&btf->names);
+	drgn_arena_init(&btf->arena);
+	return btf;
+}
+
+struct drgn_error *drgn_btf_create(struct drgn_program *prog, const char *path,
+				   struct drgn_btf **ret)
+{
+	struct drgn_error *err;
+	struct drgn_btf *btf;
+	size_t size;
+
+	btf = drgn_btf_alloc(prog);
+	if (!btf)
+		return &drgn_enomem;
+	err = read_btf_file(path, &btf->data, &size);
+	if (err)
+		goto err;
+	err = drgn_btf_init_data(btf, size, path);
+	if (err)
+		goto err;
+	*ret = btf;
+	return NULL;
+
+err:
+	drgn_btf_destroy(btf);
+	return err;
+}
+
+struct drgn_error *drgn_btf_create_from_data(struct drgn_program *prog,
+					     char *data, size_t size,
+					     const char *name,
+					     struct drgn_btf **ret)
+{
+	struct drgn_error *err;
+	struct drgn_btf *btf;
+
+	btf = drgn_btf_alloc(prog);
+	if (!btf) {
+		free(data);
+		return &drgn_enomem;
+	}
+	btf->data = data;
+	err = drgn_btf_init_data(btf, size, name);
+	if (err) {
+		drgn_btf_destroy(btf);
+		return err;
+	}
+	*ret = btf;
+	return NULL;
+}
+
+void drgn_btf_destroy(struct drgn_btf *btf)
+{
+	if (!btf)
+		return;
+	drgn_arena_deinit(&btf->arena);
+	drgn_btf_name_map_deinit(&btf->names);
+	free(btf->parsed);
+	free(btf->types);
+	free(btf->data);
+	free(btf);
+}
+
+static struct drgn_error *drgn_btf_type(struct drgn_btf *btf, uint32_t id,
+					bool can_be_incomplete_array,
+					struct drgn_qualified_type *ret);
+
+struct drgn_type_from_btf_thunk {
+	struct drgn_type_thunk thunk;
+	struct drgn_btf *btf;
+	uint32_t id;
+	bool can_be_incomplete_array;
+};
+
+static struct drgn_error *
+drgn_type_from_btf_thunk_evaluate_fn(struct drgn_type_thunk *thunk,
+				     struct drgn_qualified_type *ret)
+{
+	struct drgn_type_from_btf_thunk *t =
+		container_of(thunk, struct drgn_type_from_btf_thunk, thunk);
+
+	return drgn_btf_type(t->btf, t->id, t->can_be_incomplete_array, ret);
+}
+
+static void drgn_type_from_btf_thunk_free_fn(struct drgn_type_thunk *thunk)
+{
+	/* Thunks are allocated from drgn_btf::arena. */
+}
+
+static struct drgn_error *
+drgn_lazy_type_from_btf(struct drgn_btf *btf, uint32_t id,
+			bool can_be_incomplete_array,
+			struct drgn_lazy_type *ret)
+{
+	struct drgn_type_from_btf_thunk *thunk;
+
+	thunk = drgn_arena_alloc(&btf->arena, sizeof(*thunk));
+	if (!thunk)
+		return &drgn_enomem;
+	thunk->thunk.evaluate_fn = drgn_type_from_btf_thunk_evaluate_fn;
+	thunk->thunk.free_fn = drgn_type_from_btf_thunk_free_fn;
+	thunk->btf = btf;
+	thunk->id = id;
+	thunk->can_be_incomplete_array = can_be_incomplete_array;
+	drgn_lazy_type_init_thunk(ret, &thunk->thunk);
+	return NULL;
+}
+
+static struct drgn_error *drgn_btf_check_id(struct drgn_btf *btf, uint32_t id,
+					    uint32_t parent_id)
+{
+	if (id >= btf->num_types) {
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "BTF type %" PRIu32 " refers to invalid type %" PRIu32,
+					 parent_id, id);
+	}
+	return NULL;
+}
+
+static struct drgn_error *
+drgn_compound_type_from_btf(struct drgn_btf *btf, uint32_t id,
+			    const struct btf_type *t, struct drgn_type **ret)
+{
+	struct drgn_error *err;
+	const char *tag = drgn_btf_name(btf, t->name_off);
+	uint16_t num_members = btf_vlen(t);
+	const struct btf_member *btf_members =
+		(const struct btf_member *)(t + 1);
+	struct drgn_type_member *members;
+	struct drgn_type *type;
+	uint16_t i;
+
+	type = drgn_arena_alloc(&btf->arena, sizeof(*type));
+	members = drgn_arena_alloc_array(&btf->arena, num_members,
+					 sizeof(*members));
+	if (!type || (num_members && !members))
+		return &drgn_enomem;
+
+	for (i = 0; i < num_members; i++) {
+		struct drgn_lazy_type member_type;
+		uint64_t bit_offset, bit_field_size;
+
+		if (btf_members[i].name_off >= btf->strings_size) {
+			return drgn_error_format(DRGN_ERROR_OTHER,
+						 "BTF type %" PRIu32 " has invalid member name offset",
+						 id);
+		}
+		err = drgn_btf_check_id(btf, btf_members[i].type, id);
+		if (err)
+			return err;
+		if (btf_kind_flag(t)) {
+			bit_offset = btf_members[i].offset & 0xffffff;
+			bit_field_size = btf_members[i].offset >> 24;
+		} else {
+			bit_offset = btf_members[i].offset;
+			bit_field_size = 0;
+		}
+		/*
+		 * Flexible array members are only allowed as the last member
+		 * of a structure with more than one named member.
+		 */
+		err = drgn_lazy_type_from_btf(btf, btf_members[i].type,
+					      btf_kind(t) == BTF_KIND_STRUCT &&
+					      num_members > 1 &&
+					      i == num_members - 1,
+					      &member_type);
+		if (err)
+			return err;
+		drgn_type_member_init(&members[i], member_type,
+				      drgn_btf_name(btf,
+						    btf_members[i].name_off),
+				      bit_offset, bit_field_size);
+	}
+
+	if (btf_kind(t) == BTF_KIND_STRUCT) {
+		drgn_struct_type_init(type, tag, t->size, members, num_members,
+				      &drgn_language_c);
+	} else {
+		drgn_union_type_init(type, tag, t->size, members, num_members,
+				     &drgn_language_c);
+	}
+	*ret = type;
+	return NULL;
+}
+
+/*
+ * Find the complete definition of a forward declared type, or create an
+ * incomplete type if there is none.
+ */
+static struct drgn_error *
+drgn_declaration_from_btf(struct drgn_btf *btf, uint32_t id,
+			  const struct btf_type *t, enum drgn_btf_namespace ns,
+			  struct drgn_qualified_type *ret)
+{
+	const char *tag = drgn_btf_name(btf, t->name_off);
+	struct drgn_type *type;
+
+	if (tag) {
+		struct drgn_btf_name_key key = {
+			.name = { tag, strlen(tag) },
+			.ns = ns,
+		};
+		struct drgn_btf_name_map_iterator it;
+
+		it = drgn_btf_name_map_search(&btf->names, &key);
+		if (it.entry && it.entry->value != id &&
+		    !drgn_btf_is_declaration(btf, it.entry->value))
+			return drgn_btf_type(btf, it.entry->value, false, ret);
+	}
+
+	type = drgn_arena_alloc(&btf->arena, sizeof(*type));
+	if (!type)
+		return &drgn_enomem;
+	switch (ns) {
+	case DRGN_BTF_NAMESPACE_STRUCT:
+		drgn_struct_type_init_incomplete(type, tag, &drgn_language_c);
+		break;
+	case DRGN_BTF_NAMESPACE_UNION:
+		drgn_union_type_init_incomplete(type, tag, &drgn_language_c);
+		break;
+	case DRGN_BTF_NAMESPACE_ENUM:
+		drgn_enum_type_init_incomplete(type, tag, &drgn_language_c);
+		break;
+	default:
+		UNREACHABLE();
+	}
+	ret->type = type;
+	ret->qualifiers = 0;
+	return NULL;
+}
+
+static struct drgn_error *
+drgn_enum_type_from_btf(struct drgn_btf *btf, uint32_t id,
+			const struct btf_type *t, struct drgn_type **ret)
+{
+	struct drgn_error *err;
+	const char *tag = drgn_btf_name(btf, t->name_off);
+	uint16_t num_enumerators = btf_vlen(t);
+	struct drgn_type_enumerator *enumerators;
+	struct drgn_type *type, *compatible_type;
+	/* Newer kernels set the kind flag for signed enumerated types. */
+	bool is_signed = btf_kind_flag(t);
+	enum drgn_primitive_type primitive;
+	uint16_t i;
+
+	type = drgn_arena_alloc(&btf->arena, sizeof(*type));
+	enumerators = drgn_arena_alloc_array(&btf->arena, num_enumerators,
+					     sizeof(*enumerators));
+	if (!type || !enumerators)
+		return &drgn_enomem;
+
+	/*
+	 * Older kernels don't set the kind flag, so assume that the type is
+	 * signed if any value is negative.
+	 */
+	if (btf_kind(t) == BTF_KIND_ENUM && !is_signed) {
+		const struct btf_enum *e = (const struct btf_enum *)(t + 1);
+
+		for (i = 0; i < num_enumerators; i++) {
+			if (e[i].val < 0) {
+				is_signed = true;
+				break;
+			}
+		}
+	}
+
+	for (i = 0; i < num_enumerators; i++) {
+		const char *name;
+		int64_t svalue;
+
+		if (btf_kind(t) == BTF_KIND_ENUM) {
+			const struct btf_enum *e =
+				&((const struct btf_enum *)(t + 1))[i];
+
+			name = drgn_btf_name(btf, e->name_off);
+			svalue = is_signed ? e->val : (uint32_t)e->val;
+		} else {
+			const struct btf_enum64 *e =
+				&((const struct btf_enum64 *)(t + 1))[i];
+
+			name = drgn_btf_name(btf, e->name_off);
+			svalue = ((uint64_t)e->val_hi32 << 32) | e->val_lo32;
+		}
+		if (!name) {
+			return drgn_error_format(DRGN_ERROR_OTHER,
+						 "BTF type %" PRIu32 " has enumerator without name",
+						 id);
+		}
+		drgn_type_enumerator_init_signed(&enumerators[i], name,
+						 svalue);
+	}
+
+	switch (t->size) {
+	case 1:
+		primitive = is_signed ? DRGN_C_TYPE_SIGNED_CHAR :
+			    DRGN_C_TYPE_UNSIGNED_CHAR;
+		break;
+	case 2:
+		primitive = is_signed ? DRGN_C_TYPE_SHORT :
+			    DRGN_C_TYPE_UNSIGNED_SHORT;
+		break;
+	case 4:
+		primitive = is_signed ? DRGN_C_TYPE_INT :
+			    DRGN_C_TYPE_UNSIGNED_INT;
+		break;
+	case 8:
+		primitive = is_signed ? DRGN_C_TYPE_LONG_LONG :
+			    DRGN_C_TYPE_UNSIGNED_LONG_LONG;
+		break;
+	default:
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "BTF type %" PRIu32 " has unsupported enum size %" PRIu32,
+					 id, t->size);
+	}
+	err = drgn_type_index_find_primitive(&btf->prog->tindex, primitive,
+					     &compatible_type);
+	if (err)
+		return err;
+	if (drgn_type_size(compatible_type) != t->size) {
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "BTF type %" PRIu32 " has no compatible integer type",
+					 id);
+	}
+
+	drgn_enum_type_init(type, tag, compatible_type, enumerators,
+			    num_enumerators, &drgn_language_c);
+	*ret = type;
+	return NULL;
+}
+
+static struct drgn_error *
+drgn_function_type_from_btf(struct drgn_btf *btf, uint32_t id,
+			    const struct btf_type *t, struct drgn_type **ret)
+{
+	struct drgn_error *err;
+	const struct btf_param *btf_params = (const struct btf_param *)(t + 1);
+	size_t num_parameters = btf_vlen(t);
+	struct drgn_type_parameter *parameters;
+	struct drgn_qualified_type return_type;
+	struct drgn_type *type;
+	bool is_variadic = false;
+	size_t i;
+
+	/* A variadic function has a final parameter with type void. */
+	if (num_parameters && !btf_params[num_parameters - 1].type) {
+		is_variadic = true;
+		num_parameters--;
+	}
+
+	err = drgn_btf_check_id(btf, t->type, id);
+	if (err)
+		return err;
+	err = drgn_btf_type(btf, t->type, true, &return_type);
+	if (err)
+		return err;
+
+	type = drgn_arena_alloc(&btf->arena, sizeof(*type));
+	parameters = drgn_arena_alloc_array(&btf->arena, num_parameters,
+					    sizeof(*parameters));
+	if (!type || (num_parameters && !parameters))
+		return &drgn_enomem;
+	for (i = 0; i < num_parameters; i++) {
+		struct drgn_lazy_type parameter_type;
+
+		if (btf_params[i].name_off >= btf->strings_size) {
+			return drgn_error_format(DRGN_ERROR_OTHER,
+						 "BTF type %" PRIu32 " has invalid parameter name offset",
+						 id);
+		}
+		err = drgn_btf_check_id(btf, btf_params[i].type, id);
+		if (err)
+			return err;
+		err = drgn_lazy_type_from_btf(btf, btf_params[i].type, true,
+					      &parameter_type);
+		if (err)
+			return err;
+		drgn_type_parameter_init(&parameters[i], parameter_type,
+					 drgn_btf_name(btf,
+						       btf_params[i].name_off));
+	}
+	drgn_function_type_init(type, return_type, parameters, num_parameters,
+				is_variadic, &drgn_language_c);
+	*ret = type;
+	return NULL;
+}
+
+static struct drgn_error *
+drgn_btf_type_internal(struct drgn_btf *btf, uint32_t id,
+		       bool can_be_incomplete_array, bool *cacheable,
+		       struct drgn_qualified_type *ret)
+{
+	struct drgn_error *err;
+	const struct btf_type *t = drgn_btf_type_at(btf, id);
+	const char *name = drgn_btf_name(btf, t->name_off);
+	struct drgn_type *type;
+
+	ret->qualifiers = 0;
+	switch (btf_kind(t)) {
+	case BTF_KIND_INT:
+	case BTF_KIND_FLOAT: {
+		uint32_t encoding;
+
+		if (!name) {
+			return drgn_error_format(DRGN_ERROR_OTHER,
+						 "BTF type %" PRIu32 " has no name",
+						 id);
+		}
+		type = drgn_arena_alloc(&btf->arena, sizeof(*type));
+		if (!type)
+			return &drgn_enomem;
+		if (btf_kind(t) == BTF_KIND_FLOAT) {
+			drgn_float_type_init(type, name, t->size,
+					     &drgn_language_c);
+			break;
+		}
+		memcpy(&encoding, t + 1, sizeof(encoding));
+		encoding >>= 24;
+		if (encoding & BTF_INT_BOOL) {
+			drgn_bool_type_init(type, name, t->size,
+					    &drgn_language_c);
+		} else {
+			drgn_int_type_init(type, name, t->size,
+					   encoding & BTF_INT_SIGNED,
+					   &drgn_language_c);
+		}
+		break;
+	}
+	case BTF_KIND_PTR: {
+		struct drgn_qualified_type referenced_type;
+
+		err = drgn_btf_check_id(btf, t->type, id);
+		if (err)
+			return err;
+		err = drgn_btf_type(btf, t->type, true, &referenced_type);
+		if (err)
+			return err;
+		err = drgn_type_index_pointer_type(&btf->prog->tindex,
+						   referenced_type,
+						   &drgn_language_c, &type);
+		if (err)
+			return err;
+		break;
+	}
+	case BTF_KIND_ARRAY: {
+		const struct btf_array *array = (const struct btf_array *)(t + 1);
+		struct drgn_qualified_type element_type;
+
+		err = drgn_btf_check_id(btf, array->type, id);
+		if (err)
+			return err;
+		err = drgn_btf_type(btf, array->type, false, &element_type);
+		if (err)
+			return err;
+		/*
+		 * BTF doesn't distinguish between flexible and zero-length
+		 * arrays, so the result depends on where the type is used.
+		 */
+		if (!array->nelems)
+			*cacheable = false;
+		if (!array->nelems && can_be_incomplete_array) {
+			err = drgn_type_index_incomplete_array_type(&btf->prog->tindex,
+								    element_type,
+								    &drgn_language_c,
+								    &type);
+		} else {
+			err = drgn_type_index_array_type(&btf->prog->tindex,
+							 array->nelems,
+							 element_type,
+							 &drgn_language_c,
+							 &type);
+		}
+		if (err)
+			return err;
+		break;
+	}
+	case BTF_KIND_STRUCT:
+	case BTF_KIND_UNION:
+		err = drgn_compound_type_from_btf(btf, id, t, &type);
+		if (err)
+			return err;
+		break;
+	case BTF_KIND_FWD:
+		return drgn_declaration_from_btf(btf, id, t,
+						 btf_kind_flag(t) ?
+						 DRGN_BTF_NAMESPACE_UNION :
+						 DRGN_BTF_NAMESPACE_STRUCT,
+						 ret);
+	case BTF_KIND_ENUM:
+	case BTF_KIND_ENUM64:
+		if (!btf_vlen(t)) {
+			return drgn_declaration_from_btf(btf, id, t,
+							 DRGN_BTF_NAMESPACE_ENUM,
+							 ret);
+		}
+		err = drgn_enum_type_from_btf(btf, id, t, &type);
+		if (err)
+			return err;
+		break;
+	case BTF_KIND_TYPEDEF: {
+		struct drgn_qualified_type aliased_type;
+
+		if (!name) {
+			return drgn_error_format(DRGN_ERROR_OTHER,
+						 "BTF type %" PRIu32 " has no name",
+						 id);
+		}
+		err = drgn_btf_check_id(btf, t->type, id);
+		if (err)
+			return err;
+		err = drgn_btf_type(btf, t->type, can_be_incomplete_array,
+				    &aliased_type);
+		if (err)
+			return err;
+		type = drgn_arena_alloc(&btf->arena, sizeof(*type));
+		if (!type)
+			return &drgn_enomem;
+		drgn_typedef_type_init(type, name, aliased_type,
+				       &drgn_language_c);
+		break;
+	}
+	case BTF_KIND_VOLATILE:
+	case BTF_KIND_CONST:
+	case BTF_KIND_RESTRICT:
+	case BTF_KIND_TYPE_TAG:
+		err = drgn_btf_check_id(btf, t->type, id);
+		if (err)
+			return err;
+		err = drgn_btf_type(btf, t->type, can_be_incomplete_array,
+				    ret);
+		if (err)
+			return err;
+		if (btf_kind(t) == BTF_KIND_VOLATILE)
+			ret->qualifiers |= DRGN_QUALIFIER_VOLATILE;
+		else if (btf_kind(t) == BTF_KIND_CONST)
+			ret->qualifiers |= DRGN_QUALIFIER_CONST;
+		else if (btf_kind(t) == BTF_KIND_RESTRICT)
+			ret->qualifiers |= DRGN_QUALIFIER_RESTRICT;
+		return NULL;
+	case BTF_KIND_FUNC:
+		err = drgn_btf_check_id(btf, t->type, id);
+		if (err)
+			return err;
+		if (btf_kind(drgn_btf_type_at(btf, t->type)) !=
+		    BTF_KIND_FUNC_PROTO) {
+			return drgn_error_format(DRGN_ERROR_OTHER,
+						 "BTF function %" PRIu32 " does not refer to a prototype",
+						 id);
+		}
+		return drgn_btf_type(btf, t->type, true, ret);
+	case BTF_KIND_FUNC_PROTO:
+		err = drgn_function_type_from_btf(btf, id, t, &type);
+		if (err)
+			return err;
+		break;
+	default:
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "BTF type %" PRIu32 " is not a type",
+					 id);
+	}
+	ret->type = type;
+	return NULL;
+}
+
+/* Get the type with the given ID, parsing it if necessary. */
+static struct drgn_error *drgn_btf_type(struct drgn_btf *btf, uint32_t id,
+					bool can_be_incomplete_array,
+					struct drgn_qualified_type *ret)
+{
+	struct drgn_error *err;
+	bool cacheable = true;
+
+	if (!id) {
+		ret->type = drgn_void_type(&drgn_language_c);
+		ret->qualifiers = 0;
+		return NULL;
+	}
+	if (btf->parsed[id].type) {
+		*ret = btf->parsed[id];
+		return NULL;
+	}
+
+	if (btf->depth >= 1000) {
+		return drgn_error_create(DRGN_ERROR_RECURSION,
+					 "maximum BTF type parsing depth exceeded");
+	}
+	btf->depth++;
+	err = drgn_btf_type_internal(btf, id, can_be_incomplete_array,
+				     &cacheable, ret);
+	btf->depth--;
+	if (!err && cacheable)
+		btf->parsed[id] = *ret;
+	return err;
+}
+
+struct drgn_error *drgn_btf_type_find(enum drgn_type_kind kind,
+				      const char *name, size_t name_len,
+				      const char *filename, void *arg,
+				      struct drgn_qualified_type *ret)
+{
+	struct drgn_error *err;
+	struct drgn_btf *btf = arg;
+	struct drgn_btf_name_key key = {
+		.name = { name, name_len },
+	};
+	struct drgn_btf_name_map_iterator it;
+
+	/* BTF doesn't record source files. */
+	if (filename)
+		return &drgn_not_found;
+
+	switch (kind) {
+	case DRGN_TYPE_INT:
+	case DRGN_TYPE_BOOL:
+	case DRGN_TYPE_FLOAT:
+	case DRGN_TYPE_TYPEDEF:
+		key.ns = DRGN_BTF_NAMESPACE_ORDINARY;
+		break;
+	case DRGN_TYPE_STRUCT:
+		key.ns = DRGN_BTF_NAMESPACE_STRUCT;
+		break;
+	case DRGN_TYPE_UNION:
+		key.ns = DRGN_BTF_NAMESPACE_UNION;
+		break;
+	case DRGN_TYPE_ENUM:
+		key.ns = DRGN_BTF_NAMESPACE_ENUM;
+		break;
+	default:
+		return &drgn_not_found;
+	}
+
+	it = drgn_btf_name_map_search(&btf->names, &key);
+	if (!it.entry)
+		return &drgn_not_found;
+	err = drgn_btf_type(btf, it.entry->value, true, ret);
+	if (err)
+		return err;
+	if (drgn_type_kind(ret->type) != kind)
+		return &drgn_not_found;
+	return NULL;
+}
+
+static struct drgn_error *drgn_btf_symbol_address(struct drgn_btf *btf,
+						  const char *name,
+						  uint64_t *ret)
+{
+	struct drgn_error *err;
+	struct drgn_kallsyms *kallsyms;
+	const struct drgn_kallsyms_symbol *sym;
+
+	if ((btf->prog->flags &
+	     (DRGN_PROGRAM_IS_LINUX_KERNEL | DRGN_PROGRAM_IS_LIVE)) !=
+	    (DRGN_PROGRAM_IS_LINUX_KERNEL | DRGN_PROGRAM_IS_LIVE))
+		goto not_found;
+
+	err = drgn_program_get_kallsyms(btf->prog, &kallsyms);
+	if (err)
+		return err;
+	/* BTF only describes vmlinux. */
+	sym = drgn_kallsyms_find_by_name(kallsyms, name);
+	if (!sym || sym->module)
+		goto not_found;
+	*ret = sym->address;
+	return NULL;
+
+not_found:
+	return drgn_error_format(DRGN_ERROR_LOOKUP,
+				 "could not find address of '%s'", name);
+}
+
+struct drgn_error *
+drgn_btf_object_find(const char *name, size_t name_len, const char *filename,
+		     enum drgn_find_object_flags flags, void *arg,
+		     struct drgn_object *ret)
+{
+	struct drgn_error *err;
+	struct drgn_btf *btf = arg;
+	struct drgn_btf_name_key key = {
+		.name = { name, name_len },
+		.ns = DRGN_BTF_NAMESPACE_OBJECT,
+	};
+	struct drgn_btf_name_map_iterator it;
+	const struct btf_type *t;
+	const char *symbol;
+	struct drgn_qualified_type qualified_type;
+	uint64_t address;
+
+	if (filename)
+		return &drgn_not_found;
+
+	it = drgn_btf_name_map_search(&btf->names, &key);
+	if (!it.entry)
+		return &drgn_not_found;
+	/* Unlike name, this is null-terminated. */
+	symbol = it.entry->key.name.str;
+	t = drgn_btf_type_at(btf, it.entry->value);
+	switch (btf_kind(t)) {
+	case BTF_KIND_ENUM:
+	case BTF_KIND_ENUM64: {
+		const struct drgn_type_enumerator *enumerators;
+		size_t num_enumerators, i;
+
+		if (!(flags & DRGN_FIND_OBJECT_CONSTANT))
+			return &drgn_not_found;
+		err = drgn_btf_type(btf, it.entry->value, true,
+				    &qualified_type);
+		if (err)
+			return err;
+		enumerators = drgn_type_enumerators(qualified_type.type);
+		num_enumerators = drgn_type_num_enumerators(qualified_type.type);
+		for (i = 0; i < num_enumerators; i++) {
+			if (strlen(enumerators[i].name) != name_len ||
+			    memcmp(enumerators[i].name, name, name_len) != 0)
+				continue;
+			if (drgn_enum_type_is_signed(qualified_type.type)) {
+				return drgn_object_set_signed(ret,
+							      qualified_type,
+							      enumerators[i].svalue,
+							      0);
+			} else {
+				return drgn_object_set_unsigned(ret,
+								qualified_type,
+								enumerators[i].uvalue,
+								0);
+			}
+		}
+		UNREACHABLE();
+	}
+	case BTF_KIND_FUNC:
+		if (!(flags & DRGN_FIND_OBJECT_FUNCTION))
+			return &drgn_not_found;
+		err = drgn_btf_type(btf, it.entry->value, true,
+				    &qualified_type);
+		break;
+	case BTF_KIND_VAR:
+		if (!(flags & DRGN_FIND_OBJECT_VARIABLE))
+			return &drgn_not_found;
+		err = drgn_btf_check_id(btf, t->type, it.entry->value);
+		if (err)
+			return err;
+		err = drgn_btf_type(btf, t->type, true, &qualified_type);
+		break;
+	default:
+		UNREACHABLE();
+	}
+	if (err)
+		return err;
+
+	err = drgn_btf_symbol_address(btf, symbol, &address);
+	if (err)
+		return err;
+	return drgn_object_set_reference(ret, qualified_type, address, 0, 0,
+					 DRGN_PROGRAM_ENDIAN);
+}
+
+struct drgn_error *drgn_btf_type_by_id(struct drgn_btf *btf, uint32_t id,
+				       struct drgn_qualified_type *ret)
+{
+	if (id >= btf->num_types) {
+		return drgn_error_format(DRGN_ERROR_LOOKUP,
+					 "BTF type %" PRIu32 " does not exist",
+					 id);
+	}
+	return drgn_btf_type(btf, id, true, ret);
+}
+
+const char *drgn_btf_type_name(struct drgn_btf *btf, uint32_t id)
+{
+	if (!id || id >= btf->num_types)
+		return NULL;
+	return drgn_btf_name(btf, drgn_btf_type_at(btf, id)->name_off);
+}
@@ -0,0 +1,159 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * BTF type information.
+ *
+ * See @ref BTF.
+ */
+
+#ifndef DRGN_BTF_H
+#define DRGN_BTF_H
+
+#include "arena.h"
+#include "drgn.h"
+#include "hash_table.h"
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup BTF BTF
+ *
+ * Types and objects from BPF Type Format information.
+ *
+ * The Linux kernel can be built with a compact, deduplicated description of
+ * its types in BTF, which it exports in @c /sys/kernel/btf/vmlinux. @ref
+ * drgn_btf parses that into @ref drgn_type "drgn_types" on demand. BTF doesn't
+ * include the addresses of functions or variables, so those are looked up in @c
+ * /proc/kallsyms (see @ref Kallsyms).
+ *
+ * @{
+ */
+
+/** Namespace of a name in @ref drgn_btf::names. */
+enum drgn_btf_namespace {
+	DRGN_BTF_NAMESPACE_STRUCT,
+	DRGN_BTF_NAMESPACE_UNION,
+	DRGN_BTF_NAMESPACE_ENUM,
+	/** Typedefs and base types. */
+	DRGN_BTF_NAMESPACE_ORDINARY,
+	/** Functions, variables, and enumerators. */
+	DRGN_BTF_NAMESPACE_OBJECT,
+};
+
+/** Key of @ref drgn_btf::names. */
+struct drgn_btf_name_key {
+	struct string name;
+	enum drgn_btf_namespace ns;
+};
+
+DEFINE_HASH_MAP_TYPE(drgn_btf_name_map, struct drgn_btf_name_key, uint32_t);
+
+/**
+ * BTF type information.
+ *
+ * This is the argument for @ref drgn_btf_type_find() and @ref
+ * drgn_btf_object_find().
+ */
+struct drgn_btf {
+	struct drgn_program *prog;
+	/** Raw BTF data. */
+	char *data;
+	/** String section. */
+	const char *strings;
+	uint32_t strings_size;
+	/**
+	 * Pointer to each type, indexed by type ID. Entry 0 (the void type) is
+	 * @c NULL.
+	 */
+	const char **types;
+	/** Number of type IDs, including the void type. */
+	uint32_t num_types;
+	/**
+	 * Parsed types, indexed by type ID. Entries which haven't been parsed
+	 * yet have a @c NULL type.
+	 */
+	struct drgn_qualified_type *parsed;
+	/**
+	 * Type ID of each name.
+	 *
+	 * For enumerators, this is the ID of the enumerated type. If a
+	 * structure or union is only forward declared, this is the ID of the
+	 * declaration.
+	 */
+	struct drgn_btf_name_map names;
+	/** Memory for parsed types, their members and parameters, and thunks. */
+	struct drgn_arena arena;
+	/** Current parsing recursion depth. */
+	int depth;
+};
+
+/**
+ * Create a @ref drgn_btf from a file.
+ *
+ * @param[in] prog Program that the types will be used by.
+ * @param[in] path Path of the raw BTF file.
+ * @param[out] ret Returned BTF information.
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *drgn_btf_create(struct drgn_program *prog, const char *path,
+				   struct drgn_btf **ret);
+
+/**
+ * Create a @ref drgn_btf from raw BTF data in memory.
+ *
+ * @param[in] prog Program that the types will be used by.
+ * @param[in] data Raw BTF data allocated with @c malloc(). This takes
+ * ownership of it, even on error.
+ * @param[in] size Size of @p data.
+ * @param[in] name Name of the data to use in error messages.
+ * @param[out] ret Returned BTF information.
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *drgn_btf_create_from_data(struct drgn_program *prog,
+					     char *data, size_t size,
+					     const char *name,
+					     struct drgn_btf **ret);
+
+/** Destroy a @ref drgn_btf. */
+void drgn_btf_destroy(struct drgn_btf *btf);
+
+/** @ref drgn_type_find_fn() that uses BTF. */
+struct drgn_error *drgn_btf_type_find(enum drgn_type_kind kind,
+				      const char *name, size_t name_len,
+				      const char *filename, void *arg,
+				      struct drgn_qualified_type *ret);
+
+/**
+ * @ref drgn_object_find_fn() that uses BTF for types and @c /proc/kallsyms for
+ * addresses.
+ */
+struct drgn_error *
+drgn_btf_object_find(const char *name, size_t name_len, const char *filename,
+		     enum drgn_find_object_flags flags, void *arg,
+		     struct drgn_object *ret);
+
+/**
+ * Get the type with the given BTF type ID, parsing it if it hasn't been parsed
+ * yet.
+ *
+ * @param[out] ret Returned type. Functions (@c BTF_KIND_FUNC) are returned as
+ * their function type.
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *drgn_btf_type_by_id(struct drgn_btf *btf, uint32_t id,
+				       struct drgn_qualified_type *ret);
+
+/**
+ * Get the name of the type (or function or variable) with the given BTF type
+ * ID without parsing it.
+ *
+ * @return The name, or @c NULL if it is anonymous or the ID is not valid.
+ */
+const char *drgn_btf_type_name(struct drgn_btf *btf, uint32_t id);
+
+/** @} */
+
+#endif /* DRGN_BTF_H */
@@ -63,6 +63,7 @@ def gen_constants(input_file, output_file):
 #include "drgnpy.h"
 
 PyObject *Architecture_class;
+PyObject *FindNameFlags_class;
 PyObject *FindObjectFlags_class;
 PyObject *PrimitiveType_class;
 PyObject *PlatformFlags_class;
@@ -74,6 +75,13 @@ PyObject *TypeKind_class;
     gen_constant_class(
         drgn_h, output_file, "Architecture", "Enum", r"DRGN_ARCH_([a-zA-Z0-9_]+)"
     )
+    gen_constant_class(
+        drgn_h,
+        output_file,
+        "FindNameFlags",
+        "Flag",
+        r"DRGN_FIND_NAME_([a-zA-Z0-9_]+)",
+    )
     gen_constant_class(
         drgn_h,
         output_file,
@@ -116,6 +124,7 @@ int add_module_constants(PyObject *m)
 		return -1;
 
 	if (add_Architecture(m, enum_module) == -1 ||
+	    add_FindNameFlags(m, enum_module) == -1 ||
 	    add_FindObjectFlags(m, enum_module) == -1 ||
 	    add_PrimitiveType(m, enum_module) == -1 ||
 	    add_PlatformFlags(m, enum_module) == -1 ||
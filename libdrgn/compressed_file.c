@@ -0,0 +1,1439 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <lzma.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef WITH_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "compressed_file.h"
+#include "internal.h"
+#include "read.h"
+#include "vector.h"
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_decompressed_chunk_map, hash_pair_int_type,
+			    hash_table_scalar_eq)
+DEFINE_VECTOR(drgn_compressed_frame_vector, struct drgn_compressed_frame)
+
+#define ZSTD_FRAME_MAGIC UINT32_C(0xfd2fb528)
+#define ZSTD_SEEKABLE_MAGIC UINT32_C(0x8f92eab1)
+#define ZSTD_SEEK_TABLE_MAGIC UINT32_C(0x184d2a5e)
+#define LZ4_FRAME_MAGIC UINT32_C(0x184d2204)
+#define LZ4_LEGACY_MAGIC UINT32_C(0x184c2102)
+/* zstd and LZ4 share the skippable frame format. */
+#define SKIPPABLE_MAGIC UINT32_C(0x184d2a50)
+#define SKIPPABLE_MAGIC_MASK UINT32_C(0xfffffff0)
+
+static const char xz_magic[6] = { 0xfd, '7', 'z', 'X', 'Z', 0 };
+
+/* The formats are all little-endian. */
+static const bool bswap = __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__;
+
+/* Size of the buffer that the decoder reads input into. */
+#define DRGN_COMPRESSED_IN_BUF_SIZE (128 * 1024)
+
+static const char *
+drgn_compression_format_name(enum drgn_compression_format format)
+{
+	switch (format) {
+	case DRGN_COMPRESSION_ZSTD:
+		return "zstd";
+	case DRGN_COMPRESSION_LZ4:
+		return "LZ4";
+	case DRGN_COMPRESSION_XZ:
+		return "xz";
+	default:
+		UNREACHABLE();
+	}
+}
+
+/* Read up to @p count bytes, stopping early only at the end of the file. */
+static struct drgn_error *pread_all(int fd, const char *path, void *buf,
+				    size_t count, uint64_t offset,
+				    size_t *ret)
+{
+	char *p = buf;
+
+	*ret = 0;
+	while (count) {
+		ssize_t sret;
+
+		sret = pread(fd, p, count, offset);
+		if (sret == -1) {
+			if (errno == EINTR)
+				continue;
+			return drgn_error_create_os("pread", errno, path);
+		} else if (sret == 0) {
+			break;
+		}
+		p += sret;
+		count -= sret;
+		offset += sret;
+		*ret += sret;
+	}
+	return NULL;
+}
+
+static struct drgn_error *compressed_file_truncated(void)
+{
+	return drgn_error_create(DRGN_ERROR_OTHER,
+				 "compressed file is truncated");
+}
+
+static struct drgn_error *compressed_file_invalid(struct drgn_compressed_file *file)
+{
+	return drgn_error_format(DRGN_ERROR_OTHER, "invalid %s file",
+				 drgn_compression_format_name(file->format));
+}
+
+/* Read exactly @p count bytes from the compressed file. */
+static struct drgn_error *
+compressed_file_pread(struct drgn_compressed_file *file, void *buf,
+		      size_t count, uint64_t offset)
+{
+	struct drgn_error *err;
+	size_t n;
+
+	err = pread_all(file->fd, NULL, buf, count, offset, &n);
+	if (err)
+		return err;
+	if (n < count)
+		return compressed_file_truncated();
+	return NULL;
+}
+
+struct drgn_error *
+drgn_compression_format_detect(int fd, const char *path,
+			       enum drgn_compression_format *ret)
+{
+	struct drgn_error *err;
+	char buf[sizeof(xz_magic)];
+	const char *p = buf;
+	size_t n;
+	uint32_t magic;
+
+	err = pread_all(fd, path, buf, sizeof(buf), 0, &n);
+	if (err)
+		return err;
+	*ret = DRGN_COMPRESSION_NONE;
+	if (!read_u32(&p, buf + n, bswap, &magic))
+		return NULL;
+	if (magic == ZSTD_FRAME_MAGIC)
+		*ret = DRGN_COMPRESSION_ZSTD;
+	else if (magic == LZ4_FRAME_MAGIC || magic == LZ4_LEGACY_MAGIC)
+		*ret = DRGN_COMPRESSION_LZ4;
+	else if (n == sizeof(xz_magic) && memcmp(buf, xz_magic, n) == 0)
+		*ret = DRGN_COMPRESSION_XZ;
+	return NULL;
+}
+
+/*
+ * Decoders. Each format implements creating and destroying its decoder state,
+ * starting a frame, and decompressing some of the current frame from the input
+ * buffer.
+ */
+
+#ifdef WITH_ZSTD
+static struct drgn_error *drgn_error_zstd(size_t code)
+{
+	return drgn_error_format(DRGN_ERROR_OTHER,
+				 "could not decompress zstd data: %s",
+				 ZSTD_getErrorName(code));
+}
+
+static struct drgn_error *zstd_decoder_create(struct drgn_compressed_file *file)
+{
+	ZSTD_DCtx *dctx;
+	ZSTD_bounds bounds;
+
+	dctx = ZSTD_createDCtx();
+	if (!dctx)
+		return &drgn_enomem;
+	/* Allow frames compressed with --long. */
+	bounds = ZSTD_dParam_getBounds(ZSTD_d_windowLogMax);
+	if (!ZSTD_isError(bounds.error))
+		ZSTD_DCtx_setParameter(dctx, ZSTD_d_windowLogMax,
+				       bounds.upperBound);
+	file->decoder = dctx;
+	return NULL;
+}
+
+static struct drgn_error *
+zstd_decoder_begin(struct drgn_compressed_file *file,
+		   const struct drgn_compressed_frame *frame)
+{
+	size_t code;
+
+	code = ZSTD_DCtx_reset(file->decoder, ZSTD_reset_session_only);
+	if (ZSTD_isError(code))
+		return drgn_error_zstd(code);
+	return NULL;
+}
+
+static struct drgn_error *zstd_decoder_step(struct drgn_compressed_file *file,
+					    char *buf, size_t size,
+					    size_t *ret, bool *done_ret)
+{
+	ZSTD_inBuffer in = { file->in_buf, file->in_size, file->in_pos };
+	ZSTD_outBuffer out = { buf, size, 0 };
+	size_t code;
+
+	code = ZSTD_decompressStream(file->decoder, &out, &in);
+	if (ZSTD_isError(code))
+		return drgn_error_zstd(code);
+	file->in_pos = in.pos;
+	*ret = out.pos;
+	*done_ret = code == 0;
+	return NULL;
+}
+
+static void zstd_decoder_destroy(struct drgn_compressed_file *file)
+{
+	ZSTD_freeDCtx(file->decoder);
+}
+#endif
+
+#ifdef WITH_LZ4
+static struct drgn_error *drgn_error_lz4(size_t code)
+{
+	return drgn_error_format(DRGN_ERROR_OTHER,
+				 "could not decompress LZ4 data: %s",
+				 LZ4F_getErrorName(code));
+}
+
+static struct drgn_error *lz4_decoder_create(struct drgn_compressed_file *file)
+{
+	LZ4F_dctx *dctx;
+	size_t code;
+
+	code = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+	if (LZ4F_isError(code))
+		return drgn_error_lz4(code);
+	file->decoder = dctx;
+	return NULL;
+}
+
+static struct drgn_error *
+lz4_decoder_begin(struct drgn_compressed_file *file,
+		  const struct drgn_compressed_frame *frame)
+{
+	LZ4F_resetDecompressionContext(file->decoder);
+	return NULL;
+}
+
+static struct drgn_error *lz4_decoder_step(struct drgn_compressed_file *file,
+					   char *buf, size_t size, size_t *ret,
+					   bool *done_ret)
+{
+	size_t dst_size = size, src_size = file->in_size - file->in_pos;
+	size_t code;
+
+	code = LZ4F_decompress(file->decoder, buf, &dst_size,
+			       file->in_buf + file->in_pos, &src_size, NULL);
+	if (LZ4F_isError(code))
+		return drgn_error_lz4(code);
+	file->in_pos += src_size;
+	*ret = dst_size;
+	*done_ret = code == 0;
+	return NULL;
+}
+
+static void lz4_decoder_destroy(struct drgn_compressed_file *file)
+{
+	LZ4F_freeDecompressionContext(file->decoder);
+}
+#endif
+
+static struct drgn_error *drgn_error_lzma(lzma_ret ret)
+{
+	switch (ret) {
+	case LZMA_MEM_ERROR:
+		return &drgn_enomem;
+	case LZMA_FORMAT_ERROR:
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "file is not in the xz format");
+	case LZMA_OPTIONS_ERROR:
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "unsupported xz options");
+	case LZMA_DATA_ERROR:
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "xz data is corrupt");
+	case LZMA_BUF_ERROR:
+		return compressed_file_truncated();
+	default:
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "could not decompress xz data: liblzma error %d",
+					 (int)ret);
+	}
+}
+
+struct xz_decoder {
+	lzma_stream strm;
+	/* The block decoder refers to these until it is reinitialized. */
+	lzma_block block;
+	lzma_filter filters[LZMA_FILTERS_MAX + 1];
+};
+
+static void xz_decoder_free_filters(struct xz_decoder *xz)
+{
+	size_t i;
+
+	for (i = 0; i < LZMA_FILTERS_MAX &&
+	     xz->filters[i].id != LZMA_VLI_UNKNOWN; i++) {
+		free(xz->filters[i].options);
+		xz->filters[i].options = NULL;
+	}
+	xz->filters[0].id = LZMA_VLI_UNKNOWN;
+}
+
+static struct drgn_error *xz_decoder_create(struct drgn_compressed_file *file)
+{
+	static const lzma_stream strm_init = LZMA_STREAM_INIT;
+	struct xz_decoder *xz;
+
+	xz = calloc(1, sizeof(*xz));
+	if (!xz)
+		return &drgn_enomem;
+	xz->strm = strm_init;
+	xz->filters[0].id = LZMA_VLI_UNKNOWN;
+	file->decoder = xz;
+	return NULL;
+}
+
+static struct drgn_error *
+xz_decoder_begin(struct drgn_compressed_file *file,
+		 const struct drgn_compressed_frame *frame)
+{
+	struct drgn_error *err;
+	struct xz_decoder *xz = file->decoder;
+	uint8_t header[LZMA_BLOCK_HEADER_SIZE_MAX];
+	lzma_ret ret;
+
+	/* The block header comes before the compressed data. */
+	err = compressed_file_pread(file, header, 1, frame->compressed_offset);
+	if (err)
+		return err;
+	xz_decoder_free_filters(xz);
+	memset(&xz->block, 0, sizeof(xz->block));
+	xz->block.version = 1;
+	xz->block.check = frame->check;
+	xz->block.filters = xz->filters;
+	xz->block.header_size = lzma_block_header_size_decode(header[0]);
+	if (header[0] == 0 || xz->block.header_size > frame->compressed_size)
+		return compressed_file_invalid(file);
+	err = compressed_file_pread(file, header + 1,
+				    xz->block.header_size - 1,
+				    frame->compressed_offset + 1);
+	if (err)
+		return err;
+	ret = lzma_block_header_decode(&xz->block, NULL, header);
+	if (ret != LZMA_OK)
+		return drgn_error_lzma(ret);
+	ret = lzma_block_decoder(&xz->strm, &xz->block);
+	if (ret != LZMA_OK)
+		return drgn_error_lzma(ret);
+	file->in_offset += xz->block.header_size;
+	return NULL;
+}
+
+static struct drgn_error *xz_decoder_step(struct drgn_compressed_file *file,
+					  char *buf, size_t size, size_t *ret,
+					  bool *done_ret)
+{
+	struct xz_decoder *xz = file->decoder;
+	lzma_ret lret;
+
+	xz->strm.next_in = (const uint8_t *)file->in_buf + file->in_pos;
+	xz->strm.avail_in = file->in_size - file->in_pos;
+	xz->strm.next_out = (uint8_t *)buf;
+	xz->strm.avail_out = size;
+	lret = lzma_code(&xz->strm, LZMA_RUN);
+	file->in_pos = file->in_size - xz->strm.avail_in;
+	*ret = size - xz->strm.avail_out;
+	*done_ret = lret == LZMA_STREAM_END;
+	if (lret != LZMA_OK && lret != LZMA_STREAM_END &&
+	    /* We check for progress ourselves. */
+	    lret != LZMA_BUF_ERROR)
+		return drgn_error_lzma(lret);
+	return NULL;
+}
+
+static void xz_decoder_destroy(struct drgn_compressed_file *file)
+{
+	struct xz_decoder *xz = file->decoder;
+
+	lzma_end(&xz->strm);
+	xz_decoder_free_filters(xz);
+	free(xz);
+}
+
+static struct drgn_error *decoder_create(struct drgn_compressed_file *file)
+{
+	switch (file->format) {
+#ifdef WITH_ZSTD
+	case DRGN_COMPRESSION_ZSTD:
+		return zstd_decoder_create(file);
+#endif
+#ifdef WITH_LZ4
+	case DRGN_COMPRESSION_LZ4:
+		return lz4_decoder_create(file);
+#endif
+	case DRGN_COMPRESSION_XZ:
+		return xz_decoder_create(file);
+	default:
+		return drgn_error_format(DRGN_ERROR_INVALID_ARGUMENT,
+					 "drgn was built without %s support",
+					 drgn_compression_format_name(file->format));
+	}
+}
+
+static void decoder_destroy(struct drgn_compressed_file *file)
+{
+	if (!file->decoder)
+		return;
+	switch (file->format) {
+#ifdef WITH_ZSTD
+	case DRGN_COMPRESSION_ZSTD:
+		zstd_decoder_destroy(file);
+		break;
+#endif
+#ifdef WITH_LZ4
+	case DRGN_COMPRESSION_LZ4:
+		lz4_decoder_destroy(file);
+		break;
+#endif
+	case DRGN_COMPRESSION_XZ:
+		xz_decoder_destroy(file);
+		break;
+	default:
+		UNREACHABLE();
+	}
+}
+
+/* Start decompressing a frame. */
+static struct drgn_error *
+decoder_begin(struct drgn_compressed_file *file,
+	      const struct drgn_compressed_frame *frame)
+{
+	struct drgn_error *err;
+
+	file->cur_frame = file->num_frames;
+	file->in_offset = frame->compressed_offset;
+	file->in_end = frame->compressed_offset + frame->compressed_size;
+	file->in_pos = file->in_size = 0;
+	switch (file->format) {
+#ifdef WITH_ZSTD
+	case DRGN_COMPRESSION_ZSTD:
+		err = zstd_decoder_begin(file, frame);
+		break;
+#endif
+#ifdef WITH_LZ4
+	case DRGN_COMPRESSION_LZ4:
+		err = lz4_decoder_begin(file, frame);
+		break;
+#endif
+	case DRGN_COMPRESSION_XZ:
+		err = xz_decoder_begin(file, frame);
+		break;
+	default:
+		UNREACHABLE();
+	}
+	if (err)
+		return err;
+	file->cur_offset = frame->offset;
+	file->decoder_done = false;
+	file->stats->decompressions++;
+	return NULL;
+}
+
+/*
+ * Decompress up to @p size bytes of the current frame. This only returns fewer
+ * than @p size bytes at the end of the frame. On error, the decoder must be
+ * started again with decoder_begin().
+ */
+static struct drgn_error *decoder_read(struct drgn_compressed_file *file,
+				       char *buf, size_t size, size_t *ret)
+{
+	struct drgn_error *err;
+	size_t pos = 0;
+
+	while (pos < size && !file->decoder_done) {
+		size_t in_pos = file->in_pos, n;
+
+		if (file->in_pos == file->in_size &&
+		    file->in_offset < file->in_end) {
+			size_t in_size = min(file->in_end - file->in_offset,
+					     (uint64_t)DRGN_COMPRESSED_IN_BUF_SIZE);
+
+			err = compressed_file_pread(file, file->in_buf,
+						    in_size, file->in_offset);
+			if (err)
+				goto err;
+			file->in_offset += in_size;
+			file->in_pos = in_pos = 0;
+			file->in_size = in_size;
+		}
+		switch (file->format) {
+#ifdef WITH_ZSTD
+		case DRGN_COMPRESSION_ZSTD:
+			err = zstd_decoder_step(file, buf + pos, size - pos,
+						&n, &file->decoder_done);
+			break;
+#endif
+#ifdef WITH_LZ4
+		case DRGN_COMPRESSION_LZ4:
+			err = lz4_decoder_step(file, buf + pos, size - pos,
+					       &n, &file->decoder_done);
+			break;
+#endif
+		case DRGN_COMPRESSION_XZ:
+			err = xz_decoder_step(file, buf + pos, size - pos, &n,
+					      &file->decoder_done);
+			break;
+		default:
+			UNREACHABLE();
+		}
+		if (err)
+			goto err;
+		pos += n;
+		/*
+		 * If the decoder didn't do anything and there's no more input,
+		 * then the frame was cut off.
+		 */
+		if (!n && file->in_pos == in_pos && !file->decoder_done &&
+		    file->in_pos == file->in_size &&
+		    file->in_offset == file->in_end) {
+			err = compressed_file_truncated();
+			goto err;
+		}
+	}
+	file->cur_offset += pos;
+	file->stats->decompressed_bytes += pos;
+	*ret = pos;
+	return NULL;
+
+err:
+	file->cur_frame = file->num_frames;
+	return err;
+}
+
+/* Get the decompressed size of a frame by decompressing it. */
+static struct drgn_error *
+decompressed_frame_size(struct drgn_compressed_file *file,
+			struct drgn_compressed_frame *frame)
+{
+	struct drgn_error *err;
+	size_t n;
+
+	err = decoder_begin(file, frame);
+	if (err)
+		return err;
+	do {
+		err = decoder_read(file, file->skip_buf,
+				   DRGN_DECOMPRESSED_CHUNK_SIZE, &n);
+		if (err)
+			return err;
+	} while (n == DRGN_DECOMPRESSED_CHUNK_SIZE);
+	frame->size = file->cur_offset - frame->offset;
+	return NULL;
+}
+
+/*
+ * Append a frame to the index. The decompressed offset is filled in from the
+ * previous frame. If the frame's size isn't known, it is decompressed to find
+ * it.
+ */
+static struct drgn_error *
+append_frame(struct drgn_compressed_file *file,
+	     struct drgn_compressed_frame_vector *frames,
+	     uint64_t compressed_offset, uint64_t compressed_size,
+	     bool size_known, uint64_t size)
+{
+	struct drgn_error *err;
+	struct drgn_compressed_frame frame = {
+		.compressed_offset = compressed_offset,
+		.compressed_size = compressed_size,
+		.size = size,
+	};
+
+	if (frames->size) {
+		const struct drgn_compressed_frame *prev =
+			&frames->data[frames->size - 1];
+
+		frame.offset = prev->offset + prev->size;
+	}
+	if (!size_known) {
+		err = decompressed_frame_size(file, &frame);
+		if (err)
+			return err;
+	}
+	/* Empty frames never need to be read. */
+	if (frame.size && !drgn_compressed_frame_vector_append(frames, &frame))
+		return &drgn_enomem;
+	return NULL;
+}
+
+/*
+ * Read the seek table at the end of a file in the zstd seekable format. If
+ * there isn't one, this succeeds without adding any frames.
+ */
+static struct drgn_error *
+zstd_read_seek_table(struct drgn_compressed_file *file,
+		     struct drgn_compressed_frame_vector *frames)
+{
+	struct drgn_error *err;
+	char footer[9], *table;
+	const char *p = footer, *end;
+	uint32_t num_frames, magic, frame_magic, frame_size;
+	uint8_t descriptor;
+	uint64_t entry_size, table_size, compressed_offset = 0;
+
+	if (file->compressed_size < sizeof(footer) + 8)
+		return NULL;
+	err = compressed_file_pread(file, footer, sizeof(footer),
+				    file->compressed_size - sizeof(footer));
+	if (err)
+		return err;
+	read_u32(&p, footer + sizeof(footer), bswap, &num_frames);
+	read_u8(&p, footer + sizeof(footer), &descriptor);
+	read_u32(&p, footer + sizeof(footer), bswap, &magic);
+	if (magic != ZSTD_SEEKABLE_MAGIC)
+		return NULL;
+
+	/* Each entry optionally has a checksum, which we don't need. */
+	entry_size = descriptor & 0x80 ? 12 : 8;
+	table_size = num_frames * entry_size + 8;
+	if (table_size > file->compressed_size - sizeof(footer) ||
+	    table_size > SIZE_MAX)
+		return compressed_file_invalid(file);
+	table = malloc(table_size);
+	if (!table)
+		return &drgn_enomem;
+	err = compressed_file_pread(file, table, table_size,
+				    file->compressed_size - sizeof(footer) -
+				    table_size);
+	if (err)
+		goto out;
+	p = table;
+	end = table + table_size;
+	read_u32(&p, end, bswap, &frame_magic);
+	read_u32(&p, end, bswap, &frame_size);
+	if (frame_magic != ZSTD_SEEK_TABLE_MAGIC ||
+	    frame_size != table_size - 8 + sizeof(footer)) {
+		err = compressed_file_invalid(file);
+		goto out;
+	}
+	while (p < end) {
+		uint32_t compressed_size, size;
+
+		read_u32(&p, end, bswap, &compressed_size);
+		read_u32(&p, end, bswap, &size);
+		p += entry_size - 8;
+		err = append_frame(file, frames, compressed_offset,
+				   compressed_size, true, size);
+		if (err)
+			goto out;
+		compressed_offset += compressed_size;
+	}
+	err = NULL;
+out:
+	free(table);
+	return err;
+}
+
+/*
+ * Build the index of a zstd file by walking the frame and block headers. Only
+ * frames which don't record their content size need to be decompressed.
+ */
+static struct drgn_error *zstd_walk_frames(struct drgn_compressed_file *file,
+					   struct drgn_compressed_frame_vector *frames)
+{
+	static const size_t dictionary_id_sizes[] = { 0, 1, 2, 4 };
+	struct drgn_error *err;
+	uint64_t offset = 0;
+
+	while (offset < file->compressed_size) {
+		char header[18];
+		const char *p = header, *end;
+		uint32_t magic;
+		uint8_t descriptor, block_header[3];
+		size_t content_size_size, header_size, i;
+		uint64_t content_size = 0, block_offset;
+		bool single_segment;
+
+		end = header + min(file->compressed_size - offset,
+				   (uint64_t)sizeof(header));
+		err = compressed_file_pread(file, header, end - header,
+					    offset);
+		if (err)
+			return err;
+		if (!read_u32(&p, end, bswap, &magic))
+			return compressed_file_truncated();
+		if ((magic & SKIPPABLE_MAGIC_MASK) == SKIPPABLE_MAGIC) {
+			uint32_t skip;
+
+			if (!read_u32(&p, end, bswap, &skip))
+				return compressed_file_truncated();
+			offset += 8 + (uint64_t)skip;
+			continue;
+		}
+		if (magic != ZSTD_FRAME_MAGIC)
+			return compressed_file_invalid(file);
+		if (!read_u8(&p, end, &descriptor))
+			return compressed_file_truncated();
+		/* Bit 3 is reserved. */
+		if (descriptor & 0x8)
+			return compressed_file_invalid(file);
+		single_segment = descriptor & 0x20;
+		if (descriptor >> 6)
+			content_size_size = 1 << (descriptor >> 6);
+		else
+			content_size_size = single_segment;
+		header_size = (5 + !single_segment +
+			       dictionary_id_sizes[descriptor & 3]);
+		if (header_size + content_size_size > (size_t)(end - header))
+			return compressed_file_truncated();
+		for (i = 0; i < content_size_size; i++) {
+			content_size |= ((uint64_t)(uint8_t)header[header_size + i]
+					 << (8 * i));
+		}
+		if (content_size_size == 2)
+			content_size += 256;
+
+		block_offset = offset + header_size + content_size_size;
+		do {
+			uint32_t block_size;
+
+			if (file->compressed_size - block_offset < 3)
+				return compressed_file_truncated();
+			err = compressed_file_pread(file, block_header,
+						    sizeof(block_header),
+						    block_offset);
+			if (err)
+				return err;
+			block_size = (block_header[0] >> 3 |
+				      (uint32_t)block_header[1] << 5 |
+				      (uint32_t)block_header[2] << 13);
+			switch ((block_header[0] >> 1) & 3) {
+			case 0: /* Raw. */
+			case 2: /* Compressed. */
+				block_offset += 3 + block_size;
+				break;
+			case 1: /* RLE: one byte repeated block_size times. */
+				block_offset += 4;
+				break;
+			default:
+				return compressed_file_invalid(file);
+			}
+			if (block_offset > file->compressed_size)
+				return compressed_file_truncated();
+		} while (!(block_header[0] & 1));
+		/* Content checksum. */
+		if (descriptor & 0x4)
+			block_offset += 4;
+		if (block_offset > file->compressed_size)
+			return compressed_file_truncated();
+
+		err = append_frame(file, frames, offset, block_offset - offset,
+				   content_size_size != 0, content_size);
+		if (err)
+			return err;
+		offset = block_offset;
+	}
+	return NULL;
+}
+
+/* Build the index of an LZ4 file by walking the frame and block headers. */
+static struct drgn_error *lz4_walk_frames(struct drgn_compressed_file *file,
+					  struct drgn_compressed_frame_vector *frames)
+{
+	struct drgn_error *err;
+	uint64_t offset = 0;
+
+	while (offset < file->compressed_size) {
+		char header[19];
+		const char *p = header, *end;
+		uint32_t magic;
+		uint8_t flags, block_descriptor;
+		uint64_t content_size = 0, block_offset;
+
+		end = header + min(file->compressed_size - offset,
+				   (uint64_t)sizeof(header));
+		err = compressed_file_pread(file, header, end - header,
+					    offset);
+		if (err)
+			return err;
+		if (!read_u32(&p, end, bswap, &magic))
+			return compressed_file_truncated();
+		if ((magic & SKIPPABLE_MAGIC_MASK) == SKIPPABLE_MAGIC) {
+			uint32_t skip;
+
+			if (!read_u32(&p, end, bswap, &skip))
+				return compressed_file_truncated();
+			offset += 8 + (uint64_t)skip;
+			continue;
+		}
+		if (magic == LZ4_LEGACY_MAGIC) {
+			return drgn_error_create(DRGN_ERROR_OTHER,
+						 "legacy LZ4 format is not supported");
+		}
+		if (magic != LZ4_FRAME_MAGIC)
+			return compressed_file_invalid(file);
+		if (!read_u8(&p, end, &flags) ||
+		    !read_u8(&p, end, &block_descriptor))
+			return compressed_file_truncated();
+		if ((flags >> 6) != 1)
+			return compressed_file_invalid(file);
+		/* Content size. */
+		if ((flags & 0x8) && !read_u64(&p, end, bswap, &content_size))
+			return compressed_file_truncated();
+		/* Dictionary ID. */
+		if (flags & 0x1)
+			p += 4;
+		/* Header checksum. */
+		p += 1;
+		if (p > end)
+			return compressed_file_truncated();
+
+		block_offset = offset + (p - header);
+		for (;;) {
+			char size_buf[4];
+			const char *q = size_buf;
+			uint32_t block_size;
+
+			if (file->compressed_size - block_offset < 4)
+				return compressed_file_truncated();
+			err = compressed_file_pread(file, size_buf,
+						    sizeof(size_buf),
+						    block_offset);
+			if (err)
+				return err;
+			read_u32(&q, size_buf + sizeof(size_buf), bswap,
+				 &block_size);
+			block_offset += 4;
+			/* End mark. */
+			if (!block_size)
+				break;
+			/* The high bit means that the block is uncompressed. */
+			block_offset += block_size & UINT32_C(0x7fffffff);
+			/* Block checksum. */
+			if (flags & 0x10)
+				block_offset += 4;
+			if (block_offset > file->compressed_size)
+				return compressed_file_truncated();
+		}
+		/* Content checksum. */
+		if (flags & 0x4)
+			block_offset += 4;
+		if (block_offset > file->compressed_size)
+			return compressed_file_truncated();
+
+		err = append_frame(file, frames, offset, block_offset - offset,
+				   flags & 0x8, content_size);
+		if (err)
+			return err;
+		offset = block_offset;
+	}
+	return NULL;
+}
+
+/* Read the index of an xz file. Each block is a frame. */
+static struct drgn_error *xz_read_index(struct drgn_compressed_file *file,
+					struct drgn_compressed_frame_vector *frames)
+{
+	struct drgn_error *err;
+	lzma_stream strm = LZMA_STREAM_INIT;
+	lzma_index *index = NULL;
+	lzma_index_iter iter;
+	lzma_ret ret;
+	uint64_t pos = 0;
+
+	ret = lzma_file_info_decoder(&strm, &index, UINT64_MAX,
+				     file->compressed_size);
+	if (ret != LZMA_OK)
+		return drgn_error_lzma(ret);
+	for (;;) {
+		if (!strm.avail_in) {
+			size_t n = min(file->compressed_size - pos,
+				       (uint64_t)DRGN_COMPRESSED_IN_BUF_SIZE);
+
+			err = compressed_file_pread(file, file->in_buf, n, pos);
+			if (err)
+				goto out;
+			pos += n;
+			strm.next_in = (const uint8_t *)file->in_buf;
+			strm.avail_in = n;
+		}
+		ret = lzma_code(&strm, LZMA_RUN);
+		if (ret == LZMA_STREAM_END)
+			break;
+		if (ret == LZMA_SEEK_NEEDED) {
+			pos = strm.seek_pos;
+			strm.avail_in = 0;
+		} else if (ret != LZMA_OK) {
+			err = drgn_error_lzma(ret);
+			goto out;
+		}
+	}
+
+	lzma_index_iter_init(&iter, index);
+	while (!lzma_index_iter_next(&iter, LZMA_INDEX_ITER_NONEMPTY_BLOCK)) {
+		struct drgn_compressed_frame *frame;
+
+		frame = drgn_compressed_frame_vector_append_entry(frames);
+		if (!frame) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		frame->compressed_offset = iter.block.compressed_file_offset;
+		frame->compressed_size = iter.block.total_size;
+		frame->offset = iter.block.uncompressed_file_offset;
+		frame->size = iter.block.uncompressed_size;
+		frame->check = iter.stream.flags->check;
+	}
+	err = NULL;
+out:
+	lzma_index_end(index, NULL);
+	lzma_end(&strm);
+	return err;
+}
+
+/*
+ * Frame index cache file format. Like the DWARF index cache, this is only read
+ * by the same build of drgn on the same machine that wrote it, so everything is
+ * in native byte order. The file consists of the header followed by the
+ * entries. It is named after the device and inode number of the compressed
+ * file, and the header records the size and modification time of the file to
+ * detect when it changed.
+ */
+#define DRGN_FRAME_INDEX_CACHE_MAGIC "DRGNFRM"
+#define DRGN_FRAME_INDEX_CACHE_VERSION 1
+#define DRGN_FRAME_INDEX_CACHE_BYTE_ORDER UINT32_C(0x01020304)
+
+struct drgn_frame_index_cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint64_t format;
+	uint64_t file_size;
+	uint64_t mtime_sec;
+	uint64_t mtime_nsec;
+	uint64_t num_frames;
+};
+
+struct drgn_frame_index_cache_entry {
+	uint64_t compressed_offset;
+	uint64_t compressed_size;
+	uint64_t offset;
+	uint64_t size;
+};
+
+static void frame_index_cache_header_init(struct drgn_frame_index_cache_header *header,
+					  struct drgn_compressed_file *file,
+					  const struct stat *st)
+{
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, DRGN_FRAME_INDEX_CACHE_MAGIC,
+	       sizeof(header->magic));
+	header->version = DRGN_FRAME_INDEX_CACHE_VERSION;
+	header->byte_order = DRGN_FRAME_INDEX_CACHE_BYTE_ORDER;
+	header->format = file->format;
+	header->file_size = st->st_size;
+	header->mtime_sec = st->st_mtim.tv_sec;
+	header->mtime_nsec = st->st_mtim.tv_nsec;
+}
+
+static char *frame_index_cache_path(const char *dir, const struct stat *st,
+				    const char *suffix)
+{
+	char *path;
+
+	if (asprintf(&path, "%s/%" PRIx64 "-%" PRIx64 ".frames%s", dir,
+		     (uint64_t)st->st_dev, (uint64_t)st->st_ino, suffix) == -1)
+		return NULL;
+	return path;
+}
+
+/*
+ * Load the frame index of a file from the cache. If it isn't cached or is
+ * stale, this succeeds without adding any frames.
+ */
+static struct drgn_error *
+read_frame_index_cache(struct drgn_compressed_file *file, const char *dir,
+		       const struct stat *st,
+		       struct drgn_compressed_frame_vector *frames)
+{
+	struct drgn_error *err;
+	struct drgn_frame_index_cache_header header, expected;
+	struct drgn_frame_index_cache_entry *entries = NULL;
+	char *path;
+	int fd;
+	size_t n;
+	uint64_t i;
+
+	path = frame_index_cache_path(dir, st, "");
+	if (!path)
+		return &drgn_enomem;
+	fd = open(path, O_RDONLY);
+	free(path);
+	if (fd == -1)
+		return NULL;
+	err = pread_all(fd, NULL, &header, sizeof(header), 0, &n);
+	if (err || n < sizeof(header))
+		goto out;
+	frame_index_cache_header_init(&expected, file, st);
+	expected.num_frames = header.num_frames;
+	if (memcmp(&header, &expected, sizeof(header)) != 0 ||
+	    header.num_frames > SIZE_MAX / sizeof(*entries))
+		goto out;
+	entries = malloc_array(header.num_frames, sizeof(*entries));
+	if (!entries && header.num_frames)
+		goto out;
+	err = pread_all(fd, NULL, entries, header.num_frames * sizeof(*entries),
+			sizeof(header), &n);
+	if (err || n < header.num_frames * sizeof(*entries))
+		goto out;
+	if (!drgn_compressed_frame_vector_reserve(frames, header.num_frames)) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	for (i = 0; i < header.num_frames; i++) {
+		struct drgn_compressed_frame *frame =
+			drgn_compressed_frame_vector_append_entry(frames);
+
+		frame->compressed_offset = entries[i].compressed_offset;
+		frame->compressed_size = entries[i].compressed_size;
+		frame->offset = entries[i].offset;
+		frame->size = entries[i].size;
+		frame->check = 0;
+	}
+out:
+	/* The cache is only an optimization, so ignore errors reading it. */
+	if (err && err->code != DRGN_ERROR_NO_MEMORY) {
+		drgn_error_destroy(err);
+		err = NULL;
+	}
+	free(entries);
+	close(fd);
+	return err;
+}
+
+/*
+ * Save the frame index of a file in the cache. The cache is only an
+ * optimization, so this fails silently.
+ */
+static void write_frame_index_cache(struct drgn_compressed_file *file,
+				    char *dir, const struct stat *st,
+				    const struct drgn_compressed_frame_vector *frames)
+{
+	struct drgn_frame_index_cache_header header;
+	char *path = NULL, *tmp_path = NULL;
+	size_t i;
+	int fd;
+	FILE *f;
+	bool ok;
+
+	if (!mkdir_parents(dir))
+		return;
+	path = frame_index_cache_path(dir, st, "");
+	tmp_path = frame_index_cache_path(dir, st, ".XXXXXX");
+	if (!path || !tmp_path)
+		goto out;
+	fd = mkstemp(tmp_path);
+	if (fd == -1)
+		goto out;
+	f = fdopen(fd, "w");
+	if (!f) {
+		close(fd);
+		unlink(tmp_path);
+		goto out;
+	}
+
+	frame_index_cache_header_init(&header, file, st);
+	header.num_frames = frames->size;
+	ok = fwrite(&header, sizeof(header), 1, f) == 1;
+	for (i = 0; ok && i < frames->size; i++) {
+		struct drgn_frame_index_cache_entry entry = {
+			.compressed_offset = frames->data[i].compressed_offset,
+			.compressed_size = frames->data[i].compressed_size,
+			.offset = frames->data[i].offset,
+			.size = frames->data[i].size,
+		};
+
+		ok = fwrite(&entry, sizeof(entry), 1, f) == 1;
+	}
+	if (fclose(f) == EOF)
+		ok = false;
+	if (!ok || rename(tmp_path, path) == -1)
+		unlink(tmp_path);
+out:
+	free(tmp_path);
+	free(path);
+}
+
+/*
+ * Build the index of a file whose frames have to be walked, using the cache if
+ * possible.
+ */
+static struct drgn_error *
+walk_frames_cached(struct drgn_compressed_file *file, const struct stat *st,
+		   struct drgn_compressed_frame_vector *frames)
+{
+	struct drgn_error *err;
+	char *dir;
+
+	err = drgn_get_cache_dir("DRGN_FRAME_INDEX_CACHE_DIR", "/frame-index",
+				 &dir);
+	if (err)
+		return err;
+	if (dir) {
+		err = read_frame_index_cache(file, dir, st, frames);
+		if (err || frames->size)
+			goto out;
+	}
+	if (file->format == DRGN_COMPRESSION_ZSTD)
+		err = zstd_walk_frames(file, frames);
+	else
+		err = lz4_walk_frames(file, frames);
+	if (!err && dir)
+		write_frame_index_cache(file, dir, st, frames);
+out:
+	free(dir);
+	return err;
+}
+
+/* Check that the frames are in order and within the file. */
+static bool frames_valid(struct drgn_compressed_file *file,
+			 const struct drgn_compressed_frame_vector *frames)
+{
+	uint64_t offset = 0, compressed_end = 0;
+	size_t i;
+
+	for (i = 0; i < frames->size; i++) {
+		const struct drgn_compressed_frame *frame = &frames->data[i];
+
+		if (frame->offset != offset || !frame->size ||
+		    frame->size > UINT64_MAX - offset ||
+		    frame->compressed_offset < compressed_end ||
+		    frame->compressed_offset > file->compressed_size ||
+		    frame->compressed_size >
+		    file->compressed_size - frame->compressed_offset)
+			return false;
+		offset += frame->size;
+		compressed_end = (frame->compressed_offset +
+				  frame->compressed_size);
+	}
+	return true;
+}
+
+struct drgn_error *
+drgn_compressed_file_create(int fd, const char *path,
+			    enum drgn_compression_format format,
+			    struct drgn_memory_stats *stats,
+			    struct drgn_compressed_file **ret)
+{
+	struct drgn_error *err;
+	struct drgn_compressed_file *file;
+	struct stat st;
+	struct drgn_compressed_frame_vector frames = VECTOR_INIT;
+
+	if (fstat(fd, &st) == -1)
+		return drgn_error_create_os("fstat", errno, path);
+
+	file = calloc(1, sizeof(*file));
+	if (!file)
+		return &drgn_enomem;
+	file->fd = fd;
+	file->format = format;
+	file->compressed_size = st.st_size;
+	file->stats = stats;
+	drgn_decompressed_chunk_map_init(&file->map);
+	err = decoder_create(file);
+	if (err)
+		goto err;
+	file->in_buf = malloc(DRGN_COMPRESSED_IN_BUF_SIZE);
+	file->skip_buf = malloc(DRGN_DECOMPRESSED_CHUNK_SIZE);
+	if (!file->in_buf || !file->skip_buf) {
+		err = &drgn_enomem;
+		goto err;
+	}
+
+	switch (format) {
+	case DRGN_COMPRESSION_ZSTD:
+		err = zstd_read_seek_table(file, &frames);
+		if (!err && !frames.size)
+			err = walk_frames_cached(file, &st, &frames);
+		break;
+	case DRGN_COMPRESSION_LZ4:
+		err = walk_frames_cached(file, &st, &frames);
+		break;
+	case DRGN_COMPRESSION_XZ:
+		err = xz_read_index(file, &frames);
+		break;
+	default:
+		UNREACHABLE();
+	}
+	if (err)
+		goto err;
+	if (!frames_valid(file, &frames)) {
+		err = compressed_file_invalid(file);
+		goto err;
+	}
+	drgn_compressed_frame_vector_shrink_to_fit(&frames);
+	file->frames = frames.data;
+	file->num_frames = frames.size;
+	if (frames.size) {
+		file->size = (frames.data[frames.size - 1].offset +
+			      frames.data[frames.size - 1].size);
+	}
+	file->cur_frame = file->num_frames;
+	*ret = file;
+	return NULL;
+
+err:
+	drgn_compressed_frame_vector_deinit(&frames);
+	drgn_compressed_file_destroy(file);
+	return err;
+}
+
+static void drgn_decompressed_chunks_free(struct drgn_compressed_file *file)
+{
+	free(file->referenced);
+	free(file->keys);
+	free(file->chunks);
+	file->chunks = NULL;
+	file->keys = NULL;
+	file->referenced = NULL;
+}
+
+void drgn_compressed_file_destroy(struct drgn_compressed_file *file)
+{
+	if (!file)
+		return;
+	drgn_decompressed_chunks_free(file);
+	drgn_decompressed_chunk_map_deinit(&file->map);
+	decoder_destroy(file);
+	free(file->skip_buf);
+	free(file->in_buf);
+	free(file->frames);
+	free(file);
+}
+
+void drgn_compressed_file_set_cache_capacity(struct drgn_compressed_file *file,
+					     size_t capacity)
+{
+	drgn_decompressed_chunks_free(file);
+	drgn_decompressed_chunk_map_deinit(&file->map);
+	drgn_decompressed_chunk_map_init(&file->map);
+	file->capacity = capacity;
+}
+
+size_t drgn_compressed_file_memory_usage(struct drgn_compressed_file *file)
+{
+	size_t size;
+
+	size = (sizeof(*file) + file->num_frames * sizeof(file->frames[0]) +
+		DRGN_COMPRESSED_IN_BUF_SIZE + DRGN_DECOMPRESSED_CHUNK_SIZE +
+		drgn_decompressed_chunk_map_memory_usage(&file->map));
+	if (file->chunks) {
+		size += file->capacity * (DRGN_DECOMPRESSED_CHUNK_SIZE +
+					  sizeof(file->keys[0]) +
+					  sizeof(file->referenced[0]));
+	}
+	return size;
+}
+
+/* Find the frame containing an offset, which must be within the file. */
+static size_t compressed_file_find_frame(struct drgn_compressed_file *file,
+					 uint64_t offset)
+{
+	size_t lo = 0, hi = file->num_frames;
+
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (file->frames[mid].offset <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+ * Decompress a range of the file. The decoder continues from where it is if it
+ * is in the right frame and hasn't passed the start of the range. Otherwise, it
+ * starts over from the beginning of the frame. Either way, the output before
+ * the range is thrown away.
+ */
+static struct drgn_error *decompress_range(struct drgn_compressed_file *file,
+					   char *buf, uint64_t offset,
+					   size_t count)
+{
+	struct drgn_error *err;
+
+	while (count) {
+		size_t i = compressed_file_find_frame(file, offset);
+		const struct drgn_compressed_frame *frame = &file->frames[i];
+		size_t wanted, n;
+
+		if (file->cur_frame != i || file->cur_offset > offset) {
+			err = decoder_begin(file, frame);
+			if (err)
+				return err;
+			file->cur_frame = i;
+		}
+		while (file->cur_offset < offset) {
+			err = decoder_read(file, file->skip_buf,
+					   min(offset - file->cur_offset,
+					       DRGN_DECOMPRESSED_CHUNK_SIZE),
+					   &n);
+			if (err)
+				return err;
+			if (!n)
+				goto short_frame;
+		}
+		wanted = min((uint64_t)count,
+			     frame->offset + frame->size - offset);
+		err = decoder_read(file, buf, wanted, &n);
+		if (err)
+			return err;
+		if (n < wanted)
+			goto short_frame;
+		buf += n;
+		offset += n;
+		count -= n;
+	}
+	return NULL;
+
+short_frame:
+	file->cur_frame = file->num_frames;
+	return drgn_error_format(DRGN_ERROR_OTHER,
+				 "%s frame is shorter than expected",
+				 drgn_compression_format_name(file->format));
+}
+
+static bool drgn_decompressed_chunks_alloc(struct drgn_compressed_file *file)
+{
+	size_t i;
+
+	file->chunks = malloc_array(file->capacity,
+				    DRGN_DECOMPRESSED_CHUNK_SIZE);
+	file->keys = malloc_array(file->capacity, sizeof(*file->keys));
+	file->referenced = calloc(file->capacity, sizeof(*file->referenced));
+	if (!file->chunks || !file->keys || !file->referenced) {
+		drgn_decompressed_chunks_free(file);
+		return false;
+	}
+	for (i = 0; i < file->capacity; i++)
+		file->keys[i] = DRGN_DECOMPRESSED_CHUNK_EMPTY;
+	file->hand = 0;
+	return true;
+}
+
+/*
+ * Get the contents of the chunk at @p chunk, decompressing it if necessary. If
+ * the chunk can't be cached, this succeeds and returns @c NULL in @p ret, and
+ * the caller should decompress the range it needs directly.
+ */
+static struct drgn_error *
+drgn_decompressed_chunk_get(struct drgn_compressed_file *file, uint64_t chunk,
+			    const char **ret)
+{
+	struct drgn_error *err;
+	struct drgn_decompressed_chunk_map_entry entry = {
+		.key = chunk,
+	};
+	struct hash_pair hp;
+	struct drgn_decompressed_chunk_map_iterator it;
+	size_t slot;
+	char *contents;
+
+	*ret = NULL;
+	hp = drgn_decompressed_chunk_map_hash(&chunk);
+	it = drgn_decompressed_chunk_map_search_hashed(&file->map, &chunk, hp);
+	if (it.entry) {
+		slot = it.entry->value;
+		file->stats->decompression_cache_hits++;
+		file->referenced[slot] = true;
+		*ret = &file->chunks[slot * DRGN_DECOMPRESSED_CHUNK_SIZE];
+		return NULL;
+	}
+
+	if (!file->chunks && !drgn_decompressed_chunks_alloc(file))
+		return NULL;
+	while (file->referenced[file->hand]) {
+		file->referenced[file->hand] = false;
+		if (++file->hand == file->capacity)
+			file->hand = 0;
+	}
+	slot = file->hand;
+	if (++file->hand == file->capacity)
+		file->hand = 0;
+	if (file->keys[slot] != DRGN_DECOMPRESSED_CHUNK_EMPTY) {
+		drgn_decompressed_chunk_map_delete(&file->map,
+						   &file->keys[slot]);
+		file->keys[slot] = DRGN_DECOMPRESSED_CHUNK_EMPTY;
+	}
+
+	contents = &file->chunks[slot * DRGN_DECOMPRESSED_CHUNK_SIZE];
+	err = decompress_range(file, contents, chunk,
+			       min(file->size - chunk,
+				   DRGN_DECOMPRESSED_CHUNK_SIZE));
+	if (err)
+		return err;
+	entry.value = slot;
+	if (drgn_decompressed_chunk_map_insert_hashed(&file->map, &entry, hp,
+						      NULL) == 1) {
+		file->keys[slot] = chunk;
+		file->referenced[slot] = true;
+	}
+	*ret = contents;
+	return NULL;
+}
+
+struct drgn_error *drgn_compressed_file_read(struct drgn_compressed_file *file,
+					     void *buf, uint64_t offset,
+					     size_t count)
+{
+	struct drgn_error *err;
+	char *p = buf;
+
+	if (offset > file->size || count > file->size - offset)
+		return compressed_file_truncated();
+	if (!file->capacity)
+		return decompress_range(file, p, offset, count);
+	while (count) {
+		uint64_t chunk = offset & ~(DRGN_DECOMPRESSED_CHUNK_SIZE - 1);
+		size_t chunk_offset = offset - chunk;
+		size_t n = min((uint64_t)count,
+			       DRGN_DECOMPRESSED_CHUNK_SIZE - chunk_offset);
+		const char *contents;
+
+		err = drgn_decompressed_chunk_get(file, chunk, &contents);
+		if (err)
+			return err;
+		if (contents) {
+			memcpy(p, contents + chunk_offset, n);
+		} else {
+			err = decompress_range(file, p, offset, n);
+			if (err)
+				return err;
+		}
+		p += n;
+		offset += n;
+		count -= n;
+	}
+	return NULL;
+}
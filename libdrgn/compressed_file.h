@@ -0,0 +1,212 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Random access to compressed files.
+ *
+ * See @ref CompressedFile.
+ */
+
+#ifndef DRGN_COMPRESSED_FILE_H
+#define DRGN_COMPRESSED_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash_table.h"
+
+struct drgn_memory_stats;
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup CompressedFile Compressed files
+ *
+ * Random access to compressed files.
+ *
+ * A @ref drgn_compressed_file reads ranges of the decompressed contents of a
+ * file compressed with zstd, LZ4, or xz without decompressing the whole file.
+ * The file is split into frames which can be decompressed on their own (zstd
+ * and LZ4 frames and xz blocks), and a read only decompresses the frames that
+ * it touches, from the start of each frame up to the end of the read.
+ * Decompressed data is cached in fixed-size chunks.
+ *
+ * A file compressed as a single frame can still be read, but each read which
+ * isn't after the previous one has to decompress the frame from the beginning.
+ * Files written by multi-threaded xz, in the zstd seekable format, or as many
+ * concatenated zstd or LZ4 frames avoid this.
+ *
+ * @{
+ */
+
+/** Compression format of a file. */
+enum drgn_compression_format {
+	/** Not compressed or not a format that we recognize. */
+	DRGN_COMPRESSION_NONE,
+	DRGN_COMPRESSION_ZSTD,
+	DRGN_COMPRESSION_LZ4,
+	DRGN_COMPRESSION_XZ,
+};
+
+/**
+ * Determine the compression format of a file from its magic number.
+ *
+ * This succeeds even if drgn was built without support for the format.
+ *
+ * @param[in] fd File descriptor.
+ * @param[in] path Path of the file, used for error messages.
+ * @param[out] ret Returned format.
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *
+drgn_compression_format_detect(int fd, const char *path,
+			       enum drgn_compression_format *ret);
+
+/** Frame of a @ref drgn_compressed_file which can be decompressed on its own. */
+struct drgn_compressed_frame {
+	/** Offset of the frame in the compressed file. */
+	uint64_t compressed_offset;
+	/** Size of the frame in the compressed file. */
+	uint64_t compressed_size;
+	/** Offset of the contents of the frame in the decompressed file. */
+	uint64_t offset;
+	/** Size of the decompressed contents of the frame. */
+	uint64_t size;
+	/** Integrity check of an xz block. Unused for other formats. */
+	unsigned int check;
+};
+
+/** Size of the chunks cached by a @ref drgn_compressed_file. */
+#define DRGN_DECOMPRESSED_CHUNK_SIZE (UINT64_C(256) * 1024)
+
+/**
+ * Key of an empty slot in the chunk cache of a @ref drgn_compressed_file.
+ *
+ * Keys are chunk offsets, which are always multiples of @ref
+ * DRGN_DECOMPRESSED_CHUNK_SIZE, so this can never be a valid key.
+ */
+#define DRGN_DECOMPRESSED_CHUNK_EMPTY UINT64_C(1)
+
+DEFINE_HASH_MAP_TYPE(drgn_decompressed_chunk_map, uint64_t, size_t)
+
+/** File compressed with zstd, LZ4, or xz. */
+struct drgn_compressed_file {
+	/** File descriptor of the compressed file. Not owned. */
+	int fd;
+	/** Compression format. */
+	enum drgn_compression_format format;
+	/** Size of the compressed file. */
+	uint64_t compressed_size;
+	/** Size of the decompressed contents. */
+	uint64_t size;
+	/** Frames in order of offset. */
+	struct drgn_compressed_frame *frames;
+	/** Number of frames. */
+	size_t num_frames;
+	/**
+	 * Index in @ref frames of the frame that the decoder is in the middle
+	 * of, or @ref num_frames if it isn't in a frame.
+	 */
+	size_t cur_frame;
+	/** Offset in the decompressed file that the decoder is at. */
+	uint64_t cur_offset;
+	/** Whether the decoder has reached the end of its frame. */
+	bool decoder_done;
+	/** Offset in the compressed file of the next input to read. */
+	uint64_t in_offset;
+	/** End of the input of the frame that the decoder is in. */
+	uint64_t in_end;
+	/** Buffered input for the decoder. */
+	char *in_buf;
+	/** Position of the next unconsumed byte in @ref in_buf. */
+	size_t in_pos;
+	/** Number of valid bytes in @ref in_buf. */
+	size_t in_size;
+	/** Buffer that skipped output is decompressed into. */
+	char *skip_buf;
+	/** Decoder state for the format. */
+	void *decoder;
+	/** Map from chunk offset to slot index. */
+	struct drgn_decompressed_chunk_map map;
+	/**
+	 * Contents of each slot, or @c NULL if the cache hasn't been allocated
+	 * yet.
+	 */
+	char *chunks;
+	/**
+	 * Offset of the chunk in each slot, or @ref
+	 * DRGN_DECOMPRESSED_CHUNK_EMPTY.
+	 */
+	uint64_t *keys;
+	/** Reference bit of each slot. */
+	bool *referenced;
+	/** Maximum number of cached chunks. Zero if the cache is disabled. */
+	size_t capacity;
+	/** Next slot to consider for eviction. */
+	size_t hand;
+	/** Statistics to update. */
+	struct drgn_memory_stats *stats;
+};
+
+/**
+ * Open a compressed file and build its frame index.
+ *
+ * For xz and the zstd seekable format, the index is read from the end of the
+ * file. Otherwise, the frame headers are walked, and frames whose headers don't
+ * record their decompressed size are decompressed once to find it. That index
+ * is saved in @c $DRGN_FRAME_INDEX_CACHE_DIR (by default, @c frame-index in the
+ * drgn cache directory) so that opening the same file again is cheap.
+ *
+ * @param[in] fd File descriptor of the compressed file. It must stay open until
+ * the file is destroyed.
+ * @param[in] path Path of the file, used for error messages.
+ * @param[in] format Compression format returned by @ref
+ * drgn_compression_format_detect().
+ * @param[in] stats Statistics to update.
+ * @param[out] ret Returned file, which must be destroyed with @ref
+ * drgn_compressed_file_destroy().
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *
+drgn_compressed_file_create(int fd, const char *path,
+			    enum drgn_compression_format format,
+			    struct drgn_memory_stats *stats,
+			    struct drgn_compressed_file **ret);
+
+/** Destroy a @ref drgn_compressed_file. */
+void drgn_compressed_file_destroy(struct drgn_compressed_file *file);
+
+/**
+ * Set the maximum number of chunks cached by a @ref drgn_compressed_file.
+ *
+ * This discards any cached chunks. Memory for the cache is allocated the next
+ * time it is needed. If that allocation fails, reads bypass the cache.
+ *
+ * @param[in] capacity Number of chunks. Zero disables the cache.
+ */
+void drgn_compressed_file_set_cache_capacity(struct drgn_compressed_file *file,
+					     size_t capacity);
+
+/** Get the number of bytes allocated by a @ref drgn_compressed_file. */
+size_t drgn_compressed_file_memory_usage(struct drgn_compressed_file *file);
+
+/**
+ * Read from the decompressed contents of a @ref drgn_compressed_file.
+ *
+ * @param[out] buf Buffer to read into.
+ * @param[in] offset Offset in the decompressed file to read from.
+ * @param[in] count Number of bytes to read.
+ * @return @c NULL on success, non-@c NULL on error. If the range is past the
+ * end of the file, the error is a @ref DRGN_ERROR_OTHER error for a truncated
+ * file.
+ */
+struct drgn_error *drgn_compressed_file_read(struct drgn_compressed_file *file,
+					     void *buf, uint64_t offset,
+					     size_t count);
+
+/** @} */
+
+#endif /* DRGN_COMPRESSED_FILE_H */
@@ -0,0 +1,140 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <dlfcn.h>
+#include <stdlib.h>
+
+#include "debuginfod.h"
+#include "internal.h"
+
+typedef struct debuginfod_client *debuginfod_begin_fn(void);
+typedef int debuginfod_find_fn(struct debuginfod_client *client,
+			       const unsigned char *build_id,
+			       int build_id_len, char **path);
+typedef void debuginfod_end_fn(struct debuginfod_client *client);
+
+static debuginfod_begin_fn *fp_debuginfod_begin;
+static debuginfod_find_fn *fp_debuginfod_find_executable;
+static debuginfod_find_fn *fp_debuginfod_find_debuginfo;
+static debuginfod_end_fn *fp_debuginfod_end;
+static pthread_once_t debuginfod_once = PTHREAD_ONCE_INIT;
+
+/* Like libdwfl, we either get all of the functions or none of them. */
+static void debuginfod_dlopen(void)
+{
+	void *handle;
+
+	handle = dlopen("libdebuginfod.so.1", RTLD_LAZY);
+	if (!handle)
+		handle = dlopen("libdebuginfod.so", RTLD_LAZY);
+	if (!handle)
+		return;
+	fp_debuginfod_begin = dlsym(handle, "debuginfod_begin");
+	fp_debuginfod_find_executable = dlsym(handle,
+					      "debuginfod_find_executable");
+	fp_debuginfod_find_debuginfo = dlsym(handle,
+					     "debuginfod_find_debuginfo");
+	fp_debuginfod_end = dlsym(handle, "debuginfod_end");
+	if (!fp_debuginfod_begin || !fp_debuginfod_find_executable ||
+	    !fp_debuginfod_find_debuginfo || !fp_debuginfod_end) {
+		fp_debuginfod_begin = NULL;
+		fp_debuginfod_find_executable = NULL;
+		fp_debuginfod_find_debuginfo = NULL;
+		fp_debuginfod_end = NULL;
+		dlclose(handle);
+	}
+}
+
+void drgn_debuginfod_init(struct drgn_debuginfod *dbginfod)
+{
+	const char *urls, *jobs;
+	long max_clients = 8;
+
+	pthread_mutex_init(&dbginfod->lock, NULL);
+	pthread_cond_init(&dbginfod->cond, NULL);
+	dbginfod->idle = NULL;
+	dbginfod->num_idle = 0;
+	dbginfod->num_clients = 0;
+	dbginfod->max_clients = 0;
+
+	/* Don't bother loading the library if there are no servers. */
+	urls = getenv("DEBUGINFOD_URLS");
+	if (!urls || !urls[0])
+		return;
+	jobs = getenv("DRGN_DEBUGINFOD_JOBS");
+	if (jobs)
+		max_clients = atol(jobs);
+	if (max_clients <= 0)
+		return;
+	pthread_once(&debuginfod_once, debuginfod_dlopen);
+	if (!fp_debuginfod_begin)
+		return;
+	dbginfod->idle = malloc_array(max_clients, sizeof(*dbginfod->idle));
+	if (!dbginfod->idle)
+		return;
+	dbginfod->max_clients = max_clients;
+}
+
+void drgn_debuginfod_deinit(struct drgn_debuginfod *dbginfod)
+{
+	size_t i;
+
+	for (i = 0; i < dbginfod->num_idle; i++)
+		fp_debuginfod_end(dbginfod->idle[i]);
+	free(dbginfod->idle);
+	pthread_cond_destroy(&dbginfod->cond);
+	pthread_mutex_destroy(&dbginfod->lock);
+}
+
+static struct debuginfod_client *
+drgn_debuginfod_get_client(struct drgn_debuginfod *dbginfod)
+{
+	struct debuginfod_client *client;
+
+	pthread_mutex_lock(&dbginfod->lock);
+	while (!dbginfod->num_idle &&
+	       dbginfod->num_clients >= dbginfod->max_clients)
+		pthread_cond_wait(&dbginfod->cond, &dbginfod->lock);
+	if (dbginfod->num_idle) {
+		client = dbginfod->idle[--dbginfod->num_idle];
+	} else {
+		client = fp_debuginfod_begin();
+		if (client)
+			dbginfod->num_clients++;
+	}
+	pthread_mutex_unlock(&dbginfod->lock);
+	return client;
+}
+
+static void drgn_debuginfod_put_client(struct drgn_debuginfod *dbginfod,
+				       struct debuginfod_client *client)
+{
+	pthread_mutex_lock(&dbginfod->lock);
+	dbginfod->idle[dbginfod->num_idle++] = client;
+	pthread_cond_signal(&dbginfod->cond);
+	pthread_mutex_unlock(&dbginfod->lock);
+}
+
+int drgn_debuginfod_find(struct drgn_debuginfod *dbginfod,
+			 enum drgn_debuginfod_file file,
+			 const void *build_id, size_t build_id_len,
+			 char **path_ret)
+{
+	struct debuginfod_client *client;
+	debuginfod_find_fn *find;
+	int fd;
+
+	if (!drgn_debuginfod_enabled(dbginfod) || !build_id_len)
+		return -1;
+	client = drgn_debuginfod_get_client(dbginfod);
+	if (!client)
+		return -1;
+	if (file == DRGN_DEBUGINFOD_EXECUTABLE)
+		find = fp_debuginfod_find_executable;
+	else
+		find = fp_debuginfod_find_debuginfo;
+	/* This returns a negative errno on failure. */
+	fd = find(client, build_id, build_id_len, path_ret);
+	drgn_debuginfod_put_client(dbginfod, client);
+	return fd < 0 ? -1 : fd;
+}
@@ -0,0 +1,94 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Downloading debugging information with debuginfod.
+ *
+ * See @ref Debuginfod.
+ */
+
+#ifndef DRGN_DEBUGINFOD_H
+#define DRGN_DEBUGINFOD_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup Debuginfod Debuginfod
+ *
+ * Downloading debugging information with debuginfod.
+ *
+ * libdebuginfod is loaded with @c dlopen() if it is installed, so it is not a
+ * hard dependency. It is only used if @c $DEBUGINFOD_URLS is set.
+ *
+ * A @c debuginfod_client may only be used by one thread at a time, so a @ref
+ * drgn_debuginfod keeps a pool of clients. The size of the pool bounds the
+ * number of concurrent downloads.
+ *
+ * @{
+ */
+
+struct debuginfod_client;
+
+/** Kind of file to download. */
+enum drgn_debuginfod_file {
+	/** The executable or shared library itself. */
+	DRGN_DEBUGINFOD_EXECUTABLE,
+	/** The separate debug file. */
+	DRGN_DEBUGINFOD_DEBUGINFO,
+};
+
+/** Pool of debuginfod clients. */
+struct drgn_debuginfod {
+	pthread_mutex_t lock;
+	/** Signaled when a client is returned to the pool. */
+	pthread_cond_t cond;
+	/** Idle clients. */
+	struct debuginfod_client **idle;
+	size_t num_idle;
+	/** Number of clients that have been created. */
+	size_t num_clients;
+	/**
+	 * Maximum number of clients, or 0 if debuginfod is disabled.
+	 *
+	 * This is @c $DRGN_DEBUGINFOD_JOBS if it is set, otherwise 8.
+	 */
+	size_t max_clients;
+};
+
+/** Initialize a @ref drgn_debuginfod. This never fails. */
+void drgn_debuginfod_init(struct drgn_debuginfod *dbginfod);
+
+/** Deinitialize a @ref drgn_debuginfod. */
+void drgn_debuginfod_deinit(struct drgn_debuginfod *dbginfod);
+
+/** Return whether debuginfod can be used. */
+static inline bool drgn_debuginfod_enabled(struct drgn_debuginfod *dbginfod)
+{
+	return dbginfod->max_clients > 0;
+}
+
+/**
+ * Download a file by build ID, or get it from the debuginfod client cache if it
+ * was already downloaded.
+ *
+ * This is thread-safe. If all of the clients in the pool are busy, this waits
+ * for one to become available.
+ *
+ * @param[out] path_ret Path of the file in the debuginfod client cache, which
+ * must be freed with @c free().
+ * @return File descriptor, or -1 if the file could not be found.
+ */
+int drgn_debuginfod_find(struct drgn_debuginfod *dbginfod,
+			 enum drgn_debuginfod_file file,
+			 const void *build_id, size_t build_id_len,
+			 char **path_ret);
+
+/** @} */
+
+#endif /* DRGN_DEBUGINFOD_H */
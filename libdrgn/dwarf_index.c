@@ -3,27 +3,39 @@
 
 #include <assert.h>
 #include <dwarf.h>
+#include <errno.h>
 #include <elfutils/libdw.h>
 #include <elfutils/libdwelf.h>
+#include <endian.h>
 #include <fcntl.h>
+#include <fnmatch.h>
 #include <gelf.h>
 #include <inttypes.h>
 #include <libelf.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
 #include "internal.h"
 #include "dwarf_index.h"
+#include "line_table.h"
+#include "orc.h"
 #include "read.h"
 #include "siphash.h"
 #include "string_builder.h"
+#include "usdt.h"
 
 DEFINE_VECTOR_FUNCTIONS(dwfl_module_vector)
+DEFINE_VECTOR_FUNCTIONS(drgn_dwarf_index_die_module_vector)
+DEFINE_VECTOR_FUNCTIONS(drgn_dwarf_index_split_unit_vector)
 DEFINE_VECTOR_FUNCTIONS(drgn_dwarf_module_vector)
+DEFINE_VECTOR_FUNCTIONS(drgn_dwarf_index_deferred_file_vector)
+DEFINE_VECTOR_FUNCTIONS(drgn_debug_info_module_stats_vector)
 
 static inline struct hash_pair
 drgn_dwarf_module_hash(const struct drgn_dwarf_module_key *key)
@@ -47,6 +59,9 @@ DEFINE_HASH_TABLE_FUNCTIONS(drgn_dwarf_module_table, drgn_dwarf_module_hash,
 			    drgn_dwarf_module_eq)
 
 DEFINE_HASH_TABLE_FUNCTIONS(c_string_set, c_string_hash, c_string_eq)
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_build_id_location_map, c_string_hash,
+			    c_string_eq)
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_shared_elf_map, c_string_hash, c_string_eq)
 
 /**
  * @c Dwfl_Callbacks::find_elf() implementation.
@@ -107,7 +122,9 @@ static int drgn_dwfl_linux_proc_find_elf(Dwfl_Module *dwfl_module,
 
 /*
  * Uses drgn_dwfl_find_elf() if the ELF file was reported directly and falls
- * back to dwfl_build_id_find_elf() otherwise.
+ * back to dwfl_build_id_find_elf() otherwise. Files found by build ID are
+ * remembered in the build ID location cache, which is checked first. If the
+ * file isn't found locally, it is downloaded with debuginfod.
  */
 static int drgn_dwfl_build_id_find_elf(Dwfl_Module *dwfl_module,
 				       void **userdatap, const char *name,
@@ -115,13 +132,81 @@ static int drgn_dwfl_build_id_find_elf(Dwfl_Module *dwfl_module,
 				       Elf **elfp)
 {
 	struct drgn_dwfl_module_userdata *userdata = *userdatap;
+	const unsigned char *build_id;
+	GElf_Addr build_id_vaddr;
+	int build_id_len;
+	int fd;
 
 	if (userdata->elf) {
 		return drgn_dwfl_find_elf(dwfl_module, userdatap, name, base,
 					  file_name, elfp);
 	}
-	return dwfl_build_id_find_elf(dwfl_module, userdatap, name, base,
-				      file_name, elfp);
+
+	build_id_len = dwfl_module_build_id(dwfl_module, &build_id,
+					    &build_id_vaddr);
+	if (build_id_len > 0) {
+		fd = drgn_dwarf_index_open_build_id_location(userdata->dindex,
+							     build_id,
+							     build_id_len,
+							     file_name, elfp);
+		if (fd != -1)
+			return fd;
+	}
+	fd = dwfl_build_id_find_elf(dwfl_module, userdatap, name, base,
+				    file_name, elfp);
+	if (fd == -1 && build_id_len > 0) {
+		fd = drgn_debuginfod_find(&userdata->dindex->debuginfod,
+					  DRGN_DEBUGINFOD_EXECUTABLE, build_id,
+					  build_id_len, file_name);
+	}
+	if (fd != -1 && build_id_len > 0 && *file_name) {
+		drgn_dwarf_index_add_build_id_location(userdata->dindex,
+						       build_id, build_id_len,
+						       *file_name);
+	}
+	return fd;
+}
+
+/*
+ * Uses dwfl_standard_find_debuginfo() and falls back to downloading the debug
+ * file with debuginfod.
+ *
+ * This is called from the threads that read each module's compilation units,
+ * so debug files are downloaded concurrently (up to the size of the client
+ * pool), and each module is indexed as soon as its file arrives.
+ */
+static int drgn_dwfl_find_debuginfo(Dwfl_Module *dwfl_module, void **userdatap,
+				    const char *modname, Dwarf_Addr base,
+				    const char *file_name,
+				    const char *debuglink_file,
+				    GElf_Word debuglink_crc,
+				    char **debuginfo_file_name)
+{
+	struct drgn_dwfl_module_userdata *userdata = *userdatap;
+	const unsigned char *build_id;
+	GElf_Addr build_id_vaddr;
+	int build_id_len;
+	int fd;
+
+	fd = dwfl_standard_find_debuginfo(dwfl_module, userdatap, modname, base,
+					  file_name, debuglink_file,
+					  debuglink_crc, debuginfo_file_name);
+	if (fd != -1 ||
+	    !drgn_debuginfod_enabled(&userdata->dindex->debuginfod))
+		return fd;
+	/*
+	 * Lookups for an alternate debug file (.gnu_debugaltlink) pass its name
+	 * with no CRC. We only know the module's own build ID, so skip those.
+	 */
+	if (debuglink_file && !debuglink_crc)
+		return -1;
+	build_id_len = dwfl_module_build_id(dwfl_module, &build_id,
+					    &build_id_vaddr);
+	if (build_id_len <= 0)
+		return -1;
+	return drgn_debuginfod_find(&userdata->dindex->debuginfod,
+				    DRGN_DEBUGINFOD_DEBUGINFO, build_id,
+				    build_id_len, debuginfo_file_name);
 }
 
 /**
@@ -149,13 +234,13 @@ const Dwfl_Callbacks drgn_dwfl_callbacks = {
 
 const Dwfl_Callbacks drgn_linux_proc_dwfl_callbacks = {
 	.find_elf = drgn_dwfl_linux_proc_find_elf,
-	.find_debuginfo = dwfl_standard_find_debuginfo,
+	.find_debuginfo = drgn_dwfl_find_debuginfo,
 	.section_address = drgn_dwfl_section_address,
 };
 
 const Dwfl_Callbacks drgn_userspace_core_dump_dwfl_callbacks = {
 	.find_elf = drgn_dwfl_build_id_find_elf,
-	.find_debuginfo = dwfl_standard_find_debuginfo,
+	.find_debuginfo = drgn_dwfl_find_debuginfo,
 	.section_address = drgn_dwfl_section_address,
 };
 
@@ -164,6 +249,8 @@ enum {
 	SECTION_DEBUG_ABBREV,
 	SECTION_DEBUG_STR,
 	SECTION_DEBUG_LINE,
+	SECTION_DEBUG_NAMES,
+	SECTION_DEBUG_STR_OFFSETS,
 	DRGN_DWARF_INDEX_NUM_SECTIONS,
 };
 
@@ -172,12 +259,15 @@ static const char * const section_name[DRGN_DWARF_INDEX_NUM_SECTIONS] = {
 	[SECTION_DEBUG_ABBREV] = ".debug_abbrev",
 	[SECTION_DEBUG_STR] = ".debug_str",
 	[SECTION_DEBUG_LINE] = ".debug_line",
+	[SECTION_DEBUG_NAMES] = ".debug_names",
+	[SECTION_DEBUG_STR_OFFSETS] = ".debug_str_offsets",
 };
 
 /*
  * The DWARF abbreviation table gets translated into a series of instructions.
  * An instruction <= INSN_MAX_SKIP indicates a number of bytes to be skipped
- * over. The next few instructions mean that the corresponding attribute can be
+ * over. The next few instructions mean that the corresponding attribute (or,
+ * for ATTRIB_LEB128*, run of up to 4 consecutive LEB128 attributes) can be
  * skipped over. The remaining instructions indicate that the corresponding
  * attribute should be parsed. Finally, every sequence of instructions
  * corresponding to a DIE is terminated by a zero byte followed by a bitmask of
@@ -185,12 +275,15 @@ static const char * const section_name[DRGN_DWARF_INDEX_NUM_SECTIONS] = {
  * tag is not of interest).
  */
 enum {
-	INSN_MAX_SKIP = 229,
+	INSN_MAX_SKIP = 225,
 	ATTRIB_BLOCK1,
 	ATTRIB_BLOCK2,
 	ATTRIB_BLOCK4,
 	ATTRIB_EXPRLOC,
 	ATTRIB_LEB128,
+	ATTRIB_LEB128_2,
+	ATTRIB_LEB128_3,
+	ATTRIB_LEB128_4,
 	ATTRIB_STRING,
 	ATTRIB_SIBLING_REF1,
 	ATTRIB_SIBLING_REF2,
@@ -200,6 +293,7 @@ enum {
 	ATTRIB_NAME_STRP4,
 	ATTRIB_NAME_STRP8,
 	ATTRIB_NAME_STRING,
+	ATTRIB_NAME_STR_INDEX,
 	ATTRIB_STMT_LIST_LINEPTR4,
 	ATTRIB_STMT_LIST_LINEPTR8,
 	ATTRIB_DECL_FILE_DATA1,
@@ -221,6 +315,8 @@ enum {
 	TAG_MASK = (1 << TAG_BITS) - 1,
 	/* The remaining bits can be used for other purposes. */
 	TAG_FLAG_DECLARATION = 0x40,
+	/* Unit DIEs are never declarations, so the bit is reused for them. */
+	TAG_FLAG_SKELETON = TAG_FLAG_DECLARATION,
 	TAG_FLAG_CHILDREN = 0x80,
 };
 
@@ -250,8 +346,87 @@ static void abbrev_table_deinit(struct abbrev_table *abbrev)
 	uint32_vector_deinit(&abbrev->decls);
 }
 
+/*
+ * Index cache file format. This is only ever read by the same build of drgn on
+ * the same machine that wrote it, so everything is in native byte order. The
+ * file consists of the header, the build ID padded to a multiple of 8 bytes,
+ * the entries, and finally the null-terminated names.
+ */
+#define DRGN_DWARF_INDEX_CACHE_MAGIC "DRGNIDX"
+#define DRGN_DWARF_INDEX_CACHE_VERSION 1
+#define DRGN_DWARF_INDEX_CACHE_BYTE_ORDER UINT32_C(0x01020304)
+
+struct drgn_dwarf_index_cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint64_t build_id_len;
+	/* Size of .debug_info that the offsets refer to. */
+	uint64_t debug_info_size;
+	uint64_t num_entries;
+	uint64_t names_size;
+};
+
+struct drgn_dwarf_index_cache_entry {
+	uint64_t tag;
+	uint64_t file_name_hash;
+	uint64_t offset;
+	/* Offset of the name in the names. */
+	uint64_t name;
+};
+
+/* Number of cached entries which are indexed together like a unit. */
+#define DRGN_DWARF_INDEX_CACHE_CHUNK 16384
+
+/* An index entry to be saved in the cache. */
+struct drgn_dwarf_index_cache_record {
+	const char *name;
+	uint64_t tag;
+	uint64_t file_name_hash;
+	uint64_t offset;
+};
+
+DEFINE_VECTOR(drgn_dwarf_index_cache_record_vector,
+	      struct drgn_dwarf_index_cache_record)
+
+/*
+ * Relocated section cache file format. This is used for relocatable files
+ * (i.e., Linux kernel modules) so that their debugging information sections
+ * don't need to be decompressed and relocated every time they're loaded. Like
+ * the index cache, everything is in native byte order. The file consists of the
+ * header, the build ID padded to a multiple of 8 bytes, the entries, and the
+ * contents of each section padded to a multiple of 8 bytes.
+ */
+#define DRGN_SECTION_CACHE_MAGIC "DRGNSEC"
+#define DRGN_SECTION_CACHE_VERSION 1
+
+struct drgn_section_cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint64_t build_id_len;
+	/* Hash of the section addresses that relocations were applied with. */
+	uint64_t addresses_hash;
+	uint64_t num_sections;
+};
+
+/*
+ * A cached section. The entries are in section order and include every
+ * .debug_* section in the file.
+ */
+struct drgn_section_cache_entry {
+	uint64_t index;
+	/* Offset of the section contents in the file. */
+	uint64_t offset;
+	uint64_t size;
+};
+
+DEFINE_VECTOR(elf_scn_vector, Elf_Scn *)
+
 struct compilation_unit {
 	Dwfl_Module *module;
+	/* Index of module in drgn_dwarf_index::die_modules. */
+	uint32_t module_index;
 	Elf_Data *sections[DRGN_DWARF_INDEX_NUM_SECTIONS];
 	const char *ptr;
 	uint64_t unit_length;
@@ -259,6 +434,58 @@ struct compilation_unit {
 	uint8_t address_size;
 	bool is_64_bit;
 	bool bswap;
+	/*
+	 * Build ID of the module if the entries for this unit should be saved
+	 * in the cache, NULL otherwise.
+	 */
+	const void *build_id;
+	size_t build_id_len;
+	struct drgn_dwarf_index_cache_record_vector cache_records;
+	/*
+	 * If non-NULL, this is not a real unit but a chunk of entries from a
+	 * mapped cache file to index instead.
+	 */
+	const struct drgn_dwarf_index_cache_entry *cache_entries;
+	size_t num_cache_entries;
+	const char *cache_names;
+	/*
+	 * Whether the unit is covered by .debug_names (one of CU_NAMES_*). If
+	 * so, only the DIEs in names_dies are indexed instead of scanning the
+	 * whole unit.
+	 */
+	int names;
+	/* Offsets in .debug_info of the top-level DIEs in .debug_names. */
+	struct uint64_vector names_dies;
+	/* Number of DIEs indexed from this unit. */
+	uint64_t num_dies;
+	/*
+	 * If non-NULL, this is a split unit from this split DWARF file, and
+	 * sections come from it except for SECTION_DEBUG_LINE, which is the
+	 * skeleton's.
+	 */
+	Dwarf *split_dwarf;
+	/* Name of the split DWARF file if split_dwarf is non-NULL. */
+	const char *split_name;
+	/*
+	 * For split units, the offset of the skeleton unit's line number
+	 * program, or SIZE_MAX.
+	 */
+	size_t split_stmt_list;
+	/*
+	 * Whether this is a skeleton unit. Set while indexing along with
+	 * skeleton_stmt_list, the offset of its line number program.
+	 */
+	bool skeleton;
+	size_t skeleton_stmt_list;
+};
+
+enum {
+	/* The unit is not covered by .debug_names. */
+	CU_NAMES_UNUSED,
+	/* The unit is covered by .debug_names. */
+	CU_NAMES_USED,
+	/* The unit is listed in .debug_names, but it can't be used for it. */
+	CU_NAMES_REJECTED,
 };
 
 static inline const char *section_ptr(Elf_Data *data, size_t offset)
@@ -276,19 +503,22 @@ static inline const char *section_end(Elf_Data *data)
  *
  * DIEs with the same name but different tags or files are considered distinct.
  * We only compare the hash of the file name, not the string value, because a
- * 64-bit collision is unlikely enough, especially when also considering the
- * name and tag.
+ * 32-bit collision is unlikely enough when also considering the name and tag.
+ *
+ * There can be millions of these, so they are packed into 24 bytes.
  */
 struct drgn_dwarf_index_die {
-	uint64_t tag;
-	uint64_t file_name_hash;
+	uint64_t offset;
 	/*
 	 * The next DIE with the same name (as an index into
-	 * drgn_dwarf_index_shard::dies), or SIZE_MAX if this is the last DIE.
+	 * drgn_dwarf_index_shard::dies), or UINT32_MAX if this is the last DIE.
 	 */
-	size_t next;
-	Dwfl_Module *module;
-	uint64_t offset;
+	uint32_t next;
+	/* Index of the module in drgn_dwarf_index::die_modules. */
+	uint32_t module;
+	/* The lower 32 bits of the file name hash. */
+	uint32_t file_name_hash;
+	uint16_t tag;
 };
 
 /*
@@ -298,24 +528,36 @@ struct drgn_dwarf_index_die {
 DEFINE_HASH_TABLE_FUNCTIONS(drgn_dwarf_index_die_map, string_hash, string_eq)
 DEFINE_VECTOR_FUNCTIONS(drgn_dwarf_index_die_vector)
 
-static inline size_t hash_pair_to_shard(struct hash_pair hp)
-{
-	/*
-	 * The 8 most significant bits of the hash are used as the F14 tag, so
-	 * we don't want to use those for sharding.
-	 */
-	return ((hp.first >>
-		 (8 * sizeof(size_t) - 8 - DRGN_DWARF_INDEX_SHARD_BITS)) &
-		(((size_t)1 << DRGN_DWARF_INDEX_SHARD_BITS) - 1));
-}
-
 static inline struct drgn_error *drgn_eof(void)
 {
 	return drgn_error_create(DRGN_ERROR_OTHER,
 				 "debug information is truncated");
 }
 
-static inline bool skip_leb128(const char **ptr, const char *end)
+/* Bit 7 of each byte in a word, i.e., the LEB128 continuation bits. */
+#define LEB128_CONTINUATION_BITS UINT64_C(0x8080808080808080)
+
+/*
+ * Load the next 8 bytes if they are in bounds and return a mask of the bytes
+ * which end a LEB128 number (i.e., have bit 7 clear) in that word, or 0 if
+ * there are fewer than 8 bytes left. Byte i of the input corresponds to bit 8 *
+ * i + 7 of the mask.
+ */
+static inline uint64_t leb128_end_mask(const char *ptr, const char *end,
+				       uint64_t *word_ret)
+{
+	uint64_t word;
+
+	if (end - ptr < (ptrdiff_t)sizeof(word))
+		return 0;
+	memcpy(&word, ptr, sizeof(word));
+	word = le64toh(word);
+	if (word_ret)
+		*word_ret = word;
+	return ~word & LEB128_CONTINUATION_BITS;
+}
+
+static inline bool skip_leb128_slow(const char **ptr, const char *end)
 {
 	for (;;) {
 		if (*ptr >= end)
@@ -325,8 +567,45 @@ static inline bool skip_leb128(const char **ptr, const char *end)
 	}
 }
 
-static inline struct drgn_error *read_uleb128(const char **ptr, const char *end,
-					      uint64_t *value)
+/*
+ * Skip @p n consecutive LEB128 numbers. This finds the ends of all of the
+ * numbers in the next 8 bytes at once instead of checking one byte at a time.
+ */
+static inline bool skip_leb128s(const char **ptr, const char *end,
+				unsigned int n)
+{
+	while (n) {
+		uint64_t mask;
+		unsigned int bit;
+
+		mask = leb128_end_mask(*ptr, end, NULL);
+		if (!mask) {
+			/* Near the end or a number longer than 8 bytes. */
+			if (!skip_leb128_slow(ptr, end))
+				return false;
+			n--;
+			continue;
+		}
+		for (;;) {
+			bit = ctz(mask);
+			n--;
+			mask &= mask - 1;
+			if (!n || !mask)
+				break;
+		}
+		*ptr += bit / 8 + 1;
+	}
+	return true;
+}
+
+static inline bool skip_leb128(const char **ptr, const char *end)
+{
+	return skip_leb128s(ptr, end, 1);
+}
+
+static inline struct drgn_error *read_uleb128_slow(const char **ptr,
+						   const char *end,
+						   uint64_t *value)
 {
 	int shift = 0;
 	uint8_t byte;
@@ -349,6 +628,35 @@ static inline struct drgn_error *read_uleb128(const char **ptr, const char *end,
 	return NULL;
 }
 
+static inline struct drgn_error *read_uleb128(const char **ptr, const char *end,
+					      uint64_t *value)
+{
+	uint64_t word, mask, tmp;
+	unsigned int len, i;
+
+	/* Most numbers are a single byte. */
+	if (*ptr < end && !(*(const uint8_t *)*ptr & 0x80)) {
+		*value = *(const uint8_t *)(*ptr)++;
+		return NULL;
+	}
+
+	/*
+	 * Otherwise, if the number fits in the next 8 bytes, find its length
+	 * with one load and decode it without bounds checks. 8 bytes hold at
+	 * most 56 bits, so this can't overflow.
+	 */
+	mask = leb128_end_mask(*ptr, end, &word);
+	if (!mask)
+		return read_uleb128_slow(ptr, end, value);
+	len = ctz(mask) / 8 + 1;
+	tmp = 0;
+	for (i = 0; i < len; i++)
+		tmp |= ((word >> (8 * i)) & 0x7f) << (7 * i);
+	*value = tmp;
+	*ptr += len;
+	return NULL;
+}
+
 static inline struct drgn_error *read_uleb128_into_size_t(const char **ptr,
 							  const char *end,
 							  size_t *value)
@@ -394,6 +702,15 @@ drgn_dwfl_module_userdata_destroy(struct drgn_dwfl_module_userdata *userdata)
 		if (userdata->fd != -1)
 			close(userdata->fd);
 		free(userdata->path);
+		if (userdata->cache_map)
+			munmap(userdata->cache_map, userdata->cache_map_size);
+		/* After elf_end() because the sections point into this. */
+		if (userdata->section_cache_map) {
+			munmap(userdata->section_cache_map,
+			       userdata->section_cache_map_size);
+		}
+		drgn_orc_table_destroy(userdata->orc);
+		drgn_line_table_destroy(userdata->lines);
 		free(userdata);
 	}
 }
@@ -503,9 +820,397 @@ static void drgn_dwarf_index_free_modules(struct drgn_dwarf_index *dindex,
 	dwfl_report_end(dindex->dwfl, drgn_dwfl_module_removed, &arg);
 }
 
+/*
+ * Return a build ID formatted as a hexadecimal string, or NULL if we couldn't
+ * allocate it.
+ */
+static char *build_id_to_hex(const void *build_id, size_t build_id_len)
+{
+	static const char hex[] = "0123456789abcdef";
+	const uint8_t *bytes = build_id;
+	char *str;
+	size_t i;
+
+	str = malloc(2 * build_id_len + 1);
+	if (!str)
+		return NULL;
+	for (i = 0; i < build_id_len; i++) {
+		str[2 * i] = hex[bytes[i] >> 4];
+		str[2 * i + 1] = hex[bytes[i] & 0xf];
+	}
+	str[2 * build_id_len] = '\0';
+	return str;
+}
+
+bool drgn_dwarf_index_create_cache_dir(struct drgn_dwarf_index *dindex)
+{
+	return dindex->cache_dir && mkdir_parents(dindex->cache_dir);
+}
+
+static void read_build_id_locations(struct drgn_dwarf_index *dindex)
+{
+	char *path;
+	FILE *file;
+	char *line = NULL;
+	size_t n = 0;
+	ssize_t len;
+
+	dindex->build_id_locations_read = true;
+	if (asprintf(&path, "%s/build-ids", dindex->cache_dir) == -1)
+		return;
+	file = fopen(path, "r");
+	free(path);
+	if (!file)
+		return;
+	while ((len = getline(&line, &n, file)) != -1) {
+		struct drgn_build_id_location_map_entry entry;
+		int build_id_end = 0, path_start = 0;
+
+		if (len && line[len - 1] == '\n')
+			line[len - 1] = '\0';
+		/* Skip malformed lines. */
+		if (sscanf(line, "%*[0-9a-f]%n %" SCNd64 " %" SCNd64 " %n",
+			   &build_id_end, &entry.value.mtime_sec,
+			   &entry.value.mtime_nsec, &path_start) != 2 ||
+		    !build_id_end || !path_start || line[path_start] != '/')
+			continue;
+		line[build_id_end] = '\0';
+		entry.key = strdup(line);
+		entry.value.path = strdup(line + path_start);
+		if (!entry.key || !entry.value.path ||
+		    drgn_build_id_location_map_insert(&dindex->build_id_locations,
+						      &entry, NULL) != 1) {
+			free(entry.value.path);
+			free(entry.key);
+		}
+	}
+	free(line);
+	fclose(file);
+}
+
+/*
+ * Save the build ID locations if they changed. Like the index cache, this fails
+ * silently.
+ */
+static void write_build_id_locations(struct drgn_dwarf_index *dindex)
+{
+	struct drgn_build_id_location_map_iterator it;
+	char *path = NULL, *tmp_path = NULL;
+	int fd;
+	FILE *file;
+	bool ok = true;
+
+	if (!dindex->build_id_locations_dirty ||
+	    !mkdir_parents(dindex->cache_dir))
+		return;
+	if (asprintf(&path, "%s/build-ids", dindex->cache_dir) == -1) {
+		path = NULL;
+		goto out;
+	}
+	if (asprintf(&tmp_path, "%s.XXXXXX", path) == -1) {
+		tmp_path = NULL;
+		goto out;
+	}
+	fd = mkstemp(tmp_path);
+	if (fd == -1)
+		goto out;
+	file = fdopen(fd, "w");
+	if (!file) {
+		close(fd);
+		unlink(tmp_path);
+		goto out;
+	}
+	for (it = drgn_build_id_location_map_first(&dindex->build_id_locations);
+	     ok && it.entry; it = drgn_build_id_location_map_next(it)) {
+		ok = fprintf(file, "%s %" PRId64 " %" PRId64 " %s\n",
+			     it.entry->key, it.entry->value.mtime_sec,
+			     it.entry->value.mtime_nsec,
+			     it.entry->value.path) >= 0;
+	}
+	if (fclose(file) == EOF)
+		ok = false;
+	/* Replace the file atomically in case it's being read. */
+	if (!ok || rename(tmp_path, path) == -1)
+		unlink(tmp_path);
+out:
+	free(tmp_path);
+	free(path);
+}
+
+static void free_build_id_locations(struct drgn_dwarf_index *dindex)
+{
+	struct drgn_build_id_location_map_iterator it;
+
+	for (it = drgn_build_id_location_map_first(&dindex->build_id_locations);
+	     it.entry; it = drgn_build_id_location_map_next(it)) {
+		free(it.entry->value.path);
+		free(it.entry->key);
+	}
+	drgn_build_id_location_map_deinit(&dindex->build_id_locations);
+}
+
+struct drgn_shared_debug_info *drgn_shared_debug_info_create(void)
+{
+	struct drgn_shared_debug_info *shared;
+
+	shared = malloc(sizeof(*shared));
+	if (!shared)
+		return NULL;
+	pthread_mutex_init(&shared->lock, NULL);
+	shared->refcount = 1;
+	drgn_shared_elf_map_init(&shared->elfs);
+	return shared;
+}
+
+void drgn_shared_debug_info_incref(struct drgn_shared_debug_info *shared)
+{
+	pthread_mutex_lock(&shared->lock);
+	shared->refcount++;
+	pthread_mutex_unlock(&shared->lock);
+}
+
+void drgn_shared_debug_info_decref(struct drgn_shared_debug_info *shared)
+{
+	struct drgn_shared_elf_map_iterator it;
+	size_t refcount;
+
+	if (!shared)
+		return;
+	pthread_mutex_lock(&shared->lock);
+	refcount = --shared->refcount;
+	pthread_mutex_unlock(&shared->lock);
+	if (refcount)
+		return;
+	/*
+	 * Modules that are still using a file hold their own reference to the
+	 * Elf handle, so this only drops ours.
+	 */
+	for (it = drgn_shared_elf_map_first(&shared->elfs); it.entry;
+	     it = drgn_shared_elf_map_next(it)) {
+		elf_end(it.entry->value);
+		free(it.entry->key);
+	}
+	drgn_shared_elf_map_deinit(&shared->elfs);
+	pthread_mutex_destroy(&shared->lock);
+	free(shared);
+}
+
+/*
+ * Return the ELF handle to use for a file with the given build ID: either the
+ * shared handle for the build ID, in which case elf is freed, or elf itself,
+ * which is then shared with the other indexes. Failing to share the file isn't
+ * an error.
+ */
+static Elf *drgn_dwarf_index_share_elf(struct drgn_dwarf_index *dindex,
+				       const void *build_id,
+				       size_t build_id_len, Elf *elf)
+{
+	struct drgn_shared_debug_info *shared = dindex->shared;
+	struct drgn_shared_elf_map_entry entry;
+	struct drgn_shared_elf_map_iterator it;
+	GElf_Ehdr ehdr_mem, *ehdr;
+	Elf *ret = elf;
+
+	if (!shared || !build_id_len)
+		return elf;
+	ehdr = gelf_getehdr(elf, &ehdr_mem);
+	if (!ehdr || ehdr->e_type == ET_REL)
+		return elf;
+	entry.key = build_id_to_hex(build_id, build_id_len);
+	if (!entry.key)
+		return elf;
+
+	pthread_mutex_lock(&shared->lock);
+	it = drgn_shared_elf_map_search(&shared->elfs, &entry.key);
+	if (it.entry) {
+		/*
+		 * For a file that isn't an archive, this just increments the
+		 * reference count of the handle. The file descriptor doesn't
+		 * need to match since the handle is already mapped.
+		 */
+		ret = elf_begin(-1, ELF_C_READ_MMAP, it.entry->value);
+		if (ret)
+			elf_end(elf);
+		else
+			ret = elf;
+	} else {
+		entry.value = elf_begin(-1, ELF_C_READ_MMAP, elf);
+		if (entry.value) {
+			if (drgn_shared_elf_map_insert(&shared->elfs, &entry,
+						       NULL) == 1)
+				entry.key = NULL;
+			else
+				elf_end(entry.value);
+		}
+	}
+	pthread_mutex_unlock(&shared->lock);
+	free(entry.key);
+	return ret;
+}
+
+char *drgn_dwarf_index_find_build_id_location(struct drgn_dwarf_index *dindex,
+					      const void *build_id,
+					      size_t build_id_len)
+{
+	struct drgn_build_id_location_map_iterator it;
+	char *key;
+	char *path = NULL;
+	struct stat st;
+
+	if (!dindex->cache_dir || !build_id_len)
+		return NULL;
+	key = build_id_to_hex(build_id, build_id_len);
+	if (!key)
+		return NULL;
+	omp_set_lock(&dindex->build_id_locations_lock);
+	if (!dindex->build_id_locations_read)
+		read_build_id_locations(dindex);
+	it = drgn_build_id_location_map_search(&dindex->build_id_locations,
+					       &key);
+	if (it.entry) {
+		struct drgn_build_id_location *location = &it.entry->value;
+
+		if (stat(location->path, &st) == 0 &&
+		    st.st_mtim.tv_sec == location->mtime_sec &&
+		    st.st_mtim.tv_nsec == location->mtime_nsec) {
+			path = strdup(location->path);
+		} else {
+			/* The file is gone or was replaced. */
+			free(location->path);
+			free(it.entry->key);
+			drgn_build_id_location_map_delete_iterator(&dindex->build_id_locations,
+								   it);
+			dindex->build_id_locations_dirty = true;
+		}
+	}
+	omp_unset_lock(&dindex->build_id_locations_lock);
+	free(key);
+	return path;
+}
+
+void drgn_dwarf_index_add_build_id_location(struct drgn_dwarf_index *dindex,
+					    const void *build_id,
+					    size_t build_id_len,
+					    const char *path)
+{
+	struct drgn_build_id_location_map_entry entry;
+	struct drgn_build_id_location_map_iterator it;
+	struct stat st;
+	int r;
+
+	/* Lines in the file are only terminated by a newline. */
+	if (!dindex->cache_dir || !build_id_len || path[0] != '/' ||
+	    strchr(path, '\n') || stat(path, &st) == -1)
+		return;
+	entry.key = build_id_to_hex(build_id, build_id_len);
+	entry.value.path = strdup(path);
+	entry.value.mtime_sec = st.st_mtim.tv_sec;
+	entry.value.mtime_nsec = st.st_mtim.tv_nsec;
+	if (!entry.key || !entry.value.path)
+		goto out;
+
+	omp_set_lock(&dindex->build_id_locations_lock);
+	if (!dindex->build_id_locations_read)
+		read_build_id_locations(dindex);
+	r = drgn_build_id_location_map_insert(&dindex->build_id_locations,
+					      &entry, &it);
+	if (r == 1) {
+		dindex->build_id_locations_dirty = true;
+		entry.key = NULL;
+		entry.value.path = NULL;
+	} else if (r == 0) {
+		struct drgn_build_id_location *location = &it.entry->value;
+
+		if (strcmp(location->path, path) != 0 ||
+		    location->mtime_sec != entry.value.mtime_sec ||
+		    location->mtime_nsec != entry.value.mtime_nsec) {
+			free(location->path);
+			*location = entry.value;
+			entry.value.path = NULL;
+			dindex->build_id_locations_dirty = true;
+		}
+	}
+	omp_unset_lock(&dindex->build_id_locations_lock);
+out:
+	free(entry.value.path);
+	free(entry.key);
+}
+
+int drgn_dwarf_index_open_build_id_location(struct drgn_dwarf_index *dindex,
+					    const void *build_id,
+					    size_t build_id_len,
+					    char **path_ret, Elf **elf_ret)
+{
+	char *path;
+	int fd;
+	Elf *elf;
+	const void *elf_build_id;
+
+	path = drgn_dwarf_index_find_build_id_location(dindex, build_id,
+						       build_id_len);
+	if (!path)
+		return -1;
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		goto err_path;
+	elf = dwelf_elf_begin(fd);
+	if (!elf)
+		goto err_fd;
+	if (dwelf_elf_gnu_build_id(elf, &elf_build_id) != (ssize_t)build_id_len ||
+	    memcmp(elf_build_id, build_id, build_id_len) != 0)
+		goto err_elf;
+	*path_ret = path;
+	*elf_ret = elf;
+	return fd;
+
+err_elf:
+	elf_end(elf);
+err_fd:
+	close(fd);
+err_path:
+	free(path);
+	return -1;
+}
+
+/*
+ * Parse a size in bytes with an optional K, M, or G suffix. Invalid sizes are
+ * treated as no limit.
+ */
+static size_t parse_batch_size(const char *str)
+{
+	unsigned long long size;
+	char *end;
+
+	if (!str || !str[0])
+		return 0;
+	errno = 0;
+	size = strtoull(str, &end, 0);
+	if (errno)
+		return 0;
+	switch (*end) {
+	case 'G':
+	case 'g':
+		size *= 1024;
+		/* fallthrough */
+	case 'M':
+	case 'm':
+		size *= 1024;
+		/* fallthrough */
+	case 'K':
+	case 'k':
+		size *= 1024;
+		end++;
+		break;
+	}
+	if (*end || size > SIZE_MAX)
+		return 0;
+	return size;
+}
+
 struct drgn_error *drgn_dwarf_index_init(struct drgn_dwarf_index *dindex,
 					 const Dwfl_Callbacks *callbacks)
 {
+	struct drgn_error *err;
 	size_t i;
 	char *max_errors;
 
@@ -519,6 +1224,11 @@ struct drgn_error *drgn_dwarf_index_init(struct drgn_dwarf_index *dindex,
 		drgn_dwarf_index_die_map_init(&shard->map);
 		drgn_dwarf_index_die_vector_init(&shard->dies);
 	}
+	drgn_dwarf_index_die_module_vector_init(&dindex->die_modules);
+	drgn_debug_info_module_stats_vector_init(&dindex->module_stats);
+	memset(&dindex->stats, 0, sizeof(dindex->stats));
+	dindex->progress_fn = NULL;
+	dindex->progress_arg = NULL;
 	memset(&dindex->errors, 0, sizeof(dindex->errors));
 	dindex->num_errors = 0;
 	max_errors = getenv("DRGN_MAX_DEBUG_INFO_ERRORS");
@@ -526,22 +1236,78 @@ struct drgn_error *drgn_dwarf_index_init(struct drgn_dwarf_index *dindex,
 		dindex->max_errors = atoi(max_errors);
 	else
 		dindex->max_errors = 5;
+	dindex->batch_size =
+		parse_batch_size(getenv("DRGN_DWARF_INDEX_BATCH_SIZE"));
+	err = drgn_get_cache_dir("DRGN_DWARF_INDEX_CACHE_DIR", "",
+				 &dindex->cache_dir);
+	if (err) {
+		drgn_debug_info_module_stats_vector_deinit(&dindex->module_stats);
+		drgn_dwarf_index_die_module_vector_deinit(&dindex->die_modules);
+		free_shards(dindex, ARRAY_SIZE(dindex->shards));
+		dwfl_end(dindex->dwfl);
+		return err;
+	}
+	drgn_debuginfod_init(&dindex->debuginfod);
+	drgn_build_id_location_map_init(&dindex->build_id_locations);
+	omp_init_lock(&dindex->build_id_locations_lock);
+	dindex->build_id_locations_read = false;
+	dindex->build_id_locations_dirty = false;
 	drgn_dwarf_module_table_init(&dindex->module_table);
 	drgn_dwarf_module_vector_init(&dindex->no_build_id);
 	c_string_set_init(&dindex->names);
+	drgn_dwarf_index_deferred_file_vector_init(&dindex->deferred);
+	drgn_dwarf_index_split_unit_vector_init(&dindex->split_units);
+	dindex->sorted_names = NULL;
+	dindex->num_sorted_names = 0;
+	dindex->reporting = false;
+	dindex->async_running = false;
+	dindex->async_err = NULL;
+	dindex->shared = NULL;
 	return NULL;
 }
 
+static void
+drgn_dwarf_index_deferred_file_deinit(struct drgn_dwarf_index_deferred_file *file)
+{
+	if (file->free_arg)
+		file->free_arg(file->arg);
+	free(file->name);
+	free(file->path);
+}
+
 void drgn_dwarf_index_deinit(struct drgn_dwarf_index *dindex)
 {
+	size_t i;
+
 	if (!dindex)
 		return;
+	drgn_dwarf_index_wait(dindex);
+	drgn_error_destroy(dindex->async_err);
+	for (i = 0; i < dindex->deferred.size; i++) {
+		struct drgn_dwarf_index_deferred_file *file =
+			&dindex->deferred.data[i];
+
+		elf_end(file->elf);
+		if (file->fd != -1)
+			close(file->fd);
+		drgn_dwarf_index_deferred_file_deinit(file);
+	}
+	free(dindex->sorted_names);
+	drgn_dwarf_index_split_unit_vector_deinit(&dindex->split_units);
+	drgn_dwarf_index_deferred_file_vector_deinit(&dindex->deferred);
 	c_string_set_deinit(&dindex->names);
 	drgn_dwarf_index_free_modules(dindex, false, true);
 	assert(dindex->no_build_id.size == 0);
 	assert(drgn_dwarf_module_table_size(&dindex->module_table) == 0);
 	drgn_dwarf_module_vector_deinit(&dindex->no_build_id);
 	drgn_dwarf_module_table_deinit(&dindex->module_table);
+	write_build_id_locations(dindex);
+	omp_destroy_lock(&dindex->build_id_locations_lock);
+	free_build_id_locations(dindex);
+	drgn_debuginfod_deinit(&dindex->debuginfod);
+	free(dindex->cache_dir);
+	drgn_debug_info_module_stats_vector_deinit(&dindex->module_stats);
+	drgn_dwarf_index_die_module_vector_deinit(&dindex->die_modules);
 	free_shards(dindex, ARRAY_SIZE(dindex->shards));
 	dwfl_end(dindex->dwfl);
 }
@@ -549,6 +1315,7 @@ void drgn_dwarf_index_deinit(struct drgn_dwarf_index *dindex)
 void drgn_dwarf_index_report_begin(struct drgn_dwarf_index *dindex)
 {
 	dwfl_report_begin_add(dindex->dwfl);
+	dindex->reporting = true;
 }
 
 struct drgn_error *
@@ -722,6 +1489,7 @@ struct drgn_error *drgn_dwarf_index_report_elf(struct drgn_dwarf_index *dindex,
 		err = NULL;
 		goto free;
 	}
+	elf = drgn_dwarf_index_share_elf(dindex, build_id, build_id_len, elf);
 
 	path_key = realpath(path, NULL);
 	if (!path_key) {
@@ -753,7 +1521,16 @@ struct drgn_error *drgn_dwarf_index_report_elf(struct drgn_dwarf_index *dindex,
 	userdata->path = path_key;
 	userdata->fd = fd;
 	userdata->elf = elf;
+	userdata->dindex = dindex;
 	userdata->state = DRGN_DWARF_MODULE_NEW;
+	userdata->cache_map = NULL;
+	userdata->orc = NULL;
+	userdata->orc_loaded = false;
+	userdata->lines = NULL;
+	userdata->lines_loaded = false;
+	userdata->cache_map_size = 0;
+	userdata->section_cache_map = NULL;
+	userdata->section_cache_map_size = 0;
 	*userdatap = userdata;
 	if (new_ret)
 		*new_ret = true;
@@ -823,6 +1600,15 @@ static int drgn_dwarf_index_report_dwfl_module(Dwfl_Module *dwfl_module,
 	userdata->path = NULL;
 	userdata->fd = -1;
 	userdata->elf = NULL;
+	userdata->dindex = dindex;
+	userdata->cache_map = NULL;
+	userdata->orc = NULL;
+	userdata->orc_loaded = false;
+	userdata->lines = NULL;
+	userdata->lines_loaded = false;
+	userdata->cache_map_size = 0;
+	userdata->section_cache_map = NULL;
+	userdata->section_cache_map_size = 0;
 	if (module->state == DRGN_DWARF_MODULE_INDEXED) {
 		/*
 		 * We've already indexed this module. Don't index it again, but
@@ -928,35 +1714,64 @@ static struct drgn_error *apply_relocation(Elf_Data *data, uint64_t r_offset,
 	return NULL;
 }
 
-static struct drgn_error *relocate_section(Elf_Scn *scn, Elf_Scn *rela_scn,
-					   Elf_Scn *symtab_scn,
-					   uint64_t *sh_addrs, size_t shdrnum)
-{
-	struct drgn_error *err;
-	Elf_Data *data, *rela_data, *symtab_data;
+/* A debugging information section and the relocations to apply to it. */
+struct relocation_section {
+	Elf_Scn *rela_scn;
+	Elf_Data *data;
+	Elf_Data *rela_data;
 	const Elf64_Rela *relocs;
+	size_t num_relocs;
 	const Elf64_Sym *syms;
-	size_t num_relocs, num_syms;
-	size_t i;
-	GElf_Shdr *shdr, shdr_mem;
+	size_t num_syms;
+};
 
-	err = read_elf_section(scn, &data);
-	if (err)
-		return err;
-	err = read_elf_section(rela_scn, &rela_data);
-	if (err)
-		return err;
-	err = read_elf_section(symtab_scn, &symtab_data);
-	if (err)
-		return err;
+DEFINE_VECTOR(relocation_section_vector, struct relocation_section)
 
-	relocs = (Elf64_Rela *)rela_data->d_buf;
-	num_relocs = rela_data->d_size / sizeof(Elf64_Rela);
-	syms = (Elf64_Sym *)symtab_data->d_buf;
-	num_syms = symtab_data->d_size / sizeof(Elf64_Sym);
+/*
+ * Number of relocations applied by each OpenMP task. Large sections are split
+ * into several tasks.
+ */
+#define RELOCATION_CHUNK_SIZE 16384
 
-	for (i = 0; i < num_relocs; i++) {
-		const Elf64_Rela *reloc = &relocs[i];
+/*
+ * libelf isn't thread-safe, so all of the section data is read up front before
+ * any relocations are applied in parallel.
+ */
+static struct drgn_error *
+read_relocation_section(Elf_Scn *scn, Elf_Scn *rela_scn, Elf_Scn *symtab_scn,
+			struct relocation_section *ret)
+{
+	struct drgn_error *err;
+	Elf_Data *symtab_data;
+
+	err = read_elf_section(scn, &ret->data);
+	if (err)
+		return err;
+	err = read_elf_section(rela_scn, &ret->rela_data);
+	if (err)
+		return err;
+	err = read_elf_section(symtab_scn, &symtab_data);
+	if (err)
+		return err;
+
+	ret->rela_scn = rela_scn;
+	ret->relocs = (Elf64_Rela *)ret->rela_data->d_buf;
+	ret->num_relocs = ret->rela_data->d_size / sizeof(Elf64_Rela);
+	ret->syms = (Elf64_Sym *)symtab_data->d_buf;
+	ret->num_syms = symtab_data->d_size / sizeof(Elf64_Sym);
+	return NULL;
+}
+
+/* Apply relocations [start, end) of a section. */
+static struct drgn_error *
+relocate_section(const struct relocation_section *section, size_t start,
+		 size_t end, const uint64_t *sh_addrs, size_t shdrnum)
+{
+	struct drgn_error *err;
+	size_t i;
+
+	for (i = start; i < end; i++) {
+		const Elf64_Rela *reloc = &section->relocs[i];
 		uint32_t r_sym, r_type;
 		uint16_t st_shndx;
 		uint64_t sh_addr;
@@ -964,11 +1779,11 @@ static struct drgn_error *relocate_section(Elf_Scn *scn, Elf_Scn *rela_scn,
 		r_sym = ELF64_R_SYM(reloc->r_info);
 		r_type = ELF64_R_TYPE(reloc->r_info);
 
-		if (r_sym >= num_syms) {
+		if (r_sym >= section->num_syms) {
 			return drgn_error_create(DRGN_ERROR_OTHER,
 						 "invalid relocation symbol");
 		}
-		st_shndx = syms[r_sym].st_shndx;
+		st_shndx = section->syms[r_sym].st_shndx;
 		if (st_shndx == 0) {
 			sh_addr = 0;
 		} else if (st_shndx < shdrnum) {
@@ -977,24 +1792,31 @@ static struct drgn_error *relocate_section(Elf_Scn *scn, Elf_Scn *rela_scn,
 			return drgn_error_create(DRGN_ERROR_OTHER,
 						 "invalid symbol section index");
 		}
-		err = apply_relocation(data, reloc->r_offset, r_type,
+		err = apply_relocation(section->data, reloc->r_offset, r_type,
 				       reloc->r_addend,
-				       sh_addr + syms[r_sym].st_value);
+				       sh_addr + section->syms[r_sym].st_value);
 		if (err)
 			return err;
 	}
+	return NULL;
+}
 
-	/*
-	 * Mark the relocation section as empty so that libdwfl doesn't try to
-	 * apply it again.
-	 */
-	shdr = gelf_getshdr(rela_scn, &shdr_mem);
+/*
+ * Mark a relocation section as empty so that libdwfl doesn't try to apply it
+ * again.
+ */
+static struct drgn_error *
+finish_relocation_section(struct relocation_section *section)
+{
+	GElf_Shdr *shdr, shdr_mem;
+
+	shdr = gelf_getshdr(section->rela_scn, &shdr_mem);
 	if (!shdr)
 		return drgn_error_libelf();
 	shdr->sh_size = 0;
-	if (!gelf_update_shdr(rela_scn, shdr))
+	if (!gelf_update_shdr(section->rela_scn, shdr))
 		return drgn_error_libelf();
-	rela_data->d_size = 0;
+	section->rela_data->d_size = 0;
 	return NULL;
 }
 
@@ -1004,25 +1826,40 @@ static struct drgn_error *relocate_section(Elf_Scn *scn, Elf_Scn *rela_scn,
  * usually done by libdwfl. However, libdwfl is relatively slow at it. This is a
  * much faster implementation. It is only implemented for x86-64; for other
  * architectures, we can fall back to libdwfl.
+ *
+ * The relocations are applied by OpenMP tasks, so when this is called from
+ * read_cus(), threads which have run out of modules to read help relocate the
+ * sections of larger modules.
+ */
+/*
+ * Whether apply_elf_relocations() relocates a file itself instead of leaving it
+ * to libdwfl.
  */
+static bool can_apply_elf_relocations(const GElf_Ehdr *ehdr)
+{
+	return (ehdr->e_type == ET_REL &&
+		ehdr->e_machine == EM_X86_64 &&
+		ehdr->e_ident[EI_CLASS] == ELFCLASS64 &&
+		ehdr->e_ident[EI_DATA] ==
+		(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ?
+		 ELFDATA2LSB : ELFDATA2MSB));
+}
+
 static struct drgn_error *apply_elf_relocations(Elf *elf)
 {
-	struct drgn_error *err;
+	struct drgn_error *err = NULL;
 	GElf_Ehdr ehdr_mem, *ehdr;
 	size_t shdrnum, shstrndx;
 	uint64_t *sh_addrs;
 	Elf_Scn *scn;
+	struct relocation_section_vector sections = VECTOR_INIT;
+	size_t i;
 
 	ehdr = gelf_getehdr(elf, &ehdr_mem);
 	if (!ehdr)
 		return drgn_error_libelf();
 
-	if (ehdr->e_type != ET_REL ||
-	    ehdr->e_machine != EM_X86_64 ||
-	    ehdr->e_ident[EI_CLASS] != ELFCLASS64 ||
-	    ehdr->e_ident[EI_DATA] !=
-	    (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ?
-	     ELFDATA2LSB : ELFDATA2MSB)) {
+	if (!can_apply_elf_relocations(ehdr)) {
 		/* Unsupported; fall back to libdwfl. */
 		return NULL;
 	}
@@ -1079,6 +1916,7 @@ static struct drgn_error *apply_elf_relocations(Elf *elf)
 
 		if (strstartswith(scnname, ".rela.debug_")) {
 			Elf_Scn *info_scn, *link_scn;
+			struct relocation_section *section;
 
 			info_scn = elf_getscn(elf, shdr->sh_info);
 			if (!info_scn) {
@@ -1092,18 +1930,178 @@ static struct drgn_error *apply_elf_relocations(Elf *elf)
 				goto out;
 			}
 
-			err = relocate_section(info_scn, scn, link_scn,
-					       sh_addrs, shdrnum);
+			section = relocation_section_vector_append_entry(&sections);
+			if (!section) {
+				err = &drgn_enomem;
+				goto out;
+			}
+			err = read_relocation_section(info_scn, scn, link_scn,
+						      section);
 			if (err)
 				goto out;
 		}
 	}
+
+	for (i = 0; i < sections.size; i++) {
+		size_t j;
+
+		for (j = 0; j < sections.data[i].num_relocs;
+		     j += RELOCATION_CHUNK_SIZE) {
+			#pragma omp task shared(err)
+			{
+				struct drgn_error *task_err;
+
+				task_err = relocate_section(&sections.data[i], j,
+							    min(j + RELOCATION_CHUNK_SIZE,
+								sections.data[i].num_relocs),
+							    sh_addrs, shdrnum);
+				if (task_err) {
+					#pragma omp critical(drgn_apply_elf_relocations)
+					if (err)
+						drgn_error_destroy(task_err);
+					else
+						err = task_err;
+				}
+			}
+		}
+	}
+	#pragma omp taskwait
+	if (err)
+		goto out;
+
+	for (i = 0; i < sections.size; i++) {
+		err = finish_relocation_section(&sections.data[i]);
+		if (err)
+			goto out;
+	}
 out:
+	relocation_section_vector_deinit(&sections);
 	free(sh_addrs);
-	return NULL;
+	return err;
+}
+
+/* A compressed debugging information section. */
+struct compressed_section {
+	Elf_Scn *scn;
+	/* Whether this is a GNU .zdebug section rather than SHF_COMPRESSED. */
+	bool gnu;
+};
+
+DEFINE_VECTOR(compressed_section_vector, struct compressed_section)
+
+/*
+ * Compressed debugging information sections (SHF_COMPRESSED or .zdebug) are
+ * normally decompressed one by one by libdw when it reads them. Instead, this
+ * decompresses them up front in OpenMP tasks, so the sections of a module are
+ * decompressed in parallel, and threads in read_cus() which have run out of
+ * modules to read help decompress the sections of larger modules.
+ *
+ * libelf isn't thread-safe in general, but once the header and compressed data
+ * of a section have been read, decompressing it only modifies the state of that
+ * section. So, those are read here before any decompression starts.
+ */
+static struct drgn_error *decompress_debug_sections(Elf *elf)
+{
+	struct drgn_error *err = NULL;
+	size_t shstrndx;
+	Elf_Scn *scn = NULL;
+	struct compressed_section_vector sections = VECTOR_INIT;
+	size_t i;
+
+	if (elf_getshdrstrndx(elf, &shstrndx))
+		return drgn_error_libelf();
+
+	while ((scn = elf_nextscn(elf, scn))) {
+		GElf_Shdr *shdr, shdr_mem;
+		const char *scnname;
+		struct compressed_section *section;
+		bool gnu;
+
+		shdr = gelf_getshdr(scn, &shdr_mem);
+		if (!shdr) {
+			err = drgn_error_libelf();
+			goto out;
+		}
+		if (shdr->sh_type == SHT_NOBITS)
+			continue;
+
+		scnname = elf_strptr(elf, shstrndx, shdr->sh_name);
+		if (!scnname)
+			continue;
+		if (shdr->sh_flags & SHF_COMPRESSED) {
+			if (!strstartswith(scnname, ".debug_"))
+				continue;
+			gnu = false;
+		} else if (strstartswith(scnname, ".zdebug_")) {
+			gnu = true;
+		} else {
+			continue;
+		}
+
+		if (!elf_getdata(scn, NULL)) {
+			err = drgn_error_libelf();
+			goto out;
+		}
+		section = compressed_section_vector_append_entry(&sections);
+		if (!section) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		section->scn = scn;
+		section->gnu = gnu;
+	}
+
+	for (i = 0; i < sections.size; i++) {
+		#pragma omp task shared(err)
+		{
+			int ret;
+
+			if (sections.data[i].gnu)
+				ret = elf_compress_gnu(sections.data[i].scn, 0, 0);
+			else
+				ret = elf_compress(sections.data[i].scn, 0, 0);
+			if (ret < 0) {
+				struct drgn_error *task_err;
+
+				/* The libelf error number is thread-local. */
+				task_err = drgn_error_libelf();
+				#pragma omp critical(drgn_decompress_debug_sections)
+				if (err)
+					drgn_error_destroy(task_err);
+				else
+					err = task_err;
+			}
+		}
+	}
+	#pragma omp taskwait
+out:
+	compressed_section_vector_deinit(&sections);
+	return err;
+}
+
+static bool section_name_matches(const char *scnname, const char *name,
+				 bool dwo)
+{
+	size_t len;
+
+	if (dwo) {
+		/* Split DWARF files use the .dwo suffix. */
+		len = strlen(name);
+		return (strncmp(scnname, name, len) == 0 &&
+			strcmp(scnname + len, ".dwo") == 0);
+	}
+	/* Also match the GNU .zdebug name. */
+	return (strcmp(scnname, name) == 0 ||
+		(scnname[0] == '.' && scnname[1] == 'z' &&
+		 strcmp(scnname + 2, name + 1) == 0));
 }
 
-static struct drgn_error *get_debug_sections(Elf *elf, Elf_Data **sections)
+/*
+ * Get the sections used for indexing. If dwo is true, get the sections of a
+ * split DWARF file, which don't include .debug_line or .debug_names.
+ */
+static struct drgn_error *get_debug_sections(Elf *elf, Elf_Data **sections,
+					     bool dwo)
 {
 	struct drgn_error *err;
 	size_t shstrndx;
@@ -1130,10 +2128,13 @@ static struct drgn_error *get_debug_sections(Elf *elf, Elf_Data **sections)
 			continue;
 
 		for (i = 0; i < DRGN_DWARF_INDEX_NUM_SECTIONS; i++) {
-			if (sections[i])
+			if (sections[i] ||
+			    (dwo && (i == SECTION_DEBUG_LINE ||
+				     i == SECTION_DEBUG_NAMES)))
 				continue;
 
-			if (strcmp(scnname, section_name[i]) != 0)
+			if (!section_name_matches(scnname, section_name[i],
+						  dwo))
 				continue;
 
 			err = read_elf_section(scn, &sections[i]);
@@ -1143,10 +2144,12 @@ static struct drgn_error *get_debug_sections(Elf *elf, Elf_Data **sections)
 	}
 
 	for (i = 0; i < DRGN_DWARF_INDEX_NUM_SECTIONS; i++) {
-		if (i != SECTION_DEBUG_LINE && !sections[i]) {
+		if (i != SECTION_DEBUG_LINE && i != SECTION_DEBUG_NAMES &&
+		    i != SECTION_DEBUG_STR_OFFSETS && !sections[i]) {
 			return drgn_error_format(DRGN_ERROR_OTHER,
-						 "no %s section",
-						 section_name[i]);
+						 "no %s%s section",
+						 section_name[i],
+						 dwo ? ".dwo" : "");
 		}
 	}
 
@@ -1201,122 +2204,1064 @@ static struct drgn_error *read_compilation_unit_header(const char *ptr,
 
 DEFINE_VECTOR(compilation_unit_vector, struct compilation_unit)
 
-static struct drgn_error *
-read_dwfl_module_cus(Dwfl_Module *dwfl_module,
-		     struct drgn_dwfl_module_userdata *userdata,
-		     struct compilation_unit_vector *cus)
+static void compilation_units_deinit(struct compilation_unit *cus,
+				     size_t num_cus)
 {
-	struct drgn_error *err;
-	Dwarf *dwarf;
-	Dwarf_Addr bias;
-	Elf *elf;
-	Elf_Data *sections[DRGN_DWARF_INDEX_NUM_SECTIONS] = {};
-	bool bswap;
-	const char *ptr, *end;
+	size_t i;
 
-	if (userdata->elf) {
-		err = apply_elf_relocations(userdata->elf);
-		if (err)
-			return err;
+	for (i = 0; i < num_cus; i++) {
+		drgn_dwarf_index_cache_record_vector_deinit(&cus[i].cache_records);
+		uint64_vector_deinit(&cus[i].names_dies);
 	}
+}
 
-	/*
-	 * Note: not dwfl_module_getelf(), because then libdwfl applies
-	 * ELF relocations to all sections, not just debug sections.
-	 */
-	dwarf = dwfl_module_getdwarf(dwfl_module, &bias);
-	if (!dwarf)
-		return drgn_error_libdwfl();
-
-	elf = dwarf_getelf(dwarf);
-	if (!elf)
-		return drgn_error_libdw();
+static inline size_t cache_build_id_size(size_t build_id_len)
+{
+	return (build_id_len + 7) & ~(size_t)7;
+}
 
-	err = get_debug_sections(elf, sections);
-	if (err)
-		return err;
+/*
+ * Return the path of the cache file for the given build ID with an optional
+ * suffix, or NULL if we couldn't allocate it.
+ */
+static char *cache_path(struct drgn_dwarf_index *dindex, const void *build_id,
+			size_t build_id_len, const char *suffix)
+{
+	char *build_id_str;
+	char *path;
 
-	bswap = (elf_getident(elf, NULL)[EI_DATA] !=
-		 (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ?
-		  ELFDATA2LSB : ELFDATA2MSB));
+	build_id_str = build_id_to_hex(build_id, build_id_len);
+	if (!build_id_str)
+		return NULL;
+	if (asprintf(&path, "%s/%s%s", dindex->cache_dir, build_id_str,
+		     suffix) == -1)
+		path = NULL;
+	free(build_id_str);
+	return path;
+}
 
-	ptr = section_ptr(sections[SECTION_DEBUG_INFO], 0);
-	end = section_end(sections[SECTION_DEBUG_INFO]);
-	while (ptr < end) {
-		struct compilation_unit *cu;
+/*
+ * Map and validate the cache file for a module. On success, the mapping is
+ * saved in @p userdata and the header is returned. If there is no valid cache
+ * file, NULL is returned; this is not an error.
+ */
+static const struct drgn_dwarf_index_cache_header *
+map_cache(struct drgn_dwarf_index *dindex, const void *build_id,
+	  size_t build_id_len, uint64_t debug_info_size,
+	  struct drgn_dwfl_module_userdata *userdata)
+{
+	const struct drgn_dwarf_index_cache_header *header;
+	const struct drgn_dwarf_index_cache_entry *entries;
+	const char *names;
+	char *path;
+	int fd;
+	struct stat st;
+	void *map;
+	size_t size, offset;
+	uint64_t i;
 
-		cu = compilation_unit_vector_append_entry(cus);
-		if (!cu)
-			return &drgn_enomem;
-		cu->module = dwfl_module;
-		memcpy(cu->sections, sections, sizeof(cu->sections));
-		cu->ptr = ptr;
-		cu->bswap = bswap;
-		err = read_compilation_unit_header(ptr, end, cu);
-		if (err)
-			return err;
+	path = cache_path(dindex, build_id, build_id_len, ".idx");
+	if (!path)
+		return NULL;
+	fd = open(path, O_RDONLY);
+	free(path);
+	if (fd == -1)
+		return NULL;
+	if (fstat(fd, &st) == -1 || st.st_size < sizeof(*header) ||
+	    st.st_size > SIZE_MAX) {
+		close(fd);
+		return NULL;
+	}
+	size = st.st_size;
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
 
-		ptr += (cu->is_64_bit ? 12 : 4) + cu->unit_length;
+	header = map;
+	offset = sizeof(*header) + cache_build_id_size(build_id_len);
+	if (memcmp(header->magic, DRGN_DWARF_INDEX_CACHE_MAGIC,
+		   sizeof(header->magic)) != 0 ||
+	    header->version != DRGN_DWARF_INDEX_CACHE_VERSION ||
+	    header->byte_order != DRGN_DWARF_INDEX_CACHE_BYTE_ORDER ||
+	    header->build_id_len != build_id_len ||
+	    header->debug_info_size != debug_info_size ||
+	    size < offset ||
+	    memcmp(header + 1, build_id, build_id_len) != 0 ||
+	    header->num_entries > (size - offset) / sizeof(*entries))
+		goto invalid;
+	entries = (const void *)((const char *)map + offset);
+	offset += header->num_entries * sizeof(*entries);
+	names = (const char *)map + offset;
+	if (header->names_size != size - offset ||
+	    (header->names_size && names[header->names_size - 1] != '\0'))
+		goto invalid;
+	/*
+	 * Every name offset within the names is null-terminated because the
+	 * last byte is a null terminator.
+	 */
+	for (i = 0; i < header->num_entries; i++) {
+		if (entries[i].name >= header->names_size ||
+		    entries[i].offset >= debug_info_size)
+			goto invalid;
 	}
+
+	if (userdata->cache_map)
+		munmap(userdata->cache_map, userdata->cache_map_size);
+	userdata->cache_map = map;
+	userdata->cache_map_size = size;
+	return header;
+
+invalid:
+	munmap(map, size);
 	return NULL;
 }
 
-static struct drgn_error *read_module_cus(struct drgn_dwarf_module *module,
-					  struct compilation_unit_vector *cus,
-					  const char **name_ret)
+/*
+ * Get the hash of the section addresses of a file for the relocated section
+ * cache. Returns false if the file can't be cached: only relocatable files that
+ * we relocate ourselves are, and files with GNU .zdebug sections aren't because
+ * libdw would try to decompress them again based on the name.
+ */
+static bool section_cache_addresses_hash(Elf *elf, uint64_t *ret)
 {
-	struct drgn_error *err;
-	const size_t orig_cus_size = cus->size;
-	size_t i;
+	static const uint64_t siphash_key[2];
+	GElf_Ehdr ehdr_mem, *ehdr;
+	size_t shstrndx;
+	Elf_Scn *scn = NULL;
+	struct siphash hash;
 
-	for (i = 0; i < module->dwfl_modules.size; i++) {
-		Dwfl_Module *dwfl_module;
-		void **userdatap;
-		struct drgn_dwfl_module_userdata *userdata;
+	ehdr = gelf_getehdr(elf, &ehdr_mem);
+	if (!ehdr || !can_apply_elf_relocations(ehdr) ||
+	    elf_getshdrstrndx(elf, &shstrndx))
+		return false;
+	siphash_init(&hash, siphash_key);
+	while ((scn = elf_nextscn(elf, scn))) {
+		GElf_Shdr shdr_mem, *shdr;
+		const char *scnname;
 
-		dwfl_module = module->dwfl_modules.data[i];
-		*name_ret = dwfl_module_info(dwfl_module, &userdatap, NULL,
-					     NULL, NULL, NULL, NULL, NULL);
-		userdata = *userdatap;
-		err = read_dwfl_module_cus(dwfl_module, userdata, cus);
-		if (err) {
-			/*
-			 * Ignore the error unless we have no more Dwfl_Modules
-			 * to try.
-			 */
-			if (i == module->dwfl_modules.size - 1)
-				return err;
-			drgn_error_destroy(err);
-			cus->size = orig_cus_size;
-			continue;
-		}
-		userdata->state = DRGN_DWARF_MODULE_INDEXING;
-		module->state = DRGN_DWARF_MODULE_INDEXING;
-		return NULL;
+		shdr = gelf_getshdr(scn, &shdr_mem);
+		if (!shdr)
+			return false;
+		scnname = elf_strptr(elf, shstrndx, shdr->sh_name);
+		if (scnname && strstartswith(scnname, ".zdebug_"))
+			return false;
+		siphash_update(&hash, &shdr->sh_addr, sizeof(shdr->sh_addr));
 	}
-	UNREACHABLE();
+	*ret = siphash_final(&hash);
+	return true;
 }
 
-static struct drgn_error *read_cus(struct drgn_dwarf_index *dindex,
-				   struct drgn_dwarf_module **unindexed,
-				   size_t num_unindexed,
-				   struct compilation_unit_vector *all_cus)
+/* Get the sections saved in the relocated section cache. */
+static struct drgn_error *get_cached_sections(Elf *elf,
+					      struct elf_scn_vector *ret)
 {
-	struct drgn_error *err = NULL;
+	size_t shstrndx;
+	Elf_Scn *scn = NULL;
 
-	#pragma omp parallel
-	{
-		struct compilation_unit_vector cus = VECTOR_INIT;
+	if (elf_getshdrstrndx(elf, &shstrndx))
+		return drgn_error_libelf();
+	while ((scn = elf_nextscn(elf, scn))) {
+		GElf_Shdr shdr_mem, *shdr;
+		const char *scnname;
 
-		#pragma omp for schedule(dynamic)
-		for (size_t i = 0; i < num_unindexed; i++) {
-			struct drgn_error *module_err;
-			const char *name;
+		shdr = gelf_getshdr(scn, &shdr_mem);
+		if (!shdr)
+			return drgn_error_libelf();
+		if (shdr->sh_type == SHT_NOBITS)
+			continue;
+		scnname = elf_strptr(elf, shstrndx, shdr->sh_name);
+		if (!scnname || !strstartswith(scnname, ".debug_"))
+			continue;
+		/* Read the data now so that it can't fail later. */
+		if (!elf_getdata(scn, NULL))
+			return drgn_error_libelf();
+		if (!elf_scn_vector_append(ret, &scn))
+			return &drgn_enomem;
+	}
+	return NULL;
+}
+
+/*
+ * Replace the debugging information sections of a relocatable file with the
+ * relocated and decompressed contents in its cache file, if there is a valid
+ * one. The mapping is saved in @p userdata.
+ */
+static struct drgn_error *
+map_section_cache(struct drgn_dwarf_index *dindex,
+		  struct drgn_dwarf_module *module,
+		  struct drgn_dwfl_module_userdata *userdata,
+		  uint64_t addresses_hash, bool *mapped_ret)
+{
+	struct drgn_error *err;
+	Elf *elf = userdata->elf;
+	struct elf_scn_vector sections = VECTOR_INIT;
+	const struct drgn_section_cache_header *header;
+	const struct drgn_section_cache_entry *entries;
+	char *path;
+	int fd;
+	struct stat st;
+	void *map;
+	size_t size, offset, shstrndx, i;
+	Elf_Scn *scn;
+
+	*mapped_ret = false;
+	path = cache_path(dindex, module->build_id, module->build_id_len,
+			  ".sections");
+	if (!path)
+		return NULL;
+	fd = open(path, O_RDONLY);
+	free(path);
+	if (fd == -1)
+		return NULL;
+	if (fstat(fd, &st) == -1 || st.st_size < sizeof(*header) ||
+	    st.st_size > SIZE_MAX) {
+		close(fd);
+		return NULL;
+	}
+	size = st.st_size;
+	/* Private and writable in case libdw or libdwfl modify the sections. */
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	header = map;
+	offset = sizeof(*header) + cache_build_id_size(module->build_id_len);
+	if (memcmp(header->magic, DRGN_SECTION_CACHE_MAGIC,
+		   sizeof(header->magic)) != 0 ||
+	    header->version != DRGN_SECTION_CACHE_VERSION ||
+	    header->byte_order != DRGN_DWARF_INDEX_CACHE_BYTE_ORDER ||
+	    header->build_id_len != module->build_id_len ||
+	    header->addresses_hash != addresses_hash ||
+	    size < offset ||
+	    memcmp(header + 1, module->build_id, module->build_id_len) != 0 ||
+	    header->num_sections > (size - offset) / sizeof(*entries)) {
+		err = NULL;
+		goto out;
+	}
+	entries = (const void *)((const char *)map + offset);
+
+	/* Validate everything before modifying any sections. */
+	err = get_cached_sections(elf, &sections);
+	if (err)
+		goto out;
+	if (sections.size != header->num_sections)
+		goto out;
+	for (i = 0; i < sections.size; i++) {
+		if (entries[i].index != elf_ndxscn(sections.data[i]) ||
+		    entries[i].offset > size ||
+		    entries[i].size > size - entries[i].offset)
+			goto out;
+	}
+	/*
+	 * From here on, the sections point into the mapping, so keep it even
+	 * if we fail.
+	 */
+	if (userdata->section_cache_map)
+		munmap(userdata->section_cache_map,
+		       userdata->section_cache_map_size);
+	userdata->section_cache_map = map;
+	userdata->section_cache_map_size = size;
+	map = NULL;
+
+	for (i = 0; i < sections.size; i++) {
+		GElf_Shdr shdr_mem, *shdr;
+		Elf_Data *data;
+
+		scn = sections.data[i];
+		data = elf_getdata(scn, NULL);
+		shdr = gelf_getshdr(scn, &shdr_mem);
+		if (!data || !shdr) {
+			err = drgn_error_libelf();
+			goto out;
+		}
+		/* The contents are already decompressed. */
+		shdr->sh_flags &= ~(GElf_Xword)SHF_COMPRESSED;
+		shdr->sh_size = entries[i].size;
+		if (!gelf_update_shdr(scn, shdr)) {
+			err = drgn_error_libelf();
+			goto out;
+		}
+		data->d_buf = (char *)map + entries[i].offset;
+		data->d_size = entries[i].size;
+		data->d_type = ELF_T_BYTE;
+		data->d_off = 0;
+	}
+
+	/* And already relocated. */
+	if (elf_getshdrstrndx(elf, &shstrndx)) {
+		err = drgn_error_libelf();
+		goto out;
+	}
+	scn = NULL;
+	while ((scn = elf_nextscn(elf, scn))) {
+		GElf_Shdr shdr_mem, *shdr;
+		const char *scnname;
+		Elf_Data *data;
+
+		shdr = gelf_getshdr(scn, &shdr_mem);
+		if (!shdr) {
+			err = drgn_error_libelf();
+			goto out;
+		}
+		if (shdr->sh_type != SHT_RELA)
+			continue;
+		scnname = elf_strptr(elf, shstrndx, shdr->sh_name);
+		if (!scnname || !strstartswith(scnname, ".rela.debug_"))
+			continue;
+		shdr->sh_size = 0;
+		if (!gelf_update_shdr(scn, shdr)) {
+			err = drgn_error_libelf();
+			goto out;
+		}
+		data = elf_getdata(scn, NULL);
+		if (data)
+			data->d_size = 0;
+	}
+	*mapped_ret = true;
+out:
+	elf_scn_vector_deinit(&sections);
+	if (map)
+		munmap(map, size);
+	return err;
+}
+
+/*
+ * Save the relocated and decompressed debugging information sections of a
+ * relocatable file in the cache. The cache is only an optimization, so this
+ * fails silently.
+ */
+static void write_section_cache(struct drgn_dwarf_index *dindex,
+				struct drgn_dwarf_module *module, Elf *elf,
+				uint64_t addresses_hash)
+{
+	static const char padding[8];
+	struct drgn_section_cache_header header = {
+		.magic = DRGN_SECTION_CACHE_MAGIC,
+		.version = DRGN_SECTION_CACHE_VERSION,
+		.byte_order = DRGN_DWARF_INDEX_CACHE_BYTE_ORDER,
+		.build_id_len = module->build_id_len,
+		.addresses_hash = addresses_hash,
+	};
+	struct drgn_error *err;
+	struct elf_scn_vector sections = VECTOR_INIT;
+	char *path = NULL, *tmp_path = NULL;
+	size_t build_id_padding, i;
+	uint64_t offset;
+	int fd;
+	FILE *file;
+	bool ok;
+
+	err = get_cached_sections(elf, &sections);
+	if (err) {
+		drgn_error_destroy(err);
+		goto out;
+	}
+	header.num_sections = sections.size;
+
+	if (!drgn_dwarf_index_create_cache_dir(dindex))
+		goto out;
+	path = cache_path(dindex, module->build_id, module->build_id_len,
+			  ".sections");
+	tmp_path = cache_path(dindex, module->build_id, module->build_id_len,
+			      ".sections.XXXXXX");
+	if (!path || !tmp_path)
+		goto out;
+	fd = mkstemp(tmp_path);
+	if (fd == -1)
+		goto out;
+	file = fdopen(fd, "w");
+	if (!file) {
+		close(fd);
+		unlink(tmp_path);
+		goto out;
+	}
+
+	build_id_padding = (cache_build_id_size(module->build_id_len) -
+			    module->build_id_len);
+	ok = (fwrite(&header, sizeof(header), 1, file) == 1 &&
+	      fwrite(module->build_id, 1, module->build_id_len, file) ==
+	      module->build_id_len &&
+	      fwrite(padding, 1, build_id_padding, file) == build_id_padding);
+	offset = (sizeof(header) + cache_build_id_size(module->build_id_len) +
+		  sections.size * sizeof(struct drgn_section_cache_entry));
+	for (i = 0; ok && i < sections.size; i++) {
+		struct drgn_section_cache_entry entry = {
+			.index = elf_ndxscn(sections.data[i]),
+			.offset = offset,
+			.size = elf_getdata(sections.data[i], NULL)->d_size,
+		};
+
+		ok = fwrite(&entry, sizeof(entry), 1, file) == 1;
+		offset += (entry.size + 7) & ~(uint64_t)7;
+	}
+	for (i = 0; ok && i < sections.size; i++) {
+		Elf_Data *data = elf_getdata(sections.data[i], NULL);
+		size_t data_padding = -data->d_size & 7;
+
+		ok = (fwrite(data->d_buf, 1, data->d_size, file) ==
+		      data->d_size &&
+		      fwrite(padding, 1, data_padding, file) == data_padding);
+	}
+	if (fclose(file) == EOF)
+		ok = false;
+	if (!ok || rename(tmp_path, path) == -1)
+		unlink(tmp_path);
+out:
+	free(tmp_path);
+	free(path);
+	elf_scn_vector_deinit(&sections);
+}
+
+/*
+ * .debug_names index attributes. elfutils' dwarf.h doesn't define these yet, so
+ * we define our own.
+ */
+enum {
+	DRGN_DW_IDX_compile_unit = 1,
+	DRGN_DW_IDX_type_unit = 2,
+	DRGN_DW_IDX_die_offset = 3,
+	DRGN_DW_IDX_parent = 4,
+};
+
+struct names_abbrev {
+	uint64_t code;
+	uint64_t tag;
+	/*
+	 * Index in names_abbrev_table::attribs of the (index attribute, form)
+	 * pairs for this abbreviation, which are terminated by (0, 0).
+	 */
+	size_t attribs;
+};
+
+DEFINE_VECTOR(names_abbrev_vector, struct names_abbrev)
+
+struct names_abbrev_table {
+	struct names_abbrev_vector abbrevs;
+	struct uint64_vector attribs;
+};
+
+static struct drgn_error *
+read_names_abbrev_table(const char *ptr, const char *end,
+			struct names_abbrev_table *table, bool *usable_ret)
+{
+	struct drgn_error *err;
+	bool has_enumerator = false, has_enumeration_type = false;
+
+	for (;;) {
+		struct names_abbrev *abbrev;
+		bool has_die_offset = false, has_parent = false;
+
+		abbrev = names_abbrev_vector_append_entry(&table->abbrevs);
+		if (!abbrev)
+			return &drgn_enomem;
+		if ((err = read_uleb128(&ptr, end, &abbrev->code)))
+			return err;
+		if (abbrev->code == 0) {
+			table->abbrevs.size--;
+			break;
+		}
+		if ((err = read_uleb128(&ptr, end, &abbrev->tag)))
+			return err;
+		if (abbrev->tag == DW_TAG_enumerator)
+			has_enumerator = true;
+		else if (abbrev->tag == DW_TAG_enumeration_type)
+			has_enumeration_type = true;
+		abbrev->attribs = table->attribs.size;
+		for (;;) {
+			uint64_t idx, form;
+
+			if ((err = read_uleb128(&ptr, end, &idx)) ||
+			    (err = read_uleb128(&ptr, end, &form)))
+				return err;
+			if (!uint64_vector_append(&table->attribs, &idx) ||
+			    !uint64_vector_append(&table->attribs, &form))
+				return &drgn_enomem;
+			if (idx == 0 && form == 0)
+				break;
+			if (idx == DRGN_DW_IDX_die_offset)
+				has_die_offset = true;
+			else if (idx == DRGN_DW_IDX_parent)
+				has_parent = true;
+		}
+		/*
+		 * We only index top-level DIEs, so we need to know whether each
+		 * entry has a parent. Older producers don't emit
+		 * DW_IDX_parent.
+		 */
+		if (!has_die_offset || !has_parent) {
+			*usable_ret = false;
+			return NULL;
+		}
+	}
+	/*
+	 * If there are enumeration types but no enumerators, then the
+	 * enumerators of anonymous enumeration types might not be indexed.
+	 */
+	*usable_ret = has_enumerator || !has_enumeration_type;
+	return NULL;
+}
+
+static const struct names_abbrev *
+names_abbrev_find(const struct names_abbrev_table *table, uint64_t code)
+{
+	size_t i;
+
+	/* Codes are usually sequential starting at one. */
+	if (code >= 1 && code <= table->abbrevs.size &&
+	    table->abbrevs.data[code - 1].code == code)
+		return &table->abbrevs.data[code - 1];
+	for (i = 0; i < table->abbrevs.size; i++) {
+		if (table->abbrevs.data[i].code == code)
+			return &table->abbrevs.data[i];
+	}
+	return NULL;
+}
+
+static struct drgn_error *read_names_form(const char **ptr, const char *end,
+					  uint64_t form, bool bswap,
+					  uint64_t *ret)
+{
+	uint8_t u8;
+
+	switch (form) {
+	case DW_FORM_flag_present:
+		*ret = 0;
+		return NULL;
+	case DW_FORM_data1:
+	case DW_FORM_ref1:
+	case DW_FORM_flag:
+		if (!read_u8(ptr, end, &u8))
+			return drgn_eof();
+		*ret = u8;
+		return NULL;
+	case DW_FORM_data2:
+	case DW_FORM_ref2:
+		if (!read_u16_into_u64(ptr, end, bswap, ret))
+			return drgn_eof();
+		return NULL;
+	case DW_FORM_data4:
+	case DW_FORM_ref4:
+		if (!read_u32_into_u64(ptr, end, bswap, ret))
+			return drgn_eof();
+		return NULL;
+	case DW_FORM_data8:
+	case DW_FORM_ref8:
+	case DW_FORM_ref_sig8:
+		if (!read_u64(ptr, end, bswap, ret))
+			return drgn_eof();
+		return NULL;
+	case DW_FORM_udata:
+	case DW_FORM_ref_udata:
+		return read_uleb128(ptr, end, ret);
+	default:
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "unknown .debug_names attribute form %" PRIu64,
+					 form);
+	}
+}
+
+static struct compilation_unit *find_cu(struct compilation_unit *cus,
+					size_t num_cus, uint64_t offset)
+{
+	const char *debug_info_buffer;
+	size_t lo = 0, hi = num_cus;
+
+	if (!num_cus)
+		return NULL;
+	debug_info_buffer = section_ptr(cus[0].sections[SECTION_DEBUG_INFO], 0);
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		uint64_t mid_offset = cus[mid].ptr - debug_info_buffer;
+
+		if (offset < mid_offset)
+			hi = mid;
+		else if (offset > mid_offset)
+			lo = mid + 1;
+		else
+			return &cus[mid];
+	}
+	return NULL;
+}
+
+/*
+ * Read one name index from .debug_names, adding the offsets of the top-level
+ * DIEs that it contains to the units that it covers.
+ */
+static struct drgn_error *read_name_index(struct compilation_unit *cus,
+					  size_t num_cus, const char **ptr,
+					  const char *end, bool bswap)
+{
+	struct drgn_error *err;
+	const char *buffer = *ptr, *unit_end;
+	uint32_t tmp;
+	bool is_64_bit;
+	uint64_t unit_length;
+	size_t offset_size;
+	uint16_t version, padding;
+	uint32_t comp_unit_count, local_type_unit_count;
+	uint32_t foreign_type_unit_count, bucket_count, name_count;
+	uint32_t abbrev_table_size, augmentation_string_size;
+	const char *cu_list, *entry_offsets, *abbrevs, *entry_pool;
+	uint64_t skip;
+	struct names_abbrev_table abbrev_table = {};
+	struct compilation_unit **cu_map = NULL;
+	bool usable;
+	uint32_t i;
+
+	if (!read_u32(&buffer, end, bswap, &tmp))
+		return drgn_eof();
+	is_64_bit = tmp == UINT32_C(0xffffffff);
+	if (is_64_bit) {
+		if (!read_u64(&buffer, end, bswap, &unit_length))
+			return drgn_eof();
+	} else {
+		unit_length = tmp;
+	}
+	if (unit_length > end - buffer)
+		return drgn_eof();
+	unit_end = buffer + unit_length;
+	*ptr = unit_end;
+	offset_size = is_64_bit ? 8 : 4;
+
+	if (!read_u16(&buffer, unit_end, bswap, &version))
+		return drgn_eof();
+	if (version != 5) {
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "unknown .debug_names version %" PRIu16,
+					 version);
+	}
+	if (!read_u16(&buffer, unit_end, bswap, &padding) ||
+	    !read_u32(&buffer, unit_end, bswap, &comp_unit_count) ||
+	    !read_u32(&buffer, unit_end, bswap, &local_type_unit_count) ||
+	    !read_u32(&buffer, unit_end, bswap, &foreign_type_unit_count) ||
+	    !read_u32(&buffer, unit_end, bswap, &bucket_count) ||
+	    !read_u32(&buffer, unit_end, bswap, &name_count) ||
+	    !read_u32(&buffer, unit_end, bswap, &abbrev_table_size) ||
+	    !read_u32(&buffer, unit_end, bswap, &augmentation_string_size))
+		return drgn_eof();
+
+	/* The sizes are all 32-bit, so this can't overflow. */
+	skip = ((augmentation_string_size + UINT64_C(3)) & ~UINT64_C(3));
+	cu_list = buffer + skip;
+	skip += ((uint64_t)comp_unit_count + local_type_unit_count) *
+		offset_size;
+	skip += (uint64_t)foreign_type_unit_count * 8;
+	skip += (uint64_t)bucket_count * 4;
+	if (bucket_count)
+		skip += (uint64_t)name_count * 4;
+	/* Skip the string offsets. */
+	skip += (uint64_t)name_count * offset_size;
+	entry_offsets = buffer + skip;
+	skip += (uint64_t)name_count * offset_size;
+	abbrevs = buffer + skip;
+	skip += abbrev_table_size;
+	if (skip > unit_end - buffer)
+		return drgn_eof();
+	entry_pool = buffer + skip;
+
+	err = read_names_abbrev_table(abbrevs, entry_pool, &abbrev_table,
+				      &usable);
+	if (err || !usable)
+		goto out;
+
+	if (comp_unit_count) {
+		cu_map = malloc_array(comp_unit_count, sizeof(*cu_map));
+		if (!cu_map) {
+			err = &drgn_enomem;
+			goto out;
+		}
+	}
+	for (i = 0; i < comp_unit_count; i++) {
+		const char *p = cu_list + i * offset_size;
+		uint64_t cu_offset;
+
+		if (is_64_bit)
+			read_u64_nocheck(&p, bswap, &cu_offset);
+		else
+			read_u32_into_u64_nocheck(&p, bswap, &cu_offset);
+		cu_map[i] = find_cu(cus, num_cus, cu_offset);
+		if (cu_map[i] && cu_map[i]->names == CU_NAMES_UNUSED)
+			cu_map[i]->names = CU_NAMES_USED;
+	}
+
+	for (i = 0; i < name_count; i++) {
+		const char *p = entry_offsets + i * offset_size;
+		uint64_t entry_offset;
+
+		if (is_64_bit)
+			read_u64_nocheck(&p, bswap, &entry_offset);
+		else
+			read_u32_into_u64_nocheck(&p, bswap, &entry_offset);
+		if (entry_offset > unit_end - entry_pool) {
+			err = drgn_eof();
+			goto out;
+		}
+		p = entry_pool + entry_offset;
+		for (;;) {
+			uint64_t code;
+			const struct names_abbrev *abbrev;
+			const uint64_t *attrib;
+			uint64_t cu_index = 0, die_offset = 0;
+			bool has_cu_index = false, type_unit = false;
+			bool has_parent = false;
+			struct compilation_unit *cu;
+			uint64_t cu_offset, cu_end;
+
+			if ((err = read_uleb128(&p, unit_end, &code)))
+				goto out;
+			if (code == 0)
+				break;
+			abbrev = names_abbrev_find(&abbrev_table, code);
+			if (!abbrev) {
+				err = drgn_error_format(DRGN_ERROR_OTHER,
+							"unknown .debug_names abbreviation code %" PRIu64,
+							code);
+				goto out;
+			}
+			for (attrib = &abbrev_table.attribs.data[abbrev->attribs];
+			     attrib[0] || attrib[1]; attrib += 2) {
+				uint64_t value;
+
+				if ((err = read_names_form(&p, unit_end,
+							   attrib[1], bswap,
+							   &value)))
+					goto out;
+				switch (attrib[0]) {
+				case DRGN_DW_IDX_compile_unit:
+					has_cu_index = true;
+					cu_index = value;
+					break;
+				case DRGN_DW_IDX_type_unit:
+					type_unit = true;
+					break;
+				case DRGN_DW_IDX_die_offset:
+					die_offset = value;
+					break;
+				case DRGN_DW_IDX_parent:
+					/*
+					 * DW_FORM_flag_present means that the
+					 * entry has no parent in the index.
+					 */
+					has_parent = (attrib[1] !=
+						      DW_FORM_flag_present);
+					break;
+				}
+			}
+
+			/* We don't index type units. */
+			if (type_unit)
+				continue;
+			if ((!has_cu_index && comp_unit_count != 1) ||
+			    cu_index >= comp_unit_count) {
+				err = drgn_error_create(DRGN_ERROR_OTHER,
+							"invalid .debug_names unit index");
+				goto out;
+			}
+			cu = cu_map[cu_index];
+			if (!cu || cu->names != CU_NAMES_USED)
+				continue;
+			if (abbrev->tag == DW_TAG_enumerator) {
+				/*
+				 * We index enumerators by their enumeration
+				 * type, which we find by walking the children
+				 * of the enumeration types in the index. If the
+				 * enumeration type isn't in the index, then we
+				 * have to scan the whole unit.
+				 */
+				if (!has_parent)
+					cu->names = CU_NAMES_REJECTED;
+				continue;
+			}
+			if (has_parent)
+				continue;
+
+			cu_offset = (cu->ptr -
+				     section_ptr(cu->sections[SECTION_DEBUG_INFO], 0));
+			cu_end = (cu->is_64_bit ? 12 : 4) + cu->unit_length;
+			if (die_offset < (cu->is_64_bit ? 23 : 11) ||
+			    die_offset >= cu_end) {
+				cu->names = CU_NAMES_REJECTED;
+				continue;
+			}
+			die_offset += cu_offset;
+			if (!uint64_vector_append(&cu->names_dies,
+						  &die_offset)) {
+				err = &drgn_enomem;
+				goto out;
+			}
+		}
+	}
+	err = NULL;
+out:
+	free(cu_map);
+	uint64_vector_deinit(&abbrev_table.attribs);
+	names_abbrev_vector_deinit(&abbrev_table.abbrevs);
+	return err;
+}
+
+static int uint64_cmp(const void *_a, const void *_b)
+{
+	uint64_t a = *(const uint64_t *)_a;
+	uint64_t b = *(const uint64_t *)_b;
+
+	return (a > b) - (a < b);
+}
+
+/*
+ * Read the .debug_names section for the units of a module. This is only an
+ * optimization, so if it can't be used, every unit is scanned instead.
+ */
+static struct drgn_error *read_debug_names(struct compilation_unit *cus,
+					   size_t num_cus,
+					   Elf_Data *debug_names, bool bswap)
+{
+	struct drgn_error *err = NULL;
+	const char *ptr = section_ptr(debug_names, 0);
+	const char *end = section_end(debug_names);
+	size_t i;
+
+	while (ptr < end) {
+		err = read_name_index(cus, num_cus, &ptr, end, bswap);
+		if (err)
+			break;
+	}
+
+	for (i = 0; i < num_cus; i++) {
+		struct compilation_unit *cu = &cus[i];
+
+		if (err || cu->names != CU_NAMES_USED) {
+			cu->names = CU_NAMES_UNUSED;
+			cu->names_dies.size = 0;
+		} else {
+			/* Index the DIEs in order to access memory sequentially. */
+			qsort(cu->names_dies.data, cu->names_dies.size,
+			      sizeof(cu->names_dies.data[0]), uint64_cmp);
+		}
+	}
+	if (err && err->code != DRGN_ERROR_NO_MEMORY) {
+		drgn_error_destroy(err);
+		err = NULL;
+	}
+	return err;
+}
+
+static struct drgn_error *
+read_dwfl_module_cus(struct drgn_dwarf_index *dindex,
+		     struct drgn_dwarf_module *module,
+		     Dwfl_Module *dwfl_module,
+		     struct drgn_dwfl_module_userdata *userdata,
+		     struct compilation_unit_vector *cus)
+{
+	struct drgn_error *err;
+	Dwarf *dwarf;
+	Dwarf_Addr bias;
+	Elf *elf;
+	Elf_Data *sections[DRGN_DWARF_INDEX_NUM_SECTIONS] = {};
+	bool bswap;
+	const char *ptr, *end;
+	bool use_cache;
+	size_t orig_cus_size;
+
+	userdata->relocate_ns = 0;
+	if (userdata->elf) {
+		uint64_t start, addresses_hash;
+		bool use_section_cache, mapped = false;
+
+		start = monotonic_ns();
+		use_section_cache =
+			(dindex->cache_dir && module->build_id_len &&
+			 section_cache_addresses_hash(userdata->elf,
+						     &addresses_hash));
+		if (use_section_cache) {
+			err = map_section_cache(dindex, module, userdata,
+						addresses_hash, &mapped);
+			if (err)
+				return err;
+		}
+		if (!mapped) {
+			err = decompress_debug_sections(userdata->elf);
+			if (err)
+				return err;
+
+			start = monotonic_ns();
+			err = apply_elf_relocations(userdata->elf);
+			if (err)
+				return err;
+		}
+		userdata->relocate_ns = monotonic_ns() - start;
+		if (use_section_cache && !mapped) {
+			write_section_cache(dindex, module, userdata->elf,
+					    addresses_hash);
+		}
+	}
+
+	/*
+	 * Note: not dwfl_module_getelf(), because then libdwfl applies
+	 * ELF relocations to all sections, not just debug sections.
+	 */
+	dwarf = dwfl_module_getdwarf(dwfl_module, &bias);
+	if (!dwarf)
+		return drgn_error_libdwfl();
+
+	elf = dwarf_getelf(dwarf);
+	if (!elf)
+		return drgn_error_libdw();
+
+	err = get_debug_sections(elf, sections, false);
+	if (err)
+		return err;
+
+	bswap = (elf_getident(elf, NULL)[EI_DATA] !=
+		 (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ?
+		  ELFDATA2LSB : ELFDATA2MSB));
+	userdata->debug_info_bytes = sections[SECTION_DEBUG_INFO]->d_size;
+
+	use_cache = dindex->cache_dir && module->build_id_len;
+	if (use_cache) {
+		const struct drgn_dwarf_index_cache_header *header;
+
+		header = map_cache(dindex, module->build_id,
+				   module->build_id_len,
+				   sections[SECTION_DEBUG_INFO]->d_size,
+				   userdata);
+		if (header) {
+			const char *entries_ptr;
+			const struct drgn_dwarf_index_cache_entry *entries;
+			uint64_t i;
+
+			entries_ptr = ((const char *)(header + 1) +
+				       cache_build_id_size(module->build_id_len));
+			entries = (const void *)entries_ptr;
+			for (i = 0; i < header->num_entries;
+			     i += DRGN_DWARF_INDEX_CACHE_CHUNK) {
+				struct compilation_unit *cu;
+
+				cu = compilation_unit_vector_append_entry(cus);
+				if (!cu)
+					return &drgn_enomem;
+				memset(cu, 0, sizeof(*cu));
+				cu->module = dwfl_module;
+				cu->split_stmt_list = SIZE_MAX;
+				cu->cache_entries = &entries[i];
+				cu->num_cache_entries =
+					min(header->num_entries - i,
+					    (uint64_t)DRGN_DWARF_INDEX_CACHE_CHUNK);
+				cu->cache_names = (const char *)&entries[header->num_entries];
+			}
+			return NULL;
+		}
+	}
+
+	orig_cus_size = cus->size;
+	ptr = section_ptr(sections[SECTION_DEBUG_INFO], 0);
+	end = section_end(sections[SECTION_DEBUG_INFO]);
+	while (ptr < end) {
+		struct compilation_unit *cu;
+
+		cu = compilation_unit_vector_append_entry(cus);
+		if (!cu)
+			return &drgn_enomem;
+		cu->module = dwfl_module;
+		memcpy(cu->sections, sections, sizeof(cu->sections));
+		cu->ptr = ptr;
+		cu->bswap = bswap;
+		if (use_cache) {
+			cu->build_id = module->build_id;
+			cu->build_id_len = module->build_id_len;
+		} else {
+			cu->build_id = NULL;
+			cu->build_id_len = 0;
+		}
+		drgn_dwarf_index_cache_record_vector_init(&cu->cache_records);
+		cu->cache_entries = NULL;
+		cu->num_cache_entries = 0;
+		cu->cache_names = NULL;
+		cu->num_dies = 0;
+		cu->split_dwarf = NULL;
+		cu->split_name = NULL;
+		cu->split_stmt_list = SIZE_MAX;
+		cu->skeleton = false;
+		cu->names = CU_NAMES_UNUSED;
+		uint64_vector_init(&cu->names_dies);
+		err = read_compilation_unit_header(ptr, end, cu);
+		if (err)
+			return err;
+
+		ptr += (cu->is_64_bit ? 12 : 4) + cu->unit_length;
+	}
+
+	if (sections[SECTION_DEBUG_NAMES]) {
+		return read_debug_names(&cus->data[orig_cus_size],
+					cus->size - orig_cus_size,
+					sections[SECTION_DEBUG_NAMES], bswap);
+	}
+	return NULL;
+}
+
+static struct drgn_error *read_module_cus(struct drgn_dwarf_index *dindex,
+					  struct drgn_dwarf_module *module,
+					  struct compilation_unit_vector *cus,
+					  const char **name_ret)
+{
+	struct drgn_error *err;
+	const size_t orig_cus_size = cus->size;
+	size_t i;
+
+	for (i = 0; i < module->dwfl_modules.size; i++) {
+		Dwfl_Module *dwfl_module;
+		void **userdatap;
+		struct drgn_dwfl_module_userdata *userdata;
+		uint64_t start;
+
+		dwfl_module = module->dwfl_modules.data[i];
+		*name_ret = dwfl_module_info(dwfl_module, &userdatap, NULL,
+					     NULL, NULL, NULL, NULL, NULL);
+		userdata = *userdatap;
+		start = monotonic_ns();
+		err = read_dwfl_module_cus(dindex, module, dwfl_module,
+					   userdata, cus);
+		userdata->read_ns = monotonic_ns() - start;
+		if (err) {
+			/*
+			 * Ignore the error unless we have no more Dwfl_Modules
+			 * to try.
+			 */
+			if (i == module->dwfl_modules.size - 1)
+				return err;
+			drgn_error_destroy(err);
+			cus->size = orig_cus_size;
+			continue;
+		}
+		userdata->state = DRGN_DWARF_MODULE_INDEXING;
+		module->state = DRGN_DWARF_MODULE_INDEXING;
+		return NULL;
+	}
+	UNREACHABLE();
+}
+
+static struct drgn_error *read_cus(struct drgn_dwarf_index *dindex,
+				   struct drgn_dwarf_module **unindexed,
+				   size_t num_unindexed,
+				   struct compilation_unit_vector *all_cus)
+{
+	struct drgn_error *err = NULL;
+
+	#pragma omp parallel num_threads(drgn_num_threads())
+	{
+		struct compilation_unit_vector cus = VECTOR_INIT;
+
+		#pragma omp for schedule(dynamic)
+		for (size_t i = 0; i < num_unindexed; i++) {
+			struct drgn_error *module_err;
+			const char *name;
 
 			if (err)
 				continue;
 
-			module_err = read_module_cus(unindexed[i], &cus, &name);
+			module_err = read_module_cus(dindex, unindexed[i], &cus,
+						     &name);
 			if (module_err) {
 				#pragma omp critical(drgn_read_cus)
 				if (err) {
@@ -1461,13 +3406,19 @@ static struct drgn_error *read_abbrev_decl(const char **ptr, const char *end,
 			case DW_FORM_string:
 				insn = ATTRIB_NAME_STRING;
 				goto append_insn;
+			case DW_FORM_GNU_str_index:
+				if (!cu->sections[SECTION_DEBUG_STR_OFFSETS])
+					break;
+				insn = ATTRIB_NAME_STR_INDEX;
+				goto append_insn;
 			default:
 				break;
 			}
 		} else if (name == DW_AT_stmt_list &&
 			   (tag == DW_TAG_compile_unit ||
 			    tag == DW_TAG_partial_unit) &&
-			   cu->sections[SECTION_DEBUG_LINE]) {
+			   cu->sections[SECTION_DEBUG_LINE] &&
+			   !cu->split_dwarf) {
 			switch (form) {
 			case DW_FORM_data4:
 				insn = ATTRIB_STMT_LIST_LINEPTR4;
@@ -1510,6 +3461,9 @@ static struct drgn_error *read_abbrev_decl(const char **ptr, const char *end,
 			default:
 				break;
 			}
+		} else if (name == DW_AT_GNU_dwo_id &&
+			   tag == DW_TAG_compile_unit && !cu->split_dwarf) {
+			die_flags |= TAG_FLAG_SKELETON;
 		} else if (name == DW_AT_declaration) {
 			/*
 			 * In theory, this could be DW_FORM_flag with a value of
@@ -1576,6 +3530,19 @@ static struct drgn_error *read_abbrev_decl(const char **ptr, const char *end,
 		case DW_FORM_sdata:
 		case DW_FORM_udata:
 		case DW_FORM_ref_udata:
+		case DW_FORM_GNU_addr_index:
+		case DW_FORM_GNU_str_index:
+			/* Merge consecutive LEB128 attributes. */
+			if (!first) {
+				uint8_t *last_insn;
+
+				last_insn = &abbrev->insns.data[abbrev->insns.size - 1];
+				if (*last_insn >= ATTRIB_LEB128 &&
+				    *last_insn < ATTRIB_LEB128_4) {
+					(*last_insn)++;
+					continue;
+				}
+			}
 			insn = ATTRIB_LEB128;
 			goto append_insn;
 		case DW_FORM_ref_addr:
@@ -1703,9 +3670,19 @@ static void hash_directory(struct siphash *hash, const char *path,
 
 DEFINE_VECTOR(siphash_vector, struct siphash)
 
+/*
+ * Hashes of include directories by path. Most units in a module have the same
+ * include directories, so each indexing thread keeps the hashes of the ones it
+ * has seen instead of canonicalizing and hashing them again for every unit. The
+ * paths point into the line number program sections.
+ */
+DEFINE_HASH_MAP(drgn_directory_hash_map, struct string, struct siphash,
+		string_hash, string_eq)
+
 static struct drgn_error *
 read_file_name_table(struct drgn_dwarf_index *dindex,
 		     struct compilation_unit *cu, size_t stmt_list,
+		     struct drgn_directory_hash_map *directory_hashes,
 		     struct uint64_vector *file_name_table)
 {
 	/*
@@ -1737,8 +3714,27 @@ read_file_name_table(struct drgn_dwarf_index *dindex,
 			err = &drgn_enomem;
 			goto out;
 		}
+
+		struct drgn_directory_hash_map_entry entry = {
+			.key = { path, path_len },
+		};
+		struct hash_pair hp = drgn_directory_hash_map_hash(&entry.key);
+		struct drgn_directory_hash_map_iterator it =
+			drgn_directory_hash_map_search_hashed(directory_hashes,
+							      &entry.key, hp);
+		if (it.entry) {
+			*hash = it.entry->value;
+			continue;
+		}
 		siphash_init(hash, siphash_key);
 		hash_directory(hash, path, path_len);
+		entry.value = *hash;
+		if (drgn_directory_hash_map_insert_searched(directory_hashes,
+							    &entry, hp,
+							    NULL) == -1) {
+			err = &drgn_enomem;
+			goto out;
+		}
 	}
 
 	for (;;) {
@@ -1788,11 +3784,14 @@ out:
 }
 
 static bool append_die_entry(struct drgn_dwarf_index_shard *shard, uint64_t tag,
-			     uint64_t file_name_hash, Dwfl_Module *module,
+			     uint64_t file_name_hash, uint32_t module,
 			     uint64_t offset)
 {
 	struct drgn_dwarf_index_die *die;
 
+	/* UINT32_MAX is reserved for drgn_dwarf_index_die::next. */
+	if (shard->dies.size == UINT32_MAX)
+		return false;
 	die = drgn_dwarf_index_die_vector_append_entry(&shard->dies);
 	if (!die)
 		return false;
@@ -1800,14 +3799,39 @@ static bool append_die_entry(struct drgn_dwarf_index_shard *shard, uint64_t tag,
 	die->file_name_hash = file_name_hash;
 	die->module = module;
 	die->offset = offset;
-	die->next = SIZE_MAX;
+	die->next = UINT32_MAX;
+	return true;
+}
+
+static bool
+append_cache_record(struct drgn_dwarf_index_cache_record_vector *records,
+		    const char *name, uint64_t tag, uint64_t file_name_hash,
+		    uint64_t offset)
+{
+	struct drgn_dwarf_index_cache_record *record;
+
+	if (!records)
+		return true;
+	record = drgn_dwarf_index_cache_record_vector_append_entry(records);
+	if (!record)
+		return false;
+	record->name = name;
+	record->tag = tag;
+	record->file_name_hash = file_name_hash;
+	record->offset = offset;
 	return true;
 }
 
-static struct drgn_error *index_die(struct drgn_dwarf_index *dindex,
-				    const char *name, uint64_t tag,
-				    uint64_t file_name_hash,
-				    Dwfl_Module *module, uint64_t offset)
+/*
+ * If @p records is not NULL, the DIE is also appended to it unless it is a
+ * duplicate of a DIE that was already indexed from the same module. Note that
+ * it must be appended even if it is a duplicate of a DIE from another module,
+ * since the cache for this module must be usable on its own.
+ */
+static struct drgn_error *
+index_die(struct drgn_dwarf_index *dindex, const char *name, uint64_t tag,
+	  uint64_t file_name_hash, uint32_t module, uint64_t offset,
+	  struct drgn_dwarf_index_cache_record_vector *records)
 {
 	struct drgn_error *err;
 	struct drgn_dwarf_index_die_map_entry entry = {
@@ -1823,7 +3847,8 @@ static struct drgn_error *index_die(struct drgn_dwarf_index *dindex,
 	struct drgn_dwarf_index_die *die;
 
 	hp = drgn_dwarf_index_die_map_hash(&entry.key);
-	shard = &dindex->shards[hash_pair_to_shard(hp)];
+	shard = &dindex->shards[hash_pair_to_shard(hp,
+						   DRGN_DWARF_INDEX_SHARD_BITS)];
 	omp_set_lock(&shard->lock);
 	it = drgn_dwarf_index_die_map_search_hashed(&shard->map, &entry.key,
 						    hp);
@@ -1836,22 +3861,24 @@ static struct drgn_error *index_die(struct drgn_dwarf_index *dindex,
 		entry.value = shard->dies.size - 1;
 		if (drgn_dwarf_index_die_map_insert_searched(&shard->map,
 							     &entry, hp,
-							     NULL) == 1)
-			err = NULL;
-		else
+							     NULL) != 1) {
 			err = &drgn_enomem;
-		goto out;
+			goto out;
+		}
+		goto record;
 	}
 
 	die = &shard->dies.data[it.entry->value];
 	for (;;) {
 		if (die->tag == tag &&
-		    die->file_name_hash == file_name_hash) {
+		    die->file_name_hash == (uint32_t)file_name_hash) {
+			if (die->module != module)
+				goto record;
 			err = NULL;
 			goto out;
 		}
 
-		if (die->next == SIZE_MAX)
+		if (die->next == UINT32_MAX)
 			break;
 		die = &shard->dies.data[die->next];
 	}
@@ -1862,12 +3889,37 @@ static struct drgn_error *index_die(struct drgn_dwarf_index *dindex,
 		goto out;
 	}
 	shard->dies.data[index].next = shard->dies.size - 1;
-	err = NULL;
+record:
+	if (append_cache_record(records, name, tag, file_name_hash, offset))
+		err = NULL;
+	else
+		err = &drgn_enomem;
 out:
 	omp_unset_lock(&shard->lock);
 	return err;
 }
 
+static struct drgn_error *index_cached_cu(struct drgn_dwarf_index *dindex,
+					  struct compilation_unit *cu)
+{
+	struct drgn_error *err;
+	size_t i;
+
+	for (i = 0; i < cu->num_cache_entries; i++) {
+		const struct drgn_dwarf_index_cache_entry *entry;
+
+		entry = &cu->cache_entries[i];
+		err = index_die(dindex, &cu->cache_names[entry->name],
+				entry->tag, entry->file_name_hash,
+				cu->module_index,
+				entry->offset, NULL);
+		if (err)
+			return err;
+	}
+	cu->num_dies += cu->num_cache_entries;
+	return NULL;
+}
+
 struct die {
 	const char *sibling;
 	const char *name;
@@ -1921,7 +3973,10 @@ static struct drgn_error *read_die(struct compilation_unit *cu,
 				return err;
 			goto skip;
 		case ATTRIB_LEB128:
-			if (!skip_leb128(ptr, end))
+		case ATTRIB_LEB128_2:
+		case ATTRIB_LEB128_3:
+		case ATTRIB_LEB128_4:
+			if (!skip_leb128s(ptr, end, insn - ATTRIB_LEB128 + 1))
 				return drgn_eof();
 			break;
 		case ATTRIB_NAME_STRING:
@@ -1970,6 +4025,33 @@ strp:
 			die->name = &debug_str_buffer[tmp];
 			__builtin_prefetch(die->name);
 			break;
+		case ATTRIB_NAME_STR_INDEX: {
+			Elf_Data *str_offsets;
+			const char *str_offsets_ptr, *str_offsets_end;
+			size_t offset_size = cu->is_64_bit ? 8 : 4;
+
+			if ((err = read_uleb128_into_size_t(ptr, end, &tmp)))
+				return err;
+			str_offsets = cu->sections[SECTION_DEBUG_STR_OFFSETS];
+			str_offsets_ptr = section_ptr(str_offsets, 0);
+			str_offsets_end = section_end(str_offsets);
+			if (tmp >= (str_offsets_end - str_offsets_ptr) /
+				   offset_size)
+				return drgn_eof();
+			str_offsets_ptr += tmp * offset_size;
+			if (cu->is_64_bit) {
+				if (!read_u64_into_size_t(&str_offsets_ptr,
+							  str_offsets_end,
+							  cu->bswap, &tmp))
+					return drgn_eof();
+			} else {
+				if (!read_u32_into_size_t(&str_offsets_ptr,
+							  str_offsets_end,
+							  cu->bswap, &tmp))
+					return drgn_eof();
+			}
+			goto strp;
+		}
 		case ATTRIB_STMT_LIST_LINEPTR4:
 			if (!read_u32_into_size_t(ptr, end, cu->bswap,
 						  &die->stmt_list))
@@ -2044,8 +4126,51 @@ skip:
 	return NULL;
 }
 
-static struct drgn_error *index_cu(struct drgn_dwarf_index *dindex,
-				   struct compilation_unit *cu)
+/* Index a DIE read from a unit, resolving its name and file if necessary. */
+static struct drgn_error *
+index_cu_die(struct drgn_dwarf_index *dindex, struct compilation_unit *cu,
+	     const struct abbrev_table *abbrev, const char *end,
+	     const char *debug_str_buffer, const char *debug_str_end,
+	     struct die *die, uint64_t tag, uint64_t die_offset,
+	     const struct uint64_vector *file_name_table)
+{
+	struct drgn_error *err;
+	uint64_t file_name_hash;
+
+	if (die->specification && (!die->name || !die->decl_file)) {
+		struct die decl = {};
+		const char *decl_ptr = die->specification;
+
+		if ((err = read_die(cu, abbrev, &decl_ptr, end,
+				    debug_str_buffer, debug_str_end, &decl)))
+			return err;
+		if (!die->name && decl.name)
+			die->name = decl.name;
+		if (!die->decl_file && decl.decl_file)
+			die->decl_file = decl.decl_file;
+	}
+
+	if (!die->name)
+		return NULL;
+	if (die->decl_file > file_name_table->size) {
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "invalid DW_AT_decl_file %zu",
+					 die->decl_file);
+	}
+	if (die->decl_file)
+		file_name_hash = file_name_table->data[die->decl_file - 1];
+	else
+		file_name_hash = 0;
+	cu->num_dies++;
+	return index_die(dindex, die->name, tag, file_name_hash,
+			 cu->module_index,
+			 die_offset,
+			 cu->build_id ? &cu->cache_records : NULL);
+}
+
+static struct drgn_error *
+index_cu(struct drgn_dwarf_index *dindex, struct compilation_unit *cu,
+	 struct drgn_directory_hash_map *directory_hashes)
 {
 	struct drgn_error *err;
 	struct abbrev_table abbrev = ABBREV_TABLE_INIT;
@@ -2089,14 +4214,23 @@ static struct drgn_error *index_cu(struct drgn_dwarf_index *dindex,
 
 		tag = die.flags & TAG_MASK;
 		if (tag == DW_TAG_compile_unit || tag == DW_TAG_partial_unit) {
-			if (depth == 0 && die.stmt_list != SIZE_MAX &&
-			    (err = read_file_name_table(dindex, cu,
-							die.stmt_list,
-							&file_name_table)))
-				goto out;
+			if (depth == 0) {
+				size_t stmt_list = die.stmt_list;
+
+				if (stmt_list == SIZE_MAX)
+					stmt_list = cu->split_stmt_list;
+				if (stmt_list != SIZE_MAX &&
+				    (err = read_file_name_table(dindex, cu,
+								stmt_list,
+								directory_hashes,
+								&file_name_table)))
+					goto out;
+				if (die.flags & TAG_FLAG_SKELETON) {
+					cu->skeleton = true;
+					cu->skeleton_stmt_list = die.stmt_list;
+				}
+			}
 		} else if (tag && !(die.flags & TAG_FLAG_DECLARATION)) {
-			uint64_t file_name_hash;
-
 			/*
 			 * NB: the enumerator name points to the
 			 * enumeration_type DIE instead of the enumerator DIE.
@@ -2109,36 +4243,12 @@ static struct drgn_error *index_cu(struct drgn_dwarf_index *dindex,
 			else if (depth != 1)
 				goto next;
 
-			if (die.specification && (!die.name || !die.decl_file)) {
-				struct die decl = {};
-				const char *decl_ptr = die.specification;
-
-				if ((err = read_die(cu, &abbrev, &decl_ptr, end,
-						    debug_str_buffer,
-						    debug_str_end, &decl)))
-					goto out;
-				if (!die.name && decl.name)
-					die.name = decl.name;
-				if (!die.decl_file && decl.decl_file)
-					die.decl_file = decl.decl_file;
-			}
-
-			if (die.name) {
-				if (die.decl_file > file_name_table.size) {
-					err = drgn_error_format(DRGN_ERROR_OTHER,
-								"invalid DW_AT_decl_file %zu",
-								die.decl_file);
-					goto out;
-				}
-				if (die.decl_file)
-					file_name_hash = file_name_table.data[die.decl_file - 1];
-				else
-					file_name_hash = 0;
-				if ((err = index_die(dindex, die.name, tag,
-						     file_name_hash, cu->module,
-						     die_offset)))
-					goto out;
-			}
+			if ((err = index_cu_die(dindex, cu, &abbrev, end,
+						debug_str_buffer,
+						debug_str_end, &die, tag,
+						die_offset,
+						&file_name_table)))
+				goto out;
 		}
 
 next:
@@ -2159,10 +4269,151 @@ out:
 	return err;
 }
 
-static void rollback_dwarf_index(struct drgn_dwarf_index *dindex)
+/*
+ * Index the DIEs of a unit that were found in .debug_names. This is equivalent
+ * to index_cu() but only reads the top-level DIEs that have a name and the
+ * children of enumeration types.
+ */
+static struct drgn_error *
+index_cu_names(struct drgn_dwarf_index *dindex, struct compilation_unit *cu,
+	       struct drgn_directory_hash_map *directory_hashes)
+{
+	struct drgn_error *err;
+	struct abbrev_table abbrev = ABBREV_TABLE_INIT;
+	struct uint64_vector file_name_table = VECTOR_INIT;
+	Elf_Data *debug_abbrev = cu->sections[SECTION_DEBUG_ABBREV];
+	const char *debug_abbrev_end = section_end(debug_abbrev);
+	const char *ptr = &cu->ptr[cu->is_64_bit ? 23 : 11];
+	const char *end = &cu->ptr[(cu->is_64_bit ? 12 : 4) + cu->unit_length];
+	Elf_Data *debug_info = cu->sections[SECTION_DEBUG_INFO];
+	const char *debug_info_buffer = section_ptr(debug_info, 0);
+	Elf_Data *debug_str = cu->sections[SECTION_DEBUG_STR];
+	const char *debug_str_buffer = section_ptr(debug_str, 0);
+	const char *debug_str_end = section_end(debug_str);
+	struct die cu_die = {
+		.stmt_list = SIZE_MAX,
+	};
+	uint64_t tag;
+	size_t i;
+
+	if ((err = read_abbrev_table(section_ptr(debug_abbrev,
+						 cu->debug_abbrev_offset),
+				     debug_abbrev_end, cu, &abbrev)))
+		goto out;
+
+	err = read_die(cu, &abbrev, &ptr, end, debug_str_buffer,
+		       debug_str_end, &cu_die);
+	if (err && err->code == DRGN_ERROR_STOP) {
+		err = NULL;
+		goto out;
+	} else if (err) {
+		goto out;
+	}
+	tag = cu_die.flags & TAG_MASK;
+	if ((tag == DW_TAG_compile_unit || tag == DW_TAG_partial_unit) &&
+	    cu_die.stmt_list != SIZE_MAX &&
+	    (err = read_file_name_table(dindex, cu, cu_die.stmt_list,
+					directory_hashes, &file_name_table)))
+		goto out;
+	if (cu_die.flags & TAG_FLAG_SKELETON) {
+		cu->skeleton = true;
+		cu->skeleton_stmt_list = cu_die.stmt_list;
+	}
+
+	for (i = 0; i < cu->names_dies.size; i++) {
+		struct die die = {
+			.stmt_list = SIZE_MAX,
+		};
+		uint64_t die_offset = cu->names_dies.data[i];
+		unsigned int depth;
+
+		/* The same DIE may be listed under multiple names. */
+		if (i > 0 && die_offset == cu->names_dies.data[i - 1])
+			continue;
+
+		ptr = debug_info_buffer + die_offset;
+		err = read_die(cu, &abbrev, &ptr, end, debug_str_buffer,
+			       debug_str_end, &die);
+		if (err && err->code == DRGN_ERROR_STOP)
+			continue;
+		else if (err)
+			goto out;
+
+		tag = die.flags & TAG_MASK;
+		if (!tag || (die.flags & TAG_FLAG_DECLARATION))
+			continue;
+		if ((err = index_cu_die(dindex, cu, &abbrev, end,
+					debug_str_buffer, debug_str_end, &die,
+					tag, die_offset, &file_name_table)))
+			goto out;
+		if (tag != DW_TAG_enumeration_type ||
+		    !(die.flags & TAG_FLAG_CHILDREN))
+			continue;
+
+		/*
+		 * NB: the enumerator name points to the enumeration_type DIE
+		 * instead of the enumerator DIE.
+		 */
+		depth = 1;
+		for (;;) {
+			struct die child = {
+				.stmt_list = SIZE_MAX,
+			};
+
+			err = read_die(cu, &abbrev, &ptr, end,
+				       debug_str_buffer, debug_str_end, &child);
+			if (err && err->code == DRGN_ERROR_STOP) {
+				if (--depth == 0)
+					break;
+				continue;
+			} else if (err) {
+				goto out;
+			}
+
+			tag = child.flags & TAG_MASK;
+			if (depth == 1 && tag == DW_TAG_enumerator &&
+			    !(child.flags & TAG_FLAG_DECLARATION) &&
+			    (err = index_cu_die(dindex, cu, &abbrev, end,
+						debug_str_buffer,
+						debug_str_end, &child, tag,
+						die_offset, &file_name_table)))
+				goto out;
+
+			if (child.flags & TAG_FLAG_CHILDREN) {
+				if (child.sibling)
+					ptr = child.sibling;
+				else
+					depth++;
+			}
+		}
+	}
+
+	err = NULL;
+out:
+	uint64_vector_deinit(&file_name_table);
+	abbrev_table_deinit(&abbrev);
+	return err;
+}
+
+/* Discard the sorted list of names, which is rebuilt when it's next needed. */
+static void drgn_dwarf_index_invalidate_names(struct drgn_dwarf_index *dindex)
+{
+	free(dindex->sorted_names);
+	dindex->sorted_names = NULL;
+	dindex->num_sorted_names = 0;
+}
+
+/*
+ * Remove everything that was added to the index since it had orig_num_modules
+ * modules and orig_num_split_units pending split units.
+ */
+static void rollback_dwarf_index(struct drgn_dwarf_index *dindex,
+				 size_t orig_num_modules,
+				 size_t orig_num_split_units)
 {
 	size_t i;
 
+	drgn_dwarf_index_invalidate_names(dindex);
 	for (i = 0; i < ARRAY_SIZE(dindex->shards); i++) {
 		struct drgn_dwarf_index_shard *shard;
 		struct drgn_dwarf_index_die *die;
@@ -2176,19 +4427,10 @@ static void rollback_dwarf_index(struct drgn_dwarf_index *dindex)
 		 * last update, we can just shrink the dies array to the first
 		 * entry that was added for this update.
 		 */
-		while (shard->dies.size) {
-			void **userdatap;
-			struct drgn_dwfl_module_userdata *userdata;
-
-			die = &shard->dies.data[shard->dies.size - 1];
-			dwfl_module_info(die->module, &userdatap, NULL,
-					 NULL, NULL, NULL, NULL, NULL);
-			userdata = *userdatap;
-			if (userdata->state == DRGN_DWARF_MODULE_INDEXED)
-				break;
-			else
-				shard->dies.size--;
-		}
+		while (shard->dies.size &&
+		       shard->dies.data[shard->dies.size - 1].module >=
+		       orig_num_modules)
+			shard->dies.size--;
 
 		/*
 		 * The new entries may be chained off of existing entries;
@@ -2196,11 +4438,11 @@ static void rollback_dwarf_index(struct drgn_dwarf_index *dindex)
 		 * entries must also be new, so there's no need to preserve
 		 * them.
 		 */
-		for (index = 0; index < shard->dies.size; i++) {
+		for (index = 0; index < shard->dies.size; index++) {
 			die = &shard->dies.data[index];
-			if (die->next != SIZE_MAX &&
+			if (die->next != UINT32_MAX &&
 			    die->next >= shard->dies.size)
-				die->next = SIZE_MAX;
+				die->next = UINT32_MAX;
 		}
 
 		/* Finally, delete the new entries in the map. */
@@ -2214,37 +4456,369 @@ static void rollback_dwarf_index(struct drgn_dwarf_index *dindex)
 			}
 		}
 	}
+
+	/* The new modules are also at the end. */
+	dindex->die_modules.size = orig_num_modules;
+	dindex->module_stats.size = orig_num_modules;
+	dindex->split_units.size = orig_num_split_units;
+}
+
+/* Add a module whose units are about to be indexed to the index. */
+static struct drgn_error *index_cus_add_module(struct drgn_dwarf_index *dindex,
+					       struct compilation_unit *cu)
+{
+	struct drgn_debug_info_module_stats_vector *module_stats =
+		&dindex->module_stats;
+	struct drgn_debug_info_module_stats *stats;
+	struct drgn_dwarf_index_die_module die_module = {
+		.module = cu->module,
+		.split_dwarf = cu->split_dwarf,
+	};
+	void **userdatap;
+	struct drgn_dwfl_module_userdata *userdata;
+	const char *name;
+
+	if (dindex->die_modules.size == UINT32_MAX)
+		return &drgn_enomem;
+	stats = drgn_debug_info_module_stats_vector_append_entry(module_stats);
+	if (!stats)
+		return &drgn_enomem;
+	if (!drgn_dwarf_index_die_module_vector_append(&dindex->die_modules,
+						       &die_module)) {
+		module_stats->size--;
+		return &drgn_enomem;
+	}
+	name = dwfl_module_info(cu->module, &userdatap, NULL, NULL, NULL, NULL,
+				NULL, NULL);
+	userdata = *userdatap;
+	memset(stats, 0, sizeof(*stats));
+	if (cu->split_dwarf) {
+		/* Split units are read when they are indexed. */
+		stats->name = cu->split_name ? cu->split_name : name;
+		stats->debug_info_bytes =
+			cu->sections[SECTION_DEBUG_INFO]->d_size;
+	} else {
+		stats->name = name;
+		stats->read_ns = userdata->read_ns;
+		stats->relocate_ns = userdata->relocate_ns;
+		stats->debug_info_bytes = userdata->debug_info_bytes;
+	}
+	stats->cached = cu->cache_entries;
+	DRGN_PROBE(index_module_begin, stats->name, stats->debug_info_bytes,
+		   stats->cached);
+	return NULL;
 }
 
+/*
+ * Index the given units. modules_done is the number of modules reported to the
+ * progress callback so far in this load, and total_modules is the number of
+ * modules in the whole load, or 0 if it is only these units' modules.
+ */
 static struct drgn_error *index_cus(struct drgn_dwarf_index *dindex,
 				    struct compilation_unit *cus,
-				    size_t num_cus)
+				    size_t num_cus, size_t *modules_done,
+				    size_t total_modules)
 {
 	struct drgn_error *err = NULL;
+	const size_t orig_num_modules = dindex->die_modules.size;
+	size_t *pending_cus = NULL;
+	size_t num_modules;
 	size_t i;
 
-	#pragma omp parallel for schedule(dynamic)
+	drgn_dwarf_index_invalidate_names(dindex);
+	/*
+	 * The units of a module (or split DWARF file) are contiguous, so we
+	 * only need to compare against the last module that we added.
+	 */
 	for (i = 0; i < num_cus; i++) {
-		struct drgn_error *cu_err;
+		struct drgn_dwarf_index_die_module_vector *die_modules =
+			&dindex->die_modules;
+
+		if (die_modules->size == orig_num_modules ||
+		    die_modules->data[die_modules->size - 1].module !=
+		    cus[i].module ||
+		    die_modules->data[die_modules->size - 1].split_dwarf !=
+		    cus[i].split_dwarf) {
+			err = index_cus_add_module(dindex, &cus[i]);
+			if (err)
+				return err;
+		}
+		cus[i].module_index = die_modules->size - 1;
+		if (!cus[i].cache_entries)
+			dindex->module_stats.data[cus[i].module_index].cus++;
+	}
 
-		if (err)
-			continue;
+	num_modules = dindex->die_modules.size - orig_num_modules;
+	if (!total_modules)
+		total_modules = num_modules;
+	/*
+	 * Count the units left in each module so that we know when the module
+	 * is done, for the progress callback and the index_module_end probe.
+	 */
+	if (num_modules) {
+		pending_cus = calloc(num_modules, sizeof(*pending_cus));
+		if (!pending_cus)
+			return &drgn_enomem;
+		for (i = 0; i < num_cus; i++)
+			pending_cus[cus[i].module_index - orig_num_modules]++;
+	}
+
+	#pragma omp parallel num_threads(drgn_num_threads())
+	{
+		struct drgn_directory_hash_map directory_hashes;
+
+		drgn_directory_hash_map_init(&directory_hashes);
+		#pragma omp for schedule(dynamic)
+		for (i = 0; i < num_cus; i++) {
+			struct drgn_debug_info_module_stats *stats;
+			struct drgn_error *cu_err;
+			uint64_t start;
 
-		cu_err = index_cu(dindex, &cus[i]);
-		if (cu_err) {
-			#pragma omp critical(drgn_index_cus)
 			if (err)
-				drgn_error_destroy(cu_err);
-			else
-				err = cu_err;
+				continue;
+
+			start = monotonic_ns();
+			if (cus[i].cache_entries) {
+				cu_err = index_cached_cu(dindex, &cus[i]);
+			} else if (cus[i].names == CU_NAMES_USED) {
+				cu_err = index_cu_names(dindex, &cus[i],
+							&directory_hashes);
+			} else {
+				cu_err = index_cu(dindex, &cus[i],
+						  &directory_hashes);
+			}
+			if (cu_err) {
+				#pragma omp critical(drgn_index_cus)
+				if (err)
+					drgn_error_destroy(cu_err);
+				else
+					err = cu_err;
+				continue;
+			}
+
+			stats = &dindex->module_stats.data[cus[i].module_index];
+			__atomic_fetch_add(&stats->index_ns,
+					   monotonic_ns() - start,
+					   __ATOMIC_RELAXED);
+			__atomic_fetch_add(&stats->dies, cus[i].num_dies,
+					   __ATOMIC_RELAXED);
+			if (pending_cus &&
+			    __atomic_sub_fetch(&pending_cus[cus[i].module_index -
+							    orig_num_modules],
+					       1, __ATOMIC_ACQ_REL) == 0) {
+				DRGN_PROBE(index_module_end, stats->name,
+					   stats->dies, stats->index_ns);
+				if (dindex->progress_fn) {
+					#pragma omp critical(drgn_index_cus_progress)
+					dindex->progress_fn(stats,
+							    ++*modules_done,
+							    total_modules,
+							    dindex->progress_arg);
+				}
+			}
+		}
+		drgn_directory_hash_map_deinit(&directory_hashes);
+	}
+	free(pending_cus);
+	return err;
+}
+
+/*
+ * Save the index entries for the given units, which must all belong to the
+ * same module, in the cache. The cache is only an optimization, so this fails
+ * silently.
+ */
+static void write_cache(struct drgn_dwarf_index *dindex,
+			struct compilation_unit *cus, size_t num_cus)
+{
+	static const char padding[8];
+	struct drgn_dwarf_index_cache_header header = {
+		.magic = DRGN_DWARF_INDEX_CACHE_MAGIC,
+		.version = DRGN_DWARF_INDEX_CACHE_VERSION,
+		.byte_order = DRGN_DWARF_INDEX_CACHE_BYTE_ORDER,
+		.build_id_len = cus[0].build_id_len,
+		.debug_info_size = cus[0].sections[SECTION_DEBUG_INFO]->d_size,
+	};
+	char *path = NULL, *tmp_path = NULL;
+	int fd;
+	FILE *file;
+	size_t i, j;
+	uint64_t name;
+	bool ok;
+
+	for (i = 0; i < num_cus; i++) {
+		struct drgn_dwarf_index_cache_record_vector *records;
+
+		records = &cus[i].cache_records;
+		header.num_entries += records->size;
+		for (j = 0; j < records->size; j++)
+			header.names_size += strlen(records->data[j].name) + 1;
+	}
+
+	if (!mkdir_parents(dindex->cache_dir))
+		return;
+	path = cache_path(dindex, cus[0].build_id, cus[0].build_id_len,
+			  ".idx");
+	tmp_path = cache_path(dindex, cus[0].build_id, cus[0].build_id_len,
+			      ".idx.XXXXXX");
+	if (!path || !tmp_path)
+		goto out;
+	fd = mkstemp(tmp_path);
+	if (fd == -1)
+		goto out;
+	file = fdopen(fd, "w");
+	if (!file) {
+		close(fd);
+		unlink(tmp_path);
+		goto out;
+	}
+
+	ok = (fwrite(&header, sizeof(header), 1, file) == 1 &&
+	      fwrite(cus[0].build_id, 1, header.build_id_len, file) ==
+	      header.build_id_len &&
+	      fwrite(padding, 1,
+		     cache_build_id_size(header.build_id_len) -
+		     header.build_id_len, file) ==
+	      cache_build_id_size(header.build_id_len) - header.build_id_len);
+	name = 0;
+	for (i = 0; ok && i < num_cus; i++) {
+		struct drgn_dwarf_index_cache_record_vector *records;
+
+		records = &cus[i].cache_records;
+		for (j = 0; ok && j < records->size; j++) {
+			struct drgn_dwarf_index_cache_record *record;
+			struct drgn_dwarf_index_cache_entry entry;
+
+			record = &records->data[j];
+			entry.tag = record->tag;
+			entry.file_name_hash = record->file_name_hash;
+			entry.offset = record->offset;
+			entry.name = name;
+			name += strlen(record->name) + 1;
+			ok = fwrite(&entry, sizeof(entry), 1, file) == 1;
 		}
 	}
+	for (i = 0; ok && i < num_cus; i++) {
+		struct drgn_dwarf_index_cache_record_vector *records;
+
+		records = &cus[i].cache_records;
+		for (j = 0; ok && j < records->size; j++) {
+			const char *record_name = records->data[j].name;
+
+			ok = fputs(record_name, file) != EOF &&
+			     fputc('\0', file) != EOF;
+		}
+	}
+	if (fclose(file) == EOF)
+		ok = false;
+	/* Replace the cache file atomically in case it's being read. */
+	if (!ok || rename(tmp_path, path) == -1)
+		unlink(tmp_path);
+out:
+	free(tmp_path);
+	free(path);
+}
+
+static void write_caches(struct drgn_dwarf_index *dindex,
+			 struct compilation_unit *cus, size_t num_cus)
+{
+	size_t i, j;
+
+	for (i = 0; i < num_cus; i = j) {
+		for (j = i + 1; j < num_cus; j++) {
+			if (cus[j].module != cus[i].module)
+				break;
+		}
+		if (cus[i].build_id)
+			write_cache(dindex, &cus[i], j - i);
+	}
+}
+
+/*
+ * Remember the skeleton units that were found while indexing so that their
+ * split units can be indexed later.
+ */
+static struct drgn_error *add_split_units(struct drgn_dwarf_index *dindex,
+					  struct compilation_unit *cus,
+					  size_t num_cus)
+{
+	size_t i, j, k;
+
+	for (i = 0; i < num_cus; i = j) {
+		bool has_skeleton = false;
+
+		for (j = i; j < num_cus && cus[j].module == cus[i].module;
+		     j++) {
+			struct drgn_dwarf_index_split_unit *split_unit;
+			const char *debug_info;
+
+			if (!cus[j].skeleton)
+				continue;
+			split_unit = drgn_dwarf_index_split_unit_vector_append_entry(&dindex->split_units);
+			if (!split_unit)
+				return &drgn_enomem;
+			debug_info = section_ptr(cus[j].sections[SECTION_DEBUG_INFO],
+						 0);
+			split_unit->module = cus[j].module;
+			split_unit->die_offset = ((cus[j].ptr - debug_info) +
+						  (cus[j].is_64_bit ? 23 : 11));
+			split_unit->stmt_list = cus[j].skeleton_stmt_list;
+			has_skeleton = true;
+		}
+		/*
+		 * The cache doesn't record skeleton units, so don't save
+		 * modules that have them.
+		 */
+		if (has_skeleton) {
+			for (k = i; k < j; k++) {
+				cus[k].build_id = NULL;
+				cus[k].build_id_len = 0;
+			}
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Index a batch of units, remember their split units, and save them in the
+ * cache. The units are freed and removed from the vector either way.
+ */
+static struct drgn_error *index_batch(struct drgn_dwarf_index *dindex,
+				      struct compilation_unit_vector *cus,
+				      size_t *modules_done,
+				      size_t total_modules)
+{
+	struct drgn_error *err;
+	uint64_t start, cpu_start;
+
+	DRGN_PROBE(index_begin, cus->size);
+	start = monotonic_ns();
+	cpu_start = process_cpu_ns();
+	err = index_cus(dindex, cus->data, cus->size, modules_done,
+			total_modules);
+	dindex->stats.index_ns += monotonic_ns() - start;
+	DRGN_PROBE(index_end, cus->size, err ? err->code : 0);
+	dindex->stats.index_cpu_ns += process_cpu_ns() - cpu_start;
+	if (!err)
+		err = add_split_units(dindex, cus->data, cus->size);
+	if (!err) {
+		start = monotonic_ns();
+		write_caches(dindex, cus->data, cus->size);
+		dindex->stats.cache_write_ns += monotonic_ns() - start;
+	}
+	compilation_units_deinit(cus->data, cus->size);
+	cus->size = 0;
 	return err;
 }
 
 /*
  * Like drgn_dwarf_index_report_end(), but doesn't finalize reported errors or
  * free unindexed modules on success.
+ *
+ * If drgn_dwarf_index::batch_size is set, modules are read a few at a time
+ * (enough to keep every thread busy) and indexed whenever the units read so
+ * far reach the batch size, so that the memory used for the units and their
+ * cache entries is bounded.
  */
 static struct drgn_error *
 drgn_dwarf_index_report_end_internal(struct drgn_dwarf_index *dindex,
@@ -2253,6 +4827,11 @@ drgn_dwarf_index_report_end_internal(struct drgn_dwarf_index *dindex,
 	struct drgn_error *err;
 	struct drgn_dwarf_module_vector unindexed = VECTOR_INIT;
 	struct compilation_unit_vector cus = VECTOR_INIT;
+	const size_t orig_num_modules = dindex->die_modules.size;
+	const size_t orig_num_split_units = dindex->split_units.size;
+	size_t total_modules, modules_done = 0;
+	uint64_t batch_bytes = 0;
+	size_t i, n;
 
 	dwfl_report_end(dindex->dwfl, NULL, NULL);
 	if (report_from_dwfl &&
@@ -2262,26 +4841,61 @@ drgn_dwarf_index_report_end_internal(struct drgn_dwarf_index *dindex,
 		goto err;
 	}
 	err = drgn_dwarf_index_get_unindexed(dindex, &unindexed);
-	if (err)
-		goto err;
-	err = read_cus(dindex, unindexed.data, unindexed.size, &cus);
 	if (err)
 		goto err;
 	/*
-	 * After this point, if we hit an error, then we have to roll back the
-	 * index.
+	 * If everything is indexed at once, index_cus() knows exactly how many
+	 * modules were read successfully.
 	 */
-	err = index_cus(dindex, cus.data, cus.size);
-	if (err) {
-		rollback_dwarf_index(dindex);
-		goto err;
+	total_modules = dindex->batch_size ? unindexed.size : 0;
+	for (i = 0; i < unindexed.size; i += n) {
+		const size_t orig_cus_size = cus.size;
+		uint64_t start, cpu_start;
+		size_t j;
+
+		if (dindex->batch_size) {
+			n = min(unindexed.size - i,
+				(size_t)drgn_num_threads());
+		} else {
+			n = unindexed.size;
+		}
+		start = monotonic_ns();
+		cpu_start = process_cpu_ns();
+		err = read_cus(dindex, &unindexed.data[i], n, &cus);
+		dindex->stats.read_ns += monotonic_ns() - start;
+		dindex->stats.read_cpu_ns += process_cpu_ns() - cpu_start;
+		if (err)
+			goto err_rollback;
+		for (j = orig_cus_size; j < cus.size; j++) {
+			/* Cached units are read from the mapped cache file. */
+			if (!cus.data[j].cache_entries)
+				batch_bytes += cus.data[j].unit_length;
+		}
+		if (i + n < unindexed.size && batch_bytes < dindex->batch_size)
+			continue;
+		/*
+		 * After this point, if we hit an error, then we have to roll
+		 * back the index.
+		 */
+		err = index_batch(dindex, &cus, &modules_done, total_modules);
+		if (err)
+			goto err_rollback;
+		batch_bytes = 0;
 	}
 
 out:
+	compilation_units_deinit(cus.data, cus.size);
 	compilation_unit_vector_deinit(&cus);
 	drgn_dwarf_module_vector_deinit(&unindexed);
 	return err;
 
+err_rollback:
+	/* Earlier batches may have been indexed already. */
+	if (dindex->die_modules.size != orig_num_modules ||
+	    dindex->split_units.size != orig_num_split_units) {
+		rollback_dwarf_index(dindex, orig_num_modules,
+				     orig_num_split_units);
+	}
 err:
 	drgn_dwarf_index_free_modules(dindex, false, false);
 	drgn_dwarf_index_reset_errors(dindex);
@@ -2292,13 +4906,17 @@ struct drgn_error *drgn_dwarf_index_report_end(struct drgn_dwarf_index *dindex,
 					       bool report_from_dwfl)
 {
 	struct drgn_error *err;
+	const size_t orig_num_modules = dindex->die_modules.size;
+	const size_t orig_num_split_units = dindex->split_units.size;
 
+	dindex->reporting = false;
 	err = drgn_dwarf_index_report_end_internal(dindex, report_from_dwfl);
 	if (err)
 		return err;
 	err = drgn_dwarf_index_finalize_errors(dindex);
 	if (err && err->code != DRGN_ERROR_MISSING_DEBUG_INFO) {
-		rollback_dwarf_index(dindex);
+		rollback_dwarf_index(dindex, orig_num_modules,
+				     orig_num_split_units);
 		drgn_dwarf_index_free_modules(dindex, false, false);
 		return err;
 	}
@@ -2306,14 +4924,87 @@ struct drgn_error *drgn_dwarf_index_report_end(struct drgn_dwarf_index *dindex,
 	return err;
 }
 
+static void *drgn_dwarf_index_report_end_thread(void *arg)
+{
+	struct drgn_dwarf_index *dindex = arg;
+
+	dindex->async_err =
+		drgn_dwarf_index_report_end(dindex,
+					    dindex->async_report_from_dwfl);
+	return NULL;
+}
+
+struct drgn_error *
+drgn_dwarf_index_report_end_async(struct drgn_dwarf_index *dindex,
+				  bool report_from_dwfl, bool *started_ret)
+{
+	dindex->async_report_from_dwfl = report_from_dwfl;
+	dindex->async_err = NULL;
+	if (pthread_create(&dindex->async_thread, NULL,
+			   drgn_dwarf_index_report_end_thread, dindex) == 0) {
+		dindex->async_running = true;
+		*started_ret = true;
+		return NULL;
+	}
+	*started_ret = false;
+	return drgn_dwarf_index_report_end(dindex, report_from_dwfl);
+}
+
+void drgn_dwarf_index_wait(struct drgn_dwarf_index *dindex)
+{
+	if (dindex->async_running) {
+		pthread_join(dindex->async_thread, NULL);
+		dindex->async_running = false;
+	}
+}
+
+void drgn_dwarf_index_stats(struct drgn_dwarf_index *dindex,
+			    struct drgn_debug_info_stats *ret)
+{
+	size_t i;
+
+	*ret = dindex->stats;
+	ret->modules = dindex->module_stats.size;
+	for (i = 0; i < dindex->module_stats.size; i++) {
+		const struct drgn_debug_info_module_stats *stats =
+			&dindex->module_stats.data[i];
+
+		ret->cus += stats->cus;
+		ret->dies += stats->dies;
+		ret->debug_info_bytes += stats->debug_info_bytes;
+	}
+}
+
+size_t drgn_dwarf_index_memory_usage(struct drgn_dwarf_index *dindex)
+{
+	size_t size = 0, i;
+
+	for (i = 0; i < ARRAY_SIZE(dindex->shards); i++) {
+		struct drgn_dwarf_index_shard *shard = &dindex->shards[i];
+
+		size += (drgn_dwarf_index_die_map_memory_usage(&shard->map) +
+			 drgn_dwarf_index_die_vector_memory_usage(&shard->dies));
+	}
+	size += (drgn_dwarf_index_die_module_vector_memory_usage(&dindex->die_modules) +
+		 drgn_dwarf_index_split_unit_vector_memory_usage(&dindex->split_units) +
+		 drgn_debug_info_module_stats_vector_memory_usage(&dindex->module_stats) +
+		 drgn_dwarf_module_table_memory_usage(&dindex->module_table) +
+		 drgn_dwarf_module_vector_memory_usage(&dindex->no_build_id) +
+		 drgn_dwarf_index_deferred_file_vector_memory_usage(&dindex->deferred) +
+		 dindex->num_sorted_names * sizeof(dindex->sorted_names[0]));
+	return size;
+}
+
 struct drgn_error *drgn_dwarf_index_flush(struct drgn_dwarf_index *dindex,
 					  bool report_from_dwfl)
 {
 	struct drgn_error *err;
 
 	err = drgn_dwarf_index_report_end_internal(dindex, report_from_dwfl);
-	if (err)
+	if (err) {
+		dindex->reporting = false;
 		return err;
+	}
 	drgn_dwarf_index_free_modules(dindex, true, false);
 	drgn_dwarf_index_report_begin(dindex);
 	return NULL;
@@ -2321,6 +5012,7 @@ struct drgn_error *drgn_dwarf_index_flush(struct drgn_dwarf_index *dindex,
 
 void drgn_dwarf_index_report_abort(struct drgn_dwarf_index *dindex)
 {
+	dindex->reporting = false;
 	dwfl_report_end(dindex->dwfl, NULL, NULL);
 	drgn_dwarf_index_free_modules(dindex, false, false);
 	drgn_dwarf_index_reset_errors(dindex);
@@ -2332,6 +5024,293 @@ bool drgn_dwarf_index_is_indexed(struct drgn_dwarf_index *dindex,
 	return c_string_set_search(&dindex->names, &name).entry != NULL;
 }
 
+struct drgn_error *drgn_dwarf_index_defer_elf(struct drgn_dwarf_index *dindex,
+					      const char *path, int fd,
+					      Elf *elf, uint64_t start,
+					      uint64_t end, const char *name)
+{
+	struct drgn_dwarf_index_deferred_file *file;
+
+	file = drgn_dwarf_index_deferred_file_vector_append_entry(
+		&dindex->deferred);
+	if (!file)
+		goto err;
+	file->path = strdup(path);
+	if (!file->path)
+		goto err_file;
+	if (name) {
+		file->name = strdup(name);
+		if (!file->name) {
+			free(file->path);
+			goto err_file;
+		}
+	} else {
+		file->name = NULL;
+	}
+	file->fd = fd;
+	file->elf = elf;
+	file->start = start;
+	file->end = end;
+	file->open = NULL;
+	file->arg = NULL;
+	file->free_arg = NULL;
+	return NULL;
+
+err_file:
+	dindex->deferred.size--;
+err:
+	elf_end(elf);
+	close(fd);
+	return &drgn_enomem;
+}
+
+struct drgn_error *
+drgn_dwarf_index_defer_module(struct drgn_dwarf_index *dindex,
+			      const char *name, uint64_t start, uint64_t end,
+			      drgn_dwarf_index_open_deferred_fn *open,
+			      void (*free_arg)(void *), void *arg)
+{
+	struct drgn_dwarf_index_deferred_file *file;
+
+	file = drgn_dwarf_index_deferred_file_vector_append_entry(
+		&dindex->deferred);
+	if (!file)
+		goto err;
+	file->name = strdup(name);
+	if (!file->name) {
+		dindex->deferred.size--;
+		goto err;
+	}
+	file->path = NULL;
+	file->fd = -1;
+	file->elf = NULL;
+	file->start = start;
+	file->end = end;
+	file->open = open;
+	file->arg = arg;
+	file->free_arg = free_arg;
+	return NULL;
+
+err:
+	free_arg(arg);
+	return &drgn_enomem;
+}
+
+bool drgn_dwarf_index_is_deferred(struct drgn_dwarf_index *dindex,
+				  const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < dindex->deferred.size; i++) {
+		if (dindex->deferred.data[i].name &&
+		    strcmp(dindex->deferred.data[i].name, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+bool drgn_dwarf_index_has_deferred(struct drgn_dwarf_index *dindex,
+				   uint64_t address)
+{
+	size_t i;
+
+	for (i = 0; i < dindex->deferred.size; i++) {
+		if (dindex->deferred.data[i].start <= address &&
+		    address < dindex->deferred.data[i].end)
+			return true;
+	}
+	return false;
+}
+
+struct drgn_error *
+drgn_dwarf_index_report_deferred(struct drgn_dwarf_index *dindex, bool all,
+				 uint64_t address, bool *reported_ret)
+{
+	struct drgn_error *err = NULL;
+	size_t i = 0;
+
+	*reported_ret = false;
+	while (i < dindex->deferred.size) {
+		struct drgn_dwarf_index_deferred_file file =
+			dindex->deferred.data[i];
+
+		if (!all && (address < file.start || address >= file.end)) {
+			i++;
+			continue;
+		}
+		/*
+		 * Remove the file before reporting it, since
+		 * drgn_dwarf_index_report_elf() takes ownership of it even on
+		 * failure.
+		 */
+		dindex->deferred.data[i] =
+			dindex->deferred.data[--dindex->deferred.size];
+		if (file.open) {
+			err = file.open(file.arg, &file.path, &file.fd,
+					&file.elf, &file.start, &file.end);
+			if (err) {
+				err = drgn_dwarf_index_report_error(dindex,
+								    file.name,
+								    NULL, err);
+				drgn_dwarf_index_deferred_file_deinit(&file);
+				if (err || !all)
+					break;
+				continue;
+			}
+		}
+		err = drgn_dwarf_index_report_elf(dindex, file.path, file.fd,
+						  file.elf, file.start,
+						  file.end, file.name, NULL);
+		drgn_dwarf_index_deferred_file_deinit(&file);
+		if (err)
+			break;
+		*reported_ret = true;
+		if (!all)
+			break;
+	}
+	return err;
+}
+
+/* Get the units of the split DWARF file for a skeleton unit. */
+static struct drgn_error *
+read_split_unit_cus(struct drgn_dwarf_index_split_unit *split_unit,
+		    struct compilation_unit_vector *cus)
+{
+	struct drgn_error *err;
+	Dwarf *dwarf, *split_dwarf;
+	Dwarf_Addr bias;
+	Dwarf_Die cudie, subdie;
+	uint8_t unit_type;
+	Dwarf_Attribute attr_mem, *attr;
+	const char *split_name;
+	Elf *elf;
+	Elf_Data *sections[DRGN_DWARF_INDEX_NUM_SECTIONS] = {};
+	Elf_Data *skeleton_sections[DRGN_DWARF_INDEX_NUM_SECTIONS] = {};
+	bool bswap;
+	const char *ptr, *end;
+
+	dwarf = dwfl_module_getdwarf(split_unit->module, &bias);
+	if (!dwarf)
+		return drgn_error_libdwfl();
+	if (!dwarf_offdie(dwarf, split_unit->die_offset, &cudie))
+		return drgn_error_libdw();
+	/*
+	 * libdw looks for the split unit when we ask for it. If it can't be
+	 * found, this is still a skeleton unit but without a split unit.
+	 */
+	if (dwarf_cu_info(cudie.cu, NULL, &unit_type, NULL, &subdie, NULL,
+			  NULL, NULL))
+		return drgn_error_libdw();
+	if (unit_type != DW_UT_skeleton || !subdie.cu)
+		return NULL;
+	split_dwarf = dwarf_cu_getdwarf(subdie.cu);
+	if (!split_dwarf)
+		return drgn_error_libdw();
+	attr = dwarf_attr(&cudie, DW_AT_GNU_dwo_name, &attr_mem);
+	split_name = attr ? dwarf_formstring(attr) : NULL;
+
+	elf = dwarf_getelf(split_dwarf);
+	if (!elf)
+		return drgn_error_libdw();
+	err = get_debug_sections(elf, sections, true);
+	if (err)
+		return err;
+	/* The split unit's file names refer to the skeleton's line table. */
+	err = get_debug_sections(dwarf_getelf(dwarf), skeleton_sections,
+				 false);
+	if (err)
+		return err;
+	sections[SECTION_DEBUG_LINE] = skeleton_sections[SECTION_DEBUG_LINE];
+
+	bswap = (elf_getident(elf, NULL)[EI_DATA] !=
+		 (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ?
+		  ELFDATA2LSB : ELFDATA2MSB));
+
+	ptr = section_ptr(sections[SECTION_DEBUG_INFO], 0);
+	end = section_end(sections[SECTION_DEBUG_INFO]);
+	while (ptr < end) {
+		struct compilation_unit *cu;
+
+		cu = compilation_unit_vector_append_entry(cus);
+		if (!cu)
+			return &drgn_enomem;
+		memset(cu, 0, sizeof(*cu));
+		cu->module = split_unit->module;
+		memcpy(cu->sections, sections, sizeof(cu->sections));
+		cu->ptr = ptr;
+		cu->bswap = bswap;
+		drgn_dwarf_index_cache_record_vector_init(&cu->cache_records);
+		cu->split_dwarf = split_dwarf;
+		cu->split_name = split_name;
+		cu->split_stmt_list = split_unit->stmt_list;
+		cu->names = CU_NAMES_UNUSED;
+		uint64_vector_init(&cu->names_dies);
+		err = read_compilation_unit_header(ptr, end, cu);
+		if (err)
+			return err;
+
+		ptr += (cu->is_64_bit ? 12 : 4) + cu->unit_length;
+	}
+	return NULL;
+}
+
+struct drgn_error *
+drgn_dwarf_index_index_split_units(struct drgn_dwarf_index *dindex,
+				   bool *indexed_ret)
+{
+	struct drgn_error *err = NULL;
+	struct compilation_unit_vector cus = VECTOR_INIT;
+	const size_t orig_num_modules = dindex->die_modules.size;
+	uint64_t start, cpu_start;
+	size_t modules_done = 0;
+	size_t i;
+
+	*indexed_ret = false;
+	if (!dindex->split_units.size)
+		return NULL;
+
+	/*
+	 * Opening the split DWARF files goes through libdw, which isn't thread
+	 * safe, so it is done serially. The units are indexed in parallel.
+	 */
+	start = monotonic_ns();
+	cpu_start = process_cpu_ns();
+	for (i = 0; i < dindex->split_units.size; i++) {
+		const size_t orig_cus_size = cus.size;
+
+		err = read_split_unit_cus(&dindex->split_units.data[i], &cus);
+		if (err) {
+			if (err->code == DRGN_ERROR_NO_MEMORY)
+				goto out;
+			/* A bad split DWARF file shouldn't affect the rest. */
+			drgn_error_destroy(err);
+			err = NULL;
+			compilation_units_deinit(&cus.data[orig_cus_size],
+						 cus.size - orig_cus_size);
+			cus.size = orig_cus_size;
+		}
+	}
+	dindex->stats.read_ns += monotonic_ns() - start;
+	dindex->stats.read_cpu_ns += process_cpu_ns() - cpu_start;
+
+	start = monotonic_ns();
+	cpu_start = process_cpu_ns();
+	err = index_cus(dindex, cus.data, cus.size, &modules_done, 0);
+	dindex->stats.index_ns += monotonic_ns() - start;
+	dindex->stats.index_cpu_ns += process_cpu_ns() - cpu_start;
+	if (err) {
+		rollback_dwarf_index(dindex, orig_num_modules,
+				     dindex->split_units.size);
+		goto out;
+	}
+	dindex->split_units.size = 0;
+	*indexed_ret = cus.size != 0;
+out:
+	compilation_units_deinit(cus.data, cus.size);
+	compilation_unit_vector_deinit(&cus);
+	return err;
+}
+
 void drgn_dwarf_index_iterator_init(struct drgn_dwarf_index_iterator *it,
 				    struct drgn_dwarf_index *dindex,
 				    const char *name, size_t name_len,
@@ -2348,7 +5327,7 @@ void drgn_dwarf_index_iterator_init(struct drgn_dwarf_index_iterator *it,
 		struct drgn_dwarf_index_die_map_iterator map_it;
 
 		hp = drgn_dwarf_index_die_map_hash(&key);
-		it->shard = hash_pair_to_shard(hp);
+		it->shard = hash_pair_to_shard(hp, DRGN_DWARF_INDEX_SHARD_BITS);
 		shard = &dindex->shards[it->shard];
 		map_it = drgn_dwarf_index_die_map_search_hashed(&shard->map,
 								&key, hp);
@@ -2422,19 +5401,179 @@ drgn_dwarf_index_iterator_next(struct drgn_dwarf_index_iterator *it,
 			shard = &dindex->shards[it->shard];
 			die = &shard->dies.data[it->index];
 
-			it->index = die->next;
+			it->index = die->next == UINT32_MAX ? SIZE_MAX : die->next;
 
 			if (drgn_dwarf_index_iterator_matches_tag(it, die))
 				break;
 		}
 	}
 
-	dwarf = dwfl_module_getdwarf(die->module, &bias);
+	dwarf = dwfl_module_getdwarf(dindex->die_modules.data[die->module].module,
+				     &bias);
 	if (!dwarf)
 		return drgn_error_libdwfl();
+	if (dindex->die_modules.data[die->module].split_dwarf)
+		dwarf = dindex->die_modules.data[die->module].split_dwarf;
 	if (!dwarf_offdie(dwarf, die->offset, die_ret))
 		return drgn_error_libdw();
 	if (bias_ret)
 		*bias_ret = bias;
 	return NULL;
 }
+
+static unsigned int dwarf_tag_to_name_kind(uint16_t tag)
+{
+	switch (tag) {
+	case DW_TAG_enumerator:
+		return DRGN_FIND_NAME_CONSTANT;
+	case DW_TAG_subprogram:
+		return DRGN_FIND_NAME_FUNCTION;
+	case DW_TAG_variable:
+		return DRGN_FIND_NAME_VARIABLE;
+	case DW_TAG_base_type:
+	case DW_TAG_typedef:
+		return DRGN_FIND_NAME_TYPE;
+	case DW_TAG_structure_type:
+	case DW_TAG_union_type:
+	case DW_TAG_class_type:
+	case DW_TAG_enumeration_type:
+		return DRGN_FIND_NAME_TAG;
+	default:
+		return 0;
+	}
+}
+
+static int drgn_dwarf_index_name_cmp(const void *_a, const void *_b)
+{
+	const struct drgn_dwarf_index_name *a = _a, *b = _b;
+
+	return strcmp(a->str, b->str);
+}
+
+/*
+ * Build the sorted list of names. Each name is in exactly one shard, so there
+ * are no duplicates.
+ */
+static struct drgn_error *
+drgn_dwarf_index_sort_names(struct drgn_dwarf_index *dindex)
+{
+	size_t num_names = 0, i;
+	struct drgn_dwarf_index_name *names;
+
+	for (i = 0; i < ARRAY_SIZE(dindex->shards); i++)
+		num_names += drgn_dwarf_index_die_map_size(&dindex->shards[i].map);
+	/* Allocate at least one so that an empty index is still sorted. */
+	names = malloc_array(num_names ? num_names : 1, sizeof(*names));
+	if (!names)
+		return &drgn_enomem;
+
+	num_names = 0;
+	for (i = 0; i < ARRAY_SIZE(dindex->shards); i++) {
+		struct drgn_dwarf_index_shard *shard = &dindex->shards[i];
+		struct drgn_dwarf_index_die_map_iterator it;
+
+		for (it = drgn_dwarf_index_die_map_first(&shard->map); it.entry;
+		     it = drgn_dwarf_index_die_map_next(it)) {
+			unsigned int kinds = 0;
+			size_t index = it.entry->value;
+
+			for (;;) {
+				struct drgn_dwarf_index_die *die =
+					&shard->dies.data[index];
+
+				kinds |= dwarf_tag_to_name_kind(die->tag);
+				if (die->next == UINT32_MAX)
+					break;
+				index = die->next;
+			}
+			if (!kinds)
+				continue;
+			names[num_names].str = it.entry->key.str;
+			names[num_names].len = it.entry->key.len;
+			names[num_names].kinds = kinds;
+			num_names++;
+		}
+	}
+	qsort(names, num_names, sizeof(*names), drgn_dwarf_index_name_cmp);
+	dindex->sorted_names = names;
+	dindex->num_sorted_names = num_names;
+	return NULL;
+}
+
+/* Return the index of the first name which is not less than the given prefix. */
+static size_t drgn_dwarf_index_names_lower_bound(struct drgn_dwarf_index *dindex,
+						 const char *prefix,
+						 size_t prefix_len)
+{
+	size_t lo = 0, hi = dindex->num_sorted_names;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		const struct drgn_dwarf_index_name *name =
+			&dindex->sorted_names[mid];
+		int cmp = strncmp(name->str, prefix, prefix_len);
+
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+struct drgn_error *
+drgn_dwarf_index_for_each_name(struct drgn_dwarf_index *dindex,
+			       const char *prefix, const char *glob,
+			       enum drgn_find_name_flags flags, drgn_name_fn fn,
+			       void *arg)
+{
+	struct drgn_error *err;
+	size_t prefix_len = strlen(prefix);
+	char *search = NULL;
+	size_t search_len, i;
+
+	if (!dindex->sorted_names) {
+		err = drgn_dwarf_index_sort_names(dindex);
+		if (err)
+			return err;
+	}
+
+	/*
+	 * The part of the pattern before the first special character is a
+	 * literal prefix which we can search for, too.
+	 */
+	search_len = prefix_len;
+	if (glob) {
+		size_t glob_prefix_len = strcspn(glob, "*?[\\");
+
+		if (strncmp(prefix, glob,
+			    min(prefix_len, glob_prefix_len)) != 0)
+			return NULL;
+		if (glob_prefix_len > prefix_len) {
+			search = strndup(glob, glob_prefix_len);
+			if (!search)
+				return &drgn_enomem;
+			prefix = search;
+			search_len = glob_prefix_len;
+		}
+	}
+
+	err = NULL;
+	for (i = drgn_dwarf_index_names_lower_bound(dindex, prefix, search_len);
+	     i < dindex->num_sorted_names; i++) {
+		const struct drgn_dwarf_index_name *name =
+			&dindex->sorted_names[i];
+
+		if (strncmp(name->str, prefix, search_len) != 0)
+			break;
+		if (!(name->kinds & flags))
+			continue;
+		if (glob && fnmatch(glob, name->str, 0) != 0)
+			continue;
+		err = fn(name->str, name->len, name->kinds, arg);
+		if (err)
+			break;
+	}
+	free(search);
+	return err;
+}
@@ -14,6 +14,7 @@
 
 #include <elfutils/libdwfl.h>
 #include <libelf.h>
+#include <pthread.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -27,6 +28,7 @@ typedef struct {} omp_lock_t;
 #define omp_unset_lock(lock) do {} while (0)
 #endif
 
+#include "debuginfod.h"
 #include "drgn.h"
 #include "hash_table.h"
 #include "string_builder.h"
@@ -47,9 +49,21 @@ typedef struct {} omp_lock_t;
  * highly optimized. This is implemented as a homegrown DWARF parser specialized
  * for the task of scanning over DIEs quickly.
  *
- * Although the DWARF standard defines ".debug_pubnames" and ".debug_names"
- * sections, GCC and Clang currently don't emit them by default, so we don't use
- * them.
+ * The DWARF standard also defines ".debug_pubnames" and ".debug_names"
+ * sections, but GCC and Clang don't emit them by default. If a file has a
+ * ".debug_names" section which records the parent of each entry, then only the
+ * top-level DIEs that it lists are read for the units that it covers. Units
+ * that it doesn't cover (or can't fully describe, like ones with anonymous
+ * enumeration types) are still scanned. ".gdb_index" is not used because it
+ * doesn't contain DIE offsets.
+ *
+ * The index entries for modules with a build ID are also saved to a cache file
+ * named after the build ID in @ref drgn_dwarf_index::cache_dir. If a valid
+ * cache file exists when a module is indexed, the entries are mapped from it
+ * instead of being parsed from the DWARF. Similarly, the debugging information
+ * sections of relocatable files (i.e., kernel modules) are saved after they are
+ * decompressed and relocated, keyed by build ID and section addresses, and
+ * mapped instead of processed again.
  *
  * @{
  */
@@ -87,6 +101,41 @@ enum drgn_dwarf_module_state {
 
 DEFINE_VECTOR_TYPE(dwfl_module_vector, Dwfl_Module *)
 
+/** Source of DIEs in a @ref drgn_dwarf_index. */
+struct drgn_dwarf_index_die_module {
+	Dwfl_Module *module;
+	/**
+	 * Split DWARF file (.dwo) containing the DIEs, or @c NULL if they are
+	 * in the module's own debugging information.
+	 */
+	Dwarf *split_dwarf;
+};
+
+DEFINE_VECTOR_TYPE(drgn_dwarf_index_die_module_vector,
+		   struct drgn_dwarf_index_die_module)
+
+/**
+ * Skeleton unit whose split unit hasn't been indexed yet.
+ *
+ * @sa drgn_dwarf_index_index_split_units()
+ */
+struct drgn_dwarf_index_split_unit {
+	Dwfl_Module *module;
+	/** Offset of the skeleton unit DIE in .debug_info. */
+	uint64_t die_offset;
+	/**
+	 * Offset of the skeleton unit's line number program, which the split
+	 * unit's file names refer to, or @c SIZE_MAX if it doesn't have one.
+	 */
+	size_t stmt_list;
+};
+
+DEFINE_VECTOR_TYPE(drgn_dwarf_index_split_unit_vector,
+		   struct drgn_dwarf_index_split_unit)
+
+DEFINE_VECTOR_TYPE(drgn_debug_info_module_stats_vector,
+		   struct drgn_debug_info_module_stats)
+
 /**
  * A module reported to a @ref drgn_dwarf_index.
  *
@@ -132,7 +181,43 @@ struct drgn_dwfl_module_userdata {
 	char *path;
 	Elf *elf;
 	int fd;
+	/** Index that the module was reported to. */
+	struct drgn_dwarf_index *dindex;
 	enum drgn_dwarf_module_state state;
+	/**
+	 * Mapped index cache file that the module was indexed from, or @c NULL.
+	 *
+	 * The names in the index point into this mapping.
+	 */
+	void *cache_map;
+	size_t cache_map_size;
+	/**
+	 * Mapped relocated section cache file that the module's debugging
+	 * information sections point into, or @c NULL.
+	 */
+	void *section_cache_map;
+	size_t section_cache_map_size;
+	/** Time spent reading the module's units, in nanoseconds. */
+	uint64_t read_ns;
+	/** Part of @ref read_ns spent applying relocations. */
+	uint64_t relocate_ns;
+	/** Size of the module's .debug_info section. */
+	uint64_t debug_info_bytes;
+	/**
+	 * ORC unwinding table, or @c NULL if it hasn't been loaded or the
+	 * module doesn't have one. See @ref orc_loaded.
+	 */
+	struct drgn_orc_table *orc;
+	/** Whether we tried to load @ref orc. */
+	bool orc_loaded;
+	/**
+	 * Address to source line table, or @c NULL if it hasn't been built or
+	 * the module doesn't have line number information. See @ref
+	 * lines_loaded.
+	 */
+	struct drgn_line_table *lines;
+	/** Whether we tried to build @ref lines. */
+	bool lines_loaded;
 };
 
 DEFINE_VECTOR_TYPE(drgn_dwarf_module_vector, struct drgn_dwarf_module *)
@@ -158,6 +243,116 @@ DEFINE_HASH_TABLE_TYPE(drgn_dwarf_module_table, struct drgn_dwarf_module *,
 
 DEFINE_HASH_SET_TYPE(c_string_set, const char *)
 
+/** Location of a file found by build ID. */
+struct drgn_build_id_location {
+	char *path;
+	/** Modification time of @ref path when it was found. */
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+};
+
+/** Map from hexadecimal build ID to location. The keys are owned. */
+DEFINE_HASH_MAP_TYPE(drgn_build_id_location_map, char *,
+		     struct drgn_build_id_location)
+
+/** Map from hexadecimal build ID to ELF handle. The keys are owned. */
+DEFINE_HASH_MAP_TYPE(drgn_shared_elf_map, char *, Elf *)
+
+/**
+ * ELF files shared between several @ref drgn_dwarf_index "indexes".
+ *
+ * When the same binary is debugged by several programs in one process (e.g.,
+ * many vmcores from the same kernel build), each program would otherwise open
+ * its own copy of the file and decompress its own copy of the debugging
+ * sections. Indexes sharing this open each file with a given build ID once and
+ * share the @c Elf handle, which libelf reference counts. Each index still has
+ * its own @c Dwfl_Module for it, so the load address can differ.
+ *
+ * Files that need to be relocated (i.e., kernel modules) are not shared, since
+ * their section addresses are set in the @c Elf handle.
+ *
+ * This is reference counted. Programs sharing it must not load debugging
+ * information concurrently, since libelf handles aren't thread-safe.
+ */
+struct drgn_shared_debug_info {
+	/** @privatesection */
+	pthread_mutex_t lock;
+	/** Protected by @ref lock. */
+	size_t refcount;
+	/** Protected by @ref lock. */
+	struct drgn_shared_elf_map elfs;
+};
+
+/**
+ * Create a @ref drgn_shared_debug_info with a reference count of one.
+ *
+ * @return New object, or @c NULL if it couldn't be allocated.
+ */
+struct drgn_shared_debug_info *drgn_shared_debug_info_create(void);
+
+/** Increment the reference count of a @ref drgn_shared_debug_info. */
+void drgn_shared_debug_info_incref(struct drgn_shared_debug_info *shared);
+
+/**
+ * Decrement the reference count of a @ref drgn_shared_debug_info and free it
+ * if it was the last reference. This does nothing if @p shared is @c NULL.
+ */
+void drgn_shared_debug_info_decref(struct drgn_shared_debug_info *shared);
+
+/**
+ * Callback to find and open a file deferred with @ref
+ * drgn_dwarf_index_defer_module().
+ *
+ * @param[in] arg Argument passed to @ref drgn_dwarf_index_defer_module().
+ * @param[out] path_ret Returned path, which is freed with @c free().
+ * @param[out] fd_ret Returned file descriptor.
+ * @param[out] elf_ret Returned ELF handle.
+ * @param[in,out] start_ret Start address, initially the one that the module
+ * was deferred with.
+ * @param[in,out] end_ret End address.
+ */
+typedef struct drgn_error *
+drgn_dwarf_index_open_deferred_fn(void *arg, char **path_ret, int *fd_ret,
+				  Elf **elf_ret, uint64_t *start_ret,
+				  uint64_t *end_ret);
+
+/**
+ * File whose indexing was deferred with @ref drgn_dwarf_index_defer_elf() or
+ * @ref drgn_dwarf_index_defer_module().
+ */
+struct drgn_dwarf_index_deferred_file {
+	/**
+	 * Path, file descriptor, and ELF handle if the file is already open,
+	 * otherwise @c NULL, -1, and @c NULL.
+	 */
+	char *path;
+	int fd;
+	Elf *elf;
+	uint64_t start;
+	uint64_t end;
+	char *name;
+	/** Callback to open the file if it isn't already open, or @c NULL. */
+	drgn_dwarf_index_open_deferred_fn *open;
+	/** Argument to @ref open, freed with @ref free_arg. */
+	void *arg;
+	void (*free_arg)(void *arg);
+};
+
+DEFINE_VECTOR_TYPE(drgn_dwarf_index_deferred_file_vector,
+		   struct drgn_dwarf_index_deferred_file)
+
+/**
+ * Name in the sorted list of names of a @ref drgn_dwarf_index. See @ref
+ * drgn_dwarf_index_for_each_name().
+ */
+struct drgn_dwarf_index_name {
+	/** Null-terminated name. */
+	const char *str;
+	size_t len;
+	/** Kinds of DIEs with this name, as @ref drgn_find_name_flags. */
+	unsigned int kinds;
+};
+
 /**
  * Fast index of DWARF debugging information.
  *
@@ -175,6 +370,20 @@ struct drgn_dwarf_index {
 	 * This is sharded to reduce lock contention.
 	 */
 	struct drgn_dwarf_index_shard shards[1 << DRGN_DWARF_INDEX_SHARD_BITS];
+	/**
+	 * Modules (and split DWARF files) that indexed DIEs belong to.
+	 *
+	 * Indexed DIEs refer to their module by index into this vector rather
+	 * than by pointer to save space.
+	 */
+	struct drgn_dwarf_index_die_module_vector die_modules;
+	/** Statistics of each module in @ref die_modules, in the same order. */
+	struct drgn_debug_info_module_stats_vector module_stats;
+	/** Statistics of every update. */
+	struct drgn_debug_info_stats stats;
+	/** Progress callback, or @c NULL. */
+	drgn_debug_info_progress_fn *progress_fn;
+	void *progress_arg;
 	Dwfl *dwfl;
 	/**
 	 * Formatted errors reported by @ref drgn_dwarf_index_report_error().
@@ -186,6 +395,47 @@ struct drgn_dwarf_index {
 	unsigned int num_errors;
 	/** Maximum number of errors to report before truncating. */
 	unsigned int max_errors;
+	/**
+	 * Approximate number of bytes of @c .debug_info to read and index at
+	 * once, or 0 for no limit.
+	 *
+	 * Indexing a batch of modules allocates memory proportional to the
+	 * size of their debugging information, which isn't freed until the
+	 * batch is done (in particular, the entries to save in the cache).
+	 * Modules are never split between batches, so a single module larger
+	 * than this is indexed in a batch by itself.
+	 *
+	 * This is @c $DRGN_DWARF_INDEX_BATCH_SIZE, which may have a @c K, @c M,
+	 * or @c G suffix.
+	 */
+	size_t batch_size;
+	/**
+	 * Directory containing index cache files, or @c NULL if the cache is
+	 * disabled.
+	 *
+	 * This is @c $DRGN_DWARF_INDEX_CACHE_DIR if it is set (an empty value
+	 * disables the cache), otherwise @c $XDG_CACHE_HOME/drgn or @c
+	 * $HOME/.cache/drgn.
+	 */
+	char *cache_dir;
+	/**
+	 * Locations of files found by build ID.
+	 *
+	 * This is saved in @c build-ids in @ref cache_dir so that later runs
+	 * can open the files directly instead of searching for them again. It
+	 * is read on first use and written by @ref drgn_dwarf_index_deinit() if
+	 * it changed. Each line is the hexadecimal build ID, the modification
+	 * time in seconds and nanoseconds, and the path, separated by spaces.
+	 *
+	 * All of the @c build_id_locations fields are protected by @ref
+	 * build_id_locations_lock.
+	 */
+	struct drgn_build_id_location_map build_id_locations;
+	omp_lock_t build_id_locations_lock;
+	bool build_id_locations_read;
+	bool build_id_locations_dirty;
+	/** Clients for downloading files that aren't found locally. */
+	struct drgn_debuginfod debuginfod;
 	/**
 	 * Modules keyed by build ID and address range.
 	 *
@@ -202,8 +452,56 @@ struct drgn_dwarf_index {
 	 * should not be freed.
 	 */
 	struct c_string_set names;
+	/**
+	 * Files which were registered but not reported yet.
+	 *
+	 * These are reported by @ref drgn_dwarf_index_report_deferred().
+	 */
+	struct drgn_dwarf_index_deferred_file_vector deferred;
+	/**
+	 * Skeleton units of indexed modules whose split DWARF files haven't
+	 * been opened yet.
+	 *
+	 * These are indexed by @ref drgn_dwarf_index_index_split_units().
+	 */
+	struct drgn_dwarf_index_split_unit_vector split_units;
+	/**
+	 * Every indexed name in sorted order, or @c NULL if it hasn't been built
+	 * since the index last changed.
+	 */
+	struct drgn_dwarf_index_name *sorted_names;
+	/** Number of names in @ref sorted_names. */
+	size_t num_sorted_names;
+	/** Whether modules are currently being reported. */
+	bool reporting;
+	/**
+	 * Whether @ref async_thread is running @ref
+	 * drgn_dwarf_index_report_end_async().
+	 */
+	bool async_running;
+	bool async_report_from_dwfl;
+	pthread_t async_thread;
+	/**
+	 * Result of the last @ref drgn_dwarf_index_report_end_async(). This
+	 * is only valid after @ref drgn_dwarf_index_wait(), and it is owned by
+	 * whoever takes it.
+	 */
+	struct drgn_error *async_err;
+	/**
+	 * ELF files shared with other indexes, or @c NULL. This is owned by the
+	 * program.
+	 */
+	struct drgn_shared_debug_info *shared;
 };
 
+/**
+ * Create @ref drgn_dwarf_index::cache_dir and its parents if they don't exist.
+ *
+ * @return Whether the directory exists. This is @c false if the cache is
+ * disabled.
+ */
+bool drgn_dwarf_index_create_cache_dir(struct drgn_dwarf_index *dindex);
+
 /**
  * Initialize a @ref drgn_dwarf_index.
  *
@@ -296,6 +594,45 @@ struct drgn_error *drgn_dwarf_index_report_elf(struct drgn_dwarf_index *dindex,
 struct drgn_error *drgn_dwarf_index_report_end(struct drgn_dwarf_index *dindex,
 					       bool report_from_dwfl);
 
+/**
+ * Like @ref drgn_dwarf_index_report_end(), but index in a background thread.
+ *
+ * @ref drgn_dwarf_index_wait() must be called before the index is used again,
+ * after which the result is in @ref drgn_dwarf_index::async_err.
+ *
+ * @param[out] started_ret Whether the thread was started. If not, the index
+ * was updated synchronously, and the result is returned instead.
+ */
+struct drgn_error *
+drgn_dwarf_index_report_end_async(struct drgn_dwarf_index *dindex,
+				  bool report_from_dwfl, bool *started_ret);
+
+/**
+ * Wait for indexing started by @ref drgn_dwarf_index_report_end_async() to
+ * finish.
+ *
+ * This does nothing if the index isn't being updated in the background.
+ */
+void drgn_dwarf_index_wait(struct drgn_dwarf_index *dindex);
+
+/**
+ * Get the statistics of a DWARF index, including the totals of @ref
+ * drgn_dwarf_index::module_stats.
+ *
+ * The index must not be being updated in the background.
+ */
+void drgn_dwarf_index_stats(struct drgn_dwarf_index *dindex,
+			    struct drgn_debug_info_stats *ret);
+
+/**
+ * Get the number of bytes allocated by a DWARF index for its shards and module
+ * bookkeeping. This doesn't include memory allocated by libdwfl or libdw or
+ * mapped files.
+ *
+ * The index must not be being updated in the background.
+ */
+size_t drgn_dwarf_index_memory_usage(struct drgn_dwarf_index *dindex);
+
 /**
  * Index new DWARF information and continue reporting.
  *
@@ -319,6 +656,45 @@ struct drgn_error *drgn_dwarf_index_flush(struct drgn_dwarf_index *dindex,
  */
 void drgn_dwarf_index_report_abort(struct drgn_dwarf_index *dindex);
 
+/**
+ * Look up the cached location of a file with the given build ID.
+ *
+ * The entry is discarded if the file was modified since it was cached. The
+ * caller should still verify that the file has the expected build ID.
+ *
+ * @return Path which must be freed with @c free(), or @c NULL if there is no
+ * valid cached location (including if the cache is disabled or we couldn't
+ * allocate memory).
+ */
+char *drgn_dwarf_index_find_build_id_location(struct drgn_dwarf_index *dindex,
+					      const void *build_id,
+					      size_t build_id_len);
+
+/**
+ * Cache the location of a file with the given build ID.
+ *
+ * The cache is only an optimization, so this fails silently.
+ */
+void drgn_dwarf_index_add_build_id_location(struct drgn_dwarf_index *dindex,
+					    const void *build_id,
+					    size_t build_id_len,
+					    const char *path);
+
+/**
+ * Open the cached location of a file with the given build ID.
+ *
+ * This is like @ref drgn_dwarf_index_find_build_id_location(), but it also
+ * checks that the file still has the given build ID.
+ *
+ * @param[out] path_ret Returned path, which must be freed with @c free().
+ * @param[out] elf_ret Returned ELF handle.
+ * @return File descriptor, or -1 if there is no valid cached location.
+ */
+int drgn_dwarf_index_open_build_id_location(struct drgn_dwarf_index *dindex,
+					    const void *build_id,
+					    size_t build_id_len,
+					    char **path_ret, Elf **elf_ret);
+
 /**
  * Return whether a @ref drgn_dwarf_index has indexed a module with the given
  * name.
@@ -326,6 +702,108 @@ void drgn_dwarf_index_report_abort(struct drgn_dwarf_index *dindex);
 bool drgn_dwarf_index_is_indexed(struct drgn_dwarf_index *dindex,
 				 const char *name);
 
+/**
+ * Register an ELF file with a @ref drgn_dwarf_index without reporting it.
+ *
+ * The file is not indexed until it is reported with @ref
+ * drgn_dwarf_index_report_deferred(). The parameters are the same as for @ref
+ * drgn_dwarf_index_report_elf(), and this takes ownership of @p fd and @p elf
+ * on either success or failure.
+ */
+struct drgn_error *drgn_dwarf_index_defer_elf(struct drgn_dwarf_index *dindex,
+					      const char *path, int fd,
+					      Elf *elf, uint64_t start,
+					      uint64_t end, const char *name);
+
+/**
+ * Register a module with a @ref drgn_dwarf_index without finding its file.
+ *
+ * This is like @ref drgn_dwarf_index_defer_elf(), except that the file is only
+ * found and opened by @p open when the module is reported with @ref
+ * drgn_dwarf_index_report_deferred(). Until then, nothing is read for the
+ * module. If @p open fails, the error is reported with @ref
+ * drgn_dwarf_index_report_error().
+ *
+ * @param[in] name Name of the module.
+ * @param[in] start Start address of the module, which must be known at this
+ * point so that lookups of addresses in the module can report it.
+ * @param[in] end End address of the module.
+ * @param[in] arg Argument to @p open. This takes ownership of it on either
+ * success or failure; it is freed with @p free_arg.
+ */
+struct drgn_error *
+drgn_dwarf_index_defer_module(struct drgn_dwarf_index *dindex,
+			      const char *name, uint64_t start, uint64_t end,
+			      drgn_dwarf_index_open_deferred_fn *open,
+			      void (*free_arg)(void *), void *arg);
+
+/**
+ * Return whether a @ref drgn_dwarf_index has a deferred file with the given
+ * module name.
+ */
+bool drgn_dwarf_index_is_deferred(struct drgn_dwarf_index *dindex,
+				  const char *name);
+
+/**
+ * Return whether a @ref drgn_dwarf_index has a deferred file containing the
+ * given address.
+ */
+bool drgn_dwarf_index_has_deferred(struct drgn_dwarf_index *dindex,
+				   uint64_t address);
+
+/**
+ * Report deferred files to a @ref drgn_dwarf_index.
+ *
+ * This must be called between @ref drgn_dwarf_index_report_begin() and @ref
+ * drgn_dwarf_index_report_end(). The reported files are no longer deferred,
+ * even if this fails.
+ *
+ * @param[in] all Whether to report all deferred files. If @c false, only the
+ * file containing @p address is reported.
+ * @param[in] address Address to look up if @p all is @c false.
+ * @param[out] reported_ret Whether any files were reported.
+ */
+struct drgn_error *
+drgn_dwarf_index_report_deferred(struct drgn_dwarf_index *dindex, bool all,
+				 uint64_t address, bool *reported_ret);
+
+/**
+ * Open and index the split DWARF files (.dwo) of the skeleton units in @ref
+ * drgn_dwarf_index::split_units.
+ *
+ * Split units are found by libdw from the skeleton unit's @c
+ * DW_AT_GNU_dwo_name and @c DW_AT_comp_dir. Ones that can't be found are
+ * ignored. Either way, the skeleton units are no longer pending afterwards.
+ *
+ * This must not be called while modules are being reported.
+ *
+ * @param[out] indexed_ret Whether any split units were indexed.
+ */
+struct drgn_error *
+drgn_dwarf_index_index_split_units(struct drgn_dwarf_index *dindex,
+				   bool *indexed_ret);
+
+/**
+ * Call a function for each name in a DWARF index, in sorted order.
+ *
+ * The sorted list of names is built on the first call after the index changes.
+ * Names starting with @p prefix are found with a binary search.
+ *
+ * @param[in] prefix Only enumerate names starting with this.
+ * @param[in] glob If not @c NULL, only enumerate names matching this @c
+ * fnmatch() pattern.
+ * @param[in] flags Only enumerate names with a DIE of one of these kinds.
+ * @param[in] fn Callback. If it returns an error, including &@ref drgn_stop,
+ * enumeration stops and the error is returned.
+ * @param[in] arg Argument to pass to @p fn.
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *
+drgn_dwarf_index_for_each_name(struct drgn_dwarf_index *dindex,
+			       const char *prefix, const char *glob,
+			       enum drgn_find_name_flags flags, drgn_name_fn fn,
+			       void *arg);
+
 /**
  * Iterator over DWARF debugging information.
  *
@@ -12,10 +12,51 @@
 #include "hash_table.h"
 #include "object_index.h"
 #include "type_index.h"
+#include "usdt.h"
 #include "vector.h"
 
 DEFINE_HASH_TABLE_FUNCTIONS(dwarf_type_map, hash_pair_ptr_type,
 			    hash_table_scalar_eq)
+
+static struct hash_pair
+drgn_dwarf_find_key_hash(const struct drgn_dwarf_find_key *key)
+{
+	size_t hash;
+
+	hash = hash_bytes(key->name, key->name_len);
+	if (key->filename)
+		hash = hash_combine(hash, c_string_hash(&key->filename).first);
+	hash = hash_combine(hash, ((size_t)key->kind << 1) | key->object);
+	return hash_pair_from_avalanching_hash(hash);
+}
+
+static bool drgn_dwarf_find_key_eq(const struct drgn_dwarf_find_key *a,
+				   const struct drgn_dwarf_find_key *b)
+{
+	return (a->kind == b->kind && a->object == b->object &&
+		a->name_len == b->name_len &&
+		memcmp(a->name, b->name, a->name_len) == 0 &&
+		(a->filename && b->filename ?
+		 strcmp(a->filename, b->filename) == 0 :
+		 a->filename == b->filename));
+}
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_dwarf_find_map, drgn_dwarf_find_key_hash,
+			    drgn_dwarf_find_key_eq)
+
+static struct hash_pair
+drgn_dwarf_canonical_key_hash(const struct drgn_dwarf_canonical_key *key)
+{
+	return hash_pair_from_avalanching_hash(key->hash);
+}
+
+static bool
+drgn_dwarf_canonical_key_eq(const struct drgn_dwarf_canonical_key *a,
+			    const struct drgn_dwarf_canonical_key *b);
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_dwarf_canonical_map,
+			    drgn_dwarf_canonical_key_hash,
+			    drgn_dwarf_canonical_key_eq)
 DEFINE_VECTOR(drgn_type_member_vector, struct drgn_type_member)
 DEFINE_VECTOR(drgn_type_enumerator_vector, struct drgn_type_enumerator)
 DEFINE_VECTOR(drgn_type_parameter_vector, struct drgn_type_parameter)
@@ -27,37 +68,6 @@ struct drgn_type_from_dwarf_thunk {
 	bool can_be_incomplete_array;
 };
 
-static void drgn_dwarf_type_free(struct drgn_dwarf_type *dwarf_type)
-{
-	if (dwarf_type->should_free) {
-		struct drgn_type *type = dwarf_type->type;
-
-		if (drgn_type_has_members(type)) {
-			struct drgn_type_member *members;
-			size_t num_members, i;
-
-			members = drgn_type_members(type);
-			num_members = drgn_type_num_members(type);
-			for (i = 0; i < num_members; i++)
-				drgn_type_member_deinit(&members[i]);
-			free(members);
-		}
-		if (drgn_type_has_parameters(type)) {
-			struct drgn_type_parameter *parameters;
-			size_t num_parameters, i;
-
-			parameters = drgn_type_parameters(type);
-			num_parameters = drgn_type_num_parameters(type);
-			for (i = 0; i < num_parameters; i++)
-				drgn_type_parameter_deinit(&parameters[i]);
-			free(parameters);
-		}
-		if (drgn_type_has_enumerators(type))
-			free(drgn_type_enumerators(type));
-		free(type);
-	}
-}
-
 static int dwarf_type(Dwarf_Die *die, Dwarf_Die *ret)
 {
 	Dwarf_Attribute attr_mem;
@@ -145,7 +155,7 @@ drgn_type_from_dwarf_thunk_evaluate_fn(struct drgn_type_thunk *thunk,
 
 static void drgn_type_from_dwarf_thunk_free_fn(struct drgn_type_thunk *thunk)
 {
-	free(container_of(thunk, struct drgn_type_from_dwarf_thunk, thunk));
+	/* Thunks are allocated from drgn_dwarf_info_cache::arena. */
 }
 
 static struct drgn_error *
@@ -169,7 +179,7 @@ drgn_lazy_type_from_dwarf(struct drgn_dwarf_info_cache *dicache,
 					 "%s has invalid DW_AT_type", tag_name);
 	}
 
-	thunk = malloc(sizeof(*thunk));
+	thunk = drgn_arena_alloc(&dicache->arena, sizeof(*thunk));
 	if (!thunk)
 		return &drgn_enomem;
 
@@ -271,7 +281,7 @@ drgn_base_type_from_dwarf(struct drgn_dwarf_info_cache *dicache, Dwarf_Die *die,
 					 "DW_TAG_base_type has missing or invalid DW_AT_byte_size");
 	}
 
-	type = malloc(sizeof(*type));
+	type = drgn_arena_alloc(&dicache->arena, sizeof(*type));
 	if (!type)
 		return &drgn_enomem;
 	switch (encoding) {
@@ -526,12 +536,263 @@ static struct drgn_error *parse_member(struct drgn_dwarf_info_cache *dicache,
 	return NULL;
 }
 
+static bool strings_equal(const char *a, const char *b)
+{
+	return a && b ? strcmp(a, b) == 0 : a == b;
+}
+
+/*
+ * Return whether an attribute is either missing from both DIEs or has the same
+ * constant value in both.
+ */
+static bool dwarf_udata_attrs_equal(Dwarf_Die *a, Dwarf_Die *b,
+				    unsigned int name)
+{
+	Dwarf_Attribute a_attr_mem, b_attr_mem;
+	Dwarf_Attribute *a_attr, *b_attr;
+	Dwarf_Word a_value, b_value;
+
+	a_attr = dwarf_attr_integrate(a, name, &a_attr_mem);
+	b_attr = dwarf_attr_integrate(b, name, &b_attr_mem);
+	if (!a_attr || !b_attr)
+		return !a_attr && !b_attr;
+	return (dwarf_formudata(a_attr, &a_value) == 0 &&
+		dwarf_formudata(b_attr, &b_value) == 0 && a_value == b_value);
+}
+
+static bool dwarf_flags_equal(Dwarf_Die *a, Dwarf_Die *b, unsigned int name)
+{
+	bool a_flag, b_flag;
+
+	return (dwarf_flag(a, name, &a_flag) == 0 &&
+		dwarf_flag(b, name, &b_flag) == 0 && a_flag == b_flag);
+}
+
+/* Give up on comparing types nested deeper than this. */
+#define DWARF_TYPE_EQUIVALENT_MAX_DEPTH 32
+
+static bool dwarf_types_equivalent(Dwarf_Die *a, Dwarf_Die *b, int depth,
+				   bool shallow);
+
+static bool dwarf_type_attrs_equivalent(Dwarf_Die *a, Dwarf_Die *b, int depth,
+					bool shallow)
+{
+	Dwarf_Die a_type, b_type;
+	int a_r, b_r;
+
+	a_r = dwarf_type(a, &a_type);
+	b_r = dwarf_type(b, &b_type);
+	if (a_r == -1 || b_r == -1)
+		return false;
+	if (a_r || b_r)
+		return a_r == b_r;
+	return dwarf_types_equivalent(&a_type, &b_type, depth + 1, shallow);
+}
+
+static bool dwarf_children_equivalent(Dwarf_Die *a, Dwarf_Die *b, int depth,
+				      bool shallow)
+{
+	Dwarf_Die a_child, b_child;
+	int a_r, b_r;
+
+	a_r = dwarf_child(a, &a_child);
+	b_r = dwarf_child(b, &b_child);
+	while (a_r == 0 && b_r == 0) {
+		int tag = dwarf_tag(&a_child);
+
+		if (tag != dwarf_tag(&b_child))
+			return false;
+		switch (tag) {
+		case DW_TAG_member:
+			if (!strings_equal(dwarf_diename(&a_child),
+					   dwarf_diename(&b_child)) ||
+			    !dwarf_udata_attrs_equal(&a_child, &b_child,
+						     DW_AT_data_member_location) ||
+			    !dwarf_udata_attrs_equal(&a_child, &b_child,
+						     DW_AT_data_bit_offset) ||
+			    !dwarf_udata_attrs_equal(&a_child, &b_child,
+						     DW_AT_bit_offset) ||
+			    !dwarf_udata_attrs_equal(&a_child, &b_child,
+						     DW_AT_bit_size) ||
+			    !dwarf_udata_attrs_equal(&a_child, &b_child,
+						     DW_AT_byte_size) ||
+			    !dwarf_type_attrs_equivalent(&a_child, &b_child,
+							 depth, shallow))
+				return false;
+			break;
+		case DW_TAG_enumerator:
+			if (!strings_equal(dwarf_diename(&a_child),
+					   dwarf_diename(&b_child)) ||
+			    !dwarf_udata_attrs_equal(&a_child, &b_child,
+						     DW_AT_const_value))
+				return false;
+			break;
+		case DW_TAG_subrange_type:
+			if (!dwarf_udata_attrs_equal(&a_child, &b_child,
+						     DW_AT_count) ||
+			    !dwarf_udata_attrs_equal(&a_child, &b_child,
+						     DW_AT_upper_bound))
+				return false;
+			break;
+		case DW_TAG_formal_parameter:
+			if (!dwarf_type_attrs_equivalent(&a_child, &b_child,
+							 depth, shallow))
+				return false;
+			break;
+		case DW_TAG_unspecified_parameters:
+			break;
+		default:
+			/* Be conservative about anything else (e.g., C++). */
+			return false;
+		}
+		a_r = dwarf_siblingof(&a_child, &a_child);
+		b_r = dwarf_siblingof(&b_child, &b_child);
+	}
+	/* Both must have run out of children at the same time without errors. */
+	return a_r == 1 && b_r == 1;
+}
+
+/*
+ * Return whether two type DIEs describe the same type. This errs on the side
+ * of returning false.
+ *
+ * Named compound and enumerated types are compared fully unless shallow is
+ * true, in which case their name, size, and file are enough. Types reached
+ * through a pointer are compared shallowly, which keeps self-referential types
+ * from recursing forever.
+ */
+static bool dwarf_types_equivalent(Dwarf_Die *a, Dwarf_Die *b, int depth,
+				   bool shallow)
+{
+	int tag;
+
+	if (a->addr == b->addr)
+		return true;
+	if (depth > DWARF_TYPE_EQUIVALENT_MAX_DEPTH)
+		return false;
+	tag = dwarf_tag(a);
+	if (tag != dwarf_tag(b) ||
+	    !strings_equal(dwarf_diename(a), dwarf_diename(b)) ||
+	    !dwarf_udata_attrs_equal(a, b, DW_AT_byte_size))
+		return false;
+	switch (tag) {
+	case DW_TAG_base_type:
+		return dwarf_udata_attrs_equal(a, b, DW_AT_encoding);
+	case DW_TAG_const_type:
+	case DW_TAG_restrict_type:
+	case DW_TAG_volatile_type:
+	case DW_TAG_atomic_type:
+	case DW_TAG_typedef:
+		return dwarf_type_attrs_equivalent(a, b, depth, shallow);
+	case DW_TAG_pointer_type:
+		return dwarf_type_attrs_equivalent(a, b, depth, true);
+	case DW_TAG_structure_type:
+	case DW_TAG_union_type:
+	case DW_TAG_class_type:
+	case DW_TAG_enumeration_type:
+		if (!dwarf_flags_equal(a, b, DW_AT_declaration) ||
+		    !strings_equal(dwarf_decl_file(a), dwarf_decl_file(b)))
+			return false;
+		if (shallow && dwarf_diename(a))
+			return true;
+		return (dwarf_type_attrs_equivalent(a, b, depth, shallow) &&
+			dwarf_children_equivalent(a, b, depth, shallow));
+	case DW_TAG_array_type:
+		return (dwarf_type_attrs_equivalent(a, b, depth, shallow) &&
+			dwarf_children_equivalent(a, b, depth, shallow));
+	case DW_TAG_subroutine_type:
+		return (dwarf_flags_equal(a, b, DW_AT_prototyped) &&
+			dwarf_type_attrs_equivalent(a, b, depth, true) &&
+			dwarf_children_equivalent(a, b, depth, true));
+	default:
+		return false;
+	}
+}
+
+static bool
+drgn_dwarf_canonical_key_eq(const struct drgn_dwarf_canonical_key *a,
+			    const struct drgn_dwarf_canonical_key *b)
+{
+	Dwarf_Die a_die = a->die, b_die = b->die;
+
+	return (a->hash == b->hash && a->lang == b->lang &&
+		dwarf_types_equivalent(&a_die, &b_die, 0, false));
+}
+
+/*
+ * Look for an already parsed type that is identical to the complete compound
+ * or enumerated type described by a DIE. If there isn't one, *key_ret and
+ * *hp_ret are set for drgn_dwarf_add_canonical_type() (with a NULL DIE address
+ * if the DIE couldn't be hashed).
+ */
+static struct drgn_type *
+drgn_dwarf_find_canonical_type(struct drgn_dwarf_info_cache *dicache,
+			       Dwarf_Die *die,
+			       const struct drgn_language *lang,
+			       struct drgn_dwarf_canonical_key *key_ret,
+			       struct hash_pair *hp_ret)
+{
+	const char *name;
+	size_t hash;
+	Dwarf_Die child;
+	int r;
+	struct drgn_dwarf_canonical_map_iterator it;
+
+	key_ret->die.addr = NULL;
+	hash = hash_combine(dwarf_tag(die), dwarf_bytesize(die));
+	name = dwarf_diename(die);
+	if (name)
+		hash = hash_combine(hash, hash_bytes(name, strlen(name)));
+	name = dwarf_decl_file(die);
+	if (name)
+		hash = hash_combine(hash, hash_bytes(name, strlen(name)));
+	r = dwarf_child(die, &child);
+	while (r == 0) {
+		name = dwarf_diename(&child);
+		if (name) {
+			hash = hash_combine(hash,
+					    hash_bytes(name, strlen(name)));
+		}
+		r = dwarf_siblingof(&child, &child);
+	}
+	if (r == -1)
+		return NULL;
+
+	key_ret->die = *die;
+	key_ret->lang = lang;
+	key_ret->hash = hash;
+	*hp_ret = drgn_dwarf_canonical_map_hash(key_ret);
+	it = drgn_dwarf_canonical_map_search_hashed(&dicache->canonical_map,
+						    key_ret, *hp_ret);
+	return it.entry ? it.entry->value : NULL;
+}
+
+/*
+ * Remember a newly parsed type for drgn_dwarf_find_canonical_type(). This is
+ * only an optimization, so it fails silently.
+ */
+static void
+drgn_dwarf_add_canonical_type(struct drgn_dwarf_info_cache *dicache,
+			      const struct drgn_dwarf_canonical_key *key,
+			      struct hash_pair hp, struct drgn_type *type)
+{
+	struct drgn_dwarf_canonical_map_entry entry = {
+		.key = *key,
+		.value = type,
+	};
+
+	if (!key->die.addr)
+		return;
+	drgn_dwarf_canonical_map_insert_searched(&dicache->canonical_map,
+						 &entry, hp, NULL);
+}
+
 static struct drgn_error *
 drgn_compound_type_from_dwarf(struct drgn_dwarf_info_cache *dicache,
 			      Dwarf_Die *die,
 			      const struct drgn_language *lang,
 			      enum drgn_type_kind kind,
-			      struct drgn_type **ret, bool *should_free)
+			      struct drgn_type **ret)
 {
 	struct drgn_error *err;
 
@@ -579,15 +840,24 @@ drgn_compound_type_from_dwarf(struct drgn_dwarf_info_cache *dicache,
 		err = drgn_dwarf_info_cache_find_complete(dicache,
 							  dw_tag, tag, ret);
 		if (!err) {
-			*should_free = false;
 			return NULL;
 		} else if (err->code != DRGN_ERROR_STOP) {
 			return err;
 		}
 	}
 
-	*should_free = true;
-	struct drgn_type *type = malloc(sizeof(*type));
+	struct drgn_dwarf_canonical_key canonical_key;
+	struct hash_pair canonical_hp;
+	if (!declaration) {
+		*ret = drgn_dwarf_find_canonical_type(dicache, die, lang,
+						      &canonical_key,
+						      &canonical_hp);
+		if (*ret)
+			return NULL;
+	}
+
+	struct drgn_type *type = drgn_arena_alloc(&dicache->arena,
+						  sizeof(*type));
 	if (!type)
 		return &drgn_enomem;
 
@@ -643,18 +913,26 @@ drgn_compound_type_from_dwarf(struct drgn_dwarf_info_cache *dicache,
 					"libdw could not parse DIE children");
 		goto err;
 	}
-	drgn_type_member_vector_shrink_to_fit(&members);
+	struct drgn_type_member *members_copy =
+		drgn_arena_memdup_array(&dicache->arena, members.data,
+					members.size, sizeof(members.data[0]));
+	if (members.size && !members_copy) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	size_t num_members = members.size;
+	drgn_type_member_vector_deinit(&members);
 
 	if (kind == DRGN_TYPE_UNION) {
-		drgn_union_type_init(type, tag, size, members.data,
-				     members.size, lang);
+		drgn_union_type_init(type, tag, size, members_copy,
+				     num_members, lang);
 	} else {
 		if (kind == DRGN_TYPE_STRUCT) {
-			drgn_struct_type_init(type, tag, size, members.data,
-					      members.size, lang);
+			drgn_struct_type_init(type, tag, size, members_copy,
+					      num_members, lang);
 		} else {
-			drgn_class_type_init(type, tag, size, members.data,
-					     members.size, lang);
+			drgn_class_type_init(type, tag, size, members_copy,
+					     num_members, lang);
 		}
 		/*
 		 * Flexible array members are only allowed as the last member of
@@ -662,9 +940,9 @@ drgn_compound_type_from_dwarf(struct drgn_dwarf_info_cache *dicache,
 		 * can_be_incomplete_array to false in parse_member(), so fix it
 		 * up.
 		 */
-		if (members.size > 1) {
+		if (num_members > 1) {
 			struct drgn_type_member *member =
-				&drgn_type_members(type)[members.size - 1];
+				&members_copy[num_members - 1];
 			/*
 			 * The type may have already been evaluated if it's a
 			 * bit field. Arrays can't be bit fields, so it's okay
@@ -679,6 +957,8 @@ drgn_compound_type_from_dwarf(struct drgn_dwarf_info_cache *dicache,
 			}
 		}
 	}
+	drgn_dwarf_add_canonical_type(dicache, &canonical_key, canonical_hp,
+				      type);
 	*ret = type;
 	return NULL;
 
@@ -686,7 +966,6 @@ err:
 	for (size_t i = 0; i < members.size; i++)
 		drgn_type_member_deinit(&members.data[i]);
 	drgn_type_member_vector_deinit(&members);
-	free(type);
 	return err;
 }
 
@@ -801,7 +1080,7 @@ enum_compatible_type_fallback(struct drgn_dwarf_info_cache *dicache,
 static struct drgn_error *
 drgn_enum_type_from_dwarf(struct drgn_dwarf_info_cache *dicache, Dwarf_Die *die,
 			  const struct drgn_language *lang,
-			  struct drgn_type **ret, bool *should_free)
+			  struct drgn_type **ret)
 {
 	struct drgn_error *err;
 
@@ -828,15 +1107,24 @@ drgn_enum_type_from_dwarf(struct drgn_dwarf_info_cache *dicache, Dwarf_Die *die,
 							  DW_TAG_enumeration_type,
 							  tag, ret);
 		if (!err) {
-			*should_free = false;
 			return NULL;
 		} else if (err->code != DRGN_ERROR_STOP) {
 			return err;
 		}
 	}
 
-	*should_free = true;
-	struct drgn_type *type = malloc(sizeof(*type));
+	struct drgn_dwarf_canonical_key canonical_key;
+	struct hash_pair canonical_hp;
+	if (!declaration) {
+		*ret = drgn_dwarf_find_canonical_type(dicache, die, lang,
+						      &canonical_key,
+						      &canonical_hp);
+		if (*ret)
+			return NULL;
+	}
+
+	struct drgn_type *type = drgn_arena_alloc(&dicache->arena,
+						  sizeof(*type));
 	if (!type)
 		return &drgn_enomem;
 
@@ -874,7 +1162,16 @@ drgn_enum_type_from_dwarf(struct drgn_dwarf_info_cache *dicache, Dwarf_Die *die,
 					"libdw could not parse DIE children");
 		goto err;
 	}
-	drgn_type_enumerator_vector_shrink_to_fit(&enumerators);
+	struct drgn_type_enumerator *enumerators_copy =
+		drgn_arena_memdup_array(&dicache->arena, enumerators.data,
+					enumerators.size,
+					sizeof(enumerators.data[0]));
+	if (enumerators.size && !enumerators_copy) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	size_t num_enumerators = enumerators.size;
+	drgn_type_enumerator_vector_deinit(&enumerators);
 
 	struct drgn_type *compatible_type;
 	r = dwarf_type(die, &child);
@@ -901,14 +1198,15 @@ drgn_enum_type_from_dwarf(struct drgn_dwarf_info_cache *dicache, Dwarf_Die *die,
 		}
 	}
 
-	drgn_enum_type_init(type, tag, compatible_type, enumerators.data,
-			    enumerators.size, lang);
+	drgn_enum_type_init(type, tag, compatible_type, enumerators_copy,
+			    num_enumerators, lang);
+	drgn_dwarf_add_canonical_type(dicache, &canonical_key, canonical_hp,
+				      type);
 	*ret = type;
 	return NULL;
 
 err:
 	drgn_type_enumerator_vector_deinit(&enumerators);
-	free(type);
 	return err;
 }
 
@@ -931,20 +1229,18 @@ drgn_typedef_type_from_dwarf(struct drgn_dwarf_info_cache *dicache,
 					 "DW_TAG_typedef has missing or invalid DW_AT_name");
 	}
 
-	type = malloc(sizeof(*type));
-	if (!type)
-		return &drgn_enomem;
-
 	err = drgn_type_from_dwarf_child(dicache, die,
 					 drgn_language_or_default(lang),
 					 "DW_TAG_typedef", true,
 					 can_be_incomplete_array,
 					 is_incomplete_array_ret,
 					 &aliased_type);
-	if (err) {
-		free(type);
+	if (err)
 		return err;
-	}
+
+	type = drgn_arena_alloc(&dicache->arena, sizeof(*type));
+	if (!type)
+		return &drgn_enomem;
 
 	drgn_typedef_type_init(type, name, aliased_type, lang);
 	*ret = type;
@@ -975,7 +1271,8 @@ struct array_dimension {
 	bool is_complete;
 };
 
-DEFINE_VECTOR(array_dimension_vector, struct array_dimension)
+/* Almost all arrays have one or two dimensions. */
+DEFINE_SMALL_VECTOR(array_dimension_vector, struct array_dimension, 4)
 
 static struct drgn_error *subrange_length(Dwarf_Die *die,
 					  struct array_dimension *dimension)
@@ -1030,15 +1327,18 @@ drgn_array_type_from_dwarf(struct drgn_dwarf_info_cache *dicache,
 			   struct drgn_type **ret)
 {
 	struct drgn_error *err;
-	struct array_dimension_vector dimensions = VECTOR_INIT;
+	struct array_dimension_vector dimensions;
 	struct array_dimension *dimension;
 	Dwarf_Die child;
+	array_dimension_vector_init(&dimensions);
 	int r = dwarf_child(die, &child);
 	while (r == 0) {
 		if (dwarf_tag(&child) == DW_TAG_subrange_type) {
 			dimension = array_dimension_vector_append_entry(&dimensions);
-			if (!dimension)
+			if (!dimension) {
+				err = &drgn_enomem;
 				goto out;
+			}
 			err = subrange_length(&child, dimension);
 			if (err)
 				goto out;
@@ -1052,8 +1352,10 @@ drgn_array_type_from_dwarf(struct drgn_dwarf_info_cache *dicache,
 	}
 	if (!dimensions.size) {
 		dimension = array_dimension_vector_append_entry(&dimensions);
-		if (!dimension)
+		if (!dimension) {
+			err = &drgn_enomem;
 			goto out;
+		}
 		dimension->is_complete = false;
 	}
 
@@ -1136,10 +1438,6 @@ drgn_function_type_from_dwarf(struct drgn_dwarf_info_cache *dicache,
 {
 	struct drgn_error *err;
 
-	struct drgn_type *type = malloc(sizeof(*type));
-	if (!type)
-		return &drgn_enomem;
-
 	const char *tag_name =
 		dwarf_tag(die) == DW_TAG_subroutine_type ?
 		"DW_TAG_subroutine_type" : "DW_TAG_subprogram";
@@ -1184,7 +1482,6 @@ drgn_function_type_from_dwarf(struct drgn_dwarf_info_cache *dicache,
 					"libdw could not parse DIE children");
 		goto err;
 	}
-	drgn_type_parameter_vector_shrink_to_fit(&parameters);
 
 	struct drgn_qualified_type return_type;
 	err = drgn_type_from_dwarf_child(dicache, die,
@@ -1194,8 +1491,19 @@ drgn_function_type_from_dwarf(struct drgn_dwarf_info_cache *dicache,
 	if (err)
 		goto err;
 
-	drgn_function_type_init(type, return_type, parameters.data,
+	struct drgn_type *type = drgn_arena_alloc(&dicache->arena,
+						  sizeof(*type));
+	struct drgn_type_parameter *parameters_copy =
+		drgn_arena_memdup_array(&dicache->arena, parameters.data,
+					parameters.size,
+					sizeof(parameters.data[0]));
+	if (!type || (parameters.size && !parameters_copy)) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	drgn_function_type_init(type, return_type, parameters_copy,
 				parameters.size, is_variadic, lang);
+	drgn_type_parameter_vector_deinit(&parameters);
 	*ret = type;
 	return NULL;
 
@@ -1203,7 +1511,6 @@ err:
 	for (size_t i = 0; i < parameters.size; i++)
 		drgn_type_parameter_deinit(&parameters.data[i]);
 	drgn_type_parameter_vector_deinit(&parameters);
-	free(type);
 	return err;
 }
 
@@ -1221,6 +1528,7 @@ drgn_type_from_dwarf_internal(struct drgn_dwarf_info_cache *dicache,
 	};
 	struct dwarf_type_map *map;
 	struct dwarf_type_map_iterator it;
+	uint64_t start_ns;
 
 	if (dicache->depth >= 1000) {
 		return drgn_error_create(DRGN_ERROR_RECURSION,
@@ -1247,6 +1555,11 @@ drgn_type_from_dwarf_internal(struct drgn_dwarf_info_cache *dicache,
 		return err;
 
 	ret->qualifiers = 0;
+	/* Nested types are counted but only timed as part of the outermost. */
+	drgn_profile_count(dicache->tindex->profile, dwarf_types);
+	start_ns = (dicache->depth ? 0 :
+		    drgn_profile_begin(dicache->tindex->profile));
+	DRGN_PROBE(type_from_dwarf_begin, die->addr, dicache->depth);
 	dicache->depth++;
 	entry.value.is_incomplete_array = false;
 	switch (dwarf_tag(die)) {
@@ -1255,7 +1568,6 @@ drgn_type_from_dwarf_internal(struct drgn_dwarf_info_cache *dicache,
 		 * Qualified types share the struct drgn_type with the
 		 * unqualified type.
 		 */
-		entry.value.should_free = false;
 		err = drgn_type_from_dwarf_child(dicache, die,
 						 drgn_language_or_default(lang),
 						 "DW_TAG_const_type", true,
@@ -1263,7 +1575,6 @@ drgn_type_from_dwarf_internal(struct drgn_dwarf_info_cache *dicache,
 		ret->qualifiers |= DRGN_QUALIFIER_CONST;
 		break;
 	case DW_TAG_restrict_type:
-		entry.value.should_free = false;
 		err = drgn_type_from_dwarf_child(dicache, die,
 						 drgn_language_or_default(lang),
 						 "DW_TAG_restrict_type", true,
@@ -1271,7 +1582,6 @@ drgn_type_from_dwarf_internal(struct drgn_dwarf_info_cache *dicache,
 		ret->qualifiers |= DRGN_QUALIFIER_RESTRICT;
 		break;
 	case DW_TAG_volatile_type:
-		entry.value.should_free = false;
 		err = drgn_type_from_dwarf_child(dicache, die,
 						 drgn_language_or_default(lang),
 						 "DW_TAG_volatile_type", true,
@@ -1279,7 +1589,6 @@ drgn_type_from_dwarf_internal(struct drgn_dwarf_info_cache *dicache,
 		ret->qualifiers |= DRGN_QUALIFIER_VOLATILE;
 		break;
 	case DW_TAG_atomic_type:
-		entry.value.should_free = false;
 		err = drgn_type_from_dwarf_child(dicache, die,
 						 drgn_language_or_default(lang),
 						 "DW_TAG_atomic_type", true,
@@ -1287,31 +1596,26 @@ drgn_type_from_dwarf_internal(struct drgn_dwarf_info_cache *dicache,
 		ret->qualifiers |= DRGN_QUALIFIER_ATOMIC;
 		break;
 	case DW_TAG_base_type:
-		entry.value.should_free = true;
 		err = drgn_base_type_from_dwarf(dicache, die, lang, &ret->type);
 		break;
 	case DW_TAG_structure_type:
 		err = drgn_compound_type_from_dwarf(dicache, die, lang,
 						    DRGN_TYPE_STRUCT,
-						    &ret->type,
-						    &entry.value.should_free);
+						    &ret->type);
 		break;
 	case DW_TAG_union_type:
 		err = drgn_compound_type_from_dwarf(dicache, die, lang,
-						    DRGN_TYPE_UNION, &ret->type,
-						    &entry.value.should_free);
+						    DRGN_TYPE_UNION, &ret->type);
 		break;
 	case DW_TAG_class_type:
 		err = drgn_compound_type_from_dwarf(dicache, die, lang,
-						    DRGN_TYPE_CLASS, &ret->type,
-						    &entry.value.should_free);
+						    DRGN_TYPE_CLASS, &ret->type);
 		break;
 	case DW_TAG_enumeration_type:
-		err = drgn_enum_type_from_dwarf(dicache, die, lang, &ret->type,
-						&entry.value.should_free);
+		err = drgn_enum_type_from_dwarf(dicache, die, lang,
+						&ret->type);
 		break;
 	case DW_TAG_typedef:
-		entry.value.should_free = true;
 		err = drgn_typedef_type_from_dwarf(dicache, die, lang,
 						   can_be_incomplete_array,
 						   &entry.value.is_incomplete_array,
@@ -1319,12 +1623,10 @@ drgn_type_from_dwarf_internal(struct drgn_dwarf_info_cache *dicache,
 		break;
 	case DW_TAG_pointer_type:
 		/* Pointer types are owned by the type index. */
-		entry.value.should_free = false;
 		err = drgn_pointer_type_from_dwarf(dicache, die, lang, &ret->type);
 		break;
 	case DW_TAG_array_type:
 		/* Array types are owned by the type index. */
-		entry.value.should_free = false;
 		err = drgn_array_type_from_dwarf(dicache, die, lang,
 						 can_be_incomplete_array,
 						 &entry.value.is_incomplete_array,
@@ -1332,7 +1634,6 @@ drgn_type_from_dwarf_internal(struct drgn_dwarf_info_cache *dicache,
 		break;
 	case DW_TAG_subroutine_type:
 	case DW_TAG_subprogram:
-		entry.value.should_free = true;
 		err = drgn_function_type_from_dwarf(dicache, die, lang,
 						    &ret->type);
 		break;
@@ -1343,6 +1644,9 @@ drgn_type_from_dwarf_internal(struct drgn_dwarf_info_cache *dicache,
 		break;
 	}
 	dicache->depth--;
+	drgn_profile_add_ns(dicache->tindex->profile, dwarf_types, start_ns);
+	DRGN_PROBE(type_from_dwarf_end, die->addr, dicache->depth,
+		   err ? err->code : 0);
 	if (err)
 		return err;
 
@@ -1352,15 +1656,112 @@ drgn_type_from_dwarf_internal(struct drgn_dwarf_info_cache *dicache,
 		map = &dicache->cant_be_incomplete_array_map;
 	else
 		map = &dicache->map;
-	if (dwarf_type_map_insert_searched(map, &entry, hp, NULL) == -1) {
-		drgn_dwarf_type_free(&entry.value);
+	if (dwarf_type_map_insert_searched(map, &entry, hp, NULL) == -1)
 		return &drgn_enomem;
-	}
 	if (is_incomplete_array_ret)
 		*is_incomplete_array_ret = entry.value.is_incomplete_array;
 	return NULL;
 }
 
+static void drgn_dwarf_find_map_clear_all(struct drgn_dwarf_find_map *map)
+{
+	struct drgn_dwarf_find_map_iterator it;
+
+	for (it = drgn_dwarf_find_map_first(map); it.entry;
+	     it = drgn_dwarf_find_map_next(it)) {
+		/* The name and filename are allocated together. */
+		free((char *)it.entry->key.name);
+		if (it.entry->value.object) {
+			drgn_object_deinit(it.entry->value.object);
+			free(it.entry->value.object);
+		}
+	}
+	drgn_dwarf_find_map_clear(map);
+}
+
+/*
+ * Look up a previous result for a find. If there is none, this returns NULL
+ * and *hp_ret is set for drgn_dwarf_find_memoize().
+ */
+static struct drgn_dwarf_find_result *
+drgn_dwarf_find_memoized(struct drgn_dwarf_info_cache *dicache,
+			 const struct drgn_dwarf_find_key *key,
+			 struct hash_pair *hp_ret)
+{
+	struct drgn_dwarf_find_map_iterator it;
+
+	/* New debugging information may change any result. */
+	if (dicache->dindex.die_modules.size !=
+	    dicache->find_map_num_modules) {
+		drgn_dwarf_find_map_clear_all(&dicache->find_map);
+		dicache->find_map_num_modules = dicache->dindex.die_modules.size;
+	}
+	*hp_ret = drgn_dwarf_find_map_hash(key);
+	it = drgn_dwarf_find_map_search_hashed(&dicache->find_map, key,
+					       *hp_ret);
+	return it.entry ? &it.entry->value : NULL;
+}
+
+/*
+ * Remember the result of a find. This is only an optimization, so it fails
+ * silently. On failure, the resolved object, if any, is freed.
+ */
+static void drgn_dwarf_find_memoize(struct drgn_dwarf_info_cache *dicache,
+				    const struct drgn_dwarf_find_key *key,
+				    struct hash_pair hp,
+				    const struct drgn_dwarf_find_result *result)
+{
+	struct drgn_dwarf_find_map_entry entry = {
+		.key = *key,
+		.value = *result,
+	};
+	size_t filename_size = key->filename ? strlen(key->filename) + 1 : 0;
+	char *buf;
+
+	buf = malloc(key->name_len + filename_size);
+	if (!buf)
+		goto err;
+	memcpy(buf, key->name, key->name_len);
+	entry.key.name = buf;
+	if (key->filename) {
+		memcpy(buf + key->name_len, key->filename, filename_size);
+		entry.key.filename = buf + key->name_len;
+	}
+	if (drgn_dwarf_find_map_insert_searched(&dicache->find_map, &entry, hp,
+						NULL) != -1)
+		return;
+	free(buf);
+err:
+	if (result->object) {
+		drgn_object_deinit(result->object);
+		free(result->object);
+	}
+}
+
+/*
+ * Save a copy of an object resolved from a DIE so that later finds of the same
+ * name don't need to evaluate its location or value again. Returns NULL if the
+ * copy couldn't be made, which is only an optimization.
+ */
+static struct drgn_object *drgn_dwarf_resolved_object(const struct drgn_object *obj)
+{
+	struct drgn_error *err;
+	struct drgn_object *copy;
+
+	copy = malloc(sizeof(*copy));
+	if (!copy)
+		return NULL;
+	drgn_object_init(copy, obj->prog);
+	err = drgn_object_copy(copy, obj);
+	if (err) {
+		drgn_error_destroy(err);
+		drgn_object_deinit(copy);
+		free(copy);
+		return NULL;
+	}
+	return copy;
+}
+
 struct drgn_error *drgn_dwarf_type_find(enum drgn_type_kind kind,
 					const char *name, size_t name_len,
 					const char *filename, void *arg,
@@ -1368,10 +1769,30 @@ struct drgn_error *drgn_dwarf_type_find(enum drgn_type_kind kind,
 {
 	struct drgn_error *err;
 	struct drgn_dwarf_info_cache *dicache = arg;
+	struct drgn_dwarf_find_key key = {
+		.kind = kind,
+		.name = name,
+		.name_len = name_len,
+		.filename = filename,
+	};
+	struct drgn_dwarf_find_result result = {};
+	struct drgn_dwarf_find_result *memoized;
+	struct hash_pair hp;
 	struct drgn_dwarf_index_iterator it;
-	Dwarf_Die die;
 	uint64_t tag;
 
+	/* The index may still be being updated in the background. */
+	drgn_dwarf_index_wait(&dicache->dindex);
+
+	memoized = drgn_dwarf_find_memoized(dicache, &key, &hp);
+	if (memoized) {
+		if (!memoized->found)
+			return &drgn_not_found;
+		/* Parsing may add to the map, so copy the result first. */
+		result = *memoized;
+		return drgn_type_from_dwarf(dicache, &result.die, ret);
+	}
+
 	switch (kind) {
 	case DRGN_TYPE_INT:
 	case DRGN_TYPE_BOOL:
@@ -1399,21 +1820,27 @@ struct drgn_error *drgn_dwarf_type_find(enum drgn_type_kind kind,
 
 	drgn_dwarf_index_iterator_init(&it, &dicache->dindex, name, name_len,
 				       &tag, 1);
-	while (!(err = drgn_dwarf_index_iterator_next(&it, &die, NULL))) {
-		if (die_matches_filename(&die, filename)) {
-			err = drgn_type_from_dwarf(dicache, &die, ret);
+	while (!(err = drgn_dwarf_index_iterator_next(&it, &result.die,
+						      NULL))) {
+		if (die_matches_filename(&result.die, filename)) {
+			err = drgn_type_from_dwarf(dicache, &result.die, ret);
 			if (err)
 				return err;
 			/*
 			 * For DW_TAG_base_type, we need to check that the type
 			 * we found was the right kind.
 			 */
-			if (drgn_type_kind(ret->type) == kind)
+			if (drgn_type_kind(ret->type) == kind) {
+				result.found = true;
+				drgn_dwarf_find_memoize(dicache, &key, hp,
+							&result);
 				return NULL;
+			}
 		}
 	}
 	if (err && err->code != DRGN_ERROR_STOP)
 		return err;
+	drgn_dwarf_find_memoize(dicache, &key, hp, &result);
 	return &drgn_not_found;
 }
 
@@ -1501,6 +1928,26 @@ drgn_object_from_dwarf_variable(struct drgn_dwarf_info_cache *dicache,
 					 dwarf_die_byte_order(die));
 }
 
+static struct drgn_error *
+drgn_object_from_dwarf(struct drgn_dwarf_info_cache *dicache, Dwarf_Die *die,
+		       uint64_t bias, const char *name,
+		       struct drgn_object *ret)
+{
+	switch (dwarf_tag(die)) {
+	case DW_TAG_enumeration_type:
+		return drgn_object_from_dwarf_enumerator(dicache, die, name,
+							 ret);
+	case DW_TAG_subprogram:
+		return drgn_object_from_dwarf_subprogram(dicache, die, bias,
+							 name, ret);
+	case DW_TAG_variable:
+		return drgn_object_from_dwarf_variable(dicache, die, bias, name,
+						       ret);
+	default:
+		UNREACHABLE();
+	}
+}
+
 struct drgn_error *
 drgn_dwarf_object_find(const char *name, size_t name_len, const char *filename,
 		       enum drgn_find_object_flags flags, void *arg,
@@ -1508,11 +1955,46 @@ drgn_dwarf_object_find(const char *name, size_t name_len, const char *filename,
 {
 	struct drgn_error *err;
 	struct drgn_dwarf_info_cache *dicache = arg;
+	struct drgn_dwarf_find_key key = {
+		.kind = flags,
+		.object = true,
+		.name = name,
+		.name_len = strlen(name),
+		.filename = filename,
+	};
+	struct drgn_dwarf_find_result result = {};
+	struct drgn_dwarf_find_result *memoized;
+	struct hash_pair hp;
 	uint64_t tags[3];
 	size_t num_tags;
 	struct drgn_dwarf_index_iterator it;
-	Dwarf_Die die;
-	uint64_t bias;
+	struct drgn_dwarf_find_map_iterator map_it;
+
+	drgn_dwarf_index_wait(&dicache->dindex);
+
+	memoized = drgn_dwarf_find_memoized(dicache, &key, &hp);
+	if (memoized) {
+		if (!memoized->found)
+			return &drgn_not_found;
+		if (memoized->object)
+			return drgn_object_copy(ret, memoized->object);
+		result = *memoized;
+		err = drgn_object_from_dwarf(dicache, &result.die,
+					     result.bias, name, ret);
+		if (err)
+			return err;
+		/*
+		 * Resolving the object may have parsed types that did their own
+		 * finds, so look up the entry again.
+		 */
+		map_it = drgn_dwarf_find_map_search_hashed(&dicache->find_map,
+							   &key, hp);
+		if (map_it.entry && !map_it.entry->value.object) {
+			map_it.entry->value.object =
+				drgn_dwarf_resolved_object(ret);
+		}
+		return NULL;
+	}
 
 	num_tags = 0;
 	if (flags & DRGN_FIND_OBJECT_CONSTANT)
@@ -1523,27 +2005,26 @@ drgn_dwarf_object_find(const char *name, size_t name_len, const char *filename,
 		tags[num_tags++] = DW_TAG_variable;
 
 	drgn_dwarf_index_iterator_init(&it, &dicache->dindex, name,
-				       strlen(name), tags, num_tags);
-	while (!(err = drgn_dwarf_index_iterator_next(&it, &die, &bias))) {
-		if (!die_matches_filename(&die, filename))
+				       key.name_len, tags, num_tags);
+	while (!(err = drgn_dwarf_index_iterator_next(&it, &result.die,
+						      &result.bias))) {
+		if (!die_matches_filename(&result.die, filename))
 			continue;
-		switch (dwarf_tag(&die)) {
-		case DW_TAG_enumeration_type:
-			return drgn_object_from_dwarf_enumerator(dicache, &die,
-								 name, ret);
-		case DW_TAG_subprogram:
-			return drgn_object_from_dwarf_subprogram(dicache, &die,
-								 bias, name,
-								 ret);
-		case DW_TAG_variable:
-			return drgn_object_from_dwarf_variable(dicache, &die,
-							       bias, name, ret);
-		default:
-			UNREACHABLE();
-		}
+		result.found = true;
+		err = drgn_object_from_dwarf(dicache, &result.die, result.bias,
+					     name, ret);
+		/*
+		 * If the object couldn't be resolved, remember the DIE anyways
+		 * so that the error is reported again without searching.
+		 */
+		if (!err)
+			result.object = drgn_dwarf_resolved_object(ret);
+		drgn_dwarf_find_memoize(dicache, &key, hp, &result);
+		return err;
 	}
 	if (err && err->code != DRGN_ERROR_STOP)
 		return err;
+	drgn_dwarf_find_memoize(dicache, &key, hp, &result);
 	return &drgn_not_found;
 }
 
@@ -1565,6 +2046,10 @@ drgn_dwarf_info_cache_create(struct drgn_type_index *tindex,
 	}
 	dwarf_type_map_init(&dicache->map);
 	dwarf_type_map_init(&dicache->cant_be_incomplete_array_map);
+	drgn_arena_init(&dicache->arena);
+	drgn_dwarf_canonical_map_init(&dicache->canonical_map);
+	drgn_dwarf_find_map_init(&dicache->find_map);
+	dicache->find_map_num_modules = 0;
 	dicache->depth = 0;
 	dicache->tindex = tindex;
 	*ret = dicache;
@@ -1573,20 +2058,40 @@ drgn_dwarf_info_cache_create(struct drgn_type_index *tindex,
 
 void drgn_dwarf_info_cache_destroy(struct drgn_dwarf_info_cache *dicache)
 {
-	struct dwarf_type_map_iterator it;
-
 	if (!dicache)
 		return;
 
-	for (it = dwarf_type_map_first(&dicache->map); it.entry;
-	     it = dwarf_type_map_next(it))
-		drgn_dwarf_type_free(&it.entry->value);
-	/* Arrays don't need to be freed, but typedefs do. */
-	for (it = dwarf_type_map_first(&dicache->cant_be_incomplete_array_map);
-	     it.entry; it = dwarf_type_map_next(it))
-		drgn_dwarf_type_free(&it.entry->value);
+	drgn_dwarf_find_map_clear_all(&dicache->find_map);
+	drgn_dwarf_find_map_deinit(&dicache->find_map);
+	drgn_dwarf_canonical_map_deinit(&dicache->canonical_map);
 	dwarf_type_map_deinit(&dicache->cant_be_incomplete_array_map);
 	dwarf_type_map_deinit(&dicache->map);
+	/* This frees every parsed type. */
+	drgn_arena_deinit(&dicache->arena);
 	drgn_dwarf_index_deinit(&dicache->dindex);
 	free(dicache);
 }
+
+size_t drgn_dwarf_info_cache_memory_usage(struct drgn_dwarf_info_cache *dicache)
+{
+	struct drgn_dwarf_find_map_iterator it;
+	size_t size;
+
+	drgn_type_index_lock(dicache->tindex);
+	size = (dwarf_type_map_memory_usage(&dicache->map) +
+		dwarf_type_map_memory_usage(&dicache->cant_be_incomplete_array_map) +
+		drgn_dwarf_canonical_map_memory_usage(&dicache->canonical_map) +
+		drgn_dwarf_find_map_memory_usage(&dicache->find_map) +
+		drgn_arena_memory_usage(&dicache->arena));
+	/* The name and filename are allocated together. */
+	for (it = drgn_dwarf_find_map_first(&dicache->find_map); it.entry;
+	     it = drgn_dwarf_find_map_next(it)) {
+		size += it.entry->key.name_len + 1;
+		if (it.entry->key.filename)
+			size += strlen(it.entry->key.filename) + 1;
+		if (it.entry->value.object)
+			size += sizeof(*it.entry->value.object);
+	}
+	drgn_type_index_unlock(dicache->tindex);
+	return size;
+}
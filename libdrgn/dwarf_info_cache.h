@@ -12,6 +12,7 @@
 #ifndef DRGN_DWARF_INFO_CACHE_H
 #define DRGN_DWARF_INFO_CACHE_H
 
+#include "arena.h"
 #include "drgn.h"
 #include "hash_table.h"
 
@@ -40,12 +41,61 @@ struct drgn_dwarf_type {
 	 * drgn_type_from_dwarf_internal().
 	 */
 	bool is_incomplete_array;
-	/** Whether we need to free @c type. */
-	bool should_free;
 };
 
 DEFINE_HASH_MAP_TYPE(dwarf_type_map, const void *, struct drgn_dwarf_type);
 
+/**
+ * Key of a type in @ref drgn_dwarf_info_cache::canonical_map.
+ *
+ * Keys are equal if their DIEs describe structurally identical types.
+ */
+struct drgn_dwarf_canonical_key {
+	Dwarf_Die die;
+	const struct drgn_language *lang;
+	/** Hash of the name, size, file, and member names of the type. */
+	size_t hash;
+};
+
+DEFINE_HASH_MAP_TYPE(drgn_dwarf_canonical_map, struct drgn_dwarf_canonical_key,
+		     struct drgn_type *);
+
+/**
+ * Arguments of a @ref drgn_dwarf_type_find() or @ref drgn_dwarf_object_find()
+ * call.
+ */
+struct drgn_dwarf_find_key {
+	/**
+	 * @ref drgn_type_kind for types, @ref drgn_find_object_flags for
+	 * objects.
+	 */
+	int kind;
+	bool object;
+	const char *name;
+	size_t name_len;
+	/** Filename, or @c NULL. */
+	const char *filename;
+};
+
+/** Result of a @ref drgn_dwarf_type_find() or @ref drgn_dwarf_object_find(). */
+struct drgn_dwarf_find_result {
+	/** Whether anything was found. If not, the rest is garbage. */
+	bool found;
+	/** DIE that was found. */
+	Dwarf_Die die;
+	/** Load bias of the module containing @c die. */
+	uint64_t bias;
+	/**
+	 * For objects, the object resolved from @c die (e.g., a global
+	 * variable's address and type or a constant's value), or @c NULL if it
+	 * hasn't been resolved. It is owned by the map.
+	 */
+	struct drgn_object *object;
+};
+
+DEFINE_HASH_MAP_TYPE(drgn_dwarf_find_map, struct drgn_dwarf_find_key,
+		     struct drgn_dwarf_find_result);
+
 struct drgn_dwarf_index;
 
 /**
@@ -71,6 +121,32 @@ struct drgn_dwarf_info_cache {
 	 * See @ref drgn_type_from_dwarf_internal().
 	 */
 	struct dwarf_type_map cant_be_incomplete_array_map;
+	/**
+	 * Complete compound and enumerated types by structure.
+	 *
+	 * The same type is usually defined in many compilation units. The
+	 * first DIE parsed for a type creates it, and identical DIEs parsed
+	 * later reuse it. The types are owned by @ref map.
+	 */
+	struct drgn_dwarf_canonical_map canonical_map;
+	/**
+	 * Results of previous type and object lookups, including ones that
+	 * didn't find anything.
+	 *
+	 * The key strings and resolved objects are owned by the map. This is
+	 * cleared whenever more debugging information is indexed.
+	 */
+	struct drgn_dwarf_find_map find_map;
+	/**
+	 * Memory for parsed types, including their members, enumerators,
+	 * parameters, and lazy type thunks.
+	 *
+	 * These are all freed at once when the cache is destroyed. Pointer and
+	 * array types are owned by @ref tindex instead.
+	 */
+	struct drgn_arena arena;
+	/** Number of modules in @ref dindex when @ref find_map was filled. */
+	size_t find_map_num_modules;
 	/** Current parsing recursion depth. */
 	int depth;
 	/** Type index. */
@@ -86,6 +162,12 @@ drgn_dwarf_info_cache_create(struct drgn_type_index *tindex,
 /** Destroy a @ref drgn_dwarf_info_cache. */
 void drgn_dwarf_info_cache_destroy(struct drgn_dwarf_info_cache *dicache);
 
+/**
+ * Get the number of bytes allocated by a @ref drgn_dwarf_info_cache for parsed
+ * types and its lookup caches, not including @ref drgn_dwarf_info_cache::dindex.
+ */
+size_t drgn_dwarf_info_cache_memory_usage(struct drgn_dwarf_info_cache *dicache);
+
 /** @ref drgn_type_find_fn() that uses DWARF debugging information. */
 struct drgn_error *drgn_dwarf_type_find(enum drgn_type_kind kind,
 					const char *name, size_t name_len,
@@ -440,8 +440,145 @@ __libdwfl_dynamic_vaddr_get (Elf *elf, GElf_Addr *vaddrp)
   return false;
 }
 
-int
-dwfl_core_file_report (Dwfl *dwfl, Elf *elf, const char *executable)
+/* Memory callback argument for dwfl_core_file_report_memory.  ELF only
+   covers the headers and notes of the core file, so segment contents are
+   read through READ instead.  */
+struct core_memory
+{
+  Elf *elf;
+  Dwfl_Core_Memory_Read *read;
+  void *arg;
+};
+
+static bool
+core_memory_callback (Dwfl *dwfl, int ndx,
+		      void **buffer, size_t *buffer_available,
+		      GElf_Addr vaddr,
+		      size_t minread,
+		      void *arg)
+{
+  struct core_memory *core = arg;
+  Elf *elf = core->elf;
+
+  if (ndx == -1)
+    {
+      /* Called for cleanup.  */
+      free (*buffer);
+      *buffer = NULL;
+      *buffer_available = 0;
+      return false;
+    }
+
+  const GElf_Off align = dwfl->segment_align ?: 1;
+  GElf_Phdr phdr;
+
+  do
+    if (unlikely (gelf_getphdr (elf, ndx++, &phdr) == NULL))
+      return false;
+  while (phdr.p_type != PT_LOAD
+	 || ((phdr.p_vaddr + phdr.p_memsz + align - 1) & -align) <= vaddr);
+
+  GElf_Off start = vaddr - phdr.p_vaddr + phdr.p_offset;
+  GElf_Off end;
+  GElf_Addr end_vaddr;
+
+  update_end (&phdr, align, &end, &end_vaddr);
+
+  /* We need at least this much.  */
+  if (! more (minread))
+    return false;
+
+  /* See how much more we can get of what the caller wants.  */
+  (void) more (*buffer_available);
+
+  if (unlikely (start >= end))
+    return false;
+
+  void *into = *buffer;
+  size_t size;
+  if (*buffer == NULL)
+    {
+      size = MIN (minread ?: 512, MAX (4096, MIN (end - start,
+						   *buffer_available)));
+      into = malloc (size);
+      if (unlikely (into == NULL))
+	{
+	  __libdwfl_seterrno (DWFL_E_NOMEM);
+	  return false;
+	}
+    }
+  else
+    size = *buffer_available;
+  /* Unlike a file, the reader can't return a short read, so stay within
+     the contiguous part of the segment.  */
+  size = MIN (size, end - start);
+
+  if (size < minread || ! core->read (into, vaddr, size, core->arg))
+    {
+      if (into != *buffer)
+	free (into);
+      return false;
+    }
+
+  if (minread == 0)		/* String mode.  */
+    {
+      const void *eos = memchr (into, '\0', size);
+      if (unlikely (eos == NULL) || unlikely (eos == into))
+	{
+	  if (*buffer == NULL)
+	    free (into);
+	  return false;
+	}
+      size = eos + 1 - into;
+    }
+
+  if (*buffer == NULL)
+    *buffer = into;
+  *buffer_available = size;
+  return true;
+}
+
+/* Dwfl_Module_Callback for dwfl_core_file_report_memory.  The buffer from
+   core_memory_callback is always malloc'd, so this is the part of
+   core_file_read_eagerly for a core file that wasn't mmap'd.  */
+static bool
+core_memory_read_eagerly (Dwfl_Module *mod,
+			  void **userdata __attribute__ ((unused)),
+			  const char *name __attribute__ ((unused)),
+			  Dwarf_Addr start __attribute__ ((unused)),
+			  void **buffer, size_t *buffer_available,
+			  GElf_Off cost, GElf_Off worthwhile,
+			  GElf_Off whole,
+			  GElf_Off contiguous __attribute__ ((unused)),
+			  void *arg __attribute__ ((unused)), Elf **elfp)
+{
+  if (whole <= *buffer_available)
+    {
+      *elfp = elf_memory (*buffer, whole);
+      if (unlikely (*elfp == NULL))
+	return false;
+
+      (*elfp)->flags |= ELF_F_MALLOCED;
+      *buffer = NULL;
+      *buffer_available = 0;
+      return true;
+    }
+
+  if (worthwhile == 0)
+    return false;
+
+  if (whole > MAX_EAGER_COST && mod->build_id_len > 0)
+    return false;
+
+  return cost <= MAX_EAGER_COST;
+}
+
+static int
+core_file_report (Dwfl *dwfl, Elf *elf, const char *executable,
+		  Dwfl_Memory_Callback *memory_callback,
+		  void *memory_callback_arg,
+		  Dwfl_Module_Callback *read_eagerly,
+		  void *read_eagerly_arg)
 {
   size_t phnum;
   if (unlikely (elf_getphdrnum (elf, &phnum) != 0))
@@ -545,7 +682,7 @@ dwfl_core_file_report (Dwfl *dwfl, Elf *elf, const char *executable)
   struct r_debug_info r_debug_info;
   memset (&r_debug_info, 0, sizeof r_debug_info);
   int retval = dwfl_link_map_report (dwfl, auxv, auxv_size,
-				     dwfl_elf_phdr_memory_callback, elf,
+				     memory_callback, memory_callback_arg,
 				     &r_debug_info);
   int listed = retval > 0 ? retval : 0;
 
@@ -556,8 +693,9 @@ dwfl_core_file_report (Dwfl *dwfl, Elf *elf, const char *executable)
   do
     {
       int seg = dwfl_segment_report_module (dwfl, ndx, NULL,
-					    &dwfl_elf_phdr_memory_callback, elf,
-					    core_file_read_eagerly, elf,
+					    memory_callback,
+					    memory_callback_arg,
+					    read_eagerly, read_eagerly_arg,
 					    note_file, note_file_size,
 					    &r_debug_info);
       if (unlikely (seg < 0))
@@ -625,6 +763,14 @@ dwfl_core_file_report (Dwfl *dwfl, Elf *elf, const char *executable)
      error rather than just nothing found.  */
   return listed > 0 ? listed : retval;
 }
+
+int
+dwfl_core_file_report (Dwfl *dwfl, Elf *elf, const char *executable)
+{
+  return core_file_report (dwfl, elf, executable,
+			   dwfl_elf_phdr_memory_callback, elf,
+			   core_file_read_eagerly, elf);
+}
 INTDEF (dwfl_core_file_report)
 NEW_VERSION (dwfl_core_file_report, ELFUTILS_0.158)
 
@@ -639,3 +785,13 @@ _compat_without_executable_dwfl_core_file_report (Dwfl *dwfl, Elf *elf)
   return dwfl_core_file_report (dwfl, elf, NULL);
 }
 #endif
+
+int
+dwfl_core_file_report_memory (Dwfl *dwfl, Elf *elf, const char *executable,
+			      Dwfl_Core_Memory_Read *memory_read, void *arg)
+{
+  struct core_memory core = { elf, memory_read, arg };
+  return core_file_report (dwfl, elf, executable,
+			   core_memory_callback, &core,
+			   core_memory_read_eagerly, NULL);
+}
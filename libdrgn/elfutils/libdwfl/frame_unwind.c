@@ -803,6 +803,24 @@ __libdwfl_frame_unwind (Dwfl_Frame *state)
      Then we need to unwind from the original, unadjusted PC.  */
   if (! state->initial_frame && ! state->signal_frame)
     pc--;
+  Dwfl_Process *callback_process = state->thread->process;
+  if (callback_process->callbacks->unwind != NULL)
+    {
+      if (new_unwound (state) == NULL)
+	{
+	  __libdwfl_seterrno (DWFL_E_NOMEM);
+	  return;
+	}
+      state->unwound->pc_state = DWFL_FRAME_STATE_PC_UNDEFINED;
+      int r = callback_process->callbacks->unwind (state, pc,
+						   callback_process->callbacks_arg);
+      if (r > 0)
+	return;
+      free (state->unwound);
+      state->unwound = NULL;
+      if (r < 0)
+	return;
+    }
   Dwarf_Addr bias;
   Dwarf_Frame *frame = dwfl_frame_dwarf_frame_pc (state, pc, &bias);
   if (frame != NULL)
@@ -838,6 +856,22 @@ __libdwfl_frame_unwind (Dwfl_Frame *state)
   state->unwound->signal_frame = signal_frame;
 }
 
+bool
+dwfl_frame_unwound_register_set (Dwfl_Frame *state, unsigned regno,
+				 Dwarf_Addr value)
+{
+  return __libdwfl_frame_reg_set (state->unwound, regno, value);
+}
+
+void
+dwfl_frame_unwound_pc_set (Dwfl_Frame *state, Dwarf_Addr pc,
+			   bool signal_frame)
+{
+  state->unwound->pc = pc;
+  state->unwound->pc_state = DWFL_FRAME_STATE_PC_SET;
+  state->unwound->signal_frame = signal_frame;
+}
+
 bool
 dwfl_frame_eval_expr (Dwfl_Frame *state, const Dwarf_Op *ops, size_t nops,
 		      Dwarf_Addr *result)
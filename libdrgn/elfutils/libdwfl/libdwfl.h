@@ -355,6 +355,21 @@ extern int dwfl_linux_kernel_report_offline (Dwfl *dwfl, const char *release,
    errors.  */
 extern int dwfl_core_file_report (Dwfl *dwfl, Elf *elf, const char *executable);
 
+/* Callback for dwfl_core_file_report_memory to read SIZE bytes of the
+   dumped memory at virtual address ADDR into BUF.  Returns false if the
+   memory can't be read.  */
+typedef bool Dwfl_Core_Memory_Read (void *buf, GElf_Addr addr, size_t size,
+				    void *arg);
+
+/* Like dwfl_core_file_report, but the contents of PT_LOAD segments are read
+   with MEMORY_READ instead of from ELF.  This is for an ELF handle which only
+   covers the headers and notes of the core file, e.g., when the core file is
+   compressed.  */
+extern int dwfl_core_file_report_memory (Dwfl *dwfl, Elf *elf,
+					 const char *executable,
+					 Dwfl_Core_Memory_Read *memory_read,
+					 void *arg);
+
 /* Call dwfl_report_module for each file mapped into the address space of PID.
    Returns zero on success, -1 if dwfl_report_module failed,
    or an errno code if opening the proc files failed.  */
@@ -690,6 +705,15 @@ typedef struct
      detach method above.  This method may be NULL.  */
   void (*thread_detach) (Dwfl_Thread *thread, void *thread_arg)
     __nonnull_attribute__ (1);
+
+  /* Called to unwind frame STATE before trying CFI.  PC is the program
+     counter to look up, which has already been adjusted for call frames.
+     Returns 1 if the frame was unwound with dwfl_frame_unwound_register_set
+     and dwfl_frame_unwound_pc_set (leaving the PC unset means STATE is the
+     outermost frame), 0 to fall back to CFI, or -1 to stop unwinding.  This
+     method may be NULL.  */
+  int (*unwind) (Dwfl_Frame *state, Dwarf_Addr pc, void *dwfl_arg)
+    __nonnull_attribute__ (1);
 } Dwfl_Thread_Callbacks;
 
 /* PID is the process id associated with the DWFL state.  Architecture of DWFL
@@ -822,6 +846,20 @@ bool dwfl_frame_pc (Dwfl_Frame *state, Dwarf_Addr *pc, bool *isactivation)
 bool dwfl_frame_register (Dwfl_Frame *state, unsigned regno, Dwarf_Addr *value)
   __nonnull_attribute__ (1);
 
+/* Called by Dwfl_Thread_Callbacks.unwind implementation.  Set register
+   REGNO of the frame unwound from STATE.  Returns false if REGNO is
+   invalid.  */
+bool dwfl_frame_unwound_register_set (Dwfl_Frame *state, unsigned regno,
+				      Dwarf_Addr value)
+  __nonnull_attribute__ (1);
+
+/* Called by Dwfl_Thread_Callbacks.unwind implementation.  Set the PC of the
+   frame unwound from STATE.  If SIGNAL_FRAME is true, the PC is the
+   interrupted instruction rather than a return address.  */
+void dwfl_frame_unwound_pc_set (Dwfl_Frame *state, Dwarf_Addr pc,
+				bool signal_frame)
+  __nonnull_attribute__ (1);
+
 /* Evaluate a DWARF expression in the context of a frame.  On success, returns
    true and fills in *RESULT.  On error, returns false.  */
 bool dwfl_frame_eval_expr (Dwfl_Frame *state, const Dwarf_Op *ops, size_t nops,
@@ -28,6 +28,13 @@ struct drgn_error drgn_stop = {
 	.message = "stop iteration",
 };
 
+struct drgn_error drgn_quiet_fault = {
+	.code = DRGN_ERROR_FAULT,
+	.message = "could not read memory",
+};
+
+__thread unsigned int drgn_quiet_faults_depth;
+
 static struct drgn_error *drgn_error_create_nodup(enum drgn_error_code code,
 						  char *message)
 {
@@ -125,6 +132,8 @@ LIBDRGN_PUBLIC struct drgn_error *drgn_error_create_fault(const char *message,
 {
 	struct drgn_error *err;
 
+	if (drgn_quiet_faults_depth)
+		return &drgn_quiet_fault;
 	err = drgn_error_create(DRGN_ERROR_FAULT, message);
 	if (err != &drgn_enomem)
 		err->address = address;
@@ -139,6 +148,8 @@ drgn_error_format_fault(uint64_t address, const char *format, ...)
 	char *message;
 	int ret;
 
+	if (drgn_quiet_faults_depth)
+		return &drgn_quiet_fault;
 	va_start(ap, format);
 	ret = vasprintf(&message, format, ap);
 	va_end(ap);
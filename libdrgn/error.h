@@ -35,6 +35,38 @@ struct drgn_object_type;
  */
 extern struct drgn_error drgn_stop;
 
+/**
+ * Global fault error returned while faults are quiet.
+ *
+ * It doesn't have an address. See @ref drgn_quiet_faults_begin().
+ */
+extern struct drgn_error drgn_quiet_fault;
+
+/** Nesting depth of @ref drgn_quiet_faults_begin() on the current thread. */
+extern __thread unsigned int drgn_quiet_faults_depth;
+
+/**
+ * Make fault errors on the current thread free until the matching call to @ref
+ * drgn_quiet_faults_end().
+ *
+ * Reading memory that isn't mapped is expected when probing for valid
+ * addresses or unwinding past the end of a stack. While faults are quiet, @ref
+ * drgn_error_create_fault() and @ref drgn_error_format_fault() return @ref
+ * drgn_quiet_fault instead of allocating an error and formatting its message.
+ * This must only be used by callers which discard fault errors. Calls may be
+ * nested.
+ */
+static inline void drgn_quiet_faults_begin(void)
+{
+	drgn_quiet_faults_depth++;
+}
+
+/** End a section started by @ref drgn_quiet_faults_begin(). */
+static inline void drgn_quiet_faults_end(void)
+{
+	drgn_quiet_faults_depth--;
+}
+
 struct string_builder;
 
 /**
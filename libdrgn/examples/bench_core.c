@@ -0,0 +1,385 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/*
+ * Microbenchmarks for core libdrgn primitives: hash tables, memory reads,
+ * deserializing bits, type and member lookups, and creating and formatting
+ * objects. Each benchmark prints one line of the form "name: N ns/op" in a
+ * fixed order, so that the output of two builds can be compared directly, e.g.:
+ *
+ * make bench
+ * make examples/bench_core && examples/bench_core -n 1000000
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../internal.h"
+#include "../hash_table.h"
+#include "../language.h"
+#include "../serialize.h"
+#include "../type.h"
+
+DEFINE_HASH_MAP(bench_map, uint64_t, uint64_t, hash_pair_int_type,
+		hash_table_scalar_eq)
+
+/* Size of the memory segment that reads go to. */
+#define BENCH_MEMORY_SIZE (1 << 20)
+
+static unsigned long num_ops = 1000000;
+static volatile uint64_t bench_sink;
+static struct timespec bench_start;
+
+static inline uint64_t bench_random(uint64_t *state)
+{
+	/* xorshift64* */
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * UINT64_C(2685821657736338717);
+}
+
+static void bench_begin(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &bench_start);
+}
+
+static void bench_end(const char *name, unsigned long n)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("%s: %.1f ns/op\n", name,
+	       ((end.tv_sec - bench_start.tv_sec) * 1e9 +
+		(end.tv_nsec - bench_start.tv_nsec)) / n);
+}
+
+static void bench_check(struct drgn_error *err)
+{
+	if (err) {
+		drgn_error_fwrite(stderr, err);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void bench_hash_table(void)
+{
+	struct bench_map map;
+	uint64_t state, sum = 0;
+	unsigned long i;
+
+	bench_map_init(&map);
+	state = 1;
+	bench_begin();
+	for (i = 0; i < num_ops; i++) {
+		struct bench_map_entry entry = {
+			.key = bench_random(&state),
+			.value = i,
+		};
+
+		if (bench_map_insert(&map, &entry, NULL) == -1) {
+			fprintf(stderr, "bench_map_insert: out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	bench_end("hash_table insert", num_ops);
+
+	state = 1;
+	bench_begin();
+	for (i = 0; i < num_ops; i++) {
+		uint64_t key = bench_random(&state);
+
+		sum += bench_map_search(&map, &key).entry->value;
+	}
+	bench_end("hash_table search hit", num_ops);
+
+	state = 2;
+	bench_begin();
+	for (i = 0; i < num_ops; i++) {
+		uint64_t key = bench_random(&state);
+
+		sum += bench_map_search(&map, &key).entry != NULL;
+	}
+	bench_end("hash_table search miss", num_ops);
+
+	state = 1;
+	bench_begin();
+	for (i = 0; i < num_ops; i++) {
+		uint64_t key = bench_random(&state);
+
+		sum += bench_map_delete(&map, &key);
+	}
+	bench_end("hash_table delete", num_ops);
+
+	bench_map_deinit(&map);
+	bench_sink = sum;
+}
+
+static struct drgn_error *bench_read_memory(void *buf, uint64_t address,
+					    size_t count, uint64_t offset,
+					    void *arg, bool physical)
+{
+	memcpy(buf, (char *)arg + offset, count);
+	return NULL;
+}
+
+static void bench_memory_reader(struct drgn_program *prog)
+{
+	uint64_t state = 1, sum = 0;
+	char buf[4096];
+	unsigned long i, n;
+
+	bench_begin();
+	for (i = 0; i < num_ops; i++) {
+		uint64_t address = (bench_random(&state) % BENCH_MEMORY_SIZE) & ~7;
+		uint64_t value;
+
+		bench_check(drgn_program_read_u64(prog, 0x10000 + address,
+						  false, &value));
+		sum += value;
+	}
+	bench_end("read_u64 random", num_ops);
+
+	n = num_ops / 10 ? num_ops / 10 : 1;
+	bench_begin();
+	for (i = 0; i < n; i++) {
+		uint64_t address = (i * sizeof(buf)) % BENCH_MEMORY_SIZE;
+
+		bench_check(drgn_program_read_memory(prog, buf,
+						     0x10000 + address,
+						     sizeof(buf), false));
+		sum += buf[0];
+	}
+	bench_end("read_memory 4096 bytes", n);
+
+	bench_begin();
+	for (i = 0; i < num_ops; i++) {
+		bool read;
+
+		bench_check(drgn_program_try_read_memory(prog, buf, 8, 8, false,
+							 &read));
+		sum += read;
+	}
+	bench_end("try_read_memory fault", num_ops);
+	bench_sink = sum;
+}
+
+static void bench_deserialize_bits(const char *memory)
+{
+	uint64_t state = 1, sum = 0;
+	uint64_t values[1024];
+	unsigned long i, n;
+
+	bench_begin();
+	for (i = 0; i < num_ops; i++) {
+		uint64_t bit_offset = bench_random(&state) % (8 * 4096);
+
+		sum += deserialize_bits(memory, bit_offset, 13, true);
+	}
+	bench_end("deserialize_bits 13-bit field", num_ops);
+
+	n = num_ops / 1024 ? num_ops / 1024 : 1;
+	bench_begin();
+	for (i = 0; i < n; i++) {
+		deserialize_bits_array(values, memory, 1024, 0, 64, 32, true);
+		sum += values[i % 1024];
+	}
+	bench_end("deserialize_bits_array 32-bit element", n * 1024);
+
+	bench_begin();
+	for (i = 0; i < n; i++) {
+		deserialize_bits_array(values, memory, 1024, 1, 64, 30, true);
+		sum += values[i % 1024];
+	}
+	bench_end("deserialize_bits_array 30-bit field element", n * 1024);
+	bench_sink = sum;
+}
+
+static struct drgn_type bench_int_type;
+static struct drgn_type bench_point_type;
+static struct drgn_type_member bench_point_members[2];
+
+static struct drgn_error *bench_find_type(enum drgn_type_kind kind,
+					  const char *name, size_t name_len,
+					  const char *filename, void *arg,
+					  struct drgn_qualified_type *ret)
+{
+	if (kind == DRGN_TYPE_STRUCT && name_len == strlen("point") &&
+	    memcmp(name, "point", name_len) == 0) {
+		ret->type = &bench_point_type;
+		ret->qualifiers = 0;
+		return NULL;
+	}
+	return &drgn_not_found;
+}
+
+static void bench_types(struct drgn_program *prog)
+{
+	struct drgn_qualified_type qualified_type;
+	struct drgn_member_info member;
+	uint64_t sum = 0;
+	unsigned long i;
+
+	bench_begin();
+	for (i = 0; i < num_ops; i++) {
+		bench_check(drgn_program_find_type(prog, "struct point", NULL,
+						   &qualified_type));
+		sum += (uintptr_t)qualified_type.type;
+	}
+	bench_end("find_type struct point", num_ops);
+
+	bench_begin();
+	for (i = 0; i < num_ops; i++) {
+		bench_check(drgn_program_find_type(prog, "unsigned long", NULL,
+						   &qualified_type));
+		sum += (uintptr_t)qualified_type.type;
+	}
+	bench_end("find_type unsigned long", num_ops);
+
+	bench_begin();
+	for (i = 0; i < num_ops; i++) {
+		bench_check(drgn_program_find_type(prog, "struct point *", NULL,
+						   &qualified_type));
+		sum += (uintptr_t)qualified_type.type;
+	}
+	bench_end("find_type struct point *", num_ops);
+
+	bench_begin();
+	for (i = 0; i < num_ops; i++) {
+		bench_check(drgn_program_member_info(prog, &bench_point_type,
+						     "y", &member));
+		sum += member.bit_offset;
+	}
+	bench_end("member_info", num_ops);
+	bench_sink = sum;
+}
+
+static void bench_objects(struct drgn_program *prog)
+{
+	struct drgn_qualified_type qualified_type = { &bench_point_type };
+	struct drgn_object obj, member;
+	uint64_t state = 1, sum = 0;
+	unsigned long i, n;
+
+	drgn_object_init(&obj, prog);
+	drgn_object_init(&member, prog);
+
+	bench_begin();
+	for (i = 0; i < num_ops; i++) {
+		uint64_t address = (bench_random(&state) % BENCH_MEMORY_SIZE) & ~7;
+
+		bench_check(drgn_object_set_reference(&obj, qualified_type,
+						      0x10000 + address, 0, 0,
+						      DRGN_PROGRAM_ENDIAN));
+		sum += obj.reference.address;
+	}
+	bench_end("object_set_reference", num_ops);
+
+	bench_begin();
+	for (i = 0; i < num_ops; i++) {
+		uint64_t value;
+
+		bench_check(drgn_object_member(&member, &obj, "y"));
+		bench_check(drgn_object_read_unsigned(&member, &value));
+		sum += value;
+	}
+	bench_end("object_member and read", num_ops);
+
+	n = num_ops / 10 ? num_ops / 10 : 1;
+	bench_begin();
+	for (i = 0; i < n; i++) {
+		char *str;
+
+		bench_check(drgn_format_object(&obj, SIZE_MAX, 0, &str));
+		sum += str[0];
+		free(str);
+	}
+	bench_end("format_object struct", n);
+
+	drgn_object_deinit(&member);
+	drgn_object_deinit(&obj);
+	bench_sink = sum;
+}
+
+static void usage(bool error)
+{
+	fprintf(error ? stderr : stdout,
+		"usage: bench_core [-n COUNT]\n"
+		"\n"
+		"Benchmark core libdrgn primitives\n"
+		"\n"
+		"Options:\n"
+		"  -n, --count COUNT       number of operations per benchmark\n"
+		"                          (default: 1000000)\n"
+		"  -h, --help              display this help message and exit\n");
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+int main(int argc, char **argv)
+{
+	struct option long_options[] = {
+		{"count", required_argument, NULL, 'n'},
+		{"help", no_argument, NULL, 'h'},
+		{},
+	};
+	uint64_t state = 1;
+	struct drgn_lazy_type int_lazy_type;
+	struct drgn_program *prog;
+	char *memory;
+	size_t i;
+
+	for (;;) {
+		int c = getopt_long(argc, argv, "n:h", long_options, NULL);
+		if (c == -1)
+			break;
+		switch (c) {
+		case 'n':
+			num_ops = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			usage(false);
+		default:
+			usage(true);
+		}
+	}
+	if (optind != argc || !num_ops)
+		usage(true);
+
+	memory = malloc(BENCH_MEMORY_SIZE);
+	if (!memory) {
+		perror("malloc");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < BENCH_MEMORY_SIZE; i++)
+		memory[i] = bench_random(&state);
+
+	drgn_int_type_init(&bench_int_type, "int", 4, true, &drgn_language_c);
+	drgn_lazy_type_init_evaluated(&int_lazy_type, &bench_int_type, 0);
+	drgn_type_member_init(&bench_point_members[0], int_lazy_type, "x", 0,
+			      0);
+	drgn_type_member_init(&bench_point_members[1], int_lazy_type, "y", 32,
+			      0);
+	drgn_struct_type_init(&bench_point_type, "point", 8,
+			      bench_point_members, 2, &drgn_language_c);
+
+	bench_check(drgn_program_create(&drgn_host_platform, &prog));
+	bench_check(drgn_program_add_memory_segment(prog, 0x10000,
+						    BENCH_MEMORY_SIZE,
+						    bench_read_memory, memory,
+						    false));
+	bench_check(drgn_program_add_type_finder(prog, bench_find_type, NULL));
+
+	bench_hash_table();
+	bench_memory_reader(prog);
+	bench_deserialize_bits(memory);
+	bench_types(prog);
+	bench_objects(prog);
+
+	drgn_program_destroy(prog);
+	free(memory);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,211 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/*
+ * Benchmark search_le lookups of address ranges in a splay tree, a sorted array
+ * searched by binary search, and an ordered index, with random and sequential
+ * addresses, e.g.:
+ *
+ * make examples/bench_ordered_index && \
+ *	examples/bench_ordered_index -s 10000 -n 10000000
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../binary_search_tree.h"
+#include "../ordered_index.h"
+
+struct bench_range {
+	struct binary_tree_node node;
+	uint64_t address;
+	uint64_t size;
+};
+
+static inline uint64_t bench_range_to_key(const struct bench_range *entry)
+{
+	return entry->address;
+}
+
+DEFINE_BINARY_SEARCH_TREE(bench_tree, struct bench_range, node,
+			  bench_range_to_key, binary_search_tree_scalar_cmp,
+			  splay)
+
+static inline uint64_t bench_range_ptr_to_key(struct bench_range * const *entry)
+{
+	return (*entry)->address;
+}
+
+DEFINE_ORDERED_INDEX(bench_index, struct bench_range *, uint64_t,
+		     bench_range_ptr_to_key)
+
+static inline uint64_t bench_random(uint64_t *state)
+{
+	/* xorshift64* */
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * UINT64_C(2685821657736338717);
+}
+
+static struct bench_range **bench_sorted;
+static size_t num_ranges = 10000;
+static uint64_t address_space;
+
+static struct bench_range *bench_array_search_le(uint64_t address)
+{
+	size_t lo = 0, hi = num_ranges;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (bench_sorted[mid]->address <= address)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo ? bench_sorted[lo - 1] : NULL;
+}
+
+enum bench_kind {
+	BENCH_TREE,
+	BENCH_ARRAY,
+	BENCH_INDEX,
+};
+
+static void bench_run(const char *name, enum bench_kind kind,
+		      struct bench_tree *tree, struct bench_index *index,
+		      unsigned long num_lookups, bool sequential)
+{
+	struct timespec start, end;
+	uint64_t state = 1, address = 0, step, hits = 0;
+	unsigned long i;
+
+	step = address_space / num_lookups + 1;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < num_lookups; i++) {
+		struct bench_range *range;
+
+		if (sequential)
+			address += step;
+		else
+			address = bench_random(&state) % address_space;
+		switch (kind) {
+		case BENCH_TREE:
+			range = bench_tree_search_le(tree, &address).entry;
+			break;
+		case BENCH_ARRAY:
+			range = bench_array_search_le(address);
+			break;
+		case BENCH_INDEX: {
+			struct bench_range **entry;
+
+			entry = bench_index_search_le(index, address);
+			range = entry ? *entry : NULL;
+			break;
+		}
+		default:
+			abort();
+		}
+		if (range && address - range->address < range->size)
+			hits++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("%s %s: %.1f ns/lookup (%.0f%% hits)\n", name,
+	       sequential ? "sequential" : "random",
+	       ((end.tv_sec - start.tv_sec) * 1e9 +
+		(end.tv_nsec - start.tv_nsec)) / num_lookups,
+	       100.0 * hits / num_lookups);
+}
+
+static void usage(bool error)
+{
+	fprintf(error ? stderr : stdout,
+		"usage: bench_ordered_index [-s RANGES] [-n LOOKUPS]\n"
+		"\n"
+		"Benchmark address range lookups\n"
+		"\n"
+		"Options:\n"
+		"  -s, --size RANGES       number of ranges (default: 10000)\n"
+		"  -n, --count LOOKUPS     number of lookups (default: 10000000)\n"
+		"  -h, --help              display this help message and exit\n");
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+int main(int argc, char **argv)
+{
+	struct option long_options[] = {
+		{"size", required_argument, NULL, 's'},
+		{"count", required_argument, NULL, 'n'},
+		{"help", no_argument, NULL, 'h'},
+		{},
+	};
+	unsigned long num_lookups = 10000000;
+	struct bench_range *ranges, **entries;
+	struct bench_tree tree;
+	struct bench_index index;
+	uint64_t state = 1;
+	size_t i;
+
+	for (;;) {
+		int c = getopt_long(argc, argv, "s:n:h", long_options, NULL);
+		if (c == -1)
+			break;
+		switch (c) {
+		case 's':
+			num_ranges = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			num_lookups = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			usage(false);
+		default:
+			usage(true);
+		}
+	}
+	if (optind != argc || !num_ranges || !num_lookups)
+		usage(true);
+
+	ranges = calloc(num_ranges, sizeof(*ranges));
+	bench_sorted = calloc(num_ranges, sizeof(*bench_sorted));
+	entries = calloc(num_ranges, sizeof(*entries));
+	if (!ranges || !bench_sorted || !entries) {
+		perror("calloc");
+		return EXIT_FAILURE;
+	}
+	/* Ranges of random sizes separated by random gaps. */
+	bench_tree_init(&tree);
+	for (i = 0; i < num_ranges; i++) {
+		address_space += 4096 * (bench_random(&state) % 16);
+		ranges[i].address = address_space;
+		ranges[i].size = 4096 * (1 + bench_random(&state) % 64);
+		address_space += ranges[i].size;
+		bench_sorted[i] = entries[i] = &ranges[i];
+		bench_tree_insert(&tree, &ranges[i], NULL);
+	}
+	bench_index_init(&index);
+	if (!bench_index_build(&index, entries, num_ranges)) {
+		perror("bench_index_build");
+		return EXIT_FAILURE;
+	}
+
+	bench_run("splay tree", BENCH_TREE, &tree, &index, num_lookups, false);
+	bench_run("binary search", BENCH_ARRAY, &tree, &index, num_lookups,
+		  false);
+	bench_run("ordered index", BENCH_INDEX, &tree, &index, num_lookups,
+		  false);
+	bench_run("splay tree", BENCH_TREE, &tree, &index, num_lookups, true);
+	bench_run("binary search", BENCH_ARRAY, &tree, &index, num_lookups,
+		  true);
+	bench_run("ordered index", BENCH_INDEX, &tree, &index, num_lookups,
+		  true);
+
+	bench_index_deinit(&index);
+	free(bench_sorted);
+	free(ranges);
+	return EXIT_SUCCESS;
+}
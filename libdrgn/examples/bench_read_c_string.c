@@ -0,0 +1,142 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/*
+ * Count the memory allocations and time taken by drgn_program_read_c_string()
+ * for strings of a given length, e.g.:
+ *
+ * make examples/bench_read_c_string && examples/bench_read_c_string -l 16
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "drgn.h"
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long num_allocations;
+
+void *malloc(size_t size)
+{
+	num_allocations++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	num_allocations++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	num_allocations++;
+	return __libc_realloc(ptr, size);
+}
+
+static struct drgn_error *read_buffer(void *buf, uint64_t address,
+				      size_t count, uint64_t offset, void *arg,
+				      bool physical)
+{
+	memcpy(buf, (char *)arg + offset, count);
+	return NULL;
+}
+
+static void usage(bool error)
+{
+	fprintf(error ? stderr : stdout,
+		"usage: bench_read_c_string [-l LENGTH] [-n COUNT]\n"
+		"\n"
+		"Count allocations done by drgn_program_read_c_string()\n"
+		"\n"
+		"Options:\n"
+		"  -l, --length LENGTH     length of the string (default: 16)\n"
+		"  -n, --count COUNT       number of reads (default: 1000000)\n"
+		"  -h, --help              display this help message and exit\n");
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+int main(int argc, char **argv)
+{
+	struct option long_options[] = {
+		{"length", required_argument, NULL, 'l'},
+		{"count", required_argument, NULL, 'n'},
+		{"help", no_argument, NULL, 'h'},
+		{},
+	};
+	size_t length = 16;
+	unsigned long count = 1000000, i, start_allocations;
+	struct drgn_error *err;
+	struct drgn_program *prog;
+	struct timespec start, end;
+	char *buf;
+
+	for (;;) {
+		int c = getopt_long(argc, argv, "l:n:h", long_options, NULL);
+		if (c == -1)
+			break;
+		switch (c) {
+		case 'l':
+			length = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			usage(false);
+		default:
+			usage(true);
+		}
+	}
+	if (optind != argc || !count)
+		usage(true);
+
+	buf = malloc(length + 1);
+	if (!buf) {
+		perror("malloc");
+		return EXIT_FAILURE;
+	}
+	memset(buf, 'a', length);
+	buf[length] = '\0';
+
+	err = drgn_program_create(&drgn_host_platform, &prog);
+	if (!err) {
+		err = drgn_program_add_memory_segment(prog, 0x10000, length + 1,
+						      read_buffer, buf, false);
+	}
+	if (err) {
+		drgn_error_fwrite(stderr, err);
+		return EXIT_FAILURE;
+	}
+
+	start_allocations = num_allocations;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i++) {
+		char *str;
+
+		err = drgn_program_read_c_string(prog, 0x10000, false,
+						 SIZE_MAX, &str);
+		if (err) {
+			drgn_error_fwrite(stderr, err);
+			return EXIT_FAILURE;
+		}
+		free(str);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("%.2f allocations/read, %.1f ns/read\n",
+	       (double)(num_allocations - start_allocations) / count,
+	       ((end.tv_sec - start.tv_sec) * 1e9 +
+		(end.tv_nsec - start.tv_nsec)) / count);
+
+	drgn_program_destroy(prog);
+	free(buf);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,202 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/*
+ * Benchmark a sharded hash table against a single hash table behind one lock
+ * under contention. Each thread searches for random keys and inserts the ones
+ * that are missing, like a cache that is filled on demand.
+ *
+ * make examples/bench_sharded_hash_table && \
+ *	examples/bench_sharded_hash_table -t 8 -n 1000000 -i 10
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../hash_table.h"
+
+DEFINE_HASH_MAP(bench_map, uint64_t, uint64_t, hash_pair_int_type,
+		hash_table_scalar_eq)
+DEFINE_SHARDED_HASH_TABLE(bench_sharded_map, bench_map, 6)
+
+struct bench_locked_map {
+	pthread_rwlock_t lock;
+	struct bench_map map;
+};
+
+struct bench_thread {
+	pthread_t thread;
+	void *map;
+	uint64_t seed;
+};
+
+static unsigned long num_ops = 1000000;
+static unsigned long num_keys = 100000;
+static unsigned int insert_percent = 10;
+
+static inline uint64_t bench_random(uint64_t *state)
+{
+	/* xorshift64* */
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * UINT64_C(2685821657736338717);
+}
+
+static void *bench_locked_thread(void *arg)
+{
+	struct bench_thread *thread = arg;
+	struct bench_locked_map *locked = thread->map;
+	unsigned long i;
+
+	for (i = 0; i < num_ops; i++) {
+		uint64_t r = bench_random(&thread->seed);
+		struct bench_map_entry entry = {
+			.key = r % num_keys,
+			.value = r,
+		};
+
+		if ((r >> 32) % 100 < insert_percent) {
+			pthread_rwlock_wrlock(&locked->lock);
+			bench_map_insert(&locked->map, &entry, NULL);
+		} else {
+			pthread_rwlock_rdlock(&locked->lock);
+			bench_map_search(&locked->map, &entry.key);
+		}
+		pthread_rwlock_unlock(&locked->lock);
+	}
+	return NULL;
+}
+
+static void *bench_sharded_thread(void *arg)
+{
+	struct bench_thread *thread = arg;
+	struct bench_sharded_map *sharded = thread->map;
+	unsigned long i;
+
+	for (i = 0; i < num_ops; i++) {
+		uint64_t r = bench_random(&thread->seed);
+		struct bench_map_entry entry = {
+			.key = r % num_keys,
+			.value = r,
+		};
+
+		if ((r >> 32) % 100 < insert_percent)
+			bench_sharded_map_insert(sharded, &entry, NULL);
+		else
+			bench_sharded_map_search(sharded, &entry.key, NULL);
+	}
+	return NULL;
+}
+
+static double bench_run(const char *name, void *(*fn)(void *), void *map,
+			unsigned int num_threads)
+{
+	struct bench_thread *threads;
+	struct timespec start, end;
+	unsigned int i;
+	double elapsed;
+
+	threads = calloc(num_threads, sizeof(*threads));
+	if (!threads) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < num_threads; i++) {
+		threads[i].map = map;
+		threads[i].seed = i + 1;
+		if (pthread_create(&threads[i].thread, NULL, fn, &threads[i])) {
+			perror("pthread_create");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (i = 0; i < num_threads; i++)
+		pthread_join(threads[i].thread, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	free(threads);
+
+	elapsed = ((end.tv_sec - start.tv_sec) * 1e9 +
+		   (end.tv_nsec - start.tv_nsec));
+	printf("%s: %.1f ns/op, %.1f Mops/s\n", name,
+	       elapsed / ((double)num_ops * num_threads),
+	       (double)num_ops * num_threads / elapsed * 1e3);
+	return elapsed;
+}
+
+static void usage(bool error)
+{
+	fprintf(error ? stderr : stdout,
+		"usage: bench_sharded_hash_table [-t THREADS] [-n OPS] [-k KEYS] [-i PERCENT]\n"
+		"\n"
+		"Benchmark a sharded hash table against one locked hash table\n"
+		"\n"
+		"Options:\n"
+		"  -t, --threads THREADS   number of threads (default: 4)\n"
+		"  -n, --ops OPS           operations per thread (default: 1000000)\n"
+		"  -k, --keys KEYS         number of distinct keys (default: 100000)\n"
+		"  -i, --insert PERCENT    percentage of operations that insert\n"
+		"                          (default: 10)\n"
+		"  -h, --help              display this help message and exit\n");
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+int main(int argc, char **argv)
+{
+	struct option long_options[] = {
+		{"threads", required_argument, NULL, 't'},
+		{"ops", required_argument, NULL, 'n'},
+		{"keys", required_argument, NULL, 'k'},
+		{"insert", required_argument, NULL, 'i'},
+		{"help", no_argument, NULL, 'h'},
+		{},
+	};
+	unsigned int num_threads = 4;
+	struct bench_locked_map locked;
+	struct bench_sharded_map sharded;
+	double locked_ns, sharded_ns;
+
+	for (;;) {
+		int c = getopt_long(argc, argv, "t:n:k:i:h", long_options, NULL);
+		if (c == -1)
+			break;
+		switch (c) {
+		case 't':
+			num_threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			num_ops = strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			num_keys = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			insert_percent = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			usage(false);
+		default:
+			usage(true);
+		}
+	}
+	if (optind != argc || !num_threads || !num_keys || insert_percent > 100)
+		usage(true);
+
+	pthread_rwlock_init(&locked.lock, NULL);
+	bench_map_init(&locked.map);
+	locked_ns = bench_run("locked", bench_locked_thread, &locked,
+			      num_threads);
+	bench_map_deinit(&locked.map);
+	pthread_rwlock_destroy(&locked.lock);
+
+	bench_sharded_map_init(&sharded);
+	sharded_ns = bench_run("sharded", bench_sharded_thread, &sharded,
+			       num_threads);
+	bench_sharded_map_deinit(&sharded);
+
+	printf("speedup: %.2fx\n", locked_ns / sharded_ns);
+	return EXIT_SUCCESS;
+}
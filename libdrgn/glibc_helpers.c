@@ -0,0 +1,582 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <byteswap.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+#include "hash_table.h"
+#include "helpers.h"
+#include "program.h"
+#include "vector.h"
+
+/* Low bits of the size field of a malloc chunk. */
+#define PREV_INUSE 0x1
+#define SIZE_BITS 0x7
+
+/*
+ * Upper bound on the number of arenas, heaps per arena, and chunks per fastbin
+ * that are followed, in case the lists are corrupted.
+ */
+#define MALLOC_WALK_MAX_LIST_LENGTH (1 << 24)
+
+DEFINE_VECTOR(glibc_helper_malloc_chunk_vector,
+	      struct glibc_helper_malloc_chunk)
+DEFINE_HASH_MAP(malloc_size_class_map, uint64_t, uint64_t, hash_pair_int_type,
+		hash_table_scalar_eq)
+DEFINE_HASH_SET(malloc_chunk_set, uint64_t, hash_pair_int_type,
+		hash_table_scalar_eq)
+
+struct malloc_walk {
+	struct drgn_program *prog;
+	bool bswap;
+	/* SIZE_SZ, i.e., sizeof(size_t). */
+	uint64_t word_size;
+	/* MALLOC_ALIGNMENT. */
+	uint64_t alignment;
+	/* HEAP_MAX_SIZE. */
+	uint64_t heap_max_size;
+	/* struct malloc_state. */
+	uint64_t arena_size, arena_top_offset, arena_next_offset;
+	uint64_t arena_fastbins_offset, num_fastbins;
+	/* heap_info, which is only looked up if there are thread arenas. */
+	bool have_heap_info;
+	uint64_t heap_info_size, heap_ar_ptr_offset, heap_prev_offset;
+	uint64_t heap_size_offset;
+	/* Whether fastbin pointers are mangled (glibc 2.32+), if known. */
+	bool safe_linking_known, safe_linking;
+	struct glibc_helper_malloc_stats *stats;
+	struct malloc_size_class_map size_classes;
+	struct malloc_chunk_set fastbin_chunks;
+	bool want_chunks;
+	uint64_t min_size, max_size;
+	struct glibc_helper_malloc_chunk_vector chunks;
+	/* Block of heap memory which was last read. */
+	char *buf;
+	uint64_t buf_address;
+	size_t buf_size;
+};
+
+static struct drgn_error *malloc_walk_offset(struct drgn_program *prog,
+					     struct drgn_type *type,
+					     const char *member_designator,
+					     uint64_t *ret)
+{
+	struct drgn_error *err;
+	struct drgn_member_info member;
+
+	err = drgn_program_member_path(prog, type, member_designator, &member);
+	if (err)
+		return err;
+	*ret = member.bit_offset / 8;
+	return NULL;
+}
+
+static uint64_t malloc_walk_decode_word(struct malloc_walk *w, const char *p)
+{
+	if (w->word_size == 8) {
+		uint64_t value;
+
+		memcpy(&value, p, sizeof(value));
+		return w->bswap ? bswap_64(value) : value;
+	} else {
+		uint32_t value;
+
+		memcpy(&value, p, sizeof(value));
+		return w->bswap ? bswap_32(value) : value;
+	}
+}
+
+/*
+ * Read a word of the heap range which ends at end, reading the next block of
+ * the range if it isn't in the buffer.
+ */
+static struct drgn_error *malloc_walk_heap_word(struct malloc_walk *w,
+						uint64_t address, uint64_t end,
+						uint64_t *ret)
+{
+	struct drgn_error *err;
+
+	if (address < w->buf_address ||
+	    address - w->buf_address + w->word_size > w->buf_size) {
+		size_t size = min(end - address,
+				  (uint64_t)GLIBC_HELPER_MALLOC_READ_SIZE);
+
+		if (size < w->word_size)
+			size = w->word_size;
+		w->buf_size = 0;
+		err = drgn_program_read_memory(w->prog, w->buf, address, size,
+					       false);
+		if (err)
+			return err;
+		w->buf_address = address;
+		w->buf_size = size;
+	}
+	*ret = malloc_walk_decode_word(w, w->buf + (address - w->buf_address));
+	return NULL;
+}
+
+/* Align a chunk address so that the memory it returns is aligned. */
+static uint64_t malloc_walk_align_chunk(struct malloc_walk *w, uint64_t chunk)
+{
+	uint64_t misalign = (chunk + 2 * w->word_size) % w->alignment;
+
+	return misalign ? chunk + w->alignment - misalign : chunk;
+}
+
+/* Account for a chunk once whether it is in use is known. */
+static struct drgn_error *malloc_walk_chunk(struct malloc_walk *w,
+					    uint64_t chunk, uint64_t size,
+					    bool in_use)
+{
+	struct glibc_helper_malloc_stats *stats = w->stats;
+	struct malloc_size_class_map_entry entry = { .key = size, .value = 1 };
+	struct malloc_size_class_map_iterator it;
+	uint64_t usable;
+	int ret;
+
+	/* Fastbin chunks are still marked as in use. */
+	if (in_use &&
+	    malloc_chunk_set_search(&w->fastbin_chunks, &chunk).entry) {
+		stats->fastbin_chunks++;
+		stats->fastbin_bytes += size;
+		in_use = false;
+	}
+	if (!in_use) {
+		stats->free_chunks++;
+		stats->free_bytes += size;
+		return NULL;
+	}
+
+	stats->in_use_chunks++;
+	stats->in_use_bytes += size;
+	ret = malloc_size_class_map_insert(&w->size_classes, &entry, &it);
+	if (ret == -1)
+		return &drgn_enomem;
+	else if (ret == 0)
+		it.entry->value++;
+
+	usable = size - w->word_size;
+	if (w->want_chunks && usable >= w->min_size && usable <= w->max_size) {
+		struct glibc_helper_malloc_chunk *allocated;
+
+		allocated =
+			glibc_helper_malloc_chunk_vector_append_entry(&w->chunks);
+		if (!allocated)
+			return &drgn_enomem;
+		allocated->address = chunk + 2 * w->word_size;
+		allocated->size = usable;
+	}
+	return NULL;
+}
+
+/*
+ * Walk the chunks in [start, end). If top is non-zero, it is the top chunk of
+ * the arena, which ends the walk. Otherwise, the walk ends at the fencepost at
+ * the end of a heap.
+ */
+static struct drgn_error *malloc_walk_chunks(struct malloc_walk *w,
+					     uint64_t start, uint64_t end,
+					     uint64_t top)
+{
+	struct drgn_error *err;
+	/*
+	 * Whether a chunk is in use is only known from the header of the next
+	 * chunk, so one chunk is pending at a time.
+	 */
+	uint64_t chunk = start, pending = 0, pending_size = 0;
+
+	while (chunk <= end - 2 * w->word_size) {
+		uint64_t head, size;
+
+		err = malloc_walk_heap_word(w, chunk + w->word_size, end,
+					    &head);
+		if (err)
+			return err;
+		size = head & ~(uint64_t)SIZE_BITS;
+		if (pending) {
+			err = malloc_walk_chunk(w, pending, pending_size,
+						head & PREV_INUSE);
+			if (err)
+				return err;
+			pending = 0;
+		}
+		if (chunk == top) {
+			w->stats->top_bytes += size;
+			return NULL;
+		}
+		/* Fenceposts are smaller than MINSIZE. */
+		if (size < 4 * w->word_size)
+			return NULL;
+		if (size > end - chunk || size % w->alignment) {
+			return drgn_error_format(DRGN_ERROR_OTHER,
+						 "malloc chunk at 0x%" PRIx64 " is corrupted",
+						 chunk);
+		}
+		pending = chunk;
+		pending_size = size;
+		chunk += size;
+	}
+	if (pending)
+		return malloc_walk_chunk(w, pending, pending_size, true);
+	return NULL;
+}
+
+/*
+ * Collect the chunks in the fastbins of an arena. Errors following the lists
+ * are ignored, since corrupted fastbins shouldn't prevent the rest of the walk.
+ */
+static struct drgn_error *malloc_walk_fastbins(struct malloc_walk *w,
+					       uint64_t arena)
+{
+	struct drgn_error *err;
+	uint64_t i;
+
+	for (i = 0; i < w->num_fastbins; i++) {
+		uint64_t chunk, length = 0;
+
+		err = drgn_program_read_word(w->prog,
+					     arena + w->arena_fastbins_offset +
+					     i * w->word_size, false, &chunk);
+		if (err)
+			return err;
+		while (chunk && length++ < MALLOC_WALK_MAX_LIST_LENGTH) {
+			uint64_t fd_address = chunk + 2 * w->word_size, fd;
+			int ret;
+
+			ret = malloc_chunk_set_insert(&w->fastbin_chunks,
+						      &chunk, NULL);
+			if (ret == -1)
+				return &drgn_enomem;
+			/* Stop at a cycle. */
+			if (ret == 0)
+				break;
+			err = drgn_program_read_word(w->prog, fd_address, false,
+						     &fd);
+			if (err) {
+				drgn_error_destroy(err);
+				break;
+			}
+			/*
+			 * With safe-linking, fd is mangled with the address it
+			 * is stored at. A mangled pointer is almost never
+			 * aligned, which decides for the whole heap.
+			 */
+			if (!w->safe_linking_known && fd) {
+				w->safe_linking = fd % w->alignment != 0;
+				w->safe_linking_known = true;
+			}
+			if (w->safe_linking)
+				fd ^= fd_address >> 12;
+			if (fd % w->alignment)
+				break;
+			chunk = fd;
+		}
+	}
+	return NULL;
+}
+
+static struct drgn_error *malloc_walk_init_heap_info(struct malloc_walk *w)
+{
+	struct drgn_error *err;
+	struct drgn_qualified_type heap_info_type;
+
+	if (w->have_heap_info)
+		return NULL;
+	err = drgn_program_find_type(w->prog, "struct _heap_info", NULL,
+				     &heap_info_type);
+	if (err)
+		return err;
+	err = drgn_type_sizeof(heap_info_type.type, &w->heap_info_size);
+	if (err)
+		return err;
+	err = malloc_walk_offset(w->prog, heap_info_type.type, "ar_ptr",
+				 &w->heap_ar_ptr_offset);
+	if (err)
+		return err;
+	err = malloc_walk_offset(w->prog, heap_info_type.type, "prev",
+				 &w->heap_prev_offset);
+	if (err)
+		return err;
+	err = malloc_walk_offset(w->prog, heap_info_type.type, "size",
+				 &w->heap_size_offset);
+	if (err)
+		return err;
+	w->have_heap_info = true;
+	return NULL;
+}
+
+/* Walk the heaps of a thread arena, starting from the one with the top. */
+static struct drgn_error *malloc_walk_thread_arena(struct malloc_walk *w,
+						   uint64_t arena, uint64_t top)
+{
+	struct drgn_error *err;
+	uint64_t heap, length = 0;
+
+	err = malloc_walk_init_heap_info(w);
+	if (err)
+		return err;
+	heap = top & ~(w->heap_max_size - 1);
+	while (heap) {
+		uint64_t ar_ptr, size, start;
+
+		if (length++ >= MALLOC_WALK_MAX_LIST_LENGTH) {
+			return drgn_error_create(DRGN_ERROR_OTHER,
+						 "malloc heap list is too long");
+		}
+		err = drgn_program_read_word(w->prog,
+					     heap + w->heap_ar_ptr_offset,
+					     false, &ar_ptr);
+		if (err)
+			return err;
+		if (ar_ptr != arena) {
+			return drgn_error_format(DRGN_ERROR_OTHER,
+						 "malloc heap at 0x%" PRIx64 " is not in arena at 0x%" PRIx64,
+						 heap, arena);
+		}
+		err = drgn_program_read_word(w->prog,
+					     heap + w->heap_size_offset, false,
+					     &size);
+		if (err)
+			return err;
+		if (size > w->heap_max_size) {
+			return drgn_error_format(DRGN_ERROR_OTHER,
+						 "malloc heap at 0x%" PRIx64 " is corrupted",
+						 heap);
+		}
+		/* The first heap of an arena also contains the arena. */
+		if (heap + w->heap_info_size == arena)
+			start = arena + w->arena_size;
+		else
+			start = heap + w->heap_info_size;
+		err = malloc_walk_chunks(w, malloc_walk_align_chunk(w, start),
+					 heap + size,
+					 top >= heap && top < heap + size ?
+					 top : 0);
+		if (err)
+			return err;
+		w->stats->heaps++;
+		err = drgn_program_read_word(w->prog,
+					     heap + w->heap_prev_offset, false,
+					     &heap);
+		if (err)
+			return err;
+	}
+	return NULL;
+}
+
+static struct drgn_error *malloc_walk_init(struct malloc_walk *w,
+					   uint64_t *main_arena_ret,
+					   uint64_t *sbrk_base_ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = w->prog;
+	struct drgn_qualified_type arena_type;
+	struct drgn_member_info fastbins;
+	struct drgn_object obj;
+	uint64_t fastbins_size;
+
+	if (!prog->has_platform) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "program byte order is not known");
+	}
+	if (prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "malloc heap can only be walked for userspace programs");
+	}
+	w->bswap = drgn_program_bswap(prog);
+	w->word_size = drgn_program_is_64_bit(prog) ? 8 : 4;
+	w->alignment = 2 * w->word_size;
+	/* 2 * DEFAULT_MMAP_THRESHOLD_MAX. */
+	w->heap_max_size = (w->word_size == 8 ?
+			    UINT64_C(64) * 1024 * 1024 : UINT64_C(1024) * 1024);
+
+	err = drgn_program_find_type(prog, "struct malloc_state", NULL,
+				     &arena_type);
+	if (err)
+		return err;
+	err = drgn_type_sizeof(arena_type.type, &w->arena_size);
+	if (err)
+		return err;
+	err = malloc_walk_offset(prog, arena_type.type, "top",
+				 &w->arena_top_offset);
+	if (err)
+		return err;
+	err = malloc_walk_offset(prog, arena_type.type, "next",
+				 &w->arena_next_offset);
+	if (err)
+		return err;
+	err = drgn_program_member_info(prog, arena_type.type, "fastbinsY",
+				       &fastbins);
+	if (err)
+		return err;
+	w->arena_fastbins_offset = fastbins.bit_offset / 8;
+	err = drgn_type_sizeof(fastbins.qualified_type.type, &fastbins_size);
+	if (err)
+		return err;
+	w->num_fastbins = fastbins_size / w->word_size;
+
+	drgn_object_init(&obj, prog);
+	err = drgn_program_find_object(prog, "main_arena", NULL,
+				       DRGN_FIND_OBJECT_VARIABLE, &obj);
+	if (err)
+		goto out;
+	err = drgn_object_address_of(&obj, &obj);
+	if (err)
+		goto out;
+	err = drgn_object_read_unsigned(&obj, main_arena_ret);
+	if (err)
+		goto out;
+	err = drgn_program_find_object(prog, "mp_", NULL,
+				       DRGN_FIND_OBJECT_VARIABLE, &obj);
+	if (err)
+		goto out;
+	err = drgn_object_member(&obj, &obj, "sbrk_base");
+	if (err)
+		goto out;
+	err = drgn_object_read_unsigned(&obj, sbrk_base_ret);
+out:
+	drgn_object_deinit(&obj);
+	return err;
+}
+
+static int glibc_helper_malloc_size_class_cmp(const void *a, const void *b)
+{
+	const struct glibc_helper_malloc_size_class *class_a = a, *class_b = b;
+
+	return (class_a->size > class_b->size) -
+	       (class_a->size < class_b->size);
+}
+
+/* Convert the size class map to the sorted array in the statistics. */
+static struct drgn_error *malloc_walk_size_classes(struct malloc_walk *w)
+{
+	struct glibc_helper_malloc_stats *stats = w->stats;
+	struct malloc_size_class_map_iterator it;
+	size_t n = malloc_size_class_map_size(&w->size_classes), i = 0;
+
+	stats->size_classes = malloc_array(n ? n : 1,
+					   sizeof(*stats->size_classes));
+	if (!stats->size_classes)
+		return &drgn_enomem;
+	for (it = malloc_size_class_map_first(&w->size_classes); it.entry;
+	     it = malloc_size_class_map_next(it)) {
+		stats->size_classes[i].size = it.entry->key;
+		stats->size_classes[i].count = it.entry->value;
+		i++;
+	}
+	qsort(stats->size_classes, n, sizeof(*stats->size_classes),
+	      glibc_helper_malloc_size_class_cmp);
+	stats->num_size_classes = n;
+	return NULL;
+}
+
+struct drgn_error *
+glibc_helper_malloc_walk(struct drgn_program *prog,
+			 struct glibc_helper_malloc_stats *stats_ret,
+			 uint64_t min_size, uint64_t max_size,
+			 struct glibc_helper_malloc_chunk **chunks_ret,
+			 size_t *num_chunks_ret)
+{
+	struct drgn_error *err;
+	struct malloc_walk w = {
+		.prog = prog,
+		.stats = stats_ret,
+		.want_chunks = chunks_ret != NULL,
+		.min_size = min_size,
+		.max_size = max_size,
+	};
+	uint64_t main_arena, sbrk_base, arena, length = 0;
+
+	memset(stats_ret, 0, sizeof(*stats_ret));
+	malloc_size_class_map_init(&w.size_classes);
+	malloc_chunk_set_init(&w.fastbin_chunks);
+	glibc_helper_malloc_chunk_vector_init(&w.chunks);
+
+	err = malloc_walk_init(&w, &main_arena, &sbrk_base);
+	if (err)
+		goto out;
+	w.buf = malloc(GLIBC_HELPER_MALLOC_READ_SIZE);
+	if (!w.buf) {
+		err = &drgn_enomem;
+		goto out;
+	}
+
+	/* Collect the fastbin chunks first, since they look allocated. */
+	arena = main_arena;
+	do {
+		if (length++ >= MALLOC_WALK_MAX_LIST_LENGTH) {
+			err = drgn_error_create(DRGN_ERROR_OTHER,
+						"malloc arena list is too long");
+			goto out;
+		}
+		err = malloc_walk_fastbins(&w, arena);
+		if (err)
+			goto out;
+		err = drgn_program_read_word(prog, arena + w.arena_next_offset,
+					     false, &arena);
+		if (err)
+			goto out;
+	} while (arena && arena != main_arena);
+
+	arena = main_arena;
+	do {
+		uint64_t top;
+
+		err = drgn_program_read_word(prog, arena + w.arena_top_offset,
+					     false, &top);
+		if (err)
+			goto out;
+		if (arena == main_arena) {
+			/*
+			 * The main arena is contiguous from the start of the
+			 * brk heap to the top chunk unless sbrk failed, in
+			 * which case only the top chunk is counted.
+			 */
+			uint64_t start = malloc_walk_align_chunk(&w,
+								 sbrk_base);
+
+			if (sbrk_base && top >= start) {
+				err = malloc_walk_chunks(&w, start,
+							 top + 2 * w.word_size,
+							 top);
+			}
+		} else {
+			err = malloc_walk_thread_arena(&w, arena, top);
+		}
+		if (err)
+			goto out;
+		stats_ret->arenas++;
+		err = drgn_program_read_word(prog, arena + w.arena_next_offset,
+					     false, &arena);
+		if (err)
+			goto out;
+	} while (arena && arena != main_arena);
+
+	err = malloc_walk_size_classes(&w);
+	if (err)
+		goto out;
+	if (chunks_ret) {
+		glibc_helper_malloc_chunk_vector_shrink_to_fit(&w.chunks);
+		*chunks_ret = w.chunks.data;
+		*num_chunks_ret = w.chunks.size;
+		glibc_helper_malloc_chunk_vector_init(&w.chunks);
+	}
+out:
+	if (err)
+		glibc_helper_malloc_stats_deinit(stats_ret);
+	free(w.buf);
+	glibc_helper_malloc_chunk_vector_deinit(&w.chunks);
+	malloc_chunk_set_deinit(&w.fastbin_chunks);
+	malloc_size_class_map_deinit(&w.size_classes);
+	return err;
+}
+
+void glibc_helper_malloc_stats_deinit(struct glibc_helper_malloc_stats *stats)
+{
+	free(stats->size_classes);
+	stats->size_classes = NULL;
+	stats->num_size_classes = 0;
+}
@@ -18,6 +18,7 @@
 #ifdef __SSE4_2__
 #include <nmmintrin.h>
 #endif
+#include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -25,6 +26,7 @@
 
 #include "cityhash.h"
 #include "util.h"
+#include "wyhash.h"
 
 /**
  * @ingroup Internals
@@ -165,6 +167,13 @@ bool hash_table_empty(struct hash_table *table);
  */
 size_t hash_table_size(struct hash_table *table);
 
+/**
+ * Get the number of bytes allocated by a @ref hash_table.
+ *
+ * This doesn't include memory owned by the entries themselves.
+ */
+size_t hash_table_memory_usage(struct hash_table *table);
+
 /**
  * Delete all entries in a @ref hash_table.
  *
@@ -760,6 +769,15 @@ static bool table##_reserve(struct table *table, size_t capacity)		\
 }										\
 										\
 __attribute__((unused))								\
+static size_t table##_memory_usage(struct table *table)			\
+{										\
+	if (table->chunks == hash_table_empty_chunk)				\
+		return 0;							\
+	return table##_alloc_size(table->chunk_mask + 1,			\
+				  table##_max_size(table));			\
+}										\
+										\
+__attribute__((unused))								\
 static void table##_clear(struct table *table)					\
 {										\
 	size_t chunk_count;							\
@@ -1190,6 +1208,204 @@ DEFINE_HASH_TABLE_FUNCTIONS(table, hash_func, eq_func)
 DEFINE_HASH_SET_TYPE(table, key_type)				\
 DEFINE_HASH_TABLE_FUNCTIONS(table, hash_func, eq_func)
 
+/**
+ * Get the shard for a hash from a table split into <tt>1 << shard_bits</tt>
+ * shards.
+ *
+ * The 8 most significant bits of the hash are used as the F14 tag and the least
+ * significant bits select the chunk, so this uses the bits just below the tag.
+ */
+static inline size_t hash_pair_to_shard(struct hash_pair hp,
+					unsigned int shard_bits)
+{
+	return ((hp.first >> (8 * sizeof(size_t) - 8 - shard_bits)) &
+		(((size_t)1 << shard_bits) - 1));
+}
+
+/**
+ * Define a hash table which is split into shards that can be used concurrently.
+ *
+ * Each shard is an instance of an existing hash table, @p base_table (defined
+ * with @ref DEFINE_HASH_TABLE() or one of its wrappers), protected by its own
+ * read-write lock. Searches only take the read lock, so they run in parallel;
+ * inserts and deletes take the write lock of one shard. The shard is chosen by
+ * @ref hash_pair_to_shard(), so an entry's shard and its chunk within the shard
+ * come from the same hash.
+ *
+ * Because another thread may rehash a shard as soon as its lock is dropped,
+ * the functions copy entries out instead of returning iterators. Compound
+ * operations can lock a shard returned by <tt>table_shard()</tt> and use the
+ * @p base_table interface on <tt>shard->base</tt> directly.
+ *
+ * This defines (with the example name @c sharded_table):
+ *
+ * @code{.c}
+ * struct sharded_table_shard {
+ *     pthread_rwlock_t lock;
+ *     struct base_table base;
+ * };
+ * struct sharded_table {
+ *     struct sharded_table_shard shards[1 << shard_bits];
+ * };
+ * void sharded_table_init(struct sharded_table *table);
+ * void sharded_table_deinit(struct sharded_table *table);
+ * struct sharded_table_shard *sharded_table_shard(struct sharded_table *table,
+ *                                                 struct hash_pair hp);
+ * bool sharded_table_search_hashed(struct sharded_table *table,
+ *                                  const key_type *key, struct hash_pair hp,
+ *                                  entry_type *entry_ret);
+ * bool sharded_table_search(struct sharded_table *table, const key_type *key,
+ *                           entry_type *entry_ret);
+ * int sharded_table_insert_hashed(struct sharded_table *table,
+ *                                 const entry_type *entry,
+ *                                 struct hash_pair hp, entry_type *entry_ret);
+ * int sharded_table_insert(struct sharded_table *table,
+ *                          const entry_type *entry, entry_type *entry_ret);
+ * bool sharded_table_delete(struct sharded_table *table, const key_type *key);
+ * size_t sharded_table_size(struct sharded_table *table);
+ * size_t sharded_table_memory_usage(struct sharded_table *table);
+ * @endcode
+ *
+ * The search functions return whether the key was found and, if so and @c
+ * entry_ret is not @c NULL, copy the entry to it. The insert functions return
+ * like <tt>base_table_insert()</tt> and, on success, copy the new or existing
+ * entry to @c entry_ret if it is not @c NULL.
+ *
+ * @param[in] table Name of the sharded table type to define.
+ * @param[in] base_table Name of the hash table type used for each shard.
+ * @param[in] shard_bits log2 of the number of shards.
+ */
+#define DEFINE_SHARDED_HASH_TABLE(table, base_table, shard_bits)		\
+struct table##_shard {								\
+	pthread_rwlock_t lock;							\
+	struct base_table base;							\
+} __attribute__((aligned(64)));							\
+										\
+struct table {									\
+	struct table##_shard shards[1 << (shard_bits)];			\
+};										\
+										\
+__attribute__((unused))								\
+static void table##_init(struct table *table)					\
+{										\
+	size_t i;								\
+										\
+	for (i = 0; i < ARRAY_SIZE(table->shards); i++) {			\
+		pthread_rwlock_init(&table->shards[i].lock, NULL);		\
+		base_table##_init(&table->shards[i].base);			\
+	}									\
+}										\
+										\
+__attribute__((unused))								\
+static void table##_deinit(struct table *table)				\
+{										\
+	size_t i;								\
+										\
+	for (i = 0; i < ARRAY_SIZE(table->shards); i++) {			\
+		base_table##_deinit(&table->shards[i].base);			\
+		pthread_rwlock_destroy(&table->shards[i].lock);		\
+	}									\
+}										\
+										\
+static inline struct table##_shard *table##_shard(struct table *table,		\
+						  struct hash_pair hp)		\
+{										\
+	return &table->shards[hash_pair_to_shard(hp, shard_bits)];		\
+}										\
+										\
+static bool table##_search_hashed(struct table *table,				\
+				  const base_table##_key_type *key,		\
+				  struct hash_pair hp,				\
+				  base_table##_entry_type *entry_ret)		\
+{										\
+	struct table##_shard *shard = table##_shard(table, hp);			\
+	struct base_table##_iterator it;					\
+										\
+	pthread_rwlock_rdlock(&shard->lock);					\
+	it = base_table##_search_hashed(&shard->base, key, hp);		\
+	if (it.entry && entry_ret)						\
+		*entry_ret = *it.entry;						\
+	pthread_rwlock_unlock(&shard->lock);					\
+	return it.entry != NULL;						\
+}										\
+										\
+__attribute__((unused))								\
+static bool table##_search(struct table *table,				\
+			   const base_table##_key_type *key,			\
+			   base_table##_entry_type *entry_ret)			\
+{										\
+	return table##_search_hashed(table, key, base_table##_hash(key),	\
+				     entry_ret);				\
+}										\
+										\
+static int table##_insert_hashed(struct table *table,				\
+				 const base_table##_entry_type *entry,		\
+				 struct hash_pair hp,				\
+				 base_table##_entry_type *entry_ret)		\
+{										\
+	struct table##_shard *shard = table##_shard(table, hp);			\
+	struct base_table##_iterator it;					\
+	int ret;								\
+										\
+	pthread_rwlock_wrlock(&shard->lock);					\
+	ret = base_table##_insert_hashed(&shard->base, entry, hp, &it);	\
+	if (ret != -1 && entry_ret)						\
+		*entry_ret = *it.entry;						\
+	pthread_rwlock_unlock(&shard->lock);					\
+	return ret;								\
+}										\
+										\
+__attribute__((unused))								\
+static int table##_insert(struct table *table,					\
+			  const base_table##_entry_type *entry,		\
+			  base_table##_entry_type *entry_ret)			\
+{										\
+	base_table##_key_type key = base_table##_entry_to_key(entry);		\
+										\
+	return table##_insert_hashed(table, entry, base_table##_hash(&key),	\
+				     entry_ret);				\
+}										\
+										\
+__attribute__((unused))								\
+static bool table##_delete(struct table *table,				\
+			   const base_table##_key_type *key)			\
+{										\
+	struct hash_pair hp = base_table##_hash(key);				\
+	struct table##_shard *shard = table##_shard(table, hp);			\
+	bool ret;								\
+										\
+	pthread_rwlock_wrlock(&shard->lock);					\
+	ret = base_table##_delete_hashed(&shard->base, key, hp);		\
+	pthread_rwlock_unlock(&shard->lock);					\
+	return ret;								\
+}										\
+										\
+__attribute__((unused))								\
+static size_t table##_size(struct table *table)				\
+{										\
+	size_t i, size = 0;							\
+										\
+	for (i = 0; i < ARRAY_SIZE(table->shards); i++) {			\
+		pthread_rwlock_rdlock(&table->shards[i].lock);			\
+		size += base_table##_size(&table->shards[i].base);		\
+		pthread_rwlock_unlock(&table->shards[i].lock);			\
+	}									\
+	return size;								\
+}										\
+										\
+__attribute__((unused))								\
+static size_t table##_memory_usage(struct table *table)			\
+{										\
+	size_t i, size = 0;							\
+										\
+	for (i = 0; i < ARRAY_SIZE(table->shards); i++) {			\
+		pthread_rwlock_rdlock(&table->shards[i].lock);			\
+		size += base_table##_memory_usage(&table->shards[i].base);	\
+		pthread_rwlock_unlock(&table->shards[i].lock);			\
+	}									\
+	return size;								\
+}
+
 /**
  * Empty hash table initializer.
  *
@@ -1374,13 +1590,30 @@ static inline size_t hash_combine(size_t a, size_t b)
 #endif
 }
 
+/**
+ * Hash an arbitrary sequence of bytes.
+ *
+ * This uses wyhash where 128-bit multiplication is available and falls back to
+ * CityHash otherwise. The result is avalanching. It is only suitable for
+ * in-memory hash tables: the algorithm may change, so the values must not be
+ * persisted.
+ */
+static inline size_t hash_bytes(const void *data, size_t len)
+{
+#if defined(__SIZEOF_INT128__) && SIZE_MAX == 0xffffffffffffffff
+	return wyhash64(data, len, 0);
+#else
+	return cityhash_size_t(data, len);
+#endif
+}
+
 #ifdef DOXYGEN
 /** Hash a null-terminated string. */
 struct hash_pair c_string_hash(const char * const *key);
 #else
 #define c_string_hash(key) ({					\
 	const char *_key = *(key);				\
-	size_t _hash = cityhash_size_t(_key, strlen(_key));	\
+	size_t _hash = hash_bytes(_key, strlen(_key));		\
 								\
 	hash_pair_from_avalanching_hash(_hash);			\
 })
@@ -1411,7 +1644,7 @@ struct string {
 /** Hash a @ref string. */
 static inline struct hash_pair string_hash(const struct string *key)
 {
-	size_t hash = cityhash_size_t(key->str, key->len);
+	size_t hash = hash_bytes(key->str, key->len);
 
 	return hash_pair_from_avalanching_hash(hash);
 }
@@ -13,10 +13,64 @@
 #ifndef DRGN_HELPERS_H
 #define DRGN_HELPERS_H
 
+#include "vector.h"
+
 struct drgn_error *linux_helper_read_vm(struct drgn_program *prog,
 					uint64_t pgtable, uint64_t virt_addr,
 					void *buf, size_t count);
 
+/** Contiguous range of a page table with the same translation. */
+struct linux_helper_vm_mapping {
+	uint64_t virt_addr;
+	uint64_t size;
+	/** Physical address of @ref virt_addr, or @c UINT64_MAX if unmapped. */
+	uint64_t phys_addr;
+};
+
+DEFINE_VECTOR_TYPE(linux_helper_vm_mapping_vector,
+		   struct linux_helper_vm_mapping)
+
+/**
+ * Translations of one page table (e.g., of one @c mm_struct) which are kept
+ * across reads.
+ *
+ * Unlike the translations cached by @ref linux_helper_read_vm(), these don't
+ * depend on the memory read cache and are never discarded, so they go stale if
+ * the page table of a running kernel changes.
+ */
+struct linux_helper_vm_translation {
+	/** Page table root. */
+	uint64_t pgtable;
+	/** Known mappings, sorted by address and not overlapping. */
+	struct linux_helper_vm_mapping_vector mappings;
+};
+
+/** Initialize a @ref linux_helper_vm_translation with no mappings. */
+void linux_helper_vm_translation_init(struct linux_helper_vm_translation *t,
+				      uint64_t pgtable);
+
+/** Deinitialize a @ref linux_helper_vm_translation. */
+void linux_helper_vm_translation_deinit(struct linux_helper_vm_translation *t);
+
+/**
+ * Translate a virtual address range in one walk of the page table and add the
+ * mappings to a @ref linux_helper_vm_translation.
+ */
+struct drgn_error *
+linux_helper_vm_translation_fill(struct drgn_program *prog,
+				 struct linux_helper_vm_translation *t,
+				 uint64_t virt_addr, uint64_t size);
+
+/**
+ * Read memory like @ref linux_helper_read_vm(), using the mappings in a @ref
+ * linux_helper_vm_translation. Ranges which aren't in it yet are filled with
+ * @ref linux_helper_vm_translation_fill().
+ */
+struct drgn_error *
+linux_helper_vm_translation_read(struct drgn_program *prog,
+				 struct linux_helper_vm_translation *t,
+				 uint64_t virt_addr, void *buf, size_t count);
+
 struct drgn_error *
 linux_helper_radix_tree_lookup(struct drgn_object *res,
 			       const struct drgn_object *root, uint64_t index);
@@ -40,4 +94,1361 @@ struct drgn_error *linux_helper_find_task(struct drgn_object *res,
 struct drgn_error *
 linux_helper_task_state_to_char(const struct drgn_object *task, char *ret);
 
+/** Iterator over the nodes of a @c list_head or @c hlist_head list. */
+struct linux_helper_list_iterator {
+	struct drgn_program *prog;
+	/* Address of the list head. Unused for hash lists. */
+	uint64_t head;
+	/* Address of the current node. */
+	uint64_t pos;
+	/* Offset of the pointer to the next node in each node. */
+	uint64_t link_offset;
+	/* Whether this is a hash list, which ends at NULL. */
+	bool hlist;
+	/* Whether pos has already been returned. */
+	bool started;
+};
+
+/**
+ * Initialize an iterator over a @c list_head list.
+ *
+ * @param[in] head <tt>struct list_head *</tt> or <tt>struct list_head</tt>
+ * reference object.
+ * @param[in] reverse Whether to follow @c prev pointers instead of @c next.
+ * @param[out] node_type_ret Type of the nodes (<tt>struct list_head *</tt>). May
+ * be @c NULL.
+ */
+struct drgn_error *
+linux_helper_list_iterator_init(struct linux_helper_list_iterator *it,
+				const struct drgn_object *head, bool reverse,
+				struct drgn_qualified_type *node_type_ret);
+
+/**
+ * Initialize an iterator over a @c hlist_head list.
+ *
+ * @param[in] head <tt>struct hlist_head *</tt> or <tt>struct hlist_head</tt>
+ * reference object.
+ * @param[out] node_type_ret Type of the nodes (<tt>struct hlist_node *</tt>).
+ * May be @c NULL.
+ */
+struct drgn_error *
+linux_helper_hlist_iterator_init(struct linux_helper_list_iterator *it,
+				 const struct drgn_object *head,
+				 struct drgn_qualified_type *node_type_ret);
+
+/**
+ * Get the address of the next node from a list iterator.
+ *
+ * The pointer to the following node is only read on the next call, so the
+ * returned node may be removed from the list before then.
+ *
+ * @return @c NULL on success, &@ref drgn_stop at the end of the list, or
+ * another error.
+ */
+struct drgn_error *
+linux_helper_list_iterator_next(struct linux_helper_list_iterator *it,
+				uint64_t *ret);
+
+/**
+ * Maximum depth of a red-black tree supported by @ref
+ * linux_helper_rbtree_iterator.
+ *
+ * A red-black tree with @c n nodes has a height of at most <tt>2 * log2(n +
+ * 1)</tt>, so this is enough for any tree that fits in a 64-bit address space.
+ */
+#define LINUX_HELPER_RBTREE_MAX_DEPTH 128
+
+/** In-order iterator over the nodes of an @c rb_root tree. */
+struct linux_helper_rbtree_iterator {
+	struct drgn_program *prog;
+	/* Offsets of the rb_left and rb_right pointers in each node. */
+	uint64_t left_offset, right_offset;
+	/* Number of nodes on the stack. */
+	unsigned int depth;
+	/*
+	 * Nodes whose left subtrees have been visited but which have not been
+	 * returned yet. The top of the stack is the next node.
+	 */
+	uint64_t stack[LINUX_HELPER_RBTREE_MAX_DEPTH];
+};
+
+/**
+ * Initialize an in-order iterator over an @c rb_root tree.
+ *
+ * @param[in] root <tt>struct rb_root *</tt> or <tt>struct rb_root</tt>
+ * reference object.
+ * @param[out] node_type_ret Type of the nodes (<tt>struct rb_node *</tt>). May
+ * be @c NULL.
+ */
+struct drgn_error *
+linux_helper_rbtree_iterator_init(struct linux_helper_rbtree_iterator *it,
+				  const struct drgn_object *root,
+				  struct drgn_qualified_type *node_type_ret);
+
+/**
+ * Get the address of the next node from a red-black tree iterator.
+ *
+ * @return @c NULL on success, &@ref drgn_stop after the last node, or another
+ * error.
+ */
+struct drgn_error *
+linux_helper_rbtree_iterator_next(struct linux_helper_rbtree_iterator *it,
+				  uint64_t *ret);
+
+/**
+ * Find an entry in a red-black tree with an integer key.
+ *
+ * The tree must be sorted in ascending order by the key member.
+ *
+ * @param[out] res Returned <tt>type *</tt> object, or @c NULL if no entry
+ * matches.
+ * @param[in] root <tt>struct rb_root *</tt> or <tt>struct rb_root</tt>
+ * reference object.
+ * @param[in] type Type of the entries.
+ * @param[in] member_designator Name of the @c rb_node member in @p type.
+ * @param[in] key_designator Name of the integer key member in @p type.
+ * @param[in] key Key to find, as a two's complement 64-bit value.
+ * @param[in] key_negative Whether @p key is negative.
+ */
+struct drgn_error *linux_helper_rb_find(struct drgn_object *res,
+					const struct drgn_object *root,
+					struct drgn_qualified_type type,
+					const char *member_designator,
+					const char *key_designator,
+					uint64_t key, bool key_negative);
+
+/**
+ * Maximum depth of a radix tree supported by @ref
+ * linux_helper_radix_tree_iterator. This is enough for 64-bit indices with
+ * the smallest node size used by the kernel (16 slots).
+ */
+#define LINUX_HELPER_RADIX_TREE_MAX_DEPTH 16
+
+/** Maximum number of slots in a radix tree node. */
+#define LINUX_HELPER_RADIX_TREE_MAX_SLOTS 64
+
+/** Node on the stack of a @ref linux_helper_radix_tree_iterator. */
+struct linux_helper_radix_tree_frame {
+	/* Address of the node. */
+	uint64_t address;
+	/* Index of the first slot in the node. */
+	uint64_t index;
+	uint64_t shift;
+	/* Next slot to visit. */
+	uint64_t slot;
+	/* Number of non-empty slots that have not been visited. */
+	uint64_t remaining;
+	uint64_t slots[LINUX_HELPER_RADIX_TREE_MAX_SLOTS];
+};
+
+/** Iterator over the entries of a radix tree or XArray. */
+struct linux_helper_radix_tree_iterator {
+	struct drgn_program *prog;
+	/* Tag of internal node pointers: 1 for radix trees, 2 for XArrays. */
+	uint64_t internal_node;
+	/* Root entry if it is not a node, returned at index 0. */
+	uint64_t root_entry;
+	/* Offsets and sizes of the node members that we read. */
+	uint64_t shift_offset, count_offset, slots_offset;
+	uint64_t shift_size, count_size;
+	/* Number of slots per node. */
+	uint64_t map_size;
+	/* Number of bytes that we read from each node. */
+	size_t node_size;
+	/* Buffer of node_size bytes. */
+	char *buf;
+	/* Number of nodes on the stack. */
+	unsigned int depth;
+	struct linux_helper_radix_tree_frame stack[LINUX_HELPER_RADIX_TREE_MAX_DEPTH];
+};
+
+/**
+ * Initialize an iterator over a radix tree or XArray.
+ *
+ * Each node is read with a single memory read, and the iterator stops
+ * scanning a node once it has visited as many non-empty slots as the node's
+ * count.
+ *
+ * @param[in] root <tt>struct radix_tree_root *</tt> or <tt>struct xarray
+ * *</tt> object, or a reference to one.
+ */
+struct drgn_error *
+linux_helper_radix_tree_iterator_init(struct linux_helper_radix_tree_iterator *it,
+				      const struct drgn_object *root);
+
+/**
+ * Initialize a radix tree iterator over an IDR.
+ *
+ * @param[in] idr <tt>struct idr *</tt> object, or a reference to one.
+ * @param[out] base_ret Base to be added to the returned indices to get IDs.
+ */
+struct drgn_error *
+linux_helper_idr_iterator_init(struct linux_helper_radix_tree_iterator *it,
+			       const struct drgn_object *idr,
+			       uint64_t *base_ret);
+
+/**
+ * Deinitialize an iterator initialized with @ref
+ * linux_helper_radix_tree_iterator_init() or @ref
+ * linux_helper_idr_iterator_init(). This may also be called if initialization
+ * failed.
+ */
+void
+linux_helper_radix_tree_iterator_deinit(struct linux_helper_radix_tree_iterator *it);
+
+/**
+ * Get the next entry from a radix tree iterator.
+ *
+ * Empty slots, sibling entries, and retry entries are skipped.
+ *
+ * @param[out] index_ret Returned index.
+ * @param[out] entry_ret Returned entry.
+ * @return @c NULL on success, &@ref drgn_stop after the last entry, or another
+ * error.
+ */
+struct drgn_error *
+linux_helper_radix_tree_iterator_next(struct linux_helper_radix_tree_iterator *it,
+				      uint64_t *index_ret, uint64_t *entry_ret);
+
+/**
+ * Get up to @p capacity entries from a radix tree iterator at once.
+ *
+ * @param[out] indices Array of at least @p capacity returned indices.
+ * @param[out] entries Array of at least @p capacity returned entries.
+ * @param[out] count_ret Number of returned entries.
+ * @return @c NULL on success, &@ref drgn_stop if there were no more entries,
+ * or another error.
+ */
+struct drgn_error *
+linux_helper_radix_tree_iterator_next_batch(struct linux_helper_radix_tree_iterator *it,
+					    uint64_t *indices,
+					    uint64_t *entries, size_t capacity,
+					    size_t *count_ret);
+
+/** Iterator over the PIDs or tasks in a PID namespace. */
+struct linux_helper_pid_iterator {
+	struct drgn_program *prog;
+	/* Whether to return tasks instead of PIDs. */
+	bool tasks;
+	/* Whether the namespace has an IDR (Linux v4.15+). */
+	bool use_idr;
+	/* IDR iterator if use_idr. */
+	struct linux_helper_radix_tree_iterator idr_it;
+	/* Otherwise, the state of the pid_hash walk. */
+	uint64_t ns_address;
+	uint64_t pid_hash, pidhash_size, hlist_head_size, bucket, node;
+	uint64_t hlist_next_offset, upid_ns_offset, pid_chain_offset;
+	/* Offset of numbers[ns->level] in struct pid. */
+	uint64_t numbers_offset;
+	/* Offset of tasks[PIDTYPE_PID].first in struct pid. */
+	uint64_t pid_tasks_offset;
+	/* Offset of the PIDTYPE_PID link in struct task_struct. */
+	uint64_t task_link_offset;
+};
+
+/**
+ * Cache every PID in a PID namespace with one walk.
+ *
+ * Afterwards, @ref linux_helper_find_pid() and @ref linux_helper_find_task()
+ * for the namespace are answered from the cache instead of the PID hash or
+ * IDR. The cache is discarded by @ref drgn_program_invalidate_memory_cache(),
+ * so for a live kernel, it should be rebuilt after that. Calling this again
+ * rebuilds the cache for the namespace.
+ *
+ * @param[in] ns <tt>struct pid_namespace *</tt> object.
+ */
+struct drgn_error *linux_helper_cache_pids(const struct drgn_object *ns);
+
+/**
+ * Initialize an iterator over the PIDs in a PID namespace.
+ *
+ * @param[in] ns <tt>struct pid_namespace *</tt> object.
+ * @param[in] tasks If @c true, return the task of each PID that has one (see
+ * @ref linux_helper_pid_task()) instead of the PID.
+ */
+struct drgn_error *
+linux_helper_pid_iterator_init(struct linux_helper_pid_iterator *it,
+			       const struct drgn_object *ns, bool tasks);
+
+/**
+ * Deinitialize an iterator initialized with @ref
+ * linux_helper_pid_iterator_init(). This may also be called if initialization
+ * failed.
+ */
+void linux_helper_pid_iterator_deinit(struct linux_helper_pid_iterator *it);
+
+/**
+ * Get the address of the next <tt>struct pid</tt> or <tt>struct
+ * task_struct</tt> from a PID iterator.
+ *
+ * @return @c NULL on success, &@ref drgn_stop after the last one, or another
+ * error.
+ */
+struct drgn_error *
+linux_helper_pid_iterator_next(struct linux_helper_pid_iterator *it,
+			       uint64_t *ret);
+
+/**
+ * Number of pages whose <tt>struct page</tt>s @ref linux_helper_page_iterator
+ * reads at once. This is the size of a memory hotplug subsection, the
+ * smallest unit in which the kernel populates the memory map.
+ */
+#define LINUX_HELPER_PAGE_CHUNK 512
+
+/** Iterator over the page frame numbers of the pages in the system. */
+struct linux_helper_page_iterator {
+	struct drgn_program *prog;
+	/* Address of the struct page array. */
+	uint64_t vmemmap;
+	/* sizeof(struct page). */
+	uint64_t page_size;
+	/* Offset and size of page->flags. */
+	uint64_t flags_offset, flags_size;
+	/* Only return pages with (page->flags & flags_mask) == flags_value. */
+	uint64_t flags_mask, flags_value;
+	/* Next PFN to return and the maximum PFN. */
+	uint64_t pfn, max_pfn;
+	/*
+	 * Sparse memory model section information, used to skip sections with
+	 * no memory map. If mem_section is 0, the memory map is assumed to be
+	 * contiguous.
+	 */
+	uint64_t mem_section;
+	bool sections_extreme;
+	uint64_t section_size, section_mem_map_offset;
+	uint64_t sections_per_root, nr_section_roots;
+	/* PFNs currently in buf are [buf_pfn, buf_pfn + buf_count). */
+	uint64_t buf_pfn, buf_count;
+	/* Buffer of LINUX_HELPER_PAGE_CHUNK struct pages. */
+	char *buf;
+};
+
+/**
+ * Initialize an iterator over all of the pages in the system whose flags
+ * match, i.e., <tt>(page->flags & @p flags_mask) == @p flags_value</tt>.
+ * If @p flags_mask is 0, all pages are returned.
+ */
+struct drgn_error *
+linux_helper_page_iterator_init(struct linux_helper_page_iterator *it,
+				struct drgn_program *prog, uint64_t flags_mask,
+				uint64_t flags_value);
+
+/**
+ * Deinitialize an iterator initialized with @ref
+ * linux_helper_page_iterator_init(). This may also be called if
+ * initialization failed.
+ */
+void linux_helper_page_iterator_deinit(struct linux_helper_page_iterator *it);
+
+/**
+ * Get the page frame number of the next matching page.
+ *
+ * The memory map is read in chunks of @ref LINUX_HELPER_PAGE_CHUNK pages.
+ * Sections without a memory map and chunks which cannot be read are skipped.
+ *
+ * @return @c NULL on success, &@ref drgn_stop after the last page, or another
+ * error.
+ */
+struct drgn_error *
+linux_helper_page_iterator_next(struct linux_helper_page_iterator *it,
+				uint64_t *pfn_ret);
+
+/**
+ * Get the per-CPU offsets of the kernel (@c __per_cpu_offset).
+ *
+ * The offsets are read once and cached in the program.
+ *
+ * @param[out] offsets_ret Returned offsets, indexed by CPU. This is owned by
+ * the program.
+ * @param[out] num_ret Returned number of offsets (@c NR_CPUS).
+ */
+struct drgn_error *linux_helper_per_cpu_offsets(struct drgn_program *prog,
+						const uint64_t **offsets_ret,
+						size_t *num_ret);
+
+/**
+ * Get the CPUs in a CPU mask.
+ *
+ * @param[in] prog Program.
+ * @param[in] mask <tt>struct cpumask</tt> reference or <tt>struct cpumask
+ * *</tt> object, or @c NULL for the online CPU mask.
+ * @param[out] cpus_ret Returned array of CPUs in ascending order. It must be
+ * freed with @c free().
+ * @param[out] num_ret Returned number of CPUs.
+ */
+struct drgn_error *linux_helper_cpumask_cpus(struct drgn_program *prog,
+					     const struct drgn_object *mask,
+					     uint64_t **cpus_ret,
+					     size_t *num_ret);
+
+/**
+ * Get the address of a per-CPU variable for a given CPU.
+ *
+ * @param[in] ptr <tt>type __percpu *</tt> object.
+ */
+struct drgn_error *linux_helper_per_cpu_ptr(const struct drgn_object *ptr,
+					    uint64_t cpu, uint64_t *ret);
+
+/**
+ * Sum a per-CPU integer over the CPUs in a CPU mask.
+ *
+ * @param[in] ptr <tt>type __percpu *</tt> object, where @c type is an integer
+ * type.
+ * @param[in] mask See @ref linux_helper_cpumask_cpus().
+ * @param[out] ret Returned sum, truncated to 64 bits.
+ * @param[out] is_signed_ret Whether @c type is signed, in which case @p ret
+ * should be interpreted as an @c int64_t.
+ */
+struct drgn_error *linux_helper_per_cpu_sum(const struct drgn_object *ptr,
+					    const struct drgn_object *mask,
+					    uint64_t *ret, bool *is_signed_ret);
+
+/**
+ * Maximum number of objects in a SLUB slab (@c MAX_OBJS_PER_PAGE in the
+ * kernel).
+ */
+#define LINUX_HELPER_SLAB_MAX_OBJECTS 32767
+
+/** Iterator over the allocated objects in a SLUB slab cache. */
+struct linux_helper_slab_object_iterator {
+	/* Iterator over slab pages. */
+	struct linux_helper_page_iterator pages;
+	/* Address of the struct kmem_cache. */
+	uint64_t slab_cache;
+	/* kmem_cache->size, kmem_cache->offset, and kmem_cache->red_left_pad. */
+	uint64_t size, freeptr_offset, red_left_pad;
+	/* kmem_cache->random if CONFIG_SLAB_FREELIST_HARDENED is enabled. */
+	bool freelist_hardened;
+	uint64_t freelist_random;
+	/* PAGE_OFFSET. */
+	uint64_t page_offset;
+	/* Offsets of slab members in struct page (or struct slab). */
+	uint64_t slab_cache_offset, freelist_offset;
+	uint64_t objects_bit_offset, objects_bit_size;
+	/*
+	 * Per-CPU slabs (struct page *) and their per-CPU freelists, or NULL if
+	 * per-CPU freelists are not being handled.
+	 */
+	uint64_t *cpu_slabs, *cpu_freelists;
+	size_t num_cpu_slabs;
+	/* Current slab. */
+	uint64_t slab_address, slab_objects, slab_index;
+	/* Contents of the current slab. */
+	char *slab_buf;
+	size_t slab_buf_size;
+	/* Whether each object in the current slab is free. */
+	bool *slab_free;
+};
+
+/**
+ * Initialize an iterator over the allocated objects in a slab cache.
+ *
+ * Only SLUB is supported. All of the slab pages in the system are found via
+ * the memory map. Each slab is read once, and its free objects are determined
+ * by walking its freelist in the read copy.
+ *
+ * @param[in] slab_cache <tt>struct kmem_cache *</tt> object.
+ * @param[in] cpu_freelists Whether to also treat objects on the per-CPU
+ * freelists as free. These are only valid for a stopped kernel.
+ */
+struct drgn_error *
+linux_helper_slab_object_iterator_init(struct linux_helper_slab_object_iterator *it,
+				       const struct drgn_object *slab_cache,
+				       bool cpu_freelists);
+
+/**
+ * Deinitialize an iterator initialized with @ref
+ * linux_helper_slab_object_iterator_init(). This may also be called if
+ * initialization failed.
+ */
+void
+linux_helper_slab_object_iterator_deinit(struct linux_helper_slab_object_iterator *it);
+
+/**
+ * Get the address of the next allocated object from a @ref
+ * linux_helper_slab_object_iterator.
+ *
+ * @return @c NULL on success, @ref drgn_stop if there are no more objects,
+ * non-@c NULL on error.
+ */
+struct drgn_error *
+linux_helper_slab_object_iterator_next(struct linux_helper_slab_object_iterator *it,
+				       uint64_t *ret);
+
+/**
+ * Get the full path of a dentry given its mount, like the kernel's @c
+ * d_path().
+ *
+ * While the memory read cache is enabled, the path of every dentry walked is
+ * cached in the program, so paths that share a directory prefix only walk the
+ * prefix once.
+ *
+ * @param[in] path_or_vfsmnt <tt>struct path</tt> reference, <tt>struct path
+ * *</tt> object, or <tt>struct vfsmount *</tt> object.
+ * @param[in] dentry <tt>struct dentry *</tt> object if @p path_or_vfsmnt is a
+ * <tt>struct vfsmount *</tt>, @c NULL otherwise.
+ * @param[out] ret Returned path. It is not null-terminated and must be freed
+ * with @c free(). It is set to @c NULL if the dentry's name is generated by a
+ * @c d_dname() operation.
+ * @param[out] len_ret Returned length of the path.
+ */
+struct drgn_error *linux_helper_d_path(const struct drgn_object *path_or_vfsmnt,
+				       const struct drgn_object *dentry,
+				       char **ret, size_t *len_ret);
+
+/**
+ * Get the path of a dentry from the root of its filesystem, like the kernel's
+ * @c dentry_path(), but without a leading slash.
+ *
+ * This uses the same cache as @ref linux_helper_d_path().
+ *
+ * @param[in] dentry <tt>struct dentry *</tt> object.
+ * @param[out] ret Returned path. It is not null-terminated and must be freed
+ * with @c free().
+ * @param[out] len_ret Returned length of the path.
+ */
+struct drgn_error *linux_helper_dentry_path(const struct drgn_object *dentry,
+					    char **ret, size_t *len_ret);
+
+/** Fields of a task that can be read by @ref linux_helper_task_snapshot(). */
+enum linux_helper_task_field {
+	/** Address of the <tt>struct task_struct</tt>. */
+	LINUX_HELPER_TASK_ADDRESS,
+	/** @c task->pid. */
+	LINUX_HELPER_TASK_PID,
+	/** @c task->tgid. */
+	LINUX_HELPER_TASK_TGID,
+	/** @c task->comm. */
+	LINUX_HELPER_TASK_COMM,
+	/** State character; see @ref linux_helper_task_state_to_char(). */
+	LINUX_HELPER_TASK_STATE,
+	/** @c task->utime. */
+	LINUX_HELPER_TASK_UTIME,
+	/** @c task->stime. */
+	LINUX_HELPER_TASK_STIME,
+	/** Resident set size of @c task->mm in pages, or 0 if it has no mm. */
+	LINUX_HELPER_TASK_RSS,
+	/** Number of task fields. */
+	LINUX_HELPER_NUM_TASK_FIELDS,
+};
+
+/** Columnar snapshot of fields of every task. */
+struct linux_helper_task_snapshot {
+	/** Number of tasks. */
+	size_t num_tasks;
+	/**
+	 * Values of each field by task, or @c NULL if the field wasn't
+	 * requested. @ref LINUX_HELPER_TASK_COMM is stored in @ref comms
+	 * instead.
+	 */
+	uint64_t *values[LINUX_HELPER_NUM_TASK_FIELDS];
+	/**
+	 * @c task->comm for each task, @ref comm_len bytes each. These are not
+	 * necessarily null-terminated.
+	 */
+	char *comms;
+	/** Size of @c task->comm. */
+	size_t comm_len;
+};
+
+/**
+ * Take a snapshot of fields of every task in a PID namespace.
+ *
+ * The tasks are found as with @ref linux_helper_pid_iterator_init(). Then,
+ * nearby fields are coalesced, and the task structures are read in batches.
+ *
+ * @param[out] ret Returned snapshot. On success, it must be deinitialized with
+ * @ref linux_helper_task_snapshot_deinit().
+ * @param[in] ns <tt>struct pid_namespace *</tt> object.
+ * @param[in] fields Bit mask of fields to read, where field @c n is <tt>1 <<
+ * n</tt> for @c n in @ref linux_helper_task_field.
+ */
+struct drgn_error *
+linux_helper_task_snapshot(struct linux_helper_task_snapshot *ret,
+			   const struct drgn_object *ns, uint64_t fields);
+
+/** Free the values in a @ref linux_helper_task_snapshot. */
+void
+linux_helper_task_snapshot_deinit(struct linux_helper_task_snapshot *snapshot);
+
+/** Resident set size of a task found by @ref linux_helper_task_rss(). */
+struct linux_helper_task_rss {
+	/** Address of the <tt>struct task_struct</tt>. */
+	uint64_t task;
+	/** @c task->mm, or 0 for kernel threads. */
+	uint64_t mm;
+	/** Resident file pages (@c MM_FILEPAGES). */
+	uint64_t file;
+	/** Resident anonymous pages (@c MM_ANONPAGES). */
+	uint64_t anon;
+	/**
+	 * Resident shared memory pages (@c MM_SHMEMPAGES), or 0 before Linux
+	 * 4.5.
+	 */
+	uint64_t shmem;
+};
+
+/**
+ * Get the exact resident set size of every task in a PID namespace.
+ *
+ * Unlike @ref LINUX_HELPER_TASK_RSS, which is the approximate value reported
+ * by @c get_mm_rss(), this includes the deltas that the kernel hasn't folded
+ * into the counters of the mm yet: the per-CPU counts of each <tt>struct
+ * percpu_counter</tt> in @c mm->rss_stat since Linux 6.2, and the counts cached
+ * by each thread in @c task->rss_stat before that. Each distinct mm is read
+ * once, and the per-CPU counts of every mm are read in large batches.
+ *
+ * @param[in] ns <tt>struct pid_namespace *</tt> object.
+ * @param[out] ret Returned tasks, in the order of @ref
+ * linux_helper_pid_iterator_init(). It must be freed with @c free().
+ * @param[out] num_ret Returned number of tasks.
+ */
+struct drgn_error *linux_helper_task_rss(const struct drgn_object *ns,
+					 struct linux_helper_task_rss **ret,
+					 size_t *num_ret);
+
+/** Inclusive range of IDs matched by a @ref linux_helper_task_filter. */
+struct linux_helper_task_id_range {
+	uint64_t first, last;
+};
+
+/**
+ * Conditions on tasks for @ref linux_helper_filter_tasks(). A task matches if
+ * it matches every condition which is set.
+ */
+struct linux_helper_task_filter {
+	/**
+	 * State characters to match (see @ref
+	 * linux_helper_task_state_to_char()), e.g., <tt>"D"</tt>, or @c NULL
+	 * to match any state.
+	 */
+	const char *states;
+	/**
+	 * @c fnmatch() pattern to match against @c task->comm, or @c NULL to
+	 * match any command name.
+	 */
+	const char *comm;
+	/** Ranges of @c task->pid to match, if @ref num_pids is non-zero. */
+	const struct linux_helper_task_id_range *pids;
+	size_t num_pids;
+	/** Ranges of @c task->tgid to match, if @ref num_tgids is non-zero. */
+	const struct linux_helper_task_id_range *tgids;
+	size_t num_tgids;
+};
+
+/**
+ * Find the tasks in a PID namespace which match a filter.
+ *
+ * The tasks are read like @ref linux_helper_task_snapshot(), reading only the
+ * fields needed by the filter, and the filter is evaluated without creating
+ * objects, so this is much faster than filtering every task separately.
+ *
+ * @param[in] ns <tt>struct pid_namespace *</tt> object.
+ * @param[out] tasks_ret Returned addresses of the matching <tt>struct
+ * task_struct</tt>s. It must be freed with @c free().
+ * @param[out] num_ret Returned number of matching tasks.
+ */
+struct drgn_error *
+linux_helper_filter_tasks(const struct drgn_object *ns,
+			  const struct linux_helper_task_filter *filter,
+			  uint64_t **tasks_ret, size_t *num_ret);
+
+/**
+ * Size of a task's memory which could not be read by @ref
+ * linux_helper_task_args().
+ */
+#define LINUX_HELPER_TASK_ARGS_UNAVAILABLE SIZE_MAX
+
+/** Memory of one task read by @ref linux_helper_task_args(). */
+struct linux_helper_task_args_entry {
+	/** Address of the <tt>struct task_struct</tt>. */
+	uint64_t task;
+	/** Offset of the command line in @ref linux_helper_task_args::data. */
+	size_t cmdline_offset;
+	/**
+	 * Size of the command line, or @ref LINUX_HELPER_TASK_ARGS_UNAVAILABLE
+	 * if it wasn't requested, the task has no mm, or it isn't in memory.
+	 */
+	size_t cmdline_size;
+	/** Offset of the environment in @ref linux_helper_task_args::data. */
+	size_t environ_offset;
+	/** Size of the environment, like @ref cmdline_size. */
+	size_t environ_size;
+};
+
+/** Command lines and environments of many tasks. */
+struct linux_helper_task_args {
+	/** Entry for each task. */
+	struct linux_helper_task_args_entry *entries;
+	/** Number of entries. */
+	size_t num_entries;
+	/**
+	 * Raw memory of every command line and environment. Tasks sharing an
+	 * mm (i.e., threads of the same process) share the data.
+	 */
+	char *data;
+};
+
+/**
+ * Read the command lines and/or environments of many tasks.
+ *
+ * This is like calling @c cmdline() and @c environ() on each task, but the mm
+ * of each task is read in batches, each mm is only read once, and each mm's
+ * page table is only walked once for both ranges (see @ref
+ * linux_helper_vm_translation). Tasks whose memory can't be read are marked
+ * unavailable rather than failing the whole call.
+ *
+ * @param[out] ret Returned entries. On success, it must be deinitialized with
+ * @ref linux_helper_task_args_deinit().
+ * @param[in] ns <tt>struct pid_namespace *</tt> object. If @p tasks is @c NULL,
+ * every task in it is read as with @ref linux_helper_pid_iterator_init().
+ * @param[in] tasks Addresses of the <tt>struct task_struct</tt>s to read, or
+ * @c NULL.
+ * @param[in] num_tasks Number of tasks in @p tasks.
+ * @param[in] read_cmdline Whether to read the command lines.
+ * @param[in] read_environ Whether to read the environments.
+ */
+struct drgn_error *linux_helper_task_args(struct linux_helper_task_args *ret,
+					  const struct drgn_object *ns,
+					  const uint64_t *tasks,
+					  size_t num_tasks, bool read_cmdline,
+					  bool read_environ);
+
+/** Free the entries and data in a @ref linux_helper_task_args. */
+void linux_helper_task_args_deinit(struct linux_helper_task_args *args);
+
+/** Event read by @ref linux_helper_ftrace_events(). */
+struct linux_helper_ftrace_event {
+	/** Timestamp of the event in ring buffer clock units. */
+	uint64_t timestamp;
+	/** CPU whose buffer the event was recorded in. */
+	uint64_t cpu;
+	/** Offset of the payload in @ref linux_helper_ftrace_events::data. */
+	size_t offset;
+	/** Size of the event payload. */
+	size_t size;
+};
+
+/** Events of an ftrace ring buffer. */
+struct linux_helper_ftrace_events {
+	/** Events sorted by timestamp, then by CPU, then by recording order. */
+	struct linux_helper_ftrace_event *events;
+	/** Number of events. */
+	size_t num_events;
+	/** Raw buffer pages that the events were decoded from. */
+	char *data;
+	/** Number of buffer pages which could not be read. */
+	size_t lost_pages;
+};
+
+/**
+ * Read the events in an ftrace ring buffer.
+ *
+ * The buffer pages of every CPU are read in one batch and the ring buffer event
+ * headers are decoded natively, so this is suitable for buffers of hundreds of
+ * megabytes. Each event is returned with its absolute timestamp and its raw
+ * payload, which starts with the trace entry header (i.e., the event type).
+ * Events already consumed by a reader of @c trace_pipe are skipped. Pages which
+ * can't be read (e.g., because they were filtered out of a core dump) are
+ * skipped and counted.
+ *
+ * @param[out] ret Returned events. On success, it must be deinitialized with
+ * @ref linux_helper_ftrace_events_deinit().
+ * @param[in] buffer <tt>struct trace_buffer *</tt> (or <tt>struct
+ * ring_buffer *</tt> before Linux 5.6) object, or @c NULL for the buffer of the
+ * top-level tracing instance.
+ */
+struct drgn_error *
+linux_helper_ftrace_events(struct linux_helper_ftrace_events *ret,
+			   struct drgn_program *prog,
+			   const struct drgn_object *buffer);
+
+/** Free the events and data in a @ref linux_helper_ftrace_events. */
+void
+linux_helper_ftrace_events_deinit(struct linux_helper_ftrace_events *events);
+
+/** Socket hash table walked by @ref linux_helper_sock_table(). */
+enum linux_helper_sock_table_kind {
+	/** @c tcp_hashinfo: established, time-wait, and listening sockets. */
+	LINUX_HELPER_SOCK_TABLE_TCP,
+	/** @c udp_table. */
+	LINUX_HELPER_SOCK_TABLE_UDP,
+};
+
+/** Socket found by @ref linux_helper_sock_table(). */
+struct linux_helper_sock {
+	/** Address of the <tt>struct sock</tt>. */
+	uint64_t sock;
+	/**
+	 * Address of the <tt>struct cgroup</tt> of the socket, or 0 if it is
+	 * not known (e.g., for time-wait and request sockets).
+	 */
+	uint64_t cgroup;
+	/**
+	 * Local and remote addresses in network byte order. Only the first
+	 * @ref linux_helper_sock::addr_len bytes are used.
+	 */
+	uint8_t saddr[16], daddr[16];
+	/** 4 for @c AF_INET, 16 for @c AF_INET6, 0 otherwise. */
+	uint8_t addr_len;
+	/** Local and remote ports in host byte order. */
+	uint16_t sport, dport;
+	/** Address family (e.g., @c AF_INET). */
+	uint16_t family;
+	/** @c skc_state (e.g., @c TCP_ESTABLISHED). */
+	uint8_t state;
+};
+
+/**
+ * Find every socket in a protocol's socket hash tables.
+ *
+ * The bucket arrays are read in large chunks rather than bucket by bucket, and
+ * each socket is read with a single read of its <tt>struct sock_common</tt>,
+ * which contains both the link to the next socket in the bucket and the
+ * connection information.
+ *
+ * @param[in] kind Table to walk.
+ * @param[in] read_info Whether to fill in everything in @ref
+ * linux_helper_sock other than @ref linux_helper_sock::sock.
+ * @param[out] socks_ret Returned sockets. It must be freed with @c free().
+ * @param[out] num_ret Returned number of sockets.
+ */
+struct drgn_error *
+linux_helper_sock_table(struct drgn_program *prog,
+			enum linux_helper_sock_table_kind kind, bool read_info,
+			struct linux_helper_sock **socks_ret, size_t *num_ret);
+
+/** Inode found by @ref linux_helper_sb_inodes(). */
+struct linux_helper_sb_inode {
+	/** Address of the <tt>struct inode</tt>. */
+	uint64_t inode;
+	/** @c i_ino. */
+	uint64_t ino;
+	/** @c i_mapping->nrpages, i.e., the number of pages in the page cache. */
+	uint64_t nrpages;
+	/**
+	 * Number of page (or folio) entries found by walking the page cache,
+	 * if it was requested.
+	 */
+	uint64_t page_entries;
+	/**
+	 * Number of value entries (e.g., shadow entries of evicted pages)
+	 * found by walking the page cache, if it was requested.
+	 */
+	uint64_t value_entries;
+};
+
+/**
+ * Find every inode of a superblock (i.e., the @c s_inodes list).
+ *
+ * Each inode is read with a single read of the part of the <tt>struct
+ * inode</tt> containing the list link, inode number, and (usually embedded)
+ * address space, so this is suitable for superblocks with millions of inodes.
+ *
+ * @param[in] sb <tt>struct super_block *</tt> object.
+ * @param[in] walk_page_cache Whether to also walk the page cache XArray (or
+ * radix tree) of each inode with pages and count its entries.
+ * @param[out] inodes_ret Returned inodes. It must be freed with @c free().
+ * @param[out] num_ret Returned number of inodes.
+ */
+struct drgn_error *
+linux_helper_sb_inodes(const struct drgn_object *sb, bool walk_page_cache,
+		       struct linux_helper_sb_inode **inodes_ret,
+		       size_t *num_ret);
+
+/** Maximum number of fields that @ref linux_helper_cgroup_walk() can read. */
+#define LINUX_HELPER_CGROUP_WALK_MAX_FIELDS 32
+
+/** Cgroup found by @ref linux_helper_cgroup_walk(). */
+struct linux_helper_cgroup_walk_entry {
+	/**
+	 * Address of the structure containing the <tt>struct
+	 * cgroup_subsys_state</tt> (e.g., <tt>struct cgroup</tt>).
+	 */
+	uint64_t address;
+	/** @c css->cgroup. */
+	uint64_t cgroup;
+	/** @c css->flags (e.g., @c CSS_ONLINE). */
+	uint64_t flags;
+	/** Depth below the root of the walk, which has a depth of 0. */
+	size_t depth;
+	/**
+	 * Offset of the null-terminated name of the cgroup in @ref
+	 * linux_helper_cgroup_walk::names.
+	 */
+	size_t name_offset;
+	/** Length of the name, not including the null terminator. */
+	size_t name_len;
+};
+
+/** Cgroup hierarchy returned by @ref linux_helper_cgroup_walk(). */
+struct linux_helper_cgroup_walk {
+	/** Cgroups in pre-order, starting with the root of the walk. */
+	struct linux_helper_cgroup_walk_entry *entries;
+	size_t num_entries;
+	/** Number of fields read for each cgroup. */
+	size_t num_fields;
+	/**
+	 * Values of the fields, @ref linux_helper_cgroup_walk::num_fields for
+	 * each cgroup. Values of signed fields are sign-extended.
+	 */
+	uint64_t *values;
+	/** Whether each field is signed. */
+	bool field_signed[LINUX_HELPER_CGROUP_WALK_MAX_FIELDS];
+	/** Names of the cgroups. */
+	char *names;
+};
+
+/**
+ * Walk a cgroup hierarchy in pre-order, like @c css_for_each_descendant_pre(),
+ * and read its names and a selection of integer fields.
+ *
+ * Each level of the hierarchy is read in batches, with a single coalesced read
+ * per cgroup covering the list links and all of the requested fields, so this
+ * is suitable for hierarchies with many thousands of cgroups. Unlike @c
+ * css_for_each_descendant_pre(), cgroups which are not online (i.e., without
+ * @c CSS_ONLINE in their flags) are also returned.
+ *
+ * @param[out] ret Returned hierarchy. It must be freed with @ref
+ * linux_helper_cgroup_walk_deinit().
+ * @param[in] css <tt>struct cgroup_subsys_state *</tt> object of the root of
+ * the walk.
+ * @param[in] container_type Name of the type containing the <tt>struct
+ * cgroup_subsys_state</tt> (e.g., <tt>"struct mem_cgroup"</tt>), or @c NULL
+ * for <tt>"struct cgroup"</tt>. The first member of this type which is a
+ * <tt>struct cgroup_subsys_state</tt> is used.
+ * @param[in] fields Member designators of integer fields of @p container_type
+ * to read (e.g., <tt>"memory.usage.counter"</tt>).
+ * @param[in] num_fields Number of fields in @p fields. At most @ref
+ * LINUX_HELPER_CGROUP_WALK_MAX_FIELDS.
+ */
+struct drgn_error *
+linux_helper_cgroup_walk(struct linux_helper_cgroup_walk *ret,
+			 const struct drgn_object *css,
+			 const char *container_type,
+			 const char * const *fields, size_t num_fields);
+
+/** Free a @ref linux_helper_cgroup_walk. */
+void linux_helper_cgroup_walk_deinit(struct linux_helper_cgroup_walk *walk);
+
+/**
+ * Get the memory usage of every memory cgroup in a hierarchy.
+ *
+ * The hierarchy is walked with @ref linux_helper_cgroup_walk(), reading the
+ * page counter of each memory cgroup (@c memory.usage.counter) as its only
+ * field. Usage also includes pages which are precharged to a memory cgroup in
+ * the per-CPU charge stocks (@c memcg_stock) but aren't in use yet, so the
+ * stocks of every online CPU are read in one batch and returned separately.
+ *
+ * @param[out] walk_ret Returned hierarchy, with the usage in pages as the
+ * value of the only field. It must be freed with @ref
+ * linux_helper_cgroup_walk_deinit().
+ * @param[out] stock_ret Returned number of pages precharged to each memory
+ * cgroup, in the same order as the entries of @p walk_ret. It must be freed
+ * with @c free().
+ * @param[in] css <tt>struct cgroup_subsys_state *</tt> object of the memory
+ * controller of the root of the walk.
+ */
+struct drgn_error *
+linux_helper_memcg_usage(struct linux_helper_cgroup_walk *walk_ret,
+			 uint64_t **stock_ret, const struct drgn_object *css);
+
+struct drgn_btf;
+
+/**
+ * Get the type information in a <tt>struct btf</tt> (e.g., the BTF of a BPF
+ * program or map).
+ *
+ * The raw BTF data is read in one read and indexed the first time, and the
+ * result is cached by the program for as long as the <tt>struct btf</tt> has
+ * the same data. Split BTF (i.e., BTF with a @c base_btf, like that of kernel
+ * modules) is not supported.
+ *
+ * @param[in] btf <tt>struct btf *</tt> object.
+ * @param[out] ret Returned BTF information. It is owned by the program.
+ */
+struct drgn_error *linux_helper_btf(const struct drgn_object *btf,
+				    struct drgn_btf **ret);
+
+/** In-flight request found by @ref linux_helper_blk_mq_inflight(). */
+struct linux_helper_blk_mq_request {
+	/** Address of the <tt>struct request</tt>. */
+	uint64_t request;
+	/**
+	 * Address of the <tt>struct gendisk</tt> of the request (@c
+	 * rq->rq_disk, or @c q->disk on kernels without it), or 0 if it is not
+	 * known.
+	 */
+	uint64_t disk;
+	/** @c rq->start_time_ns, i.e., when the request was allocated. */
+	uint64_t start_time_ns;
+	/**
+	 * @c rq->io_start_time_ns, i.e., when the request was issued to the
+	 * device, or 0 if the kernel doesn't record it.
+	 */
+	uint64_t io_start_time_ns;
+	/** First sector (@c rq->__sector). */
+	uint64_t sector;
+	/** Remaining length in bytes (@c rq->__data_len). */
+	uint32_t data_len;
+	/** @c rq->cmd_flags (the operation and flags). */
+	uint32_t cmd_flags;
+	/** Driver tag of the request (@c rq->tag). */
+	uint32_t tag;
+};
+
+/**
+ * Find the requests of a blk-mq request queue which are in flight (i.e.,
+ * which were started and haven't completed).
+ *
+ * This scans the request array of the driver tags of each hardware context
+ * like @c blk_mq_queue_tag_busy_iter(), except that the array is read in one
+ * read and the requests are read in batches with a single read each. Tags
+ * shared between hardware contexts are only scanned once.
+ *
+ * @param[in] q <tt>struct request_queue *</tt> object.
+ * @param[out] requests_ret Returned requests. It must be freed with @c
+ * free().
+ * @param[out] num_ret Returned number of requests.
+ */
+struct drgn_error *
+linux_helper_blk_mq_inflight(const struct drgn_object *q,
+			     struct linux_helper_blk_mq_request **requests_ret,
+			     size_t *num_ret);
+
+/** Kind of timer found by @ref linux_helper_pending_timers(). */
+enum linux_helper_timer_kind {
+	/** <tt>struct timer_list</tt> in a timer wheel. */
+	LINUX_HELPER_TIMER_LIST,
+	/** <tt>struct hrtimer</tt>. */
+	LINUX_HELPER_TIMER_HRTIMER,
+};
+
+/** Pending timer found by @ref linux_helper_pending_timers(). */
+struct linux_helper_timer {
+	/** Address of the <tt>struct timer_list</tt> or <tt>struct hrtimer</tt>. */
+	uint64_t timer;
+	/**
+	 * Expiry time: @c expires in jiffies for timer lists, or the hard
+	 * expiry (@c node.expires) in nanoseconds of the clock base's clock for
+	 * hrtimers.
+	 */
+	uint64_t expires;
+	/** Address of the callback function. */
+	uint64_t function;
+	/**
+	 * Address of the object waiting for the timer if the callback is a
+	 * well-known one, or 0 otherwise: the <tt>struct task_struct</tt> for
+	 * @c hrtimer_wakeup() and @c process_timeout(), or the <tt>struct
+	 * delayed_work</tt> for @c delayed_work_timer_fn().
+	 */
+	uint64_t owner;
+	/** CPU whose timer base the timer is queued on. */
+	uint32_t cpu;
+	/**
+	 * Index of the timer base (e.g., @c BASE_STD) for timer lists, or of
+	 * the clock base (e.g., @c HRTIMER_BASE_MONOTONIC) for hrtimers.
+	 */
+	uint8_t base;
+	/** @ref linux_helper_timer_kind. */
+	uint8_t kind;
+};
+
+/**
+ * Find every pending timer on every possible CPU.
+ *
+ * This scans the buckets of the per-CPU timer wheels (@c timer_bases) and the
+ * red-black trees of the per-CPU hrtimer clock bases (@c hrtimer_bases). The
+ * bucket array of each wheel is read in one read, and each timer is read with
+ * a single read which also contains the link to the next timer in its bucket.
+ *
+ * This requires Linux 4.8 or newer, which has the current timer wheel.
+ *
+ * @param[out] timers_ret Returned timers, grouped by CPU, with the timer lists
+ * of each CPU before its hrtimers, and the hrtimers of each clock base in
+ * order of expiry. It must be freed with @c free().
+ * @param[out] num_ret Returned number of timers.
+ */
+struct drgn_error *
+linux_helper_pending_timers(struct drgn_program *prog,
+			    struct linux_helper_timer **timers_ret,
+			    size_t *num_ret);
+
+/** Pages allocated from one stack, found by @ref linux_helper_page_owner_stacks(). */
+struct linux_helper_page_owner_stack {
+	/** Stack depot handle of the allocation stack, or 0 if none. */
+	uint32_t handle;
+	/** Number of allocations. */
+	uint64_t allocations;
+	/** Total number of pages in the allocations. */
+	uint64_t pages;
+	/**
+	 * Program counters of the allocation stack, innermost first, or @c NULL
+	 * if the stack isn't known.
+	 */
+	uint64_t *pcs;
+	/** Number of program counters in @ref pcs. */
+	size_t num_pcs;
+};
+
+/**
+ * Find the allocation stacks of all allocated pages recorded by @c page_owner.
+ *
+ * This walks the memory map with @ref linux_helper_page_iterator and reads the
+ * @c page_ext entries of each chunk of pages in one read from the memory
+ * section. The @c page_owner record of each allocated page is decoded
+ * natively, and the allocations are aggregated by stack depot handle (the
+ * stack depot stores each distinct stack once, so a handle identifies a
+ * stack). Each distinct handle is then resolved to its program counters.
+ *
+ * This requires @c CONFIG_PAGE_OWNER with @c page_owner=on and @c
+ * CONFIG_SPARSEMEM.
+ *
+ * @param[out] stacks_ret Returned stacks, sorted by decreasing number of pages.
+ * It must be freed with @ref linux_helper_page_owner_stacks_destroy().
+ * @param[out] num_ret Returned number of stacks.
+ */
+struct drgn_error *
+linux_helper_page_owner_stacks(struct drgn_program *prog,
+			       struct linux_helper_page_owner_stack **stacks_ret,
+			       size_t *num_ret);
+
+/**
+ * Free stacks returned by @ref linux_helper_page_owner_stacks() along with
+ * their program counters.
+ */
+void
+linux_helper_page_owner_stacks_destroy(struct linux_helper_page_owner_stack *stacks,
+				       size_t num);
+
+/** Runqueue of one CPU found by @ref linux_helper_runqueues(). */
+struct linux_helper_runqueue {
+	/** Address of the <tt>struct rq</tt>. */
+	uint64_t rq;
+	/** Address of the running <tt>struct task_struct</tt>. */
+	uint64_t curr;
+	/** Runqueue clock (@c clock) in nanoseconds. */
+	uint64_t clock;
+	/** Number of runnable tasks of every scheduling class. */
+	uint64_t nr_running;
+	/**
+	 * Number of runnable CFS tasks, including tasks in task groups
+	 * (@c cfs.h_nr_running).
+	 */
+	uint64_t cfs_nr_running;
+	/** Number of runnable real-time tasks (@c rt.rt_nr_running). */
+	uint64_t rt_nr_running;
+	/** Number of runnable deadline tasks (@c dl.dl_nr_running). */
+	uint64_t dl_nr_running;
+	/** Total load weight of the root CFS runqueue (@c cfs.load.weight). */
+	uint64_t cfs_load_weight;
+	/**
+	 * PELT load average of the root CFS runqueue (@c cfs.avg.load_avg), or
+	 * 0 if the kernel was built without @c CONFIG_SMP.
+	 */
+	uint64_t cfs_load_avg;
+	uint32_t cpu;
+};
+
+/** Scheduling class of a task found by @ref linux_helper_runqueues(). */
+enum linux_helper_sched_class {
+	/** @c fair_sched_class (CFS or EEVDF). */
+	LINUX_HELPER_SCHED_FAIR,
+	/** @c rt_sched_class. */
+	LINUX_HELPER_SCHED_RT,
+	/** @c dl_sched_class. */
+	LINUX_HELPER_SCHED_DL,
+	/** @c idle_sched_class. */
+	LINUX_HELPER_SCHED_IDLE,
+	/** @c stop_sched_class. */
+	LINUX_HELPER_SCHED_STOP,
+	/** Any other class (e.g., @c ext_sched_class). */
+	LINUX_HELPER_SCHED_OTHER,
+};
+
+/** Running or queued task found by @ref linux_helper_runqueues(). */
+struct linux_helper_runqueue_task {
+	/** Address of the <tt>struct task_struct</tt>. */
+	uint64_t task;
+	/**
+	 * @c se.vruntime for @ref LINUX_HELPER_SCHED_FAIR tasks, the absolute
+	 * deadline (@c dl.deadline) in nanoseconds for @ref
+	 * LINUX_HELPER_SCHED_DL tasks, and 0 otherwise.
+	 */
+	uint64_t key;
+	/** Dynamic priority (@c prio). */
+	int32_t prio;
+	/** CPU whose runqueue the task is on. */
+	uint32_t cpu;
+	/** @ref linux_helper_sched_class. */
+	uint8_t sched_class;
+	/** Whether the task is running on the CPU. */
+	bool current;
+};
+
+/**
+ * Take a snapshot of the runqueue of every online CPU.
+ *
+ * Each <tt>struct rq</tt> is read in one read. The CFS red-black trees
+ * (descending into task groups), the real-time priority queues, and the
+ * deadline red-black tree of each CPU are walked natively.
+ *
+ * @param[out] runqueues_ret Returned runqueues in order of CPU. It must be
+ * freed with @c free().
+ * @param[out] num_runqueues_ret Returned number of runqueues.
+ * @param[out] tasks_ret Returned tasks, grouped by CPU. The tasks of each CPU
+ * are the CFS tasks (for each CFS runqueue, the running entity and then the
+ * queued entities in order of virtual runtime), then the real-time tasks in
+ * order of priority, then the deadline tasks in order of deadline, then the
+ * running task if it wasn't found on a queue (e.g., the idle task). It must be
+ * freed with @c free().
+ * @param[out] num_tasks_ret Returned number of tasks.
+ */
+struct drgn_error *
+linux_helper_runqueues(struct drgn_program *prog,
+		       struct linux_helper_runqueue **runqueues_ret,
+		       size_t *num_runqueues_ret,
+		       struct linux_helper_runqueue_task **tasks_ret,
+		       size_t *num_tasks_ret);
+
+/** Busy vmalloc area found by @ref linux_helper_vmalloc_areas(). */
+struct linux_helper_vmalloc_area {
+	/** Start address (@c va_start). */
+	uint64_t address;
+	/**
+	 * Size in bytes. This is @c vm->size (which includes the guard page,
+	 * if any) if the area has a <tt>struct vm_struct</tt>, and <tt>va_end
+	 * - va_start</tt> otherwise.
+	 */
+	uint64_t size;
+	/**
+	 * Address of the <tt>struct vm_struct</tt>, or 0 if the area doesn't
+	 * have one (e.g., it was mapped by @c vm_map_ram()).
+	 */
+	uint64_t vm;
+	/** @c vm->caller, or 0 if there is no @c vm. */
+	uint64_t caller;
+	/** @c vm->nr_pages, or 0 if there is no @c vm. */
+	uint64_t pages;
+	/** @c vm->flags (e.g., @c VM_ALLOC), or 0 if there is no @c vm. */
+	uint64_t flags;
+};
+
+/**
+ * Get every busy vmalloc area.
+ *
+ * The red-black tree of busy areas (one per vmap node since Linux 6.9) is
+ * walked natively, and the <tt>struct vmap_area</tt> and <tt>struct
+ * vm_struct</tt> of each area are read in batches.
+ *
+ * @param[out] ret Returned areas sorted by address. It must be freed with @c
+ * free().
+ * @param[out] num_ret Returned number of areas.
+ */
+struct drgn_error *
+linux_helper_vmalloc_areas(struct drgn_program *prog,
+			   struct linux_helper_vmalloc_area **ret,
+			   size_t *num_ret);
+
+/** vmalloc usage of one caller from @ref linux_helper_vmalloc_callers(). */
+struct linux_helper_vmalloc_caller {
+	/** @ref linux_helper_vmalloc_area::caller. */
+	uint64_t caller;
+	/** Number of areas. */
+	uint64_t areas;
+	/** Total @ref linux_helper_vmalloc_area::size. */
+	uint64_t size;
+	/** Total @ref linux_helper_vmalloc_area::pages. */
+	uint64_t pages;
+};
+
+/**
+ * Aggregate vmalloc areas by caller.
+ *
+ * @param[in] areas Areas returned by @ref linux_helper_vmalloc_areas().
+ * @param[out] ret Returned callers sorted by decreasing size. It must be freed
+ * with @c free().
+ * @param[out] num_ret Returned number of callers.
+ */
+struct drgn_error *
+linux_helper_vmalloc_callers(const struct linux_helper_vmalloc_area *areas,
+			     size_t num_areas,
+			     struct linux_helper_vmalloc_caller **ret,
+			     size_t *num_ret);
+
+/** Size of the blocks of heap memory read by @ref glibc_helper_malloc_walk(). */
+#define GLIBC_HELPER_MALLOC_READ_SIZE (1024 * 1024)
+
+/** Number of allocated glibc malloc chunks of one size. */
+struct glibc_helper_malloc_size_class {
+	/** Chunk size, including the chunk header. */
+	uint64_t size;
+	uint64_t count;
+};
+
+/** Summary of the glibc malloc heap. */
+struct glibc_helper_malloc_stats {
+	/** Number of arenas, including the main arena. */
+	uint64_t arenas;
+	/** Number of heaps of thread arenas. */
+	uint64_t heaps;
+	/** Number of chunks which are allocated. */
+	uint64_t in_use_chunks;
+	/** Total size of the allocated chunks. */
+	uint64_t in_use_bytes;
+	/** Number of free chunks, including fastbin chunks. */
+	uint64_t free_chunks;
+	/** Total size of the free chunks. */
+	uint64_t free_bytes;
+	/** Number and total size of free chunks in fastbins. */
+	uint64_t fastbin_chunks, fastbin_bytes;
+	/** Total size of the top chunks of the arenas. */
+	uint64_t top_bytes;
+	/** Allocated chunks grouped by size, sorted by size. */
+	struct glibc_helper_malloc_size_class *size_classes;
+	size_t num_size_classes;
+};
+
+/** Allocated glibc malloc chunk found by @ref glibc_helper_malloc_walk(). */
+struct glibc_helper_malloc_chunk {
+	/** Address returned by @c malloc(), i.e., after the chunk header. */
+	uint64_t address;
+	/** Usable size of the chunk, i.e., @c malloc_usable_size(). */
+	uint64_t size;
+};
+
+/**
+ * Walk the glibc malloc heap of a userspace program.
+ *
+ * This walks the chunks of the main arena and of every heap of the thread
+ * arenas, reading the heap in blocks of @ref GLIBC_HELPER_MALLOC_READ_SIZE
+ * bytes and decoding the chunk headers without creating objects. This requires
+ * debugging information for glibc (for @c main_arena and @c mp_).
+ *
+ * A chunk is free if the next chunk doesn't have @c PREV_INUSE set or if it is
+ * in a fastbin. Chunks cached in a thread's tcache can't be found from a core
+ * dump without the thread's TLS, so they are counted as allocated, as are
+ * chunks allocated directly with @c mmap(), which aren't in any arena.
+ *
+ * @param[out] stats_ret Returned statistics. The size classes must be freed
+ * with @ref glibc_helper_malloc_stats_deinit().
+ * @param[in] min_size If @p chunks_ret is not @c NULL, the smallest usable size
+ * of an allocated chunk to return.
+ * @param[in] max_size If @p chunks_ret is not @c NULL, the largest usable size
+ * of an allocated chunk to return.
+ * @param[out] chunks_ret If not @c NULL, returned allocated chunks with a size
+ * in [@p min_size, @p max_size], in address order within each heap. It must be
+ * freed with @c free().
+ * @param[out] num_chunks_ret Returned number of chunks in @p chunks_ret.
+ */
+struct drgn_error *
+glibc_helper_malloc_walk(struct drgn_program *prog,
+			 struct glibc_helper_malloc_stats *stats_ret,
+			 uint64_t min_size, uint64_t max_size,
+			 struct glibc_helper_malloc_chunk **chunks_ret,
+			 size_t *num_chunks_ret);
+
+/** Free the size classes of a @ref glibc_helper_malloc_stats. */
+void glibc_helper_malloc_stats_deinit(struct glibc_helper_malloc_stats *stats);
+
 #endif /* DRGN_HELPERS_H */
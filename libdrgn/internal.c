@@ -4,13 +4,134 @@
 #include <elfutils/libdwelf.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "internal.h"
 
+/* Set by drgn_set_num_threads(), or 0 if it wasn't called. */
+static int drgn_num_threads_set;
+static int drgn_num_threads_default;
+static pthread_once_t drgn_num_threads_once = PTHREAD_ONCE_INIT;
+
+static void drgn_num_threads_init(void)
+{
+	const char *env;
+	int num_threads = 0;
+
+	env = getenv("DRGN_NUM_THREADS");
+	if (env)
+		num_threads = atoi(env);
+#ifdef _OPENMP
+	if (num_threads <= 0)
+		num_threads = omp_get_max_threads();
+#endif
+	drgn_num_threads_default = num_threads > 0 ? num_threads : 1;
+}
+
+LIBDRGN_PUBLIC void drgn_set_num_threads(int num_threads)
+{
+	__atomic_store_n(&drgn_num_threads_set,
+			 num_threads > 0 ? num_threads : 0, __ATOMIC_RELAXED);
+}
+
+/*
+ * omp_set_num_threads() only applies to the calling thread, so instead, every
+ * parallel region passes this in a num_threads() clause.
+ */
+LIBDRGN_PUBLIC int drgn_num_threads(void)
+{
+	int num_threads;
+
+	num_threads = __atomic_load_n(&drgn_num_threads_set, __ATOMIC_RELAXED);
+	if (num_threads)
+		return num_threads;
+	pthread_once(&drgn_num_threads_once, drgn_num_threads_init);
+	return drgn_num_threads_default;
+}
+
+static void *(*drgn_blocking_begin)(void);
+static void (*drgn_blocking_end)(void *);
+
+LIBDRGN_PUBLIC void drgn_set_blocking_callbacks(void *(*begin)(void),
+						void (*end)(void *))
+{
+	drgn_blocking_begin = begin;
+	drgn_blocking_end = end;
+}
+
+void drgn_mutex_lock(pthread_mutex_t *mutex)
+{
+	void *state;
+
+	if (pthread_mutex_trylock(mutex) == 0)
+		return;
+	if (!drgn_blocking_begin) {
+		pthread_mutex_lock(mutex);
+		return;
+	}
+	state = drgn_blocking_begin();
+	pthread_mutex_lock(mutex);
+	drgn_blocking_end(state);
+}
+
+struct drgn_error *drgn_get_cache_dir(const char *env, const char *subdir,
+				      char **ret)
+{
+	const char *dir;
+	const char *suffix;
+
+	dir = getenv(env);
+	if (dir) {
+		if (!dir[0]) {
+			*ret = NULL;
+			return NULL;
+		}
+		subdir = suffix = "";
+	} else {
+		dir = getenv("XDG_CACHE_HOME");
+		if (dir && dir[0]) {
+			suffix = "/drgn";
+		} else {
+			dir = getenv("HOME");
+			if (!dir || !dir[0]) {
+				*ret = NULL;
+				return NULL;
+			}
+			suffix = "/.cache/drgn";
+		}
+	}
+	if (asprintf(ret, "%s%s%s", dir, suffix, subdir) == -1)
+		return &drgn_enomem;
+	return NULL;
+}
+
+bool mkdir_parents(char *path)
+{
+	char *p;
+
+	for (p = path + 1; *p; p++) {
+		if (*p == '/') {
+			*p = '\0';
+			if (mkdir(path, 0777) == -1 && errno != EEXIST) {
+				*p = '/';
+				return false;
+			}
+			*p = '/';
+		}
+	}
+	return mkdir(path, 0777) == 0 || errno == EEXIST;
+}
+
 struct drgn_error *open_elf_file(const char *path, int *fd_ret, Elf **elf_ret)
 {
 	struct drgn_error *err;
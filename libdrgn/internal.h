@@ -10,6 +10,7 @@
 #ifndef DRGN_INTERNAL_H
 #define DRGN_INTERNAL_H
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <elfutils/libdw.h>
@@ -32,6 +33,40 @@
 #define LIBDRGN_PUBLIC __attribute__((visibility("default")))
 #endif
 
+/**
+ * Lock a mutex, calling the callbacks set by @ref
+ * drgn_set_blocking_callbacks() if it is held by another thread.
+ *
+ * This should be used for locks which may be held while calling back into a
+ * language binding.
+ */
+void drgn_mutex_lock(pthread_mutex_t *mutex);
+
+/**
+ * Get the directory for a drgn cache.
+ *
+ * This is the value of the environment variable @p env if it is set, or
+ * otherwise @p subdir under <tt>$XDG_CACHE_HOME/drgn</tt> or
+ * <tt>$HOME/.cache/drgn</tt>.
+ *
+ * @param[in] env Name of the environment variable overriding the directory.
+ * @param[in] subdir Subdirectory of the default cache directory, either empty
+ * or starting with a slash.
+ * @param[out] ret Returned directory, which must be freed with @c free(), or
+ * @c NULL if the cache is disabled because @p env is set to an empty string or
+ * there is no home directory.
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *drgn_get_cache_dir(const char *env, const char *subdir,
+				      char **ret);
+
+/**
+ * Create a directory and any missing parent directories.
+ *
+ * @return Whether the directory exists.
+ */
+bool mkdir_parents(char *path);
+
 struct drgn_error *open_elf_file(const char *path, int *fd_ret, Elf **elf_ret);
 
 struct drgn_error *find_elf_file(char **path_ret, int *fd_ret, Elf **elf_ret,
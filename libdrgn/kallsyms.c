@@ -0,0 +1,283 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "internal.h"
+#include "kallsyms.h"
+#include "vector.h"
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_kallsyms_name_map, c_string_hash,
+			    c_string_eq)
+
+DEFINE_VECTOR(drgn_kallsyms_symbol_vector, struct drgn_kallsyms_symbol)
+
+/* Read an entire file into a null-terminated buffer. */
+static struct drgn_error *read_kallsyms_file(const char *path, char **buf_ret,
+					     size_t *size_ret)
+{
+	struct drgn_error *err;
+	int fd;
+	char *buf = NULL;
+	size_t size = 0, capacity = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return drgn_error_create_os("open", errno, path);
+	for (;;) {
+		ssize_t r;
+
+		/* Leave room for the null terminator. */
+		if (size + 1 >= capacity) {
+			char *tmp;
+
+			capacity = capacity ? capacity * 2 : 1024 * 1024;
+			tmp = realloc(buf, capacity);
+			if (!tmp) {
+				err = &drgn_enomem;
+				goto err;
+			}
+			buf = tmp;
+		}
+		r = read(fd, buf + size, capacity - size - 1);
+		if (r == -1) {
+			if (errno == EINTR)
+				continue;
+			err = drgn_error_create_os("read", errno, path);
+			goto err;
+		}
+		if (r == 0)
+			break;
+		size += r;
+	}
+	close(fd);
+	buf[size] = '\0';
+	*buf_ret = buf;
+	*size_ret = size;
+	return NULL;
+
+err:
+	free(buf);
+	close(fd);
+	return err;
+}
+
+/*
+ * Parse a line of the form "address type name" or "address type name\t[module]"
+ * in place.
+ */
+static bool parse_kallsyms_line(char *line, struct drgn_kallsyms_symbol *ret)
+{
+	char *p, *end;
+
+	errno = 0;
+	ret->address = strtoull(line, &end, 16);
+	if (errno || end == line || *end != ' ')
+		return false;
+	p = end + 1;
+	if (!*p || p[1] != ' ')
+		return false;
+	ret->global = *p >= 'A' && *p <= 'Z';
+	p += 2;
+	ret->name = p;
+	p += strcspn(p, "\t ");
+	if (p == ret->name)
+		return false;
+	if (*p) {
+		*p++ = '\0';
+		p += strspn(p, "\t ");
+		if (*p == '[') {
+			ret->module = ++p;
+			p = strchr(p, ']');
+			if (!p)
+				return false;
+			*p = '\0';
+		} else {
+			ret->module = NULL;
+		}
+	} else {
+		ret->module = NULL;
+	}
+	ret->size = 0;
+	return true;
+}
+
+static int drgn_kallsyms_symbol_cmp(const void *_a, const void *_b)
+{
+	const struct drgn_kallsyms_symbol *a = _a, *b = _b;
+
+	if (a->address != b->address)
+		return a->address < b->address ? -1 : 1;
+	/*
+	 * Lookups by address return the last symbol at an address, so sort
+	 * global symbols and then the first symbol in the file last.
+	 */
+	if (a->global != b->global)
+		return a->global ? 1 : -1;
+	return a->order > b->order ? -1 : a->order < b->order;
+}
+
+static bool module_eq(const char *a, const char *b)
+{
+	return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+/* Whether a is preferred over b for lookups by name. */
+static bool kallsyms_name_preferred(const struct drgn_kallsyms_symbol *a,
+				    const struct drgn_kallsyms_symbol *b)
+{
+	if (!a->module != !b->module)
+		return !a->module;
+	return a->order < b->order;
+}
+
+struct drgn_error *drgn_kallsyms_init(struct drgn_kallsyms *ret,
+				      const char *path)
+{
+	struct drgn_error *err;
+	struct drgn_kallsyms_symbol_vector symbols = VECTOR_INIT;
+	char *buf, *line, *next;
+	size_t size, i;
+	bool nonzero = false;
+
+	err = read_kallsyms_file(path, &buf, &size);
+	if (err)
+		return err;
+
+	for (line = buf; *line; line = next) {
+		struct drgn_kallsyms_symbol *sym;
+
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+		else
+			next = line + strlen(line);
+		if (!*line)
+			continue;
+		sym = drgn_kallsyms_symbol_vector_append_entry(&symbols);
+		if (!sym) {
+			err = &drgn_enomem;
+			goto err;
+		}
+		if (!parse_kallsyms_line(line, sym)) {
+			err = drgn_error_format(DRGN_ERROR_OTHER,
+						"could not parse %s", path);
+			goto err;
+		}
+		sym->order = symbols.size - 1;
+		if (sym->address)
+			nonzero = true;
+	}
+	/* Unprivileged readers see all zeroes (see kptr_restrict). */
+	if (symbols.size && !nonzero) {
+		err = drgn_error_format(DRGN_ERROR_OTHER,
+					"%s does not contain addresses", path);
+		goto err;
+	}
+
+	qsort(symbols.data, symbols.size, sizeof(symbols.data[0]),
+	      drgn_kallsyms_symbol_cmp);
+	drgn_kallsyms_symbol_vector_shrink_to_fit(&symbols);
+
+	/*
+	 * Each symbol extends to the next higher address in the same module.
+	 * Aliases at the same address get the same size.
+	 */
+	for (i = 0; i < symbols.size;) {
+		uint64_t address = symbols.data[i].address;
+		size_t j, k;
+
+		for (j = i + 1; j < symbols.size; j++) {
+			if (symbols.data[j].address != address)
+				break;
+		}
+		if (j < symbols.size &&
+		    module_eq(symbols.data[j].module, symbols.data[i].module)) {
+			for (k = i; k < j; k++)
+				symbols.data[k].size = symbols.data[j].address - address;
+		}
+		i = j;
+	}
+
+	drgn_kallsyms_name_map_init(&ret->names);
+	for (i = 0; i < symbols.size; i++) {
+		struct drgn_kallsyms_name_map_entry entry = {
+			.key = symbols.data[i].name,
+			.value = i,
+		};
+		struct drgn_kallsyms_name_map_iterator it;
+		int r;
+
+		r = drgn_kallsyms_name_map_insert(&ret->names, &entry, &it);
+		if (r == -1) {
+			drgn_kallsyms_name_map_deinit(&ret->names);
+			err = &drgn_enomem;
+			goto err;
+		}
+		if (r == 0 &&
+		    kallsyms_name_preferred(&symbols.data[i],
+					    &symbols.data[it.entry->value]))
+			it.entry->value = i;
+	}
+
+	ret->symbols = symbols.data;
+	ret->num_symbols = symbols.size;
+	ret->buf = buf;
+	ret->buf_size = size + 1;
+	return NULL;
+
+err:
+	drgn_kallsyms_symbol_vector_deinit(&symbols);
+	free(buf);
+	return err;
+}
+
+void drgn_kallsyms_deinit(struct drgn_kallsyms *kallsyms)
+{
+	drgn_kallsyms_name_map_deinit(&kallsyms->names);
+	free(kallsyms->symbols);
+	free(kallsyms->buf);
+}
+
+size_t drgn_kallsyms_memory_usage(struct drgn_kallsyms *kallsyms)
+{
+	return (kallsyms->num_symbols * sizeof(kallsyms->symbols[0]) +
+		kallsyms->buf_size +
+		drgn_kallsyms_name_map_memory_usage(&kallsyms->names));
+}
+
+const struct drgn_kallsyms_symbol *
+drgn_kallsyms_find_by_address(struct drgn_kallsyms *kallsyms,
+			      uint64_t address)
+{
+	const struct drgn_kallsyms_symbol *base = kallsyms->symbols;
+	size_t n = kallsyms->num_symbols;
+
+	if (!n)
+		return NULL;
+	/* Find the last symbol at or before the address. */
+	while (n > 1) {
+		size_t half = n / 2;
+
+		base = base[half].address <= address ? base + half : base;
+		n -= half;
+	}
+	if (address - base->address >= base->size)
+		return NULL;
+	return base;
+}
+
+const struct drgn_kallsyms_symbol *
+drgn_kallsyms_find_by_name(struct drgn_kallsyms *kallsyms, const char *name)
+{
+	struct drgn_kallsyms_name_map_iterator it;
+
+	it = drgn_kallsyms_name_map_search(&kallsyms->names, &name);
+	if (!it.entry)
+		return NULL;
+	return &kallsyms->symbols[it.entry->value];
+}
@@ -0,0 +1,106 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Kernel symbol table from @c /proc/kallsyms.
+ *
+ * See @ref Kallsyms.
+ */
+
+#ifndef DRGN_KALLSYMS_H
+#define DRGN_KALLSYMS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash_table.h"
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup Kallsyms Kallsyms
+ *
+ * Kernel symbol table from @c /proc/kallsyms.
+ *
+ * The file is parsed once into an array sorted by address and a map from name
+ * to symbol. This is a symbol source for the running kernel when debugging
+ * information is missing or doesn't cover an address.
+ *
+ * @{
+ */
+
+/** Symbol in a @ref drgn_kallsyms. */
+struct drgn_kallsyms_symbol {
+	uint64_t address;
+	/**
+	 * Distance to the next symbol at a higher address in the same module,
+	 * or 0 if there is none. @c /proc/kallsyms doesn't have sizes.
+	 */
+	uint64_t size;
+	const char *name;
+	/** Name of the module, or @c NULL for vmlinux. */
+	const char *module;
+	/** Line number in @c /proc/kallsyms. */
+	uint32_t order;
+	/** Whether the symbol is global (its type character is uppercase). */
+	bool global;
+};
+
+/** Map from name to index in @ref drgn_kallsyms::symbols. */
+DEFINE_HASH_MAP_TYPE(drgn_kallsyms_name_map, const char *, size_t)
+
+/** Parsed @c /proc/kallsyms. */
+struct drgn_kallsyms {
+	/** Symbols sorted by address. */
+	struct drgn_kallsyms_symbol *symbols;
+	size_t num_symbols;
+	/** Contents of the file, which the names point into. */
+	char *buf;
+	/** Size of @ref buf in bytes, including the null terminator. */
+	size_t buf_size;
+	/**
+	 * Symbol for each name. For duplicate names, a vmlinux symbol is
+	 * preferred over a module symbol, then the first one in the file.
+	 */
+	struct drgn_kallsyms_name_map names;
+};
+
+/**
+ * Read and index a kallsyms file.
+ *
+ * @param[out] ret Returned table. Must be freed with @ref drgn_kallsyms_deinit()
+ * on success.
+ * @param[in] path Path of the file, usually @c /proc/kallsyms.
+ */
+struct drgn_error *drgn_kallsyms_init(struct drgn_kallsyms *ret,
+				      const char *path);
+
+/** Free a @ref drgn_kallsyms. */
+void drgn_kallsyms_deinit(struct drgn_kallsyms *kallsyms);
+
+/** Get the number of bytes allocated by a @ref drgn_kallsyms. */
+size_t drgn_kallsyms_memory_usage(struct drgn_kallsyms *kallsyms);
+
+/**
+ * Find the symbol containing an address.
+ *
+ * @return Symbol, or @c NULL if no symbol contains the address.
+ */
+const struct drgn_kallsyms_symbol *
+drgn_kallsyms_find_by_address(struct drgn_kallsyms *kallsyms,
+			      uint64_t address);
+
+/**
+ * Find a symbol by name.
+ *
+ * @return Symbol, or @c NULL if there is no symbol with the name.
+ */
+const struct drgn_kallsyms_symbol *
+drgn_kallsyms_find_by_name(struct drgn_kallsyms *kallsyms, const char *name);
+
+/** @} */
+
+#endif /* DRGN_KALLSYMS_H */
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: GPL-3.0+
 
 #include <fcntl.h>
+#include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -49,11 +50,16 @@ static struct drgn_error *drgn_platform_from_kdump(kdump_ctx_t *ctx,
 	return NULL;
 }
 
-static struct drgn_error *drgn_read_kdump(void *buf, uint64_t address,
-					  size_t count, uint64_t offset,
-					  void *arg, bool physical)
+/*
+ * Reads at least this large are split into chunks of this size and
+ * decompressed in parallel.
+ */
+#define DRGN_KDUMP_PARALLEL_CHUNK_SIZE (16 * 1024)
+
+static struct drgn_error *drgn_read_kdump_ctx(kdump_ctx_t *ctx, void *buf,
+					      uint64_t address, size_t count,
+					      bool physical)
 {
-	kdump_ctx_t *ctx = arg;
 	kdump_status ks;
 
 	ks = kdump_read(ctx, physical ? KDUMP_KPHYSADDR : KDUMP_KVADDR, address,
@@ -66,6 +72,190 @@ static struct drgn_error *drgn_read_kdump(void *buf, uint64_t address,
 	return NULL;
 }
 
+/*
+ * Make sure that there is a clone of the kdump context for each thread. A
+ * kdump context can't be used by multiple threads at once.
+ */
+static bool drgn_kdump_get_clones(struct drgn_program *prog, int num_threads)
+{
+	kdump_ctx_t **clones;
+
+	if (prog->num_kdump_clones >= num_threads)
+		return true;
+	clones = realloc(prog->kdump_clones, num_threads * sizeof(*clones));
+	if (!clones)
+		return false;
+	prog->kdump_clones = clones;
+	while (prog->num_kdump_clones < num_threads) {
+		clones[prog->num_kdump_clones] = kdump_clone(prog->kdump_ctx, 0);
+		if (!clones[prog->num_kdump_clones])
+			return false;
+		prog->num_kdump_clones++;
+	}
+	return true;
+}
+
+static struct drgn_error *drgn_read_kdump(void *buf, uint64_t address,
+					  size_t count, uint64_t offset,
+					  void *arg, bool physical)
+{
+	struct drgn_program *prog = arg;
+	struct drgn_error *err = NULL;
+	uint64_t start_ns = monotonic_ns();
+	size_t num_chunks;
+	int num_threads;
+
+	/*
+	 * Large reads come from the memory cache's readahead or from the
+	 * caller. Compressed pages are the bottleneck for those, so decompress
+	 * them on multiple threads.
+	 */
+	num_chunks = ((count + DRGN_KDUMP_PARALLEL_CHUNK_SIZE - 1) /
+		      DRGN_KDUMP_PARALLEL_CHUNK_SIZE);
+	num_threads = drgn_num_threads();
+	if (num_chunks < (size_t)num_threads)
+		num_threads = num_chunks;
+	if (num_threads <= 1 || !drgn_kdump_get_clones(prog, num_threads)) {
+		prog->reader.stats.kdump_reads++;
+		err = drgn_read_kdump_ctx(prog->kdump_ctx, buf, address, count,
+					  physical);
+		goto out;
+	}
+
+	#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+	for (size_t i = 0; i < num_chunks; i++) {
+		size_t chunk_offset = i * DRGN_KDUMP_PARALLEL_CHUNK_SIZE;
+		struct drgn_error *chunk_err;
+
+		if (err)
+			continue;
+
+		chunk_err = drgn_read_kdump_ctx(prog->kdump_clones[omp_get_thread_num()],
+						(char *)buf + chunk_offset,
+						address + chunk_offset,
+						min((size_t)DRGN_KDUMP_PARALLEL_CHUNK_SIZE,
+						    count - chunk_offset),
+						physical);
+		if (chunk_err) {
+			#pragma omp critical(drgn_read_kdump)
+			if (err)
+				drgn_error_destroy(chunk_err);
+			else
+				err = chunk_err;
+		}
+	}
+	prog->reader.stats.kdump_reads += num_chunks;
+out:
+	prog->reader.stats.kdump_bytes += count;
+	prog->reader.stats.kdump_ns += monotonic_ns() - start_ns;
+	return err;
+}
+
+#ifdef KDUMP_ATTR_FILE_PAGEMAP
+/*
+ * Maximum number of pages of virtual memory that drgn_kdump_present() checks
+ * at once. Each one needs an address translation.
+ */
+#define DRGN_KDUMP_PRESENT_MAX_PAGES 1024
+
+/* Return whether a PFN is in the dump and the last PFN with the same answer. */
+static bool drgn_kdump_pfn_present(kdump_bmp_t *bmp, kdump_addr_t pfn,
+				   kdump_addr_t *last_ret)
+{
+	kdump_addr_t idx = pfn;
+
+	if (kdump_bmp_find_set(bmp, &idx) != KDUMP_OK) {
+		*last_ret = KDUMP_ADDR_MAX;
+		return false;
+	}
+	if (idx != pfn) {
+		*last_ret = idx - 1;
+		return false;
+	}
+	if (kdump_bmp_find_clear(bmp, &idx) != KDUMP_OK)
+		*last_ret = KDUMP_ADDR_MAX;
+	else
+		*last_ret = idx - 1;
+	return true;
+}
+
+/*
+ * drgn_memory_present_fn that checks the bitmap of pages included in the dump,
+ * so that pages excluded by makedumpfile (e.g., free, cache, and user pages)
+ * fail without asking libkdumpfile to read them.
+ */
+static struct drgn_error *drgn_kdump_present(uint64_t address, uint64_t last,
+					     void *arg, bool physical,
+					     bool *present_ret,
+					     uint64_t *last_ret)
+{
+	struct drgn_program *prog = arg;
+	uint64_t page_size = prog->vmcoreinfo.page_size;
+	kdump_addr_t pfn_last;
+	unsigned int i;
+
+	if (physical) {
+		*present_ret = drgn_kdump_pfn_present(prog->kdump_pagemap,
+						      address / page_size,
+						      &pfn_last);
+		if (pfn_last >= last / page_size)
+			*last_ret = last;
+		else
+			*last_ret = (pfn_last + 1) * page_size - 1;
+		return NULL;
+	}
+
+	/*
+	 * Virtual addresses have to be translated one page at a time, so only
+	 * look at a bounded number of pages.
+	 */
+	for (i = 0; i < DRGN_KDUMP_PRESENT_MAX_PAGES; i++) {
+		kdump_paddr_t paddr;
+		bool present;
+		uint64_t page_last;
+
+		if (kdump_vtop(prog->kdump_ctx, address, &paddr) == KDUMP_OK) {
+			present = drgn_kdump_pfn_present(prog->kdump_pagemap,
+							 paddr / page_size,
+							 &pfn_last);
+		} else {
+			present = false;
+		}
+		if (i == 0)
+			*present_ret = present;
+		else if (present != *present_ret)
+			break;
+		page_last = address | (page_size - 1);
+		*last_ret = min(page_last, last);
+		if (page_last >= last)
+			break;
+		address = page_last + 1;
+	}
+	return NULL;
+}
+
+/*
+ * Use the dump's page bitmap to check whether memory is present. Older versions
+ * of libkdumpfile and some dump formats don't have one, in which case every
+ * read goes to libkdumpfile.
+ */
+static void drgn_kdump_init_pagemap(struct drgn_program *prog)
+{
+	kdump_attr_t attr;
+
+	if (!prog->vmcoreinfo.page_size)
+		return;
+	attr.type = KDUMP_BITMAP;
+	if (kdump_get_typed_attr(prog->kdump_ctx, KDUMP_ATTR_FILE_PAGEMAP,
+				 &attr) != KDUMP_OK)
+		return;
+	kdump_bmp_incref(attr.val.bitmap);
+	prog->kdump_pagemap = attr.val.bitmap;
+	drgn_memory_reader_set_present(&prog->reader, drgn_kdump_present,
+				       prog);
+}
+#endif
+
 struct drgn_error *drgn_program_set_kdump(struct drgn_program *prog)
 {
 	struct drgn_error *err;
@@ -113,11 +303,11 @@ struct drgn_error *drgn_program_set_kdump(struct drgn_program *prog)
 		goto err;
 
 	err = drgn_program_add_memory_segment(prog, 0, UINT64_MAX,
-					      drgn_read_kdump, ctx, false);
+					      drgn_read_kdump, prog, false);
 	if (err)
 		goto err;
 	err = drgn_program_add_memory_segment(prog, 0, UINT64_MAX,
-					      drgn_read_kdump, ctx, true);
+					      drgn_read_kdump, prog, true);
 	if (err) {
 		drgn_memory_reader_deinit(&prog->reader);
 		drgn_memory_reader_init(&prog->reader);
@@ -125,14 +315,18 @@ struct drgn_error *drgn_program_set_kdump(struct drgn_program *prog)
 	}
 
 	prog->flags |= DRGN_PROGRAM_IS_LINUX_KERNEL;
-	err = drgn_program_add_object_finder(prog, linux_kernel_object_find,
-					     prog);
+	err = drgn_program_add_memoized_object_finder(prog,
+						      linux_kernel_object_find,
+						      prog);
 	if (err)
 		goto err;
 	if (!prog->lang)
 		prog->lang = &drgn_language_c;
 	drgn_program_set_platform(prog, &platform);
 	prog->kdump_ctx = ctx;
+#ifdef KDUMP_ATTR_FILE_PAGEMAP
+	drgn_kdump_init_pagemap(prog);
+#endif
 	return NULL;
 
 err:
@@ -146,11 +340,14 @@ struct drgn_error *drgn_program_cache_prstatus_kdump(struct drgn_program *prog)
 	kdump_num_t ncpus, i;
 	kdump_status ks;
 
+	/* The prefetch thread may be using the context to read memory. */
+	drgn_memory_reader_lock(&prog->reader);
 	ks = kdump_get_number_attr(prog->kdump_ctx, "cpu.number", &ncpus);
 	if (ks != KDUMP_OK) {
-		return drgn_error_format(DRGN_ERROR_OTHER,
-					 "kdump_get_number_attr(cpu.number): %s",
-					 kdump_get_err(prog->kdump_ctx));
+		err = drgn_error_format(DRGN_ERROR_OTHER,
+					"kdump_get_number_attr(cpu.number): %s",
+					kdump_get_err(prog->kdump_ctx));
+		goto out;
 	}
 
 	/*
@@ -172,19 +369,21 @@ struct drgn_error *drgn_program_cache_prstatus_kdump(struct drgn_program *prog)
 			 "cpu.%" PRIuFAST64 ".PRSTATUS", i);
 		ks = kdump_attr_ref(prog->kdump_ctx, attr_name, &prstatus_ref);
 		if (ks != KDUMP_OK) {
-			return drgn_error_format(DRGN_ERROR_OTHER,
-						 "kdump_attr_ref(%s): %s",
-						 attr_name,
-						 kdump_get_err(prog->kdump_ctx));
+			err = drgn_error_format(DRGN_ERROR_OTHER,
+						"kdump_attr_ref(%s): %s",
+						attr_name,
+						kdump_get_err(prog->kdump_ctx));
+			goto out;
 		}
 
 		ks = kdump_attr_ref_get(prog->kdump_ctx, &prstatus_ref,
 					&prstatus_attr);
 		if (ks != KDUMP_OK) {
-			return drgn_error_format(DRGN_ERROR_OTHER,
-						 "kdump_attr_ref_get(%s): %s",
-						 attr_name,
-						 kdump_get_err(prog->kdump_ctx));
+			err = drgn_error_format(DRGN_ERROR_OTHER,
+						"kdump_attr_ref_get(%s): %s",
+						attr_name,
+						kdump_get_err(prog->kdump_ctx));
+			goto out;
 		}
 
 		prstatus_data = kdump_blob_pin(prstatus_attr.val.blob);
@@ -193,7 +392,10 @@ struct drgn_error *drgn_program_cache_prstatus_kdump(struct drgn_program *prog)
 							prstatus_data,
 							prstatus_size);
 		if (err)
-			return err;
+			goto out;
 	}
-	return NULL;
+	err = NULL;
+out:
+	drgn_memory_reader_unlock(&prog->reader);
+	return err;
 }
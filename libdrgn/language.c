@@ -17,8 +17,11 @@ const struct drgn_language drgn_languages[] = {
 		.format_type_name = c_format_type_name,
 		.format_type = c_format_type,
 		.format_object = c_format_object,
+		.format_object_stream = c_format_object_stream,
+		.format_object_json = c_format_object_json,
 		.find_type = c_find_type,
-		.bit_offset = c_bit_offset,
+		.member_path = c_member_path,
+		.compile_expression = c_compile_expression,
 		.integer_literal = c_integer_literal,
 		.bool_literal = c_bool_literal,
 		.float_literal = c_float_literal,
@@ -51,8 +54,11 @@ const struct drgn_language drgn_languages[] = {
 		.format_type_name = c_format_type_name,
 		.format_type = c_format_type,
 		.format_object = c_format_object,
+		.format_object_stream = c_format_object_stream,
+		.format_object_json = c_format_object_json,
 		.find_type = c_find_type,
-		.bit_offset = c_bit_offset,
+		.member_path = c_member_path,
+		.compile_expression = c_compile_expression,
 		.integer_literal = c_integer_literal,
 		.bool_literal = c_bool_literal,
 		.float_literal = c_float_literal,
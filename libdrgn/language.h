@@ -32,18 +32,30 @@ struct drgn_type_index;
 
 typedef struct drgn_error *drgn_format_type_fn(struct drgn_qualified_type,
 					       char **);
-typedef struct drgn_error *drgn_format_object_fn(const struct drgn_object *,
-						 size_t,
-						 enum drgn_format_object_flags,
-						 char **);
+typedef struct drgn_error *
+drgn_format_object_fn(const struct drgn_object *, size_t,
+		      enum drgn_format_object_flags,
+		      const struct drgn_format_object_limits *, char **);
+typedef struct drgn_error *
+drgn_format_object_stream_fn(const struct drgn_object *, size_t,
+			     enum drgn_format_object_flags,
+			     const struct drgn_format_object_limits *,
+			     drgn_format_object_write_fn *, void *);
+typedef struct drgn_error *
+drgn_format_object_json_fn(const struct drgn_object *,
+			   const struct drgn_format_object_limits *, char **);
 typedef struct drgn_error *drgn_find_type_fn(struct drgn_type_index *tindex,
 					     const char *name,
 					     const char *filename,
 					     struct drgn_qualified_type *ret);
-typedef struct drgn_error *drgn_bit_offset_fn(struct drgn_program *prog,
-					      struct drgn_type *type,
-					      const char *member_designator,
-					      uint64_t *ret);
+typedef struct drgn_error *drgn_member_path_fn(struct drgn_program *prog,
+					       struct drgn_type *type,
+					       const char *member_designator,
+					       struct drgn_member_info *ret);
+typedef struct drgn_error *
+drgn_compile_expression_fn(struct drgn_program *prog, const char *str,
+			   const char * const *variables, size_t num_variables,
+			   struct drgn_expression **ret);
 typedef struct drgn_error *drgn_integer_literal_fn(struct drgn_object *res,
 						   uint64_t uvalue);
 typedef struct drgn_error *drgn_bool_literal_fn(struct drgn_object *res,
@@ -57,6 +69,25 @@ typedef struct drgn_error *drgn_bool_op(const struct drgn_object *obj, bool *ret
 typedef struct drgn_error *drgn_cmp_op(const struct drgn_object *lhs,
 				       const struct drgn_object *rhs, int *ret);
 
+/**
+ * Compiled expression.
+ *
+ * A language's @ref drgn_language::compile_expression callback returns a
+ * structure embedding this one.
+ */
+struct drgn_expression {
+	/** Program that the expression was compiled for. */
+	struct drgn_program *prog;
+	/** Number of variables which must be passed when evaluating. */
+	size_t num_variables;
+	/** Implement @ref drgn_expression_evaluate(). */
+	struct drgn_error *(*evaluate)(struct drgn_expression *expr,
+				       const struct drgn_object * const *variables,
+				       struct drgn_object *res);
+	/** Implement @ref drgn_expression_destroy(). */
+	void (*destroy)(struct drgn_expression *expr);
+};
+
 /**
  * Language implementation.
  *
@@ -75,8 +106,12 @@ struct drgn_language {
 	drgn_format_type_fn *format_type_name;
 	/** Implement @ref drgn_format_type(). */
 	drgn_format_type_fn *format_type;
-	/** Implement @ref drgn_format_object(). */
+	/** Implement @ref drgn_format_object_limited(). */
 	drgn_format_object_fn *format_object;
+	/** Implement @ref drgn_format_object_stream(). */
+	drgn_format_object_stream_fn *format_object_stream;
+	/** Implement @ref drgn_format_object_json(). */
+	drgn_format_object_json_fn *format_object_json;
 	/**
 	 * Implement @ref drgn_type_index_find().
 	 *
@@ -85,13 +120,21 @@ struct drgn_language {
 	 */
 	drgn_find_type_fn *find_type;
 	/**
-	 * Get the offset of a member in a type.
+	 * Resolve a member designator in a type.
 	 *
 	 * This should parse @p member_designator (which may include one or more
-	 * member references and zero or more array subscripts) and calculate
-	 * the offset, in bits, of that member from the beginning of @p type.
+	 * member references and zero or more array subscripts) and return the
+	 * type of the designated member, its offset in bits from the beginning
+	 * of @p type, and its bit field size.
+	 */
+	drgn_member_path_fn *member_path;
+	/**
+	 * Implement @ref drgn_program_compile_expression().
+	 *
+	 * This should parse @p str, resolving any names which are not in @p
+	 * variables in @p prog.
 	 */
-	drgn_bit_offset_fn *bit_offset;
+	drgn_compile_expression_fn *compile_expression;
 	/**
 	 * Set an object to an integer literal.
 	 *
@@ -134,8 +177,11 @@ struct drgn_language {
 drgn_format_type_fn c_format_type_name;
 drgn_format_type_fn c_format_type;
 drgn_format_object_fn c_format_object;
+drgn_format_object_stream_fn c_format_object_stream;
+drgn_format_object_json_fn c_format_object_json;
 drgn_find_type_fn c_find_type;
-drgn_bit_offset_fn c_bit_offset;
+drgn_member_path_fn c_member_path;
+drgn_compile_expression_fn c_compile_expression;
 drgn_integer_literal_fn c_integer_literal;
 drgn_bool_literal_fn c_bool_literal;
 drgn_float_literal_fn c_float_literal;
@@ -7,6 +7,7 @@
 #include <limits.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "internal.h"
 #include "hash_table.h"
@@ -546,14 +547,15 @@ struct drgn_error *c_format_type_name(struct drgn_qualified_type qualified_type,
 				      char **ret)
 {
 	struct drgn_error *err;
-	struct string_builder sb = {};
+	struct string_builder sb;
 
+	string_builder_init_scratch(&sb);
 	err = c_format_type_name_impl(qualified_type, &sb);
 	if (err) {
-		free(sb.str);
+		string_builder_release_scratch(&sb);
 		return err;
 	}
-	if (!string_builder_finalize(&sb, ret))
+	if (!string_builder_finalize_scratch(&sb, ret))
 		return &drgn_enomem;
 	return NULL;
 }
@@ -562,26 +564,105 @@ struct drgn_error *c_format_type(struct drgn_qualified_type qualified_type,
 				 char **ret)
 {
 	struct drgn_error *err;
-	struct string_builder sb = {};
+	struct string_builder sb;
 
+	string_builder_init_scratch(&sb);
 	if (drgn_type_is_complete(qualified_type.type))
 		err = c_define_type(qualified_type, 0, &sb);
 	else
 		err = c_format_type_name_impl(qualified_type, &sb);
 	if (err) {
-		free(sb.str);
+		string_builder_release_scratch(&sb);
 		return err;
 	}
-	if (!string_builder_finalize(&sb, ret))
+	if (!string_builder_finalize_scratch(&sb, ret))
 		return &drgn_enomem;
 	return NULL;
 }
 
+/*
+ * Append the parenthesized type name of an object. Objects are formatted with
+ * the same few types over and over, so this uses the program's cache.
+ */
+static struct drgn_error *
+c_append_object_type_name(const struct drgn_object *obj,
+			  struct string_builder *sb)
+{
+	struct drgn_error *err;
+	const char *name;
+
+	err = drgn_type_index_format_type_name(&obj->prog->tindex,
+					       drgn_object_qualified_type(obj),
+					       &name);
+	if (err)
+		return err;
+	if (!string_builder_appendc(sb, '(') ||
+	    !string_builder_append(sb, name) ||
+	    !string_builder_appendc(sb, ')'))
+		return &drgn_enomem;
+	return NULL;
+}
+
+DEFINE_HASH_SET(c_format_address_set, uint64_t, hash_pair_int_type,
+		hash_table_scalar_eq)
+DEFINE_VECTOR(c_format_address_vector, uint64_t)
+
+/* Limits and state shared by a single call to c_format_object(). */
+struct c_format_state {
+	uint64_t max_elements;
+	size_t max_depth;
+	size_t max_bytes;
+	size_t follow_pointers;
+	uint64_t max_dereference_bytes;
+	/* Current nesting depth of initializers. */
+	size_t depth;
+	/* Current number of pointers followed to get to this point. */
+	size_t pointer_depth;
+	/* Total size of the objects that followed pointers point to. */
+	uint64_t dereference_bytes;
+	/*
+	 * Addresses that have been dereferenced when following pointers, and
+	 * the order that they were added in so that the ones added while
+	 * formatting output which is then thrown away can be forgotten.
+	 */
+	struct c_format_address_set visited;
+	struct c_format_address_vector visited_log;
+};
+
+/*
+ * Point that the pointer-following state can be rolled back to when output is
+ * discarded (e.g., when an initializer doesn't fit on one line).
+ */
+struct c_format_mark {
+	size_t num_visited;
+	uint64_t dereference_bytes;
+};
+
+static inline struct c_format_mark c_format_mark(struct c_format_state *state)
+{
+	return (struct c_format_mark){
+		.num_visited = state->visited_log.size,
+		.dereference_bytes = state->dereference_bytes,
+	};
+}
+
+static void c_format_rollback(struct c_format_state *state,
+			      struct c_format_mark mark)
+{
+	while (state->visited_log.size > mark.num_visited) {
+		uint64_t address =
+			state->visited_log.data[--state->visited_log.size];
+
+		c_format_address_set_delete(&state->visited, &address);
+	}
+	state->dereference_bytes = mark.dereference_bytes;
+}
+
 static struct drgn_error *
 c_format_object_impl(const struct drgn_object *obj, size_t indent,
 		     size_t one_line_columns, size_t multi_line_columns,
 		     enum drgn_format_object_flags flags,
-		     struct string_builder *sb);
+		     struct c_format_state *state, struct string_builder *sb);
 
 static bool is_character_type(struct drgn_type *type)
 {
@@ -651,6 +732,50 @@ no_escape:
 	return ret ? NULL : &drgn_enomem;
 }
 
+/*
+ * Whether a character is formatted as itself in a string literal by
+ * c_format_character().
+ */
+static inline bool c_string_character_is_plain(unsigned char c)
+{
+	return c >= '\x20' && c < '\x7f' && c != '"' && c != '\\';
+}
+
+/*
+ * Format the characters of a string literal up to a null terminator. Runs of
+ * characters that don't need to be escaped are appended at once instead of one
+ * character at a time. *nul_ret is set to whether a null terminator was found.
+ */
+static struct drgn_error *
+c_format_string_characters(const unsigned char *buf, size_t n,
+			   struct string_builder *sb, bool *nul_ret)
+{
+	struct drgn_error *err;
+	size_t i = 0;
+
+	while (i < n) {
+		size_t end = i;
+
+		while (end < n && c_string_character_is_plain(buf[end]))
+			end++;
+		if (end > i &&
+		    !string_builder_appendn(sb, (const char *)buf + i, end - i))
+			return &drgn_enomem;
+		if (end == n)
+			break;
+		if (buf[end] == '\0') {
+			*nul_ret = true;
+			return NULL;
+		}
+		err = c_format_character(buf[end], false, true, sb);
+		if (err)
+			return err;
+		i = end + 1;
+	}
+	*nul_ret = false;
+	return NULL;
+}
+
 static struct drgn_error *
 c_format_string(struct drgn_memory_reader *reader, uint64_t address,
 		uint64_t length, struct string_builder *sb)
@@ -660,20 +785,24 @@ c_format_string(struct drgn_memory_reader *reader, uint64_t address,
 	if (!string_builder_appendc(sb, '"'))
 		return &drgn_enomem;
 	while (length) {
-		unsigned char c;
-
-		err = drgn_memory_reader_read(reader, &c, address++, 1, false);
+		unsigned char chunk[DRGN_STRING_CHUNK_SIZE];
+		size_t n;
+		bool nul;
+
+		err = drgn_memory_reader_read_string_chunk(reader, chunk,
+							   address,
+							   min(length,
+							       (uint64_t)sizeof(chunk)),
+							   false, &n);
 		if (err)
 			return err;
-
-		if (c == '\0') {
+		err = c_format_string_characters(chunk, n, sb, &nul);
+		if (err)
+			return err;
+		if (nul)
 			break;
-		} else {
-			err = c_format_character(c, false, true, sb);
-			if (err)
-				return err;
-		}
-		length--;
+		address += n;
+		length -= n;
 	}
 	if (!string_builder_appendc(sb, '"'))
 		return &drgn_enomem;
@@ -761,22 +890,54 @@ struct initializer_iter {
 	void (*reset)(struct initializer_iter *);
 	struct drgn_error *(*append_designation)(struct initializer_iter *,
 						 struct string_builder *);
+	/*
+	 * Whether the iterator stops before the real end because of a limit,
+	 * in which case an ellipsis is appended after the last initializer.
+	 */
+	bool truncated;
 };
 
+/* Whether we've formatted as much output as we were limited to. */
+static inline bool c_format_bytes_exceeded(struct c_format_state *state,
+					   struct string_builder *sb)
+{
+	return state->max_bytes && sb->written + sb->len >= state->max_bytes;
+}
+
+/*
+ * If we've reached the depth limit, format an initializer as "{...}" without
+ * looking at its members or elements.
+ */
+static bool c_format_depth_exceeded(struct c_format_state *state,
+				    struct string_builder *sb,
+				    struct drgn_error **err)
+{
+	if (!state->max_depth || state->depth < state->max_depth)
+		return false;
+	if (string_builder_append(sb, "{...}"))
+		*err = NULL;
+	else
+		*err = &drgn_enomem;
+	return true;
+}
+
 static struct drgn_error *c_format_initializer(struct drgn_program *prog,
 					       struct initializer_iter *iter,
 					       size_t indent,
 					       size_t one_line_columns,
 					       size_t multi_line_columns,
 					       bool same_line,
+					       struct c_format_state *state,
 					       struct string_builder *sb)
 {
 	struct drgn_error *err;
 	struct drgn_object obj;
 	enum drgn_format_object_flags initializer_flags;
 	size_t brace, remaining_columns, start_columns;
+	struct c_format_mark mark = c_format_mark(state);
 
 	drgn_object_init(&obj, prog);
+	state->depth++;
 
 	/* First, try to fit everything on one line. */
 	brace = sb->len;
@@ -788,12 +949,20 @@ static struct drgn_error *c_format_initializer(struct drgn_program *prog,
 		remaining_columns = 0;
 	for (;;) {
 		size_t initializer_start;
+		bool ellipsis = false;
 
-		err = iter->next(iter, &obj, &initializer_flags);
-		if (err && err->code == DRGN_ERROR_STOP)
-			break;
-		else if (err)
-			goto out;
+		if (c_format_bytes_exceeded(state, sb)) {
+			ellipsis = true;
+		} else {
+			err = iter->next(iter, &obj, &initializer_flags);
+			if (err && err->code == DRGN_ERROR_STOP) {
+				if (!iter->truncated)
+					break;
+				ellipsis = true;
+			} else if (err) {
+				goto out;
+			}
+		}
 
 		if (!same_line) {
 			err = &drgn_line_wrap;
@@ -828,6 +997,20 @@ static struct drgn_error *c_format_initializer(struct drgn_program *prog,
 			remaining_columns -= 2;
 		}
 
+		if (ellipsis) {
+			if (remaining_columns < 3) {
+				err = &drgn_line_wrap;
+				break;
+			}
+			if (!string_builder_append(sb, "...")) {
+				err = &drgn_enomem;
+				goto out;
+			}
+			remaining_columns -= 3;
+			err = NULL;
+			break;
+		}
+
 		if (iter->append_designation) {
 			size_t designation_start = sb->len;
 
@@ -845,7 +1028,7 @@ static struct drgn_error *c_format_initializer(struct drgn_program *prog,
 		initializer_start = sb->len;
 		err = c_format_object_impl(&obj, indent + 1,
 					   remaining_columns - 2, 0,
-					   initializer_flags, sb);
+					   initializer_flags, state, sb);
 		if (err == &drgn_line_wrap)
 			break;
 		else if (err)
@@ -886,6 +1069,7 @@ static struct drgn_error *c_format_initializer(struct drgn_program *prog,
 	}
 
 	sb->len = brace + 1;
+	c_format_rollback(state, mark);
 	if (__builtin_sub_overflow(multi_line_columns, 8 * (indent + 1),
 				   &start_columns))
 		start_columns = 0;
@@ -893,19 +1077,42 @@ static struct drgn_error *c_format_initializer(struct drgn_program *prog,
 	iter->reset(iter);
 	for (;;) {
 		size_t newline, designation_start, line_columns;
+		bool ellipsis = false;
 
-		err = iter->next(iter, &obj, &initializer_flags);
-		if (err && err->code == DRGN_ERROR_STOP)
-			break;
-		else if (err)
+		/*
+		 * Nothing before this point is looked at again, so if we're
+		 * streaming, this is a safe place to write it out.
+		 */
+		err = string_builder_flush(sb, false);
+		if (err)
 			goto out;
 
+		if (c_format_bytes_exceeded(state, sb)) {
+			ellipsis = true;
+		} else {
+			err = iter->next(iter, &obj, &initializer_flags);
+			if (err && err->code == DRGN_ERROR_STOP) {
+				if (!iter->truncated)
+					break;
+				ellipsis = true;
+			} else if (err) {
+				goto out;
+			}
+		}
+
 		newline = sb->len;
 		if (!string_builder_appendc(sb, '\n') ||
 		    !append_tabs(indent + 1, sb)) {
 			err = &drgn_enomem;
 			goto out;
 		}
+		if (ellipsis) {
+			if (!string_builder_append(sb, "...")) {
+				err = &drgn_enomem;
+				goto out;
+			}
+			break;
+		}
 
 		designation_start = sb->len;
 		line_columns = start_columns;
@@ -922,8 +1129,10 @@ static struct drgn_error *c_format_initializer(struct drgn_program *prog,
 		if (line_columns > 1) {
 			size_t initializer_start = sb->len;
 
+			mark = c_format_mark(state);
 			err = c_format_object_impl(&obj, 0, line_columns - 1,
-						   0, initializer_flags, sb);
+						   0, initializer_flags, state,
+						   sb);
 			if (!err) {
 				size_t len = sb->len - designation_start;
 
@@ -959,11 +1168,12 @@ static struct drgn_error *c_format_initializer(struct drgn_program *prog,
 			}
 			/* It didn't fit. */
 			sb->len = initializer_start;
+			c_format_rollback(state, mark);
 		}
 
 		err = c_format_object_impl(&obj, indent + 1, 0,
 					   multi_line_columns,
-					   initializer_flags, sb);
+					   initializer_flags, state, sb);
 		if (err)
 			goto out;
 		if (!string_builder_appendc(sb, ',')) {
@@ -980,6 +1190,7 @@ static struct drgn_error *c_format_initializer(struct drgn_program *prog,
 	}
 	err = NULL;
 out:
+	state->depth--;
 	drgn_object_deinit(&obj);
 	return err;
 }
@@ -989,7 +1200,12 @@ struct compound_initializer_state {
 	uint64_t bit_offset;
 };
 
-DEFINE_VECTOR(compound_initializer_stack, struct compound_initializer_state)
+/*
+ * One entry per level of unnamed member being flattened, so this rarely needs
+ * to allocate.
+ */
+DEFINE_SMALL_VECTOR(compound_initializer_stack,
+		    struct compound_initializer_state, 4)
 
 struct compound_initializer_iter {
 	struct initializer_iter iter;
@@ -1102,6 +1318,7 @@ c_format_compound_object(const struct drgn_object *obj,
 			 struct drgn_type *underlying_type, size_t indent,
 			 size_t one_line_columns, size_t multi_line_columns,
 			 enum drgn_format_object_flags flags,
+			 struct c_format_state *state,
 			 struct string_builder *sb)
 {
 	struct drgn_error *err;
@@ -1140,6 +1357,9 @@ c_format_compound_object(const struct drgn_object *obj,
 					 keyword);
 	}
 
+	if (c_format_depth_exceeded(state, sb, &err))
+		return err;
+
 	compound_initializer_stack_init(&iter.stack);
 	new = compound_initializer_stack_append_entry(&iter.stack);
 	if (!new) {
@@ -1191,7 +1411,7 @@ c_format_compound_object(const struct drgn_object *obj,
 	err = c_format_initializer(obj->prog, &iter.iter, indent,
 				   one_line_columns, multi_line_columns,
 				   flags & DRGN_FORMAT_OBJECT_MEMBERS_SAME_LINE,
-				   sb);
+				   state, sb);
 out:
 	compound_initializer_stack_deinit(&iter.stack);
 	return err;
@@ -1203,51 +1423,148 @@ c_format_enum_object(const struct drgn_object *obj,
 		     struct string_builder *sb)
 {
 	struct drgn_error *err;
-	struct drgn_type_enumerator *enumerators;
-	size_t num_enumerators, i;
+	const struct drgn_type_enumerator *enumerator;
+	bool is_signed;
+	union {
+		int64_t svalue;
+		uint64_t uvalue;
+	} value;
 
 	if (!drgn_type_is_complete(underlying_type)) {
 		return drgn_error_create(DRGN_ERROR_TYPE,
 					 "cannot format incomplete enum object");
 	}
 
-	enumerators = drgn_type_enumerators(underlying_type);
-	num_enumerators = drgn_type_num_enumerators(underlying_type);
-	if (drgn_enum_type_is_signed(underlying_type)) {
-		int64_t svalue;
+	is_signed = drgn_enum_type_is_signed(underlying_type);
+	if (is_signed)
+		err = drgn_object_read_signed(obj, &value.svalue);
+	else
+		err = drgn_object_read_unsigned(obj, &value.uvalue);
+	if (err)
+		return err;
 
-		err = drgn_object_read_signed(obj, &svalue);
-		if (err)
-			return err;
-		for (i = 0; i < num_enumerators; i++) {
-			if (enumerators[i].svalue == svalue) {
-				if (!string_builder_append(sb,
-							   enumerators[i].name))
-					return &drgn_enomem;
-				return NULL;
-			}
-		}
-		if (!string_builder_appendf(sb, "%" PRId64, svalue))
+	err = drgn_type_index_find_enumerator(&obj->prog->tindex,
+					      underlying_type, value.uvalue,
+					      &enumerator);
+	if (!err) {
+		if (!string_builder_append(sb, enumerator->name))
 			return &drgn_enomem;
 		return NULL;
+	} else if (err != &drgn_not_found) {
+		return err;
+	}
+
+	if (is_signed) {
+		if (!string_builder_appendf(sb, "%" PRId64, value.svalue))
+			return &drgn_enomem;
 	} else {
-		uint64_t uvalue;
+		if (!string_builder_appendf(sb, "%" PRIu64, value.uvalue))
+			return &drgn_enomem;
+	}
+	return NULL;
+}
 
-		err = drgn_object_read_unsigned(obj, &uvalue);
-		if (err)
-			return err;
-		for (i = 0; i < num_enumerators; i++) {
-			if (enumerators[i].uvalue == uvalue) {
-				if (!string_builder_append(sb,
-							   enumerators[i].name))
-					return &drgn_enomem;
+/*
+ * Compound and array objects up to this size are read from memory all at once
+ * before they are formatted. Larger arrays are read in chunks of this size.
+ */
+#define C_FORMAT_MAX_READ_SIZE (1024 * 1024)
+/*
+ * If any limits are set, most of a large object may not be formatted, so only
+ * objects up to this size are read all at once, and larger arrays are read in
+ * chunks of this size.
+ */
+#define C_FORMAT_LIMITED_READ_SIZE 4096
+
+/*
+ * Read a compound or array object from memory once instead of once for every
+ * member or element. If *obj is such a reference, it is read into value and
+ * *obj is replaced with value. Arrays larger than C_FORMAT_MAX_READ_SIZE are
+ * left as references and read in chunks by c_format_array_object() instead.
+ */
+static struct drgn_error *
+c_format_read_object(const struct drgn_object **obj, struct drgn_object *value,
+		     struct c_format_state *state)
+{
+	struct drgn_error *err;
+	struct drgn_type *underlying_type;
+	uint64_t size;
+
+	if (!(*obj)->is_reference || (*obj)->kind != DRGN_OBJECT_BUFFER)
+		return NULL;
+	size = drgn_buffer_object_size(*obj);
+	if ((state->max_elements || state->max_depth || state->max_bytes) &&
+	    size > C_FORMAT_LIMITED_READ_SIZE)
+		return NULL;
+	underlying_type = drgn_underlying_type((*obj)->type);
+	switch (drgn_type_kind(underlying_type)) {
+	case DRGN_TYPE_STRUCT:
+	case DRGN_TYPE_UNION:
+	case DRGN_TYPE_CLASS:
+		break;
+	case DRGN_TYPE_ARRAY:
+		if (size > C_FORMAT_MAX_READ_SIZE)
+			return NULL;
+		break;
+	default:
+		return NULL;
+	}
+	err = drgn_object_read(value, *obj);
+	if (err)
+		return err;
+	*obj = value;
+	return NULL;
+}
+
+/*
+ * Decide whether to dereference a pointer. An explicitly requested dereference
+ * is only skipped if the target was already formatted. A pointer is otherwise
+ * followed if it is non-NULL, at most state->follow_pointers pointers deep,
+ * within the dereference size budget, and its target wasn't already
+ * formatted. The target is recorded as formatted if it is dereferenced.
+ */
+static struct drgn_error *
+c_format_follow_pointer(struct drgn_type *underlying_type, uint64_t address,
+			bool explicit, struct c_format_state *state,
+			bool *dereference_ret, bool *visited_ret)
+{
+	struct drgn_error *err;
+	uint64_t size;
+
+	*dereference_ret = explicit;
+	*visited_ret = false;
+	if (!state->follow_pointers)
+		return NULL;
+	if (!explicit &&
+	    (!address || state->pointer_depth >= state->follow_pointers))
+		return NULL;
+	if (c_format_address_set_search(&state->visited, &address).entry) {
+		*dereference_ret = false;
+		*visited_ret = true;
+		return NULL;
+	}
+	if (!explicit) {
+		err = drgn_type_sizeof(drgn_type_type(underlying_type).type,
+				       &size);
+		if (err) {
+			/* Pointers to void, functions, etc. aren't followed. */
+			if (err->code == DRGN_ERROR_TYPE) {
+				drgn_error_destroy(err);
 				return NULL;
 			}
+			return err;
 		}
-		if (!string_builder_appendf(sb, "%" PRIu64, uvalue))
-			return &drgn_enomem;
-		return NULL;
+		if (state->max_dereference_bytes &&
+		    size > state->max_dereference_bytes -
+			   state->dereference_bytes)
+			return NULL;
+		state->dereference_bytes += size;
 	}
+	if (c_format_address_set_insert(&state->visited, &address, NULL) == -1 ||
+	    !c_format_address_vector_append(&state->visited_log, &address))
+		return &drgn_enomem;
+	*dereference_ret = true;
+	return NULL;
 }
 
 static struct drgn_error *
@@ -1256,12 +1573,14 @@ c_format_pointer_object(const struct drgn_object *obj,
 			size_t indent, size_t one_line_columns,
 			size_t multi_line_columns,
 			enum drgn_format_object_flags flags,
+			struct c_format_state *state,
 			struct string_builder *sb)
 {
 	struct drgn_error *err;
 	enum drgn_format_object_flags passthrough_flags =
 		drgn_passthrough_format_object_flags(flags);
-	bool dereference = flags & DRGN_FORMAT_OBJECT_DEREFERENCE;
+	bool explicit = flags & DRGN_FORMAT_OBJECT_DEREFERENCE;
+	bool dereference, visited = false;
 	bool c_string =
 		((flags & DRGN_FORMAT_OBJECT_STRING) &&
 		 is_character_type(drgn_type_type(underlying_type).type));
@@ -1269,28 +1588,31 @@ c_format_pointer_object(const struct drgn_object *obj,
 	uint64_t uvalue;
 	struct drgn_symbol sym;
 	size_t start, type_start, type_end, value_start, value_end;
+	struct c_format_mark mark = c_format_mark(state);
+
+	err = drgn_object_read_unsigned(obj, &uvalue);
+	if (err)
+		return err;
+	if (c_string) {
+		dereference = explicit;
+	} else {
+		err = c_format_follow_pointer(underlying_type, uvalue, explicit,
+					      state, &dereference, &visited);
+		if (err)
+			return err;
+	}
 
 	start = sb->len;
 	if (dereference && !c_string && !string_builder_appendc(sb, '*'))
 		return &drgn_enomem;
 	type_start = sb->len;
 	if (flags & DRGN_FORMAT_OBJECT_TYPE_NAME) {
-		if (!string_builder_appendc(sb, '('))
-			return &drgn_enomem;
-		err = c_format_type_name_impl(drgn_object_qualified_type(obj),
-					      sb);
+		err = c_append_object_type_name(obj, sb);
 		if (err)
 			return err;
-		if (!string_builder_appendc(sb, ')'))
-			return &drgn_enomem;
-
 	}
 	type_end = sb->len;
 
-	err = drgn_object_read_unsigned(obj, &uvalue);
-	if (err)
-		return err;
-
 	have_symbol = ((flags & DRGN_FORMAT_OBJECT_SYMBOLIZE) &&
 		       drgn_program_find_symbol_by_address_internal(obj->prog,
 								    uvalue,
@@ -1307,6 +1629,8 @@ c_format_pointer_object(const struct drgn_object *obj,
 
 	if (!string_builder_appendf(sb, "0x%" PRIx64, uvalue))
 		return &drgn_enomem;
+	if (visited && !string_builder_append(sb, " /* shown above */"))
+		return &drgn_enomem;
 	if (!dereference && !c_string)
 		return NULL;
 	value_end = sb->len;
@@ -1322,6 +1646,8 @@ c_format_pointer_object(const struct drgn_object *obj,
 	} else {
 		struct drgn_object dereferenced;
 
+		const struct drgn_object *target = &dereferenced;
+
 		drgn_object_init(&dereferenced, obj->prog);
 		err = drgn_object_dereference(&dereferenced, obj);
 		if (err) {
@@ -1333,9 +1659,21 @@ c_format_pointer_object(const struct drgn_object *obj,
 		if (__builtin_sub_overflow(one_line_columns, sb->len - start,
 					   &one_line_columns))
 			one_line_columns = 0;
-		err = c_format_object_impl(&dereferenced, indent,
-					   one_line_columns, multi_line_columns,
-					   passthrough_flags, sb);
+		/* We may need to truncate back to the address below. */
+		sb->hold++;
+		if (!explicit)
+			state->pointer_depth++;
+		err = c_format_read_object(&target, &dereferenced, state);
+		if (!err) {
+			err = c_format_object_impl(target, indent,
+						   one_line_columns,
+						   multi_line_columns,
+						   passthrough_flags, state,
+						   sb);
+		}
+		if (!explicit)
+			state->pointer_depth--;
+		sb->hold--;
 		drgn_object_deinit(&dereferenced);
 	}
 	if (!err || (err->code != DRGN_ERROR_FAULT && err->code != DRGN_ERROR_OUT_OF_BOUNDS)) {
@@ -1349,6 +1687,7 @@ no_dereference:
 	 * and truncate everything after the address.
 	 */
 	drgn_error_destroy(err);
+	c_format_rollback(state, mark);
 	if (type_start != start) {
 		memmove(&sb->str[start], &sb->str[type_start],
 			type_end - type_start);
@@ -1368,8 +1707,65 @@ struct array_initializer_iter {
 	uint64_t element_bit_size;
 	uint64_t length, i;
 	enum drgn_format_object_flags flags, element_flags;
+	/*
+	 * If obj is a reference, the chunk of elements [window_start,
+	 * window_end) which was last read into window.
+	 */
+	char *window;
+	uint64_t window_size, window_start, window_end;
 };
 
+/* Get element i of an array, reading it from the current chunk if possible. */
+static struct drgn_error *
+array_initializer_iter_element(struct array_initializer_iter *iter, uint64_t i,
+			       struct drgn_object *obj_ret)
+{
+	struct drgn_error *err;
+	const struct drgn_object *obj = iter->obj;
+	uint64_t element_size, window_length;
+
+	if (!obj->is_reference || obj->kind != DRGN_OBJECT_BUFFER ||
+	    obj->reference.bit_offset || !iter->element_bit_size ||
+	    iter->element_bit_size % 8 ||
+	    iter->element_bit_size / 8 > iter->window_size) {
+		return drgn_object_slice(obj_ret, obj, iter->element_type,
+					 i * iter->element_bit_size, 0);
+	}
+	element_size = iter->element_bit_size / 8;
+
+	if (i < iter->window_start || i >= iter->window_end) {
+		/*
+		 * Align the chunk so that walking backwards (when trimming
+		 * trailing zeroes) reuses it, too.
+		 */
+		window_length = iter->window_size / element_size;
+		iter->window_start = i - i % window_length;
+		iter->window_end = min(iter->window_start + window_length,
+				       iter->length);
+		if (!iter->window) {
+			iter->window = malloc(window_length * element_size);
+			if (!iter->window)
+				return &drgn_enomem;
+		}
+		err = drgn_memory_reader_read(&obj->prog->reader, iter->window,
+					      obj->reference.address +
+					      iter->window_start * element_size,
+					      (iter->window_end -
+					       iter->window_start) *
+					      element_size, false);
+		if (err) {
+			iter->window_start = iter->window_end = 0;
+			return err;
+		}
+	}
+	return drgn_object_set_buffer(obj_ret, iter->element_type,
+				      iter->window +
+				      (i - iter->window_start) * element_size,
+				      0, 0,
+				      obj->reference.little_endian ?
+				      DRGN_LITTLE_ENDIAN : DRGN_BIG_ENDIAN);
+}
+
 static struct drgn_error *
 array_initializer_iter_next(struct initializer_iter *iter_,
 			    struct drgn_object *obj_ret,
@@ -1384,8 +1780,7 @@ array_initializer_iter_next(struct initializer_iter *iter_,
 
 		if (iter->i >= iter->length)
 			return &drgn_stop;
-		err = drgn_object_slice(obj_ret, iter->obj, iter->element_type,
-					iter->i * iter->element_bit_size, 0);
+		err = array_initializer_iter_element(iter, iter->i, obj_ret);
 		if (err)
 			return err;
 		iter->i++;
@@ -1431,7 +1826,7 @@ c_format_array_object(const struct drgn_object *obj,
 		      struct drgn_type *underlying_type, size_t indent,
 		      size_t one_line_columns, size_t multi_line_columns,
 		      enum drgn_format_object_flags flags,
-		      struct string_builder *sb)
+		      struct c_format_state *state, struct string_builder *sb)
 {
 	struct drgn_error *err;
 	struct array_initializer_iter iter = {
@@ -1457,50 +1852,61 @@ c_format_array_object(const struct drgn_object *obj,
 					       iter.length, sb);
 		} else {
 			const unsigned char *buf;
-			uint64_t size, i;
+			bool nul;
 
 			if (!string_builder_appendc(sb, '"'))
 				return &drgn_enomem;
 			buf = (const unsigned char *)drgn_object_buffer(obj);
-			size = drgn_buffer_object_size(obj);
-			for (i = 0; i < size; i++) {
-				if (buf[i] == '\0')
-					break;
-				err = c_format_character(buf[i], false, true,
-							 sb);
-				if (err)
-					return err;
-			}
+			err = c_format_string_characters(buf,
+							 drgn_buffer_object_size(obj),
+							 sb, &nul);
+			if (err)
+				return err;
 			if (!string_builder_appendc(sb, '"'))
 				return &drgn_enomem;
 			return NULL;
 		}
 	}
 
+	if (c_format_depth_exceeded(state, sb, &err))
+		return err;
+
 	err = drgn_type_bit_size(iter.element_type.type,
 				 &iter.element_bit_size);
 	if (err)
 		return err;
 
+	/*
+	 * Don't look at elements past the limit at all, so that we don't read
+	 * them from memory.
+	 */
+	if (state->max_elements || state->max_depth || state->max_bytes)
+		iter.window_size = C_FORMAT_LIMITED_READ_SIZE;
+	else
+		iter.window_size = C_FORMAT_MAX_READ_SIZE;
+	if (state->max_elements && iter.length > state->max_elements) {
+		iter.length = state->max_elements;
+		iter.iter.truncated = true;
+	}
+
 	/*
 	 * If we don't want zero elements, ignore any at the end. If we're
 	 * including indices, then we'll skip past zeroes as we iterate, so we
-	 * don't need to do this.
+	 * don't need to do this. If we truncated the array, then the elements
+	 * at the end aren't the real end.
 	 */
 	if (!(flags & (DRGN_FORMAT_OBJECT_ELEMENT_INDICES |
 		       DRGN_FORMAT_OBJECT_IMPLICIT_ELEMENTS)) &&
-	    iter.length) {
+	    !iter.iter.truncated && iter.length) {
 		struct drgn_object element;
 
 		drgn_object_init(&element, obj->prog);
 		do {
 			bool zero;
 
-			err = drgn_object_slice(&element, obj,
-						iter.element_type,
-						(iter.length - 1) *
-						iter.element_bit_size,
-						0);
+			err = array_initializer_iter_element(&iter,
+							     iter.length - 1,
+							     &element);
 			if (err)
 				break;
 
@@ -1514,12 +1920,15 @@ c_format_array_object(const struct drgn_object *obj,
 		} while (iter.length);
 		drgn_object_deinit(&element);
 		if (err)
-			return err;
+			goto out;
 	}
-	return c_format_initializer(obj->prog, &iter.iter, indent,
-				    one_line_columns, multi_line_columns,
-				    flags & DRGN_FORMAT_OBJECT_ELEMENTS_SAME_LINE,
-				    sb);
+	err = c_format_initializer(obj->prog, &iter.iter, indent,
+				   one_line_columns, multi_line_columns,
+				   flags & DRGN_FORMAT_OBJECT_ELEMENTS_SAME_LINE,
+				   state, sb);
+out:
+	free(iter.window);
+	return err;
 }
 
 static struct drgn_error *
@@ -1540,7 +1949,7 @@ static struct drgn_error *
 c_format_object_impl(const struct drgn_object *obj, size_t indent,
 		     size_t one_line_columns, size_t multi_line_columns,
 		     enum drgn_format_object_flags flags,
-		     struct string_builder *sb)
+		     struct c_format_state *state, struct string_builder *sb)
 {
 	struct drgn_error *err;
 	struct drgn_type *underlying_type = drgn_underlying_type(obj->type);
@@ -1552,20 +1961,16 @@ c_format_object_impl(const struct drgn_object *obj, size_t indent,
 	if (drgn_type_kind(underlying_type) == DRGN_TYPE_POINTER) {
 		return c_format_pointer_object(obj, underlying_type, indent,
 					       one_line_columns,
-					       multi_line_columns, flags, sb);
+					       multi_line_columns, flags, state,
+					       sb);
 	}
 
 	if (flags & DRGN_FORMAT_OBJECT_TYPE_NAME) {
 		size_t old_len = sb->len;
 
-		if (!string_builder_appendc(sb, '('))
-			return &drgn_enomem;
-		err = c_format_type_name_impl(drgn_object_qualified_type(obj),
-					      sb);
+		err = c_append_object_type_name(obj, sb);
 		if (err)
 			return err;
-		if (!string_builder_appendc(sb, ')'))
-			return &drgn_enomem;
 
 		if (__builtin_sub_overflow(one_line_columns, sb->len - old_len,
 					   &one_line_columns))
@@ -1589,13 +1994,15 @@ c_format_object_impl(const struct drgn_object *obj, size_t indent,
 	case DRGN_TYPE_CLASS:
 		return c_format_compound_object(obj, underlying_type, indent,
 						one_line_columns,
-						multi_line_columns, flags, sb);
+						multi_line_columns, flags,
+						state, sb);
 	case DRGN_TYPE_ENUM:
 		return c_format_enum_object(obj, underlying_type, sb);
 	case DRGN_TYPE_ARRAY:
 		return c_format_array_object(obj, underlying_type, indent,
 					     one_line_columns,
-					     multi_line_columns, flags, sb);
+					     multi_line_columns, flags, state,
+					     sb);
 	case DRGN_TYPE_FUNCTION:
 		return c_format_function_object(obj, sb);
 	default:
@@ -1603,23 +2010,466 @@ c_format_object_impl(const struct drgn_object *obj, size_t indent,
 	}
 }
 
-struct drgn_error *c_format_object(const struct drgn_object *obj,
-				   size_t columns,
-				   enum drgn_format_object_flags flags,
-				   char **ret)
+static struct drgn_error *
+c_format_object_sb(const struct drgn_object *obj, size_t columns,
+		   enum drgn_format_object_flags flags,
+		   const struct drgn_format_object_limits *limits,
+		   struct string_builder *sb)
 {
 	struct drgn_error *err;
-	struct string_builder sb = {};
+	struct c_format_state state = {};
+	struct drgn_object value;
+
+	if (limits) {
+		state.max_elements = limits->max_elements;
+		state.max_depth = limits->max_depth;
+		state.max_bytes = limits->max_bytes;
+		state.follow_pointers = limits->follow_pointers;
+		state.max_dereference_bytes = limits->max_dereference_bytes;
+	}
+	c_format_address_set_init(&state.visited);
+	c_format_address_vector_init(&state.visited_log);
+	/* Pointers back to the object itself are cycles, too. */
+	if (state.follow_pointers && obj->is_reference &&
+	    drgn_type_kind(drgn_underlying_type(obj->type)) !=
+	    DRGN_TYPE_POINTER &&
+	    c_format_address_set_insert(&state.visited,
+					&obj->reference.address, NULL) == -1) {
+		err = &drgn_enomem;
+		goto out;
+	}
 
-	err = c_format_object_impl(obj, 0, columns, max(columns, (size_t)1),
-				   flags, &sb);
-	if (err) {
-		free(sb.str);
-		return err;
+	drgn_object_init(&value, obj->prog);
+	err = c_format_read_object(&obj, &value, &state);
+	if (!err) {
+		err = c_format_object_impl(obj, 0, columns,
+					   max(columns, (size_t)1), flags,
+					   &state, sb);
 	}
-	if (!string_builder_finalize(&sb, ret))
-		return &drgn_enomem;
-	return NULL;
+	drgn_object_deinit(&value);
+out:
+	c_format_address_vector_deinit(&state.visited_log);
+	c_format_address_set_deinit(&state.visited);
+	return err;
+}
+
+struct drgn_error *
+c_format_object(const struct drgn_object *obj, size_t columns,
+		enum drgn_format_object_flags flags,
+		const struct drgn_format_object_limits *limits, char **ret)
+{
+	struct drgn_error *err;
+	struct string_builder sb;
+
+	string_builder_init_scratch(&sb);
+	err = c_format_object_sb(obj, columns, flags, limits, &sb);
+	if (err) {
+		string_builder_release_scratch(&sb);
+		return err;
+	}
+	if (!string_builder_finalize_scratch(&sb, ret))
+		return &drgn_enomem;
+	return NULL;
+}
+
+struct drgn_error *
+c_format_object_stream(const struct drgn_object *obj, size_t columns,
+		       enum drgn_format_object_flags flags,
+		       const struct drgn_format_object_limits *limits,
+		       drgn_format_object_write_fn *write, void *arg)
+{
+	struct drgn_error *err;
+	struct string_builder sb;
+
+	string_builder_init_scratch(&sb);
+	sb.write = write;
+	sb.write_arg = arg;
+	err = c_format_object_sb(obj, columns, flags, limits, &sb);
+	if (!err)
+		err = string_builder_flush(&sb, true);
+	string_builder_release_scratch(&sb);
+	return err;
+}
+
+static bool c_json_append_string(const char *s, struct string_builder *sb)
+{
+	if (!string_builder_appendc(sb, '"'))
+		return false;
+	for (; *s; s++) {
+		unsigned char c = *s;
+		bool ret;
+
+		if (c == '"' || c == '\\')
+			ret = string_builder_appendf(sb, "\\%c", c);
+		else if (c < 0x20)
+			ret = string_builder_appendf(sb, "\\u%04x", c);
+		else
+			ret = string_builder_appendc(sb, c);
+		if (!ret)
+			return false;
+	}
+	return string_builder_appendc(sb, '"');
+}
+
+static struct drgn_error *
+c_format_json_node(const struct drgn_object *obj, const char *name,
+		   bool is_member, bool has_address, uint64_t address,
+		   struct c_format_state *state, struct string_builder *sb);
+
+static struct drgn_error *
+c_format_json_compound(const struct drgn_object *obj,
+		       struct drgn_type *underlying_type, bool has_address,
+		       uint64_t address, struct c_format_state *state,
+		       struct string_builder *sb, bool *truncated)
+{
+	struct drgn_error *err;
+	struct compound_initializer_iter iter = {
+		.iter = {
+			.next = compound_initializer_iter_next,
+		},
+		.obj = obj,
+		/* Flatten unnamed members and don't skip zeroes. */
+		.flags = (DRGN_FORMAT_OBJECT_MEMBER_NAMES |
+			  DRGN_FORMAT_OBJECT_IMPLICIT_MEMBERS),
+	};
+	struct compound_initializer_state *new;
+	struct drgn_object member;
+	bool first = true;
+
+	compound_initializer_stack_init(&iter.stack);
+	new = compound_initializer_stack_append_entry(&iter.stack);
+	if (!new) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	new->member = drgn_type_members(underlying_type);
+	new->end = new->member + drgn_type_num_members(underlying_type);
+	new->bit_offset = 0;
+
+	drgn_object_init(&member, obj->prog);
+	if (!string_builder_appendc(sb, '[')) {
+		err = &drgn_enomem;
+		goto out_member;
+	}
+	for (;;) {
+		enum drgn_format_object_flags member_flags;
+		struct compound_initializer_state *top;
+		struct drgn_type_member *type_member;
+		uint64_t bit_offset;
+
+		if (c_format_bytes_exceeded(state, sb)) {
+			*truncated = true;
+			break;
+		}
+		err = iter.iter.next(&iter.iter, &member, &member_flags);
+		if (err == &drgn_stop)
+			break;
+		else if (err)
+			goto out_member;
+
+		top = &iter.stack.data[iter.stack.size - 1];
+		type_member = &top->member[-1];
+		bit_offset = top->bit_offset + type_member->bit_offset;
+		if (!first && !string_builder_appendc(sb, ',')) {
+			err = &drgn_enomem;
+			goto out_member;
+		}
+		first = false;
+		err = c_format_json_node(&member, type_member->name, true,
+					 has_address && bit_offset % 8 == 0 &&
+					 !type_member->bit_field_size,
+					 address + bit_offset / 8, state, sb);
+		if (err)
+			goto out_member;
+	}
+	err = string_builder_appendc(sb, ']') ? NULL : &drgn_enomem;
+out_member:
+	drgn_object_deinit(&member);
+out:
+	compound_initializer_stack_deinit(&iter.stack);
+	return err;
+}
+
+static struct drgn_error *
+c_format_json_array(const struct drgn_object *obj,
+		    struct drgn_type *underlying_type, bool has_address,
+		    uint64_t address, struct c_format_state *state,
+		    struct string_builder *sb, bool *truncated)
+{
+	struct drgn_error *err;
+	struct array_initializer_iter iter = {
+		.iter = {
+			.next = array_initializer_iter_next,
+		},
+		.obj = obj,
+		.element_type = drgn_type_type(underlying_type),
+		.length = drgn_type_length(underlying_type),
+		/* Don't skip zeroes. */
+		.flags = DRGN_FORMAT_OBJECT_IMPLICIT_ELEMENTS,
+	};
+	struct drgn_object element;
+
+	err = drgn_type_bit_size(iter.element_type.type,
+				 &iter.element_bit_size);
+	if (err)
+		return err;
+	if (state->max_elements || state->max_depth || state->max_bytes)
+		iter.window_size = C_FORMAT_LIMITED_READ_SIZE;
+	else
+		iter.window_size = C_FORMAT_MAX_READ_SIZE;
+	if (state->max_elements && iter.length > state->max_elements) {
+		iter.length = state->max_elements;
+		*truncated = true;
+	}
+	has_address = has_address && iter.element_bit_size % 8 == 0;
+
+	drgn_object_init(&element, obj->prog);
+	if (!string_builder_appendc(sb, '[')) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	for (;;) {
+		enum drgn_format_object_flags element_flags;
+
+		if (c_format_bytes_exceeded(state, sb)) {
+			*truncated = true;
+			break;
+		}
+		err = iter.iter.next(&iter.iter, &element, &element_flags);
+		if (err == &drgn_stop)
+			break;
+		else if (err)
+			goto out;
+		if (iter.i > 1 && !string_builder_appendc(sb, ',')) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		err = c_format_json_node(&element, NULL, false, has_address,
+					 address + (iter.i - 1) *
+					 (iter.element_bit_size / 8),
+					 state, sb);
+		if (err)
+			goto out;
+	}
+	err = string_builder_appendc(sb, ']') ? NULL : &drgn_enomem;
+out:
+	drgn_object_deinit(&element);
+	free(iter.window);
+	return err;
+}
+
+/*
+ * Append the "value" of a JSON node, followed by any other keys which depend
+ * on it.
+ */
+static struct drgn_error *
+c_format_json_value(const struct drgn_object *obj, bool has_address,
+		    uint64_t address, struct c_format_state *state,
+		    struct string_builder *sb)
+{
+	struct drgn_error *err;
+	struct drgn_type *underlying_type = drgn_underlying_type(obj->type);
+	const struct drgn_type_enumerator *enumerator;
+	union drgn_value value;
+	double fvalue;
+	bool truncated = false;
+
+	switch (drgn_type_kind(underlying_type)) {
+	case DRGN_TYPE_VOID:
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "cannot format void object");
+	case DRGN_TYPE_INT:
+	case DRGN_TYPE_BOOL:
+	case DRGN_TYPE_POINTER:
+		err = drgn_object_read_integer(obj, &value);
+		if (err)
+			return err;
+		if (drgn_type_kind(underlying_type) == DRGN_TYPE_BOOL) {
+			if (!string_builder_append(sb,
+						   value.uvalue ? "true" : "false"))
+				return &drgn_enomem;
+		} else if (obj->kind == DRGN_OBJECT_SIGNED) {
+			if (!string_builder_appendf(sb, "%" PRId64,
+						    value.svalue))
+				return &drgn_enomem;
+		} else {
+			if (!string_builder_appendf(sb, "%" PRIu64,
+						    value.uvalue))
+				return &drgn_enomem;
+		}
+		return NULL;
+	case DRGN_TYPE_FLOAT:
+		err = drgn_object_read_float(obj, &fvalue);
+		if (err)
+			return err;
+		/* JSON can't represent infinity or NaN. */
+		if (isfinite(fvalue)) {
+			if (!string_builder_appendf(sb, "%.*g", DBL_DECIMAL_DIG,
+						    fvalue))
+				return &drgn_enomem;
+		} else if (!string_builder_append(sb, "null")) {
+			return &drgn_enomem;
+		}
+		return NULL;
+	case DRGN_TYPE_COMPLEX:
+		return drgn_error_format(DRGN_ERROR_TYPE,
+					 "complex object formatting is not implemented");
+	case DRGN_TYPE_ENUM:
+		if (!drgn_type_is_complete(underlying_type)) {
+			return drgn_error_create(DRGN_ERROR_TYPE,
+						 "cannot format incomplete enum object");
+		}
+		err = drgn_object_read_integer(obj, &value);
+		if (err)
+			return err;
+		if (obj->kind == DRGN_OBJECT_SIGNED) {
+			if (!string_builder_appendf(sb, "%" PRId64,
+						    value.svalue))
+				return &drgn_enomem;
+		} else {
+			if (!string_builder_appendf(sb, "%" PRIu64,
+						    value.uvalue))
+				return &drgn_enomem;
+		}
+		err = drgn_type_index_find_enumerator(&obj->prog->tindex,
+						      underlying_type,
+						      value.uvalue,
+						      &enumerator);
+		if (!err) {
+			if (!string_builder_append(sb, ",\"enumerator\":") ||
+			    !c_json_append_string(enumerator->name, sb))
+				return &drgn_enomem;
+		} else if (err != &drgn_not_found) {
+			return err;
+		}
+		return NULL;
+	case DRGN_TYPE_STRUCT:
+	case DRGN_TYPE_UNION:
+	case DRGN_TYPE_CLASS:
+	case DRGN_TYPE_ARRAY:
+		if (drgn_type_kind(underlying_type) != DRGN_TYPE_ARRAY &&
+		    !drgn_type_is_complete(underlying_type)) {
+			return drgn_error_create(DRGN_ERROR_TYPE,
+						 "cannot format incomplete object");
+		}
+		if (state->max_depth && state->depth >= state->max_depth) {
+			if (!string_builder_append(sb, "null,\"truncated\":true"))
+				return &drgn_enomem;
+			return NULL;
+		}
+		state->depth++;
+		if (drgn_type_kind(underlying_type) == DRGN_TYPE_ARRAY) {
+			err = c_format_json_array(obj, underlying_type,
+						  has_address, address, state,
+						  sb, &truncated);
+		} else {
+			err = c_format_json_compound(obj, underlying_type,
+						     has_address, address,
+						     state, sb, &truncated);
+		}
+		state->depth--;
+		if (err)
+			return err;
+		if (truncated && !string_builder_append(sb, ",\"truncated\":true"))
+			return &drgn_enomem;
+		return NULL;
+	case DRGN_TYPE_FUNCTION:
+		if (!string_builder_append(sb, "null"))
+			return &drgn_enomem;
+		return NULL;
+	default:
+		UNREACHABLE();
+	}
+}
+
+static struct drgn_error *
+c_format_json_node(const struct drgn_object *obj, const char *name,
+		   bool is_member, bool has_address, uint64_t address,
+		   struct c_format_state *state, struct string_builder *sb)
+{
+	struct drgn_error *err;
+	const char *type_name;
+
+	if (!string_builder_appendc(sb, '{'))
+		return &drgn_enomem;
+	if (is_member) {
+		if (!string_builder_append(sb, "\"name\":"))
+			return &drgn_enomem;
+		if (name) {
+			if (!c_json_append_string(name, sb))
+				return &drgn_enomem;
+		} else if (!string_builder_append(sb, "null")) {
+			return &drgn_enomem;
+		}
+		if (!string_builder_appendc(sb, ','))
+			return &drgn_enomem;
+	}
+
+	err = drgn_type_index_format_type_name(&obj->prog->tindex,
+					       drgn_object_qualified_type(obj),
+					       &type_name);
+	if (err)
+		return err;
+	if (!string_builder_append(sb, "\"type\":") ||
+	    !c_json_append_string(type_name, sb) ||
+	    !string_builder_append(sb, ",\"address\":"))
+		return &drgn_enomem;
+	if (has_address) {
+		if (!string_builder_appendf(sb, "%" PRIu64, address))
+			return &drgn_enomem;
+	} else if (!string_builder_append(sb, "null")) {
+		return &drgn_enomem;
+	}
+	if (!string_builder_append(sb, ",\"value\":"))
+		return &drgn_enomem;
+	err = c_format_json_value(obj, has_address, address, state, sb);
+	if (err)
+		return err;
+	if (!string_builder_appendc(sb, '}'))
+		return &drgn_enomem;
+	return NULL;
+}
+
+struct drgn_error *
+c_format_object_json(const struct drgn_object *obj,
+		     const struct drgn_format_object_limits *limits, char **ret)
+{
+	struct drgn_error *err;
+	struct c_format_state state = {};
+	struct string_builder sb;
+	struct drgn_object value;
+	bool has_address;
+	uint64_t address;
+
+	if (limits) {
+		state.max_elements = limits->max_elements;
+		state.max_depth = limits->max_depth;
+		state.max_bytes = limits->max_bytes;
+	}
+
+	/*
+	 * Reading the object replaces it with a value, so remember where it
+	 * came from first. Addresses of members and elements are derived from
+	 * this.
+	 */
+	has_address = (obj->is_reference && !obj->reference.bit_offset &&
+		       !obj->is_bit_field);
+	address = obj->is_reference ? obj->reference.address : 0;
+	string_builder_init_scratch(&sb);
+	drgn_object_init(&value, obj->prog);
+	err = c_format_read_object(&obj, &value, &state);
+	if (!err) {
+		err = c_format_json_node(obj, NULL, false, has_address,
+					 address, &state, &sb);
+	}
+	drgn_object_deinit(&value);
+	if (err) {
+		string_builder_release_scratch(&sb);
+		return err;
+	}
+	if (!string_builder_finalize_scratch(&sb, ret))
+		return &drgn_enomem;
+	return NULL;
 }
 
 /* This obviously incomplete since we only handle the tokens we care about. */
@@ -1655,6 +2505,27 @@ enum {
 	C_TOKEN_RBRACKET,
 	C_TOKEN_ASTERISK,
 	C_TOKEN_DOT,
+	/* The following are only used in expressions. */
+	C_TOKEN_ARROW,
+	C_TOKEN_AMPERSAND,
+	C_TOKEN_PLUS,
+	C_TOKEN_MINUS,
+	C_TOKEN_SLASH,
+	C_TOKEN_PERCENT,
+	C_TOKEN_TILDE,
+	C_TOKEN_EXCLAMATION,
+	C_TOKEN_LSHIFT,
+	C_TOKEN_RSHIFT,
+	C_TOKEN_LT,
+	C_TOKEN_LE,
+	C_TOKEN_GT,
+	C_TOKEN_GE,
+	C_TOKEN_EQ,
+	C_TOKEN_NE,
+	C_TOKEN_CARET,
+	C_TOKEN_PIPE,
+	C_TOKEN_AND_AND,
+	C_TOKEN_OR_OR,
 	C_TOKEN_NUMBER,
 	C_TOKEN_IDENTIFIER,
 };
@@ -1742,6 +2613,94 @@ struct drgn_error *drgn_lexer_c(struct drgn_lexer *lexer,
 		token->kind = C_TOKEN_DOT;
 		p++;
 		break;
+	case '-':
+		if (p[1] == '>') {
+			token->kind = C_TOKEN_ARROW;
+			p += 2;
+		} else {
+			token->kind = C_TOKEN_MINUS;
+			p++;
+		}
+		break;
+	case '&':
+		if (p[1] == '&') {
+			token->kind = C_TOKEN_AND_AND;
+			p += 2;
+		} else {
+			token->kind = C_TOKEN_AMPERSAND;
+			p++;
+		}
+		break;
+	case '|':
+		if (p[1] == '|') {
+			token->kind = C_TOKEN_OR_OR;
+			p += 2;
+		} else {
+			token->kind = C_TOKEN_PIPE;
+			p++;
+		}
+		break;
+	case '<':
+		if (p[1] == '<') {
+			token->kind = C_TOKEN_LSHIFT;
+			p += 2;
+		} else if (p[1] == '=') {
+			token->kind = C_TOKEN_LE;
+			p += 2;
+		} else {
+			token->kind = C_TOKEN_LT;
+			p++;
+		}
+		break;
+	case '>':
+		if (p[1] == '>') {
+			token->kind = C_TOKEN_RSHIFT;
+			p += 2;
+		} else if (p[1] == '=') {
+			token->kind = C_TOKEN_GE;
+			p += 2;
+		} else {
+			token->kind = C_TOKEN_GT;
+			p++;
+		}
+		break;
+	case '=':
+		if (p[1] != '=') {
+			return drgn_error_create(DRGN_ERROR_SYNTAX,
+						 "assignment is not supported");
+		}
+		token->kind = C_TOKEN_EQ;
+		p += 2;
+		break;
+	case '!':
+		if (p[1] == '=') {
+			token->kind = C_TOKEN_NE;
+			p += 2;
+		} else {
+			token->kind = C_TOKEN_EXCLAMATION;
+			p++;
+		}
+		break;
+	case '+':
+		token->kind = C_TOKEN_PLUS;
+		p++;
+		break;
+	case '/':
+		token->kind = C_TOKEN_SLASH;
+		p++;
+		break;
+	case '%':
+		token->kind = C_TOKEN_PERCENT;
+		p++;
+		break;
+	case '~':
+		token->kind = C_TOKEN_TILDE;
+		p++;
+		break;
+	case '^':
+		token->kind = C_TOKEN_CARET;
+		p++;
+		break;
 	default:
 		if (isalpha(*p) || *p == '_') {
 			struct string key;
@@ -1805,9 +2764,9 @@ static struct drgn_error *c_token_to_u64(const struct drgn_token *token,
 			if ('0' <= c && c <= '9')
 				digit = c - '0';
 			else if ('a' <= c && c <= 'f')
-				digit = c - 'a';
+				digit = c - 'a' + 10;
 			else /* ('A' <= c && c <= 'F') */
-				digit = c - 'A';
+				digit = c - 'A' + 10;
 			if (x > UINT64_MAX / 16)
 				goto overflow;
 			x *= 16;
@@ -2498,55 +3457,66 @@ c_type_from_declarator(struct drgn_type_index *tindex,
 	return err;
 }
 
-struct drgn_error *c_find_type(struct drgn_type_index *tindex, const char *name,
-			       const char *filename,
-			       struct drgn_qualified_type *ret)
+/*
+ * Parse a type name (a specifier-qualifier-list followed by an optional
+ * abstract-declarator). This stops at the first token which can't continue the
+ * type name.
+ */
+static struct drgn_error *c_parse_type_name(struct drgn_type_index *tindex,
+					    struct drgn_lexer *lexer,
+					    const char *filename,
+					    struct drgn_qualified_type *ret)
 {
 	struct drgn_error *err;
-	struct drgn_lexer lexer;
 	struct drgn_token token;
+	struct c_declarator *outer = NULL, *inner;
 
-	drgn_lexer_init(&lexer, drgn_lexer_c, name);
-
-	err = c_parse_specifier_qualifier_list(tindex, &lexer, filename, ret);
+	err = c_parse_specifier_qualifier_list(tindex, lexer, filename, ret);
 	if (err)
-		goto out;
+		return err;
 
-	err = drgn_lexer_pop(&lexer, &token);
+	err = drgn_lexer_peek(lexer, &token);
 	if (err)
-		goto out;
-	if (token.kind != C_TOKEN_EOF) {
-		struct c_declarator *outer = NULL, *inner;
-
-		err = drgn_lexer_push(&lexer, &token);
-		if (err)
-			return err;
+		return err;
+	if (token.kind != C_TOKEN_ASTERISK && token.kind != C_TOKEN_LPAREN &&
+	    token.kind != C_TOKEN_LBRACKET)
+		return NULL;
 
-		err = c_parse_abstract_declarator(tindex, &lexer, &outer,
-						  &inner);
-		if (err) {
-			while (outer) {
-				struct c_declarator *next;
+	err = c_parse_abstract_declarator(tindex, lexer, &outer, &inner);
+	if (err) {
+		while (outer) {
+			struct c_declarator *next;
 
-				next = outer->next;
-				free(outer);
-				outer = next;
-			}
-			goto out;
+			next = outer->next;
+			free(outer);
+			outer = next;
 		}
+		return err;
+	}
+	return c_type_from_declarator(tindex, outer, ret);
+}
 
-		err = c_type_from_declarator(tindex, outer, ret);
-		if (err)
-			goto out;
+struct drgn_error *c_find_type(struct drgn_type_index *tindex, const char *name,
+			       const char *filename,
+			       struct drgn_qualified_type *ret)
+{
+	struct drgn_error *err;
+	struct drgn_lexer lexer;
+	struct drgn_token token;
 
-		err = drgn_lexer_pop(&lexer, &token);
-		if (err)
-			goto out;
-		if (token.kind != C_TOKEN_EOF) {
-			err = drgn_error_create(DRGN_ERROR_SYNTAX,
-						"extra tokens after type name");
-			goto out;
-		}
+	drgn_lexer_init(&lexer, drgn_lexer_c, name);
+
+	err = c_parse_type_name(tindex, &lexer, filename, ret);
+	if (err)
+		goto out;
+
+	err = drgn_lexer_pop(&lexer, &token);
+	if (err)
+		goto out;
+	if (token.kind != C_TOKEN_EOF) {
+		err = drgn_error_create(DRGN_ERROR_SYNTAX,
+					"extra tokens after type name");
+		goto out;
 	}
 
 	err = NULL;
@@ -2555,14 +3525,16 @@ out:
 	return err;
 }
 
-struct drgn_error *c_bit_offset(struct drgn_program *prog,
-				struct drgn_type *type,
-				const char *member_designator, uint64_t *ret)
+struct drgn_error *c_member_path(struct drgn_program *prog,
+				 struct drgn_type *type,
+				 const char *member_designator,
+				 struct drgn_member_info *ret)
 {
 	struct drgn_error *err;
 	struct drgn_lexer lexer;
 	int state = INT_MIN;
-	uint64_t bit_offset = 0;
+	struct drgn_qualified_type qualified_type = { type };
+	uint64_t bit_offset = 0, bit_field_size = 0;
 
 	drgn_lexer_init(&lexer, drgn_lexer_c, member_designator);
 
@@ -2577,28 +3549,27 @@ struct drgn_error *c_bit_offset(struct drgn_program *prog,
 		case INT_MIN:
 		case C_TOKEN_DOT:
 			if (token.kind == C_TOKEN_IDENTIFIER) {
-				struct drgn_member_value *member;
-				struct drgn_qualified_type member_type;
+				struct drgn_member_value member;
 
 				err = drgn_type_index_find_member(&prog->tindex,
-								  type,
+								  qualified_type.type,
 								  token.value,
 								  token.len,
 								  &member);
 				if (err)
 					goto out;
 				if (__builtin_add_overflow(bit_offset,
-							   member->bit_offset,
+							   member.bit_offset,
 							   &bit_offset)) {
 					err = drgn_error_create(DRGN_ERROR_OVERFLOW,
 								"offset is too large");
 					goto out;
 				}
-				err = drgn_lazy_type_evaluate(member->type,
-							      &member_type);
+				err = drgn_lazy_type_evaluate(member.type,
+							      &qualified_type);
 				if (err)
 					goto out;
-				type = member_type.type;
+				bit_field_size = member.bit_field_size;
 			} else if (state == C_TOKEN_DOT) {
 				err = drgn_error_create(DRGN_ERROR_SYNTAX,
 							"expected identifier after '.'");
@@ -2613,7 +3584,9 @@ struct drgn_error *c_bit_offset(struct drgn_program *prog,
 		case C_TOKEN_RBRACKET:
 			switch (token.kind) {
 			case C_TOKEN_EOF:
-				*ret = bit_offset;
+				ret->qualified_type = qualified_type;
+				ret->bit_offset = bit_offset;
+				ret->bit_field_size = bit_field_size;
 				err = NULL;
 				goto out;
 			case C_TOKEN_DOT:
@@ -2634,22 +3607,22 @@ struct drgn_error *c_bit_offset(struct drgn_program *prog,
 		case C_TOKEN_LBRACKET:
 			if (token.kind == C_TOKEN_NUMBER) {
 				struct drgn_type *underlying_type;
-				struct drgn_type *element_type;
+				struct drgn_qualified_type element_type;
 				uint64_t index, bit_size, element_offset;
 
 				err = c_token_to_u64(&token, &index);
 				if (err)
 					goto out;
 
-				underlying_type = drgn_underlying_type(type);
+				underlying_type =
+					drgn_underlying_type(qualified_type.type);
 				if (drgn_type_kind(underlying_type) != DRGN_TYPE_ARRAY) {
-					err = drgn_type_error("'%s' is not an array",
-							      type);
+					err = drgn_qualified_type_error("'%s' is not an array",
+									qualified_type);
 					goto out;
 				}
-				element_type =
-					drgn_type_type(underlying_type).type;
-				err = drgn_type_bit_size(element_type,
+				element_type = drgn_type_type(underlying_type);
+				err = drgn_type_bit_size(element_type.type,
 							 &bit_size);
 				if (err)
 					goto out;
@@ -2662,7 +3635,8 @@ struct drgn_error *c_bit_offset(struct drgn_program *prog,
 								"offset is too large");
 					goto out;
 				}
-				type = element_type;
+				qualified_type = element_type;
+				bit_field_size = 0;
 			} else {
 				err = drgn_error_create(DRGN_ERROR_SYNTAX,
 							"expected number after '['");
@@ -2687,6 +3661,698 @@ out:
 	return err;
 }
 
+enum c_expr_kind {
+	/* Variable bound at evaluation time. */
+	C_EXPR_VARIABLE,
+	/* Object found in the program at compile time. */
+	C_EXPR_OBJECT,
+	C_EXPR_NUMBER,
+	C_EXPR_MEMBER,
+	C_EXPR_MEMBER_DEREFERENCE,
+	C_EXPR_SUBSCRIPT,
+	C_EXPR_CAST,
+	C_EXPR_ADDRESS_OF,
+	C_EXPR_UNARY,
+	C_EXPR_LOGICAL_NOT,
+	C_EXPR_BINARY,
+	C_EXPR_CMP,
+	C_EXPR_LOGICAL_AND,
+	C_EXPR_LOGICAL_OR,
+};
+
+struct c_expr {
+	enum c_expr_kind kind;
+	/* Operands; rhs is only used by binary expressions. */
+	struct c_expr *lhs, *rhs;
+	union {
+		/* C_EXPR_VARIABLE. */
+		size_t variable;
+		/* C_EXPR_OBJECT. */
+		struct drgn_object object;
+		/* C_EXPR_NUMBER. */
+		uint64_t number;
+		/* C_EXPR_MEMBER and C_EXPR_MEMBER_DEREFERENCE. */
+		char *member;
+		/* C_EXPR_CAST. */
+		struct drgn_qualified_type type;
+		/* C_EXPR_UNARY. */
+		drgn_unary_op *unary_op;
+		/* C_EXPR_BINARY. */
+		drgn_binary_op *binary_op;
+		/* C_EXPR_CMP: the comparison token. */
+		int cmp;
+	};
+};
+
+struct c_expression {
+	struct drgn_expression expr;
+	struct c_expr *root;
+};
+
+static void c_expr_destroy(struct c_expr *node)
+{
+	if (!node)
+		return;
+	c_expr_destroy(node->lhs);
+	c_expr_destroy(node->rhs);
+	if (node->kind == C_EXPR_OBJECT)
+		drgn_object_deinit(&node->object);
+	else if (node->kind == C_EXPR_MEMBER ||
+		 node->kind == C_EXPR_MEMBER_DEREFERENCE)
+		free(node->member);
+	free(node);
+}
+
+static struct drgn_error *c_expr_create(enum c_expr_kind kind,
+					struct c_expr *lhs, struct c_expr *rhs,
+					struct c_expr **ret)
+{
+	struct c_expr *node;
+
+	node = calloc(1, sizeof(*node));
+	if (!node) {
+		c_expr_destroy(lhs);
+		c_expr_destroy(rhs);
+		return &drgn_enomem;
+	}
+	node->kind = kind;
+	node->lhs = lhs;
+	node->rhs = rhs;
+	*ret = node;
+	return NULL;
+}
+
+struct c_expr_parser {
+	struct drgn_program *prog;
+	struct drgn_lexer lexer;
+	const char * const *variables;
+	size_t num_variables;
+};
+
+/* Binary operators, indexed by token kind. */
+static const struct {
+	/* Higher binds tighter; 0 means that the token is not an operator. */
+	int precedence;
+	enum c_expr_kind kind;
+	drgn_binary_op *op;
+} c_binary_ops[C_TOKEN_IDENTIFIER + 1] = {
+	[C_TOKEN_OR_OR] = { 1, C_EXPR_LOGICAL_OR },
+	[C_TOKEN_AND_AND] = { 2, C_EXPR_LOGICAL_AND },
+	[C_TOKEN_PIPE] = { 3, C_EXPR_BINARY, drgn_object_or },
+	[C_TOKEN_CARET] = { 4, C_EXPR_BINARY, drgn_object_xor },
+	[C_TOKEN_AMPERSAND] = { 5, C_EXPR_BINARY, drgn_object_and },
+	[C_TOKEN_EQ] = { 6, C_EXPR_CMP },
+	[C_TOKEN_NE] = { 6, C_EXPR_CMP },
+	[C_TOKEN_LT] = { 7, C_EXPR_CMP },
+	[C_TOKEN_LE] = { 7, C_EXPR_CMP },
+	[C_TOKEN_GT] = { 7, C_EXPR_CMP },
+	[C_TOKEN_GE] = { 7, C_EXPR_CMP },
+	[C_TOKEN_LSHIFT] = { 8, C_EXPR_BINARY, drgn_object_lshift },
+	[C_TOKEN_RSHIFT] = { 8, C_EXPR_BINARY, drgn_object_rshift },
+	[C_TOKEN_PLUS] = { 9, C_EXPR_BINARY, drgn_object_add },
+	[C_TOKEN_MINUS] = { 9, C_EXPR_BINARY, drgn_object_sub },
+	[C_TOKEN_ASTERISK] = { 10, C_EXPR_BINARY, drgn_object_mul },
+	[C_TOKEN_SLASH] = { 10, C_EXPR_BINARY, drgn_object_div },
+	[C_TOKEN_PERCENT] = { 10, C_EXPR_BINARY, drgn_object_mod },
+};
+
+static struct drgn_error *c_parse_expr(struct c_expr_parser *parser,
+				       int min_precedence,
+				       struct c_expr **ret);
+static struct drgn_error *c_parse_cast_expr(struct c_expr_parser *parser,
+					    struct c_expr **ret);
+
+static struct drgn_error *c_expect_token(struct c_expr_parser *parser,
+					 int kind, const char *message)
+{
+	struct drgn_error *err;
+	struct drgn_token token;
+
+	err = drgn_lexer_pop(&parser->lexer, &token);
+	if (err)
+		return err;
+	if (token.kind != kind)
+		return drgn_error_create(DRGN_ERROR_SYNTAX, message);
+	return NULL;
+}
+
+static struct drgn_error *c_parse_primary_expr(struct c_expr_parser *parser,
+					       struct c_expr **ret)
+{
+	struct drgn_error *err;
+	struct drgn_token token;
+	size_t i;
+	char *name;
+
+	err = drgn_lexer_pop(&parser->lexer, &token);
+	if (err)
+		return err;
+	switch (token.kind) {
+	case C_TOKEN_IDENTIFIER:
+		for (i = 0; i < parser->num_variables; i++) {
+			if (strlen(parser->variables[i]) == token.len &&
+			    memcmp(parser->variables[i], token.value,
+				   token.len) == 0) {
+				err = c_expr_create(C_EXPR_VARIABLE, NULL, NULL,
+						    ret);
+				if (err)
+					return err;
+				(*ret)->variable = i;
+				return NULL;
+			}
+		}
+		name = strndup(token.value, token.len);
+		if (!name)
+			return &drgn_enomem;
+		err = c_expr_create(C_EXPR_OBJECT, NULL, NULL, ret);
+		if (err) {
+			free(name);
+			return err;
+		}
+		drgn_object_init(&(*ret)->object, parser->prog);
+		err = drgn_program_find_object(parser->prog, name, NULL,
+					       DRGN_FIND_OBJECT_ANY,
+					       &(*ret)->object);
+		free(name);
+		if (err) {
+			c_expr_destroy(*ret);
+			return err;
+		}
+		return NULL;
+	case C_TOKEN_NUMBER:
+		err = c_expr_create(C_EXPR_NUMBER, NULL, NULL, ret);
+		if (err)
+			return err;
+		err = c_token_to_u64(&token, &(*ret)->number);
+		if (err) {
+			c_expr_destroy(*ret);
+			return err;
+		}
+		return NULL;
+	case C_TOKEN_LPAREN:
+		err = c_parse_expr(parser, 1, ret);
+		if (err)
+			return err;
+		err = c_expect_token(parser, C_TOKEN_RPAREN, "expected ')'");
+		if (err) {
+			c_expr_destroy(*ret);
+			return err;
+		}
+		return NULL;
+	case C_TOKEN_EOF:
+		return drgn_error_create(DRGN_ERROR_SYNTAX,
+					 "unexpected end of expression");
+	default:
+		return drgn_error_format(DRGN_ERROR_SYNTAX,
+					 "unexpected '%.*s' in expression",
+					 (int)token.len, token.value);
+	}
+}
+
+static struct drgn_error *c_parse_postfix_expr(struct c_expr_parser *parser,
+					       struct c_expr **ret)
+{
+	struct drgn_error *err;
+	struct c_expr *node, *rhs;
+
+	err = c_parse_primary_expr(parser, &node);
+	if (err)
+		return err;
+
+	for (;;) {
+		struct drgn_token token;
+		enum c_expr_kind kind;
+
+		err = drgn_lexer_pop(&parser->lexer, &token);
+		if (err)
+			goto err;
+		switch (token.kind) {
+		case C_TOKEN_DOT:
+		case C_TOKEN_ARROW:
+			kind = (token.kind == C_TOKEN_DOT ?
+				C_EXPR_MEMBER : C_EXPR_MEMBER_DEREFERENCE);
+			err = drgn_lexer_pop(&parser->lexer, &token);
+			if (err)
+				goto err;
+			if (token.kind != C_TOKEN_IDENTIFIER) {
+				err = drgn_error_create(DRGN_ERROR_SYNTAX,
+							kind == C_EXPR_MEMBER ?
+							"expected identifier after '.'" :
+							"expected identifier after '->'");
+				goto err;
+			}
+			err = c_expr_create(kind, node, NULL, &node);
+			if (err)
+				return err;
+			node->member = strndup(token.value, token.len);
+			if (!node->member) {
+				err = &drgn_enomem;
+				goto err;
+			}
+			break;
+		case C_TOKEN_LBRACKET:
+			err = c_parse_expr(parser, 1, &rhs);
+			if (err)
+				goto err;
+			err = c_expr_create(C_EXPR_SUBSCRIPT, node, rhs, &node);
+			if (err)
+				return err;
+			err = c_expect_token(parser, C_TOKEN_RBRACKET,
+					     "expected ']'");
+			if (err)
+				goto err;
+			break;
+		default:
+			err = drgn_lexer_push(&parser->lexer, &token);
+			if (err)
+				goto err;
+			*ret = node;
+			return NULL;
+		}
+	}
+
+err:
+	c_expr_destroy(node);
+	return err;
+}
+
+static struct drgn_error *c_parse_unary_expr(struct c_expr_parser *parser,
+					     struct c_expr **ret)
+{
+	struct drgn_error *err;
+	struct drgn_token token;
+	struct c_expr *operand;
+	enum c_expr_kind kind;
+	drgn_unary_op *op = NULL;
+
+	err = drgn_lexer_pop(&parser->lexer, &token);
+	if (err)
+		return err;
+	switch (token.kind) {
+	case C_TOKEN_PLUS:
+		kind = C_EXPR_UNARY;
+		op = drgn_object_pos;
+		break;
+	case C_TOKEN_MINUS:
+		kind = C_EXPR_UNARY;
+		op = drgn_object_neg;
+		break;
+	case C_TOKEN_TILDE:
+		kind = C_EXPR_UNARY;
+		op = drgn_object_not;
+		break;
+	case C_TOKEN_EXCLAMATION:
+		kind = C_EXPR_LOGICAL_NOT;
+		break;
+	case C_TOKEN_ASTERISK:
+		/* *x is equivalent to x[0]. */
+		err = c_parse_cast_expr(parser, &operand);
+		if (err)
+			return err;
+		err = c_expr_create(C_EXPR_NUMBER, NULL, NULL, ret);
+		if (err) {
+			c_expr_destroy(operand);
+			return err;
+		}
+		(*ret)->number = 0;
+		return c_expr_create(C_EXPR_SUBSCRIPT, operand, *ret, ret);
+	case C_TOKEN_AMPERSAND:
+		kind = C_EXPR_ADDRESS_OF;
+		break;
+	case C_TOKEN_LPAREN:
+		err = drgn_lexer_push(&parser->lexer, &token);
+		if (err)
+			return err;
+		return c_parse_cast_expr(parser, ret);
+	default:
+		err = drgn_lexer_push(&parser->lexer, &token);
+		if (err)
+			return err;
+		return c_parse_postfix_expr(parser, ret);
+	}
+
+	err = c_parse_cast_expr(parser, &operand);
+	if (err)
+		return err;
+	err = c_expr_create(kind, operand, NULL, ret);
+	if (err)
+		return err;
+	(*ret)->unary_op = op;
+	return NULL;
+}
+
+/*
+ * Return whether the token after an opening parenthesis starts a type name
+ * (i.e., the parenthesis begins a cast).
+ */
+static struct drgn_error *c_token_begins_type_name(struct c_expr_parser *parser,
+						   const struct drgn_token *token,
+						   bool *ret)
+{
+	struct drgn_error *err;
+	struct drgn_qualified_type qualified_type;
+	size_t i;
+
+	if (MIN_KEYWORD_TOKEN <= token->kind &&
+	    token->kind <= MAX_KEYWORD_TOKEN) {
+		*ret = true;
+		return NULL;
+	}
+	if (token->kind != C_TOKEN_IDENTIFIER) {
+		*ret = false;
+		return NULL;
+	}
+	/* Variables shadow typedefs. */
+	for (i = 0; i < parser->num_variables; i++) {
+		if (strlen(parser->variables[i]) == token->len &&
+		    memcmp(parser->variables[i], token->value,
+			   token->len) == 0) {
+			*ret = false;
+			return NULL;
+		}
+	}
+	if ((token->len == sizeof("size_t") - 1 &&
+	     memcmp(token->value, "size_t", token->len) == 0) ||
+	    (token->len == sizeof("ptrdiff_t") - 1 &&
+	     memcmp(token->value, "ptrdiff_t", token->len) == 0)) {
+		*ret = true;
+		return NULL;
+	}
+	err = drgn_type_index_find_parsed(&parser->prog->tindex,
+					  DRGN_TYPE_TYPEDEF, token->value,
+					  token->len, NULL, &qualified_type);
+	if (!err) {
+		*ret = true;
+		return NULL;
+	} else if (err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		*ret = false;
+		return NULL;
+	} else {
+		return err;
+	}
+}
+
+static struct drgn_error *c_parse_cast_expr(struct c_expr_parser *parser,
+					    struct c_expr **ret)
+{
+	struct drgn_error *err;
+	struct drgn_token lparen, token;
+	struct drgn_qualified_type qualified_type;
+	struct c_expr *operand;
+	bool is_cast;
+
+	err = drgn_lexer_pop(&parser->lexer, &lparen);
+	if (err)
+		return err;
+	if (lparen.kind != C_TOKEN_LPAREN)
+		goto not_cast;
+	err = drgn_lexer_peek(&parser->lexer, &token);
+	if (err)
+		return err;
+	err = c_token_begins_type_name(parser, &token, &is_cast);
+	if (err)
+		return err;
+	if (!is_cast)
+		goto not_cast;
+
+	err = c_parse_type_name(&parser->prog->tindex, &parser->lexer, NULL,
+				&qualified_type);
+	if (err)
+		return err;
+	err = c_expect_token(parser, C_TOKEN_RPAREN,
+			     "expected ')' after type name");
+	if (err)
+		return err;
+	err = c_parse_cast_expr(parser, &operand);
+	if (err)
+		return err;
+	err = c_expr_create(C_EXPR_CAST, operand, NULL, ret);
+	if (err)
+		return err;
+	(*ret)->type = qualified_type;
+	return NULL;
+
+not_cast:
+	err = drgn_lexer_push(&parser->lexer, &lparen);
+	if (err)
+		return err;
+	if (lparen.kind == C_TOKEN_LPAREN)
+		return c_parse_postfix_expr(parser, ret);
+	return c_parse_unary_expr(parser, ret);
+}
+
+static struct drgn_error *c_parse_expr(struct c_expr_parser *parser,
+				       int min_precedence,
+				       struct c_expr **ret)
+{
+	struct drgn_error *err;
+	struct c_expr *lhs, *rhs;
+
+	err = c_parse_cast_expr(parser, &lhs);
+	if (err)
+		return err;
+
+	for (;;) {
+		struct drgn_token token;
+		int precedence;
+
+		err = drgn_lexer_pop(&parser->lexer, &token);
+		if (err)
+			goto err;
+		precedence = (token.kind <= C_TOKEN_IDENTIFIER ?
+			      c_binary_ops[token.kind].precedence : 0);
+		if (!precedence || precedence < min_precedence) {
+			err = drgn_lexer_push(&parser->lexer, &token);
+			if (err)
+				goto err;
+			*ret = lhs;
+			return NULL;
+		}
+
+		/* All binary operators are left-associative. */
+		err = c_parse_expr(parser, precedence + 1, &rhs);
+		if (err)
+			goto err;
+		err = c_expr_create(c_binary_ops[token.kind].kind, lhs, rhs,
+				    &lhs);
+		if (err)
+			return err;
+		if (lhs->kind == C_EXPR_BINARY)
+			lhs->binary_op = c_binary_ops[token.kind].op;
+		else if (lhs->kind == C_EXPR_CMP)
+			lhs->cmp = token.kind;
+	}
+
+err:
+	c_expr_destroy(lhs);
+	return err;
+}
+
+static struct drgn_error *c_expr_evaluate(struct c_expr *node,
+					  const struct drgn_object * const *variables,
+					  struct drgn_object *res);
+
+static struct drgn_error *
+c_expr_evaluate_bool(struct c_expr *node,
+		     const struct drgn_object * const *variables,
+		     struct drgn_object *tmp, bool *ret)
+{
+	struct drgn_error *err;
+
+	err = c_expr_evaluate(node, variables, tmp);
+	if (err)
+		return err;
+	return drgn_object_bool(tmp, ret);
+}
+
+static struct drgn_error *c_expr_evaluate(struct c_expr *node,
+					  const struct drgn_object * const *variables,
+					  struct drgn_object *res)
+{
+	struct drgn_error *err;
+	struct drgn_object rhs;
+	union drgn_value index;
+	bool lhs_bool, rhs_bool;
+	int cmp;
+
+	switch (node->kind) {
+	case C_EXPR_VARIABLE:
+		return drgn_object_copy(res, variables[node->variable]);
+	case C_EXPR_OBJECT:
+		return drgn_object_copy(res, &node->object);
+	case C_EXPR_NUMBER:
+		return drgn_object_integer_literal(res, node->number);
+	case C_EXPR_MEMBER:
+	case C_EXPR_MEMBER_DEREFERENCE:
+		err = c_expr_evaluate(node->lhs, variables, res);
+		if (err)
+			return err;
+		if (node->kind == C_EXPR_MEMBER)
+			return drgn_object_member(res, res, node->member);
+		else
+			return drgn_object_member_dereference(res, res,
+							      node->member);
+	case C_EXPR_SUBSCRIPT:
+		err = c_expr_evaluate(node->lhs, variables, res);
+		if (err)
+			return err;
+		drgn_object_init(&rhs, res->prog);
+		err = c_expr_evaluate(node->rhs, variables, &rhs);
+		if (!err)
+			err = drgn_object_read_integer(&rhs, &index);
+		if (!err) {
+			err = drgn_object_subscript(res, res,
+						    rhs.kind == DRGN_OBJECT_SIGNED ?
+						    index.svalue :
+						    (int64_t)index.uvalue);
+		}
+		drgn_object_deinit(&rhs);
+		return err;
+	case C_EXPR_CAST:
+		err = c_expr_evaluate(node->lhs, variables, res);
+		if (err)
+			return err;
+		return drgn_object_cast(res, node->type, res);
+	case C_EXPR_ADDRESS_OF:
+		err = c_expr_evaluate(node->lhs, variables, res);
+		if (err)
+			return err;
+		return drgn_object_address_of(res, res);
+	case C_EXPR_UNARY:
+		err = c_expr_evaluate(node->lhs, variables, res);
+		if (err)
+			return err;
+		return node->unary_op(res, res);
+	case C_EXPR_LOGICAL_NOT:
+		err = c_expr_evaluate_bool(node->lhs, variables, res,
+					   &lhs_bool);
+		if (err)
+			return err;
+		return drgn_object_integer_literal(res, !lhs_bool);
+	case C_EXPR_LOGICAL_AND:
+	case C_EXPR_LOGICAL_OR:
+		err = c_expr_evaluate_bool(node->lhs, variables, res,
+					   &lhs_bool);
+		if (err)
+			return err;
+		if (lhs_bool == (node->kind == C_EXPR_LOGICAL_OR))
+			return drgn_object_integer_literal(res, lhs_bool);
+		err = c_expr_evaluate_bool(node->rhs, variables, res,
+					   &rhs_bool);
+		if (err)
+			return err;
+		return drgn_object_integer_literal(res, rhs_bool);
+	case C_EXPR_BINARY:
+	case C_EXPR_CMP:
+		err = c_expr_evaluate(node->lhs, variables, res);
+		if (err)
+			return err;
+		drgn_object_init(&rhs, res->prog);
+		err = c_expr_evaluate(node->rhs, variables, &rhs);
+		if (err)
+			goto out;
+		if (node->kind == C_EXPR_BINARY) {
+			err = node->binary_op(res, res, &rhs);
+			goto out;
+		}
+		err = drgn_object_cmp(res, &rhs, &cmp);
+		if (err)
+			goto out;
+		switch (node->cmp) {
+		case C_TOKEN_EQ:
+			cmp = cmp == 0;
+			break;
+		case C_TOKEN_NE:
+			cmp = cmp != 0;
+			break;
+		case C_TOKEN_LT:
+			cmp = cmp < 0;
+			break;
+		case C_TOKEN_LE:
+			cmp = cmp <= 0;
+			break;
+		case C_TOKEN_GT:
+			cmp = cmp > 0;
+			break;
+		case C_TOKEN_GE:
+			cmp = cmp >= 0;
+			break;
+		default:
+			UNREACHABLE();
+		}
+		err = drgn_object_integer_literal(res, cmp);
+out:
+		drgn_object_deinit(&rhs);
+		return err;
+	}
+	UNREACHABLE();
+}
+
+static struct drgn_error *
+c_expression_evaluate(struct drgn_expression *expr,
+		      const struct drgn_object * const *variables,
+		      struct drgn_object *res)
+{
+	struct c_expression *cexpr = container_of(expr, struct c_expression,
+						  expr);
+
+	return c_expr_evaluate(cexpr->root, variables, res);
+}
+
+static void c_expression_destroy(struct drgn_expression *expr)
+{
+	struct c_expression *cexpr = container_of(expr, struct c_expression,
+						  expr);
+
+	c_expr_destroy(cexpr->root);
+	free(cexpr);
+}
+
+struct drgn_error *c_compile_expression(struct drgn_program *prog,
+					const char *str,
+					const char * const *variables,
+					size_t num_variables,
+					struct drgn_expression **ret)
+{
+	struct drgn_error *err;
+	struct c_expr_parser parser = {
+		.prog = prog,
+		.variables = variables,
+		.num_variables = num_variables,
+	};
+	struct c_expression *cexpr;
+	struct c_expr *root;
+
+	drgn_lexer_init(&parser.lexer, drgn_lexer_c, str);
+	err = c_parse_expr(&parser, 1, &root);
+	if (err)
+		goto out;
+	err = c_expect_token(&parser, C_TOKEN_EOF,
+			     "extra tokens after expression");
+	if (err) {
+		c_expr_destroy(root);
+		goto out;
+	}
+
+	cexpr = malloc(sizeof(*cexpr));
+	if (!cexpr) {
+		c_expr_destroy(root);
+		err = &drgn_enomem;
+		goto out;
+	}
+	cexpr->expr.prog = prog;
+	cexpr->expr.num_variables = num_variables;
+	cexpr->expr.evaluate = c_expression_evaluate;
+	cexpr->expr.destroy = c_expression_destroy;
+	cexpr->root = root;
+	*ret = &cexpr->expr;
+	err = NULL;
+out:
+	drgn_lexer_deinit(&parser.lexer);
+	return err;
+}
+
 struct drgn_error *c_integer_literal(struct drgn_object *res, uint64_t uvalue)
 {
 	static const enum drgn_primitive_type types[] = {
@@ -3233,6 +4899,23 @@ struct drgn_error *c_op_bool(const struct drgn_object *obj, bool *ret)
 	return NULL;
 }
 
+/*
+ * Return whether an operand is a pointer after array-to-pointer and
+ * function-to-pointer conversion. Unlike c_operand_type(), this doesn't need to
+ * look up the converted type.
+ */
+static bool c_operand_is_pointer(const struct drgn_object *obj)
+{
+	switch (drgn_type_kind(drgn_underlying_type(obj->type))) {
+	case DRGN_TYPE_ARRAY:
+	case DRGN_TYPE_FUNCTION:
+	case DRGN_TYPE_POINTER:
+		return true;
+	default:
+		return false;
+	}
+}
+
 struct drgn_error *c_op_cmp(const struct drgn_object *lhs,
 			    const struct drgn_object *rhs, int *ret)
 {
@@ -3240,6 +4923,13 @@ struct drgn_error *c_op_cmp(const struct drgn_object *lhs,
 	struct drgn_object_type lhs_type, rhs_type;
 	bool lhs_pointer, rhs_pointer;
 
+	/*
+	 * Pointer comparisons only depend on the addresses, which
+	 * drgn_op_cmp_pointers() gets directly from arrays and functions.
+	 */
+	if (c_operand_is_pointer(lhs) && c_operand_is_pointer(rhs))
+		return drgn_op_cmp_pointers(lhs, rhs, ret);
+
 	err = c_operand_type(lhs, &lhs_type, &lhs_pointer, NULL);
 	if (err)
 		return err;
@@ -0,0 +1,152 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <stdlib.h>
+
+#include "internal.h"
+#include "line_table.h"
+#include "vector.h"
+
+struct line_table_sort_entry {
+	struct drgn_line_table_entry entry;
+	/* Original position, so that rows at the same address keep their order. */
+	size_t index;
+};
+
+DEFINE_VECTOR(line_table_sort_vector, struct line_table_sort_entry)
+
+static int line_table_sort_entry_cmp(const void *_a, const void *_b)
+{
+	const struct line_table_sort_entry *a = _a, *b = _b;
+
+	if (a->entry.address != b->entry.address)
+		return a->entry.address < b->entry.address ? -1 : 1;
+	/*
+	 * If one sequence ends where another begins, the end must come first
+	 * so that lookups find the beginning of the next sequence.
+	 */
+	if (a->entry.end_sequence != b->entry.end_sequence)
+		return a->entry.end_sequence ? -1 : 1;
+	if (a->index != b->index)
+		return a->index < b->index ? -1 : 1;
+	return 0;
+}
+
+static struct drgn_error *
+line_table_add_cu(struct line_table_sort_vector *rows, Dwarf_Die *cu_die,
+		   uint64_t bias)
+{
+	Dwarf_Lines *lines;
+	size_t num_lines, i;
+
+	if (dwarf_getsrclines(cu_die, &lines, &num_lines)) {
+		/* Skip units without a line program. */
+		return NULL;
+	}
+	for (i = 0; i < num_lines; i++) {
+		Dwarf_Line *line;
+		Dwarf_Addr address;
+		int lineno, column;
+		bool end_sequence;
+		const char *filename;
+		struct line_table_sort_entry *row;
+
+		line = dwarf_onesrcline(lines, i);
+		if (!line || dwarf_lineaddr(line, &address) ||
+		    dwarf_lineendsequence(line, &end_sequence))
+			continue;
+		filename = dwarf_linesrc(line, NULL, NULL);
+		if (dwarf_lineno(line, &lineno) || lineno < 0)
+			lineno = 0;
+		if (dwarf_linecol(line, &column) || column < 0 ||
+		    column > UINT16_MAX)
+			column = 0;
+
+		row = line_table_sort_vector_append_entry(rows);
+		if (!row)
+			return &drgn_enomem;
+		row->entry.address = address + bias;
+		row->entry.filename = filename;
+		row->entry.line = lineno;
+		row->entry.column = column;
+		row->entry.end_sequence = end_sequence;
+		row->index = rows->size - 1;
+	}
+	return NULL;
+}
+
+struct drgn_error *drgn_line_table_create(Dwarf *dwarf, uint64_t bias,
+					  struct drgn_line_table **ret)
+{
+	struct drgn_error *err;
+	struct line_table_sort_vector rows = VECTOR_INIT;
+	struct drgn_line_table *table;
+	Dwarf_Off offset = 0, next_offset;
+	size_t header_size, i;
+
+	*ret = NULL;
+	while (dwarf_nextcu(dwarf, offset, &next_offset, &header_size, NULL,
+			    NULL, NULL) == 0) {
+		Dwarf_Die cu_die;
+
+		if (dwarf_offdie(dwarf, offset + header_size, &cu_die)) {
+			err = line_table_add_cu(&rows, &cu_die, bias);
+			if (err)
+				goto out;
+		}
+		offset = next_offset;
+	}
+	if (!rows.size) {
+		err = NULL;
+		goto out;
+	}
+	qsort(rows.data, rows.size, sizeof(rows.data[0]),
+	      line_table_sort_entry_cmp);
+
+	table = malloc(sizeof(*table));
+	if (!table) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	table->entries = malloc_array(rows.size, sizeof(*table->entries));
+	if (!table->entries) {
+		free(table);
+		err = &drgn_enomem;
+		goto out;
+	}
+	for (i = 0; i < rows.size; i++)
+		table->entries[i] = rows.data[i].entry;
+	table->num_entries = rows.size;
+	*ret = table;
+	err = NULL;
+out:
+	line_table_sort_vector_deinit(&rows);
+	return err;
+}
+
+void drgn_line_table_destroy(struct drgn_line_table *table)
+{
+	if (table) {
+		free(table->entries);
+		free(table);
+	}
+}
+
+const struct drgn_line_table_entry *
+drgn_line_table_find(const struct drgn_line_table *table, uint64_t address)
+{
+	size_t lo = 0, hi = table->num_entries;
+
+	/* Find the last row starting at or before address. */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (table->entries[mid].address <= address)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (!lo || table->entries[lo - 1].end_sequence)
+		return NULL;
+	return &table->entries[lo - 1];
+}
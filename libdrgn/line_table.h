@@ -0,0 +1,83 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Address to source line lookup tables.
+ *
+ * See @ref LineTables.
+ */
+
+#ifndef DRGN_LINE_TABLE_H
+#define DRGN_LINE_TABLE_H
+
+#include <elfutils/libdw.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup LineTables Line tables
+ *
+ * Address to source line lookup tables.
+ *
+ * libdw can find the line for an address with @c dwarf_getsrc_die(), but that
+ * requires finding the compilation unit first and searching its line program
+ * for every lookup. Instead, the line programs of every compilation unit in a
+ * module are decoded once into a single compact table sorted by address, which
+ * can be binary searched.
+ *
+ * @{
+ */
+
+/** Row of a @ref drgn_line_table. */
+struct drgn_line_table_entry {
+	/** Start address of the row. */
+	uint64_t address;
+	/** Source file name. This is owned by libdw. */
+	const char *filename;
+	uint32_t line;
+	uint16_t column;
+	/**
+	 * Whether this row marks the end of a sequence, i.e., its address is
+	 * one past the end of the previous row and isn't covered by it.
+	 */
+	bool end_sequence;
+};
+
+/** Line table of a module sorted by address. */
+struct drgn_line_table {
+	struct drgn_line_table_entry *entries;
+	size_t num_entries;
+};
+
+/**
+ * Build the line table of a module.
+ *
+ * This only uses @p dwarf, so tables for different modules can be built in
+ * parallel.
+ *
+ * @param[in] bias Bias to add to addresses in @p dwarf.
+ * @param[out] ret Returned table, or @c NULL if the module doesn't have line
+ * number information. Must be freed with @ref drgn_line_table_destroy().
+ */
+struct drgn_error *drgn_line_table_create(Dwarf *dwarf, uint64_t bias,
+					  struct drgn_line_table **ret);
+
+/** Free a @ref drgn_line_table. */
+void drgn_line_table_destroy(struct drgn_line_table *table);
+
+/**
+ * Find the row covering an address.
+ *
+ * @return Row, or @c NULL if no row covers @p address.
+ */
+const struct drgn_line_table_entry *
+drgn_line_table_find(const struct drgn_line_table *table, uint64_t address);
+
+/** @} */
+
+#endif /* DRGN_LINE_TABLE_H */
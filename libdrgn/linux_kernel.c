@@ -2,9 +2,12 @@
 // SPDX-License-Identifier: GPL-3.0+
 
 #include <dirent.h>
+#include <elfutils/libdwelf.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <gelf.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -18,6 +21,7 @@
 #include "linux_kernel.h"
 #include "program.h"
 #include "read.h"
+#include "vector.h"
 
 struct drgn_error *read_memory_via_pgtable(void *buf, uint64_t address,
 					   size_t count, uint64_t offset,
@@ -124,60 +128,6 @@ struct drgn_error *parse_vmcoreinfo(const char *desc, size_t descsz,
 	return NULL;
 }
 
-struct drgn_error *proc_kallsyms_symbol_addr(const char *name,
-					     unsigned long *ret)
-{
-	struct drgn_error *err;
-	FILE *file;
-	char *line = NULL;
-	size_t n = 0;
-
-	file = fopen("/proc/kallsyms", "r");
-	if (!file)
-		return drgn_error_create_os("fopen", errno, "/proc/kallsyms");
-
-	for (;;) {
-		char *addr_str, *sym_str, *saveptr, *end;
-
-		errno = 0;
-		if (getline(&line, &n, file) == -1) {
-			if (errno) {
-				err = drgn_error_create_os("getline", errno,
-							   "/proc/kallsyms");
-			} else {
-				err = &drgn_not_found;
-			}
-			break;
-		}
-
-		addr_str = strtok_r(line, "\t ", &saveptr);
-		if (!addr_str || !*addr_str)
-			goto invalid;
-		if (!strtok_r(NULL, "\t ", &saveptr))
-			goto invalid;
-		sym_str = strtok_r(NULL, "\t\n ", &saveptr);
-		if (!sym_str)
-			goto invalid;
-
-		if (strcmp(sym_str, name) != 0)
-			continue;
-
-		errno = 0;
-		*ret = strtoul(line, &end, 16);
-		if (errno || *end) {
-invalid:
-			err = drgn_error_create(DRGN_ERROR_OTHER,
-						"could not parse /proc/kallsyms");
-			break;
-		}
-		err = NULL;
-		break;
-	}
-	free(line);
-	fclose(file);
-	return err;
-}
-
 /*
  * Before Linux kernel commit 23c85094fe18 ("proc/kcore: add vmcoreinfo note to
  * /proc/kcore") (in v4.19), /proc/kcore didn't have a VMCOREINFO note. Instead,
@@ -234,6 +184,58 @@ out:
 	return err;
 }
 
+DEFINE_VECTOR(ram_range_vector, struct drgn_memory_range)
+
+struct drgn_error *
+linux_kernel_live_ram_ranges(struct drgn_memory_range **ranges_ret,
+			     size_t *num_ranges_ret)
+{
+	struct drgn_error *err = NULL;
+	struct ram_range_vector ranges = VECTOR_INIT;
+	FILE *file;
+	char *line = NULL;
+	size_t n = 0;
+
+	/* This is only an optimization, so ignore errors opening the file. */
+	file = fopen("/proc/iomem", "r");
+	if (!file)
+		goto out;
+	while (getline(&line, &n, file) != -1) {
+		struct drgn_memory_range range, *last;
+		int name_start;
+
+		/* Only top-level resources are interesting. */
+		if (sscanf(line, "%" SCNx64 "-%" SCNx64 " : %n", &range.start,
+			   &range.last, &name_start) != 2 ||
+		    strcmp(line + name_start, "System RAM\n") != 0)
+			continue;
+		if (!range.last) {
+			/* The addresses are hidden from unprivileged users. */
+			ranges.size = 0;
+			break;
+		}
+		last = ranges.size ? &ranges.data[ranges.size - 1] : NULL;
+		if (last && range.start <= last->last + 1) {
+			if (range.last > last->last)
+				last->last = range.last;
+		} else if (!ram_range_vector_append(&ranges, &range)) {
+			err = &drgn_enomem;
+			break;
+		}
+	}
+	free(line);
+	fclose(file);
+out:
+	if (err) {
+		ram_range_vector_deinit(&ranges);
+		return err;
+	}
+	ram_range_vector_shrink_to_fit(&ranges);
+	*ranges_ret = ranges.data;
+	*num_ranges_ret = ranges.size;
+	return NULL;
+}
+
 struct drgn_error *linux_kernel_get_thread_size(struct drgn_program *prog,
 						uint64_t *ret)
 {
@@ -383,39 +385,80 @@ struct drgn_error *linux_kernel_object_find(const char *name, size_t name_len,
 	return &drgn_not_found;
 }
 
+DEFINE_HASH_MAP(kernel_module_address_map, char *, uint64_t, c_string_hash,
+		c_string_eq)
+
 struct kernel_module_iterator {
 	char *name;
 	FILE *file;
+	/* Saved section addresses of a live kernel, or NULL. */
+	struct kernel_module_layout *layout;
 	char *notes;
 	size_t notes_len, notes_capacity;
-	union {
-		struct {
-			size_t name_capacity;
-			uint64_t start, end;
-		};
-		struct {
-			struct drgn_qualified_type module_type;
-			struct drgn_object mod, node, tmp1, tmp2, tmp3;
-			uint64_t head;
-		};
-	};
+	uint64_t start, end;
+	/* Capacity of name when it is read from /proc/modules. */
+	size_t name_capacity;
+	/*
+	 * Objects for walking the module list in memory. For the running
+	 * kernel, these are only used to read section addresses.
+	 */
+	struct drgn_qualified_type module_type;
+	struct drgn_object mod, node, tmp1, tmp2, tmp3;
+	uint64_t head;
+	/*
+	 * For the running kernel, map from module name to the address of its
+	 * struct module, built the first time it is needed by
+	 * kernel_module_iterator_find_live(). If it could not be built,
+	 * live_modules_err is set.
+	 */
+	struct kernel_module_address_map live_modules;
+	bool live_modules_built;
+	bool live_modules_err;
 };
 
 static void kernel_module_iterator_deinit(struct kernel_module_iterator *it)
 {
-	if (it->file) {
+	struct kernel_module_address_map_iterator map_it;
+
+	if (it->file)
 		fclose(it->file);
-	} else {
-		drgn_object_deinit(&it->tmp3);
-		drgn_object_deinit(&it->tmp2);
-		drgn_object_deinit(&it->tmp1);
-		drgn_object_deinit(&it->node);
-		drgn_object_deinit(&it->mod);
-	}
+	for (map_it = kernel_module_address_map_first(&it->live_modules);
+	     map_it.entry; map_it = kernel_module_address_map_next(map_it))
+		free(map_it.entry->key);
+	kernel_module_address_map_deinit(&it->live_modules);
+	drgn_object_deinit(&it->tmp3);
+	drgn_object_deinit(&it->tmp2);
+	drgn_object_deinit(&it->tmp1);
+	drgn_object_deinit(&it->node);
+	drgn_object_deinit(&it->mod);
 	free(it->notes);
 	free(it->name);
 }
 
+/* Initialize it->node to the modules list and it->head to its address. */
+static struct drgn_error *
+kernel_module_iterator_init_list(struct kernel_module_iterator *it,
+				 struct drgn_program *prog)
+{
+	struct drgn_error *err;
+
+	err = drgn_program_find_type(prog, "struct module", NULL,
+				     &it->module_type);
+	if (err)
+		return err;
+	err = drgn_program_find_object(prog, "modules", NULL,
+				       DRGN_FIND_OBJECT_VARIABLE, &it->node);
+	if (err)
+		return err;
+	err = drgn_object_address_of(&it->node, &it->node);
+	if (err)
+		return err;
+	err = drgn_object_read(&it->node, &it->node);
+	if (err)
+		return err;
+	return drgn_object_read_unsigned(&it->node, &it->head);
+}
+
 static struct drgn_error *
 kernel_module_iterator_init(struct kernel_module_iterator *it,
 			    struct drgn_program *prog)
@@ -423,41 +466,27 @@ kernel_module_iterator_init(struct kernel_module_iterator *it,
 	struct drgn_error *err;
 
 	it->name = NULL;
+	it->layout = NULL;
 	it->notes = NULL;
 	it->notes_len = it->notes_capacity = 0;
+	it->name_capacity = 0;
+	drgn_object_init(&it->mod, prog);
+	drgn_object_init(&it->node, prog);
+	drgn_object_init(&it->tmp1, prog);
+	drgn_object_init(&it->tmp2, prog);
+	drgn_object_init(&it->tmp3, prog);
+	kernel_module_address_map_init(&it->live_modules);
+	it->live_modules_built = it->live_modules_err = false;
 	if (prog->flags & DRGN_PROGRAM_IS_LIVE) {
 		it->file = fopen("/proc/modules", "r");
 		if (!it->file) {
-			return drgn_error_create_os("fopen", errno,
-						    "/proc/modules");
+			err = drgn_error_create_os("fopen", errno,
+						   "/proc/modules");
+			goto err;
 		}
-		it->name_capacity = 0;
 	} else {
 		it->file = NULL;
-
-		err = drgn_program_find_type(prog, "struct module", NULL,
-					     &it->module_type);
-		if (err)
-			return err;
-
-		drgn_object_init(&it->mod, prog);
-		drgn_object_init(&it->node, prog);
-		drgn_object_init(&it->tmp1, prog);
-		drgn_object_init(&it->tmp2, prog);
-		drgn_object_init(&it->tmp3, prog);
-
-		err = drgn_program_find_object(prog, "modules", NULL,
-					       DRGN_FIND_OBJECT_VARIABLE,
-					       &it->node);
-		if (err)
-			goto err;
-		err = drgn_object_address_of(&it->node, &it->node);
-		if (err)
-			goto err;
-		err = drgn_object_read(&it->node, &it->node);
-		if (err)
-			goto err;
-		err = drgn_object_read_unsigned(&it->node, &it->head);
+		err = kernel_module_iterator_init_list(it, prog);
 		if (err)
 			goto err;
 	}
@@ -497,6 +526,46 @@ kernel_module_iterator_next_live(struct kernel_module_iterator *it)
 	return NULL;
 }
 
+/*
+ * Get the address range of the core of the current module. This is only used to
+ * defer loading the module, so if it fails, the range is left empty.
+ */
+static void
+kernel_module_iterator_offline_range(struct kernel_module_iterator *it)
+{
+	struct drgn_error *err;
+	uint64_t base, size;
+
+	/* Before Linux 4.5, these were struct module::module_core/core_size. */
+	err = drgn_object_member_dereference(&it->tmp1, &it->mod,
+					     "core_layout");
+	if (!err) {
+		err = drgn_object_member(&it->tmp2, &it->tmp1, "base");
+		if (!err)
+			err = drgn_object_member(&it->tmp3, &it->tmp1, "size");
+	} else if (err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		err = drgn_object_member_dereference(&it->tmp2, &it->mod,
+						     "module_core");
+		if (!err) {
+			err = drgn_object_member_dereference(&it->tmp3,
+							     &it->mod,
+							     "core_size");
+		}
+	}
+	if (!err)
+		err = drgn_object_read_unsigned(&it->tmp2, &base);
+	if (!err)
+		err = drgn_object_read_unsigned(&it->tmp3, &size);
+	if (err) {
+		drgn_error_destroy(err);
+		it->start = it->end = 0;
+		return;
+	}
+	it->start = base;
+	it->end = base + size;
+}
+
 static struct drgn_error *
 kernel_module_iterator_next_offline(struct kernel_module_iterator *it)
 {
@@ -529,16 +598,184 @@ kernel_module_iterator_next_offline(struct kernel_module_iterator *it)
 		return err;
 	free(it->name);
 	it->name = name;
+	kernel_module_iterator_offline_range(it);
+	return NULL;
+}
+
+/* Build kernel_module_iterator::live_modules by walking the module list. */
+static struct drgn_error *
+kernel_module_iterator_build_live(struct kernel_module_iterator *it,
+				  struct drgn_program *prog)
+{
+	struct drgn_error *err;
+
+	err = kernel_module_iterator_init_list(it, prog);
+	if (err)
+		return err;
+	for (;;) {
+		struct kernel_module_address_map_entry entry;
+		uint64_t addr;
+		int ret;
+
+		err = drgn_object_member_dereference(&it->node, &it->node,
+						     "next");
+		if (err)
+			return err;
+		err = drgn_object_read(&it->node, &it->node);
+		if (err)
+			return err;
+		err = drgn_object_read_unsigned(&it->node, &addr);
+		if (err)
+			return err;
+		if (addr == it->head)
+			return NULL;
+		err = drgn_object_container_of(&it->mod, &it->node,
+					       it->module_type, "list");
+		if (err)
+			return err;
+		err = drgn_object_read_unsigned(&it->mod, &entry.value);
+		if (err)
+			return err;
+		err = drgn_object_member_dereference(&it->tmp1, &it->mod,
+						     "name");
+		if (err)
+			return err;
+		err = drgn_object_read_c_string(&it->tmp1, &entry.key);
+		if (err)
+			return err;
+		ret = kernel_module_address_map_insert(&it->live_modules,
+						       &entry, NULL);
+		if (ret != 1) {
+			free(entry.key);
+			if (ret == -1)
+				return &drgn_enomem;
+		}
+	}
+}
+
+/*
+ * Set @c it->mod to the struct module of the current module of an iterator
+ * over the running kernel's modules. The modules are found in memory with one
+ * walk of the module list instead of through sysfs.
+ *
+ * @return @c NULL on success, &@ref drgn_not_found if the module couldn't be
+ * found in memory, non-@c NULL on other errors.
+ */
+static struct drgn_error *
+kernel_module_iterator_find_live(struct kernel_module_iterator *it,
+				 struct drgn_program *prog)
+{
+	struct drgn_error *err;
+	struct kernel_module_address_map_iterator map_it;
+	struct drgn_qualified_type module_ptr_type = {};
+
+	if (!it->live_modules_built && !it->live_modules_err) {
+		err = kernel_module_iterator_build_live(it, prog);
+		if (err == &drgn_enomem)
+			return err;
+		/*
+		 * Without debugging information or /proc/kcore, fall back to
+		 * sysfs.
+		 */
+		if (err) {
+			drgn_error_destroy(err);
+			it->live_modules_err = true;
+		} else {
+			it->live_modules_built = true;
+		}
+	}
+	if (it->live_modules_err)
+		return &drgn_not_found;
+	map_it = kernel_module_address_map_search(&it->live_modules,
+						  &it->name);
+	if (!map_it.entry)
+		return &drgn_not_found;
+	err = drgn_type_index_pointer_type(&prog->tindex, it->module_type,
+					   NULL, &module_ptr_type.type);
+	if (err)
+		return err;
+	return drgn_object_set_unsigned(&it->mod, module_ptr_type,
+					map_it.entry->value, 0);
+}
+
+/*
+ * Initialize a kernel module iterator positioned at a module found by an
+ * earlier iteration, so that its sections can be read.
+ *
+ * @param[in] module_address Address of the module's struct module. For the
+ * running kernel, this may be 0 if it wasn't found in memory, in which case the
+ * sections are read from sysfs.
+ */
+static struct drgn_error *
+kernel_module_iterator_init_at(struct kernel_module_iterator *it,
+			       struct drgn_program *prog, const char *name,
+			       uint64_t module_address)
+{
+	struct drgn_error *err;
+
+	err = kernel_module_iterator_init(it, prog);
+	if (err)
+		return err;
+	it->name = strdup(name);
+	if (!it->name) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	if (it->file) {
+		struct kernel_module_address_map_entry entry;
+
+		/*
+		 * If the module wasn't found in memory before, don't repeat
+		 * the walk.
+		 */
+		if (!module_address) {
+			it->live_modules_err = true;
+			return NULL;
+		}
+		err = drgn_program_find_type(prog, "struct module", NULL,
+					     &it->module_type);
+		if (err)
+			goto err;
+		entry.key = strdup(name);
+		if (!entry.key) {
+			err = &drgn_enomem;
+			goto err;
+		}
+		entry.value = module_address;
+		if (kernel_module_address_map_insert(&it->live_modules, &entry,
+						     NULL) == -1) {
+			free(entry.key);
+			err = &drgn_enomem;
+			goto err;
+		}
+		it->live_modules_built = true;
+	} else {
+		struct drgn_qualified_type module_ptr_type = {};
+
+		err = drgn_type_index_pointer_type(&prog->tindex,
+						   it->module_type, NULL,
+						   &module_ptr_type.type);
+		if (err)
+			goto err;
+		err = drgn_object_set_unsigned(&it->mod, module_ptr_type,
+					       module_address, 0);
+		if (err)
+			goto err;
+	}
 	return NULL;
+
+err:
+	kernel_module_iterator_deinit(it);
+	return err;
 }
 
 /**
  * Get the the next loaded kernel module.
  *
  * After this is called, @c it->name is set to the name of the kernel module,
- * and @c it->start and @c it->end are set to the address range of the kernel
- * module. These are valid until the next time this is called or the iterator is
- * destroyed.
+ * and @c it->start and @c it->end are set to the address range of the core of
+ * the kernel module (which may be empty if it couldn't be determined). These
+ * are valid until the next time this is called or the iterator is destroyed.
  *
  * @return @c NULL on success, non-@c NULL on error. In particular, when there
  * are no more modules, a @ref DRGN_ERROR_STOP error is returned.
@@ -561,63 +798,103 @@ struct kernel_module_section_iterator {
 			uint64_t i;
 			uint64_t nsections;
 			char *name;
+			/* Member of struct module_sect_attr with the name. */
+			const char *name_member;
 		};
 	};
 };
 
+/* Initialize a section iterator which reads mod->sect_attrs. */
+static struct drgn_error *
+kernel_module_section_iterator_init_memory(struct kernel_module_section_iterator *it,
+					   struct kernel_module_iterator *kmod_it)
+{
+	struct drgn_error *err;
+
+	it->dir = NULL;
+	it->i = 0;
+	it->name = NULL;
+	/* it->nsections = mod->sect_attrs->nsections */
+	err = drgn_object_member_dereference(&kmod_it->tmp1, &kmod_it->mod,
+					     "sect_attrs");
+	if (err)
+		return err;
+	err = drgn_object_member_dereference(&kmod_it->tmp2, &kmod_it->tmp1,
+					     "nsections");
+	if (err)
+		return err;
+	err = drgn_object_read_unsigned(&kmod_it->tmp2, &it->nsections);
+	if (err)
+		return err;
+	/* kmod_it->tmp1 = mod->sect_attrs->attrs */
+	err = drgn_object_member_dereference(&kmod_it->tmp1, &kmod_it->tmp1,
+					     "attrs");
+	if (err)
+		return err;
+
+	/*
+	 * Since Linux kernel commit ed66f991bb19 ("module: Refactor section
+	 * attr into bin attribute") (in v5.8), the name is in the bin
+	 * attribute. Check the members now so that the running kernel can still
+	 * fall back to sysfs.
+	 */
+	err = drgn_object_subscript(&kmod_it->tmp2, &kmod_it->tmp1, 0);
+	if (err)
+		return err;
+	err = drgn_object_member(&kmod_it->tmp3, &kmod_it->tmp2, "address");
+	if (err)
+		return err;
+	it->name_member = "name";
+	err = drgn_object_member(&kmod_it->tmp3, &kmod_it->tmp2, "name");
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		it->name_member = "battr.attr.name";
+		err = drgn_object_member(&kmod_it->tmp3, &kmod_it->tmp2,
+					 it->name_member);
+	}
+	return err;
+}
+
 static struct drgn_error *
 kernel_module_section_iterator_init(struct kernel_module_section_iterator *it,
 				    struct kernel_module_iterator *kmod_it)
 {
 	struct drgn_error *err;
+	char *path;
 
 	it->kmod_it = kmod_it;
-	if (kmod_it->file) {
-		char *path;
+	if (!kmod_it->file)
+		return kernel_module_section_iterator_init_memory(it, kmod_it);
 
-		if (asprintf(&path, "/sys/module/%s/sections",
-			     kmod_it->name) == -1)
-			return &drgn_enomem;
-		it->dir = opendir(path);
-		free(path);
-		if (!it->dir) {
-			err = drgn_error_format_os("opendir", errno,
-						   "/sys/module/%s/sections",
-						   kmod_it->name);
-			return err;
-		}
-		it->dirfd = dirfd(it->dir);
-		if (it->dirfd == -1) {
-			err = drgn_error_format_os("dirfd", errno,
-						   "/sys/module/%s/sections",
-						   kmod_it->name);
-			closedir(it->dir);
-			return err;
-		}
-		return NULL;
-	} else {
-		it->dir = NULL;
-		it->i = 0;
-		it->name = NULL;
-		/* it->nsections = mod->sect_attrs->nsections */
-		err = drgn_object_member_dereference(&kmod_it->tmp1,
-						     &kmod_it->mod,
-						     "sect_attrs");
-		if (err)
-			return err;
-		err = drgn_object_member_dereference(&kmod_it->tmp2,
-						     &kmod_it->tmp1,
-						     "nsections");
-		if (err)
-			return err;
-		err = drgn_object_read_unsigned(&kmod_it->tmp2,
-						&it->nsections);
-		if (err)
-			return err;
-		/* kmod_it->tmp1 = mod->sect_attrs->attrs */
-		return drgn_object_member_dereference(&kmod_it->tmp1,
-						      &kmod_it->tmp1, "attrs");
+	/*
+	 * Reading sect_attrs from memory is much faster than reading a sysfs
+	 * file per section, so try that first for the running kernel, too.
+	 */
+	err = kernel_module_iterator_find_live(kmod_it, kmod_it->mod.prog);
+	if (!err)
+		err = kernel_module_section_iterator_init_memory(it, kmod_it);
+	if (!err || err == &drgn_enomem)
+		return err;
+	drgn_error_destroy(err);
+
+	if (asprintf(&path, "/sys/module/%s/sections", kmod_it->name) == -1)
+		return &drgn_enomem;
+	it->dir = opendir(path);
+	free(path);
+	if (!it->dir) {
+		return drgn_error_format_os("opendir", errno,
+					    "/sys/module/%s/sections",
+					    kmod_it->name);
 	}
+	it->dirfd = dirfd(it->dir);
+	if (it->dirfd == -1) {
+		err = drgn_error_format_os("dirfd", errno,
+					   "/sys/module/%s/sections",
+					   kmod_it->name);
+		closedir(it->dir);
+		return err;
+	}
+	return NULL;
 }
 
 static void
@@ -689,7 +966,7 @@ kernel_module_section_iterator_next_live(struct kernel_module_section_iterator *
 }
 
 static struct drgn_error *
-kernel_module_section_iterator_next_offline(struct kernel_module_section_iterator *it,
+kernel_module_section_iterator_next_memory(struct kernel_module_section_iterator *it,
 					    const char **name_ret,
 					    uint64_t *address_ret)
 {
@@ -708,7 +985,8 @@ kernel_module_section_iterator_next_offline(struct kernel_module_section_iterato
 	err = drgn_object_read_unsigned(&kmod_it->tmp3, address_ret);
 	if (err)
 		return err;
-	err = drgn_object_member(&kmod_it->tmp3, &kmod_it->tmp2, "name");
+	err = drgn_object_member(&kmod_it->tmp3, &kmod_it->tmp2,
+				 it->name_member);
 	if (err)
 		return err;
 	err = drgn_object_read_c_string(&kmod_it->tmp3, &name);
@@ -728,8 +1006,8 @@ kernel_module_section_iterator_next(struct kernel_module_section_iterator *it,
 		return kernel_module_section_iterator_next_live(it, name_ret,
 								address_ret);
 	} else {
-		return kernel_module_section_iterator_next_offline(it, name_ret,
-								   address_ret);
+		return kernel_module_section_iterator_next_memory(it, name_ret,
+								  address_ret);
 	}
 }
 
@@ -818,82 +1096,248 @@ out:
 	return err;
 }
 
-static const char *kmod_index_find(struct kmod_index *index, const char *key)
+/* Map from module name to path relative to /lib/modules/$(uname -r). */
+DEFINE_HASH_MAP(depmod_path_map, const char *, struct string, c_string_hash,
+		c_string_eq)
+
+/*
+ * Parsed modules.dep.bin for a kernel release.
+ *
+ * These are cached for the lifetime of the process and shared by every program
+ * for the same release, since a process may create many programs (e.g., one
+ * per vmcore). See depmod_index_get().
+ */
+struct depmod_index {
+	char *osrelease;
+	struct kmod_index modules_dep;
+	/* Identity of modules.dep.bin when it was mapped. */
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime;
+	/*
+	 * Every module in the index. The names are owned by the map, and the
+	 * paths point into the mapping.
+	 */
+	struct depmod_path_map paths;
+	/* Number of users. Protected by depmod_cache_lock. */
+	unsigned int refcount;
+	struct depmod_index *next;
+};
+
+static pthread_mutex_t depmod_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct depmod_index *depmod_cache;
+
+/* Add the first value of a node, which is "path: dependencies...". */
+static bool depmod_index_add_value(struct depmod_index *depmod,
+				   const char *ptr, const char *name)
+{
+	struct depmod_path_map_entry entry;
+	uint32_t value_count;
+	const char *deps;
+	size_t deps_len;
+	const char *colon;
+	int r;
+
+	if (!read_be32(&ptr, depmod->modules_dep.end, &value_count) ||
+	    !value_count)
+		return true;
+	/* Skip over priority. */
+	ptr += 4;
+	if (!read_string(&ptr, depmod->modules_dep.end, &deps, &deps_len))
+		return true;
+	colon = strchr(deps, ':');
+	if (!colon)
+		return true;
+	entry.key = strdup(name);
+	if (!entry.key)
+		return false;
+	entry.value.str = deps;
+	entry.value.len = colon - deps;
+	r = depmod_path_map_insert(&depmod->paths, &entry, NULL);
+	if (r != 1)
+		free((char *)entry.key);
+	return r != -1;
+}
+
+/*
+ * Walk the trie rooted at the node whose offset is at *ptr, adding every key
+ * and its path. key contains the key so far, which is key_len bytes long.
+ * Returns false if we couldn't allocate memory.
+ */
+static bool depmod_index_add_node(struct depmod_index *depmod,
+				  const char *ptr, char *key, size_t key_len,
+				  size_t key_capacity)
 {
 	static const uint32_t INDEX_NODE_MASK = UINT32_C(0x0fffffff);
 	static const uint32_t INDEX_NODE_CHILDS = UINT32_C(0x20000000);
 	static const uint32_t INDEX_NODE_VALUES = UINT32_C(0x40000000);
 	static const uint32_t INDEX_NODE_PREFIX = UINT32_C(0x80000000);
-	const char *ptr = index->ptr + 8;
+	struct kmod_index *index = &depmod->modules_dep;
 	uint32_t offset;
 
-	for (;;) {
-		if (!read_be32(&ptr, index->end, &offset))
-			return NULL;
-		ptr = index->ptr + (offset & INDEX_NODE_MASK);
-
-		if (offset & INDEX_NODE_PREFIX) {
-			const char *prefix;
-			size_t prefix_len;
-
-			if (!read_string(&ptr, index->end, &prefix,
-					 &prefix_len))
-				return NULL;
-			if (strncmp(key, prefix, prefix_len) != 0)
-				return NULL;
-			key += prefix_len;
-		}
+	if (!read_be32(&ptr, index->end, &offset) ||
+	    !(offset & INDEX_NODE_MASK))
+		return true;
+	ptr = index->ptr + (offset & INDEX_NODE_MASK);
 
-		if (offset & INDEX_NODE_CHILDS) {
-			uint8_t first, last;
+	if (offset & INDEX_NODE_PREFIX) {
+		const char *prefix;
+		size_t prefix_len;
 
-			if (!read_u8(&ptr, index->end, &first) ||
-			    !read_u8(&ptr, index->end, &last))
-				return NULL;
-			if (*key) {
-				uint8_t cur = *key;
+		if (!read_string(&ptr, index->end, &prefix, &prefix_len) ||
+		    prefix_len >= key_capacity - key_len)
+			return true;
+		memcpy(key + key_len, prefix, prefix_len);
+		key_len += prefix_len;
+	}
 
-				if (cur < first || cur > last)
-					return NULL;
-				ptr += 4 * (cur - first);
-				key++;
-				continue;
-			} else {
-				ptr += 4 * (last - first + 1);
-				break;
+	if (offset & INDEX_NODE_CHILDS) {
+		uint8_t first, last;
+		unsigned int c;
+
+		if (!read_u8(&ptr, index->end, &first) ||
+		    !read_u8(&ptr, index->end, &last) || first > last)
+			return true;
+		if (key_len + 1 < key_capacity) {
+			for (c = first; c <= last; c++) {
+				key[key_len] = c;
+				if (!depmod_index_add_node(depmod,
+							   ptr + 4 * (c - first),
+							   key, key_len + 1,
+							   key_capacity))
+					return false;
 			}
-		} else if (*key) {
-			return NULL;
-		} else {
-			break;
 		}
+		ptr += 4 * (last - first + 1);
 	}
-	if (!(offset & INDEX_NODE_VALUES))
-		return NULL;
-	return ptr;
+
+	if (offset & INDEX_NODE_VALUES) {
+		key[key_len] = '\0';
+		return depmod_index_add_value(depmod, ptr, key);
+	}
+	return true;
 }
 
-struct depmod_index {
-	struct kmod_index modules_dep;
-};
+static void depmod_index_free_paths(struct depmod_index *depmod)
+{
+	struct depmod_path_map_iterator it;
+
+	for (it = depmod_path_map_first(&depmod->paths); it.entry;
+	     it = depmod_path_map_next(it))
+		free((char *)it.entry->key);
+	depmod_path_map_deinit(&depmod->paths);
+}
+
+static struct drgn_error *depmod_index_load(struct depmod_index *depmod,
+					    const char *path,
+					    const struct stat *st)
+{
+	struct drgn_error *err;
+	char key[256];
+
+	err = kmod_index_init(&depmod->modules_dep, path);
+	if (err)
+		return err;
+	depmod->dev = st->st_dev;
+	depmod->ino = st->st_ino;
+	depmod->mtime = st->st_mtim;
+	depmod_path_map_init(&depmod->paths);
+	if (!depmod_index_add_node(depmod, depmod->modules_dep.ptr + 8, key, 0,
+				   sizeof(key))) {
+		depmod_index_free_paths(depmod);
+		kmod_index_deinit(&depmod->modules_dep);
+		return &drgn_enomem;
+	}
+	return NULL;
+}
 
-static struct drgn_error *depmod_index_init(struct depmod_index *depmod,
-					    const char *osrelease)
+/*
+ * Get the depmod index for a kernel release, loading it if it isn't cached or
+ * if the file changed since it was cached. The returned index must be released
+ * with depmod_index_put().
+ */
+static struct drgn_error *depmod_index_get(const char *osrelease,
+					   struct depmod_index **ret)
 {
+	struct drgn_error *err;
 	char path[256];
+	struct stat st;
+	struct depmod_index *depmod;
 
 	snprintf(path, sizeof(path), "/lib/modules/%s/modules.dep.bin",
 		 osrelease);
-	return kmod_index_init(&depmod->modules_dep, path);
+	if (stat(path, &st) == -1)
+		return drgn_error_create_os("stat", errno, path);
+
+	pthread_mutex_lock(&depmod_cache_lock);
+	for (depmod = depmod_cache; depmod; depmod = depmod->next) {
+		if (strcmp(depmod->osrelease, osrelease) == 0)
+			break;
+	}
+	if (depmod) {
+		/*
+		 * If the file was replaced but the old index is still in use,
+		 * keep using it rather than unmapping it out from under anyone.
+		 */
+		if (depmod->refcount == 0 &&
+		    (depmod->dev != st.st_dev || depmod->ino != st.st_ino ||
+		     depmod->mtime.tv_sec != st.st_mtim.tv_sec ||
+		     depmod->mtime.tv_nsec != st.st_mtim.tv_nsec)) {
+			depmod_index_free_paths(depmod);
+			kmod_index_deinit(&depmod->modules_dep);
+			err = depmod_index_load(depmod, path, &st);
+			if (err) {
+				/* Drop it; it is reloaded next time. */
+				struct depmod_index **pp = &depmod_cache;
+
+				while (*pp != depmod)
+					pp = &(*pp)->next;
+				*pp = depmod->next;
+				free(depmod->osrelease);
+				free(depmod);
+				goto out;
+			}
+		}
+	} else {
+		depmod = malloc(sizeof(*depmod));
+		if (!depmod) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		depmod->osrelease = strdup(osrelease);
+		if (!depmod->osrelease) {
+			free(depmod);
+			err = &drgn_enomem;
+			goto out;
+		}
+		err = depmod_index_load(depmod, path, &st);
+		if (err) {
+			free(depmod->osrelease);
+			free(depmod);
+			goto out;
+		}
+		depmod->refcount = 0;
+		depmod->next = depmod_cache;
+		depmod_cache = depmod;
+	}
+	depmod->refcount++;
+	*ret = depmod;
+	err = NULL;
+out:
+	pthread_mutex_unlock(&depmod_cache_lock);
+	return err;
 }
 
-static void depmod_index_deinit(struct depmod_index *depmod)
+static void depmod_index_put(struct depmod_index *depmod)
 {
-	kmod_index_deinit(&depmod->modules_dep);
+	pthread_mutex_lock(&depmod_cache_lock);
+	depmod->refcount--;
+	pthread_mutex_unlock(&depmod_cache_lock);
 }
 
 /*
- * Look up the path of the kernel module with the given name.
+ * Look up the path of the kernel module with the given name. This doesn't
+ * modify the index, so it is safe to call in parallel.
  *
  * @param[in] name Name of the kernel module.
  * @param[out] path_ret Returned path of the kernel module, relative to
@@ -904,32 +1348,13 @@ static void depmod_index_deinit(struct depmod_index *depmod)
 static bool depmod_index_find(struct depmod_index *depmod, const char *name,
 			      const char **path_ret, size_t *len_ret)
 {
-	const char *ptr;
-	uint32_t value_count;
-	const char *deps;
-	size_t deps_len;
-	char *colon;
-
-	ptr = kmod_index_find(&depmod->modules_dep, name);
-	if (!ptr)
-		return false;
-
-	if (!read_be32(&ptr, depmod->modules_dep.end, &value_count) ||
-	    !value_count)
-		return false;
-
-	/* Skip over priority. */
-	ptr += 4;
-	if (!read_string(&ptr, depmod->modules_dep.end, &deps,
-			 &deps_len))
-		return false;
+	struct depmod_path_map_iterator it;
 
-	colon = strchr(deps, ':');
-	if (!colon)
+	it = depmod_path_map_search(&depmod->paths, &name);
+	if (!it.entry)
 		return false;
-
-	*path_ret = deps;
-	*len_ret = colon - deps;
+	*path_ret = it.entry->value.str;
+	*len_ret = it.entry->value.len;
 	return true;
 }
 
@@ -1014,38 +1439,392 @@ get_kernel_module_name_from_modinfo(Elf_Scn *modinfo_scn, const char **ret)
  * offsetof(struct module, name).
  */
 static struct drgn_error *
-get_kernel_module_name_from_this_module(Elf_Scn *this_module_scn,
-					size_t name_offset, const char **ret)
+get_kernel_module_name_from_this_module(Elf_Scn *this_module_scn,
+					size_t name_offset, const char **ret)
+{
+	struct drgn_error *err;
+	Elf_Data *data;
+	const char *p, *nul;
+
+	if (this_module_scn) {
+		err = read_elf_section(this_module_scn, &data);
+		if (err)
+			return err;
+		if (name_offset < data->d_size) {
+			p = data->d_buf + name_offset;
+			nul = memchr(p, 0, data->d_size - name_offset);
+			if (nul && nul != p) {
+				*ret = p;
+				return NULL;
+			}
+		}
+	}
+	*ret = NULL;
+	return NULL;
+}
+
+DEFINE_HASH_MAP(elf_scn_name_map, const char *, Elf_Scn *, c_string_hash,
+		c_string_eq)
+
+/* Name and address of a loaded kernel module section. */
+struct kernel_module_section {
+	char *name;
+	uint64_t address;
+};
+
+DEFINE_VECTOR(kernel_module_section_vector, struct kernel_module_section)
+
+static void
+kernel_module_section_vector_free(struct kernel_module_section_vector *sections)
+{
+	for (size_t i = 0; i < sections->size; i++)
+		free(sections->data[i].name);
+	kernel_module_section_vector_deinit(sections);
+}
+
+/*
+ * Read the section addresses of the current module of a kernel module iterator
+ * from the program.
+ */
+static struct drgn_error *
+read_kernel_module_sections(struct kernel_module_iterator *kmod_it,
+			    struct kernel_module_section_vector *ret)
+{
+	struct drgn_error *err;
+	struct kernel_module_section_iterator section_it;
+	err = kernel_module_section_iterator_init(&section_it, kmod_it);
+	if (err)
+		return err;
+	const char *name;
+	uint64_t address;
+	while (!(err = kernel_module_section_iterator_next(&section_it, &name,
+							   &address))) {
+		struct kernel_module_section *section =
+			kernel_module_section_vector_append_entry(ret);
+		if (!section) {
+			err = &drgn_enomem;
+			break;
+		}
+		section->name = strdup(name);
+		if (!section->name) {
+			ret->size--;
+			err = &drgn_enomem;
+			break;
+		}
+		section->address = address;
+	}
+	kernel_module_section_iterator_deinit(&section_it);
+	if (err && err->code != DRGN_ERROR_STOP)
+		return err;
+	return NULL;
+}
+
+static struct drgn_error *
+copy_kernel_module_sections(const struct kernel_module_section_vector *sections,
+			    struct kernel_module_section_vector *ret)
+{
+	for (size_t i = 0; i < sections->size; i++) {
+		struct kernel_module_section *section =
+			kernel_module_section_vector_append_entry(ret);
+		if (!section)
+			return &drgn_enomem;
+		section->name = strdup(sections->data[i].name);
+		if (!section->name) {
+			ret->size--;
+			return &drgn_enomem;
+		}
+		section->address = sections->data[i].address;
+	}
+	return NULL;
+}
+
+/*
+ * Reading the section addresses of a live kernel requires reading every file
+ * in /sys/module/$name/sections, which adds up to thousands of files. They are
+ * saved to kernel-module-layout in the DWARF index cache directory along with
+ * the boot ID, so later runs in the same boot can skip that. The saved sections
+ * of a module are only used if its address range in /proc/modules hasn't
+ * changed.
+ *
+ * The file contains the boot ID on the first line, followed by a line with the
+ * name, start address, end address, and number of sections of each module, and
+ * a line with the address and name of each of its sections.
+ */
+struct kernel_module_layout_entry {
+	uint64_t start, end;
+	struct kernel_module_section_vector sections;
+	/* Whether the module was seen in this run. Others are not saved. */
+	bool seen;
+};
+
+DEFINE_HASH_MAP(kernel_module_layout_map, char *,
+		struct kernel_module_layout_entry, c_string_hash, c_string_eq)
+
+struct kernel_module_layout {
+	char *path;
+	char boot_id[64];
+	struct kernel_module_layout_map map;
+	bool dirty;
+};
+
+static void
+kernel_module_layout_map_free(struct kernel_module_layout_map *map)
+{
+	struct kernel_module_layout_map_iterator it;
+
+	for (it = kernel_module_layout_map_first(map); it.entry;
+	     it = kernel_module_layout_map_next(it)) {
+		kernel_module_section_vector_free(&it.entry->value.sections);
+		free(it.entry->key);
+	}
+	kernel_module_layout_map_deinit(map);
+}
+
+static void kernel_module_layout_read(struct kernel_module_layout *layout)
+{
+	FILE *file;
+	char *line = NULL;
+	size_t n = 0;
+	ssize_t len;
+
+	file = fopen(layout->path, "r");
+	if (!file)
+		return;
+	len = getline(&line, &n, file);
+	if (len <= 0 || line[len - 1] != '\n')
+		goto out;
+	line[len - 1] = '\0';
+	if (strcmp(line, layout->boot_id) != 0) {
+		/* This is from a previous boot. */
+		layout->dirty = true;
+		goto out;
+	}
+	while ((len = getline(&line, &n, file)) != -1) {
+		struct kernel_module_layout_map_entry entry;
+		uint64_t nsections, i;
+		int name_end;
+
+		if (sscanf(line, "%*s%n %" SCNx64 " %" SCNx64 " %" SCNu64,
+			   &name_end, &entry.value.start, &entry.value.end,
+			   &nsections) != 3)
+			break;
+		line[name_end] = '\0';
+		entry.key = strdup(line);
+		if (!entry.key)
+			break;
+		kernel_module_section_vector_init(&entry.value.sections);
+		entry.value.seen = false;
+		for (i = 0; i < nsections; i++) {
+			struct kernel_module_section *section;
+			int name_start;
+
+			if ((len = getline(&line, &n, file)) <= 0)
+				break;
+			if (line[len - 1] == '\n')
+				line[len - 1] = '\0';
+			section = kernel_module_section_vector_append_entry(&entry.value.sections);
+			if (!section)
+				break;
+			if (sscanf(line, "%" SCNx64 " %n", &section->address,
+				   &name_start) != 1 ||
+			    !(section->name = strdup(line + name_start))) {
+				entry.value.sections.size--;
+				break;
+			}
+		}
+		if (i < nsections ||
+		    kernel_module_layout_map_insert(&layout->map, &entry,
+						    NULL) != 1) {
+			kernel_module_section_vector_free(&entry.value.sections);
+			free(entry.key);
+			/* The file is truncated or corrupt. */
+			layout->dirty = true;
+			break;
+		}
+	}
+out:
+	free(line);
+	fclose(file);
+}
+
+static void kernel_module_layout_init(struct kernel_module_layout *layout,
+				      struct drgn_dwarf_index *dindex)
+{
+	FILE *file;
+	size_t len;
+
+	layout->path = NULL;
+	kernel_module_layout_map_init(&layout->map);
+	layout->dirty = false;
+	/* This is only used for live kernels. */
+	if (!dindex || !dindex->cache_dir)
+		return;
+	file = fopen("/proc/sys/kernel/random/boot_id", "r");
+	if (!file)
+		return;
+	if (!fgets(layout->boot_id, sizeof(layout->boot_id), file)) {
+		fclose(file);
+		return;
+	}
+	fclose(file);
+	len = strlen(layout->boot_id);
+	if (len && layout->boot_id[len - 1] == '\n')
+		layout->boot_id[--len] = '\0';
+	if (!len ||
+	    asprintf(&layout->path, "%s/kernel-module-layout",
+		     dindex->cache_dir) == -1) {
+		layout->path = NULL;
+		return;
+	}
+	kernel_module_layout_read(layout);
+}
+
+/* Like the index cache, saving this fails silently. */
+static void kernel_module_layout_write(struct kernel_module_layout *layout,
+				       struct drgn_dwarf_index *dindex)
+{
+	struct kernel_module_layout_map_iterator it;
+	char *tmp_path;
+	int fd;
+	FILE *file;
+	bool ok;
+
+	/* Modules which were unloaded also need to be dropped. */
+	for (it = kernel_module_layout_map_first(&layout->map); it.entry;
+	     it = kernel_module_layout_map_next(it)) {
+		if (!it.entry->value.seen)
+			layout->dirty = true;
+	}
+	if (!layout->dirty || !drgn_dwarf_index_create_cache_dir(dindex))
+		return;
+	if (asprintf(&tmp_path, "%s.XXXXXX", layout->path) == -1)
+		return;
+	fd = mkstemp(tmp_path);
+	if (fd == -1)
+		goto out;
+	file = fdopen(fd, "w");
+	if (!file) {
+		close(fd);
+		unlink(tmp_path);
+		goto out;
+	}
+	ok = fprintf(file, "%s\n", layout->boot_id) >= 0;
+	for (it = kernel_module_layout_map_first(&layout->map);
+	     ok && it.entry; it = kernel_module_layout_map_next(it)) {
+		const struct kernel_module_layout_entry *entry =
+			&it.entry->value;
+
+		if (!entry->seen)
+			continue;
+		ok = fprintf(file, "%s %" PRIx64 " %" PRIx64 " %zu\n",
+			     it.entry->key, entry->start, entry->end,
+			     entry->sections.size) >= 0;
+		for (size_t i = 0; ok && i < entry->sections.size; i++) {
+			ok = fprintf(file, "%" PRIx64 " %s\n",
+				     entry->sections.data[i].address,
+				     entry->sections.data[i].name) >= 0;
+		}
+	}
+	if (fclose(file) == EOF)
+		ok = false;
+	/* Replace the file atomically in case it's being read. */
+	if (!ok || rename(tmp_path, layout->path) == -1)
+		unlink(tmp_path);
+out:
+	free(tmp_path);
+}
+
+static void kernel_module_layout_deinit(struct kernel_module_layout *layout)
+{
+	kernel_module_layout_map_free(&layout->map);
+	free(layout->path);
+}
+
+/*
+ * Keep the saved sections of the current module of a kernel module iterator if
+ * it is still loaded at the same address, even if they aren't needed this time.
+ */
+static void kernel_module_layout_visit(struct kernel_module_iterator *kmod_it)
+{
+	struct kernel_module_layout_map_iterator it;
+	char *name = kmod_it->name;
+
+	it = kernel_module_layout_map_search(&kmod_it->layout->map, &name);
+	if (it.entry && it.entry->value.start == kmod_it->start &&
+	    it.entry->value.end == kmod_it->end)
+		it.entry->value.seen = true;
+}
+
+/*
+ * Get the section addresses of the current module of a kernel module iterator,
+ * using the saved layout if possible. This reads from the program, so it must
+ * be done serially.
+ */
+static struct drgn_error *
+get_kernel_module_sections(struct kernel_module_iterator *kmod_it,
+			   struct kernel_module_section_vector *ret)
 {
 	struct drgn_error *err;
-	Elf_Data *data;
-	const char *p, *nul;
+	struct kernel_module_layout *layout = kmod_it->layout;
+	struct kernel_module_layout_map_entry entry;
+	struct kernel_module_layout_map_iterator it;
+	char *name = kmod_it->name;
+
+	if (!layout)
+		return read_kernel_module_sections(kmod_it, ret);
+
+	it = kernel_module_layout_map_search(&layout->map, &name);
+	if (it.entry && it.entry->value.start == kmod_it->start &&
+	    it.entry->value.end == kmod_it->end) {
+		it.entry->value.seen = true;
+		return copy_kernel_module_sections(&it.entry->value.sections,
+						   ret);
+	}
 
-	if (this_module_scn) {
-		err = read_elf_section(this_module_scn, &data);
-		if (err)
-			return err;
-		if (name_offset < data->d_size) {
-			p = data->d_buf + name_offset;
-			nul = memchr(p, 0, data->d_size - name_offset);
-			if (nul && nul != p) {
-				*ret = p;
-				return NULL;
-			}
-		}
+	err = read_kernel_module_sections(kmod_it, ret);
+	if (err)
+		return err;
+	/* Failing to save the sections isn't an error. */
+	if (it.entry) {
+		kernel_module_section_vector_free(&it.entry->value.sections);
+		kernel_module_section_vector_init(&it.entry->value.sections);
+		it.entry->value.start = kmod_it->start;
+		it.entry->value.end = kmod_it->end;
+		it.entry->value.seen = true;
+		if (!copy_kernel_module_sections(ret,
+						 &it.entry->value.sections))
+			layout->dirty = true;
+		else
+			it.entry->value.seen = false;
+		return NULL;
 	}
-	*ret = NULL;
+	entry.key = strdup(kmod_it->name);
+	if (!entry.key)
+		return NULL;
+	entry.value.start = kmod_it->start;
+	entry.value.end = kmod_it->end;
+	entry.value.seen = true;
+	kernel_module_section_vector_init(&entry.value.sections);
+	if (copy_kernel_module_sections(ret, &entry.value.sections) ||
+	    kernel_module_layout_map_insert(&layout->map, &entry, NULL) != 1) {
+		kernel_module_section_vector_free(&entry.value.sections);
+		free(entry.key);
+		return NULL;
+	}
+	layout->dirty = true;
 	return NULL;
 }
 
-DEFINE_HASH_MAP(elf_scn_name_map, const char *, Elf_Scn *, c_string_hash,
-		c_string_eq)
-
+/*
+ * Set the addresses of the sections in a kernel module ELF file to where they
+ * were loaded and return the address range of the module. This only touches
+ * the given Elf handle, so it may be called in parallel for different files.
+ */
 static struct drgn_error *
-cache_kernel_module_sections(struct kernel_module_iterator *kmod_it, Elf *elf,
-			     uint64_t *start_ret, uint64_t *end_ret)
+apply_kernel_module_sections(const struct kernel_module_section_vector *sections,
+			     Elf *elf, uint64_t *start_ret, uint64_t *end_ret)
 {
-	struct drgn_error *err;
+	struct drgn_error *err = NULL;
 
 	size_t shstrndx;
 	if (elf_getshdrstrndx(elf, &shstrndx))
@@ -1083,14 +1862,9 @@ cache_kernel_module_sections(struct kernel_module_iterator *kmod_it, Elf *elf,
 	}
 
 	uint64_t start = UINT64_MAX, end = 0;
-	struct kernel_module_section_iterator section_it;
-	err = kernel_module_section_iterator_init(&section_it, kmod_it);
-	if (err)
-		goto out_scn_map;
-	const char *name;
-	uint64_t address;
-	while (!(err = kernel_module_section_iterator_next(&section_it, &name,
-							   &address))) {
+	for (size_t i = 0; i < sections->size; i++) {
+		const char *name = sections->data[i].name;
+		uint64_t address = sections->data[i].address;
 		struct elf_scn_name_map_iterator it =
 			elf_scn_name_map_search(&scn_map, &name);
 		if (it.entry) {
@@ -1099,12 +1873,12 @@ cache_kernel_module_sections(struct kernel_module_iterator *kmod_it, Elf *elf,
 						       &shdr_mem);
 			if (!shdr) {
 				err = drgn_error_libelf();
-				break;
+				goto out_scn_map;
 			}
 			shdr->sh_addr = address;
 			if (!gelf_update_shdr(it.entry->value, shdr)) {
 				err = drgn_error_libelf();
-				break;
+				goto out_scn_map;
 			}
 			uint64_t section_end;
 			if (__builtin_add_overflow(address, shdr->sh_size,
@@ -1118,20 +1892,31 @@ cache_kernel_module_sections(struct kernel_module_iterator *kmod_it, Elf *elf,
 			}
 		}
 	}
-	if (err && err->code != DRGN_ERROR_STOP)
-		goto out_section_it;
-	err = NULL;
 	if (start >= end)
 		start = end = 0;
 	*start_ret = start;
 	*end_ret = end;
-out_section_it:
-	kernel_module_section_iterator_deinit(&section_it);
 out_scn_map:
 	elf_scn_name_map_deinit(&scn_map);
 	return err;
 }
 
+static struct drgn_error *
+cache_kernel_module_sections(struct kernel_module_iterator *kmod_it, Elf *elf,
+			     uint64_t *start_ret, uint64_t *end_ret)
+{
+	struct drgn_error *err;
+	struct kernel_module_section_vector sections = VECTOR_INIT;
+
+	err = get_kernel_module_sections(kmod_it, &sections);
+	if (!err) {
+		err = apply_kernel_module_sections(&sections, elf, start_ret,
+						   end_ret);
+	}
+	kernel_module_section_vector_free(&sections);
+	return err;
+}
+
 struct kernel_module_file {
 	const char *path;
 	int fd;
@@ -1203,11 +1988,106 @@ report_loaded_kernel_module(struct drgn_program *prog,
 	return NULL;
 }
 
-static struct drgn_error *
-report_default_kernel_module(struct drgn_program *prog,
-			     struct drgn_dwarf_index *dindex,
-			     struct kernel_module_iterator *kmod_it,
-			     struct depmod_index *depmod)
+/*
+ * Loaded kernel module to look for at the standard locations. Finding and
+ * opening the files is done in parallel, then the results are reported in the
+ * order that the modules were found.
+ */
+struct default_kernel_module {
+	char *name;
+	struct kernel_module_section_vector sections;
+	/* Error getting sections, or NULL. */
+	struct drgn_error *sections_err;
+	/* Results of find_default_kernel_module(). */
+	char *path;
+	int fd;
+	Elf *elf;
+	uint64_t start, end;
+	/* Error to report instead, if any. */
+	bool failed;
+	const char *report_name;
+	const char *report_message;
+	struct drgn_error *report_err;
+};
+
+DEFINE_VECTOR(default_kernel_module_vector, struct default_kernel_module)
+
+static void default_kernel_module_deinit(struct default_kernel_module *kmod)
+{
+	if (kmod->elf)
+		elf_end(kmod->elf);
+	if (kmod->fd != -1)
+		close(kmod->fd);
+	free(kmod->path);
+	drgn_error_destroy(kmod->sections_err);
+	drgn_error_destroy(kmod->report_err);
+	kernel_module_section_vector_free(&kmod->sections);
+	free(kmod->name);
+}
+
+static void
+default_kernel_module_vector_free(struct default_kernel_module_vector *kmods)
+{
+	for (size_t i = 0; i < kmods->size; i++)
+		default_kernel_module_deinit(&kmods->data[i]);
+	default_kernel_module_vector_deinit(kmods);
+}
+
+/*
+ * Read the GNU build ID of a loaded kernel module from sysfs. This is only
+ * meaningful for the running kernel. Returns the length of the build ID, or 0
+ * if it couldn't be read.
+ */
+static size_t read_sysfs_module_build_id(const char *name, unsigned char *buf,
+					 size_t size)
+{
+	char *path;
+	int fd;
+	unsigned char notes[256];
+	ssize_t r;
+	size_t offset = 0;
+
+	if (asprintf(&path, "/sys/module/%s/notes/.note.gnu.build-id",
+		     name) == -1)
+		return 0;
+	fd = open(path, O_RDONLY);
+	free(path);
+	if (fd == -1)
+		return 0;
+	r = read(fd, notes, sizeof(notes));
+	close(fd);
+	if (r <= 0)
+		return 0;
+	while (offset + sizeof(GElf_Nhdr) <= (size_t)r) {
+		GElf_Nhdr nhdr;
+		size_t name_offset, desc_offset;
+
+		memcpy(&nhdr, &notes[offset], sizeof(nhdr));
+		name_offset = offset + sizeof(nhdr);
+		desc_offset = name_offset + ((nhdr.n_namesz + 3) & ~(size_t)3);
+		if (desc_offset + nhdr.n_descsz > (size_t)r)
+			break;
+		if (nhdr.n_type == NT_GNU_BUILD_ID && nhdr.n_namesz == 4 &&
+		    memcmp(&notes[name_offset], "GNU", 4) == 0 &&
+		    nhdr.n_descsz <= size) {
+			memcpy(buf, &notes[desc_offset], nhdr.n_descsz);
+			return nhdr.n_descsz;
+		}
+		offset = desc_offset + ((nhdr.n_descsz + 3) & ~(size_t)3);
+	}
+	return 0;
+}
+
+/*
+ * Find and open the file for a loaded kernel module and apply its section
+ * addresses. This doesn't touch the program, and the DWARF index is only used
+ * for its build ID location cache, which has its own lock, so it is safe to
+ * call in parallel.
+ */
+static void find_default_kernel_module(struct drgn_program *prog,
+				       struct drgn_dwarf_index *dindex,
+				       struct depmod_index *depmod,
+				       struct default_kernel_module *kmod)
 {
 	static const char * const module_paths[] = {
 		"/usr/lib/debug/lib/modules/%s/%.*s",
@@ -1219,16 +2099,34 @@ report_default_kernel_module(struct drgn_program *prog,
 	const char *depmod_path;
 	size_t depmod_path_len;
 	size_t extension_len;
-	char *path;
-	int fd;
-	Elf *elf;
-	uint64_t start, end;
+	unsigned char build_id[64];
+	size_t build_id_len = 0;
+	const void *elf_build_id;
+
+	/*
+	 * For the running kernel, we can get the build ID from sysfs and skip
+	 * the search if we already know where the file is.
+	 */
+	if (prog->flags & DRGN_PROGRAM_IS_LIVE) {
+		build_id_len = read_sysfs_module_build_id(kmod->name, build_id,
+							  sizeof(build_id));
+	}
+	if (build_id_len) {
+		kmod->fd = drgn_dwarf_index_open_build_id_location(dindex,
+								   build_id,
+								   build_id_len,
+								   &kmod->path,
+								   &kmod->elf);
+		if (kmod->fd != -1)
+			goto apply_sections;
+	}
 
-	if (!depmod_index_find(depmod, kmod_it->name, &depmod_path,
+	if (!depmod_index_find(depmod, kmod->name, &depmod_path,
 			       &depmod_path_len)) {
-		return drgn_dwarf_index_report_error(dindex, kmod_it->name,
-						     "could not find module in depmod",
-						     NULL);
+		kmod->failed = true;
+		kmod->report_name = kmod->name;
+		kmod->report_message = "could not find module in depmod";
+		return;
 	}
 
 	if (depmod_path_len >= 3 &&
@@ -1237,43 +2135,276 @@ report_default_kernel_module(struct drgn_program *prog,
 		extension_len = 3;
 	else
 		extension_len = 0;
-	err = find_elf_file(&path, &fd, &elf, module_paths,
+	err = find_elf_file(&kmod->path, &kmod->fd, &kmod->elf, module_paths,
 			    prog->vmcoreinfo.osrelease,
 			    depmod_path_len - extension_len, depmod_path,
 			    extension_len,
 			    depmod_path + depmod_path_len - extension_len);
-	if (err)
-		return drgn_dwarf_index_report_error(dindex, NULL, NULL, err);
-	if (!elf) {
-		return drgn_dwarf_index_report_error(dindex, kmod_it->name,
-						     "could not find .ko",
-						     NULL);
+	if (err) {
+		kmod->failed = true;
+		kmod->report_err = err;
+		return;
+	}
+	if (!kmod->elf && build_id_len) {
+		/* Fall back to downloading the debug file. */
+		kmod->fd = drgn_debuginfod_find(&dindex->debuginfod,
+						DRGN_DEBUGINFOD_DEBUGINFO,
+						build_id, build_id_len,
+						&kmod->path);
+		if (kmod->fd != -1) {
+			kmod->elf = dwelf_elf_begin(kmod->fd);
+			if (!kmod->elf) {
+				close(kmod->fd);
+				kmod->fd = -1;
+				free(kmod->path);
+				kmod->path = NULL;
+			}
+		}
+	}
+	if (!kmod->elf) {
+		kmod->failed = true;
+		kmod->report_name = kmod->name;
+		kmod->report_message = "could not find .ko";
+		return;
+	}
+	if (build_id_len &&
+	    dwelf_elf_gnu_build_id(kmod->elf, &elf_build_id) ==
+	    (ssize_t)build_id_len &&
+	    memcmp(elf_build_id, build_id, build_id_len) == 0) {
+		drgn_dwarf_index_add_build_id_location(dindex, build_id,
+						       build_id_len,
+						       kmod->path);
 	}
 
-	err = cache_kernel_module_sections(kmod_it, elf, &start, &end);
+apply_sections:
+	err = kmod->sections_err;
+	kmod->sections_err = NULL;
+	if (!err) {
+		err = apply_kernel_module_sections(&kmod->sections, kmod->elf,
+						   &kmod->start, &kmod->end);
+	}
 	if (err) {
-		elf_end(elf);
-		close(fd);
-		free(path);
-		return drgn_dwarf_index_report_error(dindex, path,
-						     "could not get section addresses",
-						     err);
+		kmod->failed = true;
+		kmod->report_name = kmod->path;
+		kmod->report_message = "could not get section addresses";
+		kmod->report_err = err;
 	}
+}
 
-	err = drgn_dwarf_index_report_elf(dindex, path, fd, elf, start, end,
-					  kmod_it->name, NULL);
-	free(path);
+static struct drgn_error *
+report_default_kernel_modules(struct drgn_program *prog,
+			      struct drgn_dwarf_index *dindex,
+			      struct default_kernel_module_vector *kmods,
+			      struct depmod_index *depmod, bool defer)
+{
+	struct drgn_error *err = NULL;
+	size_t i;
+
+	#pragma omp parallel for schedule(dynamic) \
+		num_threads(drgn_num_threads())
+	for (i = 0; i < kmods->size; i++)
+		find_default_kernel_module(prog, dindex, depmod,
+					   &kmods->data[i]);
+
+	for (i = 0; i < kmods->size; i++) {
+		struct default_kernel_module *kmod = &kmods->data[i];
+
+		if (kmod->failed) {
+			err = drgn_dwarf_index_report_error(dindex,
+							    kmod->report_name,
+							    kmod->report_message,
+							    kmod->report_err);
+			kmod->report_err = NULL;
+		} else if (defer) {
+			err = drgn_dwarf_index_defer_elf(dindex, kmod->path,
+							 kmod->fd, kmod->elf,
+							 kmod->start, kmod->end,
+							 kmod->name);
+		} else {
+			err = drgn_dwarf_index_report_elf(dindex, kmod->path,
+							  kmod->fd, kmod->elf,
+							  kmod->start, kmod->end,
+							  kmod->name, NULL);
+		}
+		if (!kmod->failed) {
+			/* The DWARF index takes ownership of these. */
+			kmod->elf = NULL;
+			kmod->fd = -1;
+		}
+		if (err)
+			break;
+	}
+	return err;
+}
+
+/* Loaded kernel module whose file is only found when it is needed. */
+struct deferred_kernel_module {
+	struct drgn_program *prog;
+	struct drgn_dwarf_index *dindex;
+	struct default_kernel_module kmod;
+	/*
+	 * Whether the section addresses still need to be read. If so, this is
+	 * the address of the module's struct module (for kernels other than
+	 * the running kernel).
+	 */
+	bool sections_pending;
+	uint64_t module_address;
+};
+
+static struct drgn_error *
+read_deferred_kernel_module_sections(struct deferred_kernel_module *deferred)
+{
+	struct drgn_error *err;
+	struct kernel_module_iterator kmod_it;
+
+	err = kernel_module_iterator_init_at(&kmod_it, deferred->prog,
+					     deferred->kmod.name,
+					     deferred->module_address);
+	if (err)
+		return err;
+	err = read_kernel_module_sections(&kmod_it, &deferred->kmod.sections);
+	kernel_module_iterator_deinit(&kmod_it);
 	return err;
 }
 
+static void deferred_kernel_module_destroy(void *arg)
+{
+	struct deferred_kernel_module *deferred = arg;
+
+	default_kernel_module_deinit(&deferred->kmod);
+	free(deferred);
+}
+
+static struct drgn_error *open_deferred_kernel_module(void *arg,
+						       char **path_ret,
+						       int *fd_ret,
+						       Elf **elf_ret,
+						       uint64_t *start_ret,
+						       uint64_t *end_ret)
+{
+	struct drgn_error *err;
+	struct deferred_kernel_module *deferred = arg;
+	struct default_kernel_module *kmod = &deferred->kmod;
+	struct depmod_index *depmod;
+
+	if (deferred->sections_pending) {
+		deferred->sections_pending = false;
+		kmod->sections_err =
+			read_deferred_kernel_module_sections(deferred);
+	}
+	err = depmod_index_get(deferred->prog->vmcoreinfo.osrelease, &depmod);
+	if (err)
+		return err;
+	find_default_kernel_module(deferred->prog, deferred->dindex, depmod,
+				   kmod);
+	depmod_index_put(depmod);
+	if (kmod->failed) {
+		err = kmod->report_err;
+		kmod->report_err = NULL;
+		if (!err) {
+			err = drgn_error_create(DRGN_ERROR_OTHER,
+						kmod->report_message);
+		}
+		return err;
+	}
+	*path_ret = kmod->path;
+	*fd_ret = kmod->fd;
+	*elf_ret = kmod->elf;
+	*start_ret = kmod->start;
+	*end_ret = kmod->end;
+	kmod->path = NULL;
+	kmod->fd = -1;
+	kmod->elf = NULL;
+	return NULL;
+}
+
+/*
+ * Defer finding the file for a loaded kernel module until an address in it is
+ * needed or a lookup misses, so that sessions which only need a few modules
+ * don't have to find, open, and parse the rest. If read_sections is false, the
+ * section addresses are also only read then.
+ */
+static struct drgn_error *
+defer_kernel_module(struct drgn_program *prog, struct drgn_dwarf_index *dindex,
+		    struct kernel_module_iterator *kmod_it, bool read_sections)
+{
+	struct drgn_error *err;
+	struct deferred_kernel_module *deferred;
+
+	deferred = calloc(1, sizeof(*deferred));
+	if (!deferred)
+		return &drgn_enomem;
+	deferred->prog = prog;
+	deferred->dindex = dindex;
+	deferred->kmod.fd = -1;
+	deferred->kmod.name = strdup(kmod_it->name);
+	if (!deferred->kmod.name) {
+		free(deferred);
+		return &drgn_enomem;
+	}
+	if (read_sections) {
+		deferred->kmod.sections_err =
+			get_kernel_module_sections(kmod_it,
+						   &deferred->kmod.sections);
+	} else {
+		deferred->sections_pending = true;
+		if (kmod_it->file) {
+			/*
+			 * Find the module in memory now, while the module list
+			 * only has to be walked once.
+			 */
+			err = kernel_module_iterator_find_live(kmod_it, prog);
+			if (err == &drgn_not_found)
+				err = NULL;
+			else if (!err)
+				err = drgn_object_read_unsigned(&kmod_it->mod,
+								&deferred->module_address);
+		} else {
+			err = drgn_object_read_unsigned(&kmod_it->mod,
+							&deferred->module_address);
+		}
+		if (err) {
+			deferred_kernel_module_destroy(deferred);
+			return err;
+		}
+	}
+	return drgn_dwarf_index_defer_module(dindex, kmod_it->name,
+					     kmod_it->start, kmod_it->end,
+					     open_deferred_kernel_module,
+					     deferred_kernel_module_destroy,
+					     deferred);
+}
+
 static struct drgn_error *
 report_loaded_kernel_modules(struct drgn_program *prog,
 			     struct drgn_dwarf_index *dindex,
 			     struct kernel_module_table *kmod_table,
-			     struct depmod_index *depmod)
+			     struct depmod_index **depmodp)
 {
 	struct drgn_error *err;
 	struct kernel_module_iterator kmod_it;
+	struct kernel_module_layout layout;
+	struct default_kernel_module_vector default_kmods = VECTOR_INIT;
+	const char *env;
+	int lazy;
+	bool defer;
+
+	/*
+	 * Modules found at the standard locations can be indexed lazily, the
+	 * first time that a lookup misses or an address in the module is
+	 * needed.
+	 */
+	env = getenv("DRGN_LAZY_KERNEL_MODULES");
+	lazy = env ? atoi(env) : 0;
+	defer = lazy > 0;
+	/*
+	 * At level 2, even listing the loaded modules waits until then, which
+	 * only works if they all come from the standard locations.
+	 */
+	if (lazy >= 2 && depmodp && !kmod_table) {
+		prog->kernel_modules_pending = true;
+		return NULL;
+	}
 
 	err = kernel_module_iterator_init(&kmod_it, prog);
 	if (err) {
@@ -1282,6 +2413,9 @@ kernel_module_iterator_error:
 						     "could not find loaded kernel modules",
 						     err);
 	}
+	kernel_module_layout_init(&layout, kmod_it.file ? dindex : NULL);
+	if (layout.path)
+		kmod_it.layout = &layout;
 	for (;;) {
 		err = kernel_module_iterator_next(&kmod_it);
 		if (err && err->code == DRGN_ERROR_STOP) {
@@ -1289,8 +2423,12 @@ kernel_module_iterator_error:
 			break;
 		} else if (err) {
 			kernel_module_iterator_deinit(&kmod_it);
+			kernel_module_layout_deinit(&layout);
+			default_kernel_module_vector_free(&default_kmods);
 			goto kernel_module_iterator_error;
 		}
+		if (kmod_it.layout)
+			kernel_module_layout_visit(&kmod_it);
 
 		/* Look for an explicitly-reported file first. */
 		if (kmod_table) {
@@ -1307,30 +2445,94 @@ kernel_module_iterator_error:
 		 * defaults, look for the module at the standard locations unless we've
 		 * already indexed that module.
 		 */
-		if (depmod &&
-		    !drgn_dwarf_index_is_indexed(dindex, kmod_it.name)) {
-			if (!depmod->modules_dep.ptr) {
-				err = depmod_index_init(depmod,
-							prog->vmcoreinfo.osrelease);
+		if (depmodp &&
+		    !drgn_dwarf_index_is_indexed(dindex, kmod_it.name) &&
+		    !drgn_dwarf_index_is_deferred(dindex, kmod_it.name)) {
+			if (!*depmodp) {
+				err = depmod_index_get(prog->vmcoreinfo.osrelease,
+						       depmodp);
 				if (err) {
-					depmod->modules_dep.ptr = NULL;
 					err = drgn_dwarf_index_report_error(dindex,
 									    "kernel modules",
 									    "could not read depmod",
 									    err);
 					if (err)
 						break;
-					depmod = NULL;
+					depmodp = NULL;
 					continue;
 				}
 			}
-			err = report_default_kernel_module(prog, dindex,
-							   &kmod_it, depmod);
-			if (err)
+			if (defer && kmod_it.start < kmod_it.end) {
+				err = defer_kernel_module(prog, dindex,
+							  &kmod_it, true);
+				if (err)
+					break;
+				continue;
+			}
+			struct default_kernel_module *kmod =
+				default_kernel_module_vector_append_entry(&default_kmods);
+			if (!kmod) {
+				err = &drgn_enomem;
+				break;
+			}
+			memset(kmod, 0, sizeof(*kmod));
+			kmod->fd = -1;
+			kmod->name = strdup(kmod_it.name);
+			if (!kmod->name) {
+				err = &drgn_enomem;
 				break;
+			}
+			/* Section addresses are read from the program serially. */
+			kmod->sections_err =
+				get_kernel_module_sections(&kmod_it,
+							   &kmod->sections);
 		}
 	}
 	kernel_module_iterator_deinit(&kmod_it);
+	if (!err && kmod_it.layout)
+		kernel_module_layout_write(&layout, dindex);
+	kernel_module_layout_deinit(&layout);
+	if (!err) {
+		err = report_default_kernel_modules(prog, dindex,
+						    &default_kmods,
+						    depmodp ? *depmodp : NULL,
+						    defer);
+	}
+	default_kernel_module_vector_free(&default_kmods);
+	return err;
+}
+
+/*
+ * Register every loaded kernel module which hasn't been indexed or deferred yet
+ * as a deferred module, reading only the module list. This is done the first
+ * time that a lookup needs modules if $DRGN_LAZY_KERNEL_MODULES is 2. That is
+ * in the middle of an unrelated lookup, so failing to list the modules is
+ * ignored.
+ */
+struct drgn_error *
+linux_kernel_defer_loaded_modules(struct drgn_program *prog,
+				  struct drgn_dwarf_index *dindex)
+{
+	struct drgn_error *err;
+	struct kernel_module_iterator kmod_it;
+
+	err = kernel_module_iterator_init(&kmod_it, prog);
+	if (err)
+		goto out;
+	while (!(err = kernel_module_iterator_next(&kmod_it))) {
+		if (drgn_dwarf_index_is_indexed(dindex, kmod_it.name) ||
+		    drgn_dwarf_index_is_deferred(dindex, kmod_it.name))
+			continue;
+		err = defer_kernel_module(prog, dindex, &kmod_it, false);
+		if (err)
+			break;
+	}
+	kernel_module_iterator_deinit(&kmod_it);
+out:
+	if (err && err->code != DRGN_ERROR_NO_MEMORY) {
+		drgn_error_destroy(err);
+		err = NULL;
+	}
 	return err;
 }
 
@@ -1380,9 +2582,8 @@ report_kernel_modules(struct drgn_program *prog,
 	}
 
 	struct kernel_module_table kmod_table = HASH_TABLE_INIT;
-	struct depmod_index depmod;
+	struct depmod_index *depmod = NULL;
 	struct kernel_module_table_iterator it;
-	depmod.modules_dep.ptr = NULL;
 	for (size_t i = 0; i < num_kmods; i++) {
 		struct kernel_module_file *kmod = &kmods[i];
 		if (!kmod->name) {
@@ -1449,8 +2650,8 @@ report_kernel_modules(struct drgn_program *prog,
 	}
 	err = NULL;
 out:
-	if (depmod.modules_dep.ptr)
-		depmod_index_deinit(&depmod);
+	if (depmod)
+		depmod_index_put(depmod);
 	kernel_module_table_deinit(&kmod_table);
 	return err;
 }
@@ -1505,6 +2706,48 @@ static struct drgn_error *report_vmlinux(struct drgn_program *prog,
 	return err;
 }
 
+/* File passed to linux_kernel_report_debug_info() after it was opened. */
+struct kernel_elf_file {
+	int fd;
+	Elf *elf;
+	/* Error opening or identifying the file. */
+	struct drgn_error *err;
+	Elf_Scn *this_module_scn, *modinfo_scn;
+	bool is_vmlinux;
+	/* Kernel module name from .modinfo, and any error getting it. */
+	const char *name;
+	struct drgn_error *name_err;
+};
+
+/*
+ * Open and identify a file. This only touches the new Elf handle, so it may be
+ * called in parallel.
+ */
+static void open_kernel_elf_file(const char *path, struct kernel_elf_file *ret)
+{
+	memset(ret, 0, sizeof(*ret));
+	ret->err = open_elf_file(path, &ret->fd, &ret->elf);
+	if (ret->err) {
+		ret->fd = -1;
+		ret->elf = NULL;
+		return;
+	}
+	ret->err = identify_kernel_elf(ret->elf, &ret->this_module_scn,
+				       &ret->modinfo_scn, &ret->is_vmlinux);
+	if (ret->err) {
+		elf_end(ret->elf);
+		close(ret->fd);
+		ret->fd = -1;
+		ret->elf = NULL;
+		return;
+	}
+	if (ret->this_module_scn || ret->modinfo_scn) {
+		ret->name_err =
+			get_kernel_module_name_from_modinfo(ret->modinfo_scn,
+							    &ret->name);
+	}
+}
+
 struct drgn_error *
 linux_kernel_report_debug_info(struct drgn_program *prog,
 			       struct drgn_dwarf_index *dindex,
@@ -1512,6 +2755,7 @@ linux_kernel_report_debug_info(struct drgn_program *prog,
 			       bool report_default, bool report_main)
 {
 	struct drgn_error *err;
+	struct kernel_elf_file *files = NULL;
 	struct kernel_module_file *kmods;
 	size_t i, num_kmods = 0;
 	bool need_module_definition = false;
@@ -1525,34 +2769,39 @@ linux_kernel_report_debug_info(struct drgn_program *prog,
 		kmods = NULL;
 	}
 
+	/* Opening and identifying the files is done in parallel. */
+	if (n) {
+		files = malloc_array(n, sizeof(*files));
+		if (!files) {
+			err = &drgn_enomem;
+			goto out;
+		}
+	}
+	#pragma omp parallel for schedule(dynamic) \
+		num_threads(drgn_num_threads())
+	for (i = 0; i < n; i++)
+		open_kernel_elf_file(paths[i], &files[i]);
+
 	/*
 	 * We may need to index vmlinux before we can properly report kernel
 	 * modules. So, this sets aside kernel modules and reports everything
-	 * else.
+	 * else, in the order that the files were given.
 	 */
 	for (i = 0; i < n; i++) {
 		const char *path = paths[i];
-		int fd;
-		Elf *elf;
-		Elf_Scn *this_module_scn, *modinfo_scn;
-		bool is_vmlinux;
-
-		err = open_elf_file(path, &fd, &elf);
-		if (err) {
-			err = drgn_dwarf_index_report_error(dindex, path, NULL,
-							    err);
-			if (err)
-				goto out;
-			continue;
-		}
-
-		err = identify_kernel_elf(elf, &this_module_scn, &modinfo_scn,
-					  &is_vmlinux);
+		int fd = files[i].fd;
+		Elf *elf = files[i].elf;
+		Elf_Scn *this_module_scn = files[i].this_module_scn;
+		Elf_Scn *modinfo_scn = files[i].modinfo_scn;
+		bool is_vmlinux = files[i].is_vmlinux;
+
+		err = files[i].err;
+		files[i].err = NULL;
+		files[i].elf = NULL;
+		files[i].fd = -1;
 		if (err) {
 			err = drgn_dwarf_index_report_error(dindex, path, NULL,
 							    err);
-			elf_end(elf);
-			close(fd);
 			if (err)
 				goto out;
 			continue;
@@ -1563,8 +2812,9 @@ linux_kernel_report_debug_info(struct drgn_program *prog,
 			kmod->path = path;
 			kmod->fd = fd;
 			kmod->elf = elf;
-			err = get_kernel_module_name_from_modinfo(modinfo_scn,
-								  &kmod->name);
+			kmod->name = files[i].name;
+			err = files[i].name_err;
+			files[i].name_err = NULL;
 			if (err) {
 				err = drgn_dwarf_index_report_error(dindex,
 								    path, NULL,
@@ -1621,6 +2871,17 @@ linux_kernel_report_debug_info(struct drgn_program *prog,
 				    report_default, need_module_definition,
 				    vmlinux_is_pending);
 out:
+	if (files) {
+		for (i = 0; i < n; i++) {
+			if (files[i].elf)
+				elf_end(files[i].elf);
+			if (files[i].fd != -1)
+				close(files[i].fd);
+			drgn_error_destroy(files[i].err);
+			drgn_error_destroy(files[i].name_err);
+		}
+		free(files);
+	}
 	for (i = 0; i < num_kmods; i++) {
 		elf_end(kmods[i].elf);
 		if (kmods[i].fd != -1)
@@ -9,6 +9,7 @@
 #include "drgn.h"
 
 struct drgn_dwarf_index;
+struct drgn_memory_range;
 struct drgn_memory_reader;
 struct vmcoreinfo;
 
@@ -19,14 +20,27 @@ struct drgn_error *read_memory_via_pgtable(void *buf, uint64_t address,
 struct drgn_error *parse_vmcoreinfo(const char *desc, size_t descsz,
 				    struct vmcoreinfo *ret);
 
-struct drgn_error *proc_kallsyms_symbol_addr(const char *name,
-					     unsigned long *ret);
-
 struct drgn_error *read_vmcoreinfo_fallback(struct drgn_memory_reader *reader,
 					    struct vmcoreinfo *ret);
+
+/*
+ * Get the physical address ranges of System RAM of the running kernel from
+ * /proc/iomem, sorted by address and merged. If they are not available (e.g.,
+ * because the addresses are hidden from unprivileged users), no ranges are
+ * returned. The ranges must be freed with free().
+ */
+struct drgn_error *
+linux_kernel_live_ram_ranges(struct drgn_memory_range **ranges_ret,
+			     size_t *num_ranges_ret);
+
 struct drgn_error *linux_kernel_get_thread_size(struct drgn_program *prog,
 						uint64_t *ret);
 
+/*
+ * Object finder for constants derived from the kernel's VMCOREINFO and
+ * platform. Its results don't depend on which debugging information is loaded,
+ * so it is registered with drgn_program_add_memoized_object_finder().
+ */
 struct drgn_error *linux_kernel_object_find(const char *name, size_t name_len,
 					    const char *filename,
 					    enum drgn_find_object_flags flags,
@@ -38,6 +52,10 @@ linux_kernel_report_debug_info(struct drgn_program *prog,
 			       const char **paths, size_t n,
 			       bool report_default, bool report_main);
 
+struct drgn_error *
+linux_kernel_defer_loaded_modules(struct drgn_program *prog,
+				  struct drgn_dwarf_index *dindex);
+
 #define KDUMP_SIGNATURE "KDUMP   "
 #define KDUMP_SIG_LEN (sizeof(KDUMP_SIGNATURE) - 1)
 
@@ -1,22 +1,55 @@
 // Copyright (c) Facebook, Inc. and its affiliates.
 // SPDX-License-Identifier: GPL-3.0+
 
+#include <byteswap.h>
+#include <fnmatch.h>
 #include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "internal.h"
+#include "btf.h"
+#include "helpers.h"
+#include "object.h"
 #include "program.h"
+#include "serialize.h"
+#include "string_builder.h"
+#include "vector.h"
 
-struct drgn_error *linux_helper_read_vm(struct drgn_program *prog,
-					uint64_t pgtable, uint64_t virt_addr,
-					void *buf, size_t count)
+/*
+ * Start walking a page table at the given address. If *@p it is @c NULL, this
+ * acquires @ref drgn_program::pgtable_it first.
+ */
+static struct drgn_error *pgtable_iterator_start(struct drgn_program *prog,
+						 struct pgtable_iterator **it,
+						 uint64_t pgtable,
+						 uint64_t virt_addr)
 {
-	struct drgn_error *err;
-	struct pgtable_iterator *it;
-	pgtable_iterator_next_fn *next;
-	uint64_t read_addr = 0;
-	size_t read_size = 0;
+	if (!*it) {
+		if (prog->pgtable_it_in_use) {
+			return drgn_error_create_fault("recursive address translation; "
+						       "page table may be missing from core dump",
+						       virt_addr);
+		}
+		if (!prog->pgtable_it) {
+			prog->pgtable_it =
+				malloc(sizeof(*prog->pgtable_it) +
+				       prog->platform.arch->pgtable_iterator_arch_size);
+			if (!prog->pgtable_it)
+				return &drgn_enomem;
+			prog->pgtable_it->prog = prog;
+		}
+		*it = prog->pgtable_it;
+		prog->pgtable_it_in_use = true;
+	}
+	(*it)->pgtable = pgtable;
+	(*it)->virt_addr = virt_addr;
+	prog->platform.arch->pgtable_iterator_arch_init((*it)->arch);
+	return NULL;
+}
 
+static struct drgn_error *check_vm_translation(struct drgn_program *prog)
+{
 	if (!(prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL)) {
 		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
 					 "virtual address translation is only available for the Linux kernel");
@@ -30,49 +63,297 @@ struct drgn_error *linux_helper_read_vm(struct drgn_program *prog,
 					 "virtual address translation is not implemented for %s architecture",
 					 prog->platform.arch->name);
 	}
+	return NULL;
+}
+
+struct drgn_error *linux_helper_read_vm(struct drgn_program *prog,
+					uint64_t pgtable, uint64_t virt_addr,
+					void *buf, size_t count)
+{
+	struct drgn_error *err = NULL;
+	struct pgtable_iterator *it = NULL;
+	pgtable_iterator_next_fn *next;
+	uint64_t read_addr = 0;
+	size_t read_size = 0;
+	bool use_cache;
 
+	err = check_vm_translation(prog);
+	if (err)
+		return err;
 	if (!count)
 		return NULL;
 
-	if (prog->pgtable_it_in_use) {
-		return drgn_error_create_fault("recursive address translation; "
-					       "page table may be missing from core dump",
-					       virt_addr);
+	/*
+	 * The page table iterator and translation cache are shared, so
+	 * serialize with other readers.
+	 */
+	drgn_memory_reader_lock(&prog->reader);
+	prog->reader.stats.translations++;
+	/*
+	 * Translations are cached along with memory, so only use the cache
+	 * while memory is being cached.
+	 */
+	use_cache = prog->reader.cache.capacity != 0;
+	next = prog->platform.arch->linux_kernel_pgtable_iterator_next;
+	do {
+		uint64_t start_virt_addr, start_phys_addr, size, phys_addr;
+		size_t n;
+
+		if (use_cache &&
+		    drgn_program_find_translation(prog, pgtable, virt_addr,
+						  &start_virt_addr, &size,
+						  &start_phys_addr)) {
+			prog->reader.stats.translation_cache_hits++;
+		} else {
+			/*
+			 * Continue walking with the iterator if we left off at
+			 * this address; otherwise, (re)start it.
+			 */
+			if (!it || it->virt_addr != virt_addr) {
+				err = pgtable_iterator_start(prog, &it, pgtable,
+							     virt_addr);
+				if (err)
+					break;
+			}
+
+			prog->reader.stats.pgtable_walks++;
+			err = next(it, &start_virt_addr, &start_phys_addr);
+			if (err)
+				break;
+			if (start_phys_addr == UINT64_MAX) {
+				err = drgn_error_create_fault("address is not mapped",
+							      virt_addr);
+				break;
+			}
+			size = it->virt_addr - start_virt_addr;
+			if (use_cache && size && !(size & (size - 1)) &&
+			    !(start_virt_addr & (size - 1))) {
+				drgn_program_cache_translation(prog, pgtable,
+							       start_virt_addr,
+							       size,
+							       start_phys_addr);
+			}
+		}
+		n = min(start_virt_addr + size - virt_addr, (uint64_t)count);
+		phys_addr = start_phys_addr + (virt_addr - start_virt_addr);
+		if (read_size && phys_addr == read_addr + read_size) {
+			read_size += n;
+		} else {
+			if (read_size) {
+				err = drgn_program_read_memory(prog, buf,
+							       read_addr,
+							       read_size, true);
+				if (err)
+					break;
+				buf = (char *)buf + read_size;
+			}
+			read_addr = phys_addr;
+			read_size = n;
+		}
+		virt_addr += n;
+		count -= n;
+	} while (count);
+	if (!err) {
+		err = drgn_program_read_memory(prog, buf, read_addr, read_size,
+					       true);
 	}
+	if (it)
+		prog->pgtable_it_in_use = false;
+	drgn_memory_reader_unlock(&prog->reader);
+	return err;
+}
 
-	if (prog->pgtable_it) {
-		it = prog->pgtable_it;
-	} else {
-		it = malloc(sizeof(*it) +
-			    prog->platform.arch->pgtable_iterator_arch_size);
-		if (!it)
-			return &drgn_enomem;
-		prog->pgtable_it = it;
-		it->prog = prog;
+DEFINE_VECTOR_FUNCTIONS(linux_helper_vm_mapping_vector)
+
+void linux_helper_vm_translation_init(struct linux_helper_vm_translation *t,
+				      uint64_t pgtable)
+{
+	t->pgtable = pgtable;
+	linux_helper_vm_mapping_vector_init(&t->mappings);
+}
+
+void linux_helper_vm_translation_deinit(struct linux_helper_vm_translation *t)
+{
+	linux_helper_vm_mapping_vector_deinit(&t->mappings);
+}
+
+static int linux_helper_vm_mapping_cmp(const void *_a, const void *_b)
+{
+	const struct linux_helper_vm_mapping *a = _a, *b = _b;
+
+	if (a->virt_addr < b->virt_addr)
+		return -1;
+	else if (a->virt_addr > b->virt_addr)
+		return 1;
+	else
+		return 0;
+}
+
+/* Find the mapping containing an address, or NULL if it isn't known. */
+static const struct linux_helper_vm_mapping *
+linux_helper_vm_translation_find(const struct linux_helper_vm_translation *t,
+				 uint64_t virt_addr)
+{
+	size_t lo = 0, hi = t->mappings.size;
+
+	/* Find the first mapping starting after the address. */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (t->mappings.data[mid].virt_addr <= virt_addr)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
-	it->pgtable = pgtable;
-	it->virt_addr = virt_addr;
-	prog->pgtable_it_in_use = true;
-	prog->platform.arch->pgtable_iterator_arch_init(it->arch);
+	if (lo &&
+	    virt_addr - t->mappings.data[lo - 1].virt_addr <
+	    t->mappings.data[lo - 1].size)
+		return &t->mappings.data[lo - 1];
+	return NULL;
+}
+
+/* Like linux_helper_vm_translation_fill(), but the caller holds the lock. */
+static struct drgn_error *
+linux_helper_vm_translation_fill_locked(struct drgn_program *prog,
+					struct linux_helper_vm_translation *t,
+					uint64_t virt_addr, uint64_t size)
+{
+	struct drgn_error *err;
+	struct pgtable_iterator *it = NULL;
+	pgtable_iterator_next_fn *next;
+	size_t old_size = t->mappings.size, i, j;
+
 	next = prog->platform.arch->linux_kernel_pgtable_iterator_next;
+	err = pgtable_iterator_start(prog, &it, t->pgtable, virt_addr);
+	if (err)
+		return err;
 	do {
-		uint64_t virt_addr, start_virt_addr, end_virt_addr;
-		uint64_t start_phys_addr, end_phys_addr;
-		size_t n;
+		struct linux_helper_vm_mapping *last, *mapping;
+		uint64_t start_virt_addr, start_phys_addr, mapping_size;
 
-		virt_addr = it->virt_addr;
+		prog->reader.stats.pgtable_walks++;
 		err = next(it, &start_virt_addr, &start_phys_addr);
 		if (err)
 			break;
-		if (start_phys_addr == UINT64_MAX) {
+		mapping_size = it->virt_addr - start_virt_addr;
+		/* Merge with the previous mapping if they're contiguous. */
+		last = (t->mappings.size > old_size ?
+			&t->mappings.data[t->mappings.size - 1] : NULL);
+		if (last && last->virt_addr + last->size == start_virt_addr &&
+		    (last->phys_addr == UINT64_MAX ?
+		     start_phys_addr == UINT64_MAX :
+		     start_phys_addr == last->phys_addr + last->size)) {
+			last->size += mapping_size;
+			continue;
+		}
+		mapping = linux_helper_vm_mapping_vector_append_entry(&t->mappings);
+		if (!mapping) {
+			err = &drgn_enomem;
+			break;
+		}
+		mapping->virt_addr = start_virt_addr;
+		mapping->size = mapping_size;
+		mapping->phys_addr = start_phys_addr;
+		/* Stop at the end of the range or of the address space. */
+	} while (it->virt_addr > virt_addr && it->virt_addr - virt_addr < size);
+	prog->pgtable_it_in_use = false;
+	if (err) {
+		t->mappings.size = old_size;
+		return err;
+	}
+
+	/*
+	 * Merge the new mappings into the old ones. The walk may have covered
+	 * known ranges again, so trim the overlap off of each mapping.
+	 */
+	qsort(t->mappings.data, t->mappings.size, sizeof(t->mappings.data[0]),
+	      linux_helper_vm_mapping_cmp);
+	for (i = j = 0; i < t->mappings.size; i++) {
+		struct linux_helper_vm_mapping mapping = t->mappings.data[i];
+
+		if (j) {
+			const struct linux_helper_vm_mapping *prev =
+				&t->mappings.data[j - 1];
+
+			if (mapping.virt_addr - prev->virt_addr < prev->size) {
+				uint64_t overlap = (prev->virt_addr +
+						    prev->size -
+						    mapping.virt_addr);
+
+				if (overlap >= mapping.size)
+					continue;
+				mapping.virt_addr += overlap;
+				mapping.size -= overlap;
+				if (mapping.phys_addr != UINT64_MAX)
+					mapping.phys_addr += overlap;
+			}
+		}
+		t->mappings.data[j++] = mapping;
+	}
+	t->mappings.size = j;
+	return NULL;
+}
+
+struct drgn_error *
+linux_helper_vm_translation_fill(struct drgn_program *prog,
+				 struct linux_helper_vm_translation *t,
+				 uint64_t virt_addr, uint64_t size)
+{
+	struct drgn_error *err;
+
+	err = check_vm_translation(prog);
+	if (err || !size)
+		return err;
+	drgn_memory_reader_lock(&prog->reader);
+	err = linux_helper_vm_translation_fill_locked(prog, t, virt_addr, size);
+	drgn_memory_reader_unlock(&prog->reader);
+	return err;
+}
+
+struct drgn_error *
+linux_helper_vm_translation_read(struct drgn_program *prog,
+				 struct linux_helper_vm_translation *t,
+				 uint64_t virt_addr, void *buf, size_t count)
+{
+	struct drgn_error *err;
+	uint64_t read_addr = 0;
+	size_t read_size = 0;
+
+	err = check_vm_translation(prog);
+	if (err)
+		return err;
+	if (!count)
+		return NULL;
+
+	drgn_memory_reader_lock(&prog->reader);
+	prog->reader.stats.translations++;
+	do {
+		const struct linux_helper_vm_mapping *mapping;
+		uint64_t phys_addr;
+		size_t n;
+
+		mapping = linux_helper_vm_translation_find(t, virt_addr);
+		if (mapping) {
+			prog->reader.stats.translation_cache_hits++;
+		} else {
+			/* Translate the rest of the read in one walk. */
+			err = linux_helper_vm_translation_fill_locked(prog, t,
+								      virt_addr,
+								      count);
+			if (err)
+				break;
+			mapping = linux_helper_vm_translation_find(t,
+								   virt_addr);
+		}
+		if (!mapping || mapping->phys_addr == UINT64_MAX) {
 			err = drgn_error_create_fault("address is not mapped",
 						      virt_addr);
 			break;
 		}
-		end_virt_addr = it->virt_addr;
-		end_phys_addr = start_phys_addr + (end_virt_addr - start_virt_addr);
-		n = min(end_virt_addr - virt_addr, (uint64_t)count);
-		if (read_size && end_phys_addr == read_addr + read_size) {
+		n = min(mapping->virt_addr + mapping->size - virt_addr,
+			(uint64_t)count);
+		phys_addr = mapping->phys_addr + (virt_addr - mapping->virt_addr);
+		if (read_size && phys_addr == read_addr + read_size) {
 			read_size += n;
 		} else {
 			if (read_size) {
@@ -83,25 +364,27 @@ struct drgn_error *linux_helper_read_vm(struct drgn_program *prog,
 					break;
 				buf = (char *)buf + read_size;
 			}
-			read_addr = start_phys_addr + (virt_addr - start_virt_addr);
+			read_addr = phys_addr;
 			read_size = n;
 		}
+		virt_addr += n;
 		count -= n;
 	} while (count);
 	if (!err) {
 		err = drgn_program_read_memory(prog, buf, read_addr, read_size,
 					       true);
 	}
-	prog->pgtable_it_in_use = false;
+	drgn_memory_reader_unlock(&prog->reader);
 	return err;
 }
 
+static const uint64_t RADIX_TREE_ENTRY_MASK = 3;
+
 struct drgn_error *
 linux_helper_radix_tree_lookup(struct drgn_object *res,
 			       const struct drgn_object *root, uint64_t index)
 {
 	struct drgn_error *err;
-	static const uint64_t RADIX_TREE_ENTRY_MASK = 3;
 	uint64_t RADIX_TREE_INTERNAL_NODE;
 	uint64_t RADIX_TREE_MAP_MASK;
 	struct drgn_object node, tmp;
@@ -376,12 +659,48 @@ out:
 	return err;
 }
 
+/*
+ * Look up a PID in the cache built by linux_helper_cache_pids(). If the
+ * namespace is cached, res is set to the struct pid * or, if task is true, the
+ * struct task_struct *.
+ */
+static struct drgn_error *find_cached_pid(struct drgn_object *res,
+					  const struct drgn_object *ns,
+					  uint64_t pid, bool task,
+					  bool *found_ret)
+{
+	struct drgn_error *err;
+	struct drgn_qualified_type qualified_type;
+	uint64_t ns_address;
+	struct drgn_cached_pid cached;
+
+	err = drgn_object_read_unsigned(ns, &ns_address);
+	if (err)
+		return err;
+	*found_ret = drgn_program_find_cached_pid(res->prog, ns_address, pid,
+						  &cached);
+	if (!*found_ret)
+		return NULL;
+	err = drgn_program_find_type(res->prog,
+				     task ? "struct task_struct *" :
+				     "struct pid *", NULL, &qualified_type);
+	if (err)
+		return err;
+	return drgn_object_set_unsigned(res, qualified_type,
+					task ? cached.task : cached.pid, 0);
+}
+
 struct drgn_error *linux_helper_find_pid(struct drgn_object *res,
 					 const struct drgn_object *ns,
 					 uint64_t pid)
 {
 	struct drgn_error *err;
 	struct drgn_object tmp;
+	bool found;
+
+	err = find_cached_pid(res, ns, pid, false, &found);
+	if (err || found)
+		return err;
 
 	drgn_object_init(&tmp, res->prog);
 
@@ -481,6 +800,11 @@ struct drgn_error *linux_helper_find_task(struct drgn_object *res,
 	struct drgn_object pid_obj;
 	struct drgn_object pid_type_obj;
 	union drgn_value pid_type;
+	bool found;
+
+	err = find_cached_pid(res, ns, pid, true, &found);
+	if (err || found)
+		return err;
 
 	drgn_object_init(&pid_obj, res->prog);
 	drgn_object_init(&pid_type_obj, res->prog);
@@ -577,15 +901,35 @@ out:
 	return err;
 }
 
+/*
+ * Get the state character for a task's state and exit_state. The state
+ * characters must have been cached with cache_task_state_chars().
+ */
+static char task_state_char(struct drgn_program *prog, uint64_t task_state,
+			    uint64_t exit_state)
+{
+	static const uint64_t TASK_NOLOAD = 0x400;
+	uint64_t state;
+	char c;
+
+	state = (task_state | exit_state) & prog->task_report;
+	c = prog->task_state_chars[fls(state)];
+	/*
+	 * States beyond TASK_REPORT are special. As of Linux v5.3, TASK_IDLE is
+	 * the only one; it is defined as TASK_UNINTERRUPTIBLE | TASK_NOLOAD.
+	 */
+	if (c == 'D' && (task_state & ~state) == TASK_NOLOAD)
+		c = 'I';
+	return c;
+}
+
 struct drgn_error *
 linux_helper_task_state_to_char(const struct drgn_object *task, char *ret)
 {
-	static const uint64_t TASK_NOLOAD = 0x400;
 	struct drgn_error *err;
 	struct drgn_program *prog = task->prog;
 	struct drgn_object tmp;
 	union drgn_value task_state, exit_state;
-	uint64_t state;
 
 	drgn_object_init(&tmp, prog);
 
@@ -608,16 +952,8144 @@ linux_helper_task_state_to_char(const struct drgn_object *task, char *ret)
 	if (err)
 		goto out;
 
-	state = (task_state.uvalue | exit_state.uvalue) & prog->task_report;
-	*ret = prog->task_state_chars[fls(state)];
-	/*
-	 * States beyond TASK_REPORT are special. As of Linux v5.3, TASK_IDLE is
-	 * the only one; it is defined as TASK_UNINTERRUPTIBLE | TASK_NOLOAD.
-	 */
-	if (*ret == 'D' && (task_state.uvalue & ~state) == TASK_NOLOAD)
-		*ret = 'I';
+	*ret = task_state_char(prog, task_state.uvalue, exit_state.uvalue);
 	err = NULL;
 out:
 	drgn_object_deinit(&tmp);
 	return err;
 }
+
+/*
+ * Get the address and type of a list head or tree root given either a pointer
+ * to it or a reference to it.
+ */
+static struct drgn_error *head_address_and_type(const struct drgn_object *head,
+						const char *what,
+						struct drgn_type **type_ret,
+						uint64_t *address_ret)
+{
+	struct drgn_type *type;
+
+	type = drgn_underlying_type(head->type);
+	switch (drgn_type_kind(type)) {
+	case DRGN_TYPE_POINTER:
+		*type_ret = drgn_type_type(type).type;
+		return drgn_object_read_unsigned(head, address_ret);
+	case DRGN_TYPE_STRUCT:
+		if (head->is_reference) {
+			*type_ret = type;
+			*address_ret = head->reference.address;
+			return NULL;
+		}
+		/* fallthrough */
+	default:
+		return drgn_error_format(DRGN_ERROR_TYPE,
+					 "%s must be a pointer or a reference",
+					 what);
+	}
+}
+
+struct drgn_error *
+linux_helper_list_iterator_init(struct linux_helper_list_iterator *it,
+				const struct drgn_object *head, bool reverse,
+				struct drgn_qualified_type *node_type_ret)
+{
+	struct drgn_error *err;
+	struct drgn_type *type;
+	struct drgn_member_info member;
+
+	err = head_address_and_type(head, "list head", &type, &it->head);
+	if (err)
+		return err;
+	err = drgn_program_member_info(head->prog, type,
+				       reverse ? "prev" : "next", &member);
+	if (err)
+		return err;
+
+	it->prog = head->prog;
+	it->link_offset = member.bit_offset / 8;
+	it->hlist = false;
+	it->started = false;
+	err = drgn_program_read_word(it->prog, it->head + it->link_offset,
+				     false, &it->pos);
+	if (err)
+		return err;
+	if (node_type_ret)
+		*node_type_ret = member.qualified_type;
+	return NULL;
+}
+
+struct drgn_error *
+linux_helper_hlist_iterator_init(struct linux_helper_list_iterator *it,
+				 const struct drgn_object *head,
+				 struct drgn_qualified_type *node_type_ret)
+{
+	struct drgn_error *err;
+	struct drgn_type *type;
+	struct drgn_member_info first, next;
+	uint64_t head_address;
+
+	err = head_address_and_type(head, "hash list head", &type,
+				    &head_address);
+	if (err)
+		return err;
+	err = drgn_program_member_info(head->prog, type, "first", &first);
+	if (err)
+		return err;
+	type = drgn_underlying_type(first.qualified_type.type);
+	if (drgn_type_kind(type) != DRGN_TYPE_POINTER) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "hash list head first member is not a pointer");
+	}
+	err = drgn_program_member_info(head->prog, drgn_type_type(type).type,
+				       "next", &next);
+	if (err)
+		return err;
+
+	it->prog = head->prog;
+	it->head = 0;
+	it->link_offset = next.bit_offset / 8;
+	it->hlist = true;
+	it->started = false;
+	err = drgn_program_read_word(it->prog,
+				     head_address + first.bit_offset / 8,
+				     false, &it->pos);
+	if (err)
+		return err;
+	if (node_type_ret)
+		*node_type_ret = first.qualified_type;
+	return NULL;
+}
+
+/*
+ * Hint that the node pointed to by the pointer at @p address will be visited
+ * soon so that it can be read while the caller processes the current node. The
+ * pointer is usually in a page that was just read, so this is cheap. Errors are
+ * ignored.
+ */
+static void prefetch_pointee(struct drgn_program *prog, uint64_t address)
+{
+	struct drgn_error *err;
+	uint64_t value;
+
+	if (!drgn_memory_reader_prefetch_enabled(&prog->reader))
+		return;
+	drgn_quiet_faults_begin();
+	err = drgn_program_read_word(prog, address, false, &value);
+	drgn_quiet_faults_end();
+	if (err)
+		drgn_error_destroy(err);
+	else if (value)
+		drgn_program_prefetch_memory(prog, value, 1, false);
+}
+
+static inline bool
+linux_helper_list_iterator_done(struct linux_helper_list_iterator *it)
+{
+	return it->hlist ? !it->pos : it->pos == it->head;
+}
+
+struct drgn_error *
+linux_helper_list_iterator_next(struct linux_helper_list_iterator *it,
+				uint64_t *ret)
+{
+	struct drgn_error *err;
+
+	if (linux_helper_list_iterator_done(it))
+		return &drgn_stop;
+	if (it->started) {
+		err = drgn_program_read_word(it->prog,
+					     it->pos + it->link_offset, false,
+					     &it->pos);
+		if (err)
+			return err;
+		if (linux_helper_list_iterator_done(it))
+			return &drgn_stop;
+	}
+	it->started = true;
+	prefetch_pointee(it->prog, it->pos + it->link_offset);
+	*ret = it->pos;
+	return NULL;
+}
+
+/*
+ * Get the offset of the rb_node member in a tree root, the type of that
+ * member, and the offsets of the child pointers in each node.
+ */
+static struct drgn_error *
+rb_node_offsets(struct drgn_program *prog, struct drgn_type *root_type,
+		uint64_t *rb_node_offset_ret,
+		struct drgn_qualified_type *node_type_ret,
+		uint64_t *left_offset_ret, uint64_t *right_offset_ret)
+{
+	struct drgn_error *err;
+	struct drgn_member_info member;
+	struct drgn_type *type;
+
+	err = drgn_program_member_info(prog, root_type, "rb_node", &member);
+	if (err)
+		return err;
+	type = drgn_underlying_type(member.qualified_type.type);
+	if (drgn_type_kind(type) != DRGN_TYPE_POINTER) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "red-black tree root rb_node member is not a pointer");
+	}
+	*rb_node_offset_ret = member.bit_offset / 8;
+	*node_type_ret = member.qualified_type;
+	type = drgn_type_type(type).type;
+
+	err = drgn_program_member_info(prog, type, "rb_left", &member);
+	if (err)
+		return err;
+	*left_offset_ret = member.bit_offset / 8;
+	err = drgn_program_member_info(prog, type, "rb_right", &member);
+	if (err)
+		return err;
+	*right_offset_ret = member.bit_offset / 8;
+	return NULL;
+}
+
+/* Push node and its chain of left children onto the stack. */
+static struct drgn_error *
+rbtree_iterator_push_left(struct linux_helper_rbtree_iterator *it,
+			  uint64_t node)
+{
+	struct drgn_error *err;
+
+	while (node) {
+		if (it->depth >= LINUX_HELPER_RBTREE_MAX_DEPTH) {
+			return drgn_error_create(DRGN_ERROR_OTHER,
+						 "red-black tree is too deep");
+		}
+		it->stack[it->depth++] = node;
+		err = drgn_program_read_word(it->prog, node + it->left_offset,
+					     false, &node);
+		if (err)
+			return err;
+	}
+	return NULL;
+}
+
+struct drgn_error *
+linux_helper_rbtree_iterator_init(struct linux_helper_rbtree_iterator *it,
+				  const struct drgn_object *root,
+				  struct drgn_qualified_type *node_type_ret)
+{
+	struct drgn_error *err;
+	struct drgn_type *type;
+	struct drgn_qualified_type node_type;
+	uint64_t root_address, rb_node_offset, node;
+
+	err = head_address_and_type(root, "red-black tree root", &type,
+				    &root_address);
+	if (err)
+		return err;
+	it->prog = root->prog;
+	it->depth = 0;
+	err = rb_node_offsets(it->prog, type, &rb_node_offset, &node_type,
+			      &it->left_offset, &it->right_offset);
+	if (err)
+		return err;
+	err = drgn_program_read_word(it->prog, root_address + rb_node_offset,
+				     false, &node);
+	if (err)
+		return err;
+	err = rbtree_iterator_push_left(it, node);
+	if (err)
+		return err;
+	if (node_type_ret)
+		*node_type_ret = node_type;
+	return NULL;
+}
+
+struct drgn_error *
+linux_helper_rbtree_iterator_next(struct linux_helper_rbtree_iterator *it,
+				  uint64_t *ret)
+{
+	struct drgn_error *err;
+	uint64_t node, right;
+
+	if (!it->depth)
+		return &drgn_stop;
+	node = it->stack[it->depth - 1];
+	err = drgn_program_read_word(it->prog, node + it->right_offset, false,
+				     &right);
+	if (err)
+		return err;
+	it->depth--;
+	err = rbtree_iterator_push_left(it, right);
+	if (err)
+		return err;
+	/* The next call descends into the right subtree of the next node. */
+	if (it->depth) {
+		prefetch_pointee(it->prog,
+				 it->stack[it->depth - 1] + it->right_offset);
+	}
+	*ret = node;
+	return NULL;
+}
+
+/* Compare a key to an integer value read from memory. */
+static int rb_find_cmp(uint64_t key, bool key_negative, uint64_t value,
+		       bool value_negative)
+{
+	if (key_negative != value_negative)
+		return key_negative ? -1 : 1;
+	/*
+	 * If both have the same sign, two's complement order matches unsigned
+	 * order.
+	 */
+	if (key < value)
+		return -1;
+	else if (key > value)
+		return 1;
+	else
+		return 0;
+}
+
+struct drgn_error *linux_helper_rb_find(struct drgn_object *res,
+					const struct drgn_object *root,
+					struct drgn_qualified_type type,
+					const char *member_designator,
+					const char *key_designator,
+					uint64_t key, bool key_negative)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = root->prog;
+	bool little_endian = drgn_program_is_little_endian(prog);
+	struct drgn_type *root_type;
+	struct drgn_qualified_type node_type, entry_type;
+	struct drgn_member_info member, key_member;
+	struct drgn_object_type key_type;
+	enum drgn_object_kind key_kind;
+	uint64_t key_bit_size, key_offset, key_read_size;
+	uint64_t root_address, rb_node_offset, left_offset, right_offset;
+	uint64_t node, entry = 0;
+
+	err = head_address_and_type(root, "red-black tree root", &root_type,
+				    &root_address);
+	if (err)
+		return err;
+	err = rb_node_offsets(prog, root_type, &rb_node_offset, &node_type,
+			      &left_offset, &right_offset);
+	if (err)
+		return err;
+
+	err = drgn_program_member_path(prog, type.type, member_designator,
+				       &member);
+	if (err)
+		return err;
+	if (member.bit_offset % 8) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "rb_node member is not byte-aligned");
+	}
+	err = drgn_program_member_path(prog, type.type, key_designator,
+				       &key_member);
+	if (err)
+		return err;
+	err = drgn_object_set_common(key_member.qualified_type,
+				     key_member.bit_field_size, &key_type,
+				     &key_kind, &key_bit_size);
+	if (err)
+		return err;
+	if (key_kind != DRGN_OBJECT_SIGNED &&
+	    key_kind != DRGN_OBJECT_UNSIGNED) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "red-black tree key must be an integer");
+	}
+	key_offset = key_member.bit_offset / 8;
+	key_read_size = (key_member.bit_offset % 8 + key_bit_size + 7) / 8;
+
+	err = drgn_type_index_pointer_type(&prog->tindex, type, NULL,
+					   &entry_type.type);
+	if (err)
+		return err;
+	entry_type.qualifiers = 0;
+
+	err = drgn_program_read_word(prog, root_address + rb_node_offset,
+				     false, &node);
+	if (err)
+		return err;
+	while (node) {
+		char buf[9];
+		uint64_t value;
+		bool value_negative;
+		int cmp;
+
+		err = drgn_program_read_memory(prog, buf,
+					       node - member.bit_offset / 8 +
+					       key_offset, key_read_size,
+					       false);
+		if (err)
+			return err;
+		value = deserialize_bits(buf, key_member.bit_offset % 8,
+					 key_bit_size, little_endian);
+		if (key_kind == DRGN_OBJECT_SIGNED) {
+			value = sign_extend(value, key_bit_size);
+			value_negative = (int64_t)value < 0;
+		} else {
+			value_negative = false;
+		}
+
+		cmp = rb_find_cmp(key, key_negative, value, value_negative);
+		if (cmp < 0) {
+			err = drgn_program_read_word(prog, node + left_offset,
+						     false, &node);
+		} else if (cmp > 0) {
+			err = drgn_program_read_word(prog, node + right_offset,
+						     false, &node);
+		} else {
+			entry = node - member.bit_offset / 8;
+			break;
+		}
+		if (err)
+			return err;
+	}
+	return drgn_object_set_unsigned(res, entry_type, entry, 0);
+}
+
+/*
+ * Get the offset and size of an integer member of a radix tree node. If the
+ * member is missing and not required, the size is set to 0.
+ */
+static struct drgn_error *radix_tree_node_member(struct drgn_program *prog,
+						 struct drgn_type *node_type,
+						 const char *name,
+						 bool required,
+						 uint64_t *offset_ret,
+						 uint64_t *size_ret)
+{
+	struct drgn_error *err;
+	struct drgn_member_info member;
+
+	err = drgn_program_member_info(prog, node_type, name, &member);
+	if (err) {
+		if (!required && err->code == DRGN_ERROR_LOOKUP) {
+			drgn_error_destroy(err);
+			*offset_ret = 0;
+			*size_ret = 0;
+			return NULL;
+		}
+		return err;
+	}
+	if (member.bit_offset % 8 || member.bit_field_size) {
+		return drgn_error_format(DRGN_ERROR_TYPE,
+					 "radix tree node %s member is a bit field",
+					 name);
+	}
+	*offset_ret = member.bit_offset / 8;
+	return drgn_type_sizeof(member.qualified_type.type, size_ret);
+}
+
+/* Read and push the node at the given address. */
+static struct drgn_error *
+radix_tree_iterator_push(struct linux_helper_radix_tree_iterator *it,
+			 uint64_t address, uint64_t index)
+{
+	struct drgn_error *err;
+	bool little_endian = drgn_program_is_little_endian(it->prog);
+	uint64_t word_size = drgn_program_is_64_bit(it->prog) ? 8 : 4;
+	uint64_t i;
+	struct linux_helper_radix_tree_frame *frame;
+
+	if (it->depth >= LINUX_HELPER_RADIX_TREE_MAX_DEPTH) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "radix tree is too deep");
+	}
+	err = drgn_program_read_memory(it->prog, it->buf, address,
+				       it->node_size, false);
+	if (err)
+		return err;
+
+	frame = &it->stack[it->depth];
+	frame->address = address;
+	frame->index = index;
+	frame->shift = deserialize_bits(it->buf + it->shift_offset, 0,
+					it->shift_size * 8, little_endian);
+	frame->slot = 0;
+	if (it->count_size) {
+		frame->remaining = deserialize_bits(it->buf + it->count_offset,
+						    0, it->count_size * 8,
+						    little_endian);
+	} else {
+		frame->remaining = it->map_size;
+	}
+	for (i = 0; i < it->map_size; i++) {
+		frame->slots[i] = drgn_program_decode_word(it->prog,
+							   it->buf +
+							   it->slots_offset +
+							   i * word_size);
+	}
+	it->depth++;
+	return NULL;
+}
+
+struct drgn_error *
+linux_helper_radix_tree_iterator_init(struct linux_helper_radix_tree_iterator *it,
+				      const struct drgn_object *root)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = root->prog;
+	struct drgn_type *root_type;
+	struct drgn_qualified_type node_type;
+	struct drgn_member_info member;
+	uint64_t root_address, head, slots_size, word_size;
+
+	it->prog = prog;
+	it->buf = NULL;
+	it->depth = 0;
+	it->root_entry = 0;
+
+	err = head_address_and_type(root, "radix tree root", &root_type,
+				    &root_address);
+	if (err)
+		return err;
+	err = drgn_program_member_info(prog, root_type, "xa_head", &member);
+	if (!err) {
+		err = drgn_program_find_type(prog, "struct xa_node", NULL,
+					     &node_type);
+		if (err)
+			return err;
+		it->internal_node = 2;
+	} else if (err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		err = drgn_program_member_info(prog, root_type, "rnode",
+					       &member);
+		if (err)
+			return err;
+		err = drgn_program_find_type(prog, "struct radix_tree_node",
+					     NULL, &node_type);
+		if (err)
+			return err;
+		it->internal_node = 1;
+	} else {
+		return err;
+	}
+	err = drgn_program_read_word(prog, root_address + member.bit_offset / 8,
+				     false, &head);
+	if (err)
+		return err;
+	if ((head & RADIX_TREE_ENTRY_MASK) != it->internal_node) {
+		it->root_entry = head;
+		return NULL;
+	}
+
+	err = radix_tree_node_member(prog, node_type.type, "shift", true,
+				     &it->shift_offset, &it->shift_size);
+	if (err)
+		return err;
+	err = radix_tree_node_member(prog, node_type.type, "count", false,
+				     &it->count_offset, &it->count_size);
+	if (err)
+		return err;
+	if (it->shift_size > 8 || it->count_size > 8) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "radix tree node shift or count member is too large");
+	}
+
+	err = drgn_program_member_info(prog, node_type.type, "slots", &member);
+	if (err)
+		return err;
+	if (drgn_type_kind(member.qualified_type.type) != DRGN_TYPE_ARRAY) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "radix tree node slots member is not an array");
+	}
+	it->map_size = drgn_type_length(member.qualified_type.type);
+	if (it->map_size > LINUX_HELPER_RADIX_TREE_MAX_SLOTS) {
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "radix tree nodes with more than %d slots are not supported",
+					 LINUX_HELPER_RADIX_TREE_MAX_SLOTS);
+	}
+	err = drgn_type_sizeof(member.qualified_type.type, &slots_size);
+	if (err)
+		return err;
+	word_size = drgn_program_is_64_bit(prog) ? 8 : 4;
+	if (member.bit_offset % 8 || slots_size != it->map_size * word_size) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "radix tree node slots member is not an array of pointers");
+	}
+	it->slots_offset = member.bit_offset / 8;
+
+	it->node_size = it->slots_offset + slots_size;
+	if (it->shift_offset + it->shift_size > it->node_size)
+		it->node_size = it->shift_offset + it->shift_size;
+	if (it->count_offset + it->count_size > it->node_size)
+		it->node_size = it->count_offset + it->count_size;
+	it->buf = malloc(it->node_size);
+	if (!it->buf)
+		return &drgn_enomem;
+
+	err = radix_tree_iterator_push(it, head & ~it->internal_node, 0);
+	if (err) {
+		free(it->buf);
+		it->buf = NULL;
+	}
+	return err;
+}
+
+struct drgn_error *
+linux_helper_idr_iterator_init(struct linux_helper_radix_tree_iterator *it,
+			       const struct drgn_object *idr,
+			       uint64_t *base_ret)
+{
+	struct drgn_error *err;
+	struct drgn_object ptr, tmp;
+
+	it->buf = NULL;
+	drgn_object_init(&ptr, idr->prog);
+	drgn_object_init(&tmp, idr->prog);
+
+	/* Accept a reference to the IDR as well as a pointer to it. */
+	if (drgn_type_kind(drgn_underlying_type(idr->type)) !=
+	    DRGN_TYPE_POINTER) {
+		err = drgn_object_address_of(&ptr, idr);
+		if (err)
+			goto out;
+		idr = &ptr;
+	}
+
+	err = drgn_object_member_dereference(&tmp, idr, "idr_base");
+	if (!err) {
+		union drgn_value idr_base;
+
+		err = drgn_object_read_integer(&tmp, &idr_base);
+		if (err)
+			goto out;
+		*base_ret = idr_base.uvalue;
+	} else if (err->code == DRGN_ERROR_LOOKUP) {
+		/* idr_base was added in v4.16. */
+		drgn_error_destroy(err);
+		*base_ret = 0;
+	} else {
+		goto out;
+	}
+
+	err = drgn_object_member_dereference(&tmp, idr, "idr_rt");
+	if (err)
+		goto out;
+	err = linux_helper_radix_tree_iterator_init(it, &tmp);
+out:
+	drgn_object_deinit(&tmp);
+	drgn_object_deinit(&ptr);
+	return err;
+}
+
+void
+linux_helper_radix_tree_iterator_deinit(struct linux_helper_radix_tree_iterator *it)
+{
+	free(it->buf);
+}
+
+struct drgn_error *
+linux_helper_radix_tree_iterator_next(struct linux_helper_radix_tree_iterator *it,
+				      uint64_t *index_ret, uint64_t *entry_ret)
+{
+	struct drgn_error *err;
+	uint64_t word_size = drgn_program_is_64_bit(it->prog) ? 8 : 4;
+
+	if (it->root_entry) {
+		*index_ret = 0;
+		*entry_ret = it->root_entry;
+		it->root_entry = 0;
+		return NULL;
+	}
+
+	while (it->depth) {
+		struct linux_helper_radix_tree_frame *frame;
+		uint64_t slot, entry, index, slots_address;
+
+		frame = &it->stack[it->depth - 1];
+		if (frame->slot >= it->map_size || !frame->remaining) {
+			it->depth--;
+			continue;
+		}
+		slot = frame->slot++;
+		entry = frame->slots[slot];
+		if (!entry)
+			continue;
+		frame->remaining--;
+		if (frame->shift < 64)
+			index = frame->index + (slot << frame->shift);
+		else
+			index = frame->index;
+
+		if ((entry & RADIX_TREE_ENTRY_MASK) != it->internal_node) {
+			*index_ret = index;
+			*entry_ret = entry;
+			return NULL;
+		}
+		/*
+		 * XArray sibling and retry entries are small internal entries.
+		 * Radix tree sibling entries point into the node's own slots.
+		 */
+		slots_address = frame->address + it->slots_offset;
+		if (entry <= 4096 ||
+		    ((entry & ~it->internal_node) >= slots_address &&
+		     (entry & ~it->internal_node) <
+		     slots_address + it->map_size * word_size))
+			continue;
+		err = radix_tree_iterator_push(it, entry & ~it->internal_node,
+					       index);
+		if (err)
+			return err;
+	}
+	return &drgn_stop;
+}
+
+struct drgn_error *
+linux_helper_radix_tree_iterator_next_batch(struct linux_helper_radix_tree_iterator *it,
+					    uint64_t *indices,
+					    uint64_t *entries, size_t capacity,
+					    size_t *count_ret)
+{
+	struct drgn_error *err;
+	size_t count = 0;
+
+	while (count < capacity) {
+		err = linux_helper_radix_tree_iterator_next(it, &indices[count],
+							    &entries[count]);
+		if (err == &drgn_stop)
+			break;
+		if (err) {
+			/* Entries that were already returned are discarded. */
+			return err;
+		}
+		count++;
+	}
+	*count_ret = count;
+	return count ? NULL : &drgn_stop;
+}
+
+/* Get the offset in bytes of a member designator. */
+static struct drgn_error *member_offset(struct drgn_program *prog,
+					struct drgn_type *type,
+					const char *member_designator,
+					uint64_t *ret)
+{
+	struct drgn_error *err;
+	struct drgn_member_info member;
+
+	err = drgn_program_member_path(prog, type, member_designator, &member);
+	if (err)
+		return err;
+	if (member.bit_offset % 8) {
+		return drgn_error_format(DRGN_ERROR_TYPE,
+					 "%s member is not byte-aligned",
+					 member_designator);
+	}
+	*ret = member.bit_offset / 8;
+	return NULL;
+}
+
+static struct drgn_error *
+pid_iterator_init_pid_hash(struct linux_helper_pid_iterator *it,
+			   struct drgn_type *pid_type, uint64_t level)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = it->prog;
+	struct drgn_qualified_type upid_type, hlist_node_type;
+	struct drgn_object tmp;
+	struct drgn_type *type;
+	union drgn_value pidhash_shift;
+	char member[64];
+
+	err = drgn_program_find_type(prog, "struct upid", NULL, &upid_type);
+	if (err)
+		return err;
+	err = member_offset(prog, upid_type.type, "pid_chain",
+			    &it->pid_chain_offset);
+	if (err)
+		return err;
+	err = member_offset(prog, upid_type.type, "ns", &it->upid_ns_offset);
+	if (err)
+		return err;
+	err = drgn_program_find_type(prog, "struct hlist_node", NULL,
+				     &hlist_node_type);
+	if (err)
+		return err;
+	err = member_offset(prog, hlist_node_type.type, "next",
+			    &it->hlist_next_offset);
+	if (err)
+		return err;
+	sprintf(member, "numbers[%" PRIu64 "]", level);
+	err = member_offset(prog, pid_type, member, &it->numbers_offset);
+	if (err)
+		return err;
+
+	drgn_object_init(&tmp, prog);
+	err = drgn_program_find_object(prog, "pidhash_shift", NULL,
+				       DRGN_FIND_OBJECT_ANY, &tmp);
+	if (err)
+		goto out;
+	err = drgn_object_read_integer(&tmp, &pidhash_shift);
+	if (err)
+		goto out;
+	if (pidhash_shift.uvalue >= 64)
+		it->pidhash_size = 0;
+	else
+		it->pidhash_size = UINT64_C(1) << pidhash_shift.uvalue;
+
+	err = drgn_program_find_object(prog, "pid_hash", NULL,
+				       DRGN_FIND_OBJECT_ANY, &tmp);
+	if (err)
+		goto out;
+	type = drgn_underlying_type(tmp.type);
+	if (drgn_type_kind(type) == DRGN_TYPE_POINTER) {
+		err = drgn_object_read_unsigned(&tmp, &it->pid_hash);
+		if (err)
+			goto out;
+	} else if (drgn_type_kind(type) == DRGN_TYPE_ARRAY &&
+		   tmp.is_reference) {
+		it->pid_hash = tmp.reference.address;
+	} else {
+		err = drgn_error_create(DRGN_ERROR_TYPE,
+					"pid_hash is not a pointer or array");
+		goto out;
+	}
+	err = drgn_type_sizeof(drgn_type_type(type).type,
+			       &it->hlist_head_size);
+	if (err)
+		goto out;
+	it->bucket = 0;
+	it->node = 0;
+out:
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+struct drgn_error *
+linux_helper_pid_iterator_init(struct linux_helper_pid_iterator *it,
+			       const struct drgn_object *ns, bool tasks)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = ns->prog;
+	struct drgn_qualified_type pid_type;
+	struct drgn_object tmp;
+	union drgn_value level;
+
+	it->prog = prog;
+	it->tasks = tasks;
+	it->use_idr = false;
+	it->idr_it.buf = NULL;
+
+	err = drgn_program_find_type(prog, "struct pid", NULL, &pid_type);
+	if (err)
+		return err;
+
+	drgn_object_init(&tmp, prog);
+	if (tasks) {
+		union drgn_value PIDTYPE_PID;
+		char member[64];
+		struct drgn_qualified_type task_struct_type;
+
+		err = drgn_program_find_object(prog, "PIDTYPE_PID", NULL,
+					       DRGN_FIND_OBJECT_CONSTANT,
+					       &tmp);
+		if (err)
+			goto out;
+		err = drgn_object_read_integer(&tmp, &PIDTYPE_PID);
+		if (err)
+			goto out;
+		sprintf(member, "tasks[%" PRIu64 "].first", PIDTYPE_PID.uvalue);
+		err = member_offset(prog, pid_type.type, member,
+				    &it->pid_tasks_offset);
+		if (err)
+			goto out;
+		err = drgn_program_find_type(prog, "struct task_struct", NULL,
+					     &task_struct_type);
+		if (err)
+			goto out;
+		sprintf(member, "pid_links[%" PRIu64 "]", PIDTYPE_PID.uvalue);
+		err = member_offset(prog, task_struct_type.type, member,
+				    &it->task_link_offset);
+		if (err && err->code == DRGN_ERROR_LOOKUP) {
+			drgn_error_destroy(err);
+			sprintf(member, "pids[%" PRIu64 "].node",
+				PIDTYPE_PID.uvalue);
+			err = member_offset(prog, task_struct_type.type,
+					    member, &it->task_link_offset);
+		}
+		if (err)
+			goto out;
+	}
+
+	err = drgn_object_member_dereference(&tmp, ns, "idr");
+	if (!err) {
+		uint64_t base;
+
+		err = drgn_object_address_of(&tmp, &tmp);
+		if (err)
+			goto out;
+		err = linux_helper_idr_iterator_init(&it->idr_it, &tmp, &base);
+		if (err)
+			goto out;
+		it->use_idr = true;
+	} else if (err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		err = drgn_object_read_unsigned(ns, &it->ns_address);
+		if (err)
+			goto out;
+		err = drgn_object_member_dereference(&tmp, ns, "level");
+		if (err)
+			goto out;
+		err = drgn_object_read_integer(&tmp, &level);
+		if (err)
+			goto out;
+		err = pid_iterator_init_pid_hash(it, pid_type.type,
+						 level.uvalue);
+	}
+out:
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+void linux_helper_pid_iterator_deinit(struct linux_helper_pid_iterator *it)
+{
+	linux_helper_radix_tree_iterator_deinit(&it->idr_it);
+}
+
+static struct drgn_error *
+pid_iterator_next_pid(struct linux_helper_pid_iterator *it, uint64_t *ret)
+{
+	struct drgn_error *err;
+
+	if (it->use_idr) {
+		uint64_t index;
+
+		return linux_helper_radix_tree_iterator_next(&it->idr_it,
+							     &index, ret);
+	}
+
+	for (;;) {
+		uint64_t upid, upid_ns;
+
+		if (!it->node) {
+			if (it->bucket >= it->pidhash_size)
+				return &drgn_stop;
+			/* node = pid_hash[bucket++].first */
+			err = drgn_program_read_word(it->prog,
+						     it->pid_hash +
+						     it->bucket++ *
+						     it->hlist_head_size,
+						     false, &it->node);
+			if (err)
+				return err;
+			continue;
+		}
+
+		upid = it->node - it->pid_chain_offset;
+		err = drgn_program_read_word(it->prog,
+					     it->node + it->hlist_next_offset,
+					     false, &it->node);
+		if (err)
+			return err;
+		err = drgn_program_read_word(it->prog,
+					     upid + it->upid_ns_offset, false,
+					     &upid_ns);
+		if (err)
+			return err;
+		if (upid_ns == it->ns_address) {
+			*ret = upid - it->numbers_offset;
+			return NULL;
+		}
+	}
+}
+
+struct drgn_error *
+linux_helper_pid_iterator_next(struct linux_helper_pid_iterator *it,
+			       uint64_t *ret)
+{
+	struct drgn_error *err;
+	uint64_t pid, first;
+
+	for (;;) {
+		err = pid_iterator_next_pid(it, &pid);
+		if (err || !it->tasks)
+			break;
+		/* pid_task(pid, PIDTYPE_PID) */
+		err = drgn_program_read_word(it->prog,
+					     pid + it->pid_tasks_offset, false,
+					     &first);
+		if (err)
+			return err;
+		if (first) {
+			*ret = first - it->task_link_offset;
+			return NULL;
+		}
+	}
+	if (!err)
+		*ret = pid;
+	return err;
+}
+
+/* x86-64 constants for the sparse memory model. */
+static const uint64_t PAGE_SHIFT = 12;
+static const uint64_t SECTION_SIZE_BITS = 27;
+static const uint64_t SECTION_HAS_MEM_MAP = 1 << 1;
+
+/*
+ * Find mem_section for CONFIG_SPARSEMEM. If it doesn't exist, it->mem_section
+ * is left as 0.
+ */
+static struct drgn_error *
+page_iterator_init_sections(struct linux_helper_page_iterator *it)
+{
+	struct drgn_error *err;
+	struct drgn_object tmp;
+	struct drgn_type *type, *root_type;
+	struct drgn_qualified_type mem_section_type;
+	struct drgn_member_info member;
+
+	it->mem_section = 0;
+	drgn_object_init(&tmp, it->prog);
+	err = drgn_program_find_object(it->prog, "mem_section", NULL,
+				       DRGN_FIND_OBJECT_VARIABLE, &tmp);
+	if (err) {
+		if (err->code == DRGN_ERROR_LOOKUP) {
+			drgn_error_destroy(err);
+			err = NULL;
+		}
+		goto out;
+	}
+
+	/*
+	 * mem_section is struct mem_section **mem_section or struct
+	 * mem_section *mem_section[NR_SECTION_ROOTS] with
+	 * CONFIG_SPARSEMEM_EXTREME and struct mem_section
+	 * mem_section[NR_SECTION_ROOTS][SECTIONS_PER_ROOT] without it.
+	 */
+	type = drgn_underlying_type(tmp.type);
+	if (drgn_type_kind(type) == DRGN_TYPE_POINTER) {
+		err = drgn_object_read_unsigned(&tmp, &it->mem_section);
+		if (err)
+			goto out;
+		it->nr_section_roots = UINT64_MAX;
+	} else if (drgn_type_kind(type) == DRGN_TYPE_ARRAY &&
+		   tmp.is_reference) {
+		it->mem_section = tmp.reference.address;
+		it->nr_section_roots = drgn_type_length(type);
+	} else {
+		goto out;
+	}
+	root_type = drgn_underlying_type(drgn_type_type(type).type);
+	if (drgn_type_kind(root_type) == DRGN_TYPE_POINTER) {
+		uint64_t page_size = UINT64_C(1) << PAGE_SHIFT;
+
+		it->sections_extreme = true;
+		mem_section_type = drgn_type_type(root_type);
+		err = drgn_type_sizeof(mem_section_type.type,
+				       &it->section_size);
+		if (err)
+			goto out;
+		it->sections_per_root = page_size / it->section_size;
+	} else if (drgn_type_kind(root_type) == DRGN_TYPE_ARRAY) {
+		it->sections_extreme = false;
+		mem_section_type = drgn_type_type(root_type);
+		err = drgn_type_sizeof(mem_section_type.type,
+				       &it->section_size);
+		if (err)
+			goto out;
+		it->sections_per_root = drgn_type_length(root_type);
+	} else {
+		it->mem_section = 0;
+		goto out;
+	}
+	if (!it->sections_per_root) {
+		it->mem_section = 0;
+		goto out;
+	}
+	err = drgn_program_member_info(it->prog, mem_section_type.type,
+				       "section_mem_map", &member);
+	if (err)
+		goto out;
+	it->section_mem_map_offset = member.bit_offset / 8;
+out:
+	if (err)
+		it->mem_section = 0;
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+struct drgn_error *
+linux_helper_page_iterator_init(struct linux_helper_page_iterator *it,
+				struct drgn_program *prog, uint64_t flags_mask,
+				uint64_t flags_value)
+{
+	struct drgn_error *err;
+	struct drgn_object tmp;
+	struct drgn_type *type;
+	struct drgn_member_info member;
+
+	it->prog = prog;
+	it->flags_mask = flags_mask;
+	it->flags_value = flags_value;
+	it->pfn = 0;
+	it->buf_pfn = 0;
+	it->buf_count = 0;
+	it->buf = NULL;
+
+	drgn_object_init(&tmp, prog);
+	err = drgn_program_find_object(prog, "vmemmap", NULL,
+				       DRGN_FIND_OBJECT_ANY, &tmp);
+	if (err)
+		goto out;
+	type = drgn_underlying_type(tmp.type);
+	if (drgn_type_kind(type) != DRGN_TYPE_POINTER) {
+		err = drgn_error_create(DRGN_ERROR_TYPE,
+					"vmemmap is not a pointer");
+		goto out;
+	}
+	err = drgn_object_read_unsigned(&tmp, &it->vmemmap);
+	if (err)
+		goto out;
+	type = drgn_type_type(type).type;
+	err = drgn_type_sizeof(type, &it->page_size);
+	if (err)
+		goto out;
+	err = drgn_program_member_info(prog, type, "flags", &member);
+	if (err)
+		goto out;
+	it->flags_offset = member.bit_offset / 8;
+	err = drgn_type_sizeof(member.qualified_type.type, &it->flags_size);
+	if (err)
+		goto out;
+	if (member.bit_offset % 8 || it->flags_size > 8 ||
+	    it->flags_offset + it->flags_size > it->page_size) {
+		err = drgn_error_create(DRGN_ERROR_TYPE,
+					"invalid struct page flags member");
+		goto out;
+	}
+
+	err = drgn_program_find_object(prog, "max_pfn", NULL,
+				       DRGN_FIND_OBJECT_ANY, &tmp);
+	if (err)
+		goto out;
+	err = drgn_object_read_unsigned(&tmp, &it->max_pfn);
+	if (err)
+		goto out;
+
+	err = page_iterator_init_sections(it);
+	if (err)
+		goto out;
+
+	it->buf = malloc_array(LINUX_HELPER_PAGE_CHUNK, it->page_size);
+	if (!it->buf)
+		err = &drgn_enomem;
+out:
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+void linux_helper_page_iterator_deinit(struct linux_helper_page_iterator *it)
+{
+	free(it->buf);
+}
+
+/*
+ * Get the address of the struct mem_section containing a PFN, or 0 if it
+ * doesn't exist. it->mem_section must be non-zero.
+ */
+static struct drgn_error *
+page_iterator_section(struct linux_helper_page_iterator *it, uint64_t pfn,
+		      uint64_t *ret)
+{
+	struct drgn_error *err;
+	uint64_t word_size = drgn_program_is_64_bit(it->prog) ? 8 : 4;
+	uint64_t nr, root, section;
+
+	nr = pfn >> (SECTION_SIZE_BITS - PAGE_SHIFT);
+	root = nr / it->sections_per_root;
+	if (root >= it->nr_section_roots) {
+		*ret = 0;
+		return NULL;
+	}
+	if (it->sections_extreme) {
+		err = drgn_program_read_word(it->prog,
+					     it->mem_section + root * word_size,
+					     false, &section);
+		if (err)
+			return err;
+		if (section) {
+			section += (nr % it->sections_per_root) *
+				   it->section_size;
+		}
+	} else {
+		section = it->mem_section + nr * it->section_size;
+	}
+	*ret = section;
+	return NULL;
+}
+
+/* Return whether the section containing a PFN has a memory map. */
+static struct drgn_error *
+page_iterator_valid_section(struct linux_helper_page_iterator *it,
+			    uint64_t pfn, bool *ret)
+{
+	struct drgn_error *err;
+	uint64_t section, section_mem_map;
+
+	if (!it->mem_section) {
+		*ret = true;
+		return NULL;
+	}
+
+	err = page_iterator_section(it, pfn, &section);
+	if (err)
+		return err;
+	if (!section) {
+		*ret = false;
+		return NULL;
+	}
+	err = drgn_program_read_word(it->prog,
+				     section + it->section_mem_map_offset,
+				     false, &section_mem_map);
+	if (err)
+		return err;
+	*ret = section_mem_map & SECTION_HAS_MEM_MAP;
+	return NULL;
+}
+
+/* Read the chunk containing it->pfn into it->buf. */
+static struct drgn_error *
+page_iterator_read_chunk(struct linux_helper_page_iterator *it)
+{
+	struct drgn_error *err;
+	uint64_t pages_per_section;
+
+	pages_per_section = UINT64_C(1) << (SECTION_SIZE_BITS - PAGE_SHIFT);
+	while (it->pfn < it->max_pfn) {
+		bool valid;
+
+		err = page_iterator_valid_section(it, it->pfn, &valid);
+		if (err)
+			return err;
+		if (!valid) {
+			it->pfn = (it->pfn | (pages_per_section - 1)) + 1;
+			continue;
+		}
+
+		it->buf_pfn = it->pfn & ~(uint64_t)(LINUX_HELPER_PAGE_CHUNK - 1);
+		it->buf_count = min(it->max_pfn - it->buf_pfn,
+				    (uint64_t)LINUX_HELPER_PAGE_CHUNK);
+		err = drgn_program_try_read_memory(it->prog, it->buf,
+						   it->vmemmap +
+						   it->buf_pfn * it->page_size,
+						   it->buf_count * it->page_size,
+						   false, &valid);
+		if (err || valid)
+			return err;
+		/*
+		 * This part of the memory map isn't populated. If more of it is
+		 * known to be absent, skip all of that at once.
+		 */
+		it->buf_count = 0;
+		it->pfn = it->buf_pfn + LINUX_HELPER_PAGE_CHUNK;
+		if (it->pfn < it->max_pfn) {
+			uint64_t address = it->vmemmap + it->pfn * it->page_size;
+			uint64_t run_last, next_pfn;
+
+			err = drgn_memory_reader_present(&it->prog->reader,
+							 address,
+							 it->vmemmap +
+							 it->max_pfn * it->page_size - 1,
+							 false, &valid,
+							 &run_last);
+			if (err)
+				return err;
+			if (!valid) {
+				next_pfn = ((run_last + 1 - it->vmemmap) /
+					    it->page_size) &
+					   ~(uint64_t)(LINUX_HELPER_PAGE_CHUNK - 1);
+				if (next_pfn > it->pfn)
+					it->pfn = next_pfn;
+			}
+		}
+	}
+	return &drgn_stop;
+}
+
+struct drgn_error *
+linux_helper_page_iterator_next(struct linux_helper_page_iterator *it,
+				uint64_t *pfn_ret)
+{
+	struct drgn_error *err;
+	bool little_endian = drgn_program_is_little_endian(it->prog);
+
+	for (;;) {
+		uint64_t flags;
+
+		if (it->pfn < it->buf_pfn ||
+		    it->pfn >= it->buf_pfn + it->buf_count) {
+			err = page_iterator_read_chunk(it);
+			if (err)
+				return err;
+		}
+		flags = deserialize_bits(it->buf +
+					 (it->pfn - it->buf_pfn) * it->page_size +
+					 it->flags_offset, 0,
+					 it->flags_size * 8, little_endian);
+		if ((flags & it->flags_mask) == it->flags_value) {
+			*pfn_ret = it->pfn++;
+			return NULL;
+		}
+		it->pfn++;
+	}
+}
+
+/* Read an array of words into a newly allocated array. */
+static struct drgn_error *read_word_array(struct drgn_program *prog,
+					  uint64_t address, size_t n,
+					  uint64_t **ret)
+{
+	struct drgn_error *err;
+	uint64_t *words;
+
+	words = malloc_array(n, sizeof(*words));
+	if (!words)
+		return &drgn_enomem;
+	err = drgn_program_read_word_array(prog, address, n, false, words);
+	if (err) {
+		free(words);
+		return err;
+	}
+	*ret = words;
+	return NULL;
+}
+
+struct drgn_error *linux_helper_per_cpu_offsets(struct drgn_program *prog,
+						const uint64_t **offsets_ret,
+						size_t *num_ret)
+{
+	struct drgn_error *err;
+	struct drgn_object tmp;
+	struct drgn_type *type;
+	uint64_t *offsets;
+	size_t num_offsets;
+
+	if (prog->per_cpu_offsets)
+		goto out_cached;
+
+	drgn_object_init(&tmp, prog);
+	err = drgn_program_find_object(prog, "__per_cpu_offset", NULL,
+				       DRGN_FIND_OBJECT_VARIABLE, &tmp);
+	if (err)
+		goto out;
+	type = drgn_underlying_type(tmp.type);
+	if (drgn_type_kind(type) != DRGN_TYPE_ARRAY || !tmp.is_reference ||
+	    !drgn_type_is_complete(type)) {
+		err = drgn_error_create(DRGN_ERROR_TYPE,
+					"__per_cpu_offset is not an array");
+		goto out;
+	}
+	num_offsets = drgn_type_length(type);
+	err = read_word_array(prog, tmp.reference.address, num_offsets,
+			      &offsets);
+	if (err)
+		goto out;
+	prog->per_cpu_offsets = offsets;
+	prog->num_per_cpu_offsets = num_offsets;
+out:
+	drgn_object_deinit(&tmp);
+	if (err)
+		return err;
+out_cached:
+	*offsets_ret = prog->per_cpu_offsets;
+	*num_ret = prog->num_per_cpu_offsets;
+	return NULL;
+}
+
+struct drgn_error *linux_helper_cpumask_cpus(struct drgn_program *prog,
+					     const struct drgn_object *mask,
+					     uint64_t **cpus_ret,
+					     size_t *num_ret)
+{
+	struct drgn_error *err;
+	struct drgn_object tmp;
+	struct drgn_type *type;
+	struct drgn_member_info bits;
+	uint64_t address, word_bits, *words = NULL, *cpus = NULL;
+	size_t num_words, num_cpus = 0, i;
+
+	drgn_object_init(&tmp, prog);
+	if (!mask) {
+		err = drgn_program_find_object(prog, "__cpu_online_mask", NULL,
+					       DRGN_FIND_OBJECT_VARIABLE,
+					       &tmp);
+		if (err)
+			goto out;
+		mask = &tmp;
+	}
+	err = head_address_and_type(mask, "CPU mask", &type, &address);
+	if (err)
+		goto out;
+	err = drgn_program_member_info(prog, type, "bits", &bits);
+	if (err)
+		goto out;
+	type = drgn_underlying_type(bits.qualified_type.type);
+	if (drgn_type_kind(type) != DRGN_TYPE_ARRAY) {
+		err = drgn_error_create(DRGN_ERROR_TYPE,
+					"cpumask bits member is not an array");
+		goto out;
+	}
+	num_words = drgn_type_length(type);
+	word_bits = drgn_program_is_64_bit(prog) ? 64 : 32;
+	err = read_word_array(prog, address + bits.bit_offset / 8, num_words,
+			      &words);
+	if (err)
+		goto out;
+
+	for (i = 0; i < num_words; i++)
+		num_cpus += __builtin_popcountll(words[i]);
+	cpus = malloc_array(num_cpus, sizeof(*cpus));
+	if (!cpus && num_cpus) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	num_cpus = 0;
+	for (i = 0; i < num_words; i++) {
+		uint64_t word = words[i];
+
+		while (word) {
+			cpus[num_cpus++] = i * word_bits + __builtin_ctzll(word);
+			word &= word - 1;
+		}
+	}
+	*cpus_ret = cpus;
+	*num_ret = num_cpus;
+	err = NULL;
+out:
+	free(words);
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+static struct drgn_error *per_cpu_offset(struct drgn_program *prog,
+					 uint64_t cpu, uint64_t *ret)
+{
+	struct drgn_error *err;
+	const uint64_t *offsets;
+	size_t num_offsets;
+
+	err = linux_helper_per_cpu_offsets(prog, &offsets, &num_offsets);
+	if (err)
+		return err;
+	if (cpu >= num_offsets) {
+		return drgn_error_format(DRGN_ERROR_OUT_OF_BOUNDS,
+					 "CPU %" PRIu64 " is out of range",
+					 cpu);
+	}
+	*ret = offsets[cpu];
+	return NULL;
+}
+
+/* Number of per-CPU values read in one batch by per_cpu_sums(). */
+#define PER_CPU_SUMS_BATCH_SIZE 4096
+
+static void per_cpu_sums_add(const char *buf, size_t n, const size_t *owners,
+			     uint64_t size, bool is_signed, bool little_endian,
+			     uint64_t *sums)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		uint64_t value = deserialize_bits(buf + i * size, 0, size * 8,
+						  little_endian);
+
+		if (is_signed)
+			value = sign_extend(value, size * 8);
+		sums[owners[i]] += value;
+	}
+}
+
+/*
+ * Sum per-CPU integers of the given size at each of the given per-CPU
+ * addresses over the given CPUs. The values for every address and CPU are read
+ * in large batches with drgn_program_read_memory_batch() rather than one read
+ * each. The sums are truncated to 64 bits.
+ */
+static struct drgn_error *per_cpu_sums(struct drgn_program *prog,
+				       const uint64_t *cpus, size_t num_cpus,
+				       const uint64_t *addresses, size_t num,
+				       uint64_t size, bool is_signed,
+				       uint64_t *sums)
+{
+	struct drgn_error *err;
+	bool little_endian = drgn_program_is_little_endian(prog);
+	struct drgn_memory_read_request *requests;
+	const uint64_t *offsets;
+	size_t num_offsets, *owners;
+	size_t i, j, n = 0;
+	char *buf;
+
+	if (!size || size > 8) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "unsupported per-CPU integer size");
+	}
+	err = linux_helper_per_cpu_offsets(prog, &offsets, &num_offsets);
+	if (err)
+		return err;
+	for (j = 0; j < num_cpus; j++) {
+		if (cpus[j] >= num_offsets) {
+			return drgn_error_format(DRGN_ERROR_OUT_OF_BOUNDS,
+						 "CPU %" PRIu64 " is out of range",
+						 cpus[j]);
+		}
+	}
+	memset(sums, 0, num * sizeof(*sums));
+	requests = malloc_array(PER_CPU_SUMS_BATCH_SIZE, sizeof(*requests));
+	owners = malloc_array(PER_CPU_SUMS_BATCH_SIZE, sizeof(*owners));
+	buf = malloc_array(PER_CPU_SUMS_BATCH_SIZE, size);
+	if (!requests || !owners || !buf) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	for (i = 0; i < num; i++) {
+		for (j = 0; j < num_cpus; j++) {
+			if (n == PER_CPU_SUMS_BATCH_SIZE) {
+				err = drgn_program_read_memory_batch(prog,
+								     requests,
+								     n);
+				if (err)
+					goto out;
+				per_cpu_sums_add(buf, n, owners, size,
+						 is_signed, little_endian,
+						 sums);
+				n = 0;
+			}
+			requests[n] = (struct drgn_memory_read_request){
+				.buf = buf + n * size,
+				.address = addresses[i] + offsets[cpus[j]],
+				.count = size,
+			};
+			owners[n++] = i;
+		}
+	}
+	if (n) {
+		err = drgn_program_read_memory_batch(prog, requests, n);
+		if (err)
+			goto out;
+		per_cpu_sums_add(buf, n, owners, size, is_signed,
+				 little_endian, sums);
+	}
+	err = NULL;
+out:
+	free(buf);
+	free(owners);
+	free(requests);
+	return err;
+}
+
+struct drgn_error *linux_helper_per_cpu_ptr(const struct drgn_object *ptr,
+					    uint64_t cpu, uint64_t *ret)
+{
+	struct drgn_error *err;
+	uint64_t address, offset;
+
+	err = drgn_object_read_unsigned(ptr, &address);
+	if (err)
+		return err;
+	err = per_cpu_offset(ptr->prog, cpu, &offset);
+	if (err)
+		return err;
+	*ret = address + offset;
+	return NULL;
+}
+
+struct drgn_error *linux_helper_per_cpu_sum(const struct drgn_object *ptr,
+					    const struct drgn_object *mask,
+					    uint64_t *ret, bool *is_signed_ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = ptr->prog;
+	struct drgn_type *type;
+	struct drgn_object_type value_type;
+	enum drgn_object_kind kind;
+	uint64_t bit_size, address, *cpus;
+	size_t num_cpus;
+
+	type = drgn_underlying_type(ptr->type);
+	if (drgn_type_kind(type) != DRGN_TYPE_POINTER) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "per-CPU sum requires a pointer");
+	}
+	err = drgn_object_set_common(drgn_type_type(type), 0, &value_type,
+				     &kind, &bit_size);
+	if (err)
+		return err;
+	if ((kind != DRGN_OBJECT_SIGNED && kind != DRGN_OBJECT_UNSIGNED) ||
+	    bit_size > 64) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "per-CPU sum requires a pointer to an integer");
+	}
+	err = drgn_object_read_unsigned(ptr, &address);
+	if (err)
+		return err;
+
+	err = linux_helper_cpumask_cpus(prog, mask, &cpus, &num_cpus);
+	if (err)
+		return err;
+	err = per_cpu_sums(prog, cpus, num_cpus, &address, 1, bit_size / 8,
+			   kind == DRGN_OBJECT_SIGNED, ret);
+	if (!err)
+		*is_signed_ret = kind == DRGN_OBJECT_SIGNED;
+	free(cpus);
+	return err;
+}
+
+/* Read an unsigned integer member of a structure object. */
+static struct drgn_error *read_member_unsigned(const struct drgn_object *obj,
+					       const char *member,
+					       uint64_t *ret)
+{
+	struct drgn_error *err;
+	struct drgn_object tmp;
+
+	drgn_object_init(&tmp, obj->prog);
+	err = drgn_object_member_dereference(&tmp, obj, member);
+	if (!err)
+		err = drgn_object_read_unsigned(&tmp, ret);
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+static struct drgn_error *
+slab_object_iterator_init_cpu_slabs(struct linux_helper_slab_object_iterator *it,
+				    const struct drgn_object *slab_cache)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = slab_cache->prog;
+	struct drgn_object tmp;
+	struct drgn_type *type;
+	uint64_t cpu_slab, freelist_offset, slab_offset, *cpus = NULL;
+	size_t num_cpus, i;
+
+	drgn_object_init(&tmp, prog);
+	err = drgn_object_member_dereference(&tmp, slab_cache, "cpu_slab");
+	if (err)
+		goto out;
+	type = drgn_underlying_type(tmp.type);
+	if (drgn_type_kind(type) != DRGN_TYPE_POINTER) {
+		err = drgn_error_create(DRGN_ERROR_TYPE,
+					"kmem_cache cpu_slab is not a pointer");
+		goto out;
+	}
+	type = drgn_type_type(type).type;
+	err = drgn_object_read_unsigned(&tmp, &cpu_slab);
+	if (err)
+		goto out;
+	err = member_offset(prog, type, "freelist", &freelist_offset);
+	if (err)
+		goto out;
+	/* struct kmem_cache_cpu::page was renamed to slab in Linux 5.17. */
+	err = member_offset(prog, type, "slab", &slab_offset);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		err = member_offset(prog, type, "page", &slab_offset);
+	}
+	if (err)
+		goto out;
+
+	err = linux_helper_cpumask_cpus(prog, NULL, &cpus, &num_cpus);
+	if (err)
+		goto out;
+	it->cpu_slabs = malloc_array(num_cpus, sizeof(*it->cpu_slabs));
+	it->cpu_freelists = malloc_array(num_cpus,
+					 sizeof(*it->cpu_freelists));
+	if ((!it->cpu_slabs || !it->cpu_freelists) && num_cpus) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	for (i = 0; i < num_cpus; i++) {
+		uint64_t offset;
+
+		err = per_cpu_offset(prog, cpus[i], &offset);
+		if (err)
+			goto out;
+		err = drgn_program_read_word(prog,
+					     cpu_slab + offset + slab_offset,
+					     false, &it->cpu_slabs[i]);
+		if (err)
+			goto out;
+		err = drgn_program_read_word(prog,
+					     cpu_slab + offset +
+					     freelist_offset, false,
+					     &it->cpu_freelists[i]);
+		if (err)
+			goto out;
+	}
+	it->num_cpu_slabs = num_cpus;
+out:
+	free(cpus);
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+struct drgn_error *
+linux_helper_slab_object_iterator_init(struct linux_helper_slab_object_iterator *it,
+				       const struct drgn_object *slab_cache,
+				       bool cpu_freelists)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = slab_cache->prog;
+	struct drgn_object tmp;
+	struct drgn_qualified_type slab_type;
+	struct drgn_member_info member;
+	uint64_t pg_slab, word_size;
+
+	memset(it, 0, sizeof(*it));
+	drgn_object_init(&tmp, prog);
+
+	err = drgn_object_read_unsigned(slab_cache, &it->slab_cache);
+	if (err)
+		goto out;
+	err = drgn_object_member_dereference(&tmp, slab_cache, "cpu_slab");
+	if (err) {
+		if (err->code == DRGN_ERROR_LOOKUP) {
+			drgn_error_destroy(err);
+			err = drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+						"only SLUB is supported");
+		}
+		goto out;
+	}
+	err = read_member_unsigned(slab_cache, "size", &it->size);
+	if (err)
+		goto out;
+	err = read_member_unsigned(slab_cache, "offset", &it->freeptr_offset);
+	if (err)
+		goto out;
+	word_size = drgn_program_is_64_bit(prog) ? 8 : 4;
+	if (!it->size || it->freeptr_offset + word_size > it->size) {
+		err = drgn_error_create(DRGN_ERROR_OTHER,
+					"invalid kmem_cache size or offset");
+		goto out;
+	}
+	/* red_left_pad only exists with CONFIG_SLUB_DEBUG. */
+	err = read_member_unsigned(slab_cache, "red_left_pad",
+				   &it->red_left_pad);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		it->red_left_pad = 0;
+	} else if (err) {
+		goto out;
+	}
+	err = read_member_unsigned(slab_cache, "random",
+				   &it->freelist_random);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		it->freelist_hardened = false;
+	} else if (err) {
+		goto out;
+	} else {
+		it->freelist_hardened = true;
+	}
+
+	err = drgn_program_find_object(prog, "PAGE_OFFSET", NULL,
+				       DRGN_FIND_OBJECT_CONSTANT, &tmp);
+	if (err)
+		goto out;
+	err = drgn_object_read_unsigned(&tmp, &it->page_offset);
+	if (err)
+		goto out;
+	err = drgn_program_find_object(prog, "PG_slab", NULL,
+				       DRGN_FIND_OBJECT_CONSTANT, &tmp);
+	if (err)
+		goto out;
+	err = drgn_object_read_unsigned(&tmp, &pg_slab);
+	if (err)
+		goto out;
+
+	/*
+	 * Since Linux 5.17, the slab members of struct page are defined in
+	 * struct slab, which overlays struct page.
+	 */
+	err = drgn_program_find_type(prog, "struct slab", NULL, &slab_type);
+	if (!err) {
+		err = drgn_program_member_info(prog, slab_type.type,
+					       "slab_cache", &member);
+	}
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		err = drgn_program_find_type(prog, "struct page", NULL,
+					     &slab_type);
+		if (err)
+			goto out;
+		err = drgn_program_member_info(prog, slab_type.type,
+					       "slab_cache", &member);
+	}
+	if (err)
+		goto out;
+	it->slab_cache_offset = member.bit_offset / 8;
+	err = member_offset(prog, slab_type.type, "freelist",
+			    &it->freelist_offset);
+	if (err)
+		goto out;
+	err = drgn_program_member_info(prog, slab_type.type, "objects",
+				       &member);
+	if (err)
+		goto out;
+	it->objects_bit_offset = member.bit_offset;
+	it->objects_bit_size = member.bit_field_size;
+	if (!it->objects_bit_size) {
+		err = drgn_type_sizeof(member.qualified_type.type,
+				       &it->objects_bit_size);
+		if (err)
+			goto out;
+		it->objects_bit_size *= 8;
+	}
+
+	if (cpu_freelists) {
+		err = slab_object_iterator_init_cpu_slabs(it, slab_cache);
+		if (err)
+			goto out;
+	}
+
+	err = linux_helper_page_iterator_init(&it->pages, prog,
+					      UINT64_C(1) << pg_slab,
+					      UINT64_C(1) << pg_slab);
+	if (err)
+		goto out;
+	if (max(it->slab_cache_offset, it->freelist_offset) + word_size >
+	    it->pages.page_size ||
+	    it->objects_bit_size > 64 ||
+	    it->objects_bit_offset + it->objects_bit_size >
+	    it->pages.page_size * 8) {
+		err = drgn_error_create(DRGN_ERROR_TYPE,
+					"invalid struct page slab members");
+		goto out;
+	}
+	it->slab_free = malloc_array(LINUX_HELPER_SLAB_MAX_OBJECTS,
+				     sizeof(*it->slab_free));
+	if (!it->slab_free)
+		err = &drgn_enomem;
+out:
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+void
+linux_helper_slab_object_iterator_deinit(struct linux_helper_slab_object_iterator *it)
+{
+	free(it->slab_free);
+	free(it->slab_buf);
+	free(it->cpu_freelists);
+	free(it->cpu_slabs);
+	linux_helper_page_iterator_deinit(&it->pages);
+}
+
+/* Get the index of an object in the current slab given its address. */
+static bool slab_object_index(struct linux_helper_slab_object_iterator *it,
+			      uint64_t address, uint64_t *ret)
+{
+	uint64_t start = it->slab_address + it->red_left_pad;
+
+	if (address < start || (address - start) % it->size ||
+	    (address - start) / it->size >= it->slab_objects)
+		return false;
+	*ret = (address - start) / it->size;
+	return true;
+}
+
+/* Mark the objects on a freelist of the current slab as free. */
+static struct drgn_error *
+slab_walk_freelist(struct linux_helper_slab_object_iterator *it,
+		   uint64_t address)
+{
+	bool is_64_bit = drgn_program_is_64_bit(it->pages.prog);
+	uint64_t n = 0;
+
+	while (address) {
+		uint64_t index, ptr_addr, value;
+
+		if (!slab_object_index(it, address, &index) ||
+		    n++ >= it->slab_objects) {
+			return drgn_error_format(DRGN_ERROR_OTHER,
+						 "invalid freelist pointer 0x%" PRIx64 " in slab at 0x%" PRIx64,
+						 address, it->slab_address);
+		}
+		it->slab_free[index] = true;
+		ptr_addr = address + it->freeptr_offset;
+		value = drgn_program_decode_word(it->pages.prog,
+						 it->slab_buf +
+						 (ptr_addr - it->slab_address));
+		if (it->freelist_hardened) {
+			uint64_t swabbed;
+
+			/*
+			 * Since Linux 5.7, the pointer address is byte swapped
+			 * before being mixed in. Fall back to the old encoding
+			 * if that doesn't give a valid pointer.
+			 */
+			swabbed = is_64_bit ? bswap_64(ptr_addr) :
+					      bswap_32(ptr_addr);
+			address = value ^ it->freelist_random ^ swabbed;
+			if (address && !slab_object_index(it, address, &index))
+				address = value ^ it->freelist_random ^ ptr_addr;
+		} else {
+			address = value;
+		}
+	}
+	return NULL;
+}
+
+/* Read a slab and compute its free objects. */
+static struct drgn_error *
+slab_object_iterator_load(struct linux_helper_slab_object_iterator *it,
+			  uint64_t pfn, const char *page, uint64_t objects)
+{
+	struct drgn_error *err;
+	uint64_t page_address, freelist, size;
+	size_t i;
+
+	if (objects > LINUX_HELPER_SLAB_MAX_OBJECTS) {
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "slab at PFN %" PRIu64 " has too many objects",
+					 pfn);
+	}
+	it->slab_address = it->page_offset + (pfn << PAGE_SHIFT);
+	it->slab_objects = objects;
+	it->slab_index = 0;
+
+	size = it->red_left_pad + objects * it->size;
+	if (size > it->slab_buf_size) {
+		char *tmp;
+
+		tmp = realloc(it->slab_buf, size);
+		if (!tmp)
+			return &drgn_enomem;
+		it->slab_buf = tmp;
+		it->slab_buf_size = size;
+	}
+	err = drgn_program_read_memory(it->pages.prog, it->slab_buf,
+				       it->slab_address, size, false);
+	if (err)
+		return err;
+
+	memset(it->slab_free, 0, objects * sizeof(it->slab_free[0]));
+	freelist = drgn_program_decode_word(it->pages.prog,
+					    page + it->freelist_offset);
+	err = slab_walk_freelist(it, freelist);
+	if (err)
+		return err;
+	page_address = it->pages.vmemmap + pfn * it->pages.page_size;
+	for (i = 0; i < it->num_cpu_slabs; i++) {
+		if (it->cpu_slabs[i] == page_address) {
+			err = slab_walk_freelist(it, it->cpu_freelists[i]);
+			if (err)
+				return err;
+		}
+	}
+	return NULL;
+}
+
+struct drgn_error *
+linux_helper_slab_object_iterator_next(struct linux_helper_slab_object_iterator *it,
+				       uint64_t *ret)
+{
+	struct drgn_error *err;
+	bool little_endian = drgn_program_is_little_endian(it->pages.prog);
+
+	for (;;) {
+		uint64_t pfn, slab_cache, objects;
+		const char *page;
+
+		while (it->slab_index < it->slab_objects) {
+			uint64_t i = it->slab_index++;
+
+			if (!it->slab_free[i]) {
+				*ret = (it->slab_address + it->red_left_pad +
+					i * it->size);
+				return NULL;
+			}
+		}
+
+		err = linux_helper_page_iterator_next(&it->pages, &pfn);
+		if (err)
+			return err;
+		/* The page iterator leaves the struct page in its buffer. */
+		page = (it->pages.buf +
+			(pfn - it->pages.buf_pfn) * it->pages.page_size);
+		slab_cache = drgn_program_decode_word(it->pages.prog,
+						      page +
+						      it->slab_cache_offset);
+		if (slab_cache != it->slab_cache)
+			continue;
+		objects = deserialize_bits(page + it->objects_bit_offset / 8,
+					   it->objects_bit_offset % 8,
+					   it->objects_bit_size,
+					   little_endian);
+		err = slab_object_iterator_load(it, pfn, page, objects);
+		if (err)
+			return err;
+	}
+}
+
+/* Member offsets used to compute the path of a dentry. */
+struct dentry_path_info {
+	struct drgn_program *prog;
+	/* Offsets in struct dentry. */
+	uint64_t d_parent, d_name_name, d_name_len, d_name_len_size;
+	/* Offsets in struct mount. */
+	uint64_t mnt, mnt_parent, mnt_mountpoint, mnt_root;
+};
+
+/* A dentry whose path hasn't been computed yet. */
+struct dentry_path_step {
+	/* Address of the struct mount, or 0 for dentry_path(). */
+	uint64_t mnt;
+	uint64_t dentry;
+	/*
+	 * Address and length of the dentry's name, or 0 and UINT64_MAX if the
+	 * dentry is the root of a mount and has the same path as its mount
+	 * point.
+	 */
+	uint64_t name;
+	uint64_t name_len;
+};
+
+/* Enough for most paths without allocating. */
+DEFINE_SMALL_VECTOR(dentry_path_step_vector, struct dentry_path_step, 16)
+
+/*
+ * Maximum number of dentries walked for a single path, to bound the walk if
+ * there is a cycle.
+ */
+static const size_t DENTRY_PATH_MAX_STEPS = 65536;
+
+/* Maximum length of a single path component that we'll read. */
+static const uint64_t DENTRY_NAME_MAX = 4096;
+
+static struct drgn_error *dentry_path_info_init(struct dentry_path_info *info,
+						struct drgn_program *prog,
+						struct drgn_type *dentry_type,
+						bool mounts)
+{
+	struct drgn_error *err;
+	struct drgn_member_info member;
+	struct drgn_qualified_type mount_type;
+
+	info->prog = prog;
+	err = member_offset(prog, dentry_type, "d_parent", &info->d_parent);
+	if (err)
+		return err;
+	err = member_offset(prog, dentry_type, "d_name.name",
+			    &info->d_name_name);
+	if (err)
+		return err;
+	err = drgn_program_member_path(prog, dentry_type, "d_name.len",
+				       &member);
+	if (err)
+		return err;
+	info->d_name_len = member.bit_offset / 8;
+	err = drgn_type_sizeof(member.qualified_type.type,
+			       &info->d_name_len_size);
+	if (err)
+		return err;
+	if (member.bit_offset % 8 || member.bit_field_size ||
+	    info->d_name_len_size > 8) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "invalid qstr len member");
+	}
+	if (!mounts)
+		return NULL;
+
+	err = drgn_program_find_type(prog, "struct mount", NULL, &mount_type);
+	if (err)
+		return err;
+	err = member_offset(prog, mount_type.type, "mnt", &info->mnt);
+	if (err)
+		return err;
+	err = member_offset(prog, mount_type.type, "mnt_parent",
+			    &info->mnt_parent);
+	if (err)
+		return err;
+	err = member_offset(prog, mount_type.type, "mnt_mountpoint",
+			    &info->mnt_mountpoint);
+	if (err)
+		return err;
+	return member_offset(prog, mount_type.type, "mnt.mnt_root",
+			     &info->mnt_root);
+}
+
+/*
+ * Compute the path of a dentry. If mnt is 0, this is the path from the root
+ * of the filesystem without a leading slash. Otherwise, it's the full path
+ * with a leading slash, except that the root directory is the empty string.
+ */
+static struct drgn_error *dentry_path(struct dentry_path_info *info,
+				      uint64_t mnt, uint64_t dentry,
+				      struct string_builder *sb)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = info->prog;
+	bool little_endian = drgn_program_is_little_endian(prog);
+	struct dentry_path_step_vector steps;
+	size_t i;
+
+	dentry_path_step_vector_init(&steps);
+	for (;;) {
+		struct dentry_path_step *step;
+		bool found;
+		uint64_t d_parent, name, name_len;
+		char buf[8];
+
+		if (!drgn_program_find_dentry_path(prog, mnt, dentry, sb,
+						   &found)) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		if (found)
+			break;
+
+		if (steps.size >= DENTRY_PATH_MAX_STEPS) {
+			err = drgn_error_format(DRGN_ERROR_OTHER,
+						"path of dentry 0x%" PRIx64 " is too deep",
+						dentry);
+			goto out;
+		}
+
+		if (mnt) {
+			uint64_t mnt_root, mnt_parent;
+
+			err = drgn_program_read_word(prog,
+						     mnt + info->mnt_root,
+						     false, &mnt_root);
+			if (err)
+				goto out;
+			if (dentry == mnt_root) {
+				err = drgn_program_read_word(prog,
+							     mnt + info->mnt_parent,
+							     false,
+							     &mnt_parent);
+				if (err)
+					goto out;
+				if (mnt == mnt_parent)
+					break;
+				step = dentry_path_step_vector_append_entry(&steps);
+				if (!step) {
+					err = &drgn_enomem;
+					goto out;
+				}
+				step->mnt = mnt;
+				step->dentry = dentry;
+				step->name = 0;
+				step->name_len = UINT64_MAX;
+				err = drgn_program_read_word(prog,
+							     mnt + info->mnt_mountpoint,
+							     false, &dentry);
+				if (err)
+					goto out;
+				mnt = mnt_parent;
+				continue;
+			}
+		}
+
+		err = drgn_program_read_word(prog, dentry + info->d_parent,
+					     false, &d_parent);
+		if (err)
+			goto out;
+		if (dentry == d_parent)
+			break;
+		err = drgn_program_read_word(prog, dentry + info->d_name_name,
+					     false, &name);
+		if (err)
+			goto out;
+		err = drgn_program_read_memory(prog, buf,
+					       dentry + info->d_name_len,
+					       info->d_name_len_size, false);
+		if (err)
+			goto out;
+		name_len = deserialize_bits(buf, 0, info->d_name_len_size * 8,
+					    little_endian);
+		if (name_len > DENTRY_NAME_MAX) {
+			err = drgn_error_format(DRGN_ERROR_OTHER,
+						"name of dentry 0x%" PRIx64 " is too long",
+						dentry);
+			goto out;
+		}
+		step = dentry_path_step_vector_append_entry(&steps);
+		if (!step) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		step->mnt = mnt;
+		step->dentry = dentry;
+		step->name = name;
+		step->name_len = name_len;
+		dentry = d_parent;
+	}
+
+	/* Now build the path from the top down, caching every prefix. */
+	for (i = steps.size; i-- > 0;) {
+		struct dentry_path_step *step = &steps.data[i];
+
+		if (step->name_len != UINT64_MAX) {
+			if ((step->mnt || sb->len) &&
+			    !string_builder_appendc(sb, '/')) {
+				err = &drgn_enomem;
+				goto out;
+			}
+			if (!string_builder_reserve(sb,
+						    sb->len + step->name_len)) {
+				err = &drgn_enomem;
+				goto out;
+			}
+			err = drgn_program_read_memory(prog, sb->str + sb->len,
+						       step->name,
+						       step->name_len, false);
+			if (err)
+				goto out;
+			sb->len += step->name_len;
+		}
+		drgn_program_cache_dentry_path(prog, step->mnt, step->dentry,
+					       sb->str, sb->len);
+	}
+	err = NULL;
+out:
+	dentry_path_step_vector_deinit(&steps);
+	return err;
+}
+
+struct drgn_error *linux_helper_d_path(const struct drgn_object *path_or_vfsmnt,
+				       const struct drgn_object *dentry,
+				       char **ret, size_t *len_ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = path_or_vfsmnt->prog;
+	struct dentry_path_info info;
+	struct drgn_type *type, *dentry_type;
+	struct drgn_qualified_type qualified_type;
+	struct string_builder sb = {};
+	uint64_t vfsmnt, dentry_address, d_op, d_dname, d_op_offset;
+	const char *tag;
+
+	type = drgn_underlying_type(path_or_vfsmnt->type);
+	if (drgn_type_kind(type) == DRGN_TYPE_POINTER)
+		type = drgn_underlying_type(drgn_type_type(type).type);
+	tag = drgn_type_kind(type) == DRGN_TYPE_STRUCT ?
+	      drgn_type_tag(type) : NULL;
+	if (tag && strcmp(tag, "path") == 0) {
+		uint64_t path, mnt_offset, dentry_offset;
+
+		err = head_address_and_type(path_or_vfsmnt, "path", &type,
+					    &path);
+		if (err)
+			return err;
+		err = member_offset(prog, type, "mnt", &mnt_offset);
+		if (err)
+			return err;
+		err = member_offset(prog, type, "dentry", &dentry_offset);
+		if (err)
+			return err;
+		err = drgn_program_read_word(prog, path + mnt_offset, false,
+					     &vfsmnt);
+		if (err)
+			return err;
+		err = drgn_program_read_word(prog, path + dentry_offset, false,
+					     &dentry_address);
+		if (err)
+			return err;
+	} else {
+		if (!dentry) {
+			return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+						 "d_path() with a vfsmount requires a dentry");
+		}
+		err = drgn_object_read_unsigned(path_or_vfsmnt, &vfsmnt);
+		if (err)
+			return err;
+		err = drgn_object_read_unsigned(dentry, &dentry_address);
+		if (err)
+			return err;
+	}
+
+	err = drgn_program_find_type(prog, "struct dentry", NULL,
+				     &qualified_type);
+	if (err)
+		return err;
+	dentry_type = qualified_type.type;
+	err = dentry_path_info_init(&info, prog, dentry_type, true);
+	if (err)
+		return err;
+
+	/* Names generated by d_dname() can't be computed. */
+	err = member_offset(prog, dentry_type, "d_op", &d_op_offset);
+	if (err)
+		return err;
+	err = drgn_program_read_word(prog, dentry_address + d_op_offset, false,
+				     &d_op);
+	if (err)
+		return err;
+	if (d_op) {
+		uint64_t d_dname_offset;
+
+		err = drgn_program_find_type(prog, "struct dentry_operations",
+					     NULL, &qualified_type);
+		if (err)
+			return err;
+		err = member_offset(prog, qualified_type.type, "d_dname",
+				    &d_dname_offset);
+		if (err)
+			return err;
+		err = drgn_program_read_word(prog, d_op + d_dname_offset, false,
+					     &d_dname);
+		if (err)
+			return err;
+		if (d_dname) {
+			*ret = NULL;
+			*len_ret = 0;
+			return NULL;
+		}
+	}
+
+	err = dentry_path(&info, vfsmnt - info.mnt, dentry_address, &sb);
+	if (err)
+		goto err;
+	if (!sb.len && !string_builder_appendc(&sb, '/')) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	*ret = sb.str;
+	*len_ret = sb.len;
+	return NULL;
+
+err:
+	free(sb.str);
+	return err;
+}
+
+struct drgn_error *linux_helper_dentry_path(const struct drgn_object *dentry,
+					    char **ret, size_t *len_ret)
+{
+	struct drgn_error *err;
+	struct dentry_path_info info;
+	struct drgn_type *type;
+	struct string_builder sb = {};
+	uint64_t address;
+
+	type = drgn_underlying_type(dentry->type);
+	if (drgn_type_kind(type) != DRGN_TYPE_POINTER) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "dentry_path() requires a pointer");
+	}
+	err = drgn_object_read_unsigned(dentry, &address);
+	if (err)
+		return err;
+	err = dentry_path_info_init(&info, dentry->prog,
+				    drgn_type_type(type).type, false);
+	if (err)
+		return err;
+	err = dentry_path(&info, 0, address, &sb);
+	if (err) {
+		free(sb.str);
+		return err;
+	}
+	*ret = sb.str;
+	*len_ret = sb.len;
+	return NULL;
+}
+
+/* Members of struct task_struct read by linux_helper_task_snapshot(). */
+enum task_snapshot_member_index {
+	TASK_SNAPSHOT_PID,
+	TASK_SNAPSHOT_TGID,
+	TASK_SNAPSHOT_COMM,
+	TASK_SNAPSHOT_STATE,
+	TASK_SNAPSHOT_EXIT_STATE,
+	TASK_SNAPSHOT_UTIME,
+	TASK_SNAPSHOT_STIME,
+	TASK_SNAPSHOT_MM,
+	TASK_SNAPSHOT_NUM_MEMBERS,
+};
+
+/*
+ * Maximum number of member ranges in a read plan. This leaves room for the
+ * members of struct cgroup_subsys_state read by linux_helper_cgroup_walk().
+ */
+#define TASK_SNAPSHOT_MAX_RANGES (LINUX_HELPER_CGROUP_WALK_MAX_FIELDS + 8)
+
+/* Location of a member or of a range of members read in one request. */
+struct task_snapshot_range {
+	uint64_t offset, size;
+};
+
+/* Memory read plan for a structure. */
+struct task_snapshot_plan {
+	/* Ranges to read, sorted by offset. */
+	struct task_snapshot_range spans[TASK_SNAPSHOT_MAX_RANGES];
+	size_t num_spans;
+	/* Offset of the first range and size covering all of the ranges. */
+	uint64_t base, window;
+};
+
+/*
+ * Member copied directly for each field, or -1 if the field is computed
+ * separately.
+ */
+static const int task_snapshot_direct_members[LINUX_HELPER_NUM_TASK_FIELDS] = {
+	[LINUX_HELPER_TASK_ADDRESS] = -1,
+	[LINUX_HELPER_TASK_PID] = TASK_SNAPSHOT_PID,
+	[LINUX_HELPER_TASK_TGID] = TASK_SNAPSHOT_TGID,
+	[LINUX_HELPER_TASK_COMM] = -1,
+	[LINUX_HELPER_TASK_STATE] = -1,
+	[LINUX_HELPER_TASK_UTIME] = TASK_SNAPSHOT_UTIME,
+	[LINUX_HELPER_TASK_STIME] = TASK_SNAPSHOT_STIME,
+	[LINUX_HELPER_TASK_RSS] = -1,
+};
+
+/* Number of tasks whose structures are read in one batch. */
+#define TASK_SNAPSHOT_BATCH_SIZE 256
+
+/*
+ * Members closer than this many bytes apart are read in the same request, since
+ * a slightly larger read is cheaper than an extra one.
+ */
+static const uint64_t TASK_SNAPSHOT_MAX_GAP = 128;
+
+DEFINE_VECTOR(task_address_vector, uint64_t)
+
+static struct drgn_error *task_snapshot_member(struct drgn_program *prog,
+					       struct drgn_type *type,
+					       const char *member_designator,
+					       uint64_t max_size,
+					       struct task_snapshot_range *ret)
+{
+	struct drgn_error *err;
+	struct drgn_member_info member;
+
+	err = drgn_program_member_path(prog, type, member_designator, &member);
+	if (err)
+		return err;
+	err = drgn_type_sizeof(member.qualified_type.type, &ret->size);
+	if (err)
+		return err;
+	if (member.bit_offset % 8 || member.bit_field_size ||
+	    ret->size > max_size || !ret->size) {
+		return drgn_error_format(DRGN_ERROR_TYPE,
+					 "unsupported %s member",
+					 member_designator);
+	}
+	ret->offset = member.bit_offset / 8;
+	return NULL;
+}
+
+/* Sort and coalesce member ranges into a read plan. */
+static void task_snapshot_plan_init(struct task_snapshot_plan *plan,
+				    const struct task_snapshot_range *members,
+				    size_t num_members)
+{
+	struct task_snapshot_range sorted[TASK_SNAPSHOT_MAX_RANGES];
+	size_t i, j;
+
+	for (i = 0; i < num_members; i++) {
+		for (j = i; j > 0 && sorted[j - 1].offset > members[i].offset;
+		     j--)
+			sorted[j] = sorted[j - 1];
+		sorted[j] = members[i];
+	}
+
+	plan->num_spans = 0;
+	for (i = 0; i < num_members; i++) {
+		struct task_snapshot_range *span;
+		uint64_t end = sorted[i].offset + sorted[i].size;
+
+		if (plan->num_spans) {
+			span = &plan->spans[plan->num_spans - 1];
+			if (sorted[i].offset <= span->offset + span->size +
+						TASK_SNAPSHOT_MAX_GAP) {
+				if (end > span->offset + span->size)
+					span->size = end - span->offset;
+				continue;
+			}
+		}
+		plan->spans[plan->num_spans++] = sorted[i];
+	}
+	if (plan->num_spans) {
+		struct task_snapshot_range *last;
+
+		last = &plan->spans[plan->num_spans - 1];
+		plan->base = plan->spans[0].offset;
+		plan->window = last->offset + last->size - plan->base;
+	} else {
+		plan->base = plan->window = 0;
+	}
+}
+
+/*
+ * Read the planned ranges of a batch of structures into buf, which has room
+ * for plan->window bytes per structure. Addresses of 0 are skipped.
+ */
+static struct drgn_error *
+task_snapshot_plan_read(struct drgn_program *prog,
+			const struct task_snapshot_plan *plan,
+			const uint64_t *addresses, size_t n, char *buf,
+			struct drgn_memory_read_request *requests)
+{
+	size_t i, j, num_requests = 0;
+
+	for (i = 0; i < n; i++) {
+		if (!addresses[i])
+			continue;
+		for (j = 0; j < plan->num_spans; j++) {
+			const struct task_snapshot_range *span = &plan->spans[j];
+
+			requests[num_requests++] = (struct drgn_memory_read_request){
+				.buf = (buf + i * plan->window + span->offset -
+					plan->base),
+				.address = addresses[i] + span->offset,
+				.count = span->size,
+			};
+		}
+	}
+	if (!num_requests)
+		return NULL;
+	return drgn_program_read_memory_batch(prog, requests, num_requests);
+}
+
+static uint64_t task_snapshot_value(const char *buf,
+				    const struct task_snapshot_plan *plan,
+				    const struct task_snapshot_range *member,
+				    bool little_endian)
+{
+	return deserialize_bits(buf + member->offset - plan->base, 0,
+				member->size * 8, little_endian);
+}
+
+/*
+ * Find the locations of the mm_struct counters summed by get_mm_rss():
+ * MM_FILEPAGES, MM_ANONPAGES, and MM_SHMEMPAGES (if it exists). If indices_ret
+ * is not NULL, it is set to the index of each counter in mm->rss_stat.
+ */
+static struct drgn_error *
+task_snapshot_rss_members(struct drgn_program *prog,
+			  struct task_snapshot_range *ret,
+			  uint64_t *indices_ret, size_t *num_ret)
+{
+	static const char * const counters[] = {
+		"MM_FILEPAGES", "MM_ANONPAGES", "MM_SHMEMPAGES",
+	};
+	struct drgn_error *err;
+	struct drgn_qualified_type mm_type;
+	struct drgn_object tmp;
+	size_t i;
+
+	err = drgn_program_find_type(prog, "struct mm_struct", NULL, &mm_type);
+	if (err)
+		return err;
+	drgn_object_init(&tmp, prog);
+	*num_ret = 0;
+	for (i = 0; i < ARRAY_SIZE(counters); i++) {
+		uint64_t index;
+		char member[64];
+
+		err = drgn_program_find_object(prog, counters[i], NULL,
+					       DRGN_FIND_OBJECT_CONSTANT,
+					       &tmp);
+		if (err && err->code == DRGN_ERROR_LOOKUP && i == 2) {
+			/* MM_SHMEMPAGES was added in Linux 4.5. */
+			drgn_error_destroy(err);
+			err = NULL;
+			break;
+		}
+		if (err)
+			goto out;
+		err = drgn_object_read_unsigned(&tmp, &index);
+		if (err)
+			goto out;
+
+		/*
+		 * mm->rss_stat is an array of struct percpu_counter since
+		 * Linux 6.2 and a struct mm_rss_stat before that.
+		 */
+		snprintf(member, sizeof(member), "rss_stat.count[%" PRIu64 "].counter",
+			 index);
+		err = task_snapshot_member(prog, mm_type.type, member, 8,
+					   &ret[*num_ret]);
+		if (err && (err->code == DRGN_ERROR_LOOKUP ||
+			    err->code == DRGN_ERROR_TYPE)) {
+			drgn_error_destroy(err);
+			snprintf(member, sizeof(member),
+				 "rss_stat[%" PRIu64 "].count", index);
+			err = task_snapshot_member(prog, mm_type.type, member,
+						   8, &ret[*num_ret]);
+		}
+		if (err)
+			goto out;
+		if (indices_ret)
+			indices_ret[*num_ret] = index;
+		(*num_ret)++;
+	}
+	err = NULL;
+out:
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+/*
+ * Fill in the fields of task t of a snapshot from its structure read into buf.
+ * Returns the task's mm if LINUX_HELPER_TASK_RSS is requested.
+ */
+static uint64_t task_snapshot_fill(struct drgn_program *prog,
+				   struct linux_helper_task_snapshot *snapshot,
+				   size_t t, uint64_t task, const char *buf,
+				   const struct task_snapshot_plan *plan,
+				   const struct task_snapshot_range *members)
+{
+	bool little_endian = drgn_program_is_little_endian(prog);
+	uint64_t **values = snapshot->values;
+	size_t f;
+
+#define VALUE(index)	\
+	task_snapshot_value(buf, plan, &members[index], little_endian)
+	for (f = 0; f < LINUX_HELPER_NUM_TASK_FIELDS; f++) {
+		int m = task_snapshot_direct_members[f];
+
+		if (values[f] && m >= 0)
+			values[f][t] = VALUE(m);
+	}
+	if (values[LINUX_HELPER_TASK_ADDRESS])
+		values[LINUX_HELPER_TASK_ADDRESS][t] = task;
+	if (values[LINUX_HELPER_TASK_STATE]) {
+		values[LINUX_HELPER_TASK_STATE][t] =
+			task_state_char(prog, VALUE(TASK_SNAPSHOT_STATE),
+					VALUE(TASK_SNAPSHOT_EXIT_STATE));
+	}
+	if (snapshot->comms) {
+		memcpy(snapshot->comms + t * snapshot->comm_len,
+		       buf + members[TASK_SNAPSHOT_COMM].offset - plan->base,
+		       snapshot->comm_len);
+	}
+	return values[LINUX_HELPER_TASK_RSS] ? VALUE(TASK_SNAPSHOT_MM) : 0;
+#undef VALUE
+}
+
+static struct drgn_error *task_snapshot_tasks(const struct drgn_object *ns,
+					      struct task_address_vector *tasks)
+{
+	struct drgn_error *err;
+	struct linux_helper_pid_iterator it;
+
+	err = linux_helper_pid_iterator_init(&it, ns, true);
+	if (err)
+		goto out;
+	for (;;) {
+		uint64_t task;
+
+		err = linux_helper_pid_iterator_next(&it, &task);
+		if (err == &drgn_stop) {
+			err = NULL;
+			break;
+		}
+		if (err)
+			goto out;
+		if (!task_address_vector_append(tasks, &task)) {
+			err = &drgn_enomem;
+			goto out;
+		}
+	}
+out:
+	linux_helper_pid_iterator_deinit(&it);
+	return err;
+}
+
+struct drgn_error *
+linux_helper_task_snapshot(struct linux_helper_task_snapshot *ret,
+			   const struct drgn_object *ns, uint64_t fields)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = ns->prog;
+	bool little_endian = drgn_program_is_little_endian(prog);
+	struct task_snapshot_range members[TASK_SNAPSHOT_NUM_MEMBERS];
+	struct task_snapshot_range wanted[TASK_SNAPSHOT_NUM_MEMBERS];
+	struct task_snapshot_range rss_members[3];
+	size_t num_wanted = 0, num_rss_members = 0;
+	struct task_snapshot_plan task_plan, rss_plan;
+	struct task_address_vector tasks = VECTOR_INIT;
+	struct drgn_memory_read_request *requests = NULL;
+	char *task_buf = NULL, *rss_buf = NULL;
+	uint64_t mms[TASK_SNAPSHOT_BATCH_SIZE];
+	struct drgn_qualified_type task_type;
+	struct drgn_object tmp;
+	size_t i, start;
+
+	memset(ret, 0, sizeof(*ret));
+	drgn_object_init(&tmp, prog);
+
+	err = drgn_program_find_type(prog, "struct task_struct", NULL,
+				     &task_type);
+	if (err)
+		goto err;
+
+#define WANT(field_mask, index, designator, max_size) do {			\
+	if (fields & (field_mask)) {						\
+		err = task_snapshot_member(prog, task_type.type, designator,	\
+					   max_size, &members[index]);		\
+		if (err)							\
+			goto err;						\
+		wanted[num_wanted++] = members[index];				\
+	}									\
+} while (0)
+	WANT(UINT64_C(1) << LINUX_HELPER_TASK_PID, TASK_SNAPSHOT_PID, "pid",
+	     8);
+	WANT(UINT64_C(1) << LINUX_HELPER_TASK_TGID, TASK_SNAPSHOT_TGID,
+	     "tgid", 8);
+	WANT(UINT64_C(1) << LINUX_HELPER_TASK_COMM, TASK_SNAPSHOT_COMM,
+	     "comm", 64);
+	WANT(UINT64_C(1) << LINUX_HELPER_TASK_UTIME, TASK_SNAPSHOT_UTIME,
+	     "utime", 8);
+	WANT(UINT64_C(1) << LINUX_HELPER_TASK_STIME, TASK_SNAPSHOT_STIME,
+	     "stime", 8);
+	WANT(UINT64_C(1) << LINUX_HELPER_TASK_RSS, TASK_SNAPSHOT_MM, "mm", 8);
+	WANT(UINT64_C(1) << LINUX_HELPER_TASK_STATE, TASK_SNAPSHOT_EXIT_STATE,
+	     "exit_state", 8);
+#undef WANT
+	if (fields & (UINT64_C(1) << LINUX_HELPER_TASK_STATE)) {
+		/* task_struct::state was renamed to __state in Linux 5.14. */
+		err = task_snapshot_member(prog, task_type.type, "__state", 8,
+					   &members[TASK_SNAPSHOT_STATE]);
+		if (err && err->code == DRGN_ERROR_LOOKUP) {
+			drgn_error_destroy(err);
+			err = task_snapshot_member(prog, task_type.type,
+						   "state", 8,
+						   &members[TASK_SNAPSHOT_STATE]);
+		}
+		if (err)
+			goto err;
+		wanted[num_wanted++] = members[TASK_SNAPSHOT_STATE];
+		if (!prog->task_state_chars) {
+			err = cache_task_state_chars(&tmp);
+			if (err)
+				goto err;
+		}
+	}
+	task_snapshot_plan_init(&task_plan, wanted, num_wanted);
+	if (fields & (UINT64_C(1) << LINUX_HELPER_TASK_RSS)) {
+		err = task_snapshot_rss_members(prog, rss_members, NULL,
+						&num_rss_members);
+		if (err)
+			goto err;
+	}
+	task_snapshot_plan_init(&rss_plan, rss_members, num_rss_members);
+
+	err = task_snapshot_tasks(ns, &tasks);
+	if (err)
+		goto err;
+	ret->num_tasks = tasks.size;
+	for (i = 0; i < LINUX_HELPER_NUM_TASK_FIELDS; i++) {
+		if (i == LINUX_HELPER_TASK_COMM ||
+		    !(fields & (UINT64_C(1) << i)))
+			continue;
+		ret->values[i] = malloc_array(max(tasks.size, (size_t)1),
+					      sizeof(ret->values[i][0]));
+		if (!ret->values[i]) {
+			err = &drgn_enomem;
+			goto err;
+		}
+	}
+	if (fields & (UINT64_C(1) << LINUX_HELPER_TASK_COMM)) {
+		ret->comm_len = members[TASK_SNAPSHOT_COMM].size;
+		ret->comms = malloc_array(max(tasks.size, (size_t)1),
+					  ret->comm_len);
+		if (!ret->comms) {
+			err = &drgn_enomem;
+			goto err;
+		}
+	}
+
+	task_buf = malloc_array(TASK_SNAPSHOT_BATCH_SIZE,
+				max(task_plan.window, (uint64_t)1));
+	rss_buf = malloc_array(TASK_SNAPSHOT_BATCH_SIZE,
+			       max(rss_plan.window, (uint64_t)1));
+	requests = malloc_array(TASK_SNAPSHOT_BATCH_SIZE,
+				TASK_SNAPSHOT_NUM_MEMBERS * sizeof(*requests));
+	if (!task_buf || !rss_buf || !requests) {
+		err = &drgn_enomem;
+		goto err;
+	}
+
+	for (start = 0; start < tasks.size; start += TASK_SNAPSHOT_BATCH_SIZE) {
+		size_t n = min(tasks.size - start,
+			       (size_t)TASK_SNAPSHOT_BATCH_SIZE);
+
+		err = task_snapshot_plan_read(prog, &task_plan,
+					      &tasks.data[start], n, task_buf,
+					      requests);
+		if (err)
+			goto err;
+		for (i = 0; i < n; i++) {
+			mms[i] = task_snapshot_fill(prog, ret, start + i,
+						    tasks.data[start + i],
+						    task_buf + i * task_plan.window,
+						    &task_plan, members);
+		}
+
+		if (!ret->values[LINUX_HELPER_TASK_RSS])
+			continue;
+		err = task_snapshot_plan_read(prog, &rss_plan, mms, n, rss_buf,
+					      requests);
+		if (err)
+			goto err;
+		for (i = 0; i < n; i++) {
+			const char *buf = rss_buf + i * rss_plan.window;
+			uint64_t rss = 0;
+			size_t j;
+
+			for (j = 0; mms[i] && j < num_rss_members; j++) {
+				int64_t count;
+
+				count = task_snapshot_value(buf, &rss_plan,
+							    &rss_members[j],
+							    little_endian);
+				count = sign_extend(count,
+						    rss_members[j].size * 8);
+				/* Counters may be transiently negative. */
+				if (count > 0)
+					rss += count;
+			}
+			ret->values[LINUX_HELPER_TASK_RSS][start + i] = rss;
+		}
+	}
+	err = NULL;
+	goto out;
+
+err:
+	linux_helper_task_snapshot_deinit(ret);
+out:
+	free(requests);
+	free(rss_buf);
+	free(task_buf);
+	task_address_vector_deinit(&tasks);
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+void
+linux_helper_task_snapshot_deinit(struct linux_helper_task_snapshot *snapshot)
+{
+	size_t i;
+
+	for (i = 0; i < LINUX_HELPER_NUM_TASK_FIELDS; i++)
+		free(snapshot->values[i]);
+	free(snapshot->comms);
+}
+
+/* Map from an mm to its index in the array of distinct mms. */
+DEFINE_HASH_MAP(task_rss_mm_map, uint64_t, size_t, hash_pair_int_type,
+		hash_table_scalar_eq)
+
+/*
+ * Find the per-CPU counters of mm->rss_stat. Since Linux 6.2, each counter is
+ * a struct percpu_counter whose total also includes the unflushed per-CPU
+ * deltas in counters. Returns with *num_ret = 0 for older kernels.
+ */
+static struct drgn_error *
+task_rss_per_cpu_members(struct drgn_program *prog,
+			 const uint64_t *indices, size_t num_counters,
+			 struct task_snapshot_range *ret, size_t *num_ret,
+			 uint64_t *size_ret)
+{
+	struct drgn_error *err;
+	struct drgn_qualified_type mm_type;
+	struct drgn_member_info member;
+	struct drgn_type *type;
+	size_t i;
+
+	*num_ret = 0;
+	err = drgn_program_find_type(prog, "struct mm_struct", NULL, &mm_type);
+	if (err)
+		return err;
+	for (i = 0; i < num_counters; i++) {
+		char designator[64];
+
+		snprintf(designator, sizeof(designator),
+			 "rss_stat[%" PRIu64 "].counters", indices[i]);
+		err = task_snapshot_member(prog, mm_type.type, designator, 8,
+					   &ret[i]);
+		if (err && (err->code == DRGN_ERROR_LOOKUP ||
+			    err->code == DRGN_ERROR_TYPE) && i == 0) {
+			drgn_error_destroy(err);
+			return NULL;
+		}
+		if (err)
+			return err;
+	}
+	err = drgn_program_member_path(prog, mm_type.type,
+				       "rss_stat[0].counters", &member);
+	if (err)
+		return err;
+	type = drgn_underlying_type(member.qualified_type.type);
+	if (drgn_type_kind(type) != DRGN_TYPE_POINTER) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "percpu_counter counters is not a pointer");
+	}
+	err = drgn_type_sizeof(drgn_type_type(type).type, size_ret);
+	if (err)
+		return err;
+	*num_ret = num_counters;
+	return NULL;
+}
+
+/*
+ * Find the per-thread counters of task->rss_stat. Before Linux 6.2, with
+ * SPLIT_RSS_COUNTING, each thread caches deltas to the counters of its mm.
+ * Returns with *num_ret = 0 if they don't exist.
+ */
+static struct drgn_error *
+task_rss_split_members(struct drgn_program *prog, struct drgn_type *task_type,
+		       const uint64_t *indices, size_t num_counters,
+		       struct task_snapshot_range *ret, size_t *num_ret)
+{
+	struct drgn_error *err;
+	size_t i;
+
+	*num_ret = 0;
+	for (i = 0; i < num_counters; i++) {
+		char designator[64];
+
+		snprintf(designator, sizeof(designator),
+			 "rss_stat.count[%" PRIu64 "]", indices[i]);
+		err = task_snapshot_member(prog, task_type, designator, 8,
+					   &ret[i]);
+		if (err && err->code == DRGN_ERROR_LOOKUP && i == 0) {
+			drgn_error_destroy(err);
+			return NULL;
+		}
+		if (err)
+			return err;
+	}
+	*num_ret = num_counters;
+	return NULL;
+}
+
+struct drgn_error *linux_helper_task_rss(const struct drgn_object *ns,
+					 struct linux_helper_task_rss **ret,
+					 size_t *num_ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = ns->prog;
+	bool little_endian = drgn_program_is_little_endian(prog);
+	struct task_snapshot_range task_members[4], mm_members[6];
+	struct task_snapshot_range *rss_members = mm_members;
+	struct task_snapshot_range *per_cpu_members, *split_members;
+	uint64_t indices[3], per_cpu_size = 0;
+	size_t num_counters, num_per_cpu, num_split, i, j, start;
+	struct task_snapshot_plan task_plan, mm_plan;
+	struct drgn_qualified_type task_type;
+	struct task_address_vector tasks = VECTOR_INIT;
+	struct task_address_vector mms = VECTOR_INIT;
+	struct task_rss_mm_map mm_map = HASH_TABLE_INIT;
+	struct linux_helper_task_rss *entries = NULL;
+	struct drgn_memory_read_request *requests = NULL;
+	char *buf = NULL;
+	/*
+	 * Index of the distinct mm of each task, or SIZE_MAX for kernel
+	 * threads.
+	 */
+	size_t *mm_indices = NULL;
+	/* Counter totals of each distinct mm, num_counters each. */
+	int64_t *counts = NULL;
+	/* Deltas cached by each task, num_split each. */
+	int64_t *deltas = NULL;
+	uint64_t *pointers = NULL, *sums = NULL, *cpus = NULL;
+	size_t *owners = NULL, num_cpus;
+
+	err = drgn_program_find_type(prog, "struct task_struct", NULL,
+				     &task_type);
+	if (err)
+		return err;
+	err = task_snapshot_member(prog, task_type.type, "mm", 8,
+				   &task_members[0]);
+	if (err)
+		return err;
+	err = task_snapshot_rss_members(prog, rss_members, indices,
+					&num_counters);
+	if (err)
+		return err;
+	per_cpu_members = &mm_members[num_counters];
+	err = task_rss_per_cpu_members(prog, indices, num_counters,
+				       per_cpu_members, &num_per_cpu,
+				       &per_cpu_size);
+	if (err)
+		return err;
+	split_members = &task_members[1];
+	err = task_rss_split_members(prog, task_type.type, indices,
+				     num_counters, split_members, &num_split);
+	if (err)
+		return err;
+	task_snapshot_plan_init(&task_plan, task_members, 1 + num_split);
+	task_snapshot_plan_init(&mm_plan, mm_members,
+				num_counters + num_per_cpu);
+
+	err = task_snapshot_tasks(ns, &tasks);
+	if (err)
+		goto out;
+	entries = malloc_array(max(tasks.size, (size_t)1), sizeof(*entries));
+	mm_indices = malloc_array(max(tasks.size, (size_t)1),
+				  sizeof(*mm_indices));
+	buf = malloc_array(TASK_SNAPSHOT_BATCH_SIZE,
+			   max(max(task_plan.window, mm_plan.window),
+			       (uint64_t)1));
+	requests = malloc_array(TASK_SNAPSHOT_BATCH_SIZE,
+				TASK_SNAPSHOT_MAX_RANGES * sizeof(*requests));
+	deltas = malloc_array(max(tasks.size * num_split, (size_t)1),
+			      sizeof(*deltas));
+	if (!entries || !mm_indices || !deltas || !buf || !requests) {
+		err = &drgn_enomem;
+		goto out;
+	}
+
+	/*
+	 * Read the mm and cached deltas of each task and find the distinct
+	 * mms.
+	 */
+	for (start = 0; start < tasks.size; start += TASK_SNAPSHOT_BATCH_SIZE) {
+		size_t n = min(tasks.size - start,
+			       (size_t)TASK_SNAPSHOT_BATCH_SIZE);
+
+		err = task_snapshot_plan_read(prog, &task_plan,
+					      &tasks.data[start], n, buf,
+					      requests);
+		if (err)
+			goto out;
+		for (i = 0; i < n; i++) {
+			const char *task_buf = buf + i * task_plan.window;
+			struct linux_helper_task_rss *entry =
+				&entries[start + i];
+			struct task_rss_mm_map_entry map_entry;
+			struct task_rss_mm_map_iterator it;
+			int r;
+
+			entry->task = tasks.data[start + i];
+			entry->mm = task_snapshot_value(task_buf, &task_plan,
+							&task_members[0],
+							little_endian);
+			for (j = 0; j < num_split; j++) {
+				uint64_t value;
+
+				value = task_snapshot_value(task_buf,
+							    &task_plan,
+							    &split_members[j],
+							    little_endian);
+				deltas[(start + i) * num_split + j] =
+					sign_extend(value,
+						    split_members[j].size * 8);
+			}
+			mm_indices[start + i] = SIZE_MAX;
+			if (!entry->mm)
+				continue;
+			map_entry.key = entry->mm;
+			map_entry.value = mms.size;
+			r = task_rss_mm_map_insert(&mm_map, &map_entry, &it);
+			if (r < 0 ||
+			    (r && !task_address_vector_append(&mms,
+							      &entry->mm))) {
+				err = &drgn_enomem;
+				goto out;
+			}
+			mm_indices[start + i] = it.entry->value;
+		}
+	}
+
+	counts = calloc(max(mms.size * num_counters, (size_t)1),
+			sizeof(*counts));
+	pointers = malloc_array(max(mms.size * num_per_cpu, (size_t)1),
+				sizeof(*pointers));
+	if (!counts || !pointers) {
+		err = &drgn_enomem;
+		goto out;
+	}
+
+	/* Read the counters of each distinct mm. */
+	for (start = 0; start < mms.size; start += TASK_SNAPSHOT_BATCH_SIZE) {
+		size_t n = min(mms.size - start,
+			       (size_t)TASK_SNAPSHOT_BATCH_SIZE);
+
+		err = task_snapshot_plan_read(prog, &mm_plan,
+					      &mms.data[start], n, buf,
+					      requests);
+		if (err)
+			goto out;
+		for (i = 0; i < n; i++) {
+			const char *mm_buf = buf + i * mm_plan.window;
+
+			for (j = 0; j < num_counters; j++) {
+				uint64_t value;
+
+				value = task_snapshot_value(mm_buf, &mm_plan,
+							    &rss_members[j],
+							    little_endian);
+				counts[(start + i) * num_counters + j] =
+					sign_extend(value,
+						    rss_members[j].size * 8);
+			}
+			for (j = 0; j < num_per_cpu; j++) {
+				pointers[(start + i) * num_per_cpu + j] =
+					task_snapshot_value(mm_buf, &mm_plan,
+							    &per_cpu_members[j],
+							    little_endian);
+			}
+		}
+	}
+
+	/*
+	 * Add the per-CPU deltas of every counter, reading them all in one
+	 * batched pass. Counters without per-CPU memory are skipped.
+	 */
+	if (num_per_cpu && mms.size) {
+		size_t num_pointers = 0;
+
+		sums = malloc_array(mms.size * num_per_cpu, sizeof(*sums));
+		owners = malloc_array(mms.size * num_per_cpu, sizeof(*owners));
+		if (!sums || !owners) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		for (i = 0; i < mms.size * num_per_cpu; i++) {
+			if (pointers[i]) {
+				owners[num_pointers] = i;
+				pointers[num_pointers++] = pointers[i];
+			}
+		}
+		err = linux_helper_cpumask_cpus(prog, NULL, &cpus, &num_cpus);
+		if (err)
+			goto out;
+		err = per_cpu_sums(prog, cpus, num_cpus, pointers,
+				   num_pointers, per_cpu_size, true, sums);
+		if (err)
+			goto out;
+		for (i = 0; i < num_pointers; i++)
+			counts[owners[i]] += (int64_t)sums[i];
+	}
+
+	/* Add the deltas cached by each thread. */
+	for (i = 0; i < tasks.size; i++) {
+		if (mm_indices[i] == SIZE_MAX)
+			continue;
+		for (j = 0; j < num_split; j++) {
+			counts[mm_indices[i] * num_counters + j] +=
+				deltas[i * num_split + j];
+		}
+	}
+
+	for (i = 0; i < tasks.size; i++) {
+		struct linux_helper_task_rss *entry = &entries[i];
+		uint64_t values[3] = {};
+
+		if (mm_indices[i] != SIZE_MAX) {
+			for (j = 0; j < num_counters; j++) {
+				int64_t count =
+					counts[mm_indices[i] * num_counters +
+					       j];
+
+				/* Counters may be transiently negative. */
+				values[j] = count > 0 ? count : 0;
+			}
+		}
+		entry->file = values[0];
+		entry->anon = values[1];
+		entry->shmem = values[2];
+	}
+	*ret = entries;
+	*num_ret = tasks.size;
+	entries = NULL;
+	err = NULL;
+out:
+	free(cpus);
+	free(owners);
+	free(sums);
+	free(pointers);
+	free(counts);
+	free(requests);
+	free(buf);
+	free(deltas);
+	free(mm_indices);
+	free(entries);
+	task_rss_mm_map_deinit(&mm_map);
+	task_address_vector_deinit(&mms);
+	task_address_vector_deinit(&tasks);
+	return err;
+}
+
+static bool task_id_in_ranges(uint64_t id,
+			      const struct linux_helper_task_id_range *ranges,
+			      size_t num_ranges)
+{
+	size_t i;
+
+	for (i = 0; i < num_ranges; i++) {
+		if (ranges[i].first <= id && id <= ranges[i].last)
+			return true;
+	}
+	return false;
+}
+
+/* Whether task t of a snapshot matches a filter. */
+static bool task_filter_match(const struct linux_helper_task_filter *filter,
+			      const struct linux_helper_task_snapshot *snapshot,
+			      size_t t, char *comm)
+{
+	uint64_t * const *values = snapshot->values;
+
+	if (filter->states &&
+	    !strchr(filter->states,
+		    (char)values[LINUX_HELPER_TASK_STATE][t]))
+		return false;
+	if (filter->num_pids &&
+	    !task_id_in_ranges(values[LINUX_HELPER_TASK_PID][t], filter->pids,
+			       filter->num_pids))
+		return false;
+	if (filter->num_tgids &&
+	    !task_id_in_ranges(values[LINUX_HELPER_TASK_TGID][t],
+			       filter->tgids, filter->num_tgids))
+		return false;
+	if (filter->comm) {
+		/* Don't rely on task->comm being null-terminated. */
+		memcpy(comm, snapshot->comms + t * snapshot->comm_len,
+		       snapshot->comm_len);
+		comm[snapshot->comm_len] = '\0';
+		if (fnmatch(filter->comm, comm, 0) != 0)
+			return false;
+	}
+	return true;
+}
+
+struct drgn_error *
+linux_helper_filter_tasks(const struct drgn_object *ns,
+			  const struct linux_helper_task_filter *filter,
+			  uint64_t **tasks_ret, size_t *num_ret)
+{
+	struct drgn_error *err;
+	struct linux_helper_task_snapshot snapshot;
+	uint64_t fields = UINT64_C(1) << LINUX_HELPER_TASK_ADDRESS;
+	uint64_t *tasks;
+	char *comm = NULL;
+	size_t num_tasks = 0, t;
+
+	if (filter->states)
+		fields |= UINT64_C(1) << LINUX_HELPER_TASK_STATE;
+	if (filter->comm)
+		fields |= UINT64_C(1) << LINUX_HELPER_TASK_COMM;
+	if (filter->num_pids)
+		fields |= UINT64_C(1) << LINUX_HELPER_TASK_PID;
+	if (filter->num_tgids)
+		fields |= UINT64_C(1) << LINUX_HELPER_TASK_TGID;
+	err = linux_helper_task_snapshot(&snapshot, ns, fields);
+	if (err)
+		return err;
+	if (filter->comm) {
+		comm = malloc(snapshot.comm_len + 1);
+		if (!comm) {
+			err = &drgn_enomem;
+			goto out;
+		}
+	}
+	/* Compact the matching tasks into the address column in place. */
+	tasks = snapshot.values[LINUX_HELPER_TASK_ADDRESS];
+	for (t = 0; t < snapshot.num_tasks; t++) {
+		if (task_filter_match(filter, &snapshot, t, comm))
+			tasks[num_tasks++] = tasks[t];
+	}
+	snapshot.values[LINUX_HELPER_TASK_ADDRESS] = NULL;
+	*tasks_ret = tasks;
+	*num_ret = num_tasks;
+	err = NULL;
+out:
+	free(comm);
+	linux_helper_task_snapshot_deinit(&snapshot);
+	return err;
+}
+
+/* Members of struct mm_struct read by linux_helper_task_args(). */
+enum task_args_member_index {
+	TASK_ARGS_PGD,
+	TASK_ARGS_ARG_START,
+	TASK_ARGS_ARG_END,
+	TASK_ARGS_ENV_START,
+	TASK_ARGS_ENV_END,
+	TASK_ARGS_NUM_MEMBERS,
+};
+
+static const char * const task_args_member_names[TASK_ARGS_NUM_MEMBERS] = {
+	[TASK_ARGS_PGD] = "pgd",
+	[TASK_ARGS_ARG_START] = "arg_start",
+	[TASK_ARGS_ARG_END] = "arg_end",
+	[TASK_ARGS_ENV_START] = "env_start",
+	[TASK_ARGS_ENV_END] = "env_end",
+};
+
+/*
+ * Ranges larger than this are assumed to come from a corrupted mm and are not
+ * read.
+ */
+static const uint64_t TASK_ARGS_MAX_SIZE = UINT64_C(1) << 30;
+
+/* Map from an mm to the index of the first task using it. */
+DEFINE_HASH_MAP(task_args_mm_map, uint64_t, size_t, hash_pair_int_type,
+		hash_table_scalar_eq)
+
+/*
+ * Read [start, end) of an address space and append it to data. If it can't be
+ * read, *size_ret is set to LINUX_HELPER_TASK_ARGS_UNAVAILABLE instead.
+ */
+static struct drgn_error *task_args_read(struct drgn_program *prog,
+					 struct linux_helper_vm_translation *t,
+					 uint64_t start, uint64_t end,
+					 struct string_builder *data,
+					 size_t *offset_ret, size_t *size_ret)
+{
+	struct drgn_error *err;
+	size_t size;
+
+	*offset_ret = data->len;
+	*size_ret = LINUX_HELPER_TASK_ARGS_UNAVAILABLE;
+	if (end < start || end - start > TASK_ARGS_MAX_SIZE)
+		return NULL;
+	size = end - start;
+	if (!string_builder_reserve(data, data->len + size))
+		return &drgn_enomem;
+	err = linux_helper_vm_translation_read(prog, t, start,
+					       data->str + data->len, size);
+	if (err) {
+		if (err->code == DRGN_ERROR_FAULT) {
+			drgn_error_destroy(err);
+			return NULL;
+		}
+		return err;
+	}
+	data->len += size;
+	*size_ret = size;
+	return NULL;
+}
+
+/* Read the requested ranges of one mm from its members read into buf. */
+static struct drgn_error *
+task_args_read_mm(struct drgn_program *prog,
+		  struct linux_helper_task_args_entry *entry, const char *buf,
+		  const struct task_snapshot_plan *plan,
+		  const struct task_snapshot_range *members, bool read_cmdline,
+		  bool read_environ, struct string_builder *data)
+{
+	bool little_endian = drgn_program_is_little_endian(prog);
+	struct drgn_error *err;
+	struct linux_helper_vm_translation t;
+	uint64_t values[TASK_ARGS_NUM_MEMBERS];
+	uint64_t first = UINT64_MAX, last = 0;
+	size_t i;
+
+	for (i = 0; i < TASK_ARGS_NUM_MEMBERS; i++) {
+		values[i] = task_snapshot_value(buf, plan, &members[i],
+						little_endian);
+	}
+	/*
+	 * The environment is right after the command line at the top of the
+	 * stack, so translate everything that's needed in one walk.
+	 */
+	if (read_cmdline &&
+	    values[TASK_ARGS_ARG_START] <= values[TASK_ARGS_ARG_END]) {
+		first = min(first, values[TASK_ARGS_ARG_START]);
+		last = max(last, values[TASK_ARGS_ARG_END]);
+	}
+	if (read_environ &&
+	    values[TASK_ARGS_ENV_START] <= values[TASK_ARGS_ENV_END]) {
+		first = min(first, values[TASK_ARGS_ENV_START]);
+		last = max(last, values[TASK_ARGS_ENV_END]);
+	}
+
+	linux_helper_vm_translation_init(&t, values[TASK_ARGS_PGD]);
+	if (first < last && last - first <= 2 * TASK_ARGS_MAX_SIZE) {
+		err = linux_helper_vm_translation_fill(prog, &t, first,
+						       last - first);
+		if (err && err->code == DRGN_ERROR_FAULT) {
+			/* The reads below will mark it unavailable. */
+			drgn_error_destroy(err);
+			err = NULL;
+		}
+		if (err)
+			goto out;
+	}
+	if (read_cmdline) {
+		err = task_args_read(prog, &t, values[TASK_ARGS_ARG_START],
+				     values[TASK_ARGS_ARG_END], data,
+				     &entry->cmdline_offset,
+				     &entry->cmdline_size);
+		if (err)
+			goto out;
+	}
+	if (read_environ) {
+		err = task_args_read(prog, &t, values[TASK_ARGS_ENV_START],
+				     values[TASK_ARGS_ENV_END], data,
+				     &entry->environ_offset,
+				     &entry->environ_size);
+		if (err)
+			goto out;
+	}
+	err = NULL;
+out:
+	linux_helper_vm_translation_deinit(&t);
+	return err;
+}
+
+struct drgn_error *linux_helper_task_args(struct linux_helper_task_args *ret,
+					  const struct drgn_object *ns,
+					  const uint64_t *tasks,
+					  size_t num_tasks, bool read_cmdline,
+					  bool read_environ)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = ns->prog;
+	bool little_endian = drgn_program_is_little_endian(prog);
+	struct task_snapshot_range task_mm;
+	struct task_snapshot_range members[TASK_ARGS_NUM_MEMBERS];
+	struct task_snapshot_plan task_plan, mm_plan;
+	struct task_address_vector all_tasks = VECTOR_INIT;
+	struct task_args_mm_map mm_map;
+	struct string_builder data = {};
+	struct drgn_memory_read_request *requests = NULL;
+	char *mm_buf = NULL;
+	char task_buf[TASK_SNAPSHOT_BATCH_SIZE * 8];
+	uint64_t mms[TASK_SNAPSHOT_BATCH_SIZE];
+	uint64_t new_mms[TASK_SNAPSHOT_BATCH_SIZE];
+	size_t first_tasks[TASK_SNAPSHOT_BATCH_SIZE];
+	struct drgn_qualified_type task_type, mm_type;
+	size_t i, start;
+
+	memset(ret, 0, sizeof(*ret));
+	task_args_mm_map_init(&mm_map);
+
+	err = check_vm_translation(prog);
+	if (err)
+		goto out;
+	err = drgn_program_find_type(prog, "struct task_struct", NULL,
+				     &task_type);
+	if (err)
+		goto out;
+	err = drgn_program_find_type(prog, "struct mm_struct", NULL, &mm_type);
+	if (err)
+		goto out;
+	err = task_snapshot_member(prog, task_type.type, "mm", 8, &task_mm);
+	if (err)
+		goto out;
+	for (i = 0; i < TASK_ARGS_NUM_MEMBERS; i++) {
+		err = task_snapshot_member(prog, mm_type.type,
+					   task_args_member_names[i], 8,
+					   &members[i]);
+		if (err)
+			goto out;
+	}
+	task_snapshot_plan_init(&task_plan, &task_mm, 1);
+	task_snapshot_plan_init(&mm_plan, members, TASK_ARGS_NUM_MEMBERS);
+
+	if (!tasks) {
+		err = task_snapshot_tasks(ns, &all_tasks);
+		if (err)
+			goto out;
+		tasks = all_tasks.data;
+		num_tasks = all_tasks.size;
+	}
+	ret->entries = malloc_array(max(num_tasks, (size_t)1),
+				    sizeof(ret->entries[0]));
+	mm_buf = malloc_array(TASK_SNAPSHOT_BATCH_SIZE, mm_plan.window);
+	requests = malloc_array(TASK_SNAPSHOT_BATCH_SIZE,
+				TASK_SNAPSHOT_NUM_MEMBERS * sizeof(*requests));
+	if (!ret->entries || !mm_buf || !requests) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	ret->num_entries = num_tasks;
+
+	for (start = 0; start < num_tasks; start += TASK_SNAPSHOT_BATCH_SIZE) {
+		size_t n = min(num_tasks - start,
+			       (size_t)TASK_SNAPSHOT_BATCH_SIZE);
+		size_t num_new_mms = 0;
+
+		/* Read the mm of each task in the batch. */
+		err = task_snapshot_plan_read(prog, &task_plan, &tasks[start],
+					      n, task_buf, requests);
+		if (err)
+			goto err;
+		for (i = 0; i < n; i++) {
+			struct linux_helper_task_args_entry *entry;
+			struct task_args_mm_map_entry map_entry;
+			struct task_args_mm_map_iterator it;
+			int r;
+
+			entry = &ret->entries[start + i];
+			entry->task = tasks[start + i];
+			entry->cmdline_offset = entry->environ_offset = 0;
+			entry->cmdline_size = entry->environ_size =
+				LINUX_HELPER_TASK_ARGS_UNAVAILABLE;
+			if (!entry->task) {
+				mms[i] = 0;
+				continue;
+			}
+			mms[i] = task_snapshot_value(task_buf +
+						     i * task_plan.window,
+						     &task_plan, &task_mm,
+						     little_endian);
+			if (!mms[i])
+				continue;
+
+			/* Threads share an mm, so only read it once. */
+			map_entry.key = mms[i];
+			map_entry.value = start + i;
+			r = task_args_mm_map_insert(&mm_map, &map_entry, &it);
+			if (r < 0) {
+				err = &drgn_enomem;
+				goto err;
+			}
+			first_tasks[i] = it.entry->value;
+			if (r)
+				new_mms[num_new_mms++] = mms[i];
+		}
+
+		/* Read the members of the new mms, then their memory. */
+		err = task_snapshot_plan_read(prog, &mm_plan, new_mms,
+					      num_new_mms, mm_buf, requests);
+		if (err)
+			goto err;
+		num_new_mms = 0;
+		for (i = 0; i < n; i++) {
+			if (!mms[i] || first_tasks[i] != start + i)
+				continue;
+			err = task_args_read_mm(prog, &ret->entries[start + i],
+						mm_buf +
+						num_new_mms++ * mm_plan.window,
+						&mm_plan, members,
+						read_cmdline, read_environ,
+						&data);
+			if (err)
+				goto err;
+		}
+		for (i = 0; i < n; i++) {
+			struct linux_helper_task_args_entry *entry;
+
+			if (!mms[i] || first_tasks[i] == start + i)
+				continue;
+			entry = &ret->entries[start + i];
+			*entry = ret->entries[first_tasks[i]];
+			entry->task = tasks[start + i];
+		}
+	}
+	ret->data = data.str;
+	data.str = NULL;
+	err = NULL;
+	goto out;
+
+err:
+	linux_helper_task_args_deinit(ret);
+out:
+	free(data.str);
+	free(requests);
+	free(mm_buf);
+	task_args_mm_map_deinit(&mm_map);
+	task_address_vector_deinit(&all_tasks);
+	return err;
+}
+
+void linux_helper_task_args_deinit(struct linux_helper_task_args *args)
+{
+	free(args->entries);
+	free(args->data);
+}
+
+/* Ring buffer event types (see include/linux/ring_buffer.h). */
+enum {
+	RINGBUF_TYPE_DATA_TYPE_LEN_MAX = 28,
+	RINGBUF_TYPE_PADDING,
+	RINGBUF_TYPE_TIME_EXTEND,
+	RINGBUF_TYPE_TIME_STAMP,
+};
+
+/* Flags stored in the high bits of buffer_data_page::commit. */
+static const uint64_t RB_MISSED_FLAGS = (UINT64_C(1) << 31) |
+					(UINT64_C(1) << 30);
+/* Top bits of a full timestamp which don't fit in a TIME_STAMP event. */
+static const uint64_t RB_TS_MSB = UINT64_C(0xf8) << 56;
+/* Sanity limit on the number of pages in one CPU's buffer. */
+static const uint64_t FTRACE_MAX_PAGES = UINT64_C(1) << 24;
+
+/* Layout of the ring buffer structures, from the kernel's debug info. */
+struct ftrace_layout {
+	uint64_t cpu_buffer_reader_page;
+	uint64_t cpu_buffer_head_page;
+	uint64_t cpu_buffer_commit_page;
+	/* struct buffer_page. */
+	uint64_t bpage_size;
+	uint64_t bpage_next;
+	uint64_t bpage_read, bpage_read_size;
+	uint64_t bpage_page;
+	/* struct buffer_data_page. */
+	uint64_t time_stamp;
+	uint64_t commit, commit_size;
+	uint64_t data;
+	/* Size of the event data in each buffer_data_page. */
+	uint64_t data_size;
+};
+
+struct ftrace_page {
+	uint64_t cpu;
+	/* Address of the struct buffer_data_page. */
+	uint64_t address;
+	/* Offset of the first event which hasn't been consumed. */
+	uint64_t read;
+};
+
+DEFINE_VECTOR(ftrace_page_vector, struct ftrace_page)
+DEFINE_VECTOR(ftrace_event_vector, struct linux_helper_ftrace_event)
+
+static struct drgn_error *ftrace_member(struct drgn_program *prog,
+					const char *type_name,
+					const char *member_designator,
+					uint64_t *offset_ret,
+					uint64_t *size_ret)
+{
+	struct drgn_error *err;
+	struct drgn_qualified_type qualified_type;
+	struct drgn_member_info member;
+	uint64_t size;
+
+	err = drgn_program_find_type(prog, type_name, NULL, &qualified_type);
+	if (err)
+		return err;
+	err = drgn_program_member_path(prog, qualified_type.type,
+				       member_designator, &member);
+	if (err)
+		return err;
+	if (member.bit_offset % 8 || member.bit_field_size) {
+		return drgn_error_format(DRGN_ERROR_TYPE,
+					 "%s member %s is not byte-aligned",
+					 type_name, member_designator);
+	}
+	*offset_ret = member.bit_offset / 8;
+	if (size_ret) {
+		err = drgn_type_sizeof(member.qualified_type.type, &size);
+		if (err)
+			return err;
+		if (size == 0 || size > 8) {
+			return drgn_error_format(DRGN_ERROR_TYPE,
+						 "%s member %s is not an integer",
+						 type_name,
+						 member_designator);
+		}
+		*size_ret = size;
+	}
+	return NULL;
+}
+
+static struct drgn_error *ftrace_layout_init(struct drgn_program *prog,
+					     const struct drgn_object *buffer,
+					     struct ftrace_layout *layout)
+{
+	struct drgn_error *err;
+	struct drgn_qualified_type qualified_type;
+	struct drgn_object tmp;
+	uint64_t subbuf_size;
+
+	if ((err = ftrace_member(prog, "struct ring_buffer_per_cpu",
+				 "reader_page", &layout->cpu_buffer_reader_page,
+				 NULL)) ||
+	    (err = ftrace_member(prog, "struct ring_buffer_per_cpu",
+				 "head_page", &layout->cpu_buffer_head_page,
+				 NULL)) ||
+	    (err = ftrace_member(prog, "struct ring_buffer_per_cpu",
+				 "commit_page", &layout->cpu_buffer_commit_page,
+				 NULL)) ||
+	    (err = ftrace_member(prog, "struct buffer_page", "list.next",
+				 &layout->bpage_next, NULL)) ||
+	    (err = ftrace_member(prog, "struct buffer_page", "read",
+				 &layout->bpage_read,
+				 &layout->bpage_read_size)) ||
+	    (err = ftrace_member(prog, "struct buffer_page", "page",
+				 &layout->bpage_page, NULL)) ||
+	    (err = ftrace_member(prog, "struct buffer_data_page",
+				 "time_stamp", &layout->time_stamp, NULL)) ||
+	    (err = ftrace_member(prog, "struct buffer_data_page", "commit",
+				 &layout->commit, &layout->commit_size)) ||
+	    (err = ftrace_member(prog, "struct buffer_data_page", "data",
+				 &layout->data, NULL)))
+		return err;
+	err = drgn_program_find_type(prog, "struct buffer_page", NULL,
+				     &qualified_type);
+	if (err)
+		return err;
+	err = drgn_type_sizeof(qualified_type.type, &layout->bpage_size);
+	if (err)
+		return err;
+
+	/*
+	 * Since Linux kernel commit 139f84002145 ("ring-buffer: Add interface
+	 * for configuring trace sub buffer size") (in v6.8), the buffer pages
+	 * may be larger than a page.
+	 */
+	drgn_object_init(&tmp, prog);
+	err = drgn_object_member_dereference(&tmp, buffer, "subbuf_size");
+	if (!err) {
+		err = drgn_object_read_unsigned(&tmp, &subbuf_size);
+		if (!err)
+			layout->data_size = subbuf_size;
+	} else if (err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		err = NULL;
+		if (prog->vmcoreinfo.page_size <= layout->data) {
+			err = drgn_error_create(DRGN_ERROR_OTHER,
+						"page size is not known");
+		} else {
+			layout->data_size = (prog->vmcoreinfo.page_size -
+					     layout->data);
+		}
+	}
+	drgn_object_deinit(&tmp);
+	if (!err && (layout->data_size < 8 ||
+		     layout->data_size > UINT64_C(1) << 30)) {
+		err = drgn_error_create(DRGN_ERROR_OTHER,
+					"invalid ring buffer page size");
+	}
+	return err;
+}
+
+/*
+ * Append the pages of one CPU's buffer which may contain unconsumed events, in
+ * order: the reader page and then the ring from the head page to the commit
+ * page.
+ */
+static struct drgn_error *ftrace_cpu_pages(struct drgn_program *prog,
+					   const struct ftrace_layout *layout,
+					   uint64_t cpu, uint64_t cpu_buffer,
+					   struct ftrace_page_vector *pages)
+{
+	bool little_endian = drgn_program_is_little_endian(prog);
+	/* The low bits of the list pointers are flags. */
+	uint64_t mask = ~UINT64_C(3);
+	struct drgn_error *err;
+	uint64_t reader_page, head_page, commit_page, bpage, n;
+	char *buf;
+
+	if ((err = drgn_program_read_word(prog,
+					  cpu_buffer +
+					  layout->cpu_buffer_reader_page,
+					  false, &reader_page)) ||
+	    (err = drgn_program_read_word(prog,
+					  cpu_buffer +
+					  layout->cpu_buffer_head_page,
+					  false, &head_page)) ||
+	    (err = drgn_program_read_word(prog,
+					  cpu_buffer +
+					  layout->cpu_buffer_commit_page,
+					  false, &commit_page)))
+		return err;
+
+	buf = malloc(layout->bpage_size);
+	if (!buf)
+		return &drgn_enomem;
+	bpage = reader_page;
+	for (n = 0; n < FTRACE_MAX_PAGES; n++) {
+		struct ftrace_page *page;
+
+		err = drgn_program_read_memory(prog, buf, bpage,
+					       layout->bpage_size, false);
+		if (err)
+			goto out;
+		page = ftrace_page_vector_append_entry(pages);
+		if (!page) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		page->cpu = cpu;
+		page->address = deserialize_bits(buf + layout->bpage_page, 0,
+						 drgn_program_is_64_bit(prog) ?
+						 64 : 32, little_endian);
+		/* Only the reader page has been partially consumed. */
+		page->read = n ? 0 :
+			     deserialize_bits(buf + layout->bpage_read, 0,
+					      8 * layout->bpage_read_size,
+					      little_endian);
+
+		if (bpage == commit_page)
+			break;
+		if (n == 0) {
+			bpage = head_page & mask;
+		} else {
+			bpage = deserialize_bits(buf + layout->bpage_next, 0,
+						 drgn_program_is_64_bit(prog) ?
+						 64 : 32, little_endian) & mask;
+			if (bpage == (head_page & mask))
+				break;
+		}
+	}
+	err = NULL;
+out:
+	free(buf);
+	return err;
+}
+
+/* Read the buffer_data_pages into data, dropping pages that can't be read. */
+static struct drgn_error *ftrace_read_pages(struct drgn_program *prog,
+					    struct ftrace_page_vector *pages,
+					    uint64_t page_size, char *data,
+					    size_t *lost_ret)
+{
+	struct drgn_error *err;
+	struct drgn_memory_read_request *requests;
+	size_t i, j;
+
+	requests = malloc_array(max(pages->size, (size_t)1),
+				sizeof(*requests));
+	if (!requests)
+		return &drgn_enomem;
+	for (i = 0; i < pages->size; i++) {
+		requests[i].buf = data + i * page_size;
+		requests[i].address = pages->data[i].address;
+		requests[i].count = page_size;
+		requests[i].physical = false;
+	}
+	err = drgn_program_read_memory_batch(prog, requests, pages->size);
+	free(requests);
+	*lost_ret = 0;
+	if (!err || err->code != DRGN_ERROR_FAULT)
+		return err;
+	drgn_error_destroy(err);
+
+	/* Fall back to reading the pages one by one. */
+	for (i = j = 0; i < pages->size; i++) {
+		err = drgn_program_read_memory(prog, data + j * page_size,
+					       pages->data[i].address,
+					       page_size, false);
+		if (!err) {
+			pages->data[j++] = pages->data[i];
+		} else if (err->code == DRGN_ERROR_FAULT) {
+			drgn_error_destroy(err);
+			(*lost_ret)++;
+		} else {
+			return err;
+		}
+	}
+	pages->size = j;
+	return NULL;
+}
+
+/* Add the correct top bits to the truncated timestamp of a TIME_STAMP event. */
+static uint64_t ftrace_fix_abs_ts(uint64_t abs, uint64_t ts)
+{
+	if (ts & RB_TS_MSB) {
+		abs |= ts & RB_TS_MSB;
+		if (abs < ts)
+			abs += UINT64_C(1) << 59;
+	}
+	return abs;
+}
+
+static struct drgn_error *ftrace_decode_page(const struct ftrace_layout *layout,
+					     bool little_endian,
+					     const struct ftrace_page *page,
+					     const char *buf, size_t buf_offset,
+					     struct ftrace_event_vector *events)
+{
+	uint64_t ts, commit, pos = 0;
+	const char *p = buf + layout->data;
+
+	ts = deserialize_bits(buf + layout->time_stamp, 0, 64, little_endian);
+	commit = deserialize_bits(buf + layout->commit, 0,
+				  8 * layout->commit_size, little_endian);
+	commit = min(commit & ~RB_MISSED_FLAGS, layout->data_size);
+	while (commit - pos >= 4) {
+		uint32_t header, type_len, time_delta, array0 = 0;
+		uint64_t length, payload = 0, size;
+
+		header = deserialize_bits(p + pos, 0, 32, little_endian);
+		/* type_len:5 is in the low bits on little-endian. */
+		if (little_endian) {
+			type_len = header & 0x1f;
+			time_delta = header >> 5;
+		} else {
+			type_len = header >> 27;
+			time_delta = header & 0x7ffffff;
+		}
+		if (type_len == RINGBUF_TYPE_PADDING && time_delta == 0) {
+			/* The rest of the page is empty. */
+			break;
+		}
+		if (type_len > RINGBUF_TYPE_DATA_TYPE_LEN_MAX ||
+		    type_len == 0) {
+			if (commit - pos < 8)
+				break;
+			array0 = deserialize_bits(p + pos + 4, 0, 32,
+						  little_endian);
+		}
+		switch (type_len) {
+		case RINGBUF_TYPE_PADDING:
+			/* A discarded event. */
+			length = (uint64_t)array0 + 4;
+			size = 0;
+			break;
+		case RINGBUF_TYPE_TIME_EXTEND:
+			ts += ((uint64_t)array0 << 27) + time_delta;
+			length = 8;
+			size = 0;
+			break;
+		case RINGBUF_TYPE_TIME_STAMP:
+			ts = ftrace_fix_abs_ts(((uint64_t)array0 << 27) |
+					       time_delta, ts);
+			length = 8;
+			size = 0;
+			break;
+		case 0:
+			if (array0 < 4)
+				return NULL;
+			ts += time_delta;
+			length = (uint64_t)array0 + 4;
+			payload = pos + 8;
+			size = array0 - 4;
+			break;
+		default:
+			ts += time_delta;
+			length = 4 * type_len + 4;
+			payload = pos + 4;
+			size = 4 * type_len;
+			break;
+		}
+		if (length > commit - pos)
+			break;
+		if (size && pos >= page->read) {
+			struct linux_helper_ftrace_event *event;
+
+			event = ftrace_event_vector_append_entry(events);
+			if (!event)
+				return &drgn_enomem;
+			event->timestamp = ts;
+			event->cpu = page->cpu;
+			event->offset = buf_offset + layout->data + payload;
+			event->size = size;
+		}
+		pos += length;
+	}
+	return NULL;
+}
+
+static int ftrace_event_cmp(const void *_a, const void *_b)
+{
+	const struct linux_helper_ftrace_event *a = _a, *b = _b;
+
+	if (a->timestamp != b->timestamp)
+		return a->timestamp < b->timestamp ? -1 : 1;
+	if (a->cpu != b->cpu)
+		return a->cpu < b->cpu ? -1 : 1;
+	if (a->offset != b->offset)
+		return a->offset < b->offset ? -1 : 1;
+	return 0;
+}
+
+struct drgn_error *
+linux_helper_ftrace_events(struct linux_helper_ftrace_events *ret,
+			   struct drgn_program *prog,
+			   const struct drgn_object *buffer)
+{
+	struct drgn_error *err;
+	struct drgn_object global_trace, array_buffer, buffer_obj, tmp;
+	struct ftrace_layout layout;
+	struct ftrace_page_vector pages = VECTOR_INIT;
+	struct ftrace_event_vector events = VECTOR_INIT;
+	uint64_t *cpu_buffers = NULL, num_cpus, page_size, i;
+	char *data = NULL;
+	size_t lost_pages;
+
+	drgn_object_init(&global_trace, prog);
+	drgn_object_init(&array_buffer, prog);
+	drgn_object_init(&buffer_obj, prog);
+	drgn_object_init(&tmp, prog);
+	if (!buffer) {
+		err = drgn_program_find_object(prog, "global_trace", NULL,
+					       DRGN_FIND_OBJECT_VARIABLE,
+					       &global_trace);
+		if (err)
+			goto out;
+		err = drgn_object_member(&array_buffer, &global_trace,
+					 "array_buffer");
+		if (err && err->code == DRGN_ERROR_LOOKUP) {
+			/*
+			 * Before Linux kernel commit 1c5eb4481e01
+			 * ("tracing: Rename trace_buffer to array_buffer") (in
+			 * v5.6), it was named trace_buffer.
+			 */
+			drgn_error_destroy(err);
+			err = drgn_object_member(&array_buffer, &global_trace,
+						 "trace_buffer");
+		}
+		if (err)
+			goto out;
+		err = drgn_object_member(&buffer_obj, &array_buffer, "buffer");
+		if (err)
+			goto out;
+		buffer = &buffer_obj;
+	}
+
+	err = ftrace_layout_init(prog, buffer, &layout);
+	if (err)
+		goto out;
+	page_size = layout.data + layout.data_size;
+
+	err = drgn_object_member_dereference(&tmp, buffer, "cpus");
+	if (err)
+		goto out;
+	err = drgn_object_read_unsigned(&tmp, &num_cpus);
+	if (err)
+		goto out;
+	err = drgn_object_member_dereference(&tmp, buffer, "buffers");
+	if (err)
+		goto out;
+	err = drgn_object_read_unsigned(&tmp, &i);
+	if (err)
+		goto out;
+	if (num_cpus > 65536) {
+		err = drgn_error_create(DRGN_ERROR_OTHER,
+					"invalid ring buffer CPU count");
+		goto out;
+	}
+	err = read_word_array(prog, i, num_cpus, &cpu_buffers);
+	if (err)
+		goto out;
+	for (i = 0; i < num_cpus; i++) {
+		/* Buffers are only allocated for possible CPUs. */
+		if (!cpu_buffers[i])
+			continue;
+		err = ftrace_cpu_pages(prog, &layout, i, cpu_buffers[i],
+				       &pages);
+		if (err)
+			goto out;
+	}
+
+	if (pages.size > SIZE_MAX / page_size) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	data = malloc(max(pages.size * page_size, (uint64_t)1));
+	if (!data) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	err = ftrace_read_pages(prog, &pages, page_size, data, &lost_pages);
+	if (err)
+		goto out;
+	for (i = 0; i < pages.size; i++) {
+		err = ftrace_decode_page(&layout,
+					 drgn_program_is_little_endian(prog),
+					 &pages.data[i], data + i * page_size,
+					 i * page_size, &events);
+		if (err)
+			goto out;
+	}
+	qsort(events.data, events.size, sizeof(*events.data),
+	      ftrace_event_cmp);
+
+	ftrace_event_vector_shrink_to_fit(&events);
+	ret->events = events.data;
+	ret->num_events = events.size;
+	ret->data = data;
+	ret->lost_pages = lost_pages;
+	data = NULL;
+	events.data = NULL;
+	err = NULL;
+out:
+	free(data);
+	ftrace_event_vector_deinit(&events);
+	ftrace_page_vector_deinit(&pages);
+	free(cpu_buffers);
+	drgn_object_deinit(&tmp);
+	drgn_object_deinit(&buffer_obj);
+	drgn_object_deinit(&array_buffer);
+	drgn_object_deinit(&global_trace);
+	return err;
+}
+
+void
+linux_helper_ftrace_events_deinit(struct linux_helper_ftrace_events *events)
+{
+	free(events->data);
+	free(events->events);
+}
+
+/* Address families of the Linux kernel. */
+static const uint16_t SOCK_AF_INET = 2;
+static const uint16_t SOCK_AF_INET6 = 10;
+/* Number of hash buckets to read at once. */
+static const uint64_t SOCK_TABLE_CHUNK = 65536;
+
+/* Offsets in struct sock of the members read by linux_helper_sock_table(). */
+struct sock_table_layout {
+	/* Size of struct sock_common, which is read for each socket. */
+	uint64_t sock_common_size;
+	/* skc_node and skc_nulls_node both have next at the same offset. */
+	uint64_t node;
+	uint64_t family, family_size;
+	uint64_t state;
+	uint64_t rcv_saddr, daddr;
+	/* UINT64_MAX if the kernel doesn't have IPv6. */
+	uint64_t v6_rcv_saddr, v6_daddr;
+	uint64_t dport, num, num_size;
+	/* UINT64_MAX if the kernel doesn't have socket cgroup data. */
+	uint64_t cgroup;
+	/* Whether cgroup is sock_cgroup_data::val, which may be tagged. */
+	bool cgroup_is_val;
+	/* States of sockets which aren't full sockets, or UINT64_MAX. */
+	uint64_t time_wait_state, new_syn_recv_state;
+};
+
+static struct drgn_error *sock_member(struct drgn_program *prog,
+				      struct drgn_type *sock_type,
+				      const char *member_designator,
+				      uint64_t *offset_ret, uint64_t *size_ret)
+{
+	struct drgn_error *err;
+	struct drgn_member_info member;
+
+	err = drgn_program_member_path(prog, sock_type, member_designator,
+				       &member);
+	if (err)
+		return err;
+	if (member.bit_offset % 8 || member.bit_field_size) {
+		return drgn_error_format(DRGN_ERROR_TYPE,
+					 "struct sock member %s is not byte-aligned",
+					 member_designator);
+	}
+	*offset_ret = member.bit_offset / 8;
+	if (size_ret) {
+		err = drgn_type_sizeof(member.qualified_type.type, size_ret);
+		if (err)
+			return err;
+		if (*size_ret == 0 || *size_ret > 8) {
+			return drgn_error_format(DRGN_ERROR_TYPE,
+						 "struct sock member %s is not an integer",
+						 member_designator);
+		}
+	}
+	return NULL;
+}
+
+/* Like sock_member(), but set *offset_ret to UINT64_MAX if it doesn't exist. */
+static struct drgn_error *sock_optional_member(struct drgn_program *prog,
+					       struct drgn_type *sock_type,
+					       const char *member_designator,
+					       uint64_t *offset_ret)
+{
+	struct drgn_error *err;
+
+	err = sock_member(prog, sock_type, member_designator, offset_ret,
+			  NULL);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		*offset_ret = UINT64_MAX;
+		err = NULL;
+	}
+	return err;
+}
+
+static struct drgn_error *sock_state_constant(struct drgn_program *prog,
+					      const char *name, uint64_t *ret)
+{
+	struct drgn_error *err;
+	struct drgn_object tmp;
+
+	drgn_object_init(&tmp, prog);
+	err = drgn_program_find_object(prog, name, NULL,
+				       DRGN_FIND_OBJECT_CONSTANT, &tmp);
+	if (!err) {
+		err = drgn_object_read_unsigned(&tmp, ret);
+	} else if (err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		*ret = UINT64_MAX;
+		err = NULL;
+	}
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+static struct drgn_error *
+sock_table_layout_init(struct drgn_program *prog, bool read_info,
+		       struct sock_table_layout *layout)
+{
+	struct drgn_error *err;
+	struct drgn_qualified_type sock_type, sock_common_type;
+	uint64_t size;
+
+	err = drgn_program_find_type(prog, "struct sock", NULL, &sock_type);
+	if (err)
+		return err;
+	err = sock_member(prog, sock_type.type, "__sk_common.skc_node",
+			  &layout->node, NULL);
+	if (err || !read_info)
+		return err;
+
+	err = drgn_program_find_type(prog, "struct sock_common", NULL,
+				     &sock_common_type);
+	if (err)
+		return err;
+	err = drgn_type_sizeof(sock_common_type.type,
+			       &layout->sock_common_size);
+	if (err)
+		return err;
+	if ((err = sock_member(prog, sock_type.type, "__sk_common.skc_family",
+			       &layout->family, &layout->family_size)) ||
+	    (err = sock_member(prog, sock_type.type, "__sk_common.skc_state",
+			       &layout->state, NULL)) ||
+	    (err = sock_member(prog, sock_type.type,
+			       "__sk_common.skc_rcv_saddr", &layout->rcv_saddr,
+			       NULL)) ||
+	    (err = sock_member(prog, sock_type.type, "__sk_common.skc_daddr",
+			       &layout->daddr, NULL)) ||
+	    (err = sock_member(prog, sock_type.type, "__sk_common.skc_dport",
+			       &layout->dport, NULL)) ||
+	    (err = sock_member(prog, sock_type.type, "__sk_common.skc_num",
+			       &layout->num, &layout->num_size)) ||
+	    (err = sock_optional_member(prog, sock_type.type,
+					"__sk_common.skc_v6_rcv_saddr",
+					&layout->v6_rcv_saddr)) ||
+	    (err = sock_optional_member(prog, sock_type.type,
+					"__sk_common.skc_v6_daddr",
+					&layout->v6_daddr)))
+		return err;
+
+	/*
+	 * Since Linux kernel commit 8520e224f547 ("bpf, cgroups: Fix
+	 * cgroup v2 fallback on v1/v2 mixed mode") (in v5.15),
+	 * sock_cgroup_data is always a cgroup pointer.
+	 */
+	err = sock_optional_member(prog, sock_type.type, "sk_cgrp_data.cgroup",
+				   &layout->cgroup);
+	if (!err && layout->cgroup == UINT64_MAX) {
+		err = sock_optional_member(prog, sock_type.type,
+					   "sk_cgrp_data.val", &layout->cgroup);
+		layout->cgroup_is_val = true;
+	}
+	if (err)
+		return err;
+
+	if ((err = sock_state_constant(prog, "TCP_TIME_WAIT",
+				       &layout->time_wait_state)) ||
+	    (err = sock_state_constant(prog, "TCP_NEW_SYN_RECV",
+				       &layout->new_syn_recv_state)))
+		return err;
+	/* Make sure that everything read from sock_common is in it. */
+	size = max(layout->family + layout->family_size,
+		   layout->num + layout->num_size);
+	size = max(size, layout->rcv_saddr + 4);
+	size = max(size, layout->daddr + 4);
+	size = max(size, layout->dport + 2);
+	size = max(size, layout->state + 1);
+	if (layout->v6_rcv_saddr != UINT64_MAX)
+		size = max(size, layout->v6_rcv_saddr + 16);
+	if (layout->v6_daddr != UINT64_MAX)
+		size = max(size, layout->v6_daddr + 16);
+	if (size > layout->sock_common_size ||
+	    layout->node + 8 > layout->sock_common_size) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "unexpected sock_common layout");
+	}
+	return NULL;
+}
+
+/* Decode a socket read into buf. */
+static struct drgn_error *
+sock_table_info(struct drgn_program *prog,
+		const struct sock_table_layout *layout, const char *buf,
+		struct linux_helper_sock *sock)
+{
+	bool little_endian = drgn_program_is_little_endian(prog);
+	struct drgn_error *err;
+	const uint8_t *dport;
+
+	sock->family = deserialize_bits(buf + layout->family, 0,
+					8 * layout->family_size,
+					little_endian);
+	sock->state = (uint8_t)buf[layout->state];
+	sock->sport = deserialize_bits(buf + layout->num, 0,
+				       8 * layout->num_size, little_endian);
+	dport = (const uint8_t *)buf + layout->dport;
+	sock->dport = (dport[0] << 8) | dport[1];
+	memset(sock->saddr, 0, sizeof(sock->saddr));
+	memset(sock->daddr, 0, sizeof(sock->daddr));
+	if (sock->family == SOCK_AF_INET6 &&
+	    layout->v6_rcv_saddr != UINT64_MAX &&
+	    layout->v6_daddr != UINT64_MAX) {
+		sock->addr_len = 16;
+		memcpy(sock->saddr, buf + layout->v6_rcv_saddr, 16);
+		memcpy(sock->daddr, buf + layout->v6_daddr, 16);
+	} else if (sock->family == SOCK_AF_INET) {
+		sock->addr_len = 4;
+		memcpy(sock->saddr, buf + layout->rcv_saddr, 4);
+		memcpy(sock->daddr, buf + layout->daddr, 4);
+	} else {
+		sock->addr_len = 0;
+	}
+
+	sock->cgroup = 0;
+	if (layout->cgroup != UINT64_MAX &&
+	    sock->state != layout->time_wait_state &&
+	    sock->state != layout->new_syn_recv_state) {
+		uint64_t cgroup;
+
+		err = drgn_program_read_word(prog,
+					     sock->sock + layout->cgroup, false,
+					     &cgroup);
+		if (err)
+			return err;
+		/* Before Linux 5.15, the low bit means it's not a pointer. */
+		if (!layout->cgroup_is_val || !(cgroup & 1))
+			sock->cgroup = cgroup;
+	}
+	return NULL;
+}
+
+DEFINE_VECTOR(linux_helper_sock_vector, struct linux_helper_sock)
+
+/* Walk the sockets in one bucket, given its first node. */
+static struct drgn_error *
+sock_table_walk_list(struct drgn_program *prog,
+		     const struct sock_table_layout *layout, bool read_info,
+		     uint64_t node, char *buf,
+		     struct linux_helper_sock_vector *socks)
+{
+	struct drgn_error *err;
+	struct linux_helper_sock *sock;
+
+	/* NULL ends a list, and an odd value ends a nulls list. */
+	while (node && !(node & 1)) {
+		sock = linux_helper_sock_vector_append_entry(socks);
+		if (!sock)
+			return &drgn_enomem;
+		sock->sock = node - layout->node;
+		if (!read_info) {
+			err = drgn_program_read_word(prog, node, false, &node);
+			if (err)
+				return err;
+			continue;
+		}
+		err = drgn_program_read_memory(prog, buf, sock->sock,
+					       layout->sock_common_size, false);
+		if (err)
+			return err;
+		err = sock_table_info(prog, layout, buf, sock);
+		if (err)
+			return err;
+		node = drgn_program_decode_word(prog, buf + layout->node);
+	}
+	return NULL;
+}
+
+/*
+ * Walk num_buckets hash buckets, each bucket_size bytes, starting at address.
+ * The (nulls) list head of each bucket is at head_offset.
+ */
+static struct drgn_error *
+sock_table_walk(struct drgn_program *prog,
+		const struct sock_table_layout *layout, bool read_info,
+		uint64_t address, uint64_t num_buckets, uint64_t bucket_size,
+		uint64_t head_offset, struct linux_helper_sock_vector *socks)
+{
+	uint64_t word_bits = drgn_program_is_64_bit(prog) ? 64 : 32;
+	struct drgn_error *err;
+	uint64_t chunk_size = min(num_buckets, SOCK_TABLE_CHUNK);
+	uint64_t i, j;
+	char *buckets, *buf = NULL;
+
+	if (!num_buckets)
+		return NULL;
+	if (bucket_size < head_offset + word_bits / 8) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "invalid socket hash bucket size");
+	}
+	buckets = malloc_array(chunk_size, bucket_size);
+	if (!buckets)
+		return &drgn_enomem;
+	if (read_info) {
+		buf = malloc(layout->sock_common_size);
+		if (!buf) {
+			err = &drgn_enomem;
+			goto out;
+		}
+	}
+	for (i = 0; i < num_buckets; i += chunk_size) {
+		uint64_t n = min(chunk_size, num_buckets - i);
+
+		err = drgn_program_read_memory(prog, buckets,
+					       address + i * bucket_size,
+					       n * bucket_size, false);
+		if (err)
+			goto out;
+		for (j = 0; j < n; j++) {
+			uint64_t node;
+
+			node = drgn_program_decode_word(prog,
+							buckets +
+							j * bucket_size +
+							head_offset);
+			err = sock_table_walk_list(prog, layout, read_info,
+						   node, buf, socks);
+			if (err)
+				goto out;
+		}
+	}
+	err = NULL;
+out:
+	free(buf);
+	free(buckets);
+	return err;
+}
+
+/*
+ * Walk a member of a hash table object which is a pointer to or array of
+ * buckets, given the member of each bucket containing the list head.
+ */
+static struct drgn_error *
+sock_table_walk_member(const struct sock_table_layout *layout, bool read_info,
+		       const struct drgn_object *table, const char *member_name,
+		       uint64_t num_buckets, const char *head_name,
+		       struct linux_helper_sock_vector *socks)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = table->prog;
+	struct drgn_object tmp;
+	struct drgn_type *type, *bucket_type;
+	struct drgn_member_info head;
+	uint64_t address, bucket_size;
+
+	drgn_object_init(&tmp, prog);
+	err = drgn_object_member(&tmp, table, member_name);
+	if (err)
+		goto out;
+	type = drgn_underlying_type(tmp.type);
+	if (drgn_type_kind(type) == DRGN_TYPE_ARRAY) {
+		if (!tmp.is_reference) {
+			err = drgn_error_format(DRGN_ERROR_TYPE,
+						"%s is not a reference",
+						member_name);
+			goto out;
+		}
+		num_buckets = drgn_type_length(type);
+		address = tmp.reference.address;
+	} else if (drgn_type_kind(type) == DRGN_TYPE_POINTER) {
+		err = drgn_object_read_unsigned(&tmp, &address);
+		if (err)
+			goto out;
+	} else {
+		err = drgn_error_format(DRGN_ERROR_TYPE,
+					"%s is not an array or pointer",
+					member_name);
+		goto out;
+	}
+	bucket_type = drgn_type_type(type).type;
+	err = drgn_type_sizeof(bucket_type, &bucket_size);
+	if (err)
+		goto out;
+	err = drgn_program_member_info(prog, bucket_type, head_name, &head);
+	if (err)
+		goto out;
+	err = sock_table_walk(prog, layout, read_info, address, num_buckets,
+			      bucket_size, head.bit_offset / 8, socks);
+out:
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+static struct drgn_error *sock_table_mask(const struct drgn_object *table,
+					  const char *member_name,
+					  uint64_t *ret)
+{
+	struct drgn_error *err;
+	struct drgn_object tmp;
+
+	drgn_object_init(&tmp, table->prog);
+	err = drgn_object_member(&tmp, table, member_name);
+	if (!err)
+		err = drgn_object_read_unsigned(&tmp, ret);
+	drgn_object_deinit(&tmp);
+	if (!err && *ret >= UINT64_C(1) << 32) {
+		err = drgn_error_format(DRGN_ERROR_OTHER, "invalid %s",
+					member_name);
+	}
+	return err;
+}
+
+struct drgn_error *
+linux_helper_sock_table(struct drgn_program *prog,
+			enum linux_helper_sock_table_kind kind, bool read_info,
+			struct linux_helper_sock **socks_ret, size_t *num_ret)
+{
+	struct drgn_error *err;
+	struct sock_table_layout layout;
+	struct linux_helper_sock_vector socks = VECTOR_INIT;
+	struct drgn_object table;
+	uint64_t mask;
+
+	err = sock_table_layout_init(prog, read_info, &layout);
+	if (err)
+		return err;
+
+	drgn_object_init(&table, prog);
+	err = drgn_program_find_object(prog,
+				       kind == LINUX_HELPER_SOCK_TABLE_TCP ?
+				       "tcp_hashinfo" : "udp_table",
+				       NULL, DRGN_FIND_OBJECT_VARIABLE, &table);
+	if (err)
+		goto out;
+	if (kind == LINUX_HELPER_SOCK_TABLE_UDP) {
+		err = sock_table_mask(&table, "mask", &mask);
+		if (err)
+			goto out;
+		err = sock_table_walk_member(&layout, read_info, &table, "hash",
+					     mask + 1, "head", &socks);
+		goto out;
+	}
+
+	err = sock_table_mask(&table, "ehash_mask", &mask);
+	if (err)
+		goto out;
+	err = sock_table_walk_member(&layout, read_info, &table, "ehash",
+				     mask + 1, "chain", &socks);
+	if (err)
+		goto out;
+	err = sock_table_walk_member(&layout, read_info, &table,
+				     "listening_hash", 0, "head", &socks);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		/*
+		 * Since Linux kernel commit cae3873c5b3a ("net: inet: Retire
+		 * port only listening_hash") (in v5.19), listening sockets are
+		 * only in lhash2.
+		 */
+		drgn_error_destroy(err);
+		err = sock_table_mask(&table, "lhash2_mask", &mask);
+		if (err)
+			goto out;
+		err = sock_table_walk_member(&layout, read_info, &table,
+					     "lhash2", mask + 1, "nulls_head",
+					     &socks);
+	}
+out:
+	drgn_object_deinit(&table);
+	if (err) {
+		linux_helper_sock_vector_deinit(&socks);
+		return err;
+	}
+	linux_helper_sock_vector_shrink_to_fit(&socks);
+	*socks_ret = socks.data;
+	*num_ret = socks.size;
+	return NULL;
+}
+
+/* Sanity limit on the number of inodes in one superblock. */
+static const uint64_t SB_INODES_MAX = UINT64_C(1) << 32;
+
+DEFINE_VECTOR(linux_helper_sb_inode_vector, struct linux_helper_sb_inode)
+
+/* Offsets in struct inode of the members read by linux_helper_sb_inodes(). */
+struct sb_inodes_layout {
+	/* Start and size of the window of struct inode that is read. */
+	uint64_t window_start, window_size;
+	uint64_t sb_list, ino, ino_size, mapping, i_data;
+	/* Offsets in struct address_space. */
+	uint64_t nrpages, nrpages_size, i_pages;
+	struct drgn_qualified_type i_pages_type;
+};
+
+static struct drgn_error *sb_inodes_member(struct drgn_program *prog,
+					   struct drgn_type *type,
+					   const char *member_designator,
+					   uint64_t *offset_ret,
+					   uint64_t *size_ret,
+					   struct drgn_qualified_type *type_ret)
+{
+	struct drgn_error *err;
+	struct drgn_member_info member;
+
+	err = drgn_program_member_path(prog, type, member_designator, &member);
+	if (err)
+		return err;
+	if (member.bit_offset % 8 || member.bit_field_size) {
+		return drgn_error_format(DRGN_ERROR_TYPE,
+					 "%s is not byte-aligned",
+					 member_designator);
+	}
+	*offset_ret = member.bit_offset / 8;
+	if (size_ret) {
+		err = drgn_type_sizeof(member.qualified_type.type, size_ret);
+		if (err)
+			return err;
+		if (*size_ret == 0 || *size_ret > 8) {
+			return drgn_error_format(DRGN_ERROR_TYPE,
+						 "%s is not an integer",
+						 member_designator);
+		}
+	}
+	if (type_ret)
+		*type_ret = member.qualified_type;
+	return NULL;
+}
+
+static struct drgn_error *sb_inodes_layout_init(struct drgn_program *prog,
+						struct sb_inodes_layout *layout)
+{
+	struct drgn_error *err;
+	struct drgn_qualified_type inode_type, mapping_type;
+	uint64_t word_size = drgn_program_is_64_bit(prog) ? 8 : 4;
+	uint64_t end;
+
+	err = drgn_program_find_type(prog, "struct inode", NULL, &inode_type);
+	if (err)
+		return err;
+	err = drgn_program_find_type(prog, "struct address_space", NULL,
+				     &mapping_type);
+	if (err)
+		return err;
+	/*
+	 * Since Linux kernel commit b93b016313b3 ("page cache: use xa_lock")
+	 * (in v4.17), the page cache is i_pages rather than page_tree.
+	 */
+	err = sb_inodes_member(prog, mapping_type.type, "i_pages",
+			       &layout->i_pages, NULL, &layout->i_pages_type);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		err = sb_inodes_member(prog, mapping_type.type, "page_tree",
+				       &layout->i_pages, NULL,
+				       &layout->i_pages_type);
+	}
+	if (err ||
+	    (err = sb_inodes_member(prog, mapping_type.type, "nrpages",
+				    &layout->nrpages, &layout->nrpages_size,
+				    NULL)) ||
+	    (err = sb_inodes_member(prog, inode_type.type, "i_sb_list.next",
+				    &layout->sb_list, NULL, NULL)) ||
+	    (err = sb_inodes_member(prog, inode_type.type, "i_ino",
+				    &layout->ino, &layout->ino_size, NULL)) ||
+	    (err = sb_inodes_member(prog, inode_type.type, "i_mapping",
+				    &layout->mapping, NULL, NULL)) ||
+	    (err = sb_inodes_member(prog, inode_type.type, "i_data",
+				    &layout->i_data, NULL, NULL)))
+		return err;
+
+	layout->window_start = min(min(layout->sb_list, layout->ino),
+				   min(layout->mapping,
+				       layout->i_data + layout->nrpages));
+	end = max(max(layout->sb_list + word_size,
+		      layout->ino + layout->ino_size),
+		  max(layout->mapping + word_size,
+		      layout->i_data + layout->nrpages +
+		      layout->nrpages_size));
+	layout->window_size = end - layout->window_start;
+	return NULL;
+}
+
+/* Count the page and value entries in the page cache of an address space. */
+static struct drgn_error *
+sb_inode_walk_page_cache(struct drgn_program *prog,
+			 const struct sb_inodes_layout *layout,
+			 uint64_t mapping, struct linux_helper_sb_inode *inode)
+{
+	struct drgn_error *err;
+	struct drgn_object root;
+	struct linux_helper_radix_tree_iterator it;
+	uint64_t indices[64], entries[64];
+	size_t count, i;
+
+	drgn_object_init(&root, prog);
+	err = drgn_object_set_reference(&root, layout->i_pages_type,
+					mapping + layout->i_pages, 0, 0,
+					DRGN_PROGRAM_ENDIAN);
+	if (err)
+		goto out;
+	err = linux_helper_radix_tree_iterator_init(&it, &root);
+	if (err)
+		goto out_it;
+	for (;;) {
+		size_t capacity = ARRAY_SIZE(entries);
+
+		err = linux_helper_radix_tree_iterator_next_batch(&it, indices,
+								  entries,
+								  capacity,
+								  &count);
+		if (err == &drgn_stop) {
+			err = NULL;
+			break;
+		}
+		if (err)
+			break;
+		/*
+		 * XArray value entries have bit 0 set and radix tree
+		 * exceptional entries have bit 1 set. Internal entries were
+		 * already skipped.
+		 */
+		for (i = 0; i < count; i++) {
+			if (entries[i] & 3)
+				inode->value_entries++;
+			else
+				inode->page_entries++;
+		}
+	}
+out_it:
+	linux_helper_radix_tree_iterator_deinit(&it);
+out:
+	drgn_object_deinit(&root);
+	return err;
+}
+
+struct drgn_error *
+linux_helper_sb_inodes(const struct drgn_object *sb, bool walk_page_cache,
+		       struct linux_helper_sb_inode **inodes_ret,
+		       size_t *num_ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = sb->prog;
+	bool little_endian = drgn_program_is_little_endian(prog);
+	uint64_t word_bits = drgn_program_is_64_bit(prog) ? 64 : 32;
+	struct sb_inodes_layout layout;
+	struct linux_helper_sb_inode_vector inodes = VECTOR_INIT;
+	struct drgn_object tmp;
+	uint64_t head, node;
+	char *buf = NULL;
+
+	err = sb_inodes_layout_init(prog, &layout);
+	if (err)
+		return err;
+
+	drgn_object_init(&tmp, prog);
+	err = drgn_object_member_dereference(&tmp, sb, "s_inodes");
+	if (err)
+		goto out;
+	if (!tmp.is_reference) {
+		err = drgn_error_create(DRGN_ERROR_TYPE,
+					"s_inodes is not a reference");
+		goto out;
+	}
+	head = tmp.reference.address;
+	err = drgn_program_read_word(prog, head, false, &node);
+	if (err)
+		goto out;
+
+	buf = malloc(layout.window_size);
+	if (!buf) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	while (node != head) {
+		struct linux_helper_sb_inode *inode;
+		uint64_t address, mapping, i_data;
+
+		if (inodes.size >= SB_INODES_MAX) {
+			err = drgn_error_create(DRGN_ERROR_OTHER,
+						"s_inodes list is too long or corrupted");
+			goto out;
+		}
+		address = node - layout.sb_list;
+		err = drgn_program_read_memory(prog, buf,
+					       address + layout.window_start,
+					       layout.window_size, false);
+		if (err)
+			goto out;
+		inode = linux_helper_sb_inode_vector_append_entry(&inodes);
+		if (!inode) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		inode->inode = address;
+		inode->ino = deserialize_bits(buf + layout.ino -
+					      layout.window_start, 0,
+					      8 * layout.ino_size,
+					      little_endian);
+		mapping = deserialize_bits(buf + layout.mapping -
+					   layout.window_start, 0, word_bits,
+					   little_endian);
+		i_data = address + layout.i_data;
+		if (mapping == i_data) {
+			/* The usual case: the mapping is embedded. */
+			inode->nrpages =
+				deserialize_bits(buf + layout.i_data +
+						 layout.nrpages -
+						 layout.window_start, 0,
+						 8 * layout.nrpages_size,
+						 little_endian);
+		} else if (mapping) {
+			err = drgn_program_read_memory(prog, &inode->nrpages,
+						       mapping + layout.nrpages,
+						       layout.nrpages_size,
+						       false);
+			if (err)
+				goto out;
+			inode->nrpages =
+				deserialize_bits(&inode->nrpages, 0,
+						 8 * layout.nrpages_size,
+						 little_endian);
+		} else {
+			inode->nrpages = 0;
+		}
+		inode->page_entries = 0;
+		inode->value_entries = 0;
+		if (walk_page_cache && mapping) {
+			err = sb_inode_walk_page_cache(prog, &layout, mapping,
+						       inode);
+			if (err)
+				goto out;
+		}
+		node = deserialize_bits(buf + layout.sb_list -
+					layout.window_start, 0, word_bits,
+					little_endian);
+	}
+	err = NULL;
+out:
+	free(buf);
+	drgn_object_deinit(&tmp);
+	if (err) {
+		linux_helper_sb_inode_vector_deinit(&inodes);
+		return err;
+	}
+	linux_helper_sb_inode_vector_shrink_to_fit(&inodes);
+	*inodes_ret = inodes.data;
+	*num_ret = inodes.size;
+	return NULL;
+}
+
+
+/* Maximum number of cgroups found by linux_helper_cgroup_walk(). */
+static const size_t CGROUP_WALK_MAX = (size_t)1 << 24;
+
+/* Maximum size of a cgroup name read in a batch of names. */
+#define CGROUP_WALK_NAME_SIZE 256
+
+/* Members of the css read for each cgroup before the requested fields. */
+enum cgroup_walk_member_index {
+	CGROUP_WALK_CHILDREN,
+	CGROUP_WALK_SIBLING,
+	CGROUP_WALK_FLAGS,
+	CGROUP_WALK_CGROUP,
+	CGROUP_WALK_NUM_MEMBERS,
+};
+
+/* Cgroup visited by linux_helper_cgroup_walk(). */
+struct cgroup_walk_node {
+	uint64_t address, cgroup, flags;
+	/* Next link in the list of children of this cgroup to follow. */
+	uint64_t cursor;
+	size_t parent, depth;
+	/* Indices of related nodes, or SIZE_MAX if there are none. */
+	size_t first_child, last_child, next_sibling;
+};
+
+/* Cgroup to read in the next round of linux_helper_cgroup_walk(). */
+struct cgroup_walk_pending {
+	size_t parent;
+	uint64_t address;
+};
+
+DEFINE_VECTOR(cgroup_walk_node_vector, struct cgroup_walk_node)
+DEFINE_VECTOR(cgroup_walk_pending_vector, struct cgroup_walk_pending)
+DEFINE_VECTOR(cgroup_walk_value_vector, uint64_t)
+
+struct cgroup_walk_state {
+	struct linux_helper_cgroup_walk *walk;
+	bool little_endian;
+	/* The css members followed by the requested fields. */
+	struct task_snapshot_range members[TASK_SNAPSHOT_MAX_RANGES];
+	struct task_snapshot_plan plan;
+	/* Nodes in the order they were read. */
+	struct cgroup_walk_node_vector nodes;
+	/* Values of the fields of each node in the order they were read. */
+	struct cgroup_walk_value_vector values;
+	struct cgroup_walk_pending_vector pending, next_pending;
+};
+
+/* Find the name of the first member of a type which is a css. */
+static struct drgn_error *cgroup_walk_css_member(struct drgn_type *type,
+						 const char **ret)
+{
+	struct drgn_error *err;
+	struct drgn_type_member *members;
+	size_t num_members, i;
+
+	type = drgn_underlying_type(type);
+	if (!drgn_type_has_members(type)) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "cgroup container type is not a structure");
+	}
+	members = drgn_type_members(type);
+	num_members = drgn_type_num_members(type);
+	for (i = 0; i < num_members; i++) {
+		struct drgn_qualified_type member_type;
+		struct drgn_type *underlying;
+		const char *tag;
+
+		if (!members[i].name)
+			continue;
+		err = drgn_member_type(&members[i], &member_type);
+		if (err)
+			return err;
+		underlying = drgn_underlying_type(member_type.type);
+		if (drgn_type_kind(underlying) != DRGN_TYPE_STRUCT)
+			continue;
+		tag = drgn_type_tag(underlying);
+		if (tag && strcmp(tag, "cgroup_subsys_state") == 0) {
+			*ret = members[i].name;
+			return NULL;
+		}
+	}
+	return drgn_error_create(DRGN_ERROR_LOOKUP,
+				 "cgroup container type has no struct cgroup_subsys_state member");
+}
+
+/* Find an integer member of the container and whether it is signed. */
+static struct drgn_error *cgroup_walk_field(struct drgn_program *prog,
+					    struct drgn_type *type,
+					    const char *member_designator,
+					    struct task_snapshot_range *ret,
+					    bool *signed_ret)
+{
+	struct drgn_error *err;
+	struct drgn_member_info member;
+	struct drgn_type *underlying;
+
+	err = task_snapshot_member(prog, type, member_designator, 8, ret);
+	if (err)
+		return err;
+	err = drgn_program_member_path(prog, type, member_designator, &member);
+	if (err)
+		return err;
+	underlying = drgn_underlying_type(member.qualified_type.type);
+	if (drgn_type_kind(underlying) == DRGN_TYPE_ENUM &&
+	    drgn_type_is_complete(underlying)) {
+		*signed_ret = drgn_enum_type_is_signed(underlying);
+	} else if (drgn_type_has_is_signed(underlying)) {
+		*signed_ret = drgn_type_is_signed(underlying);
+	} else if (drgn_type_kind(underlying) == DRGN_TYPE_BOOL ||
+		   drgn_type_kind(underlying) == DRGN_TYPE_POINTER) {
+		*signed_ret = false;
+	} else {
+		return drgn_error_format(DRGN_ERROR_TYPE,
+					 "%s is not an integer",
+					 member_designator);
+	}
+	return NULL;
+}
+
+/* Queue the next child of a node to be read if it has one. */
+static bool cgroup_walk_queue(struct cgroup_walk_state *state, size_t i)
+{
+	const struct cgroup_walk_node *node = &state->nodes.data[i];
+	struct cgroup_walk_pending *pending;
+	uint64_t children = state->members[CGROUP_WALK_CHILDREN].offset;
+	uint64_t sibling = state->members[CGROUP_WALK_SIBLING].offset;
+
+	/* The cursor returns to the list head after the last child. */
+	if (node->cursor == node->address + children)
+		return true;
+	pending = cgroup_walk_pending_vector_append_entry(&state->next_pending);
+	if (!pending)
+		return false;
+	pending->parent = i;
+	pending->address = node->cursor - sibling;
+	return true;
+}
+
+static uint64_t cgroup_walk_member(const struct cgroup_walk_state *state,
+				   const char *buf, size_t member)
+{
+	return task_snapshot_value(buf, &state->plan, &state->members[member],
+				   state->little_endian);
+}
+
+/* Add a node read into buf and queue its first child and its next sibling. */
+static struct drgn_error *
+cgroup_walk_visit(struct cgroup_walk_state *state,
+		  const struct cgroup_walk_pending *pending, const char *buf)
+{
+	size_t num_fields = state->walk->num_fields;
+	struct cgroup_walk_node *node, *parent;
+	size_t i = state->nodes.size, j;
+
+	if (i >= CGROUP_WALK_MAX) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "cgroup hierarchy is too large or corrupted");
+	}
+	node = cgroup_walk_node_vector_append_entry(&state->nodes);
+	if (!node)
+		return &drgn_enomem;
+	node->address = pending->address;
+	node->cgroup = cgroup_walk_member(state, buf, CGROUP_WALK_CGROUP);
+	node->flags = cgroup_walk_member(state, buf, CGROUP_WALK_FLAGS);
+	node->cursor = cgroup_walk_member(state, buf, CGROUP_WALK_CHILDREN);
+	node->parent = pending->parent;
+	node->depth = 0;
+	node->first_child = node->last_child = node->next_sibling = SIZE_MAX;
+	for (j = 0; j < num_fields; j++) {
+		size_t member = CGROUP_WALK_NUM_MEMBERS + j;
+		uint64_t *value;
+
+		value = cgroup_walk_value_vector_append_entry(&state->values);
+		if (!value)
+			return &drgn_enomem;
+		*value = cgroup_walk_member(state, buf, member);
+		if (state->walk->field_signed[j]) {
+			*value = sign_extend(*value,
+					     8 * state->members[member].size);
+		}
+	}
+
+	if (pending->parent != SIZE_MAX) {
+		parent = &state->nodes.data[pending->parent];
+		node->depth = parent->depth + 1;
+		if (parent->last_child == SIZE_MAX)
+			parent->first_child = i;
+		else
+			state->nodes.data[parent->last_child].next_sibling = i;
+		parent->last_child = i;
+		parent->cursor = cgroup_walk_member(state, buf,
+						    CGROUP_WALK_SIBLING);
+		if (!cgroup_walk_queue(state, pending->parent))
+			return &drgn_enomem;
+	}
+	if (!cgroup_walk_queue(state, i))
+		return &drgn_enomem;
+	return NULL;
+}
+
+/* Copy the nodes and their values into the walk in pre-order. */
+static struct drgn_error *cgroup_walk_order(struct cgroup_walk_state *state)
+{
+	struct linux_helper_cgroup_walk *walk = state->walk;
+	size_t num_fields = walk->num_fields;
+	const struct cgroup_walk_node *nodes = state->nodes.data;
+	size_t i = 0;
+
+	walk->entries = malloc_array(state->nodes.size, sizeof(*walk->entries));
+	walk->values = malloc_array(max(state->nodes.size * num_fields,
+					(size_t)1), sizeof(*walk->values));
+	if (!walk->entries || !walk->values)
+		return &drgn_enomem;
+	while (i != SIZE_MAX) {
+		struct linux_helper_cgroup_walk_entry *entry;
+
+		entry = &walk->entries[walk->num_entries];
+		entry->address = nodes[i].address;
+		entry->cgroup = nodes[i].cgroup;
+		entry->flags = nodes[i].flags;
+		entry->depth = nodes[i].depth;
+		memcpy(&walk->values[walk->num_entries * num_fields],
+		       &state->values.data[i * num_fields],
+		       num_fields * sizeof(*walk->values));
+		walk->num_entries++;
+
+		if (nodes[i].first_child != SIZE_MAX) {
+			i = nodes[i].first_child;
+			continue;
+		}
+		/* The root of the walk has no parent and no siblings. */
+		while (i != SIZE_MAX && nodes[i].next_sibling == SIZE_MAX)
+			i = nodes[i].parent;
+		if (i != SIZE_MAX)
+			i = nodes[i].next_sibling;
+	}
+	return NULL;
+}
+
+/*
+ * Append the name of a cgroup, which was read into buf if it fit in size
+ * bytes, to sb.
+ */
+static struct drgn_error *cgroup_walk_append_name(struct drgn_program *prog,
+						  struct string_builder *sb,
+						  uint64_t address,
+						  const char *buf,
+						  size_t size, size_t *len_ret)
+{
+	struct drgn_error *err;
+	size_t len = strnlen(buf, size);
+	char *str;
+	bool ok;
+
+	if (len < size) {
+		ok = string_builder_appendn(sb, buf, len);
+	} else {
+		err = drgn_program_read_c_string(prog, address, false,
+						 SIZE_MAX, &str);
+		if (err)
+			return err;
+		len = strlen(str);
+		ok = string_builder_appendn(sb, str, len);
+		free(str);
+	}
+	if (!ok || !string_builder_appendc(sb, '\0'))
+		return &drgn_enomem;
+	*len_ret = len;
+	return NULL;
+}
+
+/* Size of the batched read of a cgroup name, which stays in one page. */
+static uint64_t cgroup_walk_name_size(uint64_t address)
+{
+	return min(4096 - address % 4096, (uint64_t)CGROUP_WALK_NAME_SIZE);
+}
+
+/*
+ * Read the names of the cgroups of a walk in batches: first the kernfs nodes,
+ * then their names and parents, then the strings.
+ */
+static struct drgn_error *cgroup_walk_names(struct drgn_program *prog,
+					    struct cgroup_walk_state *state)
+{
+	struct drgn_error *err;
+	struct linux_helper_cgroup_walk *walk = state->walk;
+	bool little_endian = state->little_endian;
+	struct drgn_qualified_type cgroup_type, kn_type;
+	struct task_snapshot_range kn, kn_members[2];
+	struct task_snapshot_plan kn_plan;
+	struct drgn_memory_read_request *requests = NULL;
+	struct string_builder sb = {};
+	uint64_t kns[TASK_SNAPSHOT_BATCH_SIZE];
+	uint64_t names[TASK_SNAPSHOT_BATCH_SIZE];
+	char *buf = NULL, *name_buf = NULL;
+	size_t start, i;
+
+	err = drgn_program_find_type(prog, "struct cgroup", NULL,
+				     &cgroup_type);
+	if (err)
+		return err;
+	err = drgn_program_find_type(prog, "struct kernfs_node", NULL,
+				     &kn_type);
+	if (err)
+		return err;
+	err = task_snapshot_member(prog, cgroup_type.type, "kn", 8, &kn);
+	if (err)
+		return err;
+	err = task_snapshot_member(prog, kn_type.type, "name", 8,
+				   &kn_members[0]);
+	if (err)
+		return err;
+	/* kernfs_node::parent was renamed to __parent in Linux 6.15. */
+	err = task_snapshot_member(prog, kn_type.type, "parent", 8,
+				   &kn_members[1]);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		err = task_snapshot_member(prog, kn_type.type, "__parent", 8,
+					   &kn_members[1]);
+	}
+	if (err)
+		return err;
+	task_snapshot_plan_init(&kn_plan, kn_members, 2);
+
+	buf = malloc_array(TASK_SNAPSHOT_BATCH_SIZE, kn_plan.window);
+	name_buf = malloc_array(TASK_SNAPSHOT_BATCH_SIZE,
+				CGROUP_WALK_NAME_SIZE);
+	requests = malloc_array(TASK_SNAPSHOT_BATCH_SIZE * kn_plan.num_spans,
+				sizeof(*requests));
+	if (!buf || !name_buf || !requests) {
+		err = &drgn_enomem;
+		goto out;
+	}
+
+	for (start = 0; start < walk->num_entries;
+	     start += TASK_SNAPSHOT_BATCH_SIZE) {
+		size_t n = min(walk->num_entries - start,
+			       (size_t)TASK_SNAPSHOT_BATCH_SIZE);
+		size_t num_requests = 0;
+
+		for (i = 0; i < n; i++) {
+			uint64_t cgroup = walk->entries[start + i].cgroup;
+
+			requests[i] = (struct drgn_memory_read_request){
+				.buf = &kns[i],
+				.address = cgroup + kn.offset,
+				.count = kn.size,
+			};
+		}
+		err = drgn_program_read_memory_batch(prog, requests, n);
+		if (err)
+			goto out;
+		for (i = 0; i < n; i++) {
+			kns[i] = deserialize_bits(&kns[i], 0, 8 * kn.size,
+						  little_endian);
+		}
+
+		err = task_snapshot_plan_read(prog, &kn_plan, kns, n, buf,
+					      requests);
+		if (err)
+			goto out;
+		for (i = 0; i < n; i++) {
+			const char *kn_buf = buf + i * kn_plan.window;
+
+			/* kernfs_name() names the root kernfs node "/". */
+			names[i] = 0;
+			if (!kns[i] ||
+			    !task_snapshot_value(kn_buf, &kn_plan,
+						 &kn_members[1], little_endian))
+				continue;
+			names[i] = task_snapshot_value(kn_buf, &kn_plan,
+						       &kn_members[0],
+						       little_endian);
+			if (!names[i])
+				continue;
+			requests[num_requests++] = (struct drgn_memory_read_request){
+				.buf = name_buf + i * CGROUP_WALK_NAME_SIZE,
+				.address = names[i],
+				.count = cgroup_walk_name_size(names[i]),
+			};
+		}
+		if (num_requests) {
+			err = drgn_program_read_memory_batch(prog, requests,
+							     num_requests);
+			if (err)
+				goto out;
+		}
+
+		for (i = 0; i < n; i++) {
+			struct linux_helper_cgroup_walk_entry *entry;
+			const char *name = name_buf + i * CGROUP_WALK_NAME_SIZE;
+			size_t size;
+
+			entry = &walk->entries[start + i];
+			entry->name_offset = sb.len;
+			if (names[i]) {
+				size = cgroup_walk_name_size(names[i]);
+			} else {
+				name = kns[i] ? "/" : "";
+				size = strlen(name) + 1;
+			}
+			err = cgroup_walk_append_name(prog, &sb, names[i],
+						      name, size,
+						      &entry->name_len);
+			if (err)
+				goto out;
+		}
+	}
+	if (!string_builder_finalize(&sb, &walk->names)) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	err = NULL;
+out:
+	if (err)
+		free(sb.str);
+	free(requests);
+	free(name_buf);
+	free(buf);
+	return err;
+}
+
+/* Find the members of the css and the fields to read. */
+static struct drgn_error *cgroup_walk_plan(struct drgn_program *prog,
+					   struct cgroup_walk_state *state,
+					   struct drgn_type *type,
+					   const char *css_member,
+					   const char * const *fields)
+{
+	static const char * const css_members[] = {
+		[CGROUP_WALK_CHILDREN] = "children.next",
+		[CGROUP_WALK_SIBLING] = "sibling.next",
+		[CGROUP_WALK_FLAGS] = "flags",
+		[CGROUP_WALK_CGROUP] = "cgroup",
+	};
+	struct drgn_error *err;
+	size_t num_fields = state->walk->num_fields;
+	size_t i;
+
+	for (i = 0; i < CGROUP_WALK_NUM_MEMBERS; i++) {
+		char designator[128];
+
+		snprintf(designator, sizeof(designator), "%s.%s", css_member,
+			 css_members[i]);
+		err = task_snapshot_member(prog, type, designator, 8,
+					   &state->members[i]);
+		if (err)
+			return err;
+	}
+	for (i = 0; i < num_fields; i++) {
+		struct task_snapshot_range *member =
+			&state->members[CGROUP_WALK_NUM_MEMBERS + i];
+
+		err = cgroup_walk_field(prog, type, fields[i], member,
+					&state->walk->field_signed[i]);
+		if (err)
+			return err;
+	}
+	task_snapshot_plan_init(&state->plan, state->members,
+				CGROUP_WALK_NUM_MEMBERS + num_fields);
+	return NULL;
+}
+
+struct drgn_error *
+linux_helper_cgroup_walk(struct linux_helper_cgroup_walk *ret,
+			 const struct drgn_object *css,
+			 const char *container_type,
+			 const char * const *fields, size_t num_fields)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = css->prog;
+	struct cgroup_walk_state state = {
+		.walk = ret,
+		.little_endian = drgn_program_is_little_endian(prog),
+		.nodes = VECTOR_INIT,
+		.values = VECTOR_INIT,
+		.pending = VECTOR_INIT,
+		.next_pending = VECTOR_INIT,
+	};
+	struct cgroup_walk_pending_vector tmp;
+	struct cgroup_walk_pending *pending, *root;
+	struct drgn_qualified_type type;
+	struct drgn_member_info css_info;
+	const char *css_member;
+	struct drgn_memory_read_request *requests = NULL;
+	uint64_t addresses[TASK_SNAPSHOT_BATCH_SIZE];
+	uint64_t css_address;
+	char *buf = NULL;
+	size_t start, i;
+
+	if (num_fields > LINUX_HELPER_CGROUP_WALK_MAX_FIELDS) {
+		return drgn_error_format(DRGN_ERROR_INVALID_ARGUMENT,
+					 "at most %d cgroup fields can be read",
+					 LINUX_HELPER_CGROUP_WALK_MAX_FIELDS);
+	}
+	memset(ret, 0, sizeof(*ret));
+	ret->num_fields = num_fields;
+
+	err = drgn_object_read_unsigned(css, &css_address);
+	if (err)
+		return err;
+	if (!container_type)
+		container_type = "struct cgroup";
+	err = drgn_program_find_type(prog, container_type, NULL, &type);
+	if (err)
+		return err;
+	err = cgroup_walk_css_member(type.type, &css_member);
+	if (err)
+		return err;
+	err = drgn_program_member_path(prog, type.type, css_member, &css_info);
+	if (err)
+		return err;
+	err = cgroup_walk_plan(prog, &state, type.type, css_member, fields);
+	if (err)
+		return err;
+
+	buf = malloc_array(TASK_SNAPSHOT_BATCH_SIZE, state.plan.window);
+	requests = malloc_array(TASK_SNAPSHOT_BATCH_SIZE * state.plan.num_spans,
+				sizeof(*requests));
+	root = cgroup_walk_pending_vector_append_entry(&state.pending);
+	if (!buf || !requests || !root) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	root->parent = SIZE_MAX;
+	root->address = css_address - css_info.bit_offset / 8;
+
+	/*
+	 * Siblings are a linked list, so each round reads the next child of
+	 * every cgroup that has more children to visit, in batches.
+	 */
+	while (state.pending.size) {
+		state.next_pending.size = 0;
+		for (start = 0; start < state.pending.size;
+		     start += TASK_SNAPSHOT_BATCH_SIZE) {
+			size_t n = min(state.pending.size - start,
+				       (size_t)TASK_SNAPSHOT_BATCH_SIZE);
+
+			pending = &state.pending.data[start];
+			for (i = 0; i < n; i++)
+				addresses[i] = pending[i].address;
+			err = task_snapshot_plan_read(prog, &state.plan,
+						      addresses, n, buf,
+						      requests);
+			if (err)
+				goto out;
+			for (i = 0; i < n; i++) {
+				const char *node_buf;
+
+				node_buf = buf + i * state.plan.window;
+				err = cgroup_walk_visit(&state, &pending[i],
+							node_buf);
+				if (err)
+					goto out;
+			}
+		}
+		tmp = state.pending;
+		state.pending = state.next_pending;
+		state.next_pending = tmp;
+	}
+
+	err = cgroup_walk_order(&state);
+	if (err)
+		goto out;
+	err = cgroup_walk_names(prog, &state);
+out:
+	free(requests);
+	free(buf);
+	cgroup_walk_pending_vector_deinit(&state.next_pending);
+	cgroup_walk_pending_vector_deinit(&state.pending);
+	cgroup_walk_value_vector_deinit(&state.values);
+	cgroup_walk_node_vector_deinit(&state.nodes);
+	if (err)
+		linux_helper_cgroup_walk_deinit(ret);
+	return err;
+}
+
+void linux_helper_cgroup_walk_deinit(struct linux_helper_cgroup_walk *walk)
+{
+	free(walk->names);
+	free(walk->values);
+	free(walk->entries);
+}
+
+/* Pages precharged to a memory cgroup in a per-CPU charge stock. */
+struct memcg_stock_entry {
+	uint64_t memcg, nr_pages;
+};
+
+DEFINE_VECTOR(memcg_stock_vector, struct memcg_stock_entry)
+
+static int memcg_stock_entry_cmp(const void *_a, const void *_b)
+{
+	const struct memcg_stock_entry *a = _a, *b = _b;
+
+	if (a->memcg != b->memcg)
+		return a->memcg < b->memcg ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Get the location of an array of pointers or integers in a per-CPU charge
+ * stock. Older kernels cache one memory cgroup per stock, and newer kernels
+ * cache several, so a scalar member is treated as an array of length 1.
+ */
+static struct drgn_error *memcg_stock_member(struct drgn_program *prog,
+					     struct drgn_type *type,
+					     const char *name,
+					     struct task_snapshot_range *ret,
+					     uint64_t *length_ret)
+{
+	struct drgn_error *err;
+	struct drgn_member_info member;
+	struct drgn_type *member_type;
+	uint64_t length = 1;
+
+	err = drgn_program_member_info(prog, type, name, &member);
+	if (err)
+		return err;
+	member_type = drgn_underlying_type(member.qualified_type.type);
+	if (drgn_type_kind(member_type) == DRGN_TYPE_ARRAY) {
+		length = drgn_type_length(member_type);
+		member_type = drgn_type_type(member_type).type;
+	}
+	err = drgn_type_sizeof(member_type, &ret->size);
+	if (err)
+		return err;
+	if (member.bit_offset % 8 || member.bit_field_size || !ret->size ||
+	    ret->size > 8 || !length) {
+		return drgn_error_format(DRGN_ERROR_TYPE,
+					 "unsupported memcg_stock_pcp %s member",
+					 name);
+	}
+	ret->offset = member.bit_offset / 8;
+	*length_ret = length;
+	return NULL;
+}
+
+/*
+ * Read the pages precharged to memory cgroups in the per-CPU charge stocks
+ * (memcg_stock) of every online CPU. The stocks of all of the CPUs are read in
+ * one batch. The returned entries are sorted by memory cgroup, with one entry
+ * per memory cgroup.
+ */
+static struct drgn_error *memcg_stocks(struct drgn_program *prog,
+				       struct memcg_stock_vector *ret)
+{
+	struct drgn_error *err;
+	bool little_endian = drgn_program_is_little_endian(prog);
+	struct task_snapshot_range members[2], spans[2];
+	struct task_snapshot_plan plan;
+	struct drgn_memory_read_request *requests = NULL;
+	const uint64_t *offsets;
+	uint64_t stock, slots, nr_pages_slots, *cpus = NULL;
+	uint64_t addresses[TASK_SNAPSHOT_BATCH_SIZE];
+	size_t num_offsets, num_cpus, start, i, j;
+	struct drgn_object tmp;
+	struct drgn_type *type;
+	char *buf = NULL;
+
+	drgn_object_init(&tmp, prog);
+	err = drgn_program_find_object(prog, "memcg_stock", NULL,
+				       DRGN_FIND_OBJECT_VARIABLE, &tmp);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		/* The kernel doesn't have charge stocks. */
+		drgn_error_destroy(err);
+		err = NULL;
+		goto out;
+	}
+	if (err)
+		goto out;
+	if (!tmp.is_reference) {
+		err = drgn_error_create(DRGN_ERROR_TYPE,
+					"memcg_stock is not a variable");
+		goto out;
+	}
+	stock = tmp.reference.address;
+	type = drgn_underlying_type(tmp.type);
+	if ((err = memcg_stock_member(prog, type, "cached", &members[0],
+				      &slots)) ||
+	    (err = memcg_stock_member(prog, type, "nr_pages", &members[1],
+				      &nr_pages_slots)))
+		goto out;
+	if (slots != nr_pages_slots) {
+		err = drgn_error_create(DRGN_ERROR_TYPE,
+					"memcg_stock_pcp cached and nr_pages do not match");
+		goto out;
+	}
+	for (i = 0; i < ARRAY_SIZE(members); i++)
+		spans[i] = (struct task_snapshot_range){
+			members[i].offset, members[i].size * slots,
+		};
+	task_snapshot_plan_init(&plan, spans, ARRAY_SIZE(spans));
+
+	err = linux_helper_per_cpu_offsets(prog, &offsets, &num_offsets);
+	if (err)
+		goto out;
+	err = linux_helper_cpumask_cpus(prog, NULL, &cpus, &num_cpus);
+	if (err)
+		goto out;
+	buf = malloc_array(TASK_SNAPSHOT_BATCH_SIZE, plan.window);
+	requests = malloc_array(TASK_SNAPSHOT_BATCH_SIZE * plan.num_spans,
+				sizeof(*requests));
+	if (!buf || !requests) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	for (start = 0; start < num_cpus; start += TASK_SNAPSHOT_BATCH_SIZE) {
+		size_t n = min(num_cpus - start,
+			       (size_t)TASK_SNAPSHOT_BATCH_SIZE);
+
+		for (i = 0; i < n; i++) {
+			if (cpus[start + i] >= num_offsets) {
+				err = drgn_error_format(DRGN_ERROR_OUT_OF_BOUNDS,
+							"CPU %" PRIu64 " is out of range",
+							cpus[start + i]);
+				goto out;
+			}
+			addresses[i] = stock + offsets[cpus[start + i]];
+		}
+		err = task_snapshot_plan_read(prog, &plan, addresses, n, buf,
+					      requests);
+		if (err)
+			goto out;
+		for (i = 0; i < n; i++) {
+			for (j = 0; j < slots; j++) {
+				struct task_snapshot_range cached = {
+					members[0].offset + j * members[0].size,
+					members[0].size,
+				};
+				struct task_snapshot_range nr_pages = {
+					members[1].offset + j * members[1].size,
+					members[1].size,
+				};
+				struct memcg_stock_entry entry = {
+					task_snapshot_value(buf +
+							    i * plan.window,
+							    &plan, &cached,
+							    little_endian),
+					task_snapshot_value(buf +
+							    i * plan.window,
+							    &plan, &nr_pages,
+							    little_endian),
+				};
+
+				if (entry.memcg && entry.nr_pages &&
+				    !memcg_stock_vector_append(ret, &entry)) {
+					err = &drgn_enomem;
+					goto out;
+				}
+			}
+		}
+	}
+
+	/* Merge the stocks of the same memory cgroup on different CPUs. */
+	qsort(ret->data, ret->size, sizeof(ret->data[0]),
+	      memcg_stock_entry_cmp);
+	for (i = j = 0; i < ret->size; i++) {
+		if (j && ret->data[j - 1].memcg == ret->data[i].memcg)
+			ret->data[j - 1].nr_pages += ret->data[i].nr_pages;
+		else
+			ret->data[j++] = ret->data[i];
+	}
+	ret->size = j;
+	err = NULL;
+out:
+	free(requests);
+	free(buf);
+	free(cpus);
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+struct drgn_error *
+linux_helper_memcg_usage(struct linux_helper_cgroup_walk *walk_ret,
+			 uint64_t **stock_ret, const struct drgn_object *css)
+{
+	static const char * const fields[] = { "memory.usage.counter" };
+	struct drgn_error *err;
+	struct memcg_stock_vector stocks = VECTOR_INIT;
+	uint64_t *stock;
+	size_t i;
+
+	err = linux_helper_cgroup_walk(walk_ret, css, "struct mem_cgroup",
+				       fields, ARRAY_SIZE(fields));
+	if (err)
+		return err;
+	err = memcg_stocks(css->prog, &stocks);
+	if (err)
+		goto err;
+	stock = malloc_array(max(walk_ret->num_entries, (size_t)1),
+			     sizeof(*stock));
+	if (!stock) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	for (i = 0; i < walk_ret->num_entries; i++) {
+		struct memcg_stock_entry key = {
+			.memcg = walk_ret->entries[i].address,
+		};
+		struct memcg_stock_entry *found;
+
+		found = bsearch(&key, stocks.data, stocks.size,
+				sizeof(stocks.data[0]), memcg_stock_entry_cmp);
+		stock[i] = found ? found->nr_pages : 0;
+	}
+	memcg_stock_vector_deinit(&stocks);
+	*stock_ret = stock;
+	return NULL;
+
+err:
+	memcg_stock_vector_deinit(&stocks);
+	linux_helper_cgroup_walk_deinit(walk_ret);
+	return err;
+}
+
+/* Maximum size of the raw BTF data read by linux_helper_btf(). */
+static const uint64_t BTF_DATA_MAX = UINT64_C(1) << 30;
+
+static struct drgn_error *btf_member_value(struct drgn_object *tmp,
+					   const struct drgn_object *btf,
+					   const char *member_name,
+					   uint64_t *ret)
+{
+	struct drgn_error *err;
+
+	err = drgn_object_member_dereference(tmp, btf, member_name);
+	if (err)
+		return err;
+	return drgn_object_read_unsigned(tmp, ret);
+}
+
+struct drgn_error *linux_helper_btf(const struct drgn_object *btf,
+				    struct drgn_btf **ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = btf->prog;
+	struct drgn_object tmp;
+	uint64_t address, data, data_size, base_btf;
+	char name[64];
+	char *buf;
+
+	err = drgn_object_read_unsigned(btf, &address);
+	if (err)
+		return err;
+	drgn_object_init(&tmp, prog);
+	err = btf_member_value(&tmp, btf, "data", &data);
+	if (err)
+		goto out;
+	err = btf_member_value(&tmp, btf, "data_size", &data_size);
+	if (err)
+		goto out;
+	/* Split BTF was added in Linux kernel commit 951bb64621b8 (in v5.11). */
+	err = btf_member_value(&tmp, btf, "base_btf", &base_btf);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		base_btf = 0;
+	} else if (err) {
+		goto out;
+	}
+	if (base_btf) {
+		err = drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					"split BTF is not supported");
+		goto out;
+	}
+
+	*ret = drgn_program_find_kernel_btf(prog, address, data, data_size);
+	if (*ret)
+		goto out;
+	if (data_size > BTF_DATA_MAX) {
+		err = drgn_error_create(DRGN_ERROR_OTHER,
+					"BTF data is too large or corrupted");
+		goto out;
+	}
+	buf = malloc(data_size ? data_size : 1);
+	if (!buf) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	err = drgn_program_read_memory(prog, buf, data, data_size, false);
+	if (err) {
+		free(buf);
+		goto out;
+	}
+	snprintf(name, sizeof(name), "BTF at 0x%" PRIx64, address);
+	err = drgn_btf_create_from_data(prog, buf, data_size, name, ret);
+	if (err)
+		goto out;
+	err = drgn_program_cache_kernel_btf(prog, address, data, data_size,
+					    *ret);
+out:
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+/* Members of struct request read by linux_helper_blk_mq_inflight(). */
+enum blk_mq_rq_member_index {
+	BLK_MQ_RQ_Q,
+	BLK_MQ_RQ_TAG,
+	BLK_MQ_RQ_STATE,
+	BLK_MQ_RQ_SECTOR,
+	BLK_MQ_RQ_DATA_LEN,
+	BLK_MQ_RQ_CMD_FLAGS,
+	BLK_MQ_RQ_START_TIME,
+	/* The following members are optional. */
+	BLK_MQ_RQ_IO_START_TIME,
+	BLK_MQ_RQ_DISK,
+	BLK_MQ_RQ_NUM_MEMBERS,
+};
+
+DEFINE_VECTOR(blk_mq_address_vector, uint64_t)
+DEFINE_VECTOR(linux_helper_blk_mq_request_vector,
+	      struct linux_helper_blk_mq_request)
+
+/* Layout of struct request and the state of linux_helper_blk_mq_inflight(). */
+struct blk_mq_inflight_state {
+	struct drgn_program *prog;
+	bool little_endian;
+	uint64_t q, q_disk, in_flight;
+	struct task_snapshot_range members[BLK_MQ_RQ_NUM_MEMBERS];
+	bool has_member[BLK_MQ_RQ_NUM_MEMBERS];
+	struct task_snapshot_plan plan;
+	/* Offsets of blk_mq_hw_ctx::tags and of members of blk_mq_tags. */
+	uint64_t hctx_tags, tags_rqs;
+	struct task_snapshot_range tags_nr_tags;
+	struct linux_helper_blk_mq_request_vector requests;
+};
+
+static struct drgn_error *
+blk_mq_inflight_layout(struct blk_mq_inflight_state *state)
+{
+	static const char * const member_names[] = {
+		[BLK_MQ_RQ_Q] = "q",
+		[BLK_MQ_RQ_TAG] = "tag",
+		[BLK_MQ_RQ_STATE] = "state",
+		[BLK_MQ_RQ_SECTOR] = "__sector",
+		[BLK_MQ_RQ_DATA_LEN] = "__data_len",
+		[BLK_MQ_RQ_CMD_FLAGS] = "cmd_flags",
+		[BLK_MQ_RQ_START_TIME] = "start_time_ns",
+		[BLK_MQ_RQ_IO_START_TIME] = "io_start_time_ns",
+		[BLK_MQ_RQ_DISK] = "rq_disk",
+	};
+	struct drgn_error *err;
+	struct drgn_program *prog = state->prog;
+	struct drgn_qualified_type rq_type, hctx_type, tags_type;
+	struct task_snapshot_range present[BLK_MQ_RQ_NUM_MEMBERS];
+	struct task_snapshot_range range;
+	size_t num_present = 0, i;
+
+	err = drgn_program_find_type(prog, "struct request", NULL, &rq_type);
+	if (err)
+		return err;
+	err = drgn_program_find_type(prog, "struct blk_mq_hw_ctx", NULL,
+				     &hctx_type);
+	if (err)
+		return err;
+	err = drgn_program_find_type(prog, "struct blk_mq_tags", NULL,
+				     &tags_type);
+	if (err)
+		return err;
+	for (i = 0; i < BLK_MQ_RQ_NUM_MEMBERS; i++) {
+		err = task_snapshot_member(prog, rq_type.type,
+					   member_names[i], 8,
+					   &state->members[i]);
+		if (err && err->code == DRGN_ERROR_LOOKUP &&
+		    i >= BLK_MQ_RQ_IO_START_TIME) {
+			drgn_error_destroy(err);
+			state->has_member[i] = false;
+			continue;
+		}
+		if (err)
+			return err;
+		state->has_member[i] = true;
+		present[num_present++] = state->members[i];
+	}
+	task_snapshot_plan_init(&state->plan, present, num_present);
+
+	err = task_snapshot_member(prog, hctx_type.type, "tags", 8, &range);
+	if (err)
+		return err;
+	state->hctx_tags = range.offset;
+	err = task_snapshot_member(prog, tags_type.type, "rqs", 8, &range);
+	if (err)
+		return err;
+	state->tags_rqs = range.offset;
+	return task_snapshot_member(prog, tags_type.type, "nr_tags", 8,
+				    &state->tags_nr_tags);
+}
+
+/* Get the hardware contexts in the hctx_table XArray of a request queue. */
+static struct drgn_error *blk_mq_hctx_table(const struct drgn_object *xa,
+					    struct blk_mq_address_vector *ret)
+{
+	struct drgn_error *err;
+	struct linux_helper_radix_tree_iterator it;
+	uint64_t indices[64], entries[64];
+	size_t count, i;
+
+	err = linux_helper_radix_tree_iterator_init(&it, xa);
+	if (err)
+		goto out;
+	for (;;) {
+		size_t capacity = ARRAY_SIZE(entries);
+
+		err = linux_helper_radix_tree_iterator_next_batch(&it, indices,
+								  entries,
+								  capacity,
+								  &count);
+		if (err == &drgn_stop) {
+			err = NULL;
+			break;
+		}
+		if (err)
+			break;
+		for (i = 0; i < count; i++) {
+			if (!blk_mq_address_vector_append(ret, &entries[i])) {
+				err = &drgn_enomem;
+				goto out;
+			}
+		}
+	}
+out:
+	linux_helper_radix_tree_iterator_deinit(&it);
+	return err;
+}
+
+/* Get the hardware contexts of a request queue. */
+static struct drgn_error *blk_mq_hctxs(const struct drgn_object *q,
+				       struct blk_mq_address_vector *ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = q->prog;
+	struct drgn_object tmp;
+	uint64_t queue_hw_ctx, nr_hw_queues;
+	uint64_t *hctxs;
+	size_t i;
+
+	drgn_object_init(&tmp, prog);
+	/*
+	 * Since Linux kernel commit 4e5cc99e1e48 ("blk-mq: manage hctx map via
+	 * xarray") (in v5.18), the hardware contexts are in an XArray.
+	 */
+	err = drgn_object_member_dereference(&tmp, q, "hctx_table");
+	if (!err) {
+		err = blk_mq_hctx_table(&tmp, ret);
+		goto out;
+	}
+	if (err->code != DRGN_ERROR_LOOKUP)
+		goto out;
+	drgn_error_destroy(err);
+
+	err = drgn_object_member_dereference(&tmp, q, "nr_hw_queues");
+	if (!err)
+		err = drgn_object_read_unsigned(&tmp, &nr_hw_queues);
+	if (!err)
+		err = drgn_object_member_dereference(&tmp, q, "queue_hw_ctx");
+	if (!err)
+		err = drgn_object_read_unsigned(&tmp, &queue_hw_ctx);
+	if (err)
+		goto out;
+	/* Queues which aren't blk-mq have no hardware contexts. */
+	if (!queue_hw_ctx || !nr_hw_queues)
+		goto out;
+	err = read_word_array(prog, queue_hw_ctx, nr_hw_queues, &hctxs);
+	if (err)
+		goto out;
+	for (i = 0; i < nr_hw_queues; i++) {
+		if (hctxs[i] && !blk_mq_address_vector_append(ret, &hctxs[i])) {
+			err = &drgn_enomem;
+			break;
+		}
+	}
+	free(hctxs);
+out:
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+static uint64_t blk_mq_rq_value(const struct blk_mq_inflight_state *state,
+				const char *buf, size_t member)
+{
+	if (!state->has_member[member])
+		return 0;
+	return task_snapshot_value(buf, &state->plan, &state->members[member],
+				   state->little_endian);
+}
+
+/* Add the in-flight requests of a batch read into buf to the result. */
+static struct drgn_error *
+blk_mq_inflight_batch(struct blk_mq_inflight_state *state,
+		      const uint64_t *rqs, const uint32_t *tags, size_t n,
+		      const char *buf)
+{
+	struct linux_helper_blk_mq_request_vector *vec = &state->requests;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		const char *rq_buf = buf + i * state->plan.window;
+		struct linux_helper_blk_mq_request *request;
+		uint64_t tag;
+
+		/*
+		 * The request array keeps completed requests until their tags
+		 * are reused, and the tags may be shared with other queues.
+		 */
+		tag = blk_mq_rq_value(state, rq_buf, BLK_MQ_RQ_TAG);
+		if (blk_mq_rq_value(state, rq_buf, BLK_MQ_RQ_STATE) !=
+		    state->in_flight ||
+		    blk_mq_rq_value(state, rq_buf, BLK_MQ_RQ_Q) != state->q ||
+		    (uint32_t)tag != tags[i])
+			continue;
+		request = linux_helper_blk_mq_request_vector_append_entry(vec);
+		if (!request)
+			return &drgn_enomem;
+		request->request = rqs[i];
+		if (state->has_member[BLK_MQ_RQ_DISK]) {
+			request->disk = blk_mq_rq_value(state, rq_buf,
+							BLK_MQ_RQ_DISK);
+		} else {
+			request->disk = state->q_disk;
+		}
+		request->start_time_ns =
+			blk_mq_rq_value(state, rq_buf, BLK_MQ_RQ_START_TIME);
+		request->io_start_time_ns =
+			blk_mq_rq_value(state, rq_buf, BLK_MQ_RQ_IO_START_TIME);
+		request->sector = blk_mq_rq_value(state, rq_buf,
+						  BLK_MQ_RQ_SECTOR);
+		request->data_len = blk_mq_rq_value(state, rq_buf,
+						    BLK_MQ_RQ_DATA_LEN);
+		request->cmd_flags = blk_mq_rq_value(state, rq_buf,
+						     BLK_MQ_RQ_CMD_FLAGS);
+		request->tag = tags[i];
+	}
+	return NULL;
+}
+
+/* Scan the request array of one set of tags. */
+static struct drgn_error *
+blk_mq_inflight_tags(struct blk_mq_inflight_state *state, uint64_t tags,
+		     char *buf, struct drgn_memory_read_request *requests)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = state->prog;
+	uint64_t rqs_address, nr_tags;
+	uint64_t *rqs;
+	uint64_t batch[TASK_SNAPSHOT_BATCH_SIZE];
+	uint32_t batch_tags[TASK_SNAPSHOT_BATCH_SIZE];
+	size_t n = 0, i;
+
+	err = drgn_program_read_word(prog, tags + state->tags_rqs, false,
+				     &rqs_address);
+	if (err)
+		return err;
+	err = drgn_program_read_memory(prog, &nr_tags,
+				       tags + state->tags_nr_tags.offset,
+				       state->tags_nr_tags.size, false);
+	if (err)
+		return err;
+	nr_tags = deserialize_bits(&nr_tags, 0, 8 * state->tags_nr_tags.size,
+				   state->little_endian);
+	if (!rqs_address || !nr_tags)
+		return NULL;
+	if (nr_tags > UINT32_MAX) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "blk_mq_tags is corrupted");
+	}
+	err = read_word_array(prog, rqs_address, nr_tags, &rqs);
+	if (err)
+		return err;
+	for (i = 0; i < nr_tags; i++) {
+		if (!rqs[i])
+			continue;
+		batch[n] = rqs[i];
+		batch_tags[n] = i;
+		if (++n < TASK_SNAPSHOT_BATCH_SIZE && i + 1 < nr_tags)
+			continue;
+		err = task_snapshot_plan_read(prog, &state->plan, batch, n,
+					      buf, requests);
+		if (!err)
+			err = blk_mq_inflight_batch(state, batch, batch_tags,
+						    n, buf);
+		if (err)
+			goto out;
+		n = 0;
+	}
+	if (n) {
+		err = task_snapshot_plan_read(prog, &state->plan, batch, n,
+					      buf, requests);
+		if (!err)
+			err = blk_mq_inflight_batch(state, batch, batch_tags,
+						    n, buf);
+	}
+out:
+	free(rqs);
+	return err;
+}
+
+struct drgn_error *
+linux_helper_blk_mq_inflight(const struct drgn_object *q,
+			     struct linux_helper_blk_mq_request **requests_ret,
+			     size_t *num_ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = q->prog;
+	struct blk_mq_inflight_state state = {
+		.prog = prog,
+		.little_endian = drgn_program_is_little_endian(prog),
+		.requests = VECTOR_INIT,
+	};
+	struct blk_mq_address_vector hctxs = VECTOR_INIT;
+	struct blk_mq_address_vector tags = VECTOR_INIT;
+	struct drgn_memory_read_request *requests = NULL;
+	struct drgn_object tmp;
+	char *buf = NULL;
+	size_t i, j;
+
+	drgn_object_init(&tmp, prog);
+	err = blk_mq_inflight_layout(&state);
+	if (err)
+		goto out;
+	err = drgn_object_read_unsigned(q, &state.q);
+	if (err)
+		goto out;
+	err = drgn_program_find_object(prog, "MQ_RQ_IN_FLIGHT", NULL,
+				       DRGN_FIND_OBJECT_CONSTANT, &tmp);
+	if (!err)
+		err = drgn_object_read_unsigned(&tmp, &state.in_flight);
+	if (err)
+		goto out;
+	if (!state.has_member[BLK_MQ_RQ_DISK]) {
+		/* Since Linux 5.18, the disk is only in the request queue. */
+		err = drgn_object_member_dereference(&tmp, q, "disk");
+		if (!err)
+			err = drgn_object_read_unsigned(&tmp, &state.q_disk);
+		if (err && err->code == DRGN_ERROR_LOOKUP) {
+			drgn_error_destroy(err);
+			err = NULL;
+		}
+		if (err)
+			goto out;
+	}
+
+	err = blk_mq_hctxs(q, &hctxs);
+	if (err)
+		goto out;
+	/* Shared tags are the same for every hardware context. */
+	for (i = 0; i < hctxs.size; i++) {
+		uint64_t hctx_tags, address = hctxs.data[i] + state.hctx_tags;
+
+		err = drgn_program_read_word(prog, address, false, &hctx_tags);
+		if (err)
+			goto out;
+		if (!hctx_tags)
+			continue;
+		for (j = 0; j < tags.size; j++) {
+			if (tags.data[j] == hctx_tags)
+				break;
+		}
+		if (j == tags.size &&
+		    !blk_mq_address_vector_append(&tags, &hctx_tags)) {
+			err = &drgn_enomem;
+			goto out;
+		}
+	}
+
+	buf = malloc_array(TASK_SNAPSHOT_BATCH_SIZE, state.plan.window);
+	requests = malloc_array(TASK_SNAPSHOT_BATCH_SIZE * state.plan.num_spans,
+				sizeof(*requests));
+	if (!buf || !requests) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	for (i = 0; i < tags.size; i++) {
+		err = blk_mq_inflight_tags(&state, tags.data[i], buf,
+					   requests);
+		if (err)
+			goto out;
+	}
+	err = NULL;
+out:
+	free(requests);
+	free(buf);
+	blk_mq_address_vector_deinit(&tags);
+	blk_mq_address_vector_deinit(&hctxs);
+	drgn_object_deinit(&tmp);
+	if (err) {
+		linux_helper_blk_mq_request_vector_deinit(&state.requests);
+		return err;
+	}
+	linux_helper_blk_mq_request_vector_shrink_to_fit(&state.requests);
+	*requests_ret = state.requests.data;
+	*num_ret = state.requests.size;
+	return NULL;
+}
+
+/* Maximum number of timers, in case a timer list is corrupted. */
+#define PENDING_TIMERS_MAX (UINT64_C(1) << 26)
+
+DEFINE_VECTOR(linux_helper_timer_vector, struct linux_helper_timer)
+
+/* Layout of the structures read by linux_helper_pending_timers(). */
+struct pending_timers_state {
+	struct drgn_program *prog;
+	bool little_endian;
+	uint64_t word_size;
+	/* Per-CPU timer_bases and hrtimer_bases. */
+	uint64_t timer_bases, num_timer_bases, timer_base_size;
+	uint64_t hrtimer_bases;
+	/* struct timer_base. */
+	uint64_t vectors, wheel_size;
+	/* struct timer_list, which is read in one read. */
+	uint64_t timer_list_size, entry, entry_next;
+	struct task_snapshot_range timer_list_expires, timer_list_function;
+	/* struct hrtimer_cpu_base and struct hrtimer_clock_base. */
+	uint64_t clock_base, num_clock_bases, clock_base_size, active_root;
+	struct drgn_qualified_type root_type;
+	/* struct hrtimer, which is read in one read. */
+	uint64_t hrtimer_size, hrtimer_node;
+	struct task_snapshot_range hrtimer_expires, hrtimer_function;
+	/*
+	 * Addresses of callbacks with known owners (0 if not found), and the
+	 * offsets from the timer to the owner or to a pointer to the owner.
+	 */
+	uint64_t hrtimer_wakeup, sleeper_task;
+	uint64_t process_timeout, process_timer_task;
+	uint64_t delayed_work_timer_fn, delayed_work_timer;
+	char *buf;
+	struct linux_helper_timer_vector timers;
+};
+
+/* Get the address of a function, or 0 if it doesn't exist. */
+static struct drgn_error *pending_timers_function(struct drgn_program *prog,
+						  const char *name,
+						  uint64_t *ret)
+{
+	struct drgn_error *err;
+	struct drgn_object tmp;
+
+	drgn_object_init(&tmp, prog);
+	err = drgn_program_find_object(prog, name, NULL,
+				       DRGN_FIND_OBJECT_FUNCTION, &tmp);
+	if (!err) {
+		*ret = tmp.is_reference ? tmp.reference.address : 0;
+	} else if (err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		*ret = 0;
+		err = NULL;
+	}
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+/*
+ * Get the offset of a member of a structure containing a timer relative to the
+ * timer. If the structure or either member doesn't exist, *function_ret is set
+ * to 0 so that the owner isn't looked up.
+ */
+static struct drgn_error *pending_timers_owner(struct drgn_program *prog,
+					       const char *type_name,
+					       const char *timer_member,
+					       const char *owner_member,
+					       uint64_t *function_ret,
+					       uint64_t *ret)
+{
+	struct drgn_error *err;
+	struct drgn_qualified_type type;
+	uint64_t timer_offset, owner_offset = 0;
+
+	if (!*function_ret)
+		return NULL;
+	err = drgn_program_find_type(prog, type_name, NULL, &type);
+	if (!err)
+		err = member_offset(prog, type.type, timer_member,
+				    &timer_offset);
+	if (!err && owner_member)
+		err = member_offset(prog, type.type, owner_member,
+				    &owner_offset);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		*function_ret = 0;
+		return NULL;
+	}
+	if (err)
+		return err;
+	*ret = owner_offset - timer_offset;
+	return NULL;
+}
+
+/* Get the address and number of elements of a per-CPU array variable. */
+static struct drgn_error *pending_timers_bases(struct drgn_program *prog,
+					       const char *name,
+					       uint64_t *address_ret,
+					       uint64_t *length_ret,
+					       uint64_t *element_size_ret)
+{
+	struct drgn_error *err;
+	struct drgn_object tmp;
+	struct drgn_type *type;
+
+	drgn_object_init(&tmp, prog);
+	err = drgn_program_find_object(prog, name, NULL,
+				       DRGN_FIND_OBJECT_VARIABLE, &tmp);
+	if (err)
+		goto out;
+	type = drgn_underlying_type(tmp.type);
+	if (!tmp.is_reference ||
+	    (length_ret && (drgn_type_kind(type) != DRGN_TYPE_ARRAY ||
+			    !drgn_type_is_complete(type)))) {
+		err = drgn_error_format(DRGN_ERROR_TYPE,
+					"%s is not %s", name,
+					length_ret ? "an array" : "a variable");
+		goto out;
+	}
+	*address_ret = tmp.reference.address;
+	if (length_ret) {
+		*length_ret = drgn_type_length(type);
+		err = drgn_type_sizeof(drgn_type_type(type).type,
+				       element_size_ret);
+	}
+out:
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+static struct drgn_error *
+pending_timers_layout(struct pending_timers_state *state)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = state->prog;
+	struct drgn_qualified_type timer_base_type, timer_list_type;
+	struct drgn_qualified_type cpu_base_type, clock_base_type, hrtimer_type;
+	struct drgn_member_info member;
+	struct drgn_type *type;
+
+	/*
+	 * The current timer wheel was added in Linux kernel commit
+	 * 500462a9de65 ("timers: Switch to a non-cascading wheel") (in v4.8).
+	 */
+	err = pending_timers_bases(prog, "timer_bases", &state->timer_bases,
+				   &state->num_timer_bases,
+				   &state->timer_base_size);
+	if (err)
+		return err;
+	err = pending_timers_bases(prog, "hrtimer_bases",
+				   &state->hrtimer_bases, NULL, NULL);
+	if (err)
+		return err;
+
+	err = drgn_program_find_type(prog, "struct timer_base", NULL,
+				     &timer_base_type);
+	if (err)
+		return err;
+	err = drgn_program_member_info(prog, timer_base_type.type, "vectors",
+				       &member);
+	if (err)
+		return err;
+	type = drgn_underlying_type(member.qualified_type.type);
+	if (member.bit_offset % 8 || drgn_type_kind(type) != DRGN_TYPE_ARRAY) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "timer_base vectors member is not an array");
+	}
+	state->vectors = member.bit_offset / 8;
+	state->wheel_size = drgn_type_length(type);
+
+	err = drgn_program_find_type(prog, "struct timer_list", NULL,
+				     &timer_list_type);
+	if (err)
+		return err;
+	err = drgn_type_sizeof(timer_list_type.type, &state->timer_list_size);
+	if (err)
+		return err;
+	if ((err = member_offset(prog, timer_list_type.type, "entry",
+				 &state->entry)) ||
+	    (err = member_offset(prog, timer_list_type.type, "entry.next",
+				 &state->entry_next)) ||
+	    (err = task_snapshot_member(prog, timer_list_type.type, "expires",
+					8, &state->timer_list_expires)) ||
+	    (err = task_snapshot_member(prog, timer_list_type.type, "function",
+					8, &state->timer_list_function)))
+		return err;
+
+	err = drgn_program_find_type(prog, "struct hrtimer_cpu_base", NULL,
+				     &cpu_base_type);
+	if (err)
+		return err;
+	err = drgn_program_member_info(prog, cpu_base_type.type, "clock_base",
+				       &member);
+	if (err)
+		return err;
+	type = drgn_underlying_type(member.qualified_type.type);
+	if (member.bit_offset % 8 || drgn_type_kind(type) != DRGN_TYPE_ARRAY) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "hrtimer_cpu_base clock_base member is not an array");
+	}
+	state->clock_base = member.bit_offset / 8;
+	state->num_clock_bases = drgn_type_length(type);
+	err = drgn_program_find_type(prog, "struct hrtimer_clock_base", NULL,
+				     &clock_base_type);
+	if (err)
+		return err;
+	err = drgn_type_sizeof(clock_base_type.type, &state->clock_base_size);
+	if (err)
+		return err;
+	/*
+	 * Since Linux kernel commit 511885d7061e ("lib/timerqueue: Rely on
+	 * rbtree semantics for next timer") (in v5.0), the timer queue is an
+	 * rb_root_cached.
+	 */
+	err = drgn_program_member_info(prog, clock_base_type.type,
+				       "active.rb_root.rb_root", &member);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		err = drgn_program_member_info(prog, clock_base_type.type,
+					       "active.head", &member);
+	}
+	if (err)
+		return err;
+	state->active_root = member.bit_offset / 8;
+	state->root_type = member.qualified_type;
+
+	err = drgn_program_find_type(prog, "struct hrtimer", NULL,
+				     &hrtimer_type);
+	if (err)
+		return err;
+	err = drgn_type_sizeof(hrtimer_type.type, &state->hrtimer_size);
+	if (err)
+		return err;
+	if ((err = member_offset(prog, hrtimer_type.type, "node.node",
+				 &state->hrtimer_node)) ||
+	    (err = task_snapshot_member(prog, hrtimer_type.type,
+					"node.expires", 8,
+					&state->hrtimer_expires)) ||
+	    (err = task_snapshot_member(prog, hrtimer_type.type, "function", 8,
+					&state->hrtimer_function)))
+		return err;
+	if (state->entry_next + state->word_size > state->timer_list_size) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "timer_list entry member is invalid");
+	}
+
+	if ((err = pending_timers_function(prog, "hrtimer_wakeup",
+					   &state->hrtimer_wakeup)) ||
+	    (err = pending_timers_owner(prog, "struct hrtimer_sleeper",
+					"timer", "task", &state->hrtimer_wakeup,
+					&state->sleeper_task)) ||
+	    (err = pending_timers_function(prog, "process_timeout",
+					   &state->process_timeout)) ||
+	    (err = pending_timers_owner(prog, "struct process_timer", "timer",
+					"task", &state->process_timeout,
+					&state->process_timer_task)) ||
+	    (err = pending_timers_function(prog, "delayed_work_timer_fn",
+					   &state->delayed_work_timer_fn)))
+		return err;
+	return pending_timers_owner(prog, "struct delayed_work", "timer", NULL,
+				    &state->delayed_work_timer_fn,
+				    &state->delayed_work_timer);
+}
+
+static uint64_t pending_timers_value(const struct pending_timers_state *state,
+				     const struct task_snapshot_range *member)
+{
+	return deserialize_bits(state->buf + member->offset, 0,
+				member->size * 8, state->little_endian);
+}
+
+/* Add a timer, looking up its owner if its callback is a known one. */
+static struct drgn_error *
+pending_timers_add(struct pending_timers_state *state, uint64_t timer,
+		   uint64_t expires, uint64_t function, uint64_t cpu,
+		   uint64_t base, enum linux_helper_timer_kind kind)
+{
+	struct drgn_error *err;
+	struct linux_helper_timer *entry;
+	uint64_t owner = 0;
+
+	if (state->timers.size >= PENDING_TIMERS_MAX) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "too many timers or timer list is corrupted");
+	}
+	if (kind == LINUX_HELPER_TIMER_HRTIMER && function &&
+	    function == state->hrtimer_wakeup) {
+		err = drgn_program_read_word(state->prog,
+					     timer + state->sleeper_task,
+					     false, &owner);
+		if (err)
+			return err;
+	} else if (kind == LINUX_HELPER_TIMER_LIST && function &&
+		   function == state->process_timeout) {
+		err = drgn_program_read_word(state->prog,
+					     timer + state->process_timer_task,
+					     false, &owner);
+		if (err)
+			return err;
+	} else if (kind == LINUX_HELPER_TIMER_LIST && function &&
+		   function == state->delayed_work_timer_fn) {
+		owner = timer + state->delayed_work_timer;
+	}
+
+	entry = linux_helper_timer_vector_append_entry(&state->timers);
+	if (!entry)
+		return &drgn_enomem;
+	entry->timer = timer;
+	entry->expires = expires;
+	entry->function = function;
+	entry->owner = owner;
+	entry->cpu = cpu;
+	entry->base = base;
+	entry->kind = kind;
+	return NULL;
+}
+
+/* Walk the buckets of one timer wheel. */
+static struct drgn_error *
+pending_timers_wheel(struct pending_timers_state *state, uint64_t timer_base,
+		     uint64_t cpu, uint64_t base)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = state->prog;
+	uint64_t *heads;
+	size_t i;
+
+	err = read_word_array(prog, timer_base + state->vectors,
+			      state->wheel_size, &heads);
+	if (err)
+		return err;
+	for (i = 0; i < state->wheel_size; i++) {
+		uint64_t node = heads[i];
+
+		/*
+		 * Each timer is read in one read, which includes the link to
+		 * the next timer in the bucket.
+		 */
+		while (node) {
+			uint64_t timer = node - state->entry;
+			uint64_t expires, function;
+
+			err = drgn_program_read_memory(prog, state->buf, timer,
+						       state->timer_list_size,
+						       false);
+			if (err)
+				goto out;
+			expires = pending_timers_value(state,
+						       &state->timer_list_expires);
+			function = pending_timers_value(state,
+							&state->timer_list_function);
+			err = pending_timers_add(state, timer, expires,
+						 function, cpu, base,
+						 LINUX_HELPER_TIMER_LIST);
+			if (err)
+				goto out;
+			node = drgn_program_decode_word(prog,
+							state->buf +
+							state->entry_next);
+		}
+	}
+	err = NULL;
+out:
+	free(heads);
+	return err;
+}
+
+/* Walk the red-black tree of one hrtimer clock base. */
+static struct drgn_error *
+pending_timers_clock_base(struct pending_timers_state *state,
+			  uint64_t clock_base, uint64_t cpu, uint64_t base)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = state->prog;
+	struct linux_helper_rbtree_iterator it;
+	struct drgn_object root;
+	uint64_t node;
+
+	drgn_object_init(&root, prog);
+	err = drgn_object_set_reference(&root, state->root_type,
+					clock_base + state->active_root, 0, 0,
+					DRGN_PROGRAM_ENDIAN);
+	if (err)
+		goto out;
+	err = linux_helper_rbtree_iterator_init(&it, &root, NULL);
+	if (err)
+		goto out;
+	while (!(err = linux_helper_rbtree_iterator_next(&it, &node))) {
+		uint64_t timer = node - state->hrtimer_node;
+		uint64_t expires, function;
+
+		err = drgn_program_read_memory(prog, state->buf, timer,
+					       state->hrtimer_size, false);
+		if (err)
+			goto out;
+		expires = pending_timers_value(state, &state->hrtimer_expires);
+		function = pending_timers_value(state,
+						&state->hrtimer_function);
+		err = pending_timers_add(state, timer, expires, function, cpu,
+					 base, LINUX_HELPER_TIMER_HRTIMER);
+		if (err)
+			goto out;
+	}
+	if (err == &drgn_stop)
+		err = NULL;
+out:
+	drgn_object_deinit(&root);
+	return err;
+}
+
+struct drgn_error *
+linux_helper_pending_timers(struct drgn_program *prog,
+			    struct linux_helper_timer **timers_ret,
+			    size_t *num_ret)
+{
+	struct drgn_error *err;
+	struct pending_timers_state state = {
+		.prog = prog,
+		.little_endian = drgn_program_is_little_endian(prog),
+		.word_size = drgn_program_is_64_bit(prog) ? 8 : 4,
+		.timers = VECTOR_INIT,
+	};
+	uint64_t *cpus = NULL;
+	size_t num_cpus, i;
+	uint64_t j;
+
+	err = pending_timers_layout(&state);
+	if (err)
+		return err;
+	state.buf = malloc(max(state.timer_list_size, state.hrtimer_size));
+	if (!state.buf)
+		return &drgn_enomem;
+	err = linux_helper_cpumask_cpus(prog, NULL, &cpus, &num_cpus);
+	if (err)
+		goto out;
+	for (i = 0; i < num_cpus; i++) {
+		uint64_t offset;
+
+		err = per_cpu_offset(prog, cpus[i], &offset);
+		if (err)
+			goto out;
+		for (j = 0; j < state.num_timer_bases; j++) {
+			err = pending_timers_wheel(&state,
+						   state.timer_bases + offset +
+						   j * state.timer_base_size,
+						   cpus[i], j);
+			if (err)
+				goto out;
+		}
+		for (j = 0; j < state.num_clock_bases; j++) {
+			uint64_t clock_base = state.hrtimer_bases + offset +
+					      state.clock_base +
+					      j * state.clock_base_size;
+
+			err = pending_timers_clock_base(&state, clock_base,
+							cpus[i], j);
+			if (err)
+				goto out;
+		}
+	}
+	err = NULL;
+out:
+	free(cpus);
+	free(state.buf);
+	if (err) {
+		linux_helper_timer_vector_deinit(&state.timers);
+		return err;
+	}
+	linux_helper_timer_vector_shrink_to_fit(&state.timers);
+	*timers_ret = state.timers.data;
+	*num_ret = state.timers.size;
+	return NULL;
+}
+
+/*
+ * Offsets in the stack depot are in units of 1 << DEPOT_STACK_ALIGN
+ * (STACK_ALLOC_ALIGN before Linux 6.1), which is a macro.
+ */
+static const uint64_t STACK_DEPOT_ALIGN = 4;
+/* Maximum number of entries in a stack record, in case it is corrupted. */
+static const uint64_t STACK_DEPOT_MAX_ENTRIES = 4096;
+/* Bit of mem_section::page_ext for sections whose page_ext is invalid. */
+static const uint64_t PAGE_EXT_INVALID = 1;
+
+/* Layout of the stack depot. */
+struct stack_depot {
+	struct drgn_program *prog;
+	bool little_endian;
+	/* Address of the array of pools (called slabs before Linux 6.3). */
+	uint64_t pools, num_pools;
+	/* Bit fields of union handle_parts. */
+	uint64_t index_shift, index_bits, offset_shift, offset_bits;
+	/* Whether the index is pool_index_plus_1 (since Linux 6.9). */
+	bool index_plus_1;
+	/* struct stack_record. */
+	struct task_snapshot_range record_size;
+	uint64_t record_entries;
+};
+
+/* Get the shift and size of a handle_parts bit field. */
+static struct drgn_error *stack_depot_bit_field(struct stack_depot *depot,
+					       struct drgn_type *type,
+					       const char *name,
+					       uint64_t *shift_ret,
+					       uint64_t *bits_ret)
+{
+	struct drgn_error *err;
+	struct drgn_member_info member;
+
+	err = drgn_program_member_info(depot->prog, type, name, &member);
+	if (err)
+		return err;
+	if (!member.bit_field_size || member.bit_offset +
+	    member.bit_field_size > 32) {
+		return drgn_error_format(DRGN_ERROR_TYPE,
+					 "unsupported handle_parts %s member",
+					 name);
+	}
+	*shift_ret = depot->little_endian ?
+		     member.bit_offset :
+		     32 - member.bit_offset - member.bit_field_size;
+	*bits_ret = member.bit_field_size;
+	return NULL;
+}
+
+static struct drgn_error *stack_depot_init(struct stack_depot *depot,
+					   struct drgn_program *prog)
+{
+	struct drgn_error *err;
+	struct drgn_object tmp;
+	struct drgn_qualified_type parts_type, record_type;
+	struct drgn_type *type;
+
+	depot->prog = prog;
+	depot->little_endian = drgn_program_is_little_endian(prog);
+	drgn_object_init(&tmp, prog);
+	err = drgn_program_find_object(prog, "stack_pools", NULL,
+				       DRGN_FIND_OBJECT_VARIABLE, &tmp);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		err = drgn_program_find_object(prog, "stack_slabs", NULL,
+					       DRGN_FIND_OBJECT_VARIABLE,
+					       &tmp);
+	}
+	if (err)
+		goto out;
+	type = drgn_underlying_type(tmp.type);
+	if (drgn_type_kind(type) == DRGN_TYPE_ARRAY && tmp.is_reference &&
+	    drgn_type_is_complete(type)) {
+		depot->pools = tmp.reference.address;
+		depot->num_pools = drgn_type_length(type);
+	} else if (drgn_type_kind(type) == DRGN_TYPE_POINTER) {
+		/* Bounded by the index bits below. */
+		err = drgn_object_read_unsigned(&tmp, &depot->pools);
+		if (err)
+			goto out;
+		depot->num_pools = UINT64_MAX;
+	} else {
+		err = drgn_error_create(DRGN_ERROR_TYPE,
+					"stack depot pools are not an array");
+		goto out;
+	}
+
+	err = drgn_program_find_type(prog, "union handle_parts", NULL,
+				     &parts_type);
+	if (err)
+		goto out;
+	depot->index_plus_1 = false;
+	err = stack_depot_bit_field(depot, parts_type.type, "pool_index",
+				    &depot->index_shift, &depot->index_bits);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		depot->index_plus_1 = true;
+		err = stack_depot_bit_field(depot, parts_type.type,
+					    "pool_index_plus_1",
+					    &depot->index_shift,
+					    &depot->index_bits);
+	}
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		depot->index_plus_1 = false;
+		err = stack_depot_bit_field(depot, parts_type.type,
+					    "slabindex", &depot->index_shift,
+					    &depot->index_bits);
+	}
+	if (err)
+		goto out;
+	err = stack_depot_bit_field(depot, parts_type.type, "offset",
+				    &depot->offset_shift, &depot->offset_bits);
+	if (err)
+		goto out;
+
+	err = drgn_program_find_type(prog, "struct stack_record", NULL,
+				     &record_type);
+	if (err)
+		goto out;
+	err = task_snapshot_member(prog, record_type.type, "size", 8,
+				   &depot->record_size);
+	if (err)
+		goto out;
+	err = member_offset(prog, record_type.type, "entries",
+			    &depot->record_entries);
+out:
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+/* Get the program counters of a stack depot handle like stack_depot_fetch(). */
+static struct drgn_error *stack_depot_fetch(struct stack_depot *depot,
+					    uint32_t handle, uint64_t **pcs_ret,
+					    size_t *num_ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = depot->prog;
+	uint64_t word_size = drgn_program_is_64_bit(prog) ? 8 : 4;
+	uint64_t index, offset, pool, record, size;
+	char buf[8];
+
+	*pcs_ret = NULL;
+	*num_ret = 0;
+	if (!handle)
+		return NULL;
+	index = (handle >> depot->index_shift) &
+		((UINT64_C(1) << depot->index_bits) - 1);
+	offset = (handle >> depot->offset_shift) &
+		 ((UINT64_C(1) << depot->offset_bits) - 1);
+	if (depot->index_plus_1) {
+		if (!index)
+			return NULL;
+		index--;
+	}
+	if (index >= depot->num_pools) {
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "invalid stack depot handle 0x%" PRIx32,
+					 handle);
+	}
+	err = drgn_program_read_word(prog, depot->pools + index * word_size,
+				     false, &pool);
+	if (err)
+		return err;
+	if (!pool) {
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "invalid stack depot handle 0x%" PRIx32,
+					 handle);
+	}
+	record = pool + (offset << STACK_DEPOT_ALIGN);
+	err = drgn_program_read_memory(prog, buf,
+				       record + depot->record_size.offset,
+				       depot->record_size.size, false);
+	if (err)
+		return err;
+	size = deserialize_bits(buf, 0, depot->record_size.size * 8,
+				depot->little_endian);
+	if (size > STACK_DEPOT_MAX_ENTRIES) {
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "stack depot record for handle 0x%" PRIx32 " is corrupted",
+					 handle);
+	}
+	if (!size)
+		return NULL;
+	err = read_word_array(prog, record + depot->record_entries, size,
+			      pcs_ret);
+	if (err)
+		return err;
+	*num_ret = size;
+	return NULL;
+}
+
+/* Layout of page_ext and page_owner. */
+struct page_owner_layout {
+	/* page_ext_size, which includes the data of every page_ext user. */
+	uint64_t page_ext_size;
+	/* Offset of page_ext in struct mem_section. */
+	uint64_t section_page_ext;
+	uint64_t flags_offset, flags_size, allocated_bit;
+	/* Offset of struct page_owner in each page_ext. */
+	uint64_t owner;
+	/* Members of struct page_owner relative to owner. */
+	struct task_snapshot_range order, handle;
+};
+
+static struct drgn_error *
+page_owner_layout_init(struct drgn_program *prog,
+		       struct page_owner_layout *layout)
+{
+	struct drgn_error *err;
+	struct drgn_object tmp;
+	struct drgn_qualified_type type;
+	struct task_snapshot_range range;
+
+	drgn_object_init(&tmp, prog);
+	err = drgn_program_find_object(prog, "page_ext_size", NULL,
+				       DRGN_FIND_OBJECT_VARIABLE, &tmp);
+	if (!err)
+		err = drgn_object_read_unsigned(&tmp, &layout->page_ext_size);
+	if (err)
+		goto out;
+	err = drgn_program_find_object(prog, "page_owner_ops", NULL,
+				       DRGN_FIND_OBJECT_VARIABLE, &tmp);
+	if (err)
+		goto out;
+	err = drgn_object_member(&tmp, &tmp, "offset");
+	if (!err)
+		err = drgn_object_read_unsigned(&tmp, &layout->owner);
+	if (err)
+		goto out;
+	/*
+	 * Since Linux kernel commit fdf3bf809162 ("mm, page_owner: record page
+	 * owner for each subpage") (in v5.4), PAGE_EXT_OWNER is set even after
+	 * the page is freed, and PAGE_EXT_OWNER_ALLOCATED is set while it is
+	 * allocated.
+	 */
+	err = drgn_program_find_object(prog, "PAGE_EXT_OWNER_ALLOCATED", NULL,
+				       DRGN_FIND_OBJECT_CONSTANT, &tmp);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		err = drgn_program_find_object(prog, "PAGE_EXT_OWNER", NULL,
+					       DRGN_FIND_OBJECT_CONSTANT,
+					       &tmp);
+	}
+	if (!err)
+		err = drgn_object_read_unsigned(&tmp, &layout->allocated_bit);
+	if (err)
+		goto out;
+
+	err = drgn_program_find_type(prog, "struct page_ext", NULL, &type);
+	if (err)
+		goto out;
+	err = task_snapshot_member(prog, type.type, "flags", 8, &range);
+	if (err)
+		goto out;
+	layout->flags_offset = range.offset;
+	layout->flags_size = range.size;
+	if (layout->allocated_bit >= 8 * range.size) {
+		err = drgn_error_create(DRGN_ERROR_OTHER,
+					"invalid page_ext flag");
+		goto out;
+	}
+	err = drgn_program_find_type(prog, "struct page_owner", NULL, &type);
+	if (err)
+		goto out;
+	if ((err = task_snapshot_member(prog, type.type, "order", 8,
+					&layout->order)) ||
+	    (err = task_snapshot_member(prog, type.type, "handle", 4,
+					&layout->handle)))
+		goto out;
+	if (layout->flags_offset + layout->flags_size > layout->page_ext_size ||
+	    layout->owner + layout->order.offset + layout->order.size >
+	    layout->page_ext_size ||
+	    layout->owner + layout->handle.offset + layout->handle.size >
+	    layout->page_ext_size) {
+		err = drgn_error_create(DRGN_ERROR_OTHER,
+					"page_ext_size is invalid");
+		goto out;
+	}
+
+	err = drgn_program_find_type(prog, "struct mem_section", NULL, &type);
+	if (err)
+		goto out;
+	err = member_offset(prog, type.type, "page_ext",
+			    &layout->section_page_ext);
+out:
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+/* Map from a stack depot handle to its index in the stacks. */
+DEFINE_HASH_MAP(page_owner_stack_map, uint32_t, size_t, hash_pair_int_type,
+		hash_table_scalar_eq)
+DEFINE_VECTOR(linux_helper_page_owner_stack_vector,
+	      struct linux_helper_page_owner_stack)
+
+static int page_owner_stack_cmp(const void *_a, const void *_b)
+{
+	const struct linux_helper_page_owner_stack *a = _a, *b = _b;
+
+	if (a->pages != b->pages)
+		return a->pages > b->pages ? -1 : 1;
+	if (a->handle != b->handle)
+		return a->handle < b->handle ? -1 : 1;
+	return 0;
+}
+
+/* Count an allocation from the page_owner record of its first page. */
+static struct drgn_error *
+page_owner_add(struct page_owner_stack_map *map,
+	       struct linux_helper_page_owner_stack_vector *stacks,
+	       uint32_t handle, uint64_t order)
+{
+	struct page_owner_stack_map_entry entry = {
+		.key = handle,
+		.value = stacks->size,
+	};
+	struct page_owner_stack_map_iterator it;
+	struct linux_helper_page_owner_stack *stack;
+	int r;
+
+	r = page_owner_stack_map_insert(map, &entry, &it);
+	if (r == -1)
+		return &drgn_enomem;
+	if (r == 1) {
+		stack = linux_helper_page_owner_stack_vector_append_entry(stacks);
+		if (!stack)
+			return &drgn_enomem;
+		stack->handle = handle;
+		stack->allocations = 0;
+		stack->pages = 0;
+		stack->pcs = NULL;
+		stack->num_pcs = 0;
+	} else {
+		stack = &stacks->data[it.entry->value];
+	}
+	stack->allocations++;
+	stack->pages += UINT64_C(1) << order;
+	return NULL;
+}
+
+struct drgn_error *
+linux_helper_page_owner_stacks(struct drgn_program *prog,
+			       struct linux_helper_page_owner_stack **stacks_ret,
+			       size_t *num_ret)
+{
+	struct drgn_error *err;
+	bool little_endian = drgn_program_is_little_endian(prog);
+	struct page_owner_layout layout;
+	struct stack_depot depot;
+	struct linux_helper_page_iterator it;
+	struct page_owner_stack_map map;
+	struct linux_helper_page_owner_stack_vector stacks = VECTOR_INIT;
+	/* page_ext entries of the PFNs [buf_pfn, buf_pfn + buf_count). */
+	char *buf = NULL;
+	uint64_t buf_pfn = 0, buf_count = 0;
+	bool buf_valid = false;
+	uint64_t pfn;
+	size_t i;
+
+	page_owner_stack_map_init(&map);
+	err = linux_helper_page_iterator_init(&it, prog, 0, 0);
+	if (err)
+		goto out;
+	if (!it.mem_section) {
+		err = drgn_error_create(DRGN_ERROR_OTHER,
+					"page_ext is only supported with CONFIG_SPARSEMEM");
+		goto out;
+	}
+	err = page_owner_layout_init(prog, &layout);
+	if (err)
+		goto out;
+	err = stack_depot_init(&depot, prog);
+	if (err)
+		goto out;
+	buf = malloc_array(LINUX_HELPER_PAGE_CHUNK, layout.page_ext_size);
+	if (!buf) {
+		err = &drgn_enomem;
+		goto out;
+	}
+
+	while (!(err = linux_helper_page_iterator_next(&it, &pfn))) {
+		const char *page_ext;
+		uint64_t flags, order, handle;
+
+		if (pfn < buf_pfn || pfn >= buf_pfn + buf_count) {
+			uint64_t section, section_page_ext;
+
+			/* A chunk is always within one section. */
+			buf_pfn = pfn & ~(uint64_t)(LINUX_HELPER_PAGE_CHUNK - 1);
+			buf_count = min(it.max_pfn - buf_pfn,
+					(uint64_t)LINUX_HELPER_PAGE_CHUNK);
+			buf_valid = false;
+			err = page_iterator_section(&it, pfn, &section);
+			if (err)
+				goto out;
+			if (!section)
+				continue;
+			err = drgn_program_read_word(prog,
+						     section +
+						     layout.section_page_ext,
+						     false, &section_page_ext);
+			if (err)
+				goto out;
+			if (!section_page_ext ||
+			    (section_page_ext & PAGE_EXT_INVALID))
+				continue;
+			/*
+			 * The section's page_ext pointer is offset so that it
+			 * can be indexed by PFN.
+			 */
+			err = drgn_program_try_read_memory(prog, buf,
+							   section_page_ext +
+							   buf_pfn *
+							   layout.page_ext_size,
+							   buf_count *
+							   layout.page_ext_size,
+							   false, &buf_valid);
+			if (err)
+				goto out;
+		}
+		if (!buf_valid)
+			continue;
+
+		page_ext = buf + (pfn - buf_pfn) * layout.page_ext_size;
+		flags = deserialize_bits(page_ext + layout.flags_offset, 0,
+					 layout.flags_size * 8, little_endian);
+		if (!(flags & (UINT64_C(1) << layout.allocated_bit)))
+			continue;
+		order = deserialize_bits(page_ext + layout.owner +
+					 layout.order.offset, 0,
+					 layout.order.size * 8, little_endian);
+		/*
+		 * Allocations are aligned to their size, so this skips all but
+		 * the first page of each allocation.
+		 */
+		if (order >= 64 || (pfn & ((UINT64_C(1) << order) - 1)))
+			continue;
+		handle = deserialize_bits(page_ext + layout.owner +
+					  layout.handle.offset, 0,
+					  layout.handle.size * 8,
+					  little_endian);
+		err = page_owner_add(&map, &stacks, handle, order);
+		if (err)
+			goto out;
+	}
+	if (err != &drgn_stop)
+		goto out;
+
+	/* Each stack is only fetched once no matter how many pages it has. */
+	for (i = 0; i < stacks.size; i++) {
+		err = stack_depot_fetch(&depot, stacks.data[i].handle,
+					&stacks.data[i].pcs,
+					&stacks.data[i].num_pcs);
+		if (err)
+			goto out;
+	}
+	qsort(stacks.data, stacks.size, sizeof(stacks.data[0]),
+	      page_owner_stack_cmp);
+	err = NULL;
+out:
+	free(buf);
+	linux_helper_page_iterator_deinit(&it);
+	page_owner_stack_map_deinit(&map);
+	if (err) {
+		linux_helper_page_owner_stacks_destroy(stacks.data,
+						       stacks.size);
+		return err;
+	}
+	linux_helper_page_owner_stack_vector_shrink_to_fit(&stacks);
+	*stacks_ret = stacks.data;
+	*num_ret = stacks.size;
+	return NULL;
+}
+
+void
+linux_helper_page_owner_stacks_destroy(struct linux_helper_page_owner_stack *stacks,
+				       size_t num)
+{
+	size_t i;
+
+	for (i = 0; i < num; i++)
+		free(stacks[i].pcs);
+	free(stacks);
+}
+
+DEFINE_VECTOR(linux_helper_runqueue_vector, struct linux_helper_runqueue)
+DEFINE_VECTOR(linux_helper_runqueue_task_vector,
+	      struct linux_helper_runqueue_task)
+
+/* Maximum number of tasks, in case a runqueue is corrupted. */
+static const uint64_t RUNQUEUES_MAX_TASKS = UINT64_C(1) << 24;
+/* Maximum depth of nested task groups, in case a runqueue is corrupted. */
+static const int RUNQUEUES_MAX_DEPTH = 64;
+
+static const char * const runqueues_class_names[] = {
+	[LINUX_HELPER_SCHED_FAIR] = "fair_sched_class",
+	[LINUX_HELPER_SCHED_RT] = "rt_sched_class",
+	[LINUX_HELPER_SCHED_DL] = "dl_sched_class",
+	[LINUX_HELPER_SCHED_IDLE] = "idle_sched_class",
+	[LINUX_HELPER_SCHED_STOP] = "stop_sched_class",
+};
+
+/* Layout of the structures read by linux_helper_runqueues(). */
+struct runqueues_state {
+	struct drgn_program *prog;
+	bool little_endian;
+	uint64_t word_size;
+	/* Per-CPU runqueues. */
+	uint64_t runqueues;
+	/*
+	 * struct rq, which is read in one read. The ranges are relative to the
+	 * struct rq, including the ones in the embedded cfs_rq, rt_rq, and
+	 * dl_rq. Optional members have a size of 0 if they don't exist.
+	 */
+	uint64_t rq_size, rq_cfs, rq_rt, rq_dl;
+	struct task_snapshot_range rq_curr, rq_clock, rq_nr_running;
+	struct task_snapshot_range cfs_nr_running, cfs_load_weight, cfs_load_avg;
+	struct task_snapshot_range rt_nr_running, dl_nr_running;
+	/* struct cfs_rq. */
+	uint64_t cfs_timeline, cfs_curr;
+	struct drgn_qualified_type cfs_root_type;
+	/* struct sched_entity, which is read in one read. */
+	uint64_t se_size, se_run_node, se_my_q;
+	bool se_has_my_q;
+	struct task_snapshot_range se_vruntime;
+	/* struct rt_rq and struct sched_rt_entity. */
+	uint64_t rt_queue, rt_queue_length, list_head_size, list_next;
+	uint64_t rt_se_run_list, rt_se_my_q;
+	bool rt_se_has_my_q;
+	/* struct dl_rq and struct sched_dl_entity, which is read in one read. */
+	uint64_t dl_root;
+	struct drgn_qualified_type dl_root_type;
+	uint64_t dl_se_size, dl_se_rb_node;
+	struct task_snapshot_range dl_se_deadline;
+	/* Bit field marking deadline servers, or 0 bits if it doesn't exist. */
+	uint64_t dl_server_bit_offset;
+	uint8_t dl_server_bit_size;
+	/* struct task_struct. */
+	uint64_t task_se, task_rt, task_dl;
+	struct task_snapshot_range task_prio, task_sched_class;
+	/* Addresses of the scheduling classes (0 if not found). */
+	uint64_t classes[ARRAY_SIZE(runqueues_class_names)];
+	char *buf;
+	/* The CPU being walked, its running task, and whether it was found. */
+	uint32_t cpu;
+	uint64_t curr;
+	bool curr_found;
+	struct linux_helper_runqueue_task_vector tasks;
+};
+
+/* Like task_snapshot_member(), but a missing member has a size of 0. */
+static struct drgn_error *
+runqueues_optional_member(struct drgn_program *prog, struct drgn_type *type,
+			  const char *member_designator,
+			  struct task_snapshot_range *ret)
+{
+	struct drgn_error *err;
+
+	err = task_snapshot_member(prog, type, member_designator, 8, ret);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		ret->offset = ret->size = 0;
+		err = NULL;
+	}
+	return err;
+}
+
+/*
+ * Get a member of struct rq by trying each of its names (it may have been
+ * renamed) and making it relative to the struct rq.
+ */
+static struct drgn_error *
+runqueues_rq_member(struct runqueues_state *state, struct drgn_type *type,
+		    uint64_t offset, const char * const *names, size_t n,
+		    bool optional, struct task_snapshot_range *ret)
+{
+	struct drgn_error *err;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		err = runqueues_optional_member(state->prog, type, names[i],
+						ret);
+		if (err)
+			return err;
+		if (ret->size) {
+			ret->offset += offset;
+			return NULL;
+		}
+	}
+	if (optional)
+		return NULL;
+	return drgn_error_format(DRGN_ERROR_LOOKUP, "no member '%s'",
+				 names[0]);
+}
+
+/*
+ * Get the offset of a pointer member which only exists with some
+ * configurations (e.g., my_q with CONFIG_FAIR_GROUP_SCHED).
+ */
+static struct drgn_error *runqueues_optional_offset(struct drgn_program *prog,
+						    struct drgn_type *type,
+						    const char *name,
+						    uint64_t *ret,
+						    bool *exists_ret)
+{
+	struct drgn_error *err;
+
+	err = member_offset(prog, type, name, ret);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		*exists_ret = false;
+		return NULL;
+	}
+	*exists_ret = !err;
+	return err;
+}
+
+/*
+ * Get the offset and type of a red-black tree root, trying the rb_root inside
+ * of an rb_root_cached first.
+ */
+static struct drgn_error *runqueues_root(struct drgn_program *prog,
+					 struct drgn_type *type,
+					 const char *cached_name,
+					 const char *name, uint64_t *ret,
+					 struct drgn_qualified_type *type_ret)
+{
+	struct drgn_error *err;
+	struct drgn_member_info member;
+
+	err = drgn_program_member_path(prog, type, cached_name, &member);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		err = drgn_program_member_path(prog, type, name, &member);
+	}
+	if (err)
+		return err;
+	*ret = member.bit_offset / 8;
+	*type_ret = member.qualified_type;
+	return NULL;
+}
+
+static struct drgn_error *runqueues_layout(struct runqueues_state *state)
+{
+	static const char * const cfs_nr_running[] = {
+		/* Renamed in Linux 6.14. */
+		"h_nr_running", "h_nr_queued",
+	};
+	static const char * const rt_nr_running[] = { "rt_nr_running" };
+	static const char * const dl_nr_running[] = { "dl_nr_running" };
+	static const char * const load_weight[] = { "load.weight" };
+	static const char * const load_avg[] = { "avg.load_avg" };
+	struct drgn_error *err;
+	struct drgn_program *prog = state->prog;
+	struct drgn_qualified_type rq_type, cfs_rq_type, rt_rq_type, dl_rq_type;
+	struct drgn_qualified_type se_type, rt_se_type, dl_se_type, task_type;
+	struct drgn_qualified_type list_head_type;
+	struct drgn_member_info member;
+	struct drgn_type *type;
+	size_t i;
+
+	err = pending_timers_bases(prog, "runqueues", &state->runqueues, NULL,
+				   NULL);
+	if (err)
+		return err;
+	if ((err = drgn_program_find_type(prog, "struct rq", NULL,
+					  &rq_type)) ||
+	    (err = drgn_program_find_type(prog, "struct cfs_rq", NULL,
+					  &cfs_rq_type)) ||
+	    (err = drgn_program_find_type(prog, "struct rt_rq", NULL,
+					  &rt_rq_type)) ||
+	    (err = drgn_program_find_type(prog, "struct dl_rq", NULL,
+					  &dl_rq_type)) ||
+	    (err = drgn_program_find_type(prog, "struct sched_entity", NULL,
+					  &se_type)) ||
+	    (err = drgn_program_find_type(prog, "struct sched_rt_entity", NULL,
+					  &rt_se_type)) ||
+	    (err = drgn_program_find_type(prog, "struct sched_dl_entity", NULL,
+					  &dl_se_type)) ||
+	    (err = drgn_program_find_type(prog, "struct task_struct", NULL,
+					  &task_type)) ||
+	    (err = drgn_program_find_type(prog, "struct list_head", NULL,
+					  &list_head_type)))
+		return err;
+
+	err = drgn_type_sizeof(rq_type.type, &state->rq_size);
+	if (err)
+		return err;
+	if ((err = member_offset(prog, rq_type.type, "cfs",
+				 &state->rq_cfs)) ||
+	    (err = member_offset(prog, rq_type.type, "rt", &state->rq_rt)) ||
+	    (err = member_offset(prog, rq_type.type, "dl", &state->rq_dl)) ||
+	    (err = task_snapshot_member(prog, rq_type.type, "curr", 8,
+					&state->rq_curr)) ||
+	    (err = task_snapshot_member(prog, rq_type.type, "clock", 8,
+					&state->rq_clock)) ||
+	    (err = task_snapshot_member(prog, rq_type.type, "nr_running", 8,
+					&state->rq_nr_running)) ||
+	    (err = runqueues_rq_member(state, cfs_rq_type.type, state->rq_cfs,
+				       cfs_nr_running,
+				       ARRAY_SIZE(cfs_nr_running), false,
+				       &state->cfs_nr_running)) ||
+	    (err = runqueues_rq_member(state, cfs_rq_type.type, state->rq_cfs,
+				       load_weight, ARRAY_SIZE(load_weight),
+				       false, &state->cfs_load_weight)) ||
+	    (err = runqueues_rq_member(state, cfs_rq_type.type, state->rq_cfs,
+				       load_avg, ARRAY_SIZE(load_avg), true,
+				       &state->cfs_load_avg)) ||
+	    (err = runqueues_rq_member(state, rt_rq_type.type, state->rq_rt,
+				       rt_nr_running,
+				       ARRAY_SIZE(rt_nr_running), false,
+				       &state->rt_nr_running)) ||
+	    (err = runqueues_rq_member(state, dl_rq_type.type, state->rq_dl,
+				       dl_nr_running,
+				       ARRAY_SIZE(dl_nr_running), false,
+				       &state->dl_nr_running)))
+		return err;
+
+	/*
+	 * Since Linux kernel commit bfb068892d30 ("sched/numa: implement
+	 * access locality") (in v4.14), the CFS and deadline trees are
+	 * rb_root_cached.
+	 */
+	if ((err = runqueues_root(prog, cfs_rq_type.type,
+				  "tasks_timeline.rb_root", "tasks_timeline",
+				  &state->cfs_timeline,
+				  &state->cfs_root_type)) ||
+	    (err = member_offset(prog, cfs_rq_type.type, "curr",
+				 &state->cfs_curr)) ||
+	    (err = runqueues_root(prog, dl_rq_type.type, "root.rb_root",
+				  "rb_root", &state->dl_root,
+				  &state->dl_root_type)))
+		return err;
+
+	if ((err = drgn_type_sizeof(se_type.type, &state->se_size)) ||
+	    (err = member_offset(prog, se_type.type, "run_node",
+				 &state->se_run_node)) ||
+	    (err = task_snapshot_member(prog, se_type.type, "vruntime", 8,
+					&state->se_vruntime)) ||
+	    (err = runqueues_optional_offset(prog, se_type.type, "my_q",
+					     &state->se_my_q,
+					     &state->se_has_my_q)))
+		return err;
+
+	err = drgn_program_member_path(prog, rt_rq_type.type, "active.queue",
+				       &member);
+	if (err)
+		return err;
+	type = drgn_underlying_type(member.qualified_type.type);
+	if (member.bit_offset % 8 || drgn_type_kind(type) != DRGN_TYPE_ARRAY) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "rt_prio_array queue member is not an array");
+	}
+	state->rt_queue = member.bit_offset / 8;
+	state->rt_queue_length = drgn_type_length(type);
+	if ((err = drgn_type_sizeof(list_head_type.type,
+				    &state->list_head_size)) ||
+	    (err = member_offset(prog, list_head_type.type, "next",
+				 &state->list_next)) ||
+	    (err = member_offset(prog, rt_se_type.type, "run_list",
+				 &state->rt_se_run_list)) ||
+	    (err = runqueues_optional_offset(prog, rt_se_type.type, "my_q",
+					     &state->rt_se_my_q,
+					     &state->rt_se_has_my_q)))
+		return err;
+	if (state->list_head_size % state->word_size ||
+	    state->list_next % state->word_size) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "list_head is not made of words");
+	}
+
+	if ((err = drgn_type_sizeof(dl_se_type.type, &state->dl_se_size)) ||
+	    (err = member_offset(prog, dl_se_type.type, "rb_node",
+				 &state->dl_se_rb_node)) ||
+	    (err = task_snapshot_member(prog, dl_se_type.type, "deadline", 8,
+					&state->dl_se_deadline)))
+		return err;
+	/*
+	 * Since Linux kernel commit 63ba8422f876 ("sched/deadline: Introduce
+	 * deadline servers") (in v6.8), the deadline tree also contains
+	 * entities which aren't tasks.
+	 */
+	err = drgn_program_member_info(prog, dl_se_type.type, "dl_server",
+				       &member);
+	if (!err) {
+		uint64_t bit_size = member.bit_field_size;
+
+		if (!bit_size) {
+			err = drgn_type_sizeof(member.qualified_type.type,
+					       &bit_size);
+			if (err)
+				return err;
+			bit_size *= 8;
+		}
+		if (!bit_size || bit_size > 64) {
+			return drgn_error_create(DRGN_ERROR_TYPE,
+						 "unsupported dl_server member");
+		}
+		state->dl_server_bit_offset = member.bit_offset;
+		state->dl_server_bit_size = bit_size;
+	} else if (err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+	} else {
+		return err;
+	}
+
+	if ((err = member_offset(prog, task_type.type, "se",
+				 &state->task_se)) ||
+	    (err = member_offset(prog, task_type.type, "rt",
+				 &state->task_rt)) ||
+	    (err = member_offset(prog, task_type.type, "dl",
+				 &state->task_dl)) ||
+	    (err = task_snapshot_member(prog, task_type.type, "prio", 8,
+					&state->task_prio)) ||
+	    (err = task_snapshot_member(prog, task_type.type, "sched_class", 8,
+					&state->task_sched_class)))
+		return err;
+
+	for (i = 0; i < ARRAY_SIZE(runqueues_class_names); i++) {
+		struct drgn_object tmp;
+
+		drgn_object_init(&tmp, prog);
+		err = drgn_program_find_object(prog, runqueues_class_names[i],
+					       NULL, DRGN_FIND_OBJECT_VARIABLE,
+					       &tmp);
+		if (!err) {
+			state->classes[i] =
+				tmp.is_reference ? tmp.reference.address : 0;
+		} else if (err->code == DRGN_ERROR_LOOKUP) {
+			drgn_error_destroy(err);
+			err = NULL;
+		}
+		drgn_object_deinit(&tmp);
+		if (err)
+			return err;
+	}
+	return NULL;
+}
+
+static uint64_t runqueues_value(const struct runqueues_state *state,
+				const char *buf,
+				const struct task_snapshot_range *member)
+{
+	if (!member->size)
+		return 0;
+	return deserialize_bits(buf + member->offset, 0, member->size * 8,
+				state->little_endian);
+}
+
+/* Read a member of a task_struct. */
+static struct drgn_error *
+runqueues_task_value(struct runqueues_state *state, uint64_t task,
+		     const struct task_snapshot_range *member, uint64_t *ret)
+{
+	struct drgn_error *err;
+	char buf[8];
+
+	err = drgn_program_read_memory(state->prog, buf, task + member->offset,
+				       member->size, false);
+	if (err)
+		return err;
+	*ret = deserialize_bits(buf, 0, member->size * 8,
+				state->little_endian);
+	return NULL;
+}
+
+static struct drgn_error *
+runqueues_add(struct runqueues_state *state, uint64_t task, uint64_t key,
+	      enum linux_helper_sched_class sched_class)
+{
+	struct drgn_error *err;
+	struct linux_helper_runqueue_task *entry;
+	uint64_t prio;
+
+	if (state->tasks.size >= RUNQUEUES_MAX_TASKS) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "too many tasks or runqueue is corrupted");
+	}
+	err = runqueues_task_value(state, task, &state->task_prio, &prio);
+	if (err)
+		return err;
+	entry = linux_helper_runqueue_task_vector_append_entry(&state->tasks);
+	if (!entry)
+		return &drgn_enomem;
+	entry->task = task;
+	entry->key = key;
+	entry->prio = truncate_signed(prio, state->task_prio.size * 8);
+	entry->cpu = state->cpu;
+	entry->sched_class = sched_class;
+	entry->current = task == state->curr;
+	if (entry->current)
+		state->curr_found = true;
+	return NULL;
+}
+
+static struct drgn_error *runqueues_cfs_rq(struct runqueues_state *state,
+					   uint64_t cfs_rq, int depth);
+
+/* Add the task of a CFS entity, or descend into it if it is a task group. */
+static struct drgn_error *runqueues_cfs_entity(struct runqueues_state *state,
+					       uint64_t se, int depth)
+{
+	struct drgn_error *err;
+	uint64_t vruntime, my_q = 0;
+
+	err = drgn_program_read_memory(state->prog, state->buf, se,
+				       state->se_size, false);
+	if (err)
+		return err;
+	vruntime = runqueues_value(state, state->buf, &state->se_vruntime);
+	if (state->se_has_my_q) {
+		my_q = drgn_program_decode_word(state->prog,
+						state->buf + state->se_my_q);
+	}
+	if (my_q)
+		return runqueues_cfs_rq(state, my_q, depth + 1);
+	return runqueues_add(state, se - state->task_se, vruntime,
+			     LINUX_HELPER_SCHED_FAIR);
+}
+
+static struct drgn_error *runqueues_cfs_rq(struct runqueues_state *state,
+					   uint64_t cfs_rq, int depth)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = state->prog;
+	struct linux_helper_rbtree_iterator it;
+	struct drgn_object root;
+	uint64_t curr, node;
+
+	if (depth >= RUNQUEUES_MAX_DEPTH) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "task groups are too deep or runqueue is corrupted");
+	}
+	/*
+	 * The running entity isn't in the tree. If it is a task group, the
+	 * running task is below it.
+	 */
+	err = drgn_program_read_word(prog, cfs_rq + state->cfs_curr, false,
+				     &curr);
+	if (err)
+		return err;
+	if (curr) {
+		err = runqueues_cfs_entity(state, curr, depth);
+		if (err)
+			return err;
+	}
+
+	drgn_object_init(&root, prog);
+	err = drgn_object_set_reference(&root, state->cfs_root_type,
+					cfs_rq + state->cfs_timeline, 0, 0,
+					DRGN_PROGRAM_ENDIAN);
+	if (err)
+		goto out;
+	err = linux_helper_rbtree_iterator_init(&it, &root, NULL);
+	if (err)
+		goto out;
+	while (!(err = linux_helper_rbtree_iterator_next(&it, &node))) {
+		err = runqueues_cfs_entity(state, node - state->se_run_node,
+					   depth);
+		if (err)
+			goto out;
+	}
+	if (err == &drgn_stop)
+		err = NULL;
+out:
+	drgn_object_deinit(&root);
+	return err;
+}
+
+static struct drgn_error *runqueues_rt_rq(struct runqueues_state *state,
+					  uint64_t rt_rq, int depth)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = state->prog;
+	uint64_t list_head_words = state->list_head_size / state->word_size;
+	uint64_t *heads;
+	uint64_t i;
+
+	if (depth >= RUNQUEUES_MAX_DEPTH) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "task groups are too deep or runqueue is corrupted");
+	}
+	/* Read every list_head of the priority array in one read. */
+	err = read_word_array(prog, rt_rq + state->rt_queue,
+			      state->rt_queue_length * list_head_words,
+			      &heads);
+	if (err)
+		return err;
+	for (i = 0; i < state->rt_queue_length; i++) {
+		uint64_t head = (rt_rq + state->rt_queue +
+				 i * state->list_head_size);
+		uint64_t node = heads[i * list_head_words +
+				      state->list_next / state->word_size];
+
+		while (node != head) {
+			uint64_t rt_se = node - state->rt_se_run_list;
+			uint64_t my_q = 0;
+
+			if (!node) {
+				err = drgn_error_create(DRGN_ERROR_OTHER,
+							"real-time runqueue list is corrupted");
+				goto out;
+			}
+			if (state->rt_se_has_my_q) {
+				err = drgn_program_read_word(prog,
+							     rt_se +
+							     state->rt_se_my_q,
+							     false, &my_q);
+				if (err)
+					goto out;
+			}
+			if (my_q) {
+				err = runqueues_rt_rq(state, my_q, depth + 1);
+			} else {
+				err = runqueues_add(state,
+						    rt_se - state->task_rt, 0,
+						    LINUX_HELPER_SCHED_RT);
+			}
+			if (err)
+				goto out;
+			err = drgn_program_read_word(prog,
+						     node + state->list_next,
+						     false, &node);
+			if (err)
+				goto out;
+		}
+	}
+	err = NULL;
+out:
+	free(heads);
+	return err;
+}
+
+static struct drgn_error *runqueues_dl_rq(struct runqueues_state *state,
+					  uint64_t dl_rq)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = state->prog;
+	struct linux_helper_rbtree_iterator it;
+	struct drgn_object root;
+	uint64_t node;
+
+	drgn_object_init(&root, prog);
+	err = drgn_object_set_reference(&root, state->dl_root_type,
+					dl_rq + state->dl_root, 0, 0,
+					DRGN_PROGRAM_ENDIAN);
+	if (err)
+		goto out;
+	err = linux_helper_rbtree_iterator_init(&it, &root, NULL);
+	if (err)
+		goto out;
+	while (!(err = linux_helper_rbtree_iterator_next(&it, &node))) {
+		uint64_t dl_se = node - state->dl_se_rb_node;
+		uint64_t deadline;
+
+		err = drgn_program_read_memory(prog, state->buf, dl_se,
+					       state->dl_se_size, false);
+		if (err)
+			goto out;
+		if (state->dl_server_bit_size &&
+		    deserialize_bits(state->buf +
+				     state->dl_server_bit_offset / 8,
+				     state->dl_server_bit_offset % 8,
+				     state->dl_server_bit_size,
+				     state->little_endian))
+			continue;
+		deadline = runqueues_value(state, state->buf,
+					   &state->dl_se_deadline);
+		err = runqueues_add(state, dl_se - state->task_dl, deadline,
+				    LINUX_HELPER_SCHED_DL);
+		if (err)
+			goto out;
+	}
+	if (err == &drgn_stop)
+		err = NULL;
+out:
+	drgn_object_deinit(&root);
+	return err;
+}
+
+/* Add the running task of the current CPU if it wasn't on a queue. */
+static struct drgn_error *runqueues_add_curr(struct runqueues_state *state)
+{
+	struct drgn_error *err;
+	enum linux_helper_sched_class sched_class = LINUX_HELPER_SCHED_OTHER;
+	uint64_t class_address, key = 0;
+	size_t i;
+
+	if (!state->curr || state->curr_found)
+		return NULL;
+	err = runqueues_task_value(state, state->curr,
+				   &state->task_sched_class, &class_address);
+	if (err)
+		return err;
+	for (i = 0; i < ARRAY_SIZE(state->classes); i++) {
+		if (state->classes[i] && class_address == state->classes[i]) {
+			sched_class = i;
+			break;
+		}
+	}
+	if (sched_class == LINUX_HELPER_SCHED_FAIR) {
+		struct task_snapshot_range vruntime = {
+			.offset = state->task_se + state->se_vruntime.offset,
+			.size = state->se_vruntime.size,
+		};
+
+		err = runqueues_task_value(state, state->curr, &vruntime,
+					   &key);
+	} else if (sched_class == LINUX_HELPER_SCHED_DL) {
+		struct task_snapshot_range deadline = {
+			.offset = state->task_dl + state->dl_se_deadline.offset,
+			.size = state->dl_se_deadline.size,
+		};
+
+		err = runqueues_task_value(state, state->curr, &deadline,
+					   &key);
+	}
+	if (err)
+		return err;
+	return runqueues_add(state, state->curr, key, sched_class);
+}
+
+struct drgn_error *
+linux_helper_runqueues(struct drgn_program *prog,
+		       struct linux_helper_runqueue **runqueues_ret,
+		       size_t *num_runqueues_ret,
+		       struct linux_helper_runqueue_task **tasks_ret,
+		       size_t *num_tasks_ret)
+{
+	struct drgn_error *err;
+	struct runqueues_state state = {
+		.prog = prog,
+		.little_endian = drgn_program_is_little_endian(prog),
+		.word_size = drgn_program_is_64_bit(prog) ? 8 : 4,
+		.tasks = VECTOR_INIT,
+	};
+	struct linux_helper_runqueue_vector runqueues = VECTOR_INIT;
+	char *rq_buf = NULL;
+	uint64_t *cpus = NULL;
+	size_t num_cpus, i;
+
+	err = runqueues_layout(&state);
+	if (err)
+		return err;
+	rq_buf = malloc(state.rq_size);
+	state.buf = malloc(max(state.se_size, state.dl_se_size));
+	if (!rq_buf || !state.buf) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	err = linux_helper_cpumask_cpus(prog, NULL, &cpus, &num_cpus);
+	if (err)
+		goto out;
+	for (i = 0; i < num_cpus; i++) {
+		struct linux_helper_runqueue *rq;
+		uint64_t offset;
+
+		err = per_cpu_offset(prog, cpus[i], &offset);
+		if (err)
+			goto out;
+		rq = linux_helper_runqueue_vector_append_entry(&runqueues);
+		if (!rq) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		rq->rq = state.runqueues + offset;
+		rq->cpu = cpus[i];
+		err = drgn_program_read_memory(prog, rq_buf, rq->rq,
+					       state.rq_size, false);
+		if (err)
+			goto out;
+		rq->curr = runqueues_value(&state, rq_buf, &state.rq_curr);
+		rq->clock = runqueues_value(&state, rq_buf, &state.rq_clock);
+		rq->nr_running = runqueues_value(&state, rq_buf,
+						 &state.rq_nr_running);
+		rq->cfs_nr_running = runqueues_value(&state, rq_buf,
+						     &state.cfs_nr_running);
+		rq->rt_nr_running = runqueues_value(&state, rq_buf,
+						    &state.rt_nr_running);
+		rq->dl_nr_running = runqueues_value(&state, rq_buf,
+						    &state.dl_nr_running);
+		rq->cfs_load_weight = runqueues_value(&state, rq_buf,
+						      &state.cfs_load_weight);
+		rq->cfs_load_avg = runqueues_value(&state, rq_buf,
+						   &state.cfs_load_avg);
+
+		state.cpu = rq->cpu;
+		state.curr = rq->curr;
+		state.curr_found = false;
+		if ((err = runqueues_cfs_rq(&state, rq->rq + state.rq_cfs,
+					    0)) ||
+		    (err = runqueues_rt_rq(&state, rq->rq + state.rq_rt, 0)) ||
+		    (err = runqueues_dl_rq(&state, rq->rq + state.rq_dl)) ||
+		    (err = runqueues_add_curr(&state)))
+			goto out;
+	}
+	err = NULL;
+out:
+	free(cpus);
+	free(state.buf);
+	free(rq_buf);
+	if (err) {
+		linux_helper_runqueue_task_vector_deinit(&state.tasks);
+		linux_helper_runqueue_vector_deinit(&runqueues);
+		return err;
+	}
+	linux_helper_runqueue_vector_shrink_to_fit(&runqueues);
+	linux_helper_runqueue_task_vector_shrink_to_fit(&state.tasks);
+	*runqueues_ret = runqueues.data;
+	*num_runqueues_ret = runqueues.size;
+	*tasks_ret = state.tasks.data;
+	*num_tasks_ret = state.tasks.size;
+	return NULL;
+}
+
+/* Maximum number of vmalloc areas, in case the tree is corrupted. */
+static const size_t VMALLOC_MAX_AREAS = (size_t)1 << 26;
+
+/*
+ * Find the vmap_area of every busy vmalloc area in one red-black tree of busy
+ * areas.
+ */
+static struct drgn_error *vmalloc_walk_root(const struct drgn_object *root,
+					    uint64_t rb_node_offset,
+					    struct task_address_vector *ret)
+{
+	struct drgn_error *err;
+	struct linux_helper_rbtree_iterator it;
+	uint64_t node;
+
+	err = linux_helper_rbtree_iterator_init(&it, root, NULL);
+	if (err)
+		return err;
+	while (!(err = linux_helper_rbtree_iterator_next(&it, &node))) {
+		uint64_t va = node - rb_node_offset;
+
+		if (ret->size >= VMALLOC_MAX_AREAS) {
+			return drgn_error_create(DRGN_ERROR_OTHER,
+						 "too many vmalloc areas or tree is corrupted");
+		}
+		if (!task_address_vector_append(ret, &va))
+			return &drgn_enomem;
+	}
+	if (err == &drgn_stop)
+		err = NULL;
+	return err;
+}
+
+/*
+ * Find the vmap_area of every busy vmalloc area. Before Linux 6.9, they are in
+ * one tree, vmap_area_root. Since then, each vmap node (vmap_nodes) has its own
+ * tree.
+ */
+static struct drgn_error *vmalloc_vmap_areas(struct drgn_program *prog,
+					     uint64_t rb_node_offset,
+					     struct task_address_vector *ret)
+{
+	struct drgn_error *err;
+	struct drgn_qualified_type node_type;
+	struct drgn_member_info busy_root;
+	struct drgn_object root, tmp;
+	uint64_t nodes, num_nodes, node_size, i;
+
+	drgn_object_init(&root, prog);
+	drgn_object_init(&tmp, prog);
+	err = drgn_program_find_object(prog, "vmap_area_root", NULL,
+				       DRGN_FIND_OBJECT_VARIABLE, &root);
+	if (!err) {
+		err = vmalloc_walk_root(&root, rb_node_offset, ret);
+		goto out;
+	}
+	if (err->code != DRGN_ERROR_LOOKUP)
+		goto out;
+	drgn_error_destroy(err);
+
+	if ((err = drgn_program_find_type(prog, "struct vmap_node", NULL,
+					  &node_type)) ||
+	    (err = drgn_type_sizeof(node_type.type, &node_size)) ||
+	    (err = drgn_program_member_path(prog, node_type.type, "busy.root",
+					    &busy_root)))
+		goto out;
+	if ((err = drgn_program_find_object(prog, "vmap_nodes", NULL,
+					    DRGN_FIND_OBJECT_VARIABLE,
+					    &tmp)) ||
+	    (err = drgn_object_read_unsigned(&tmp, &nodes)) ||
+	    (err = drgn_program_find_object(prog, "nr_vmap_nodes", NULL,
+					    DRGN_FIND_OBJECT_VARIABLE,
+					    &tmp)) ||
+	    (err = drgn_object_read_unsigned(&tmp, &num_nodes)))
+		goto out;
+	for (i = 0; i < num_nodes; i++) {
+		err = drgn_object_set_reference(&root,
+						busy_root.qualified_type,
+						nodes + i * node_size +
+						busy_root.bit_offset / 8,
+						0, 0, DRGN_PROGRAM_ENDIAN);
+		if (err)
+			goto out;
+		err = vmalloc_walk_root(&root, rb_node_offset, ret);
+		if (err)
+			goto out;
+	}
+out:
+	drgn_object_deinit(&tmp);
+	drgn_object_deinit(&root);
+	return err;
+}
+
+static int linux_helper_vmalloc_area_cmp(const void *_a, const void *_b)
+{
+	const struct linux_helper_vmalloc_area *a = _a, *b = _b;
+
+	if (a->address != b->address)
+		return a->address < b->address ? -1 : 1;
+	return 0;
+}
+
+struct drgn_error *
+linux_helper_vmalloc_areas(struct drgn_program *prog,
+			   struct linux_helper_vmalloc_area **ret,
+			   size_t *num_ret)
+{
+	enum {
+		VA_START,
+		VA_END,
+		VA_VM,
+		VM_SIZE,
+		VM_FLAGS,
+		VM_NR_PAGES,
+		VM_CALLER,
+		NUM_MEMBERS,
+	};
+	struct drgn_error *err;
+	bool little_endian = drgn_program_is_little_endian(prog);
+	struct task_snapshot_range members[NUM_MEMBERS];
+	struct task_snapshot_plan va_plan, vm_plan;
+	struct drgn_qualified_type va_type, vm_type;
+	struct task_address_vector vas = VECTOR_INIT;
+	struct linux_helper_vmalloc_area *areas = NULL;
+	struct drgn_memory_read_request *requests = NULL;
+	uint64_t vms[TASK_SNAPSHOT_BATCH_SIZE];
+	uint64_t rb_node_offset;
+	size_t start, i;
+	char *buf = NULL;
+
+	if ((err = drgn_program_find_type(prog, "struct vmap_area", NULL,
+					  &va_type)) ||
+	    (err = drgn_program_find_type(prog, "struct vm_struct", NULL,
+					  &vm_type)) ||
+	    (err = member_offset(prog, va_type.type, "rb_node",
+				 &rb_node_offset)) ||
+	    (err = task_snapshot_member(prog, va_type.type, "va_start", 8,
+					&members[VA_START])) ||
+	    (err = task_snapshot_member(prog, va_type.type, "va_end", 8,
+					&members[VA_END])) ||
+	    (err = task_snapshot_member(prog, va_type.type, "vm", 8,
+					&members[VA_VM])) ||
+	    (err = task_snapshot_member(prog, vm_type.type, "size", 8,
+					&members[VM_SIZE])) ||
+	    (err = task_snapshot_member(prog, vm_type.type, "flags", 8,
+					&members[VM_FLAGS])) ||
+	    (err = task_snapshot_member(prog, vm_type.type, "nr_pages", 8,
+					&members[VM_NR_PAGES])) ||
+	    (err = task_snapshot_member(prog, vm_type.type, "caller", 8,
+					&members[VM_CALLER])))
+		return err;
+	task_snapshot_plan_init(&va_plan, &members[VA_START], VM_SIZE);
+	task_snapshot_plan_init(&vm_plan, &members[VM_SIZE],
+				NUM_MEMBERS - VM_SIZE);
+
+	err = vmalloc_vmap_areas(prog, rb_node_offset, &vas);
+	if (err)
+		goto out;
+	areas = malloc_array(max(vas.size, (size_t)1), sizeof(*areas));
+	buf = malloc_array(TASK_SNAPSHOT_BATCH_SIZE,
+			   max(va_plan.window, vm_plan.window));
+	requests = malloc_array(TASK_SNAPSHOT_BATCH_SIZE,
+				TASK_SNAPSHOT_MAX_RANGES * sizeof(*requests));
+	if (!areas || !buf || !requests) {
+		err = &drgn_enomem;
+		goto out;
+	}
+
+	for (start = 0; start < vas.size; start += TASK_SNAPSHOT_BATCH_SIZE) {
+		size_t n = min(vas.size - start,
+			       (size_t)TASK_SNAPSHOT_BATCH_SIZE);
+
+#define VALUE(plan, i, index)					\
+	task_snapshot_value(buf + (i) * (plan).window, &(plan),	\
+			    &members[index], little_endian)
+		err = task_snapshot_plan_read(prog, &va_plan,
+					      &vas.data[start], n, buf,
+					      requests);
+		if (err)
+			goto out;
+		for (i = 0; i < n; i++) {
+			struct linux_helper_vmalloc_area *area =
+				&areas[start + i];
+			uint64_t va_end = VALUE(va_plan, i, VA_END);
+
+			area->address = VALUE(va_plan, i, VA_START);
+			area->size = va_end - area->address;
+			area->vm = vms[i] = VALUE(va_plan, i, VA_VM);
+		}
+
+		/* Areas without a vm_struct (e.g., vm_map_ram()) aren't read. */
+		err = task_snapshot_plan_read(prog, &vm_plan, vms, n, buf,
+					      requests);
+		if (err)
+			goto out;
+		for (i = 0; i < n; i++) {
+			struct linux_helper_vmalloc_area *area =
+				&areas[start + i];
+
+			if (!vms[i]) {
+				area->flags = area->pages = area->caller = 0;
+				continue;
+			}
+			area->size = VALUE(vm_plan, i, VM_SIZE);
+			area->flags = VALUE(vm_plan, i, VM_FLAGS);
+			area->pages = VALUE(vm_plan, i, VM_NR_PAGES);
+			area->caller = VALUE(vm_plan, i, VM_CALLER);
+		}
+#undef VALUE
+	}
+	/* With more than one tree, the areas are only sorted per tree. */
+	qsort(areas, vas.size, sizeof(areas[0]), linux_helper_vmalloc_area_cmp);
+	*ret = areas;
+	*num_ret = vas.size;
+	areas = NULL;
+	err = NULL;
+out:
+	free(requests);
+	free(buf);
+	free(areas);
+	task_address_vector_deinit(&vas);
+	return err;
+}
+
+static int vmalloc_caller_address_cmp(const void *_a, const void *_b)
+{
+	const struct linux_helper_vmalloc_caller *a = _a, *b = _b;
+
+	if (a->caller != b->caller)
+		return a->caller < b->caller ? -1 : 1;
+	return 0;
+}
+
+static int vmalloc_caller_size_cmp(const void *_a, const void *_b)
+{
+	const struct linux_helper_vmalloc_caller *a = _a, *b = _b;
+
+	if (a->size != b->size)
+		return a->size > b->size ? -1 : 1;
+	return vmalloc_caller_address_cmp(a, b);
+}
+
+struct drgn_error *
+linux_helper_vmalloc_callers(const struct linux_helper_vmalloc_area *areas,
+			     size_t num_areas,
+			     struct linux_helper_vmalloc_caller **ret,
+			     size_t *num_ret)
+{
+	struct linux_helper_vmalloc_caller *callers;
+	size_t i, j;
+
+	callers = malloc_array(max(num_areas, (size_t)1), sizeof(*callers));
+	if (!callers)
+		return &drgn_enomem;
+	for (i = 0; i < num_areas; i++) {
+		callers[i] = (struct linux_helper_vmalloc_caller){
+			.caller = areas[i].caller,
+			.areas = 1,
+			.size = areas[i].size,
+			.pages = areas[i].pages,
+		};
+	}
+	/* Merge the areas of each caller. */
+	qsort(callers, num_areas, sizeof(callers[0]),
+	      vmalloc_caller_address_cmp);
+	for (i = j = 0; i < num_areas; i++) {
+		if (j && callers[j - 1].caller == callers[i].caller) {
+			callers[j - 1].areas++;
+			callers[j - 1].size += callers[i].size;
+			callers[j - 1].pages += callers[i].pages;
+		} else {
+			callers[j++] = callers[i];
+		}
+	}
+	qsort(callers, j, sizeof(callers[0]), vmalloc_caller_size_cmp);
+	*ret = callers;
+	*num_ret = j;
+	return NULL;
+}
+
+DEFINE_VECTOR(pid_cache_entry_vector, struct drgn_pid_cache_entry)
+
+/* Read the PID number and task of a struct pid into a PID cache entry. */
+static struct drgn_error *cache_pid(struct linux_helper_pid_iterator *it,
+				    uint64_t nr_offset, uint64_t pid,
+				    struct drgn_pid_cache_entry *entry)
+{
+	struct drgn_error *err;
+	uint32_t nr;
+	uint64_t first;
+
+	err = drgn_program_read_u32(it->prog, pid + nr_offset, false, &nr);
+	if (err)
+		return err;
+	/* pid_task(pid, PIDTYPE_PID) */
+	err = drgn_program_read_word(it->prog, pid + it->pid_tasks_offset,
+				     false, &first);
+	if (err)
+		return err;
+	entry->key.nr = nr;
+	entry->value.pid = pid;
+	entry->value.task = first ? first - it->task_link_offset : 0;
+	return NULL;
+}
+
+struct drgn_error *linux_helper_cache_pids(const struct drgn_object *ns)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = ns->prog;
+	struct linux_helper_pid_iterator it;
+	struct pid_cache_entry_vector entries = VECTOR_INIT;
+	struct drgn_qualified_type pid_type;
+	struct drgn_object tmp;
+	union drgn_value level;
+	uint64_t ns_address, nr_offset, pid;
+	char member[64];
+
+	drgn_object_init(&tmp, prog);
+	/* Initialize with tasks to get the offsets for pid_task(). */
+	err = linux_helper_pid_iterator_init(&it, ns, true);
+	if (err)
+		goto out;
+	err = drgn_object_read_unsigned(ns, &ns_address);
+	if (err)
+		goto out;
+	err = drgn_object_member_dereference(&tmp, ns, "level");
+	if (err)
+		goto out;
+	err = drgn_object_read_integer(&tmp, &level);
+	if (err)
+		goto out;
+	err = drgn_program_find_type(prog, "struct pid", NULL, &pid_type);
+	if (err)
+		goto out;
+	sprintf(member, "numbers[%" PRIu64 "].nr", level.uvalue);
+	err = member_offset(prog, pid_type.type, member, &nr_offset);
+	if (err)
+		goto out;
+
+	/* Walk the PIDs themselves so that PIDs without a task are cached. */
+	while (!(err = pid_iterator_next_pid(&it, &pid))) {
+		struct drgn_pid_cache_entry *entry;
+
+		entry = pid_cache_entry_vector_append_entry(&entries);
+		if (!entry) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		entry->key.ns = ns_address;
+		err = cache_pid(&it, nr_offset, pid, entry);
+		if (err)
+			goto out;
+	}
+	if (err != &drgn_stop)
+		goto out;
+	err = drgn_program_cache_pids(prog, ns_address, entries.data,
+				      entries.size);
+out:
+	pid_cache_entry_vector_deinit(&entries);
+	linux_helper_pid_iterator_deinit(&it);
+	drgn_object_deinit(&tmp);
+	return err;
+}
@@ -0,0 +1,367 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <omp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash_table.h"
+#include "internal.h"
+#include "memory_diff.h"
+#include "memory_reader.h"
+#include "program.h"
+#include "vector.h"
+
+DEFINE_VECTOR(drgn_page_hash_vector, struct drgn_page_hash)
+DEFINE_VECTOR(drgn_memory_diff_range_vector, struct drgn_memory_range)
+
+/* Chunk of memory hashed by one thread. */
+struct drgn_memory_diff_chunk {
+	uint64_t address;
+	size_t size;
+};
+
+DEFINE_VECTOR(drgn_memory_diff_chunk_vector, struct drgn_memory_diff_chunk)
+
+/* Hash buf, which is at address, one page at a time. */
+static bool drgn_memory_diff_hash(const char *buf, uint64_t address,
+				  size_t size,
+				  struct drgn_page_hash_vector *hashes)
+{
+	size_t offset = 0;
+
+	while (offset < size) {
+		struct drgn_page_hash *hash;
+		size_t n;
+
+		n = min((uint64_t)(size - offset),
+			DRGN_MEMORY_CACHE_PAGE_SIZE -
+			((address + offset) &
+			 (DRGN_MEMORY_CACHE_PAGE_SIZE - 1)));
+		hash = drgn_page_hash_vector_append_entry(hashes);
+		if (!hash)
+			return false;
+		hash->address = address + offset;
+		hash->hash = hash_bytes(buf + offset, n);
+		hash->size = n;
+		offset += n;
+	}
+	return true;
+}
+
+static struct drgn_error *
+drgn_memory_diff_hash_chunk(struct drgn_memory_reader *reader, bool physical,
+			    const struct drgn_memory_diff_chunk *chunk,
+			    char *buf, struct drgn_page_hash_vector *hashes)
+{
+	struct drgn_error *err;
+	size_t offset;
+	bool ok;
+
+	err = drgn_memory_reader_try_read(reader, buf, chunk->address,
+					  chunk->size, physical, &ok);
+	if (err)
+		return err;
+	if (ok) {
+		if (!drgn_memory_diff_hash(buf, chunk->address, chunk->size,
+					   hashes))
+			return &drgn_enomem;
+		return NULL;
+	}
+
+	/*
+	 * Part of the chunk isn't readable. Read it again one page at a time
+	 * and skip the pages that fail.
+	 */
+	for (offset = 0; offset < chunk->size;) {
+		uint64_t address = chunk->address + offset;
+		size_t n;
+
+		n = min((uint64_t)(chunk->size - offset),
+			DRGN_MEMORY_CACHE_PAGE_SIZE -
+			(address & (DRGN_MEMORY_CACHE_PAGE_SIZE - 1)));
+		err = drgn_memory_reader_try_read(reader, buf, address, n,
+						  physical, &ok);
+		if (err)
+			return err;
+		if (ok && !drgn_memory_diff_hash(buf, address, n, hashes))
+			return &drgn_enomem;
+		offset += n;
+	}
+	return NULL;
+}
+
+/*
+ * Split the present memory in ranges into chunks which don't cross a multiple
+ * of the chunk size, so that every page is hashed by the same chunk no matter
+ * where its range starts. Memory which is known to be absent (e.g., pages
+ * excluded from a core dump) isn't included.
+ */
+static struct drgn_error *
+drgn_memory_diff_chunks(struct drgn_memory_reader *reader, bool physical,
+			const struct drgn_memory_range *ranges,
+			size_t num_ranges,
+			struct drgn_memory_diff_chunk_vector *chunks)
+{
+	struct drgn_error *err;
+	size_t i;
+
+	for (i = 0; i < num_ranges; i++) {
+		uint64_t address = ranges[i].start;
+
+		for (;;) {
+			uint64_t run_last;
+			bool present;
+
+			err = drgn_memory_reader_present(reader, address,
+							 ranges[i].last,
+							 physical, &present,
+							 &run_last);
+			if (err)
+				return err;
+			while (present) {
+				struct drgn_memory_diff_chunk *chunk;
+				uint64_t chunk_last;
+
+				chunk_last = address |
+					     (DRGN_MEMORY_DIFF_CHUNK_SIZE - 1);
+				if (chunk_last > run_last)
+					chunk_last = run_last;
+				chunk = drgn_memory_diff_chunk_vector_append_entry(chunks);
+				if (!chunk)
+					return &drgn_enomem;
+				chunk->address = address;
+				chunk->size = chunk_last - address + 1;
+				if (chunk_last == run_last)
+					break;
+				address = chunk_last + 1;
+			}
+			if (run_last >= ranges[i].last)
+				break;
+			address = run_last + 1;
+		}
+	}
+	return NULL;
+}
+
+static int drgn_page_hash_cmp(const void *_a, const void *_b)
+{
+	const struct drgn_page_hash *a = _a, *b = _b;
+
+	if (a->address != b->address)
+		return a->address < b->address ? -1 : 1;
+	return 0;
+}
+
+struct drgn_error *
+drgn_memory_hashes_build(struct drgn_program *prog, bool physical,
+			 const struct drgn_memory_range *ranges,
+			 size_t num_ranges, struct drgn_memory_hashes **ret)
+{
+	struct drgn_error *err = NULL;
+	struct drgn_memory_range *segment_ranges = NULL;
+	struct drgn_memory_diff_chunk_vector chunks = VECTOR_INIT;
+	struct drgn_page_hash_vector *thread_hashes = NULL;
+	char **buffers = NULL;
+	struct drgn_memory_hashes *hashes = NULL;
+	size_t err_index = SIZE_MAX, num_pages, i, j;
+	int num_threads = drgn_num_threads(), thread;
+
+	if (!ranges) {
+		err = drgn_memory_reader_ranges(&prog->reader, physical,
+						&segment_ranges, &num_ranges);
+		if (err)
+			return err;
+		ranges = segment_ranges;
+	}
+	err = drgn_memory_diff_chunks(&prog->reader, physical, ranges,
+				      num_ranges, &chunks);
+	if (err)
+		goto out;
+
+	hashes = malloc(sizeof(*hashes));
+	if (!hashes)
+		goto enomem;
+	hashes->pages = NULL;
+	hashes->num_pages = 0;
+	hashes->physical = physical;
+	if (!chunks.size)
+		goto out;
+
+	thread_hashes = malloc_array(num_threads, sizeof(*thread_hashes));
+	if (!thread_hashes)
+		goto enomem;
+	for (thread = 0; thread < num_threads; thread++)
+		drgn_page_hash_vector_init(&thread_hashes[thread]);
+	buffers = calloc(num_threads, sizeof(*buffers));
+	if (!buffers)
+		goto enomem;
+	for (thread = 0; thread < num_threads; thread++) {
+		buffers[thread] = malloc(DRGN_MEMORY_DIFF_CHUNK_SIZE);
+		if (!buffers[thread])
+			goto enomem;
+	}
+
+	#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+	for (i = 0; i < chunks.size; i++) {
+		struct drgn_error *chunk_err;
+		size_t first_err_index;
+		int thread_num;
+
+		/* Once a chunk fails, the rest of the hashes are useless. */
+		#pragma omp atomic read
+		first_err_index = err_index;
+		if (first_err_index != SIZE_MAX)
+			continue;
+
+		thread_num = omp_get_thread_num();
+		chunk_err = drgn_memory_diff_hash_chunk(&prog->reader, physical,
+							&chunks.data[i],
+							buffers[thread_num],
+							&thread_hashes[thread_num]);
+		if (chunk_err) {
+			#pragma omp critical(drgn_memory_hashes_build)
+			{
+				if (i < err_index) {
+					drgn_error_destroy(err);
+					err = chunk_err;
+					#pragma omp atomic write
+					err_index = i;
+				} else {
+					drgn_error_destroy(chunk_err);
+				}
+			}
+		}
+	}
+	if (err)
+		goto out;
+
+	num_pages = 0;
+	for (thread = 0; thread < num_threads; thread++)
+		num_pages += thread_hashes[thread].size;
+	if (num_pages) {
+		hashes->pages = malloc_array(num_pages,
+					     sizeof(hashes->pages[0]));
+		if (!hashes->pages)
+			goto enomem;
+	}
+	for (thread = 0; thread < num_threads; thread++) {
+		memcpy(hashes->pages + hashes->num_pages,
+		       thread_hashes[thread].data,
+		       thread_hashes[thread].size *
+		       sizeof(thread_hashes[thread].data[0]));
+		hashes->num_pages += thread_hashes[thread].size;
+		drgn_page_hash_vector_deinit(&thread_hashes[thread]);
+		drgn_page_hash_vector_init(&thread_hashes[thread]);
+	}
+	qsort(hashes->pages, hashes->num_pages, sizeof(hashes->pages[0]),
+	      drgn_page_hash_cmp);
+	/* Overlapping ranges hash the same pages more than once. */
+	for (i = j = 0; i < hashes->num_pages; i++) {
+		if (j && hashes->pages[j - 1].address == hashes->pages[i].address)
+			continue;
+		hashes->pages[j++] = hashes->pages[i];
+	}
+	hashes->num_pages = j;
+	goto out;
+
+enomem:
+	err = &drgn_enomem;
+out:
+	if (buffers) {
+		for (thread = 0; thread < num_threads; thread++)
+			free(buffers[thread]);
+		free(buffers);
+	}
+	if (thread_hashes) {
+		for (thread = 0; thread < num_threads; thread++)
+			drgn_page_hash_vector_deinit(&thread_hashes[thread]);
+		free(thread_hashes);
+	}
+	drgn_memory_diff_chunk_vector_deinit(&chunks);
+	free(segment_ranges);
+	if (err) {
+		if (hashes)
+			drgn_memory_hashes_destroy(hashes);
+		return err;
+	}
+	*ret = hashes;
+	return NULL;
+}
+
+void drgn_memory_hashes_destroy(struct drgn_memory_hashes *hashes)
+{
+	free(hashes->pages);
+	free(hashes);
+}
+
+/*
+ * Add a region which differs, merging it with the previous one if they overlap
+ * or are adjacent. Regions must be added in order of address.
+ */
+static bool drgn_memory_diff_add(struct drgn_memory_diff_range_vector *regions,
+				 uint64_t address, uint32_t size)
+{
+	uint64_t last = address + (size - 1);
+	struct drgn_memory_range *region;
+
+	if (regions->size) {
+		region = &regions->data[regions->size - 1];
+		if (region->last == UINT64_MAX || address <= region->last + 1) {
+			if (last > region->last)
+				region->last = last;
+			return true;
+		}
+	}
+	region = drgn_memory_diff_range_vector_append_entry(regions);
+	if (!region)
+		return false;
+	region->start = address;
+	region->last = last;
+	return true;
+}
+
+struct drgn_error *drgn_memory_hashes_diff(const struct drgn_memory_hashes *a,
+					   const struct drgn_memory_hashes *b,
+					   struct drgn_memory_range **ret,
+					   size_t *count_ret)
+{
+	struct drgn_memory_diff_range_vector regions = VECTOR_INIT;
+	size_t i = 0, j = 0;
+
+	if (a->physical != b->physical) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "cannot compare physical and virtual memory hashes");
+	}
+
+	/* Both are sorted by address, so walk them together. */
+	while (i < a->num_pages || j < b->num_pages) {
+		const struct drgn_page_hash *page;
+
+		if (j >= b->num_pages ||
+		    (i < a->num_pages &&
+		     a->pages[i].address < b->pages[j].address)) {
+			page = &a->pages[i++];
+		} else if (i >= a->num_pages ||
+			   b->pages[j].address < a->pages[i].address) {
+			page = &b->pages[j++];
+		} else {
+			const struct drgn_page_hash *other = &b->pages[j++];
+
+			page = &a->pages[i++];
+			if (page->hash == other->hash &&
+			    page->size == other->size)
+				continue;
+			if (other->size > page->size)
+				page = other;
+		}
+		if (!drgn_memory_diff_add(&regions, page->address, page->size)) {
+			drgn_memory_diff_range_vector_deinit(&regions);
+			return &drgn_enomem;
+		}
+	}
+	drgn_memory_diff_range_vector_shrink_to_fit(&regions);
+	*ret = regions.data;
+	*count_ret = regions.size;
+	return NULL;
+}
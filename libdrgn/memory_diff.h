@@ -0,0 +1,105 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Memory image comparison.
+ *
+ * See @ref MemoryDiff.
+ */
+
+#ifndef DRGN_MEMORY_DIFF_H
+#define DRGN_MEMORY_DIFF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct drgn_memory_range;
+struct drgn_program;
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup MemoryDiff Memory diff
+ *
+ * Finding the memory which differs between two images of a program.
+ *
+ * The memory of each image is summarized as a hash of every page, which is
+ * built by reading memory in chunks in parallel. Two summaries are compared
+ * page by page in order of address, and the pages which differ are coalesced
+ * into regions. Since a summary is much smaller than the memory it summarizes,
+ * it can be kept around to compare a running program against itself later.
+ *
+ * Pages are compared by their 64-bit hashes, so a changed page could be missed
+ * in the unlikely event of a hash collision. The hash function is only stable
+ * for the lifetime of the process, so summaries are not saved.
+ *
+ * @{
+ */
+
+/** Size of the chunks that are read and hashed in parallel. */
+#define DRGN_MEMORY_DIFF_CHUNK_SIZE (UINT64_C(1) << 20)
+
+/**
+ * Hash of a page of memory, or of the part of a page at the start or end of a
+ * range which isn't page-aligned.
+ */
+struct drgn_page_hash {
+	uint64_t address;
+	uint64_t hash;
+	/** Number of bytes hashed. This is at most a page. */
+	uint32_t size;
+};
+
+/** Page hashes of the memory of a program. */
+struct drgn_memory_hashes {
+	/**
+	 * Hashes sorted by address. Memory which couldn't be read has no
+	 * hashes.
+	 */
+	struct drgn_page_hash *pages;
+	size_t num_pages;
+	/** Whether the addresses are physical. */
+	bool physical;
+};
+
+/**
+ * Hash the memory of a program page by page.
+ *
+ * @param[in] physical Whether to hash physical memory instead of virtual
+ * memory.
+ * @param[in] ranges Address ranges to hash, or @c NULL to hash every memory
+ * segment of the program. Unreadable memory in the ranges is skipped.
+ * @param[in] num_ranges Number of ranges in @p ranges.
+ * @param[out] ret Returned hashes. They must be freed with @ref
+ * drgn_memory_hashes_destroy().
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *
+drgn_memory_hashes_build(struct drgn_program *prog, bool physical,
+			 const struct drgn_memory_range *ranges,
+			 size_t num_ranges, struct drgn_memory_hashes **ret);
+
+/** Free a @ref drgn_memory_hashes. */
+void drgn_memory_hashes_destroy(struct drgn_memory_hashes *hashes);
+
+/**
+ * Find the memory which differs between two @ref drgn_memory_hashes.
+ *
+ * Memory which was only readable in one of them is considered different.
+ *
+ * @param[out] ret Returned regions which differ, sorted by address. Adjacent
+ * regions are merged. This must be freed with @c free().
+ * @param[out] count_ret Returned number of regions.
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *drgn_memory_hashes_diff(const struct drgn_memory_hashes *a,
+					   const struct drgn_memory_hashes *b,
+					   struct drgn_memory_range **ret,
+					   size_t *count_ret);
+
+/** @} */
+
+#endif /* DRGN_MEMORY_DIFF_H */
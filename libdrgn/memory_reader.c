@@ -1,20 +1,148 @@
 // Copyright (c) Facebook, Inc. and its affiliates.
 // SPDX-License-Identifier: GPL-3.0+
 
+#include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/uio.h>
 
+#include "compressed_file.h"
 #include "internal.h"
 #include "memory_reader.h"
+#include "memory_trace.h"
+#include "usdt.h"
+#include "vector.h"
 
 DEFINE_BINARY_SEARCH_TREE_FUNCTIONS(drgn_memory_segment_tree,
 				    binary_search_tree_scalar_cmp, splay)
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_memory_cache_map, hash_pair_int_type,
+			    hash_table_scalar_eq)
+DEFINE_ORDERED_INDEX_FUNCTIONS(drgn_memory_segment_ordered_index,
+			       drgn_memory_segment_ptr_to_key)
+DEFINE_VECTOR(drgn_memory_segment_vector, struct drgn_memory_segment *)
+
+static void drgn_memory_cache_init(struct drgn_memory_cache *cache)
+{
+	drgn_memory_cache_map_init(&cache->map);
+	cache->pages = NULL;
+	cache->keys = NULL;
+	cache->referenced = NULL;
+	cache->capacity = 0;
+	cache->hand = 0;
+	cache->last_miss = DRGN_MEMORY_CACHE_EMPTY;
+}
+
+static void drgn_memory_cache_free(struct drgn_memory_cache *cache)
+{
+	free(cache->referenced);
+	free(cache->keys);
+	free(cache->pages);
+	cache->pages = NULL;
+	cache->keys = NULL;
+	cache->referenced = NULL;
+}
+
+static void drgn_memory_cache_deinit(struct drgn_memory_cache *cache)
+{
+	drgn_memory_cache_free(cache);
+	drgn_memory_cache_map_deinit(&cache->map);
+}
+
+static bool drgn_memory_cache_alloc(struct drgn_memory_cache *cache)
+{
+	size_t i;
+
+	cache->pages = malloc_array(cache->capacity,
+				    DRGN_MEMORY_CACHE_PAGE_SIZE);
+	cache->keys = malloc_array(cache->capacity, sizeof(*cache->keys));
+	cache->referenced = calloc(cache->capacity,
+				   sizeof(*cache->referenced));
+	if (!cache->pages || !cache->keys || !cache->referenced) {
+		drgn_memory_cache_free(cache);
+		return false;
+	}
+	for (i = 0; i < cache->capacity; i++)
+		cache->keys[i] = DRGN_MEMORY_CACHE_EMPTY;
+	cache->hand = 0;
+	return true;
+}
+
+static void drgn_memory_segment_index_init(struct drgn_memory_segment_index *index)
+{
+	drgn_memory_segment_ordered_index_init(&index->segments);
+	index->valid = false;
+}
+
+static void
+drgn_memory_segment_index_deinit(struct drgn_memory_segment_index *index)
+{
+	drgn_memory_segment_ordered_index_deinit(&index->segments);
+}
+
+static struct drgn_error *
+drgn_memory_segment_index_build(struct drgn_memory_segment_index *index,
+				struct drgn_memory_segment_tree *tree)
+{
+	struct drgn_memory_segment_tree_iterator it;
+	struct drgn_memory_segment_vector segments = VECTOR_INIT;
+
+	for (it = drgn_memory_segment_tree_first(tree); it.entry;
+	     it = drgn_memory_segment_tree_next(it)) {
+		if (!drgn_memory_segment_vector_append(&segments, &it.entry))
+			goto enomem;
+	}
+	drgn_memory_segment_vector_shrink_to_fit(&segments);
+	if (!drgn_memory_segment_ordered_index_build(&index->segments,
+						     segments.data,
+						     segments.size))
+		goto enomem;
+	index->valid = true;
+	return NULL;
+
+enomem:
+	drgn_memory_segment_vector_deinit(&segments);
+	return &drgn_enomem;
+}
 
 void drgn_memory_reader_init(struct drgn_memory_reader *reader)
 {
+	pthread_mutexattr_t attr;
+
+	/* Reads may recurse (e.g., for address translation). */
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&reader->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
 	drgn_memory_segment_tree_init(&reader->virtual_segments);
 	drgn_memory_segment_tree_init(&reader->physical_segments);
+	drgn_memory_segment_index_init(&reader->virtual_index);
+	drgn_memory_segment_index_init(&reader->physical_index);
+	drgn_memory_cache_init(&reader->cache);
+	reader->num_snapshots = 0;
+	reader->snapshot_hand = 0;
+	reader->recorder = NULL;
+	reader->read_many_fn = NULL;
+	reader->read_many_arg = NULL;
+	reader->present_fn = NULL;
+	reader->present_arg = NULL;
+	pthread_mutex_init(&reader->prefetcher.lock, NULL);
+	pthread_cond_init(&reader->prefetcher.cond, NULL);
+	reader->prefetcher.running = false;
+	reader->prefetcher.stop = false;
+	reader->prefetcher.disabled = false;
+	reader->prefetcher.head = 0;
+	reader->prefetcher.count = 0;
+	memset(&reader->throttle, 0, sizeof(reader->throttle));
+	reader->throttle.page_key = DRGN_MEMORY_CACHE_EMPTY;
 }
 
 static void free_memory_segment_tree(struct drgn_memory_segment_tree *tree)
@@ -30,10 +158,309 @@ static void free_memory_segment_tree(struct drgn_memory_segment_tree *tree)
 	}
 }
 
+static void drgn_memory_reader_drop_snapshots(struct drgn_memory_reader *reader)
+{
+	size_t i;
+
+	for (i = 0; i < reader->num_snapshots; i++)
+		free(reader->snapshots[i].buf);
+	reader->num_snapshots = 0;
+	reader->snapshot_hand = 0;
+}
+
 void drgn_memory_reader_deinit(struct drgn_memory_reader *reader)
 {
+	drgn_memory_reader_disable_prefetch(reader);
+	pthread_cond_destroy(&reader->prefetcher.cond);
+	pthread_mutex_destroy(&reader->prefetcher.lock);
+	drgn_memory_reader_drop_snapshots(reader);
+	free(reader->throttle.page);
+	drgn_memory_cache_deinit(&reader->cache);
+	drgn_memory_segment_index_deinit(&reader->physical_index);
+	drgn_memory_segment_index_deinit(&reader->virtual_index);
 	free_memory_segment_tree(&reader->physical_segments);
 	free_memory_segment_tree(&reader->virtual_segments);
+	pthread_mutex_destroy(&reader->lock);
+}
+
+void drgn_memory_reader_lock(struct drgn_memory_reader *reader)
+{
+	drgn_mutex_lock(&reader->lock);
+}
+
+void drgn_memory_reader_unlock(struct drgn_memory_reader *reader)
+{
+	pthread_mutex_unlock(&reader->lock);
+}
+
+void drgn_memory_reader_set_cache_capacity(struct drgn_memory_reader *reader,
+					   size_t capacity)
+{
+	struct drgn_memory_cache *cache = &reader->cache;
+
+	drgn_memory_reader_lock(reader);
+	drgn_memory_cache_free(cache);
+	drgn_memory_cache_map_deinit(&cache->map);
+	drgn_memory_cache_map_init(&cache->map);
+	cache->capacity = capacity;
+	drgn_memory_reader_unlock(reader);
+}
+
+void drgn_memory_reader_set_read_many(struct drgn_memory_reader *reader,
+				      drgn_memory_read_many_fn fn, void *arg)
+{
+	drgn_memory_reader_lock(reader);
+	reader->read_many_fn = fn;
+	reader->read_many_arg = arg;
+	drgn_memory_reader_unlock(reader);
+}
+
+void drgn_memory_reader_set_present(struct drgn_memory_reader *reader,
+				    drgn_memory_present_fn fn, void *arg)
+{
+	drgn_memory_reader_lock(reader);
+	reader->present_fn = fn;
+	reader->present_arg = arg;
+	drgn_memory_reader_unlock(reader);
+}
+
+void drgn_memory_reader_invalidate_cache(struct drgn_memory_reader *reader)
+{
+	struct drgn_memory_cache *cache = &reader->cache;
+	size_t i;
+
+	drgn_memory_reader_lock(reader);
+	if (cache->pages) {
+		drgn_memory_cache_map_clear(&cache->map);
+		for (i = 0; i < cache->capacity; i++) {
+			cache->keys[i] = DRGN_MEMORY_CACHE_EMPTY;
+			cache->referenced[i] = false;
+		}
+		cache->hand = 0;
+	}
+	cache->last_miss = DRGN_MEMORY_CACHE_EMPTY;
+	reader->throttle.page_key = DRGN_MEMORY_CACHE_EMPTY;
+	drgn_memory_reader_drop_snapshots(reader);
+	drgn_memory_reader_unlock(reader);
+}
+
+static __thread enum drgn_read_priority drgn_read_priority;
+
+LIBDRGN_PUBLIC enum drgn_read_priority
+drgn_set_read_priority(enum drgn_read_priority priority)
+{
+	enum drgn_read_priority old = drgn_read_priority;
+
+	drgn_read_priority = priority;
+	return old;
+}
+
+/* Size of a bucket of a throttle, which is at least min. */
+static double drgn_memory_throttle_burst(uint64_t rate, double min)
+{
+	double burst = rate * (DRGN_MEMORY_THROTTLE_BURST_NS / 1e9);
+
+	return burst > min ? burst : min;
+}
+
+static double
+drgn_memory_throttle_byte_burst(const struct drgn_memory_throttle *throttle)
+{
+	/* Always allow reading at least a page at once. */
+	return drgn_memory_throttle_burst(throttle->bytes_per_sec,
+					  DRGN_MEMORY_CACHE_PAGE_SIZE);
+}
+
+static double
+drgn_memory_throttle_read_burst(const struct drgn_memory_throttle *throttle)
+{
+	return drgn_memory_throttle_burst(throttle->reads_per_sec, 1);
+}
+
+static void drgn_memory_throttle_refill(struct drgn_memory_throttle *throttle)
+{
+	uint64_t now = monotonic_ns();
+	double seconds = (now - throttle->refill_ns) / 1e9, burst;
+
+	throttle->refill_ns = now;
+	if (throttle->bytes_per_sec) {
+		burst = drgn_memory_throttle_byte_burst(throttle);
+		throttle->byte_tokens += throttle->bytes_per_sec * seconds;
+		if (throttle->byte_tokens > burst)
+			throttle->byte_tokens = burst;
+	}
+	if (throttle->reads_per_sec) {
+		burst = drgn_memory_throttle_read_burst(throttle);
+		throttle->read_tokens += throttle->reads_per_sec * seconds;
+		if (throttle->read_tokens > burst)
+			throttle->read_tokens = burst;
+	}
+}
+
+/*
+ * Get the number of nanoseconds until both buckets of a throttle hold at least
+ * the given fraction of a burst.
+ */
+static uint64_t
+drgn_memory_throttle_delay(const struct drgn_memory_throttle *throttle,
+			   double fraction)
+{
+	double delay = 0.0, need;
+
+	if (throttle->bytes_per_sec) {
+		need = (fraction * drgn_memory_throttle_byte_burst(throttle) -
+			throttle->byte_tokens);
+		if (need / throttle->bytes_per_sec > delay)
+			delay = need / throttle->bytes_per_sec;
+	}
+	if (throttle->reads_per_sec) {
+		need = (fraction * drgn_memory_throttle_read_burst(throttle) -
+			throttle->read_tokens);
+		if (need / throttle->reads_per_sec > delay)
+			delay = need / throttle->reads_per_sec;
+	}
+	return delay > 0.0 ? (uint64_t)(delay * 1e9) + 1 : 0;
+}
+
+static void drgn_memory_throttle_nanosleep(uint64_t ns)
+{
+	struct timespec ts = {
+		.tv_sec = ns / 1000000000,
+		.tv_nsec = ns % 1000000000,
+	};
+
+	while (nanosleep(&ts, &ts) == -1 && errno == EINTR);
+}
+
+/* Sleep for a throttle delay. The reader lock must be held. */
+static void drgn_memory_throttle_sleep(struct drgn_memory_reader *reader,
+				       uint64_t ns)
+{
+	reader->stats.throttle_waits++;
+	reader->stats.throttle_ns += ns;
+	drgn_memory_throttle_nanosleep(ns);
+}
+
+void drgn_memory_reader_set_throttle(struct drgn_memory_reader *reader,
+				     uint64_t bytes_per_sec,
+				     uint64_t reads_per_sec)
+{
+	struct drgn_memory_throttle *throttle = &reader->throttle;
+
+	drgn_memory_reader_lock(reader);
+	throttle->bytes_per_sec = bytes_per_sec;
+	throttle->reads_per_sec = reads_per_sec;
+	/* Start with a full burst. */
+	throttle->byte_tokens = drgn_memory_throttle_byte_burst(throttle);
+	throttle->read_tokens = drgn_memory_throttle_read_burst(throttle);
+	throttle->refill_ns = monotonic_ns();
+	throttle->page_key = DRGN_MEMORY_CACHE_EMPTY;
+	drgn_memory_reader_unlock(reader);
+}
+
+/*
+ * Charge a read from a segment to the throttle, sleeping if it is over the
+ * limit. The reader lock must be held.
+ */
+static void drgn_memory_reader_throttle(struct drgn_memory_reader *reader,
+					uint64_t bytes, uint64_t reads)
+{
+	struct drgn_memory_throttle *throttle = &reader->throttle;
+	uint64_t delay;
+
+	if (!throttle->bytes_per_sec && !throttle->reads_per_sec)
+		return;
+	drgn_memory_throttle_refill(throttle);
+	throttle->byte_tokens -= bytes;
+	throttle->read_tokens -= reads;
+	delay = drgn_memory_throttle_delay(throttle, 0.0);
+	if (delay)
+		drgn_memory_throttle_sleep(reader, delay);
+}
+
+/*
+ * If the current thread's reads are background reads, wait until half of a
+ * burst is available before taking the reader lock for a read. This must be
+ * called without the reader lock held.
+ */
+static void
+drgn_memory_reader_background_wait(struct drgn_memory_reader *reader)
+{
+	struct drgn_memory_throttle *throttle = &reader->throttle;
+	uint64_t delay;
+
+	if (drgn_read_priority != DRGN_READ_PRIORITY_BACKGROUND)
+		return;
+	for (;;) {
+		drgn_memory_reader_lock(reader);
+		/*
+		 * If this thread is already in a read (e.g., from a read
+		 * callback), it can't give up the lock, so don't wait.
+		 */
+		delay = 0;
+		if (!reader->read_depth &&
+		    (throttle->bytes_per_sec || throttle->reads_per_sec)) {
+			drgn_memory_throttle_refill(throttle);
+			delay = drgn_memory_throttle_delay(throttle, 0.5);
+		}
+		if (delay) {
+			reader->stats.throttle_waits++;
+			reader->stats.throttle_ns += delay;
+		}
+		drgn_memory_reader_unlock(reader);
+		if (!delay)
+			break;
+		/* Sleep without the lock so that interactive reads can go. */
+		drgn_memory_throttle_nanosleep(delay);
+	}
+}
+
+/* Call a segment's read callback, charging it to the throttle. */
+static struct drgn_error *
+drgn_memory_segment_read(struct drgn_memory_reader *reader,
+			 struct drgn_memory_segment *segment, void *buf,
+			 uint64_t address, size_t count, bool physical)
+{
+	drgn_memory_reader_throttle(reader, count, 1);
+	return segment->read_fn(buf, address, count,
+				address - segment->orig_address, segment->arg,
+				physical);
+}
+
+static size_t
+memory_segment_tree_memory_usage(struct drgn_memory_segment_tree *tree)
+{
+	struct drgn_memory_segment_tree_iterator it;
+	size_t size = 0;
+
+	for (it = drgn_memory_segment_tree_first_post_order(tree); it.entry;
+	     it = drgn_memory_segment_tree_next_post_order(it))
+		size += sizeof(*it.entry);
+	return size;
+}
+
+void drgn_memory_reader_memory_usage(struct drgn_memory_reader *reader,
+				     size_t *segments_ret, size_t *cache_ret)
+{
+	struct drgn_memory_cache *cache = &reader->cache;
+	size_t size, i;
+
+	drgn_memory_reader_lock(reader);
+	*segments_ret =
+		(memory_segment_tree_memory_usage(&reader->virtual_segments) +
+		 memory_segment_tree_memory_usage(&reader->physical_segments) +
+		 drgn_memory_segment_ordered_index_memory_usage(&reader->virtual_index.segments) +
+		 drgn_memory_segment_ordered_index_memory_usage(&reader->physical_index.segments));
+	size = drgn_memory_cache_map_memory_usage(&cache->map);
+	if (cache->pages) {
+		size += cache->capacity * (DRGN_MEMORY_CACHE_PAGE_SIZE +
+					   sizeof(cache->keys[0]) +
+					   sizeof(cache->referenced[0]));
+	}
+	for (i = 0; i < reader->num_snapshots; i++)
+		size += reader->snapshots[i].size;
+	*cache_ret = size;
+	drgn_memory_reader_unlock(reader);
 }
 
 bool drgn_memory_reader_empty(struct drgn_memory_reader *reader)
@@ -42,11 +469,54 @@ bool drgn_memory_reader_empty(struct drgn_memory_reader *reader)
 		drgn_memory_segment_tree_empty(&reader->physical_segments));
 }
 
+DEFINE_VECTOR(drgn_memory_range_vector, struct drgn_memory_range)
+
 struct drgn_error *
-drgn_memory_reader_add_segment(struct drgn_memory_reader *reader,
-			       uint64_t address, uint64_t size,
-			       drgn_memory_read_fn read_fn, void *arg,
-			       bool physical)
+drgn_memory_reader_ranges(struct drgn_memory_reader *reader, bool physical,
+			  struct drgn_memory_range **ranges_ret,
+			  size_t *num_ranges_ret)
+{
+	struct drgn_memory_range_vector ranges = VECTOR_INIT;
+	struct drgn_memory_segment_tree *tree;
+	struct drgn_memory_segment_tree_iterator it;
+
+	drgn_memory_reader_lock(reader);
+	tree = physical ? &reader->physical_segments : &reader->virtual_segments;
+	for (it = drgn_memory_segment_tree_first(tree); it.entry;
+	     it = drgn_memory_segment_tree_next(it)) {
+		struct drgn_memory_segment *segment = it.entry;
+		uint64_t last = segment->address + (segment->size - 1);
+		struct drgn_memory_range *range;
+
+		if (ranges.size) {
+			range = &ranges.data[ranges.size - 1];
+			if (range->last != UINT64_MAX &&
+			    range->last + 1 == segment->address) {
+				range->last = last;
+				continue;
+			}
+		}
+		range = drgn_memory_range_vector_append_entry(&ranges);
+		if (!range) {
+			drgn_memory_reader_unlock(reader);
+			drgn_memory_range_vector_deinit(&ranges);
+			return &drgn_enomem;
+		}
+		range->start = segment->address;
+		range->last = last;
+	}
+	drgn_memory_reader_unlock(reader);
+	drgn_memory_range_vector_shrink_to_fit(&ranges);
+	*ranges_ret = ranges.data;
+	*num_ranges_ret = ranges.size;
+	return NULL;
+}
+
+static struct drgn_error *
+drgn_memory_reader_add_segment_locked(struct drgn_memory_reader *reader,
+				      uint64_t address, uint64_t size,
+				      drgn_memory_read_fn read_fn, void *arg,
+				      bool physical, uint64_t block_size)
 {
 	struct drgn_memory_segment_tree *tree = (physical ?
 						 &reader->physical_segments :
@@ -112,6 +582,7 @@ drgn_memory_reader_add_segment(struct drgn_memory_reader *reader,
 			tail->orig_address = it.entry->orig_address;
 			tail->read_fn = it.entry->read_fn;
 			tail->arg = it.entry->arg;
+			tail->block_size = it.entry->block_size;
 
 			drgn_memory_segment_tree_insert(tree, tail,
 							NULL);
@@ -217,19 +688,160 @@ insert:
 	segment->size = size;
 	segment->read_fn = read_fn;
 	segment->arg = arg;
+	segment->block_size = block_size;
 	/* If the segment is stolen, then it's already in the tree. */
 	if (!stolen)
 		drgn_memory_segment_tree_insert(tree, segment, NULL);
 	return NULL;
 }
 
-struct drgn_error *drgn_memory_reader_read(struct drgn_memory_reader *reader,
-					   void *buf, uint64_t address,
-					   size_t count, bool physical)
+/*
+ * The indices have pointers to segments that may be freed when segments are
+ * added, and cached pages may no longer come from the segment that covers them.
+ */
+static void
+drgn_memory_reader_invalidate_segments(struct drgn_memory_reader *reader)
+{
+	reader->virtual_index.valid = false;
+	reader->physical_index.valid = false;
+	drgn_memory_reader_invalidate_cache(reader);
+}
+
+struct drgn_error *
+drgn_memory_reader_add_segment(struct drgn_memory_reader *reader,
+			       uint64_t address, uint64_t size,
+			       drgn_memory_read_fn read_fn, void *arg,
+			       bool physical, uint64_t block_size)
+{
+	struct drgn_error *err;
+
+	if (block_size % DRGN_MEMORY_CACHE_PAGE_SIZE) {
+		return drgn_error_format(DRGN_ERROR_INVALID_ARGUMENT,
+					 "memory segment block size must be a multiple of %" PRIu64,
+					 DRGN_MEMORY_CACHE_PAGE_SIZE);
+	}
+
+	drgn_memory_reader_lock(reader);
+	drgn_memory_reader_invalidate_segments(reader);
+	err = drgn_memory_reader_add_segment_locked(reader, address, size,
+						    read_fn, arg, physical,
+						    block_size);
+	drgn_memory_reader_unlock(reader);
+	return err;
+}
+
+struct drgn_error *
+drgn_memory_reader_add_segments(struct drgn_memory_reader *reader,
+				const struct drgn_memory_segment_spec *segments,
+				size_t num_segments)
+{
+	struct drgn_error *err = NULL;
+	size_t i;
+
+	drgn_memory_reader_lock(reader);
+	drgn_memory_reader_invalidate_segments(reader);
+	for (i = 0; i < num_segments; i++) {
+		err = drgn_memory_reader_add_segment_locked(reader,
+							    segments[i].address,
+							    segments[i].size,
+							    segments[i].read_fn,
+							    segments[i].arg,
+							    segments[i].physical,
+							    0);
+		if (err)
+			break;
+	}
+	drgn_memory_reader_unlock(reader);
+	return err;
+}
+
+/*
+ * Find the segment containing @p address. If there is no such segment, this
+ * succeeds and returns @c NULL in @p ret.
+ */
+static struct drgn_error *
+drgn_memory_reader_find_segment(struct drgn_memory_reader *reader,
+				uint64_t address, bool physical,
+				struct drgn_memory_segment **ret)
+{
+	struct drgn_memory_segment_index *index = (physical ?
+						   &reader->physical_index :
+						   &reader->virtual_index);
+	struct drgn_memory_segment **entry;
+
+	if (!index->valid) {
+		struct drgn_error *err;
+
+		err = drgn_memory_segment_index_build(index,
+						      physical ?
+						      &reader->physical_segments :
+						      &reader->virtual_segments);
+		if (err)
+			return err;
+	}
+
+	/* Find the last segment with segment->address <= address. */
+	entry = drgn_memory_segment_ordered_index_search_le(&index->segments,
+							    address);
+	if (!entry || address - (*entry)->address >= (*entry)->size)
+		*ret = NULL;
+	else
+		*ret = *entry;
+	return NULL;
+}
+
+struct drgn_error *
+drgn_memory_reader_present(struct drgn_memory_reader *reader, uint64_t address,
+			   uint64_t last, bool physical, bool *present_ret,
+			   uint64_t *last_ret)
+{
+	struct drgn_error *err;
+	struct drgn_memory_segment *segment;
+	uint64_t segment_last;
+
+	drgn_memory_reader_lock(reader);
+	err = drgn_memory_reader_find_segment(reader, address, physical,
+					      &segment);
+	if (err)
+		goto out;
+	if (!segment) {
+		/* Everything up to the next segment is absent. */
+		struct drgn_memory_segment_ordered_index *index =
+			physical ? &reader->physical_index.segments :
+			&reader->virtual_index.segments;
+		struct drgn_memory_segment **next;
+
+		next = drgn_memory_segment_ordered_index_search_le(index,
+								   address);
+		next = next ? next + 1 : index->entries;
+		*present_ret = false;
+		if (next < index->entries + index->size &&
+		    (*next)->address - 1 < last)
+			*last_ret = (*next)->address - 1;
+		else
+			*last_ret = last;
+		goto out;
+	}
+
+	segment_last = segment->address + (segment->size - 1);
+	if (last > segment_last)
+		last = segment_last;
+	if (reader->present_fn && segment->arg == reader->present_arg) {
+		err = reader->present_fn(address, last, segment->arg, physical,
+					 present_ret, last_ret);
+	} else {
+		*present_ret = true;
+		*last_ret = last;
+	}
+out:
+	drgn_memory_reader_unlock(reader);
+	return err;
+}
+
+static struct drgn_error *
+drgn_memory_reader_read_uncached(struct drgn_memory_reader *reader, void *buf,
+				 uint64_t address, size_t count, bool physical)
 {
-	struct drgn_memory_segment_tree *tree = (physical ?
-						 &reader->physical_segments :
-						 &reader->virtual_segments);
 	struct drgn_error *err;
 	size_t read = 0;
 
@@ -237,18 +849,20 @@ struct drgn_error *drgn_memory_reader_read(struct drgn_memory_reader *reader,
 		struct drgn_memory_segment *segment;
 		size_t n;
 
-		segment = drgn_memory_segment_tree_search_le(tree,
-							     &address).entry;
-		if (!segment || segment->address + segment->size <= address) {
+		err = drgn_memory_reader_find_segment(reader, address, physical,
+						      &segment);
+		if (err)
+			return err;
+		if (!segment) {
 			return drgn_error_create_fault("could not find memory segment",
 						       address);
 		}
 
 		n = min(segment->address + segment->size - address,
 			(uint64_t)(count - read));
-		err = segment->read_fn((char *)buf + read, address, n,
-				       address - segment->orig_address,
-				       segment->arg, physical);
+		err = drgn_memory_segment_read(reader, segment,
+					       (char *)buf + read, address, n,
+					       physical);
 		if (err)
 			return err;
 
@@ -258,43 +872,1574 @@ struct drgn_error *drgn_memory_reader_read(struct drgn_memory_reader *reader,
 	return NULL;
 }
 
-struct drgn_error *drgn_read_memory_file(void *buf, uint64_t address,
-					 size_t count, uint64_t offset,
-					 void *arg, bool physical)
+/*
+ * Copy a page into the cache, evicting another page if necessary. Returns the
+ * cached copy, or @c NULL if the cache couldn't be allocated.
+ */
+static const char *drgn_memory_cache_insert(struct drgn_memory_cache *cache,
+					    uint64_t key, struct hash_pair hp,
+					    const char *page)
 {
-	struct drgn_memory_file_segment *file_segment = arg;
-	char *p = buf;
-	uint64_t file_offset = file_segment->file_offset + offset;
-	size_t file_count;
+	struct drgn_memory_cache_map_entry entry = {
+		.key = key,
+	};
+	size_t slot;
 
-	if (offset < file_segment->file_size) {
-		file_count = min((uint64_t)count,
-				 file_segment->file_size - offset);
-		count -= file_count;
+	if (!cache->pages && !drgn_memory_cache_alloc(cache))
+		return NULL;
+	while (cache->referenced[cache->hand]) {
+		cache->referenced[cache->hand] = false;
+		if (++cache->hand == cache->capacity)
+			cache->hand = 0;
+	}
+	slot = cache->hand;
+	if (++cache->hand == cache->capacity)
+		cache->hand = 0;
+	if (cache->keys[slot] != DRGN_MEMORY_CACHE_EMPTY)
+		drgn_memory_cache_map_delete(&cache->map, &cache->keys[slot]);
+
+	memcpy(&cache->pages[slot * DRGN_MEMORY_CACHE_PAGE_SIZE], page,
+	       DRGN_MEMORY_CACHE_PAGE_SIZE);
+	entry.value = slot;
+	if (drgn_memory_cache_map_insert_hashed(&cache->map, &entry, hp,
+						NULL) == 1) {
+		cache->keys[slot] = key;
+		cache->referenced[slot] = true;
 	} else {
-		file_count = 0;
+		/*
+		 * Either we couldn't allocate memory or the read callback
+		 * cached the page itself. Either way, the copy in this slot
+		 * won't be found again.
+		 */
+		cache->keys[slot] = DRGN_MEMORY_CACHE_EMPTY;
 	}
-	while (file_count) {
-		ssize_t ret;
+	return &cache->pages[slot * DRGN_MEMORY_CACHE_PAGE_SIZE];
+}
 
-		ret = pread(file_segment->fd, p, file_count, file_offset);
-		if (ret == -1) {
-			if (errno == EINTR) {
-				continue;
-			} else if (errno == EIO && file_segment->eio_is_fault) {
-				return drgn_error_create_fault("could not read memory",
-							       address);
-			} else {
-				return drgn_error_create_os("pread", errno, NULL);
-			}
-		} else if (ret == 0) {
-			return drgn_error_create_fault("short read from memory file",
-						       address);
+/*
+ * Read @p num_pages pages starting at @p start in one call to the segment's
+ * read callback and cache them all. @p page is one of them, and its cached copy
+ * is returned. If they can't be read together, this succeeds and returns @c
+ * NULL in @p ret, and the caller should read only @p page.
+ */
+static struct drgn_error *
+drgn_memory_cache_read_pages(struct drgn_memory_reader *reader,
+			     struct drgn_memory_segment *segment,
+			     uint64_t start, uint64_t num_pages, uint64_t page,
+			     bool physical, const char **ret)
+{
+	struct drgn_memory_cache *cache = &reader->cache;
+	struct drgn_error *err;
+	uint64_t page_index = (page - start) / DRGN_MEMORY_CACHE_PAGE_SIZE;
+	char *buf;
+	uint64_t i;
+
+	*ret = NULL;
+	buf = malloc(num_pages * DRGN_MEMORY_CACHE_PAGE_SIZE);
+	if (!buf)
+		return NULL;
+	reader->stats.cache_readaheads++;
+	err = drgn_memory_segment_read(reader, segment, buf, start,
+				       num_pages * DRGN_MEMORY_CACHE_PAGE_SIZE,
+				       physical);
+	if (err) {
+		/* Some of the pages may not be readable. */
+		if (err->code == DRGN_ERROR_FAULT) {
+			drgn_error_destroy(err);
+			err = NULL;
 		}
-		p += ret;
-		file_count -= ret;
-		file_offset += ret;
+		goto out;
+	}
+
+	/*
+	 * Insert the requested page last so that it can't be evicted by the
+	 * others.
+	 */
+	for (i = 0; i < num_pages; i++) {
+		uint64_t key = (start + i * DRGN_MEMORY_CACHE_PAGE_SIZE) | physical;
+		struct hash_pair hp = drgn_memory_cache_map_hash(&key);
+
+		if (i == page_index ||
+		    drgn_memory_cache_map_search_hashed(&cache->map, &key,
+							hp).entry)
+			continue;
+		if (!drgn_memory_cache_insert(cache, key, hp,
+					      &buf[i * DRGN_MEMORY_CACHE_PAGE_SIZE]))
+			goto out;
+	}
+	{
+		uint64_t key = page | physical;
+
+		*ret = drgn_memory_cache_insert(cache, key,
+						drgn_memory_cache_map_hash(&key),
+						&buf[page_index * DRGN_MEMORY_CACHE_PAGE_SIZE]);
+	}
+out:
+	free(buf);
+	return err;
+}
+
+/*
+ * Read the pages starting at @p page and cache them all. Returns the same as
+ * drgn_memory_cache_read_pages().
+ */
+static struct drgn_error *
+drgn_memory_cache_readahead(struct drgn_memory_reader *reader,
+			    struct drgn_memory_segment *segment, uint64_t page,
+			    bool physical, const char **ret)
+{
+	uint64_t num_pages;
+
+	*ret = NULL;
+	/* Don't let readahead take over the cache. */
+	num_pages = min(min(DRGN_MEMORY_CACHE_READAHEAD_PAGES,
+			    (uint64_t)reader->cache.capacity / 4),
+			(segment->address + segment->size - page) /
+			DRGN_MEMORY_CACHE_PAGE_SIZE);
+	if (num_pages <= 1)
+		return NULL;
+	return drgn_memory_cache_read_pages(reader, segment, page, num_pages,
+					    page, physical, ret);
+}
+
+/*
+ * Read the block containing @p page in a segment with a block size and cache
+ * all of its pages. Returns the same as drgn_memory_cache_read_pages().
+ */
+static struct drgn_error *
+drgn_memory_cache_read_block(struct drgn_memory_reader *reader,
+			     struct drgn_memory_segment *segment, uint64_t page,
+			     bool physical, const char **ret)
+{
+	uint64_t start, end, num_pages;
+
+	*ret = NULL;
+	start = page - page % segment->block_size;
+	if (__builtin_add_overflow(start, segment->block_size, &end))
+		end = UINT64_MAX;
+	/* Only read whole pages that are in the segment. */
+	if (start < segment->address) {
+		start = page - (page - segment->address) /
+			       DRGN_MEMORY_CACHE_PAGE_SIZE *
+			       DRGN_MEMORY_CACHE_PAGE_SIZE;
+	}
+	end = min(end, segment->address + segment->size);
+	num_pages = (end - start) / DRGN_MEMORY_CACHE_PAGE_SIZE;
+	/* Like readahead, don't let one block take over the cache. */
+	if (num_pages <= 1 || num_pages > reader->cache.capacity / 4)
+		return NULL;
+	return drgn_memory_cache_read_pages(reader, segment, start, num_pages,
+					    page, physical, ret);
+}
+
+/*
+ * Get the cached contents of the page at @p page, reading it in if necessary.
+ * If the page can't be cached, this succeeds and returns @c NULL in @p ret, and
+ * the caller should fall back to an uncached read.
+ */
+static struct drgn_error *
+drgn_memory_cache_get(struct drgn_memory_reader *reader, uint64_t page,
+		      bool physical, const char **ret)
+{
+	struct drgn_memory_cache *cache = &reader->cache;
+	struct drgn_error *err;
+	uint64_t key = page | physical;
+	struct hash_pair hp;
+	struct drgn_memory_cache_map_iterator it;
+	struct drgn_memory_segment *segment;
+	char buf[DRGN_MEMORY_CACHE_PAGE_SIZE];
+	bool sequential;
+
+	*ret = NULL;
+	hp = drgn_memory_cache_map_hash(&key);
+	it = drgn_memory_cache_map_search_hashed(&cache->map, &key, hp);
+	if (it.entry) {
+		size_t slot = it.entry->value;
+
+		reader->stats.cache_hits++;
+		DRGN_PROBE(memory_cache_hit, page, physical);
+		cache->referenced[slot] = true;
+		*ret = &cache->pages[slot * DRGN_MEMORY_CACHE_PAGE_SIZE];
+		return NULL;
+	}
+
+	err = drgn_memory_reader_find_segment(reader, page, physical, &segment);
+	if (err)
+		return err;
+	if (!segment ||
+	    segment->address + segment->size - page < DRGN_MEMORY_CACHE_PAGE_SIZE)
+		return NULL;
+
+	reader->stats.cache_misses++;
+	DRGN_PROBE(memory_cache_miss, page, physical);
+	if (segment->block_size) {
+		err = drgn_memory_cache_read_block(reader, segment, page,
+						   physical, ret);
+		if (err || *ret)
+			return err;
+	}
+	/* If we missed the previous page last time, read ahead. */
+	sequential = key == cache->last_miss + DRGN_MEMORY_CACHE_PAGE_SIZE;
+	cache->last_miss = key;
+	if (sequential) {
+		err = drgn_memory_cache_readahead(reader, segment, page,
+						  physical, ret);
+		if (err || *ret)
+			return err;
+	}
+
+	/*
+	 * Read into a temporary buffer first: the read callback may itself read
+	 * through this cache (e.g., to translate a virtual address), so we
+	 * can't pick a slot until it returns.
+	 */
+	err = drgn_memory_segment_read(reader, segment, buf, page, sizeof(buf),
+				       physical);
+	if (err) {
+		/*
+		 * The part of the page that was actually requested may still be
+		 * readable.
+		 */
+		if (err->code == DRGN_ERROR_FAULT) {
+			drgn_error_destroy(err);
+			err = NULL;
+		}
+		return err;
+	}
+	*ret = drgn_memory_cache_insert(cache, key, hp, buf);
+	return NULL;
+}
+
+/*
+ * Copy a read from a snapshot if one contains all of it. Returns whether it was
+ * found.
+ */
+static bool drgn_memory_snapshot_read(struct drgn_memory_reader *reader,
+				      void *buf, uint64_t address, size_t count,
+				      bool physical)
+{
+	size_t i;
+
+	for (i = 0; i < reader->num_snapshots; i++) {
+		struct drgn_memory_snapshot *snapshot = &reader->snapshots[i];
+
+		if (snapshot->physical == physical &&
+		    address >= snapshot->address &&
+		    address - snapshot->address <= snapshot->size &&
+		    count <= snapshot->size - (address - snapshot->address)) {
+			memcpy(buf,
+			       snapshot->buf + (address - snapshot->address),
+			       count);
+			reader->stats.snapshot_hits++;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Serve a read which doesn't cross a page from the page read by the last small
+ * read if that was less than one read interval ago, since the read would have
+ * to wait that long anyways. Otherwise, read the whole page. Returns whether
+ * the read was served.
+ */
+static struct drgn_error *
+drgn_memory_throttle_read_page(struct drgn_memory_reader *reader, void *buf,
+			       uint64_t address, size_t count, bool physical,
+			       bool *ret)
+{
+	struct drgn_memory_throttle *throttle = &reader->throttle;
+	struct drgn_error *err;
+	uint64_t page = address & -DRGN_MEMORY_CACHE_PAGE_SIZE;
+	uint64_t key = page | physical, now = monotonic_ns();
+	char page_buf[DRGN_MEMORY_CACHE_PAGE_SIZE];
+
+	*ret = false;
+	if (throttle->page_key == key &&
+	    now - throttle->page_ns < UINT64_C(1000000000) /
+				      throttle->reads_per_sec) {
+		memcpy(buf, throttle->page + (address - page), count);
+		reader->stats.coalesced_reads++;
+		*ret = true;
+		return NULL;
+	}
+	if (!throttle->page) {
+		throttle->page = malloc(DRGN_MEMORY_CACHE_PAGE_SIZE);
+		if (!throttle->page)
+			return NULL;
+	}
+
+	/*
+	 * Read into a temporary buffer first, since the read callback may do
+	 * small reads of its own (e.g., to translate the address).
+	 */
+	err = drgn_memory_reader_read_uncached(reader, page_buf, page,
+					       sizeof(page_buf), physical);
+	if (err) {
+		/* The requested part of the page may still be readable. */
+		if (err->code == DRGN_ERROR_FAULT) {
+			drgn_error_destroy(err);
+			err = NULL;
+		}
+		return err;
+	}
+	memcpy(throttle->page, page_buf, sizeof(page_buf));
+	throttle->page_key = key;
+	throttle->page_ns = now;
+	memcpy(buf, page_buf + (address - page), count);
+	*ret = true;
+	return NULL;
+}
+
+static struct drgn_error *
+drgn_memory_reader_read_locked(struct drgn_memory_reader *reader, void *buf,
+			       uint64_t address, size_t count, bool physical)
+{
+	struct drgn_error *err;
+
+	if (reader->num_snapshots &&
+	    drgn_memory_snapshot_read(reader, buf, address, count, physical))
+		return NULL;
+
+	if (!reader->cache.capacity && reader->throttle.reads_per_sec &&
+	    count && count < DRGN_MEMORY_CACHE_PAGE_SIZE &&
+	    (address & (DRGN_MEMORY_CACHE_PAGE_SIZE - 1)) + count <=
+	    DRGN_MEMORY_CACHE_PAGE_SIZE) {
+		bool read;
+
+		err = drgn_memory_throttle_read_page(reader, buf, address,
+						     count, physical, &read);
+		if (err || read)
+			return err;
+	}
+
+	if (!reader->cache.capacity || count > DRGN_MEMORY_CACHE_PAGE_SIZE) {
+		return drgn_memory_reader_read_uncached(reader, buf, address,
+							count, physical);
+	}
+
+	while (count) {
+		uint64_t page = address & -DRGN_MEMORY_CACHE_PAGE_SIZE;
+		uint64_t page_offset = address - page;
+		size_t n = min(DRGN_MEMORY_CACHE_PAGE_SIZE - page_offset,
+			       (uint64_t)count);
+		const char *cached;
+
+		err = drgn_memory_cache_get(reader, page, physical, &cached);
+		if (err)
+			return err;
+		if (cached) {
+			memcpy(buf, cached + page_offset, n);
+		} else {
+			err = drgn_memory_reader_read_uncached(reader, buf,
+							       address, n,
+							       physical);
+			if (err)
+				return err;
+		}
+		buf = (char *)buf + n;
+		address += n;
+		count -= n;
+	}
+	return NULL;
+}
+
+struct drgn_error *drgn_memory_reader_read(struct drgn_memory_reader *reader,
+					   void *buf, uint64_t address,
+					   size_t count, bool physical)
+{
+	struct drgn_error *err;
+	uint64_t start_ns = 0;
+
+	drgn_memory_reader_background_wait(reader);
+	drgn_memory_reader_lock(reader);
+	reader->stats.reads++;
+	reader->stats.read_bytes += count;
+	/* Only time the outermost read so that recursive reads don't count twice. */
+	if (reader->read_depth++ == 0)
+		start_ns = monotonic_ns();
+	err = drgn_memory_reader_read_locked(reader, buf, address, count,
+					     physical);
+	if (--reader->read_depth == 0) {
+		uint64_t read_ns = monotonic_ns() - start_ns;
+
+		reader->stats.read_ns += read_ns;
+		DRGN_PROBE(memory_read, address, count, physical, read_ns,
+			   err ? err->code : 0);
+		if (reader->recorder &&
+		    (!err || err->code == DRGN_ERROR_FAULT)) {
+			drgn_memory_recorder_record(reader->recorder, buf,
+						    address, count, physical,
+						    err != NULL);
+		}
+	}
+	drgn_memory_reader_unlock(reader);
+	return err;
+}
+
+struct drgn_error *
+drgn_memory_reader_try_read(struct drgn_memory_reader *reader, void *buf,
+			    uint64_t address, size_t count, bool physical,
+			    bool *ret)
+{
+	struct drgn_error *err;
+
+	/*
+	 * If the backend can tell that part of the range is absent, don't
+	 * bother trying to read it.
+	 */
+	if (count && address + (count - 1) >= address) {
+		uint64_t last = address + (count - 1);
+		uint64_t run_address = address;
+
+		for (;;) {
+			bool present;
+			uint64_t run_last;
+
+			err = drgn_memory_reader_present(reader, run_address,
+							 last, physical,
+							 &present, &run_last);
+			if (err)
+				return err;
+			if (!present) {
+				*ret = false;
+				return NULL;
+			}
+			if (run_last >= last)
+				break;
+			run_address = run_last + 1;
+		}
+	}
+
+	drgn_quiet_faults_begin();
+	err = drgn_memory_reader_read(reader, buf, address, count, physical);
+	drgn_quiet_faults_end();
+	/* Read callbacks outside of libdrgn may still allocate faults. */
+	if (err && err->code == DRGN_ERROR_FAULT) {
+		drgn_error_destroy(err);
+		*ret = false;
+		return NULL;
+	}
+	*ret = !err;
+	return err;
+}
+
+void drgn_memory_reader_map(struct drgn_memory_reader *reader,
+			    uint64_t address, size_t count, bool physical,
+			    const void **ret)
+{
+	struct drgn_error *err;
+	struct drgn_memory_segment *segment;
+	struct drgn_memory_file_segment *file_segment;
+	uint64_t offset;
+
+	*ret = NULL;
+	if (!count)
+		return;
+	drgn_memory_reader_lock(reader);
+	/* Snapshots and recordings must see every read. */
+	if (reader->num_snapshots || reader->recorder)
+		goto out;
+	err = drgn_memory_reader_find_segment(reader, address, physical,
+					      &segment);
+	if (err) {
+		drgn_error_destroy(err);
+		goto out;
+	}
+	if (!segment || segment->read_fn != drgn_read_memory_file ||
+	    segment->address + segment->size - address < count)
+		goto out;
+	file_segment = segment->arg;
+	offset = address - segment->orig_address;
+	if (!file_segment->map || offset > file_segment->file_size ||
+	    count > file_segment->file_size - offset)
+		goto out;
+	reader->stats.reads++;
+	reader->stats.read_bytes += count;
+	file_segment->stats->file_bytes += count;
+	*ret = file_segment->map + offset;
+out:
+	drgn_memory_reader_unlock(reader);
+}
+
+struct drgn_error *drgn_memory_reader_snapshot(struct drgn_memory_reader *reader,
+					       uint64_t address, size_t size,
+					       bool physical)
+{
+	struct drgn_error *err;
+	struct drgn_memory_snapshot *snapshot;
+	char *buf;
+
+	if (!size)
+		return NULL;
+	buf = malloc(size);
+	if (!buf)
+		return &drgn_enomem;
+	drgn_memory_reader_lock(reader);
+	err = drgn_memory_reader_read(reader, buf, address, size, physical);
+	if (err) {
+		free(buf);
+		goto out;
+	}
+	snapshot = &reader->snapshots[reader->snapshot_hand];
+	if (reader->num_snapshots == DRGN_MEMORY_SNAPSHOT_MAX)
+		free(snapshot->buf);
+	else
+		reader->num_snapshots++;
+	if (++reader->snapshot_hand == DRGN_MEMORY_SNAPSHOT_MAX)
+		reader->snapshot_hand = 0;
+	snapshot->address = address;
+	snapshot->size = size;
+	snapshot->physical = physical;
+	snapshot->buf = buf;
+out:
+	drgn_memory_reader_unlock(reader);
+	return err;
+}
+
+struct drgn_error *
+drgn_memory_reader_read_string_chunk(struct drgn_memory_reader *reader,
+				     void *buf, uint64_t address, size_t count,
+				     bool physical, size_t *ret)
+{
+	struct drgn_error *err;
+	size_t n;
+
+	n = min((uint64_t)count,
+		DRGN_STRING_CHUNK_SIZE - (address & (DRGN_STRING_CHUNK_SIZE - 1)));
+	if (n > 1) {
+		bool read;
+
+		err = drgn_memory_reader_try_read(reader, buf, address, n,
+						  physical, &read);
+		if (err)
+			return err;
+		if (read) {
+			*ret = n;
+			return NULL;
+		}
+	}
+	err = drgn_memory_reader_read(reader, buf, address, 1, physical);
+	if (err)
+		return err;
+	*ret = 1;
+	return NULL;
+}
+
+/*
+ * Maximum number of pages that the prefetch thread reads at once, so that it
+ * doesn't hold the reader lock for long.
+ */
+#define DRGN_MEMORY_PREFETCH_RUN_PAGES UINT64_C(8)
+
+/*
+ * Read the next run of uncached pages from *@p page through @p last into the
+ * cache and advance *@p page past it. *@p budget is decremented by the number
+ * of pages read or skipped, and no more pages are considered once it reaches
+ * zero. Returns whether there may be more pages to prefetch. Errors are ignored
+ * since this is only a hint.
+ */
+static bool drgn_memory_prefetch_run(struct drgn_memory_reader *reader,
+				     uint64_t *page, uint64_t last,
+				     bool physical, uint64_t *budget)
+{
+	struct drgn_memory_cache *cache = &reader->cache;
+	struct drgn_error *err;
+	struct drgn_memory_segment *segment;
+	uint64_t start, num_pages, max_pages;
+	const char *cached;
+	bool done;
+
+	/* Don't let prefetching take over the cache. */
+	*budget = min(*budget, (uint64_t)cache->capacity / 4);
+	if (!*budget)
+		return false;
+
+	/* Skip pages which are already cached. */
+	for (;;) {
+		uint64_t key = *page | physical;
+
+		if (!drgn_memory_cache_map_search(&cache->map, &key).entry)
+			break;
+		if (*page == last || !--*budget)
+			return false;
+		*page += DRGN_MEMORY_CACHE_PAGE_SIZE;
+	}
+
+	start = *page;
+	err = drgn_memory_reader_find_segment(reader, start, physical,
+					      &segment);
+	if (err) {
+		drgn_error_destroy(err);
+		return false;
+	}
+	if (!segment ||
+	    segment->address + segment->size - start <
+	    DRGN_MEMORY_CACHE_PAGE_SIZE) {
+		/* This page can't be cached, but the next one may be. */
+		if (start == last || !--*budget)
+			return false;
+		*page = start + DRGN_MEMORY_CACHE_PAGE_SIZE;
+		return true;
+	}
+
+	max_pages = min(DRGN_MEMORY_PREFETCH_RUN_PAGES, *budget);
+	num_pages = 1;
+	for (;;) {
+		uint64_t next = start + (num_pages - 1) *
+				DRGN_MEMORY_CACHE_PAGE_SIZE;
+		uint64_t key;
+
+		if (next == last || num_pages == max_pages)
+			break;
+		next += DRGN_MEMORY_CACHE_PAGE_SIZE;
+		key = next | physical;
+		if (segment->address + segment->size - next <
+		    DRGN_MEMORY_CACHE_PAGE_SIZE ||
+		    drgn_memory_cache_map_search(&cache->map, &key).entry)
+			break;
+		num_pages++;
+	}
+	done = start + (num_pages - 1) * DRGN_MEMORY_CACHE_PAGE_SIZE == last;
+
+	/*
+	 * Bump the read depth so that nested reads (e.g., for address
+	 * translation) aren't timed or recorded as if they were requested.
+	 */
+	reader->read_depth++;
+	err = drgn_memory_cache_read_pages(reader, segment, start, num_pages,
+					   start, physical, &cached);
+	reader->read_depth--;
+	drgn_error_destroy(err);
+
+	*budget -= num_pages;
+	if (done)
+		return false;
+	*page = start + num_pages * DRGN_MEMORY_CACHE_PAGE_SIZE;
+	return true;
+}
+
+static void *drgn_memory_prefetch_thread(void *arg)
+{
+	struct drgn_memory_reader *reader = arg;
+	struct drgn_memory_prefetcher *prefetcher = &reader->prefetcher;
+
+	/* Faults are ignored, so don't bother formatting them. */
+	drgn_quiet_faults_begin();
+	drgn_set_read_priority(DRGN_READ_PRIORITY_BACKGROUND);
+	pthread_mutex_lock(&prefetcher->lock);
+	for (;;) {
+		struct drgn_memory_prefetch_request request;
+		uint64_t page, last, budget = UINT64_MAX;
+		bool more;
+
+		while (!prefetcher->count && !prefetcher->stop)
+			pthread_cond_wait(&prefetcher->cond, &prefetcher->lock);
+		if (prefetcher->stop)
+			break;
+		request = prefetcher->queue[prefetcher->head];
+		prefetcher->head = ((prefetcher->head + 1) %
+				    DRGN_MEMORY_PREFETCH_QUEUE_SIZE);
+		prefetcher->count--;
+
+		page = request.address & -DRGN_MEMORY_CACHE_PAGE_SIZE;
+		last = request.last & -DRGN_MEMORY_CACHE_PAGE_SIZE;
+		do {
+			pthread_mutex_unlock(&prefetcher->lock);
+			drgn_memory_reader_background_wait(reader);
+			drgn_memory_reader_lock(reader);
+			more = drgn_memory_prefetch_run(reader, &page, last,
+							request.physical,
+							&budget);
+			drgn_memory_reader_unlock(reader);
+			pthread_mutex_lock(&prefetcher->lock);
+		} while (more && !prefetcher->stop);
+	}
+	pthread_mutex_unlock(&prefetcher->lock);
+	drgn_quiet_faults_end();
+	return NULL;
+}
+
+void drgn_memory_reader_prefetch_async(struct drgn_memory_reader *reader,
+				       uint64_t address, uint64_t size,
+				       bool physical)
+{
+	struct drgn_memory_prefetcher *prefetcher = &reader->prefetcher;
+	struct drgn_memory_prefetch_request *request;
+	uint64_t last;
+
+	if (!size)
+		return;
+	if (__builtin_add_overflow(address, size - 1, &last))
+		last = UINT64_MAX;
+
+	pthread_mutex_lock(&prefetcher->lock);
+	if (prefetcher->disabled)
+		goto out;
+	if (!prefetcher->running) {
+		if (pthread_create(&prefetcher->thread, NULL,
+				   drgn_memory_prefetch_thread, reader)) {
+			/* Hints are best effort, so don't keep trying. */
+			prefetcher->disabled = true;
+			goto out;
+		}
+		prefetcher->running = true;
+	}
+	/* Newer hints are more likely to be needed soon. */
+	if (prefetcher->count == DRGN_MEMORY_PREFETCH_QUEUE_SIZE) {
+		prefetcher->head = ((prefetcher->head + 1) %
+				    DRGN_MEMORY_PREFETCH_QUEUE_SIZE);
+		prefetcher->count--;
+	}
+	request = &prefetcher->queue[(prefetcher->head + prefetcher->count) %
+				     DRGN_MEMORY_PREFETCH_QUEUE_SIZE];
+	request->address = address;
+	request->last = last;
+	request->physical = physical;
+	prefetcher->count++;
+	pthread_cond_signal(&prefetcher->cond);
+out:
+	pthread_mutex_unlock(&prefetcher->lock);
+}
+
+bool drgn_memory_reader_prefetch_enabled(struct drgn_memory_reader *reader)
+{
+	bool enabled;
+
+	pthread_mutex_lock(&reader->prefetcher.lock);
+	enabled = !reader->prefetcher.disabled;
+	pthread_mutex_unlock(&reader->prefetcher.lock);
+	return enabled;
+}
+
+void drgn_memory_reader_disable_prefetch(struct drgn_memory_reader *reader)
+{
+	struct drgn_memory_prefetcher *prefetcher = &reader->prefetcher;
+	bool running;
+
+	pthread_mutex_lock(&prefetcher->lock);
+	prefetcher->disabled = true;
+	prefetcher->count = 0;
+	running = prefetcher->running;
+	if (running) {
+		prefetcher->stop = true;
+		prefetcher->running = false;
+		pthread_cond_signal(&prefetcher->cond);
+	}
+	pthread_mutex_unlock(&prefetcher->lock);
+	if (running)
+		pthread_join(prefetcher->thread, NULL);
+}
+
+/* Maximum size of a coalesced read in drgn_memory_reader_read_batch(). */
+#define DRGN_MEMORY_BATCH_COALESCE_SIZE (UINT64_C(64) * 1024)
+
+static int drgn_memory_read_request_cmp(const void *_a, const void *_b)
+{
+	const struct drgn_memory_read_request *a =
+		*(struct drgn_memory_read_request * const *)_a;
+	const struct drgn_memory_read_request *b =
+		*(struct drgn_memory_read_request * const *)_b;
+
+	if (a->physical != b->physical)
+		return a->physical ? 1 : -1;
+	if (a->address < b->address)
+		return -1;
+	else if (a->address > b->address)
+		return 1;
+	else
+		return 0;
+}
+
+/*
+ * Read the uncached pages needed by a sorted batch from segments that the
+ * reader's read_many_fn can read, all in one call, and cache them. Like
+ * readahead, this is only an optimization: pages that it doesn't cache are read
+ * normally afterwards.
+ */
+static struct drgn_error *
+drgn_memory_reader_prefetch(struct drgn_memory_reader *reader,
+			    struct drgn_memory_read_request **sorted,
+			    size_t num_requests)
+{
+	struct drgn_memory_cache *cache = &reader->cache;
+	struct drgn_error *err = NULL;
+	/* Don't let a batch take over the cache. */
+	size_t max_pages = cache->capacity / 4, num_pages = 0, i;
+	struct drgn_memory_read_request *pages;
+	char *buf = NULL;
+	bool *ok = NULL;
+	bool have_prev = false, prev_physical = false;
+	uint64_t prev_page = 0;
+
+	if (max_pages < 2)
+		return NULL;
+	pages = malloc_array(max_pages, sizeof(*pages));
+	if (!pages)
+		return NULL;
+	for (i = 0; i < num_requests && num_pages < max_pages; i++) {
+		const struct drgn_memory_read_request *request = sorted[i];
+		uint64_t page, last;
+
+		if (!request->count ||
+		    __builtin_add_overflow(request->address,
+					   request->count - 1, &last))
+			continue;
+		page = request->address & -DRGN_MEMORY_CACHE_PAGE_SIZE;
+		last &= -DRGN_MEMORY_CACHE_PAGE_SIZE;
+		for (;;) {
+			uint64_t key = page | request->physical;
+			struct drgn_memory_segment *segment;
+
+			/* The batch is sorted, so skip pages we already saw. */
+			if (!have_prev || prev_physical != request->physical ||
+			    page > prev_page) {
+				have_prev = true;
+				prev_physical = request->physical;
+				prev_page = page;
+				if (drgn_memory_cache_map_search(&cache->map,
+								 &key).entry)
+					goto next;
+				err = drgn_memory_reader_find_segment(reader,
+								      page,
+								      request->physical,
+								      &segment);
+				if (err)
+					goto out;
+				if (segment &&
+				    segment->arg == reader->read_many_arg &&
+				    segment->address + segment->size - page >=
+				    DRGN_MEMORY_CACHE_PAGE_SIZE) {
+					pages[num_pages].address = page;
+					pages[num_pages].count =
+						DRGN_MEMORY_CACHE_PAGE_SIZE;
+					pages[num_pages].physical =
+						request->physical;
+					if (++num_pages == max_pages)
+						break;
+				}
+			}
+next:
+			if (page == last)
+				break;
+			page += DRGN_MEMORY_CACHE_PAGE_SIZE;
+		}
+	}
+	/* A single page is read just as well by the normal path. */
+	if (num_pages < 2)
+		goto out;
+
+	buf = malloc_array(num_pages, DRGN_MEMORY_CACHE_PAGE_SIZE);
+	ok = calloc(num_pages, sizeof(*ok));
+	if (!buf || !ok)
+		goto out;
+	for (i = 0; i < num_pages; i++)
+		pages[i].buf = &buf[i * DRGN_MEMORY_CACHE_PAGE_SIZE];
+	reader->stats.cache_readaheads++;
+	reader->stats.cache_misses += num_pages;
+	drgn_memory_reader_throttle(reader,
+				    num_pages * DRGN_MEMORY_CACHE_PAGE_SIZE,
+				    num_pages);
+	err = reader->read_many_fn(pages, num_pages, ok, reader->read_many_arg);
+	if (err)
+		goto out;
+	for (i = 0; i < num_pages; i++) {
+		uint64_t key = pages[i].address | pages[i].physical;
+		struct hash_pair hp = drgn_memory_cache_map_hash(&key);
+
+		if (!ok[i] ||
+		    drgn_memory_cache_map_search_hashed(&cache->map, &key,
+							hp).entry)
+			continue;
+		if (!drgn_memory_cache_insert(cache, key, hp, pages[i].buf))
+			break;
+	}
+out:
+	free(ok);
+	free(buf);
+	free(pages);
+	return err;
+}
+
+static struct drgn_error *
+drgn_memory_reader_read_batch_locked(struct drgn_memory_reader *reader,
+				     struct drgn_memory_read_request *requests,
+				     size_t num_requests)
+{
+	struct drgn_error *err = NULL;
+	struct drgn_memory_read_request **sorted;
+	uint64_t max_coalesce;
+	char *scratch = NULL;
+	size_t i, j, k;
+
+	if (!num_requests)
+		return NULL;
+
+	sorted = malloc_array(num_requests, sizeof(*sorted));
+	if (!sorted)
+		return &drgn_enomem;
+	for (i = 0; i < num_requests; i++)
+		sorted[i] = &requests[i];
+	qsort(sorted, num_requests, sizeof(*sorted),
+	      drgn_memory_read_request_cmp);
+
+	/*
+	 * Reads larger than a page bypass the page cache, so don't coalesce
+	 * past that if the cache is enabled.
+	 */
+	max_coalesce = (reader->cache.capacity ? DRGN_MEMORY_CACHE_PAGE_SIZE :
+			DRGN_MEMORY_BATCH_COALESCE_SIZE);
+
+	if (reader->cache.capacity && reader->read_many_fn) {
+		err = drgn_memory_reader_prefetch(reader, sorted, num_requests);
+		if (err)
+			goto out;
+	}
+
+	for (i = 0; i < num_requests; i = j) {
+		struct drgn_memory_read_request *first = sorted[i];
+		uint64_t start = first->address, end = start + first->count;
+
+		/*
+		 * Merge the following requests which overlap or are adjacent
+		 * to this one, as long as the merged range stays small.
+		 */
+		for (j = i + 1; j < num_requests; j++) {
+			struct drgn_memory_read_request *next = sorted[j];
+			uint64_t next_end;
+
+			if (next->physical != first->physical ||
+			    end < start || next->address > end ||
+			    __builtin_add_overflow(next->address, next->count,
+						   &next_end))
+				break;
+			next_end = max(end, next_end);
+			if (next_end - start > max_coalesce)
+				break;
+			end = next_end;
+		}
+
+		if (j == i + 1) {
+			err = drgn_memory_reader_read_locked(reader, first->buf,
+						      first->address,
+						      first->count,
+						      first->physical);
+			if (err)
+				goto out;
+			continue;
+		}
+
+		if (!scratch) {
+			scratch = malloc(max_coalesce);
+			if (!scratch) {
+				err = &drgn_enomem;
+				goto out;
+			}
+		}
+		err = drgn_memory_reader_read_locked(reader, scratch, start,
+					      end - start, first->physical);
+		if (err)
+			goto out;
+		for (k = i; k < j; k++) {
+			memcpy(sorted[k]->buf, scratch + (sorted[k]->address - start),
+			       sorted[k]->count);
+		}
+	}
+
+out:
+	free(scratch);
+	free(sorted);
+	return err;
+}
+
+struct drgn_error *
+drgn_memory_reader_read_batch(struct drgn_memory_reader *reader,
+			      struct drgn_memory_read_request *requests,
+			      size_t num_requests)
+{
+	struct drgn_error *err;
+
+	uint64_t start_ns = 0;
+	size_t i;
+
+	drgn_memory_reader_background_wait(reader);
+	drgn_memory_reader_lock(reader);
+	reader->stats.reads += num_requests;
+	for (i = 0; i < num_requests; i++)
+		reader->stats.read_bytes += requests[i].count;
+	if (reader->read_depth++ == 0)
+		start_ns = monotonic_ns();
+	err = drgn_memory_reader_read_batch_locked(reader, requests,
+						   num_requests);
+	if (--reader->read_depth == 0) {
+		uint64_t read_ns = monotonic_ns() - start_ns;
+
+		reader->stats.read_ns += read_ns;
+		DRGN_PROBE(memory_read_batch, num_requests, read_ns,
+			   err ? err->code : 0);
+		/*
+		 * If the batch faulted, we don't know which requests were read,
+		 * so they are all recorded as faults.
+		 */
+		if (reader->recorder &&
+		    (!err || err->code == DRGN_ERROR_FAULT)) {
+			for (i = 0; i < num_requests; i++) {
+				drgn_memory_recorder_record(reader->recorder,
+							    requests[i].buf,
+							    requests[i].address,
+							    requests[i].count,
+							    requests[i].physical,
+							    err != NULL);
+			}
+		}
+	}
+	drgn_memory_reader_unlock(reader);
+	return err;
+}
+
+struct drgn_error *drgn_read_memory_file(void *buf, uint64_t address,
+					 size_t count, uint64_t offset,
+					 void *arg, bool physical)
+{
+	struct drgn_memory_file_segment *file_segment = arg;
+	char *p = buf;
+	uint64_t file_offset = file_segment->file_offset + offset;
+	size_t file_count;
+
+	if (offset < file_segment->file_size) {
+		file_count = min((uint64_t)count,
+				 file_segment->file_size - offset);
+		count -= file_count;
+	} else {
+		file_count = 0;
+	}
+	file_segment->stats->file_bytes += file_count;
+	if (file_segment->map) {
+		memcpy(p, file_segment->map + offset, file_count);
+		p += file_count;
+		file_count = 0;
+	} else if (file_segment->compressed && file_count) {
+		struct drgn_error *err;
+
+		if (file_offset > file_segment->compressed->size ||
+		    file_count > file_segment->compressed->size - file_offset) {
+			return drgn_error_create_fault("short read from memory file",
+						       address);
+		}
+		err = drgn_compressed_file_read(file_segment->compressed, p,
+						file_offset, file_count);
+		if (err)
+			return err;
+		p += file_count;
+		file_count = 0;
+	}
+	while (file_count) {
+		ssize_t ret;
+
+		file_segment->stats->file_syscalls++;
+		ret = pread(file_segment->fd, p, file_count, file_offset);
+		if (ret == -1) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno == EIO && file_segment->eio_is_fault) {
+				return drgn_error_create_fault("could not read memory",
+							       address);
+			} else {
+				return drgn_error_create_os("pread", errno, NULL);
+			}
+		} else if (ret == 0) {
+			return drgn_error_create_fault("short read from memory file",
+						       address);
+		}
+		p += ret;
+		file_count -= ret;
+		file_offset += ret;
+	}
+	memset(p, 0, count);
+	return NULL;
+}
+
+static struct hash_pair
+drgn_process_mapped_file_key_hash(const struct drgn_process_mapped_file_key *key)
+{
+	return hash_pair_from_avalanching_hash(hash_combine(key->dev,
+							    key->ino));
+}
+
+static bool
+drgn_process_mapped_file_key_eq(const struct drgn_process_mapped_file_key *a,
+				const struct drgn_process_mapped_file_key *b)
+{
+	return a->dev == b->dev && a->ino == b->ino;
+}
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_process_mapped_file_map,
+			    drgn_process_mapped_file_key_hash,
+			    drgn_process_mapped_file_key_eq)
+DEFINE_VECTOR_FUNCTIONS(drgn_process_mapped_file_vector)
+DEFINE_VECTOR(drgn_process_mapping_vector, struct drgn_process_mapping)
+
+void drgn_memory_process_segment_init(struct drgn_memory_process_segment *segment,
+				      pid_t pid,
+				      struct drgn_memory_stats *stats,
+				      struct drgn_memory_file_segment *fallback)
+{
+	char buf[64];
+	long page_size;
+
+	segment->pid = pid;
+	segment->stats = stats;
+	segment->fallback = fallback;
+	segment->use_fallback = false;
+	segment->mappings = NULL;
+	segment->num_mappings = 0;
+	segment->maps_valid = false;
+	segment->maps_ns = 0;
+	segment->maps_buf = NULL;
+	segment->maps_buf_capacity = 0;
+	drgn_process_mapped_file_vector_init(&segment->files);
+	drgn_process_mapped_file_map_init(&segment->file_map);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	segment->page_size = page_size > 0 ? page_size : 4096;
+	sprintf(buf, "/proc/%ld/maps", (long)pid);
+	segment->maps_fd = open(buf, O_RDONLY);
+	sprintf(buf, "/proc/%ld/pagemap", (long)pid);
+	segment->pagemap_fd = open(buf, O_RDONLY);
+}
+
+void
+drgn_memory_process_segment_deinit(struct drgn_memory_process_segment *segment)
+{
+	size_t i;
+
+	for (i = 0; i < segment->files.size; i++) {
+		struct drgn_process_mapped_file *file = &segment->files.data[i];
+
+		if (file->map)
+			munmap((void *)file->map, file->size);
+		free(file->path);
+	}
+	drgn_process_mapped_file_map_deinit(&segment->file_map);
+	drgn_process_mapped_file_vector_deinit(&segment->files);
+	free(segment->maps_buf);
+	free(segment->mappings);
+	if (segment->pagemap_fd != -1)
+		close(segment->pagemap_fd);
+	if (segment->maps_fd != -1)
+		close(segment->maps_fd);
+}
+
+void
+drgn_memory_process_segment_invalidate(struct drgn_memory_process_segment *segment)
+{
+	segment->maps_valid = false;
+}
+
+/* Stop using the memory map, e.g., because it couldn't be read. */
+static void
+drgn_process_segment_disable_maps(struct drgn_memory_process_segment *segment)
+{
+	close(segment->maps_fd);
+	segment->maps_fd = -1;
+	free(segment->mappings);
+	segment->mappings = NULL;
+	segment->num_mappings = 0;
+}
+
+/*
+ * Get the index of the file with the given device and inode numbers, adding it
+ * if this is the first mapping of it.
+ */
+static bool
+drgn_process_segment_add_file(struct drgn_memory_process_segment *segment,
+			      const struct drgn_process_mapped_file_key *key,
+			      const char *path, size_t *ret)
+{
+	struct drgn_process_mapped_file_map_entry entry = {
+		.key = *key,
+		.value = segment->files.size,
+	};
+	struct drgn_process_mapped_file_map_iterator it;
+	struct drgn_process_mapped_file *file;
+	int r;
+
+	r = drgn_process_mapped_file_map_insert(&segment->file_map, &entry,
+						&it);
+	if (r < 0)
+		return false;
+	if (r == 0) {
+		*ret = it.entry->value;
+		return true;
+	}
+	file = drgn_process_mapped_file_vector_append_entry(&segment->files);
+	if (!file)
+		goto err;
+	file->path = strdup(path);
+	if (!file->path) {
+		drgn_process_mapped_file_vector_pop(&segment->files);
+		goto err;
+	}
+	file->key = *key;
+	file->opened = false;
+	file->map = NULL;
+	file->size = 0;
+	*ret = entry.value;
+	return true;
+
+err:
+	drgn_process_mapped_file_map_delete_iterator(&segment->file_map, it);
+	return false;
+}
+
+/* Parse one line of /proc/$pid/maps, which must be null-terminated. */
+static bool
+drgn_process_segment_parse_mapping(struct drgn_memory_process_segment *segment,
+				   char *line,
+				   struct drgn_process_mapping *mapping)
+{
+	static const char deleted[] = " (deleted)";
+	struct drgn_process_mapped_file_key key;
+	unsigned int major, minor;
+	char perms[5];
+	size_t len;
+	int path_start = -1;
+	char *path;
+
+	if (sscanf(line,
+		   "%" SCNx64 "-%" SCNx64 " %4s %" SCNx64 " %x:%x %" SCNu64 " %n",
+		   &mapping->start, &mapping->end, perms,
+		   &mapping->file_offset, &major, &minor, &key.ino,
+		   &path_start) < 7 || path_start < 0)
+		return false;
+	mapping->readable = perms[0] == 'r';
+	mapping->file = SIZE_MAX;
+	mapping->file_checked = false;
+
+	path = line + path_start;
+	len = strlen(path);
+	if (!mapping->readable || perms[1] == 'w' || path[0] != '/' ||
+	    !key.ino ||
+	    (len >= sizeof(deleted) - 1 &&
+	     strcmp(path + len - (sizeof(deleted) - 1), deleted) == 0))
+		return true;
+	key.dev = makedev(major, minor);
+	/* Failing to add the file only means that it isn't used. */
+	if (!drgn_process_segment_add_file(segment, &key, path,
+					   &mapping->file))
+		mapping->file = SIZE_MAX;
+	return true;
+}
+
+static struct drgn_error *
+drgn_process_segment_read_maps(struct drgn_memory_process_segment *segment)
+{
+	struct drgn_process_mapping_vector mappings = VECTOR_INIT;
+	size_t size = 0;
+	char *line, *end;
+
+	segment->stats->process_map_refreshes++;
+	if (lseek(segment->maps_fd, 0, SEEK_SET) == -1)
+		goto disable;
+	for (;;) {
+		ssize_t ret;
+
+		/* Leave room for a null terminator. */
+		if (segment->maps_buf_capacity - size < 4096) {
+			size_t capacity = max(segment->maps_buf_capacity * 2,
+					      (size_t)65536);
+			char *buf = realloc(segment->maps_buf, capacity);
+
+			if (!buf)
+				return &drgn_enomem;
+			segment->maps_buf = buf;
+			segment->maps_buf_capacity = capacity;
+		}
+		segment->stats->process_syscalls++;
+		ret = read(segment->maps_fd, segment->maps_buf + size,
+			   segment->maps_buf_capacity - size - 1);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			goto disable;
+		} else if (ret == 0) {
+			break;
+		}
+		size += ret;
+	}
+	segment->maps_buf[size] = '\0';
+
+	for (line = segment->maps_buf; *line; line = end) {
+		struct drgn_process_mapping *mapping;
+
+		end = strchrnul(line, '\n');
+		if (*end)
+			*end++ = '\0';
+		mapping = drgn_process_mapping_vector_append_entry(&mappings);
+		if (!mapping) {
+			drgn_process_mapping_vector_deinit(&mappings);
+			return &drgn_enomem;
+		}
+		if (!drgn_process_segment_parse_mapping(segment, line,
+							mapping)) {
+			drgn_process_mapping_vector_deinit(&mappings);
+			goto disable;
+		}
+	}
+	drgn_process_mapping_vector_shrink_to_fit(&mappings);
+	free(segment->mappings);
+	segment->mappings = mappings.data;
+	segment->num_mappings = mappings.size;
+	segment->maps_valid = true;
+	segment->maps_ns = monotonic_ns();
+	return NULL;
+
+disable:
+	/* The map is only an optimization, so fall back to reading blindly. */
+	drgn_process_segment_disable_maps(segment);
+	return NULL;
+}
+
+static struct drgn_process_mapping *
+drgn_process_segment_find_mapping(struct drgn_memory_process_segment *segment,
+				  uint64_t address)
+{
+	size_t lo = 0, hi = segment->num_mappings;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (segment->mappings[mid].start <= address)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo && address < segment->mappings[lo - 1].end)
+		return &segment->mappings[lo - 1];
+	return NULL;
+}
+
+/* Page map entry bits (see Documentation/admin-guide/mm/pagemap.rst). */
+#define PAGEMAP_PRESENT (UINT64_C(1) << 63)
+#define PAGEMAP_SWAPPED (UINT64_C(1) << 62)
+#define PAGEMAP_FILE (UINT64_C(1) << 61)
+
+/*
+ * Check that no page of a mapping is anonymous, i.e., copied on write or
+ * swapped out, so that the mapping still has the contents of its file.
+ */
+static bool
+drgn_process_mapping_is_clean(struct drgn_memory_process_segment *segment,
+			      const struct drgn_process_mapping *mapping)
+{
+	uint64_t entries[512];
+	uint64_t page = mapping->start / segment->page_size;
+	uint64_t end = mapping->end / segment->page_size;
+
+	if (segment->pagemap_fd == -1)
+		return false;
+	while (page < end) {
+		size_t n = min(end - page, (uint64_t)ARRAY_SIZE(entries));
+		ssize_t ret;
+		size_t i;
+
+		segment->stats->process_syscalls++;
+		ret = pread(segment->pagemap_fd, entries,
+			    n * sizeof(entries[0]), page * sizeof(entries[0]));
+		if (ret == -1 && errno == EINTR)
+			continue;
+		if (ret < (ssize_t)sizeof(entries[0]))
+			return false;
+		n = ret / sizeof(entries[0]);
+		for (i = 0; i < n; i++) {
+			if ((entries[i] & PAGEMAP_SWAPPED) ||
+			    ((entries[i] & PAGEMAP_PRESENT) &&
+			     !(entries[i] & PAGEMAP_FILE)))
+				return false;
+		}
+		page += n;
+	}
+	return true;
+}
+
+static void drgn_process_mapped_file_open(struct drgn_process_mapped_file *file)
+{
+	struct stat st;
+	int fd;
+	void *map;
+
+	file->opened = true;
+	fd = open(file->path, O_RDONLY);
+	free(file->path);
+	file->path = NULL;
+	if (fd == -1)
+		return;
+	/* Don't read from a file that has been replaced since it was mapped. */
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) ||
+	    st.st_dev != file->key.dev || st.st_ino != file->key.ino ||
+	    st.st_size <= 0 || (uint64_t)st.st_size > SIZE_MAX) {
+		close(fd);
+		return;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return;
+	file->map = map;
+	file->size = st.st_size;
+}
+
+/*
+ * Try to read from the file that a mapping maps instead of from the process.
+ * Returns whether the read was served.
+ */
+static bool
+drgn_process_mapping_read_file(struct drgn_memory_process_segment *segment,
+			       struct drgn_process_mapping *mapping, void *buf,
+			       uint64_t address, size_t count)
+{
+	struct drgn_process_mapped_file *file;
+	uint64_t file_offset;
+
+	if (!mapping->file_checked) {
+		mapping->file_checked = true;
+		if (!drgn_process_mapping_is_clean(segment, mapping))
+			mapping->file = SIZE_MAX;
+	}
+	if (mapping->file == SIZE_MAX)
+		return false;
+	file = &segment->files.data[mapping->file];
+	if (!file->opened)
+		drgn_process_mapped_file_open(file);
+	/* Past the end of the file, leave it to the process to fault. */
+	file_offset = mapping->file_offset + (address - mapping->start);
+	if (!file->map || file_offset > file->size ||
+	    count > file->size - file_offset)
+		return false;
+	memcpy(buf, file->map + file_offset, count);
+	segment->stats->process_file_bytes += count;
+	return true;
+}
+
+static struct drgn_error *
+drgn_process_segment_read(struct drgn_memory_process_segment *process_segment,
+			  void *buf, uint64_t address, size_t count,
+			  uint64_t offset, bool physical)
+{
+	struct iovec local_iov, remote_iov;
+
+	if (process_segment->use_fallback) {
+		return drgn_read_memory_file(buf, address, count, offset,
+					     process_segment->fallback,
+					     physical);
+	}
+
+	while (count) {
+		ssize_t ret;
+
+		local_iov.iov_base = buf;
+		local_iov.iov_len = count;
+		remote_iov.iov_base = (void *)(uintptr_t)address;
+		remote_iov.iov_len = count;
+		process_segment->stats->process_syscalls++;
+		ret = process_vm_readv(process_segment->pid, &local_iov, 1,
+				       &remote_iov, 1, 0);
+		if (ret == -1) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno == EPERM || errno == ENOSYS) {
+				process_segment->use_fallback = true;
+				return drgn_read_memory_file(buf, address,
+							     count, offset,
+							     process_segment->fallback,
+							     physical);
+			} else if (errno == EFAULT) {
+				return drgn_error_create_fault("could not read memory",
+							       address);
+			} else {
+				return drgn_error_create_os("process_vm_readv",
+							    errno, NULL);
+			}
+		} else if (ret == 0) {
+			return drgn_error_create_fault("could not read memory",
+						       address);
+		}
+		process_segment->stats->process_bytes += ret;
+		buf = (char *)buf + ret;
+		address += ret;
+		offset += ret;
+		count -= ret;
+	}
+	return NULL;
+}
+
+struct drgn_error *drgn_read_memory_process(void *buf, uint64_t address,
+					    size_t count, uint64_t offset,
+					    void *arg, bool physical)
+{
+	struct drgn_error *err;
+	struct drgn_memory_process_segment *segment = arg;
+	bool refreshed = false;
+
+	while (count) {
+		struct drgn_process_mapping *mapping;
+		size_t n;
+
+		if (segment->maps_fd != -1 && !segment->maps_valid) {
+			err = drgn_process_segment_read_maps(segment);
+			if (err)
+				return err;
+			refreshed = true;
+		}
+		if (segment->maps_fd == -1) {
+			return drgn_process_segment_read(segment, buf, address,
+							 count, offset,
+							 physical);
+		}
+
+		/*
+		 * /proc/$pid/mem can read mappings without read permission, but
+		 * process_vm_readv() can't.
+		 */
+		mapping = drgn_process_segment_find_mapping(segment, address);
+		if (!mapping ||
+		    (!mapping->readable && !segment->use_fallback)) {
+			/* Look for a mapping added since the map was read. */
+			if (!refreshed &&
+			    monotonic_ns() - segment->maps_ns >=
+			    DRGN_PROCESS_MAPS_MAX_AGE_NS) {
+				segment->maps_valid = false;
+				continue;
+			}
+			segment->stats->process_map_faults++;
+			return drgn_error_create_fault("could not read memory",
+						       address);
+		}
+
+		n = min((uint64_t)count, mapping->end - address);
+		if (mapping->file == SIZE_MAX ||
+		    !drgn_process_mapping_read_file(segment, mapping, buf,
+						    address, n)) {
+			err = drgn_process_segment_read(segment, buf, address,
+							n, offset, physical);
+			if (err) {
+				/*
+				 * The mapping may have changed since the map
+				 * was read. Read it again and retry once.
+				 */
+				if (err->code == DRGN_ERROR_FAULT &&
+				    !refreshed) {
+					drgn_error_destroy(err);
+					segment->maps_valid = false;
+					continue;
+				}
+				return err;
+			}
+		}
+		buf = (char *)buf + n;
+		address += n;
+		offset += n;
+		count -= n;
 	}
-	memset(p, 0, count);
 	return NULL;
 }
@@ -12,11 +12,16 @@
 #ifndef DRGN_MEMORY_READER_H
 #define DRGN_MEMORY_READER_H
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/types.h>
 
 #include "binary_search_tree.h"
+#include "hash_table.h"
+#include "ordered_index.h"
+#include "vector.h"
 
 /**
  * @ingroup Internals
@@ -49,6 +54,11 @@ struct drgn_memory_segment {
 	drgn_memory_read_fn read_fn;
 	/** Argument to pass to @ref drgn_memory_segment::read_fn. */
 	void *arg;
+	/**
+	 * If non-zero, size of the aligned blocks that cache misses in this
+	 * segment read at once. See @ref drgn_memory_reader_add_segment().
+	 */
+	uint64_t block_size;
 };
 
 static inline uint64_t
@@ -61,17 +71,286 @@ DEFINE_BINARY_SEARCH_TREE_TYPE(drgn_memory_segment_tree, struct
 			       drgn_memory_segment, node,
 			       drgn_memory_segment_to_key)
 
+static inline uint64_t
+drgn_memory_segment_ptr_to_key(struct drgn_memory_segment * const *entry)
+{
+	return (*entry)->address;
+}
+
+DEFINE_ORDERED_INDEX_TYPE(drgn_memory_segment_ordered_index,
+			  struct drgn_memory_segment *, uint64_t)
+
+/**
+ * Ordered index of the segments in a @ref drgn_memory_segment_tree.
+ *
+ * Lookups search this index instead of the tree, since splaying would modify
+ * the tree on every lookup. It is rebuilt from the tree on the first lookup
+ * after segments are added, after which lookups don't write anything.
+ */
+struct drgn_memory_segment_index {
+	/** Segments in order of address. */
+	struct drgn_memory_segment_ordered_index segments;
+	/** Whether @ref segments is up to date with the tree. */
+	bool valid;
+};
+
+/** Size of the pages cached by a @ref drgn_memory_cache. */
+#define DRGN_MEMORY_CACHE_PAGE_SIZE UINT64_C(4096)
+
+/**
+ * Key of an empty slot in a @ref drgn_memory_cache.
+ *
+ * Keys are the page address with the least significant bit set for physical
+ * addresses, so this can never be a valid key.
+ */
+#define DRGN_MEMORY_CACHE_EMPTY UINT64_C(2)
+
+/**
+ * Maximum number of pages that a @ref drgn_memory_cache reads at once when it
+ * detects sequential access.
+ */
+#define DRGN_MEMORY_CACHE_READAHEAD_PAGES UINT64_C(32)
+
+DEFINE_HASH_MAP_TYPE(drgn_memory_cache_map, uint64_t, size_t)
+
+/**
+ * Cache of recently read pages in a @ref drgn_memory_reader.
+ *
+ * Reads no larger than a page are served from this cache. On a miss, the whole
+ * page is read from its segment. Pages which are not entirely contained in one
+ * segment are never cached. Pages are evicted with the CLOCK algorithm. When
+ * consecutive pages miss, the following pages are read ahead in one call to the
+ * segment's read callback.
+ */
+struct drgn_memory_cache {
+	/** Map from page key to slot index. */
+	struct drgn_memory_cache_map map;
+	/**
+	 * Contents of each slot, or @c NULL if the cache hasn't been allocated
+	 * yet.
+	 */
+	char *pages;
+	/** Key of the page in each slot, or @ref DRGN_MEMORY_CACHE_EMPTY. */
+	uint64_t *keys;
+	/** Reference bit of each slot. */
+	bool *referenced;
+	/** Maximum number of cached pages. Zero if the cache is disabled. */
+	size_t capacity;
+	/** Next slot to consider for eviction. */
+	size_t hand;
+	/**
+	 * Key of the last page that missed, or @ref DRGN_MEMORY_CACHE_EMPTY.
+	 * Used to detect sequential access.
+	 */
+	uint64_t last_miss;
+};
+
+/** Maximum number of snapshots kept by a @ref drgn_memory_reader. */
+#define DRGN_MEMORY_SNAPSHOT_MAX 8
+
+/**
+ * Range of memory read in advance by @ref drgn_memory_reader_snapshot().
+ *
+ * Reads entirely contained in a snapshot are served from it, regardless of
+ * their size or whether the page cache is enabled.
+ */
+struct drgn_memory_snapshot {
+	/** Starting address of the range. */
+	uint64_t address;
+	/** Size of the range in bytes. */
+	size_t size;
+	/** Whether @ref address is physical. */
+	bool physical;
+	/** Contents of the range. */
+	char *buf;
+};
+
+/** Maximum number of pending hints in a @ref drgn_memory_prefetcher. */
+#define DRGN_MEMORY_PREFETCH_QUEUE_SIZE 64
+
+/** Range of memory passed to @ref drgn_memory_reader_prefetch_async(). */
+struct drgn_memory_prefetch_request {
+	uint64_t address;
+	/** Last address in the range (inclusive). */
+	uint64_t last;
+	bool physical;
+};
+
+/**
+ * Background thread which reads hinted ranges of memory into the page cache of
+ * a @ref drgn_memory_reader.
+ *
+ * The thread is started by the first hint. It takes the reader lock to read
+ * like any other thread, but only for a few pages at a time so that it doesn't
+ * hold up reads which are actually needed.
+ */
+struct drgn_memory_prefetcher {
+	/**
+	 * Lock protecting the rest of this structure. This may be acquired
+	 * while holding the reader lock, but not the other way around.
+	 */
+	pthread_mutex_t lock;
+	/** Signaled when a hint is queued or the thread should exit. */
+	pthread_cond_t cond;
+	/** Prefetch thread. Only valid if @ref running. */
+	pthread_t thread;
+	/** Whether @ref thread has been started. */
+	bool running;
+	/** Whether @ref thread should exit. */
+	bool stop;
+	/** Whether hints are ignored. */
+	bool disabled;
+	/** Ring buffer of pending hints. */
+	struct drgn_memory_prefetch_request queue[DRGN_MEMORY_PREFETCH_QUEUE_SIZE];
+	/** Index of the oldest hint in @ref queue. */
+	size_t head;
+	/** Number of hints in @ref queue. */
+	size_t count;
+};
+
+/**
+ * Length of the burst allowed by a @ref drgn_memory_throttle, in nanoseconds of
+ * its rates.
+ */
+#define DRGN_MEMORY_THROTTLE_BURST_NS UINT64_C(100000000)
+
+/**
+ * Rate limit on the reads that a @ref drgn_memory_reader makes from its
+ * segments. See @ref drgn_program_set_read_limit().
+ *
+ * Each read is charged to two token buckets, one of bytes and one of reads,
+ * which refill at the limited rates up to one burst. A read which overdraws a
+ * bucket sleeps until it is paid back. Background reads first wait until half
+ * of a burst is available, without holding the reader lock, so that they
+ * don't hold up interactive reads.
+ */
+struct drgn_memory_throttle {
+	/** Maximum bytes per second, or 0 for no limit. */
+	uint64_t bytes_per_sec;
+	/** Maximum reads per second, or 0 for no limit. */
+	uint64_t reads_per_sec;
+	/** Bytes available as of @ref refill_ns. Negative while overdrawn. */
+	double byte_tokens;
+	/** Reads available as of @ref refill_ns. Negative while overdrawn. */
+	double read_tokens;
+	/** monotonic_ns() when the buckets were last refilled. */
+	uint64_t refill_ns;
+	/**
+	 * Page read by the last small read when the number of reads is limited
+	 * and the cache is disabled, or @c NULL if it hasn't been allocated.
+	 */
+	char *page;
+	/** Cache key of @ref page, or @ref DRGN_MEMORY_CACHE_EMPTY. */
+	uint64_t page_key;
+	/** monotonic_ns() when @ref page was read. */
+	uint64_t page_ns;
+};
+
+struct drgn_compressed_file;
+struct drgn_memory_recorder;
+
+/**
+ * Callback which reads many ranges of memory at once, e.g., by pipelining
+ * requests to a remote target.
+ *
+ * @param[in] requests Ranges to read.
+ * @param[in] num_requests Number of ranges.
+ * @param[out] ok For each range, whether it was read. A range which can't be
+ * read is not an error.
+ * @param[in] arg Argument passed to @ref drgn_memory_reader_set_read_many().
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+typedef struct drgn_error *
+(*drgn_memory_read_many_fn)(struct drgn_memory_read_request *requests,
+			    size_t num_requests, bool *ok, void *arg);
+
+/**
+ * Callback which reports whether memory is present without reading it, e.g.,
+ * from the bitmap of pages included in a core dump.
+ *
+ * @param[in] address Address to check.
+ * @param[in] last Last address that the caller is interested in. This is never
+ * past the end of the segment containing @p address.
+ * @param[in] arg Argument passed to @ref drgn_memory_reader_set_present().
+ * @param[in] physical Whether @p address is physical.
+ * @param[out] present_ret Whether the memory at @p address may be readable. If
+ * this is @c false, reading it must fail with a @ref DRGN_ERROR_FAULT error.
+ * @param[out] last_ret Last address, at most @p last, such that all of the
+ * memory from @p address through it has the same answer. This may be less than
+ * the end of the actual run if the callback doesn't want to look further.
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+typedef struct drgn_error *
+(*drgn_memory_present_fn)(uint64_t address, uint64_t last, void *arg,
+			  bool physical, bool *present_ret, uint64_t *last_ret);
+
 /**
  * Memory reader.
  *
  * A memory reader maps the segments of memory in an address space to callbacks
  * which can be used to read memory from those segments.
+ *
+ * All of the functions operating on a memory reader may be called from multiple
+ * threads. They are serialized by a recursive lock, which is held while calling
+ * read callbacks.
  */
 struct drgn_memory_reader {
+	/**
+	 * Lock protecting everything in the reader. See @ref
+	 * drgn_memory_reader_lock().
+	 */
+	pthread_mutex_t lock;
 	/** Virtual memory segments. */
 	struct drgn_memory_segment_tree virtual_segments;
 	/** Physical memory segments. */
 	struct drgn_memory_segment_tree physical_segments;
+	/** Lookup index of @ref virtual_segments. */
+	struct drgn_memory_segment_index virtual_index;
+	/** Lookup index of @ref physical_segments. */
+	struct drgn_memory_segment_index physical_index;
+	/** Page cache. */
+	struct drgn_memory_cache cache;
+	/**
+	 * Snapshots, replaced in round-robin order once there are @ref
+	 * DRGN_MEMORY_SNAPSHOT_MAX.
+	 */
+	struct drgn_memory_snapshot snapshots[DRGN_MEMORY_SNAPSHOT_MAX];
+	/** Number of valid entries in @ref snapshots. */
+	size_t num_snapshots;
+	/** Next entry in @ref snapshots to replace. */
+	size_t snapshot_hand;
+	/**
+	 * Read statistics. These are protected by @ref lock like everything
+	 * else, so they don't need atomic updates.
+	 */
+	struct drgn_memory_stats stats;
+	/** Number of nested calls to @ref drgn_memory_reader_read(). */
+	unsigned int read_depth;
+	/**
+	 * Recorder of outermost reads, or @c NULL if reads aren't being
+	 * recorded. See @ref drgn_program_record_memory().
+	 */
+	struct drgn_memory_recorder *recorder;
+	/**
+	 * Callback for reading many pages of segments whose argument is @ref
+	 * read_many_arg at once, or @c NULL. See @ref
+	 * drgn_memory_reader_set_read_many().
+	 */
+	drgn_memory_read_many_fn read_many_fn;
+	/** Argument to pass to @ref read_many_fn. */
+	void *read_many_arg;
+	/**
+	 * Callback for checking whether memory in segments whose argument is
+	 * @ref present_arg is present, or @c NULL. See @ref
+	 * drgn_memory_reader_set_present().
+	 */
+	drgn_memory_present_fn present_fn;
+	/** Argument to pass to @ref present_fn. */
+	void *present_arg;
+	/** Background prefetching. */
+	struct drgn_memory_prefetcher prefetcher;
+	/** Read rate limit. */
+	struct drgn_memory_throttle throttle;
 };
 
 /**
@@ -84,15 +363,211 @@ void drgn_memory_reader_init(struct drgn_memory_reader *reader);
 /** Deinitialize a @ref drgn_memory_reader. */
 void drgn_memory_reader_deinit(struct drgn_memory_reader *reader);
 
+/**
+ * Lock a @ref drgn_memory_reader.
+ *
+ * The lock is recursive. This only needs to be called directly to protect
+ * other state which is used by read callbacks, like address translation.
+ */
+void drgn_memory_reader_lock(struct drgn_memory_reader *reader);
+
+/** Unlock a @ref drgn_memory_reader locked with @ref drgn_memory_reader_lock(). */
+void drgn_memory_reader_unlock(struct drgn_memory_reader *reader);
+
 /** Return whether a @ref drgn_memory_reader has no segments. */
 bool drgn_memory_reader_empty(struct drgn_memory_reader *reader);
 
-/** @sa drgn_program_add_memory_segment() */
+/** Range of memory covered by contiguous segments. */
+struct drgn_memory_range {
+	uint64_t start;
+	/** Last address in the range (inclusive). */
+	uint64_t last;
+};
+
+/**
+ * Get the ranges of memory covered by the segments of an address space in a
+ * @ref drgn_memory_reader, in order of address. Contiguous segments are merged
+ * into one range.
+ *
+ * @param[out] ranges_ret Returned array of ranges, which must be freed with
+ * @c free(), or @c NULL if there are none.
+ * @param[out] num_ranges_ret Returned number of ranges.
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *
+drgn_memory_reader_ranges(struct drgn_memory_reader *reader, bool physical,
+			  struct drgn_memory_range **ranges_ret,
+			  size_t *num_ranges_ret);
+
+/**
+ * @sa drgn_program_add_memory_segment()
+ *
+ * @param[in] block_size If non-zero, a multiple of @ref
+ * DRGN_MEMORY_CACHE_PAGE_SIZE. When the page cache misses in this segment, the
+ * whole block of this size aligned to this size which contains the page is read
+ * with one call to @p read_fn (clipped to the segment) and cached, unless it
+ * would take up more than a quarter of the cache.
+ */
 struct drgn_error *
 drgn_memory_reader_add_segment(struct drgn_memory_reader *reader,
 			       uint64_t address, uint64_t size,
 			       drgn_memory_read_fn read_fn, void *arg,
-			       bool physical);
+			       bool physical, uint64_t block_size);
+
+/**
+ * Segment to add with @ref drgn_memory_reader_add_segments(). These never have
+ * a block size.
+ */
+struct drgn_memory_segment_spec {
+	uint64_t address;
+	uint64_t size;
+	drgn_memory_read_fn read_fn;
+	void *arg;
+	bool physical;
+};
+
+/**
+ * Add many segments to a @ref drgn_memory_reader.
+ *
+ * This is equivalent to calling @ref drgn_memory_reader_add_segment() for each
+ * segment in order, but the cache and segment indices are only invalidated
+ * once. If this fails, some of the segments may have been added.
+ */
+struct drgn_error *
+drgn_memory_reader_add_segments(struct drgn_memory_reader *reader,
+				const struct drgn_memory_segment_spec *segments,
+				size_t num_segments);
+
+/**
+ * Set the maximum number of pages cached by a @ref drgn_memory_reader.
+ *
+ * This discards any cached pages. Memory for the cache is allocated the next
+ * time it is needed. If that allocation fails, reads bypass the cache.
+ *
+ * @param[in] capacity Number of pages. Zero disables the cache.
+ */
+void drgn_memory_reader_set_cache_capacity(struct drgn_memory_reader *reader,
+					   size_t capacity);
+
+/**
+ * Set a callback for reading many pages at once.
+ *
+ * When the page cache is enabled, @ref drgn_memory_reader_read_batch() first
+ * reads all of the uncached pages that the batch needs from segments whose
+ * argument is @p arg with one call to @p fn and caches them. This lets a slow
+ * backend overlap the reads instead of serving them one at a time.
+ *
+ * @param[in] fn Callback, or @c NULL to unset it.
+ * @param[in] arg Argument to pass to @p fn. This is also the argument of the
+ * segments that @p fn can read.
+ */
+void drgn_memory_reader_set_read_many(struct drgn_memory_reader *reader,
+				      drgn_memory_read_many_fn fn, void *arg);
+
+/**
+ * Set the callback for checking whether memory is present without reading it.
+ *
+ * @param[in] fn Callback, or @c NULL to unset it.
+ * @param[in] arg Argument to pass to @p fn. This is also the argument of the
+ * segments that @p fn can answer for.
+ */
+void drgn_memory_reader_set_present(struct drgn_memory_reader *reader,
+				    drgn_memory_present_fn fn, void *arg);
+
+/**
+ * Check whether memory is present without reading it.
+ *
+ * Memory which isn't in any segment is absent. Memory in a segment is absent if
+ * the segment's backend says so with its @ref drgn_memory_present_fn, and is
+ * otherwise assumed to be present. This lets scanners skip large runs of
+ * memory that can't be read (e.g., pages excluded from a core dump) without
+ * trying to read them page by page.
+ *
+ * @param[in] address Address to check.
+ * @param[in] last Last address that the caller is interested in.
+ * @param[out] present_ret Whether the memory at @p address may be readable.
+ * @param[out] last_ret Last address, at most @p last, through which the memory
+ * starting at @p address has the same answer.
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *
+drgn_memory_reader_present(struct drgn_memory_reader *reader, uint64_t address,
+			   uint64_t last, bool physical, bool *present_ret,
+			   uint64_t *last_ret);
+
+/**
+ * Hint that a range of memory will be read soon.
+ *
+ * This queues the range to be read into the page cache by a background thread
+ * and returns immediately. Read callbacks may be called from that thread (with
+ * the reader lock held, as usual). Pages which are already cached are skipped.
+ * If too many hints are pending, the oldest ones are dropped.
+ *
+ * @param[in] size Size of the range in bytes. At most a quarter of the cache is
+ * filled by one hint.
+ */
+void drgn_memory_reader_prefetch_async(struct drgn_memory_reader *reader,
+				       uint64_t address, uint64_t size,
+				       bool physical);
+
+/**
+ * Return whether hints passed to @ref drgn_memory_reader_prefetch_async() may
+ * be used.
+ *
+ * Callers which need to do extra work to come up with a hint can check this
+ * first.
+ */
+bool drgn_memory_reader_prefetch_enabled(struct drgn_memory_reader *reader);
+
+/**
+ * Stop prefetching and ignore any future hints.
+ *
+ * This must be called before freeing anything that read callbacks use, and
+ * when adding a segment whose read callback must not be called from another
+ * thread (e.g., because it needs a lock that a reader may hold while waiting
+ * for the reader lock). It waits for the prefetch thread to exit, so it must
+ * not be called with the reader lock held.
+ */
+void drgn_memory_reader_disable_prefetch(struct drgn_memory_reader *reader);
+
+/**
+ * Set the read rate limits of a @ref drgn_memory_reader. See @ref
+ * drgn_program_set_read_limit().
+ */
+void drgn_memory_reader_set_throttle(struct drgn_memory_reader *reader,
+				     uint64_t bytes_per_sec,
+				     uint64_t reads_per_sec);
+
+/**
+ * Discard all pages and snapshots cached by a @ref drgn_memory_reader.
+ */
+void drgn_memory_reader_invalidate_cache(struct drgn_memory_reader *reader);
+
+/**
+ * Get the number of bytes allocated by a @ref drgn_memory_reader.
+ *
+ * @param[out] segments_ret Returned size of the segments and their lookup
+ * indices.
+ * @param[out] cache_ret Returned size of the page cache and snapshots.
+ */
+void drgn_memory_reader_memory_usage(struct drgn_memory_reader *reader,
+				     size_t *segments_ret, size_t *cache_ret);
+
+/**
+ * Read a range of memory once and serve later reads within it from the copy.
+ *
+ * The copy is kept until it is replaced by a newer snapshot or @ref
+ * drgn_memory_reader_invalidate_cache() is called.
+ *
+ * @param[in] reader Memory reader.
+ * @param[in] address Starting address in memory to read.
+ * @param[in] size Number of bytes to read.
+ * @param[in] physical Whether @c address is physical.
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *drgn_memory_reader_snapshot(struct drgn_memory_reader *reader,
+					       uint64_t address, size_t size,
+					       bool physical);
 
 /**
  * Read from a @ref drgn_memory_reader.
@@ -108,6 +583,63 @@ struct drgn_error *drgn_memory_reader_read(struct drgn_memory_reader *reader,
 					   void *buf, uint64_t address,
 					   size_t count, bool physical);
 
+/**
+ * Read from a @ref drgn_memory_reader without allocating an error on a fault.
+ *
+ * @sa drgn_program_try_read_memory()
+ */
+struct drgn_error *
+drgn_memory_reader_try_read(struct drgn_memory_reader *reader, void *buf,
+			    uint64_t address, size_t count, bool physical,
+			    bool *ret);
+
+/**
+ * Get a pointer to memory in a @ref drgn_memory_reader without copying it.
+ *
+ * This is only possible if the memory is all in one segment read by @ref
+ * drgn_read_memory_file() from a mapped file, and the reader has no snapshots
+ * and isn't recording reads. Otherwise, the caller should fall back to @ref
+ * drgn_memory_reader_read().
+ *
+ * @param[out] ret Returned pointer to @p count bytes, which is valid for as
+ * long as the segment, or @c NULL if the memory isn't mapped.
+ */
+void drgn_memory_reader_map(struct drgn_memory_reader *reader,
+			    uint64_t address, size_t count, bool physical,
+			    const void **ret);
+
+/**
+ * Alignment and maximum size of chunks read by @ref
+ * drgn_memory_reader_read_string_chunk(). This divides the page size, so chunks
+ * never cross a page boundary.
+ */
+#define DRGN_STRING_CHUNK_SIZE 256
+
+/**
+ * Read the next chunk of a string from a @ref drgn_memory_reader.
+ *
+ * This reads at most @p count bytes up to the next multiple of @ref
+ * DRGN_STRING_CHUNK_SIZE, so that the caller can scan them for a terminator
+ * without reading memory one byte at a time. Because the memory after the end
+ * of a string may not be readable, if the chunk can't be read, this falls back
+ * to reading one byte.
+ *
+ * @param[out] buf Buffer to read into. Must have room for @p count bytes.
+ * @param[in] count Maximum number of bytes to read. Must be non-zero.
+ * @param[out] ret Returned number of bytes read.
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *
+drgn_memory_reader_read_string_chunk(struct drgn_memory_reader *reader,
+				     void *buf, uint64_t address, size_t count,
+				     bool physical, size_t *ret);
+
+/** @sa drgn_program_read_memory_batch() */
+struct drgn_error *
+drgn_memory_reader_read_batch(struct drgn_memory_reader *reader,
+			      struct drgn_memory_read_request *requests,
+			      size_t num_requests);
+
 /** Argument for @ref drgn_read_memory_file(). */
 struct drgn_memory_file_segment {
 	/** Offset in the file where the segment starts. */
@@ -118,8 +650,27 @@ struct drgn_memory_file_segment {
 	 * as if they contained zeroes.
 	 */
 	uint64_t file_size;
+	/**
+	 * Mapping of the segment in the file, or @c NULL if it is not mapped.
+	 *
+	 * If this is non-@c NULL, it points to @ref file_size bytes starting at
+	 * @ref file_offset, and reads copy from here instead of calling
+	 * pread().
+	 */
+	const char *map;
+	/**
+	 * Decompressed contents of the file, or @c NULL if the file is not
+	 * compressed.
+	 *
+	 * If this is non-@c NULL, @ref file_offset is an offset in the
+	 * decompressed contents, and reads decompress from here instead of
+	 * calling pread().
+	 */
+	struct drgn_compressed_file *compressed;
 	/** File descriptor. */
 	int fd;
+	/** Statistics to update. */
+	struct drgn_memory_stats *stats;
 	/**
 	 * If @c true, EIO is treated as a fault. Otherwise, it is treated as an
 	 * OS error.
@@ -132,6 +683,137 @@ struct drgn_error *drgn_read_memory_file(void *buf, uint64_t address,
 					 size_t count, uint64_t offset,
 					 void *arg, bool physical);
 
+/**
+ * Maximum age in nanoseconds of the memory map of a running process before a
+ * read of an address which isn't in it reads the map again.
+ */
+#define DRGN_PROCESS_MAPS_MAX_AGE_NS UINT64_C(10000000)
+
+/** Key of a @ref drgn_process_mapped_file. */
+struct drgn_process_mapped_file_key {
+	/** Device number of the file. */
+	uint64_t dev;
+	/** Inode number of the file. */
+	uint64_t ino;
+};
+
+/** File mapped by a running process which reads may be served from. */
+struct drgn_process_mapped_file {
+	struct drgn_process_mapped_file_key key;
+	/** Path of the file. This is freed once the file is opened. */
+	char *path;
+	bool opened;
+	/**
+	 * Mapping of the whole file, or @c NULL if it couldn't be opened or is
+	 * no longer the file that the process mapped.
+	 */
+	const char *map;
+	size_t size;
+};
+
+DEFINE_VECTOR_TYPE(drgn_process_mapped_file_vector,
+		   struct drgn_process_mapped_file)
+/** Map from file key to index in a @ref drgn_process_mapped_file_vector. */
+DEFINE_HASH_MAP_TYPE(drgn_process_mapped_file_map,
+		     struct drgn_process_mapped_file_key, size_t)
+
+/** Mapping parsed from the memory map of a running process. */
+struct drgn_process_mapping {
+	uint64_t start;
+	uint64_t end;
+	/** Offset in the mapped file of @ref start. */
+	uint64_t file_offset;
+	/**
+	 * Index in @ref drgn_memory_process_segment::files of the file that
+	 * reads of the mapping may be served from, or @c SIZE_MAX. This is
+	 * only set for read-only mappings of regular files.
+	 */
+	size_t file;
+	/** Whether the mapping is readable. */
+	bool readable;
+	/**
+	 * Whether @ref file has been checked against the page map of the
+	 * process. If any page of the mapping was copied on write (e.g., by
+	 * relocations or breakpoints), @ref file is reset to @c SIZE_MAX.
+	 */
+	bool file_checked;
+};
+
+/** Argument for @ref drgn_read_memory_process(). */
+struct drgn_memory_process_segment {
+	/** Process ID to read from. */
+	pid_t pid;
+	/** Statistics to update. */
+	struct drgn_memory_stats *stats;
+	/**
+	 * Segment to read with @ref drgn_read_memory_file() instead if
+	 * process_vm_readv() is not available or not permitted.
+	 */
+	struct drgn_memory_file_segment *fallback;
+	/**
+	 * Whether to always use @ref fallback. This is set after
+	 * process_vm_readv() fails with @c EPERM or @c ENOSYS.
+	 */
+	bool use_fallback;
+	/**
+	 * File descriptor of <tt>/proc/$pid/maps</tt>, or -1 if it can't be
+	 * read, in which case every read is attempted.
+	 */
+	int maps_fd;
+	/** File descriptor of <tt>/proc/$pid/pagemap</tt>, or -1. */
+	int pagemap_fd;
+	/** Page size of the host. */
+	uint64_t page_size;
+	/** Mappings sorted by address. */
+	struct drgn_process_mapping *mappings;
+	size_t num_mappings;
+	/** Whether @ref mappings may be used, i.e., aren't known to be stale. */
+	bool maps_valid;
+	/** monotonic_ns() when @ref mappings were read. */
+	uint64_t maps_ns;
+	/** Buffer that the maps file is read into. */
+	char *maps_buf;
+	size_t maps_buf_capacity;
+	/** Files that reads may be served from. */
+	struct drgn_process_mapped_file_vector files;
+	/** Index of @ref files. */
+	struct drgn_process_mapped_file_map file_map;
+};
+
+/**
+ * Initialize a @ref drgn_memory_process_segment.
+ *
+ * If the memory map of the process can be read, reads of addresses which
+ * aren't mapped fail without a system call, and reads of read-only file
+ * mappings whose pages haven't been copied on write are served from a mapping
+ * of the file. Otherwise, every read goes to the process.
+ */
+void drgn_memory_process_segment_init(struct drgn_memory_process_segment *segment,
+				      pid_t pid,
+				      struct drgn_memory_stats *stats,
+				      struct drgn_memory_file_segment *fallback);
+
+/** Deinitialize a @ref drgn_memory_process_segment. */
+void
+drgn_memory_process_segment_deinit(struct drgn_memory_process_segment *segment);
+
+/**
+ * Discard the memory map cached by a @ref drgn_memory_process_segment so that
+ * the next read reads it again.
+ *
+ * The reader lock must be held.
+ */
+void
+drgn_memory_process_segment_invalidate(struct drgn_memory_process_segment *segment);
+
+/**
+ * @ref drgn_memory_read_fn which reads from another process with
+ * process_vm_readv().
+ */
+struct drgn_error *drgn_read_memory_process(void *buf, uint64_t address,
+					    size_t count, uint64_t offset,
+					    void *arg, bool physical);
+
 /** @} */
 
 #endif /* DRGN_MEMORY_READER_H */
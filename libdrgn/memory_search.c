@@ -0,0 +1,363 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <omp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+#include "memory_reader.h"
+#include "memory_search.h"
+
+DEFINE_VECTOR_FUNCTIONS(drgn_memory_search_match_vector)
+
+struct drgn_error *
+drgn_memory_search_iterator_init(struct drgn_memory_search_iterator *it,
+				 struct drgn_memory_reader *reader,
+				 const void *pattern, const void *mask,
+				 size_t size, uint64_t alignment,
+				 bool physical)
+{
+	struct drgn_error *err;
+	size_t num_chunks, i;
+
+	if (size == 0) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "search pattern is empty");
+	}
+	if (size > DRGN_MEMORY_SEARCH_MAX_SIZE) {
+		return drgn_error_format(DRGN_ERROR_INVALID_ARGUMENT,
+					 "search pattern is longer than %d bytes",
+					 DRGN_MEMORY_SEARCH_MAX_SIZE);
+	}
+	if (!alignment || (alignment & (alignment - 1))) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "alignment must be a power of two");
+	}
+
+	memset(it, 0, sizeof(*it));
+	it->reader = reader;
+	it->size = size;
+	it->alignment = alignment;
+	it->physical = physical;
+	it->anchor = SIZE_MAX;
+	drgn_memory_search_match_vector_init(&it->matches);
+
+	it->pattern = malloc(size);
+	if (!it->pattern)
+		goto enomem;
+	memcpy(it->pattern, pattern, size);
+	if (mask) {
+		it->mask = malloc(size);
+		if (!it->mask)
+			goto enomem;
+		memcpy(it->mask, mask, size);
+		for (i = 0; i < size; i++) {
+			it->pattern[i] &= it->mask[i];
+			/*
+			 * Zero bytes are common in memory, so prefer a non-zero
+			 * anchor.
+			 */
+			if ((uint8_t)it->mask[i] == 0xff &&
+			    (it->anchor == SIZE_MAX ||
+			     (!it->pattern[it->anchor] && it->pattern[i])))
+				it->anchor = i;
+		}
+	}
+
+	err = drgn_memory_reader_ranges(reader, physical, &it->ranges,
+					&it->num_ranges);
+	if (err) {
+		drgn_memory_search_iterator_deinit(it);
+		return err;
+	}
+	if (it->num_ranges)
+		it->address = it->ranges[0].start;
+
+	it->num_threads = drgn_num_threads();
+	num_chunks = ((size_t)it->num_threads *
+		      DRGN_MEMORY_SEARCH_CHUNKS_PER_THREAD);
+	it->chunks = malloc_array(num_chunks, sizeof(it->chunks[0]));
+	if (!it->chunks)
+		goto enomem;
+	it->chunk_matches = malloc_array(num_chunks,
+					 sizeof(it->chunk_matches[0]));
+	if (!it->chunk_matches)
+		goto enomem;
+	for (i = 0; i < num_chunks; i++)
+		drgn_memory_search_match_vector_init(&it->chunk_matches[i]);
+	it->buffers = calloc(it->num_threads, sizeof(it->buffers[0]));
+	if (!it->buffers)
+		goto enomem;
+	for (i = 0; i < (size_t)it->num_threads; i++) {
+		it->buffers[i] = malloc(DRGN_MEMORY_SEARCH_CHUNK_SIZE +
+					DRGN_MEMORY_SEARCH_MAX_SIZE - 1);
+		if (!it->buffers[i])
+			goto enomem;
+	}
+	return NULL;
+
+enomem:
+	drgn_memory_search_iterator_deinit(it);
+	return &drgn_enomem;
+}
+
+void drgn_memory_search_iterator_deinit(struct drgn_memory_search_iterator *it)
+{
+	size_t num_chunks = ((size_t)it->num_threads *
+			     DRGN_MEMORY_SEARCH_CHUNKS_PER_THREAD);
+	size_t i;
+
+	if (it->buffers) {
+		for (i = 0; i < (size_t)it->num_threads; i++)
+			free(it->buffers[i]);
+		free(it->buffers);
+	}
+	if (it->chunk_matches) {
+		for (i = 0; i < num_chunks; i++)
+			drgn_memory_search_match_vector_deinit(&it->chunk_matches[i]);
+		free(it->chunk_matches);
+	}
+	free(it->chunks);
+	drgn_memory_search_match_vector_deinit(&it->matches);
+	drgn_error_destroy(it->err);
+	free(it->ranges);
+	free(it->mask);
+	free(it->pattern);
+}
+
+static bool drgn_memory_search_masked_eq(struct drgn_memory_search_iterator *it,
+					 const char *p)
+{
+	size_t i;
+
+	for (i = 0; i < it->size; i++) {
+		if ((p[i] & it->mask[i]) != it->pattern[i])
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Search for matches starting in buf[0, num_starts), which must be followed by
+ * at least it->size - 1 more bytes. The address of buf is address.
+ */
+static struct drgn_error *
+drgn_memory_search_buf(struct drgn_memory_search_iterator *it,
+		       const char *buf, size_t num_starts, uint64_t address,
+		       struct drgn_memory_search_match_vector *matches)
+{
+	size_t len = num_starts + it->size - 1;
+	/* The first aligned start. */
+	size_t pos = -address & (it->alignment - 1);
+
+	while (pos < num_starts) {
+		const char *p;
+		uint64_t match;
+
+		if (!it->mask) {
+			p = memmem(buf + pos, len - pos, it->pattern, it->size);
+			if (!p)
+				break;
+		} else if (it->anchor != SIZE_MAX) {
+			p = memchr(buf + pos + it->anchor,
+				   it->pattern[it->anchor], num_starts - pos);
+			if (!p)
+				break;
+			p -= it->anchor;
+			if (!drgn_memory_search_masked_eq(it, p)) {
+				pos = p - buf + 1;
+				continue;
+			}
+		} else {
+			/* There's no byte to look for, so try every start. */
+			p = buf + pos;
+			if (!drgn_memory_search_masked_eq(it, p)) {
+				pos += it->alignment;
+				continue;
+			}
+		}
+		pos = p - buf;
+		match = address + pos;
+		if (match & (it->alignment - 1)) {
+			pos++;
+			continue;
+		}
+		if (!drgn_memory_search_match_vector_append(matches, &match))
+			return &drgn_enomem;
+		pos += it->alignment;
+	}
+	return NULL;
+}
+
+/* Search a run of readable bytes buf[start, end) of a chunk. */
+static struct drgn_error *
+drgn_memory_search_run(struct drgn_memory_search_iterator *it,
+		       struct drgn_memory_search_chunk *chunk,
+		       const char *buf, size_t start, size_t end,
+		       struct drgn_memory_search_match_vector *matches)
+{
+	if (end - start < it->size || start >= chunk->num_starts)
+		return NULL;
+	return drgn_memory_search_buf(it, buf + start,
+				      min(chunk->num_starts - start,
+					  end - start - it->size + 1),
+				      chunk->address + start, matches);
+}
+
+static struct drgn_error *
+drgn_memory_search_chunk(struct drgn_memory_search_iterator *it,
+			 struct drgn_memory_search_chunk *chunk, char *buf,
+			 struct drgn_memory_search_match_vector *matches)
+{
+	struct drgn_error *err;
+	size_t offset, run_start;
+	bool ok;
+
+	matches->size = 0;
+	err = drgn_memory_reader_try_read(it->reader, buf, chunk->address,
+					  chunk->read_size, it->physical, &ok);
+	if (err)
+		return err;
+	if (ok) {
+		return drgn_memory_search_run(it, chunk, buf, 0,
+					      chunk->read_size, matches);
+	}
+
+	/*
+	 * Part of the chunk isn't readable. Skip runs of memory that are known
+	 * to be absent, read the rest again one page at a time, and search
+	 * each run of readable pages.
+	 */
+	run_start = 0;
+	for (offset = 0; offset < chunk->read_size;) {
+		uint64_t address = chunk->address + offset;
+		uint64_t run_last;
+		size_t n;
+
+		err = drgn_memory_reader_present(it->reader, address,
+						 chunk->address +
+						 (chunk->read_size - 1),
+						 it->physical, &ok,
+						 &run_last);
+		if (err)
+			return err;
+		if (ok) {
+			n = min((uint64_t)(chunk->read_size - offset),
+				DRGN_MEMORY_CACHE_PAGE_SIZE -
+				(address & (DRGN_MEMORY_CACHE_PAGE_SIZE - 1)));
+			err = drgn_memory_reader_try_read(it->reader, buf + offset,
+							  address, n,
+							  it->physical, &ok);
+			if (err)
+				return err;
+		} else {
+			n = run_last - address + 1;
+		}
+		if (!ok) {
+			err = drgn_memory_search_run(it, chunk, buf, run_start,
+						     offset, matches);
+			if (err)
+				return err;
+			run_start = offset + n;
+		}
+		offset += n;
+	}
+	return drgn_memory_search_run(it, chunk, buf, run_start,
+				      chunk->read_size, matches);
+}
+
+/* Search the next window of chunks. */
+static void drgn_memory_search_window(struct drgn_memory_search_iterator *it)
+{
+	struct drgn_error *err = NULL;
+	size_t max_chunks = ((size_t)it->num_threads *
+			     DRGN_MEMORY_SEARCH_CHUNKS_PER_THREAD);
+	size_t num_chunks = 0, failed_chunk = SIZE_MAX, i;
+
+	while (num_chunks < max_chunks &&
+	       it->range_index < it->num_ranges) {
+		struct drgn_memory_range *range = &it->ranges[it->range_index];
+		struct drgn_memory_search_chunk *chunk =
+			&it->chunks[num_chunks++];
+		uint64_t remaining = range->last - it->address;
+
+		/* remaining + 1 may overflow, so compare with size - 1. */
+		if (remaining >= DRGN_MEMORY_SEARCH_CHUNK_SIZE - 1)
+			chunk->num_starts = DRGN_MEMORY_SEARCH_CHUNK_SIZE;
+		else
+			chunk->num_starts = remaining + 1;
+		chunk->address = it->address;
+		chunk->read_size = (chunk->num_starts +
+				    min((uint64_t)(it->size - 1),
+					remaining - (chunk->num_starts - 1)));
+		if (remaining == chunk->num_starts - 1) {
+			if (++it->range_index < it->num_ranges)
+				it->address = it->ranges[it->range_index].start;
+		} else {
+			it->address += chunk->num_starts;
+		}
+	}
+
+	#pragma omp parallel for schedule(dynamic) num_threads(it->num_threads)
+	for (i = 0; i < num_chunks; i++) {
+		struct drgn_error *chunk_err;
+
+		chunk_err = drgn_memory_search_chunk(it, &it->chunks[i],
+						     it->buffers[omp_get_thread_num()],
+						     &it->chunk_matches[i]);
+		if (chunk_err) {
+			/* Keep the error of the earliest chunk. */
+			#pragma omp critical(drgn_memory_search_window)
+			if (i < failed_chunk) {
+				drgn_error_destroy(err);
+				err = chunk_err;
+				failed_chunk = i;
+			} else {
+				drgn_error_destroy(chunk_err);
+			}
+		}
+	}
+
+	/* Return the matches before the chunk that failed, if any. */
+	it->matches.size = 0;
+	it->pos = 0;
+	for (i = 0; i < num_chunks && i < failed_chunk; i++) {
+		struct drgn_memory_search_match_vector *chunk_matches =
+			&it->chunk_matches[i];
+
+		if (!drgn_memory_search_match_vector_reserve(&it->matches,
+							     it->matches.size +
+							     chunk_matches->size)) {
+			drgn_error_destroy(err);
+			err = &drgn_enomem;
+			break;
+		}
+		memcpy(it->matches.data + it->matches.size,
+		       chunk_matches->data,
+		       chunk_matches->size * sizeof(chunk_matches->data[0]));
+		it->matches.size += chunk_matches->size;
+	}
+	if (err)
+		it->err = err;
+	else if (it->range_index >= it->num_ranges)
+		it->err = &drgn_stop;
+}
+
+struct drgn_error *
+drgn_memory_search_iterator_next(struct drgn_memory_search_iterator *it,
+				 uint64_t *ret)
+{
+	while (it->pos >= it->matches.size) {
+		if (it->err) {
+			struct drgn_error *err = it->err;
+
+			/* Only return an error once. */
+			it->err = &drgn_stop;
+			return err;
+		}
+		drgn_memory_search_window(it);
+	}
+	*ret = it->matches.data[it->pos++];
+	return NULL;
+}
@@ -0,0 +1,151 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Memory pattern search.
+ *
+ * See @ref MemorySearch.
+ */
+
+#ifndef DRGN_MEMORY_SEARCH_H
+#define DRGN_MEMORY_SEARCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vector.h"
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup MemorySearch Memory search
+ *
+ * Searching all of the memory of a @ref drgn_memory_reader for a pattern.
+ *
+ * The segments of an address space are searched in order of address, in
+ * windows of @ref DRGN_MEMORY_SEARCH_CHUNK_SIZE chunks, one window at a time.
+ * The chunks in a window are read in large reads and searched in parallel,
+ * using the vectorized <tt>memmem()</tt> and <tt>memchr()</tt> from the C
+ * library. Matches are returned in order of address. Chunks that can't be read
+ * entirely are read again one page at a time, and unreadable pages are
+ * skipped.
+ *
+ * @{
+ */
+
+/** Size of the chunks searched in parallel. */
+#define DRGN_MEMORY_SEARCH_CHUNK_SIZE (UINT64_C(1) << 20)
+
+/** Number of chunks searched in each window per thread. */
+#define DRGN_MEMORY_SEARCH_CHUNKS_PER_THREAD 4
+
+/** Maximum size of a search pattern. */
+#define DRGN_MEMORY_SEARCH_MAX_SIZE 4096
+
+struct drgn_memory_range;
+struct drgn_memory_reader;
+
+/** Chunk of a window searched by a @ref drgn_memory_search_iterator. */
+struct drgn_memory_search_chunk {
+	uint64_t address;
+	/** Number of addresses in the chunk where a match may start. */
+	size_t num_starts;
+	/**
+	 * Number of bytes to read, which includes up to the size of the
+	 * pattern minus one bytes after the last start.
+	 */
+	size_t read_size;
+};
+
+DEFINE_VECTOR_TYPE(drgn_memory_search_match_vector, uint64_t)
+
+/** Iterator over the addresses of a pattern in memory. */
+struct drgn_memory_search_iterator {
+	struct drgn_memory_reader *reader;
+	/** Pattern, already masked by @ref mask. */
+	char *pattern;
+	/** Mask of the pattern, or @c NULL if every bit must match. */
+	char *mask;
+	size_t size;
+	/** Alignment of matches. This is a power of two. */
+	uint64_t alignment;
+	bool physical;
+	/**
+	 * Index of a byte of the pattern with no masked bits, which is looked
+	 * for with <tt>memchr()</tt>, or @c SIZE_MAX if there is none. Only
+	 * used if @ref mask is not @c NULL.
+	 */
+	size_t anchor;
+	/** Ranges to search, in order of address. */
+	struct drgn_memory_range *ranges;
+	size_t num_ranges;
+	/** Index in @ref ranges of the next chunk. */
+	size_t range_index;
+	/** Address of the next chunk. */
+	uint64_t address;
+	/** Number of threads that search each window. */
+	int num_threads;
+	/** Read buffer of each thread. */
+	char **buffers;
+	/**
+	 * Chunks of the current window. There are @ref
+	 * DRGN_MEMORY_SEARCH_CHUNKS_PER_THREAD per thread.
+	 */
+	struct drgn_memory_search_chunk *chunks;
+	/** Matches found in each of @ref chunks. */
+	struct drgn_memory_search_match_vector *chunk_matches;
+	/** Matches of the current window and the next one to return. */
+	struct drgn_memory_search_match_vector matches;
+	size_t pos;
+	/**
+	 * Error to return after the matches of the current window, or @c NULL.
+	 */
+	struct drgn_error *err;
+};
+
+/**
+ * Initialize a @ref drgn_memory_search_iterator.
+ *
+ * The segments to search are determined when the iterator is initialized.
+ *
+ * @param[in] pattern Bytes to search for.
+ * @param[in] mask Bits of @p pattern that must match, or @c NULL if all of them
+ * must match. This has the same size as @p pattern.
+ * @param[in] size Size of @p pattern. Must be between 1 and @ref
+ * DRGN_MEMORY_SEARCH_MAX_SIZE.
+ * @param[in] alignment Only return matches at multiples of this. Must be a
+ * power of two.
+ * @param[in] physical Whether to search physical memory instead of virtual
+ * memory.
+ * @return @c NULL on success, non-@c NULL on error. On error, the iterator
+ * doesn't need to be deinitialized.
+ */
+struct drgn_error *
+drgn_memory_search_iterator_init(struct drgn_memory_search_iterator *it,
+				 struct drgn_memory_reader *reader,
+				 const void *pattern, const void *mask,
+				 size_t size, uint64_t alignment,
+				 bool physical);
+
+/** Deinitialize a @ref drgn_memory_search_iterator. */
+void drgn_memory_search_iterator_deinit(struct drgn_memory_search_iterator *it);
+
+/**
+ * Get the next match from a @ref drgn_memory_search_iterator.
+ *
+ * Memory that can't be read is skipped.
+ *
+ * @param[out] ret Returned address of the match.
+ * @return @c NULL on success, @ref drgn_stop if there are no more matches,
+ * non-@c NULL on any other error.
+ */
+struct drgn_error *
+drgn_memory_search_iterator_next(struct drgn_memory_search_iterator *it,
+				 uint64_t *ret);
+
+/** @} */
+
+#endif /* DRGN_MEMORY_SEARCH_H */
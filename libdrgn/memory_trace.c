@@ -0,0 +1,741 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "internal.h"
+#include "language.h"
+#include "linux_kernel.h"
+#include "memory_reader.h"
+#include "memory_trace.h"
+#include "program.h"
+#include "read.h"
+#include "vector.h"
+
+/* Size of the header of a trace file. */
+#define DRGN_MEMORY_TRACE_HEADER_SIZE					\
+	(DRGN_MEMORY_TRACE_MAGIC_LEN + 4 * sizeof(uint32_t) +		\
+	 sizeof(((struct vmcoreinfo *)NULL)->osrelease) +		\
+	 3 * sizeof(uint64_t) + 1)
+
+static struct hash_pair
+drgn_memory_trace_key_hash(const struct drgn_memory_trace_key *key)
+{
+	size_t hash = hash_combine(hash_combine(key->address, key->count),
+				   key->physical);
+
+	return hash_pair_from_avalanching_hash(hash);
+}
+
+static bool drgn_memory_trace_key_eq(const struct drgn_memory_trace_key *a,
+				     const struct drgn_memory_trace_key *b)
+{
+	return (a->address == b->address && a->count == b->count &&
+		a->physical == b->physical);
+}
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_memory_trace_map, drgn_memory_trace_key_hash,
+			    drgn_memory_trace_key_eq)
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_memory_trace_page_set, hash_pair_int_type,
+			    hash_table_scalar_eq)
+
+static char *write_u32(char *p, uint32_t value)
+{
+	value = htole32(value);
+	memcpy(p, &value, sizeof(value));
+	return p + sizeof(value);
+}
+
+static char *write_u64(char *p, uint64_t value)
+{
+	value = htole64(value);
+	memcpy(p, &value, sizeof(value));
+	return p + sizeof(value);
+}
+
+static char *write_uleb128(char *p, uint64_t value)
+{
+	do {
+		uint8_t byte = value & 0x7f;
+
+		value >>= 7;
+		if (value)
+			byte |= 0x80;
+		*p++ = byte;
+	} while (value);
+	return p;
+}
+
+static bool read_uleb128(const char **ptr, const char *end, uint64_t *ret)
+{
+	int shift = 0;
+	uint64_t value = 0;
+	uint8_t byte;
+
+	do {
+		if (!read_u8(ptr, end, &byte) || shift >= 64)
+			return false;
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		shift += 7;
+	} while (byte & 0x80);
+	*ret = value;
+	return true;
+}
+
+/* Mark the pages of [address, address + count) as touched. */
+static void drgn_memory_recorder_touch(struct drgn_memory_recorder *recorder,
+				       uint64_t address, uint64_t count,
+				       bool physical)
+{
+	uint64_t page, last_page;
+
+	if (!count)
+		return;
+	page = address & ~(DRGN_MEMORY_CACHE_PAGE_SIZE - 1);
+	last_page = ((address + (count - 1)) &
+		     ~(DRGN_MEMORY_CACHE_PAGE_SIZE - 1));
+	if (last_page < page)
+		last_page = UINT64_MAX & ~(DRGN_MEMORY_CACHE_PAGE_SIZE - 1);
+	for (;;) {
+		uint64_t entry = page | physical;
+
+		if (drgn_memory_trace_page_set_insert(&recorder->touched_pages,
+						      &entry, NULL) == -1)
+			recorder->pages_enomem = true;
+		if (page == last_page)
+			break;
+		page += DRGN_MEMORY_CACHE_PAGE_SIZE;
+	}
+}
+
+void drgn_memory_recorder_record(struct drgn_memory_recorder *recorder,
+				 const void *buf, uint64_t address,
+				 size_t count, bool physical, bool fault)
+{
+	/* Flags and two ULEB128s of at most 10 bytes each. */
+	char header[21], *p;
+	uint8_t flags = physical ? DRGN_MEMORY_TRACE_PHYSICAL : 0;
+	int64_t delta;
+
+	if (recorder->pages) {
+		drgn_memory_recorder_touch(recorder, address, count, physical);
+		return;
+	}
+
+	if (fault) {
+		flags |= DRGN_MEMORY_TRACE_FAULT;
+	} else {
+		struct drgn_memory_trace_map_entry entry = {
+			.key = { address, count, physical },
+			.value = hash_bytes(buf, count),
+		};
+		struct drgn_memory_trace_map *map = &recorder->last_data;
+		struct hash_pair hp;
+		struct drgn_memory_trace_map_iterator it;
+
+		hp = drgn_memory_trace_map_hash(&entry.key);
+		it = drgn_memory_trace_map_search_hashed(map, &entry.key, hp);
+		if (!it.entry) {
+			/* If this fails, the data is written every time. */
+			drgn_memory_trace_map_insert_searched(map, &entry, hp,
+							      NULL);
+		} else if (it.entry->value == entry.value) {
+			flags |= DRGN_MEMORY_TRACE_REPEAT;
+		} else {
+			it.entry->value = entry.value;
+		}
+	}
+
+	/* Zigzag encode the delta so that small negative deltas are short. */
+	delta = address - recorder->prev_address;
+	recorder->prev_address = address;
+	p = header;
+	*p++ = flags;
+	p = write_uleb128(p, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+	p = write_uleb128(p, count);
+	fwrite(header, 1, p - header, recorder->file);
+	if (!(flags & (DRGN_MEMORY_TRACE_FAULT | DRGN_MEMORY_TRACE_REPEAT)))
+		fwrite(buf, 1, count, recorder->file);
+}
+
+struct drgn_error *
+drgn_memory_recorder_destroy(struct drgn_memory_recorder *recorder)
+{
+	struct drgn_error *err = NULL;
+
+	if (ferror(recorder->file)) {
+		err = drgn_error_create(DRGN_ERROR_OS,
+					"could not write memory trace");
+		fclose(recorder->file);
+	} else if (fclose(recorder->file) == EOF) {
+		err = drgn_error_create_os("fclose", errno, NULL);
+	}
+	drgn_memory_trace_map_deinit(&recorder->last_data);
+	drgn_memory_trace_page_set_deinit(&recorder->touched_pages);
+	free(recorder);
+	return err;
+}
+
+/* Order touched pages by address space, then address. */
+static int drgn_memory_trace_page_cmp(const void *_a, const void *_b)
+{
+	uint64_t a = *(const uint64_t *)_a, b = *(const uint64_t *)_b;
+
+	if ((a & 1) != (b & 1))
+		return (a & 1) < (b & 1) ? -1 : 1;
+	if (a != b)
+		return a < b ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Read and record [address, address + count). If part of it faults, each page
+ * of it is tried separately, and the pages which fault are skipped.
+ */
+static struct drgn_error *
+drgn_memory_recorder_read_pages(struct drgn_memory_recorder *recorder,
+				struct drgn_memory_reader *reader, char *buf,
+				uint64_t address, uint64_t count,
+				bool physical)
+{
+	static const uint64_t page_size = DRGN_MEMORY_CACHE_PAGE_SIZE;
+	struct drgn_error *err;
+	bool whole = true;
+
+	while (count) {
+		uint64_t n = count;
+
+		if (!whole)
+			n = min(count, page_size - (address & (page_size - 1)));
+		err = drgn_memory_reader_read(reader, buf, address, n,
+					      physical);
+		if (!err) {
+			drgn_memory_recorder_record(recorder, buf, address, n,
+						    physical, false);
+		} else if (err->code == DRGN_ERROR_FAULT) {
+			drgn_error_destroy(err);
+			if (whole) {
+				whole = false;
+				continue;
+			}
+		} else {
+			return err;
+		}
+		address += n;
+		count -= n;
+	}
+	return NULL;
+}
+
+/*
+ * Write the current contents of the touched pages of a recorder, clipped to
+ * the segments of the reader. Consecutive pages are read together.
+ */
+static struct drgn_error *
+drgn_memory_recorder_write_pages(struct drgn_memory_recorder *recorder,
+				 struct drgn_memory_reader *reader)
+{
+	static const uint64_t page_size = DRGN_MEMORY_CACHE_PAGE_SIZE;
+	struct drgn_error *err = NULL;
+	struct drgn_memory_trace_page_set_iterator it;
+	struct drgn_memory_range *ranges = NULL;
+	size_t num_pages, num_ranges = 0, i, j, k = 0, m;
+	uint64_t *pages;
+	char *buf;
+	bool ranges_physical = false;
+
+	if (recorder->pages_enomem)
+		return &drgn_enomem;
+	num_pages = drgn_memory_trace_page_set_size(&recorder->touched_pages);
+	if (!num_pages)
+		return NULL;
+	pages = malloc_array(num_pages, sizeof(*pages));
+	buf = malloc(DRGN_MEMORY_TRACE_PAGE_RUN_SIZE);
+	if (!pages || !buf) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	i = 0;
+	for (it = drgn_memory_trace_page_set_first(&recorder->touched_pages);
+	     it.entry; it = drgn_memory_trace_page_set_next(it))
+		pages[i++] = *it.entry;
+	qsort(pages, num_pages, sizeof(*pages), drgn_memory_trace_page_cmp);
+
+	/* Switch to recording reads now that the pages are being written. */
+	recorder->pages = false;
+	err = drgn_memory_reader_ranges(reader, false, &ranges, &num_ranges);
+	if (err)
+		goto out;
+	for (i = 0; i < num_pages; i = j) {
+		bool physical = pages[i] & 1;
+		uint64_t start = pages[i] & ~(uint64_t)1, last;
+
+		if (physical != ranges_physical) {
+			free(ranges);
+			ranges = NULL;
+			err = drgn_memory_reader_ranges(reader, physical,
+							&ranges, &num_ranges);
+			if (err)
+				goto out;
+			ranges_physical = physical;
+			k = 0;
+		}
+		for (j = i + 1;
+		     j < num_pages && (j - i) * page_size <
+		     DRGN_MEMORY_TRACE_PAGE_RUN_SIZE &&
+		     pages[j] == pages[i] + (j - i) * page_size; j++)
+			;
+		last = start + ((j - i) * page_size - 1);
+
+		/* The runs are sorted, so the ranges only move forward. */
+		while (k < num_ranges && ranges[k].last < start)
+			k++;
+		for (m = k; m < num_ranges && ranges[m].start <= last; m++) {
+			uint64_t piece_start = max(start, ranges[m].start);
+			uint64_t piece_last = min(last, ranges[m].last);
+
+			err = drgn_memory_recorder_read_pages(recorder, reader,
+							      buf, piece_start,
+							      piece_last -
+							      piece_start + 1,
+							      physical);
+			if (err)
+				goto out;
+		}
+	}
+out:
+	free(ranges);
+	free(buf);
+	free(pages);
+	return err;
+}
+
+/*
+ * Start recording to a new trace file, either every read or only the touched
+ * pages.
+ */
+static struct drgn_error *
+drgn_program_start_recording(struct drgn_program *prog, const char *path,
+			     bool pages)
+{
+	struct drgn_error *err;
+	struct drgn_memory_recorder *recorder;
+	char header[DRGN_MEMORY_TRACE_HEADER_SIZE], *p;
+
+	if (!prog->has_platform) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "program platform is not known");
+	}
+	if (prog->core_fd == -1 && drgn_memory_reader_empty(&prog->reader)) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "program memory is not initialized");
+	}
+
+	recorder = malloc(sizeof(*recorder));
+	if (!recorder)
+		return &drgn_enomem;
+	recorder->file = fopen(path, "w");
+	if (!recorder->file) {
+		err = drgn_error_create_os("fopen", errno, path);
+		free(recorder);
+		return err;
+	}
+	drgn_memory_trace_map_init(&recorder->last_data);
+	recorder->prev_address = 0;
+	recorder->pages = pages;
+	recorder->pages_enomem = false;
+	drgn_memory_trace_page_set_init(&recorder->touched_pages);
+
+	p = header;
+	memcpy(p, DRGN_MEMORY_TRACE_MAGIC, DRGN_MEMORY_TRACE_MAGIC_LEN);
+	p += DRGN_MEMORY_TRACE_MAGIC_LEN;
+	p = write_u32(p, DRGN_MEMORY_TRACE_VERSION);
+	p = write_u32(p, prog->platform.arch->arch);
+	p = write_u32(p, prog->platform.flags);
+	p = write_u32(p, prog->flags);
+	memcpy(p, prog->vmcoreinfo.osrelease,
+	       sizeof(prog->vmcoreinfo.osrelease));
+	p += sizeof(prog->vmcoreinfo.osrelease);
+	p = write_u64(p, prog->vmcoreinfo.page_size);
+	p = write_u64(p, prog->vmcoreinfo.kaslr_offset);
+	p = write_u64(p, prog->vmcoreinfo.swapper_pg_dir);
+	*p++ = prog->vmcoreinfo.pgtable_l5_enabled;
+	fwrite(header, 1, p - header, recorder->file);
+
+	drgn_memory_reader_lock(&prog->reader);
+	if (prog->reader.recorder) {
+		drgn_memory_reader_unlock(&prog->reader);
+		drgn_error_destroy(drgn_memory_recorder_destroy(recorder));
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "program is already recording memory");
+	}
+	/*
+	 * Results derived from memory which was read before recording started
+	 * (e.g., cached dentry paths) would let reads be skipped, so discard
+	 * them.
+	 */
+	drgn_program_invalidate_memory_cache(prog);
+	prog->reader.recorder = recorder;
+	drgn_memory_reader_unlock(&prog->reader);
+	return NULL;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_record_memory(struct drgn_program *prog, const char *path)
+{
+	return drgn_program_start_recording(prog, path, false);
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_record_memory_pages(struct drgn_program *prog, const char *path)
+{
+	return drgn_program_start_recording(prog, path, true);
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_record_memory_range(struct drgn_program *prog, uint64_t address,
+				 uint64_t size, bool physical)
+{
+	struct drgn_memory_recorder *recorder;
+
+	drgn_memory_reader_lock(&prog->reader);
+	recorder = prog->reader.recorder;
+	if (!recorder || !recorder->pages) {
+		drgn_memory_reader_unlock(&prog->reader);
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "program is not recording memory pages");
+	}
+	drgn_memory_recorder_touch(recorder, address, size, physical);
+	drgn_memory_reader_unlock(&prog->reader);
+	return NULL;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_stop_recording_memory(struct drgn_program *prog)
+{
+	struct drgn_error *err = NULL;
+	struct drgn_memory_recorder *recorder;
+
+	drgn_memory_reader_lock(&prog->reader);
+	recorder = prog->reader.recorder;
+	prog->reader.recorder = NULL;
+	drgn_memory_reader_unlock(&prog->reader);
+	if (!recorder) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "program is not recording memory");
+	}
+	if (recorder->pages)
+		err = drgn_memory_recorder_write_pages(recorder, &prog->reader);
+	if (err) {
+		drgn_error_destroy(drgn_memory_recorder_destroy(recorder));
+		return err;
+	}
+	return drgn_memory_recorder_destroy(recorder);
+}
+
+/* Data record in a trace file. */
+struct drgn_memory_trace_record {
+	uint64_t address;
+	uint64_t count;
+	/* Data in the mapped trace file. */
+	const char *data;
+	bool physical;
+};
+
+DEFINE_VECTOR(drgn_memory_trace_record_vector, struct drgn_memory_trace_record)
+
+static struct drgn_error *drgn_read_memory_trace(void *buf, uint64_t address,
+						 size_t count, uint64_t offset,
+						 void *arg, bool physical)
+{
+	memcpy(buf, (char *)arg + offset, count);
+	return NULL;
+}
+
+/* Order by address space, then address. */
+static int drgn_memory_trace_record_cmp(const void *_a, const void *_b)
+{
+	const struct drgn_memory_trace_record *a = _a, *b = _b;
+
+	if (a->physical != b->physical)
+		return a->physical < b->physical ? -1 : 1;
+	if (a->address != b->address)
+		return a->address < b->address ? -1 : 1;
+	return 0;
+}
+
+static struct drgn_error *
+drgn_memory_trace_parse_records(const char *ptr, const char *end,
+				struct drgn_memory_trace_record_vector *records)
+{
+	uint64_t address = 0;
+
+	while (ptr < end) {
+		uint8_t flags;
+		uint64_t zigzag, count;
+
+		read_u8(&ptr, end, &flags);
+		if (flags & ~DRGN_ALL_MEMORY_TRACE_FLAGS ||
+		    !read_uleb128(&ptr, end, &zigzag) ||
+		    !read_uleb128(&ptr, end, &count))
+			goto invalid;
+		address += (zigzag >> 1) ^ -(zigzag & 1);
+		if ((flags & (DRGN_MEMORY_TRACE_FAULT |
+			      DRGN_MEMORY_TRACE_REPEAT)) || count == 0)
+			continue;
+		if (count > (size_t)(end - ptr) ||
+		    count - 1 > UINT64_MAX - address)
+			goto invalid;
+
+		struct drgn_memory_trace_record *record =
+			drgn_memory_trace_record_vector_append_entry(records);
+		if (!record)
+			return &drgn_enomem;
+		record->address = address;
+		record->count = count;
+		record->data = ptr;
+		record->physical = flags & DRGN_MEMORY_TRACE_PHYSICAL;
+		ptr += count;
+	}
+	return NULL;
+
+invalid:
+	return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+				 "invalid memory trace record");
+}
+
+/*
+ * Find the segment containing the start of a record. The segments are sorted
+ * the same way as drgn_memory_trace_record_cmp().
+ */
+static struct drgn_memory_segment_spec *
+drgn_memory_trace_find_segment(struct drgn_memory_segment_spec *segments,
+			       size_t num_segments,
+			       const struct drgn_memory_trace_record *record)
+{
+	size_t lo = 0, hi = num_segments;
+
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (segments[mid].physical < record->physical ||
+		    (segments[mid].physical == record->physical &&
+		     segments[mid].address <= record->address))
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return &segments[lo];
+}
+
+/*
+ * Merge the records into segments covering every recorded byte, and fill in
+ * the segments in the order that the records were recorded so that the most
+ * recent data wins.
+ */
+static struct drgn_error *
+drgn_memory_trace_add_segments(struct drgn_program *prog,
+			       const struct drgn_memory_trace_record *records,
+			       size_t num_records)
+{
+	struct drgn_error *err;
+	struct drgn_memory_trace_record *sorted;
+	struct drgn_memory_segment_spec *segments = NULL;
+	size_t num_segments = 0, i;
+	uint64_t size = 0, last = 0;
+	char *buf;
+
+	if (!num_records)
+		return NULL;
+
+	sorted = malloc_array(num_records, sizeof(*sorted));
+	if (!sorted)
+		return &drgn_enomem;
+	memcpy(sorted, records, num_records * sizeof(*sorted));
+	qsort(sorted, num_records, sizeof(*sorted),
+	      drgn_memory_trace_record_cmp);
+
+	/* There can't be more segments than records. */
+	segments = malloc_array(num_records, sizeof(*segments));
+	if (!segments) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	for (i = 0; i < num_records; i++) {
+		struct drgn_memory_trace_record *record = &sorted[i];
+		uint64_t record_last = record->address + (record->count - 1);
+		struct drgn_memory_segment_spec *segment;
+
+		if (num_segments &&
+		    segments[num_segments - 1].physical == record->physical &&
+		    (last == UINT64_MAX || record->address <= last + 1)) {
+			segment = &segments[num_segments - 1];
+			if (record_last > last)
+				last = record_last;
+		} else {
+			segment = &segments[num_segments++];
+			segment->address = record->address;
+			segment->read_fn = drgn_read_memory_trace;
+			segment->physical = record->physical;
+			last = record_last;
+		}
+		segment->size = last - segment->address + 1;
+	}
+
+	/*
+	 * The segments can't add up to more than the size of the records,
+	 * which are all in the trace file.
+	 */
+	for (i = 0; i < num_segments; i++)
+		size += segments[i].size;
+	buf = malloc(size);
+	if (!buf) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	size = 0;
+	for (i = 0; i < num_segments; i++) {
+		segments[i].arg = buf + size;
+		size += segments[i].size;
+	}
+	for (i = 0; i < num_records; i++) {
+		struct drgn_memory_segment_spec *segment;
+
+		segment = drgn_memory_trace_find_segment(segments,
+							 num_segments,
+							 &records[i]);
+		memcpy((char *)segment->arg +
+		       (records[i].address - segment->address),
+		       records[i].data, records[i].count);
+	}
+
+	err = drgn_memory_reader_add_segments(&prog->reader, segments,
+					      num_segments);
+	if (err) {
+		drgn_memory_reader_deinit(&prog->reader);
+		drgn_memory_reader_init(&prog->reader);
+		free(buf);
+		goto out;
+	}
+	prog->memory_trace_buf = buf;
+out:
+	free(segments);
+	free(sorted);
+	return err;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_set_memory_trace(struct drgn_program *prog, const char *path)
+{
+	struct drgn_error *err;
+	int fd;
+	struct stat st;
+	char *map;
+	const char *ptr, *end;
+	uint32_t version, arch, platform_flags, flags;
+	struct vmcoreinfo vmcoreinfo;
+	uint8_t pgtable_l5_enabled;
+	struct drgn_platform *platform = NULL;
+	struct drgn_memory_trace_record_vector records = VECTOR_INIT;
+	bool bswap = __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__;
+
+	err = drgn_program_check_initialized(prog);
+	if (err)
+		return err;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return drgn_error_create_os("open", errno, path);
+	if (fstat(fd, &st) == -1) {
+		err = drgn_error_create_os("fstat", errno, path);
+		close(fd);
+		return err;
+	}
+	if ((uint64_t)st.st_size < DRGN_MEMORY_TRACE_HEADER_SIZE) {
+		close(fd);
+		goto invalid;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return drgn_error_create_os("mmap", errno, path);
+	ptr = map;
+	end = map + st.st_size;
+
+	if (memcmp(ptr, DRGN_MEMORY_TRACE_MAGIC,
+		   DRGN_MEMORY_TRACE_MAGIC_LEN) != 0) {
+		munmap(map, st.st_size);
+		goto invalid;
+	}
+	ptr += DRGN_MEMORY_TRACE_MAGIC_LEN;
+	read_u32_nocheck(&ptr, bswap, &version);
+	if (version != DRGN_MEMORY_TRACE_VERSION) {
+		munmap(map, st.st_size);
+		return drgn_error_format(DRGN_ERROR_INVALID_ARGUMENT,
+					 "unsupported memory trace version %" PRIu32,
+					 version);
+	}
+	read_u32_nocheck(&ptr, bswap, &arch);
+	read_u32_nocheck(&ptr, bswap, &platform_flags);
+	read_u32_nocheck(&ptr, bswap, &flags);
+	memcpy(vmcoreinfo.osrelease, ptr, sizeof(vmcoreinfo.osrelease));
+	vmcoreinfo.osrelease[sizeof(vmcoreinfo.osrelease) - 1] = '\0';
+	ptr += sizeof(vmcoreinfo.osrelease);
+	read_u64_nocheck(&ptr, bswap, &vmcoreinfo.page_size);
+	read_u64_nocheck(&ptr, bswap, &vmcoreinfo.kaslr_offset);
+	read_u64_nocheck(&ptr, bswap, &vmcoreinfo.swapper_pg_dir);
+	read_u8(&ptr, end, &pgtable_l5_enabled);
+	vmcoreinfo.pgtable_l5_enabled = pgtable_l5_enabled;
+
+	err = drgn_platform_create(arch, platform_flags, &platform);
+	if (err)
+		goto out_map;
+	err = drgn_memory_trace_parse_records(ptr, end, &records);
+	if (err)
+		goto out_platform;
+	err = drgn_memory_trace_add_segments(prog, records.data, records.size);
+	if (err)
+		goto out_platform;
+	if (flags & DRGN_PROGRAM_IS_LINUX_KERNEL) {
+		err = drgn_program_add_memoized_object_finder(prog,
+							      linux_kernel_object_find,
+							      prog);
+		if (err) {
+			drgn_memory_reader_deinit(&prog->reader);
+			drgn_memory_reader_init(&prog->reader);
+			free(prog->memory_trace_buf);
+			prog->memory_trace_buf = NULL;
+			goto out_platform;
+		}
+	}
+
+	prog->flags |= flags & ~DRGN_PROGRAM_IS_LIVE;
+	if (prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL) {
+		prog->vmcoreinfo = vmcoreinfo;
+		if (!prog->lang)
+			prog->lang = &drgn_language_c;
+	}
+	drgn_program_set_memory_cache_size(prog,
+					   DRGN_DEFAULT_CORE_DUMP_MEMORY_CACHE_SIZE);
+	drgn_program_set_platform(prog, platform);
+
+out_platform:
+	drgn_platform_destroy(platform);
+out_map:
+	drgn_memory_trace_record_vector_deinit(&records);
+	munmap(map, st.st_size);
+	return err;
+
+invalid:
+	return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+				 "not a drgn memory trace");
+}
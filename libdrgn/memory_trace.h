@@ -0,0 +1,154 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Memory access traces.
+ *
+ * See @ref MemoryTraces.
+ */
+
+#ifndef DRGN_MEMORY_TRACE_H
+#define DRGN_MEMORY_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "hash_table.h"
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup MemoryTraces Memory traces
+ *
+ * Recording and replaying memory accesses.
+ *
+ * A memory trace logs every read from a program's memory and the data that was
+ * read, so that the same reads can later be served without the original core
+ * dump or kernel. See @ref drgn_program_record_memory() and @ref
+ * drgn_program_set_memory_trace().
+ *
+ * A trace file starts with a header:
+ *
+ * - The magic string @ref DRGN_MEMORY_TRACE_MAGIC.
+ * - The format version, @ref DRGN_MEMORY_TRACE_VERSION, as a u32.
+ * - The @ref drgn_architecture, @ref drgn_platform_flags, and @ref
+ *   drgn_program_flags of the program, as u32s.
+ * - The fields of its @ref vmcoreinfo: @c osrelease as 128 bytes, @c page_size,
+ *   @c kaslr_offset, and @c swapper_pg_dir as u64s, and @c pgtable_l5_enabled
+ *   as a u8.
+ *
+ * It is followed by one record per read, in order:
+ *
+ * - Flags (@ref drgn_memory_trace_flags) as a u8.
+ * - The difference between the address and the address of the previous record
+ *   as a ULEB128 of the zigzag encoding of the signed difference.
+ * - The number of bytes read as a ULEB128.
+ * - The data that was read, unless @ref DRGN_MEMORY_TRACE_FAULT or @ref
+ *   DRGN_MEMORY_TRACE_REPEAT is set.
+ *
+ * All fixed-size integers are little-endian.
+ *
+ * A recorder can also record pages instead of reads (see @ref
+ * drgn_program_record_memory_pages()). Then, reads only mark the pages that
+ * they touch, and the current contents of the pages are written as records
+ * when recording stops. This takes a snapshot of the memory used by a script,
+ * e.g., on a live kernel, in one burst, so replaying it later gives a
+ * consistent view that can be queried beyond the exact reads of the first run.
+ *
+ * @{
+ */
+
+/** Magic string at the start of a memory trace file. */
+#define DRGN_MEMORY_TRACE_MAGIC "DRGNMTRC"
+/** Length of @ref DRGN_MEMORY_TRACE_MAGIC. */
+#define DRGN_MEMORY_TRACE_MAGIC_LEN 8
+/** Version of the memory trace file format. */
+#define DRGN_MEMORY_TRACE_VERSION 1
+
+/** Flags of a record in a memory trace. */
+enum drgn_memory_trace_flags {
+	/** The address is physical. */
+	DRGN_MEMORY_TRACE_PHYSICAL = (1 << 0),
+	/** The read faulted, so the record has no data. */
+	DRGN_MEMORY_TRACE_FAULT = (1 << 1),
+	/**
+	 * The read returned the same data as the last read of the same range,
+	 * so the record has no data.
+	 */
+	DRGN_MEMORY_TRACE_REPEAT = (1 << 2),
+	/** All valid flags. */
+	DRGN_ALL_MEMORY_TRACE_FLAGS = (1 << 3) - 1,
+};
+
+/** Range of memory read by a record in a memory trace. */
+struct drgn_memory_trace_key {
+	uint64_t address;
+	uint64_t count;
+	bool physical;
+};
+
+/** Map from range to the hash of the data last recorded for it. */
+DEFINE_HASH_MAP_TYPE(drgn_memory_trace_map, struct drgn_memory_trace_key,
+		     uint64_t)
+
+/**
+ * Set of pages touched while recording pages, as the address of the page ORed
+ * with 1 if it is physical.
+ */
+DEFINE_HASH_SET_TYPE(drgn_memory_trace_page_set, uint64_t)
+
+/** Maximum size of the runs of pages read at once when writing pages. */
+#define DRGN_MEMORY_TRACE_PAGE_RUN_SIZE (UINT64_C(1) << 20)
+
+/** Recorder of the reads from a @ref drgn_memory_reader. */
+struct drgn_memory_recorder {
+	/** Trace file. */
+	FILE *file;
+	/**
+	 * Hash of the data that was last recorded for each range. Data which
+	 * is the same as last time is not written again.
+	 */
+	struct drgn_memory_trace_map last_data;
+	/** Address of the previous record. */
+	uint64_t prev_address;
+	/**
+	 * Whether pages are recorded instead of reads, see @ref
+	 * drgn_program_record_memory_pages().
+	 */
+	bool pages;
+	/** Whether a touched page couldn't be added to @ref touched_pages. */
+	bool pages_enomem;
+	/** Pages touched so far if @ref pages is @c true. */
+	struct drgn_memory_trace_page_set touched_pages;
+};
+
+/**
+ * Flush and close the trace file of a @ref drgn_memory_recorder and free it.
+ *
+ * @return @c NULL on success, non-@c NULL if the trace file couldn't be
+ * written. The recorder is freed either way.
+ */
+struct drgn_error *
+drgn_memory_recorder_destroy(struct drgn_memory_recorder *recorder);
+
+/**
+ * Record a read in a @ref drgn_memory_recorder.
+ *
+ * If the recorder records pages, this only marks the pages of the read as
+ * touched. Errors writing the trace are reported by @ref
+ * drgn_program_stop_recording_memory().
+ *
+ * @param[in] buf Data that was read. Ignored if @p fault is @c true.
+ * @param[in] fault Whether the read faulted.
+ */
+void drgn_memory_recorder_record(struct drgn_memory_recorder *recorder,
+				 const void *buf, uint64_t address,
+				 size_t count, bool physical, bool fault);
+
+/** @} */
+
+#endif /* DRGN_MEMORY_TRACE_H */
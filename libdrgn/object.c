@@ -31,12 +31,89 @@ void drgn_object_init(struct drgn_object *obj, struct drgn_program *prog)
 		__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
 }
 
+/* Smallest size class of value buffers, in bytes (as a shift). */
+#define DRGN_VALUE_BUFFER_MIN_SHIFT 4
+
+static unsigned int drgn_value_buffer_class(uint64_t size)
+{
+	if (size <= UINT64_C(1) << DRGN_VALUE_BUFFER_MIN_SHIFT)
+		return 0;
+	return 64 - __builtin_clzll(size - 1) - DRGN_VALUE_BUFFER_MIN_SHIFT;
+}
+
+char *drgn_value_buffer_alloc(struct drgn_program *prog, uint64_t size)
+{
+	unsigned int class;
+	char *buf;
+
+	class = drgn_value_buffer_class(size);
+	if (class >= DRGN_VALUE_BUFFER_NUM_CLASSES)
+		return malloc64(size);
+
+	pthread_mutex_lock(&prog->value_buffers_lock);
+	buf = prog->value_buffers[class];
+	if (buf) {
+		/* Free buffers are linked through their first bytes. */
+		memcpy(&prog->value_buffers[class], buf, sizeof(void *));
+		prog->num_value_buffers[class]--;
+	}
+	pthread_mutex_unlock(&prog->value_buffers_lock);
+	if (buf)
+		return buf;
+	return malloc((size_t)1 << (class + DRGN_VALUE_BUFFER_MIN_SHIFT));
+}
+
+void drgn_value_buffer_free(struct drgn_program *prog, char *buf,
+			    uint64_t size)
+{
+	unsigned int class;
+
+	class = drgn_value_buffer_class(size);
+	if (class < DRGN_VALUE_BUFFER_NUM_CLASSES) {
+		pthread_mutex_lock(&prog->value_buffers_lock);
+		if (prog->num_value_buffers[class] <
+		    DRGN_VALUE_BUFFER_MAX_FREE) {
+			memcpy(buf, &prog->value_buffers[class],
+			       sizeof(void *));
+			prog->value_buffers[class] = buf;
+			prog->num_value_buffers[class]++;
+			buf = NULL;
+		}
+		pthread_mutex_unlock(&prog->value_buffers_lock);
+	}
+	free(buf);
+}
+
+void drgn_value_buffers_init(struct drgn_program *prog)
+{
+	pthread_mutex_init(&prog->value_buffers_lock, NULL);
+}
+
+void drgn_value_buffers_deinit(struct drgn_program *prog)
+{
+	unsigned int i;
+
+	for (i = 0; i < DRGN_VALUE_BUFFER_NUM_CLASSES; i++) {
+		while (prog->value_buffers[i]) {
+			void *buf = prog->value_buffers[i];
+
+			memcpy(&prog->value_buffers[i], buf, sizeof(void *));
+			free(buf);
+		}
+		prog->num_value_buffers[i] = 0;
+	}
+	pthread_mutex_destroy(&prog->value_buffers_lock);
+}
+
 static void drgn_value_deinit(const struct drgn_object *obj,
 			      const union drgn_value *value)
 {
 	if (obj->kind == DRGN_OBJECT_BUFFER &&
-	    !drgn_buffer_object_is_inline(obj))
-		free(value->bufp);
+	    !drgn_value_is_inline(obj->bit_size, value->bit_offset)) {
+		drgn_value_buffer_free(obj->prog, value->bufp,
+				       drgn_value_size(obj->bit_size,
+						       value->bit_offset));
+	}
 }
 
 LIBDRGN_PUBLIC void drgn_object_deinit_value(const struct drgn_object *obj,
@@ -244,10 +321,9 @@ struct drgn_error *sanity_check_object(enum drgn_object_kind kind,
 	}
 }
 
-static void drgn_value_deserialize(union drgn_value *value, const char *buf,
-				   uint8_t bit_offset,
-				   enum drgn_object_kind kind,
-				   uint64_t bit_size, bool little_endian)
+void drgn_value_deserialize(union drgn_value *value, const char *buf,
+			    uint8_t bit_offset, enum drgn_object_kind kind,
+			    uint64_t bit_size, bool little_endian)
 {
 	union {
 		int64_t svalue;
@@ -330,7 +406,7 @@ drgn_object_set_buffer_internal(struct drgn_object *res,
 		if (size <= sizeof(res->value.ibuf)) {
 			dst = res->value.ibuf;
 		} else {
-			dst = malloc64(size);
+			dst = drgn_value_buffer_alloc(res->prog, size);
 			if (!dst)
 				return &drgn_enomem;
 		}
@@ -462,7 +538,7 @@ drgn_object_copy(struct drgn_object *res, const struct drgn_object *obj)
 			dst = res->value.ibuf;
 			src = obj->value.ibuf;
 		} else {
-			dst = malloc64(size);
+			dst = drgn_value_buffer_alloc(res->prog, size);
 			if (!dst)
 				return &drgn_enomem;
 			src = obj->value.bufp;
@@ -575,6 +651,33 @@ drgn_object_dereference_offset(struct drgn_object *res,
 					 DRGN_PROGRAM_ENDIAN);
 }
 
+struct drgn_error *drgn_object_read_scalar(const struct drgn_object *obj,
+					   union drgn_value *ret)
+{
+	struct drgn_error *err;
+	char buf[9];
+	uint64_t size;
+
+	assert(obj->kind == DRGN_OBJECT_SIGNED ||
+	       obj->kind == DRGN_OBJECT_UNSIGNED ||
+	       obj->kind == DRGN_OBJECT_FLOAT);
+
+	if (!obj->is_reference) {
+		*ret = obj->value;
+		return NULL;
+	}
+
+	size = drgn_reference_object_size(obj);
+	assert(size <= sizeof(buf));
+	err = drgn_memory_reader_read(&obj->prog->reader, buf,
+				      obj->reference.address, size, false);
+	if (err)
+		return err;
+	drgn_value_deserialize(ret, buf, obj->reference.bit_offset, obj->kind,
+			       obj->bit_size, obj->reference.little_endian);
+	return NULL;
+}
+
 static struct drgn_error *
 drgn_object_read_reference(const struct drgn_object *obj,
 				union drgn_value *value)
@@ -596,7 +699,7 @@ drgn_object_read_reference(const struct drgn_object *obj,
 		if (size <= sizeof(value->ibuf)) {
 			buf = value->ibuf;
 		} else {
-			buf = malloc64(size);
+			buf = drgn_value_buffer_alloc(obj->prog, size);
 			if (!buf)
 				return &drgn_enomem;
 		}
@@ -605,7 +708,7 @@ drgn_object_read_reference(const struct drgn_object *obj,
 					      false);
 		if (err) {
 			if (buf != value->ibuf)
-				free(buf);
+				drgn_value_buffer_free(obj->prog, buf, size);
 			return err;
 		}
 		if (buf != value->ibuf)
@@ -614,18 +717,7 @@ drgn_object_read_reference(const struct drgn_object *obj,
 		value->little_endian = obj->reference.little_endian;
 		return NULL;
 	} else {
-		char buf[9];
-
-		assert(size <= sizeof(buf));
-		err = drgn_memory_reader_read(&obj->prog->reader, buf,
-					      obj->reference.address, size,
-					      false);
-		if (err)
-			return err;
-		drgn_value_deserialize(value, buf, obj->reference.bit_offset,
-				       obj->kind, obj->bit_size,
-				       obj->reference.little_endian);
-		return NULL;
+		return drgn_object_read_scalar(obj, value);
 	}
 }
 
@@ -654,6 +746,25 @@ drgn_object_read(struct drgn_object *res, const struct drgn_object *obj)
 	}
 }
 
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_object_snapshot(const struct drgn_object *obj)
+{
+	uint64_t size;
+
+	if (!obj->is_reference)
+		return NULL;
+	if (!drgn_object_kind_is_complete(obj->kind)) {
+		return drgn_error_incomplete_type("cannot read object with %s type",
+						  obj->type);
+	}
+	size = drgn_reference_object_size(obj);
+	if (size > SIZE_MAX)
+		return &drgn_enomem;
+	return drgn_memory_reader_snapshot(&obj->prog->reader,
+					   obj->reference.address, size,
+					   false);
+}
+
 LIBDRGN_PUBLIC struct drgn_error *
 drgn_object_read_value(const struct drgn_object *obj, union drgn_value *value,
 		       const union drgn_value **ret)
@@ -834,6 +945,15 @@ drgn_object_read_c_string(const struct drgn_object *obj, char **ret)
 LIBDRGN_PUBLIC struct drgn_error *
 drgn_format_object(const struct drgn_object *obj, size_t columns,
 		   enum drgn_format_object_flags flags, char **ret)
+{
+	return drgn_format_object_limited(obj, columns, flags, NULL, ret);
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_format_object_limited(const struct drgn_object *obj, size_t columns,
+			   enum drgn_format_object_flags flags,
+			   const struct drgn_format_object_limits *limits,
+			   char **ret)
 {
 	const struct drgn_language *lang = drgn_object_language(obj);
 
@@ -841,7 +961,100 @@ drgn_format_object(const struct drgn_object *obj, size_t columns,
 		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
 					 "invalid format object flags");
 	}
-	return lang->format_object(obj, columns, flags, ret);
+	return lang->format_object(obj, columns, flags, limits, ret);
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_format_object_stream(const struct drgn_object *obj, size_t columns,
+			  enum drgn_format_object_flags flags,
+			  const struct drgn_format_object_limits *limits,
+			  drgn_format_object_write_fn *write, void *arg)
+{
+	const struct drgn_language *lang = drgn_object_language(obj);
+
+	if (flags & ~DRGN_FORMAT_OBJECT_VALID_FLAGS) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "invalid format object flags");
+	}
+	return lang->format_object_stream(obj, columns, flags, limits, write,
+					  arg);
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_format_object_json(const struct drgn_object *obj,
+			const struct drgn_format_object_limits *limits,
+			char **ret)
+{
+	const struct drgn_language *lang = drgn_object_language(obj);
+
+	return lang->format_object_json(obj, limits, ret);
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_format_objects(const struct drgn_object * const *objs, size_t num_objs,
+		    size_t columns, enum drgn_format_object_flags flags,
+		    const struct drgn_format_object_limits *limits, char **rets)
+{
+	struct drgn_error *err = NULL;
+	size_t err_index = SIZE_MAX;
+	size_t i;
+
+	if (flags & ~DRGN_FORMAT_OBJECT_VALID_FLAGS) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "invalid format object flags");
+	}
+	if (!num_objs)
+		return NULL;
+	for (i = 1; i < num_objs; i++) {
+		if (objs[i]->prog != objs[0]->prog) {
+			return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+						 "objects are from different programs");
+		}
+	}
+	drgn_program_enable_concurrent_lookups(objs[0]->prog);
+
+	#pragma omp parallel for schedule(dynamic) \
+		num_threads(drgn_num_threads())
+	for (i = 0; i < num_objs; i++) {
+		const struct drgn_language *lang;
+		struct drgn_error *obj_err;
+		size_t first_err_index;
+
+		rets[i] = NULL;
+		/*
+		 * Once an object fails, only earlier objects can replace the
+		 * error, so skip the later ones.
+		 */
+		#pragma omp atomic read
+		first_err_index = err_index;
+		if (first_err_index < i)
+			continue;
+
+		lang = drgn_object_language(objs[i]);
+		obj_err = lang->format_object(objs[i], columns, flags, limits,
+					      &rets[i]);
+		if (obj_err) {
+			#pragma omp critical(drgn_format_objects)
+			{
+				if (i < err_index) {
+					drgn_error_destroy(err);
+					err = obj_err;
+					#pragma omp atomic write
+					err_index = i;
+				} else {
+					drgn_error_destroy(obj_err);
+				}
+			}
+		}
+	}
+
+	if (err) {
+		for (i = 0; i < num_objs; i++) {
+			free(rets[i]);
+			rets[i] = NULL;
+		}
+	}
+	return err;
 }
 
 static struct drgn_error *
@@ -1062,9 +1275,58 @@ drgn_object_is_zero_impl(const struct drgn_object *obj, bool *ret)
 	}
 }
 
+/*
+ * Check a buffer object with a flattened layout by reading it once and
+ * checking each leaf, instead of slicing it member by member.
+ */
+static struct drgn_error *
+drgn_flattened_object_is_zero(const struct drgn_object *obj,
+			      const struct drgn_type_layout *layout, bool *ret)
+{
+	struct drgn_error *err;
+	union drgn_value value_mem;
+	const union drgn_value *value;
+	const char *buf;
+	size_t i;
+
+	err = drgn_object_read_value(obj, &value_mem, &value);
+	if (err)
+		return err;
+	buf = (drgn_value_is_inline(obj->bit_size, value->bit_offset) ?
+	       value->ibuf : value->bufp);
+	for (i = 0; i < layout->num_leaves; i++) {
+		const struct drgn_type_leaf *leaf = &layout->leaves[i];
+		uint64_t bit_offset = value->bit_offset + leaf->bit_offset;
+		union drgn_value leaf_value;
+
+		drgn_value_deserialize(&leaf_value, buf + bit_offset / 8,
+				       bit_offset % 8, leaf->kind,
+				       leaf->bit_size, value->little_endian);
+		if (leaf->kind == DRGN_OBJECT_FLOAT ?
+		    leaf_value.fvalue != 0 : leaf_value.uvalue != 0) {
+			*ret = false;
+			break;
+		}
+	}
+	drgn_object_deinit_value(obj, value);
+	return NULL;
+}
+
 struct drgn_error *drgn_object_is_zero(const struct drgn_object *obj, bool *ret)
 {
+	struct drgn_error *err;
+
 	*ret = true;
+	if (obj->kind == DRGN_OBJECT_BUFFER) {
+		const struct drgn_type_layout *layout;
+
+		err = drgn_type_index_layout(&obj->prog->tindex, obj->type,
+					     &layout);
+		if (err)
+			return err;
+		if (layout->flattened)
+			return drgn_flattened_object_is_zero(obj, layout, ret);
+	}
 	return drgn_object_is_zero_impl(obj, ret);
 }
 
@@ -1363,7 +1625,7 @@ struct drgn_error *drgn_object_member_dereference(struct drgn_object *res,
 {
 	struct drgn_error *err;
 	struct drgn_type *underlying_type;
-	struct drgn_member_value *member;
+	struct drgn_member_value member;
 	struct drgn_qualified_type qualified_type;
 
 	if (res->prog != obj->prog) {
@@ -1384,13 +1646,13 @@ struct drgn_error *drgn_object_member_dereference(struct drgn_object *res,
 	if (err)
 		return err;
 
-	err = drgn_lazy_type_evaluate(member->type, &qualified_type);
+	err = drgn_lazy_type_evaluate(member.type, &qualified_type);
 	if (err)
 		return err;
 
 	return drgn_object_dereference_offset(res, obj, qualified_type,
-					      member->bit_offset,
-					      member->bit_field_size);
+					      member.bit_offset,
+					      member.bit_field_size);
 }
 
 LIBDRGN_PUBLIC struct drgn_error *
@@ -1400,7 +1662,8 @@ drgn_object_container_of(struct drgn_object *res, const struct drgn_object *obj,
 {
 	const struct drgn_language *lang = drgn_object_language(obj);
 	struct drgn_error *err;
-	uint64_t address, bit_offset;
+	uint64_t address;
+	struct drgn_member_info member;
 	struct drgn_qualified_type result_type;
 
 	if (res->prog != obj->prog) {
@@ -1414,11 +1677,11 @@ drgn_object_container_of(struct drgn_object *res, const struct drgn_object *obj,
 				       obj->type);
 	}
 
-	err = lang->bit_offset(obj->prog, qualified_type.type,
-			       member_designator, &bit_offset);
+	err = lang->member_path(obj->prog, qualified_type.type,
+				member_designator, &member);
 	if (err)
 		return err;
-	if (bit_offset % 8) {
+	if (member.bit_offset % 8) {
 		return drgn_error_format(DRGN_ERROR_INVALID_ARGUMENT,
 					 "container_of() member is not byte-aligned");
 	}
@@ -1433,7 +1696,7 @@ drgn_object_container_of(struct drgn_object *res, const struct drgn_object *obj,
 		return err;
 	result_type.qualifiers = 0;
 	return drgn_object_set_unsigned(res, result_type,
-					address - bit_offset / 8, 0);
+					address - member.bit_offset / 8, 0);
 }
 
 LIBDRGN_PUBLIC struct drgn_error *
@@ -1752,6 +2015,21 @@ struct drgn_error *drgn_op_cmp_pointers(const struct drgn_object *lhs,
 	struct drgn_error *err;
 	uint64_t lhs_value, rhs_value;
 
+	/*
+	 * Two references to the same pointer in memory have the same value, so
+	 * they don't need to be read.
+	 */
+	if (lhs->kind == DRGN_OBJECT_UNSIGNED &&
+	    rhs->kind == DRGN_OBJECT_UNSIGNED &&
+	    lhs->is_reference && rhs->is_reference &&
+	    lhs->reference.address == rhs->reference.address &&
+	    lhs->reference.bit_offset == rhs->reference.bit_offset &&
+	    lhs->reference.little_endian == rhs->reference.little_endian &&
+	    lhs->bit_size == rhs->bit_size) {
+		*ret = 0;
+		return NULL;
+	}
+
 	err = pointer_operand(lhs, &lhs_value);
 	if (err)
 		return err;
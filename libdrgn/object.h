@@ -139,6 +139,64 @@ struct drgn_error *
 drgn_byte_order_to_little_endian(struct drgn_program *prog,
 				 enum drgn_byte_order byte_order, bool *ret);
 
+/**
+ * Deserialize a scalar value from a buffer.
+ *
+ * @param[out] value Returned value.
+ * @param[in] buf Buffer containing the value.
+ * @param[in] bit_offset Offset of the value from the beginning of @p buf. Must
+ * be less than 8.
+ * @param[in] kind @ref DRGN_OBJECT_SIGNED, @ref DRGN_OBJECT_UNSIGNED, or @ref
+ * DRGN_OBJECT_FLOAT.
+ * @param[in] bit_size Size of the value in bits.
+ * @param[in] little_endian Whether the value is little-endian.
+ */
+void drgn_value_deserialize(union drgn_value *value, const char *buf,
+			    uint8_t bit_offset, enum drgn_object_kind kind,
+			    uint64_t bit_size, bool little_endian);
+
+/**
+ * Allocate a buffer for the value of a buffer object.
+ *
+ * Buffers of up to 4 KiB are rounded up to a power-of-two size class and
+ * recycled through per-program free lists, so reading many medium-sized
+ * objects doesn't need a malloc() and free() for each one.
+ *
+ * @param[in] size Size of the value in bytes. This must be greater than the
+ * size of the inline buffer.
+ * @return The buffer, which must be freed with @ref drgn_value_buffer_free(),
+ * or @c NULL if we couldn't allocate memory.
+ */
+char *drgn_value_buffer_alloc(struct drgn_program *prog, uint64_t size);
+
+/**
+ * Free a buffer allocated with @ref drgn_value_buffer_alloc().
+ *
+ * @param[in] size The size that was passed to @ref drgn_value_buffer_alloc().
+ */
+void drgn_value_buffer_free(struct drgn_program *prog, char *buf,
+			    uint64_t size);
+
+/** Initialize the value buffer cache of a @ref drgn_program. */
+void drgn_value_buffers_init(struct drgn_program *prog);
+
+/** Free all cached value buffers of a @ref drgn_program. */
+void drgn_value_buffers_deinit(struct drgn_program *prog);
+
+/**
+ * Get the value of a signed, unsigned, or floating-point object.
+ *
+ * This is a cheaper version of @ref drgn_object_read_value() for scalar
+ * objects: a reference is read directly into a small stack buffer, and the
+ * result never needs to be passed to @ref drgn_object_deinit_value().
+ *
+ * @param[in] obj Object with kind @ref DRGN_OBJECT_SIGNED, @ref
+ * DRGN_OBJECT_UNSIGNED, or @ref DRGN_OBJECT_FLOAT.
+ * @param[out] ret Returned value.
+ */
+struct drgn_error *drgn_object_read_scalar(const struct drgn_object *obj,
+					   union drgn_value *ret);
+
 /**
  * Binary operator implementation.
  *
@@ -307,7 +365,8 @@ struct drgn_error *drgn_op_cmp_impl(const struct drgn_object *lhs,
 /**
  * Implement object comparison for pointers and reference buffer objects.
  *
- * When comparing reference buffer objects, their address is used.
+ * When comparing reference buffer objects, their address is used. Two
+ * references to the same pointer compare equal without reading memory.
  */
 struct drgn_error *drgn_op_cmp_pointers(const struct drgn_object *lhs,
 					const struct drgn_object *rhs,
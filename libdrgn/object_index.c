@@ -4,9 +4,36 @@
 #include <string.h>
 
 #include "internal.h"
+#include "object.h"
 #include "object_index.h"
 #include "type.h"
 
+static struct hash_pair
+drgn_object_finder_memo_key_hash(const struct drgn_object_finder_memo_key *key)
+{
+	size_t hash;
+
+	hash = hash_combine(key->flags, hash_bytes(key->name, key->name_len));
+	if (key->filename)
+		hash = hash_combine(hash, c_string_hash(&key->filename).first);
+	return hash_pair_from_avalanching_hash(hash);
+}
+
+static bool
+drgn_object_finder_memo_key_eq(const struct drgn_object_finder_memo_key *a,
+			       const struct drgn_object_finder_memo_key *b)
+{
+	return (a->flags == b->flags && a->name_len == b->name_len &&
+		memcmp(a->name, b->name, a->name_len) == 0 &&
+		(a->filename && b->filename ?
+		 strcmp(a->filename, b->filename) == 0 :
+		 a->filename == b->filename));
+}
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_object_finder_memo,
+			    drgn_object_finder_memo_key_hash,
+			    drgn_object_finder_memo_key_eq)
+
 void drgn_object_index_init(struct drgn_object_index *oindex)
 {
 	oindex->finders = NULL;
@@ -19,7 +46,18 @@ void drgn_object_index_deinit(struct drgn_object_index *oindex)
 	finder = oindex->finders;
 	while (finder) {
 		struct drgn_object_finder *next = finder->next;
+		struct drgn_object_finder_memo_iterator it;
 
+		for (it = drgn_object_finder_memo_first(&finder->memo);
+		     it.entry; it = drgn_object_finder_memo_next(it)) {
+			/* The name and filename are allocated together. */
+			free((char *)it.entry->key.name);
+			if (it.entry->value) {
+				drgn_object_deinit(it.entry->value);
+				free(it.entry->value);
+			}
+		}
+		drgn_object_finder_memo_deinit(&finder->memo);
 		free(finder);
 		finder = next;
 	}
@@ -27,7 +65,7 @@ void drgn_object_index_deinit(struct drgn_object_index *oindex)
 
 struct drgn_error *
 drgn_object_index_add_finder(struct drgn_object_index *oindex,
-			     drgn_object_find_fn fn, void *arg)
+			     drgn_object_find_fn fn, void *arg, bool memoize)
 {
 	struct drgn_object_finder *finder;
 
@@ -36,11 +74,88 @@ drgn_object_index_add_finder(struct drgn_object_index *oindex,
 		return &drgn_enomem;
 	finder->fn = fn;
 	finder->arg = arg;
+	finder->memoize = memoize;
+	drgn_object_finder_memo_init(&finder->memo);
 	finder->next = oindex->finders;
 	oindex->finders = finder;
 	return NULL;
 }
 
+size_t drgn_object_index_memory_usage(struct drgn_object_index *oindex)
+{
+	struct drgn_object_finder *finder;
+	struct drgn_object_finder_memo_iterator it;
+	size_t size = 0;
+
+	for (finder = oindex->finders; finder; finder = finder->next) {
+		size += drgn_object_finder_memo_memory_usage(&finder->memo);
+		for (it = drgn_object_finder_memo_first(&finder->memo);
+		     it.entry; it = drgn_object_finder_memo_next(it)) {
+			size += it.entry->key.name_len + 1;
+			if (it.entry->key.filename)
+				size += strlen(it.entry->key.filename) + 1;
+			if (it.entry->value)
+				size += sizeof(*it.entry->value);
+		}
+	}
+	return size;
+}
+
+/*
+ * Remember the result of a call to a finder: a copy of @p obj, or @c NULL if
+ * the object wasn't found. Memoizing is only an optimization, so failures are
+ * ignored.
+ */
+static void drgn_object_finder_memoize(struct drgn_object_finder *finder,
+				       const struct drgn_object_finder_memo_key *key,
+				       struct hash_pair hp,
+				       const struct drgn_object *obj)
+{
+	struct drgn_object_finder_memo_entry entry = {
+		.key = *key,
+	};
+	struct drgn_error *err;
+	size_t filename_size;
+	char *buf;
+
+	filename_size = key->filename ? strlen(key->filename) + 1 : 0;
+	buf = malloc(key->name_len + 1 + filename_size);
+	if (!buf)
+		return;
+	memcpy(buf, key->name, key->name_len);
+	buf[key->name_len] = '\0';
+	entry.key.name = buf;
+	if (key->filename) {
+		memcpy(buf + key->name_len + 1, key->filename, filename_size);
+		entry.key.filename = buf + key->name_len + 1;
+	}
+	if (obj) {
+		entry.value = malloc(sizeof(*entry.value));
+		if (!entry.value)
+			goto err;
+		drgn_object_init(entry.value, obj->prog);
+		err = drgn_object_copy(entry.value, obj);
+		if (err) {
+			drgn_error_destroy(err);
+			drgn_object_deinit(entry.value);
+			free(entry.value);
+			goto err;
+		}
+	} else {
+		entry.value = NULL;
+	}
+	/* The finder may have looked up the same object itself. */
+	if (drgn_object_finder_memo_insert_hashed(&finder->memo, &entry, hp,
+						  NULL) == 1)
+		return;
+	if (entry.value) {
+		drgn_object_deinit(entry.value);
+		free(entry.value);
+	}
+err:
+	free(buf);
+}
+
 struct drgn_error *drgn_object_index_find(struct drgn_object_index *oindex,
 					  const char *name,
 					  const char *filename,
@@ -60,10 +175,38 @@ struct drgn_error *drgn_object_index_find(struct drgn_object_index *oindex,
 	name_len = strlen(name);
 	finder = oindex->finders;
 	while (finder) {
+		struct drgn_object_finder_memo_key key = {
+			.name = name,
+			.name_len = name_len,
+			.filename = filename,
+			.flags = flags,
+		};
+		struct hash_pair hp;
+
+		if (finder->memoize) {
+			struct drgn_object_finder_memo_iterator it;
+
+			hp = drgn_object_finder_memo_hash(&key);
+			it = drgn_object_finder_memo_search_hashed(&finder->memo,
+								   &key, hp);
+			if (it.entry) {
+				if (it.entry->value)
+					return drgn_object_copy(ret,
+								it.entry->value);
+				finder = finder->next;
+				continue;
+			}
+		}
+
 		err = finder->fn(name, name_len, filename, flags, finder->arg,
 				 ret);
-		if (err != &drgn_not_found)
+		if (err && err != &drgn_not_found)
 			return err;
+		if (finder->memoize)
+			drgn_object_finder_memoize(finder, &key, hp,
+						   err ? NULL : ret);
+		if (!err)
+			return NULL;
 		finder = finder->next;
 	}
 
@@ -13,6 +13,7 @@
 #define DRGN_OBJECT_INDEX_H
 
 #include "drgn.h"
+#include "hash_table.h"
 
 /**
  * @ingroup Internals
@@ -27,12 +28,35 @@
  * @{
  */
 
+/** Arguments of a call to a @ref drgn_object_finder. */
+struct drgn_object_finder_memo_key {
+	const char *name;
+	size_t name_len;
+	/** Filename, or @c NULL. */
+	const char *filename;
+	enum drgn_find_object_flags flags;
+};
+
+/**
+ * Map from the arguments of a call to a @ref drgn_object_finder to a copy of
+ * the object it returned, or @c NULL if the object was not found.
+ */
+DEFINE_HASH_MAP_TYPE(drgn_object_finder_memo,
+		     struct drgn_object_finder_memo_key, struct drgn_object *);
+
 /** Registered callback in a @ref drgn_object_index. */
 struct drgn_object_finder {
 	/** The callback. */
 	drgn_object_find_fn fn;
 	/** Argument to pass to @ref drgn_object_finder::fn. */
 	void *arg;
+	/** Whether results of @ref fn are memoized in @ref memo. */
+	bool memoize;
+	/**
+	 * Results of previous calls to @ref fn, including objects that weren't
+	 * found. The keys and objects are owned by the map.
+	 */
+	struct drgn_object_finder_memo memo;
 	/** Next callback to try. */
 	struct drgn_object_finder *next;
 };
@@ -56,10 +80,18 @@ void drgn_object_index_init(struct drgn_object_index *oindex);
 /** Deinitialize a @ref drgn_object_index. */
 void drgn_object_index_deinit(struct drgn_object_index *oindex);
 
-/** @sa drgn_program_add_object_finder() */
+/**
+ * @sa drgn_program_add_object_finder()
+ *
+ * @param[in] memoize Whether to remember the results of @p fn. @sa
+ * drgn_program_add_memoized_object_finder()
+ */
 struct drgn_error *
 drgn_object_index_add_finder(struct drgn_object_index *oindex,
-			     drgn_object_find_fn fn, void *arg);
+			     drgn_object_find_fn fn, void *arg, bool memoize);
+
+/** Get the number of bytes allocated by a @ref drgn_object_index. */
+size_t drgn_object_index_memory_usage(struct drgn_object_index *oindex);
 
 /**
  * Find an object in a @ref drgn_object_index.
@@ -0,0 +1,253 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <gelf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+#include "orc.h"
+
+/*
+ * Versions of the ORC entry format:
+ *
+ * 1. Before Linux 6.3: sp_reg:4, bp_reg:4, type:2, end:1. type is CALL (0),
+ *    REGS (1), or REGS_PARTIAL (2), and the outermost frame has an undefined
+ *    sp_reg and end set.
+ * 2. Linux 6.3: sp_reg:4, bp_reg:4, type:2, signal:1, end:1.
+ * 3. Linux 6.4 and newer (which also added .orc_header): sp_reg:4, bp_reg:4,
+ *    type:3, signal:1. type is UNDEFINED (0), END_OF_STACK (1), CALL (2), REGS
+ *    (3), or REGS_PARTIAL (4).
+ */
+static int orc_version(Elf *elf, size_t shstrndx, const char *osrelease)
+{
+	Elf_Scn *scn = NULL;
+	int major, minor;
+
+	while ((scn = elf_nextscn(elf, scn))) {
+		GElf_Shdr shdr_mem, *shdr;
+		const char *name;
+
+		shdr = gelf_getshdr(scn, &shdr_mem);
+		if (!shdr)
+			continue;
+		name = elf_strptr(elf, shstrndx, shdr->sh_name);
+		if (name && strcmp(name, ".orc_header") == 0)
+			return 3;
+	}
+	if (sscanf(osrelease, "%d.%d", &major, &minor) != 2)
+		return 1;
+	if (major > 6 || (major == 6 && minor >= 4))
+		return 3;
+	if (major == 6 && minor == 3)
+		return 2;
+	return 1;
+}
+
+static void parse_orc_entry(const char *p, int version,
+			    struct drgn_orc_entry *ret)
+{
+	static const uint8_t old_types[] = {
+		DRGN_ORC_TYPE_CALL,
+		DRGN_ORC_TYPE_REGS,
+		DRGN_ORC_TYPE_REGS_PARTIAL,
+		DRGN_ORC_TYPE_UNDEFINED,
+	};
+	uint8_t regs = p[4], flags = p[5];
+	bool end;
+
+	memcpy(&ret->sp_offset, p, sizeof(ret->sp_offset));
+	memcpy(&ret->bp_offset, p + 2, sizeof(ret->bp_offset));
+	ret->sp_reg = regs & 0xf;
+	ret->bp_reg = regs >> 4;
+	if (version == 3) {
+		ret->type = flags & 0x7;
+		if (ret->type > DRGN_ORC_TYPE_REGS_PARTIAL)
+			ret->type = DRGN_ORC_TYPE_UNDEFINED;
+		ret->signal = flags & 0x8;
+		return;
+	}
+	ret->type = old_types[flags & 0x3];
+	if (version == 2) {
+		ret->signal = flags & 0x4;
+		end = flags & 0x8;
+	} else {
+		ret->signal = ret->type != DRGN_ORC_TYPE_CALL;
+		end = flags & 0x4;
+	}
+	if (ret->sp_reg == DRGN_ORC_REG_UNDEFINED) {
+		ret->type = (end ? DRGN_ORC_TYPE_END_OF_STACK :
+			     DRGN_ORC_TYPE_UNDEFINED);
+	}
+}
+
+struct orc_sort_entry {
+	uint64_t pc;
+	struct drgn_orc_entry entry;
+};
+
+static int orc_sort_entry_cmp(const void *_a, const void *_b)
+{
+	const struct orc_sort_entry *a = _a, *b = _b;
+
+	if (a->pc != b->pc)
+		return a->pc < b->pc ? -1 : 1;
+	return 0;
+}
+
+/*
+ * The tables in vmlinux are sorted at build time, but the tables in kernel
+ * modules are only sorted when they are loaded.
+ */
+static struct drgn_error *sort_orc_table(struct drgn_orc_table *table)
+{
+	struct orc_sort_entry *sorted;
+	size_t i;
+
+	for (i = 1; i < table->num_entries; i++) {
+		if (table->pcs[i] < table->pcs[i - 1])
+			break;
+	}
+	if (i >= table->num_entries)
+		return NULL;
+
+	sorted = malloc_array(table->num_entries, sizeof(*sorted));
+	if (!sorted)
+		return &drgn_enomem;
+	for (i = 0; i < table->num_entries; i++) {
+		sorted[i].pc = table->pcs[i];
+		sorted[i].entry = table->entries[i];
+	}
+	qsort(sorted, table->num_entries, sizeof(*sorted), orc_sort_entry_cmp);
+	for (i = 0; i < table->num_entries; i++) {
+		table->pcs[i] = sorted[i].pc;
+		table->entries[i] = sorted[i].entry;
+	}
+	free(sorted);
+	return NULL;
+}
+
+struct drgn_error *drgn_orc_table_create(Dwfl_Module *module,
+					 const char *osrelease,
+					 struct drgn_orc_table **ret)
+{
+	struct drgn_error *err;
+	Elf *elf;
+	GElf_Addr bias;
+	GElf_Ehdr ehdr_mem, *ehdr;
+	size_t shstrndx, num_entries, i;
+	Elf_Scn *scn = NULL;
+	Elf_Data *ip_data = NULL, *orc_data = NULL;
+	uint64_t ip_addr = 0;
+	struct drgn_orc_table *table;
+	int version;
+
+	*ret = NULL;
+	/*
+	 * This applies relocations to all sections of kernel modules, which we
+	 * need for .orc_unwind_ip.
+	 */
+	elf = dwfl_module_getelf(module, &bias);
+	if (!elf)
+		return NULL;
+	ehdr = gelf_getehdr(elf, &ehdr_mem);
+	if (!ehdr || ehdr->e_machine != EM_X86_64 ||
+	    ehdr->e_ident[EI_DATA] != ELFDATA2LSB ||
+	    __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+		return NULL;
+	if (elf_getshdrstrndx(elf, &shstrndx))
+		return drgn_error_libelf();
+
+	while ((scn = elf_nextscn(elf, scn))) {
+		GElf_Shdr shdr_mem, *shdr;
+		const char *name;
+
+		shdr = gelf_getshdr(scn, &shdr_mem);
+		if (!shdr)
+			return drgn_error_libelf();
+		if (shdr->sh_type != SHT_PROGBITS)
+			continue;
+		name = elf_strptr(elf, shstrndx, shdr->sh_name);
+		if (!name)
+			continue;
+		if (strcmp(name, ".orc_unwind_ip") == 0) {
+			ip_data = elf_getdata(scn, NULL);
+			if (!ip_data)
+				return drgn_error_libelf();
+			ip_addr = shdr->sh_addr + bias;
+		} else if (strcmp(name, ".orc_unwind") == 0) {
+			orc_data = elf_getdata(scn, NULL);
+			if (!orc_data)
+				return drgn_error_libelf();
+		}
+	}
+	if (!ip_data || !orc_data)
+		return NULL;
+	num_entries = ip_data->d_size / sizeof(int32_t);
+	if (!num_entries)
+		return NULL;
+	if (orc_data->d_size / 6 != num_entries) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "ORC sections have different numbers of entries");
+	}
+	version = orc_version(elf, shstrndx, osrelease);
+
+	table = malloc(sizeof(*table));
+	if (!table)
+		return &drgn_enomem;
+	table->pcs = malloc_array(num_entries, sizeof(*table->pcs));
+	table->entries = malloc_array(num_entries, sizeof(*table->entries));
+	table->num_entries = num_entries;
+	if (!table->pcs || !table->entries) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	for (i = 0; i < num_entries; i++) {
+		int32_t offset;
+
+		/* Each entry is relative to its own address. */
+		memcpy(&offset, (char *)ip_data->d_buf + i * sizeof(offset),
+		       sizeof(offset));
+		table->pcs[i] = ip_addr + i * sizeof(offset) + offset;
+		parse_orc_entry((char *)orc_data->d_buf + i * 6, version,
+				&table->entries[i]);
+	}
+	err = sort_orc_table(table);
+	if (err)
+		goto err;
+	*ret = table;
+	return NULL;
+
+err:
+	drgn_orc_table_destroy(table);
+	return err;
+}
+
+void drgn_orc_table_destroy(struct drgn_orc_table *table)
+{
+	if (table) {
+		free(table->entries);
+		free(table->pcs);
+		free(table);
+	}
+}
+
+const struct drgn_orc_entry *
+drgn_orc_table_find(const struct drgn_orc_table *table, uint64_t pc)
+{
+	size_t lo = 0, hi = table->num_entries;
+
+	/* Find the last entry starting at or before pc. */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (table->pcs[mid] <= pc)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (!lo)
+		return NULL;
+	return &table->entries[lo - 1];
+}
@@ -0,0 +1,117 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Linux kernel ORC unwinding tables.
+ *
+ * See @ref OrcTables.
+ */
+
+#ifndef DRGN_ORC_H
+#define DRGN_ORC_H
+
+#include <elfutils/libdwfl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup OrcTables ORC tables
+ *
+ * Linux kernel ORC unwinding tables.
+ *
+ * x86-64 kernels built with @c CONFIG_UNWINDER_ORC have a compact table of
+ * unwinding rules in the @c .orc_unwind_ip and @c .orc_unwind sections of
+ * vmlinux and each kernel module. These are much simpler and faster to
+ * evaluate than DWARF CFI, and they are present even without debugging
+ * information.
+ *
+ * The format of the entries changed in Linux 6.3 and 6.4, so entries are
+ * converted to a common representation when the table is loaded.
+ *
+ * @{
+ */
+
+/** Register that an ORC rule is relative to. */
+enum drgn_orc_reg {
+	DRGN_ORC_REG_UNDEFINED = 0,
+	DRGN_ORC_REG_PREV_SP = 1,
+	DRGN_ORC_REG_DX = 2,
+	DRGN_ORC_REG_DI = 3,
+	DRGN_ORC_REG_BP = 4,
+	DRGN_ORC_REG_SP = 5,
+	DRGN_ORC_REG_R10 = 6,
+	DRGN_ORC_REG_R13 = 7,
+	DRGN_ORC_REG_BP_INDIRECT = 8,
+	DRGN_ORC_REG_SP_INDIRECT = 9,
+};
+
+/** Kind of frame described by an ORC entry. */
+enum drgn_orc_type {
+	/** No unwinding information. */
+	DRGN_ORC_TYPE_UNDEFINED,
+	/** The outermost frame. */
+	DRGN_ORC_TYPE_END_OF_STACK,
+	/** Normal call frame; the return address is just below the CFA. */
+	DRGN_ORC_TYPE_CALL,
+	/** The CFA points to a full <tt>struct pt_regs</tt>. */
+	DRGN_ORC_TYPE_REGS,
+	/** The CFA points to the hardware interrupt frame of a pt_regs. */
+	DRGN_ORC_TYPE_REGS_PARTIAL,
+};
+
+/** ORC unwinding rule for a range of instructions. */
+struct drgn_orc_entry {
+	int16_t sp_offset;
+	int16_t bp_offset;
+	/** @ref drgn_orc_reg that the CFA is relative to. */
+	uint8_t sp_reg;
+	/** @ref drgn_orc_reg that the saved frame pointer is relative to. */
+	uint8_t bp_reg;
+	/** @ref drgn_orc_type. */
+	uint8_t type;
+	/**
+	 * Whether the caller's program counter should be used as is instead of
+	 * as a return address.
+	 */
+	bool signal;
+};
+
+/** ORC table of a module sorted by program counter. */
+struct drgn_orc_table {
+	/** Start address of the range covered by each entry. */
+	uint64_t *pcs;
+	struct drgn_orc_entry *entries;
+	size_t num_entries;
+};
+
+/**
+ * Load the ORC table of a module.
+ *
+ * @param[in] osrelease Kernel release, used to determine the format of the
+ * entries.
+ * @param[out] ret Returned table, or @c NULL if the module doesn't have one.
+ * Must be freed with @ref drgn_orc_table_destroy().
+ */
+struct drgn_error *drgn_orc_table_create(Dwfl_Module *module,
+					 const char *osrelease,
+					 struct drgn_orc_table **ret);
+
+/** Free a @ref drgn_orc_table. */
+void drgn_orc_table_destroy(struct drgn_orc_table *table);
+
+/**
+ * Find the ORC entry covering a program counter.
+ *
+ * @return Entry, or @c NULL if no entry covers @p pc.
+ */
+const struct drgn_orc_entry *
+drgn_orc_table_find(const struct drgn_orc_table *table, uint64_t pc);
+
+/** @} */
+
+#endif /* DRGN_ORC_H */
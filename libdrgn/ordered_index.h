@@ -0,0 +1,285 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Generic immutable ordered indices.
+ *
+ * See @ref OrderedIndices.
+ */
+
+#ifndef DRGN_ORDERED_INDEX_H
+#define DRGN_ORDERED_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup OrderedIndices Ordered indices
+ *
+ * Immutable sorted indices.
+ *
+ * An ordered index is built once from an array of entries sorted by key and is
+ * then only searched. Unlike a splay tree (see @ref BinarySearchTrees),
+ * searching doesn't modify anything, so it only needs a read lock (or no lock
+ * at all). It also doesn't chase pointers. The keys are stored in a static
+ * B+-tree with nodes of @ref ORDERED_INDEX_NODE_SIZE keys, which is one cache
+ * line of 64-bit keys. Each level of a search scans one node without branching.
+ * If the entries change, the index must be rebuilt.
+ *
+ * This fits maps from address ranges that are read much more often than they
+ * change. Keys must be a scalar type which can be compared with <tt><=</tt>.
+ *
+ * An ordered index is defined with @ref DEFINE_ORDERED_INDEX(). Each generated
+ * interface is prefixed with a given name. The interface documented here uses
+ * the example name @c ordered_index, which could be generated with this example
+ * code:
+ *
+ * @code{.c}
+ * key_type entry_to_key(const entry_type *entry);
+ * DEFINE_ORDERED_INDEX(ordered_index, entry_type, key_type, entry_to_key)
+ * @endcode
+ *
+ * @{
+ */
+
+/** Number of keys in each node of an ordered index. */
+#define ORDERED_INDEX_NODE_SIZE 8
+
+/**
+ * Maximum number of levels in an ordered index. This is enough for @c SIZE_MAX
+ * entries.
+ */
+#define ORDERED_INDEX_MAX_LEVELS 22
+
+#ifdef DOXYGEN
+/**
+ * @struct ordered_index
+ *
+ * Ordered index instance.
+ *
+ * There are no requirements on how this is allocated. It may be global, on the
+ * stack, allocated by @c malloc(), embedded in another structure, etc.
+ */
+struct ordered_index;
+
+/** Initialize an empty @ref ordered_index. */
+void ordered_index_init(struct ordered_index *index);
+
+/** Free memory allocated by a @ref ordered_index. */
+void ordered_index_deinit(struct ordered_index *index);
+
+/**
+ * Replace the contents of an @ref ordered_index.
+ *
+ * @param[in] entries Array of entries sorted by key, allocated with @c malloc().
+ * On success, the index takes ownership of it. On failure, it is left to the
+ * caller.
+ * @param[in] size Number of entries.
+ * @return @c true on success, @c false on failure to allocate memory. On
+ * failure, the index is not modified.
+ */
+bool ordered_index_build(struct ordered_index *index, entry_type *entries,
+			 size_t size);
+
+/**
+ * Find the entry with the greatest key less than or equal to the given key.
+ *
+ * @return The entry, or @c NULL if every key is greater than @p key.
+ */
+entry_type *ordered_index_search_le(const struct ordered_index *index,
+				    key_type key);
+
+/** Return the number of entries in an @ref ordered_index. */
+size_t ordered_index_size(const struct ordered_index *index);
+
+/** Return the number of bytes allocated by an @ref ordered_index. */
+size_t ordered_index_memory_usage(const struct ordered_index *index);
+#endif
+
+/**
+ * Define an ordered index type without defining its functions.
+ *
+ * This is useful when the type must be defined in one place (e.g., a header)
+ * but the interface is defined elsewhere (e.g., a source file) with @ref
+ * DEFINE_ORDERED_INDEX_FUNCTIONS(). Otherwise, just use @ref
+ * DEFINE_ORDERED_INDEX().
+ *
+ * @sa DEFINE_ORDERED_INDEX()
+ */
+#define DEFINE_ORDERED_INDEX_TYPE(index, entry_type, key_type)		\
+typedef typeof(entry_type) index##_entry_type;				\
+typedef typeof(key_type) index##_key_type;				\
+									\
+struct index {								\
+	index##_entry_type *entries;					\
+	size_t size;							\
+	/*								\
+	 * Keys of every level concatenated: first one per entry, then	\
+	 * the first key of every node in the level below, and so on.	\
+	 * Each level is padded to a whole node by repeating its last	\
+	 * key.								\
+	 */								\
+	index##_key_type *keys;						\
+	size_t num_keys;						\
+	unsigned int num_levels;					\
+	size_t level_offsets[ORDERED_INDEX_MAX_LEVELS];			\
+	size_t level_sizes[ORDERED_INDEX_MAX_LEVELS];			\
+};
+
+/**
+ * Define the functions for an ordered index.
+ *
+ * The type must have already been defined with @ref
+ * DEFINE_ORDERED_INDEX_TYPE().
+ *
+ * Unless the type and function definitions must be in separate places, use @ref
+ * DEFINE_ORDERED_INDEX() instead.
+ *
+ * @sa DEFINE_ORDERED_INDEX()
+ */
+#define DEFINE_ORDERED_INDEX_FUNCTIONS(index, entry_to_key)			\
+__attribute__((unused))								\
+static void index##_init(struct index *index)					\
+{										\
+	index->entries = NULL;							\
+	index->size = 0;							\
+	index->keys = NULL;							\
+	index->num_keys = 0;							\
+	index->num_levels = 0;							\
+}										\
+										\
+__attribute__((unused))								\
+static void index##_deinit(struct index *index)					\
+{										\
+	free(index->keys);							\
+	free(index->entries);							\
+}										\
+										\
+__attribute__((unused))								\
+static bool index##_build(struct index *index,					\
+			  index##_entry_type *entries, size_t size)		\
+{										\
+	size_t level_offsets[ORDERED_INDEX_MAX_LEVELS];				\
+	size_t level_sizes[ORDERED_INDEX_MAX_LEVELS];				\
+	unsigned int num_levels = 0, level;					\
+	size_t num_keys = 0, level_size, i;					\
+	index##_key_type *keys;							\
+										\
+	if (size) {								\
+		level_size = size;						\
+		for (;;) {							\
+			level_offsets[num_levels] = num_keys;			\
+			level_sizes[num_levels] = level_size;			\
+			num_levels++;						\
+			num_keys += ((level_size + ORDERED_INDEX_NODE_SIZE - 1) &	\
+				     -ORDERED_INDEX_NODE_SIZE);			\
+			if (level_size <= ORDERED_INDEX_NODE_SIZE)		\
+				break;						\
+			level_size = ((level_size + ORDERED_INDEX_NODE_SIZE - 1) /	\
+				      ORDERED_INDEX_NODE_SIZE);			\
+		}								\
+		keys = malloc_array(num_keys, sizeof(*keys));			\
+		if (!keys)							\
+			return false;						\
+	} else {								\
+		keys = NULL;							\
+	}									\
+										\
+	for (level = 0; level < num_levels; level++) {				\
+		index##_key_type *level_keys = keys + level_offsets[level];	\
+		size_t end = ((level_sizes[level] + ORDERED_INDEX_NODE_SIZE - 1) &	\
+			      -ORDERED_INDEX_NODE_SIZE);			\
+										\
+		for (i = 0; i < level_sizes[level]; i++) {			\
+			if (level == 0) {					\
+				level_keys[i] = entry_to_key(&entries[i]);	\
+			} else {						\
+				level_keys[i] =					\
+					keys[level_offsets[level - 1] +		\
+					     i * ORDERED_INDEX_NODE_SIZE];	\
+			}							\
+		}								\
+		for (; i < end; i++)						\
+			level_keys[i] = level_keys[level_sizes[level] - 1];	\
+	}									\
+										\
+	index##_deinit(index);							\
+	index->entries = entries;						\
+	index->size = size;							\
+	index->keys = keys;							\
+	index->num_keys = num_keys;						\
+	index->num_levels = num_levels;						\
+	memcpy(index->level_offsets, level_offsets,				\
+	       num_levels * sizeof(level_offsets[0]));				\
+	memcpy(index->level_sizes, level_sizes,					\
+	       num_levels * sizeof(level_sizes[0]));				\
+	return true;								\
+}										\
+										\
+__attribute__((unused))								\
+static index##_entry_type *index##_search_le(const struct index *index,		\
+					     index##_key_type key)		\
+{										\
+	unsigned int level = index->num_levels;					\
+	size_t i = 0;								\
+										\
+	while (level-- > 0) {							\
+		const index##_key_type *node =					\
+			&index->keys[index->level_offsets[level] +		\
+				     i * ORDERED_INDEX_NODE_SIZE];		\
+		size_t count = 0, j;						\
+										\
+		for (j = 0; j < ORDERED_INDEX_NODE_SIZE; j++)			\
+			count += node[j] <= key;				\
+		/*								\
+		 * The first key of every node below the top is the key that	\
+		 * led us to it, so this can only happen at the top.		\
+		 */								\
+		if (!count)							\
+			return NULL;						\
+		i = min(i * ORDERED_INDEX_NODE_SIZE + count - 1,		\
+			index->level_sizes[level] - 1);				\
+	}									\
+	return index->num_levels ? &index->entries[i] : NULL;			\
+}										\
+										\
+__attribute__((unused))								\
+static size_t index##_size(const struct index *index)				\
+{										\
+	return index->size;							\
+}										\
+										\
+__attribute__((unused))								\
+static size_t index##_memory_usage(const struct index *index)			\
+{										\
+	return (index->size * sizeof(index->entries[0]) +			\
+		index->num_keys * sizeof(index->keys[0]));			\
+}
+
+/**
+ * Define an ordered index interface.
+ *
+ * This macro defines an ordered index type along with its functions.
+ *
+ * @param[in] index Name of the type to define. This is prefixed to all of the
+ * types and functions defined for that type.
+ * @param[in] entry_type Type of entries in the index.
+ * @param[in] key_type Scalar type of the keys.
+ * @param[in] entry_to_key Name of function or macro which is passed a <tt>const
+ * entry_type *</tt> and returns the key for that entry.
+ */
+#define DEFINE_ORDERED_INDEX(index, entry_type, key_type, entry_to_key)	\
+DEFINE_ORDERED_INDEX_TYPE(index, entry_type, key_type)			\
+DEFINE_ORDERED_INDEX_FUNCTIONS(index, entry_to_key)
+
+/** @} */
+
+#endif /* DRGN_ORDERED_INDEX_H */
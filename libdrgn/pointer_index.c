@@ -0,0 +1,506 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <byteswap.h>
+#include <endian.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+#include "memory_reader.h"
+#include "pointer_index.h"
+#include "program.h"
+#include "vector.h"
+
+/* Size of the header of a pointer index file. */
+#define DRGN_POINTER_INDEX_HEADER_SIZE					\
+	(DRGN_POINTER_INDEX_MAGIC_LEN + 2 * sizeof(uint32_t) + sizeof(uint64_t))
+
+DEFINE_VECTOR(drgn_pointer_index_entry_vector, struct drgn_pointer_index_entry)
+
+/* Chunk of memory scanned by one thread. */
+struct drgn_pointer_index_chunk {
+	uint64_t address;
+	size_t size;
+};
+
+DEFINE_VECTOR(drgn_pointer_index_chunk_vector, struct drgn_pointer_index_chunk)
+
+struct drgn_pointer_index_builder {
+	struct drgn_memory_reader *reader;
+	/* Virtual address ranges that pointers may point into. */
+	struct drgn_memory_range *targets;
+	size_t num_targets;
+	uint8_t word_size;
+	bool bswap;
+};
+
+static bool
+drgn_pointer_index_builder_is_target(struct drgn_pointer_index_builder *builder,
+				     uint64_t value)
+{
+	size_t lo = 0, hi = builder->num_targets;
+
+	/* Most words aren't pointers, so check the whole span first. */
+	if (value < builder->targets[0].start ||
+	    value > builder->targets[builder->num_targets - 1].last)
+		return false;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (value < builder->targets[mid].start)
+			hi = mid;
+		else if (value > builder->targets[mid].last)
+			lo = mid + 1;
+		else
+			return true;
+	}
+	return false;
+}
+
+/* Collect the words in buf that look like pointers. */
+static bool
+drgn_pointer_index_scan(struct drgn_pointer_index_builder *builder,
+			const char *buf, uint64_t address, size_t size,
+			struct drgn_pointer_index_entry_vector *entries)
+{
+	size_t i;
+
+	for (i = 0; i < size; i += builder->word_size) {
+		struct drgn_pointer_index_entry entry;
+
+		if (builder->word_size == 8) {
+			uint64_t value;
+
+			memcpy(&value, buf + i, sizeof(value));
+			entry.target = builder->bswap ? bswap_64(value) : value;
+		} else {
+			uint32_t value;
+
+			memcpy(&value, buf + i, sizeof(value));
+			entry.target = builder->bswap ? bswap_32(value) : value;
+		}
+		if (!drgn_pointer_index_builder_is_target(builder,
+							  entry.target))
+			continue;
+		entry.source = address + i;
+		if (!drgn_pointer_index_entry_vector_append(entries, &entry))
+			return false;
+	}
+	return true;
+}
+
+static struct drgn_error *
+drgn_pointer_index_scan_chunk(struct drgn_pointer_index_builder *builder,
+			      const struct drgn_pointer_index_chunk *chunk,
+			      char *buf,
+			      struct drgn_pointer_index_entry_vector *entries)
+{
+	struct drgn_error *err;
+	size_t offset;
+	bool ok;
+
+	err = drgn_memory_reader_try_read(builder->reader, buf, chunk->address,
+					  chunk->size, false, &ok);
+	if (err)
+		return err;
+	if (ok) {
+		if (!drgn_pointer_index_scan(builder, buf, chunk->address,
+					     chunk->size, entries))
+			return &drgn_enomem;
+		return NULL;
+	}
+
+	/*
+	 * Part of the chunk isn't readable. Skip runs of memory that are known
+	 * to be absent, read the rest again one page at a time, and skip the
+	 * pages that fail.
+	 */
+	for (offset = 0; offset < chunk->size;) {
+		uint64_t address = chunk->address + offset;
+		uint64_t run_last;
+		size_t n;
+
+		err = drgn_memory_reader_present(builder->reader, address,
+						 chunk->address +
+						 (chunk->size - 1), false, &ok,
+						 &run_last);
+		if (err)
+			return err;
+		if (!ok) {
+			offset += run_last - address + 1;
+			continue;
+		}
+		n = min((uint64_t)(chunk->size - offset),
+			DRGN_MEMORY_CACHE_PAGE_SIZE -
+			(address & (DRGN_MEMORY_CACHE_PAGE_SIZE - 1)));
+		err = drgn_memory_reader_try_read(builder->reader, buf, address,
+						  n, false, &ok);
+		if (err)
+			return err;
+		if (ok &&
+		    !drgn_pointer_index_scan(builder, buf, address, n, entries))
+			return &drgn_enomem;
+		offset += n;
+	}
+	return NULL;
+}
+
+/* Split ranges into word-aligned chunks. */
+static bool
+drgn_pointer_index_chunks(const struct drgn_memory_range *ranges,
+			  size_t num_ranges, uint64_t word_size,
+			  struct drgn_pointer_index_chunk_vector *chunks)
+{
+	size_t i;
+
+	for (i = 0; i < num_ranges; i++) {
+		uint64_t address;
+
+		address = (ranges[i].start + word_size - 1) & -word_size;
+		if (address < ranges[i].start || address > ranges[i].last)
+			continue;
+		for (;;) {
+			uint64_t remaining = ranges[i].last - address;
+			struct drgn_pointer_index_chunk *chunk;
+
+			if (remaining < word_size - 1)
+				break;
+			chunk = drgn_pointer_index_chunk_vector_append_entry(chunks);
+			if (!chunk)
+				return false;
+			chunk->address = address;
+			if (remaining >= DRGN_POINTER_INDEX_CHUNK_SIZE) {
+				chunk->size = DRGN_POINTER_INDEX_CHUNK_SIZE;
+				address += DRGN_POINTER_INDEX_CHUNK_SIZE;
+			} else {
+				/* remaining + 1 can't overflow here. */
+				chunk->size = (remaining + 1) & -word_size;
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+static int drgn_pointer_index_entry_cmp(const void *_a, const void *_b)
+{
+	const struct drgn_pointer_index_entry *a = _a, *b = _b;
+
+	if (a->target != b->target)
+		return a->target < b->target ? -1 : 1;
+	if (a->source != b->source)
+		return a->source < b->source ? -1 : 1;
+	return 0;
+}
+
+struct drgn_error *
+drgn_pointer_index_build(struct drgn_program *prog,
+			 const struct drgn_memory_range *ranges,
+			 size_t num_ranges, struct drgn_pointer_index **ret)
+{
+	struct drgn_error *err = NULL;
+	struct drgn_pointer_index_builder builder;
+	struct drgn_pointer_index_chunk_vector chunks = VECTOR_INIT;
+	struct drgn_pointer_index_entry_vector *thread_entries = NULL;
+	char **buffers = NULL;
+	struct drgn_pointer_index *index = NULL;
+	size_t err_index = SIZE_MAX, num_entries, i;
+	int num_threads = drgn_num_threads(), thread;
+
+	if (!prog->has_platform) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "program platform is not known");
+	}
+	builder.reader = &prog->reader;
+	builder.word_size = drgn_program_is_64_bit(prog) ? 8 : 4;
+	builder.bswap = drgn_program_bswap(prog);
+	err = drgn_memory_reader_ranges(&prog->reader, false, &builder.targets,
+					&builder.num_targets);
+	if (err)
+		return err;
+	if (!ranges) {
+		ranges = builder.targets;
+		num_ranges = builder.num_targets;
+	}
+	if (!drgn_pointer_index_chunks(ranges, num_ranges, builder.word_size,
+				       &chunks))
+		goto enomem;
+
+	index = malloc(sizeof(*index));
+	if (!index)
+		goto enomem;
+	index->entries = NULL;
+	index->num_entries = 0;
+	index->word_size = builder.word_size;
+	if (!chunks.size || !builder.num_targets)
+		goto out;
+
+	thread_entries = malloc_array(num_threads, sizeof(*thread_entries));
+	if (!thread_entries)
+		goto enomem;
+	for (thread = 0; thread < num_threads; thread++)
+		drgn_pointer_index_entry_vector_init(&thread_entries[thread]);
+	buffers = calloc(num_threads, sizeof(*buffers));
+	if (!buffers)
+		goto enomem;
+	for (thread = 0; thread < num_threads; thread++) {
+		buffers[thread] = malloc(DRGN_POINTER_INDEX_CHUNK_SIZE);
+		if (!buffers[thread])
+			goto enomem;
+	}
+
+	#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+	for (i = 0; i < chunks.size; i++) {
+		struct drgn_error *chunk_err;
+		size_t first_err_index;
+		int thread_num;
+
+		/* Once a chunk fails, the rest of the index is useless. */
+		#pragma omp atomic read
+		first_err_index = err_index;
+		if (first_err_index != SIZE_MAX)
+			continue;
+
+		thread_num = omp_get_thread_num();
+		chunk_err = drgn_pointer_index_scan_chunk(&builder,
+							  &chunks.data[i],
+							  buffers[thread_num],
+							  &thread_entries[thread_num]);
+		if (chunk_err) {
+			#pragma omp critical(drgn_pointer_index_build)
+			{
+				if (i < err_index) {
+					drgn_error_destroy(err);
+					err = chunk_err;
+					#pragma omp atomic write
+					err_index = i;
+				} else {
+					drgn_error_destroy(chunk_err);
+				}
+			}
+		}
+	}
+	if (err)
+		goto out;
+
+	num_entries = 0;
+	for (thread = 0; thread < num_threads; thread++)
+		num_entries += thread_entries[thread].size;
+	if (num_entries) {
+		index->entries = malloc_array(num_entries,
+					      sizeof(index->entries[0]));
+		if (!index->entries)
+			goto enomem;
+	}
+	for (thread = 0; thread < num_threads; thread++) {
+		memcpy(index->entries + index->num_entries,
+		       thread_entries[thread].data,
+		       thread_entries[thread].size *
+		       sizeof(thread_entries[thread].data[0]));
+		index->num_entries += thread_entries[thread].size;
+		drgn_pointer_index_entry_vector_deinit(&thread_entries[thread]);
+		drgn_pointer_index_entry_vector_init(&thread_entries[thread]);
+	}
+	qsort(index->entries, index->num_entries, sizeof(index->entries[0]),
+	      drgn_pointer_index_entry_cmp);
+	goto out;
+
+enomem:
+	err = &drgn_enomem;
+out:
+	if (buffers) {
+		for (thread = 0; thread < num_threads; thread++)
+			free(buffers[thread]);
+		free(buffers);
+	}
+	if (thread_entries) {
+		for (thread = 0; thread < num_threads; thread++)
+			drgn_pointer_index_entry_vector_deinit(&thread_entries[thread]);
+		free(thread_entries);
+	}
+	drgn_pointer_index_chunk_vector_deinit(&chunks);
+	free(builder.targets);
+	if (err) {
+		if (index)
+			drgn_pointer_index_destroy(index);
+		return err;
+	}
+	*ret = index;
+	return NULL;
+}
+
+void drgn_pointer_index_destroy(struct drgn_pointer_index *index)
+{
+	free(index->entries);
+	free(index);
+}
+
+/* Index of the first entry with a target greater than or equal to target. */
+static size_t
+drgn_pointer_index_lower_bound(const struct drgn_pointer_index *index,
+			       uint64_t target)
+{
+	size_t lo = 0, hi = index->num_entries;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (index->entries[mid].target < target)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+const struct drgn_pointer_index_entry *
+drgn_pointer_index_find(const struct drgn_pointer_index *index, uint64_t first,
+			uint64_t last, size_t *count_ret)
+{
+	size_t lo, hi;
+
+	if (first > last) {
+		*count_ret = 0;
+		return index->entries;
+	}
+	lo = drgn_pointer_index_lower_bound(index, first);
+	if (last == UINT64_MAX)
+		hi = index->num_entries;
+	else
+		hi = drgn_pointer_index_lower_bound(index, last + 1);
+	*count_ret = hi - lo;
+	return index->entries + lo;
+}
+
+struct drgn_error *
+drgn_pointer_index_save(const struct drgn_pointer_index *index,
+			const char *path)
+{
+	FILE *file;
+	char header[DRGN_POINTER_INDEX_HEADER_SIZE], *p;
+	uint32_t u32;
+	uint64_t u64;
+	size_t i;
+
+	file = fopen(path, "w");
+	if (!file)
+		return drgn_error_create_os("fopen", errno, path);
+
+	p = header;
+	memcpy(p, DRGN_POINTER_INDEX_MAGIC, DRGN_POINTER_INDEX_MAGIC_LEN);
+	p += DRGN_POINTER_INDEX_MAGIC_LEN;
+	u32 = htole32(DRGN_POINTER_INDEX_VERSION);
+	memcpy(p, &u32, sizeof(u32));
+	p += sizeof(u32);
+	u32 = htole32(index->word_size);
+	memcpy(p, &u32, sizeof(u32));
+	p += sizeof(u32);
+	u64 = htole64(index->num_entries);
+	memcpy(p, &u64, sizeof(u64));
+	p += sizeof(u64);
+	fwrite(header, 1, p - header, file);
+
+	for (i = 0; i < index->num_entries; i++) {
+		uint64_t entry[2] = {
+			htole64(index->entries[i].target),
+			htole64(index->entries[i].source),
+		};
+
+		fwrite(entry, sizeof(entry), 1, file);
+	}
+
+	if (ferror(file)) {
+		fclose(file);
+		return drgn_error_create(DRGN_ERROR_OS,
+					 "could not write pointer index");
+	}
+	if (fclose(file) == EOF)
+		return drgn_error_create_os("fclose", errno, path);
+	return NULL;
+}
+
+struct drgn_error *drgn_pointer_index_load(const char *path,
+					   struct drgn_pointer_index **ret)
+{
+	FILE *file;
+	char header[DRGN_POINTER_INDEX_HEADER_SIZE];
+	const char *p;
+	uint32_t version, word_size;
+	uint64_t num_entries;
+	struct drgn_pointer_index *index;
+	size_t i;
+
+	file = fopen(path, "r");
+	if (!file)
+		return drgn_error_create_os("fopen", errno, path);
+	if (fread(header, sizeof(header), 1, file) != 1 ||
+	    memcmp(header, DRGN_POINTER_INDEX_MAGIC,
+		   DRGN_POINTER_INDEX_MAGIC_LEN) != 0)
+		goto invalid;
+	p = header + DRGN_POINTER_INDEX_MAGIC_LEN;
+	memcpy(&version, p, sizeof(version));
+	version = le32toh(version);
+	p += sizeof(version);
+	if (version != DRGN_POINTER_INDEX_VERSION) {
+		fclose(file);
+		return drgn_error_format(DRGN_ERROR_INVALID_ARGUMENT,
+					 "unsupported pointer index version %" PRIu32,
+					 version);
+	}
+	memcpy(&word_size, p, sizeof(word_size));
+	word_size = le32toh(word_size);
+	p += sizeof(word_size);
+	memcpy(&num_entries, p, sizeof(num_entries));
+	num_entries = le64toh(num_entries);
+	if ((word_size != 4 && word_size != 8) || num_entries > SIZE_MAX)
+		goto invalid;
+
+	index = malloc(sizeof(*index));
+	if (!index) {
+		fclose(file);
+		return &drgn_enomem;
+	}
+	index->word_size = word_size;
+	index->num_entries = num_entries;
+	index->entries = NULL;
+	if (num_entries) {
+		index->entries = malloc_array(num_entries,
+					      sizeof(index->entries[0]));
+		if (!index->entries) {
+			free(index);
+			fclose(file);
+			return &drgn_enomem;
+		}
+		if (fread(index->entries, sizeof(index->entries[0]),
+			  num_entries, file) != num_entries) {
+			drgn_pointer_index_destroy(index);
+			goto invalid;
+		}
+	}
+	fclose(file);
+
+	for (i = 0; i < index->num_entries; i++) {
+		index->entries[i].target = le64toh(index->entries[i].target);
+		index->entries[i].source = le64toh(index->entries[i].source);
+		/* Lookups rely on the order, so don't trust it blindly. */
+		if (i &&
+		    drgn_pointer_index_entry_cmp(&index->entries[i - 1],
+						 &index->entries[i]) > 0) {
+			drgn_pointer_index_destroy(index);
+			return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+						 "pointer index is not sorted");
+		}
+	}
+	*ret = index;
+	return NULL;
+
+invalid:
+	fclose(file);
+	return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+				 "not a drgn pointer index");
+}
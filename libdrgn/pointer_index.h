@@ -0,0 +1,124 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Reverse pointer index.
+ *
+ * See @ref PointerIndex.
+ */
+
+#ifndef DRGN_POINTER_INDEX_H
+#define DRGN_POINTER_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct drgn_memory_range;
+struct drgn_program;
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup PointerIndex Pointer index
+ *
+ * Index from pointer values to the addresses where they are stored.
+ *
+ * A pointer index is built by reading memory in chunks in parallel and
+ * collecting every aligned word whose value is an address in a virtual memory
+ * segment of the program. It answers "what points to this object?" with a
+ * binary search instead of a scan of memory.
+ *
+ * An index can be saved to a file and loaded again later, e.g., next to the
+ * core dump it was built from. The file contains:
+ *
+ * - The magic string @ref DRGN_POINTER_INDEX_MAGIC.
+ * - The format version, @ref DRGN_POINTER_INDEX_VERSION, as a u32.
+ * - The word size of the program, as a u32.
+ * - The number of entries, as a u64.
+ * - The target and source of each entry, as u64s, in the order of the index.
+ *
+ * All integers are little-endian.
+ *
+ * @{
+ */
+
+/** Magic string at the start of a pointer index file. */
+#define DRGN_POINTER_INDEX_MAGIC "DRGNPIDX"
+/** Length of @ref DRGN_POINTER_INDEX_MAGIC. */
+#define DRGN_POINTER_INDEX_MAGIC_LEN 8
+/** Version of the pointer index file format. */
+#define DRGN_POINTER_INDEX_VERSION 1
+
+/** Size of the chunks that are read and scanned in parallel. */
+#define DRGN_POINTER_INDEX_CHUNK_SIZE (UINT64_C(1) << 20)
+
+/** Word in memory which looks like a pointer. */
+struct drgn_pointer_index_entry {
+	/** Value of the word. */
+	uint64_t target;
+	/** Address of the word. */
+	uint64_t source;
+};
+
+/** Reverse pointer index. */
+struct drgn_pointer_index {
+	/** Entries sorted by target, then by source. */
+	struct drgn_pointer_index_entry *entries;
+	size_t num_entries;
+	/** Size of the words that were indexed. */
+	uint8_t word_size;
+};
+
+/**
+ * Build a @ref drgn_pointer_index by scanning a program's memory.
+ *
+ * @param[in] ranges Virtual address ranges to scan, or @c NULL to scan every
+ * virtual memory segment of the program. Unreadable memory in the ranges is
+ * skipped.
+ * @param[in] num_ranges Number of ranges in @p ranges.
+ * @param[out] ret Returned index. It must be freed with @ref
+ * drgn_pointer_index_destroy().
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *
+drgn_pointer_index_build(struct drgn_program *prog,
+			 const struct drgn_memory_range *ranges,
+			 size_t num_ranges, struct drgn_pointer_index **ret);
+
+/** Free a @ref drgn_pointer_index. */
+void drgn_pointer_index_destroy(struct drgn_pointer_index *index);
+
+/**
+ * Find the entries of a @ref drgn_pointer_index with a target in a range.
+ *
+ * @param[in] first First target address to find.
+ * @param[in] last Last target address to find, inclusive.
+ * @param[out] count_ret Returned number of entries.
+ * @return The first entry. The entries are contiguous and sorted by target,
+ * then by source.
+ */
+const struct drgn_pointer_index_entry *
+drgn_pointer_index_find(const struct drgn_pointer_index *index, uint64_t first,
+			uint64_t last, size_t *count_ret);
+
+/** Save a @ref drgn_pointer_index to a file. */
+struct drgn_error *
+drgn_pointer_index_save(const struct drgn_pointer_index *index,
+			const char *path);
+
+/**
+ * Load a @ref drgn_pointer_index from a file saved by @ref
+ * drgn_pointer_index_save().
+ *
+ * @param[out] ret Returned index. It must be freed with @ref
+ * drgn_pointer_index_destroy().
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *drgn_pointer_index_load(const char *path,
+					   struct drgn_pointer_index **ret);
+
+/** @} */
+
+#endif /* DRGN_POINTER_INDEX_H */
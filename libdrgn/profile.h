@@ -0,0 +1,96 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Call accounting for libdrgn operations.
+ *
+ * See @ref Profiling.
+ */
+
+#ifndef DRGN_PROFILE_H
+#define DRGN_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "drgn.h"
+#include "util.h"
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup Profiling Profiling
+ *
+ * Call accounting for libdrgn operations.
+ *
+ * While profiling is enabled with @ref drgn_program_set_profiling(), profiled
+ * operations count their calls and time in a @ref drgn_profile_stats. While it
+ * is disabled, each operation only costs a branch. Counters are updated
+ * atomically since lookups may run concurrently.
+ *
+ * @{
+ */
+
+/** Profiling state of a program. */
+struct drgn_profile {
+	bool enabled;
+	struct drgn_profile_stats stats;
+};
+
+/**
+ * Start timing a profiled operation.
+ *
+ * @param[in] profile Profiling state, or @c NULL if it isn't available.
+ * @return Start time to pass to @ref drgn_profile_end(), or 0 if profiling is
+ * disabled.
+ */
+static inline uint64_t drgn_profile_begin(struct drgn_profile *profile)
+{
+	return profile && profile->enabled ? monotonic_ns() : 0;
+}
+
+/** Count a call to a profiled operation without timing it. */
+#define drgn_profile_count(profile, counter) do {				\
+	struct drgn_profile *_profile = (profile);				\
+										\
+	if (_profile && _profile->enabled) {					\
+		__atomic_fetch_add(&_profile->stats.counter.calls, 1,		\
+				   __ATOMIC_RELAXED);				\
+	}									\
+} while (0)
+
+/**
+ * Add the time since @ref drgn_profile_begin() to a counter without counting a
+ * call.
+ */
+#define drgn_profile_add_ns(profile, counter, start_ns) do {			\
+	uint64_t _start_ns = (start_ns);					\
+										\
+	if (_start_ns) {							\
+		__atomic_fetch_add(&(profile)->stats.counter.ns,		\
+				   monotonic_ns() - _start_ns,			\
+				   __ATOMIC_RELAXED);				\
+	}									\
+} while (0)
+
+/**
+ * Count a call to a profiled operation which started at @p start_ns, as
+ * returned by @ref drgn_profile_begin().
+ */
+#define drgn_profile_end(profile, counter, start_ns) do {			\
+	uint64_t _start_ns = (start_ns);					\
+										\
+	if (_start_ns) {							\
+		__atomic_fetch_add(&(profile)->stats.counter.calls, 1,		\
+				   __ATOMIC_RELAXED);				\
+		__atomic_fetch_add(&(profile)->stats.counter.ns,		\
+				   monotonic_ns() - _start_ns,			\
+				   __ATOMIC_RELAXED);				\
+	}									\
+} while (0)
+
+/** @} */
+
+#endif /* DRGN_PROFILE_H */
@@ -2,6 +2,9 @@
 // SPDX-License-Identifier: GPL-3.0+
 
 #include <byteswap.h>
+#include <dirent.h>
+#include <dwarf.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <gelf.h>
 #include <inttypes.h>
@@ -10,28 +13,154 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/vfs.h>
 
 #include "internal.h"
+#include "btf.h"
+#include "compressed_file.h"
 #include "dwarf_index.h"
 #include "dwarf_info_cache.h"
+#include "kallsyms.h"
 #include "language.h"
+#include "line_table.h"
 #include "linux_kernel.h"
 #include "memory_reader.h"
+#include "object.h"
 #include "object_index.h"
 #include "program.h"
 #include "read.h"
+#include "remote.h"
+#include "serialize.h"
 #include "string_builder.h"
 #include "symbol.h"
 #include "type_index.h"
+#include "usdt.h"
 #include "vector.h"
 
 DEFINE_VECTOR_FUNCTIONS(drgn_prstatus_vector)
 DEFINE_HASH_TABLE_FUNCTIONS(drgn_prstatus_map, hash_pair_int_type,
 			    hash_table_scalar_eq)
 
+static struct hash_pair
+drgn_translation_key_hash(const struct drgn_translation_key *key)
+{
+	size_t hash;
+
+	hash = hash_combine(key->pgtable, key->virt_addr);
+	hash = hash_combine(hash, key->shift);
+	return hash_pair_from_avalanching_hash(hash);
+}
+
+static bool drgn_translation_key_eq(const struct drgn_translation_key *a,
+				    const struct drgn_translation_key *b)
+{
+	return (a->pgtable == b->pgtable && a->virt_addr == b->virt_addr &&
+		a->shift == b->shift);
+}
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_translation_map, drgn_translation_key_hash,
+			    drgn_translation_key_eq)
+
+/*
+ * Maximum number of cached address translations. The cache is simply emptied
+ * when it is full.
+ */
+#define DRGN_MAX_CACHED_TRANSLATIONS 65536
+
+static void drgn_program_invalidate_translations(struct drgn_program *prog)
+{
+	drgn_translation_map_clear(&prog->translation_cache);
+	prog->translation_cache_shifts = 0;
+}
+
+static struct hash_pair
+drgn_dentry_path_key_hash(const struct drgn_dentry_path_key *key)
+{
+	return hash_pair_from_avalanching_hash(hash_combine(key->mnt,
+							    key->dentry));
+}
+
+static bool drgn_dentry_path_key_eq(const struct drgn_dentry_path_key *a,
+				    const struct drgn_dentry_path_key *b)
+{
+	return a->mnt == b->mnt && a->dentry == b->dentry;
+}
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_dentry_path_map, drgn_dentry_path_key_hash,
+			    drgn_dentry_path_key_eq)
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_symbol_name_map, c_string_hash, c_string_eq)
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_kernel_btf_map, hash_pair_int_type,
+			    hash_table_scalar_eq)
+DEFINE_VECTOR_FUNCTIONS(drgn_btf_vector)
+
+static struct hash_pair
+drgn_pid_cache_key_hash(const struct drgn_pid_cache_key *key)
+{
+	return hash_pair_from_avalanching_hash(hash_combine(key->ns, key->nr));
+}
+
+static bool drgn_pid_cache_key_eq(const struct drgn_pid_cache_key *a,
+				  const struct drgn_pid_cache_key *b)
+{
+	return a->ns == b->ns && a->nr == b->nr;
+}
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_pid_cache, drgn_pid_cache_key_hash,
+			    drgn_pid_cache_key_eq)
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_pid_ns_set, hash_pair_int_type,
+			    hash_table_scalar_eq)
+
+static void drgn_program_invalidate_pids(struct drgn_program *prog)
+{
+	drgn_pid_cache_clear(&prog->pid_cache);
+	drgn_pid_ns_set_clear(&prog->pid_cache_namespaces);
+}
+
+static struct hash_pair drgn_symbol_hash_pair(struct drgn_symbol * const *key)
+{
+	size_t hash;
+
+	hash = hash_combine((uintptr_t)(*key)->name, (*key)->address);
+	hash = hash_combine(hash, (*key)->size);
+	return hash_pair_from_avalanching_hash(hash);
+}
+
+static bool drgn_interned_symbol_eq(struct drgn_symbol * const *a,
+				    struct drgn_symbol * const *b)
+{
+	return ((*a)->name == (*b)->name && (*a)->address == (*b)->address &&
+		(*a)->size == (*b)->size);
+}
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_symbol_set, drgn_symbol_hash_pair,
+			    drgn_interned_symbol_eq)
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_cfi_rule_map, hash_pair_int_type,
+			    hash_table_scalar_eq)
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_pc_symbol_map, hash_pair_int_type,
+			    hash_table_scalar_eq)
+
+/*
+ * Maximum number of cached program counter to symbol lookups. Like
+ * translations, the cache is simply emptied when it is full.
+ */
+#define DRGN_MAX_CACHED_PC_SYMBOLS 65536
+
+/* Maximum number of cached dentry paths. Like translations, see above. */
+#define DRGN_MAX_CACHED_DENTRY_PATHS 65536
+
+static void drgn_program_invalidate_dentry_paths(struct drgn_program *prog)
+{
+	struct drgn_dentry_path_map_iterator it;
+
+	for (it = drgn_dentry_path_map_first(&prog->dentry_path_cache);
+	     it.entry; it = drgn_dentry_path_map_next(it))
+		free((char *)it.entry->value.str);
+	drgn_dentry_path_map_clear(&prog->dentry_path_cache);
+}
+
 static Elf_Type note_header_type(GElf_Phdr *phdr)
 {
 	if (phdr->p_align == 8)
@@ -57,12 +186,16 @@ drgn_program_language(struct drgn_program *prog)
 	return drgn_language_or_default(prog->lang);
 }
 
+static const struct drgn_program_ops *
+drgn_platform_program_ops(const struct drgn_platform *platform);
+
 void drgn_program_set_platform(struct drgn_program *prog,
 			       const struct drgn_platform *platform)
 {
 	if (!prog->has_platform) {
 		prog->platform = *platform;
 		prog->has_platform = true;
+		prog->ops = drgn_platform_program_ops(platform);
 		prog->tindex.word_size =
 			platform->flags & DRGN_PLATFORM_IS_64_BIT ? 8 : 4;
 	}
@@ -74,38 +207,119 @@ void drgn_program_init(struct drgn_program *prog,
 	memset(prog, 0, sizeof(*prog));
 	drgn_memory_reader_init(&prog->reader);
 	drgn_type_index_init(&prog->tindex);
+	prog->tindex.profile = &prog->profile;
 	drgn_object_index_init(&prog->oindex);
+	drgn_translation_map_init(&prog->translation_cache);
+	drgn_dentry_path_map_init(&prog->dentry_path_cache);
+	drgn_kernel_btf_map_init(&prog->kernel_btfs);
+	drgn_pid_cache_init(&prog->pid_cache);
+	drgn_pid_ns_set_init(&prog->pid_cache_namespaces);
+	drgn_btf_vector_init(&prog->kernel_btf_list);
+	drgn_symbol_name_map_init(&prog->symbol_name_map);
+	drgn_symbol_set_init(&prog->interned_symbols);
+	drgn_arena_init(&prog->symbol_arena);
+	drgn_cfi_rule_map_init(&prog->cfi_rules);
+	drgn_pc_symbol_map_init(&prog->pc_symbol_cache);
+	drgn_value_buffers_init(prog);
+	prog->ops = drgn_platform_program_ops(NULL);
 	prog->core_fd = -1;
 	if (platform)
 		drgn_program_set_platform(prog, platform);
 }
 
+static void drgn_program_free_core_mapped_files(struct drgn_program *prog)
+{
+	size_t i;
+
+	for (i = 0; i < prog->num_core_mapped_files; i++) {
+		struct drgn_core_mapped_file *file =
+			&prog->core_mapped_files[i];
+
+		if (file->map)
+			munmap((void *)file->map, file->size);
+		free(file->build_id);
+	}
+	free(prog->core_mapped_files);
+	prog->core_mapped_files = NULL;
+	prog->num_core_mapped_files = 0;
+	free(prog->core_mapped_file_segments);
+	prog->core_mapped_file_segments = NULL;
+}
+
 void drgn_program_deinit(struct drgn_program *prog)
 {
+	size_t i;
+
+	/* The prefetch thread may use anything that read callbacks use. */
+	drgn_memory_reader_disable_prefetch(&prog->reader);
+	drgn_program_finish_loading_debug_info(prog);
+	drgn_error_destroy(prog->debug_info_err);
+	/* Errors writing a trace which wasn't stopped are lost. */
+	if (prog->reader.recorder)
+		drgn_error_destroy(drgn_program_stop_recording_memory(prog));
+	free(prog->stack_trace_buf);
 	free(prog->task_state_chars);
+	free(prog->per_cpu_offsets);
+	free(prog->symbol_table);
+	drgn_symbol_name_map_deinit(&prog->symbol_name_map);
+	drgn_symbol_set_deinit(&prog->interned_symbols);
+	drgn_arena_deinit(&prog->symbol_arena);
+	drgn_cfi_rule_map_deinit(&prog->cfi_rules);
+	drgn_pc_symbol_map_deinit(&prog->pc_symbol_cache);
+	if (prog->kallsyms) {
+		drgn_kallsyms_deinit(prog->kallsyms);
+		free(prog->kallsyms);
+	}
 	if (prog->prstatus_cached) {
 		if (prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL)
 			drgn_prstatus_vector_deinit(&prog->prstatus_vector);
 		else
 			drgn_prstatus_map_deinit(&prog->prstatus_map);
 	}
+	free(prog->prstatus_buf);
+	drgn_translation_map_deinit(&prog->translation_cache);
+	drgn_program_invalidate_dentry_paths(prog);
+	drgn_dentry_path_map_deinit(&prog->dentry_path_cache);
 	free(prog->pgtable_it);
 
+	drgn_value_buffers_deinit(prog);
 	drgn_object_index_deinit(&prog->oindex);
 	drgn_type_index_deinit(&prog->tindex);
 	drgn_memory_reader_deinit(&prog->reader);
 
+	if (prog->pid)
+		drgn_memory_process_segment_deinit(&prog->process_segment);
 	free(prog->file_segments);
+	drgn_program_free_core_mapped_files(prog);
+	free(prog->memory_trace_buf);
 
 #ifdef WITH_LIBKDUMPFILE
+	while (prog->num_kdump_clones)
+		kdump_free(prog->kdump_clones[--prog->num_kdump_clones]);
+	free(prog->kdump_clones);
+	if (prog->kdump_pagemap)
+		kdump_bmp_decref(prog->kdump_pagemap);
 	if (prog->kdump_ctx)
 		kdump_free(prog->kdump_ctx);
 #endif
+	if (prog->core_map)
+		munmap(prog->core_map, prog->core_map_size);
 	elf_end(prog->core);
+	drgn_compressed_file_destroy(prog->core_compressed);
+	free(prog->core_headers);
 	if (prog->core_fd != -1)
 		close(prog->core_fd);
+	drgn_remote_destroy(prog->remote);
 
 	drgn_dwarf_info_cache_destroy(prog->_dicache);
+	drgn_shared_debug_info_decref(prog->shared_debug_info);
+	drgn_btf_destroy(prog->btf);
+	drgn_pid_ns_set_deinit(&prog->pid_cache_namespaces);
+	drgn_pid_cache_deinit(&prog->pid_cache);
+	drgn_kernel_btf_map_deinit(&prog->kernel_btfs);
+	for (i = 0; i < prog->kernel_btf_list.size; i++)
+		drgn_btf_destroy(prog->kernel_btf_list.data[i]);
+	drgn_btf_vector_deinit(&prog->kernel_btf_list);
 }
 
 LIBDRGN_PUBLIC struct drgn_error *
@@ -135,25 +349,105 @@ drgn_program_add_memory_segment(struct drgn_program *prog, uint64_t address,
 				uint64_t size, drgn_memory_read_fn read_fn,
 				void *arg, bool physical)
 {
-	return drgn_memory_reader_add_segment(&prog->reader, address, size,
-					      read_fn, arg, physical);
+	return drgn_program_add_memory_segment_with_block_size(prog, address,
+							       size, read_fn,
+							       arg, physical,
+							       0);
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_add_memory_segment_with_block_size(struct drgn_program *prog,
+						uint64_t address, uint64_t size,
+						drgn_memory_read_fn read_fn,
+						void *arg, bool physical,
+						uint64_t block_size)
+{
+	struct drgn_error *err;
+
+	drgn_memory_reader_lock(&prog->reader);
+	/* Cached translations may have been read from the old segments. */
+	drgn_program_invalidate_translations(prog);
+	drgn_program_invalidate_dentry_paths(prog);
+	drgn_program_invalidate_pids(prog);
+	err = drgn_memory_reader_add_segment(&prog->reader, address, size,
+					     read_fn, arg, physical,
+					     block_size);
+	/* Blocks are only read through the cache. */
+	if (!err && block_size && !prog->reader.cache.capacity) {
+		drgn_program_set_memory_cache_size(prog,
+						   DRGN_DEFAULT_CORE_DUMP_MEMORY_CACHE_SIZE);
+	}
+	drgn_memory_reader_unlock(&prog->reader);
+	return err;
+}
+
+DEFINE_VECTOR(drgn_memory_segment_spec_vector, struct drgn_memory_segment_spec)
+
+/*
+ * Like drgn_program_add_memory_segment(), but for many segments at once. Core
+ * dumps can have thousands of segments, and invalidating everything for each
+ * one adds up.
+ */
+static struct drgn_error *
+drgn_program_add_memory_segments(struct drgn_program *prog,
+				 const struct drgn_memory_segment_spec *segments,
+				 size_t num_segments)
+{
+	struct drgn_error *err;
+
+	drgn_memory_reader_lock(&prog->reader);
+	drgn_program_invalidate_translations(prog);
+	drgn_program_invalidate_dentry_paths(prog);
+	drgn_program_invalidate_pids(prog);
+	err = drgn_memory_reader_add_segments(&prog->reader, segments,
+					      num_segments);
+	drgn_memory_reader_unlock(&prog->reader);
+	return err;
 }
 
 LIBDRGN_PUBLIC struct drgn_error *
 drgn_program_add_type_finder(struct drgn_program *prog, drgn_type_find_fn fn,
 			     void *arg)
 {
-	return drgn_type_index_add_finder(&prog->tindex, fn, arg);
+	return drgn_type_index_add_finder(&prog->tindex, fn, arg, false);
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_add_memoized_type_finder(struct drgn_program *prog,
+				      drgn_type_find_fn fn, void *arg)
+{
+	return drgn_type_index_add_finder(&prog->tindex, fn, arg, true);
+}
+
+static struct drgn_error *
+drgn_program_add_object_finder_impl(struct drgn_program *prog,
+				    drgn_object_find_fn fn, void *arg,
+				    bool memoize)
+{
+	struct drgn_error *err;
+
+	/* Object finders are called with the type index lock held. */
+	drgn_type_index_lock(&prog->tindex);
+	err = drgn_object_index_add_finder(&prog->oindex, fn, arg, memoize);
+	drgn_type_index_unlock(&prog->tindex);
+	return err;
 }
 
 LIBDRGN_PUBLIC struct drgn_error *
 drgn_program_add_object_finder(struct drgn_program *prog,
 			       drgn_object_find_fn fn, void *arg)
 {
-	return drgn_object_index_add_finder(&prog->oindex, fn, arg);
+	return drgn_program_add_object_finder_impl(prog, fn, arg, false);
 }
 
-static struct drgn_error *
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_add_memoized_object_finder(struct drgn_program *prog,
+					drgn_object_find_fn fn, void *arg)
+{
+	return drgn_program_add_object_finder_impl(prog, fn, arg, true);
+}
+
+struct drgn_error *
 drgn_program_check_initialized(struct drgn_program *prog)
 {
 	if (prog->core_fd != -1 || !drgn_memory_reader_empty(&prog->reader)) {
@@ -187,207 +481,849 @@ static struct drgn_error *has_kdump_signature(const char *path, int fd,
 	return NULL;
 }
 
-LIBDRGN_PUBLIC struct drgn_error *
-drgn_program_set_core_dump(struct drgn_program *prog, const char *path)
+/*
+ * Map the core file so that reading from it doesn't need a system call. This is
+ * only an optimization, so if the file can't be mapped, we fall back to
+ * pread().
+ */
+static void drgn_program_map_core_dump(struct drgn_program *prog)
+{
+	struct stat st;
+	void *map;
+
+	if (fstat(prog->core_fd, &st) == -1 || !S_ISREG(st.st_mode) ||
+	    st.st_size <= 0 || (uint64_t)st.st_size > SIZE_MAX)
+		return;
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, prog->core_fd, 0);
+	if (map == MAP_FAILED)
+		return;
+	prog->core_map = map;
+	prog->core_map_size = st.st_size;
+}
+
+static void drgn_program_unmap_core_dump(struct drgn_program *prog)
+{
+	if (prog->core_map) {
+		munmap(prog->core_map, prog->core_map_size);
+		prog->core_map = NULL;
+		prog->core_map_size = 0;
+	}
+}
+
+/*
+ * Get the size of the prefix of a core file that contains its ELF header,
+ * program headers, and notes, given an ELF handle for a prefix of @p size
+ * bytes. If the ELF header is invalid, this returns @p size; the caller reports
+ * the error.
+ */
+static uint64_t core_headers_size(Elf *elf, uint64_t size)
 {
-	struct drgn_error *err;
 	GElf_Ehdr ehdr_mem, *ehdr;
-	struct drgn_platform platform;
-	bool is_64_bit, is_kdump;
+	uint64_t needed, phentsize;
 	size_t phnum, i;
-	size_t num_file_segments, j;
-	bool have_phys_addrs = false;
-	const char *vmcoreinfo_note = NULL;
-	size_t vmcoreinfo_size = 0;
-	bool have_nt_taskstruct = false, is_proc_kcore;
-
-	err = drgn_program_check_initialized(prog);
-	if (err)
-		return err;
 
-	prog->core_fd = open(path, O_RDONLY);
-	if (prog->core_fd == -1)
-		return drgn_error_create_os("open", errno, path);
+	ehdr = gelf_getehdr(elf, &ehdr_mem);
+	if (!ehdr)
+		return size;
+	needed = ehdr->e_ehsize;
+	/*
+	 * If there are too many program headers, the real number is in the
+	 * first section header.
+	 */
+	if (ehdr->e_phnum == PN_XNUM && ehdr->e_shoff) {
+		needed = max(needed, ehdr->e_shoff + gelf_fsize(elf, ELF_T_SHDR,
+								1, EV_CURRENT));
+		if (needed > size)
+			return needed;
+	}
+	if (elf_getphdrnum(elf, &phnum) != 0)
+		return size;
+	phentsize = gelf_fsize(elf, ELF_T_PHDR, 1, EV_CURRENT);
+	needed = max(needed, ehdr->e_phoff + phnum * phentsize);
+	if (needed > size)
+		return needed;
+	for (i = 0; i < phnum; i++) {
+		GElf_Phdr phdr_mem, *phdr;
 
-	err = has_kdump_signature(path, prog->core_fd, &is_kdump);
-	if (err)
-		goto out_fd;
-	if (is_kdump) {
-		err = drgn_program_set_kdump(prog);
-		if (err)
-			goto out_fd;
-		return NULL;
+		phdr = gelf_getphdr(elf, i, &phdr_mem);
+		if (!phdr)
+			return size;
+		if (phdr->p_type == PT_NOTE)
+			needed = max(needed, phdr->p_offset + phdr->p_filesz);
 	}
+	return needed;
+}
 
-	elf_version(EV_CURRENT);
+/*
+ * Open a compressed core dump with libelf. libelf can only read the compressed
+ * file as an uncompressed image in memory, so this decompresses the smallest
+ * prefix that contains the ELF headers and notes. Segment contents are read
+ * through the compressed file instead.
+ */
+static struct drgn_error *
+drgn_program_open_compressed_core(struct drgn_program *prog)
+{
+	struct drgn_error *err;
+	struct drgn_compressed_file *file = prog->core_compressed;
+	uint64_t size = 0, needed = min(file->size, (uint64_t)(64 * 1024));
 
-	prog->core = elf_begin(prog->core_fd, ELF_C_READ, NULL);
-	if (!prog->core) {
-		err = drgn_error_libelf();
-		goto out_fd;
-	}
+	while (needed > size) {
+		char *buf;
 
-	ehdr = gelf_getehdr(prog->core, &ehdr_mem);
-	if (!ehdr || ehdr->e_type != ET_CORE) {
-		err = drgn_error_format(DRGN_ERROR_INVALID_ARGUMENT,
-					"not an ELF core file");
-		goto out_elf;
+		if (needed > SIZE_MAX)
+			return &drgn_enomem;
+		elf_end(prog->core);
+		prog->core = NULL;
+		buf = realloc(prog->core_headers, needed);
+		if (!buf)
+			return &drgn_enomem;
+		prog->core_headers = buf;
+		err = drgn_compressed_file_read(file, buf + size, size,
+						needed - size);
+		if (err)
+			return err;
+		size = needed;
+		prog->core = elf_memory(prog->core_headers, size);
+		if (!prog->core)
+			return drgn_error_libelf();
+		/* Headers past the end of the file are caught later. */
+		needed = min(core_headers_size(prog->core, size), file->size);
 	}
+	return NULL;
+}
 
-	drgn_platform_from_elf(ehdr, &platform);
-	is_64_bit = ehdr->e_ident[EI_CLASS] == ELFCLASS64;
+DEFINE_VECTOR(phdr_vector, GElf_Phdr)
+DEFINE_VECTOR(drgn_core_mapped_file_segment_vector,
+	      struct drgn_core_mapped_file_segment)
+
+/*
+ * Find the GNU build ID note in the program headers of an ELF file which start
+ * in the given buffer.
+ */
+static bool elf_headers_build_id(const char *buf, size_t size,
+				 const char **build_id_ret,
+				 size_t *build_id_len_ret)
+{
+	const char *end = buf + size, *p;
+	bool is_64_bit, bswap;
+	uint64_t phoff;
+	uint16_t phentsize, phnum, i;
 
-	if (elf_getphdrnum(prog->core, &phnum) != 0) {
-		err = drgn_error_libelf();
-		goto out_elf;
+	if (size < EI_NIDENT || memcmp(buf, ELFMAG, SELFMAG) != 0)
+		return false;
+	is_64_bit = buf[EI_CLASS] == ELFCLASS64;
+	bswap = ((buf[EI_DATA] == ELFDATA2LSB) !=
+		 (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__));
+	if (is_64_bit) {
+		p = buf + offsetof(Elf64_Ehdr, e_phoff);
+		if (!read_u64(&p, end, bswap, &phoff))
+			return false;
+		p = buf + offsetof(Elf64_Ehdr, e_phentsize);
+	} else {
+		p = buf + offsetof(Elf32_Ehdr, e_phoff);
+		if (!read_u32_into_u64(&p, end, bswap, &phoff))
+			return false;
+		p = buf + offsetof(Elf32_Ehdr, e_phentsize);
 	}
+	if (!read_u16(&p, end, bswap, &phentsize) ||
+	    !read_u16(&p, end, bswap, &phnum))
+		return false;
 
-	/*
-	 * First pass: count the number of loadable segments, check if p_paddr
-	 * is valid, and check for notes.
-	 */
-	num_file_segments = 0;
 	for (i = 0; i < phnum; i++) {
-		GElf_Phdr phdr_mem, *phdr;
+		const char *phdr, *note, *note_end;
+		uint32_t type;
+		uint64_t offset, filesz, align;
 
-		phdr = gelf_getphdr(prog->core, i, &phdr_mem);
-		if (!phdr) {
-			err = drgn_error_libelf();
-			goto out_elf;
+		if (phoff > size || i * (uint64_t)phentsize > size - phoff)
+			return false;
+		phdr = p = buf + phoff + i * (uint64_t)phentsize;
+		if (!read_u32(&p, end, bswap, &type))
+			return false;
+		if (type != PT_NOTE)
+			continue;
+		if (is_64_bit) {
+			p = phdr + offsetof(Elf64_Phdr, p_offset);
+			if (!read_u64(&p, end, bswap, &offset))
+				return false;
+			p = phdr + offsetof(Elf64_Phdr, p_filesz);
+			if (!read_u64(&p, end, bswap, &filesz))
+				return false;
+			p = phdr + offsetof(Elf64_Phdr, p_align);
+			if (!read_u64(&p, end, bswap, &align))
+				return false;
+		} else {
+			p = phdr + offsetof(Elf32_Phdr, p_offset);
+			if (!read_u32_into_u64(&p, end, bswap, &offset))
+				return false;
+			p = phdr + offsetof(Elf32_Phdr, p_filesz);
+			if (!read_u32_into_u64(&p, end, bswap, &filesz))
+				return false;
+			p = phdr + offsetof(Elf32_Phdr, p_align);
+			if (!read_u32_into_u64(&p, end, bswap, &align))
+				return false;
 		}
-
-		if (phdr->p_type == PT_LOAD) {
-			if (phdr->p_paddr)
-				have_phys_addrs = true;
-			num_file_segments++;
-		} else if (phdr->p_type == PT_NOTE) {
-			Elf_Data *data;
-			size_t offset;
-			GElf_Nhdr nhdr;
-			size_t name_offset, desc_offset;
-
-			data = elf_getdata_rawchunk(prog->core, phdr->p_offset,
-						    phdr->p_filesz,
-						    note_header_type(phdr));
-			if (!data) {
-				err = drgn_error_libelf();
-				goto out_elf;
+		/* The notes may not be in the buffer. */
+		if (offset > size || filesz > size - offset)
+			continue;
+		align = align == 8 ? 8 : 4;
+		note = buf + offset;
+		note_end = note + filesz;
+		while (note < note_end) {
+			uint32_t namesz, descsz, note_type;
+			const char *name, *desc;
+
+			p = note;
+			if (!read_u32(&p, note_end, bswap, &namesz) ||
+			    !read_u32(&p, note_end, bswap, &descsz) ||
+			    !read_u32(&p, note_end, bswap, &note_type))
+				break;
+			name = p;
+			if (namesz > (size_t)(note_end - name))
+				break;
+			desc = name + ((namesz + align - 1) & ~(align - 1));
+			if (desc > note_end ||
+			    descsz > (size_t)(note_end - desc))
+				break;
+			if (note_type == NT_GNU_BUILD_ID && namesz == 4 &&
+			    memcmp(name, "GNU", 4) == 0 && descsz) {
+				*build_id_ret = desc;
+				*build_id_len_ret = descsz;
+				return true;
 			}
+			note = desc + ((descsz + align - 1) & ~(align - 1));
+		}
+	}
+	return false;
+}
 
-			offset = 0;
-			while (offset < data->d_size &&
-			       (offset = gelf_getnote(data, offset, &nhdr,
-						      &name_offset,
-						      &desc_offset))) {
-				const char *name, *desc;
+/*
+ * Open and map a file from the NT_FILE note. If it can't be opened or has the
+ * wrong build ID, reads from it fault.
+ */
+static void drgn_core_mapped_file_open(struct drgn_core_mapped_file *file)
+{
+	struct stat st;
+	int fd;
+	void *map;
+	const char *build_id;
+	size_t build_id_len;
+
+	file->opened = true;
+	fd = open(file->path, O_RDONLY);
+	if (fd == -1)
+		return;
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+	    (uint64_t)st.st_size > SIZE_MAX) {
+		close(fd);
+		return;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return;
+	/* Don't read from a different version of the file. */
+	if (file->build_id_len &&
+	    (!elf_headers_build_id(map, st.st_size, &build_id,
+				   &build_id_len) ||
+	     build_id_len != file->build_id_len ||
+	     memcmp(build_id, file->build_id, build_id_len) != 0)) {
+		munmap(map, st.st_size);
+		return;
+	}
+	file->map = map;
+	file->size = st.st_size;
+}
 
-				name = (char *)data->d_buf + name_offset;
-				desc = (char *)data->d_buf + desc_offset;
-				if (strncmp(name, "CORE", nhdr.n_namesz) == 0) {
-					if (nhdr.n_type == NT_TASKSTRUCT)
-						have_nt_taskstruct = true;
-				} else if (strncmp(name, "VMCOREINFO",
-						   nhdr.n_namesz) == 0) {
-					vmcoreinfo_note = desc;
-					vmcoreinfo_size = nhdr.n_descsz;
-					/*
-					 * This is either a vmcore or
-					 * /proc/kcore, so even a p_paddr of 0
-					 * may be valid.
-					 */
-					have_phys_addrs = true;
-				}
-			}
-		}
+static struct drgn_error *read_memory_core_mapped_file(void *buf,
+							uint64_t address,
+							size_t count,
+							uint64_t offset,
+							void *arg,
+							bool physical)
+{
+	struct drgn_core_mapped_file_segment *segment = arg;
+	struct drgn_core_mapped_file *file = segment->file;
+	uint64_t file_offset = segment->file_offset + offset;
+	size_t file_count;
+
+	if (!file->opened)
+		drgn_core_mapped_file_open(file);
+	if (!file->map) {
+		return drgn_error_format_fault(address,
+					       "memory is not in core dump and could not be read from %s",
+					       file->path);
 	}
+	/* Like the kernel, treat the rest of the last page as zeroes. */
+	if (file_offset < file->size)
+		file_count = min((uint64_t)count, file->size - file_offset);
+	else
+		file_count = 0;
+	memcpy(buf, file->map + file_offset, file_count);
+	memset((char *)buf + file_count, 0, count - file_count);
+	return NULL;
+}
 
-	if (have_nt_taskstruct) {
-		/*
-		 * If the core file has an NT_TASKSTRUCT note and is in /proc,
-		 * then it's probably /proc/kcore.
-		 */
-		struct statfs fs;
+/* Entry of the NT_FILE note. */
+struct nt_file_entry {
+	uint64_t start, end, file_offset;
+};
 
-		if (fstatfs(prog->core_fd, &fs) == -1) {
-			err = drgn_error_create_os("fstatfs", errno, path);
-			if (err)
-				goto out_elf;
+/*
+ * Parse the NT_FILE note of a userspace core dump. Consecutive entries for the
+ * same path (i.e., the mappings of one file) share a struct
+ * drgn_core_mapped_file.
+ */
+static struct drgn_error *
+parse_nt_file(struct drgn_program *prog, const char *note, size_t size,
+	      bool is_64_bit, bool bswap, struct nt_file_entry **entries_ret,
+	      size_t **files_ret, size_t *count_ret)
+{
+	const char *p = note, *end = note + size, *names;
+	uint64_t count, page_size, i;
+	struct nt_file_entry *entries;
+	size_t *files, word_size = is_64_bit ? 8 : 4;
+
+#define READ_WORD(ret) (is_64_bit ? read_u64(&p, end, bswap, ret) :	\
+			read_u32_into_u64(&p, end, bswap, ret))
+	if (!READ_WORD(&count) || !READ_WORD(&page_size) ||
+	    count > (uint64_t)(end - p) / (3 * word_size))
+		goto invalid;
+	entries = malloc_array(count ? count : 1, sizeof(*entries));
+	files = malloc_array(count ? count : 1, sizeof(*files));
+	prog->core_mapped_files = calloc(count ? count : 1,
+					 sizeof(*prog->core_mapped_files));
+	if (!entries || !files || !prog->core_mapped_files) {
+		free(files);
+		free(entries);
+		return &drgn_enomem;
+	}
+	for (i = 0; i < count; i++) {
+		READ_WORD(&entries[i].start);
+		READ_WORD(&entries[i].end);
+		READ_WORD(&entries[i].file_offset);
+		if (__builtin_mul_overflow(entries[i].file_offset, page_size,
+					   &entries[i].file_offset))
+			goto invalid_entries;
+	}
+#undef READ_WORD
+	names = p;
+	for (i = 0; i < count; i++) {
+		const char *name = names;
+		size_t n = prog->num_core_mapped_files;
+
+		if (!skip_string(&names, end))
+			goto invalid_entries;
+		if (n && strcmp(prog->core_mapped_files[n - 1].path,
+				name) == 0) {
+			files[i] = n - 1;
+			continue;
 		}
-		is_proc_kcore = fs.f_type == 0x9fa0; /* PROC_SUPER_MAGIC */
-	} else {
-		is_proc_kcore = false;
+		prog->core_mapped_files[n].path = name;
+		files[i] = prog->num_core_mapped_files++;
 	}
+	*entries_ret = entries;
+	*files_ret = files;
+	*count_ret = count;
+	return NULL;
 
-	if (vmcoreinfo_note && !is_proc_kcore) {
-		char *env;
+invalid_entries:
+	free(files);
+	free(entries);
+invalid:
+	return drgn_error_create(DRGN_ERROR_OTHER, "invalid NT_FILE note");
+}
 
-		/* Use libkdumpfile for ELF vmcores if it was requested. */
-		env = getenv("DRGN_USE_LIBKDUMPFILE_FOR_ELF");
+/*
+ * Read the build ID of a mapped file from its ELF headers in the core dump, if
+ * the core dump has them. This must be done before the segments read from the
+ * file are added.
+ */
+static struct drgn_error *
+core_mapped_file_read_build_id(struct drgn_program *prog,
+			       struct drgn_core_mapped_file *file,
+			       uint64_t address, uint64_t size)
+{
+	struct drgn_error *err;
+	char buf[4096];
+	const char *build_id;
+	size_t build_id_len;
+
+	err = drgn_memory_reader_read(&prog->reader, buf, address,
+				      min(size, (uint64_t)sizeof(buf)), false);
+	if (err) {
+		if (err->code != DRGN_ERROR_FAULT)
+			return err;
+		drgn_error_destroy(err);
+		return NULL;
+	}
+	if (!elf_headers_build_id(buf, min(size, (uint64_t)sizeof(buf)),
+				  &build_id, &build_id_len))
+		return NULL;
+	file->build_id = malloc(build_id_len);
+	if (!file->build_id)
+		return &drgn_enomem;
+	memcpy(file->build_id, build_id, build_id_len);
+	file->build_id_len = build_id_len;
+	return NULL;
+}
+
+/*
+ * Add segments which read the parts of the loadable segments of a userspace
+ * core dump that were omitted from the file from the files listed in the
+ * NT_FILE note, as long as the files still have the build IDs found in the
+ * core dump.
+ */
+static struct drgn_error *
+drgn_program_add_core_mapped_files(struct drgn_program *prog, const char *note,
+				   size_t size, const struct phdr_vector *phdrs,
+				   bool is_64_bit, bool bswap)
+{
+	struct drgn_error *err;
+	struct nt_file_entry *entries;
+	size_t *files, count, i, j;
+	struct drgn_core_mapped_file_segment_vector segments = VECTOR_INIT;
+	struct drgn_memory_segment_spec_vector specs = VECTOR_INIT;
+
+	err = parse_nt_file(prog, note, size, is_64_bit, bswap, &entries,
+			    &files, &count);
+	if (err)
+		return err;
+
+	for (i = 0; i < count; i++) {
+		struct drgn_core_mapped_file *file =
+			&prog->core_mapped_files[files[i]];
+
+		if (entries[i].file_offset == 0 && !file->build_id_len &&
+		    entries[i].end > entries[i].start) {
+			err = core_mapped_file_read_build_id(prog, file,
+							     entries[i].start,
+							     entries[i].end -
+							     entries[i].start);
+			if (err)
+				goto out;
+		}
+	}
+
+	/*
+	 * Both the loadable segments and the NT_FILE entries are sorted by
+	 * address, so match the omitted parts with the files in one pass.
+	 */
+	i = j = 0;
+	while (i < phdrs->size && j < count) {
+		const GElf_Phdr *phdr = &phdrs->data[i];
+		uint64_t start = phdr->p_vaddr + phdr->p_filesz;
+		uint64_t end = phdr->p_vaddr + phdr->p_memsz;
+		struct drgn_core_mapped_file_segment *segment;
+		struct drgn_memory_segment_spec *spec;
+
+		if (start >= end || end <= entries[j].start) {
+			i++;
+			continue;
+		}
+		if (entries[j].end <= start) {
+			j++;
+			continue;
+		}
+		segment = drgn_core_mapped_file_segment_vector_append_entry(&segments);
+		spec = drgn_memory_segment_spec_vector_append_entry(&specs);
+		if (!segment || !spec) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		start = max(start, entries[j].start);
+		segment->file = &prog->core_mapped_files[files[j]];
+		segment->file_offset = (entries[j].file_offset + start -
+					entries[j].start);
+		/* The argument is set once the segments stop moving. */
+		spec->address = start;
+		spec->size = min(end, entries[j].end) - start;
+		spec->read_fn = read_memory_core_mapped_file;
+		spec->physical = false;
+		if (entries[j].end < end)
+			j++;
+		else
+			i++;
+	}
+	drgn_core_mapped_file_segment_vector_shrink_to_fit(&segments);
+	for (i = 0; i < specs.size; i++)
+		specs.data[i].arg = &segments.data[i];
+	prog->core_mapped_file_segments = segments.data;
+	segments.data = NULL;
+	err = drgn_program_add_memory_segments(prog, specs.data, specs.size);
+out:
+	drgn_memory_segment_spec_vector_deinit(&specs);
+	drgn_core_mapped_file_segment_vector_deinit(&segments);
+	free(files);
+	free(entries);
+	return err;
+}
+
+/*
+ * Find the intersection of [start, last] with the first RAM range (sorted and
+ * disjoint) which overlaps it.
+ */
+static bool next_ram_piece(const struct drgn_memory_range *ranges,
+			   size_t num_ranges, uint64_t start, uint64_t last,
+			   uint64_t *start_ret, uint64_t *last_ret)
+{
+	size_t lo = 0, hi = num_ranges;
+
+	/* Find the first range which doesn't end before start. */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (ranges[mid].last < start)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == num_ranges || ranges[lo].start > last)
+		return false;
+	*start_ret = max(start, ranges[lo].start);
+	*last_ret = min(last, ranges[lo].last);
+	return true;
+}
+
+/*
+ * Replace the loadable segments of /proc/kcore which have a physical address
+ * with the pieces of them which are backed by RAM. Reading a hole in
+ * /proc/kcore costs a system call, only to zero-fill or fail with EIO. Without
+ * segments for the holes, faults are raised without a system call, and
+ * scanners which use the segments (e.g., the memory search) skip them.
+ */
+static struct drgn_error *kcore_trim_phdrs(struct phdr_vector *phdrs,
+					   bool is_64_bit)
+{
+	struct drgn_error *err;
+	struct drgn_memory_range *ranges;
+	size_t num_ranges, i;
+	struct phdr_vector trimmed = VECTOR_INIT;
+
+	err = linux_kernel_live_ram_ranges(&ranges, &num_ranges);
+	if (err)
+		return err;
+	if (!num_ranges)
+		goto out;
+	for (i = 0; i < phdrs->size; i++) {
+		const GElf_Phdr *phdr = &phdrs->data[i];
+		uint64_t start, last, piece_start, piece_last;
+
+		start = phdr->p_paddr;
+		last = start + phdr->p_memsz - 1;
+		if (phdr->p_paddr == (is_64_bit ? UINT64_MAX : UINT32_MAX) ||
+		    !phdr->p_memsz || last < start) {
+			if (!phdr_vector_append(&trimmed, phdr))
+				goto enomem;
+			continue;
+		}
+		while (next_ram_piece(ranges, num_ranges, start, last,
+				      &piece_start, &piece_last)) {
+			uint64_t delta = piece_start - phdr->p_paddr;
+			GElf_Phdr *piece;
+
+			piece = phdr_vector_append_entry(&trimmed);
+			if (!piece)
+				goto enomem;
+			*piece = *phdr;
+			piece->p_offset += delta;
+			piece->p_vaddr += delta;
+			piece->p_paddr = piece_start;
+			piece->p_memsz = piece_last - piece_start + 1;
+			if (phdr->p_filesz > delta) {
+				piece->p_filesz = min(phdr->p_filesz - delta,
+						      piece->p_memsz);
+			} else {
+				piece->p_filesz = 0;
+			}
+			if (piece_last == last)
+				break;
+			start = piece_last + 1;
+		}
+	}
+	phdr_vector_deinit(phdrs);
+	*phdrs = trimmed;
+out:
+	free(ranges);
+	return NULL;
+
+enomem:
+	phdr_vector_deinit(&trimmed);
+	free(ranges);
+	return &drgn_enomem;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_set_core_dump(struct drgn_program *prog, const char *path)
+{
+	struct drgn_error *err;
+	GElf_Ehdr ehdr_mem, *ehdr;
+	struct drgn_platform platform;
+	bool is_64_bit, is_kdump;
+	size_t phnum, i, j;
+	struct phdr_vector phdrs = VECTOR_INIT;
+	bool have_phys_addrs = false;
+	const char *vmcoreinfo_note = NULL;
+	size_t vmcoreinfo_size = 0;
+	bool have_nt_taskstruct = false, is_proc_kcore;
+	const char *nt_file_note = NULL;
+	size_t nt_file_size = 0;
+	struct drgn_memory_segment_spec_vector segments = VECTOR_INIT;
+	struct drgn_memory_segment_spec *segment;
+	enum drgn_compression_format compression;
+
+	err = drgn_program_check_initialized(prog);
+	if (err)
+		return err;
+
+	prog->core_fd = open(path, O_RDONLY);
+	if (prog->core_fd == -1)
+		return drgn_error_create_os("open", errno, path);
+
+	err = drgn_compression_format_detect(prog->core_fd, path, &compression);
+	if (err)
+		goto out_fd;
+	if (compression != DRGN_COMPRESSION_NONE) {
+		is_kdump = false;
+	} else {
+		err = has_kdump_signature(path, prog->core_fd, &is_kdump);
+		if (err)
+			goto out_fd;
+	}
+	if (is_kdump) {
+		err = drgn_program_set_kdump(prog);
+		if (err)
+			goto out_fd;
+		drgn_program_set_memory_cache_size(prog,
+						   DRGN_DEFAULT_CORE_DUMP_MEMORY_CACHE_SIZE);
+		return NULL;
+	}
+
+	elf_version(EV_CURRENT);
+
+	if (compression != DRGN_COMPRESSION_NONE) {
+		err = drgn_compressed_file_create(prog->core_fd, path,
+						  compression,
+						  &prog->reader.stats,
+						  &prog->core_compressed);
+		if (err)
+			goto out_fd;
+		err = drgn_program_open_compressed_core(prog);
+		if (err)
+			goto out_elf;
+	} else {
+		prog->core = elf_begin(prog->core_fd, ELF_C_READ, NULL);
+		if (!prog->core) {
+			err = drgn_error_libelf();
+			goto out_fd;
+		}
+	}
+
+	ehdr = gelf_getehdr(prog->core, &ehdr_mem);
+	if (!ehdr || ehdr->e_type != ET_CORE) {
+		err = drgn_error_format(DRGN_ERROR_INVALID_ARGUMENT,
+					"not an ELF core file");
+		goto out_elf;
+	}
+
+	drgn_platform_from_elf(ehdr, &platform);
+	is_64_bit = ehdr->e_ident[EI_CLASS] == ELFCLASS64;
+
+	if (elf_getphdrnum(prog->core, &phnum) != 0) {
+		err = drgn_error_libelf();
+		goto out_elf;
+	}
+
+	/*
+	 * First pass: collect the loadable segments, check if p_paddr is valid,
+	 * and check for notes.
+	 */
+	for (i = 0; i < phnum; i++) {
+		GElf_Phdr phdr_mem, *phdr;
+
+		phdr = gelf_getphdr(prog->core, i, &phdr_mem);
+		if (!phdr) {
+			err = drgn_error_libelf();
+			goto out_elf;
+		}
+
+		if (phdr->p_type == PT_LOAD) {
+			if (phdr->p_paddr)
+				have_phys_addrs = true;
+			if (!phdr_vector_append(&phdrs, phdr)) {
+				err = &drgn_enomem;
+				goto out_elf;
+			}
+		} else if (phdr->p_type == PT_NOTE) {
+			Elf_Data *data;
+			size_t offset;
+			GElf_Nhdr nhdr;
+			size_t name_offset, desc_offset;
+
+			data = elf_getdata_rawchunk(prog->core, phdr->p_offset,
+						    phdr->p_filesz,
+						    note_header_type(phdr));
+			if (!data) {
+				err = drgn_error_libelf();
+				goto out_elf;
+			}
+
+			offset = 0;
+			while (offset < data->d_size &&
+			       (offset = gelf_getnote(data, offset, &nhdr,
+						      &name_offset,
+						      &desc_offset))) {
+				const char *name, *desc;
+
+				name = (char *)data->d_buf + name_offset;
+				desc = (char *)data->d_buf + desc_offset;
+				if (strncmp(name, "CORE", nhdr.n_namesz) == 0) {
+					if (nhdr.n_type == NT_TASKSTRUCT) {
+						have_nt_taskstruct = true;
+					} else if (nhdr.n_type == NT_FILE) {
+						nt_file_note = desc;
+						nt_file_size = nhdr.n_descsz;
+					}
+				} else if (strncmp(name, "VMCOREINFO",
+						   nhdr.n_namesz) == 0) {
+					vmcoreinfo_note = desc;
+					vmcoreinfo_size = nhdr.n_descsz;
+					/*
+					 * This is either a vmcore or
+					 * /proc/kcore, so even a p_paddr of 0
+					 * may be valid.
+					 */
+					have_phys_addrs = true;
+				}
+			}
+		}
+	}
+
+	if (have_nt_taskstruct) {
+		/*
+		 * If the core file has an NT_TASKSTRUCT note and is in /proc,
+		 * then it's probably /proc/kcore.
+		 */
+		struct statfs fs;
+
+		if (fstatfs(prog->core_fd, &fs) == -1) {
+			err = drgn_error_create_os("fstatfs", errno, path);
+			if (err)
+				goto out_elf;
+		}
+		is_proc_kcore = fs.f_type == 0x9fa0; /* PROC_SUPER_MAGIC */
+	} else {
+		is_proc_kcore = false;
+	}
+
+	if (vmcoreinfo_note && !is_proc_kcore && !prog->core_compressed) {
+		char *env;
+
+		/* Use libkdumpfile for ELF vmcores if it was requested. */
+		env = getenv("DRGN_USE_LIBKDUMPFILE_FOR_ELF");
 		if (env && atoi(env)) {
 			err = drgn_program_set_kdump(prog);
 			if (err)
 				goto out_elf;
+			drgn_program_set_memory_cache_size(prog,
+							   DRGN_DEFAULT_CORE_DUMP_MEMORY_CACHE_SIZE);
+			phdr_vector_deinit(&phdrs);
 			return NULL;
 		}
 	}
 
-	prog->file_segments = malloc_array(num_file_segments,
+	if (is_proc_kcore && have_phys_addrs) {
+		err = kcore_trim_phdrs(&phdrs, is_64_bit);
+		if (err)
+			goto out_elf;
+	}
+
+	prog->file_segments = malloc_array(phdrs.size,
 					   sizeof(*prog->file_segments));
 	if (!prog->file_segments) {
 		err = &drgn_enomem;
 		goto out_elf;
 	}
 
+	/*
+	 * /proc/kcore can't be mapped, and its contents change anyways, so
+	 * only map other core dumps. Mapping a compressed core dump is
+	 * useless.
+	 */
+	if (!is_proc_kcore && !prog->core_compressed)
+		drgn_program_map_core_dump(prog);
+
+	/*
+	 * Second pass: add the segments. They are collected and then added all
+	 * at once.
+	 */
+	if (!drgn_memory_segment_spec_vector_reserve(&segments,
+						     2 * phdrs.size + 1)) {
+		err = &drgn_enomem;
+		goto out_segments;
+	}
 	if (is_proc_kcore || vmcoreinfo_note) {
 		/*
 		 * Try to read any memory that isn't in the core dump via the
 		 * page table.
 		 */
-		err = drgn_program_add_memory_segment(prog, 0,
-						      is_64_bit ?
-						      UINT64_MAX : UINT32_MAX,
-						      read_memory_via_pgtable,
-						      prog, false);
-		if (err)
-			goto out_segments;
+		segment = drgn_memory_segment_spec_vector_append_entry(&segments);
+		segment->address = 0;
+		segment->size = is_64_bit ? UINT64_MAX : UINT32_MAX;
+		segment->read_fn = read_memory_via_pgtable;
+		segment->arg = prog;
+		segment->physical = false;
 	}
-
-	/* Second pass: add the segments. */
-	for (i = 0, j = 0; i < phnum && j < num_file_segments; i++) {
-		GElf_Phdr phdr_mem, *phdr;
-
-		phdr = gelf_getphdr(prog->core, i, &phdr_mem);
-		if (!phdr) {
-			err = drgn_error_libelf();
-			goto out_segments;
-		}
-
-		if (phdr->p_type != PT_LOAD)
-			continue;
+	for (j = 0; j < phdrs.size; j++) {
+		const GElf_Phdr *phdr = &phdrs.data[j];
 
 		prog->file_segments[j].file_offset = phdr->p_offset;
 		prog->file_segments[j].file_size = phdr->p_filesz;
+		if (prog->core_map && phdr->p_offset <= prog->core_map_size &&
+		    phdr->p_filesz <= prog->core_map_size - phdr->p_offset) {
+			prog->file_segments[j].map =
+				(char *)prog->core_map + phdr->p_offset;
+		} else {
+			prog->file_segments[j].map = NULL;
+		}
+		prog->file_segments[j].compressed = prog->core_compressed;
 		prog->file_segments[j].fd = prog->core_fd;
+		prog->file_segments[j].stats = &prog->reader.stats;
 		prog->file_segments[j].eio_is_fault = false;
-		err = drgn_program_add_memory_segment(prog, phdr->p_vaddr,
-						      phdr->p_memsz,
-						      drgn_read_memory_file,
-						      &prog->file_segments[j],
-						      false);
-		if (err)
-			goto out_segments;
+		segment = drgn_memory_segment_spec_vector_append_entry(&segments);
+		segment->address = phdr->p_vaddr;
+		segment->size = phdr->p_memsz;
+		segment->read_fn = drgn_read_memory_file;
+		segment->arg = &prog->file_segments[j];
+		segment->physical = false;
 		if (have_phys_addrs &&
 		    phdr->p_paddr != (is_64_bit ? UINT64_MAX : UINT32_MAX)) {
-			err = drgn_program_add_memory_segment(prog,
-							      phdr->p_paddr,
-							      phdr->p_memsz,
-							      drgn_read_memory_file,
-							      &prog->file_segments[j],
-							      true);
-			if (err)
-				goto out_segments;
+			segment = drgn_memory_segment_spec_vector_append_entry(&segments);
+			segment->address = phdr->p_paddr;
+			segment->size = phdr->p_memsz;
+			segment->read_fn = drgn_read_memory_file;
+			segment->arg = &prog->file_segments[j];
+			segment->physical = true;
 		}
-		j++;
+	}
+	err = drgn_program_add_memory_segments(prog, segments.data,
+					       segments.size);
+	if (err)
+		goto out_segments;
+	/*
+	 * Read file-backed mappings that were left out of a userspace core dump
+	 * from the original files.
+	 */
+	if (nt_file_note && !is_proc_kcore && !vmcoreinfo_note) {
+		bool little_endian =
+			platform.flags & DRGN_PLATFORM_IS_LITTLE_ENDIAN;
+		bool bswap = (little_endian !=
+			      (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__));
+
+		err = drgn_program_add_core_mapped_files(prog, nt_file_note,
+							 nt_file_size, &phdrs,
+							 is_64_bit, bswap);
+		if (err)
+			goto out_segments;
 	}
 	/*
 	 * Before Linux kernel commit 464920104bf7 ("/proc/kcore: update
@@ -406,17 +1342,8 @@ drgn_program_set_core_dump(struct drgn_program *prog, const char *path)
 		if (err)
 			goto out_segments;
 
-		for (i = 0, j = 0; i < phnum && j < num_file_segments; i++) {
-			GElf_Phdr phdr_mem, *phdr;
-
-			phdr = gelf_getphdr(prog->core, i, &phdr_mem);
-			if (!phdr) {
-				err = drgn_error_libelf();
-				goto out_segments;
-			}
-
-			if (phdr->p_type != PT_LOAD)
-				continue;
+		for (j = 0; j < phdrs.size; j++) {
+			const GElf_Phdr *phdr = &phdrs.data[j];
 
 			if (phdr->p_vaddr >= direct_mapping &&
 			    phdr->p_vaddr - direct_mapping + phdr->p_memsz <=
@@ -433,7 +1360,6 @@ drgn_program_set_core_dump(struct drgn_program *prog, const char *path)
 				if (err)
 					goto out_segments;
 			}
-			j++;
 		}
 	}
 	if (vmcoreinfo_note) {
@@ -457,28 +1383,42 @@ drgn_program_set_core_dump(struct drgn_program *prog, const char *path)
 	} else if (vmcoreinfo_note) {
 		prog->flags |= DRGN_PROGRAM_IS_LINUX_KERNEL;
 	}
+	if (!(prog->flags & DRGN_PROGRAM_IS_LIVE)) {
+		drgn_program_set_memory_cache_size(prog,
+						   DRGN_DEFAULT_CORE_DUMP_MEMORY_CACHE_SIZE);
+	}
 	if (prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL) {
-		err = drgn_program_add_object_finder(prog,
-						     linux_kernel_object_find,
-						     prog);
+		err = drgn_program_add_memoized_object_finder(prog,
+							      linux_kernel_object_find,
+							      prog);
 		if (err)
 			goto out_segments;
 		if (!prog->lang)
 			prog->lang = &drgn_language_c;
 	}
 
+	drgn_memory_segment_spec_vector_deinit(&segments);
+	phdr_vector_deinit(&phdrs);
 	drgn_program_set_platform(prog, &platform);
 	return NULL;
 
 out_segments:
+	drgn_memory_segment_spec_vector_deinit(&segments);
 	drgn_memory_reader_deinit(&prog->reader);
 	drgn_memory_reader_init(&prog->reader);
 	free(prog->file_segments);
 	prog->file_segments = NULL;
+	drgn_program_free_core_mapped_files(prog);
+	drgn_program_unmap_core_dump(prog);
 out_elf:
+	phdr_vector_deinit(&phdrs);
 	elf_end(prog->core);
 	prog->core = NULL;
 out_fd:
+	drgn_compressed_file_destroy(prog->core_compressed);
+	prog->core_compressed = NULL;
+	free(prog->core_headers);
+	prog->core_headers = NULL;
 	close(prog->core_fd);
 	prog->core_fd = -1;
 	return err;
@@ -495,6 +1435,7 @@ drgn_program_set_pid(struct drgn_program *prog, pid_t pid)
 {
 	struct drgn_error *err;
 	char buf[64];
+	char *env;
 
 	err = drgn_program_check_initialized(prog);
 	if (err)
@@ -512,11 +1453,25 @@ drgn_program_set_pid(struct drgn_program *prog, pid_t pid)
 	}
 	prog->file_segments[0].file_offset = 0;
 	prog->file_segments[0].file_size = UINT64_MAX;
+	prog->file_segments[0].map = NULL;
+	prog->file_segments[0].compressed = NULL;
 	prog->file_segments[0].fd = prog->core_fd;
+	prog->file_segments[0].stats = &prog->reader.stats;
 	prog->file_segments[0].eio_is_fault = true;
+	/*
+	 * Read with process_vm_readv() by default, since it's cheaper than
+	 * pread() on /proc/$pid/mem. /proc/$pid/mem is still used as a fallback
+	 * if process_vm_readv() isn't permitted, or if it was requested. Either
+	 * way, unmapped addresses are found from /proc/$pid/maps.
+	 */
+	drgn_memory_process_segment_init(&prog->process_segment, pid,
+					 &prog->reader.stats,
+					 prog->file_segments);
+	env = getenv("DRGN_USE_PROC_PID_MEM");
+	prog->process_segment.use_fallback = env && atoi(env);
 	err = drgn_program_add_memory_segment(prog, 0, UINT64_MAX,
-					      drgn_read_memory_file,
-					      prog->file_segments, false);
+					      drgn_read_memory_process,
+					      &prog->process_segment, false);
 	if (err)
 		goto out_segments;
 
@@ -528,6 +1483,7 @@ drgn_program_set_pid(struct drgn_program *prog, pid_t pid)
 out_segments:
 	drgn_memory_reader_deinit(&prog->reader);
 	drgn_memory_reader_init(&prog->reader);
+	drgn_memory_process_segment_deinit(&prog->process_segment);
 	free(prog->file_segments);
 	prog->file_segments = NULL;
 out_fd:
@@ -536,11 +1492,48 @@ out_fd:
 	return err;
 }
 
-static struct drgn_error *drgn_program_get_dindex(struct drgn_program *prog,
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_set_remote(struct drgn_program *prog, const char *address)
+{
+	struct drgn_error *err;
+
+	err = drgn_program_check_initialized(prog);
+	if (err)
+		return err;
+
+	err = drgn_remote_connect(address, &prog->reader.stats, &prog->remote);
+	if (err)
+		return err;
+	err = drgn_program_add_memory_segment(prog, 0, UINT64_MAX,
+					      drgn_read_memory_remote,
+					      prog->remote, false);
+	if (err)
+		goto err;
+	drgn_memory_reader_set_read_many(&prog->reader,
+					 drgn_read_memory_remote_many,
+					 prog->remote);
+	/*
+	 * Every cache miss is a round trip to the target, so cache by default
+	 * like we do for core dumps.
+	 */
+	drgn_program_set_memory_cache_size(prog,
+					   DRGN_DEFAULT_CORE_DUMP_MEMORY_CACHE_SIZE);
+	return NULL;
+
+err:
+	drgn_memory_reader_deinit(&prog->reader);
+	drgn_memory_reader_init(&prog->reader);
+	drgn_remote_destroy(prog->remote);
+	prog->remote = NULL;
+	return err;
+}
+
+static struct drgn_error *drgn_program_get_dindex(struct drgn_program *prog,
 						  struct drgn_dwarf_index **ret)
 {
 	struct drgn_error *err;
 
+	drgn_program_finish_loading_debug_info(prog);
 	if (!prog->_dicache) {
 		const Dwfl_Callbacks *dwfl_callbacks;
 		struct drgn_dwarf_info_cache *dicache;
@@ -570,6 +1563,9 @@ static struct drgn_error *drgn_program_get_dindex(struct drgn_program *prog,
 			drgn_dwarf_info_cache_destroy(dicache);
 			return err;
 		}
+		dicache->dindex.progress_fn = prog->debug_info_progress_fn;
+		dicache->dindex.progress_arg = prog->debug_info_progress_arg;
+		dicache->dindex.shared = prog->shared_debug_info;
 		prog->_dicache = dicache;
 	}
 	*ret = &prog->_dicache->dindex;
@@ -588,6 +1584,23 @@ struct drgn_error *drgn_program_get_dwfl(struct drgn_program *prog, Dwfl **ret)
 	return NULL;
 }
 
+/*
+ * Dwfl_Core_Memory_Read callback which reads the memory of a compressed core
+ * dump for dwfl_core_file_report_memory().
+ */
+static bool drgn_program_read_core_memory(void *buf, GElf_Addr addr,
+					  size_t size, void *arg)
+{
+	struct drgn_error *err;
+
+	err = drgn_program_read_memory(arg, buf, addr, size, false);
+	if (err) {
+		drgn_error_destroy(err);
+		return false;
+	}
+	return true;
+}
+
 static struct drgn_error *
 userspace_report_debug_info(struct drgn_program *prog,
 			    struct drgn_dwarf_index *dindex,
@@ -619,7 +1632,11 @@ userspace_report_debug_info(struct drgn_program *prog,
 			return err;
 	}
 
-	if (report_default) {
+	/*
+	 * There is no core dump or /proc to find the loaded files of a remote
+	 * target in, so they must be given explicitly.
+	 */
+	if (report_default && !prog->remote) {
 		if (prog->flags & DRGN_PROGRAM_IS_LIVE) {
 			int ret;
 
@@ -630,6 +1647,12 @@ userspace_report_debug_info(struct drgn_program *prog,
 				return drgn_error_create_os("dwfl_linux_proc_report",
 							    ret, NULL);
 			}
+		} else if (prog->core_compressed) {
+			if (dwfl_core_file_report_memory(dindex->dwfl,
+							 prog->core, NULL,
+							 drgn_program_read_core_memory,
+							 prog) == -1)
+				return drgn_error_libdwfl();
 		} else if (dwfl_core_file_report(dindex->dwfl, prog->core,
 						 NULL) == -1) {
 			return drgn_error_libdwfl();
@@ -693,13 +1716,52 @@ static int drgn_set_platform_from_dwarf(Dwfl_Module *module, void **userdatap,
 	return DWARF_CB_ABORT;
 }
 
-LIBDRGN_PUBLIC struct drgn_error *
-drgn_program_load_debug_info(struct drgn_program *prog, const char **paths,
-			     size_t n, bool load_default, bool load_main)
+/* Discard the symbol table and name map after modules are reported. */
+static void drgn_program_invalidate_symbol_table(struct drgn_program *prog)
+{
+	free(prog->symbol_table);
+	prog->symbol_table = NULL;
+	prog->num_symbol_table_entries = 0;
+	prog->symbol_table_last_hit = 0;
+	prog->symbol_table_built = false;
+	drgn_symbol_name_map_clear(&prog->symbol_name_map);
+	prog->symbol_name_map_built = false;
+	prog->symbol_name_map_bad_symtabs = false;
+	/* Addresses that weren't found before may be now. */
+	drgn_pc_symbol_map_clear(&prog->pc_symbol_cache);
+}
+
+/* Finish loading debugging information after it has been indexed. */
+static void drgn_program_debug_info_loaded(struct drgn_program *prog,
+					   struct drgn_error *err)
+{
+	struct drgn_dwarf_index *dindex = &prog->_dicache->dindex;
+
+	/* Even a failed load may have indexed some files. */
+	drgn_type_index_flush_names(&prog->tindex);
+	drgn_program_invalidate_symbol_table(prog);
+	drgn_program_bump_epoch(prog);
+	if ((!err || err->code == DRGN_ERROR_MISSING_DEBUG_INFO)) {
+		if (!prog->lang &&
+		    !(prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL))
+			drgn_program_set_language_from_main(prog, dindex);
+		if (!prog->has_platform) {
+			dwfl_getdwarf(dindex->dwfl,
+				      drgn_set_platform_from_dwarf, prog, 0);
+		}
+	}
+}
+
+static struct drgn_error *
+drgn_program_load_debug_info_internal(struct drgn_program *prog,
+				      const char **paths, size_t n,
+				      bool load_default, bool load_main,
+				      bool async)
 {
 	struct drgn_error *err;
 	struct drgn_dwarf_index *dindex;
 	bool report_from_dwfl;
+	uint64_t start;
 
 	if (!n && !load_default && !load_main)
 		return NULL;
@@ -711,6 +1773,7 @@ drgn_program_load_debug_info(struct drgn_program *prog, const char **paths,
 	if (err)
 		return err;
 
+	start = monotonic_ns();
 	drgn_dwarf_index_report_begin(dindex);
 	if (prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL) {
 		err = linux_kernel_report_debug_info(prog, dindex, paths, n,
@@ -719,27 +1782,258 @@ drgn_program_load_debug_info(struct drgn_program *prog, const char **paths,
 		err = userspace_report_debug_info(prog, dindex, paths, n,
 						  load_default);
 	}
+	dindex->stats.report_ns += monotonic_ns() - start;
 	if (err) {
 		drgn_dwarf_index_report_abort(dindex);
 		return err;
 	}
 	report_from_dwfl = (!(prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL) &&
 			    load_main);
-	err = drgn_dwarf_index_report_end(dindex, report_from_dwfl);
-	if ((!err || err->code == DRGN_ERROR_MISSING_DEBUG_INFO)) {
-		if (!prog->lang &&
-		    !(prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL))
-			drgn_program_set_language_from_main(prog, dindex);
-		if (!prog->has_platform) {
-			dwfl_getdwarf(dindex->dwfl,
-				      drgn_set_platform_from_dwarf, prog, 0);
+	if (async) {
+		bool started;
+
+		err = drgn_dwarf_index_report_end_async(dindex,
+							report_from_dwfl,
+							&started);
+		if (started) {
+			prog->loading_debug_info = true;
+			return NULL;
 		}
+	} else {
+		err = drgn_dwarf_index_report_end(dindex, report_from_dwfl);
+	}
+	drgn_program_debug_info_loaded(prog, err);
+	return err;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_load_btf(struct drgn_program *prog, const char *path)
+{
+	struct drgn_error *err;
+	struct drgn_btf *btf;
+
+	if (prog->btf) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "BTF was already loaded");
+	}
+	if (!path)
+		path = "/sys/kernel/btf/vmlinux";
+
+	err = drgn_btf_create(prog, path, &btf);
+	if (err)
+		return err;
+	err = drgn_program_add_type_finder(prog, drgn_btf_type_find, btf);
+	if (err) {
+		drgn_btf_destroy(btf);
+		return err;
+	}
+	err = drgn_program_add_object_finder(prog, drgn_btf_object_find, btf);
+	if (err) {
+		drgn_type_index_remove_finder(&prog->tindex);
+		drgn_btf_destroy(btf);
+		return err;
+	}
+	if (!prog->lang)
+		prog->lang = &drgn_language_c;
+	prog->btf = btf;
+	return NULL;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_load_debug_info(struct drgn_program *prog, const char **paths,
+			     size_t n, bool load_default, bool load_main)
+{
+	return drgn_program_load_debug_info_internal(prog, paths, n,
+						     load_default, load_main,
+						     false);
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_load_debug_info_async(struct drgn_program *prog,
+				   const char **paths, size_t n,
+				   bool load_default, bool load_main)
+{
+	struct drgn_error *err;
+
+	err = drgn_program_load_debug_info_internal(prog, paths, n,
+						    load_default, load_main,
+						    true);
+	/* Only report the result of the latest load. */
+	if (prog->loading_debug_info) {
+		drgn_error_destroy(prog->debug_info_err);
+		prog->debug_info_err = NULL;
+	}
+	return err;
+}
+
+void drgn_program_finish_loading_debug_info(struct drgn_program *prog)
+{
+	struct drgn_dwarf_index *dindex;
+	struct drgn_error *err;
+
+	if (!prog->loading_debug_info)
+		return;
+	dindex = &prog->_dicache->dindex;
+	drgn_dwarf_index_wait(dindex);
+	err = dindex->async_err;
+	dindex->async_err = NULL;
+	prog->loading_debug_info = false;
+	drgn_program_debug_info_loaded(prog, err);
+	drgn_error_destroy(prog->debug_info_err);
+	prog->debug_info_err = err;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_wait_for_debug_info(struct drgn_program *prog)
+{
+	struct drgn_error *err;
+
+	drgn_program_finish_loading_debug_info(prog);
+	err = prog->debug_info_err;
+	prog->debug_info_err = NULL;
+	return err;
+}
+
+LIBDRGN_PUBLIC void
+drgn_program_debug_info_stats(struct drgn_program *prog,
+			      struct drgn_debug_info_stats *ret)
+{
+	if (!prog->_dicache) {
+		memset(ret, 0, sizeof(*ret));
+		return;
+	}
+	drgn_program_finish_loading_debug_info(prog);
+	drgn_dwarf_index_stats(&prog->_dicache->dindex, ret);
+}
+
+LIBDRGN_PUBLIC void
+drgn_program_debug_info_module_stats(struct drgn_program *prog,
+				     const struct drgn_debug_info_module_stats **ret,
+				     size_t *count_ret)
+{
+	struct drgn_dwarf_index *dindex;
+
+	if (!prog->_dicache) {
+		*ret = NULL;
+		*count_ret = 0;
+		return;
+	}
+	drgn_program_finish_loading_debug_info(prog);
+	dindex = &prog->_dicache->dindex;
+	*ret = dindex->module_stats.data;
+	*count_ret = dindex->module_stats.size;
+}
+
+LIBDRGN_PUBLIC void
+drgn_program_set_debug_info_progress(struct drgn_program *prog,
+				     drgn_debug_info_progress_fn *fn, void *arg)
+{
+	drgn_program_finish_loading_debug_info(prog);
+	prog->debug_info_progress_fn = fn;
+	prog->debug_info_progress_arg = arg;
+	if (prog->_dicache) {
+		prog->_dicache->dindex.progress_fn = fn;
+		prog->_dicache->dindex.progress_arg = arg;
+	}
+}
+
+/* Takes ownership of the reference to shared. */
+static void
+drgn_program_set_shared_debug_info(struct drgn_program *prog,
+				   struct drgn_shared_debug_info *shared)
+{
+	drgn_shared_debug_info_decref(prog->shared_debug_info);
+	prog->shared_debug_info = shared;
+	if (prog->_dicache)
+		prog->_dicache->dindex.shared = shared;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_share_debug_info(struct drgn_program *prog,
+			      struct drgn_program *other)
+{
+	struct drgn_shared_debug_info *shared;
+
+	if (prog == other)
+		return NULL;
+	drgn_program_finish_loading_debug_info(prog);
+	drgn_program_finish_loading_debug_info(other);
+	shared = other->shared_debug_info;
+	if (!shared) {
+		shared = drgn_shared_debug_info_create();
+		if (!shared)
+			return &drgn_enomem;
+		drgn_program_set_shared_debug_info(other, shared);
+	}
+	if (shared != prog->shared_debug_info) {
+		drgn_shared_debug_info_incref(shared);
+		drgn_program_set_shared_debug_info(prog, shared);
+	}
+	return NULL;
+}
+
+struct drgn_error *
+drgn_program_load_deferred_debug_info(struct drgn_program *prog, bool all,
+				      uint64_t address, bool *loaded_ret)
+{
+	struct drgn_error *err;
+	struct drgn_dwarf_index *dindex;
+
+	*loaded_ret = false;
+	if (!prog->_dicache)
+		return NULL;
+	drgn_program_finish_loading_debug_info(prog);
+	dindex = &prog->_dicache->dindex;
+	if (dindex->reporting)
+		return NULL;
+	if (prog->kernel_modules_pending) {
+		prog->kernel_modules_pending = false;
+		err = linux_kernel_defer_loaded_modules(prog, dindex);
+		if (err)
+			return err;
+	}
+	if (!dindex->deferred.size ||
+	    (!all && !drgn_dwarf_index_has_deferred(dindex, address))) {
+		/*
+		 * Split DWARF files are only opened once a lookup misses
+		 * everything else. They don't cover addresses that the
+		 * skeleton doesn't.
+		 */
+		if (!all)
+			return NULL;
+		dindex->progress_fn = NULL;
+		err = drgn_dwarf_index_index_split_units(dindex, loaded_ret);
+		dindex->progress_fn = prog->debug_info_progress_fn;
+		goto out;
+	}
+
+	drgn_dwarf_index_report_begin(dindex);
+	err = drgn_dwarf_index_report_deferred(dindex, all, address,
+					       loaded_ret);
+	if (err) {
+		drgn_dwarf_index_report_abort(dindex);
+		return err;
+	}
+	/*
+	 * This happens implicitly in the middle of lookups, where the caller
+	 * isn't prepared for the progress callback to be called.
+	 */
+	dindex->progress_fn = NULL;
+	err = drgn_dwarf_index_report_end(dindex, false);
+	dindex->progress_fn = prog->debug_info_progress_fn;
+	if (err && err->code == DRGN_ERROR_MISSING_DEBUG_INFO) {
+		drgn_error_destroy(err);
+		err = NULL;
+	}
+out:
+	if (*loaded_ret) {
+		drgn_type_index_flush_names(&prog->tindex);
+		drgn_program_invalidate_symbol_table(prog);
 	}
 	return err;
 }
 
-static uint32_t get_prstatus_pid(struct drgn_program *prog, const char *data,
-				 size_t size)
+static uint32_t get_prstatus_pid(struct drgn_program *prog, const char *data)
 {
 	uint32_t pr_pid;
 	memcpy(&pr_pid, data + (drgn_program_is_64_bit(prog) ? 32 : 24),
@@ -749,25 +2043,17 @@ static uint32_t get_prstatus_pid(struct drgn_program *prog, const char *data,
 	return pr_pid;
 }
 
-struct drgn_error *drgn_program_cache_prstatus_entry(struct drgn_program *prog,
-						     const char *data,
-						     size_t size)
+static struct drgn_error *
+drgn_program_add_prstatus(struct drgn_program *prog,
+			  const struct drgn_prstatus_location *loc)
 {
-	if (size < (drgn_program_is_64_bit(prog) ? 36 : 28)) {
-		return drgn_error_create(DRGN_ERROR_OTHER,
-					 "NT_PRSTATUS is truncated");
-	}
 	if (prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL) {
-		struct string *entry =
-			drgn_prstatus_vector_append_entry(&prog->prstatus_vector);
-		if (!entry)
+		if (!drgn_prstatus_vector_append(&prog->prstatus_vector, loc))
 			return &drgn_enomem;
-		entry->str = data;
-		entry->len = size;
 	} else {
 		struct drgn_prstatus_map_entry entry = {
-			.key = get_prstatus_pid(prog, data, size),
-			.value = { data, size },
+			.key = loc->tid,
+			.value = *loc,
 		};
 		if (drgn_prstatus_map_insert(&prog->prstatus_map, &entry,
 					     NULL) == -1)
@@ -776,6 +2062,170 @@ struct drgn_error *drgn_program_cache_prstatus_entry(struct drgn_program *prog,
 	return NULL;
 }
 
+struct drgn_error *drgn_program_cache_prstatus_entry(struct drgn_program *prog,
+						     const char *data,
+						     size_t size)
+{
+	struct drgn_prstatus_location loc = {
+		.data = data,
+		.size = size,
+	};
+
+	if (size < (drgn_program_is_64_bit(prog) ? 36 : 28)) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "NT_PRSTATUS is truncated");
+	}
+	loc.tid = get_prstatus_pid(prog, data);
+	return drgn_program_add_prstatus(prog, &loc);
+}
+
+/* Read from the core dump file, using the mapping of it if possible. */
+static struct drgn_error *drgn_program_read_core(struct drgn_program *prog,
+						 void *buf, uint64_t offset,
+						 size_t size)
+{
+	char *p = buf;
+
+	if (prog->core_map && offset <= prog->core_map_size &&
+	    size <= prog->core_map_size - offset) {
+		memcpy(buf, (char *)prog->core_map + offset, size);
+		return NULL;
+	}
+	if (prog->core_compressed) {
+		struct drgn_error *err;
+
+		/* The compressed file is protected by the reader's lock. */
+		drgn_memory_reader_lock(&prog->reader);
+		err = drgn_compressed_file_read(prog->core_compressed, buf,
+						offset, size);
+		drgn_memory_reader_unlock(&prog->reader);
+		return err;
+	}
+	while (size) {
+		ssize_t sret;
+
+		sret = pread(prog->core_fd, p, size, offset);
+		if (sret == -1) {
+			if (errno == EINTR)
+				continue;
+			return drgn_error_create_os("pread", errno, NULL);
+		} else if (sret == 0) {
+			return drgn_error_create(DRGN_ERROR_OTHER,
+						 "core dump is truncated");
+		}
+		p += sret;
+		offset += sret;
+		size -= sret;
+	}
+	return NULL;
+}
+
+/* Get the data of an NT_PRSTATUS note, reading it from the file if needed. */
+static struct drgn_error *
+drgn_program_read_prstatus(struct drgn_program *prog,
+			   const struct drgn_prstatus_location *loc,
+			   struct string *ret)
+{
+	struct drgn_error *err;
+
+	if (loc->data) {
+		ret->str = loc->data;
+	} else if (prog->core_map && loc->offset <= prog->core_map_size &&
+		   loc->size <= prog->core_map_size - loc->offset) {
+		ret->str = (char *)prog->core_map + loc->offset;
+	} else {
+		if (loc->size > prog->prstatus_buf_capacity) {
+			char *buf;
+
+			buf = realloc(prog->prstatus_buf, loc->size);
+			if (!buf)
+				return &drgn_enomem;
+			prog->prstatus_buf = buf;
+			prog->prstatus_buf_capacity = loc->size;
+		}
+		err = drgn_program_read_core(prog, prog->prstatus_buf,
+					     loc->offset, loc->size);
+		if (err)
+			return err;
+		ret->str = prog->prstatus_buf;
+	}
+	ret->len = loc->size;
+	return NULL;
+}
+
+/*
+ * Index the NT_PRSTATUS notes in a PT_NOTE segment. This parses the notes
+ * directly from the mapping of the core dump if possible, and only the
+ * location and thread ID of each note are saved.
+ */
+static struct drgn_error *
+drgn_program_cache_prstatus_notes(struct drgn_program *prog, GElf_Phdr *phdr)
+{
+	struct drgn_error *err;
+	const char *notes;
+	char *buf = NULL;
+	size_t align = phdr->p_align == 8 ? 8 : 4;
+	size_t min_size = drgn_program_is_64_bit(prog) ? 36 : 28;
+	uint64_t offset = 0;
+
+	if (phdr->p_filesz > SIZE_MAX)
+		return &drgn_enomem;
+	if (prog->core_map && phdr->p_offset <= prog->core_map_size &&
+	    phdr->p_filesz <= prog->core_map_size - phdr->p_offset) {
+		notes = (char *)prog->core_map + phdr->p_offset;
+	} else {
+		buf = malloc(phdr->p_filesz);
+		if (!buf)
+			return &drgn_enomem;
+		err = drgn_program_read_core(prog, buf, phdr->p_offset,
+					     phdr->p_filesz);
+		if (err)
+			goto out;
+		notes = buf;
+	}
+
+	while (phdr->p_filesz - offset >= 12) {
+		uint32_t nhdr[3];
+		uint64_t name_offset, desc_offset;
+		struct drgn_prstatus_location loc = {};
+
+		memcpy(nhdr, notes + offset, sizeof(nhdr));
+		if (drgn_program_bswap(prog)) {
+			nhdr[0] = bswap_32(nhdr[0]);
+			nhdr[1] = bswap_32(nhdr[1]);
+			nhdr[2] = bswap_32(nhdr[2]);
+		}
+		/* This matches the padding that gelf_getnote() expects. */
+		name_offset = offset + 12;
+		desc_offset = ((name_offset + nhdr[0] + align - 1) &
+			       ~(uint64_t)(align - 1));
+		if (desc_offset > phdr->p_filesz ||
+		    nhdr[1] > phdr->p_filesz - desc_offset)
+			break;
+		offset = ((desc_offset + nhdr[1] + align - 1) &
+			  ~(uint64_t)(align - 1));
+
+		if (nhdr[2] != NT_PRSTATUS ||
+		    strncmp(notes + name_offset, "CORE", nhdr[0]) != 0)
+			continue;
+		if (nhdr[1] < min_size) {
+			err = drgn_error_create(DRGN_ERROR_OTHER,
+						"NT_PRSTATUS is truncated");
+			goto out;
+		}
+		loc.offset = phdr->p_offset + desc_offset;
+		loc.size = nhdr[1];
+		loc.tid = get_prstatus_pid(prog, notes + desc_offset);
+		err = drgn_program_add_prstatus(prog, &loc);
+		if (err)
+			goto out;
+	}
+	err = NULL;
+out:
+	free(buf);
+	return err;
+}
+
 static struct drgn_error *drgn_program_cache_prstatus(struct drgn_program *prog)
 {
 	struct drgn_error *err;
@@ -805,10 +2255,6 @@ static struct drgn_error *drgn_program_cache_prstatus(struct drgn_program *prog)
 	}
 	for (i = 0; i < phnum; i++) {
 		GElf_Phdr phdr_mem, *phdr;
-		Elf_Data *data;
-		size_t offset;
-		GElf_Nhdr nhdr;
-		size_t name_offset, desc_offset;
 
 		phdr = gelf_getphdr(prog->core, i, &phdr_mem);
 		if (!phdr) {
@@ -817,32 +2263,9 @@ static struct drgn_error *drgn_program_cache_prstatus(struct drgn_program *prog)
 		}
 		if (phdr->p_type != PT_NOTE)
 			continue;
-
-		data = elf_getdata_rawchunk(prog->core, phdr->p_offset,
-					    phdr->p_filesz,
-					    note_header_type(phdr));
-		if (!data) {
-			err = drgn_error_libelf();
+		err = drgn_program_cache_prstatus_notes(prog, phdr);
+		if (err)
 			goto out;
-		}
-
-		offset = 0;
-		while (offset < data->d_size &&
-		       (offset = gelf_getnote(data, offset, &nhdr, &name_offset,
-					      &desc_offset))) {
-			const char *name;
-
-			name = (char *)data->d_buf + name_offset;
-			if (strncmp(name, "CORE", nhdr.n_namesz) != 0 ||
-			    nhdr.n_type != NT_PRSTATUS)
-				continue;
-
-			err = drgn_program_cache_prstatus_entry(prog,
-								(char *)data->d_buf + desc_offset,
-								nhdr.n_descsz);
-			if (err)
-				goto out;
-		}
 	}
 
 	err = NULL;
@@ -871,8 +2294,10 @@ struct drgn_error *drgn_program_find_prstatus_by_cpu(struct drgn_program *prog,
 		return err;
 
 	if (cpu < prog->prstatus_vector.size) {
-		*ret = prog->prstatus_vector.data[cpu];
-		*tid_ret = get_prstatus_pid(prog, ret->str, ret->len);
+		*tid_ret = prog->prstatus_vector.data[cpu].tid;
+		return drgn_program_read_prstatus(prog,
+						  &prog->prstatus_vector.data[cpu],
+						  ret);
 	} else {
 		ret->str = NULL;
 		ret->len = 0;
@@ -898,10 +2323,95 @@ struct drgn_error *drgn_program_find_prstatus_by_tid(struct drgn_program *prog,
 		ret->len = 0;
 		return NULL;
 	}
-	*ret = it.entry->value;
+	return drgn_program_read_prstatus(prog, &it.entry->value, ret);
+}
+
+static int uint32_cmp(const void *_a, const void *_b)
+{
+	uint32_t a = *(const uint32_t *)_a, b = *(const uint32_t *)_b;
+
+	return a < b ? -1 : a > b;
+}
+
+struct drgn_error *drgn_program_prstatus_tids(struct drgn_program *prog,
+					      uint32_t **ret,
+					      size_t *count_ret)
+{
+	struct drgn_error *err;
+	struct drgn_prstatus_map_iterator it;
+	uint32_t *tids;
+	size_t size, count = 0;
+
+	assert(!(prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL));
+	err = drgn_program_cache_prstatus(prog);
+	if (err)
+		return err;
+
+	size = drgn_prstatus_map_size(&prog->prstatus_map);
+	tids = malloc_array(size ? size : 1, sizeof(*tids));
+	if (!tids)
+		return &drgn_enomem;
+	for (it = drgn_prstatus_map_first(&prog->prstatus_map); it.entry;
+	     it = drgn_prstatus_map_next(it))
+		tids[count++] = it.entry->key;
+	qsort(tids, count, sizeof(*tids), uint32_cmp);
+	*ret = tids;
+	*count_ret = count;
 	return NULL;
 }
 
+struct drgn_error *drgn_program_live_tids(struct drgn_program *prog,
+					  uint32_t **ret, size_t *count_ret)
+{
+	struct drgn_error *err;
+	char path[sizeof("/proc/-2147483648/task")];
+	DIR *dir;
+	struct dirent *ent;
+	uint32_t *tids = NULL;
+	size_t count = 0, capacity = 0;
+
+	assert((prog->flags & (DRGN_PROGRAM_IS_LINUX_KERNEL |
+			       DRGN_PROGRAM_IS_LIVE)) == DRGN_PROGRAM_IS_LIVE);
+	snprintf(path, sizeof(path), "/proc/%ld/task", (long)prog->pid);
+	dir = opendir(path);
+	if (!dir)
+		return drgn_error_create_os("opendir", errno, path);
+	while ((errno = 0, ent = readdir(dir))) {
+		char *end;
+		unsigned long tid;
+
+		tid = strtoul(ent->d_name, &end, 10);
+		if (*end || end == ent->d_name)
+			continue;
+		if (count == capacity) {
+			uint32_t *tmp;
+
+			capacity = capacity ? capacity * 2 : 16;
+			tmp = realloc(tids, capacity * sizeof(*tids));
+			if (!tmp) {
+				err = &drgn_enomem;
+				goto err;
+			}
+			tids = tmp;
+		}
+		tids[count++] = tid;
+	}
+	if (errno) {
+		err = drgn_error_create_os("readdir", errno, path);
+		goto err;
+	}
+	closedir(dir);
+	qsort(tids, count, sizeof(*tids), uint32_cmp);
+	*ret = tids;
+	*count_ret = count;
+	return NULL;
+
+err:
+	free(tids);
+	closedir(dir);
+	return err;
+}
+
 struct drgn_error *drgn_program_init_core_dump(struct drgn_program *prog,
 					       const char *path)
 {
@@ -1022,281 +2532,1918 @@ drgn_program_read_memory(struct drgn_program *prog, void *buf, uint64_t address,
 				       physical);
 }
 
-DEFINE_VECTOR(char_vector, char)
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_try_read_memory(struct drgn_program *prog, void *buf,
+			     uint64_t address, size_t count, bool physical,
+			     bool *ret)
+{
+	return drgn_memory_reader_try_read(&prog->reader, buf, address, count,
+					   physical, ret);
+}
 
 LIBDRGN_PUBLIC struct drgn_error *
-drgn_program_read_c_string(struct drgn_program *prog, uint64_t address,
-			   bool physical, size_t max_size, char **ret)
+drgn_program_read_memory_batch(struct drgn_program *prog,
+			       struct drgn_memory_read_request *requests,
+			       size_t num_requests)
+{
+	return drgn_memory_reader_read_batch(&prog->reader, requests,
+					     num_requests);
+}
+
+/* Number of addresses read at once by drgn_program_read_field_array(). */
+#define DRGN_FIELD_ARRAY_BATCH_SIZE 4096
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_read_field_array(struct drgn_program *prog,
+			      const struct drgn_member_info *member,
+			      const uint64_t *addresses, size_t num_addresses,
+			      void *values, enum drgn_object_kind *kind_ret)
 {
 	struct drgn_error *err;
-	struct char_vector str = VECTOR_INIT;
-	for (;;) {
-		char *c = char_vector_append_entry(&str);
-		if (!c) {
-			char_vector_deinit(&str);
-			return &drgn_enomem;
+	struct drgn_object_type type;
+	enum drgn_object_kind kind;
+	uint64_t bit_size, byte_offset, size;
+	uint8_t bit_offset;
+	bool little_endian;
+	struct drgn_memory_read_request *requests;
+	char *buf;
+	uint64_t *raw;
+	size_t batch_size, i, j;
+
+	err = drgn_object_set_common(member->qualified_type,
+				     member->bit_field_size, &type, &kind,
+				     &bit_size);
+	if (err)
+		return err;
+	if (kind != DRGN_OBJECT_SIGNED && kind != DRGN_OBJECT_UNSIGNED &&
+	    kind != DRGN_OBJECT_FLOAT) {
+		return drgn_type_error("cannot read array of '%s' members",
+				       member->qualified_type.type);
+	}
+	err = sanity_check_object(kind, member->bit_field_size, bit_size);
+	if (err)
+		return err;
+	err = drgn_byte_order_to_little_endian(prog, DRGN_PROGRAM_ENDIAN,
+					       &little_endian);
+	if (err)
+		return err;
+
+	byte_offset = member->bit_offset / 8;
+	bit_offset = member->bit_offset % 8;
+	size = drgn_value_size(bit_size, bit_offset);
+	batch_size = min(num_addresses, (size_t)DRGN_FIELD_ARRAY_BATCH_SIZE);
+	requests = malloc_array(batch_size, sizeof(*requests));
+	buf = malloc_array(batch_size, size);
+	raw = malloc_array(batch_size, sizeof(*raw));
+	if (batch_size && (!requests || !buf || !raw)) {
+		err = &drgn_enomem;
+		goto out;
+	}
+
+	for (i = 0; i < num_addresses; i += batch_size) {
+		size_t n = min(num_addresses - i, batch_size);
+
+		for (j = 0; j < n; j++) {
+			requests[j].buf = &buf[j * size];
+			requests[j].address = addresses[i + j] + byte_offset;
+			requests[j].count = size;
+			requests[j].physical = false;
 		}
-		if (str.size <= max_size) {
-			err = drgn_memory_reader_read(&prog->reader, c, address,
-						      1, physical);
-			if (err) {
-				char_vector_deinit(&str);
-				return err;
+		err = drgn_program_read_memory_batch(prog, requests, n);
+		if (err)
+			goto out;
+		deserialize_bits_array(raw, buf, n, bit_offset, size * 8,
+				       bit_size, little_endian);
+		for (j = 0; j < n; j++) {
+			if (kind == DRGN_OBJECT_SIGNED) {
+				raw[j] = sign_extend(raw[j], bit_size);
+			} else if (kind == DRGN_OBJECT_FLOAT &&
+				   bit_size == 32) {
+				uint32_t bits = raw[j];
+				float fvalue32;
+				double fvalue64;
+
+				memcpy(&fvalue32, &bits, sizeof(fvalue32));
+				fvalue64 = fvalue32;
+				memcpy(&raw[j], &fvalue64, sizeof(fvalue64));
 			}
-			if (!*c)
-				break;
-		} else {
-			*c = '\0';
-			break;
 		}
-		address++;
+		memcpy((char *)values + i * 8, raw, n * 8);
 	}
-	char_vector_shrink_to_fit(&str);
-	*ret = str.data;
-	return NULL;
+	*kind_ret = kind;
+	err = NULL;
+out:
+	free(raw);
+	free(buf);
+	free(requests);
+	return err;
 }
 
-LIBDRGN_PUBLIC struct drgn_error *
-drgn_program_read_u8(struct drgn_program *prog, uint64_t address, bool physical,
-		     uint8_t *ret)
+bool drgn_program_find_translation(struct drgn_program *prog, uint64_t pgtable,
+				   uint64_t virt_addr,
+				   uint64_t *start_virt_addr_ret,
+				   uint64_t *size_ret,
+				   uint64_t *start_phys_addr_ret)
 {
-	return drgn_memory_reader_read(&prog->reader, ret, address,
-				       sizeof(*ret), physical);
-}
+	uint64_t shifts = prog->translation_cache_shifts;
 
-#define DEFINE_PROGRAM_READ_U(n)						\
-LIBDRGN_PUBLIC struct drgn_error *						\
-drgn_program_read_u##n(struct drgn_program *prog, uint64_t address,		\
-		       bool physical, uint##n##_t *ret)				\
-{										\
-	struct drgn_error *err;							\
-	uint##n##_t tmp;							\
-										\
-	if (!prog->has_platform) {						\
-		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,		\
-					 "program byte order is not known");	\
-	}									\
-	err = drgn_memory_reader_read(&prog->reader, &tmp, address,		\
-				      sizeof(tmp), physical);			\
-	if (err)								\
-		return err;							\
-	if (drgn_program_bswap(prog))						\
-		tmp = bswap_##n(tmp);						\
-	*ret = tmp;								\
-	return NULL;								\
+	while (shifts) {
+		struct drgn_translation_key key = {
+			.pgtable = pgtable,
+			.shift = ctz(shifts),
+		};
+		uint64_t size = UINT64_C(1) << key.shift;
+		struct drgn_translation_map_iterator it;
+
+		key.virt_addr = virt_addr & -size;
+		it = drgn_translation_map_search(&prog->translation_cache,
+						 &key);
+		if (it.entry) {
+			*start_virt_addr_ret = key.virt_addr;
+			*size_ret = size;
+			*start_phys_addr_ret = it.entry->value;
+			return true;
+		}
+		shifts &= shifts - 1;
+	}
+	return false;
 }
 
-DEFINE_PROGRAM_READ_U(16)
-DEFINE_PROGRAM_READ_U(32)
-DEFINE_PROGRAM_READ_U(64)
-#undef DEFINE_PROGRAM_READ_U
+void drgn_program_cache_translation(struct drgn_program *prog,
+				    uint64_t pgtable, uint64_t start_virt_addr,
+				    uint64_t size, uint64_t start_phys_addr)
+{
+	struct drgn_translation_map_entry entry = {
+		.key = {
+			.pgtable = pgtable,
+			.virt_addr = start_virt_addr,
+			.shift = ctz(size),
+		},
+		.value = start_phys_addr,
+	};
 
-LIBDRGN_PUBLIC struct drgn_error *
-drgn_program_read_word(struct drgn_program *prog, uint64_t address,
-		       bool physical, uint64_t *ret)
+	if (drgn_translation_map_size(&prog->translation_cache) >=
+	    DRGN_MAX_CACHED_TRANSLATIONS)
+		drgn_program_invalidate_translations(prog);
+	if (drgn_translation_map_insert(&prog->translation_cache, &entry,
+					NULL) == 1)
+		prog->translation_cache_shifts |= size;
+}
+
+bool drgn_program_find_dentry_path(struct drgn_program *prog, uint64_t mnt,
+				   uint64_t dentry, struct string_builder *sb,
+				   bool *found_ret)
 {
-	struct drgn_error *err;
+	struct drgn_dentry_path_key key = { .mnt = mnt, .dentry = dentry };
+	struct drgn_dentry_path_map_iterator it;
+	bool ret = true;
 
-	if (!prog->has_platform) {
-		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
-					 "program word size is not known");
+	drgn_memory_reader_lock(&prog->reader);
+	if (prog->reader.cache.capacity == 0) {
+		*found_ret = false;
+		goto out;
 	}
-	if (drgn_program_is_64_bit(prog)) {
-		uint64_t tmp;
-		err = drgn_memory_reader_read(&prog->reader, &tmp, address,
-					      sizeof(tmp), physical);
-		if (err)
-			return err;
-		if (drgn_program_bswap(prog))
-			tmp = bswap_64(tmp);
-		*ret = tmp;
-	} else {
-		uint32_t tmp;
-		err = drgn_memory_reader_read(&prog->reader, &tmp, address,
-					      sizeof(tmp), physical);
-		if (err)
-			return err;
-		if (drgn_program_bswap(prog))
-			tmp = bswap_32(tmp);
-		*ret = tmp;
+	it = drgn_dentry_path_map_search(&prog->dentry_path_cache, &key);
+	*found_ret = it.entry != NULL;
+	if (it.entry) {
+		ret = string_builder_appendn(sb, it.entry->value.str,
+					     it.entry->value.len);
 	}
-	return NULL;
+out:
+	drgn_memory_reader_unlock(&prog->reader);
+	return ret;
 }
 
-LIBDRGN_PUBLIC struct drgn_error *
-drgn_program_find_type(struct drgn_program *prog, const char *name,
-		       const char *filename, struct drgn_qualified_type *ret)
+void drgn_program_cache_dentry_path(struct drgn_program *prog, uint64_t mnt,
+				    uint64_t dentry, const char *path,
+				    size_t len)
 {
-	return drgn_type_index_find(&prog->tindex, name, filename,
-				    drgn_program_language(prog), ret);
+	struct drgn_dentry_path_map_entry entry = {
+		.key = { .mnt = mnt, .dentry = dentry },
+	};
+	char *copy;
+
+	drgn_memory_reader_lock(&prog->reader);
+	/* Paths are cached along with memory, like translations. */
+	if (prog->reader.cache.capacity == 0)
+		goto out;
+	if (drgn_dentry_path_map_size(&prog->dentry_path_cache) >=
+	    DRGN_MAX_CACHED_DENTRY_PATHS)
+		drgn_program_invalidate_dentry_paths(prog);
+	copy = malloc(len ? len : 1);
+	if (!copy)
+		goto out;
+	if (len)
+		memcpy(copy, path, len);
+	entry.value.str = copy;
+	entry.value.len = len;
+	if (drgn_dentry_path_map_insert(&prog->dentry_path_cache, &entry,
+					NULL) != 1)
+		free(copy);
+out:
+	drgn_memory_reader_unlock(&prog->reader);
 }
 
-LIBDRGN_PUBLIC struct drgn_error *
-drgn_program_find_object(struct drgn_program *prog, const char *name,
-			 const char *filename,
-			 enum drgn_find_object_flags flags,
-			 struct drgn_object *ret)
+struct drgn_btf *drgn_program_find_kernel_btf(struct drgn_program *prog,
+					      uint64_t address, uint64_t data,
+					      uint64_t data_size)
 {
-	if (ret && ret->prog != prog) {
-		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
-					 "object is from wrong program");
-	}
-	return drgn_object_index_find(&prog->oindex, name, filename, flags,
-				      ret);
+	struct drgn_kernel_btf_map_iterator it;
+	struct drgn_btf *ret = NULL;
+
+	drgn_memory_reader_lock(&prog->reader);
+	it = drgn_kernel_btf_map_search(&prog->kernel_btfs, &address);
+	if (it.entry && it.entry->value.data == data &&
+	    it.entry->value.data_size == data_size)
+		ret = it.entry->value.btf;
+	drgn_memory_reader_unlock(&prog->reader);
+	return ret;
 }
 
-bool drgn_program_find_symbol_by_address_internal(struct drgn_program *prog,
-						  uint64_t address,
-						  Dwfl_Module *module,
-						  struct drgn_symbol *ret)
+struct drgn_error *drgn_program_cache_kernel_btf(struct drgn_program *prog,
+						 uint64_t address,
+						 uint64_t data,
+						 uint64_t data_size,
+						 struct drgn_btf *btf)
 {
-	const char *name;
-	GElf_Off offset;
-	GElf_Sym elf_sym;
+	struct drgn_kernel_btf_map_entry entry = {
+		.key = address,
+		.value = { .data = data, .data_size = data_size, .btf = btf },
+	};
+	struct drgn_kernel_btf_map_iterator it;
+	struct drgn_error *err = NULL;
 
-	if (!module) {
-		if (prog->_dicache) {
-			module = dwfl_addrmodule(prog->_dicache->dindex.dwfl,
-						 address);
-			if (!module)
-				return false;
-		} else {
-			return false;
-		}
+	drgn_memory_reader_lock(&prog->reader);
+	if (!drgn_btf_vector_append(&prog->kernel_btf_list, &btf)) {
+		drgn_btf_destroy(btf);
+		err = &drgn_enomem;
+		goto out;
 	}
-
-	name = dwfl_module_addrinfo(module, address, &offset, &elf_sym, NULL,
-				    NULL, NULL);
-	if (!name)
-		return false;
-	ret->name = name;
-	ret->address = address - offset;
-	ret->size = elf_sym.st_size;
-	return true;
+	/* Replace any stale entry, which stays in kernel_btf_list. */
+	it = drgn_kernel_btf_map_search(&prog->kernel_btfs, &address);
+	if (it.entry)
+		it.entry->value = entry.value;
+	else if (drgn_kernel_btf_map_insert(&prog->kernel_btfs, &entry,
+					    NULL) == -1)
+		err = &drgn_enomem;
+out:
+	drgn_memory_reader_unlock(&prog->reader);
+	return err;
 }
 
-struct drgn_error *drgn_error_symbol_not_found(uint64_t address)
+bool drgn_program_find_cached_pid(struct drgn_program *prog, uint64_t ns,
+				  uint64_t nr, struct drgn_cached_pid *ret)
 {
-	return drgn_error_format(DRGN_ERROR_LOOKUP,
-				 "could not find symbol containing 0x%" PRIx64,
-				 address);
+	struct drgn_pid_cache_key key = { .ns = ns, .nr = nr };
+	struct drgn_pid_cache_iterator it;
+	bool found;
+
+	drgn_memory_reader_lock(&prog->reader);
+	found = drgn_pid_ns_set_search(&prog->pid_cache_namespaces,
+				       &ns).entry != NULL;
+	if (found) {
+		it = drgn_pid_cache_search(&prog->pid_cache, &key);
+		if (it.entry)
+			*ret = it.entry->value;
+		else
+			ret->pid = ret->task = 0;
+	}
+	drgn_memory_reader_unlock(&prog->reader);
+	return found;
 }
 
-LIBDRGN_PUBLIC struct drgn_error *
-drgn_program_find_symbol_by_address(struct drgn_program *prog, uint64_t address,
-				    struct drgn_symbol **ret)
+static void drgn_pid_cache_delete_ns(struct drgn_pid_cache *cache,
+				     uint64_t ns)
 {
-	struct drgn_symbol *sym;
+	struct drgn_pid_cache_iterator it;
 
-	sym = malloc(sizeof(*sym));
-	if (!sym)
-		return &drgn_enomem;
-	if (!drgn_program_find_symbol_by_address_internal(prog, address, NULL,
-							  sym)) {
-		free(sym);
-		return drgn_error_symbol_not_found(address);
+	for (it = drgn_pid_cache_first(cache); it.entry; ) {
+		if (it.entry->key.ns == ns)
+			it = drgn_pid_cache_delete_iterator(cache, it);
+		else
+			it = drgn_pid_cache_next(it);
 	}
-	*ret = sym;
-	return NULL;
 }
 
-struct find_symbol_by_name_arg {
-	const char *name;
-	struct drgn_symbol **ret;
-	struct drgn_error *err;
-	bool bad_symtabs;
-};
-
-static int find_symbol_by_name_cb(Dwfl_Module *dwfl_module, void **userdatap,
-				  const char *module_name, Dwarf_Addr base,
-				  void *cb_arg)
+struct drgn_error *
+drgn_program_cache_pids(struct drgn_program *prog, uint64_t ns,
+			const struct drgn_pid_cache_entry *entries,
+			size_t num_entries)
 {
-	struct find_symbol_by_name_arg *arg = cb_arg;
-	int symtab_len, i;
+	struct drgn_error *err = NULL;
+	size_t i;
 
-	symtab_len = dwfl_module_getsymtab(dwfl_module);
-	i = dwfl_module_getsymtab_first_global(dwfl_module);
-	if (symtab_len == -1 || i == -1) {
-		arg->bad_symtabs = true;
-		return DWARF_CB_OK;
+	drgn_memory_reader_lock(&prog->reader);
+	if (drgn_pid_ns_set_delete(&prog->pid_cache_namespaces, &ns))
+		drgn_pid_cache_delete_ns(&prog->pid_cache, ns);
+	if (!drgn_pid_cache_reserve(&prog->pid_cache,
+				    drgn_pid_cache_size(&prog->pid_cache) +
+				    num_entries))
+		goto enomem;
+	for (i = 0; i < num_entries; i++) {
+		if (drgn_pid_cache_insert(&prog->pid_cache, &entries[i],
+					  NULL) == -1)
+			goto enomem;
 	}
-	for (; i < symtab_len; i++) {
-		GElf_Sym elf_sym;
-		GElf_Addr elf_addr;
-		const char *name;
+	if (drgn_pid_ns_set_insert(&prog->pid_cache_namespaces, &ns,
+				   NULL) == -1)
+		goto enomem;
+out:
+	drgn_memory_reader_unlock(&prog->reader);
+	return err;
 
-		name = dwfl_module_getsym_info(dwfl_module, i, &elf_sym,
-					       &elf_addr, NULL, NULL, NULL);
-		if (name && strcmp(arg->name, name) == 0) {
-			struct drgn_symbol *sym;
+enomem:
+	/* Don't leave the namespace partially cached. */
+	drgn_pid_cache_delete_ns(&prog->pid_cache, ns);
+	err = &drgn_enomem;
+	goto out;
+}
 
-			sym = malloc(sizeof(*sym));
-			if (sym) {
-				sym->name = name;
-				sym->address = elf_addr;
-				sym->size = elf_sym.st_size;
-				*arg->ret = sym;
-			} else {
-				arg->err = &drgn_enomem;
-			}
-			return DWARF_CB_ABORT;
-		}
+LIBDRGN_PUBLIC void drgn_program_set_memory_cache_size(struct drgn_program *prog,
+						       uint64_t size)
+{
+	uint64_t capacity = size / DRGN_MEMORY_CACHE_PAGE_SIZE;
+
+	drgn_memory_reader_lock(&prog->reader);
+	drgn_memory_reader_set_cache_capacity(&prog->reader,
+					      min(capacity, (uint64_t)SIZE_MAX));
+	/* Decompressed chunks share the memory cache's budget. */
+	if (prog->core_compressed) {
+		capacity = size / DRGN_DECOMPRESSED_CHUNK_SIZE;
+		drgn_compressed_file_set_cache_capacity(prog->core_compressed,
+							min(capacity,
+							    (uint64_t)SIZE_MAX));
 	}
-	return DWARF_CB_OK;
+	drgn_program_invalidate_translations(prog);
+	drgn_program_invalidate_dentry_paths(prog);
+	drgn_memory_reader_unlock(&prog->reader);
 }
 
-LIBDRGN_PUBLIC struct drgn_error *
-drgn_program_find_symbol_by_name(struct drgn_program *prog,
-			const char *name, struct drgn_symbol **ret)
+LIBDRGN_PUBLIC uint64_t
+drgn_program_memory_cache_size(struct drgn_program *prog)
 {
-	struct find_symbol_by_name_arg arg = {
-		.name = name,
-		.ret = ret,
-	};
+	return (uint64_t)prog->reader.cache.capacity *
+	       DRGN_MEMORY_CACHE_PAGE_SIZE;
+}
 
-	if (prog->_dicache &&
-	    dwfl_getmodules(prog->_dicache->dindex.dwfl, find_symbol_by_name_cb,
-			    &arg, 0))
-		return arg.err;
-	return drgn_error_format(DRGN_ERROR_LOOKUP,
-				 "could not find symbol with name '%s'%s", name,
-				 arg.bad_symtabs ?
-				 " (could not get some symbol tables)" : "");
+LIBDRGN_PUBLIC void drgn_program_set_read_limit(struct drgn_program *prog,
+						uint64_t bytes_per_sec,
+						uint64_t reads_per_sec)
+{
+	drgn_memory_reader_set_throttle(&prog->reader, bytes_per_sec,
+					reads_per_sec);
 }
 
-LIBDRGN_PUBLIC struct drgn_error *
-drgn_program_element_info(struct drgn_program *prog, struct drgn_type *type,
-			  struct drgn_element_info *ret)
+LIBDRGN_PUBLIC void drgn_program_read_limit(struct drgn_program *prog,
+					    uint64_t *bytes_per_sec_ret,
+					    uint64_t *reads_per_sec_ret)
 {
-	struct drgn_type *underlying_type;
-	bool is_pointer, is_array;
+	drgn_memory_reader_lock(&prog->reader);
+	*bytes_per_sec_ret = prog->reader.throttle.bytes_per_sec;
+	*reads_per_sec_ret = prog->reader.throttle.reads_per_sec;
+	drgn_memory_reader_unlock(&prog->reader);
+}
 
-	underlying_type = drgn_underlying_type(type);
-	is_pointer = drgn_type_kind(underlying_type) == DRGN_TYPE_POINTER;
-	is_array = drgn_type_kind(underlying_type) == DRGN_TYPE_ARRAY;
-	if (!is_pointer && !is_array)
-		return drgn_type_error("'%s' is not an array or pointer", type);
+LIBDRGN_PUBLIC void
+drgn_program_set_frame_pointer_unwinding(struct drgn_program *prog,
+					 bool enabled)
+{
+	prog->frame_pointer_unwinding = enabled;
+}
 
-	ret->qualified_type = drgn_type_type(underlying_type);
-	return drgn_type_bit_size(ret->qualified_type.type, &ret->bit_size);
+LIBDRGN_PUBLIC bool
+drgn_program_frame_pointer_unwinding(struct drgn_program *prog)
+{
+	return prog->frame_pointer_unwinding;
 }
 
-LIBDRGN_PUBLIC struct drgn_error *
-drgn_program_member_info(struct drgn_program *prog, struct drgn_type *type,
-			 const char *member_name, struct drgn_member_info *ret)
+LIBDRGN_PUBLIC void
+drgn_program_invalidate_memory_cache(struct drgn_program *prog)
 {
-	struct drgn_error *err;
-	struct drgn_member_value *member;
+	drgn_memory_reader_lock(&prog->reader);
+	drgn_memory_reader_invalidate_cache(&prog->reader);
+	if (prog->pid)
+		drgn_memory_process_segment_invalidate(&prog->process_segment);
+	drgn_program_invalidate_translations(prog);
+	drgn_program_invalidate_dentry_paths(prog);
+	drgn_program_invalidate_pids(prog);
+	drgn_memory_reader_unlock(&prog->reader);
+}
 
-	err = drgn_type_index_find_member(&prog->tindex, type, member_name,
-					  strlen(member_name), &member);
-	if (err)
-		return err;
+LIBDRGN_PUBLIC uint64_t drgn_program_epoch(struct drgn_program *prog)
+{
+	if (prog->epoch_interval_ns && (prog->flags & DRGN_PROGRAM_IS_LIVE) &&
+	    monotonic_ns() - prog->epoch_start_ns >= prog->epoch_interval_ns)
+		drgn_program_bump_epoch(prog);
+	return prog->epoch;
+}
 
-	err = drgn_lazy_type_evaluate(member->type, &ret->qualified_type);
-	if (err)
-		return err;
-	ret->bit_offset = member->bit_offset;
-	ret->bit_field_size = member->bit_field_size;
-	return NULL;
+LIBDRGN_PUBLIC void drgn_program_bump_epoch(struct drgn_program *prog)
+{
+	prog->epoch++;
+	prog->epoch_start_ns = monotonic_ns();
+	if (prog->pid) {
+		drgn_memory_reader_lock(&prog->reader);
+		drgn_memory_process_segment_invalidate(&prog->process_segment);
+		drgn_memory_reader_unlock(&prog->reader);
+	}
+	/* Task state characters come from a constant array, so keep them. */
+	free(prog->per_cpu_offsets);
+	prog->per_cpu_offsets = NULL;
+	prog->num_per_cpu_offsets = 0;
+}
+
+LIBDRGN_PUBLIC void drgn_program_set_epoch_interval(struct drgn_program *prog,
+						    uint64_t interval_ns)
+{
+	prog->epoch_interval_ns = interval_ns;
+	prog->epoch_start_ns = monotonic_ns();
+}
+
+LIBDRGN_PUBLIC uint64_t
+drgn_program_epoch_interval(struct drgn_program *prog)
+{
+	return prog->epoch_interval_ns;
+}
+
+LIBDRGN_PUBLIC void drgn_program_prefetch_memory(struct drgn_program *prog,
+						 uint64_t address,
+						 uint64_t size, bool physical)
+{
+	drgn_memory_reader_prefetch_async(&prog->reader, address, size,
+					  physical);
+}
+
+LIBDRGN_PUBLIC void drgn_program_memory_stats(struct drgn_program *prog,
+					     struct drgn_memory_stats *ret)
+{
+	drgn_memory_reader_lock(&prog->reader);
+	*ret = prog->reader.stats;
+	drgn_memory_reader_unlock(&prog->reader);
+}
+
+LIBDRGN_PUBLIC void drgn_program_reset_memory_stats(struct drgn_program *prog)
+{
+	drgn_memory_reader_lock(&prog->reader);
+	memset(&prog->reader.stats, 0, sizeof(prog->reader.stats));
+	drgn_memory_reader_unlock(&prog->reader);
+}
+
+LIBDRGN_PUBLIC void drgn_program_set_profiling(struct drgn_program *prog,
+					       bool enabled)
+{
+	if (enabled && !prog->profile.enabled)
+		memset(&prog->profile.stats, 0, sizeof(prog->profile.stats));
+	prog->profile.enabled = enabled;
+}
+
+LIBDRGN_PUBLIC void drgn_program_profile_stats(struct drgn_program *prog,
+					       struct drgn_profile_stats *ret)
+{
+	*ret = prog->profile.stats;
+}
+
+static size_t drgn_program_symbols_memory_usage(struct drgn_program *prog)
+{
+	size_t size;
+
+	size = (prog->num_symbol_table_entries * sizeof(prog->symbol_table[0]) +
+		drgn_symbol_name_map_memory_usage(&prog->symbol_name_map) +
+		drgn_symbol_set_memory_usage(&prog->interned_symbols) +
+		drgn_arena_memory_usage(&prog->symbol_arena) +
+		drgn_pc_symbol_map_memory_usage(&prog->pc_symbol_cache) +
+		drgn_cfi_rule_map_memory_usage(&prog->cfi_rules));
+	if (prog->kallsyms) {
+		size += (sizeof(*prog->kallsyms) +
+			 drgn_kallsyms_memory_usage(prog->kallsyms));
+	}
+	return size;
+}
+
+LIBDRGN_PUBLIC void drgn_program_memory_usage(struct drgn_program *prog,
+					     struct drgn_memory_usage *ret)
+{
+	struct drgn_dentry_path_map_iterator it;
+	size_t segments, cache;
+
+	memset(ret, 0, sizeof(*ret));
+	if (prog->_dicache) {
+		drgn_program_finish_loading_debug_info(prog);
+		ret->dwarf_index_bytes =
+			drgn_dwarf_index_memory_usage(&prog->_dicache->dindex);
+		ret->dwarf_types_bytes =
+			drgn_dwarf_info_cache_memory_usage(prog->_dicache);
+	}
+	ret->type_index_bytes = drgn_type_index_memory_usage(&prog->tindex);
+	/* Object finders are called with the type index lock held. */
+	drgn_type_index_lock(&prog->tindex);
+	ret->type_index_bytes += drgn_object_index_memory_usage(&prog->oindex);
+	drgn_type_index_unlock(&prog->tindex);
+	ret->symbols_bytes = drgn_program_symbols_memory_usage(prog);
+	if (prog->prstatus_cached) {
+		if (prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL) {
+			ret->prstatus_bytes =
+				drgn_prstatus_vector_memory_usage(&prog->prstatus_vector);
+		} else {
+			ret->prstatus_bytes =
+				drgn_prstatus_map_memory_usage(&prog->prstatus_map);
+		}
+	}
+	ret->prstatus_bytes += prog->prstatus_buf_capacity;
+
+	drgn_memory_reader_lock(&prog->reader);
+	drgn_memory_reader_memory_usage(&prog->reader, &segments, &cache);
+	ret->memory_segments_bytes = segments;
+	ret->memory_cache_bytes =
+		(cache +
+		 drgn_translation_map_memory_usage(&prog->translation_cache) +
+		 drgn_dentry_path_map_memory_usage(&prog->dentry_path_cache));
+	for (it = drgn_dentry_path_map_first(&prog->dentry_path_cache);
+	     it.entry; it = drgn_dentry_path_map_next(it))
+		ret->memory_cache_bytes += it.entry->value.len;
+	if (prog->core_compressed) {
+		ret->memory_cache_bytes +=
+			drgn_compressed_file_memory_usage(prog->core_compressed);
+	}
+	drgn_memory_reader_unlock(&prog->reader);
+}
+
+/* Most strings fit in the first chunk, so don't allocate for that one. */
+DEFINE_SMALL_VECTOR(char_vector, char, DRGN_STRING_CHUNK_SIZE)
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_read_c_string(struct drgn_program *prog, uint64_t address,
+			   bool physical, size_t max_size, char **ret)
+{
+	struct drgn_error *err;
+	struct char_vector str;
+
+	char_vector_init(&str);
+	while (str.size < max_size) {
+		size_t n;
+		char *nul;
+
+		if (!char_vector_reserve(&str,
+					 str.size + min(max_size - str.size,
+							(size_t)DRGN_STRING_CHUNK_SIZE))) {
+			char_vector_deinit(&str);
+			return &drgn_enomem;
+		}
+		err = drgn_memory_reader_read_string_chunk(&prog->reader,
+							   str.data + str.size,
+							   address,
+							   max_size - str.size,
+							   physical, &n);
+		if (err) {
+			char_vector_deinit(&str);
+			return err;
+		}
+		nul = memchr(str.data + str.size, '\0', n);
+		if (nul) {
+			str.size = nul - str.data;
+			break;
+		}
+		str.size += n;
+		address += n;
+	}
+	if (!char_vector_append(&str, &(char){ '\0' }) ||
+	    !char_vector_steal(&str, ret)) {
+		char_vector_deinit(&str);
+		return &drgn_enomem;
+	}
+	return NULL;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_read_u8(struct drgn_program *prog, uint64_t address, bool physical,
+		     uint8_t *ret)
+{
+	return drgn_memory_reader_read(&prog->reader, ret, address,
+				       sizeof(*ret), physical);
+}
+
+/*
+ * Readers and decoders for each byte order and word size, which make up the
+ * drgn_program_ops tables. The byte order and word size are constants in each
+ * instance, so the compiler removes the branches on them.
+ */
+#define HOST_LITTLE_ENDIAN (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+
+#define DEFINE_PROGRAM_READ_U(n, order, bswap)					\
+static struct drgn_error *							\
+drgn_program_read_u##n##_##order(struct drgn_program *prog,			\
+				 uint64_t address, bool physical,		\
+				 uint##n##_t *ret)				\
+{										\
+	struct drgn_error *err;							\
+	uint##n##_t tmp;							\
+										\
+	err = drgn_memory_reader_read(&prog->reader, &tmp, address,		\
+				      sizeof(tmp), physical);			\
+	if (err)								\
+		return err;							\
+	*ret = bswap ? bswap_##n(tmp) : tmp;					\
+	return NULL;								\
+}										\
+										\
+static struct drgn_error *							\
+drgn_program_read_u##n##_array_##order(struct drgn_program *prog,		\
+				       uint64_t address, size_t count,		\
+				       bool physical, uint##n##_t *ret)		\
+{										\
+	struct drgn_error *err;							\
+	size_t size, i;								\
+										\
+	if (__builtin_mul_overflow(count, sizeof(*ret), &size)) {		\
+		return drgn_error_create(DRGN_ERROR_OVERFLOW,			\
+					 "array is too large");			\
+	}									\
+	err = drgn_memory_reader_read(&prog->reader, ret, address, size,	\
+				      physical);				\
+	if (err)								\
+		return err;							\
+	if (bswap) {								\
+		for (i = 0; i < count; i++)					\
+			ret[i] = bswap_##n(ret[i]);				\
+	}									\
+	return NULL;								\
+}										\
+										\
+static uint##n##_t drgn_program_decode_u##n##_##order(const void *buf)		\
+{										\
+	uint##n##_t tmp;							\
+										\
+	memcpy(&tmp, buf, sizeof(tmp));						\
+	return bswap ? bswap_##n(tmp) : tmp;					\
+}
+
+#define DEFINE_PROGRAM_BYTE_ORDER(order, little_endian)				\
+DEFINE_PROGRAM_READ_U(16, order, little_endian != HOST_LITTLE_ENDIAN)		\
+DEFINE_PROGRAM_READ_U(32, order, little_endian != HOST_LITTLE_ENDIAN)		\
+DEFINE_PROGRAM_READ_U(64, order, little_endian != HOST_LITTLE_ENDIAN)		\
+										\
+static uint64_t drgn_program_deserialize_bits_##order(const void *buf,		\
+						      uint64_t bit_offset,	\
+						      uint8_t bit_size)		\
+{										\
+	return deserialize_bits(buf, bit_offset, bit_size, little_endian);	\
+}
+
+DEFINE_PROGRAM_BYTE_ORDER(le, true)
+DEFINE_PROGRAM_BYTE_ORDER(be, false)
+#undef DEFINE_PROGRAM_BYTE_ORDER
+#undef DEFINE_PROGRAM_READ_U
+
+#define DEFINE_PROGRAM_WORD(bits, order)					\
+static struct drgn_error *							\
+drgn_program_read_word_##bits##_##order(struct drgn_program *prog,		\
+					uint64_t address, bool physical,	\
+					uint64_t *ret)				\
+{										\
+	struct drgn_error *err;							\
+	uint##bits##_t tmp;							\
+										\
+	err = drgn_program_read_u##bits##_##order(prog, address, physical,	\
+						  &tmp);			\
+	if (err)								\
+		return err;							\
+	*ret = tmp;								\
+	return NULL;								\
+}										\
+										\
+static struct drgn_error *							\
+drgn_program_read_word_array_##bits##_##order(struct drgn_program *prog,	\
+					      uint64_t address, size_t count,	\
+					      bool physical, uint64_t *ret)	\
+{										\
+	struct drgn_error *err;							\
+	uint32_t *words;							\
+	size_t i;								\
+										\
+	if (bits == 64) {							\
+		return drgn_program_read_u64_array_##order(prog, address,	\
+							   count, physical,	\
+							   ret);		\
+	}									\
+	/*									\
+	 * Read the 32-bit words into the first half of the buffer and widen	\
+	 * them from the end so that nothing is overwritten before it is read.	\
+	 */									\
+	words = (uint32_t *)ret;						\
+	err = drgn_program_read_u32_array_##order(prog, address, count,	\
+						  physical, words);		\
+	if (err)								\
+		return err;							\
+	for (i = count; i-- > 0;)						\
+		ret[i] = words[i];						\
+	return NULL;								\
+}										\
+										\
+static uint64_t drgn_program_decode_word_##bits##_##order(const void *buf)	\
+{										\
+	return drgn_program_decode_u##bits##_##order(buf);			\
+}										\
+										\
+static const struct drgn_program_ops drgn_program_ops_##bits##_##order = {	\
+	.read_u16 = drgn_program_read_u16_##order,				\
+	.read_u32 = drgn_program_read_u32_##order,				\
+	.read_u64 = drgn_program_read_u64_##order,				\
+	.read_word = drgn_program_read_word_##bits##_##order,			\
+	.read_u16_array = drgn_program_read_u16_array_##order,			\
+	.read_u32_array = drgn_program_read_u32_array_##order,			\
+	.read_u64_array = drgn_program_read_u64_array_##order,			\
+	.read_word_array = drgn_program_read_word_array_##bits##_##order,	\
+	.decode_u16 = drgn_program_decode_u16_##order,				\
+	.decode_u32 = drgn_program_decode_u32_##order,				\
+	.decode_u64 = drgn_program_decode_u64_##order,				\
+	.decode_word = drgn_program_decode_word_##bits##_##order,		\
+	.deserialize_bits = drgn_program_deserialize_bits_##order,		\
+};
+
+DEFINE_PROGRAM_WORD(32, le)
+DEFINE_PROGRAM_WORD(32, be)
+DEFINE_PROGRAM_WORD(64, le)
+DEFINE_PROGRAM_WORD(64, be)
+#undef DEFINE_PROGRAM_WORD
+#undef HOST_LITTLE_ENDIAN
+
+static struct drgn_error *drgn_program_unknown_byte_order(void)
+{
+	return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+				 "program byte order is not known");
+}
+
+static struct drgn_error *drgn_program_unknown_word_size(void)
+{
+	return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+				 "program word size is not known");
+}
+
+#define DEFINE_PROGRAM_READ_UNKNOWN(name, type, what)				\
+static struct drgn_error *							\
+drgn_program_read_##name##_unknown(struct drgn_program *prog,			\
+				   uint64_t address, bool physical,		\
+				   type *ret)					\
+{										\
+	return drgn_program_unknown_##what();					\
+}										\
+										\
+static struct drgn_error *							\
+drgn_program_read_##name##_array_unknown(struct drgn_program *prog,		\
+					 uint64_t address, size_t count,	\
+					 bool physical, type *ret)		\
+{										\
+	return drgn_program_unknown_##what();					\
+}
+
+DEFINE_PROGRAM_READ_UNKNOWN(u16, uint16_t, byte_order)
+DEFINE_PROGRAM_READ_UNKNOWN(u32, uint32_t, byte_order)
+DEFINE_PROGRAM_READ_UNKNOWN(u64, uint64_t, byte_order)
+DEFINE_PROGRAM_READ_UNKNOWN(word, uint64_t, word_size)
+#undef DEFINE_PROGRAM_READ_UNKNOWN
+
+static const struct drgn_program_ops drgn_program_ops_unknown = {
+	.read_u16 = drgn_program_read_u16_unknown,
+	.read_u32 = drgn_program_read_u32_unknown,
+	.read_u64 = drgn_program_read_u64_unknown,
+	.read_word = drgn_program_read_word_unknown,
+	.read_u16_array = drgn_program_read_u16_array_unknown,
+	.read_u32_array = drgn_program_read_u32_array_unknown,
+	.read_u64_array = drgn_program_read_u64_array_unknown,
+	.read_word_array = drgn_program_read_word_array_unknown,
+};
+
+static const struct drgn_program_ops *
+drgn_platform_program_ops(const struct drgn_platform *platform)
+{
+	if (!platform)
+		return &drgn_program_ops_unknown;
+	if (platform->flags & DRGN_PLATFORM_IS_64_BIT) {
+		if (platform->flags & DRGN_PLATFORM_IS_LITTLE_ENDIAN)
+			return &drgn_program_ops_64_le;
+		else
+			return &drgn_program_ops_64_be;
+	} else {
+		if (platform->flags & DRGN_PLATFORM_IS_LITTLE_ENDIAN)
+			return &drgn_program_ops_32_le;
+		else
+			return &drgn_program_ops_32_be;
+	}
+}
+
+#define DEFINE_PROGRAM_READ_U(n)						\
+LIBDRGN_PUBLIC struct drgn_error *						\
+drgn_program_read_u##n(struct drgn_program *prog, uint64_t address,		\
+		       bool physical, uint##n##_t *ret)				\
+{										\
+	return prog->ops->read_u##n(prog, address, physical, ret);		\
+}										\
+										\
+LIBDRGN_PUBLIC struct drgn_error *						\
+drgn_program_read_u##n##_array(struct drgn_program *prog, uint64_t address,	\
+			       size_t count, bool physical,			\
+			       uint##n##_t *ret)				\
+{										\
+	return prog->ops->read_u##n##_array(prog, address, count, physical,	\
+					    ret);				\
+}
+
+DEFINE_PROGRAM_READ_U(16)
+DEFINE_PROGRAM_READ_U(32)
+DEFINE_PROGRAM_READ_U(64)
+#undef DEFINE_PROGRAM_READ_U
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_read_word(struct drgn_program *prog, uint64_t address,
+		       bool physical, uint64_t *ret)
+{
+	return prog->ops->read_word(prog, address, physical, ret);
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_read_u8_array(struct drgn_program *prog, uint64_t address,
+			   size_t count, bool physical, uint8_t *ret)
+{
+	return drgn_memory_reader_read(&prog->reader, ret, address, count,
+				       physical);
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_read_word_array(struct drgn_program *prog, uint64_t address,
+			     size_t count, bool physical, uint64_t *ret)
+{
+	return prog->ops->read_word_array(prog, address, count, physical, ret);
+}
+
+static struct drgn_error *
+drgn_program_find_type_impl(struct drgn_program *prog, const char *name,
+			    const char *filename,
+			    struct drgn_qualified_type *ret)
+{
+	struct drgn_error *err;
+	bool loaded, failed;
+
+	drgn_program_finish_loading_debug_info(prog);
+	for (;;) {
+		err = drgn_type_index_find(&prog->tindex, name, filename,
+					   drgn_program_language(prog), ret);
+		if (!err || err->code != DRGN_ERROR_LOOKUP)
+			return err;
+		/* The type may be in a file that we haven't indexed yet. */
+		drgn_type_index_lock(&prog->tindex);
+		failed = (drgn_program_load_deferred_debug_info(prog, true, 0,
+								&loaded) ||
+			  !loaded);
+		drgn_type_index_unlock(&prog->tindex);
+		if (failed)
+			return err;
+		drgn_error_destroy(err);
+	}
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_find_type(struct drgn_program *prog, const char *name,
+		       const char *filename, struct drgn_qualified_type *ret)
+{
+	struct drgn_error *err;
+	uint64_t start_ns;
+
+	start_ns = drgn_profile_begin(&prog->profile);
+	err = drgn_program_find_type_impl(prog, name, filename, ret);
+	drgn_profile_end(&prog->profile, type_finds, start_ns);
+	return err;
+}
+
+LIBDRGN_PUBLIC void
+drgn_program_enable_concurrent_lookups(struct drgn_program *prog)
+{
+	drgn_program_finish_loading_debug_info(prog);
+	drgn_type_index_set_concurrent(&prog->tindex);
+}
+
+static struct drgn_error *
+drgn_program_find_object_impl(struct drgn_program *prog, const char *name,
+			      const char *filename,
+			      enum drgn_find_object_flags flags,
+			      struct drgn_object *ret)
+{
+	struct drgn_error *err;
+	bool loaded;
+
+	if (ret && ret->prog != prog) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "object is from wrong program");
+	}
+	drgn_program_finish_loading_debug_info(prog);
+	/*
+	 * Object finders share the debugging information caches with type
+	 * finders, so they are serialized the same way.
+	 */
+	drgn_type_index_lock(&prog->tindex);
+	for (;;) {
+		err = drgn_object_index_find(&prog->oindex, name, filename,
+					     flags, ret);
+		if (!err || err->code != DRGN_ERROR_LOOKUP)
+			break;
+		if (drgn_program_load_deferred_debug_info(prog, true, 0,
+							  &loaded) ||
+		    !loaded)
+			break;
+		drgn_error_destroy(err);
+	}
+	drgn_type_index_unlock(&prog->tindex);
+	return err;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_find_object(struct drgn_program *prog, const char *name,
+			 const char *filename,
+			 enum drgn_find_object_flags flags,
+			 struct drgn_object *ret)
+{
+	struct drgn_error *err;
+	uint64_t start_ns;
+
+	start_ns = drgn_profile_begin(&prog->profile);
+	err = drgn_program_find_object_impl(prog, name, filename, flags, ret);
+	drgn_profile_end(&prog->profile, object_finds, start_ns);
+	return err;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_for_each_name(struct drgn_program *prog, const char *prefix,
+			   const char *glob, enum drgn_find_name_flags flags,
+			   drgn_name_fn fn, void *arg)
+{
+	struct drgn_error *err;
+
+	if ((flags & ~DRGN_FIND_NAME_ANY) || !flags) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "invalid find name flags");
+	}
+	if (!prog->_dicache)
+		return NULL;
+	drgn_program_finish_loading_debug_info(prog);
+	/* Finders index deferred debugging information with this lock held. */
+	drgn_type_index_lock(&prog->tindex);
+	err = drgn_dwarf_index_for_each_name(&prog->_dicache->dindex, prefix,
+					     glob, flags, fn, arg);
+	drgn_type_index_unlock(&prog->tindex);
+	if (err == &drgn_stop)
+		err = NULL;
+	return err;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_compile_expression(struct drgn_program *prog, const char *expr,
+				const char * const *variables,
+				size_t num_variables,
+				struct drgn_expression **ret)
+{
+	struct drgn_error *err;
+
+	drgn_program_finish_loading_debug_info(prog);
+	/*
+	 * Type lookups while parsing casts call the type finders directly. The
+	 * lock is recursive, so object lookups may take it again.
+	 */
+	drgn_type_index_lock(&prog->tindex);
+	err = drgn_program_language(prog)->compile_expression(prog, expr,
+							      variables,
+							      num_variables,
+							      ret);
+	drgn_type_index_unlock(&prog->tindex);
+	return err;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_expression_evaluate(struct drgn_expression *expr,
+			 const struct drgn_object * const *variables,
+			 struct drgn_object *res)
+{
+	size_t i;
+
+	if (res->prog != expr->prog) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "object is from wrong program");
+	}
+	for (i = 0; i < expr->num_variables; i++) {
+		if (variables[i]->prog != expr->prog) {
+			return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+						 "variable is from wrong program");
+		}
+	}
+	return expr->evaluate(expr, variables, res);
+}
+
+LIBDRGN_PUBLIC void drgn_expression_destroy(struct drgn_expression *expr)
+{
+	if (expr)
+		expr->destroy(expr);
+}
+
+static Dwfl_Module *drgn_program_addrmodule(struct drgn_program *prog,
+					    uint64_t address)
+{
+	struct drgn_error *err;
+	Dwfl_Module *module;
+	bool loaded;
+
+	drgn_program_finish_loading_debug_info(prog);
+	module = dwfl_addrmodule(prog->_dicache->dindex.dwfl, address);
+	if (module)
+		return module;
+	/* The address may be in a file that we haven't indexed yet. */
+	err = drgn_program_load_deferred_debug_info(prog, false, address,
+						    &loaded);
+	if (err) {
+		drgn_error_destroy(err);
+		return NULL;
+	}
+	if (!loaded)
+		return NULL;
+	return dwfl_addrmodule(prog->_dicache->dindex.dwfl, address);
+}
+
+struct drgn_error *drgn_program_get_kallsyms(struct drgn_program *prog,
+					     struct drgn_kallsyms **ret)
+{
+	struct drgn_error *err;
+	struct drgn_kallsyms *kallsyms;
+
+	if (prog->kallsyms) {
+		*ret = prog->kallsyms;
+		return NULL;
+	}
+	if ((prog->flags &
+	     (DRGN_PROGRAM_IS_LINUX_KERNEL | DRGN_PROGRAM_IS_LIVE)) !=
+	    (DRGN_PROGRAM_IS_LINUX_KERNEL | DRGN_PROGRAM_IS_LIVE)) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "/proc/kallsyms is only available for the running kernel");
+	}
+	if (prog->kallsyms_failed) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "could not read /proc/kallsyms");
+	}
+
+	kallsyms = malloc(sizeof(*kallsyms));
+	if (!kallsyms)
+		return &drgn_enomem;
+	err = drgn_kallsyms_init(kallsyms, "/proc/kallsyms");
+	if (err) {
+		free(kallsyms);
+		if (err != &drgn_enomem)
+			prog->kallsyms_failed = true;
+		return err;
+	}
+	*ret = prog->kallsyms = kallsyms;
+	return NULL;
+}
+
+/* Look up a symbol in /proc/kallsyms if it can be read. */
+static const struct drgn_kallsyms_symbol *
+drgn_program_find_kallsyms_symbol(struct drgn_program *prog, const char *name,
+				  uint64_t address)
+{
+	struct drgn_error *err;
+	struct drgn_kallsyms *kallsyms;
+
+	if ((prog->flags &
+	     (DRGN_PROGRAM_IS_LINUX_KERNEL | DRGN_PROGRAM_IS_LIVE)) !=
+	    (DRGN_PROGRAM_IS_LINUX_KERNEL | DRGN_PROGRAM_IS_LIVE))
+		return NULL;
+	err = drgn_program_get_kallsyms(prog, &kallsyms);
+	if (err) {
+		drgn_error_destroy(err);
+		return NULL;
+	}
+	if (name)
+		return drgn_kallsyms_find_by_name(kallsyms, name);
+	return drgn_kallsyms_find_by_address(kallsyms, address);
+}
+
+DEFINE_VECTOR(drgn_symbol_table_entry_vector, struct drgn_symbol_table_entry)
+
+/*
+ * Rank of a symbol binding when several symbols start at the same address.
+ * This matches the preference of dwfl_module_addrinfo().
+ */
+static int symbol_binding_rank(unsigned char binding)
+{
+	switch (binding) {
+	case STB_GLOBAL:
+		return 2;
+	case STB_WEAK:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+struct symbol_table_build_entry {
+	struct drgn_symbol_table_entry entry;
+	int rank;
+};
+
+DEFINE_VECTOR(symbol_table_build_vector, struct symbol_table_build_entry)
+
+static int symbol_table_build_entry_cmp(const void *_a, const void *_b)
+{
+	const struct symbol_table_build_entry *a = _a, *b = _b;
+
+	if (a->entry.start != b->entry.start)
+		return a->entry.start < b->entry.start ? -1 : 1;
+	/* Higher rank first, then larger size first. */
+	if (a->rank != b->rank)
+		return b->rank - a->rank;
+	if (a->entry.size != b->entry.size)
+		return a->entry.size > b->entry.size ? -1 : 1;
+	return 0;
+}
+
+static int symbol_table_add_module(Dwfl_Module *dwfl_module, void **userdatap,
+				   const char *module_name, Dwarf_Addr base,
+				   void *cb_arg)
+{
+	struct symbol_table_build_vector *vec = cb_arg;
+	int symtab_len, i;
+
+	symtab_len = dwfl_module_getsymtab(dwfl_module);
+	for (i = 1; i < symtab_len; i++) {
+		struct symbol_table_build_entry *entry;
+		GElf_Sym elf_sym;
+		GElf_Addr elf_addr;
+		GElf_Word shndx;
+		const char *name;
+		unsigned char type;
+
+		name = dwfl_module_getsym_info(dwfl_module, i, &elf_sym,
+					       &elf_addr, &shndx, NULL, NULL);
+		type = GELF_ST_TYPE(elf_sym.st_info);
+		if (!name || !elf_sym.st_size || shndx == SHN_UNDEF ||
+		    type == STT_SECTION || type == STT_FILE || type == STT_TLS)
+			continue;
+		entry = symbol_table_build_vector_append_entry(vec);
+		if (!entry)
+			return DWARF_CB_ABORT;
+		entry->entry.start = elf_addr;
+		entry->entry.size = elf_sym.st_size;
+		entry->entry.name = name;
+		entry->rank = symbol_binding_rank(GELF_ST_BIND(elf_sym.st_info));
+	}
+	return DWARF_CB_OK;
+}
+
+/*
+ * Build the address-sorted symbol table from all reported modules. If we run
+ * out of memory, the table is left empty and lookups fall back to libdwfl.
+ */
+static void drgn_program_build_symbol_table(struct drgn_program *prog)
+{
+	struct symbol_table_build_vector vec = VECTOR_INIT;
+	struct drgn_symbol_table_entry_vector table = VECTOR_INIT;
+	size_t i;
+
+	prog->symbol_table_built = true;
+	if (dwfl_getmodules(prog->_dicache->dindex.dwfl,
+			    symbol_table_add_module, &vec, 0))
+		goto out;
+	qsort(vec.data, vec.size, sizeof(vec.data[0]),
+	      symbol_table_build_entry_cmp);
+	if (!drgn_symbol_table_entry_vector_reserve(&table, vec.size))
+		goto out;
+	/* Keep the preferred symbol at each address. */
+	for (i = 0; i < vec.size; i++) {
+		if (i && vec.data[i].entry.start == vec.data[i - 1].entry.start)
+			continue;
+		drgn_symbol_table_entry_vector_append(&table,
+						      &vec.data[i].entry);
+	}
+	drgn_symbol_table_entry_vector_shrink_to_fit(&table);
+	prog->symbol_table = table.data;
+	prog->num_symbol_table_entries = table.size;
+	prog->symbol_table_last_hit = 0;
+out:
+	symbol_table_build_vector_deinit(&vec);
+}
+
+/*
+ * Find the symbol table entry containing an address. Symbols nested in or
+ * overlapping a preceding symbol may be missed, so a miss isn't definitive.
+ */
+static const struct drgn_symbol_table_entry *
+drgn_program_symbol_table_lookup(struct drgn_program *prog, uint64_t address)
+{
+	const struct drgn_symbol_table_entry *base;
+	size_t n;
+
+	if (!prog->symbol_table_built)
+		drgn_program_build_symbol_table(prog);
+	n = prog->num_symbol_table_entries;
+	if (!n)
+		return NULL;
+
+	base = &prog->symbol_table[prog->symbol_table_last_hit];
+	if (address - base->start < base->size)
+		return base;
+
+	/* Find the last entry starting at or before the address. */
+	base = prog->symbol_table;
+	while (n > 1) {
+		size_t half = n / 2;
+
+		base = base[half].start <= address ? base + half : base;
+		n -= half;
+	}
+	if (address - base->start >= base->size)
+		return NULL;
+	prog->symbol_table_last_hit = base - prog->symbol_table;
+	return base;
+}
+
+static bool
+drgn_program_find_symbol_by_address_impl(struct drgn_program *prog,
+					 uint64_t address, Dwfl_Module *module,
+					 struct drgn_symbol *ret)
+{
+	const struct drgn_symbol_table_entry *entry;
+	const char *name;
+	GElf_Off offset;
+	GElf_Sym elf_sym;
+
+	const struct drgn_kallsyms_symbol *kallsyms_sym;
+
+	if (!prog->_dicache)
+		goto kallsyms;
+	drgn_program_finish_loading_debug_info(prog);
+	entry = drgn_program_symbol_table_lookup(prog, address);
+	if (entry) {
+		ret->name = entry->name;
+		ret->address = entry->start;
+		ret->size = entry->size;
+		return true;
+	}
+
+	/* Fall back to libdwfl for sizeless and nested symbols. */
+	if (!module) {
+		module = drgn_program_addrmodule(prog, address);
+		if (!module)
+			goto kallsyms;
+	}
+
+	name = dwfl_module_addrinfo(module, address, &offset, &elf_sym, NULL,
+				    NULL, NULL);
+	if (!name)
+		goto kallsyms;
+	ret->name = name;
+	ret->address = address - offset;
+	ret->size = elf_sym.st_size;
+	return true;
+
+kallsyms:
+	/* Finally, try /proc/kallsyms, which covers modules without symbols. */
+	kallsyms_sym = drgn_program_find_kallsyms_symbol(prog, NULL, address);
+	if (!kallsyms_sym)
+		return false;
+	ret->name = kallsyms_sym->name;
+	ret->address = kallsyms_sym->address;
+	ret->size = kallsyms_sym->size;
+	return true;
+}
+
+bool drgn_program_find_symbol_by_address_internal(struct drgn_program *prog,
+						  uint64_t address,
+						  Dwfl_Module *module,
+						  struct drgn_symbol *ret)
+{
+	uint64_t start_ns;
+	bool found;
+
+	DRGN_PROBE(symbol_address_begin, address);
+	start_ns = drgn_profile_begin(&prog->profile);
+	/*
+	 * The symbol tables and libdwfl are built lazily, so symbol lookups are
+	 * serialized like type lookups which need to parse new types.
+	 */
+	drgn_type_index_lock(&prog->tindex);
+	found = drgn_program_find_symbol_by_address_impl(prog, address, module,
+							 ret);
+	drgn_type_index_unlock(&prog->tindex);
+	drgn_profile_end(&prog->profile, symbol_lookups, start_ns);
+	DRGN_PROBE(symbol_address_end, address, found);
+	return found;
+}
+
+struct drgn_error *drgn_error_symbol_not_found(uint64_t address)
+{
+	return drgn_error_format(DRGN_ERROR_LOOKUP,
+				 "could not find symbol containing 0x%" PRIx64,
+				 address);
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_find_symbol_by_address(struct drgn_program *prog, uint64_t address,
+				    struct drgn_symbol **ret)
+{
+	struct drgn_symbol *sym;
+
+	sym = malloc(sizeof(*sym));
+	if (!sym)
+		return &drgn_enomem;
+	if (!drgn_program_find_symbol_by_address_internal(prog, address, NULL,
+							  sym)) {
+		free(sym);
+		return drgn_error_symbol_not_found(address);
+	}
+	*ret = sym;
+	return NULL;
+}
+
+struct drgn_error *
+drgn_program_find_interned_symbol(struct drgn_program *prog, uint64_t address,
+				  Dwfl_Module *module, struct drgn_symbol **ret)
+{
+	struct drgn_error *err = NULL;
+	struct drgn_symbol sym, *key = &sym;
+	struct drgn_symbol_set_iterator it;
+
+	if (!drgn_program_find_symbol_by_address_internal(prog, address, module,
+							  &sym))
+		return drgn_error_symbol_not_found(address);
+	drgn_type_index_lock(&prog->tindex);
+	/* Only allocate the first time we see a symbol. */
+	it = drgn_symbol_set_search(&prog->interned_symbols, &key);
+	if (!it.entry) {
+		struct drgn_arena_mark mark = drgn_arena_mark(&prog->symbol_arena);
+
+		key = drgn_arena_alloc(&prog->symbol_arena, sizeof(*key));
+		if (!key) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		*key = sym;
+		if (drgn_symbol_set_insert(&prog->interned_symbols, &key,
+					   &it) == -1) {
+			drgn_arena_rewind(&prog->symbol_arena, mark);
+			err = &drgn_enomem;
+			goto out;
+		}
+	}
+	*ret = *it.entry;
+out:
+	drgn_type_index_unlock(&prog->tindex);
+	return err;
+}
+
+struct drgn_error *drgn_program_find_pc_symbol(struct drgn_program *prog,
+					       uint64_t pc, Dwfl_Module *module,
+					       struct drgn_symbol **ret)
+{
+	struct drgn_error *err;
+	struct drgn_pc_symbol_map_iterator it;
+	struct drgn_pc_symbol_map_entry entry;
+
+	drgn_type_index_lock(&prog->tindex);
+	it = drgn_pc_symbol_map_search(&prog->pc_symbol_cache, &pc);
+	if (it.entry) {
+		*ret = it.entry->value;
+		err = NULL;
+		goto out;
+	}
+	err = drgn_program_find_interned_symbol(prog, pc, module, &entry.value);
+	if (err) {
+		if (err->code != DRGN_ERROR_LOOKUP)
+			goto out;
+		drgn_error_destroy(err);
+		err = NULL;
+		entry.value = NULL;
+	}
+	/* Don't fail the lookup if we can't cache it. */
+	if (drgn_pc_symbol_map_size(&prog->pc_symbol_cache) >=
+	    DRGN_MAX_CACHED_PC_SYMBOLS)
+		drgn_pc_symbol_map_clear(&prog->pc_symbol_cache);
+	entry.key = pc;
+	drgn_pc_symbol_map_insert(&prog->pc_symbol_cache, &entry, NULL);
+	*ret = entry.value;
+out:
+	drgn_type_index_unlock(&prog->tindex);
+	return err;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_find_symbol_by_address_interned(struct drgn_program *prog,
+					     uint64_t address,
+					     struct drgn_symbol **ret)
+{
+	return drgn_program_find_interned_symbol(prog, address, NULL, ret);
+}
+
+/* Convert the rule for a register to a drgn_cfi_reg_rule if possible. */
+static bool drgn_cfi_reg_rule_from_dwarf(Dwarf_Frame *frame, int regno,
+					 struct drgn_cfi_reg_rule *ret)
+{
+	Dwarf_Op ops_mem[3], *ops;
+	size_t nops, i = 0;
+
+	if (dwarf_frame_register(frame, regno, ops_mem, &ops, &nops))
+		return false;
+	if (nops == 0) {
+		ret->kind = (ops ? DRGN_CFI_REG_UNDEFINED :
+			     DRGN_CFI_REG_SAME_VALUE);
+		ret->value = 0;
+		return true;
+	}
+	if (nops == 1 && ops[0].atom == DW_OP_regx &&
+	    ops[0].number < DRGN_CFI_RULE_MAX_REGS) {
+		ret->kind = DRGN_CFI_REG_REGISTER;
+		ret->value = ops[0].number;
+		return true;
+	}
+	/*
+	 * Offset rules are DW_OP_call_frame_cfa, then DW_OP_plus_uconst if the
+	 * offset is non-zero, then DW_OP_stack_value for value rules.
+	 */
+	if (ops[i++].atom != DW_OP_call_frame_cfa)
+		return false;
+	ret->value = 0;
+	if (i < nops && ops[i].atom == DW_OP_plus_uconst)
+		ret->value = ops[i++].number;
+	if (i < nops && ops[i].atom == DW_OP_stack_value) {
+		ret->kind = DRGN_CFI_REG_CFA_PLUS_OFFSET;
+		i++;
+	} else {
+		ret->kind = DRGN_CFI_REG_AT_CFA_PLUS_OFFSET;
+	}
+	return i == nops;
+}
+
+static void drgn_cfi_rule_from_dwarf(Dwarf_Frame *frame,
+				     struct drgn_cfi_rule *ret)
+{
+	Dwarf_Op *ops;
+	size_t nops;
+	int ra_regno, i;
+
+	ret->simple = false;
+	ra_regno = dwarf_frame_info(frame, NULL, NULL, &ret->signal_frame);
+	if (ra_regno < 0 || ra_regno >= DRGN_CFI_RULE_MAX_REGS)
+		return;
+	ret->ra_regno = ra_regno;
+	/* The only CFA rule that isn't an expression is a register + offset. */
+	if (dwarf_frame_cfa(frame, &ops, &nops) || nops != 1 ||
+	    ops[0].atom != DW_OP_bregx ||
+	    ops[0].number >= DRGN_CFI_RULE_MAX_REGS)
+		return;
+	ret->cfa_regno = ops[0].number;
+	ret->cfa_offset = ops[0].number2;
+	for (i = 0; i < DRGN_CFI_RULE_MAX_REGS; i++) {
+		if (!drgn_cfi_reg_rule_from_dwarf(frame, i, &ret->regs[i]))
+			return;
+	}
+	ret->simple = true;
+}
+
+struct drgn_error *
+drgn_program_find_cfi_rule(struct drgn_program *prog, Dwfl *dwfl, uint64_t pc,
+			   const struct drgn_cfi_rule **ret)
+{
+	struct drgn_cfi_rule_map_iterator it;
+	struct drgn_cfi_rule_map_entry entry;
+	Dwfl_Module *module;
+	Dwarf_CFI *cfi;
+	Dwarf_Addr bias;
+	Dwarf_Frame *frame;
+
+	it = drgn_cfi_rule_map_search(&prog->cfi_rules, &pc);
+	if (it.entry) {
+		*ret = &it.entry->value;
+		return NULL;
+	}
+
+	/*
+	 * Find the CFI the same way that libdwfl does. Program counters without
+	 * CFI aren't cached, since it may be loaded later.
+	 */
+	*ret = NULL;
+	module = dwfl_addrmodule(dwfl, pc);
+	if (!module)
+		return NULL;
+	cfi = dwfl_module_eh_cfi(module, &bias);
+	if (!cfi || dwarf_cfi_addrframe(cfi, pc - bias, &frame)) {
+		cfi = dwfl_module_dwarf_cfi(module, &bias);
+		if (!cfi || dwarf_cfi_addrframe(cfi, pc - bias, &frame))
+			return NULL;
+	}
+	entry.key = pc;
+	drgn_cfi_rule_from_dwarf(frame, &entry.value);
+	free(frame);
+	if (drgn_cfi_rule_map_insert(&prog->cfi_rules, &entry, &it) == -1)
+		return &drgn_enomem;
+	*ret = &it.entry->value;
+	return NULL;
+}
+
+struct symbolize_entry {
+	uint64_t address;
+	size_t index;
+};
+
+static int symbolize_entry_cmp(const void *_a, const void *_b)
+{
+	const struct symbolize_entry *a = _a, *b = _b;
+
+	if (a->address != b->address)
+		return a->address < b->address ? -1 : 1;
+	return 0;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_symbolize(struct drgn_program *prog, const uint64_t *addresses,
+		       size_t count, size_t *indices_ret,
+		       struct drgn_symbol ***symbols_ret,
+		       size_t *num_symbols_ret)
+{
+	struct drgn_error *err;
+	struct symbolize_entry *entries;
+	struct drgn_symbol **symbols = NULL;
+	size_t num_symbols = 0, capacity = 0;
+	size_t i, index = SIZE_MAX;
+
+	entries = malloc_array(count, sizeof(*entries));
+	if (!entries && count)
+		return &drgn_enomem;
+	for (i = 0; i < count; i++) {
+		entries[i].address = addresses[i];
+		entries[i].index = i;
+	}
+	qsort(entries, count, sizeof(*entries), symbolize_entry_cmp);
+
+	for (i = 0; i < count; i++) {
+		struct drgn_symbol *sym;
+
+		/* Duplicate addresses get the same answer. */
+		if (i > 0 && entries[i].address == entries[i - 1].address)
+			goto set_index;
+		err = drgn_program_find_pc_symbol(prog, entries[i].address,
+						  NULL, &sym);
+		if (err)
+			goto err;
+		if (!sym) {
+			index = SIZE_MAX;
+			goto set_index;
+		}
+		/*
+		 * Since the addresses are sorted, addresses in the same symbol
+		 * are usually adjacent, and interned symbols can be compared
+		 * by pointer.
+		 */
+		if (num_symbols && symbols[num_symbols - 1] == sym) {
+			index = num_symbols - 1;
+			goto set_index;
+		}
+		if (num_symbols == capacity) {
+			struct drgn_symbol **tmp;
+
+			capacity = capacity ? capacity * 2 : 16;
+			tmp = realloc(symbols, capacity * sizeof(*symbols));
+			if (!tmp) {
+				err = &drgn_enomem;
+				goto err;
+			}
+			symbols = tmp;
+		}
+		symbols[num_symbols] = sym;
+		index = num_symbols++;
+set_index:
+		indices_ret[entries[i].index] = index;
+	}
+	free(entries);
+	*symbols_ret = symbols;
+	*num_symbols_ret = num_symbols;
+	return NULL;
+
+err:
+	free(symbols);
+	free(entries);
+	return err;
+}
+
+struct source_lines_module {
+	struct drgn_dwfl_module_userdata *userdata;
+	Dwarf *dwarf;
+	Dwarf_Addr bias;
+};
+
+DEFINE_VECTOR(source_lines_module_vector, struct source_lines_module)
+
+static struct drgn_dwfl_module_userdata *
+source_lines_userdata(Dwfl *dwfl, uint64_t address, Dwfl_Module **module_ret)
+{
+	Dwfl_Module *module;
+	void **userdatap;
+
+	module = dwfl_addrmodule(dwfl, address);
+	if (!module)
+		return NULL;
+	dwfl_module_info(module, &userdatap, NULL, NULL, NULL, NULL, NULL,
+			 NULL);
+	if (module_ret)
+		*module_ret = module;
+	return *userdatap;
+}
+
+/*
+ * Build the line tables of all of the modules containing the given addresses
+ * that haven't been built yet. libdw isn't safe to use from multiple threads
+ * for the same Dwarf handle, so each module's table is built by one thread.
+ */
+static struct drgn_error *
+drgn_program_load_line_tables(Dwfl *dwfl, const uint64_t *addresses,
+			      size_t count)
+{
+	struct drgn_error *err = NULL;
+	struct source_lines_module_vector modules = VECTOR_INIT;
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		Dwfl_Module *module;
+		struct drgn_dwfl_module_userdata *userdata;
+		struct source_lines_module *entry;
+
+		userdata = source_lines_userdata(dwfl, addresses[i], &module);
+		if (!userdata || userdata->lines_loaded)
+			continue;
+		/* This also marks the module so that it is only added once. */
+		userdata->lines_loaded = true;
+		entry = source_lines_module_vector_append_entry(&modules);
+		if (!entry) {
+			err = &drgn_enomem;
+			userdata->lines_loaded = false;
+			goto out;
+		}
+		entry->userdata = userdata;
+		/* This may apply relocations, so it isn't done in parallel. */
+		entry->dwarf = dwfl_module_getdwarf(module, &entry->bias);
+	}
+
+	#pragma omp parallel for schedule(dynamic) \
+		num_threads(drgn_num_threads())
+	for (i = 0; i < modules.size; i++) {
+		struct drgn_error *module_err;
+
+		if (err || !modules.data[i].dwarf)
+			continue;
+		module_err = drgn_line_table_create(modules.data[i].dwarf,
+						    modules.data[i].bias,
+						    &modules.data[i].userdata->lines);
+		if (module_err == &drgn_enomem) {
+			#pragma omp critical(drgn_program_load_line_tables)
+			err = module_err;
+		} else if (module_err) {
+			/* Treat the module as not having line information. */
+			drgn_error_destroy(module_err);
+		}
+	}
+
+out:
+	/* Modules that weren't built because of an error can be retried. */
+	if (err) {
+		for (i = 0; i < modules.size; i++) {
+			if (!modules.data[i].userdata->lines)
+				modules.data[i].userdata->lines_loaded = false;
+		}
+	}
+	source_lines_module_vector_deinit(&modules);
+	return err;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_source_lines(struct drgn_program *prog, const uint64_t *addresses,
+			  size_t count, struct drgn_source_location *ret)
+{
+	struct drgn_error *err;
+	Dwfl *dwfl;
+	size_t i;
+
+	err = drgn_program_get_dwfl(prog, &dwfl);
+	if (err)
+		return err;
+	/* The line tables are built lazily like the symbol tables. */
+	drgn_type_index_lock(&prog->tindex);
+	err = drgn_program_load_line_tables(dwfl, addresses, count);
+	if (err)
+		goto out;
+	for (i = 0; i < count; i++) {
+		struct drgn_dwfl_module_userdata *userdata;
+		const struct drgn_line_table_entry *entry = NULL;
+
+		userdata = source_lines_userdata(dwfl, addresses[i], NULL);
+		if (userdata && userdata->lines)
+			entry = drgn_line_table_find(userdata->lines,
+						     addresses[i]);
+		if (entry && entry->filename) {
+			ret[i].filename = entry->filename;
+			ret[i].line = entry->line;
+			ret[i].column = entry->column;
+		} else {
+			ret[i].filename = NULL;
+			ret[i].line = 0;
+			ret[i].column = 0;
+		}
+	}
+out:
+	drgn_type_index_unlock(&prog->tindex);
+	return err;
+}
+
+static int symbol_name_map_add_module(Dwfl_Module *dwfl_module,
+				      void **userdatap,
+				      const char *module_name, Dwarf_Addr base,
+				      void *cb_arg)
+{
+	struct drgn_program *prog = cb_arg;
+	int symtab_len, i;
+
+	symtab_len = dwfl_module_getsymtab(dwfl_module);
+	i = dwfl_module_getsymtab_first_global(dwfl_module);
+	if (symtab_len == -1 || i == -1) {
+		prog->symbol_name_map_bad_symtabs = true;
+		return DWARF_CB_OK;
+	}
+	for (; i < symtab_len; i++) {
+		struct drgn_symbol_name_map_entry entry;
+		GElf_Sym elf_sym;
+		GElf_Addr elf_addr;
+
+		entry.key = dwfl_module_getsym_info(dwfl_module, i, &elf_sym,
+						    &elf_addr, NULL, NULL,
+						    NULL);
+		if (!entry.key)
+			continue;
+		entry.value.start = elf_addr;
+		entry.value.size = elf_sym.st_size;
+		entry.value.name = entry.key;
+		/* Like a linear search, the first symbol with a name wins. */
+		if (drgn_symbol_name_map_insert(&prog->symbol_name_map, &entry,
+						NULL) == -1)
+			return DWARF_CB_ABORT;
+	}
+	return DWARF_CB_OK;
+}
+
+static struct drgn_error *
+drgn_program_build_symbol_name_map(struct drgn_program *prog)
+{
+	if (dwfl_getmodules(prog->_dicache->dindex.dwfl,
+			    symbol_name_map_add_module, prog, 0)) {
+		drgn_symbol_name_map_clear(&prog->symbol_name_map);
+		prog->symbol_name_map_bad_symtabs = false;
+		return &drgn_enomem;
+	}
+	prog->symbol_name_map_built = true;
+	return NULL;
+}
+
+static struct drgn_error *
+drgn_program_find_symbol_by_name_impl(struct drgn_program *prog,
+				      const char *name,
+				      struct drgn_symbol **ret)
+{
+	struct drgn_error *err;
+	const struct drgn_kallsyms_symbol *kallsyms_sym;
+	bool loaded;
+
+	drgn_program_finish_loading_debug_info(prog);
+	do {
+		if (prog->_dicache) {
+			struct drgn_symbol_name_map_iterator it;
+			struct drgn_symbol *sym;
+
+			if (!prog->symbol_name_map_built) {
+				err = drgn_program_build_symbol_name_map(prog);
+				if (err)
+					return err;
+			}
+			it = drgn_symbol_name_map_search(&prog->symbol_name_map,
+							 &name);
+			if (it.entry) {
+				sym = malloc(sizeof(*sym));
+				if (!sym)
+					return &drgn_enomem;
+				sym->name = it.entry->value.name;
+				sym->address = it.entry->value.start;
+				sym->size = it.entry->value.size;
+				*ret = sym;
+				return NULL;
+			}
+		}
+		err = drgn_program_load_deferred_debug_info(prog, true, 0,
+							    &loaded);
+		if (err)
+			return err;
+	} while (loaded);
+	kallsyms_sym = drgn_program_find_kallsyms_symbol(prog, name, 0);
+	if (kallsyms_sym) {
+		struct drgn_symbol *sym;
+
+		sym = malloc(sizeof(*sym));
+		if (!sym)
+			return &drgn_enomem;
+		sym->name = kallsyms_sym->name;
+		sym->address = kallsyms_sym->address;
+		sym->size = kallsyms_sym->size;
+		*ret = sym;
+		return NULL;
+	}
+	return drgn_error_format(DRGN_ERROR_LOOKUP,
+				 "could not find symbol with name '%s'%s", name,
+				 prog->symbol_name_map_bad_symtabs ?
+				 " (could not get some symbol tables)" : "");
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_find_symbol_by_name(struct drgn_program *prog,
+			const char *name, struct drgn_symbol **ret)
+{
+	struct drgn_error *err;
+	uint64_t start_ns;
+
+	DRGN_PROBE(symbol_name_begin, name);
+	start_ns = drgn_profile_begin(&prog->profile);
+	drgn_type_index_lock(&prog->tindex);
+	err = drgn_program_find_symbol_by_name_impl(prog, name, ret);
+	drgn_type_index_unlock(&prog->tindex);
+	drgn_profile_end(&prog->profile, symbol_lookups, start_ns);
+	DRGN_PROBE(symbol_name_end, name, err ? err->code : 0);
+	return err;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_element_info(struct drgn_program *prog, struct drgn_type *type,
+			  struct drgn_element_info *ret)
+{
+	struct drgn_type *underlying_type;
+	bool is_pointer, is_array;
+
+	underlying_type = drgn_underlying_type(type);
+	is_pointer = drgn_type_kind(underlying_type) == DRGN_TYPE_POINTER;
+	is_array = drgn_type_kind(underlying_type) == DRGN_TYPE_ARRAY;
+	if (!is_pointer && !is_array)
+		return drgn_type_error("'%s' is not an array or pointer", type);
+
+	ret->qualified_type = drgn_type_type(underlying_type);
+	return drgn_type_bit_size(ret->qualified_type.type, &ret->bit_size);
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_member_info(struct drgn_program *prog, struct drgn_type *type,
+			 const char *member_name, struct drgn_member_info *ret)
+{
+	struct drgn_error *err;
+	struct drgn_member_value member;
+
+	err = drgn_type_index_find_member(&prog->tindex, type, member_name,
+					  strlen(member_name), &member);
+	if (err)
+		return err;
+
+	err = drgn_lazy_type_evaluate(member.type, &ret->qualified_type);
+	if (err)
+		return err;
+	ret->bit_offset = member.bit_offset;
+	ret->bit_field_size = member.bit_field_size;
+	return NULL;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_member_path(struct drgn_program *prog, struct drgn_type *type,
+			 const char *member_designator,
+			 struct drgn_member_info *ret)
+{
+	const struct drgn_language *lang =
+		drgn_language_or_default(drgn_type_language(type));
+
+	return lang->member_path(prog, type, member_designator, ret);
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_find_enumerator(struct drgn_program *prog, struct drgn_type *type,
+			     uint64_t value,
+			     const struct drgn_type_enumerator **ret)
+{
+	struct drgn_error *err;
+
+	type = drgn_underlying_type(type);
+	if (drgn_type_kind(type) != DRGN_TYPE_ENUM) {
+		return drgn_type_error("'%s' is not an enumerated type",
+				       type);
+	}
+	if (!drgn_type_is_complete(type))
+		return drgn_type_error("'%s' is incomplete", type);
+	err = drgn_type_index_find_enumerator(&prog->tindex, type, value, ret);
+	if (err == &drgn_not_found) {
+		*ret = NULL;
+		return NULL;
+	}
+	return err;
 }
@@ -17,10 +17,13 @@
 #include <libkdumpfile/kdumpfile.h>
 #endif
 
+#include "arena.h"
 #include "hash_table.h"
 #include "memory_reader.h"
 #include "object_index.h"
 #include "platform.h"
+#include "profile.h"
+#include "remote.h"
 #include "type_index.h"
 #include "vector.h"
 
@@ -34,6 +37,14 @@
  * @{
  */
 
+/** Default size of the memory read cache for core dumps. */
+#define DRGN_DEFAULT_CORE_DUMP_MEMORY_CACHE_SIZE (UINT64_C(16) * 1024 * 1024)
+
+/** Number of size classes of value buffers cached by a @ref drgn_program. */
+#define DRGN_VALUE_BUFFER_NUM_CLASSES 9
+/** Maximum number of free value buffers cached in each size class. */
+#define DRGN_VALUE_BUFFER_MAX_FREE 64
+
 /** The important parts of the VMCOREINFO note of a Linux kernel core. */
 struct vmcoreinfo {
 	/** <tt>uname -r</tt> */
@@ -54,18 +65,260 @@ struct vmcoreinfo {
 	bool pgtable_l5_enabled;
 };
 
-DEFINE_VECTOR_TYPE(drgn_prstatus_vector, struct string)
-DEFINE_HASH_MAP_TYPE(drgn_prstatus_map, uint32_t, struct string)
+/*
+ * Location of an NT_PRSTATUS note. Notes from libkdumpfile are already in
+ * memory. Notes in an ELF core dump are only indexed by their offset in the
+ * file and read when they are needed, since a core dump of a process with many
+ * threads can have a lot of them.
+ */
+struct drgn_prstatus_location {
+	/* Note data, or NULL if it is in the core dump file. */
+	const char *data;
+	/* Offset of the note data in the core dump file if data is NULL. */
+	uint64_t offset;
+	size_t size;
+	/* Thread ID of the note. */
+	uint32_t tid;
+};
+
+/*
+ * File mapped by a userspace program, from the NT_FILE note of its core dump.
+ * Core dumps usually omit file-backed mappings that were never written to, so
+ * those are read from the file instead. The file is opened and mapped the first
+ * time it is read.
+ */
+struct drgn_core_mapped_file {
+	/* Path in the NT_FILE note, which is kept as long as the program. */
+	const char *path;
+	/*
+	 * Build ID found in the ELF headers in the core dump. If this is
+	 * non-empty, the file is only used if it has the same build ID.
+	 */
+	void *build_id;
+	size_t build_id_len;
+	bool opened;
+	/* Mapping of the file, or NULL if it couldn't be opened or used. */
+	const char *map;
+	size_t size;
+};
+
+/* Memory segment of a userspace core dump which is read from a mapped file. */
+struct drgn_core_mapped_file_segment {
+	struct drgn_core_mapped_file *file;
+	/* Offset in the file of the start of the segment. */
+	uint64_t file_offset;
+};
+
+DEFINE_VECTOR_TYPE(drgn_prstatus_vector, struct drgn_prstatus_location)
+DEFINE_HASH_MAP_TYPE(drgn_prstatus_map, uint32_t,
+		     struct drgn_prstatus_location)
+
+/* Key of a cached address translation for linux_helper_read_vm(). */
+struct drgn_translation_key {
+	/* Page table root. */
+	uint64_t pgtable;
+	/* Virtual address of the start of the mapping. */
+	uint64_t virt_addr;
+	/* Base 2 logarithm of the size of the mapping. */
+	unsigned int shift;
+};
+
+/* Map from translation key to the physical address of the mapping. */
+DEFINE_HASH_MAP_TYPE(drgn_translation_map, struct drgn_translation_key,
+		     uint64_t)
+
+/*
+ * Key of a cached path for linux_helper_d_path() and
+ * linux_helper_dentry_path().
+ */
+struct drgn_dentry_path_key {
+	/*
+	 * Address of the struct mount, or 0 for a path relative to the root of
+	 * the filesystem.
+	 */
+	uint64_t mnt;
+	/* Address of the struct dentry. */
+	uint64_t dentry;
+};
+
+/* Map from dentry path key to the path, which is allocated with malloc(). */
+DEFINE_HASH_MAP_TYPE(drgn_dentry_path_map, struct drgn_dentry_path_key,
+		     struct string)
+
+/* Entry in the address-sorted symbol table. */
+struct drgn_symbol_table_entry {
+	uint64_t start;
+	uint64_t size;
+	/* Owned by libdwfl. */
+	const char *name;
+};
+
+/*
+ * Map from symbol name to the first global symbol with that name, for
+ * drgn_program_find_symbol_by_name().
+ */
+DEFINE_HASH_MAP_TYPE(drgn_symbol_name_map, const char *,
+		     struct drgn_symbol_table_entry)
+
+/*
+ * Set of interned symbols, compared by name pointer, address, and size. See
+ * drgn_program_find_symbol_by_address_interned().
+ */
+DEFINE_HASH_SET_TYPE(drgn_symbol_set, struct drgn_symbol *)
+
+/*
+ * Map from program counter to the interned symbol containing it, or NULL if
+ * there is none. See drgn_program_find_pc_symbol().
+ */
+DEFINE_HASH_MAP_TYPE(drgn_pc_symbol_map, uint64_t, struct drgn_symbol *)
+
+/* Kind of rule for recovering a register from DWARF CFI. */
+enum drgn_cfi_reg_rule_kind {
+	/* The register can't be recovered. */
+	DRGN_CFI_REG_UNDEFINED,
+	/* The register has the same value as in the current frame. */
+	DRGN_CFI_REG_SAME_VALUE,
+	/* The register is saved at the CFA plus an offset. */
+	DRGN_CFI_REG_AT_CFA_PLUS_OFFSET,
+	/* The register's value is the CFA plus an offset. */
+	DRGN_CFI_REG_CFA_PLUS_OFFSET,
+	/* The register's value is in another register. */
+	DRGN_CFI_REG_REGISTER,
+};
+
+struct drgn_cfi_reg_rule {
+	/* @ref drgn_cfi_reg_rule_kind. */
+	uint8_t kind;
+	/* Offset or register number, depending on the kind. */
+	int64_t value;
+};
+
+/*
+ * Maximum number of registers in a cached CFI rule: the x86-64 general purpose
+ * registers and the return address.
+ */
+#define DRGN_CFI_RULE_MAX_REGS 17
+
+/*
+ * DWARF CFI unwinding rules at a program counter, extracted once so that
+ * unwinding the same program counter again doesn't have to find and interpret
+ * the FDE. See drgn_program_find_cfi_rule().
+ */
+struct drgn_cfi_rule {
+	/*
+	 * Whether the rules could be represented. If not (e.g., they use DWARF
+	 * expressions), the CFI must be interpreted by libdwfl every time.
+	 */
+	bool simple;
+	bool signal_frame;
+	/* The CFA is the value of this register plus cfa_offset. */
+	uint8_t cfa_regno;
+	uint8_t ra_regno;
+	int64_t cfa_offset;
+	struct drgn_cfi_reg_rule regs[DRGN_CFI_RULE_MAX_REGS];
+};
+
+DEFINE_HASH_MAP_TYPE(drgn_cfi_rule_map, uint64_t, struct drgn_cfi_rule)
+
+struct drgn_btf;
+
+/* BTF read from a struct btf in the kernel by linux_helper_btf(). */
+struct drgn_kernel_btf {
+	/* Address and size of the raw BTF data when it was read. */
+	uint64_t data, data_size;
+	struct drgn_btf *btf;
+};
+
+/*
+ * Map from the address of a struct btf to the BTF most recently read from it.
+ * The BTF is owned by drgn_program::kernel_btf_list.
+ */
+DEFINE_HASH_MAP_TYPE(drgn_kernel_btf_map, uint64_t, struct drgn_kernel_btf)
+
+DEFINE_VECTOR_TYPE(drgn_btf_vector, struct drgn_btf *)
+
+/* Key of a PID cached by linux_helper_cache_pids(). */
+struct drgn_pid_cache_key {
+	/* Address of the struct pid_namespace. */
+	uint64_t ns;
+	/* PID number in the namespace. */
+	uint64_t nr;
+};
+
+/* Addresses of the struct pid and its PIDTYPE_PID task (or 0). */
+struct drgn_cached_pid {
+	uint64_t pid, task;
+};
+
+DEFINE_HASH_MAP_TYPE(drgn_pid_cache, struct drgn_pid_cache_key,
+		     struct drgn_cached_pid)
+/* Set of PID namespace addresses which are in a drgn_pid_cache. */
+DEFINE_HASH_SET_TYPE(drgn_pid_ns_set, uint64_t)
+
+/**
+ * Memory readers and integer decoders specialized for the word size and byte
+ * order of a @ref drgn_program.
+ *
+ * There is one table for each combination of word size and byte order, plus one
+ * for programs whose platform isn't known yet, whose readers return an error
+ * and whose decoders are @c NULL. @ref drgn_program_set_platform() chooses the
+ * table once so that the read and decode paths don't check the platform on
+ * every call.
+ */
+struct drgn_program_ops {
+	struct drgn_error *(*read_u16)(struct drgn_program *prog,
+				       uint64_t address, bool physical,
+				       uint16_t *ret);
+	struct drgn_error *(*read_u32)(struct drgn_program *prog,
+				       uint64_t address, bool physical,
+				       uint32_t *ret);
+	struct drgn_error *(*read_u64)(struct drgn_program *prog,
+				       uint64_t address, bool physical,
+				       uint64_t *ret);
+	struct drgn_error *(*read_word)(struct drgn_program *prog,
+					uint64_t address, bool physical,
+					uint64_t *ret);
+	struct drgn_error *(*read_u16_array)(struct drgn_program *prog,
+					     uint64_t address, size_t count,
+					     bool physical, uint16_t *ret);
+	struct drgn_error *(*read_u32_array)(struct drgn_program *prog,
+					     uint64_t address, size_t count,
+					     bool physical, uint32_t *ret);
+	struct drgn_error *(*read_u64_array)(struct drgn_program *prog,
+					     uint64_t address, size_t count,
+					     bool physical, uint64_t *ret);
+	struct drgn_error *(*read_word_array)(struct drgn_program *prog,
+					      uint64_t address, size_t count,
+					      bool physical, uint64_t *ret);
+	/** Decode a 16-bit integer in the program's byte order. */
+	uint16_t (*decode_u16)(const void *buf);
+	/** Decode a 32-bit integer in the program's byte order. */
+	uint32_t (*decode_u32)(const void *buf);
+	/** Decode a 64-bit integer in the program's byte order. */
+	uint64_t (*decode_u64)(const void *buf);
+	/** Decode a pointer-sized integer in the program's byte order. */
+	uint64_t (*decode_word)(const void *buf);
+	/**
+	 * @ref deserialize_bits() in the program's byte order.
+	 */
+	uint64_t (*deserialize_bits)(const void *buf, uint64_t bit_offset,
+				     uint8_t bit_size);
+};
 
 struct drgn_dwarf_info_cache;
+struct drgn_kallsyms;
 struct drgn_dwarf_index;
+struct string_builder;
 
 struct drgn_program {
 	/** @privatesection */
 	struct drgn_memory_reader reader;
 	struct drgn_type_index tindex;
 	struct drgn_object_index oindex;
+	struct drgn_profile profile;
 	struct drgn_memory_file_segment *file_segments;
+	/* Used instead of file_segments for running processes. */
+	struct drgn_memory_process_segment process_segment;
 	/* Default language of the program. */
 	const struct drgn_language *lang;
 	/*
@@ -78,8 +331,19 @@ struct drgn_program {
 	uint64_t vmemmap;
 	/* Cached THREAD_SIZE. */
 	uint64_t thread_size;
+	/* Cached __per_cpu_offset, or NULL if it hasn't been read yet. */
+	uint64_t *per_cpu_offsets;
+	size_t num_per_cpu_offsets;
 #ifdef WITH_LIBKDUMPFILE
 	kdump_ctx_t *kdump_ctx;
+	/* Clones of kdump_ctx for reading from multiple threads. */
+	kdump_ctx_t **kdump_clones;
+	int num_kdump_clones;
+	/*
+	 * Bitmap of the PFNs whose pages are in the dump, or NULL if
+	 * libkdumpfile doesn't provide it.
+	 */
+	kdump_bmp_t *kdump_pagemap;
 #endif
 	/*
 	 * Valid iff <tt>!(flags & DRGN_PROGRAM_IS_LIVE)</tt>, unless the file
@@ -87,6 +351,30 @@ struct drgn_program {
 	 */
 	Elf *core;
 	int core_fd;
+	/*
+	 * Read-only mapping of the entire core file, or NULL if it is not
+	 * mapped. Only used for ELF core dumps of non-live programs.
+	 */
+	void *core_map;
+	size_t core_map_size;
+	/*
+	 * Decompressed contents of the core file, or NULL if it is not
+	 * compressed. In that case, core is opened on core_headers, a
+	 * decompressed prefix of the file covering the ELF headers and notes,
+	 * instead of on core_fd.
+	 */
+	struct drgn_compressed_file *core_compressed;
+	char *core_headers;
+	/*
+	 * Files backing mappings omitted from a userspace core dump and the
+	 * segments read from them. Only accessed with the memory reader's lock
+	 * held, since they are read from memory reads.
+	 */
+	struct drgn_core_mapped_file *core_mapped_files;
+	size_t num_core_mapped_files;
+	struct drgn_core_mapped_file_segment *core_mapped_file_segments;
+	/* Connection to a remote target, or NULL if the program isn't remote. */
+	struct drgn_remote *remote;
 	 /*
 	  * Valid iff
 	  * <tt>(flags & (DRGN_PROGRAM_IS_LINUX_KERNEL | DRGN_PROGRAM_IS_LIVE)) ==
@@ -94,6 +382,25 @@ struct drgn_program {
 	  */
 	pid_t pid;
 	struct drgn_dwarf_info_cache *_dicache;
+	/** Type information from BTF, if it was loaded. */
+	struct drgn_btf *btf;
+	/*
+	 * BTF read from the kernel's memory by linux_helper_btf(). Types parsed
+	 * from it may be referenced by the type index, so it is kept until the
+	 * program is destroyed even if the struct btf it was read from changes.
+	 * These are protected by the memory reader's lock.
+	 */
+	struct drgn_kernel_btf_map kernel_btfs;
+	struct drgn_btf_vector kernel_btf_list;
+	/*
+	 * PIDs cached by linux_helper_cache_pids() and the namespaces they are
+	 * cached for. These are only built on request, so unlike
+	 * dentry_path_cache, they are kept regardless of the memory cache size
+	 * until the memory cache is invalidated. They are protected by the
+	 * memory reader's lock.
+	 */
+	struct drgn_pid_cache pid_cache;
+	struct drgn_pid_ns_set pid_cache_namespaces;
 	union {
 		/*
 		 * For the Linux kernel, PRSTATUS notes indexed by CPU. See @ref
@@ -104,16 +411,44 @@ struct drgn_program {
 		/* For userspace programs, PRSTATUS notes indexed by PID. */
 		struct drgn_prstatus_map prstatus_map;
 	};
+	/*
+	 * Buffer for NT_PRSTATUS notes read from the core dump file that
+	 * aren't in core_map. See drgn_program_read_prstatus().
+	 */
+	char *prstatus_buf;
+	size_t prstatus_buf_capacity;
 	/* See @ref drgn_object_stack_trace(). */
 	struct drgn_error *stack_trace_err;
 	/* See @ref drgn_object_stack_trace_next_thread(). */
 	const struct drgn_object *stack_trace_obj;
 	uint32_t stack_trace_tid;
+	/*
+	 * Bounds of the stack of the thread being unwound, or 0 if they are
+	 * unknown.
+	 */
+	uint64_t stack_trace_stack_start, stack_trace_stack_end;
+	/*
+	 * Memory read while unwinding the current thread: the whole stack if
+	 * its bounds are known, otherwise the page most recently read. See
+	 * drgn_stack_trace_read_word().
+	 */
+	char *stack_trace_buf;
+	uint64_t stack_trace_buf_address;
+	size_t stack_trace_buf_size, stack_trace_buf_capacity;
+	/*
+	 * Whether stack_trace_buf is a snapshot of the stack of a thread in a
+	 * live process that must not be replaced while unwinding.
+	 */
+	bool stack_trace_snapshot;
 	enum drgn_program_flags flags;
 	struct drgn_platform platform;
+	/* Chosen by drgn_program_set_platform(). Never NULL. */
+	const struct drgn_program_ops *ops;
 	bool has_platform;
 	bool attached_dwfl_state;
 	bool prstatus_cached;
+	/* See @ref drgn_program_set_frame_pointer_unwinding(). */
+	bool frame_pointer_unwinding;
 	/*
 	 * Whether @ref drgn_program::pgtable_it is currently being used. Used
 	 * to prevent address translation from recursing.
@@ -122,11 +457,184 @@ struct drgn_program {
 
 	/* Page table iterator for linux_helper_read_vm(). */
 	struct pgtable_iterator *pgtable_it;
+	/*
+	 * Address translations cached by linux_helper_read_vm(). These are only
+	 * used while the memory read cache is enabled, and are discarded along
+	 * with it. Like pgtable_it, these are protected by the memory reader's
+	 * lock.
+	 */
+	struct drgn_translation_map translation_cache;
+	/* Bit n is set if translation_cache has a mapping of size 2^n. */
+	uint64_t translation_cache_shifts;
+	/*
+	 * Paths cached by linux_helper_d_path() and linux_helper_dentry_path().
+	 * Like translation_cache, these are only used while the memory read
+	 * cache is enabled, are discarded along with it, and are protected by
+	 * the memory reader's lock.
+	 */
+	struct drgn_dentry_path_map dentry_path_cache;
+	/*
+	 * Recently freed value buffers, as free lists by size class. These are
+	 * protected by value_buffers_lock. See @ref drgn_value_buffer_alloc().
+	 */
+	pthread_mutex_t value_buffers_lock;
+	void *value_buffers[DRGN_VALUE_BUFFER_NUM_CLASSES];
+	unsigned int num_value_buffers[DRGN_VALUE_BUFFER_NUM_CLASSES];
+	/*
+	 * Whether drgn_program_load_debug_info_async() is indexing in the
+	 * background.
+	 */
+	bool loading_debug_info;
+	/*
+	 * Result of the last background load, returned by
+	 * drgn_program_wait_for_debug_info().
+	 */
+	struct drgn_error *debug_info_err;
+	/* Set by drgn_program_set_debug_info_progress(). */
+	drgn_debug_info_progress_fn *debug_info_progress_fn;
+	void *debug_info_progress_arg;
+	/*
+	 * ELF files shared with other programs, or NULL. Set by
+	 * drgn_program_share_debug_info().
+	 */
+	struct drgn_shared_debug_info *shared_debug_info;
+	/*
+	 * Whether the loaded kernel modules haven't been listed yet because
+	 * $DRGN_LAZY_KERNEL_MODULES is 2. They are registered as deferred
+	 * modules by the first drgn_program_load_deferred_debug_info().
+	 */
+	bool kernel_modules_pending;
+	/*
+	 * Sized symbols of all reported modules sorted by address, built on
+	 * the first lookup by address and discarded whenever modules are
+	 * reported. See @ref drgn_program_find_symbol_by_address_internal().
+	 */
+	struct drgn_symbol_table_entry *symbol_table;
+	size_t num_symbol_table_entries;
+	/* Index of the entry that the last lookup found. */
+	size_t symbol_table_last_hit;
+	bool symbol_table_built;
+	/*
+	 * Global symbols of all reported modules by name, built on the first
+	 * lookup by name and discarded along with symbol_table.
+	 */
+	struct drgn_symbol_name_map symbol_name_map;
+	bool symbol_name_map_built;
+	/* Whether some symbol tables couldn't be read for symbol_name_map. */
+	bool symbol_name_map_bad_symtabs;
+	/*
+	 * Symbols returned by lookups by address, which live as long as the
+	 * program. Unlike symbol_table, these aren't discarded when modules
+	 * are reported, since the names are still valid. They are allocated
+	 * from symbol_arena.
+	 */
+	struct drgn_symbol_set interned_symbols;
+	struct drgn_arena symbol_arena;
+	/* Symbols by program counter found by drgn_program_find_pc_symbol(). */
+	struct drgn_pc_symbol_map pc_symbol_cache;
+	/*
+	 * Unwinding rules by program counter, which live as long as the
+	 * program since loaded CFI never changes.
+	 */
+	struct drgn_cfi_rule_map cfi_rules;
+	/*
+	 * Parsed /proc/kallsyms for the running kernel, or NULL if it hasn't
+	 * been read yet. See @ref drgn_program_get_kallsyms().
+	 */
+	struct drgn_kallsyms *kallsyms;
+	/* Whether reading /proc/kallsyms failed, so we shouldn't retry. */
+	bool kallsyms_failed;
 	/* Cache for @ref linux_helper_task_state_to_char(). */
 	char *task_state_chars;
 	uint64_t task_report;
+	/*
+	 * Memory replayed from a trace by drgn_program_set_memory_trace(), or
+	 * NULL. The trace's memory segments point into this buffer.
+	 */
+	char *memory_trace_buf;
+	/* See @ref drgn_program_epoch(). */
+	uint64_t epoch;
+	/* Interval between automatic epoch increments, or 0 if disabled. */
+	uint64_t epoch_interval_ns;
+	/* monotonic_ns() when the epoch was last incremented. */
+	uint64_t epoch_start_ns;
 };
 
+/*
+ * Look up a cached translation of a virtual address in a page table. If found,
+ * returns the start and size of the mapping containing @p virt_addr and the
+ * physical address it is mapped to.
+ */
+bool drgn_program_find_translation(struct drgn_program *prog, uint64_t pgtable,
+				   uint64_t virt_addr,
+				   uint64_t *start_virt_addr_ret,
+				   uint64_t *size_ret,
+				   uint64_t *start_phys_addr_ret);
+
+/*
+ * Cache the translation of a virtual address range in a page table. The size
+ * must be a power of two, and the virtual address must be aligned to it.
+ * Failing to cache the translation is not an error.
+ */
+void drgn_program_cache_translation(struct drgn_program *prog,
+				    uint64_t pgtable, uint64_t start_virt_addr,
+				    uint64_t size, uint64_t start_phys_addr);
+
+/*
+ * Look up the cached path of a dentry and append it to a string builder. If @p
+ * mnt is 0, the path is relative to the root of the filesystem.
+ *
+ * @param[out] found_ret Returned whether the path was cached.
+ * @return @c false if appending to the string builder failed, @c true
+ * otherwise.
+ */
+bool drgn_program_find_dentry_path(struct drgn_program *prog, uint64_t mnt,
+				   uint64_t dentry, struct string_builder *sb,
+				   bool *found_ret);
+
+/*
+ * Cache the path of a dentry. Failing to cache the path is not an error.
+ */
+void drgn_program_cache_dentry_path(struct drgn_program *prog, uint64_t mnt,
+				    uint64_t dentry, const char *path,
+				    size_t len);
+
+/*
+ * Find the BTF cached for a struct btf if its raw data is still at the same
+ * address with the same size.
+ *
+ * @return The BTF, or @c NULL if it is not cached.
+ */
+struct drgn_btf *drgn_program_find_kernel_btf(struct drgn_program *prog,
+					      uint64_t address, uint64_t data,
+					      uint64_t data_size);
+
+/*
+ * Cache the BTF read from a struct btf. This takes ownership of the BTF, even
+ * on error.
+ */
+struct drgn_error *drgn_program_cache_kernel_btf(struct drgn_program *prog,
+						 uint64_t address,
+						 uint64_t data,
+						 uint64_t data_size,
+						 struct drgn_btf *btf);
+
+/*
+ * Look up a PID in the cache built by linux_helper_cache_pids().
+ *
+ * @param[out] ret Returned PID and task. Both are 0 if the namespace is cached
+ * but the PID is not in it.
+ * @return Whether the namespace is cached.
+ */
+bool drgn_program_find_cached_pid(struct drgn_program *prog, uint64_t ns,
+				  uint64_t nr, struct drgn_cached_pid *ret);
+
+/* Replace the cached PIDs of a namespace with the given entries for it. */
+struct drgn_error *
+drgn_program_cache_pids(struct drgn_program *prog, uint64_t ns,
+			const struct drgn_pid_cache_entry *entries,
+			size_t num_entries);
+
 /** Initialize a @ref drgn_program. */
 void drgn_program_init(struct drgn_program *prog,
 		       const struct drgn_platform *platform);
@@ -141,6 +649,13 @@ void drgn_program_deinit(struct drgn_program *prog);
 void drgn_program_set_platform(struct drgn_program *prog,
 			       const struct drgn_platform *platform);
 
+/**
+ * Return an error if the memory of a @ref drgn_program was already initialized
+ * (e.g., by @ref drgn_program_set_core_dump()).
+ */
+struct drgn_error *
+drgn_program_check_initialized(struct drgn_program *prog);
+
 /**
  * Implement @ref drgn_program_from_core_dump() on an initialized @ref
  * drgn_program.
@@ -181,6 +696,28 @@ static inline bool drgn_program_is_64_bit(struct drgn_program *prog)
 	return prog->platform.flags & DRGN_PLATFORM_IS_64_BIT;
 }
 
+/**
+ * Decode a pointer-sized integer from a buffer in the byte order of a @ref
+ * drgn_program. The program's platform must be known.
+ */
+static inline uint64_t drgn_program_decode_word(struct drgn_program *prog,
+						const void *buf)
+{
+	return prog->ops->decode_word(buf);
+}
+
+/**
+ * Like @ref deserialize_bits() in the byte order of a @ref drgn_program. The
+ * program's platform must be known.
+ */
+static inline uint64_t drgn_program_deserialize_bits(struct drgn_program *prog,
+						     const void *buf,
+						     uint64_t bit_offset,
+						     uint8_t bit_size)
+{
+	return prog->ops->deserialize_bits(buf, bit_offset, bit_size);
+}
+
 struct drgn_error *drgn_program_get_dwfl(struct drgn_program *prog, Dwfl **ret);
 
 /**
@@ -189,7 +726,9 @@ struct drgn_error *drgn_program_get_dwfl(struct drgn_program *prog, Dwfl **ret);
  * This is only valid for the Linux kernel.
  *
  * @param[out] ret Returned note data. If not found, <tt>ret->str</tt> is set to
- * @c NULL and <tt>ret->len</tt> is set to zero.
+ * @c NULL and <tt>ret->len</tt> is set to zero. This may be read from the core
+ * dump file into a buffer which is only valid until the next call to this or
+ * @ref drgn_program_find_prstatus_by_tid().
  * @param[out] tid_ret Returned thread ID of note.
  */
 struct drgn_error *drgn_program_find_prstatus_by_cpu(struct drgn_program *prog,
@@ -203,12 +742,37 @@ struct drgn_error *drgn_program_find_prstatus_by_cpu(struct drgn_program *prog,
  * This is only valid for userspace programs.
  *
  * @param[out] ret Returned note data. If not found, <tt>ret->str</tt> is set to
- * @c NULL and <tt>ret->len</tt> is set to zero.
+ * @c NULL and <tt>ret->len</tt> is set to zero. Like @ref
+ * drgn_program_find_prstatus_by_cpu(), this is only valid until the next
+ * call.
  */
 struct drgn_error *drgn_program_find_prstatus_by_tid(struct drgn_program *prog,
 						     uint32_t tid,
 						     struct string *ret);
 
+/**
+ * Get the thread IDs of all of the @c NT_PRSTATUS notes, sorted.
+ *
+ * This is only valid for userspace programs.
+ *
+ * @param[out] ret Returned array of thread IDs, which must be freed with @c
+ * free().
+ * @param[out] count_ret Returned number of thread IDs.
+ */
+struct drgn_error *drgn_program_prstatus_tids(struct drgn_program *prog,
+					      uint32_t **ret,
+					      size_t *count_ret);
+
+/**
+ * Get the IDs of all of the threads of a live userspace process, sorted.
+ *
+ * @param[out] ret Returned array of thread IDs, which must be freed with @c
+ * free().
+ * @param[out] count_ret Returned number of thread IDs.
+ */
+struct drgn_error *drgn_program_live_tids(struct drgn_program *prog,
+					  uint32_t **ret, size_t *count_ret);
+
 /**
  * Cache the @c NT_PRSTATUS note provided by @p data in @p prog.
  *
@@ -219,6 +783,43 @@ struct drgn_error *drgn_program_cache_prstatus_entry(struct drgn_program *prog,
                                                      const char *data,
 						     size_t size);
 
+/**
+ * Wait for debugging information being indexed in the background by @ref
+ * drgn_program_load_debug_info_async(), if any.
+ *
+ * The result is saved for @ref drgn_program_wait_for_debug_info().
+ */
+void drgn_program_finish_loading_debug_info(struct drgn_program *prog);
+
+/**
+ * Index debugging information which was deferred while loading it.
+ *
+ * This does nothing if debugging information is currently being loaded.
+ * Missing debugging information is ignored.
+ *
+ * If @p all is @c true and there are no deferred files left, this indexes the
+ * split DWARF files of indexed skeleton units instead.
+ *
+ * @param[in] all Whether to index all deferred files. If @c false, only the
+ * file containing @p address is indexed.
+ * @param[in] address Address to look up if @p all is @c false.
+ * @param[out] loaded_ret Whether any deferred files or split units were
+ * indexed.
+ */
+struct drgn_error *
+drgn_program_load_deferred_debug_info(struct drgn_program *prog, bool all,
+				      uint64_t address, bool *loaded_ret);
+
+/**
+ * Get the parsed @c /proc/kallsyms of the running kernel, reading it if
+ * necessary.
+ *
+ * This returns an error for programs other than the running kernel and if the
+ * file couldn't be read or doesn't contain addresses.
+ */
+struct drgn_error *drgn_program_get_kallsyms(struct drgn_program *prog,
+					     struct drgn_kallsyms **ret);
+
 /*
  * Like @ref drgn_program_find_symbol_by_address(), but @p ret is already
  * allocated, we may already know the module, and doesn't return a @ref
@@ -233,6 +834,39 @@ bool drgn_program_find_symbol_by_address_internal(struct drgn_program *prog,
 						  Dwfl_Module *module,
 						  struct drgn_symbol *ret);
 
+/*
+ * Find the interned symbol containing a program counter, using a per-program
+ * cache so that looking up the same address again (e.g., for a function that
+ * many threads are sleeping in) is cheap.
+ *
+ * @param[in] module Module containing @p pc, or @c NULL if not known.
+ * @param[out] ret Returned symbol, or @c NULL if no symbol contains @p pc.
+ */
+struct drgn_error *drgn_program_find_pc_symbol(struct drgn_program *prog,
+					       uint64_t pc, Dwfl_Module *module,
+					       struct drgn_symbol **ret);
+
+/*
+ * Get the cached DWARF CFI unwinding rules for a program counter, extracting
+ * them from the CFI of the module containing it if they haven't been cached
+ * yet.
+ *
+ * @param[in] pc Program counter, already adjusted for return addresses.
+ * @param[out] ret Returned rules, or @c NULL if there is no CFI covering @p pc.
+ * This is only valid until the next call.
+ */
+struct drgn_error *
+drgn_program_find_cfi_rule(struct drgn_program *prog, Dwfl *dwfl, uint64_t pc,
+			   const struct drgn_cfi_rule **ret);
+
+/*
+ * Like @ref drgn_program_find_symbol_by_address_interned(), but we may already
+ * know the module.
+ */
+struct drgn_error *
+drgn_program_find_interned_symbol(struct drgn_program *prog, uint64_t address,
+				  Dwfl_Module *module, struct drgn_symbol **ret);
+
 /** @} */
 
 #endif /* DRGN_PROGRAM_H */
@@ -53,6 +53,11 @@ typedef struct {
 	 * alive, so we store it here.
 	 */
 	PyObject *attr_cache;
+	/*
+	 * Whether this is the canonical wrapper of a type owned by the
+	 * Program in parent. See DrgnType_wrap().
+	 */
+	bool interned;
 	/*
 	 * A Type object can wrap a struct drgn_type created elsewhere, or it
 	 * can have an embedded struct drgn_type. In the latter case, type
@@ -83,18 +88,88 @@ typedef struct {
 	uint64_t length, index;
 } ObjectIterator;
 
+/*
+ * Lazy value of a compound or array object, as returned by
+ * Object.value_(lazy=True).
+ */
+typedef struct {
+	PyObject_HEAD
+	DrgnObject *obj;
+	/* Only used for arrays. */
+	uint64_t length, element_bit_size;
+} ObjectValueProxy;
+
 typedef struct {
 	PyObject_HEAD
 	struct drgn_platform *platform;
 } Platform;
 
+/*
+ * Map from interned symbol to its Symbol wrapper. The map doesn't hold a
+ * reference; a Symbol removes itself when it is deallocated.
+ */
+DEFINE_HASH_MAP_TYPE(symbol_wrapper_map, struct drgn_symbol *, PyObject *)
+
+/*
+ * Map from qualified type to its Type wrapper. Like symbol_wrapper_map, this
+ * doesn't hold a reference; a Type removes itself when it is deallocated.
+ */
+DEFINE_HASH_MAP_TYPE(type_wrapper_map, struct drgn_qualified_type, PyObject *)
+
+/*
+ * Member found by Object.__getattr__(), keyed by the type of the object and the
+ * interned attribute name. Types are kept alive by the program, so the type
+ * pointer is stable; the entry holds a reference to the name.
+ */
+struct drgnpy_member_cache_entry {
+	struct drgn_type *type;
+	PyObject *name;
+	struct drgn_qualified_type member_type;
+	uint64_t bit_offset, bit_field_size;
+	/* Whether the object is a pointer to the compound type. */
+	bool dereference;
+};
+
+#define DRGNPY_MEMBER_CACHE_SIZE 256
+
 typedef struct {
 	PyObject_HEAD
 	struct drgn_program prog;
 	PyObject *objects;
 	PyObject *cache;
+	PyObject *debug_info_progress;
+	struct symbol_wrapper_map symbol_wrappers;
+	struct type_wrapper_map type_wrappers;
+	/* Identifier used in pickles, or 0 if not assigned yet. */
+	uint64_t pickle_id;
+	/* Map from type name to Type for unpickled types, or NULL. */
+	PyObject *unpickled_types;
+	/*
+	 * Map from (expression, variable names) to a capsule containing the
+	 * compiled struct drgn_expression for Program.eval(), or NULL.
+	 */
+	PyObject *expressions;
+	/*
+	 * Recursive lock held by calls which run with the GIL released. See
+	 * Program_begin_blocking().
+	 */
+	pthread_mutex_t blocking_lock;
+	/*
+	 * Direct-mapped cache for Object.__getattr__(), protected by the GIL.
+	 * See DrgnObject_getattro().
+	 */
+	struct drgnpy_member_cache_entry member_cache[DRGNPY_MEMBER_CACHE_SIZE];
 } Program;
 
+static inline struct drgnpy_member_cache_entry *
+Program_member_cache_entry(Program *prog, struct drgn_type *type,
+			   PyObject *name)
+{
+	uintptr_t hash = ((uintptr_t)type >> 4) * 31 + ((uintptr_t)name >> 4);
+
+	return &prog->member_cache[hash % DRGNPY_MEMBER_CACHE_SIZE];
+}
+
 typedef struct {
 	PyObject_HEAD
 	Program *prog;
@@ -107,12 +182,52 @@ typedef struct {
 	struct drgn_stack_frame frame;
 } StackFrame;
 
+typedef struct {
+	PyObject_HEAD
+	struct drgn_pointer_index *index;
+} PointerIndex;
+
+typedef struct {
+	PyObject_HEAD
+	struct drgn_memory_hashes *hashes;
+} MemoryHashes;
+
+/* How to decode a watched object from its bytes. */
+struct drgnpy_watch_item {
+	struct drgn_qualified_type qualified_type;
+	/* 0 if the object is not a bit field. */
+	uint64_t bit_field_size;
+	uint8_t bit_offset;
+	bool little_endian;
+};
+
+typedef struct {
+	PyObject_HEAD
+	Program *prog;
+	struct drgn_watch *watch;
+	struct drgnpy_watch_item *items;
+} Watch;
+
 typedef struct {
 	PyObject_HEAD
 	Program *prog;
 	struct drgn_symbol *sym;
+	/* Whether sym is interned and owned by prog rather than by us. */
+	bool interned;
 } Symbol;
 
+typedef struct {
+	PyObject_HEAD
+	Program *prog;
+	/* Type containing the member. */
+	PyObject *container_type;
+	/* Member designator string. */
+	PyObject *designator;
+	/* Wrapped info.qualified_type. */
+	PyObject *type;
+	struct drgn_member_info info;
+} MemberPath;
+
 typedef struct {
 	PyObject_HEAD
 	PyObject *name;
@@ -155,6 +270,7 @@ typedef struct {
 } TypeParameter;
 
 extern PyObject *Architecture_class;
+extern PyObject *FindNameFlags_class;
 extern PyObject *FindObjectFlags_class;
 extern PyObject *PlatformFlags_class;
 extern PyObject *PrimitiveType_class;
@@ -166,8 +282,18 @@ extern PyTypeObject DrgnObject_type;
 extern PyTypeObject DrgnType_type;
 extern PyTypeObject FaultError_type;
 extern PyTypeObject Language_type;
+extern PyTypeObject LinuxHelperIterator_type;
+extern PyTypeObject LinuxHelperRadixTreeIterator_type;
+extern PyTypeObject LinuxHelperVmTranslation_type;
+extern PyTypeObject MappedMemory_type;
+extern PyTypeObject MemberPath_type;
+extern PyTypeObject MemoryHashes_type;
+extern PyTypeObject MemorySearchIterator_type;
 extern PyTypeObject ObjectIterator_type;
+extern PyTypeObject ObjectValueMapping_type;
+extern PyTypeObject ObjectValueSequence_type;
 extern PyTypeObject Platform_type;
+extern PyTypeObject PointerIndex_type;
 extern PyTypeObject Program_type;
 extern PyTypeObject Register_type;
 extern PyTypeObject StackFrame_type;
@@ -176,6 +302,7 @@ extern PyTypeObject Symbol_type;
 extern PyTypeObject TypeEnumerator_type;
 extern PyTypeObject TypeMember_type;
 extern PyTypeObject TypeParameter_type;
+extern PyTypeObject Watch_type;
 extern PyObject *MissingDebugInfoError;
 extern PyObject *OutOfBoundsError;
 
@@ -192,17 +319,7 @@ PyObject *Language_wrap(const struct drgn_language *language);
 int language_converter(PyObject *o, void *p);
 int add_languages(void);
 
-static inline DrgnObject *DrgnObject_alloc(Program *prog)
-{
-	DrgnObject *ret;
-
-	ret = (DrgnObject *)DrgnObject_type.tp_alloc(&DrgnObject_type, 0);
-	if (ret) {
-		drgn_object_init(&ret->obj, &prog->prog);
-		Py_INCREF(prog);
-	}
-	return ret;
-}
+DrgnObject *DrgnObject_alloc(Program *prog);
 static inline Program *DrgnObject_prog(DrgnObject *obj)
 {
 	return container_of(obj->obj.prog, Program, prog);
@@ -212,6 +329,12 @@ DrgnObject *cast(PyObject *self, PyObject *args, PyObject *kwds);
 DrgnObject *reinterpret(PyObject *self, PyObject *args, PyObject *kwds);
 DrgnObject *DrgnObject_container_of(PyObject *self, PyObject *args,
 				    PyObject *kwds);
+PyObject *format_objects(PyObject *self, PyObject *args, PyObject *kwds);
+
+PyObject *MemberPath_wrap(Program *prog,
+			  struct drgn_qualified_type container_type,
+			  PyObject *designator,
+			  const struct drgn_member_info *info);
 
 PyObject *Platform_wrap(const struct drgn_platform *platform);
 
@@ -221,7 +344,27 @@ Program *program_from_core_dump(PyObject *self, PyObject *args, PyObject *kwds);
 Program *program_from_kernel(PyObject *self);
 Program *program_from_pid(PyObject *self, PyObject *args, PyObject *kwds);
 
+PyObject *PointerIndex_wrap(struct drgn_pointer_index *index);
+
+PyObject *MemoryHashes_wrap(struct drgn_memory_hashes *hashes);
+
+PyObject *Watch_wrap(Program *prog, struct drgn_watch *watch,
+		     struct drgnpy_watch_item *items);
+
 PyObject *Symbol_wrap(struct drgn_symbol *sym, Program *prog);
+PyObject *Symbol_wrap_interned(struct drgn_symbol *sym, Program *prog);
+void Program_init_symbol_wrappers(Program *prog);
+PyThreadState *Program_begin_blocking(Program *prog);
+void Program_end_blocking(Program *prog, PyThreadState *state);
+void Program_deinit_symbol_wrappers(Program *prog);
+void Program_init_type_wrappers(Program *prog);
+void Program_deinit_type_wrappers(Program *prog);
+PyObject *Program_unpickled_type(Program *prog, PyObject *name);
+
+PyObject *drgnpy_unpickle_func(const char *name);
+PyObject *drgnpy_unpickle_program(PyObject *self, PyObject *args);
+PyObject *drgnpy_unpickle_type(PyObject *self, PyObject *args);
+DrgnObject *drgnpy_unpickle_object(PyObject *self, PyObject *args);
 
 static inline PyObject *DrgnType_parent(DrgnType *type)
 {
@@ -280,6 +423,58 @@ struct path_arg {
 int path_converter(PyObject *o, void *p);
 void path_cleanup(struct path_arg *path);
 
+/*
+ * Flags for a method taking (self, args, nargs, kwnames). Python 3.6 passed
+ * keywords to every METH_FASTCALL method; Python 3.7 made that opt-in.
+ */
+#if PY_VERSION_HEX >= 0x03070000
+#define DRGNPY_METH_FASTCALL (METH_FASTCALL | METH_KEYWORDS)
+#else
+#define DRGNPY_METH_FASTCALL METH_FASTCALL
+#endif
+
+#define DRGNPY_ARG_PARSER_MAX_ARGS 8
+
+/*
+ * Argument parser for hot methods, which avoids the format string parsing and
+ * keyword dictionary of PyArg_ParseTupleAndKeywords(). Define one statically
+ * per function; the keyword names are interned the first time that it is used.
+ */
+struct drgnpy_arg_parser {
+	/* Function name for error messages. */
+	const char *fname;
+	/* NULL-terminated names of all arguments, in positional order. */
+	const char * const *keywords;
+	/* Number of leading arguments which are required. */
+	int min_args;
+	/*
+	 * Number of leading arguments which may be passed positionally. The
+	 * rest are keyword-only.
+	 */
+	int max_positional;
+	/* Number of keywords and their interned names, or 0 if not set up. */
+	int num_keywords;
+	PyObject *interned[DRGNPY_ARG_PARSER_MAX_ARGS];
+};
+
+/*
+ * Sort the arguments of a call into argument order. Keyword arguments are
+ * passed either as the names in kwnames with values after the positional
+ * arguments (for METH_FASTCALL and vectorcall) or in a dictionary (for classic
+ * calls). ret must have room for every keyword of the parser; arguments which
+ * weren't passed are set to NULL. The returned references are borrowed.
+ */
+int drgnpy_parse_args(struct drgnpy_arg_parser *parser, PyObject *const *args,
+		      Py_ssize_t nargs, PyObject *kwnames, PyObject *kwds,
+		      PyObject **ret);
+
+/*
+ * Convert argument i parsed by drgnpy_parse_args() to a string, like the "s"
+ * format unit.
+ */
+const char *drgnpy_str_arg(const struct drgnpy_arg_parser *parser, int i,
+			   PyObject *o);
+
 struct enum_arg {
 	PyObject *type;
 	unsigned long value;
@@ -289,6 +484,8 @@ int enum_converter(PyObject *o, void *p);
 
 PyObject *drgnpy_linux_helper_read_vm(PyObject *self, PyObject *args,
 				      PyObject *kwds);
+PyObject *drgnpy_linux_helper_vm_translation(PyObject *self, PyObject *args,
+					     PyObject *kwds);
 DrgnObject *drgnpy_linux_helper_radix_tree_lookup(PyObject *self,
 						  PyObject *args,
 						  PyObject *kwds);
@@ -304,5 +501,86 @@ PyObject *drgnpy_linux_helper_task_state_to_char(PyObject *self, PyObject *args,
 						 PyObject *kwds);
 PyObject *drgnpy_linux_helper_pgtable_l5_enabled(PyObject *self, PyObject *args,
 						 PyObject *kwds);
+PyObject *drgnpy_linux_helper_list_for_each(PyObject *self, PyObject *args,
+					    PyObject *kwds);
+PyObject *drgnpy_linux_helper_list_for_each_entry(PyObject *self,
+						  PyObject *args,
+						  PyObject *kwds);
+PyObject *drgnpy_linux_helper_hlist_for_each(PyObject *self, PyObject *args,
+					     PyObject *kwds);
+PyObject *drgnpy_linux_helper_hlist_for_each_entry(PyObject *self,
+						   PyObject *args,
+						   PyObject *kwds);
+PyObject *drgnpy_linux_helper_rbtree_inorder_for_each(PyObject *self,
+						      PyObject *args,
+						      PyObject *kwds);
+PyObject *drgnpy_linux_helper_rbtree_inorder_for_each_entry(PyObject *self,
+							    PyObject *args,
+							    PyObject *kwds);
+DrgnObject *drgnpy_linux_helper_rb_find(PyObject *self, PyObject *args,
+					PyObject *kwds);
+PyObject *drgnpy_linux_helper_radix_tree_for_each(PyObject *self,
+						  PyObject *args,
+						  PyObject *kwds);
+PyObject *drgnpy_linux_helper_idr_for_each(PyObject *self, PyObject *args,
+					   PyObject *kwds);
+PyObject *drgnpy_linux_helper_for_each_pid(PyObject *self, PyObject *args,
+					   PyObject *kwds);
+PyObject *drgnpy_linux_helper_for_each_task(PyObject *self, PyObject *args,
+					    PyObject *kwds);
+PyObject *drgnpy_linux_helper_for_each_page(PyObject *self, PyObject *args,
+					    PyObject *kwds);
+PyObject *drgnpy_linux_helper_page_pfns(PyObject *self, PyObject *args,
+					PyObject *kwds);
+DrgnObject *drgnpy_linux_helper_per_cpu_ptr(PyObject *self, PyObject *args,
+					    PyObject *kwds);
+PyObject *drgnpy_linux_helper_per_cpu_ptrs(PyObject *self, PyObject *args,
+					   PyObject *kwds);
+PyObject *drgnpy_linux_helper_percpu_sum(PyObject *self, PyObject *args,
+					 PyObject *kwds);
+PyObject *
+drgnpy_linux_helper_slab_cache_for_each_allocated_object(PyObject *self,
+							 PyObject *args,
+							 PyObject *kwds);
+PyObject *drgnpy_linux_helper_d_path(PyObject *self, PyObject *args,
+				     PyObject *kwds);
+PyObject *drgnpy_linux_helper_dentry_path(PyObject *self, PyObject *args,
+					  PyObject *kwds);
+PyObject *drgnpy_linux_helper_task_snapshot(PyObject *self, PyObject *args,
+					    PyObject *kwds);
+PyObject *drgnpy_linux_helper_task_args(PyObject *self, PyObject *args,
+					PyObject *kwds);
+PyObject *drgnpy_linux_helper_ftrace_events(PyObject *self, PyObject *args,
+					    PyObject *kwds);
+PyObject *drgnpy_linux_helper_sock_table(PyObject *self, PyObject *args,
+					 PyObject *kwds);
+PyObject *drgnpy_linux_helper_sb_inodes(PyObject *self, PyObject *args,
+					PyObject *kwds);
+PyObject *drgnpy_linux_helper_cgroup_walk(PyObject *self, PyObject *args,
+					  PyObject *kwds);
+PyObject *drgnpy_linux_helper_btf_type_name(PyObject *self, PyObject *args,
+					    PyObject *kwds);
+PyObject *drgnpy_linux_helper_btf_type(PyObject *self, PyObject *args,
+				       PyObject *kwds);
+PyObject *drgnpy_linux_helper_blk_mq_inflight(PyObject *self, PyObject *args,
+					      PyObject *kwds);
+PyObject *drgnpy_linux_helper_filter_tasks(PyObject *self, PyObject *args,
+					   PyObject *kwds);
+PyObject *drgnpy_linux_helper_cache_pids(PyObject *self, PyObject *args,
+					 PyObject *kwds);
+PyObject *drgnpy_linux_helper_pending_timers(PyObject *self, PyObject *args,
+					     PyObject *kwds);
+PyObject *drgnpy_linux_helper_page_owner_stacks(PyObject *self, PyObject *args,
+						PyObject *kwds);
+PyObject *drgnpy_linux_helper_runqueues(PyObject *self, PyObject *args,
+					PyObject *kwds);
+PyObject *drgnpy_linux_helper_task_rss(PyObject *self, PyObject *args,
+				       PyObject *kwds);
+PyObject *drgnpy_linux_helper_memcg_usage(PyObject *self, PyObject *args,
+					  PyObject *kwds);
+PyObject *drgnpy_linux_helper_vmalloc_areas(PyObject *self, PyObject *args,
+					    PyObject *kwds);
+PyObject *drgnpy_glibc_helper_malloc_walk(PyObject *self, PyObject *args,
+					  PyObject *kwds);
 
 #endif /* DRGNPY_H */
@@ -2,7 +2,10 @@
 // SPDX-License-Identifier: GPL-3.0+
 
 #include "drgnpy.h"
+#include "../btf.h"
+#include "../error.h"
 #include "../helpers.h"
+#include "../vector.h"
 
 PyObject *drgnpy_linux_helper_read_vm(PyObject *self, PyObject *args,
 				      PyObject *kwds)
@@ -28,8 +31,10 @@ PyObject *drgnpy_linux_helper_read_vm(PyObject *self, PyObject *args,
 	buf = PyBytes_FromStringAndSize(NULL, size);
 	if (!buf)
 		return NULL;
+	Py_BEGIN_ALLOW_THREADS
 	err = linux_helper_read_vm(&prog->prog, pgtable.uvalue, address.uvalue,
 				   PyBytes_AS_STRING(buf), size);
+	Py_END_ALLOW_THREADS
 	if (err) {
 		Py_DECREF(buf);
 		return set_drgn_error(err);
@@ -37,6 +42,117 @@ PyObject *drgnpy_linux_helper_read_vm(PyObject *self, PyObject *args,
 	return buf;
 }
 
+/*
+ * Translations of one page table which are kept across reads, returned by
+ * _linux_helper_vm_translation().
+ */
+typedef struct {
+	PyObject_HEAD
+	Program *prog;
+	struct linux_helper_vm_translation t;
+} LinuxHelperVmTranslation;
+
+PyObject *drgnpy_linux_helper_vm_translation(PyObject *self, PyObject *args,
+					     PyObject *kwds)
+{
+	static char *keywords[] = {"prog", "pgtable", NULL};
+	PyTypeObject *type = &LinuxHelperVmTranslation_type;
+	Program *prog;
+	struct index_arg pgtable = {};
+	LinuxHelperVmTranslation *ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!O&:vm_translation",
+					 keywords, &Program_type, &prog,
+					 index_converter, &pgtable))
+		return NULL;
+
+	ret = (LinuxHelperVmTranslation *)type->tp_alloc(type, 0);
+	if (!ret)
+		return NULL;
+	ret->prog = prog;
+	Py_INCREF(prog);
+	linux_helper_vm_translation_init(&ret->t, pgtable.uvalue);
+	return (PyObject *)ret;
+}
+
+static void LinuxHelperVmTranslation_dealloc(LinuxHelperVmTranslation *self)
+{
+	if (self->prog)
+		linux_helper_vm_translation_deinit(&self->t);
+	Py_XDECREF(self->prog);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *LinuxHelperVmTranslation_read(LinuxHelperVmTranslation *self,
+					       PyObject *args, PyObject *kwds)
+{
+	static char *keywords[] = {"address", "size", NULL};
+	struct drgn_error *err;
+	struct index_arg address = {};
+	Py_ssize_t size;
+	PyObject *buf;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&n:read", keywords,
+					 index_converter, &address, &size))
+		return NULL;
+
+	if (size < 0) {
+		PyErr_SetString(PyExc_ValueError, "negative size");
+		return NULL;
+	}
+	buf = PyBytes_FromStringAndSize(NULL, size);
+	if (!buf)
+		return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	err = linux_helper_vm_translation_read(&self->prog->prog, &self->t,
+					       address.uvalue,
+					       PyBytes_AS_STRING(buf), size);
+	Py_END_ALLOW_THREADS
+	if (err) {
+		Py_DECREF(buf);
+		return set_drgn_error(err);
+	}
+	return buf;
+}
+
+static PyObject *LinuxHelperVmTranslation_fill(LinuxHelperVmTranslation *self,
+					       PyObject *args, PyObject *kwds)
+{
+	static char *keywords[] = {"address", "size", NULL};
+	struct drgn_error *err;
+	struct index_arg address = {};
+	unsigned long long size;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&K:fill", keywords,
+					 index_converter, &address, &size))
+		return NULL;
+
+	Py_BEGIN_ALLOW_THREADS
+	err = linux_helper_vm_translation_fill(&self->prog->prog, &self->t,
+					       address.uvalue, size);
+	Py_END_ALLOW_THREADS
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
+static PyMethodDef LinuxHelperVmTranslation_methods[] = {
+	{"read", (PyCFunction)LinuxHelperVmTranslation_read,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"fill", (PyCFunction)LinuxHelperVmTranslation_fill,
+	 METH_VARARGS | METH_KEYWORDS},
+	{},
+};
+
+PyTypeObject LinuxHelperVmTranslation_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "_drgn._LinuxHelperVmTranslation",
+	.tp_basicsize = sizeof(LinuxHelperVmTranslation),
+	.tp_dealloc = (destructor)LinuxHelperVmTranslation_dealloc,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_methods = LinuxHelperVmTranslation_methods,
+};
+
 DrgnObject *drgnpy_linux_helper_radix_tree_lookup(PyObject *self,
 						  PyObject *args,
 						  PyObject *kwds)
@@ -254,3 +370,2638 @@ PyObject *drgnpy_linux_helper_pgtable_l5_enabled(PyObject *self, PyObject *args,
 	else
 		Py_RETURN_FALSE;
 }
+
+/*
+ * Get the pointer type and the offset of a list node or tree node member for
+ * the *_entry iterators.
+ */
+static int entry_pointer_type(Program *prog, PyObject *type_obj,
+			      const char *member_designator,
+			      struct drgn_qualified_type *entry_type_ret,
+			      uint64_t *member_offset_ret)
+{
+	struct drgn_error *err;
+	struct drgn_qualified_type qualified_type;
+	struct drgn_member_info member;
+
+	if (Program_type_arg(prog, type_obj, false, &qualified_type) == -1)
+		return -1;
+	err = drgn_program_member_path(&prog->prog, qualified_type.type,
+				       member_designator, &member);
+	if (err) {
+		set_drgn_error(err);
+		return -1;
+	}
+	if (member.bit_offset % 8) {
+		PyErr_SetString(PyExc_ValueError,
+				"node member is not byte-aligned");
+		return -1;
+	}
+	err = drgn_type_index_pointer_type(&prog->prog.tindex, qualified_type,
+					   NULL, &entry_type_ret->type);
+	if (err) {
+		set_drgn_error(err);
+		return -1;
+	}
+	entry_type_ret->qualifiers = 0;
+	*member_offset_ret = member.bit_offset / 8;
+	return 0;
+}
+
+/* Create an entry pointer object given the address of its node. */
+static DrgnObject *entry_object(Program *prog,
+				struct drgn_qualified_type entry_type,
+				uint64_t node, uint64_t member_offset)
+{
+	struct drgn_error *err;
+	DrgnObject *res;
+
+	res = DrgnObject_alloc(prog);
+	if (!res)
+		return NULL;
+	err = drgn_object_set_unsigned(&res->obj, entry_type,
+				       node - member_offset, 0);
+	if (err) {
+		Py_DECREF(res);
+		return set_drgn_error(err);
+	}
+	return res;
+}
+
+/* Maximum number of addresses that a LinuxHelperIterator fetches ahead. */
+#define LINUX_HELPER_ITERATOR_PREFETCH 64
+
+struct linux_helper_iterator_ops {
+	/* Get the address of the next node or entry. */
+	struct drgn_error *(*next)(void *it, uint64_t *ret);
+	/* Deinitialize the libdrgn iterator, or NULL if there is nothing to do. */
+	void (*deinit)(void *it);
+};
+
+/*
+ * Iterator returned by the C helpers which walk a data structure and return a
+ * pointer object for each node or entry.
+ *
+ * Addresses are fetched from the libdrgn iterator in batches ahead of the
+ * caller with the GIL released, so the loop following the links of the data
+ * structure runs in C instead of once per Python iteration. Batches start at
+ * one address and double up to LINUX_HELPER_ITERATOR_PREFETCH, so breaking out
+ * of a loop early doesn't read much more than it needs to.
+ */
+typedef struct {
+	PyObject_HEAD
+	Program *prog;
+	/* Keeps the entry type alive if it was passed as a Type. */
+	PyObject *type_obj;
+	const struct linux_helper_iterator_ops *ops;
+	/* Type of the returned pointers. */
+	struct drgn_qualified_type entry_type;
+	/* Offset of the node in each entry. */
+	uint64_t member_offset;
+	/* Fetched addresses and the next one to return. */
+	size_t pos, count;
+	/* Number of addresses to fetch in the next batch. */
+	size_t batch_size;
+	/*
+	 * Error which ended the last batch, which is raised after the addresses
+	 * before it are returned, or &drgn_stop at the end.
+	 */
+	struct drgn_error *err;
+	uint64_t addresses[LINUX_HELPER_ITERATOR_PREFETCH];
+	union {
+		struct linux_helper_list_iterator list;
+		struct linux_helper_rbtree_iterator rbtree;
+		struct linux_helper_pid_iterator pid;
+		struct linux_helper_page_iterator page;
+		struct linux_helper_slab_object_iterator slab;
+	} it;
+} LinuxHelperIterator;
+
+static LinuxHelperIterator *LinuxHelperIterator_alloc(Program *prog)
+{
+	LinuxHelperIterator *it;
+
+	it = (LinuxHelperIterator *)
+		LinuxHelperIterator_type.tp_alloc(&LinuxHelperIterator_type, 0);
+	if (!it)
+		return NULL;
+	it->prog = prog;
+	Py_INCREF(prog);
+	it->batch_size = 1;
+	return it;
+}
+
+static void LinuxHelperIterator_dealloc(LinuxHelperIterator *self)
+{
+	if (self->ops && self->ops->deinit)
+		self->ops->deinit(&self->it);
+	drgn_error_destroy(self->err);
+	Py_XDECREF(self->type_obj);
+	Py_XDECREF(self->prog);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static void LinuxHelperIterator_fetch(LinuxHelperIterator *self)
+{
+	struct drgn_error *err = NULL;
+	size_t count = 0;
+
+	Py_BEGIN_ALLOW_THREADS
+	while (count < self->batch_size) {
+		err = self->ops->next(&self->it, &self->addresses[count]);
+		if (err)
+			break;
+		count++;
+	}
+	Py_END_ALLOW_THREADS
+	self->pos = 0;
+	self->count = count;
+	self->err = err;
+	if (self->batch_size < LINUX_HELPER_ITERATOR_PREFETCH)
+		self->batch_size *= 2;
+}
+
+static DrgnObject *LinuxHelperIterator_next(LinuxHelperIterator *self)
+{
+	struct drgn_error *err;
+
+	if (self->pos >= self->count) {
+		if (!self->err)
+			LinuxHelperIterator_fetch(self);
+		if (self->pos >= self->count) {
+			err = self->err;
+			if (err == &drgn_stop)
+				return NULL;
+			/* Only raise the error once. */
+			self->err = &drgn_stop;
+			return set_drgn_error(err);
+		}
+	}
+	return entry_object(self->prog, self->entry_type,
+			    self->addresses[self->pos++], self->member_offset);
+}
+
+static PyObject *LinuxHelperIterator_length_hint(LinuxHelperIterator *self)
+{
+	/*
+	 * The length is only known once the libdrgn iterator has returned
+	 * everything.
+	 */
+	if (self->err == &drgn_stop)
+		return PyLong_FromSize_t(self->count - self->pos);
+	Py_RETURN_NOTIMPLEMENTED;
+}
+
+static PyMethodDef LinuxHelperIterator_methods[] = {
+	{"__length_hint__", (PyCFunction)LinuxHelperIterator_length_hint,
+	 METH_NOARGS},
+	{},
+};
+
+PyTypeObject LinuxHelperIterator_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "_drgn._LinuxHelperIterator",
+	.tp_basicsize = sizeof(LinuxHelperIterator),
+	.tp_dealloc = (destructor)LinuxHelperIterator_dealloc,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_iter = PyObject_SelfIter,
+	.tp_iternext = (iternextfunc)LinuxHelperIterator_next,
+	.tp_methods = LinuxHelperIterator_methods,
+};
+
+static struct drgn_error *list_iterator_next(void *it, uint64_t *ret)
+{
+	return linux_helper_list_iterator_next(it, ret);
+}
+
+static const struct linux_helper_iterator_ops list_iterator_ops = {
+	.next = list_iterator_next,
+};
+
+static PyObject *LinuxHelperListIterator_new(DrgnObject *head,
+					     PyObject *type_obj,
+					     const char *member_designator,
+					     bool hlist, bool reverse)
+{
+	struct drgn_error *err;
+	Program *prog = DrgnObject_prog(head);
+	LinuxHelperIterator *it;
+
+	it = LinuxHelperIterator_alloc(prog);
+	if (!it)
+		return NULL;
+
+	it->ops = &list_iterator_ops;
+	if (hlist) {
+		err = linux_helper_hlist_iterator_init(&it->it.list, &head->obj,
+						       &it->entry_type);
+	} else {
+		err = linux_helper_list_iterator_init(&it->it.list, &head->obj,
+						      reverse, &it->entry_type);
+	}
+	if (err)
+		goto err;
+
+	if (type_obj) {
+		if (entry_pointer_type(prog, type_obj, member_designator,
+				       &it->entry_type,
+				       &it->member_offset) == -1)
+			goto err_python;
+		it->type_obj = type_obj;
+		Py_INCREF(type_obj);
+	}
+	return (PyObject *)it;
+
+err:
+	set_drgn_error(err);
+err_python:
+	Py_DECREF(it);
+	return NULL;
+}
+
+PyObject *drgnpy_linux_helper_list_for_each(PyObject *self, PyObject *args,
+					    PyObject *kwds)
+{
+	static char *keywords[] = {"head", "reverse", NULL};
+	DrgnObject *head;
+	int reverse = 0;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|p:list_for_each",
+					 keywords, &DrgnObject_type, &head,
+					 &reverse))
+		return NULL;
+	return LinuxHelperListIterator_new(head, NULL, NULL, false, reverse);
+}
+
+PyObject *drgnpy_linux_helper_list_for_each_entry(PyObject *self,
+						  PyObject *args,
+						  PyObject *kwds)
+{
+	static char *keywords[] = {"type", "head", "member", "reverse", NULL};
+	PyObject *type_obj;
+	DrgnObject *head;
+	const char *member;
+	int reverse = 0;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds,
+					 "OO!s|p:list_for_each_entry",
+					 keywords, &type_obj, &DrgnObject_type,
+					 &head, &member, &reverse))
+		return NULL;
+	return LinuxHelperListIterator_new(head, type_obj, member, false,
+					   reverse);
+}
+
+PyObject *drgnpy_linux_helper_hlist_for_each(PyObject *self, PyObject *args,
+					     PyObject *kwds)
+{
+	static char *keywords[] = {"head", NULL};
+	DrgnObject *head;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!:hlist_for_each",
+					 keywords, &DrgnObject_type, &head))
+		return NULL;
+	return LinuxHelperListIterator_new(head, NULL, NULL, true, false);
+}
+
+PyObject *drgnpy_linux_helper_hlist_for_each_entry(PyObject *self,
+						   PyObject *args,
+						   PyObject *kwds)
+{
+	static char *keywords[] = {"type", "head", "member", NULL};
+	PyObject *type_obj;
+	DrgnObject *head;
+	const char *member;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds,
+					 "OO!s:hlist_for_each_entry", keywords,
+					 &type_obj, &DrgnObject_type, &head,
+					 &member))
+		return NULL;
+	return LinuxHelperListIterator_new(head, type_obj, member, true,
+					   false);
+}
+
+static struct drgn_error *rbtree_iterator_next(void *it, uint64_t *ret)
+{
+	return linux_helper_rbtree_iterator_next(it, ret);
+}
+
+static const struct linux_helper_iterator_ops rbtree_iterator_ops = {
+	.next = rbtree_iterator_next,
+};
+
+static PyObject *LinuxHelperRbtreeIterator_new(DrgnObject *root,
+					       PyObject *type_obj,
+					       const char *member_designator)
+{
+	struct drgn_error *err;
+	Program *prog = DrgnObject_prog(root);
+	LinuxHelperIterator *it;
+
+	it = LinuxHelperIterator_alloc(prog);
+	if (!it)
+		return NULL;
+
+	it->ops = &rbtree_iterator_ops;
+	err = linux_helper_rbtree_iterator_init(&it->it.rbtree, &root->obj,
+						&it->entry_type);
+	if (err)
+		goto err;
+
+	if (type_obj) {
+		if (entry_pointer_type(prog, type_obj, member_designator,
+				       &it->entry_type,
+				       &it->member_offset) == -1)
+			goto err_python;
+		it->type_obj = type_obj;
+		Py_INCREF(type_obj);
+	}
+	return (PyObject *)it;
+
+err:
+	set_drgn_error(err);
+err_python:
+	Py_DECREF(it);
+	return NULL;
+}
+
+PyObject *drgnpy_linux_helper_rbtree_inorder_for_each(PyObject *self,
+						      PyObject *args,
+						      PyObject *kwds)
+{
+	static char *keywords[] = {"root", NULL};
+	DrgnObject *root;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds,
+					 "O!:rbtree_inorder_for_each",
+					 keywords, &DrgnObject_type, &root))
+		return NULL;
+	return LinuxHelperRbtreeIterator_new(root, NULL, NULL);
+}
+
+PyObject *drgnpy_linux_helper_rbtree_inorder_for_each_entry(PyObject *self,
+							    PyObject *args,
+							    PyObject *kwds)
+{
+	static char *keywords[] = {"type", "root", "member", NULL};
+	PyObject *type_obj;
+	DrgnObject *root;
+	const char *member;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds,
+					 "OO!s:rbtree_inorder_for_each_entry",
+					 keywords, &type_obj, &DrgnObject_type,
+					 &root, &member))
+		return NULL;
+	return LinuxHelperRbtreeIterator_new(root, type_obj, member);
+}
+
+DrgnObject *drgnpy_linux_helper_rb_find(PyObject *self, PyObject *args,
+					PyObject *kwds)
+{
+	static char *keywords[] = {"type", "root", "member", "key",
+				   "key_member", NULL};
+	struct drgn_error *err;
+	PyObject *type_obj, *key_obj;
+	DrgnObject *root;
+	const char *member, *key_member;
+	long long svalue;
+	int overflow;
+	uint64_t key;
+	bool key_negative;
+	struct drgn_qualified_type qualified_type;
+	DrgnObject *res;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO!sOs:rb_find",
+					 keywords, &type_obj, &DrgnObject_type,
+					 &root, &member, &key_obj, &key_member))
+		return NULL;
+
+	key_obj = PyNumber_Index(key_obj);
+	if (!key_obj)
+		return NULL;
+	svalue = PyLong_AsLongLongAndOverflow(key_obj, &overflow);
+	if (overflow > 0) {
+		key = PyLong_AsUnsignedLongLong(key_obj);
+		key_negative = false;
+	} else {
+		if (overflow < 0) {
+			PyErr_SetString(PyExc_OverflowError,
+					"key is too small");
+		}
+		key = svalue;
+		key_negative = svalue < 0;
+	}
+	Py_DECREF(key_obj);
+	if (PyErr_Occurred())
+		return NULL;
+
+	if (Program_type_arg(DrgnObject_prog(root), type_obj, false,
+			     &qualified_type) == -1)
+		return NULL;
+	res = DrgnObject_alloc(DrgnObject_prog(root));
+	if (!res)
+		return NULL;
+	err = linux_helper_rb_find(&res->obj, &root->obj, qualified_type,
+				   member, key_member, key, key_negative);
+	if (err) {
+		Py_DECREF(res);
+		return set_drgn_error(err);
+	}
+	return res;
+}
+
+/* Number of entries fetched from a radix tree iterator at a time. */
+#define RADIX_TREE_ITERATOR_BATCH_SIZE 64
+
+typedef struct {
+	PyObject_HEAD
+	Program *prog;
+	/* Type of the returned entries (void * unless given). */
+	struct drgn_qualified_type entry_type;
+	/* Added to each index (the IDR base). */
+	uint64_t base;
+	struct linux_helper_radix_tree_iterator it;
+	/* Buffered entries and the next one to return. */
+	size_t batch_pos, batch_count;
+	uint64_t indices[RADIX_TREE_ITERATOR_BATCH_SIZE];
+	uint64_t entries[RADIX_TREE_ITERATOR_BATCH_SIZE];
+} LinuxHelperRadixTreeIterator;
+
+static PyObject *LinuxHelperRadixTreeIterator_new(DrgnObject *root, bool idr,
+						  PyObject *type_obj)
+{
+	struct drgn_error *err;
+	Program *prog = DrgnObject_prog(root);
+	LinuxHelperRadixTreeIterator *it;
+
+	it = (LinuxHelperRadixTreeIterator *)
+		LinuxHelperRadixTreeIterator_type.tp_alloc(&LinuxHelperRadixTreeIterator_type,
+							   0);
+	if (!it)
+		return NULL;
+	it->prog = prog;
+	Py_INCREF(prog);
+	it->batch_pos = it->batch_count = 0;
+
+	if (type_obj && type_obj != Py_None) {
+		if (Program_type_arg(prog, type_obj, false,
+				     &it->entry_type) == -1)
+			goto err_py;
+		if (drgn_type_kind(drgn_underlying_type(it->entry_type.type)) !=
+		    DRGN_TYPE_POINTER) {
+			PyErr_SetString(PyExc_TypeError,
+					"entry type must be a pointer type");
+			goto err_py;
+		}
+	} else {
+		err = drgn_program_find_type(&prog->prog, "void *", NULL,
+					     &it->entry_type);
+		if (err)
+			goto err;
+	}
+	if (idr) {
+		err = linux_helper_idr_iterator_init(&it->it, &root->obj,
+						     &it->base);
+	} else {
+		err = linux_helper_radix_tree_iterator_init(&it->it,
+							    &root->obj);
+	}
+	if (err)
+		goto err;
+	return (PyObject *)it;
+
+err:
+	set_drgn_error(err);
+err_py:
+	Py_DECREF(it);
+	return NULL;
+}
+
+static void
+LinuxHelperRadixTreeIterator_dealloc(LinuxHelperRadixTreeIterator *self)
+{
+	linux_helper_radix_tree_iterator_deinit(&self->it);
+	Py_XDECREF(self->prog);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *
+LinuxHelperRadixTreeIterator_next(LinuxHelperRadixTreeIterator *self)
+{
+	struct drgn_error *err;
+	uint64_t index, entry;
+	DrgnObject *entry_obj;
+
+	if (self->batch_pos >= self->batch_count) {
+		self->batch_pos = self->batch_count = 0;
+		err = linux_helper_radix_tree_iterator_next_batch(&self->it,
+								  self->indices,
+								  self->entries,
+								  RADIX_TREE_ITERATOR_BATCH_SIZE,
+								  &self->batch_count);
+		if (err == &drgn_stop)
+			return NULL;
+		if (err)
+			return set_drgn_error(err);
+	}
+	index = self->indices[self->batch_pos];
+	entry = self->entries[self->batch_pos];
+	self->batch_pos++;
+
+	entry_obj = DrgnObject_alloc(self->prog);
+	if (!entry_obj)
+		return NULL;
+	err = drgn_object_set_unsigned(&entry_obj->obj, self->entry_type,
+				       entry, 0);
+	if (err) {
+		Py_DECREF(entry_obj);
+		return set_drgn_error(err);
+	}
+	return Py_BuildValue("KN", (unsigned long long)(index + self->base),
+			     entry_obj);
+}
+
+PyTypeObject LinuxHelperRadixTreeIterator_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "_drgn._LinuxHelperRadixTreeIterator",
+	.tp_basicsize = sizeof(LinuxHelperRadixTreeIterator),
+	.tp_dealloc = (destructor)LinuxHelperRadixTreeIterator_dealloc,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_iter = PyObject_SelfIter,
+	.tp_iternext = (iternextfunc)LinuxHelperRadixTreeIterator_next,
+};
+
+PyObject *drgnpy_linux_helper_radix_tree_for_each(PyObject *self,
+						  PyObject *args,
+						  PyObject *kwds)
+{
+	static char *keywords[] = {"root", NULL};
+	DrgnObject *root;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!:radix_tree_for_each",
+					 keywords, &DrgnObject_type, &root))
+		return NULL;
+	return LinuxHelperRadixTreeIterator_new(root, false, NULL);
+}
+
+PyObject *drgnpy_linux_helper_idr_for_each(PyObject *self, PyObject *args,
+					   PyObject *kwds)
+{
+	static char *keywords[] = {"idr", "type", NULL};
+	DrgnObject *idr;
+	PyObject *type_obj = Py_None;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|O:idr_for_each",
+					 keywords, &DrgnObject_type, &idr,
+					 &type_obj))
+		return NULL;
+	return LinuxHelperRadixTreeIterator_new(idr, true, type_obj);
+}
+
+static struct drgn_error *pid_iterator_next(void *it, uint64_t *ret)
+{
+	return linux_helper_pid_iterator_next(it, ret);
+}
+
+static void pid_iterator_deinit(void *it)
+{
+	linux_helper_pid_iterator_deinit(it);
+}
+
+static const struct linux_helper_iterator_ops pid_iterator_ops = {
+	.next = pid_iterator_next,
+	.deinit = pid_iterator_deinit,
+};
+
+static PyObject *LinuxHelperPidIterator_new(PyObject *args, PyObject *kwds,
+					    bool tasks)
+{
+	static char *keywords[] = {"ns", NULL};
+	struct drgn_error *err;
+	struct prog_or_ns_arg prog_or_ns;
+	LinuxHelperIterator *it;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds,
+					 tasks ? "O&:for_each_task" :
+					 "O&:for_each_pid", keywords,
+					 &prog_or_pid_ns_converter,
+					 &prog_or_ns))
+		return NULL;
+
+	it = LinuxHelperIterator_alloc(prog_or_ns.prog);
+	if (!it)
+		goto out;
+
+	err = drgn_program_find_type(&it->prog->prog,
+				     tasks ? "struct task_struct *" :
+				     "struct pid *", NULL, &it->entry_type);
+	if (!err) {
+		it->ops = &pid_iterator_ops;
+		err = linux_helper_pid_iterator_init(&it->it.pid,
+						     prog_or_ns.ns, tasks);
+	}
+	if (err) {
+		set_drgn_error(err);
+		Py_DECREF(it);
+		it = NULL;
+	}
+out:
+	prog_or_ns_cleanup(&prog_or_ns);
+	return (PyObject *)it;
+}
+
+PyObject *drgnpy_linux_helper_for_each_pid(PyObject *self, PyObject *args,
+					   PyObject *kwds)
+{
+	return LinuxHelperPidIterator_new(args, kwds, false);
+}
+
+PyObject *drgnpy_linux_helper_for_each_task(PyObject *self, PyObject *args,
+					    PyObject *kwds)
+{
+	return LinuxHelperPidIterator_new(args, kwds, true);
+}
+
+DEFINE_VECTOR(uint64_vector, uint64_t)
+
+static struct drgn_error *page_iterator_next(void *_it, uint64_t *ret)
+{
+	struct drgn_error *err;
+	struct linux_helper_page_iterator *it = _it;
+	uint64_t pfn;
+
+	err = linux_helper_page_iterator_next(it, &pfn);
+	if (err)
+		return err;
+	*ret = it->vmemmap + pfn * it->page_size;
+	return NULL;
+}
+
+static void page_iterator_deinit(void *it)
+{
+	linux_helper_page_iterator_deinit(it);
+}
+
+static const struct linux_helper_iterator_ops page_iterator_ops = {
+	.next = page_iterator_next,
+	.deinit = page_iterator_deinit,
+};
+
+PyObject *drgnpy_linux_helper_for_each_page(PyObject *self, PyObject *args,
+					    PyObject *kwds)
+{
+	static char *keywords[] = {"prog", "flags", NULL};
+	struct drgn_error *err;
+	Program *prog;
+	struct index_arg flags = {};
+	LinuxHelperIterator *it;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|O&:for_each_page",
+					 keywords, &Program_type, &prog,
+					 index_converter, &flags))
+		return NULL;
+
+	it = LinuxHelperIterator_alloc(prog);
+	if (!it)
+		return NULL;
+
+	err = drgn_program_find_type(&prog->prog, "struct page *", NULL,
+				     &it->entry_type);
+	if (!err) {
+		it->ops = &page_iterator_ops;
+		err = linux_helper_page_iterator_init(&it->it.page, &prog->prog,
+						      flags.uvalue,
+						      flags.uvalue);
+	}
+	if (err) {
+		set_drgn_error(err);
+		Py_DECREF(it);
+		return NULL;
+	}
+	return (PyObject *)it;
+}
+
+PyObject *drgnpy_linux_helper_page_pfns(PyObject *self, PyObject *args,
+					PyObject *kwds)
+{
+	static char *keywords[] = {"prog", "flags", NULL};
+	struct drgn_error *err;
+	Program *prog;
+	struct index_arg flags = {};
+	struct linux_helper_page_iterator it;
+	struct uint64_vector pfns;
+	PyObject *ret = NULL;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|O&:page_pfns",
+					 keywords, &Program_type, &prog,
+					 index_converter, &flags))
+		return NULL;
+
+	uint64_vector_init(&pfns);
+	err = linux_helper_page_iterator_init(&it, &prog->prog, flags.uvalue,
+					      flags.uvalue);
+	if (err)
+		goto out;
+	for (;;) {
+		uint64_t pfn;
+
+		err = linux_helper_page_iterator_next(&it, &pfn);
+		if (err == &drgn_stop) {
+			err = NULL;
+			break;
+		}
+		if (err)
+			goto out;
+		if (!uint64_vector_append(&pfns, &pfn)) {
+			err = &drgn_enomem;
+			goto out;
+		}
+	}
+	ret = PyBytes_FromStringAndSize((char *)pfns.data,
+					pfns.size * sizeof(pfns.data[0]));
+out:
+	linux_helper_page_iterator_deinit(&it);
+	uint64_vector_deinit(&pfns);
+	if (err)
+		return set_drgn_error(err);
+	return ret;
+}
+
+DrgnObject *drgnpy_linux_helper_per_cpu_ptr(PyObject *self, PyObject *args,
+					    PyObject *kwds)
+{
+	static char *keywords[] = {"ptr", "cpu", NULL};
+	struct drgn_error *err;
+	DrgnObject *ptr;
+	struct index_arg cpu = {};
+	uint64_t address;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!O&:per_cpu_ptr",
+					 keywords, &DrgnObject_type, &ptr,
+					 index_converter, &cpu))
+		return NULL;
+
+	err = linux_helper_per_cpu_ptr(&ptr->obj, cpu.uvalue, &address);
+	if (err)
+		return set_drgn_error(err);
+	return entry_object(DrgnObject_prog(ptr),
+			    drgn_object_qualified_type(&ptr->obj), address, 0);
+}
+
+static int cpumask_converter(PyObject *o, void *p)
+{
+	const struct drgn_object **mask = p;
+
+	if (o == Py_None) {
+		*mask = NULL;
+	} else if (PyObject_TypeCheck(o, &DrgnObject_type)) {
+		*mask = &((DrgnObject *)o)->obj;
+	} else {
+		PyErr_Format(PyExc_TypeError, "expected Object or None, not %s",
+			     Py_TYPE(o)->tp_name);
+		return 0;
+	}
+	return 1;
+}
+
+PyObject *drgnpy_linux_helper_per_cpu_ptrs(PyObject *self, PyObject *args,
+					   PyObject *kwds)
+{
+	static char *keywords[] = {"ptr", "mask", NULL};
+	struct drgn_error *err;
+	DrgnObject *ptr;
+	const struct drgn_object *mask = NULL;
+	uint64_t base, *cpus;
+	size_t num_cpus, i;
+	PyObject *ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|O&:per_cpu_ptrs",
+					 keywords, &DrgnObject_type, &ptr,
+					 cpumask_converter, &mask))
+		return NULL;
+
+	err = drgn_object_read_unsigned(&ptr->obj, &base);
+	if (err)
+		return set_drgn_error(err);
+	err = linux_helper_cpumask_cpus(&DrgnObject_prog(ptr)->prog, mask,
+					&cpus, &num_cpus);
+	if (err)
+		return set_drgn_error(err);
+
+	ret = PyDict_New();
+	if (!ret)
+		goto out;
+	for (i = 0; i < num_cpus; i++) {
+		uint64_t address;
+		DrgnObject *obj;
+		PyObject *key;
+		int r;
+
+		err = linux_helper_per_cpu_ptr(&ptr->obj, cpus[i], &address);
+		if (err) {
+			set_drgn_error(err);
+			goto err;
+		}
+		obj = entry_object(DrgnObject_prog(ptr),
+				   drgn_object_qualified_type(&ptr->obj),
+				   address, 0);
+		if (!obj)
+			goto err;
+		key = PyLong_FromUnsignedLongLong(cpus[i]);
+		if (!key) {
+			Py_DECREF(obj);
+			goto err;
+		}
+		r = PyDict_SetItem(ret, key, (PyObject *)obj);
+		Py_DECREF(key);
+		Py_DECREF(obj);
+		if (r == -1)
+			goto err;
+	}
+out:
+	free(cpus);
+	return ret;
+
+err:
+	Py_CLEAR(ret);
+	goto out;
+}
+
+PyObject *drgnpy_linux_helper_percpu_sum(PyObject *self, PyObject *args,
+					 PyObject *kwds)
+{
+	static char *keywords[] = {"ptr", "mask", NULL};
+	struct drgn_error *err;
+	DrgnObject *ptr;
+	const struct drgn_object *mask = NULL;
+	uint64_t sum;
+	bool is_signed;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|O&:percpu_sum",
+					 keywords, &DrgnObject_type, &ptr,
+					 cpumask_converter, &mask))
+		return NULL;
+
+	err = linux_helper_per_cpu_sum(&ptr->obj, mask, &sum, &is_signed);
+	if (err)
+		return set_drgn_error(err);
+	if (is_signed)
+		return PyLong_FromLongLong((int64_t)sum);
+	else
+		return PyLong_FromUnsignedLongLong(sum);
+}
+
+static struct drgn_error *slab_object_iterator_next(void *it, uint64_t *ret)
+{
+	return linux_helper_slab_object_iterator_next(it, ret);
+}
+
+static void slab_object_iterator_deinit(void *it)
+{
+	linux_helper_slab_object_iterator_deinit(it);
+}
+
+static const struct linux_helper_iterator_ops slab_object_iterator_ops = {
+	.next = slab_object_iterator_next,
+	.deinit = slab_object_iterator_deinit,
+};
+
+PyObject *
+drgnpy_linux_helper_slab_cache_for_each_allocated_object(PyObject *self,
+							 PyObject *args,
+							 PyObject *kwds)
+{
+	static char *keywords[] = {"slab_cache", "type", "cpu_freelists", NULL};
+	struct drgn_error *err;
+	DrgnObject *slab_cache;
+	PyObject *type_obj;
+	int cpu_freelists = 1;
+	struct drgn_qualified_type qualified_type;
+	LinuxHelperIterator *it;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds,
+					 "O!O|p:slab_cache_for_each_allocated_object",
+					 keywords, &DrgnObject_type,
+					 &slab_cache, &type_obj,
+					 &cpu_freelists))
+		return NULL;
+
+	it = LinuxHelperIterator_alloc(DrgnObject_prog(slab_cache));
+	if (!it)
+		return NULL;
+
+	if (Program_type_arg(it->prog, type_obj, false, &qualified_type) == -1)
+		goto err_python;
+	err = drgn_type_index_pointer_type(&it->prog->prog.tindex,
+					   qualified_type, NULL,
+					   &it->entry_type.type);
+	if (err)
+		goto err;
+	it->entry_type.qualifiers = 0;
+
+	it->ops = &slab_object_iterator_ops;
+	err = linux_helper_slab_object_iterator_init(&it->it.slab,
+						     &slab_cache->obj,
+						     cpu_freelists);
+	if (err)
+		goto err;
+	return (PyObject *)it;
+
+err:
+	set_drgn_error(err);
+err_python:
+	Py_DECREF(it);
+	return NULL;
+}
+
+PyObject *drgnpy_linux_helper_d_path(PyObject *self, PyObject *args,
+				     PyObject *kwds)
+{
+	static char *keywords[] = {"path_or_vfsmnt", "dentry", NULL};
+	struct drgn_error *err;
+	DrgnObject *path_or_vfsmnt;
+	PyObject *dentry_obj = Py_None;
+	char *path;
+	size_t len;
+	PyObject *ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|O:d_path", keywords,
+					 &DrgnObject_type, &path_or_vfsmnt,
+					 &dentry_obj))
+		return NULL;
+	if (dentry_obj != Py_None &&
+	    !PyObject_TypeCheck(dentry_obj, &DrgnObject_type)) {
+		PyErr_Format(PyExc_TypeError, "expected Object or None, not %s",
+			     Py_TYPE(dentry_obj)->tp_name);
+		return NULL;
+	}
+
+	err = linux_helper_d_path(&path_or_vfsmnt->obj,
+				  dentry_obj == Py_None ?
+				  NULL : &((DrgnObject *)dentry_obj)->obj,
+				  &path, &len);
+	if (err)
+		return set_drgn_error(err);
+	if (!path)
+		Py_RETURN_NONE;
+	ret = PyBytes_FromStringAndSize(path, len);
+	free(path);
+	return ret;
+}
+
+PyObject *drgnpy_linux_helper_dentry_path(PyObject *self, PyObject *args,
+					  PyObject *kwds)
+{
+	static char *keywords[] = {"dentry", NULL};
+	struct drgn_error *err;
+	DrgnObject *dentry;
+	char *path;
+	size_t len;
+	PyObject *ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!:dentry_path",
+					 keywords, &DrgnObject_type, &dentry))
+		return NULL;
+
+	err = linux_helper_dentry_path(&dentry->obj, &path, &len);
+	if (err)
+		return set_drgn_error(err);
+	ret = PyBytes_FromStringAndSize(path ? path : "", len);
+	free(path);
+	return ret;
+}
+
+static const char * const task_field_names[LINUX_HELPER_NUM_TASK_FIELDS] = {
+	[LINUX_HELPER_TASK_ADDRESS] = "task",
+	[LINUX_HELPER_TASK_PID] = "pid",
+	[LINUX_HELPER_TASK_TGID] = "tgid",
+	[LINUX_HELPER_TASK_COMM] = "comm",
+	[LINUX_HELPER_TASK_STATE] = "state",
+	[LINUX_HELPER_TASK_UTIME] = "utime",
+	[LINUX_HELPER_TASK_STIME] = "stime",
+	[LINUX_HELPER_TASK_RSS] = "rss",
+};
+
+/* Convert one field of a task in a snapshot to a Python object. */
+static PyObject *task_field_object(Program *prog,
+				   struct drgn_qualified_type task_type,
+				   struct linux_helper_task_snapshot *snapshot,
+				   size_t t, int field)
+{
+	const char *comm;
+	char c;
+
+	switch (field) {
+	case LINUX_HELPER_TASK_ADDRESS:
+		return (PyObject *)entry_object(prog, task_type,
+						snapshot->values[field][t], 0);
+	case LINUX_HELPER_TASK_COMM:
+		comm = snapshot->comms + t * snapshot->comm_len;
+		return PyBytes_FromStringAndSize(comm,
+						 strnlen(comm,
+							 snapshot->comm_len));
+	case LINUX_HELPER_TASK_STATE:
+		c = snapshot->values[field][t];
+		return PyUnicode_FromStringAndSize(&c, 1);
+	default:
+		return PyLong_FromUnsignedLongLong(snapshot->values[field][t]);
+	}
+}
+
+PyObject *drgnpy_linux_helper_task_snapshot(PyObject *self, PyObject *args,
+					    PyObject *kwds)
+{
+	static char *keywords[] = {"ns", "fields", NULL};
+	struct drgn_error *err;
+	struct prog_or_ns_arg prog_or_ns;
+	PyObject *fields_obj, *fields_seq = NULL, *ret = NULL;
+	struct linux_helper_task_snapshot snapshot;
+	struct drgn_qualified_type task_type = {};
+	uint64_t fields = 0;
+	int *order = NULL;
+	Py_ssize_t num_fields, i;
+	size_t t;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O:task_snapshot",
+					 keywords, &prog_or_pid_ns_converter,
+					 &prog_or_ns, &fields_obj))
+		return NULL;
+
+	fields_seq = PySequence_Fast(fields_obj, "fields must be a sequence");
+	if (!fields_seq)
+		goto out;
+	num_fields = PySequence_Fast_GET_SIZE(fields_seq);
+	order = malloc_array(max(num_fields, (Py_ssize_t)1), sizeof(*order));
+	if (!order) {
+		PyErr_NoMemory();
+		goto out;
+	}
+	for (i = 0; i < num_fields; i++) {
+		PyObject *item = PySequence_Fast_GET_ITEM(fields_seq, i);
+		const char *name;
+		int field;
+
+		if (!PyUnicode_Check(item)) {
+			PyErr_SetString(PyExc_TypeError,
+					"field must be a string");
+			goto out;
+		}
+		name = PyUnicode_AsUTF8(item);
+		if (!name)
+			goto out;
+		for (field = 0; field < LINUX_HELPER_NUM_TASK_FIELDS; field++) {
+			if (strcmp(name, task_field_names[field]) == 0)
+				break;
+		}
+		if (field == LINUX_HELPER_NUM_TASK_FIELDS) {
+			PyErr_Format(PyExc_ValueError, "unknown task field %R",
+				     item);
+			goto out;
+		}
+		order[i] = field;
+		fields |= UINT64_C(1) << field;
+	}
+
+	if (fields & (UINT64_C(1) << LINUX_HELPER_TASK_ADDRESS)) {
+		err = drgn_program_find_type(&prog_or_ns.prog->prog,
+					     "struct task_struct *", NULL,
+					     &task_type);
+		if (err) {
+			set_drgn_error(err);
+			goto out;
+		}
+	}
+
+	err = linux_helper_task_snapshot(&snapshot, prog_or_ns.ns, fields);
+	if (err) {
+		set_drgn_error(err);
+		goto out;
+	}
+	ret = PyList_New(snapshot.num_tasks);
+	if (!ret)
+		goto out_snapshot;
+	for (t = 0; t < snapshot.num_tasks; t++) {
+		PyObject *tuple = PyTuple_New(num_fields);
+
+		if (!tuple)
+			goto err;
+		PyList_SET_ITEM(ret, t, tuple);
+		for (i = 0; i < num_fields; i++) {
+			PyObject *value;
+
+			value = task_field_object(prog_or_ns.prog, task_type,
+						  &snapshot, t, order[i]);
+			if (!value)
+				goto err;
+			PyTuple_SET_ITEM(tuple, i, value);
+		}
+	}
+	goto out_snapshot;
+
+err:
+	Py_CLEAR(ret);
+out_snapshot:
+	linux_helper_task_snapshot_deinit(&snapshot);
+out:
+	free(order);
+	Py_XDECREF(fields_seq);
+	prog_or_ns_cleanup(&prog_or_ns);
+	return ret;
+}
+
+/* Convert a range of the data of a linux_helper_task_args to bytes or None. */
+static PyObject *task_args_bytes(struct linux_helper_task_args *args,
+				 size_t offset, size_t size)
+{
+	if (size == LINUX_HELPER_TASK_ARGS_UNAVAILABLE)
+		Py_RETURN_NONE;
+	return PyBytes_FromStringAndSize(args->data + offset, size);
+}
+
+PyObject *drgnpy_linux_helper_task_args(PyObject *self, PyObject *args,
+					PyObject *kwds)
+{
+	static char *keywords[] = {"ns", "tasks", "cmdline", "environ", NULL};
+	struct drgn_error *err;
+	struct prog_or_ns_arg prog_or_ns;
+	PyObject *tasks_obj = Py_None, *tasks_seq = NULL, *ret = NULL;
+	int read_cmdline = 1, read_environ = 1;
+	struct linux_helper_task_args task_args;
+	struct drgn_qualified_type task_type;
+	uint64_t *tasks = NULL;
+	size_t num_tasks = 0, t;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|O$pp:task_args",
+					 keywords, &prog_or_pid_ns_converter,
+					 &prog_or_ns, &tasks_obj,
+					 &read_cmdline, &read_environ))
+		return NULL;
+
+	if (tasks_obj != Py_None) {
+		tasks_seq = PySequence_Fast(tasks_obj,
+					    "tasks must be a sequence");
+		if (!tasks_seq)
+			goto out;
+		num_tasks = PySequence_Fast_GET_SIZE(tasks_seq);
+		tasks = malloc_array(max(num_tasks, (size_t)1),
+				     sizeof(*tasks));
+		if (!tasks) {
+			PyErr_NoMemory();
+			goto out;
+		}
+		for (t = 0; t < num_tasks; t++) {
+			DrgnObject *task;
+
+			task = (DrgnObject *)PySequence_Fast_GET_ITEM(tasks_seq,
+								      t);
+			if (!PyObject_TypeCheck(task, &DrgnObject_type)) {
+				PyErr_SetString(PyExc_TypeError,
+						"task must be an Object");
+				goto out;
+			}
+			err = drgn_object_read_unsigned(&task->obj, &tasks[t]);
+			if (err) {
+				set_drgn_error(err);
+				goto out;
+			}
+		}
+	}
+
+	err = drgn_program_find_type(&prog_or_ns.prog->prog,
+				     "struct task_struct *", NULL, &task_type);
+	if (err) {
+		set_drgn_error(err);
+		goto out;
+	}
+	err = linux_helper_task_args(&task_args, prog_or_ns.ns, tasks,
+				     num_tasks, read_cmdline, read_environ);
+	if (err) {
+		set_drgn_error(err);
+		goto out;
+	}
+	ret = PyList_New(task_args.num_entries);
+	if (!ret)
+		goto out_task_args;
+	for (t = 0; t < task_args.num_entries; t++) {
+		struct linux_helper_task_args_entry *entry =
+			&task_args.entries[t];
+		PyObject *tuple;
+
+		tuple = Py_BuildValue("NNN",
+				      entry_object(prog_or_ns.prog, task_type,
+						   entry->task, 0),
+				      task_args_bytes(&task_args,
+						      entry->cmdline_offset,
+						      entry->cmdline_size),
+				      task_args_bytes(&task_args,
+						      entry->environ_offset,
+						      entry->environ_size));
+		if (!tuple) {
+			Py_CLEAR(ret);
+			goto out_task_args;
+		}
+		PyList_SET_ITEM(ret, t, tuple);
+	}
+
+out_task_args:
+	linux_helper_task_args_deinit(&task_args);
+out:
+	free(tasks);
+	Py_XDECREF(tasks_seq);
+	prog_or_ns_cleanup(&prog_or_ns);
+	return ret;
+}
+
+PyObject *drgnpy_linux_helper_ftrace_events(PyObject *self, PyObject *args,
+					    PyObject *kwds)
+{
+	static char *keywords[] = {"prog", "buffer", NULL};
+	struct drgn_error *err;
+	Program *prog;
+	PyObject *buffer_obj = Py_None, *ret;
+	struct linux_helper_ftrace_events events;
+	size_t i;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|O:ftrace_events",
+					 keywords, &Program_type, &prog,
+					 &buffer_obj))
+		return NULL;
+	if (buffer_obj != Py_None &&
+	    !PyObject_TypeCheck(buffer_obj, &DrgnObject_type)) {
+		PyErr_SetString(PyExc_TypeError,
+				"buffer must be an Object or None");
+		return NULL;
+	}
+
+	err = linux_helper_ftrace_events(&events, &prog->prog,
+					 buffer_obj == Py_None ? NULL :
+					 &((DrgnObject *)buffer_obj)->obj);
+	if (err)
+		return set_drgn_error(err);
+	ret = PyList_New(events.num_events);
+	if (!ret)
+		goto out;
+	for (i = 0; i < events.num_events; i++) {
+		struct linux_helper_ftrace_event *event = &events.events[i];
+		PyObject *tuple;
+
+		tuple = Py_BuildValue("KKy#", (unsigned long long)event->cpu,
+				      (unsigned long long)event->timestamp,
+				      events.data + event->offset,
+				      (Py_ssize_t)event->size);
+		if (!tuple) {
+			Py_CLEAR(ret);
+			goto out;
+		}
+		PyList_SET_ITEM(ret, i, tuple);
+	}
+out:
+	linux_helper_ftrace_events_deinit(&events);
+	return ret;
+}
+
+/* Build the {name: list} columns of a socket table. */
+static PyObject *sock_table_columns(const struct linux_helper_sock *socks,
+				    size_t num_socks)
+{
+	static const char * const names[] = {
+		"sock", "family", "state", "saddr", "daddr", "sport", "dport",
+		"cgroup",
+	};
+	PyObject *columns[ARRAY_SIZE(names)] = {};
+	PyObject *ret = NULL;
+	size_t i, j;
+
+	for (j = 0; j < ARRAY_SIZE(names); j++) {
+		columns[j] = PyList_New(num_socks);
+		if (!columns[j])
+			goto out;
+	}
+	for (i = 0; i < num_socks; i++) {
+		const struct linux_helper_sock *sock = &socks[i];
+		PyObject *values[ARRAY_SIZE(names)] = {
+			PyLong_FromUnsignedLongLong(sock->sock),
+			PyLong_FromUnsignedLong(sock->family),
+			PyLong_FromUnsignedLong(sock->state),
+			PyBytes_FromStringAndSize((const char *)sock->saddr,
+						  sock->addr_len),
+			PyBytes_FromStringAndSize((const char *)sock->daddr,
+						  sock->addr_len),
+			PyLong_FromUnsignedLong(sock->sport),
+			PyLong_FromUnsignedLong(sock->dport),
+			PyLong_FromUnsignedLongLong(sock->cgroup),
+		};
+		bool ok = true;
+
+		for (j = 0; j < ARRAY_SIZE(names); j++) {
+			if (values[j])
+				PyList_SET_ITEM(columns[j], i, values[j]);
+			else
+				ok = false;
+		}
+		if (!ok)
+			goto out;
+	}
+	ret = PyDict_New();
+	if (!ret)
+		goto out;
+	for (j = 0; j < ARRAY_SIZE(names); j++) {
+		if (PyDict_SetItemString(ret, names[j], columns[j]) == -1) {
+			Py_CLEAR(ret);
+			goto out;
+		}
+	}
+out:
+	for (j = 0; j < ARRAY_SIZE(names); j++)
+		Py_XDECREF(columns[j]);
+	return ret;
+}
+
+PyObject *drgnpy_linux_helper_sock_table(PyObject *self, PyObject *args,
+					 PyObject *kwds)
+{
+	static char *keywords[] = {"prog", "udp", "info", NULL};
+	struct drgn_error *err;
+	Program *prog;
+	int udp = 0, info = 0;
+	struct linux_helper_sock *socks;
+	size_t num_socks, i;
+	struct drgn_qualified_type sock_type;
+	PyObject *ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|pp:sock_table",
+					 keywords, &Program_type, &prog, &udp,
+					 &info))
+		return NULL;
+
+	if (!info) {
+		err = drgn_program_find_type(&prog->prog, "struct sock *",
+					     NULL, &sock_type);
+		if (err)
+			return set_drgn_error(err);
+	}
+	err = linux_helper_sock_table(&prog->prog,
+				      udp ? LINUX_HELPER_SOCK_TABLE_UDP :
+				      LINUX_HELPER_SOCK_TABLE_TCP,
+				      info, &socks, &num_socks);
+	if (err)
+		return set_drgn_error(err);
+	if (info) {
+		ret = sock_table_columns(socks, num_socks);
+		goto out;
+	}
+	ret = PyList_New(num_socks);
+	if (!ret)
+		goto out;
+	for (i = 0; i < num_socks; i++) {
+		DrgnObject *sock;
+
+		sock = entry_object(prog, sock_type, socks[i].sock, 0);
+		if (!sock) {
+			Py_CLEAR(ret);
+			goto out;
+		}
+		PyList_SET_ITEM(ret, i, (PyObject *)sock);
+	}
+out:
+	free(socks);
+	return ret;
+}
+
+/* Build the {name: list} columns of an inode table. */
+static PyObject *sb_inode_columns(const struct linux_helper_sb_inode *inodes,
+				  size_t num_inodes, bool page_cache)
+{
+	static const char * const names[] = {
+		"inode", "ino", "nrpages", "page_entries", "value_entries",
+	};
+	size_t num_columns = page_cache ? 5 : 3;
+	PyObject *columns[ARRAY_SIZE(names)] = {};
+	PyObject *ret = NULL;
+	size_t i, j;
+
+	for (j = 0; j < num_columns; j++) {
+		columns[j] = PyList_New(num_inodes);
+		if (!columns[j])
+			goto out;
+	}
+	for (i = 0; i < num_inodes; i++) {
+		const struct linux_helper_sb_inode *inode = &inodes[i];
+		const uint64_t values[ARRAY_SIZE(names)] = {
+			inode->inode, inode->ino, inode->nrpages,
+			inode->page_entries, inode->value_entries,
+		};
+
+		for (j = 0; j < num_columns; j++) {
+			PyObject *value;
+
+			value = PyLong_FromUnsignedLongLong(values[j]);
+			if (!value)
+				goto out;
+			PyList_SET_ITEM(columns[j], i, value);
+		}
+	}
+	ret = PyDict_New();
+	if (!ret)
+		goto out;
+	for (j = 0; j < num_columns; j++) {
+		if (PyDict_SetItemString(ret, names[j], columns[j]) == -1) {
+			Py_CLEAR(ret);
+			goto out;
+		}
+	}
+out:
+	for (j = 0; j < num_columns; j++)
+		Py_XDECREF(columns[j]);
+	return ret;
+}
+
+PyObject *drgnpy_linux_helper_sb_inodes(PyObject *self, PyObject *args,
+					PyObject *kwds)
+{
+	static char *keywords[] = {"sb", "info", "page_cache", NULL};
+	struct drgn_error *err;
+	DrgnObject *sb;
+	int info = 0, page_cache = 0;
+	struct linux_helper_sb_inode *inodes;
+	size_t num_inodes, i;
+	struct drgn_qualified_type inode_type;
+	PyObject *ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|pp:sb_inodes",
+					 keywords, &DrgnObject_type, &sb,
+					 &info, &page_cache))
+		return NULL;
+
+	if (!info) {
+		err = drgn_program_find_type(sb->obj.prog, "struct inode *",
+					     NULL, &inode_type);
+		if (err)
+			return set_drgn_error(err);
+	}
+	err = linux_helper_sb_inodes(&sb->obj, info && page_cache, &inodes,
+				     &num_inodes);
+	if (err)
+		return set_drgn_error(err);
+	if (info) {
+		ret = sb_inode_columns(inodes, num_inodes, page_cache);
+		goto out;
+	}
+	ret = PyList_New(num_inodes);
+	if (!ret)
+		goto out;
+	for (i = 0; i < num_inodes; i++) {
+		DrgnObject *inode;
+
+		inode = entry_object(DrgnObject_prog(sb), inode_type,
+				     inodes[i].inode, 0);
+		if (!inode) {
+			Py_CLEAR(ret);
+			goto out;
+		}
+		PyList_SET_ITEM(ret, i, (PyObject *)inode);
+	}
+out:
+	free(inodes);
+	return ret;
+}
+
+/* Build the (object, depth, flags, name, values) tuple of a walked cgroup. */
+static PyObject *cgroup_walk_item(Program *prog,
+				  struct drgn_qualified_type type,
+				  const struct linux_helper_cgroup_walk *walk,
+				  size_t i)
+{
+	const struct linux_helper_cgroup_walk_entry *entry = &walk->entries[i];
+	PyObject *values;
+	DrgnObject *obj;
+	size_t j;
+
+	values = PyTuple_New(walk->num_fields);
+	if (!values)
+		return NULL;
+	for (j = 0; j < walk->num_fields; j++) {
+		uint64_t value = walk->values[i * walk->num_fields + j];
+		PyObject *item;
+
+		if (walk->field_signed[j])
+			item = PyLong_FromLongLong((int64_t)value);
+		else
+			item = PyLong_FromUnsignedLongLong(value);
+		if (!item) {
+			Py_DECREF(values);
+			return NULL;
+		}
+		PyTuple_SET_ITEM(values, j, item);
+	}
+	obj = entry_object(prog, type, entry->address, 0);
+	if (!obj) {
+		Py_DECREF(values);
+		return NULL;
+	}
+	return Py_BuildValue("NKKy#N", obj, (unsigned long long)entry->depth,
+			     (unsigned long long)entry->flags,
+			     walk->names + entry->name_offset,
+			     (Py_ssize_t)entry->name_len, values);
+}
+
+PyObject *drgnpy_linux_helper_cgroup_walk(PyObject *self, PyObject *args,
+					  PyObject *kwds)
+{
+	static char *keywords[] = {"css", "fields", "type", NULL};
+	struct drgn_error *err;
+	DrgnObject *css;
+	PyObject *fields_obj = NULL, *fields_seq = NULL, *ret = NULL;
+	const char *type_name = NULL;
+	const char *fields[LINUX_HELPER_CGROUP_WALK_MAX_FIELDS];
+	char pointer_type_name[256];
+	struct drgn_qualified_type type;
+	struct linux_helper_cgroup_walk walk;
+	Py_ssize_t num_fields = 0, i;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|Oz:cgroup_walk",
+					 keywords, &DrgnObject_type, &css,
+					 &fields_obj, &type_name))
+		return NULL;
+
+	if (fields_obj) {
+		fields_seq = PySequence_Fast(fields_obj,
+					     "fields must be a sequence");
+		if (!fields_seq)
+			return NULL;
+		num_fields = PySequence_Fast_GET_SIZE(fields_seq);
+	}
+	if (num_fields > LINUX_HELPER_CGROUP_WALK_MAX_FIELDS) {
+		PyErr_Format(PyExc_ValueError,
+			     "at most %d cgroup fields can be read",
+			     LINUX_HELPER_CGROUP_WALK_MAX_FIELDS);
+		goto out;
+	}
+	for (i = 0; i < num_fields; i++) {
+		PyObject *item = PySequence_Fast_GET_ITEM(fields_seq, i);
+
+		if (!PyUnicode_Check(item)) {
+			PyErr_SetString(PyExc_TypeError,
+					"field must be a string");
+			goto out;
+		}
+		fields[i] = PyUnicode_AsUTF8(item);
+		if (!fields[i])
+			goto out;
+	}
+
+	snprintf(pointer_type_name, sizeof(pointer_type_name), "%s *",
+		 type_name ? type_name : "struct cgroup");
+	err = drgn_program_find_type(css->obj.prog, pointer_type_name, NULL,
+				     &type);
+	if (err) {
+		set_drgn_error(err);
+		goto out;
+	}
+	err = linux_helper_cgroup_walk(&walk, &css->obj, type_name, fields,
+				       num_fields);
+	if (err) {
+		set_drgn_error(err);
+		goto out;
+	}
+	ret = PyList_New(walk.num_entries);
+	if (!ret)
+		goto out_walk;
+	for (i = 0; i < (Py_ssize_t)walk.num_entries; i++) {
+		PyObject *item;
+
+		item = cgroup_walk_item(DrgnObject_prog(css), type, &walk, i);
+		if (!item) {
+			Py_CLEAR(ret);
+			goto out_walk;
+		}
+		PyList_SET_ITEM(ret, i, item);
+	}
+out_walk:
+	linux_helper_cgroup_walk_deinit(&walk);
+out:
+	Py_XDECREF(fields_seq);
+	return ret;
+}
+
+PyObject *drgnpy_linux_helper_btf_type_name(PyObject *self, PyObject *args,
+					    PyObject *kwds)
+{
+	static char *keywords[] = {"btf", "type_id", NULL};
+	struct drgn_error *err;
+	DrgnObject *btf_obj;
+	unsigned int type_id;
+	struct drgn_btf *btf;
+	const char *name;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!I:btf_type_name",
+					 keywords, &DrgnObject_type, &btf_obj,
+					 &type_id))
+		return NULL;
+
+	err = linux_helper_btf(&btf_obj->obj, &btf);
+	if (err)
+		return set_drgn_error(err);
+	name = drgn_btf_type_name(btf, type_id);
+	if (!name)
+		Py_RETURN_NONE;
+	return PyUnicode_FromString(name);
+}
+
+PyObject *drgnpy_linux_helper_btf_type(PyObject *self, PyObject *args,
+				       PyObject *kwds)
+{
+	static char *keywords[] = {"btf", "type_id", NULL};
+	struct drgn_error *err;
+	DrgnObject *btf_obj;
+	unsigned int type_id;
+	struct drgn_btf *btf;
+	struct drgn_qualified_type qualified_type;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!I:btf_type", keywords,
+					 &DrgnObject_type, &btf_obj, &type_id))
+		return NULL;
+
+	err = linux_helper_btf(&btf_obj->obj, &btf);
+	if (!err)
+		err = drgn_btf_type_by_id(btf, type_id, &qualified_type);
+	if (err)
+		return set_drgn_error(err);
+	return DrgnType_wrap(qualified_type,
+			     (PyObject *)DrgnObject_prog(btf_obj));
+}
+
+PyObject *drgnpy_linux_helper_blk_mq_inflight(PyObject *self, PyObject *args,
+					      PyObject *kwds)
+{
+	static char *keywords[] = {"q", NULL};
+	struct drgn_error *err;
+	DrgnObject *q;
+	Program *prog;
+	struct drgn_qualified_type rq_type, disk_type;
+	struct linux_helper_blk_mq_request *requests;
+	size_t num_requests, i;
+	PyObject *ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!:blk_mq_inflight",
+					 keywords, &DrgnObject_type, &q))
+		return NULL;
+
+	prog = DrgnObject_prog(q);
+	err = drgn_program_find_type(&prog->prog, "struct request *", NULL,
+				     &rq_type);
+	if (!err) {
+		err = drgn_program_find_type(&prog->prog, "struct gendisk *",
+					     NULL, &disk_type);
+	}
+	if (!err)
+		err = linux_helper_blk_mq_inflight(&q->obj, &requests,
+						   &num_requests);
+	if (err)
+		return set_drgn_error(err);
+	ret = PyList_New(num_requests);
+	if (!ret)
+		goto out;
+	for (i = 0; i < num_requests; i++) {
+		const struct linux_helper_blk_mq_request *req = &requests[i];
+		DrgnObject *rq, *disk;
+		PyObject *item;
+
+		rq = entry_object(prog, rq_type, req->request, 0);
+		if (!rq)
+			goto err;
+		disk = entry_object(prog, disk_type, req->disk, 0);
+		if (!disk) {
+			Py_DECREF(rq);
+			goto err;
+		}
+		item = Py_BuildValue("NNKKKII", rq, disk,
+				     (unsigned long long)req->start_time_ns,
+				     (unsigned long long)req->io_start_time_ns,
+				     (unsigned long long)req->sector,
+				     (unsigned int)req->data_len,
+				     (unsigned int)req->cmd_flags);
+		if (!item)
+			goto err;
+		PyList_SET_ITEM(ret, i, item);
+	}
+	goto out;
+
+err:
+	Py_CLEAR(ret);
+out:
+	free(requests);
+	return ret;
+}
+
+struct task_id_ranges_arg {
+	struct linux_helper_task_id_range *ranges;
+	size_t num_ranges;
+};
+
+/* Convert a sequence of (first, last) tuples to task ID ranges. */
+static int task_id_ranges_converter(PyObject *o, void *p)
+{
+	struct task_id_ranges_arg *arg = p;
+	PyObject *seq;
+	Py_ssize_t num_ranges, i;
+
+	if (!o) {
+		free(arg->ranges);
+		return 1;
+	}
+	if (o == Py_None)
+		return 1;
+	seq = PySequence_Fast(o, "ID ranges must be a sequence");
+	if (!seq)
+		return 0;
+	num_ranges = PySequence_Fast_GET_SIZE(seq);
+	arg->ranges = malloc_array(max(num_ranges, (Py_ssize_t)1),
+				   sizeof(*arg->ranges));
+	if (!arg->ranges) {
+		PyErr_NoMemory();
+		goto err;
+	}
+	for (i = 0; i < num_ranges; i++) {
+		unsigned long long first, last;
+
+		if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(seq, i), "KK",
+				      &first, &last))
+			goto err;
+		arg->ranges[i].first = first;
+		arg->ranges[i].last = last;
+	}
+	arg->num_ranges = num_ranges;
+	Py_DECREF(seq);
+	return Py_CLEANUP_SUPPORTED;
+
+err:
+	free(arg->ranges);
+	arg->ranges = NULL;
+	Py_DECREF(seq);
+	return 0;
+}
+
+PyObject *drgnpy_linux_helper_filter_tasks(PyObject *self, PyObject *args,
+					   PyObject *kwds)
+{
+	static char *keywords[] = {
+		"ns", "state", "comm", "pids", "tgids", NULL,
+	};
+	struct drgn_error *err;
+	struct prog_or_ns_arg prog_or_ns;
+	struct linux_helper_task_filter filter = {};
+	struct task_id_ranges_arg pids = {}, tgids = {};
+	struct drgn_qualified_type task_type;
+	uint64_t *tasks = NULL;
+	size_t num_tasks, i;
+	PyObject *ret = NULL;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|$zzO&O&:filter_tasks",
+					 keywords, &prog_or_pid_ns_converter,
+					 &prog_or_ns, &filter.states,
+					 &filter.comm,
+					 task_id_ranges_converter, &pids,
+					 task_id_ranges_converter, &tgids))
+		return NULL;
+	filter.pids = pids.ranges;
+	filter.num_pids = pids.num_ranges;
+	filter.tgids = tgids.ranges;
+	filter.num_tgids = tgids.num_ranges;
+
+	err = drgn_program_find_type(&prog_or_ns.prog->prog,
+				     "struct task_struct *", NULL, &task_type);
+	if (!err) {
+		err = linux_helper_filter_tasks(prog_or_ns.ns, &filter, &tasks,
+						&num_tasks);
+	}
+	if (err) {
+		set_drgn_error(err);
+		goto out;
+	}
+	ret = PyList_New(num_tasks);
+	if (!ret)
+		goto out;
+	for (i = 0; i < num_tasks; i++) {
+		DrgnObject *task;
+
+		task = entry_object(prog_or_ns.prog, task_type, tasks[i], 0);
+		if (!task) {
+			Py_CLEAR(ret);
+			goto out;
+		}
+		PyList_SET_ITEM(ret, i, (PyObject *)task);
+	}
+out:
+	free(tasks);
+	free(tgids.ranges);
+	free(pids.ranges);
+	prog_or_ns_cleanup(&prog_or_ns);
+	return ret;
+}
+
+PyObject *drgnpy_linux_helper_cache_pids(PyObject *self, PyObject *args,
+					 PyObject *kwds)
+{
+	static char *keywords[] = {"ns", NULL};
+	struct drgn_error *err;
+	struct prog_or_ns_arg prog_or_ns;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&:cache_pids", keywords,
+					 &prog_or_pid_ns_converter,
+					 &prog_or_ns))
+		return NULL;
+
+	err = linux_helper_cache_pids(prog_or_ns.ns);
+	prog_or_ns_cleanup(&prog_or_ns);
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
+/*
+ * Symbolize addresses in bulk. Returns a tuple of the names of the distinct
+ * symbols and sets indices[i] to the index of the name for addresses[i], or to
+ * SIZE_MAX if no symbol contains it.
+ */
+static PyObject *symbolize_names(struct drgn_program *prog,
+				 const uint64_t *addresses, size_t n,
+				 size_t *indices)
+{
+	struct drgn_error *err;
+	struct drgn_symbol **syms;
+	size_t num_syms, i;
+	PyObject *ret;
+
+	err = drgn_program_symbolize(prog, addresses, n, indices, &syms,
+				     &num_syms);
+	if (err)
+		return set_drgn_error(err);
+	ret = PyTuple_New(num_syms);
+	if (!ret)
+		goto out;
+	for (i = 0; i < num_syms; i++) {
+		PyObject *name = PyUnicode_FromString(drgn_symbol_name(syms[i]));
+
+		if (!name) {
+			Py_CLEAR(ret);
+			goto out;
+		}
+		PyTuple_SET_ITEM(ret, i, name);
+	}
+out:
+	free(syms);
+	return ret;
+}
+
+/* Build the {name: list} columns of the pending timers. */
+static PyObject *timer_columns(struct drgn_program *prog,
+			       const struct linux_helper_timer *timers,
+			       size_t num_timers)
+{
+	static const char * const names[] = {
+		"timer", "type", "cpu", "base", "expires", "function", "symbol",
+		"owner",
+	};
+	PyObject *columns[ARRAY_SIZE(names)] = {};
+	PyObject *kinds[2] = {}, *sym_names = NULL, *ret = NULL;
+	uint64_t *functions;
+	size_t *indices;
+	size_t i, j;
+
+	/* Symbolize the callbacks in bulk; there are few distinct ones. */
+	functions = malloc_array(num_timers ? num_timers : 1,
+				 sizeof(*functions));
+	indices = malloc_array(num_timers ? num_timers : 1, sizeof(*indices));
+	if (!functions || !indices) {
+		PyErr_NoMemory();
+		goto out;
+	}
+	for (i = 0; i < num_timers; i++)
+		functions[i] = timers[i].function;
+	sym_names = symbolize_names(prog, functions, num_timers, indices);
+	if (!sym_names)
+		goto out;
+	kinds[LINUX_HELPER_TIMER_LIST] = PyUnicode_FromString("timer_list");
+	kinds[LINUX_HELPER_TIMER_HRTIMER] = PyUnicode_FromString("hrtimer");
+	if (!kinds[LINUX_HELPER_TIMER_LIST] ||
+	    !kinds[LINUX_HELPER_TIMER_HRTIMER])
+		goto out;
+
+	for (j = 0; j < ARRAY_SIZE(names); j++) {
+		columns[j] = PyList_New(num_timers);
+		if (!columns[j])
+			goto out;
+	}
+	for (i = 0; i < num_timers; i++) {
+		const struct linux_helper_timer *timer = &timers[i];
+		PyObject *kind = kinds[timer->kind];
+		PyObject *sym_name = (indices[i] == SIZE_MAX ? Py_None :
+				      PyTuple_GET_ITEM(sym_names, indices[i]));
+		PyObject *values[ARRAY_SIZE(names)] = {
+			PyLong_FromUnsignedLongLong(timer->timer),
+			kind,
+			PyLong_FromUnsignedLong(timer->cpu),
+			PyLong_FromUnsignedLong(timer->base),
+			/* hrtimer expiry times are ktime_t, which is signed. */
+			timer->kind == LINUX_HELPER_TIMER_HRTIMER ?
+			PyLong_FromLongLong((int64_t)timer->expires) :
+			PyLong_FromUnsignedLongLong(timer->expires),
+			PyLong_FromUnsignedLongLong(timer->function),
+			sym_name,
+			PyLong_FromUnsignedLongLong(timer->owner),
+		};
+		bool ok = true;
+
+		Py_INCREF(kind);
+		Py_INCREF(sym_name);
+		for (j = 0; j < ARRAY_SIZE(names); j++) {
+			if (values[j])
+				PyList_SET_ITEM(columns[j], i, values[j]);
+			else
+				ok = false;
+		}
+		if (!ok)
+			goto out;
+	}
+	ret = PyDict_New();
+	if (!ret)
+		goto out;
+	for (j = 0; j < ARRAY_SIZE(names); j++) {
+		if (PyDict_SetItemString(ret, names[j], columns[j]) == -1) {
+			Py_CLEAR(ret);
+			goto out;
+		}
+	}
+out:
+	for (j = 0; j < ARRAY_SIZE(names); j++)
+		Py_XDECREF(columns[j]);
+	Py_XDECREF(kinds[LINUX_HELPER_TIMER_HRTIMER]);
+	Py_XDECREF(kinds[LINUX_HELPER_TIMER_LIST]);
+	Py_XDECREF(sym_names);
+	free(indices);
+	free(functions);
+	return ret;
+}
+
+PyObject *drgnpy_linux_helper_pending_timers(PyObject *self, PyObject *args,
+					     PyObject *kwds)
+{
+	static char *keywords[] = {"prog", NULL};
+	struct drgn_error *err;
+	Program *prog;
+	struct linux_helper_timer *timers;
+	size_t num_timers;
+	PyObject *ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!:pending_timers",
+					 keywords, &Program_type, &prog))
+		return NULL;
+
+	err = linux_helper_pending_timers(&prog->prog, &timers, &num_timers);
+	if (err)
+		return set_drgn_error(err);
+	ret = timer_columns(&prog->prog, timers, num_timers);
+	free(timers);
+	return ret;
+}
+
+PyObject *drgnpy_linux_helper_page_owner_stacks(PyObject *self, PyObject *args,
+						PyObject *kwds)
+{
+	static char *keywords[] = {"prog", NULL};
+	struct drgn_error *err;
+	Program *prog;
+	struct linux_helper_page_owner_stack *stacks;
+	size_t num_stacks, i, j;
+	PyObject *ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!:page_owner_stacks",
+					 keywords, &Program_type, &prog))
+		return NULL;
+
+	err = linux_helper_page_owner_stacks(&prog->prog, &stacks,
+					     &num_stacks);
+	if (err)
+		return set_drgn_error(err);
+	ret = PyList_New(num_stacks);
+	if (!ret)
+		goto out;
+	for (i = 0; i < num_stacks; i++) {
+		const struct linux_helper_page_owner_stack *stack = &stacks[i];
+		PyObject *pcs, *item;
+
+		pcs = PyTuple_New(stack->num_pcs);
+		if (!pcs)
+			goto err;
+		for (j = 0; j < stack->num_pcs; j++) {
+			PyObject *pc;
+
+			pc = PyLong_FromUnsignedLongLong(stack->pcs[j]);
+			if (!pc) {
+				Py_DECREF(pcs);
+				goto err;
+			}
+			PyTuple_SET_ITEM(pcs, j, pc);
+		}
+		item = Py_BuildValue("INKK", (unsigned int)stack->handle, pcs,
+				     (unsigned long long)stack->allocations,
+				     (unsigned long long)stack->pages);
+		if (!item)
+			goto err;
+		PyList_SET_ITEM(ret, i, item);
+	}
+	goto out;
+
+err:
+	Py_CLEAR(ret);
+out:
+	linux_helper_page_owner_stacks_destroy(stacks, num_stacks);
+	return ret;
+}
+
+/*
+ * Build a {name: list} dictionary from columns and steal the references to the
+ * columns.
+ */
+static PyObject *columns_dict(const char * const *names, PyObject **columns,
+			      size_t num_columns)
+{
+	PyObject *ret;
+	size_t j;
+
+	ret = PyDict_New();
+	if (ret) {
+		for (j = 0; j < num_columns; j++) {
+			if (PyDict_SetItemString(ret, names[j],
+						 columns[j]) == -1) {
+				Py_CLEAR(ret);
+				break;
+			}
+		}
+	}
+	for (j = 0; j < num_columns; j++)
+		Py_DECREF(columns[j]);
+	return ret;
+}
+
+/* Build the {name: list} columns of the runqueues. */
+static PyObject *
+runqueue_columns(const struct linux_helper_runqueue *runqueues,
+		 size_t num_runqueues)
+{
+	static const char * const names[] = {
+		"cpu", "rq", "curr", "nr_running", "cfs_nr_running",
+		"rt_nr_running", "dl_nr_running", "cfs_load_weight",
+		"cfs_load_avg", "clock",
+	};
+	PyObject *columns[ARRAY_SIZE(names)] = {};
+	size_t i, j;
+
+	for (j = 0; j < ARRAY_SIZE(names); j++) {
+		columns[j] = PyList_New(num_runqueues);
+		if (!columns[j])
+			goto err;
+	}
+	for (i = 0; i < num_runqueues; i++) {
+		const struct linux_helper_runqueue *rq = &runqueues[i];
+		PyObject *values[ARRAY_SIZE(names)] = {
+			PyLong_FromUnsignedLong(rq->cpu),
+			PyLong_FromUnsignedLongLong(rq->rq),
+			PyLong_FromUnsignedLongLong(rq->curr),
+			PyLong_FromUnsignedLongLong(rq->nr_running),
+			PyLong_FromUnsignedLongLong(rq->cfs_nr_running),
+			PyLong_FromUnsignedLongLong(rq->rt_nr_running),
+			PyLong_FromUnsignedLongLong(rq->dl_nr_running),
+			PyLong_FromUnsignedLongLong(rq->cfs_load_weight),
+			PyLong_FromUnsignedLongLong(rq->cfs_load_avg),
+			PyLong_FromUnsignedLongLong(rq->clock),
+		};
+		bool ok = true;
+
+		for (j = 0; j < ARRAY_SIZE(names); j++) {
+			if (values[j])
+				PyList_SET_ITEM(columns[j], i, values[j]);
+			else
+				ok = false;
+		}
+		if (!ok)
+			goto err;
+	}
+	return columns_dict(names, columns, ARRAY_SIZE(names));
+
+err:
+	for (j = 0; j < ARRAY_SIZE(names); j++)
+		Py_XDECREF(columns[j]);
+	return NULL;
+}
+
+/* Build the {name: list} columns of the tasks on the runqueues. */
+static PyObject *
+runqueue_task_columns(const struct linux_helper_runqueue_task *tasks,
+		      size_t num_tasks)
+{
+	static const char * const names[] = {
+		"cpu", "task", "class", "prio", "vruntime", "deadline",
+		"current",
+	};
+	static const char * const class_names[] = {
+		[LINUX_HELPER_SCHED_FAIR] = "fair",
+		[LINUX_HELPER_SCHED_RT] = "rt",
+		[LINUX_HELPER_SCHED_DL] = "dl",
+		[LINUX_HELPER_SCHED_IDLE] = "idle",
+		[LINUX_HELPER_SCHED_STOP] = "stop",
+		[LINUX_HELPER_SCHED_OTHER] = "other",
+	};
+	PyObject *columns[ARRAY_SIZE(names)] = {};
+	PyObject *classes[ARRAY_SIZE(class_names)] = {};
+	PyObject *ret = NULL;
+	size_t i, j;
+
+	for (j = 0; j < ARRAY_SIZE(class_names); j++) {
+		classes[j] = PyUnicode_InternFromString(class_names[j]);
+		if (!classes[j])
+			goto err;
+	}
+	for (j = 0; j < ARRAY_SIZE(names); j++) {
+		columns[j] = PyList_New(num_tasks);
+		if (!columns[j])
+			goto err;
+	}
+	for (i = 0; i < num_tasks; i++) {
+		const struct linux_helper_runqueue_task *task = &tasks[i];
+		PyObject *values[ARRAY_SIZE(names)] = {
+			PyLong_FromUnsignedLong(task->cpu),
+			PyLong_FromUnsignedLongLong(task->task),
+			classes[task->sched_class],
+			PyLong_FromLong(task->prio),
+			task->sched_class == LINUX_HELPER_SCHED_FAIR ?
+			PyLong_FromUnsignedLongLong(task->key) : Py_None,
+			task->sched_class == LINUX_HELPER_SCHED_DL ?
+			PyLong_FromUnsignedLongLong(task->key) : Py_None,
+			PyBool_FromLong(task->current),
+		};
+		bool ok = true;
+
+		Py_INCREF(classes[task->sched_class]);
+		if (task->sched_class != LINUX_HELPER_SCHED_FAIR)
+			Py_INCREF(Py_None);
+		if (task->sched_class != LINUX_HELPER_SCHED_DL)
+			Py_INCREF(Py_None);
+		for (j = 0; j < ARRAY_SIZE(names); j++) {
+			if (values[j])
+				PyList_SET_ITEM(columns[j], i, values[j]);
+			else
+				ok = false;
+		}
+		if (!ok)
+			goto err;
+	}
+	ret = columns_dict(names, columns, ARRAY_SIZE(names));
+	goto out;
+
+err:
+	for (j = 0; j < ARRAY_SIZE(names); j++)
+		Py_XDECREF(columns[j]);
+out:
+	for (j = 0; j < ARRAY_SIZE(class_names); j++)
+		Py_XDECREF(classes[j]);
+	return ret;
+}
+
+PyObject *drgnpy_linux_helper_runqueues(PyObject *self, PyObject *args,
+					PyObject *kwds)
+{
+	static char *keywords[] = {"prog", NULL};
+	struct drgn_error *err;
+	Program *prog;
+	struct linux_helper_runqueue *runqueues;
+	struct linux_helper_runqueue_task *tasks;
+	size_t num_runqueues, num_tasks;
+	PyObject *cpu_columns, *task_columns = NULL, *ret = NULL;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!:runqueues", keywords,
+					 &Program_type, &prog))
+		return NULL;
+
+	err = linux_helper_runqueues(&prog->prog, &runqueues, &num_runqueues,
+				     &tasks, &num_tasks);
+	if (err)
+		return set_drgn_error(err);
+	cpu_columns = runqueue_columns(runqueues, num_runqueues);
+	if (cpu_columns)
+		task_columns = runqueue_task_columns(tasks, num_tasks);
+	if (task_columns)
+		ret = Py_BuildValue("NN", cpu_columns, task_columns);
+	else
+		Py_XDECREF(cpu_columns);
+	free(tasks);
+	free(runqueues);
+	return ret;
+}
+
+/*
+ * Create a bytes object of n native uint64_t values, which is converted to an
+ * array("Q") in Python.
+ */
+static PyObject *uint64_column(size_t n, char **data_ret)
+{
+	PyObject *ret;
+
+	ret = PyBytes_FromStringAndSize(NULL, n * sizeof(uint64_t));
+	if (ret)
+		*data_ret = PyBytes_AS_STRING(ret);
+	return ret;
+}
+
+static void uint64_column_set(char *data, size_t i, uint64_t value)
+{
+	memcpy(data + i * sizeof(value), &value, sizeof(value));
+}
+
+PyObject *drgnpy_linux_helper_task_rss(PyObject *self, PyObject *args,
+				       PyObject *kwds)
+{
+	static char *keywords[] = {"ns", NULL};
+	static const char * const names[] = {
+		"task", "mm", "file", "anon", "shmem", "rss",
+	};
+	struct drgn_error *err;
+	struct prog_or_ns_arg prog_or_ns;
+	struct linux_helper_task_rss *tasks;
+	PyObject *columns[ARRAY_SIZE(names)] = {};
+	char *data[ARRAY_SIZE(names)];
+	PyObject *ret = NULL;
+	size_t num_tasks, i, j;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&:task_rss", keywords,
+					 &prog_or_pid_ns_converter,
+					 &prog_or_ns))
+		return NULL;
+
+	err = linux_helper_task_rss(prog_or_ns.ns, &tasks, &num_tasks);
+	if (err) {
+		set_drgn_error(err);
+		goto out;
+	}
+	for (j = 0; j < ARRAY_SIZE(names); j++) {
+		columns[j] = uint64_column(num_tasks, &data[j]);
+		if (!columns[j])
+			goto out_tasks;
+	}
+	for (i = 0; i < num_tasks; i++) {
+		const struct linux_helper_task_rss *task = &tasks[i];
+
+		uint64_column_set(data[0], i, task->task);
+		uint64_column_set(data[1], i, task->mm);
+		uint64_column_set(data[2], i, task->file);
+		uint64_column_set(data[3], i, task->anon);
+		uint64_column_set(data[4], i, task->shmem);
+		uint64_column_set(data[5], i,
+				  task->file + task->anon + task->shmem);
+	}
+	ret = columns_dict(names, columns, ARRAY_SIZE(names));
+	memset(columns, 0, sizeof(columns));
+out_tasks:
+	for (j = 0; j < ARRAY_SIZE(names); j++)
+		Py_XDECREF(columns[j]);
+	free(tasks);
+out:
+	prog_or_ns_cleanup(&prog_or_ns);
+	return ret;
+}
+
+PyObject *drgnpy_linux_helper_memcg_usage(PyObject *self, PyObject *args,
+					  PyObject *kwds)
+{
+	static char *keywords[] = {"css", NULL};
+	static const char * const names[] = {
+		"memcg", "depth", "flags", "usage", "stock", "name",
+	};
+	struct drgn_error *err;
+	DrgnObject *css;
+	struct linux_helper_cgroup_walk walk;
+	uint64_t *stock;
+	PyObject *columns[ARRAY_SIZE(names)] = {};
+	char *data[ARRAY_SIZE(names) - 1];
+	PyObject *ret = NULL;
+	size_t i, j;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!:memcg_usage",
+					 keywords, &DrgnObject_type, &css))
+		return NULL;
+
+	err = linux_helper_memcg_usage(&walk, &stock, &css->obj);
+	if (err)
+		return set_drgn_error(err);
+	for (j = 0; j < ARRAY_SIZE(data); j++) {
+		columns[j] = uint64_column(walk.num_entries, &data[j]);
+		if (!columns[j])
+			goto out;
+	}
+	columns[ARRAY_SIZE(data)] = PyList_New(walk.num_entries);
+	if (!columns[ARRAY_SIZE(data)])
+		goto out;
+	for (i = 0; i < walk.num_entries; i++) {
+		const struct linux_helper_cgroup_walk_entry *entry =
+			&walk.entries[i];
+		PyObject *name;
+
+		uint64_column_set(data[0], i, entry->address);
+		uint64_column_set(data[1], i, entry->depth);
+		uint64_column_set(data[2], i, entry->flags);
+		uint64_column_set(data[3], i, walk.values[i]);
+		uint64_column_set(data[4], i, stock[i]);
+		name = PyBytes_FromStringAndSize(walk.names +
+						 entry->name_offset,
+						 entry->name_len);
+		if (!name)
+			goto out;
+		PyList_SET_ITEM(columns[ARRAY_SIZE(data)], i, name);
+	}
+	ret = columns_dict(names, columns, ARRAY_SIZE(names));
+	memset(columns, 0, sizeof(columns));
+out:
+	for (j = 0; j < ARRAY_SIZE(names); j++)
+		Py_XDECREF(columns[j]);
+	free(stock);
+	linux_helper_cgroup_walk_deinit(&walk);
+	return ret;
+}
+
+/* Build the {name: list} columns of vmalloc areas. */
+static PyObject *
+vmalloc_area_columns(struct drgn_program *prog,
+		     const struct linux_helper_vmalloc_area *areas,
+		     size_t num_areas)
+{
+	static const char * const names[] = {
+		"address", "size", "caller", "symbol", "pages", "vm", "flags",
+	};
+	PyObject *columns[ARRAY_SIZE(names)] = {};
+	PyObject *sym_names = NULL, *ret = NULL;
+	uint64_t *callers;
+	size_t *indices;
+	size_t i, j;
+
+	callers = malloc_array(max(num_areas, (size_t)1), sizeof(*callers));
+	indices = malloc_array(max(num_areas, (size_t)1), sizeof(*indices));
+	if (!callers || !indices) {
+		PyErr_NoMemory();
+		goto out;
+	}
+	for (i = 0; i < num_areas; i++)
+		callers[i] = areas[i].caller;
+	sym_names = symbolize_names(prog, callers, num_areas, indices);
+	if (!sym_names)
+		goto out;
+
+	for (j = 0; j < ARRAY_SIZE(names); j++) {
+		columns[j] = PyList_New(num_areas);
+		if (!columns[j])
+			goto out;
+	}
+	for (i = 0; i < num_areas; i++) {
+		const struct linux_helper_vmalloc_area *area = &areas[i];
+		PyObject *sym_name = (indices[i] == SIZE_MAX ? Py_None :
+				      PyTuple_GET_ITEM(sym_names, indices[i]));
+		PyObject *values[ARRAY_SIZE(names)] = {
+			PyLong_FromUnsignedLongLong(area->address),
+			PyLong_FromUnsignedLongLong(area->size),
+			PyLong_FromUnsignedLongLong(area->caller),
+			sym_name,
+			PyLong_FromUnsignedLongLong(area->pages),
+			PyLong_FromUnsignedLongLong(area->vm),
+			PyLong_FromUnsignedLongLong(area->flags),
+		};
+		bool ok = true;
+
+		Py_INCREF(sym_name);
+		for (j = 0; j < ARRAY_SIZE(names); j++) {
+			if (values[j])
+				PyList_SET_ITEM(columns[j], i, values[j]);
+			else
+				ok = false;
+		}
+		if (!ok)
+			goto out;
+	}
+	ret = columns_dict(names, columns, ARRAY_SIZE(names));
+	memset(columns, 0, sizeof(columns));
+out:
+	for (j = 0; j < ARRAY_SIZE(names); j++)
+		Py_XDECREF(columns[j]);
+	Py_XDECREF(sym_names);
+	free(indices);
+	free(callers);
+	return ret;
+}
+
+/* Build the {name: list} columns of vmalloc usage by caller. */
+static PyObject *
+vmalloc_caller_columns(struct drgn_program *prog,
+		       const struct linux_helper_vmalloc_caller *callers,
+		       size_t num_callers)
+{
+	static const char * const names[] = {
+		"caller", "symbol", "areas", "size", "pages",
+	};
+	PyObject *columns[ARRAY_SIZE(names)] = {};
+	PyObject *sym_names = NULL, *ret = NULL;
+	uint64_t *addresses;
+	size_t *indices;
+	size_t i, j;
+
+	addresses = malloc_array(max(num_callers, (size_t)1),
+				 sizeof(*addresses));
+	indices = malloc_array(max(num_callers, (size_t)1), sizeof(*indices));
+	if (!addresses || !indices) {
+		PyErr_NoMemory();
+		goto out;
+	}
+	for (i = 0; i < num_callers; i++)
+		addresses[i] = callers[i].caller;
+	sym_names = symbolize_names(prog, addresses, num_callers, indices);
+	if (!sym_names)
+		goto out;
+
+	for (j = 0; j < ARRAY_SIZE(names); j++) {
+		columns[j] = PyList_New(num_callers);
+		if (!columns[j])
+			goto out;
+	}
+	for (i = 0; i < num_callers; i++) {
+		const struct linux_helper_vmalloc_caller *caller = &callers[i];
+		PyObject *sym_name = (indices[i] == SIZE_MAX ? Py_None :
+				      PyTuple_GET_ITEM(sym_names, indices[i]));
+		PyObject *values[ARRAY_SIZE(names)] = {
+			PyLong_FromUnsignedLongLong(caller->caller),
+			sym_name,
+			PyLong_FromUnsignedLongLong(caller->areas),
+			PyLong_FromUnsignedLongLong(caller->size),
+			PyLong_FromUnsignedLongLong(caller->pages),
+		};
+		bool ok = true;
+
+		Py_INCREF(sym_name);
+		for (j = 0; j < ARRAY_SIZE(names); j++) {
+			if (values[j])
+				PyList_SET_ITEM(columns[j], i, values[j]);
+			else
+				ok = false;
+		}
+		if (!ok)
+			goto out;
+	}
+	ret = columns_dict(names, columns, ARRAY_SIZE(names));
+	memset(columns, 0, sizeof(columns));
+out:
+	for (j = 0; j < ARRAY_SIZE(names); j++)
+		Py_XDECREF(columns[j]);
+	Py_XDECREF(sym_names);
+	free(indices);
+	free(addresses);
+	return ret;
+}
+
+PyObject *drgnpy_linux_helper_vmalloc_areas(PyObject *self, PyObject *args,
+					    PyObject *kwds)
+{
+	static char *keywords[] = {"prog", "by_caller", NULL};
+	struct drgn_error *err;
+	Program *prog;
+	int by_caller = 0;
+	struct linux_helper_vmalloc_area *areas;
+	struct linux_helper_vmalloc_caller *callers;
+	size_t num_areas, num_callers;
+	PyObject *ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|p:vmalloc_areas",
+					 keywords, &Program_type, &prog,
+					 &by_caller))
+		return NULL;
+
+	err = linux_helper_vmalloc_areas(&prog->prog, &areas, &num_areas);
+	if (err)
+		return set_drgn_error(err);
+	if (!by_caller) {
+		ret = vmalloc_area_columns(&prog->prog, areas, num_areas);
+		free(areas);
+		return ret;
+	}
+	err = linux_helper_vmalloc_callers(areas, num_areas, &callers,
+					   &num_callers);
+	free(areas);
+	if (err)
+		return set_drgn_error(err);
+	ret = vmalloc_caller_columns(&prog->prog, callers, num_callers);
+	free(callers);
+	return ret;
+}
+
+static PyObject *
+glibc_malloc_stats_to_python(const struct glibc_helper_malloc_stats *stats)
+{
+	PyObject *size_classes, *ret;
+	size_t i;
+
+	size_classes = PyList_New(stats->num_size_classes);
+	if (!size_classes)
+		return NULL;
+	for (i = 0; i < stats->num_size_classes; i++) {
+		PyObject *item;
+
+		item = Py_BuildValue("KK",
+				     (unsigned long long)stats->size_classes[i].size,
+				     (unsigned long long)stats->size_classes[i].count);
+		if (!item) {
+			Py_DECREF(size_classes);
+			return NULL;
+		}
+		PyList_SET_ITEM(size_classes, i, item);
+	}
+	ret = Py_BuildValue("{sKsKsKsKsKsKsKsKsKsN}",
+			    "arenas", (unsigned long long)stats->arenas,
+			    "heaps", (unsigned long long)stats->heaps,
+			    "in_use_chunks",
+			    (unsigned long long)stats->in_use_chunks,
+			    "in_use_bytes", (unsigned long long)stats->in_use_bytes,
+			    "free_chunks", (unsigned long long)stats->free_chunks,
+			    "free_bytes", (unsigned long long)stats->free_bytes,
+			    "fastbin_chunks",
+			    (unsigned long long)stats->fastbin_chunks,
+			    "fastbin_bytes",
+			    (unsigned long long)stats->fastbin_bytes,
+			    "top_bytes", (unsigned long long)stats->top_bytes,
+			    "size_classes", size_classes);
+	if (!ret)
+		Py_DECREF(size_classes);
+	return ret;
+}
+
+PyObject *drgnpy_glibc_helper_malloc_walk(PyObject *self, PyObject *args,
+					  PyObject *kwds)
+{
+	static char *keywords[] = {
+		"prog", "min_size", "max_size", "chunks", NULL,
+	};
+	struct drgn_error *err;
+	Program *prog;
+	struct index_arg min_size = {};
+	struct index_arg max_size = { .allow_none = true, .is_none = true };
+	int want_chunks = 0;
+	struct glibc_helper_malloc_stats stats;
+	struct glibc_helper_malloc_chunk *chunks = NULL;
+	size_t num_chunks = 0, i;
+	PyObject *stats_obj, *chunks_obj;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|O&O&p:malloc_walk",
+					 keywords, &Program_type, &prog,
+					 index_converter, &min_size,
+					 index_converter, &max_size,
+					 &want_chunks))
+		return NULL;
+
+	Py_BEGIN_ALLOW_THREADS
+	err = glibc_helper_malloc_walk(&prog->prog, &stats, min_size.uvalue,
+				       max_size.is_none ?
+				       UINT64_MAX : max_size.uvalue,
+				       want_chunks ? &chunks : NULL,
+				       &num_chunks);
+	Py_END_ALLOW_THREADS
+	if (err)
+		return set_drgn_error(err);
+
+	stats_obj = glibc_malloc_stats_to_python(&stats);
+	glibc_helper_malloc_stats_deinit(&stats);
+	if (!stats_obj)
+		goto err;
+	if (!want_chunks)
+		return Py_BuildValue("NO", stats_obj, Py_None);
+	chunks_obj = PyList_New(num_chunks);
+	if (!chunks_obj) {
+		Py_DECREF(stats_obj);
+		goto err;
+	}
+	for (i = 0; i < num_chunks; i++) {
+		PyObject *item;
+
+		item = Py_BuildValue("KK",
+				     (unsigned long long)chunks[i].address,
+				     (unsigned long long)chunks[i].size);
+		if (!item) {
+			Py_DECREF(chunks_obj);
+			Py_DECREF(stats_obj);
+			goto err;
+		}
+		PyList_SET_ITEM(chunks_obj, i, item);
+	}
+	free(chunks);
+	return Py_BuildValue("NN", stats_obj, chunks_obj);
+
+err:
+	free(chunks);
+	return NULL;
+}
@@ -0,0 +1,168 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include "drgnpy.h"
+
+PyObject *MemberPath_wrap(Program *prog,
+			  struct drgn_qualified_type container_type,
+			  PyObject *designator,
+			  const struct drgn_member_info *info)
+{
+	MemberPath *ret;
+
+	ret = (MemberPath *)MemberPath_type.tp_alloc(&MemberPath_type, 0);
+	if (!ret)
+		return NULL;
+	ret->prog = prog;
+	Py_INCREF(prog);
+	ret->info = *info;
+	Py_INCREF(designator);
+	ret->designator = designator;
+	ret->container_type = DrgnType_wrap(container_type, (PyObject *)prog);
+	if (!ret->container_type)
+		goto err;
+	ret->type = DrgnType_wrap(info->qualified_type, (PyObject *)prog);
+	if (!ret->type)
+		goto err;
+	return (PyObject *)ret;
+
+err:
+	Py_DECREF(ret);
+	return NULL;
+}
+
+static void MemberPath_dealloc(MemberPath *self)
+{
+	Py_XDECREF(self->type);
+	Py_XDECREF(self->container_type);
+	Py_XDECREF(self->designator);
+	Py_XDECREF(self->prog);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *MemberPath_repr(MemberPath *self)
+{
+	return PyUnicode_FromFormat("MemberPath(%R, %R)", self->container_type,
+				    self->designator);
+}
+
+static DrgnObject *MemberPath_apply(MemberPath *self, PyObject *args,
+				    PyObject *kwds)
+{
+	static char *keywords[] = {"obj", NULL};
+	struct drgn_error *err;
+	PyObject *arg;
+	DrgnObject *res;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:apply", keywords,
+					 &arg))
+		return NULL;
+
+	res = DrgnObject_alloc(self->prog);
+	if (!res)
+		return NULL;
+
+	if (PyObject_TypeCheck(arg, &DrgnObject_type)) {
+		DrgnObject *obj = (DrgnObject *)arg;
+
+		if (DrgnObject_prog(obj) != self->prog) {
+			PyErr_SetString(PyExc_ValueError,
+					"object is from different program");
+			goto err;
+		}
+		if (obj->obj.kind == DRGN_OBJECT_UNSIGNED &&
+		    drgn_type_kind(drgn_underlying_type(obj->obj.type)) ==
+		    DRGN_TYPE_POINTER) {
+			err = drgn_object_dereference_offset(&res->obj,
+							     &obj->obj,
+							     self->info.qualified_type,
+							     self->info.bit_offset,
+							     self->info.bit_field_size);
+		} else {
+			err = drgn_object_slice(&res->obj, &obj->obj,
+						self->info.qualified_type,
+						self->info.bit_offset,
+						self->info.bit_field_size);
+		}
+	} else {
+		struct index_arg address = {};
+		uint64_t byte_offset = self->info.bit_offset / 8;
+
+		if (!index_converter(arg, &address))
+			goto err;
+		err = drgn_object_set_reference(&res->obj,
+						self->info.qualified_type,
+						address.uvalue + byte_offset,
+						self->info.bit_offset % 8,
+						self->info.bit_field_size,
+						DRGN_PROGRAM_ENDIAN);
+	}
+	if (err) {
+		set_drgn_error(err);
+		goto err;
+	}
+	return res;
+
+err:
+	Py_DECREF(res);
+	return NULL;
+}
+
+static PyObject *MemberPath_get_container_type(MemberPath *self, void *arg)
+{
+	Py_INCREF(self->container_type);
+	return self->container_type;
+}
+
+static PyObject *MemberPath_get_designator(MemberPath *self, void *arg)
+{
+	Py_INCREF(self->designator);
+	return self->designator;
+}
+
+static PyObject *MemberPath_get_type(MemberPath *self, void *arg)
+{
+	Py_INCREF(self->type);
+	return self->type;
+}
+
+static PyObject *MemberPath_get_bit_offset(MemberPath *self, void *arg)
+{
+	return PyLong_FromUnsignedLongLong(self->info.bit_offset);
+}
+
+static PyObject *MemberPath_get_bit_field_size(MemberPath *self, void *arg)
+{
+	return PyLong_FromUnsignedLongLong(self->info.bit_field_size);
+}
+
+static PyMethodDef MemberPath_methods[] = {
+	{"apply", (PyCFunction)MemberPath_apply, METH_VARARGS | METH_KEYWORDS,
+	 drgn_MemberPath_apply_DOC},
+	{},
+};
+
+static PyGetSetDef MemberPath_getset[] = {
+	{"container_type", (getter)MemberPath_get_container_type, NULL,
+	 drgn_MemberPath_container_type_DOC},
+	{"designator", (getter)MemberPath_get_designator, NULL,
+	 drgn_MemberPath_designator_DOC},
+	{"type", (getter)MemberPath_get_type, NULL, drgn_MemberPath_type_DOC},
+	{"bit_offset", (getter)MemberPath_get_bit_offset, NULL,
+	 drgn_MemberPath_bit_offset_DOC},
+	{"bit_field_size", (getter)MemberPath_get_bit_field_size, NULL,
+	 drgn_MemberPath_bit_field_size_DOC},
+	{},
+};
+
+PyTypeObject MemberPath_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "_drgn.MemberPath",
+	.tp_basicsize = sizeof(MemberPath),
+	.tp_dealloc = (destructor)MemberPath_dealloc,
+	.tp_repr = (reprfunc)MemberPath_repr,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = drgn_MemberPath_DOC,
+	.tp_methods = MemberPath_methods,
+	.tp_getset = MemberPath_getset,
+};
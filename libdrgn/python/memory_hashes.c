@@ -0,0 +1,105 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include "drgnpy.h"
+#include "../memory_diff.h"
+#include "../memory_reader.h"
+
+PyObject *MemoryHashes_wrap(struct drgn_memory_hashes *hashes)
+{
+	MemoryHashes *ret;
+
+	ret = (MemoryHashes *)MemoryHashes_type.tp_alloc(&MemoryHashes_type, 0);
+	if (!ret) {
+		drgn_memory_hashes_destroy(hashes);
+		return NULL;
+	}
+	ret->hashes = hashes;
+	return (PyObject *)ret;
+}
+
+static void MemoryHashes_dealloc(MemoryHashes *self)
+{
+	if (self->hashes)
+		drgn_memory_hashes_destroy(self->hashes);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static Py_ssize_t MemoryHashes_length(MemoryHashes *self)
+{
+	return self->hashes->num_pages;
+}
+
+static PyObject *MemoryHashes_get_physical(MemoryHashes *self, void *arg)
+{
+	return PyBool_FromLong(self->hashes->physical);
+}
+
+static PyObject *MemoryHashes_diff(MemoryHashes *self, PyObject *args,
+				   PyObject *kwds)
+{
+	static char *keywords[] = {"other", NULL};
+	struct drgn_error *err;
+	MemoryHashes *other;
+	struct drgn_memory_range *regions;
+	size_t count, i;
+	PyObject *ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!:diff", keywords,
+					 &MemoryHashes_type, &other))
+		return NULL;
+
+	Py_BEGIN_ALLOW_THREADS
+	err = drgn_memory_hashes_diff(self->hashes, other->hashes, &regions,
+				      &count);
+	Py_END_ALLOW_THREADS
+	if (err)
+		return set_drgn_error(err);
+	ret = PyList_New(count);
+	if (!ret)
+		goto out;
+	for (i = 0; i < count; i++) {
+		PyObject *item;
+
+		item = Py_BuildValue("KK",
+				     (unsigned long long)regions[i].start,
+				     (unsigned long long)(regions[i].last -
+							  regions[i].start + 1));
+		if (!item) {
+			Py_CLEAR(ret);
+			goto out;
+		}
+		PyList_SET_ITEM(ret, i, item);
+	}
+out:
+	free(regions);
+	return ret;
+}
+
+static PyMethodDef MemoryHashes_methods[] = {
+	{"diff", (PyCFunction)MemoryHashes_diff, METH_VARARGS | METH_KEYWORDS,
+	 drgn_MemoryHashes_diff_DOC},
+	{},
+};
+
+static PyGetSetDef MemoryHashes_getset[] = {
+	{"physical", (getter)MemoryHashes_get_physical, NULL,
+	 drgn_MemoryHashes_physical_DOC},
+	{},
+};
+
+static PySequenceMethods MemoryHashes_as_sequence = {
+	.sq_length = (lenfunc)MemoryHashes_length,
+};
+
+PyTypeObject MemoryHashes_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "_drgn.MemoryHashes",
+	.tp_basicsize = sizeof(MemoryHashes),
+	.tp_dealloc = (destructor)MemoryHashes_dealloc,
+	.tp_as_sequence = &MemoryHashes_as_sequence,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = drgn_MemoryHashes_DOC,
+	.tp_methods = MemoryHashes_methods,
+	.tp_getset = MemoryHashes_getset,
+};
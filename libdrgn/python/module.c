@@ -51,6 +51,45 @@ static PyObject *filename_matches(PyObject *self, PyObject *args,
 		Py_RETURN_FALSE;
 }
 
+static PyObject *set_num_threads(PyObject *self, PyObject *args,
+				 PyObject *kwds)
+{
+	static char *keywords[] = {"num_threads", NULL};
+	int num_threads;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "i:set_num_threads",
+					 keywords, &num_threads))
+		return NULL;
+	if (num_threads < 0) {
+		PyErr_SetString(PyExc_ValueError,
+				"num_threads cannot be negative");
+		return NULL;
+	}
+	drgn_set_num_threads(num_threads);
+	Py_RETURN_NONE;
+}
+
+static PyObject *get_num_threads(PyObject *self)
+{
+	return PyLong_FromLong(drgn_num_threads());
+}
+
+static PyObject *set_background_reads(PyObject *self, PyObject *args,
+				      PyObject *kwds)
+{
+	static char *keywords[] = {"background", NULL};
+	int background;
+	enum drgn_read_priority old;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "p:set_background_reads",
+					 keywords, &background))
+		return NULL;
+	old = drgn_set_read_priority(background ?
+				     DRGN_READ_PRIORITY_BACKGROUND :
+				     DRGN_READ_PRIORITY_INTERACTIVE);
+	return PyBool_FromLong(old == DRGN_READ_PRIORITY_BACKGROUND);
+}
+
 static PyObject *sizeof_(PyObject *self, PyObject *arg)
 {
 	struct drgn_error *err;
@@ -76,6 +115,19 @@ static PyMethodDef drgn_methods[] = {
 	{"NULL", (PyCFunction)DrgnObject_NULL, METH_VARARGS | METH_KEYWORDS,
 	 drgn_NULL_DOC},
 	{"sizeof", (PyCFunction)sizeof_, METH_O, drgn_sizeof_DOC},
+	{"format_objects", (PyCFunction)format_objects,
+	 METH_VARARGS | METH_KEYWORDS, drgn_format_objects_DOC},
+	{"_unpickle_program", (PyCFunction)drgnpy_unpickle_program,
+	 METH_VARARGS},
+	{"_unpickle_type", (PyCFunction)drgnpy_unpickle_type, METH_VARARGS},
+	{"_unpickle_object", (PyCFunction)drgnpy_unpickle_object,
+	 METH_VARARGS},
+	{"set_num_threads", (PyCFunction)set_num_threads,
+	 METH_VARARGS | METH_KEYWORDS, drgn_set_num_threads_DOC},
+	{"get_num_threads", (PyCFunction)get_num_threads, METH_NOARGS,
+	 drgn_get_num_threads_DOC},
+	{"set_background_reads", (PyCFunction)set_background_reads,
+	 METH_VARARGS | METH_KEYWORDS, drgn_set_background_reads_DOC},
 	{"cast", (PyCFunction)cast, METH_VARARGS | METH_KEYWORDS,
 	 drgn_cast_DOC},
 	{"reinterpret", (PyCFunction)reinterpret, METH_VARARGS | METH_KEYWORDS,
@@ -117,6 +169,9 @@ static PyMethodDef drgn_methods[] = {
 	 METH_VARARGS | METH_KEYWORDS, drgn_function_type_DOC},
 	{"_linux_helper_read_vm", (PyCFunction)drgnpy_linux_helper_read_vm,
 	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_vm_translation",
+	 (PyCFunction)drgnpy_linux_helper_vm_translation,
+	 METH_VARARGS | METH_KEYWORDS},
 	{"_linux_helper_radix_tree_lookup",
 	 (PyCFunction)drgnpy_linux_helper_radix_tree_lookup,
 	 METH_VARARGS | METH_KEYWORDS},
@@ -134,6 +189,105 @@ static PyMethodDef drgn_methods[] = {
 	{"_linux_helper_pgtable_l5_enabled",
 	 (PyCFunction)drgnpy_linux_helper_pgtable_l5_enabled,
 	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_list_for_each",
+	 (PyCFunction)drgnpy_linux_helper_list_for_each,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_list_for_each_entry",
+	 (PyCFunction)drgnpy_linux_helper_list_for_each_entry,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_hlist_for_each",
+	 (PyCFunction)drgnpy_linux_helper_hlist_for_each,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_hlist_for_each_entry",
+	 (PyCFunction)drgnpy_linux_helper_hlist_for_each_entry,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_rbtree_inorder_for_each",
+	 (PyCFunction)drgnpy_linux_helper_rbtree_inorder_for_each,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_rbtree_inorder_for_each_entry",
+	 (PyCFunction)drgnpy_linux_helper_rbtree_inorder_for_each_entry,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_rb_find", (PyCFunction)drgnpy_linux_helper_rb_find,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_radix_tree_for_each",
+	 (PyCFunction)drgnpy_linux_helper_radix_tree_for_each,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_idr_for_each",
+	 (PyCFunction)drgnpy_linux_helper_idr_for_each,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_for_each_pid",
+	 (PyCFunction)drgnpy_linux_helper_for_each_pid,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_for_each_task",
+	 (PyCFunction)drgnpy_linux_helper_for_each_task,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_for_each_page",
+	 (PyCFunction)drgnpy_linux_helper_for_each_page,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_page_pfns", (PyCFunction)drgnpy_linux_helper_page_pfns,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_per_cpu_ptr", (PyCFunction)drgnpy_linux_helper_per_cpu_ptr,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_per_cpu_ptrs",
+	 (PyCFunction)drgnpy_linux_helper_per_cpu_ptrs,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_percpu_sum", (PyCFunction)drgnpy_linux_helper_percpu_sum,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_slab_cache_for_each_allocated_object",
+	 (PyCFunction)drgnpy_linux_helper_slab_cache_for_each_allocated_object,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_d_path", (PyCFunction)drgnpy_linux_helper_d_path,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_dentry_path", (PyCFunction)drgnpy_linux_helper_dentry_path,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_task_snapshot",
+	 (PyCFunction)drgnpy_linux_helper_task_snapshot,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_task_args", (PyCFunction)drgnpy_linux_helper_task_args,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_ftrace_events",
+	 (PyCFunction)drgnpy_linux_helper_ftrace_events,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_sock_table",
+	 (PyCFunction)drgnpy_linux_helper_sock_table,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_sb_inodes", (PyCFunction)drgnpy_linux_helper_sb_inodes,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_cgroup_walk",
+	 (PyCFunction)drgnpy_linux_helper_cgroup_walk,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_btf_type_name",
+	 (PyCFunction)drgnpy_linux_helper_btf_type_name,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_btf_type", (PyCFunction)drgnpy_linux_helper_btf_type,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_blk_mq_inflight",
+	 (PyCFunction)drgnpy_linux_helper_blk_mq_inflight,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_filter_tasks",
+	 (PyCFunction)drgnpy_linux_helper_filter_tasks,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_cache_pids", (PyCFunction)drgnpy_linux_helper_cache_pids,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_pending_timers",
+	 (PyCFunction)drgnpy_linux_helper_pending_timers,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_page_owner_stacks",
+	 (PyCFunction)drgnpy_linux_helper_page_owner_stacks,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_runqueues", (PyCFunction)drgnpy_linux_helper_runqueues,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_task_rss", (PyCFunction)drgnpy_linux_helper_task_rss,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_memcg_usage",
+	 (PyCFunction)drgnpy_linux_helper_memcg_usage,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_vmalloc_areas",
+	 (PyCFunction)drgnpy_linux_helper_vmalloc_areas,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_glibc_helper_malloc_walk",
+	 (PyCFunction)drgnpy_glibc_helper_malloc_walk,
+	 METH_VARARGS | METH_KEYWORDS},
 	{},
 };
 
@@ -145,9 +299,44 @@ static struct PyModuleDef drgnmodule = {
 	drgn_methods,
 };
 
+static int register_abc(PyObject *abc_module, const char *abc_name,
+			PyTypeObject *type)
+{
+	PyObject *abc, *ret;
+
+	abc = PyObject_GetAttrString(abc_module, abc_name);
+	if (!abc)
+		return -1;
+	ret = PyObject_CallMethod(abc, "register", "O", (PyObject *)type);
+	Py_DECREF(abc);
+	if (!ret)
+		return -1;
+	Py_DECREF(ret);
+	return 0;
+}
+
+/*
+ * A thread holding the GIL must release it before waiting for a libdrgn lock,
+ * since the thread holding that lock may be waiting for the GIL to call back
+ * into Python.
+ */
+static void *drgnpy_blocking_begin(void)
+{
+	if (!PyGILState_Check())
+		return NULL;
+	return PyEval_SaveThread();
+}
+
+static void drgnpy_blocking_end(void *state)
+{
+	if (state)
+		PyEval_RestoreThread(state);
+}
+
 DRGNPY_PUBLIC PyMODINIT_FUNC PyInit__drgn(void)
 {
 	PyObject *m;
+	PyObject *abc_module;
 	PyObject *host_platform_obj;
 	PyObject *with_libkdumpfile;
 
@@ -155,6 +344,8 @@ DRGNPY_PUBLIC PyMODINIT_FUNC PyInit__drgn(void)
 	if (!m)
 		return NULL;
 
+	drgn_set_blocking_callbacks(drgnpy_blocking_begin, drgnpy_blocking_end);
+
 	if (add_module_constants(m) == -1)
 		goto err;
 
@@ -197,11 +388,55 @@ DRGNPY_PUBLIC PyMODINIT_FUNC PyInit__drgn(void)
 	if (PyType_Ready(&ObjectIterator_type) < 0)
 		goto err;
 
+	if (PyType_Ready(&ObjectValueMapping_type) < 0 ||
+	    PyType_Ready(&ObjectValueSequence_type) < 0)
+		goto err;
+	abc_module = PyImport_ImportModule("collections.abc");
+	if (!abc_module)
+		goto err;
+	if (register_abc(abc_module, "Mapping", &ObjectValueMapping_type) ||
+	    register_abc(abc_module, "Sequence", &ObjectValueSequence_type)) {
+		Py_DECREF(abc_module);
+		goto err;
+	}
+	Py_DECREF(abc_module);
+
+	if (PyType_Ready(&LinuxHelperIterator_type) < 0)
+		goto err;
+
+	if (PyType_Ready(&LinuxHelperRadixTreeIterator_type) < 0)
+		goto err;
+
+	if (PyType_Ready(&LinuxHelperVmTranslation_type) < 0)
+		goto err;
+
+	if (PyType_Ready(&MappedMemory_type) < 0)
+		goto err;
+
+	if (PyType_Ready(&MemberPath_type) < 0)
+		goto err;
+
+	Py_INCREF(&MemberPath_type);
+	PyModule_AddObject(m, "MemberPath", (PyObject *)&MemberPath_type);
+
+	if (PyType_Ready(&MemoryHashes_type) < 0)
+		goto err;
+	Py_INCREF(&MemoryHashes_type);
+	PyModule_AddObject(m, "MemoryHashes", (PyObject *)&MemoryHashes_type);
+
+	if (PyType_Ready(&MemorySearchIterator_type) < 0)
+		goto err;
+
 	if (PyType_Ready(&Platform_type) < 0)
 		goto err;
 	Py_INCREF(&Platform_type);
 	PyModule_AddObject(m, "Platform", (PyObject *)&Platform_type);
 
+	if (PyType_Ready(&PointerIndex_type) < 0)
+		goto err;
+	Py_INCREF(&PointerIndex_type);
+	PyModule_AddObject(m, "PointerIndex", (PyObject *)&PointerIndex_type);
+
 	if (PyType_Ready(&Program_type) < 0)
 		goto err;
 	Py_INCREF(&Program_type);
@@ -243,6 +478,11 @@ DRGNPY_PUBLIC PyMODINIT_FUNC PyInit__drgn(void)
 	Py_INCREF(&TypeParameter_type);
 	PyModule_AddObject(m, "TypeParameter", (PyObject *)&TypeParameter_type);
 
+	if (PyType_Ready(&Watch_type) < 0)
+		goto err;
+	Py_INCREF(&Watch_type);
+	PyModule_AddObject(m, "Watch", (PyObject *)&Watch_type);
+
 	host_platform_obj = Platform_wrap(&drgn_host_platform);
 	if (!host_platform_obj)
 		goto err;
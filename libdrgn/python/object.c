@@ -1,7 +1,9 @@
 // Copyright (c) Facebook, Inc. and its affiliates.
 // SPDX-License-Identifier: GPL-3.0+
 
+#include <errno.h>
 #include <limits.h>
+#include <unistd.h>
 
 #include "drgnpy.h"
 #include "../error.h"
@@ -344,7 +346,7 @@ static int buffer_object_from_value(struct drgn_object *res,
 	if (size <= sizeof(value.ibuf)) {
 		buf = value.ibuf;
 	} else {
-		buf = malloc(size);
+		buf = drgn_value_buffer_alloc(res->prog, size);
 		if (!buf) {
 			PyErr_NoMemory();
 			return -1;
@@ -358,7 +360,7 @@ static int buffer_object_from_value(struct drgn_object *res,
 				bit_offset, value_obj, &type,
 				value.little_endian) == -1) {
 		if (buf != value.ibuf)
-			free(buf);
+			drgn_value_buffer_free(res->prog, buf, size);
 		return -1;
 	}
 
@@ -367,16 +369,27 @@ static int buffer_object_from_value(struct drgn_object *res,
 	return 0;
 }
 
-static DrgnObject *DrgnObject_new(PyTypeObject *subtype, PyObject *args,
-				  PyObject *kwds)
+/*
+ * Object() is called for every object created from Python, so its arguments are
+ * parsed with drgnpy_parse_args() and it supports vectorcall where available.
+ */
+static DrgnObject *DrgnObject_new_args(PyObject *const *args, Py_ssize_t nargs,
+				       PyObject *kwnames, PyObject *kwds)
 {
-	static char *keywords[] = {
+	static const char * const keywords[] = {
 		"prog", "type", "value", "address", "byteorder",
 		"bit_offset", "bit_field_size", NULL,
 	};
+	static struct drgnpy_arg_parser parser = {
+		.fname = "Object",
+		.keywords = keywords,
+		.min_args = 1,
+		.max_positional = 3,
+	};
 	struct drgn_error *err;
+	PyObject *argv[7];
 	Program *prog;
-	PyObject *type_obj = Py_None, *value_obj = Py_None;
+	PyObject *type_obj, *value_obj;
 	struct index_arg address = { .allow_none = true, .is_none = true };
 	struct byteorder_arg byteorder = {
 		.allow_none = true,
@@ -388,13 +401,21 @@ static DrgnObject *DrgnObject_new(PyTypeObject *subtype, PyObject *args,
 	struct drgn_qualified_type qualified_type;
 	DrgnObject *obj;
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|OO$O&O&O&O&:Object",
-					 keywords, &Program_type, &prog,
-					 &type_obj, &value_obj, index_converter,
-					 &address, byteorder_converter,
-					 &byteorder, index_converter,
-					 &bit_offset, index_converter,
-					 &bit_field_size))
+	if (drgnpy_parse_args(&parser, args, nargs, kwnames, kwds, argv) == -1)
+		return NULL;
+	if (!PyObject_TypeCheck(argv[0], &Program_type)) {
+		PyErr_Format(PyExc_TypeError,
+			     "Object() argument 'prog' must be Program, not %s",
+			     Py_TYPE(argv[0])->tp_name);
+		return NULL;
+	}
+	prog = (Program *)argv[0];
+	type_obj = argv[1] ? argv[1] : Py_None;
+	value_obj = argv[2] ? argv[2] : Py_None;
+	if ((argv[3] && !index_converter(argv[3], &address)) ||
+	    (argv[4] && !byteorder_converter(argv[4], &byteorder)) ||
+	    (argv[5] && !index_converter(argv[5], &bit_offset)) ||
+	    (argv[6] && !index_converter(argv[6], &bit_field_size)))
 		return NULL;
 
 	if (Program_type_arg(prog, type_obj, true, &qualified_type) == -1)
@@ -561,14 +582,64 @@ err:
 	return NULL;
 }
 
+static DrgnObject *DrgnObject_new(PyTypeObject *subtype, PyObject *args,
+				  PyObject *kwds)
+{
+	return DrgnObject_new_args(&PyTuple_GET_ITEM(args, 0),
+				   PyTuple_GET_SIZE(args), NULL, kwds);
+}
+
+#if PY_VERSION_HEX >= 0x03090000
+static PyObject *DrgnObject_vectorcall(PyObject *type, PyObject *const *args,
+				       size_t nargsf, PyObject *kwnames)
+{
+	return (PyObject *)DrgnObject_new_args(args, PyVectorcall_NARGS(nargsf),
+					       kwnames, NULL);
+}
+#endif
+
+/*
+ * Objects are created and destroyed at a high rate (e.g., one per step when
+ * iterating over a linked list), so deallocated objects are kept on a free list
+ * instead of going back to the allocator. Object can't be subclassed, so every
+ * entry has the same size. This is protected by the GIL.
+ */
+#define DRGNOBJECT_FREE_LIST_MAX 256
+static DrgnObject *DrgnObject_free_list[DRGNOBJECT_FREE_LIST_MAX];
+static size_t DrgnObject_num_free;
+
+DrgnObject *DrgnObject_alloc(Program *prog)
+{
+	DrgnObject *ret;
+
+	if (DrgnObject_num_free) {
+		ret = DrgnObject_free_list[--DrgnObject_num_free];
+		(void)PyObject_INIT(ret, &DrgnObject_type);
+	} else {
+		ret = (DrgnObject *)DrgnObject_type.tp_alloc(&DrgnObject_type,
+							     0);
+		if (!ret)
+			return NULL;
+	}
+	drgn_object_init(&ret->obj, &prog->prog);
+	drgn_profile_count(&prog->prog.profile, objects);
+	Py_INCREF(prog);
+	return ret;
+}
+
 static void DrgnObject_dealloc(DrgnObject *self)
 {
 	Py_DECREF(DrgnObject_prog(self));
 	drgn_object_deinit(&self->obj);
-	Py_TYPE(self)->tp_free((PyObject *)self);
+	if (DrgnObject_num_free < DRGNOBJECT_FREE_LIST_MAX)
+		DrgnObject_free_list[DrgnObject_num_free++] = self;
+	else
+		Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
-static PyObject *DrgnObject_value_impl(struct drgn_object *obj);
+static PyObject *DrgnObject_value_impl(struct drgn_object *obj, bool lazy);
+static PyObject *ObjectValueProxy_new(struct drgn_object *obj,
+				      struct drgn_type *underlying_type);
 
 static PyObject *DrgnObject_compound_value(struct drgn_object *obj,
 					   struct drgn_type *underlying_type)
@@ -614,7 +685,7 @@ static PyObject *DrgnObject_compound_value(struct drgn_object *obj,
 			goto out;
 		}
 
-		member_value = DrgnObject_value_impl(&member);
+		member_value = DrgnObject_value_impl(&member, false);
 		if (!member_value) {
 			Py_CLEAR(dict);
 			goto out;
@@ -674,7 +745,7 @@ static PyObject *DrgnObject_array_value(struct drgn_object *obj,
 			goto out;
 		}
 
-		element_value = DrgnObject_value_impl(&element);
+		element_value = DrgnObject_value_impl(&element, false);
 		if (!element_value) {
 			Py_CLEAR(list);
 			goto out;
@@ -688,7 +759,7 @@ out:
 	return list;
 }
 
-static PyObject *DrgnObject_value_impl(struct drgn_object *obj)
+static PyObject *DrgnObject_value_impl(struct drgn_object *obj, bool lazy)
 {
 	struct drgn_error *err;
 	struct drgn_type *underlying_type;
@@ -737,8 +808,12 @@ static PyObject *DrgnObject_value_impl(struct drgn_object *obj)
 		case DRGN_TYPE_STRUCT:
 		case DRGN_TYPE_UNION:
 		case DRGN_TYPE_CLASS:
+			if (lazy)
+				return ObjectValueProxy_new(obj, underlying_type);
 			return DrgnObject_compound_value(obj, underlying_type);
 		case DRGN_TYPE_ARRAY:
+			if (lazy)
+				return ObjectValueProxy_new(obj, underlying_type);
 			return DrgnObject_array_value(obj, underlying_type);
 		default:
 			break;
@@ -752,7 +827,42 @@ static PyObject *DrgnObject_value_impl(struct drgn_object *obj)
 
 static PyObject *DrgnObject_value(DrgnObject *self)
 {
-	return DrgnObject_value_impl(&self->obj);
+	struct drgn_error *err;
+	struct drgn_object value;
+	PyObject *ret;
+
+	/*
+	 * Read a compound or array object from memory once instead of once for
+	 * every member or element.
+	 */
+	if (!self->obj.is_reference || self->obj.kind != DRGN_OBJECT_BUFFER ||
+	    drgn_type_kind(drgn_underlying_type(self->obj.type)) ==
+	    DRGN_TYPE_COMPLEX)
+		return DrgnObject_value_impl(&self->obj, false);
+
+	drgn_object_init(&value, self->obj.prog);
+	err = drgn_object_read(&value, &self->obj);
+	if (err) {
+		drgn_object_deinit(&value);
+		return set_drgn_error(err);
+	}
+	ret = DrgnObject_value_impl(&value, false);
+	drgn_object_deinit(&value);
+	return ret;
+}
+
+static PyObject *DrgnObject_value_method(DrgnObject *self, PyObject *args,
+					 PyObject *kwds)
+{
+	static char *keywords[] = {"lazy", NULL};
+	int lazy = 0;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|$p:value_", keywords,
+					 &lazy))
+		return NULL;
+	if (lazy)
+		return DrgnObject_value_impl(&self->obj, true);
+	return DrgnObject_value(self);
 }
 
 static PyObject *DrgnObject_string(DrgnObject *self)
@@ -787,6 +897,184 @@ static DrgnObject *DrgnObject_address_of(DrgnObject *self)
 	return res;
 }
 
+/*
+ * Objects are pickled as their program, type, and either their address or
+ * their value (raw bytes for compound and array values), which is enough to
+ * recreate them without reading any memory.
+ */
+static PyObject *DrgnObject_reduce(DrgnObject *self)
+{
+	struct drgn_object *obj = &self->obj;
+	PyObject *func, *type_obj, *address_obj, *value_obj, *bit_field_size_obj;
+	PyObject *ret = NULL;
+	unsigned int bit_offset;
+	bool little_endian;
+
+	func = drgnpy_unpickle_func("_unpickle_object");
+	if (!func)
+		return NULL;
+	type_obj = DrgnType_wrap(drgn_object_qualified_type(obj),
+				 (PyObject *)DrgnObject_prog(self));
+	if (!type_obj)
+		goto out_func;
+
+	if (obj->is_reference) {
+		address_obj = PyLong_FromUnsignedLongLong(obj->reference.address);
+		value_obj = Py_None;
+		Py_INCREF(value_obj);
+		bit_offset = obj->reference.bit_offset;
+		little_endian = obj->reference.little_endian;
+	} else {
+		address_obj = Py_None;
+		Py_INCREF(address_obj);
+		switch (obj->kind) {
+		case DRGN_OBJECT_BUFFER: {
+			const char *buf;
+
+			buf = (drgn_buffer_object_is_inline(obj) ?
+			       obj->value.ibuf : obj->value.bufp);
+			value_obj = PyBytes_FromStringAndSize(buf,
+							      drgn_buffer_object_size(obj));
+			break;
+		}
+		case DRGN_OBJECT_SIGNED:
+			value_obj = PyLong_FromLongLong(obj->value.svalue);
+			break;
+		case DRGN_OBJECT_UNSIGNED:
+			value_obj = PyLong_FromUnsignedLongLong(obj->value.uvalue);
+			break;
+		case DRGN_OBJECT_FLOAT:
+			value_obj = PyFloat_FromDouble(obj->value.fvalue);
+			break;
+		default:
+			UNREACHABLE();
+		}
+		bit_offset = obj->value.bit_offset;
+		little_endian = obj->value.little_endian;
+	}
+	if (obj->is_bit_field) {
+		bit_field_size_obj = PyLong_FromUnsignedLongLong(obj->bit_size);
+	} else {
+		bit_field_size_obj = Py_None;
+		Py_INCREF(bit_field_size_obj);
+	}
+	if (address_obj && value_obj && bit_field_size_obj) {
+		ret = Py_BuildValue("O(OOOOIOO)", func, DrgnObject_prog(self),
+				    type_obj, address_obj, value_obj,
+				    bit_offset, bit_field_size_obj,
+				    little_endian ? Py_True : Py_False);
+	}
+	Py_XDECREF(bit_field_size_obj);
+	Py_XDECREF(value_obj);
+	Py_XDECREF(address_obj);
+	Py_DECREF(type_obj);
+out_func:
+	Py_DECREF(func);
+	return ret;
+}
+
+DrgnObject *drgnpy_unpickle_object(PyObject *self, PyObject *args)
+{
+	struct drgn_error *err;
+	Program *prog;
+	PyObject *type_obj, *address_obj, *value_obj;
+	unsigned char bit_offset;
+	struct index_arg bit_field_size = { .allow_none = true, .is_none = true };
+	int little_endian;
+	enum drgn_byte_order byte_order;
+	struct drgn_qualified_type qualified_type;
+	DrgnObject *res;
+
+	if (!PyArg_ParseTuple(args, "O!O!OObO&p:_unpickle_object",
+			      &Program_type, &prog, &DrgnType_type, &type_obj,
+			      &address_obj, &value_obj, &bit_offset,
+			      index_converter, &bit_field_size,
+			      &little_endian))
+		return NULL;
+	if (Program_type_arg(prog, type_obj, false, &qualified_type) == -1)
+		return NULL;
+	byte_order = little_endian ? DRGN_LITTLE_ENDIAN : DRGN_BIG_ENDIAN;
+
+	res = DrgnObject_alloc(prog);
+	if (!res)
+		return NULL;
+	if (address_obj != Py_None) {
+		uint64_t address;
+
+		address = PyLong_AsUnsignedLongLong(address_obj);
+		if (address == (uint64_t)-1 && PyErr_Occurred())
+			goto err;
+		err = drgn_object_set_reference(&res->obj, qualified_type,
+						address, bit_offset,
+						bit_field_size.uvalue,
+						byte_order);
+	} else if (PyBytes_Check(value_obj)) {
+		uint64_t bit_size;
+
+		if (bit_field_size.is_none) {
+			err = drgn_type_bit_size(qualified_type.type, &bit_size);
+			if (err) {
+				set_drgn_error(err);
+				goto err;
+			}
+		} else {
+			bit_size = bit_field_size.uvalue;
+		}
+		if (PyBytes_GET_SIZE(value_obj) !=
+		    drgn_value_size(bit_size, bit_offset)) {
+			PyErr_SetString(PyExc_ValueError,
+					"pickled buffer has wrong size");
+			goto err;
+		}
+		err = drgn_object_set_buffer(&res->obj, qualified_type,
+					     PyBytes_AS_STRING(value_obj),
+					     bit_offset, bit_field_size.uvalue,
+					     byte_order);
+	} else if (PyFloat_Check(value_obj)) {
+		err = drgn_object_set_float(&res->obj, qualified_type,
+					    PyFloat_AS_DOUBLE(value_obj));
+	} else if (PyLong_Check(value_obj)) {
+		uint64_t uvalue;
+
+		uvalue = PyLong_AsUnsignedLongLongMask(value_obj);
+		if (uvalue == (uint64_t)-1 && PyErr_Occurred())
+			goto err;
+		if (drgn_type_object_kind(qualified_type.type) ==
+		    DRGN_OBJECT_SIGNED) {
+			err = drgn_object_set_signed(&res->obj, qualified_type,
+						     uvalue,
+						     bit_field_size.uvalue);
+		} else {
+			err = drgn_object_set_unsigned(&res->obj,
+						       qualified_type, uvalue,
+						       bit_field_size.uvalue);
+		}
+	} else {
+		PyErr_SetString(PyExc_TypeError, "invalid pickled object value");
+		goto err;
+	}
+	if (err) {
+		set_drgn_error(err);
+		goto err;
+	}
+	return res;
+
+err:
+	Py_DECREF(res);
+	return NULL;
+}
+
+static DrgnObject *DrgnObject_snapshot(DrgnObject *self)
+{
+	struct drgn_error *err;
+
+	err = drgn_object_snapshot(&self->obj);
+	if (err)
+		return set_drgn_error(err);
+	Py_INCREF(self);
+	return self;
+}
+
 static DrgnObject *DrgnObject_read(DrgnObject *self)
 {
 	struct drgn_error *err;
@@ -813,20 +1101,20 @@ static PyObject *DrgnObject_repr(DrgnObject *self)
 {
 	struct drgn_error *err;
 	PyObject *parts, *tmp, *sep, *ret = NULL;
-	char *type_name;
+	const char *type_name;
 
 	parts = PyList_New(0);
 	if (!parts)
 		return NULL;
 
-	err = drgn_format_type_name(drgn_object_qualified_type(&self->obj),
-				    &type_name);
+	err = drgn_type_index_format_type_name(&self->obj.prog->tindex,
+					       drgn_object_qualified_type(&self->obj),
+					       &type_name);
 	if (err) {
 		set_drgn_error(err);
 		goto out;
 	}
 	tmp = PyUnicode_FromString(type_name);
-	free(type_name);
 	if (!tmp)
 		goto out;
 
@@ -917,8 +1205,14 @@ static PyObject *DrgnObject_str(DrgnObject *self)
 	char *str;
 	PyObject *ret;
 
+	/*
+	 * Formatting only does lookups, which are safe to run in parallel, so
+	 * it doesn't need to be serialized with other blocking calls.
+	 */
+	Py_BEGIN_ALLOW_THREADS
 	err = drgn_format_object(&self->obj, SIZE_MAX,
 				 DRGN_FORMAT_OBJECT_PRETTY, &str);
+	Py_END_ALLOW_THREADS
 	if (err)
 		return set_drgn_error(err);
 
@@ -949,8 +1243,125 @@ static int format_object_flag_converter(PyObject *o, void *p)
 	return 1;
 }
 
-static PyObject *DrgnObject_format(DrgnObject *self, PyObject *args,
-				   PyObject *kwds)
+static struct drgn_error *format_object_write_fd(const char *str, size_t len,
+						 void *arg)
+{
+	int fd = *(int *)arg;
+
+	while (len) {
+		ssize_t ret;
+
+		ret = write(fd, str, len);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			return drgn_error_create_os("write", errno, NULL);
+		}
+		str += ret;
+		len -= ret;
+	}
+	return NULL;
+}
+
+static struct drgn_error *format_object_write_py(const char *str, size_t len,
+						 void *arg)
+{
+	struct drgn_error *err;
+	PyGILState_STATE gstate;
+	PyObject *ret;
+
+	gstate = PyGILState_Ensure();
+	ret = PyObject_CallFunction(arg, "s#", str, (Py_ssize_t)len);
+	if (ret) {
+		Py_DECREF(ret);
+		err = NULL;
+	} else {
+		err = drgn_error_from_python();
+	}
+	PyGILState_Release(gstate);
+	return err;
+}
+
+static PyObject *
+DrgnObject_format_stream(DrgnObject *self, PyObject *file, size_t columns,
+			 enum drgn_format_object_flags flags,
+			 const struct drgn_format_object_limits *limits)
+{
+	struct drgn_error *err;
+	PyObject *write_obj;
+	int fd;
+	bool clear;
+
+	if (PyIndex_Check(file)) {
+		fd = PyObject_AsFileDescriptor(file);
+		if (fd == -1)
+			return NULL;
+		Py_BEGIN_ALLOW_THREADS
+		err = drgn_format_object_stream(&self->obj, columns, flags,
+						limits, format_object_write_fd,
+						&fd);
+		Py_END_ALLOW_THREADS
+		if (err)
+			return set_drgn_error(err);
+		Py_RETURN_NONE;
+	}
+
+	write_obj = PyObject_GetAttrString(file, "write");
+	if (!write_obj) {
+		if (!PyErr_ExceptionMatches(PyExc_AttributeError))
+			return NULL;
+		if (!PyCallable_Check(file)) {
+			PyErr_Clear();
+			PyErr_SetString(PyExc_TypeError,
+					"file must be a file descriptor, file object, or callable");
+			return NULL;
+		}
+		PyErr_Clear();
+		Py_INCREF(file);
+		write_obj = file;
+	}
+
+	clear = set_drgn_in_python();
+	Py_BEGIN_ALLOW_THREADS
+	err = drgn_format_object_stream(&self->obj, columns, flags, limits,
+					format_object_write_py, write_obj);
+	Py_END_ALLOW_THREADS
+	if (clear)
+		clear_drgn_in_python();
+	Py_DECREF(write_obj);
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
+/* Convert an optional non-negative integer keyword argument, or None to 0. */
+static int format_object_limit_converter(PyObject *o, void *p)
+{
+	uint64_t *ret = p;
+
+	if (o == Py_None) {
+		*ret = 0;
+		return 1;
+	}
+	o = PyNumber_Index(o);
+	if (!o)
+		return 0;
+	*ret = PyLong_AsUnsignedLongLong(o);
+	Py_DECREF(o);
+	if (*ret == (unsigned long long)-1 && PyErr_Occurred())
+		return 0;
+	return 1;
+}
+
+/*
+ * Parse the keyword arguments shared by Object.format_() and format_objects().
+ * fname is used in error messages.
+ */
+static int format_object_parse_args(PyObject *args, PyObject *kwds,
+				    const char *fname, size_t *columns_ret,
+				    enum drgn_format_object_flags *flags_ret,
+				    struct drgn_format_object_limits *limits,
+				    PyObject **file_ret)
 {
 #define FLAGS								\
 	X(dereference, DRGN_FORMAT_OBJECT_DEREFERENCE)			\
@@ -972,49 +1383,220 @@ static PyObject *DrgnObject_format(DrgnObject *self, PyObject *args,
 		FLAGS
 #undef X
 		"columns",
+		"file",
+		"max_elements",
+		"max_depth",
+		"max_bytes",
+		"follow_pointers",
+		"max_dereference_bytes",
 		NULL,
 	};
-	struct drgn_error *err;
+	char format[64];
 	PyObject *columns_obj = Py_None;
+	uint64_t max_elements = 0, max_depth = 0, max_bytes = 0;
+	uint64_t follow_pointers = 0, max_dereference_bytes = 0;
 	size_t columns = SIZE_MAX;
 	enum drgn_format_object_flags flags = DRGN_FORMAT_OBJECT_PRETTY;
 #define X(name, value)	\
 	struct format_object_flag_arg name##_arg = { &flags, value };
 	FLAGS
 #undef X
-	char *str;
-	PyObject *ret;
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|$"
+	*file_ret = Py_None;
+	snprintf(format, sizeof(format), "|$"
 #define X(name, value) "O&"
-					 FLAGS
+		 FLAGS
 #undef X
-					 "O", keywords,
+		 "OOO&O&O&O&O&:%s", fname);
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, format, keywords,
 #define X(name, value) format_object_flag_converter, &name##_arg,
 					 FLAGS
 #undef X
-					 &columns_obj))
-		return NULL;
+					 &columns_obj, file_ret,
+					 format_object_limit_converter,
+					 &max_elements,
+					 format_object_limit_converter,
+					 &max_depth,
+					 format_object_limit_converter,
+					 &max_bytes,
+					 format_object_limit_converter,
+					 &follow_pointers,
+					 format_object_limit_converter,
+					 &max_dereference_bytes))
+		return -1;
+	limits->max_elements = max_elements;
+	limits->max_depth = min(max_depth, (uint64_t)SIZE_MAX);
+	limits->max_bytes = min(max_bytes, (uint64_t)SIZE_MAX);
+	limits->follow_pointers = min(follow_pointers, (uint64_t)SIZE_MAX);
+	limits->max_dereference_bytes = max_dereference_bytes;
 
 	if (columns_obj != Py_None) {
 		columns_obj = PyNumber_Index(columns_obj);
 		if (!columns_obj)
-			return NULL;
+			return -1;
 		columns = PyLong_AsSize_t(columns_obj);
 		Py_DECREF(columns_obj);
 		if (columns == (size_t)-1 && PyErr_Occurred())
-			return NULL;
+			return -1;
+	}
+	*columns_ret = columns;
+	*flags_ret = flags;
+	return 0;
+
+#undef FLAGS
+}
+
+static PyObject *DrgnObject_format(DrgnObject *self, PyObject *args,
+				   PyObject *kwds)
+{
+	struct drgn_error *err;
+	PyObject *file;
+	struct drgn_format_object_limits limits;
+	size_t columns;
+	enum drgn_format_object_flags flags;
+	char *str;
+	PyObject *ret;
+
+	if (format_object_parse_args(args, kwds, "format_", &columns, &flags,
+				     &limits, &file) == -1)
+		return NULL;
+
+	if (file != Py_None) {
+		return DrgnObject_format_stream(self, file, columns, flags,
+						&limits);
 	}
 
-	err = drgn_format_object(&self->obj, columns, flags, &str);
+	Py_BEGIN_ALLOW_THREADS
+	err = drgn_format_object_limited(&self->obj, columns, flags, &limits,
+					 &str);
+	Py_END_ALLOW_THREADS
 	if (err)
 		return set_drgn_error(err);
 
 	ret = PyUnicode_FromString(str);
 	free(str);
 	return ret;
+}
 
-#undef FLAGS
+PyObject *format_objects(PyObject *self, PyObject *args, PyObject *kwds)
+{
+	struct drgn_error *err;
+	PyObject *objects, *empty_args, *file, *seq, *ret = NULL;
+	const struct drgn_object **objs = NULL;
+	char **strs = NULL;
+	struct drgn_format_object_limits limits;
+	size_t columns;
+	enum drgn_format_object_flags flags;
+	Py_ssize_t num_objs, i;
+	bool clear;
+
+	if (!PyArg_ParseTuple(args, "O:format_objects", &objects))
+		return NULL;
+	empty_args = PyTuple_New(0);
+	if (!empty_args)
+		return NULL;
+	if (format_object_parse_args(empty_args, kwds, "format_objects",
+				     &columns, &flags, &limits, &file) == -1) {
+		Py_DECREF(empty_args);
+		return NULL;
+	}
+	Py_DECREF(empty_args);
+	if (file != Py_None) {
+		PyErr_SetString(PyExc_TypeError,
+				"format_objects() does not support file");
+		return NULL;
+	}
+
+	/* The sequence keeps the objects alive while they are formatted. */
+	seq = PySequence_Fast(objects, "objects must be iterable");
+	if (!seq)
+		return NULL;
+	num_objs = PySequence_Fast_GET_SIZE(seq);
+	objs = malloc_array(num_objs ? num_objs : 1, sizeof(*objs));
+	strs = malloc_array(num_objs ? num_objs : 1, sizeof(*strs));
+	if (!objs || !strs) {
+		PyErr_NoMemory();
+		goto out;
+	}
+	for (i = 0; i < num_objs; i++) {
+		PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+
+		if (!PyObject_TypeCheck(item, &DrgnObject_type)) {
+			PyErr_SetString(PyExc_TypeError,
+					"objects must be Object instances");
+			goto out;
+		}
+		objs[i] = &((DrgnObject *)item)->obj;
+	}
+
+	clear = set_drgn_in_python();
+	Py_BEGIN_ALLOW_THREADS
+	err = drgn_format_objects(objs, num_objs, columns, flags, &limits,
+				  strs);
+	Py_END_ALLOW_THREADS
+	if (clear)
+		clear_drgn_in_python();
+	if (err) {
+		set_drgn_error(err);
+		goto out;
+	}
+
+	ret = PyList_New(num_objs);
+	for (i = 0; i < num_objs; i++) {
+		if (ret) {
+			PyObject *str;
+
+			str = PyUnicode_FromString(strs[i]);
+			if (str) {
+				PyList_SET_ITEM(ret, i, str);
+			} else {
+				Py_DECREF(ret);
+				ret = NULL;
+			}
+		}
+		free(strs[i]);
+	}
+out:
+	free(strs);
+	free(objs);
+	Py_DECREF(seq);
+	return ret;
+}
+
+static PyObject *DrgnObject_json(DrgnObject *self, PyObject *args,
+				 PyObject *kwds)
+{
+	static char *keywords[] = {
+		"max_elements", "max_depth", "max_bytes", NULL,
+	};
+	struct drgn_error *err;
+	uint64_t max_elements = 0, max_depth = 0, max_bytes = 0;
+	struct drgn_format_object_limits limits = {};
+	char *str;
+	PyObject *ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|$O&O&O&:json_",
+					 keywords,
+					 format_object_limit_converter,
+					 &max_elements,
+					 format_object_limit_converter,
+					 &max_depth,
+					 format_object_limit_converter,
+					 &max_bytes))
+		return NULL;
+	limits.max_elements = max_elements;
+	limits.max_depth = min(max_depth, (uint64_t)SIZE_MAX);
+	limits.max_bytes = min(max_bytes, (uint64_t)SIZE_MAX);
+
+	Py_BEGIN_ALLOW_THREADS
+	err = drgn_format_object_json(&self->obj, &limits, &str);
+	Py_END_ALLOW_THREADS
+	if (err)
+		return set_drgn_error(err);
+
+	ret = PyUnicode_FromString(str);
+	free(str);
+	return ret;
 }
 
 static Program *DrgnObject_get_prog(DrgnObject *self, void *arg)
@@ -1157,92 +1739,110 @@ DrgnObject_UNARY_OP(neg)
 DrgnObject_UNARY_OP(not)
 #undef DrgnObject_UNARY_OP
 
-static int DrgnObject_bool(DrgnObject *self)
+/*
+ * Read a scalar object for conversion to a Python number. This avoids the
+ * generic drgn_object_read_value() path, since these conversions are hot.
+ */
+static int DrgnObject_read_scalar(DrgnObject *self, union drgn_value *value)
 {
 	struct drgn_error *err;
-	bool ret;
 
-	err = drgn_object_bool(&self->obj, &ret);
+	if (!drgn_object_kind_is_complete(self->obj.kind)) {
+		err = drgn_error_incomplete_type("cannot read object with %s type",
+						 self->obj.type);
+	} else {
+		err = drgn_object_read_scalar(&self->obj, value);
+	}
 	if (err) {
 		set_drgn_error(err);
 		return -1;
 	}
-	return ret;
+	return 0;
 }
 
-static PyObject *DrgnObject_int(DrgnObject *self)
+static int DrgnObject_bool(DrgnObject *self)
 {
 	struct drgn_error *err;
-	union drgn_value value_mem;
-	const union drgn_value *value;
-	PyObject *ret;
-
-	if (!drgn_type_is_scalar(self->obj.type)) {
-		return set_error_type_name("cannot convert '%s' to int",
-					   drgn_object_qualified_type(&self->obj));
-	}
-
-	err = drgn_object_read_value(&self->obj, &value_mem, &value);
-	if (err)
-		return set_drgn_error(err);
+	union drgn_value value;
+	bool ret;
 
 	switch (self->obj.kind) {
 	case DRGN_OBJECT_SIGNED:
-		ret = PyLong_FromLongLong(value->svalue);
-		break;
+		if (DrgnObject_read_scalar(self, &value))
+			return -1;
+		return value.svalue != 0;
 	case DRGN_OBJECT_UNSIGNED:
-		ret = PyLong_FromUnsignedLongLong(value->uvalue);
-		break;
+		if (DrgnObject_read_scalar(self, &value))
+			return -1;
+		return value.uvalue != 0;
 	case DRGN_OBJECT_FLOAT:
-		ret = PyLong_FromDouble(value->fvalue);
+		if (DrgnObject_read_scalar(self, &value))
+			return -1;
+		return value.fvalue != 0;
+	default:
 		break;
+	}
+
+	err = drgn_object_bool(&self->obj, &ret);
+	if (err) {
+		set_drgn_error(err);
+		return -1;
+	}
+	return ret;
+}
+
+static PyObject *DrgnObject_int(DrgnObject *self)
+{
+	union drgn_value value;
+
+	if (!drgn_type_is_scalar(self->obj.type)) {
+		return set_error_type_name("cannot convert '%s' to int",
+					   drgn_object_qualified_type(&self->obj));
+	}
+
+	if (DrgnObject_read_scalar(self, &value))
+		return NULL;
+
+	switch (self->obj.kind) {
+	case DRGN_OBJECT_SIGNED:
+		return PyLong_FromLongLong(value.svalue);
+	case DRGN_OBJECT_UNSIGNED:
+		return PyLong_FromUnsignedLongLong(value.uvalue);
+	case DRGN_OBJECT_FLOAT:
+		return PyLong_FromDouble(value.fvalue);
 	default:
 		UNREACHABLE();
 	}
-	drgn_object_deinit_value(&self->obj, value);
-	return ret;
 }
 
 static PyObject *DrgnObject_float(DrgnObject *self)
 {
-	struct drgn_error *err;
-	union drgn_value value_mem;
-	const union drgn_value *value;
-	PyObject *ret;
+	union drgn_value value;
 
 	if (!drgn_type_is_arithmetic(self->obj.type)) {
 		return set_error_type_name("cannot convert '%s' to float",
 					   drgn_object_qualified_type(&self->obj));
 	}
 
-	err = drgn_object_read_value(&self->obj, &value_mem, &value);
-	if (err)
-		return set_drgn_error(err);
+	if (DrgnObject_read_scalar(self, &value))
+		return NULL;
 
 	switch (self->obj.kind) {
 	case DRGN_OBJECT_SIGNED:
-		ret = PyFloat_FromDouble(value->svalue);
-		break;
+		return PyFloat_FromDouble(value.svalue);
 	case DRGN_OBJECT_UNSIGNED:
-		ret = PyFloat_FromDouble(value->uvalue);
-		break;
+		return PyFloat_FromDouble(value.uvalue);
 	case DRGN_OBJECT_FLOAT:
-		ret = PyFloat_FromDouble(value->fvalue);
-		break;
+		return PyFloat_FromDouble(value.fvalue);
 	default:
 		UNREACHABLE();
 	}
-	drgn_object_deinit_value(&self->obj, value);
-	return ret;
 }
 
 static PyObject *DrgnObject_index(DrgnObject *self)
 {
-	struct drgn_error *err;
 	struct drgn_type *underlying_type;
-	union drgn_value value_mem;
-	const union drgn_value *value;
-	PyObject *ret;
+	union drgn_value value;
 
 	underlying_type = drgn_underlying_type(self->obj.type);
 	if (!drgn_type_is_integer(underlying_type) &&
@@ -1251,22 +1851,17 @@ static PyObject *DrgnObject_index(DrgnObject *self)
 					   drgn_object_qualified_type(&self->obj));
 	}
 
-	err = drgn_object_read_value(&self->obj, &value_mem, &value);
-	if (err)
-		return set_drgn_error(err);
+	if (DrgnObject_read_scalar(self, &value))
+		return NULL;
 
 	switch (self->obj.kind) {
 	case DRGN_OBJECT_SIGNED:
-		ret = PyLong_FromLongLong(value->svalue);
-		break;
+		return PyLong_FromLongLong(value.svalue);
 	case DRGN_OBJECT_UNSIGNED:
-		ret = PyLong_FromUnsignedLongLong(value->uvalue);
-		break;
+		return PyLong_FromUnsignedLongLong(value.uvalue);
 	default:
 		UNREACHABLE();
 	}
-	drgn_object_deinit_value(&self->obj, value);
-	return ret;
 }
 
 static PyObject *DrgnObject_round(DrgnObject *self, PyObject *args,
@@ -1401,28 +1996,43 @@ out:
 		Py_RETURN_RICHCOMPARE(cmp, 0, op);
 }
 
-static DrgnObject *DrgnObject_member(DrgnObject *self, PyObject *args,
-				     PyObject *kwds)
+/* Get a member of a structure, union, or class, or of a pointer to one. */
+static struct drgn_error *DrgnObject_member_impl(DrgnObject *self,
+						 const char *name,
+						 struct drgn_object *res)
 {
-	static char *keywords[] = {"name", NULL};
+	if (self->obj.kind == DRGN_OBJECT_UNSIGNED)
+		return drgn_object_member_dereference(res, &self->obj, name);
+	else
+		return drgn_object_member(res, &self->obj, name);
+}
+
+static DrgnObject *DrgnObject_member(DrgnObject *self, PyObject *const *args,
+				     Py_ssize_t nargs, PyObject *kwnames)
+{
+	static const char * const keywords[] = {"name", NULL};
+	static struct drgnpy_arg_parser parser = {
+		.fname = "member_",
+		.keywords = keywords,
+		.min_args = 1,
+		.max_positional = 1,
+	};
 	struct drgn_error *err;
+	PyObject *argv[1];
 	const char *name;
 	DrgnObject *res;
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s:member_", keywords,
-					 &name))
+	if (drgnpy_parse_args(&parser, args, nargs, kwnames, NULL, argv) == -1)
+		return NULL;
+	name = drgnpy_str_arg(&parser, 0, argv[0]);
+	if (!name)
 		return NULL;
 
 	res = DrgnObject_alloc(DrgnObject_prog(self));
 	if (!res)
 		return NULL;
 
-	if (self->obj.kind == DRGN_OBJECT_UNSIGNED) {
-		err = drgn_object_member_dereference(&res->obj, &self->obj,
-						     name);
-	} else {
-		err = drgn_object_member(&res->obj, &self->obj, name);
-	}
+	err = DrgnObject_member_impl(self, name, &res->obj);
 	if (err) {
 		Py_DECREF(res);
 		return set_drgn_error(err);
@@ -1430,12 +2040,258 @@ static DrgnObject *DrgnObject_member(DrgnObject *self, PyObject *args,
 	return res;
 }
 
+static PyObject *DrgnObject_member_value(DrgnObject *self, PyObject *args,
+					 PyObject *kwds)
+{
+	static char *keywords[] = {"name", NULL};
+	struct drgn_error *err;
+	const char *name;
+	struct drgn_object member;
+	PyObject *ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s:member_value_",
+					 keywords, &name))
+		return NULL;
+
+	drgn_object_init(&member, self->obj.prog);
+	err = DrgnObject_member_impl(self, name, &member);
+	if (err)
+		ret = set_drgn_error(err);
+	else
+		ret = DrgnObject_value_impl(&member, false);
+	drgn_object_deinit(&member);
+	return ret;
+}
+
+/*
+ * Maximum distance between the first and last byte of the members passed to
+ * Object.read_members_() for them to be read with a single read.
+ */
+#define READ_MEMBERS_MAX_SPAN 65536
+
+/*
+ * Read all of the given member references with one read and convert them to
+ * Python values in ret. Returns 1 if the members can't be read together (in
+ * which case the caller should read them individually), 0 on success, and -1
+ * on error.
+ */
+static int read_members_coalesced(struct drgn_object *members, size_t n,
+				  PyObject *ret)
+{
+	struct drgn_error *err;
+	uint64_t start = UINT64_MAX, end = 0;
+	struct drgn_object value;
+	char *buf;
+	size_t i;
+	int status = 0;
+
+	for (i = 0; i < n; i++) {
+		uint64_t address, size;
+
+		if (!members[i].is_reference ||
+		    !drgn_object_kind_is_complete(members[i].kind))
+			return 1;
+		address = members[i].reference.address;
+		size = drgn_reference_object_size(&members[i]);
+		if (address + size < address)
+			return 1;
+		start = min(start, address);
+		end = max(end, address + size);
+	}
+	if (n == 0 || end - start > READ_MEMBERS_MAX_SPAN)
+		return 1;
+
+	buf = malloc(end - start);
+	if (!buf) {
+		PyErr_NoMemory();
+		return -1;
+	}
+	err = drgn_program_read_memory(members[0].prog, buf, start,
+				       end - start, false);
+	if (err) {
+		/*
+		 * The span may include memory that isn't mapped. Let the
+		 * caller read each member separately to get the precise error.
+		 */
+		drgn_error_destroy(err);
+		free(buf);
+		return 1;
+	}
+
+	drgn_object_init(&value, members[0].prog);
+	for (i = 0; i < n; i++) {
+		struct drgn_object *member = &members[i];
+		const char *p = &buf[member->reference.address - start];
+		PyObject *item;
+
+		err = drgn_object_set_buffer(&value,
+					     drgn_object_qualified_type(member),
+					     p, member->reference.bit_offset,
+					     member->is_bit_field ?
+					     member->bit_size : 0,
+					     member->reference.little_endian ?
+					     DRGN_LITTLE_ENDIAN :
+					     DRGN_BIG_ENDIAN);
+		if (err) {
+			set_drgn_error(err);
+			status = -1;
+			break;
+		}
+		item = DrgnObject_value_impl(&value, false);
+		if (!item) {
+			status = -1;
+			break;
+		}
+		PyTuple_SET_ITEM(ret, i, item);
+	}
+	drgn_object_deinit(&value);
+	free(buf);
+	return status;
+}
+
+static PyObject *DrgnObject_read_members(DrgnObject *self, PyObject *args)
+{
+	struct drgn_error *err;
+	Py_ssize_t n, i;
+	struct drgn_object *members;
+	PyObject *ret;
+	int status;
+
+	n = PyTuple_GET_SIZE(args);
+	for (i = 0; i < n; i++) {
+		if (!PyUnicode_Check(PyTuple_GET_ITEM(args, i))) {
+			PyErr_SetString(PyExc_TypeError,
+					"member name must be str");
+			return NULL;
+		}
+	}
+
+	ret = PyTuple_New(n);
+	if (!ret)
+		return NULL;
+	members = malloc_array(n, sizeof(*members));
+	if (!members && n) {
+		Py_DECREF(ret);
+		return PyErr_NoMemory();
+	}
+	for (i = 0; i < n; i++)
+		drgn_object_init(&members[i], self->obj.prog);
+
+	for (i = 0; i < n; i++) {
+		const char *name;
+
+		name = PyUnicode_AsUTF8(PyTuple_GET_ITEM(args, i));
+		if (!name)
+			goto err;
+		err = DrgnObject_member_impl(self, name, &members[i]);
+		if (err) {
+			set_drgn_error(err);
+			goto err;
+		}
+	}
+
+	status = read_members_coalesced(members, n, ret);
+	if (status < 0)
+		goto err;
+	if (status > 0) {
+		for (i = 0; i < n; i++) {
+			PyObject *item;
+
+			item = DrgnObject_value_impl(&members[i], false);
+			if (!item)
+				goto err;
+			PyTuple_SET_ITEM(ret, i, item);
+		}
+	}
+
+out:
+	for (i = 0; i < n; i++)
+		drgn_object_deinit(&members[i]);
+	free(members);
+	return ret;
+
+err:
+	Py_CLEAR(ret);
+	goto out;
+}
+
+/*
+ * Remember a member found by DrgnObject_getattro() so that the next lookup of
+ * the same interned name in an object of the same type skips both the generic
+ * attribute lookup and the member lookup by C string.
+ */
+static void DrgnObject_member_cache_add(DrgnObject *self, PyObject *attr_name,
+					const char *name)
+{
+	struct drgn_error *err;
+	struct drgn_type *type = self->obj.type;
+	bool dereference = self->obj.kind == DRGN_OBJECT_UNSIGNED;
+	struct drgn_member_info member;
+	struct drgnpy_member_cache_entry *entry;
+
+	if (dereference)
+		type = drgn_type_type(drgn_underlying_type(type)).type;
+	/* This was just looked up, so it is in the member map. */
+	err = drgn_program_member_info(self->obj.prog, type, name, &member);
+	if (err) {
+		drgn_error_destroy(err);
+		return;
+	}
+
+	entry = Program_member_cache_entry(DrgnObject_prog(self),
+					   self->obj.type, attr_name);
+	Py_INCREF(attr_name);
+	Py_XSETREF(entry->name, attr_name);
+	entry->type = self->obj.type;
+	entry->member_type = member.qualified_type;
+	entry->bit_offset = member.bit_offset;
+	entry->bit_field_size = member.bit_field_size;
+	entry->dereference = dereference;
+}
+
 static PyObject *DrgnObject_getattro(DrgnObject *self, PyObject *attr_name)
 {
 	struct drgn_error *err;
 	PyObject *attr;
 	const char *name;
 	DrgnObject *res;
+	bool cacheable;
+
+	/*
+	 * Names which missed the generic lookup once will always miss it,
+	 * since Object has no instance dictionary and its type can't be
+	 * modified, so members in the cache can be returned immediately.
+	 */
+	cacheable = (PyUnicode_CheckExact(attr_name) &&
+		     PyUnicode_CHECK_INTERNED(attr_name));
+	if (cacheable) {
+		struct drgnpy_member_cache_entry *entry;
+
+		entry = Program_member_cache_entry(DrgnObject_prog(self),
+						   self->obj.type, attr_name);
+		if (entry->type == self->obj.type && entry->name == attr_name) {
+			res = DrgnObject_alloc(DrgnObject_prog(self));
+			if (!res)
+				return NULL;
+			if (entry->dereference) {
+				err = drgn_object_dereference_offset(&res->obj,
+								     &self->obj,
+								     entry->member_type,
+								     entry->bit_offset,
+								     entry->bit_field_size);
+			} else {
+				err = drgn_object_slice(&res->obj, &self->obj,
+							entry->member_type,
+							entry->bit_offset,
+							entry->bit_field_size);
+			}
+			if (err) {
+				Py_DECREF(res);
+				return set_drgn_error(err);
+			}
+			return (PyObject *)res;
+		}
+	}
 
 	/*
 	 * In Python 3.7 and newer, _PyObject_GenericGetAttrWithDict() can
@@ -1473,6 +2329,8 @@ static PyObject *DrgnObject_getattro(DrgnObject *self, PyObject *attr_name)
 	} else {
 		err = drgn_object_member(&res->obj, &self->obj, name);
 	}
+	if (!err && cacheable)
+		DrgnObject_member_cache_add(self, attr_name, name);
 	if (err) {
 		Py_CLEAR(res);
 		if (err->code == DRGN_ERROR_TYPE) {
@@ -1554,6 +2412,9 @@ static DrgnObject *DrgnObject_subscript(DrgnObject *self, PyObject *key)
 	return DrgnObject_subscript_impl(self, index.svalue);
 }
 
+/* Protected by the GIL. */
+static ObjectIterator *ObjectIterator_free;
+
 static ObjectIterator *DrgnObject_iter(DrgnObject *self)
 {
 	struct drgn_type *underlying_type;
@@ -1567,10 +2428,18 @@ static ObjectIterator *DrgnObject_iter(DrgnObject *self)
 		return NULL;
 	}
 
-	it = (ObjectIterator *)ObjectIterator_type.tp_alloc(&ObjectIterator_type,
-							    0);
-	if (!it)
-		return NULL;
+	/* Reuse the last iterator, since loops over arrays are often nested. */
+	if (ObjectIterator_free) {
+		it = ObjectIterator_free;
+		ObjectIterator_free = NULL;
+		(void)PyObject_INIT(it, &ObjectIterator_type);
+	} else {
+		it = (ObjectIterator *)
+			ObjectIterator_type.tp_alloc(&ObjectIterator_type, 0);
+		if (!it)
+			return NULL;
+	}
+	it->index = 0;
 	it->obj = self;
 	Py_INCREF(self);
 	it->length = drgn_type_length(underlying_type);
@@ -1663,18 +2532,28 @@ static PyGetSetDef DrgnObject_getset[] = {
 static PyMethodDef DrgnObject_methods[] = {
 	{"__getitem__", (PyCFunction)DrgnObject_subscript,
 	 METH_O | METH_COEXIST, drgn_Object___getitem___DOC},
-	{"value_", (PyCFunction)DrgnObject_value, METH_NOARGS,
+	{"value_", (PyCFunction)DrgnObject_value_method,
+	 METH_VARARGS | METH_KEYWORDS,
 	 drgn_Object_value__DOC},
 	{"string_", (PyCFunction)DrgnObject_string, METH_NOARGS,
 	 drgn_Object_string__DOC},
-	{"member_", (PyCFunction)DrgnObject_member,
-	 METH_VARARGS | METH_KEYWORDS, drgn_Object_member__DOC},
+	{"member_", (PyCFunction)(void (*)(void))DrgnObject_member,
+	 DRGNPY_METH_FASTCALL, drgn_Object_member__DOC},
+	{"member_value_", (PyCFunction)DrgnObject_member_value,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Object_member_value__DOC},
+	{"read_members_", (PyCFunction)DrgnObject_read_members, METH_VARARGS,
+	 drgn_Object_read_members__DOC},
 	{"address_of_", (PyCFunction)DrgnObject_address_of, METH_NOARGS,
 	 drgn_Object_address_of__DOC},
 	{"read_", (PyCFunction)DrgnObject_read, METH_NOARGS,
 	 drgn_Object_read__DOC},
+	{"snapshot_", (PyCFunction)DrgnObject_snapshot, METH_NOARGS,
+	 drgn_Object_snapshot__DOC},
+	{"__reduce__", (PyCFunction)DrgnObject_reduce, METH_NOARGS},
 	{"format_", (PyCFunction)DrgnObject_format,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Object_format__DOC},
+	{"json_", (PyCFunction)DrgnObject_json, METH_VARARGS | METH_KEYWORDS,
+	 drgn_Object_json__DOC},
 	{"__round__", (PyCFunction)DrgnObject_round,
 	 METH_VARARGS | METH_KEYWORDS},
 	{"__trunc__", (PyCFunction)DrgnObject_trunc, METH_NOARGS},
@@ -1705,6 +2584,64 @@ static PyNumberMethods DrgnObject_as_number = {
 	.nb_index = (unaryfunc)DrgnObject_index,
 };
 
+static int DrgnObject_getbuffer(DrgnObject *self, Py_buffer *view,
+				int flags)
+{
+	struct drgn_error *err;
+	struct drgn_object *obj = &self->obj;
+	uint64_t size;
+	PyObject *bytes;
+	int ret;
+
+	if (obj->kind != DRGN_OBJECT_BUFFER) {
+		set_error_type_name("'%s' does not support the buffer protocol",
+				    drgn_object_qualified_type(obj));
+		return -1;
+	}
+	if (obj->bit_size % 8 ||
+	    (obj->is_reference ? obj->reference.bit_offset :
+	     obj->value.bit_offset)) {
+		PyErr_SetString(PyExc_BufferError,
+				"object is not byte-aligned");
+		return -1;
+	}
+	size = obj->bit_size / 8;
+	if (size > PY_SSIZE_T_MAX) {
+		PyErr_NoMemory();
+		return -1;
+	}
+
+	/* Values are immutable, so their buffer can be exposed directly. */
+	if (!obj->is_reference) {
+		return PyBuffer_FillInfo(view, (PyObject *)self,
+					 (void *)drgn_object_buffer(obj), size,
+					 1, flags);
+	}
+
+	/*
+	 * References are read directly into a bytes object, which then owns
+	 * the buffer.
+	 */
+	bytes = PyBytes_FromStringAndSize(NULL, size);
+	if (!bytes)
+		return -1;
+	err = drgn_program_read_memory(obj->prog, PyBytes_AS_STRING(bytes),
+				       obj->reference.address, size, false);
+	if (err) {
+		Py_DECREF(bytes);
+		set_drgn_error(err);
+		return -1;
+	}
+	ret = PyBuffer_FillInfo(view, bytes, PyBytes_AS_STRING(bytes), size, 1,
+				flags);
+	Py_DECREF(bytes);
+	return ret;
+}
+
+static PyBufferProcs DrgnObject_as_buffer = {
+	.bf_getbuffer = (getbufferproc)DrgnObject_getbuffer,
+};
+
 static PyMappingMethods DrgnObject_as_mapping = {
 	.mp_length = (lenfunc)DrgnObject_length,
 	.mp_subscript = (binaryfunc)DrgnObject_subscript,
@@ -1718,6 +2655,7 @@ PyTypeObject DrgnObject_type = {
 	.tp_repr = (reprfunc)DrgnObject_repr,
 	.tp_as_number = &DrgnObject_as_number,
 	.tp_as_mapping = &DrgnObject_as_mapping,
+	.tp_as_buffer = &DrgnObject_as_buffer,
 	.tp_str = (reprfunc)DrgnObject_str,
 	.tp_getattro = (getattrofunc)DrgnObject_getattro,
 	.tp_flags = Py_TPFLAGS_DEFAULT,
@@ -1727,6 +2665,9 @@ PyTypeObject DrgnObject_type = {
 	.tp_methods = DrgnObject_methods,
 	.tp_getset = DrgnObject_getset,
 	.tp_new = (newfunc)DrgnObject_new,
+#if PY_VERSION_HEX >= 0x03090000
+	.tp_vectorcall = DrgnObject_vectorcall,
+#endif
 };
 
 PyObject *DrgnObject_NULL(PyObject *self, PyObject *args, PyObject *kwds)
@@ -1852,7 +2793,10 @@ DrgnObject *DrgnObject_container_of(PyObject *self, PyObject *args,
 static void ObjectIterator_dealloc(ObjectIterator *self)
 {
 	Py_DECREF(self->obj);
-	Py_TYPE(self)->tp_free((PyObject *)self);
+	if (!ObjectIterator_free)
+		ObjectIterator_free = self;
+	else
+		Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
 static DrgnObject *ObjectIterator_next(ObjectIterator *self)
@@ -1883,3 +2827,278 @@ PyTypeObject ObjectIterator_type = {
 	.tp_iternext = (iternextfunc)ObjectIterator_next,
 	.tp_methods = ObjectIterator_methods,
 };
+
+static PyObject *ObjectValueProxy_new(struct drgn_object *obj,
+				      struct drgn_type *underlying_type)
+{
+	struct drgn_error *err;
+	PyTypeObject *type;
+	ObjectValueProxy *proxy;
+
+	if (drgn_type_kind(underlying_type) == DRGN_TYPE_ARRAY) {
+		type = &ObjectValueSequence_type;
+	} else if (drgn_type_is_complete(underlying_type)) {
+		type = &ObjectValueMapping_type;
+	} else {
+		PyErr_Format(PyExc_TypeError,
+			     "cannot get value of incomplete %s",
+			     drgn_type_kind_spelling[drgn_type_kind(underlying_type)]);
+		return NULL;
+	}
+
+	proxy = (ObjectValueProxy *)type->tp_alloc(type, 0);
+	if (!proxy)
+		return NULL;
+	proxy->obj = DrgnObject_alloc(container_of(obj->prog, Program, prog));
+	if (!proxy->obj) {
+		Py_DECREF(proxy);
+		return NULL;
+	}
+	err = drgn_object_copy(&proxy->obj->obj, obj);
+	if (err) {
+		Py_DECREF(proxy);
+		return set_drgn_error(err);
+	}
+	if (type == &ObjectValueSequence_type) {
+		err = drgn_type_bit_size(drgn_type_type(underlying_type).type,
+					 &proxy->element_bit_size);
+		if (err) {
+			Py_DECREF(proxy);
+			return set_drgn_error(err);
+		}
+		proxy->length = drgn_type_length(underlying_type);
+	}
+	return (PyObject *)proxy;
+}
+
+static void ObjectValueProxy_dealloc(ObjectValueProxy *self)
+{
+	Py_XDECREF(self->obj);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *ObjectValueMapping_keys(ObjectValueProxy *self)
+{
+	PyObject *keys;
+
+	keys = PyList_New(0);
+	if (!keys)
+		return NULL;
+	if (add_to_dir(keys, self->obj->obj.type) == -1) {
+		Py_DECREF(keys);
+		return NULL;
+	}
+	return keys;
+}
+
+static PyObject *ObjectValueMapping_subscript(ObjectValueProxy *self,
+					      PyObject *key)
+{
+	struct drgn_error *err;
+	const char *name;
+	struct drgn_object member;
+	PyObject *ret;
+
+	if (!PyUnicode_Check(key)) {
+		PyErr_SetObject(PyExc_KeyError, key);
+		return NULL;
+	}
+	name = PyUnicode_AsUTF8(key);
+	if (!name)
+		return NULL;
+
+	drgn_object_init(&member, self->obj->obj.prog);
+	err = drgn_object_member(&member, &self->obj->obj, name);
+	if (!err) {
+		ret = DrgnObject_value_impl(&member, true);
+	} else if (err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		PyErr_SetObject(PyExc_KeyError, key);
+		ret = NULL;
+	} else {
+		ret = set_drgn_error(err);
+	}
+	drgn_object_deinit(&member);
+	return ret;
+}
+
+static Py_ssize_t ObjectValueMapping_length(ObjectValueProxy *self)
+{
+	PyObject *keys;
+	Py_ssize_t length;
+
+	keys = ObjectValueMapping_keys(self);
+	if (!keys)
+		return -1;
+	length = PyList_GET_SIZE(keys);
+	Py_DECREF(keys);
+	return length;
+}
+
+static int ObjectValueMapping_contains(ObjectValueProxy *self, PyObject *key)
+{
+	PyObject *keys;
+	int ret;
+
+	if (!PyUnicode_Check(key))
+		return 0;
+	keys = ObjectValueMapping_keys(self);
+	if (!keys)
+		return -1;
+	ret = PySequence_Contains(keys, key);
+	Py_DECREF(keys);
+	return ret;
+}
+
+static PyObject *ObjectValueMapping_iter(ObjectValueProxy *self)
+{
+	PyObject *keys, *it;
+
+	keys = ObjectValueMapping_keys(self);
+	if (!keys)
+		return NULL;
+	it = PyObject_GetIter(keys);
+	Py_DECREF(keys);
+	return it;
+}
+
+static PyObject *ObjectValueMapping_get(ObjectValueProxy *self,
+					PyObject *args)
+{
+	PyObject *key, *default_ = Py_None, *ret;
+
+	if (!PyArg_ParseTuple(args, "O|O:get", &key, &default_))
+		return NULL;
+	ret = ObjectValueMapping_subscript(self, key);
+	if (!ret && PyErr_ExceptionMatches(PyExc_KeyError)) {
+		PyErr_Clear();
+		Py_INCREF(default_);
+		ret = default_;
+	}
+	return ret;
+}
+
+static PyObject *ObjectValueMapping_values_or_items(ObjectValueProxy *self,
+						    bool items)
+{
+	PyObject *keys, *ret;
+	Py_ssize_t i;
+
+	keys = ObjectValueMapping_keys(self);
+	if (!keys)
+		return NULL;
+	for (i = 0; i < PyList_GET_SIZE(keys); i++) {
+		PyObject *key, *value;
+
+		key = PyList_GET_ITEM(keys, i);
+		value = ObjectValueMapping_subscript(self, key);
+		if (!value) {
+			Py_DECREF(keys);
+			return NULL;
+		}
+		if (items) {
+			ret = PyTuple_Pack(2, key, value);
+			Py_DECREF(value);
+			if (!ret) {
+				Py_DECREF(keys);
+				return NULL;
+			}
+			value = ret;
+		}
+		/* PyList_SET_ITEM() doesn't release the replaced key. */
+		PyList_SET_ITEM(keys, i, value);
+		Py_DECREF(key);
+	}
+	return keys;
+}
+
+static PyObject *ObjectValueMapping_values(ObjectValueProxy *self)
+{
+	return ObjectValueMapping_values_or_items(self, false);
+}
+
+static PyObject *ObjectValueMapping_items(ObjectValueProxy *self)
+{
+	return ObjectValueMapping_values_or_items(self, true);
+}
+
+static PyMethodDef ObjectValueMapping_methods[] = {
+	{"keys", (PyCFunction)ObjectValueMapping_keys, METH_NOARGS},
+	{"values", (PyCFunction)ObjectValueMapping_values, METH_NOARGS},
+	{"items", (PyCFunction)ObjectValueMapping_items, METH_NOARGS},
+	{"get", (PyCFunction)ObjectValueMapping_get, METH_VARARGS},
+	{},
+};
+
+static PyMappingMethods ObjectValueMapping_as_mapping = {
+	.mp_length = (lenfunc)ObjectValueMapping_length,
+	.mp_subscript = (binaryfunc)ObjectValueMapping_subscript,
+};
+
+static PySequenceMethods ObjectValueMapping_as_sequence = {
+	.sq_contains = (objobjproc)ObjectValueMapping_contains,
+};
+
+PyTypeObject ObjectValueMapping_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "_drgn._ObjectValueMapping",
+	.tp_basicsize = sizeof(ObjectValueProxy),
+	.tp_dealloc = (destructor)ObjectValueProxy_dealloc,
+	.tp_as_sequence = &ObjectValueMapping_as_sequence,
+	.tp_as_mapping = &ObjectValueMapping_as_mapping,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_iter = (getiterfunc)ObjectValueMapping_iter,
+	.tp_methods = ObjectValueMapping_methods,
+};
+
+static Py_ssize_t ObjectValueSequence_length(ObjectValueProxy *self)
+{
+	if (self->length > PY_SSIZE_T_MAX) {
+		PyErr_SetString(PyExc_OverflowError, "length is too large");
+		return -1;
+	}
+	return self->length;
+}
+
+static PyObject *ObjectValueSequence_item(ObjectValueProxy *self,
+					  Py_ssize_t i)
+{
+	struct drgn_error *err;
+	struct drgn_qualified_type element_type;
+	struct drgn_object element;
+	PyObject *ret;
+
+	if (i < 0 || (uint64_t)i >= self->length) {
+		PyErr_SetString(PyExc_IndexError, "index out of range");
+		return NULL;
+	}
+
+	element_type = drgn_type_type(drgn_underlying_type(self->obj->obj.type));
+	drgn_object_init(&element, self->obj->obj.prog);
+	err = drgn_object_slice(&element, &self->obj->obj, element_type,
+				i * self->element_bit_size, 0);
+	if (err)
+		ret = set_drgn_error(err);
+	else
+		ret = DrgnObject_value_impl(&element, true);
+	drgn_object_deinit(&element);
+	return ret;
+}
+
+static PySequenceMethods ObjectValueSequence_as_sequence = {
+	.sq_length = (lenfunc)ObjectValueSequence_length,
+	.sq_item = (ssizeargfunc)ObjectValueSequence_item,
+};
+
+/*
+ * There is no tp_iter, so iteration uses the default sequence iterator, which
+ * converts one element at a time.
+ */
+PyTypeObject ObjectValueSequence_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "_drgn._ObjectValueSequence",
+	.tp_basicsize = sizeof(ObjectValueProxy),
+	.tp_dealloc = (destructor)ObjectValueProxy_dealloc,
+	.tp_as_sequence = &ObjectValueSequence_as_sequence,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+};
@@ -0,0 +1,114 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include "drgnpy.h"
+#include "../pointer_index.h"
+
+PyObject *PointerIndex_wrap(struct drgn_pointer_index *index)
+{
+	PointerIndex *ret;
+
+	ret = (PointerIndex *)PointerIndex_type.tp_alloc(&PointerIndex_type, 0);
+	if (!ret) {
+		drgn_pointer_index_destroy(index);
+		return NULL;
+	}
+	ret->index = index;
+	return (PyObject *)ret;
+}
+
+static void PointerIndex_dealloc(PointerIndex *self)
+{
+	if (self->index)
+		drgn_pointer_index_destroy(self->index);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static Py_ssize_t PointerIndex_length(PointerIndex *self)
+{
+	return self->index->num_entries;
+}
+
+static PyObject *PointerIndex_find(PointerIndex *self, PyObject *args,
+				   PyObject *kwds)
+{
+	static char *keywords[] = {"address", "size", NULL};
+	struct index_arg address = {};
+	unsigned long long size = 1;
+	uint64_t last;
+	const struct drgn_pointer_index_entry *entries;
+	size_t count, i;
+	PyObject *ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|K:find", keywords,
+					 index_converter, &address, &size))
+		return NULL;
+
+	if (!size)
+		return PyList_New(0);
+	/* Clamp the range to the end of the address space. */
+	last = address.uvalue + size - 1;
+	if (last < address.uvalue)
+		last = UINT64_MAX;
+	entries = drgn_pointer_index_find(self->index, address.uvalue, last,
+					  &count);
+	ret = PyList_New(count);
+	if (!ret)
+		return NULL;
+	for (i = 0; i < count; i++) {
+		PyObject *item;
+
+		item = Py_BuildValue("KK",
+				     (unsigned long long)entries[i].source,
+				     (unsigned long long)entries[i].target);
+		if (!item) {
+			Py_DECREF(ret);
+			return NULL;
+		}
+		PyList_SET_ITEM(ret, i, item);
+	}
+	return ret;
+}
+
+static PyObject *PointerIndex_save(PointerIndex *self, PyObject *args,
+				   PyObject *kwds)
+{
+	static char *keywords[] = {"path", NULL};
+	struct drgn_error *err;
+	struct path_arg path = {};
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&:save", keywords,
+					 path_converter, &path))
+		return NULL;
+
+	Py_BEGIN_ALLOW_THREADS
+	err = drgn_pointer_index_save(self->index, path.path);
+	Py_END_ALLOW_THREADS
+	path_cleanup(&path);
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
+static PyMethodDef PointerIndex_methods[] = {
+	{"find", (PyCFunction)PointerIndex_find, METH_VARARGS | METH_KEYWORDS,
+	 drgn_PointerIndex_find_DOC},
+	{"save", (PyCFunction)PointerIndex_save, METH_VARARGS | METH_KEYWORDS,
+	 drgn_PointerIndex_save_DOC},
+	{},
+};
+
+static PySequenceMethods PointerIndex_as_sequence = {
+	.sq_length = (lenfunc)PointerIndex_length,
+};
+
+PyTypeObject PointerIndex_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "_drgn.PointerIndex",
+	.tp_basicsize = sizeof(PointerIndex),
+	.tp_dealloc = (destructor)PointerIndex_dealloc,
+	.tp_as_sequence = &PointerIndex_as_sequence,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = drgn_PointerIndex_DOC,
+	.tp_methods = PointerIndex_methods,
+};
@@ -1,7 +1,14 @@
 // Copyright (c) Facebook, Inc. and its affiliates.
 // SPDX-License-Identifier: GPL-3.0+
 
+#include <unistd.h>
+
 #include "drgnpy.h"
+#include "../error.h"
+#include "../memory_diff.h"
+#include "../memory_search.h"
+#include "../pointer_index.h"
+#include "../watch.h"
 #include "../vector.h"
 
 static int Program_hold_object(Program *prog, PyObject *obj)
@@ -63,12 +70,136 @@ int Program_type_arg(Program *prog, PyObject *type_obj, bool can_be_none,
 	return 0;
 }
 
+/*
+ * Programs with a pickle ID by ID. The map doesn't hold a reference; a Program
+ * removes itself when it is deallocated.
+ */
+DEFINE_HASH_MAP(program_pickle_map, uint64_t, Program *, hash_pair_int_type,
+		hash_table_scalar_eq)
+
+static struct program_pickle_map program_pickle_map = HASH_TABLE_INIT;
+static uint32_t program_pickle_counter;
+
+static int Program_set_pickle_id_impl(Program *self, uint64_t pickle_id)
+{
+	struct program_pickle_map_entry entry = {
+		.key = pickle_id,
+		.value = self,
+	};
+	struct program_pickle_map_iterator it;
+
+	if (pickle_id == self->pickle_id)
+		return 0;
+	if (!pickle_id) {
+		PyErr_SetString(PyExc_ValueError, "pickle ID cannot be 0");
+		return -1;
+	}
+	it = program_pickle_map_search(&program_pickle_map, &pickle_id);
+	if (it.entry) {
+		PyErr_SetString(PyExc_ValueError,
+				"pickle ID is used by another program");
+		return -1;
+	}
+	if (program_pickle_map_insert(&program_pickle_map, &entry,
+				      NULL) == -1) {
+		PyErr_NoMemory();
+		return -1;
+	}
+	if (self->pickle_id)
+		program_pickle_map_delete(&program_pickle_map, &self->pickle_id);
+	self->pickle_id = pickle_id;
+	return 0;
+}
+
+/*
+ * Assign a pickle ID if the program doesn't have one. IDs include the process
+ * ID so that a forked process doesn't reuse the IDs that it inherited.
+ */
+static int Program_assign_pickle_id(Program *self)
+{
+	uint64_t pickle_id;
+
+	if (self->pickle_id)
+		return 0;
+	do {
+		pickle_id = ((uint64_t)getpid() << 32) |
+			    ++program_pickle_counter;
+	} while (program_pickle_map_search(&program_pickle_map,
+					  &pickle_id).entry);
+	return Program_set_pickle_id_impl(self, pickle_id);
+}
+
+PyObject *drgnpy_unpickle_program(PyObject *self, PyObject *args)
+{
+	unsigned long long pickle_id;
+	struct program_pickle_map_iterator it;
+
+	if (!PyArg_ParseTuple(args, "K:_unpickle_program", &pickle_id))
+		return NULL;
+	it = program_pickle_map_search(&program_pickle_map,
+				       &(uint64_t){pickle_id});
+	if (!it.entry) {
+		return PyErr_Format(PyExc_LookupError,
+				    "no program with pickle ID %llu", pickle_id);
+	}
+	Py_INCREF(it.entry->value);
+	return (PyObject *)it.entry->value;
+}
+
+/*
+ * Look up a type by name in a program which unpickles it. Pickles share the
+ * Type for every object of the same type, so each name is only looked up once
+ * per pickle, and the result is also remembered across pickles.
+ */
+PyObject *Program_unpickled_type(Program *prog, PyObject *name)
+{
+	struct drgn_error *err;
+	const char *name_str;
+	struct drgn_qualified_type qualified_type;
+	PyObject *type_obj;
+	bool clear;
+
+	if (prog->unpickled_types) {
+		type_obj = PyDict_GetItemWithError(prog->unpickled_types, name);
+		if (type_obj) {
+			Py_INCREF(type_obj);
+			return type_obj;
+		} else if (PyErr_Occurred()) {
+			return NULL;
+		}
+	} else {
+		prog->unpickled_types = PyDict_New();
+		if (!prog->unpickled_types)
+			return NULL;
+	}
+
+	name_str = PyUnicode_AsUTF8(name);
+	if (!name_str)
+		return NULL;
+	clear = set_drgn_in_python();
+	err = drgn_program_find_type(&prog->prog, name_str, NULL,
+				     &qualified_type);
+	if (clear)
+		clear_drgn_in_python();
+	if (err)
+		return set_drgn_error(err);
+	type_obj = DrgnType_wrap(qualified_type, (PyObject *)prog);
+	if (!type_obj)
+		return NULL;
+	if (PyDict_SetItem(prog->unpickled_types, name, type_obj) == -1) {
+		Py_DECREF(type_obj);
+		return NULL;
+	}
+	return type_obj;
+}
+
 static Program *Program_new(PyTypeObject *subtype, PyObject *args,
 			    PyObject *kwds)
 {
 	static char *keywords[] = {"platform", NULL};
 	PyObject *platform_obj = NULL, *objects, *cache;
 	struct drgn_platform *platform;
+	pthread_mutexattr_t attr;
 	Program *prog;
 
 	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O:Program", keywords,
@@ -101,15 +232,40 @@ static Program *Program_new(PyTypeObject *subtype, PyObject *args,
 	}
 	prog->objects = objects;
 	prog->cache = cache;
+	Program_init_symbol_wrappers(prog);
+	Program_init_type_wrappers(prog);
+	pthread_mutexattr_init(&attr);
+	/* A callback may make another blocking call on the same program. */
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&prog->blocking_lock, &attr);
+	pthread_mutexattr_destroy(&attr);
 	drgn_program_init(&prog->prog, platform);
+	/*
+	 * Calls which release the GIL may look up types, objects, and symbols
+	 * while other threads do the same with the GIL held.
+	 */
+	drgn_program_enable_concurrent_lookups(&prog->prog);
 	return prog;
 }
 
 static void Program_dealloc(Program *self)
 {
+	size_t i;
+
+	if (self->pickle_id)
+		program_pickle_map_delete(&program_pickle_map, &self->pickle_id);
+	/* Compiled expressions may hold objects, so free them first. */
+	Py_XDECREF(self->expressions);
 	drgn_program_deinit(&self->prog);
+	pthread_mutex_destroy(&self->blocking_lock);
+	for (i = 0; i < DRGNPY_MEMBER_CACHE_SIZE; i++)
+		Py_XDECREF(self->member_cache[i].name);
+	Program_deinit_symbol_wrappers(self);
+	Program_deinit_type_wrappers(self);
 	Py_XDECREF(self->objects);
 	Py_XDECREF(self->cache);
+	Py_XDECREF(self->debug_info_progress);
+	Py_XDECREF(self->unpickled_types);
 	Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
@@ -117,6 +273,8 @@ static int Program_traverse(Program *self, visitproc visit, void *arg)
 {
 	Py_VISIT(self->objects);
 	Py_VISIT(self->cache);
+	Py_VISIT(self->debug_info_progress);
+	Py_VISIT(self->unpickled_types);
 	return 0;
 }
 
@@ -124,9 +282,37 @@ static int Program_clear(Program *self)
 {
 	Py_CLEAR(self->objects);
 	Py_CLEAR(self->cache);
+	Py_CLEAR(self->unpickled_types);
+	Py_CLEAR(self->expressions);
+	if (self->debug_info_progress) {
+		drgn_program_set_debug_info_progress(&self->prog, NULL, NULL);
+		Py_CLEAR(self->debug_info_progress);
+	}
 	return 0;
 }
 
+/*
+ * Release the GIL for a call into libdrgn which may take a long time, like
+ * loading debugging information or unwinding a stack, so that other Python
+ * threads can run in the meantime. Blocking calls on the same program are
+ * serialized with each other. Callbacks into Python reacquire the GIL with
+ * PyGILState_Ensure().
+ */
+PyThreadState *Program_begin_blocking(Program *prog)
+{
+	PyThreadState *state;
+
+	state = PyEval_SaveThread();
+	pthread_mutex_lock(&prog->blocking_lock);
+	return state;
+}
+
+void Program_end_blocking(Program *prog, PyThreadState *state)
+{
+	pthread_mutex_unlock(&prog->blocking_lock);
+	PyEval_RestoreThread(state);
+}
+
 static struct drgn_error *py_memory_read_fn(void *buf, uint64_t address,
 					    size_t count, uint64_t offset,
 					    void *arg, bool physical)
@@ -172,19 +358,21 @@ static PyObject *Program_add_memory_segment(Program *self, PyObject *args,
 					    PyObject *kwds)
 {
 	static char *keywords[] = {
-		"address", "size", "read_fn", "physical", NULL,
+		"address", "size", "read_fn", "physical", "block_size", NULL,
 	};
 	struct drgn_error *err;
 	struct index_arg address = {};
 	struct index_arg size = {};
 	PyObject *read_fn;
 	int physical = 0;
+	struct index_arg block_size = { .allow_none = true, .is_none = true };
 
 	if (!PyArg_ParseTupleAndKeywords(args, kwds,
-					 "O&O&O|p:add_memory_segment", keywords,
-					 index_converter, &address,
+					 "O&O&O|p$O&:add_memory_segment",
+					 keywords, index_converter, &address,
 					 index_converter, &size, &read_fn,
-					 &physical))
+					 &physical, index_converter,
+					 &block_size))
 	    return NULL;
 
 	if (!PyCallable_Check(read_fn)) {
@@ -194,9 +382,21 @@ static PyObject *Program_add_memory_segment(Program *self, PyObject *args,
 
 	if (Program_hold_object(self, read_fn) == -1)
 		return NULL;
-	err = drgn_program_add_memory_segment(&self->prog, address.uvalue,
-					      size.uvalue, py_memory_read_fn,
-					      read_fn, physical);
+	/*
+	 * The callback needs the GIL, which a thread waiting for the reader
+	 * lock may hold, so it must never be called by the prefetch thread.
+	 */
+	Py_BEGIN_ALLOW_THREADS
+	drgn_memory_reader_disable_prefetch(&self->prog.reader);
+	Py_END_ALLOW_THREADS
+	err = drgn_program_add_memory_segment_with_block_size(&self->prog,
+							      address.uvalue,
+							      size.uvalue,
+							      py_memory_read_fn,
+							      read_fn, physical,
+							      block_size.is_none ?
+							      0 :
+							      block_size.uvalue);
 	if (err)
 		return set_drgn_error(err);
 	Py_RETURN_NONE;
@@ -262,13 +462,14 @@ out_gstate:
 static PyObject *Program_add_type_finder(Program *self, PyObject *args,
 					 PyObject *kwds)
 {
-	static char *keywords[] = {"fn", NULL};
+	static char *keywords[] = {"fn", "memoize", NULL};
 	struct drgn_error *err;
 	PyObject *fn, *arg;
+	int memoize = 1;
 	int ret;
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:add_type_finder",
-					 keywords, &fn))
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|$p:add_type_finder",
+					 keywords, &fn, &memoize))
 	    return NULL;
 
 	if (!PyCallable_Check(fn)) {
@@ -284,7 +485,14 @@ static PyObject *Program_add_type_finder(Program *self, PyObject *args,
 	if (ret == -1)
 		return NULL;
 
-	err = drgn_program_add_type_finder(&self->prog, py_type_find_fn, arg);
+	if (memoize) {
+		err = drgn_program_add_memoized_type_finder(&self->prog,
+							    py_type_find_fn,
+							    arg);
+	} else {
+		err = drgn_program_add_type_finder(&self->prog, py_type_find_fn,
+						   arg);
+	}
 	if (err)
 		return set_drgn_error(err);
 	Py_RETURN_NONE;
@@ -345,13 +553,14 @@ out_gstate:
 static PyObject *Program_add_object_finder(Program *self, PyObject *args,
 					   PyObject *kwds)
 {
-	static char *keywords[] = {"fn", NULL};
+	static char *keywords[] = {"fn", "memoize", NULL};
 	struct drgn_error *err;
 	PyObject *fn, *arg;
+	int memoize = 1;
 	int ret;
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:add_object_finder",
-					 keywords, &fn))
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|$p:add_object_finder",
+					 keywords, &fn, &memoize))
 	    return NULL;
 
 	if (!PyCallable_Check(fn)) {
@@ -367,8 +576,14 @@ static PyObject *Program_add_object_finder(Program *self, PyObject *args,
 	if (ret == -1)
 		return NULL;
 
-	err = drgn_program_add_object_finder(&self->prog, py_object_find_fn,
-					     arg);
+	if (memoize) {
+		err = drgn_program_add_memoized_object_finder(&self->prog,
+							      py_object_find_fn,
+							      arg);
+	} else {
+		err = drgn_program_add_object_finder(&self->prog,
+						     py_object_find_fn, arg);
+	}
 	if (err)
 		return set_drgn_error(err);
 	Py_RETURN_NONE;
@@ -418,19 +633,111 @@ static PyObject *Program_set_pid(Program *self, PyObject *args, PyObject *kwds)
 	Py_RETURN_NONE;
 }
 
+static PyObject *Program_set_remote(Program *self, PyObject *args,
+				    PyObject *kwds)
+{
+	static char *keywords[] = {"address", NULL};
+	struct drgn_error *err;
+	const char *address;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s:set_remote", keywords,
+					 &address))
+		return NULL;
+
+	err = drgn_program_set_remote(&self->prog, address);
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
+static PyObject *Program_set_memory_trace(Program *self, PyObject *args,
+					  PyObject *kwds)
+{
+	static char *keywords[] = {"path", NULL};
+	struct drgn_error *err;
+	struct path_arg path = {};
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&:set_memory_trace",
+					 keywords, path_converter, &path))
+		return NULL;
+
+	err = drgn_program_set_memory_trace(&self->prog, path.path);
+	path_cleanup(&path);
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
+static PyObject *Program_record_memory(Program *self, PyObject *args,
+				       PyObject *kwds)
+{
+	static char *keywords[] = {"path", "pages", NULL};
+	struct drgn_error *err;
+	struct path_arg path = {};
+	int pages = 0;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|$p:record_memory",
+					 keywords, path_converter, &path,
+					 &pages))
+		return NULL;
+
+	if (pages)
+		err = drgn_program_record_memory_pages(&self->prog, path.path);
+	else
+		err = drgn_program_record_memory(&self->prog, path.path);
+	path_cleanup(&path);
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
+static PyObject *Program_record_memory_range(Program *self, PyObject *args,
+					     PyObject *kwds)
+{
+	static char *keywords[] = {"address", "size", "physical", NULL};
+	struct drgn_error *err;
+	struct index_arg address = {};
+	unsigned long long size;
+	int physical = 0;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&K|p:record_memory_range",
+					 keywords, index_converter, &address,
+					 &size, &physical))
+		return NULL;
+
+	err = drgn_program_record_memory_range(&self->prog, address.uvalue,
+					       size, physical);
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
+static PyObject *Program_stop_recording_memory(Program *self)
+{
+	struct drgn_error *err;
+
+	err = drgn_program_stop_recording_memory(&self->prog);
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
 DEFINE_VECTOR(path_arg_vector, struct path_arg)
 
 static PyObject *Program_load_debug_info(Program *self, PyObject *args,
 					 PyObject *kwds)
 {
-	static char *keywords[] = {"paths", "default", "main", NULL};
+	static char *keywords[] = {
+		"paths", "default", "main", "background", NULL
+	};
 	struct drgn_error *err;
 	PyObject *paths_obj = Py_None;
 	int load_default = 0;
 	int load_main = 0;
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|Opp:load_debug_info",
+	int background = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|Opp$p:load_debug_info",
 					 keywords, &paths_obj, &load_default,
-					 &load_main))
+					 &load_main, &background))
 		return NULL;
 
 	struct path_arg_vector path_args = VECTOR_INIT;
@@ -484,8 +791,29 @@ static PyObject *Program_load_debug_info(Program *self, PyObject *args,
 		for (size_t i = 0; i < path_args.size; i++)
 			paths[i] = path_args.data[i].path;
 	}
-	err = drgn_program_load_debug_info(&self->prog, paths, path_args.size,
-					   load_default, load_main);
+	if (background) {
+		if (self->debug_info_progress) {
+			PyErr_SetString(PyExc_ValueError,
+					"debugging information progress callback cannot be used with background loading");
+			free(paths);
+			goto out;
+		}
+		err = drgn_program_load_debug_info_async(&self->prog, paths,
+							 path_args.size,
+							 load_default,
+							 load_main);
+	} else {
+		/*
+		 * This also lets the progress callback, which is called from
+		 * the indexing threads, take the GIL.
+		 */
+		PyThreadState *state = Program_begin_blocking(self);
+
+		err = drgn_program_load_debug_info(&self->prog, paths,
+						   path_args.size, load_default,
+						   load_main);
+		Program_end_blocking(self, state);
+	}
 	free(paths);
 	if (err)
 		set_drgn_error(err);
@@ -509,20 +837,217 @@ static PyObject *Program_load_default_debug_info(Program *self)
 	Py_RETURN_NONE;
 }
 
-static PyObject *Program_read(Program *self, PyObject *args, PyObject *kwds)
+static PyObject *Program_load_btf(Program *self, PyObject *args,
+				  PyObject *kwds)
+{
+	static char *keywords[] = {"path", NULL};
+	struct drgn_error *err;
+	struct path_arg path = {.allow_none = true};
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O&:load_btf", keywords,
+					 path_converter, &path))
+		return NULL;
+
+	err = drgn_program_load_btf(&self->prog, path.path);
+	path_cleanup(&path);
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
+static PyObject *Program_wait_for_debug_info(Program *self)
+{
+	struct drgn_error *err;
+
+	Py_BEGIN_ALLOW_THREADS
+	err = drgn_program_wait_for_debug_info(&self->prog);
+	Py_END_ALLOW_THREADS
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
+static PyObject *
+debug_info_module_stats_to_dict(const struct drgn_debug_info_module_stats *stats)
+{
+	return Py_BuildValue("{s:s,s:K,s:K,s:K,s:K,s:K,s:K,s:O}",
+			     "name", stats->name,
+			     "read_ns", (unsigned long long)stats->read_ns,
+			     "relocate_ns",
+			     (unsigned long long)stats->relocate_ns,
+			     "index_ns", (unsigned long long)stats->index_ns,
+			     "cus", (unsigned long long)stats->cus,
+			     "dies", (unsigned long long)stats->dies,
+			     "debug_info_bytes",
+			     (unsigned long long)stats->debug_info_bytes,
+			     "cached", stats->cached ? Py_True : Py_False);
+}
+
+static PyObject *Program_debug_info_stats(Program *self)
+{
+	static const struct {
+		const char *name;
+		size_t offset;
+	} fields[] = {
+#define X(name) { #name, offsetof(struct drgn_debug_info_stats, name) }
+		X(report_ns),
+		X(read_ns),
+		X(read_cpu_ns),
+		X(index_ns),
+		X(index_cpu_ns),
+		X(cache_write_ns),
+		X(modules),
+		X(cus),
+		X(dies),
+		X(debug_info_bytes),
+#undef X
+	};
+	struct drgn_debug_info_stats stats;
+	const struct drgn_debug_info_module_stats *module_stats;
+	size_t num_modules;
+	PyObject *dict, *modules;
+	size_t i;
+	int ret;
+
+	Py_BEGIN_ALLOW_THREADS
+	drgn_program_debug_info_stats(&self->prog, &stats);
+	Py_END_ALLOW_THREADS
+	drgn_program_debug_info_module_stats(&self->prog, &module_stats,
+					     &num_modules);
+	dict = PyDict_New();
+	if (!dict)
+		return NULL;
+	for (i = 0; i < ARRAY_SIZE(fields); i++) {
+		PyObject *value;
+
+		value = PyLong_FromUnsignedLongLong(*(uint64_t *)((char *)&stats +
+								 fields[i].offset));
+		if (!value)
+			goto err;
+		ret = PyDict_SetItemString(dict, fields[i].name, value);
+		Py_DECREF(value);
+		if (ret == -1)
+			goto err;
+	}
+
+	modules = PyList_New(num_modules);
+	if (!modules)
+		goto err;
+	for (i = 0; i < num_modules; i++) {
+		PyObject *item;
+
+		item = debug_info_module_stats_to_dict(&module_stats[i]);
+		if (!item) {
+			Py_DECREF(modules);
+			goto err;
+		}
+		PyList_SET_ITEM(modules, i, item);
+	}
+	ret = PyDict_SetItemString(dict, "module_stats", modules);
+	Py_DECREF(modules);
+	if (ret == -1)
+		goto err;
+	return dict;
+
+err:
+	Py_DECREF(dict);
+	return NULL;
+}
+
+static void
+py_debug_info_progress_fn(const struct drgn_debug_info_module_stats *module,
+			  size_t done, size_t total, void *arg)
+{
+	PyGILState_STATE gstate;
+	PyObject *stats, *ret;
+
+	gstate = PyGILState_Ensure();
+	stats = debug_info_module_stats_to_dict(module);
+	if (stats) {
+		ret = PyObject_CallFunction(arg, "Onn", stats, (Py_ssize_t)done,
+					    (Py_ssize_t)total);
+		Py_DECREF(stats);
+		Py_XDECREF(ret);
+	}
+	/* There is no way to stop indexing, so report the error and move on. */
+	if (PyErr_Occurred())
+		PyErr_WriteUnraisable(arg);
+	PyGILState_Release(gstate);
+}
+
+static PyObject *Program_set_debug_info_progress(Program *self,
+						 PyObject *args,
+						 PyObject *kwds)
+{
+	static char *keywords[] = {"fn", NULL};
+	PyObject *fn;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds,
+					 "O:set_debug_info_progress", keywords,
+					 &fn))
+		return NULL;
+
+	if (fn == Py_None) {
+		fn = NULL;
+	} else if (!PyCallable_Check(fn)) {
+		PyErr_SetString(PyExc_TypeError,
+				"progress callback must be callable or None");
+		return NULL;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	if (fn) {
+		drgn_program_set_debug_info_progress(&self->prog,
+						     py_debug_info_progress_fn,
+						     fn);
+	} else {
+		drgn_program_set_debug_info_progress(&self->prog, NULL, NULL);
+	}
+	Py_END_ALLOW_THREADS
+	Py_XINCREF(fn);
+	Py_XSETREF(self->debug_info_progress, fn);
+	Py_RETURN_NONE;
+}
+
+static PyObject *Program_share_debug_info(Program *self, PyObject *arg)
+{
+	struct drgn_error *err;
+
+	if (!PyObject_TypeCheck(arg, &Program_type)) {
+		PyErr_SetString(PyExc_TypeError, "other must be Program");
+		return NULL;
+	}
+	err = drgn_program_share_debug_info(&self->prog,
+					    &((Program *)arg)->prog);
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
+static PyObject *Program_read_common(Program *self,
+				     struct drgnpy_arg_parser *parser,
+				     PyObject *const *args, Py_ssize_t nargs,
+				     PyObject *kwnames, bool try_read)
 {
-	static char *keywords[] = {"address", "size", "physical", NULL};
 	struct drgn_error *err;
+	PyObject *argv[3];
 	struct index_arg address = {};
 	Py_ssize_t size;
 	int physical = 0;
 	PyObject *buf;
-	bool clear;
+	bool clear, read = true;
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&n|p:read", keywords,
-					 index_converter, &address, &size,
-					 &physical))
-	    return NULL;
+	if (drgnpy_parse_args(parser, args, nargs, kwnames, NULL, argv) == -1 ||
+	    !index_converter(argv[0], &address))
+		return NULL;
+	size = PyNumber_AsSsize_t(argv[1], PyExc_OverflowError);
+	if (size == -1 && PyErr_Occurred())
+		return NULL;
+	if (argv[2]) {
+		physical = PyObject_IsTrue(argv[2]);
+		if (physical == -1)
+			return NULL;
+	}
 
 	if (size < 0) {
 		PyErr_SetString(PyExc_ValueError, "negative size");
@@ -532,58 +1057,782 @@ static PyObject *Program_read(Program *self, PyObject *args, PyObject *kwds)
 	if (!buf)
 		return NULL;
 	clear = set_drgn_in_python();
-	err = drgn_program_read_memory(&self->prog, PyBytes_AS_STRING(buf),
-				       address.uvalue, size, physical);
+	Py_BEGIN_ALLOW_THREADS
+	if (try_read) {
+		err = drgn_program_try_read_memory(&self->prog,
+						   PyBytes_AS_STRING(buf),
+						   address.uvalue, size,
+						   physical, &read);
+	} else {
+		err = drgn_program_read_memory(&self->prog,
+					       PyBytes_AS_STRING(buf),
+					       address.uvalue, size, physical);
+	}
+	Py_END_ALLOW_THREADS
 	if (clear)
 		clear_drgn_in_python();
 	if (err) {
 		Py_DECREF(buf);
 		return set_drgn_error(err);
 	}
+	if (!read) {
+		Py_DECREF(buf);
+		Py_RETURN_NONE;
+	}
 	return buf;
 }
 
-#define METHOD_READ(x, type)							\
-static PyObject *Program_read_##x(Program *self, PyObject *args,		\
-				  PyObject *kwds)				\
-{										\
-	static char *keywords[] = {"address", "physical", NULL};		\
-	struct drgn_error *err;							\
-	struct index_arg address = {};						\
-	int physical = 0;							\
-	type tmp;								\
-										\
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|p:read_"#x, keywords,	\
-					 index_converter, &address, &physical))	\
-	    return NULL;							\
-										\
-	err = drgn_program_read_##x(&self->prog, address.uvalue, physical,	\
-				    &tmp);					\
-	if (err)								\
-		return set_drgn_error(err);					\
-	if (sizeof(tmp) <= sizeof(unsigned long))				\
-		return PyLong_FromUnsignedLong(tmp);				\
-	else									\
-		return PyLong_FromUnsignedLongLong(tmp);			\
+static const char * const Program_read_keywords[] = {
+	"address", "size", "physical", NULL,
+};
+
+static PyObject *Program_read(Program *self, PyObject *const *args,
+			      Py_ssize_t nargs, PyObject *kwnames)
+{
+	static struct drgnpy_arg_parser parser = {
+		.fname = "read",
+		.keywords = Program_read_keywords,
+		.min_args = 2,
+		.max_positional = 3,
+	};
+
+	return Program_read_common(self, &parser, args, nargs, kwnames, false);
 }
-METHOD_READ(u8, uint8_t)
-METHOD_READ(u16, uint16_t)
-METHOD_READ(u32, uint32_t)
-METHOD_READ(u64, uint64_t)
-METHOD_READ(word, uint64_t)
-#undef METHOD_READ
 
-static PyObject *Program_find_type(Program *self, PyObject *args, PyObject *kwds)
+static PyObject *Program_try_read(Program *self, PyObject *const *args,
+				  Py_ssize_t nargs, PyObject *kwnames)
 {
-	static char *keywords[] = {"name", "filename", NULL};
-	struct drgn_error *err;
+	static struct drgnpy_arg_parser parser = {
+		.fname = "try_read",
+		.keywords = Program_read_keywords,
+		.min_args = 2,
+		.max_positional = 3,
+	};
+
+	return Program_read_common(self, &parser, args, nargs, kwnames, true);
+}
+
+static PyObject *Program_read_into(Program *self, PyObject *args,
+				   PyObject *kwds)
+{
+	static char *keywords[] = {"buffer", "address", "physical", NULL};
+	struct drgn_error *err;
+	Py_buffer buffer;
+	struct index_arg address = {};
+	int physical = 0;
+	bool clear;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "w*O&|p:read_into",
+					 keywords, &buffer, index_converter,
+					 &address, &physical))
+		return NULL;
+
+	clear = set_drgn_in_python();
+	Py_BEGIN_ALLOW_THREADS
+	err = drgn_program_read_memory(&self->prog, buffer.buf, address.uvalue,
+				       buffer.len, physical);
+	Py_END_ALLOW_THREADS
+	if (clear)
+		clear_drgn_in_python();
+	PyBuffer_Release(&buffer);
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
+/*
+ * Exports memory mapped by a program to a memoryview returned by
+ * Program.read_view(). It holds a reference to the program so that the mapping
+ * stays valid.
+ */
+typedef struct {
+	PyObject_HEAD
+	Program *prog;
+	const void *buf;
+	Py_ssize_t len;
+} MappedMemory;
+
+static void MappedMemory_dealloc(MappedMemory *self)
+{
+	Py_XDECREF(self->prog);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static int MappedMemory_getbuffer(MappedMemory *self, Py_buffer *view,
+				  int flags)
+{
+	return PyBuffer_FillInfo(view, (PyObject *)self, (void *)self->buf,
+				 self->len, 1, flags);
+}
+
+static PyBufferProcs MappedMemory_as_buffer = {
+	.bf_getbuffer = (getbufferproc)MappedMemory_getbuffer,
+};
+
+PyTypeObject MappedMemory_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "_drgn._MappedMemory",
+	.tp_basicsize = sizeof(MappedMemory),
+	.tp_dealloc = (destructor)MappedMemory_dealloc,
+	.tp_as_buffer = &MappedMemory_as_buffer,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+};
+
+static PyObject *Program_read_view(Program *self, PyObject *args,
+				   PyObject *kwds)
+{
+	static char *keywords[] = {"address", "size", "physical", NULL};
+	struct index_arg address = {};
+	Py_ssize_t size;
+	int physical = 0;
+	const void *map;
+	MappedMemory *mapped;
+	PyObject *buf, *ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&n|p:read_view",
+					 keywords, index_converter, &address,
+					 &size, &physical))
+		return NULL;
+	if (size < 0) {
+		PyErr_SetString(PyExc_ValueError, "negative size");
+		return NULL;
+	}
+
+	drgn_memory_reader_map(&self->prog.reader, address.uvalue, size,
+			       physical, &map);
+	if (!map) {
+		/* Fall back to a copy. */
+		buf = PyObject_CallMethod((PyObject *)self, "read", "KnO",
+					  address.uvalue, size,
+					  physical ? Py_True : Py_False);
+		if (!buf)
+			return NULL;
+		ret = PyMemoryView_FromObject(buf);
+		Py_DECREF(buf);
+		return ret;
+	}
+
+	mapped = (MappedMemory *)MappedMemory_type.tp_alloc(&MappedMemory_type,
+							    0);
+	if (!mapped)
+		return NULL;
+	Py_INCREF(self);
+	mapped->prog = self;
+	mapped->buf = map;
+	mapped->len = size;
+	ret = PyMemoryView_FromObject((PyObject *)mapped);
+	Py_DECREF(mapped);
+	return ret;
+}
+
+static PyObject *Program_read_batch(Program *self, PyObject *args,
+				    PyObject *kwds)
+{
+	static char *keywords[] = {"requests", NULL};
+	struct drgn_error *err;
+	PyObject *requests_obj, *seq, *ret = NULL;
+	struct drgn_memory_read_request *requests = NULL;
+	Py_ssize_t num_requests, i;
+	bool clear;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:read_batch", keywords,
+					 &requests_obj))
+		return NULL;
+
+	seq = PySequence_Fast(requests_obj, "requests must be iterable");
+	if (!seq)
+		return NULL;
+	num_requests = PySequence_Fast_GET_SIZE(seq);
+
+	ret = PyList_New(num_requests);
+	if (!ret)
+		goto out;
+	requests = malloc_array(num_requests, sizeof(*requests));
+	if (num_requests && !requests) {
+		PyErr_NoMemory();
+		goto err;
+	}
+	for (i = 0; i < num_requests; i++) {
+		PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+		struct index_arg address = {};
+		Py_ssize_t size;
+		int physical = 0;
+		PyObject *buf;
+
+		if (!PyTuple_Check(item)) {
+			PyErr_SetString(PyExc_TypeError,
+					"request must be (address, size) or (address, size, physical) tuple");
+			goto err;
+		}
+		if (!PyArg_ParseTuple(item, "O&n|p:read_batch", index_converter,
+				      &address, &size, &physical))
+			goto err;
+		if (size < 0) {
+			PyErr_SetString(PyExc_ValueError, "negative size");
+			goto err;
+		}
+		buf = PyBytes_FromStringAndSize(NULL, size);
+		if (!buf)
+			goto err;
+		PyList_SET_ITEM(ret, i, buf);
+		requests[i].buf = PyBytes_AS_STRING(buf);
+		requests[i].address = address.uvalue;
+		requests[i].count = size;
+		requests[i].physical = physical;
+	}
+
+	clear = set_drgn_in_python();
+	Py_BEGIN_ALLOW_THREADS
+	err = drgn_program_read_memory_batch(&self->prog, requests,
+					     num_requests);
+	Py_END_ALLOW_THREADS
+	if (clear)
+		clear_drgn_in_python();
+	if (err) {
+		set_drgn_error(err);
+		goto err;
+	}
+	goto out;
+
+err:
+	Py_CLEAR(ret);
+out:
+	free(requests);
+	Py_DECREF(seq);
+	return ret;
+}
+
+static PyObject *Program_prefetch(Program *self, PyObject *args,
+				  PyObject *kwds)
+{
+	static char *keywords[] = {"address", "size", "physical", NULL};
+	struct index_arg address = {};
+	Py_ssize_t size;
+	int physical = 0;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&n|p:prefetch", keywords,
+					 index_converter, &address, &size,
+					 &physical))
+		return NULL;
+	if (size < 0) {
+		PyErr_SetString(PyExc_ValueError, "negative size");
+		return NULL;
+	}
+	drgn_program_prefetch_memory(&self->prog, address.uvalue, size,
+				     physical);
+	Py_RETURN_NONE;
+}
+
+static PyObject *Program_prefetch_many(Program *self, PyObject *args,
+				       PyObject *kwds)
+{
+	static char *keywords[] = {"ranges", NULL};
+	PyObject *ranges_obj, *it, *item;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:prefetch_many",
+					 keywords, &ranges_obj))
+		return NULL;
+
+	it = PyObject_GetIter(ranges_obj);
+	if (!it)
+		return NULL;
+	while ((item = PyIter_Next(it))) {
+		struct index_arg address = {};
+		Py_ssize_t size;
+		int physical = 0;
+
+		if (!PyTuple_Check(item)) {
+			PyErr_SetString(PyExc_TypeError,
+					"range must be (address, size) or (address, size, physical) tuple");
+			goto err;
+		}
+		if (!PyArg_ParseTuple(item, "O&n|p:prefetch_many",
+				      index_converter, &address, &size,
+				      &physical))
+			goto err;
+		if (size < 0) {
+			PyErr_SetString(PyExc_ValueError, "negative size");
+			goto err;
+		}
+		drgn_program_prefetch_memory(&self->prog, address.uvalue, size,
+					     physical);
+		Py_DECREF(item);
+	}
+	Py_DECREF(it);
+	if (PyErr_Occurred())
+		return NULL;
+	Py_RETURN_NONE;
+
+err:
+	Py_DECREF(item);
+	Py_DECREF(it);
+	return NULL;
+}
+
+/*
+ * Convert an iterable of (address, size) tuples to memory ranges. The returned
+ * array must be freed with free(). It is never NULL on success, even if there
+ * are no ranges.
+ */
+static int memory_ranges_converter(PyObject *ranges_obj,
+				   struct drgn_memory_range **ret,
+				   size_t *num_ret)
+{
+	PyObject *seq;
+	struct drgn_memory_range *ranges;
+	Py_ssize_t num_ranges, i;
+
+	seq = PySequence_Fast(ranges_obj, "ranges must be iterable");
+	if (!seq)
+		return -1;
+	num_ranges = PySequence_Fast_GET_SIZE(seq);
+	ranges = malloc_array(num_ranges ? num_ranges : 1, sizeof(*ranges));
+	if (!ranges) {
+		PyErr_NoMemory();
+		goto err;
+	}
+	for (i = 0; i < num_ranges; i++) {
+		PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+		struct index_arg address = {};
+		unsigned long long size;
+
+		if (!PyTuple_Check(item)) {
+			PyErr_SetString(PyExc_TypeError,
+					"range must be (address, size) tuple");
+			goto err;
+		}
+		if (!PyArg_ParseTuple(item, "O&K", index_converter, &address,
+				      &size))
+			goto err;
+		if (size == 0 || address.uvalue + size - 1 < address.uvalue) {
+			PyErr_SetString(PyExc_ValueError, "invalid range size");
+			goto err;
+		}
+		ranges[i].start = address.uvalue;
+		ranges[i].last = address.uvalue + size - 1;
+	}
+	Py_DECREF(seq);
+	*ret = ranges;
+	*num_ret = num_ranges;
+	return 0;
+
+err:
+	free(ranges);
+	Py_DECREF(seq);
+	return -1;
+}
+
+static PyObject *Program_build_pointer_index(Program *self, PyObject *args,
+					     PyObject *kwds)
+{
+	static char *keywords[] = {"ranges", NULL};
+	struct drgn_error *err;
+	PyObject *ranges_obj = Py_None;
+	struct drgn_memory_range *ranges = NULL;
+	size_t num_ranges = 0;
+	struct drgn_pointer_index *index;
+	bool clear;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O:build_pointer_index",
+					 keywords, &ranges_obj))
+		return NULL;
+
+	if (ranges_obj != Py_None &&
+	    memory_ranges_converter(ranges_obj, &ranges, &num_ranges) == -1)
+		return NULL;
+
+	clear = set_drgn_in_python();
+	Py_BEGIN_ALLOW_THREADS
+	err = drgn_pointer_index_build(&self->prog, ranges, num_ranges, &index);
+	Py_END_ALLOW_THREADS
+	if (clear)
+		clear_drgn_in_python();
+	free(ranges);
+	if (err)
+		return set_drgn_error(err);
+	return PointerIndex_wrap(index);
+}
+
+static PyObject *Program_watch(Program *self, PyObject *args, PyObject *kwds)
+{
+	static char *keywords[] = {"objects", NULL};
+	struct drgn_error *err;
+	PyObject *objects, *seq;
+	Py_ssize_t num_items, i;
+	uint64_t *addresses = NULL, *sizes = NULL;
+	struct drgnpy_watch_item *items = NULL;
+	struct drgn_watch *watch;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:watch", keywords,
+					 &objects))
+		return NULL;
+
+	seq = PySequence_Fast(objects, "objects must be iterable");
+	if (!seq)
+		return NULL;
+	num_items = PySequence_Fast_GET_SIZE(seq);
+	/* Always allocate something so that NULL means error. */
+	addresses = malloc_array(num_items ? num_items : 1,
+				 sizeof(*addresses));
+	sizes = malloc_array(num_items ? num_items : 1, sizeof(*sizes));
+	items = malloc_array(num_items ? num_items : 1, sizeof(*items));
+	if (!addresses || !sizes || !items) {
+		PyErr_NoMemory();
+		goto err;
+	}
+	for (i = 0; i < num_items; i++) {
+		PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+		struct drgn_object *obj;
+
+		if (!PyObject_TypeCheck(item, &DrgnObject_type)) {
+			PyErr_SetString(PyExc_TypeError,
+					"watched object must be Object");
+			goto err;
+		}
+		obj = &((DrgnObject *)item)->obj;
+		if (DrgnObject_prog((DrgnObject *)item) != self) {
+			PyErr_SetString(PyExc_ValueError,
+					"watched object is from different program");
+			goto err;
+		}
+		if (!obj->is_reference) {
+			PyErr_SetString(PyExc_ValueError,
+					"watched object must be a reference");
+			goto err;
+		}
+		addresses[i] = obj->reference.address;
+		sizes[i] = drgn_reference_object_size(obj);
+		items[i].qualified_type = drgn_object_qualified_type(obj);
+		items[i].bit_field_size = obj->is_bit_field ? obj->bit_size : 0;
+		items[i].bit_offset = obj->reference.bit_offset;
+		items[i].little_endian = obj->reference.little_endian;
+	}
+
+	err = drgn_watch_create(&self->prog, addresses, sizes, num_items,
+				&watch);
+	free(sizes);
+	free(addresses);
+	Py_DECREF(seq);
+	if (err) {
+		free(items);
+		return set_drgn_error(err);
+	}
+	return Watch_wrap(self, watch, items);
+
+err:
+	free(items);
+	free(sizes);
+	free(addresses);
+	Py_DECREF(seq);
+	return NULL;
+}
+
+static PyObject *Program_load_pointer_index(Program *self, PyObject *args,
+					    PyObject *kwds)
+{
+	static char *keywords[] = {"path", NULL};
+	struct drgn_error *err;
+	struct path_arg path = {};
+	struct drgn_pointer_index *index;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&:load_pointer_index",
+					 keywords, path_converter, &path))
+		return NULL;
+
+	Py_BEGIN_ALLOW_THREADS
+	err = drgn_pointer_index_load(path.path, &index);
+	Py_END_ALLOW_THREADS
+	path_cleanup(&path);
+	if (err)
+		return set_drgn_error(err);
+	if (self->prog.has_platform &&
+	    index->word_size != (drgn_program_is_64_bit(&self->prog) ? 8 : 4)) {
+		drgn_pointer_index_destroy(index);
+		PyErr_SetString(PyExc_ValueError,
+				"pointer index word size does not match program");
+		return NULL;
+	}
+	return PointerIndex_wrap(index);
+}
+
+static PyObject *Program_hash_memory(Program *self, PyObject *args,
+				     PyObject *kwds)
+{
+	static char *keywords[] = {"physical", "ranges", NULL};
+	struct drgn_error *err;
+	int physical = 1;
+	PyObject *ranges_obj = Py_None;
+	struct drgn_memory_range *ranges = NULL;
+	size_t num_ranges = 0;
+	struct drgn_memory_hashes *hashes;
+	bool clear;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|pO:hash_memory",
+					 keywords, &physical, &ranges_obj))
+		return NULL;
+
+	if (ranges_obj != Py_None &&
+	    memory_ranges_converter(ranges_obj, &ranges, &num_ranges) == -1)
+		return NULL;
+
+	clear = set_drgn_in_python();
+	Py_BEGIN_ALLOW_THREADS
+	err = drgn_memory_hashes_build(&self->prog, physical, ranges,
+				       num_ranges, &hashes);
+	Py_END_ALLOW_THREADS
+	if (clear)
+		clear_drgn_in_python();
+	free(ranges);
+	if (err)
+		return set_drgn_error(err);
+	return MemoryHashes_wrap(hashes);
+}
+
+/* Maximum number of matches that a MemorySearchIterator fetches at once. */
+#define MEMORY_SEARCH_ITERATOR_BATCH 256
+
+/*
+ * Iterator returned by Program.search_memory().
+ *
+ * Matches are fetched from the libdrgn iterator with the GIL released, up to
+ * the end of the window of chunks that it last searched, so that the first
+ * match isn't held back until the batch is full.
+ */
+typedef struct {
+	PyObject_HEAD
+	Program *prog;
+	struct drgn_memory_search_iterator it;
+	/* Fetched addresses and the next one to return. */
+	size_t pos, count;
+	/*
+	 * Error which ended the last batch, which is raised after the addresses
+	 * before it are returned, or &drgn_stop at the end.
+	 */
+	struct drgn_error *err;
+	uint64_t addresses[MEMORY_SEARCH_ITERATOR_BATCH];
+} MemorySearchIterator;
+
+static void MemorySearchIterator_dealloc(MemorySearchIterator *self)
+{
+	if (self->prog)
+		drgn_memory_search_iterator_deinit(&self->it);
+	drgn_error_destroy(self->err);
+	Py_XDECREF(self->prog);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static void MemorySearchIterator_fetch(MemorySearchIterator *self)
+{
+	struct drgn_error *err = NULL;
+	size_t count = 0;
+	bool clear;
+
+	clear = set_drgn_in_python();
+	Py_BEGIN_ALLOW_THREADS
+	while (count < MEMORY_SEARCH_ITERATOR_BATCH) {
+		err = drgn_memory_search_iterator_next(&self->it,
+						       &self->addresses[count]);
+		if (err)
+			break;
+		count++;
+		if (self->it.pos >= self->it.matches.size)
+			break;
+	}
+	Py_END_ALLOW_THREADS
+	if (clear)
+		clear_drgn_in_python();
+	self->pos = 0;
+	self->count = count;
+	self->err = err;
+}
+
+static PyObject *MemorySearchIterator_next(MemorySearchIterator *self)
+{
+	struct drgn_error *err;
+
+	if (self->pos >= self->count) {
+		if (!self->err)
+			MemorySearchIterator_fetch(self);
+		if (self->pos >= self->count) {
+			err = self->err;
+			if (err == &drgn_stop)
+				return NULL;
+			/* Only raise the error once. */
+			self->err = &drgn_stop;
+			return set_drgn_error(err);
+		}
+	}
+	return PyLong_FromUnsignedLongLong(self->addresses[self->pos++]);
+}
+
+PyTypeObject MemorySearchIterator_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "_drgn._MemorySearchIterator",
+	.tp_basicsize = sizeof(MemorySearchIterator),
+	.tp_dealloc = (destructor)MemorySearchIterator_dealloc,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_iter = PyObject_SelfIter,
+	.tp_iternext = (iternextfunc)MemorySearchIterator_next,
+};
+
+static PyObject *Program_search_memory(Program *self, PyObject *args,
+				       PyObject *kwds)
+{
+	static char *keywords[] = {
+		"pattern", "physical", "mask", "alignment", NULL,
+	};
+	struct drgn_error *err;
+	Py_buffer pattern, mask = {};
+	int physical = 1;
+	PyObject *mask_obj = Py_None;
+	unsigned long long alignment = 1;
+	MemorySearchIterator *it = NULL;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "y*|pO$K:search_memory",
+					 keywords, &pattern, &physical,
+					 &mask_obj, &alignment))
+		return NULL;
+
+	if (mask_obj != Py_None) {
+		if (PyObject_GetBuffer(mask_obj, &mask, PyBUF_SIMPLE) == -1)
+			goto out;
+		if (mask.len != pattern.len) {
+			PyErr_SetString(PyExc_ValueError,
+					"mask must be the same length as pattern");
+			goto out;
+		}
+	}
+
+	it = (MemorySearchIterator *)
+		MemorySearchIterator_type.tp_alloc(&MemorySearchIterator_type,
+						   0);
+	if (!it)
+		goto out;
+	err = drgn_memory_search_iterator_init(&it->it, &self->prog.reader,
+					       pattern.buf, mask.buf,
+					       pattern.len, alignment,
+					       physical);
+	if (err) {
+		Py_CLEAR(it);
+		set_drgn_error(err);
+		goto out;
+	}
+	it->prog = self;
+	Py_INCREF(self);
+
+out:
+	if (mask.obj)
+		PyBuffer_Release(&mask);
+	PyBuffer_Release(&pattern);
+	return (PyObject *)it;
+}
+
+#define METHOD_READ(x, type)							\
+static PyObject *Program_read_##x(Program *self, PyObject *args,		\
+				  PyObject *kwds)				\
+{										\
+	static char *keywords[] = {"address", "physical", NULL};		\
+	struct drgn_error *err;							\
+	struct index_arg address = {};						\
+	int physical = 0;							\
+	type tmp;								\
+										\
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|p:read_"#x, keywords,	\
+					 index_converter, &address, &physical))	\
+	    return NULL;							\
+										\
+	Py_BEGIN_ALLOW_THREADS							\
+	err = drgn_program_read_##x(&self->prog, address.uvalue, physical,	\
+				    &tmp);					\
+	Py_END_ALLOW_THREADS							\
+	if (err)								\
+		return set_drgn_error(err);					\
+	if (sizeof(tmp) <= sizeof(unsigned long))				\
+		return PyLong_FromUnsignedLong(tmp);				\
+	else									\
+		return PyLong_FromUnsignedLongLong(tmp);			\
+}
+METHOD_READ(u8, uint8_t)
+METHOD_READ(u16, uint16_t)
+METHOD_READ(u32, uint32_t)
+METHOD_READ(u64, uint64_t)
+METHOD_READ(word, uint64_t)
+#undef METHOD_READ
+
+#define METHOD_READ_ARRAY(x, type, typecode)					\
+static PyObject *Program_read_##x##_array(Program *self, PyObject *args,	\
+					  PyObject *kwds)			\
+{										\
+	static char *keywords[] = {"address", "count", "physical", NULL};	\
+	struct drgn_error *err;							\
+	struct index_arg address = {};						\
+	Py_ssize_t count;							\
+	int physical = 0;							\
+	PyObject *values, *array_module, *ret;					\
+										\
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&n|p:read_"#x"_array",	\
+					 keywords, index_converter, &address,	\
+					 &count, &physical))			\
+	    return NULL;							\
+										\
+	if (count < 0) {							\
+		PyErr_SetString(PyExc_ValueError, "negative count");		\
+		return NULL;							\
+	}									\
+	if (count > PY_SSIZE_T_MAX / (Py_ssize_t)sizeof(type))			\
+		return PyErr_NoMemory();					\
+	values = PyBytes_FromStringAndSize(NULL, count * sizeof(type));	\
+	if (!values)								\
+		return NULL;							\
+	Py_BEGIN_ALLOW_THREADS							\
+	err = drgn_program_read_##x##_array(&self->prog, address.uvalue,	\
+					    count, physical,			\
+					    (type *)PyBytes_AS_STRING(values));	\
+	Py_END_ALLOW_THREADS							\
+	if (err) {								\
+		Py_DECREF(values);						\
+		return set_drgn_error(err);					\
+	}									\
+										\
+	array_module = PyImport_ImportModule("array");				\
+	if (!array_module) {							\
+		Py_DECREF(values);						\
+		return NULL;							\
+	}									\
+	ret = PyObject_CallMethod(array_module, "array", "sO", typecode,	\
+				  values);					\
+	Py_DECREF(array_module);						\
+	Py_DECREF(values);							\
+	return ret;								\
+}
+METHOD_READ_ARRAY(u8, uint8_t, "B")
+METHOD_READ_ARRAY(u16, uint16_t, "H")
+METHOD_READ_ARRAY(u32, uint32_t, "I")
+METHOD_READ_ARRAY(u64, uint64_t, "Q")
+METHOD_READ_ARRAY(word, uint64_t, "Q")
+#undef METHOD_READ_ARRAY
+
+static PyObject *Program_find_type(Program *self, PyObject *const *args,
+				   Py_ssize_t nargs, PyObject *kwnames)
+{
+	static const char * const keywords[] = {"name", "filename", NULL};
+	static struct drgnpy_arg_parser parser = {
+		.fname = "type",
+		.keywords = keywords,
+		.min_args = 1,
+		.max_positional = 2,
+	};
+	struct drgn_error *err;
+	PyObject *argv[2];
 	const char *name;
 	struct path_arg filename = {.allow_none = true};
 	struct drgn_qualified_type qualified_type;
 	bool clear;
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O&:type", keywords,
-					 &name, path_converter, &filename))
+	if (drgnpy_parse_args(&parser, args, nargs, kwnames, NULL, argv) == -1)
+		return NULL;
+	name = drgnpy_str_arg(&parser, 0, argv[0]);
+	if (!name || (argv[1] && !path_converter(argv[1], &filename)))
 		return NULL;
 
 	clear = set_drgn_in_python();
@@ -626,6 +1875,158 @@ static PyObject *Program_pointer_type(Program *self, PyObject *args,
 	return DrgnType_wrap(qualified_type, (PyObject *)self);
 }
 
+static PyObject *Program_member_path(Program *self, PyObject *args,
+				     PyObject *kwds)
+{
+	static char *keywords[] = {"type", "member", NULL};
+	struct drgn_error *err;
+	PyObject *type_obj, *designator;
+	struct drgn_qualified_type qualified_type;
+	const char *member_designator;
+	struct drgn_member_info info;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OU:member_path", keywords,
+					 &type_obj, &designator))
+		return NULL;
+
+	if (Program_type_arg(self, type_obj, false, &qualified_type) == -1)
+		return NULL;
+	member_designator = PyUnicode_AsUTF8(designator);
+	if (!member_designator)
+		return NULL;
+
+	err = drgn_program_member_path(&self->prog, qualified_type.type,
+				       member_designator, &info);
+	if (err)
+		return set_drgn_error(err);
+	return MemberPath_wrap(self, qualified_type, designator, &info);
+}
+
+static PyObject *Program_read_field_array(Program *self, PyObject *args,
+					  PyObject *kwds)
+{
+	static char *keywords[] = {"type", "member", "addresses", NULL};
+	struct drgn_error *err;
+	PyObject *type_obj, *designator, *addresses_obj, *seq;
+	PyObject *values = NULL, *array_module, *ret = NULL;
+	struct drgn_qualified_type qualified_type;
+	const char *member_designator;
+	struct drgn_member_info info;
+	uint64_t *addresses = NULL;
+	Py_ssize_t num_addresses, i;
+	enum drgn_object_kind kind;
+	bool clear;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OUO:read_field_array",
+					 keywords, &type_obj, &designator,
+					 &addresses_obj))
+		return NULL;
+
+	if (Program_type_arg(self, type_obj, false, &qualified_type) == -1)
+		return NULL;
+	member_designator = PyUnicode_AsUTF8(designator);
+	if (!member_designator)
+		return NULL;
+	err = drgn_program_member_path(&self->prog, qualified_type.type,
+				       member_designator, &info);
+	if (err)
+		return set_drgn_error(err);
+
+	seq = PySequence_Fast(addresses_obj, "addresses must be iterable");
+	if (!seq)
+		return NULL;
+	num_addresses = PySequence_Fast_GET_SIZE(seq);
+	addresses = malloc_array(num_addresses, sizeof(*addresses));
+	if (num_addresses && !addresses) {
+		PyErr_NoMemory();
+		goto out;
+	}
+	for (i = 0; i < num_addresses; i++) {
+		struct index_arg address = {};
+
+		if (!index_converter(PySequence_Fast_GET_ITEM(seq, i),
+				     &address))
+			goto out;
+		addresses[i] = address.uvalue;
+	}
+
+	values = PyBytes_FromStringAndSize(NULL, num_addresses * 8);
+	if (!values)
+		goto out;
+	clear = set_drgn_in_python();
+	Py_BEGIN_ALLOW_THREADS
+	err = drgn_program_read_field_array(&self->prog, &info, addresses,
+					    num_addresses,
+					    PyBytes_AS_STRING(values), &kind);
+	Py_END_ALLOW_THREADS
+	if (clear)
+		clear_drgn_in_python();
+	if (err) {
+		set_drgn_error(err);
+		goto out;
+	}
+
+	array_module = PyImport_ImportModule("array");
+	if (!array_module)
+		goto out;
+	ret = PyObject_CallMethod(array_module, "array", "sO",
+				  kind == DRGN_OBJECT_SIGNED ? "q" :
+				  kind == DRGN_OBJECT_UNSIGNED ? "Q" : "d",
+				  values);
+	Py_DECREF(array_module);
+out:
+	Py_XDECREF(values);
+	free(addresses);
+	Py_DECREF(seq);
+	return ret;
+}
+
+static PyObject *Program_enumerator(Program *self, PyObject *args,
+				    PyObject *kwds)
+{
+	static char *keywords[] = {"type", "value", NULL};
+	struct drgn_error *err;
+	PyObject *type_obj, *value_obj;
+	struct drgn_qualified_type qualified_type;
+	struct drgn_type *underlying_type;
+	struct index_arg value = {};
+	const struct drgn_type_enumerator *enumerator;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO:enumerator", keywords,
+					 &type_obj, &value_obj))
+		return NULL;
+
+	if (Program_type_arg(self, type_obj, false, &qualified_type) == -1)
+		return NULL;
+	underlying_type = drgn_underlying_type(qualified_type.type);
+	value.is_signed = (drgn_type_kind(underlying_type) == DRGN_TYPE_ENUM &&
+			   drgn_type_is_complete(underlying_type) &&
+			   drgn_enum_type_is_signed(underlying_type));
+	if (!index_converter(value_obj, &value)) {
+		/* A value out of range can't match any enumerator. */
+		if (!PyErr_ExceptionMatches(PyExc_OverflowError))
+			return NULL;
+		PyErr_Clear();
+		Py_RETURN_NONE;
+	}
+
+	err = drgn_program_find_enumerator(&self->prog, qualified_type.type,
+					   value.uvalue, &enumerator);
+	if (err)
+		return set_drgn_error(err);
+	if (!enumerator)
+		Py_RETURN_NONE;
+	if (value.is_signed) {
+		return PyObject_CallFunction((PyObject *)&TypeEnumerator_type,
+					     "sL", enumerator->name,
+					     (long long)enumerator->svalue);
+	} else {
+		return PyObject_CallFunction((PyObject *)&TypeEnumerator_type,
+					     "sK", enumerator->name,
+					     (unsigned long long)enumerator->uvalue);
+	}
+}
+
 static DrgnObject *Program_find_object(Program *self, const char *name,
 				       struct path_arg *filename,
 				       enum drgn_find_object_flags flags)
@@ -671,6 +2072,57 @@ static DrgnObject *Program_object(Program *self, PyObject *args,
 	return Program_find_object(self, name, &filename, flags.value);
 }
 
+static struct drgn_error *Program_names_append(const char *name,
+						size_t name_len,
+						enum drgn_find_name_flags flags,
+						void *arg)
+{
+	PyObject *name_obj;
+	int r;
+
+	name_obj = PyUnicode_FromStringAndSize(name, name_len);
+	if (!name_obj)
+		return drgn_error_from_python();
+	r = PyList_Append(arg, name_obj);
+	Py_DECREF(name_obj);
+	if (r == -1)
+		return drgn_error_from_python();
+	return NULL;
+}
+
+static PyObject *Program_names(Program *self, PyObject *args, PyObject *kwds)
+{
+	static char *keywords[] = {"prefix", "glob", "flags", NULL};
+	struct drgn_error *err;
+	const char *prefix = "";
+	const char *glob = NULL;
+	struct enum_arg flags = {
+		.type = FindNameFlags_class,
+		.value = DRGN_FIND_NAME_ANY,
+	};
+	PyObject *ret;
+	bool clear;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|s$zO&:names", keywords,
+					 &prefix, &glob, enum_converter,
+					 &flags))
+		return NULL;
+
+	ret = PyList_New(0);
+	if (!ret)
+		return NULL;
+	clear = set_drgn_in_python();
+	err = drgn_program_for_each_name(&self->prog, prefix, glob, flags.value,
+					 Program_names_append, ret);
+	if (clear)
+		clear_drgn_in_python();
+	if (err) {
+		Py_DECREF(ret);
+		return set_drgn_error(err);
+	}
+	return ret;
+}
+
 static DrgnObject *Program_constant(Program *self, PyObject *args,
 				    PyObject *kwds)
 {
@@ -701,55 +2153,464 @@ static DrgnObject *Program_function(Program *self, PyObject *args,
 				   DRGN_FIND_OBJECT_FUNCTION);
 }
 
-static DrgnObject *Program_variable(Program *self, PyObject *args,
-				    PyObject *kwds)
+static DrgnObject *Program_variable(Program *self, PyObject *args,
+				    PyObject *kwds)
+{
+	static char *keywords[] = {"name", "filename", NULL};
+	const char *name;
+	struct path_arg filename = {.allow_none = true};
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O&:variable", keywords,
+					 &name, path_converter, &filename))
+		return NULL;
+
+	return Program_find_object(self, name, &filename,
+				   DRGN_FIND_OBJECT_VARIABLE);
+}
+
+/* Maximum number of compiled expressions cached by Program.eval(). */
+#define DRGNPY_EXPRESSION_CACHE_SIZE 1024
+
+static void Program_expression_destructor(PyObject *capsule)
+{
+	drgn_expression_destroy(PyCapsule_GetPointer(capsule,
+						     "drgn_expression"));
+}
+
+/*
+ * Return a new reference to the capsule containing the compiled expression,
+ * compiling it if it isn't cached. A reference is returned so that the
+ * expression stays alive even if a callback clears the cache while it is being
+ * evaluated.
+ */
+static PyObject *Program_get_expression(Program *self, PyObject *expr,
+					PyObject *names,
+					const char * const *variables)
+{
+	struct drgn_error *err;
+	PyObject *key, *capsule;
+	const char *str;
+	struct drgn_expression *compiled;
+	bool clear;
+
+	if (!self->expressions) {
+		self->expressions = PyDict_New();
+		if (!self->expressions)
+			return NULL;
+	}
+
+	key = PyTuple_Pack(2, expr, names);
+	if (!key)
+		return NULL;
+	capsule = PyDict_GetItemWithError(self->expressions, key);
+	if (capsule) {
+		Py_INCREF(capsule);
+		Py_DECREF(key);
+		return capsule;
+	} else if (PyErr_Occurred()) {
+		goto err;
+	}
+
+	str = PyUnicode_AsUTF8(expr);
+	if (!str)
+		goto err;
+	clear = set_drgn_in_python();
+	err = drgn_program_compile_expression(&self->prog, str, variables,
+					      PyTuple_GET_SIZE(names),
+					      &compiled);
+	if (clear)
+		clear_drgn_in_python();
+	if (err) {
+		set_drgn_error(err);
+		goto err;
+	}
+	capsule = PyCapsule_New(compiled, "drgn_expression",
+				Program_expression_destructor);
+	if (!capsule) {
+		drgn_expression_destroy(compiled);
+		goto err;
+	}
+	/* Don't let the cache grow without bound. */
+	if (PyDict_Size(self->expressions) >= DRGNPY_EXPRESSION_CACHE_SIZE)
+		PyDict_Clear(self->expressions);
+	if (PyDict_SetItem(self->expressions, key, capsule) == -1) {
+		Py_DECREF(capsule);
+		goto err;
+	}
+	Py_DECREF(key);
+	return capsule;
+
+err:
+	Py_DECREF(key);
+	return NULL;
+}
+
+static DrgnObject *Program_eval(Program *self, PyObject *args, PyObject *kwds)
+{
+	struct drgn_error *err;
+	PyObject *expr, *names, *key, *value, *capsule;
+	Py_ssize_t num_variables, i, pos;
+	const char **variable_names = NULL;
+	const struct drgn_object **variables = NULL;
+	DrgnObject *ret = NULL;
+	bool clear;
+
+	if (!PyArg_ParseTuple(args, "U:eval", &expr))
+		return NULL;
+
+	num_variables = kwds ? PyDict_Size(kwds) : 0;
+	names = PyTuple_New(num_variables);
+	if (!names)
+		return NULL;
+	if (num_variables) {
+		variable_names = malloc_array(num_variables,
+					      sizeof(*variable_names));
+		variables = malloc_array(num_variables, sizeof(*variables));
+		if (!variable_names || !variables) {
+			PyErr_NoMemory();
+			goto out;
+		}
+	}
+	pos = 0;
+	i = 0;
+	while (kwds && PyDict_Next(kwds, &pos, &key, &value)) {
+		if (!PyObject_TypeCheck(value, &DrgnObject_type)) {
+			PyErr_Format(PyExc_TypeError,
+				     "variable '%U' must be Object", key);
+			goto out;
+		}
+		if (DrgnObject_prog((DrgnObject *)value) != self) {
+			PyErr_Format(PyExc_ValueError,
+				     "variable '%U' is from wrong program",
+				     key);
+			goto out;
+		}
+		variable_names[i] = PyUnicode_AsUTF8(key);
+		if (!variable_names[i])
+			goto out;
+		variables[i] = &((DrgnObject *)value)->obj;
+		Py_INCREF(key);
+		PyTuple_SET_ITEM(names, i, key);
+		i++;
+	}
+
+	capsule = Program_get_expression(self, expr, names, variable_names);
+	if (!capsule)
+		goto out;
+
+	ret = DrgnObject_alloc(self);
+	if (!ret) {
+		Py_DECREF(capsule);
+		goto out;
+	}
+	clear = set_drgn_in_python();
+	err = drgn_expression_evaluate(PyCapsule_GetPointer(capsule,
+							    "drgn_expression"),
+				       variables, &ret->obj);
+	if (clear)
+		clear_drgn_in_python();
+	Py_DECREF(capsule);
+	if (err) {
+		Py_DECREF(ret);
+		ret = set_drgn_error(err);
+	}
+out:
+	free(variables);
+	free(variable_names);
+	Py_DECREF(names);
+	return ret;
+}
+
+static StackTrace *Program_stack_trace(Program *self, PyObject *args,
+				       PyObject *kwds)
+{
+	static char *keywords[] = {"thread", NULL};
+	struct drgn_error *err;
+	PyObject *thread;
+	struct drgn_stack_trace *trace;
+	PyThreadState *state;
+	StackTrace *ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:stack_trace", keywords,
+					 &thread))
+		return NULL;
+
+	if (PyObject_TypeCheck(thread, &DrgnObject_type)) {
+		state = Program_begin_blocking(self);
+		err = drgn_object_stack_trace(&((DrgnObject *)thread)->obj,
+					      &trace);
+		Program_end_blocking(self, state);
+	} else {
+		struct index_arg tid = {};
+
+		if (!index_converter(thread, &tid))
+			return NULL;
+		state = Program_begin_blocking(self);
+		err = drgn_program_stack_trace(&self->prog, tid.uvalue, &trace);
+		Program_end_blocking(self, state);
+	}
+	if (err)
+		return set_drgn_error(err);
+
+	ret = (StackTrace *)StackTrace_type.tp_alloc(&StackTrace_type, 0);
+	if (!ret) {
+		drgn_stack_trace_destroy(trace);
+		return NULL;
+	}
+	ret->trace = trace;
+	ret->prog = self;
+	Py_INCREF(self);
+	return ret;
+}
+
+/* Get the thread ID of a thread ID or task argument of Program.stack_traces(). */
+static int thread_id_converter(Program *prog, PyObject *o, uint32_t *ret)
+{
+	struct drgn_error *err;
+	struct index_arg tid = {};
+
+	if (PyObject_TypeCheck(o, &DrgnObject_type)) {
+		const struct drgn_object *obj = &((DrgnObject *)o)->obj;
+		struct drgn_object pid;
+		union drgn_value value;
+
+		if (drgn_type_kind(drgn_underlying_type(obj->type)) ==
+		    DRGN_TYPE_INT) {
+			err = drgn_object_read_integer(obj, &value);
+		} else {
+			/* struct task_struct * */
+			drgn_object_init(&pid, &prog->prog);
+			err = drgn_object_member_dereference(&pid, obj, "pid");
+			if (!err)
+				err = drgn_object_read_integer(&pid, &value);
+			drgn_object_deinit(&pid);
+		}
+		if (err) {
+			set_drgn_error(err);
+			return -1;
+		}
+		*ret = value.uvalue;
+		return 0;
+	}
+	if (!index_converter(o, &tid))
+		return -1;
+	*ret = tid.uvalue;
+	return 0;
+}
+
+/*
+ * Convert an optional iterable of threads to thread IDs for
+ * drgn_program_stack_traces(). *tids_ret is NULL if threads is None.
+ */
+static int Program_thread_ids(Program *self, PyObject *threads,
+			      uint32_t **tids_ret, size_t *count_ret)
+{
+	PyObject *seq;
+	uint32_t *tids;
+	size_t count, i;
+
+	*tids_ret = NULL;
+	*count_ret = 0;
+	if (threads == Py_None)
+		return 0;
+
+	seq = PySequence_Fast(threads, "threads must be iterable");
+	if (!seq)
+		return -1;
+	count = PySequence_Fast_GET_SIZE(seq);
+	tids = malloc_array(count ? count : 1, sizeof(*tids));
+	if (!tids) {
+		Py_DECREF(seq);
+		PyErr_NoMemory();
+		return -1;
+	}
+	for (i = 0; i < count; i++) {
+		if (thread_id_converter(self, PySequence_Fast_GET_ITEM(seq, i),
+					&tids[i]) == -1) {
+			Py_DECREF(seq);
+			free(tids);
+			return -1;
+		}
+	}
+	Py_DECREF(seq);
+	*tids_ret = tids;
+	*count_ret = count;
+	return 0;
+}
+
+/*
+ * Raise the first error unwinding a thread other than the thread not existing
+ * or not being unwindable (e.g., because it is running).
+ */
+static int check_thread_stack_traces(struct drgn_thread_stack_trace *traces,
+				     size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		if (!traces[i].trace &&
+		    traces[i].err->code != DRGN_ERROR_LOOKUP &&
+		    traces[i].err->code != DRGN_ERROR_INVALID_ARGUMENT) {
+			set_drgn_error(traces[i].err);
+			traces[i].err = NULL;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static StackTrace *Program_wrap_stack_trace(Program *self,
+					    struct drgn_stack_trace **trace)
 {
-	static char *keywords[] = {"name", "filename", NULL};
-	const char *name;
-	struct path_arg filename = {.allow_none = true};
+	StackTrace *trace_obj;
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O&:variable", keywords,
-					 &name, path_converter, &filename))
+	trace_obj = (StackTrace *)StackTrace_type.tp_alloc(&StackTrace_type, 0);
+	if (!trace_obj)
 		return NULL;
-
-	return Program_find_object(self, name, &filename,
-				   DRGN_FIND_OBJECT_VARIABLE);
+	trace_obj->trace = *trace;
+	*trace = NULL;
+	trace_obj->prog = self;
+	Py_INCREF(self);
+	return trace_obj;
 }
 
-static StackTrace *Program_stack_trace(Program *self, PyObject *args,
-				       PyObject *kwds)
+static PyObject *Program_stack_traces(Program *self, PyObject *args,
+				      PyObject *kwds)
 {
-	static char *keywords[] = {"thread", NULL};
+	static char *keywords[] = {"threads", NULL};
 	struct drgn_error *err;
-	PyObject *thread;
-	struct drgn_stack_trace *trace;
-	StackTrace *ret;
-
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:stack_trace", keywords,
-					 &thread))
+	PyObject *threads = Py_None, *ret = NULL;
+	PyThreadState *state;
+	uint32_t *tids;
+	size_t count, num_traces, i;
+	struct drgn_thread_stack_trace *traces;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O:stack_traces",
+					 keywords, &threads))
+		return NULL;
+	if (Program_thread_ids(self, threads, &tids, &count) == -1)
 		return NULL;
 
-	if (PyObject_TypeCheck(thread, &DrgnObject_type)) {
-		err = drgn_object_stack_trace(&((DrgnObject *)thread)->obj,
-					      &trace);
-	} else {
-		struct index_arg tid = {};
+	state = Program_begin_blocking(self);
+	err = drgn_program_stack_traces(&self->prog, tids, count, &traces,
+					&num_traces);
+	Program_end_blocking(self, state);
+	if (err) {
+		set_drgn_error(err);
+		goto out_tids;
+	}
+	if (check_thread_stack_traces(traces, num_traces) == -1)
+		goto out_traces;
 
-		if (!index_converter(thread, &tid))
-			return NULL;
-		err = drgn_program_stack_trace(&self->prog, tid.uvalue, &trace);
+	ret = PyDict_New();
+	if (!ret)
+		goto out_traces;
+	for (i = 0; i < num_traces; i++) {
+		StackTrace *trace_obj;
+		PyObject *key;
+		int r;
+
+		if (!traces[i].trace)
+			continue;
+		trace_obj = Program_wrap_stack_trace(self, &traces[i].trace);
+		if (!trace_obj)
+			goto err;
+		key = PyLong_FromUnsignedLong(traces[i].tid);
+		if (!key) {
+			Py_DECREF(trace_obj);
+			goto err;
+		}
+		r = PyDict_SetItem(ret, key, (PyObject *)trace_obj);
+		Py_DECREF(key);
+		Py_DECREF(trace_obj);
+		if (r == -1)
+			goto err;
 	}
-	if (err)
-		return set_drgn_error(err);
+	goto out_traces;
+
+err:
+	Py_CLEAR(ret);
+out_traces:
+	drgn_thread_stack_traces_destroy(traces, num_traces);
+out_tids:
+	free(tids);
+	return ret;
+}
 
-	ret = (StackTrace *)StackTrace_type.tp_alloc(&StackTrace_type, 0);
-	if (!ret) {
-		drgn_stack_trace_destroy(trace);
+static PyObject *Program_stack_trace_groups(Program *self, PyObject *args,
+					    PyObject *kwds)
+{
+	static char *keywords[] = {"threads", NULL};
+	struct drgn_error *err;
+	PyObject *threads = Py_None, *ret = NULL;
+	PyThreadState *state;
+	uint32_t *tids;
+	size_t count, num_traces, num_groups, i, j;
+	struct drgn_thread_stack_trace *traces;
+	struct drgn_stack_trace_group *groups;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O:stack_trace_groups",
+					 keywords, &threads))
+		return NULL;
+	if (Program_thread_ids(self, threads, &tids, &count) == -1)
 		return NULL;
+
+	state = Program_begin_blocking(self);
+	err = drgn_program_stack_traces(&self->prog, tids, count, &traces,
+					&num_traces);
+	Program_end_blocking(self, state);
+	if (err) {
+		set_drgn_error(err);
+		goto out_tids;
 	}
-	ret->trace = trace;
-	ret->prog = self;
-	Py_INCREF(self);
+	if (check_thread_stack_traces(traces, num_traces) == -1)
+		goto out_traces;
+	err = drgn_group_stack_traces(traces, num_traces, &groups, &num_groups);
+	if (err) {
+		set_drgn_error(err);
+		goto out_traces;
+	}
+
+	ret = PyList_New(num_groups);
+	if (!ret)
+		goto out_groups;
+	for (i = 0; i < num_groups; i++) {
+		StackTrace *trace_obj;
+		PyObject *tids_obj, *item;
+
+		tids_obj = PyList_New(groups[i].count);
+		if (!tids_obj)
+			goto err;
+		for (j = 0; j < groups[i].count; j++) {
+			PyObject *tid;
+
+			tid = PyLong_FromUnsignedLong(groups[i].tids[j]);
+			if (!tid) {
+				Py_DECREF(tids_obj);
+				goto err;
+			}
+			PyList_SET_ITEM(tids_obj, j, tid);
+		}
+		trace_obj = Program_wrap_stack_trace(self, &groups[i].trace);
+		if (!trace_obj) {
+			Py_DECREF(tids_obj);
+			goto err;
+		}
+		item = Py_BuildValue("NN", trace_obj, tids_obj);
+		if (!item)
+			goto err;
+		PyList_SET_ITEM(ret, i, item);
+	}
+	goto out_groups;
+
+err:
+	Py_CLEAR(ret);
+out_groups:
+	drgn_stack_trace_groups_destroy(groups, num_groups);
+out_traces:
+	drgn_thread_stack_traces_destroy(traces, num_traces);
+out_tids:
+	free(tids);
 	return ret;
 }
 
@@ -771,8 +2632,12 @@ static PyObject *Program_symbol(Program *self, PyObject *arg)
 
 		if (!index_converter(arg, &address))
 			return NULL;
-		err = drgn_program_find_symbol_by_address(&self->prog,
-							  address.uvalue, &sym);
+		err = drgn_program_find_symbol_by_address_interned(&self->prog,
+								   address.uvalue,
+								   &sym);
+		if (err)
+			return set_drgn_error(err);
+		return Symbol_wrap_interned(sym, self);
 	}
 	if (err)
 		return set_drgn_error(err);
@@ -784,6 +2649,193 @@ static PyObject *Program_symbol(Program *self, PyObject *arg)
 	return ret;
 }
 
+/*
+ * Convert the addresses argument of Program.symbolize() to an array. Buffers of
+ * 64-bit unsigned integers (e.g., array.array("Q")) are used without
+ * converting each element.
+ */
+static uint64_t *symbolize_addresses(PyObject *arg, size_t *count_ret)
+{
+	uint64_t *addresses;
+	PyObject *seq;
+	size_t i;
+
+	if (PyObject_CheckBuffer(arg)) {
+		Py_buffer view;
+
+		if (PyObject_GetBuffer(arg, &view,
+				       PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) == -1)
+			return NULL;
+		if (view.itemsize != sizeof(uint64_t) || !view.format ||
+		    (strcmp(view.format, "Q") != 0 &&
+		     strcmp(view.format, "L") != 0)) {
+			PyBuffer_Release(&view);
+			PyErr_SetString(PyExc_TypeError,
+					"addresses buffer must contain unsigned 64-bit integers");
+			return NULL;
+		}
+		*count_ret = view.len / view.itemsize;
+		/* Always allocate something so that NULL means error. */
+		addresses = malloc(view.len ? view.len : 1);
+		if (addresses)
+			memcpy(addresses, view.buf, view.len);
+		else
+			PyErr_NoMemory();
+		PyBuffer_Release(&view);
+		return addresses;
+	}
+
+	seq = PySequence_Fast(arg, "addresses must be a sequence");
+	if (!seq)
+		return NULL;
+	*count_ret = PySequence_Fast_GET_SIZE(seq);
+	addresses = malloc_array(*count_ret ? *count_ret : 1,
+				 sizeof(*addresses));
+	if (!addresses) {
+		Py_DECREF(seq);
+		PyErr_NoMemory();
+		return NULL;
+	}
+	for (i = 0; i < *count_ret; i++) {
+		struct index_arg address = {};
+
+		if (!index_converter(PySequence_Fast_GET_ITEM(seq, i),
+				     &address)) {
+			free(addresses);
+			Py_DECREF(seq);
+			return NULL;
+		}
+		addresses[i] = address.uvalue;
+	}
+	Py_DECREF(seq);
+	return addresses;
+}
+
+static PyObject *Program_symbolize(Program *self, PyObject *arg)
+{
+	struct drgn_error *err;
+	uint64_t *addresses;
+	size_t count, *indices;
+	struct drgn_symbol **syms;
+	size_t num_syms, i;
+	PyObject *sym_objs = NULL, *ret = NULL;
+
+	addresses = symbolize_addresses(arg, &count);
+	if (!addresses)
+		return NULL;
+	indices = malloc_array(count ? count : 1, sizeof(*indices));
+	if (!indices) {
+		PyErr_NoMemory();
+		goto out_addresses;
+	}
+	err = drgn_program_symbolize(&self->prog, addresses, count, indices,
+				     &syms, &num_syms);
+	if (err) {
+		set_drgn_error(err);
+		goto out_indices;
+	}
+
+	/*
+	 * The symbols are interned, so this reuses any existing Symbols, and
+	 * the results share them.
+	 */
+	sym_objs = PyTuple_New(num_syms);
+	if (!sym_objs)
+		goto out_syms;
+	for (i = 0; i < num_syms; i++) {
+		PyObject *sym_obj;
+
+		sym_obj = Symbol_wrap_interned(syms[i], self);
+		if (!sym_obj)
+			goto out_syms;
+		PyTuple_SET_ITEM(sym_objs, i, sym_obj);
+	}
+
+	ret = PyList_New(count);
+	if (!ret)
+		goto out_syms;
+	for (i = 0; i < count; i++) {
+		PyObject *item;
+
+		if (indices[i] == SIZE_MAX)
+			item = Py_None;
+		else
+			item = PyTuple_GET_ITEM(sym_objs, indices[i]);
+		Py_INCREF(item);
+		PyList_SET_ITEM(ret, i, item);
+	}
+
+out_syms:
+	Py_XDECREF(sym_objs);
+	free(syms);
+out_indices:
+	free(indices);
+out_addresses:
+	free(addresses);
+	return ret;
+}
+
+static PyObject *Program_source_lines(Program *self, PyObject *arg)
+{
+	struct drgn_error *err;
+	uint64_t *addresses;
+	struct drgn_source_location *locs;
+	size_t count, i;
+	const char *prev_filename = NULL;
+	PyObject *prev_filename_obj = NULL, *ret = NULL;
+
+	addresses = symbolize_addresses(arg, &count);
+	if (!addresses)
+		return NULL;
+	locs = malloc_array(count ? count : 1, sizeof(*locs));
+	if (!locs) {
+		PyErr_NoMemory();
+		goto out_addresses;
+	}
+	err = drgn_program_source_lines(&self->prog, addresses, count, locs);
+	if (err) {
+		set_drgn_error(err);
+		goto out_locs;
+	}
+
+	ret = PyList_New(count);
+	if (!ret)
+		goto out_locs;
+	for (i = 0; i < count; i++) {
+		PyObject *item;
+
+		if (!locs[i].filename) {
+			Py_INCREF(Py_None);
+			PyList_SET_ITEM(ret, i, Py_None);
+			continue;
+		}
+		/* Nearby addresses usually share a file name. */
+		if (locs[i].filename != prev_filename) {
+			Py_XDECREF(prev_filename_obj);
+			prev_filename_obj = PyUnicode_FromString(locs[i].filename);
+			if (!prev_filename_obj) {
+				Py_CLEAR(ret);
+				goto out_locs;
+			}
+			prev_filename = locs[i].filename;
+		}
+		item = Py_BuildValue("Oii", prev_filename_obj, locs[i].line,
+				     locs[i].column);
+		if (!item) {
+			Py_CLEAR(ret);
+			goto out_locs;
+		}
+		PyList_SET_ITEM(ret, i, item);
+	}
+
+out_locs:
+	Py_XDECREF(prev_filename_obj);
+	free(locs);
+out_addresses:
+	free(addresses);
+	return ret;
+}
+
 static DrgnObject *Program_subscript(Program *self, PyObject *key)
 {
 	struct drgn_error *err;
@@ -857,6 +2909,47 @@ static int Program_contains(Program *self, PyObject *key)
 	return 1;
 }
 
+static PyObject *Program_get_pickle_id(Program *self, void *arg)
+{
+	if (Program_assign_pickle_id(self) == -1)
+		return NULL;
+	return PyLong_FromUnsignedLongLong(self->pickle_id);
+}
+
+static int Program_set_pickle_id(Program *self, PyObject *value, void *arg)
+{
+	unsigned long long pickle_id;
+
+	if (!value) {
+		PyErr_SetString(PyExc_AttributeError,
+				"can't delete pickle_id attribute");
+		return -1;
+	}
+	if (!PyLong_Check(value)) {
+		PyErr_SetString(PyExc_TypeError, "pickle_id must be int");
+		return -1;
+	}
+	pickle_id = PyLong_AsUnsignedLongLong(value);
+	if (pickle_id == (unsigned long long)-1 && PyErr_Occurred())
+		return -1;
+	return Program_set_pickle_id_impl(self, pickle_id);
+}
+
+static PyObject *Program_reduce(Program *self)
+{
+	PyObject *func, *ret;
+
+	if (Program_assign_pickle_id(self) == -1)
+		return NULL;
+	func = drgnpy_unpickle_func("_unpickle_program");
+	if (!func)
+		return NULL;
+	ret = Py_BuildValue("O(K)", func,
+			    (unsigned long long)self->pickle_id);
+	Py_DECREF(func);
+	return ret;
+}
+
 static PyObject *Program_get_flags(Program *self, void *arg)
 {
 	return PyObject_CallFunction(ProgramFlags_class, "k",
@@ -879,7 +2972,340 @@ static PyObject *Program_get_language(Program *self, void *arg)
 	return Language_wrap(drgn_program_language(&self->prog));
 }
 
+static PyObject *Program_get_memory_cache_size(Program *self, void *arg)
+{
+	return PyLong_FromUnsignedLongLong(drgn_program_memory_cache_size(&self->prog));
+}
+
+static int Program_set_memory_cache_size(Program *self, PyObject *value,
+					 void *arg)
+{
+	unsigned long long size;
+
+	if (!value) {
+		PyErr_SetString(PyExc_AttributeError,
+				"can't delete memory_cache_size attribute");
+		return -1;
+	}
+	size = PyLong_AsUnsignedLongLong(value);
+	if (size == (unsigned long long)-1 && PyErr_Occurred())
+		return -1;
+	drgn_program_set_memory_cache_size(&self->prog, size);
+	return 0;
+}
+
+static PyObject *Program_get_frame_pointer_unwinding(Program *self, void *arg)
+{
+	return PyBool_FromLong(drgn_program_frame_pointer_unwinding(&self->prog));
+}
+
+static int Program_set_frame_pointer_unwinding(Program *self, PyObject *value,
+					       void *arg)
+{
+	int enabled;
+
+	if (!value) {
+		PyErr_SetString(PyExc_AttributeError,
+				"can't delete frame_pointer_unwinding attribute");
+		return -1;
+	}
+	enabled = PyObject_IsTrue(value);
+	if (enabled < 0)
+		return -1;
+	drgn_program_set_frame_pointer_unwinding(&self->prog, enabled);
+	return 0;
+}
+
+static PyObject *Program_get_epoch(Program *self, void *arg)
+{
+	return PyLong_FromUnsignedLongLong(drgn_program_epoch(&self->prog));
+}
+
+static PyObject *Program_get_epoch_interval(Program *self, void *arg)
+{
+	uint64_t interval_ns = drgn_program_epoch_interval(&self->prog);
+
+	if (!interval_ns)
+		Py_RETURN_NONE;
+	return PyFloat_FromDouble(interval_ns / 1e9);
+}
+
+static int Program_set_epoch_interval(Program *self, PyObject *value,
+				      void *arg)
+{
+	double interval;
+
+	if (!value) {
+		PyErr_SetString(PyExc_AttributeError,
+				"can't delete epoch_interval attribute");
+		return -1;
+	}
+	if (value == Py_None) {
+		drgn_program_set_epoch_interval(&self->prog, 0);
+		return 0;
+	}
+	interval = PyFloat_AsDouble(value);
+	if (interval == -1.0 && PyErr_Occurred())
+		return -1;
+	if (!(interval > 0.0 && interval < 1e10)) {
+		PyErr_SetString(PyExc_ValueError,
+				"epoch_interval must be positive or None");
+		return -1;
+	}
+	drgn_program_set_epoch_interval(&self->prog,
+					max((uint64_t)(interval * 1e9),
+					    (uint64_t)1));
+	return 0;
+}
+
+static PyObject *Program_get_read_limit(Program *self, void *arg)
+{
+	uint64_t limits[2];
+
+	drgn_program_read_limit(&self->prog, &limits[0], &limits[1]);
+	if (!limits[(uintptr_t)arg])
+		Py_RETURN_NONE;
+	return PyLong_FromUnsignedLongLong(limits[(uintptr_t)arg]);
+}
+
+/* arg is 0 for max_read_bytes_per_second or 1 for max_reads_per_second. */
+static int Program_set_read_limit(Program *self, PyObject *value, void *arg)
+{
+	static const char * const names[] = {
+		"max_read_bytes_per_second", "max_reads_per_second",
+	};
+	uint64_t limits[2];
+	unsigned long long limit;
+
+	if (!value) {
+		PyErr_Format(PyExc_AttributeError, "can't delete %s attribute",
+			     names[(uintptr_t)arg]);
+		return -1;
+	}
+	if (value == Py_None) {
+		limit = 0;
+	} else {
+		limit = PyLong_AsUnsignedLongLong(value);
+		if (limit == (unsigned long long)-1 && PyErr_Occurred())
+			return -1;
+		if (!limit) {
+			PyErr_Format(PyExc_ValueError,
+				     "%s must be positive or None",
+				     names[(uintptr_t)arg]);
+			return -1;
+		}
+	}
+	drgn_program_read_limit(&self->prog, &limits[0], &limits[1]);
+	limits[(uintptr_t)arg] = limit;
+	drgn_program_set_read_limit(&self->prog, limits[0], limits[1]);
+	return 0;
+}
+
+static PyObject *Program_get_profiling(Program *self, void *arg)
+{
+	return PyBool_FromLong(self->prog.profile.enabled);
+}
+
+static int Program_set_profiling(Program *self, PyObject *value, void *arg)
+{
+	int enabled;
+
+	if (!value) {
+		PyErr_SetString(PyExc_AttributeError,
+				"can't delete profiling attribute");
+		return -1;
+	}
+	enabled = PyObject_IsTrue(value);
+	if (enabled < 0)
+		return -1;
+	drgn_program_set_profiling(&self->prog, enabled);
+	return 0;
+}
+
+static PyObject *Program_profile_stats(Program *self)
+{
+	static const struct {
+		const char *name;
+		size_t offset;
+	} fields[] = {
+#define X(name) { #name, offsetof(struct drgn_profile_stats, name) }
+		X(type_finds),
+		X(member_lookups),
+		X(object_finds),
+		X(symbol_lookups),
+		X(dwarf_types),
+		X(objects),
+#undef X
+	};
+	struct drgn_profile_stats stats;
+	PyObject *dict;
+	size_t i;
+
+	drgn_program_profile_stats(&self->prog, &stats);
+	dict = PyDict_New();
+	if (!dict)
+		return NULL;
+	for (i = 0; i < ARRAY_SIZE(fields); i++) {
+		struct drgn_profile_counter *counter;
+		PyObject *value;
+		int ret;
+
+		counter = (struct drgn_profile_counter *)((char *)&stats +
+							  fields[i].offset);
+		value = Py_BuildValue("KK", (unsigned long long)counter->calls,
+				      (unsigned long long)counter->ns);
+		if (!value) {
+			Py_DECREF(dict);
+			return NULL;
+		}
+		ret = PyDict_SetItemString(dict, fields[i].name, value);
+		Py_DECREF(value);
+		if (ret == -1) {
+			Py_DECREF(dict);
+			return NULL;
+		}
+	}
+	return dict;
+}
+
+static PyObject *Program_stats(Program *self)
+{
+	static const struct {
+		const char *name;
+		size_t offset;
+	} fields[] = {
+#define X(name) { #name, offsetof(struct drgn_memory_stats, name) }
+		X(reads),
+		X(read_bytes),
+		X(read_ns),
+		X(cache_hits),
+		X(cache_misses),
+		X(cache_readaheads),
+		X(snapshot_hits),
+		X(file_syscalls),
+		X(file_bytes),
+		X(process_syscalls),
+		X(process_bytes),
+		X(process_map_faults),
+		X(process_map_refreshes),
+		X(process_file_bytes),
+		X(kdump_reads),
+		X(kdump_bytes),
+		X(kdump_ns),
+		X(translations),
+		X(translation_cache_hits),
+		X(pgtable_walks),
+		X(decompression_cache_hits),
+		X(decompressions),
+		X(decompressed_bytes),
+		X(remote_packets),
+		X(remote_bytes),
+		X(throttle_waits),
+		X(throttle_ns),
+		X(coalesced_reads),
+#undef X
+	};
+	struct drgn_memory_stats stats;
+	PyObject *dict;
+	size_t i;
+
+	drgn_program_memory_stats(&self->prog, &stats);
+	dict = PyDict_New();
+	if (!dict)
+		return NULL;
+	for (i = 0; i < ARRAY_SIZE(fields); i++) {
+		PyObject *value;
+		int ret;
+
+		value = PyLong_FromUnsignedLongLong(*(uint64_t *)((char *)&stats +
+								 fields[i].offset));
+		if (!value) {
+			Py_DECREF(dict);
+			return NULL;
+		}
+		ret = PyDict_SetItemString(dict, fields[i].name, value);
+		Py_DECREF(value);
+		if (ret == -1) {
+			Py_DECREF(dict);
+			return NULL;
+		}
+	}
+	return dict;
+}
+
+static PyObject *Program_memory_usage(Program *self)
+{
+	static const struct {
+		const char *name;
+		size_t offset;
+	} fields[] = {
+#define X(name) { #name, offsetof(struct drgn_memory_usage, name##_bytes) }
+		X(dwarf_index),
+		X(dwarf_types),
+		X(type_index),
+		X(symbols),
+		X(prstatus),
+		X(memory_segments),
+		X(memory_cache),
+#undef X
+	};
+	struct drgn_memory_usage usage;
+	unsigned long long total = 0;
+	PyObject *dict, *value;
+	size_t i;
+	int ret;
+
+	drgn_program_memory_usage(&self->prog, &usage);
+	dict = PyDict_New();
+	if (!dict)
+		return NULL;
+	for (i = 0; i < ARRAY_SIZE(fields); i++) {
+		uint64_t bytes = *(uint64_t *)((char *)&usage +
+					       fields[i].offset);
+
+		total += bytes;
+		value = PyLong_FromUnsignedLongLong(bytes);
+		if (!value)
+			goto err;
+		ret = PyDict_SetItemString(dict, fields[i].name, value);
+		Py_DECREF(value);
+		if (ret == -1)
+			goto err;
+	}
+	value = PyLong_FromUnsignedLongLong(total);
+	if (!value)
+		goto err;
+	ret = PyDict_SetItemString(dict, "total", value);
+	Py_DECREF(value);
+	if (ret == -1)
+		goto err;
+	return dict;
+
+err:
+	Py_DECREF(dict);
+	return NULL;
+}
+
+static PyObject *Program_reset_stats(Program *self)
+{
+	drgn_program_reset_memory_stats(&self->prog);
+	Py_RETURN_NONE;
+}
+
+static PyObject *Program_invalidate_memory_cache(Program *self)
+{
+	drgn_program_invalidate_memory_cache(&self->prog);
+	Py_RETURN_NONE;
+}
+
+static PyObject *Program_bump_epoch(Program *self)
+{
+	drgn_program_bump_epoch(&self->prog);
+	Py_RETURN_NONE;
+}
+
 static PyMethodDef Program_methods[] = {
+	{"__reduce__", (PyCFunction)Program_reduce, METH_NOARGS},
 	{"add_memory_segment", (PyCFunction)Program_add_memory_segment,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_add_memory_segment_DOC},
 	{"add_type_finder", (PyCFunction)Program_add_type_finder,
@@ -892,15 +3318,70 @@ static PyMethodDef Program_methods[] = {
 	 drgn_Program_set_kernel_DOC},
 	{"set_pid", (PyCFunction)Program_set_pid, METH_VARARGS | METH_KEYWORDS,
 	 drgn_Program_set_pid_DOC},
+	{"set_remote", (PyCFunction)Program_set_remote,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_set_remote_DOC},
+	{"set_memory_trace", (PyCFunction)Program_set_memory_trace,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_set_memory_trace_DOC},
+	{"record_memory", (PyCFunction)Program_record_memory,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_record_memory_DOC},
+	{"record_memory_range", (PyCFunction)Program_record_memory_range,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_record_memory_range_DOC},
+	{"stop_recording_memory", (PyCFunction)Program_stop_recording_memory,
+	 METH_NOARGS, drgn_Program_stop_recording_memory_DOC},
 	{"load_debug_info", (PyCFunction)Program_load_debug_info,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_load_debug_info_DOC},
 	{"load_default_debug_info",
 	 (PyCFunction)Program_load_default_debug_info, METH_NOARGS,
 	 drgn_Program_load_default_debug_info_DOC},
+	{"load_btf", (PyCFunction)Program_load_btf,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_load_btf_DOC},
+	{"wait_for_debug_info", (PyCFunction)Program_wait_for_debug_info,
+	 METH_NOARGS, drgn_Program_wait_for_debug_info_DOC},
+	{"debug_info_stats", (PyCFunction)Program_debug_info_stats,
+	 METH_NOARGS, drgn_Program_debug_info_stats_DOC},
+	{"set_debug_info_progress",
+	 (PyCFunction)Program_set_debug_info_progress,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_set_debug_info_progress_DOC},
+	{"share_debug_info", (PyCFunction)Program_share_debug_info, METH_O,
+	 drgn_Program_share_debug_info_DOC},
 	{"__getitem__", (PyCFunction)Program_subscript, METH_O | METH_COEXIST,
 	 drgn_Program___getitem___DOC},
-	{"read", (PyCFunction)Program_read, METH_VARARGS | METH_KEYWORDS,
-	 drgn_Program_read_DOC},
+	{"read", (PyCFunction)(void (*)(void))Program_read,
+	 DRGNPY_METH_FASTCALL, drgn_Program_read_DOC},
+	{"try_read", (PyCFunction)(void (*)(void))Program_try_read,
+	 DRGNPY_METH_FASTCALL, drgn_Program_try_read_DOC},
+	{"read_batch", (PyCFunction)Program_read_batch,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_read_batch_DOC},
+	{"read_into", (PyCFunction)Program_read_into,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_read_into_DOC},
+	{"read_view", (PyCFunction)Program_read_view,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_read_view_DOC},
+	{"prefetch", (PyCFunction)Program_prefetch,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_prefetch_DOC},
+	{"prefetch_many", (PyCFunction)Program_prefetch_many,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_prefetch_many_DOC},
+	{"search_memory", (PyCFunction)Program_search_memory,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_search_memory_DOC},
+	{"build_pointer_index", (PyCFunction)Program_build_pointer_index,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_build_pointer_index_DOC},
+	{"load_pointer_index", (PyCFunction)Program_load_pointer_index,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_load_pointer_index_DOC},
+	{"hash_memory", (PyCFunction)Program_hash_memory,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_hash_memory_DOC},
+	{"watch", (PyCFunction)Program_watch, METH_VARARGS | METH_KEYWORDS,
+	 drgn_Program_watch_DOC},
+	{"stats", (PyCFunction)Program_stats, METH_NOARGS,
+	 drgn_Program_stats_DOC},
+	{"reset_stats", (PyCFunction)Program_reset_stats, METH_NOARGS,
+	 drgn_Program_reset_stats_DOC},
+	{"profile_stats", (PyCFunction)Program_profile_stats, METH_NOARGS,
+	 drgn_Program_profile_stats_DOC},
+	{"memory_usage", (PyCFunction)Program_memory_usage, METH_NOARGS,
+	 drgn_Program_memory_usage_DOC},
+	{"invalidate_memory_cache", (PyCFunction)Program_invalidate_memory_cache,
+	 METH_NOARGS, drgn_Program_invalidate_memory_cache_DOC},
+	{"bump_epoch", (PyCFunction)Program_bump_epoch, METH_NOARGS,
+	 drgn_Program_bump_epoch_DOC},
 #define METHOD_DEF_READ(x)						\
 	{"read_"#x, (PyCFunction)Program_read_##x,			\
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_read_##x##_DOC}
@@ -909,23 +3390,50 @@ static PyMethodDef Program_methods[] = {
 	METHOD_DEF_READ(u32),
 	METHOD_DEF_READ(u64),
 	METHOD_DEF_READ(word),
-#undef METHOD_READ_U
-	{"type", (PyCFunction)Program_find_type, METH_VARARGS | METH_KEYWORDS,
-	 drgn_Program_type_DOC},
+#undef METHOD_DEF_READ
+#define METHOD_DEF_READ_ARRAY(x)					\
+	{"read_"#x"_array", (PyCFunction)Program_read_##x##_array,	\
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_read_##x##_array_DOC}
+	METHOD_DEF_READ_ARRAY(u8),
+	METHOD_DEF_READ_ARRAY(u16),
+	METHOD_DEF_READ_ARRAY(u32),
+	METHOD_DEF_READ_ARRAY(u64),
+	METHOD_DEF_READ_ARRAY(word),
+#undef METHOD_DEF_READ_ARRAY
+	{"type", (PyCFunction)(void (*)(void))Program_find_type,
+	 DRGNPY_METH_FASTCALL, drgn_Program_type_DOC},
 	{"pointer_type", (PyCFunction)Program_pointer_type,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_pointer_type_DOC},
+	{"member_path", (PyCFunction)Program_member_path,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_member_path_DOC},
+	{"read_field_array", (PyCFunction)Program_read_field_array,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_read_field_array_DOC},
+	{"enumerator", (PyCFunction)Program_enumerator,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_enumerator_DOC},
 	{"object", (PyCFunction)Program_object, METH_VARARGS | METH_KEYWORDS,
 	 drgn_Program_object_DOC},
+	{"names", (PyCFunction)Program_names, METH_VARARGS | METH_KEYWORDS,
+	 drgn_Program_names_DOC},
 	{"constant", (PyCFunction)Program_constant,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_constant_DOC},
 	{"function", (PyCFunction)Program_function,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_function_DOC},
 	{"variable", (PyCFunction)Program_variable,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_variable_DOC},
+	{"eval", (PyCFunction)Program_eval, METH_VARARGS | METH_KEYWORDS,
+	 drgn_Program_eval_DOC},
+	{"source_lines", (PyCFunction)Program_source_lines, METH_O,
+	 drgn_Program_source_lines_DOC},
 	{"stack_trace", (PyCFunction)Program_stack_trace,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_stack_trace_DOC},
+	{"stack_trace_groups", (PyCFunction)Program_stack_trace_groups,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_stack_trace_groups_DOC},
+	{"stack_traces", (PyCFunction)Program_stack_traces,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_stack_traces_DOC},
 	{"symbol", (PyCFunction)Program_symbol, METH_O,
 	 drgn_Program_symbol_DOC},
+	{"symbolize", (PyCFunction)Program_symbolize, METH_O,
+	 drgn_Program_symbolize_DOC},
 	{},
 };
 
@@ -937,10 +3445,28 @@ static PyMemberDef Program_members[] = {
 
 static PyGetSetDef Program_getset[] = {
 	{"flags", (getter)Program_get_flags, NULL, drgn_Program_flags_DOC},
+	{"pickle_id", (getter)Program_get_pickle_id,
+	 (setter)Program_set_pickle_id, drgn_Program_pickle_id_DOC},
 	{"platform", (getter)Program_get_platform, NULL,
 	 drgn_Program_platform_DOC},
 	{"language", (getter)Program_get_language, NULL,
 	 drgn_Program_language_DOC},
+	{"memory_cache_size", (getter)Program_get_memory_cache_size,
+	 (setter)Program_set_memory_cache_size, drgn_Program_memory_cache_size_DOC},
+	{"frame_pointer_unwinding", (getter)Program_get_frame_pointer_unwinding,
+	 (setter)Program_set_frame_pointer_unwinding,
+	 drgn_Program_frame_pointer_unwinding_DOC},
+	{"epoch", (getter)Program_get_epoch, NULL, drgn_Program_epoch_DOC},
+	{"epoch_interval", (getter)Program_get_epoch_interval,
+	 (setter)Program_set_epoch_interval, drgn_Program_epoch_interval_DOC},
+	{"max_read_bytes_per_second", (getter)Program_get_read_limit,
+	 (setter)Program_set_read_limit,
+	 drgn_Program_max_read_bytes_per_second_DOC, (void *)0},
+	{"max_reads_per_second", (getter)Program_get_read_limit,
+	 (setter)Program_set_read_limit, drgn_Program_max_reads_per_second_DOC,
+	 (void *)1},
+	{"profiling", (getter)Program_get_profiling,
+	 (setter)Program_set_profiling, drgn_Program_profiling_DOC},
 	{},
 };
 
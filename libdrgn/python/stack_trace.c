@@ -75,17 +75,23 @@ static PyObject *StackFrame_symbol(StackFrame *self)
 {
 	struct drgn_error *err;
 	struct drgn_symbol *sym;
-	PyObject *ret;
 
-	err = drgn_stack_frame_symbol(self->frame, &sym);
+	err = drgn_stack_frame_symbol_interned(self->frame, &sym);
 	if (err)
 		return set_drgn_error(err);
-	ret = Symbol_wrap(sym, self->trace->prog);
-	if (!ret) {
-		drgn_symbol_destroy(sym);
-		return NULL;
-	}
-	return ret;
+	return Symbol_wrap_interned(sym, self->trace->prog);
+}
+
+static PyObject *StackFrame_source(StackFrame *self)
+{
+	struct drgn_error *err;
+	const char *filename;
+	int line, column;
+
+	err = drgn_stack_frame_source(self->frame, &filename, &line, &column);
+	if (err)
+		return set_drgn_error(err);
+	return Py_BuildValue("sii", filename, line, column);
 }
 
 static PyObject *StackFrame_register(StackFrame *self, PyObject *arg)
@@ -162,6 +168,8 @@ static PyObject *StackFrame_get_pc(StackFrame *self, void *arg)
 static PyMethodDef StackFrame_methods[] = {
 	{"symbol", (PyCFunction)StackFrame_symbol, METH_NOARGS,
 	 drgn_StackFrame_symbol_DOC},
+	{"source", (PyCFunction)StackFrame_source, METH_NOARGS,
+	 drgn_StackFrame_source_DOC},
 	{"register", (PyCFunction)StackFrame_register,
 	 METH_O, drgn_StackFrame_register_DOC},
 	{"registers", (PyCFunction)StackFrame_registers,
@@ -3,6 +3,20 @@
 
 #include "drgnpy.h"
 
+DEFINE_HASH_TABLE_FUNCTIONS(symbol_wrapper_map, hash_pair_ptr_type,
+			    hash_table_scalar_eq)
+
+void Program_init_symbol_wrappers(Program *prog)
+{
+	symbol_wrapper_map_init(&prog->symbol_wrappers);
+}
+
+void Program_deinit_symbol_wrappers(Program *prog)
+{
+	/* Every Symbol references the Program, so this is empty by now. */
+	symbol_wrapper_map_deinit(&prog->symbol_wrappers);
+}
+
 PyObject *Symbol_wrap(struct drgn_symbol *sym, Program *prog)
 {
 	Symbol *ret;
@@ -16,9 +30,50 @@ PyObject *Symbol_wrap(struct drgn_symbol *sym, Program *prog)
 	return (PyObject *)ret;
 }
 
+/*
+ * Get the Symbol for an interned symbol, reusing the existing one if there is
+ * one. This doesn't take ownership of sym.
+ */
+PyObject *Symbol_wrap_interned(struct drgn_symbol *sym, Program *prog)
+{
+	struct symbol_wrapper_map_entry entry = { .key = sym };
+	struct symbol_wrapper_map_iterator it;
+	Symbol *ret;
+
+	it = symbol_wrapper_map_search(&prog->symbol_wrappers, &sym);
+	if (it.entry) {
+		Py_INCREF(it.entry->value);
+		return it.entry->value;
+	}
+	ret = (Symbol *)Symbol_wrap(sym, prog);
+	if (!ret)
+		return NULL;
+	ret->interned = true;
+	entry.value = (PyObject *)ret;
+	if (symbol_wrapper_map_insert(&prog->symbol_wrappers, &entry,
+				      NULL) == -1) {
+		/* Don't try to remove it from the map. */
+		ret->interned = false;
+		ret->sym = NULL;
+		Py_DECREF(ret);
+		return PyErr_NoMemory();
+	}
+	return (PyObject *)ret;
+}
+
 static void Symbol_dealloc(Symbol *self)
 {
-	drgn_symbol_destroy(self->sym);
+	if (self->interned) {
+		struct symbol_wrapper_map_iterator it;
+
+		it = symbol_wrapper_map_search(&self->prog->symbol_wrappers,
+					       &self->sym);
+		if (it.entry && it.entry->value == (PyObject *)self)
+			symbol_wrapper_map_delete_iterator(&self->prog->symbol_wrappers,
+							   it);
+	} else {
+		drgn_symbol_destroy(self->sym);
+	}
 	Py_XDECREF(self->prog);
 	Py_TYPE(self)->tp_free((PyObject *)self);
 }
@@ -91,3 +91,14 @@ DRGNPY_PUBLIC uint64_t drgn_test_deserialize_bits(const void *buf,
 {
 	return deserialize_bits(buf, bit_offset, bit_size, little_endian);
 }
+
+DRGNPY_PUBLIC void drgn_test_deserialize_bits_array(uint64_t *ret,
+						    const void *buf, size_t n,
+						    uint64_t bit_offset,
+						    uint64_t bit_stride,
+						    uint8_t bit_size,
+						    bool little_endian)
+{
+	return deserialize_bits_array(ret, buf, n, bit_offset, bit_stride,
+				      bit_size, little_endian);
+}
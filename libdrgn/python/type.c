@@ -26,8 +26,51 @@ static DrgnType *DrgnType_new(enum drgn_qualifiers qualifiers)
 	return type_obj;
 }
 
-DRGNPY_PUBLIC PyObject *DrgnType_wrap(struct drgn_qualified_type qualified_type,
-				      PyObject *parent)
+static struct hash_pair
+drgn_qualified_type_hash_pair(const struct drgn_qualified_type *key)
+{
+	return hash_pair_from_avalanching_hash(hash_combine((uintptr_t)key->type,
+							    key->qualifiers));
+}
+
+static bool drgn_qualified_type_eq_ptr(const struct drgn_qualified_type *a,
+				       const struct drgn_qualified_type *b)
+{
+	return a->type == b->type && a->qualifiers == b->qualifiers;
+}
+
+DEFINE_HASH_TABLE_FUNCTIONS(type_wrapper_map, drgn_qualified_type_hash_pair,
+			    drgn_qualified_type_eq_ptr)
+
+void Program_init_type_wrappers(Program *prog)
+{
+	type_wrapper_map_init(&prog->type_wrappers);
+}
+
+void Program_deinit_type_wrappers(Program *prog)
+{
+	/* Every interned Type references the Program, so this is empty. */
+	type_wrapper_map_deinit(&prog->type_wrappers);
+}
+
+/* Remove a Type from the wrapper map of its Program. */
+static void DrgnType_unintern(DrgnType *self)
+{
+	Program *prog = (Program *)self->parent;
+	struct drgn_qualified_type key = {
+		.type = self->type,
+		.qualifiers = self->qualifiers,
+	};
+	struct type_wrapper_map_iterator it;
+
+	it = type_wrapper_map_search(&prog->type_wrappers, &key);
+	if (it.entry && it.entry->value == (PyObject *)self)
+		type_wrapper_map_delete_iterator(&prog->type_wrappers, it);
+	self->interned = false;
+}
+
+static DrgnType *DrgnType_wrap_new(struct drgn_qualified_type qualified_type,
+				   PyObject *parent)
 {
 	DrgnType *type_obj;
 
@@ -45,6 +88,44 @@ DRGNPY_PUBLIC PyObject *DrgnType_wrap(struct drgn_qualified_type qualified_type,
 		Py_INCREF(parent);
 		type_obj->parent = parent;
 	}
+	return type_obj;
+}
+
+/*
+ * Types owned by a Program have one canonical wrapper for as long as it is
+ * alive, so repeatedly getting the same type (e.g., Object.type_ in a loop)
+ * reuses the wrapper and the attributes already cached in it.
+ */
+DRGNPY_PUBLIC PyObject *DrgnType_wrap(struct drgn_qualified_type qualified_type,
+				      PyObject *parent)
+{
+	struct type_wrapper_map_entry entry = { .key = qualified_type };
+	struct type_wrapper_map_iterator it;
+	Program *prog;
+	struct hash_pair hp;
+	DrgnType *type_obj;
+
+	if (!parent || !PyObject_TypeCheck(parent, &Program_type))
+		return (PyObject *)DrgnType_wrap_new(qualified_type, parent);
+
+	prog = (Program *)parent;
+	hp = type_wrapper_map_hash(&qualified_type);
+	it = type_wrapper_map_search_hashed(&prog->type_wrappers,
+					    &qualified_type, hp);
+	if (it.entry) {
+		Py_INCREF(it.entry->value);
+		return it.entry->value;
+	}
+	type_obj = DrgnType_wrap_new(qualified_type, parent);
+	if (!type_obj)
+		return NULL;
+	entry.value = (PyObject *)type_obj;
+	if (type_wrapper_map_insert_searched(&prog->type_wrappers, &entry, hp,
+					     NULL) == -1) {
+		Py_DECREF(type_obj);
+		return PyErr_NoMemory();
+	}
+	type_obj->interned = true;
 	return (PyObject *)type_obj;
 }
 
@@ -531,6 +612,8 @@ static int lazy_type_from_py(struct drgn_lazy_type *lazy_type, LazyType *obj)
 
 static void DrgnType_dealloc(DrgnType *self)
 {
+	if (self->interned)
+		DrgnType_unintern(self);
 	if (self->type != self->_type) {
 		Py_XDECREF(self->parent);
 	} else if (drgn_type_is_complete(self->type)) {
@@ -571,6 +654,8 @@ static int DrgnType_traverse(DrgnType *self, visitproc visit, void *arg)
 
 static int DrgnType_clear(DrgnType *self)
 {
+	if (self->interned)
+		DrgnType_unintern(self);
 	if (self->type != self->_type)
 		Py_CLEAR(self->parent);
 	Py_CLEAR(self->attr_cache);
@@ -740,16 +825,40 @@ out:
 	return ret;
 }
 
+/*
+ * Types from a Program are valid for as long as the Program is, so their
+ * formatted strings can be cached in its type index.
+ */
+static struct drgn_type_index *DrgnType_tindex(DrgnType *self)
+{
+	PyObject *parent = DrgnType_parent(self);
+
+	if (parent && PyObject_TypeCheck(parent, &Program_type))
+		return &((Program *)parent)->prog.tindex;
+	return NULL;
+}
+
 static PyObject *DrgnType_str(DrgnType *self)
 {
 	struct drgn_qualified_type qualified_type = {
 		.type = self->type,
 		.qualifiers = self->qualifiers,
 	};
+	struct drgn_type_index *tindex = DrgnType_tindex(self);
 	struct drgn_error *err;
 	PyObject *ret;
 	char *str;
 
+	if (tindex) {
+		const char *cached;
+
+		err = drgn_type_index_format_type(tindex, qualified_type,
+						  &cached);
+		if (err)
+			return set_drgn_error(err);
+		return PyUnicode_FromString(cached);
+	}
+
 	err = drgn_format_type(qualified_type, &str);
 	if (err)
 		return set_drgn_error(err);
@@ -765,10 +874,21 @@ static PyObject *DrgnType_type_name(DrgnType *self)
 		.type = self->type,
 		.qualifiers = self->qualifiers,
 	};
+	struct drgn_type_index *tindex = DrgnType_tindex(self);
 	struct drgn_error *err;
 	PyObject *ret;
 	char *str;
 
+	if (tindex) {
+		const char *cached;
+
+		err = drgn_type_index_format_type_name(tindex, qualified_type,
+						       &cached);
+		if (err)
+			return set_drgn_error(err);
+		return PyUnicode_FromString(cached);
+	}
+
 	err = drgn_format_type_name(qualified_type, &str);
 	if (err)
 		return set_drgn_error(err);
@@ -778,6 +898,58 @@ static PyObject *DrgnType_type_name(DrgnType *self)
 	return ret;
 }
 
+/*
+ * Types are pickled by name, since the same struct drgn_type isn't valid in
+ * another process (or even in a forked process, which may have parsed
+ * different types since the fork).
+ */
+static PyObject *DrgnType_reduce(DrgnType *self)
+{
+	struct drgn_qualified_type qualified_type = {
+		.type = self->type,
+		.qualifiers = self->qualifiers,
+	};
+	struct drgn_error *err;
+	PyObject *parent = DrgnType_parent(self);
+	PyObject *func, *ret;
+	char *name;
+
+	if (!PyObject_TypeCheck(parent, &Program_type)) {
+		PyErr_SetString(PyExc_TypeError,
+				"cannot pickle Type which isn't from a Program");
+		return NULL;
+	}
+	err = drgn_format_type_name(qualified_type, &name);
+	if (err)
+		return set_drgn_error(err);
+	if (strstr(name, "<anonymous>")) {
+		PyErr_Format(PyExc_TypeError,
+			     "cannot pickle anonymous type '%s'", name);
+		free(name);
+		return NULL;
+	}
+	func = drgnpy_unpickle_func("_unpickle_type");
+	if (func) {
+		ret = Py_BuildValue("O(Os)", func, parent, name);
+		Py_DECREF(func);
+	} else {
+		ret = NULL;
+	}
+	free(name);
+	return ret;
+}
+
+PyObject *drgnpy_unpickle_type(PyObject *self, PyObject *args)
+{
+	Program *prog;
+	PyObject *name;
+
+	if (!PyArg_ParseTuple(args, "O!U:_unpickle_type", &Program_type, &prog,
+			      &name))
+		return NULL;
+	return Program_unpickled_type(prog, name);
+}
+
 static PyObject *DrgnType_is_complete(DrgnType *self)
 {
 	return PyBool_FromLong(drgn_type_is_complete(self->type));
@@ -860,6 +1032,7 @@ static PyMethodDef DrgnType_methods[] = {
 	 METH_VARARGS | METH_KEYWORDS, drgn_Type_qualified_DOC},
 	{"unqualified", (PyCFunction)DrgnType_unqualified, METH_NOARGS,
 	 drgn_Type_unqualified_DOC},
+	{"__reduce__", (PyCFunction)DrgnType_reduce, METH_NOARGS},
 	{},
 };
 
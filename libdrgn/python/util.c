@@ -189,6 +189,157 @@ void path_cleanup(struct path_arg *path)
 	Py_CLEAR(path->cleanup);
 }
 
+static int drgnpy_arg_parser_init(struct drgnpy_arg_parser *parser)
+{
+	PyObject *interned[DRGNPY_ARG_PARSER_MAX_ARGS];
+	int i;
+
+	for (i = 0; parser->keywords[i]; i++) {
+		assert(i < DRGNPY_ARG_PARSER_MAX_ARGS);
+		interned[i] = PyUnicode_InternFromString(parser->keywords[i]);
+		if (!interned[i]) {
+			while (i--)
+				Py_DECREF(interned[i]);
+			return -1;
+		}
+	}
+	memcpy(parser->interned, interned, i * sizeof(interned[0]));
+	parser->num_keywords = i;
+	return 0;
+}
+
+static int drgnpy_keyword_index(struct drgnpy_arg_parser *parser,
+				PyObject *keyword)
+{
+	int i;
+
+	/* Keywords in calls are almost always interned. */
+	for (i = 0; i < parser->num_keywords; i++) {
+		if (parser->interned[i] == keyword)
+			return i;
+	}
+	if (!PyUnicode_Check(keyword))
+		return -1;
+	for (i = 0; i < parser->num_keywords; i++) {
+		if (PyUnicode_Compare(parser->interned[i], keyword) == 0)
+			return i;
+	}
+	return -1;
+}
+
+static int drgnpy_set_keyword_arg(struct drgnpy_arg_parser *parser,
+				  Py_ssize_t nargs, PyObject *keyword,
+				  PyObject *value, PyObject **ret)
+{
+	int i;
+
+	i = drgnpy_keyword_index(parser, keyword);
+	if (i < 0) {
+		PyErr_Format(PyExc_TypeError,
+			     "'%S' is an invalid keyword argument for %s()",
+			     keyword, parser->fname);
+		return -1;
+	}
+	if (ret[i]) {
+		if (i < nargs) {
+			PyErr_Format(PyExc_TypeError,
+				     "argument for %s() given by name ('%s') and position (%d)",
+				     parser->fname, parser->keywords[i], i + 1);
+		} else {
+			PyErr_Format(PyExc_TypeError,
+				     "%s() got multiple values for argument '%s'",
+				     parser->fname, parser->keywords[i]);
+		}
+		return -1;
+	}
+	ret[i] = value;
+	return 0;
+}
+
+int drgnpy_parse_args(struct drgnpy_arg_parser *parser, PyObject *const *args,
+		      Py_ssize_t nargs, PyObject *kwnames, PyObject *kwds,
+		      PyObject **ret)
+{
+	Py_ssize_t i;
+
+	if (!parser->num_keywords && drgnpy_arg_parser_init(parser) == -1)
+		return -1;
+	if (nargs > parser->max_positional) {
+		PyErr_Format(PyExc_TypeError,
+			     "%s() takes at most %d positional argument%s (%zd given)",
+			     parser->fname, parser->max_positional,
+			     parser->max_positional == 1 ? "" : "s", nargs);
+		return -1;
+	}
+	for (i = 0; i < parser->num_keywords; i++)
+		ret[i] = i < nargs ? args[i] : NULL;
+	if (kwnames) {
+		for (i = 0; i < PyTuple_GET_SIZE(kwnames); i++) {
+			if (drgnpy_set_keyword_arg(parser, nargs,
+						   PyTuple_GET_ITEM(kwnames, i),
+						   args[nargs + i], ret) == -1)
+				return -1;
+		}
+	} else if (kwds) {
+		PyObject *key, *value;
+		Py_ssize_t pos = 0;
+
+		while (PyDict_Next(kwds, &pos, &key, &value)) {
+			if (drgnpy_set_keyword_arg(parser, nargs, key, value,
+						   ret) == -1)
+				return -1;
+		}
+	}
+	for (i = 0; i < parser->min_args; i++) {
+		if (!ret[i]) {
+			PyErr_Format(PyExc_TypeError,
+				     "%s() missing required argument '%s' (pos %zd)",
+				     parser->fname, parser->keywords[i], i + 1);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+const char *drgnpy_str_arg(const struct drgnpy_arg_parser *parser, int i,
+			   PyObject *o)
+{
+	const char *s;
+	Py_ssize_t size;
+
+	if (!PyUnicode_Check(o)) {
+		PyErr_Format(PyExc_TypeError,
+			     "%s() argument '%s' must be str, not %s",
+			     parser->fname, parser->keywords[i],
+			     Py_TYPE(o)->tp_name);
+		return NULL;
+	}
+	s = PyUnicode_AsUTF8AndSize(o, &size);
+	if (!s)
+		return NULL;
+	if (strlen(s) != (size_t)size) {
+		PyErr_SetString(PyExc_ValueError, "embedded null character");
+		return NULL;
+	}
+	return s;
+}
+
+/*
+ * Get a function used to reconstruct pickled objects. It must be a module-level
+ * function so that pickle can find it by name.
+ */
+PyObject *drgnpy_unpickle_func(const char *name)
+{
+	PyObject *module, *ret;
+
+	module = PyImport_ImportModule("_drgn");
+	if (!module)
+		return NULL;
+	ret = PyObject_GetAttrString(module, name);
+	Py_DECREF(module);
+	return ret;
+}
+
 int enum_converter(PyObject *o, void *p)
 {
 	struct enum_arg *arg = p;
@@ -0,0 +1,111 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include "drgnpy.h"
+#include "../watch.h"
+
+PyObject *Watch_wrap(Program *prog, struct drgn_watch *watch,
+		     struct drgnpy_watch_item *items)
+{
+	Watch *ret;
+
+	ret = (Watch *)Watch_type.tp_alloc(&Watch_type, 0);
+	if (!ret) {
+		drgn_watch_destroy(watch);
+		free(items);
+		return NULL;
+	}
+	Py_INCREF(prog);
+	ret->prog = prog;
+	ret->watch = watch;
+	ret->items = items;
+	return (PyObject *)ret;
+}
+
+static void Watch_dealloc(Watch *self)
+{
+	if (self->watch)
+		drgn_watch_destroy(self->watch);
+	free(self->items);
+	Py_XDECREF(self->prog);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static Py_ssize_t Watch_length(Watch *self)
+{
+	return self->watch->num_items;
+}
+
+static PyObject *Watch_sample(Watch *self)
+{
+	struct drgn_error *err;
+	const size_t *changed;
+	size_t num_changed, i;
+	bool clear;
+	PyObject *ret;
+
+	clear = set_drgn_in_python();
+	Py_BEGIN_ALLOW_THREADS
+	err = drgn_watch_sample(self->watch, &changed, &num_changed);
+	Py_END_ALLOW_THREADS
+	if (clear)
+		clear_drgn_in_python();
+	if (err)
+		return set_drgn_error(err);
+
+	ret = PyList_New(num_changed);
+	if (!ret)
+		return NULL;
+	for (i = 0; i < num_changed; i++) {
+		struct drgnpy_watch_item *item = &self->items[changed[i]];
+		DrgnObject *obj;
+		PyObject *tuple;
+
+		obj = DrgnObject_alloc(self->prog);
+		if (!obj)
+			goto err;
+		err = drgn_object_set_buffer(&obj->obj, item->qualified_type,
+					     drgn_watch_data(self->watch,
+							     changed[i]),
+					     item->bit_offset,
+					     item->bit_field_size,
+					     item->little_endian ?
+					     DRGN_LITTLE_ENDIAN :
+					     DRGN_BIG_ENDIAN);
+		if (err) {
+			Py_DECREF(obj);
+			set_drgn_error(err);
+			goto err;
+		}
+		tuple = Py_BuildValue("nN", (Py_ssize_t)changed[i], obj);
+		if (!tuple)
+			goto err;
+		PyList_SET_ITEM(ret, i, tuple);
+	}
+	return ret;
+
+err:
+	Py_DECREF(ret);
+	return NULL;
+}
+
+static PyMethodDef Watch_methods[] = {
+	{"sample", (PyCFunction)Watch_sample, METH_NOARGS,
+	 drgn_Watch_sample_DOC},
+	{},
+};
+
+static PySequenceMethods Watch_as_sequence = {
+	.sq_length = (lenfunc)Watch_length,
+};
+
+PyTypeObject Watch_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "_drgn.Watch",
+	.tp_basicsize = sizeof(Watch),
+	.tp_dealloc = (destructor)Watch_dealloc,
+	.tp_as_sequence = &Watch_as_sequence,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = drgn_Watch_DOC,
+	.tp_methods = Watch_methods,
+};
@@ -0,0 +1,641 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <errno.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/vm_sockets.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "internal.h"
+#include "remote.h"
+
+/*
+ * Packet size to assume if the target doesn't tell us. GDB uses this as the
+ * minimum, too.
+ */
+#define DRGN_REMOTE_DEFAULT_PACKET_SIZE 400
+
+/* Don't let a target make us buffer arbitrarily large packets. */
+#define DRGN_REMOTE_MAX_PACKET_SIZE (UINT64_C(1) << 20)
+
+static struct drgn_error *drgn_remote_closed(void)
+{
+	return drgn_error_create(DRGN_ERROR_OTHER,
+				 "remote target closed the connection");
+}
+
+static struct drgn_error *drgn_remote_protocol_error(const char *what)
+{
+	return drgn_error_format(DRGN_ERROR_OTHER,
+				 "invalid response from remote target: %s",
+				 what);
+}
+
+static struct drgn_error *drgn_remote_send_all(struct drgn_remote *remote,
+					       const char *data, size_t len)
+{
+	while (len) {
+		ssize_t ret;
+
+		ret = send(remote->fd, data, len, MSG_NOSIGNAL);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			return drgn_error_create_os("send", errno, NULL);
+		}
+		data += ret;
+		len -= ret;
+	}
+	return NULL;
+}
+
+/* Frame and send a packet. */
+static struct drgn_error *drgn_remote_send(struct drgn_remote *remote,
+					   const char *payload)
+{
+	char buf[128];
+	size_t len = strlen(payload), i;
+	unsigned int checksum = 0;
+
+	if (len + 4 > sizeof(buf))
+		return drgn_error_create(DRGN_ERROR_OTHER, "packet is too long");
+	buf[0] = '$';
+	for (i = 0; i < len; i++) {
+		buf[i + 1] = payload[i];
+		checksum += (unsigned char)payload[i];
+	}
+	snprintf(&buf[len + 1], 4, "#%02x", checksum & 0xff);
+	return drgn_remote_send_all(remote, buf, len + 4);
+}
+
+/* Get the next received byte, reading more from the socket if necessary. */
+static struct drgn_error *drgn_remote_getc(struct drgn_remote *remote,
+					   char *ret)
+{
+	if (remote->buf_pos == remote->buf_len) {
+		ssize_t sret;
+
+		for (;;) {
+			sret = recv(remote->fd, remote->buf,
+				    remote->buf_capacity, 0);
+			if (sret == -1) {
+				if (errno == EINTR)
+					continue;
+				return drgn_error_create_os("recv", errno,
+							    NULL);
+			}
+			break;
+		}
+		if (sret == 0)
+			return drgn_remote_closed();
+		remote->buf_pos = 0;
+		remote->buf_len = sret;
+	}
+	*ret = remote->buf[remote->buf_pos++];
+	return NULL;
+}
+
+static struct drgn_error *drgn_remote_packet_append(struct drgn_remote *remote,
+						    char c, size_t n)
+{
+	if (remote->packet_len + n > DRGN_REMOTE_MAX_PACKET_SIZE)
+		return drgn_remote_protocol_error("packet is too long");
+	if (remote->packet_len + n > remote->packet_capacity) {
+		size_t capacity = max(remote->packet_capacity * 2,
+				      remote->packet_len + n);
+		char *packet = realloc(remote->packet, capacity);
+
+		if (!packet)
+			return &drgn_enomem;
+		remote->packet = packet;
+		remote->packet_capacity = capacity;
+	}
+	memset(&remote->packet[remote->packet_len], c, n);
+	remote->packet_len += n;
+	return NULL;
+}
+
+static int hex_digit_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	else if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	else if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	else
+		return -1;
+}
+
+/*
+ * Receive the next packet into remote->packet, undoing escaping and run-length
+ * encoding. Acknowledgments and notifications before it are skipped.
+ */
+static struct drgn_error *drgn_remote_recv(struct drgn_remote *remote)
+{
+	struct drgn_error *err;
+	unsigned int checksum = 0;
+	char c, sum[2];
+	int hi, lo, i;
+
+	do {
+		err = drgn_remote_getc(remote, &c);
+		if (err)
+			return err;
+		if (c == '%') {
+			/* Skip asynchronous notifications. */
+			do {
+				err = drgn_remote_getc(remote, &c);
+				if (err)
+					return err;
+			} while (c != '#');
+			for (i = 0; i < 2; i++) {
+				err = drgn_remote_getc(remote, &c);
+				if (err)
+					return err;
+			}
+			c = 0;
+		}
+	} while (c != '$');
+
+	remote->packet_len = 0;
+	for (;;) {
+		err = drgn_remote_getc(remote, &c);
+		if (err)
+			return err;
+		if (c == '#')
+			break;
+		checksum += (unsigned char)c;
+		if (c == '}') {
+			err = drgn_remote_getc(remote, &c);
+			if (err)
+				return err;
+			checksum += (unsigned char)c;
+			c ^= 0x20;
+		} else if (c == '*') {
+			/* Run-length encoding of the previous character. */
+			char n;
+
+			err = drgn_remote_getc(remote, &n);
+			if (err)
+				return err;
+			checksum += (unsigned char)n;
+			if (!remote->packet_len || (unsigned char)n < 29)
+				return drgn_remote_protocol_error("invalid run length");
+			err = drgn_remote_packet_append(remote,
+							remote->packet[remote->packet_len - 1],
+							(unsigned char)n - 29);
+			if (err)
+				return err;
+			continue;
+		}
+		err = drgn_remote_packet_append(remote, c, 1);
+		if (err)
+			return err;
+	}
+	for (i = 0; i < 2; i++) {
+		err = drgn_remote_getc(remote, &sum[i]);
+		if (err)
+			return err;
+	}
+	hi = hex_digit_value(sum[0]);
+	lo = hex_digit_value(sum[1]);
+	if (remote->ack) {
+		if (hi < 0 || lo < 0 ||
+		    (unsigned int)(hi << 4 | lo) != (checksum & 0xff)) {
+			/*
+			 * We never pipeline in acknowledgment mode, so the
+			 * target can just send it again.
+			 */
+			err = drgn_remote_send_all(remote, "-", 1);
+			if (err)
+				return err;
+			return drgn_remote_recv(remote);
+		}
+		return drgn_remote_send_all(remote, "+", 1);
+	}
+	return NULL;
+}
+
+/* Send a packet and receive the response. */
+static struct drgn_error *drgn_remote_command(struct drgn_remote *remote,
+					      const char *payload)
+{
+	struct drgn_error *err;
+
+	err = drgn_remote_send(remote, payload);
+	if (err)
+		return err;
+	return drgn_remote_recv(remote);
+}
+
+static bool drgn_remote_response_is(struct drgn_remote *remote,
+				    const char *s)
+{
+	size_t len = strlen(s);
+
+	return remote->packet_len == len && memcmp(remote->packet, s, len) == 0;
+}
+
+/* Negotiate the packet size and no-acknowledgment mode. */
+static struct drgn_error *drgn_remote_handshake(struct drgn_remote *remote)
+{
+	struct drgn_error *err;
+	uint64_t packet_size = DRGN_REMOTE_DEFAULT_PACKET_SIZE;
+	bool no_ack = false;
+	size_t pos = 0;
+
+	/* Acknowledge anything that the target sent before we connected. */
+	err = drgn_remote_send_all(remote, "+", 1);
+	if (err)
+		return err;
+	err = drgn_remote_command(remote, "qSupported");
+	if (err)
+		return err;
+	while (pos < remote->packet_len) {
+		const char *feature = &remote->packet[pos];
+		size_t len = remote->packet_len - pos;
+		const char *semicolon = memchr(feature, ';', len);
+
+		if (semicolon)
+			len = semicolon - feature;
+		if (len > 11 && memcmp(feature, "PacketSize=", 11) == 0) {
+			uint64_t value = 0;
+			size_t i;
+
+			for (i = 11; i < len && i < 27; i++) {
+				int digit = hex_digit_value(feature[i]);
+
+				if (digit < 0)
+					break;
+				value = value << 4 | digit;
+			}
+			if (value >= 32)
+				packet_size = value;
+		} else if (len == 16 &&
+			   memcmp(feature, "QStartNoAckMode+", 16) == 0) {
+			no_ack = true;
+		}
+		pos += len + 1;
+	}
+	/*
+	 * Each byte of a response is two hex digits, plus four bytes of
+	 * framing.
+	 */
+	packet_size = min(packet_size, DRGN_REMOTE_MAX_PACKET_SIZE);
+	remote->max_read = (packet_size - 4) / 2;
+
+	if (no_ack) {
+		err = drgn_remote_command(remote, "QStartNoAckMode");
+		if (err)
+			return err;
+		if (drgn_remote_response_is(remote, "OK"))
+			remote->ack = false;
+	}
+	return NULL;
+}
+
+static struct drgn_error *drgn_remote_open_socket(const char *address,
+						  int *ret)
+{
+	struct drgn_error *err;
+	int fd;
+
+	if (strncmp(address, "vsock:", 6) == 0) {
+		struct sockaddr_vm addr = {
+			.svm_family = AF_VSOCK,
+		};
+		unsigned int cid, port;
+		int n;
+
+		if (sscanf(address + 6, "%u:%u%n", &cid, &port, &n) != 2 ||
+		    address[6 + n]) {
+			return drgn_error_format(DRGN_ERROR_INVALID_ARGUMENT,
+						 "invalid vsock address: %s",
+						 address);
+		}
+		addr.svm_cid = cid;
+		addr.svm_port = port;
+		fd = socket(AF_VSOCK, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd == -1)
+			return drgn_error_create_os("socket", errno, NULL);
+		if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+			err = drgn_error_create_os("connect", errno, NULL);
+			close(fd);
+			return err;
+		}
+	} else {
+		struct addrinfo hints = {
+			.ai_socktype = SOCK_STREAM,
+		};
+		struct addrinfo *res, *ai;
+		char *host, *port;
+		int ret_errno = 0, gai_ret, one = 1;
+
+		/* Split HOST:PORT or [HOST]:PORT. */
+		if (address[0] == '[') {
+			const char *end = strchr(address, ']');
+
+			if (!end || end[1] != ':')
+				goto invalid;
+			host = strndup(address + 1, end - address - 1);
+			port = (char *)end + 2;
+		} else {
+			const char *colon = strrchr(address, ':');
+
+			if (!colon)
+				goto invalid;
+			host = strndup(address, colon - address);
+			port = (char *)colon + 1;
+		}
+		if (!host)
+			return &drgn_enomem;
+		if (!*port) {
+			free(host);
+			goto invalid;
+		}
+		gai_ret = getaddrinfo(host, port, &hints, &res);
+		free(host);
+		if (gai_ret) {
+			return drgn_error_format(DRGN_ERROR_OTHER,
+						 "could not resolve %s: %s",
+						 address,
+						 gai_strerror(gai_ret));
+		}
+		fd = -1;
+		for (ai = res; ai; ai = ai->ai_next) {
+			fd = socket(ai->ai_family,
+				    ai->ai_socktype | SOCK_CLOEXEC,
+				    ai->ai_protocol);
+			if (fd == -1) {
+				ret_errno = errno;
+				continue;
+			}
+			if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+				break;
+			ret_errno = errno;
+			close(fd);
+			fd = -1;
+		}
+		freeaddrinfo(res);
+		if (fd == -1)
+			return drgn_error_create_os("connect", ret_errno, NULL);
+		/* Requests are small, so don't let Nagle hold them back. */
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+	*ret = fd;
+	return NULL;
+
+invalid:
+	return drgn_error_format(DRGN_ERROR_INVALID_ARGUMENT,
+				 "invalid remote address: %s; expected HOST:PORT or vsock:CID:PORT",
+				 address);
+}
+
+struct drgn_error *drgn_remote_connect(const char *address,
+				       struct drgn_memory_stats *stats,
+				       struct drgn_remote **ret)
+{
+	struct drgn_error *err;
+	struct drgn_remote *remote;
+
+	remote = calloc(1, sizeof(*remote));
+	if (!remote)
+		return &drgn_enomem;
+	remote->fd = -1;
+	remote->ack = true;
+	remote->stats = stats;
+	remote->buf_capacity = 64 * 1024;
+	remote->buf = malloc(remote->buf_capacity);
+	if (!remote->buf) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	err = drgn_remote_open_socket(address, &remote->fd);
+	if (err)
+		goto err;
+	err = drgn_remote_handshake(remote);
+	if (err)
+		goto err;
+	*ret = remote;
+	return NULL;
+
+err:
+	drgn_remote_destroy(remote);
+	return err;
+}
+
+void drgn_remote_destroy(struct drgn_remote *remote)
+{
+	if (!remote)
+		return;
+	if (remote->fd != -1)
+		close(remote->fd);
+	free(remote->packet);
+	free(remote->buf);
+	free(remote);
+}
+
+/* One packet's worth of a read. */
+struct drgn_remote_read {
+	char *buf;
+	uint64_t address;
+	size_t count;
+	/* Index of the request that this is part of. */
+	size_t request;
+};
+
+/*
+ * Parse the response to an m packet. Returns whether the memory was read; an
+ * error response or a short read means that it wasn't.
+ */
+static struct drgn_error *
+drgn_remote_parse_read(struct drgn_remote *remote,
+		       const struct drgn_remote_read *read, bool *ret)
+{
+	size_t i;
+
+	if (remote->packet_len && remote->packet[0] == 'E') {
+		*ret = false;
+		return NULL;
+	}
+	if (remote->packet_len > 2 * read->count ||
+	    remote->packet_len % 2)
+		return drgn_remote_protocol_error("bad memory read response");
+	for (i = 0; i < remote->packet_len / 2; i++) {
+		int hi = hex_digit_value(remote->packet[2 * i]);
+		int lo = hex_digit_value(remote->packet[2 * i + 1]);
+
+		if (hi < 0 || lo < 0)
+			return drgn_remote_protocol_error("bad memory read response");
+		read->buf[i] = hi << 4 | lo;
+	}
+	remote->stats->remote_bytes += i;
+	/* Targets may return fewer bytes if the rest isn't readable. */
+	*ret = i == read->count;
+	return NULL;
+}
+
+/*
+ * Read a list of packet-sized reads with up to DRGN_REMOTE_MAX_OUTSTANDING
+ * requests in flight. ok is indexed by request; a request whose read fails is
+ * set to false. If fault_ret is not NULL, this stops sending at the first
+ * failure and returns it there.
+ */
+static struct drgn_error *
+drgn_remote_read_pipelined(struct drgn_remote *remote,
+			   const struct drgn_remote_read *reads,
+			   size_t num_reads, bool *ok,
+			   const struct drgn_remote_read **fault_ret)
+{
+	struct drgn_error *err;
+	size_t window = remote->ack ? 1 : DRGN_REMOTE_MAX_OUTSTANDING;
+	size_t sent = 0, received = 0;
+
+	while (received < num_reads) {
+		bool read_ok;
+
+		while (sent < num_reads && sent - received < window) {
+			char payload[64];
+
+			snprintf(payload, sizeof(payload), "m%" PRIx64 ",%zx",
+				 reads[sent].address, reads[sent].count);
+			err = drgn_remote_send(remote, payload);
+			if (err)
+				return err;
+			remote->stats->remote_packets++;
+			sent++;
+		}
+		err = drgn_remote_recv(remote);
+		if (err)
+			return err;
+		err = drgn_remote_parse_read(remote, &reads[received],
+					     &read_ok);
+		if (err)
+			return err;
+		if (!read_ok) {
+			ok[reads[received].request] = false;
+			if (fault_ret && !*fault_ret) {
+				/*
+				 * Stop sending, but drain the responses that
+				 * are still in flight.
+				 */
+				*fault_ret = &reads[received];
+				num_reads = sent;
+			}
+		}
+		received++;
+	}
+	return NULL;
+}
+
+/*
+ * Split requests into packet-sized reads. Returns the reads, which must be
+ * freed with free().
+ */
+static struct drgn_error *
+drgn_remote_split_reads(struct drgn_remote *remote,
+			struct drgn_memory_read_request *requests,
+			size_t num_requests, struct drgn_remote_read **ret,
+			size_t *num_ret)
+{
+	struct drgn_remote_read *reads;
+	size_t num_reads = 0, i;
+
+	for (i = 0; i < num_requests; i++) {
+		size_t n = (requests[i].count + remote->max_read - 1) /
+			   remote->max_read;
+
+		if (__builtin_add_overflow(num_reads, n, &num_reads))
+			return &drgn_enomem;
+	}
+	reads = malloc_array(num_reads, sizeof(*reads));
+	if (!reads && num_reads)
+		return &drgn_enomem;
+	num_reads = 0;
+	for (i = 0; i < num_requests; i++) {
+		char *buf = requests[i].buf;
+		uint64_t address = requests[i].address;
+		size_t count = requests[i].count;
+
+		while (count) {
+			size_t n = min(count, remote->max_read);
+
+			reads[num_reads].buf = buf;
+			reads[num_reads].address = address;
+			reads[num_reads].count = n;
+			reads[num_reads].request = i;
+			num_reads++;
+			buf += n;
+			address += n;
+			count -= n;
+		}
+	}
+	*ret = reads;
+	*num_ret = num_reads;
+	return NULL;
+}
+
+struct drgn_error *drgn_read_memory_remote(void *buf, uint64_t address,
+					   size_t count, uint64_t offset,
+					   void *arg, bool physical)
+{
+	struct drgn_error *err;
+	struct drgn_remote *remote = arg;
+	struct drgn_memory_read_request request = {
+		.buf = buf,
+		.address = address,
+		.count = count,
+		.physical = physical,
+	};
+	struct drgn_remote_read *reads;
+	size_t num_reads;
+	const struct drgn_remote_read *fault = NULL;
+	bool ok = true;
+
+	if (physical) {
+		return drgn_error_create_fault("remote target does not support physical addresses",
+					       address);
+	}
+	err = drgn_remote_split_reads(remote, &request, 1, &reads, &num_reads);
+	if (err)
+		return err;
+	err = drgn_remote_read_pipelined(remote, reads, num_reads, &ok, &fault);
+	if (!err && fault)
+		err = drgn_error_create_fault("could not read memory",
+					      fault->address);
+	free(reads);
+	return err;
+}
+
+struct drgn_error *
+drgn_read_memory_remote_many(struct drgn_memory_read_request *requests,
+			     size_t num_requests, bool *ok, void *arg)
+{
+	struct drgn_error *err;
+	struct drgn_remote *remote = arg;
+	struct drgn_remote_read *reads;
+	size_t num_reads, i, j;
+
+	for (i = 0; i < num_requests; i++)
+		ok[i] = !requests[i].physical;
+	err = drgn_remote_split_reads(remote, requests, num_requests, &reads,
+				      &num_reads);
+	if (err)
+		return err;
+	/* Physical requests can't be read; leave them out. */
+	for (i = j = 0; i < num_reads; i++) {
+		if (!requests[reads[i].request].physical)
+			reads[j++] = reads[i];
+	}
+	err = drgn_remote_read_pipelined(remote, reads, j, ok, NULL);
+	free(reads);
+	return err;
+}
@@ -0,0 +1,107 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Reading memory from a remote target.
+ *
+ * See @ref RemoteMemory.
+ */
+
+#ifndef DRGN_REMOTE_H
+#define DRGN_REMOTE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "drgn.h"
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup RemoteMemory Remote memory
+ *
+ * Reading memory from a remote target.
+ *
+ * A @ref drgn_remote talks to a target over TCP or vsock with the GDB remote
+ * serial protocol, which is spoken by gdbserver, the GDB stubs of QEMU and
+ * other hypervisors, and small purpose-built agents (which only need to
+ * implement the @c qSupported, @c QStartNoAckMode, and @c m packets).
+ *
+ * Because every request costs a round trip, reads are split into packets
+ * which are pipelined: up to @ref DRGN_REMOTE_MAX_OUTSTANDING requests are
+ * sent before waiting for the first response. This requires the target to
+ * support no-acknowledgment mode; otherwise, requests are sent one at a time.
+ * Batches of reads are coalesced by @ref drgn_memory_reader_read_batch() and
+ * pipelined together with @ref drgn_read_memory_remote_many().
+ *
+ * @{
+ */
+
+/** Maximum number of requests in flight to a @ref drgn_remote. */
+#define DRGN_REMOTE_MAX_OUTSTANDING 64
+
+/** Connection to a remote target. */
+struct drgn_remote {
+	/** Socket. */
+	int fd;
+	/** Whether the target acknowledges packets. */
+	bool ack;
+	/** Maximum number of bytes to request in one packet. */
+	size_t max_read;
+	/** Received data that hasn't been parsed yet. */
+	char *buf;
+	/** Position of the next unparsed byte in @ref buf. */
+	size_t buf_pos;
+	/** Number of valid bytes in @ref buf. */
+	size_t buf_len;
+	/** Allocated size of @ref buf. */
+	size_t buf_capacity;
+	/** Payload of the last received packet, decoded. */
+	char *packet;
+	/** Size of @ref packet. */
+	size_t packet_len;
+	/** Allocated size of @ref packet. */
+	size_t packet_capacity;
+	/** Statistics to update. */
+	struct drgn_memory_stats *stats;
+};
+
+/**
+ * Connect to a remote target.
+ *
+ * @param[in] address @c HOST:PORT for TCP (with the host in brackets if it is
+ * an IPv6 address) or <tt>vsock:CID:PORT</tt> for vsock.
+ * @param[in] stats Statistics to update.
+ * @param[out] ret Returned connection, which must be destroyed with @ref
+ * drgn_remote_destroy().
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *drgn_remote_connect(const char *address,
+				       struct drgn_memory_stats *stats,
+				       struct drgn_remote **ret);
+
+/** Close a @ref drgn_remote. */
+void drgn_remote_destroy(struct drgn_remote *remote);
+
+/**
+ * @ref drgn_memory_read_fn which reads from a @ref drgn_remote. The argument
+ * is the @ref drgn_remote. Physical addresses are not supported.
+ */
+struct drgn_error *drgn_read_memory_remote(void *buf, uint64_t address,
+					   size_t count, uint64_t offset,
+					   void *arg, bool physical);
+
+/**
+ * @ref drgn_memory_read_many_fn which reads from a @ref drgn_remote. All of
+ * the requests are pipelined.
+ */
+struct drgn_error *
+drgn_read_memory_remote_many(struct drgn_memory_read_request *requests,
+			     size_t num_requests, bool *ok, void *arg);
+
+/** @} */
+
+#endif /* DRGN_REMOTE_H */
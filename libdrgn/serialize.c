@@ -8,8 +8,8 @@
 #include "internal.h"
 #include "serialize.h"
 
-void serialize_bits(void *buf, uint64_t bit_offset, uint64_t uvalue,
-		    uint8_t bit_size, bool little_endian)
+void serialize_bits_generic(void *buf, uint64_t bit_offset, uint64_t uvalue,
+			    uint8_t bit_size, bool little_endian)
 {
 	uint8_t *p;
 	size_t bits, size;
@@ -61,8 +61,8 @@ void serialize_bits(void *buf, uint64_t bit_offset, uint64_t uvalue,
 	}
 }
 
-uint64_t deserialize_bits(const void *buf, uint64_t bit_offset,
-			  uint8_t bit_size, bool little_endian)
+uint64_t deserialize_bits_generic(const void *buf, uint64_t bit_offset,
+				  uint8_t bit_size, bool little_endian)
 {
 	const uint8_t *p;
 	size_t bits, size;
@@ -94,3 +94,70 @@ uint64_t deserialize_bits(const void *buf, uint64_t bit_offset,
 	}
 	return truncate_unsigned(ret, bit_size);
 }
+
+#define DESERIALIZE_ARRAY(bits)						\
+static void deserialize_array##bits(uint64_t *ret, const char *p, size_t n,	\
+				    size_t stride, bool little_endian)	\
+{									\
+	uint##bits##_t tmp;						\
+	size_t i;							\
+									\
+	if (little_endian) {						\
+		for (i = 0; i < n; i++, p += stride) {			\
+			memcpy(&tmp, p, sizeof(tmp));			\
+			ret[i] = le##bits##toh(tmp);			\
+		}							\
+	} else {							\
+		for (i = 0; i < n; i++, p += stride) {			\
+			memcpy(&tmp, p, sizeof(tmp));			\
+			ret[i] = be##bits##toh(tmp);			\
+		}							\
+	}								\
+}
+
+/* There is no le8toh() or be8toh(). */
+#define le8toh(x) (x)
+#define be8toh(x) (x)
+DESERIALIZE_ARRAY(8)
+#undef be8toh
+#undef le8toh
+DESERIALIZE_ARRAY(16)
+DESERIALIZE_ARRAY(32)
+DESERIALIZE_ARRAY(64)
+#undef DESERIALIZE_ARRAY
+
+void deserialize_bits_array(uint64_t *ret, const void *buf, size_t n,
+			    uint64_t bit_offset, uint64_t bit_stride,
+			    uint8_t bit_size, bool little_endian)
+{
+	const char *p = (const char *)buf + bit_offset / 8;
+	size_t i;
+
+	if (bit_offset % 8 == 0 && bit_stride % 8 == 0) {
+		switch (bit_size) {
+		case 8:
+			deserialize_array8(ret, p, n, bit_stride / 8,
+					   little_endian);
+			return;
+		case 16:
+			deserialize_array16(ret, p, n, bit_stride / 8,
+					    little_endian);
+			return;
+		case 32:
+			deserialize_array32(ret, p, n, bit_stride / 8,
+					    little_endian);
+			return;
+		case 64:
+			deserialize_array64(ret, p, n, bit_stride / 8,
+					    little_endian);
+			return;
+		default:
+			break;
+		}
+	}
+	for (i = 0; i < n; i++) {
+		ret[i] = deserialize_bits_generic(buf,
+						  bit_offset + i * bit_stride,
+						  bit_size, little_endian);
+	}
+}
@@ -12,8 +12,11 @@
 #ifndef DRGN_SERIALIZE_H
 #define DRGN_SERIALIZE_H
 
+#include <endian.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 /**
  * @ingroup Internals
@@ -71,8 +74,9 @@ static inline uint64_t truncate_unsigned(uint64_t uvalue, uint64_t bit_size)
  * @param[in] little_endian Whether the bits should be written out in
  * little-endian order.
  */
-void serialize_bits(void *buf, uint64_t bit_offset, uint64_t uvalue,
-		    uint8_t bit_size, bool little_endian);
+static inline void serialize_bits(void *buf, uint64_t bit_offset,
+				  uint64_t uvalue, uint8_t bit_size,
+				  bool little_endian);
 
 /**
  * Deserialize bits from a memory buffer.
@@ -89,8 +93,135 @@ void serialize_bits(void *buf, uint64_t bit_offset, uint64_t uvalue,
  * little-endian order.
  * @return The read bits in host order.
  */
-uint64_t deserialize_bits(const void *buf, uint64_t bit_offset,
-			  uint8_t bit_size, bool little_endian);
+static inline uint64_t deserialize_bits(const void *buf, uint64_t bit_offset,
+					uint8_t bit_size, bool little_endian);
+
+/**
+ * Deserialize an array of bit fields from a memory buffer.
+ *
+ * Element @c i is read from <tt>bit_offset + i * bit_stride</tt> bits into @p
+ * buf as if by @ref deserialize_bits(). Byte-aligned 8, 16, 32, and 64-bit
+ * elements are decoded by a specialized loop.
+ *
+ * @param[out] ret Returned values. This must have room for @p n values.
+ * @param[in] buf Memory buffer to read from.
+ * @param[in] n Number of elements to read.
+ * @param[in] bit_offset Offset in bits from the beginning of @p buf to the
+ * first element.
+ * @param[in] bit_stride Distance in bits between consecutive elements.
+ * @param[in] bit_size Number of bits in each element. This must be greater than
+ * zero and no more than 64.
+ * @param[in] little_endian Whether the bits should be interpreted in
+ * little-endian order.
+ */
+void deserialize_bits_array(uint64_t *ret, const void *buf, size_t n,
+			    uint64_t bit_offset, uint64_t bit_stride,
+			    uint8_t bit_size, bool little_endian);
+
+/**
+ * Serialize bits to a memory buffer without any fast paths.
+ *
+ * This handles any bit offset and size. It is only exposed for @ref
+ * serialize_bits(); call that instead.
+ */
+void serialize_bits_generic(void *buf, uint64_t bit_offset, uint64_t uvalue,
+			    uint8_t bit_size, bool little_endian);
+
+/**
+ * Deserialize bits from a memory buffer without any fast paths.
+ *
+ * This handles any bit offset and size. It is only exposed for @ref
+ * deserialize_bits(); call that instead.
+ */
+uint64_t deserialize_bits_generic(const void *buf, uint64_t bit_offset,
+				  uint8_t bit_size, bool little_endian);
+
+/*
+ * Almost every field is byte-aligned and 1, 2, 4, or 8 bytes wide, so handle
+ * those with a single load or store (and a byte swap if the byte order doesn't
+ * match the host) before falling back to the general case.
+ */
+static inline void serialize_bits(void *buf, uint64_t bit_offset,
+				  uint64_t uvalue, uint8_t bit_size,
+				  bool little_endian)
+{
+	char *p = (char *)buf + bit_offset / 8;
+
+	if (bit_offset % 8 == 0) {
+		switch (bit_size) {
+		case 8: {
+			uint8_t tmp = uvalue;
+
+			memcpy(p, &tmp, sizeof(tmp));
+			return;
+		}
+		case 16: {
+			uint16_t tmp = little_endian ? htole16(uvalue) :
+					htobe16(uvalue);
+
+			memcpy(p, &tmp, sizeof(tmp));
+			return;
+		}
+		case 32: {
+			uint32_t tmp = little_endian ? htole32(uvalue) :
+					htobe32(uvalue);
+
+			memcpy(p, &tmp, sizeof(tmp));
+			return;
+		}
+		case 64: {
+			uint64_t tmp = little_endian ? htole64(uvalue) :
+					htobe64(uvalue);
+
+			memcpy(p, &tmp, sizeof(tmp));
+			return;
+		}
+		default:
+			break;
+		}
+	}
+	serialize_bits_generic(buf, bit_offset, uvalue, bit_size,
+			       little_endian);
+}
+
+static inline uint64_t deserialize_bits(const void *buf, uint64_t bit_offset,
+					uint8_t bit_size, bool little_endian)
+{
+	const char *p = (const char *)buf + bit_offset / 8;
+
+	if (bit_offset % 8 == 0) {
+		switch (bit_size) {
+		case 8: {
+			uint8_t tmp;
+
+			memcpy(&tmp, p, sizeof(tmp));
+			return tmp;
+		}
+		case 16: {
+			uint16_t tmp;
+
+			memcpy(&tmp, p, sizeof(tmp));
+			return little_endian ? le16toh(tmp) : be16toh(tmp);
+		}
+		case 32: {
+			uint32_t tmp;
+
+			memcpy(&tmp, p, sizeof(tmp));
+			return little_endian ? le32toh(tmp) : be32toh(tmp);
+		}
+		case 64: {
+			uint64_t tmp;
+
+			memcpy(&tmp, p, sizeof(tmp));
+			return little_endian ? le64toh(tmp) : be64toh(tmp);
+		}
+		default:
+			break;
+		}
+	}
+	return deserialize_bits_generic(buf, bit_offset, bit_size,
+					little_endian);
+}
 
 /** @} */
 
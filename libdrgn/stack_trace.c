@@ -2,18 +2,33 @@
 // SPDX-License-Identifier: GPL-3.0+
 
 #include <byteswap.h>
+#include <dirent.h>
 #include <dwarf.h>
+#include <elf.h>
 #include <elfutils/libdwfl.h>
 #include <endian.h>
+#include <errno.h>
 #include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/procfs.h>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <sys/user.h>
+#include <sys/wait.h>
 
 #include "internal.h"
+#include "dwarf_index.h"
 #include "helpers.h"
+#include "linux_kernel.h"
+#include "orc.h"
 #include "program.h"
 #include "read.h"
 #include "string_builder.h"
 #include "symbol.h"
+#include "usdt.h"
+#include "vector.h"
 
 struct drgn_stack_trace {
 	struct drgn_program *prog;
@@ -21,6 +36,12 @@ struct drgn_stack_trace {
 		size_t capacity;
 		Dwfl_Thread *thread;
 	};
+	/*
+	 * Interned symbol of each frame, or NULL if it doesn't have one. This
+	 * is NULL until the trace is symbolized with
+	 * drgn_stack_trace_symbolize().
+	 */
+	struct drgn_symbol **symbols;
 	size_t num_frames;
 	Dwfl_Frame *frames[];
 };
@@ -28,9 +49,52 @@ struct drgn_stack_trace {
 LIBDRGN_PUBLIC void drgn_stack_trace_destroy(struct drgn_stack_trace *trace)
 {
 	dwfl_detach_thread(trace->thread);
+	free(trace->symbols);
 	free(trace);
 }
 
+/*
+ * Look up the symbols of every frame in a stack trace the first time one is
+ * needed. Frames only store program counters until then, and the lookups go
+ * through the program's cache, so formatting many traces of threads in the same
+ * functions only looks up each program counter once.
+ */
+static struct drgn_error *
+drgn_stack_trace_symbolize(struct drgn_stack_trace *trace)
+{
+	struct drgn_error *err;
+	struct drgn_symbol **symbols;
+	size_t i;
+
+	if (trace->symbols)
+		return NULL;
+	symbols = malloc_array(trace->num_frames ? trace->num_frames : 1,
+			       sizeof(*symbols));
+	if (!symbols)
+		return &drgn_enomem;
+	for (i = 0; i < trace->num_frames; i++) {
+		Dwarf_Addr pc;
+		bool isactivation;
+		Dwfl_Module *module;
+
+		dwfl_frame_pc(trace->frames[i], &pc, &isactivation);
+		module = dwfl_frame_module(trace->frames[i]);
+		if (!module) {
+			symbols[i] = NULL;
+			continue;
+		}
+		err = drgn_program_find_pc_symbol(trace->prog,
+						  pc - !isactivation, module,
+						  &symbols[i]);
+		if (err) {
+			free(symbols);
+			return err;
+		}
+	}
+	trace->symbols = symbols;
+	return NULL;
+}
+
 LIBDRGN_PUBLIC
 size_t drgn_stack_trace_num_frames(struct drgn_stack_trace *trace)
 {
@@ -44,28 +108,24 @@ drgn_format_stack_trace(struct drgn_stack_trace *trace, char **ret)
 	struct string_builder str = {};
 	struct drgn_stack_frame frame = { .trace = trace, };
 
+	err = drgn_stack_trace_symbolize(trace);
+	if (err)
+		return err;
 	for (; frame.i < trace->num_frames; frame.i++) {
 		Dwarf_Addr pc;
-		bool isactivation;
-		Dwfl_Module *module;
-		struct drgn_symbol sym;
+		struct drgn_symbol *sym = trace->symbols[frame.i];
 
 		if (!string_builder_appendf(&str, "#%-2zu ", frame.i)) {
 			err = &drgn_enomem;
 			goto err;
 		}
 
-		dwfl_frame_pc(trace->frames[frame.i], &pc, &isactivation);
-		module = dwfl_frame_module(trace->frames[frame.i]);
-		if (module &&
-		    drgn_program_find_symbol_by_address_internal(trace->prog,
-								 pc - !isactivation,
-								 module,
-								 &sym)) {
+		dwfl_frame_pc(trace->frames[frame.i], &pc, NULL);
+		if (sym) {
 			if (!string_builder_appendf(&str,
 						    "%s+0x%" PRIx64 "/0x%" PRIx64,
-						    sym.name, pc - sym.address,
-						    sym.size)) {
+						    sym->name, pc - sym->address,
+						    sym->size)) {
 				err = &drgn_enomem;
 				goto err;
 			}
@@ -101,32 +161,70 @@ LIBDRGN_PUBLIC uint64_t drgn_stack_frame_pc(struct drgn_stack_frame frame)
 	return pc;
 }
 
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_stack_frame_symbol_interned(struct drgn_stack_frame frame,
+				 struct drgn_symbol **ret)
+{
+	struct drgn_error *err;
+
+	err = drgn_stack_trace_symbolize(frame.trace);
+	if (err)
+		return err;
+	if (!frame.trace->symbols[frame.i]) {
+		Dwarf_Addr pc;
+		bool isactivation;
+
+		dwfl_frame_pc(frame.trace->frames[frame.i], &pc,
+			      &isactivation);
+		return drgn_error_symbol_not_found(pc - !isactivation);
+	}
+	*ret = frame.trace->symbols[frame.i];
+	return NULL;
+}
+
 LIBDRGN_PUBLIC struct drgn_error *
 drgn_stack_frame_symbol(struct drgn_stack_frame frame, struct drgn_symbol **ret)
 {
-	Dwarf_Addr pc;
-	bool isactivation;
-	Dwfl_Module *module;
-	struct drgn_symbol *sym;
+	struct drgn_error *err;
+	struct drgn_symbol *interned, *sym;
 
-	dwfl_frame_pc(frame.trace->frames[frame.i], &pc, &isactivation);
-	if (!isactivation)
-		pc--;
-	module = dwfl_frame_module(frame.trace->frames[frame.i]);
-	if (!module)
-		return drgn_error_symbol_not_found(pc);
+	err = drgn_stack_frame_symbol_interned(frame, &interned);
+	if (err)
+		return err;
 	sym = malloc(sizeof(*sym));
 	if (!sym)
 		return &drgn_enomem;
-	if (!drgn_program_find_symbol_by_address_internal(frame.trace->prog, pc,
-							  module, sym)) {
-		free(sym);
-		return drgn_error_symbol_not_found(pc);
-	}
+	*sym = *interned;
 	*ret = sym;
 	return NULL;
 }
 
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_stack_frame_source(struct drgn_stack_frame frame,
+			const char **filename_ret, int *line_ret,
+			int *column_ret)
+{
+	struct drgn_error *err;
+	Dwarf_Addr pc;
+	bool isactivation;
+	struct drgn_source_location loc;
+
+	dwfl_frame_pc(frame.trace->frames[frame.i], &pc, &isactivation);
+	pc -= !isactivation;
+	err = drgn_program_source_lines(frame.trace->prog, &pc, 1, &loc);
+	if (err)
+		return err;
+	if (!loc.filename) {
+		return drgn_error_format(DRGN_ERROR_LOOKUP,
+					 "source location not found for 0x%" PRIx64,
+					 pc);
+	}
+	*filename_ret = loc.filename;
+	*line_ret = loc.line;
+	*column_ret = loc.column;
+	return NULL;
+}
+
 LIBDRGN_PUBLIC struct drgn_error *
 drgn_stack_frame_register(struct drgn_stack_frame frame,
 			  enum drgn_register_number regno, uint64_t *ret)
@@ -156,6 +254,114 @@ drgn_stack_frame_register_by_name(struct drgn_stack_frame frame,
 	return drgn_stack_frame_register(frame, reg->number, ret);
 }
 
+/*
+ * Fill the unwinding buffer with the memory around an address: the whole stack
+ * if the address is on the stack of the thread being unwound, otherwise the
+ * page containing it. Returns &drgn_not_found if the memory can't be buffered.
+ */
+static struct drgn_error *drgn_stack_trace_fill_buf(struct drgn_program *prog,
+						    uint64_t address,
+						    size_t size)
+{
+	struct drgn_error *err;
+	uint64_t start, end;
+
+	if (prog->stack_trace_stack_end &&
+	    address >= prog->stack_trace_stack_start &&
+	    address + size <= prog->stack_trace_stack_end) {
+		start = prog->stack_trace_stack_start;
+		end = prog->stack_trace_stack_end;
+	} else {
+		start = address & ~(DRGN_MEMORY_CACHE_PAGE_SIZE - 1);
+		end = start + DRGN_MEMORY_CACHE_PAGE_SIZE;
+		if (address + size > end)
+			return &drgn_not_found;
+	}
+	if (end - start > prog->stack_trace_buf_capacity) {
+		char *buf;
+
+		buf = realloc(prog->stack_trace_buf, end - start);
+		if (!buf)
+			return &drgn_enomem;
+		prog->stack_trace_buf = buf;
+		prog->stack_trace_buf_capacity = end - start;
+	}
+	prog->stack_trace_buf_size = 0;
+	err = drgn_program_read_memory(prog, prog->stack_trace_buf, start,
+				       end - start, false);
+	if (err) {
+		if (err->code != DRGN_ERROR_FAULT)
+			return err;
+		drgn_error_destroy(err);
+		return &drgn_not_found;
+	}
+	prog->stack_trace_buf_address = start;
+	prog->stack_trace_buf_size = end - start;
+	return NULL;
+}
+
+/*
+ * Read a word while unwinding. The unwinder reads many words near each other,
+ * so rather than looking up the memory segment for every one, this reads the
+ * whole stack (or page) once per stack trace and serves reads from that.
+ */
+static struct drgn_error *
+drgn_stack_trace_read_word_impl(struct drgn_program *prog, uint64_t address,
+				uint64_t *ret)
+{
+	struct drgn_error *err;
+	size_t size;
+	const char *p;
+
+	if (!prog->has_platform)
+		return drgn_program_read_word(prog, address, false, ret);
+	size = drgn_program_is_64_bit(prog) ? 8 : 4;
+	if (address < prog->stack_trace_buf_address ||
+	    address - prog->stack_trace_buf_address + size >
+	    prog->stack_trace_buf_size) {
+		if (prog->stack_trace_snapshot)
+			return drgn_program_read_word(prog, address, false, ret);
+		err = drgn_stack_trace_fill_buf(prog, address, size);
+		if (err == &drgn_not_found)
+			return drgn_program_read_word(prog, address, false, ret);
+		else if (err)
+			return err;
+	}
+	p = prog->stack_trace_buf + (address - prog->stack_trace_buf_address);
+	if (size == 8) {
+		uint64_t tmp;
+
+		memcpy(&tmp, p, sizeof(tmp));
+		if (drgn_program_bswap(prog))
+			tmp = bswap_64(tmp);
+		*ret = tmp;
+	} else {
+		uint32_t tmp;
+
+		memcpy(&tmp, p, sizeof(tmp));
+		if (drgn_program_bswap(prog))
+			tmp = bswap_32(tmp);
+		*ret = tmp;
+	}
+	return NULL;
+}
+
+static struct drgn_error *drgn_stack_trace_read_word(struct drgn_program *prog,
+						     uint64_t address,
+						     uint64_t *ret)
+{
+	struct drgn_error *err;
+
+	/*
+	 * Every caller discards faults (which are common at the end of a
+	 * stack), so don't allocate them.
+	 */
+	drgn_quiet_faults_begin();
+	err = drgn_stack_trace_read_word_impl(prog, address, ret);
+	drgn_quiet_faults_end();
+	return err;
+}
+
 static bool drgn_thread_memory_read(Dwfl *dwfl, Dwarf_Addr addr,
 				    Dwarf_Word *result, void *dwfl_arg)
 {
@@ -163,7 +369,7 @@ static bool drgn_thread_memory_read(Dwfl *dwfl, Dwarf_Addr addr,
 	struct drgn_program *prog = dwfl_arg;
 	uint64_t word;
 
-	err = drgn_program_read_word(prog, addr, false, &word);
+	err = drgn_stack_trace_read_word(prog, addr, &word);
 	if (err) {
 		if (err->code == DRGN_ERROR_FAULT) {
 			/*
@@ -241,6 +447,154 @@ type_error:
 				 ", struct task_struct *" : "");
 }
 
+/*
+ * Get the bounds of a kernel task's stack for buffering stack reads and frame
+ * pointer unwinding. If they can't be determined, they are left unknown.
+ */
+static void drgn_thread_set_stack_bounds(struct drgn_program *prog,
+					 const struct drgn_object *task)
+{
+	struct drgn_error *err;
+	struct drgn_object tmp;
+	uint64_t stack, thread_size;
+
+	drgn_object_init(&tmp, prog);
+	err = drgn_object_member_dereference(&tmp, task, "stack");
+	if (!err)
+		err = drgn_object_read_unsigned(&tmp, &stack);
+	if (!err)
+		err = linux_kernel_get_thread_size(prog, &thread_size);
+	if (!err) {
+		prog->stack_trace_stack_start = stack;
+		prog->stack_trace_stack_end = stack + thread_size;
+	}
+	drgn_error_destroy(err);
+	drgn_object_deinit(&tmp);
+}
+
+/* Maximum size of the stack copied for each thread of a live process. */
+#define DRGN_LIVE_STACK_SNAPSHOT_SIZE (128 * 1024)
+/* Bytes below the stack pointer that a leaf function may use on x86-64. */
+#define DRGN_STACK_RED_ZONE 128
+
+/*
+ * Copy the top of a stopped thread's stack to the unwinding buffer. This reads
+ * up to DRGN_LIVE_STACK_SNAPSHOT_SIZE bytes, stopping at the first page that
+ * can't be read (i.e., the end of the stack).
+ */
+static struct drgn_error *drgn_snapshot_live_stack(struct drgn_program *prog,
+						   uint64_t sp)
+{
+	struct drgn_error *err;
+	uint64_t start;
+	size_t size;
+
+	if (prog->stack_trace_buf_capacity < DRGN_LIVE_STACK_SNAPSHOT_SIZE) {
+		char *buf;
+
+		buf = realloc(prog->stack_trace_buf,
+			      DRGN_LIVE_STACK_SNAPSHOT_SIZE);
+		if (!buf)
+			return &drgn_enomem;
+		prog->stack_trace_buf = buf;
+		prog->stack_trace_buf_capacity = DRGN_LIVE_STACK_SNAPSHOT_SIZE;
+	}
+	start = (sp - DRGN_STACK_RED_ZONE) & ~(DRGN_MEMORY_CACHE_PAGE_SIZE - 1);
+	err = drgn_program_read_memory(prog, prog->stack_trace_buf, start,
+				       DRGN_LIVE_STACK_SNAPSHOT_SIZE, false);
+	if (!err) {
+		size = DRGN_LIVE_STACK_SNAPSHOT_SIZE;
+	} else if (err->code == DRGN_ERROR_FAULT) {
+		/* The stack is smaller than that. Read what we can. */
+		drgn_error_destroy(err);
+		for (size = 0; size < DRGN_LIVE_STACK_SNAPSHOT_SIZE;
+		     size += DRGN_MEMORY_CACHE_PAGE_SIZE) {
+			err = drgn_program_read_memory(prog,
+						       prog->stack_trace_buf + size,
+						       start + size,
+						       DRGN_MEMORY_CACHE_PAGE_SIZE,
+						       false);
+			if (err) {
+				if (err->code != DRGN_ERROR_FAULT)
+					return err;
+				drgn_error_destroy(err);
+				break;
+			}
+		}
+	} else {
+		return err;
+	}
+	prog->stack_trace_buf_address = start;
+	prog->stack_trace_buf_size = size;
+	prog->stack_trace_snapshot = size > 0;
+	return NULL;
+}
+
+/*
+ * Get the registers of a thread of a live process, returned in the format of an
+ * NT_PRSTATUS note, and snapshot its stack.
+ *
+ * The thread is only stopped (with PTRACE_SEIZE and PTRACE_INTERRUPT, which
+ * unlike PTRACE_ATTACH don't send it a signal) for long enough to read its
+ * registers and copy its stack. It is released before it is unwound, so
+ * sampling a running process only stalls each thread very briefly.
+ */
+static struct drgn_error *drgn_snapshot_live_thread(struct drgn_program *prog,
+						    uint32_t tid,
+						    struct elf_prstatus *ret)
+{
+	struct drgn_error *err = NULL;
+	struct iovec iov = {
+		.iov_base = &ret->pr_reg,
+		.iov_len = sizeof(ret->pr_reg),
+	};
+	int status, sig = 0;
+
+	memset(ret, 0, sizeof(*ret));
+	ret->pr_pid = tid;
+	if (ptrace(PTRACE_SEIZE, tid, NULL, NULL) == -1) {
+		if (errno == ESRCH)
+			return drgn_error_create(DRGN_ERROR_LOOKUP,
+						 "thread not found");
+		return drgn_error_create_os("ptrace", errno, NULL);
+	}
+	if (ptrace(PTRACE_INTERRUPT, tid, NULL, NULL) == -1) {
+		err = drgn_error_create_os("ptrace", errno, NULL);
+		goto detach;
+	}
+	while (waitpid(tid, &status, __WALL) == -1) {
+		if (errno != EINTR) {
+			err = drgn_error_create_os("waitpid", errno, NULL);
+			goto detach;
+		}
+	}
+	if (!WIFSTOPPED(status)) {
+		/* The thread exited before it stopped. */
+		return drgn_error_create(DRGN_ERROR_LOOKUP, "thread not found");
+	}
+	/*
+	 * If a signal arrived first, the thread is in a signal-delivery-stop
+	 * instead, and the signal must be delivered when we detach.
+	 */
+	if (status >> 16 != PTRACE_EVENT_STOP)
+		sig = WSTOPSIG(status);
+	if (ptrace(PTRACE_GETREGSET, tid, (void *)(uintptr_t)NT_PRSTATUS,
+		   &iov) == -1) {
+		err = drgn_error_create_os("ptrace", errno, NULL);
+		goto detach;
+	}
+#ifdef __x86_64__
+	err = drgn_snapshot_live_stack(prog,
+				       ((struct user_regs_struct *)&ret->pr_reg)->rsp);
+#endif
+
+detach:
+	if (ptrace(PTRACE_DETACH, tid, NULL, (void *)(uintptr_t)sig) == -1 &&
+	    !err && errno != ESRCH)
+		err = drgn_error_create_os("ptrace", errno, NULL);
+	return err;
+}
+
 static bool drgn_thread_set_initial_registers(Dwfl_Thread *thread,
 					      void *thread_arg)
 {
@@ -249,9 +603,13 @@ static bool drgn_thread_set_initial_registers(Dwfl_Thread *thread,
 	struct drgn_object obj;
 	struct drgn_object tmp;
 	struct string prstatus;
+	struct elf_prstatus live_prstatus;
 
 	drgn_object_init(&obj, prog);
 	drgn_object_init(&tmp, prog);
+	prog->stack_trace_stack_start = prog->stack_trace_stack_end = 0;
+	prog->stack_trace_buf_size = 0;
+	prog->stack_trace_snapshot = false;
 
 	/* First, try pt_regs. */
 	if (prog->stack_trace_obj) {
@@ -295,6 +653,7 @@ static bool drgn_thread_set_initial_registers(Dwfl_Thread *thread,
 	}
 
 	if (prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL) {
+		drgn_thread_set_stack_bounds(prog, &obj);
 		if (prog->flags & DRGN_PROGRAM_IS_LIVE) {
 			err = drgn_object_member_dereference(&tmp, &obj, "on_cpu");
 			if (!err) {
@@ -383,6 +742,16 @@ static bool drgn_thread_set_initial_registers(Dwfl_Thread *thread,
 		err = prog->platform.arch->linux_kernel_set_initial_registers(thread,
 									      &obj);
 	} else {
+		if (prog->flags & DRGN_PROGRAM_IS_LIVE) {
+			err = drgn_snapshot_live_thread(prog,
+							prog->stack_trace_tid,
+							&live_prstatus);
+			if (err)
+				goto out;
+			prstatus.str = (char *)&live_prstatus;
+			prstatus.len = sizeof(live_prstatus);
+			goto prstatus;
+		}
 		err = drgn_program_find_prstatus_by_tid(prog,
 							prog->stack_trace_tid,
 							&prstatus);
@@ -442,12 +811,447 @@ static int drgn_append_stack_frame(Dwfl_Frame *state, void *arg)
 	return DWARF_CB_OK;
 }
 
+/* DWARF register numbers on x86-64. */
+enum {
+	X86_64_RAX, X86_64_RDX, X86_64_RCX, X86_64_RBX,
+	X86_64_RSI, X86_64_RDI, X86_64_RBP, X86_64_RSP,
+	X86_64_R8, X86_64_R9, X86_64_R10, X86_64_R11,
+	X86_64_R12, X86_64_R13, X86_64_R14, X86_64_R15,
+	X86_64_NUM_GPRS,
+};
+
+/* Offsets of the general-purpose registers in struct pt_regs on x86-64. */
+static const uint8_t x86_64_pt_regs_offsets[X86_64_NUM_GPRS] = {
+	[X86_64_R15] = 0, [X86_64_R14] = 8, [X86_64_R13] = 16,
+	[X86_64_R12] = 24, [X86_64_RBP] = 32, [X86_64_RBX] = 40,
+	[X86_64_R11] = 48, [X86_64_R10] = 56, [X86_64_R9] = 64,
+	[X86_64_R8] = 72, [X86_64_RAX] = 80, [X86_64_RCX] = 88,
+	[X86_64_RDX] = 96, [X86_64_RSI] = 104, [X86_64_RDI] = 112,
+};
+#define X86_64_PT_REGS_IP 128
+#define X86_64_PT_REGS_SP 152
+
+/* Get the ORC table of the module containing a program counter. */
+static struct drgn_error *
+drgn_program_find_orc_table(struct drgn_program *prog, Dwfl *dwfl,
+			    uint64_t pc, const struct drgn_orc_table **ret)
+{
+	struct drgn_error *err;
+	Dwfl_Module *module;
+	void **userdatap;
+	struct drgn_dwfl_module_userdata *userdata;
+
+	*ret = NULL;
+	module = dwfl_addrmodule(dwfl, pc);
+	if (!module)
+		return NULL;
+	dwfl_module_info(module, &userdatap, NULL, NULL, NULL, NULL, NULL,
+			 NULL);
+	userdata = *userdatap;
+	if (!userdata)
+		return NULL;
+	if (!userdata->orc_loaded) {
+		err = drgn_orc_table_create(module, prog->vmcoreinfo.osrelease,
+					    &userdata->orc);
+		if (err) {
+			if (err == &drgn_enomem)
+				return err;
+			/* Fall back to CFI for this module. */
+			drgn_error_destroy(err);
+		}
+		userdata->orc_loaded = true;
+	}
+	*ret = userdata->orc;
+	return NULL;
+}
+
+/*
+ * Read a word for the ORC or frame pointer unwinder. Faults mean that we should
+ * fall back to CFI, so they are returned as &drgn_not_found.
+ */
+static struct drgn_error *orc_read_word(struct drgn_program *prog,
+					uint64_t address, uint64_t *ret)
+{
+	struct drgn_error *err;
+
+	err = drgn_stack_trace_read_word(prog, address, ret);
+	if (err && err->code == DRGN_ERROR_FAULT) {
+		drgn_error_destroy(err);
+		return &drgn_not_found;
+	}
+	return err;
+}
+
+/* Get the register that an ORC rule refers to in the current frame. */
+static bool orc_get_reg(Dwfl_Frame *state, uint8_t reg, uint64_t *ret)
+{
+	static const int8_t regnos[] = {
+		[DRGN_ORC_REG_DX] = X86_64_RDX,
+		[DRGN_ORC_REG_DI] = X86_64_RDI,
+		[DRGN_ORC_REG_BP] = X86_64_RBP,
+		[DRGN_ORC_REG_SP] = X86_64_RSP,
+		[DRGN_ORC_REG_R10] = X86_64_R10,
+		[DRGN_ORC_REG_R13] = X86_64_R13,
+	};
+	Dwarf_Addr value;
+
+	/* None of these are RAX, so 0 means there is no such register. */
+	if (reg >= ARRAY_SIZE(regnos) || !regnos[reg] ||
+	    !dwfl_frame_register(state, regnos[reg], &value))
+		return false;
+	*ret = value;
+	return true;
+}
+
+/*
+ * Unwind a frame of an x86-64 Linux kernel stack with the kernel's ORC rules.
+ * This mirrors unwind_next_frame() in arch/x86/kernel/unwind_orc.c.
+ */
+static struct drgn_error *drgn_orc_unwind(struct drgn_program *prog,
+					  Dwfl_Frame *state,
+					  const struct drgn_orc_entry *orc)
+{
+	struct drgn_error *err;
+	uint64_t cfa, reg, ip, sp, bp;
+	bool have_bp;
+	size_t i;
+
+	if (orc->type == DRGN_ORC_TYPE_END_OF_STACK)
+		return NULL;
+	if (orc->type == DRGN_ORC_TYPE_UNDEFINED)
+		return &drgn_not_found;
+
+	switch (orc->sp_reg) {
+	case DRGN_ORC_REG_SP_INDIRECT:
+		if (!orc_get_reg(state, DRGN_ORC_REG_SP, &reg))
+			return &drgn_not_found;
+		err = orc_read_word(prog, reg, &cfa);
+		if (err)
+			return err;
+		cfa += orc->sp_offset;
+		break;
+	case DRGN_ORC_REG_BP_INDIRECT:
+		if (!orc_get_reg(state, DRGN_ORC_REG_BP, &reg))
+			return &drgn_not_found;
+		err = orc_read_word(prog, reg + orc->sp_offset, &cfa);
+		if (err)
+			return err;
+		break;
+	case DRGN_ORC_REG_SP:
+	case DRGN_ORC_REG_BP:
+		if (!orc_get_reg(state, orc->sp_reg, &cfa))
+			return &drgn_not_found;
+		cfa += orc->sp_offset;
+		break;
+	default:
+		if (!orc_get_reg(state, orc->sp_reg, &cfa))
+			return &drgn_not_found;
+		break;
+	}
+
+	have_bp = orc_get_reg(state, DRGN_ORC_REG_BP, &bp);
+	switch (orc->type) {
+	case DRGN_ORC_TYPE_CALL:
+		err = orc_read_word(prog, cfa - 8, &ip);
+		if (err)
+			return err;
+		sp = cfa;
+		break;
+	case DRGN_ORC_TYPE_REGS:
+		/* The CFA points to a full struct pt_regs. */
+		for (i = 0; i < X86_64_NUM_GPRS; i++) {
+			if (i == X86_64_RSP)
+				continue;
+			err = orc_read_word(prog, cfa + x86_64_pt_regs_offsets[i],
+					    &reg);
+			if (err)
+				return err;
+			dwfl_frame_unwound_register_set(state, i, reg);
+		}
+		err = orc_read_word(prog, cfa + X86_64_PT_REGS_IP, &ip);
+		if (!err)
+			err = orc_read_word(prog, cfa + X86_64_PT_REGS_SP, &sp);
+		if (err)
+			return err;
+		have_bp = false;
+		break;
+	case DRGN_ORC_TYPE_REGS_PARTIAL:
+		/*
+		 * The CFA points to the interrupt frame at the end of a struct
+		 * pt_regs; the other registers weren't saved.
+		 */
+		for (i = 0; i < X86_64_NUM_GPRS; i++) {
+			Dwarf_Addr value;
+
+			if (i != X86_64_RSP && i != X86_64_RBP &&
+			    dwfl_frame_register(state, i, &value))
+				dwfl_frame_unwound_register_set(state, i, value);
+		}
+		err = orc_read_word(prog, cfa, &ip);
+		if (!err)
+			err = orc_read_word(prog,
+					    cfa + X86_64_PT_REGS_SP - X86_64_PT_REGS_IP,
+					    &sp);
+		if (err)
+			return err;
+		break;
+	default:
+		return &drgn_not_found;
+	}
+
+	switch (orc->bp_reg) {
+	case DRGN_ORC_REG_UNDEFINED:
+		/* The frame pointer wasn't changed (or came from pt_regs). */
+		break;
+	case DRGN_ORC_REG_PREV_SP:
+		err = orc_read_word(prog, cfa + orc->bp_offset, &bp);
+		if (err)
+			return err;
+		have_bp = true;
+		break;
+	case DRGN_ORC_REG_BP:
+		if (!have_bp)
+			return &drgn_not_found;
+		err = orc_read_word(prog, bp + orc->bp_offset, &bp);
+		if (err)
+			return err;
+		break;
+	default:
+		return &drgn_not_found;
+	}
+	if (have_bp)
+		dwfl_frame_unwound_register_set(state, X86_64_RBP, bp);
+	dwfl_frame_unwound_register_set(state, X86_64_RSP, sp);
+	dwfl_frame_unwound_pc_set(state, ip,
+				  orc->signal ||
+				  orc->type != DRGN_ORC_TYPE_CALL);
+	return NULL;
+}
+
+/*
+ * Unwind a frame of an x86-64 stack by following the saved frame pointer. This
+ * assumes the standard frame layout where the frame pointer points to the
+ * caller's saved frame pointer, followed by the return address.
+ *
+ * @return @c NULL on success, &drgn_not_found if the chain looks broken and the
+ * frame should be unwound some other way.
+ */
+static struct drgn_error *drgn_frame_pointer_unwind(struct drgn_program *prog,
+						    Dwfl_Frame *state)
+{
+	struct drgn_error *err;
+	Dwarf_Addr bp, sp;
+	uint64_t ip, next_bp;
+
+	if (!dwfl_frame_register(state, X86_64_RBP, &bp) ||
+	    !dwfl_frame_register(state, X86_64_RSP, &sp))
+		return &drgn_not_found;
+	/* The frame pointer must be aligned and above the stack pointer. */
+	if (!bp || (bp & 7) || bp < sp)
+		return &drgn_not_found;
+	if (prog->stack_trace_stack_end &&
+	    (bp < prog->stack_trace_stack_start ||
+	     bp + 16 > prog->stack_trace_stack_end))
+		return &drgn_not_found;
+
+	err = orc_read_word(prog, bp, &next_bp);
+	if (!err)
+		err = orc_read_word(prog, bp + 8, &ip);
+	if (err)
+		return err;
+	/* The stack grows down, so the chain must move up. */
+	if (next_bp && next_bp <= bp)
+		return &drgn_not_found;
+	if (!ip)
+		return NULL;
+	dwfl_frame_unwound_register_set(state, X86_64_RBP, next_bp);
+	dwfl_frame_unwound_register_set(state, X86_64_RSP, bp + 16);
+	dwfl_frame_unwound_pc_set(state, ip, false);
+	return NULL;
+}
+
+/*
+ * Unwind a frame with cached DWARF CFI rules. This is equivalent to what
+ * libdwfl does with the CFI, but without finding and interpreting the FDE
+ * again.
+ */
+static struct drgn_error *drgn_cfi_unwind(struct drgn_program *prog,
+					  Dwfl_Frame *state,
+					  const struct drgn_cfi_rule *rule)
+{
+	struct drgn_error *err;
+	Dwarf_Addr cfa, value, ra = 0;
+	uint64_t word;
+	int i;
+
+	if (!dwfl_frame_register(state, rule->cfa_regno, &cfa))
+		return &drgn_not_found;
+	cfa += rule->cfa_offset;
+	for (i = 0; i < DRGN_CFI_RULE_MAX_REGS; i++) {
+		const struct drgn_cfi_reg_rule *reg = &rule->regs[i];
+
+		switch (reg->kind) {
+		case DRGN_CFI_REG_SAME_VALUE:
+			if (!dwfl_frame_register(state, i, &value))
+				continue;
+			break;
+		case DRGN_CFI_REG_AT_CFA_PLUS_OFFSET:
+			err = drgn_stack_trace_read_word(prog, cfa + reg->value,
+							 &word);
+			if (err) {
+				/* Like libdwfl, leave the register unknown. */
+				if (err->code != DRGN_ERROR_FAULT)
+					return err;
+				drgn_error_destroy(err);
+				continue;
+			}
+			value = word;
+			break;
+		case DRGN_CFI_REG_CFA_PLUS_OFFSET:
+			value = cfa + reg->value;
+			break;
+		case DRGN_CFI_REG_REGISTER:
+			if (!dwfl_frame_register(state, reg->value, &value))
+				continue;
+			break;
+		default:
+			continue;
+		}
+		dwfl_frame_unwound_register_set(state, i, value);
+		if (i == rule->ra_regno)
+			ra = value;
+	}
+	/* A zero return address means this is the outermost frame. */
+	if (ra)
+		dwfl_frame_unwound_pc_set(state, ra, rule->signal_frame);
+	return NULL;
+}
+
+/*
+ * How drgn_thread_unwind() unwound a frame, for the unwind_frame probe. 0 means
+ * that it was left to libdwfl, and -1 means that there was an error.
+ */
+enum {
+	DRGN_UNWIND_FRAME_POINTER = 1,
+	DRGN_UNWIND_ORC,
+	DRGN_UNWIND_CFI,
+};
+
+/*
+ * On x86-64, follow the frame pointer if frame pointer unwinding is enabled,
+ * then use ORC if this is a kernel and the module has an ORC table, then use
+ * cached DWARF CFI rules. Otherwise, libdwfl falls back to interpreting the CFI
+ * itself.
+ */
+static int drgn_thread_unwind(Dwfl_Frame *state, Dwarf_Addr pc,
+			      void *dwfl_arg)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = dwfl_arg;
+	Dwfl *dwfl = dwfl_thread_dwfl(dwfl_frame_thread(state));
+	const struct drgn_orc_table *table;
+	const struct drgn_orc_entry *orc;
+	const struct drgn_cfi_rule *rule;
+
+	if (prog->platform.arch->arch != DRGN_ARCH_X86_64)
+		goto fallback;
+	if (prog->frame_pointer_unwinding) {
+		err = drgn_frame_pointer_unwind(prog, state);
+		if (!err) {
+			DRGN_PROBE(unwind_frame, pc, DRGN_UNWIND_FRAME_POINTER);
+			return 1;
+		}
+		if (err != &drgn_not_found)
+			goto err;
+	}
+	if (prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL) {
+		err = drgn_program_find_orc_table(prog, dwfl, pc, &table);
+		if (err)
+			goto err;
+		orc = table ? drgn_orc_table_find(table, pc) : NULL;
+		if (orc) {
+			err = drgn_orc_unwind(prog, state, orc);
+			if (!err) {
+				DRGN_PROBE(unwind_frame, pc, DRGN_UNWIND_ORC);
+				return 1;
+			}
+			if (err != &drgn_not_found)
+				goto err;
+		}
+	}
+
+	err = drgn_program_find_cfi_rule(prog, dwfl, pc, &rule);
+	if (err)
+		goto err;
+	if (!rule || !rule->simple)
+		goto fallback;
+	err = drgn_cfi_unwind(prog, state, rule);
+	if (err == &drgn_not_found)
+		goto fallback;
+	if (err)
+		goto err;
+	DRGN_PROBE(unwind_frame, pc, DRGN_UNWIND_CFI);
+	return 1;
+
+fallback:
+	DRGN_PROBE(unwind_frame, pc, 0);
+	return 0;
+
+err:
+	DRGN_PROBE(unwind_frame, pc, -1);
+	drgn_error_destroy(prog->stack_trace_err);
+	prog->stack_trace_err = err;
+	return -1;
+}
+
 static const Dwfl_Thread_Callbacks drgn_linux_kernel_thread_callbacks = {
 	.next_thread = drgn_object_stack_trace_next_thread,
 	.memory_read = drgn_thread_memory_read,
 	.set_initial_registers = drgn_thread_set_initial_registers,
+	.unwind = drgn_thread_unwind,
 };
 
+/*
+ * Index any deferred debugging information containing the program counter of a
+ * frame in the trace which doesn't have a module.
+ */
+static struct drgn_error *
+drgn_stack_trace_load_deferred_debug_info(struct drgn_stack_trace *trace,
+					  bool *loaded_ret)
+{
+	struct drgn_error *err;
+	size_t i;
+
+	*loaded_ret = false;
+	for (i = 0; i < trace->num_frames; i++) {
+		Dwarf_Addr pc;
+		bool isactivation, loaded;
+
+		if (dwfl_frame_module(trace->frames[i]))
+			continue;
+		dwfl_frame_pc(trace->frames[i], &pc, &isactivation);
+		err = drgn_program_load_deferred_debug_info(trace->prog, false,
+							    pc - !isactivation,
+							    &loaded);
+		if (err)
+			return err;
+		if (loaded)
+			*loaded_ret = true;
+	}
+	return NULL;
+}
+
+/* Check whether we can unwind stacks for a program at all. */
+static struct drgn_error *
+drgn_program_check_stack_unwinding(struct drgn_program *prog)
+{
+	if (!prog->has_platform) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "cannot unwind stack without platform");
+	}
+	return NULL;
+}
+
 static struct drgn_error *drgn_get_stack_trace(struct drgn_program *prog,
 					       uint32_t tid,
 					       const struct drgn_object *obj,
@@ -457,17 +1261,11 @@ static struct drgn_error *drgn_get_stack_trace(struct drgn_program *prog,
 	Dwfl *dwfl;
 	Dwfl_Thread *thread;
 	struct drgn_stack_trace *trace;
+	bool loaded;
 
-	if (!prog->has_platform) {
-		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
-					 "cannot unwind stack without platform");
-	}
-	if ((prog->flags & (DRGN_PROGRAM_IS_LINUX_KERNEL |
-			    DRGN_PROGRAM_IS_LIVE)) == DRGN_PROGRAM_IS_LIVE) {
-		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
-					 "stack unwinding is not yet supported for live processes");
-	}
-
+	err = drgn_program_check_stack_unwinding(prog);
+	if (err)
+		return err;
 	err = drgn_program_get_dwfl(prog, &dwfl);
 	if (err)
 		return err;
@@ -479,6 +1277,7 @@ static struct drgn_error *drgn_get_stack_trace(struct drgn_program *prog,
 		prog->attached_dwfl_state = true;
 	}
 
+retry:
 	prog->stack_trace_tid = tid;
 	prog->stack_trace_obj = obj;
 	thread = dwfl_attach_thread(dwfl, STACK_TRACE_OBJ_TID);
@@ -498,6 +1297,7 @@ static struct drgn_error *drgn_get_stack_trace(struct drgn_program *prog,
 	}
 	trace->prog = prog;
 	trace->capacity = 1;
+	trace->symbols = NULL;
 	trace->num_frames = 0;
 
 	dwfl_thread_getframes(thread, drgn_append_stack_frame, &trace);
@@ -506,6 +1306,19 @@ static struct drgn_error *drgn_get_stack_trace(struct drgn_program *prog,
 		goto stack_trace_err;
 	}
 
+	/*
+	 * If we couldn't unwind through a frame because its debugging
+	 * information was deferred, index it and start over.
+	 */
+	err = drgn_stack_trace_load_deferred_debug_info(trace, &loaded);
+	if (err || loaded) {
+		free(trace);
+		if (err)
+			goto err;
+		dwfl_detach_thread(thread);
+		goto retry;
+	}
+
 	/* Shrink the trace to fit if we can, but don't fail if we can't. */
 	if (trace->capacity > trace->num_frames) {
 		struct drgn_stack_trace *tmp;
@@ -534,11 +1347,29 @@ err:
 	return err;
 }
 
+/*
+ * The unwinder keeps the thread being unwound in the program (stack_trace_obj,
+ * stack_trace_buf, etc.), so stack traces of a program are serialized like
+ * type lookups which need to parse new types.
+ */
+static struct drgn_error *
+drgn_get_stack_trace_locked(struct drgn_program *prog, uint32_t tid,
+			    const struct drgn_object *obj,
+			    struct drgn_stack_trace **ret)
+{
+	struct drgn_error *err;
+
+	drgn_type_index_lock(&prog->tindex);
+	err = drgn_get_stack_trace(prog, tid, obj, ret);
+	drgn_type_index_unlock(&prog->tindex);
+	return err;
+}
+
 LIBDRGN_PUBLIC struct drgn_error *
 drgn_program_stack_trace(struct drgn_program *prog, uint32_t tid,
 			 struct drgn_stack_trace **ret)
 {
-	return drgn_get_stack_trace(prog, tid, NULL, ret);
+	return drgn_get_stack_trace_locked(prog, tid, NULL, ret);
 }
 
 LIBDRGN_PUBLIC struct drgn_error *
@@ -553,8 +1384,355 @@ drgn_object_stack_trace(const struct drgn_object *obj,
 		err = drgn_object_read_integer(obj, &value);
 		if (err)
 			return err;
-		return drgn_get_stack_trace(obj->prog, value.uvalue, NULL, ret);
+		return drgn_get_stack_trace_locked(obj->prog, value.uvalue,
+						   NULL, ret);
+	} else {
+		return drgn_get_stack_trace_locked(obj->prog, 0, obj, ret);
+	}
+}
+
+DEFINE_VECTOR(drgn_thread_stack_trace_vector, struct drgn_thread_stack_trace)
+
+LIBDRGN_PUBLIC void
+drgn_thread_stack_traces_destroy(struct drgn_thread_stack_trace *traces,
+				 size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		if (traces[i].trace)
+			drgn_stack_trace_destroy(traces[i].trace);
+		drgn_error_destroy(traces[i].err);
+	}
+	free(traces);
+}
+
+/*
+ * Unwind one thread for drgn_program_stack_traces(), either by thread ID or from
+ * an already looked up task. Errors for the thread are saved in the entry; only
+ * running out of memory is returned.
+ */
+static struct drgn_error *
+drgn_append_thread_stack_trace(struct drgn_thread_stack_trace_vector *traces,
+			       struct drgn_program *prog, uint32_t tid,
+			       const struct drgn_object *task,
+			       struct drgn_error *err)
+{
+	struct drgn_thread_stack_trace *entry;
+
+	entry = drgn_thread_stack_trace_vector_append_entry(traces);
+	if (!entry) {
+		drgn_error_destroy(err);
+		return &drgn_enomem;
+	}
+	entry->tid = tid;
+	entry->trace = NULL;
+	if (!err)
+		err = drgn_get_stack_trace(prog, task ? 0 : tid, task,
+					   &entry->trace);
+	if (err) {
+		entry->trace = NULL;
+		if (err == &drgn_enomem)
+			return err;
+	}
+	entry->err = err;
+	return NULL;
+}
+
+static struct drgn_error *
+linux_kernel_stack_traces(struct drgn_program *prog, const uint32_t *tids,
+			  size_t count,
+			  struct drgn_thread_stack_trace_vector *traces)
+{
+	struct drgn_error *err;
+	struct drgn_object ns, task, tmp;
+	struct drgn_qualified_type task_type;
+	struct linux_helper_pid_iterator it;
+	size_t i;
+
+	drgn_object_init(&ns, prog);
+	drgn_object_init(&task, prog);
+	drgn_object_init(&tmp, prog);
+	/* Look up init_pid_ns once instead of once per thread. */
+	err = drgn_program_find_object(prog, "init_pid_ns", NULL,
+				       DRGN_FIND_OBJECT_ANY, &ns);
+	if (err)
+		goto out;
+	err = drgn_object_address_of(&ns, &ns);
+	if (err)
+		goto out;
+
+	if (tids) {
+		for (i = 0; i < count; i++) {
+			struct drgn_error *thread_err;
+			bool found;
+
+			thread_err = linux_helper_find_task(&task, &ns,
+							    tids[i]);
+			if (!thread_err)
+				thread_err = drgn_object_bool(&task, &found);
+			if (!thread_err && !found) {
+				thread_err = drgn_error_create(DRGN_ERROR_LOOKUP,
+							       "task not found");
+			}
+			err = drgn_append_thread_stack_trace(traces, prog,
+							     tids[i], &task,
+							     thread_err);
+			if (err)
+				goto out;
+		}
+		goto out;
+	}
+
+	err = drgn_program_find_type(prog, "struct task_struct *", NULL,
+				     &task_type);
+	if (err)
+		goto out;
+	err = linux_helper_pid_iterator_init(&it, &ns, true);
+	if (err)
+		goto out_it;
+	for (;;) {
+		uint64_t address;
+		union drgn_value pid;
+
+		err = linux_helper_pid_iterator_next(&it, &address);
+		if (err == &drgn_stop) {
+			err = NULL;
+			break;
+		} else if (err) {
+			break;
+		}
+		err = drgn_object_set_unsigned(&task, task_type, address, 0);
+		if (!err)
+			err = drgn_object_member_dereference(&tmp, &task, "pid");
+		if (!err)
+			err = drgn_object_read_integer(&tmp, &pid);
+		if (!err)
+			err = drgn_append_thread_stack_trace(traces, prog,
+							     pid.uvalue, &task,
+							     NULL);
+		if (err)
+			break;
+	}
+out_it:
+	linux_helper_pid_iterator_deinit(&it);
+out:
+	drgn_object_deinit(&tmp);
+	drgn_object_deinit(&task);
+	drgn_object_deinit(&ns);
+	return err;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_stack_traces(struct drgn_program *prog, const uint32_t *tids,
+			  size_t count, struct drgn_thread_stack_trace **ret,
+			  size_t *count_ret)
+{
+	struct drgn_error *err;
+	struct drgn_thread_stack_trace_vector traces = VECTOR_INIT;
+	uint32_t *all_tids = NULL;
+	size_t i;
+
+	err = drgn_program_check_stack_unwinding(prog);
+	if (err)
+		return err;
+
+	drgn_type_index_lock(&prog->tindex);
+	if (prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL) {
+		err = linux_kernel_stack_traces(prog, tids, count, &traces);
+		if (err)
+			goto err;
 	} else {
-		return drgn_get_stack_trace(obj->prog, 0, obj, ret);
+		if (!tids) {
+			if (prog->flags & DRGN_PROGRAM_IS_LIVE)
+				err = drgn_program_live_tids(prog, &all_tids,
+							     &count);
+			else
+				err = drgn_program_prstatus_tids(prog,
+								 &all_tids,
+								 &count);
+			if (err)
+				goto err;
+			tids = all_tids;
+		}
+		for (i = 0; i < count; i++) {
+			err = drgn_append_thread_stack_trace(&traces, prog,
+							     tids[i], NULL,
+							     NULL);
+			if (err)
+				goto err;
+		}
+		free(all_tids);
+	}
+	drgn_type_index_unlock(&prog->tindex);
+	drgn_thread_stack_trace_vector_shrink_to_fit(&traces);
+	*ret = traces.data;
+	*count_ret = traces.size;
+	return NULL;
+
+err:
+	drgn_type_index_unlock(&prog->tindex);
+	free(all_tids);
+	drgn_thread_stack_traces_destroy(traces.data, traces.size);
+	return err;
+}
+
+static struct hash_pair
+drgn_stack_trace_pcs_hash(struct drgn_stack_trace * const *key)
+{
+	size_t hash = 0, i;
+	Dwarf_Addr pc;
+
+	for (i = 0; i < (*key)->num_frames; i++) {
+		dwfl_frame_pc((*key)->frames[i], &pc, NULL);
+		hash = hash_combine(hash, pc);
+	}
+	return hash_pair_from_avalanching_hash(hash_combine(hash, i));
+}
+
+static bool drgn_stack_trace_pcs_eq(struct drgn_stack_trace * const *a,
+				    struct drgn_stack_trace * const *b)
+{
+	Dwarf_Addr a_pc, b_pc;
+	size_t i;
+
+	if ((*a)->num_frames != (*b)->num_frames)
+		return false;
+	for (i = 0; i < (*a)->num_frames; i++) {
+		dwfl_frame_pc((*a)->frames[i], &a_pc, NULL);
+		dwfl_frame_pc((*b)->frames[i], &b_pc, NULL);
+		if (a_pc != b_pc)
+			return false;
+	}
+	return true;
+}
+
+/* Map from a stack trace to the index of its group. */
+DEFINE_HASH_MAP(drgn_stack_trace_group_map, struct drgn_stack_trace *, size_t,
+		drgn_stack_trace_pcs_hash, drgn_stack_trace_pcs_eq)
+
+/*
+ * Groups are numbered in order of first appearance, so sorting by count and
+ * then by number keeps that order for ties.
+ */
+struct drgn_stack_trace_group_sort_entry {
+	size_t count;
+	size_t index;
+};
+
+static int drgn_stack_trace_group_cmp(const void *_a, const void *_b)
+{
+	const struct drgn_stack_trace_group_sort_entry *a = _a, *b = _b;
+
+	if (a->count != b->count)
+		return a->count > b->count ? -1 : 1;
+	if (a->index != b->index)
+		return a->index < b->index ? -1 : 1;
+	return 0;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_group_stack_traces(struct drgn_thread_stack_trace *traces, size_t count,
+			struct drgn_stack_trace_group **ret,
+			size_t *count_ret)
+{
+	struct drgn_error *err;
+	struct drgn_stack_trace_group_map map;
+	struct drgn_stack_trace_group_sort_entry *sorted = NULL;
+	struct drgn_stack_trace_group *groups = NULL;
+	size_t *group_indices, num_groups = 0, i;
+
+	drgn_stack_trace_group_map_init(&map);
+	group_indices = malloc_array(count ? count : 1, sizeof(*group_indices));
+	if (!group_indices) {
+		err = &drgn_enomem;
+		goto out;
+	}
+
+	/* First, number the groups and find the group of each trace. */
+	for (i = 0; i < count; i++) {
+		struct drgn_stack_trace_group_map_entry entry;
+		struct drgn_stack_trace_group_map_iterator it;
+
+		if (!traces[i].trace)
+			continue;
+		entry.key = traces[i].trace;
+		entry.value = num_groups;
+		if (drgn_stack_trace_group_map_insert(&map, &entry, &it) == -1) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		if (it.entry->value == num_groups)
+			num_groups++;
+		group_indices[i] = it.entry->value;
+	}
+
+	/* Then, sort them by size. */
+	sorted = calloc(num_groups ? num_groups : 1, sizeof(*sorted));
+	groups = calloc(num_groups ? num_groups : 1, sizeof(*groups));
+	if (!sorted || !groups) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	for (i = 0; i < num_groups; i++)
+		sorted[i].index = i;
+	for (i = 0; i < count; i++) {
+		if (traces[i].trace)
+			sorted[group_indices[i]].count++;
+	}
+	qsort(sorted, num_groups, sizeof(*sorted), drgn_stack_trace_group_cmp);
+
+	/* Finally, fill them in, moving the first trace of each. */
+	for (i = 0; i < num_groups; i++) {
+		groups[i].tids = malloc_array(sorted[i].count,
+					      sizeof(*groups[i].tids));
+		if (!groups[i].tids) {
+			err = &drgn_enomem;
+			goto err;
+		}
+	}
+	/*
+	 * The counts aren't needed anymore, so reuse them to map each group
+	 * number to its sorted position.
+	 */
+	for (i = 0; i < num_groups; i++)
+		sorted[sorted[i].index].count = i;
+	for (i = 0; i < count; i++) {
+		struct drgn_stack_trace_group *group;
+
+		if (!traces[i].trace)
+			continue;
+		group = &groups[sorted[group_indices[i]].count];
+		if (!group->trace) {
+			group->trace = traces[i].trace;
+			traces[i].trace = NULL;
+		}
+		group->tids[group->count++] = traces[i].tid;
+	}
+	*ret = groups;
+	*count_ret = num_groups;
+	err = NULL;
+	goto out;
+
+err:
+	drgn_stack_trace_groups_destroy(groups, groups ? num_groups : 0);
+out:
+	free(sorted);
+	free(group_indices);
+	drgn_stack_trace_group_map_deinit(&map);
+	return err;
+}
+
+LIBDRGN_PUBLIC void
+drgn_stack_trace_groups_destroy(struct drgn_stack_trace_group *groups,
+				size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		if (groups[i].trace)
+			drgn_stack_trace_destroy(groups[i].trace);
+		free(groups[i].tids);
 	}
+	free(groups);
 }
@@ -1,6 +1,7 @@
 // Copyright (c) Facebook, Inc. and its affiliates.
 // SPDX-License-Identifier: GPL-3.0+
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -16,6 +17,98 @@ bool string_builder_finalize(struct string_builder *sb, char **ret)
 	return true;
 }
 
+/* Buffer kept for string_builder_init_scratch() on each thread. */
+struct string_builder_scratch {
+	char *str;
+	size_t capacity;
+};
+
+static pthread_key_t string_builder_scratch_key;
+static pthread_once_t string_builder_scratch_once = PTHREAD_ONCE_INIT;
+static bool string_builder_scratch_key_valid;
+
+static void string_builder_scratch_destroy(void *arg)
+{
+	struct string_builder_scratch *scratch = arg;
+
+	free(scratch->str);
+	free(scratch);
+}
+
+static void string_builder_scratch_init(void)
+{
+	string_builder_scratch_key_valid =
+		pthread_key_create(&string_builder_scratch_key,
+				   string_builder_scratch_destroy) == 0;
+}
+
+static struct string_builder_scratch *string_builder_get_scratch(void)
+{
+	struct string_builder_scratch *scratch;
+
+	pthread_once(&string_builder_scratch_once, string_builder_scratch_init);
+	if (!string_builder_scratch_key_valid)
+		return NULL;
+	scratch = pthread_getspecific(string_builder_scratch_key);
+	if (!scratch) {
+		scratch = calloc(1, sizeof(*scratch));
+		if (!scratch)
+			return NULL;
+		if (pthread_setspecific(string_builder_scratch_key, scratch)) {
+			free(scratch);
+			return NULL;
+		}
+	}
+	return scratch;
+}
+
+void string_builder_init_scratch(struct string_builder *sb)
+{
+	struct string_builder_scratch *scratch = string_builder_get_scratch();
+
+	memset(sb, 0, sizeof(*sb));
+	if (scratch) {
+		sb->str = scratch->str;
+		sb->capacity = scratch->capacity;
+		scratch->str = NULL;
+		scratch->capacity = 0;
+	}
+}
+
+void string_builder_release_scratch(struct string_builder *sb)
+{
+	struct string_builder_scratch *scratch;
+
+	if (sb->capacity > STRING_BUILDER_SCRATCH_MAX_CAPACITY ||
+	    !(scratch = string_builder_get_scratch())) {
+		free(sb->str);
+		return;
+	}
+	/* Keep the bigger buffer if a nested builder was released first. */
+	if (sb->capacity > scratch->capacity) {
+		free(scratch->str);
+		scratch->str = sb->str;
+		scratch->capacity = sb->capacity;
+	} else {
+		free(sb->str);
+	}
+}
+
+bool string_builder_finalize_scratch(struct string_builder *sb, char **ret)
+{
+	char *str;
+
+	str = malloc(sb->len + 1);
+	if (str) {
+		if (sb->len)
+			memcpy(str, sb->str, sb->len);
+		str[sb->len] = '\0';
+		*ret = str;
+	}
+	string_builder_release_scratch(sb);
+	return str != NULL;
+}
+
 bool string_builder_reserve(struct string_builder *sb, size_t capacity)
 {
 	char *tmp;
@@ -32,6 +125,21 @@ bool string_builder_reserve(struct string_builder *sb, size_t capacity)
 	return true;
 }
 
+struct drgn_error *string_builder_flush(struct string_builder *sb, bool force)
+{
+	struct drgn_error *err;
+
+	if (!sb->write || sb->hold || !sb->len ||
+	    (!force && sb->len < STRING_BUILDER_FLUSH_SIZE))
+		return NULL;
+	err = sb->write(sb->str, sb->len, sb->write_arg);
+	if (err)
+		return err;
+	sb->written += sb->len;
+	sb->len = 0;
+	return NULL;
+}
+
 bool string_builder_appendc(struct string_builder *sb, char c)
 {
 	if (!string_builder_reserve(sb, sb->len + 1))
@@ -57,8 +57,39 @@ struct string_builder {
 	 * It should be initialized to zero.
 	 */
 	size_t capacity;
+	/**
+	 * Callback to write out text from @c str; see @ref
+	 * string_builder_flush().
+	 *
+	 * If this is @c NULL (the default), the string builder only builds the
+	 * string in memory.
+	 */
+	struct drgn_error *(*write)(const char *str, size_t len, void *arg);
+	/** Argument to pass to @ref string_builder::write. */
+	void *write_arg;
+	/**
+	 * Number of characters already written out by @ref
+	 * string_builder_flush().
+	 *
+	 * It should be initialized to zero.
+	 */
+	size_t written;
+	/**
+	 * Number of nested sections which may still rewrite text that has
+	 * already been appended.
+	 *
+	 * @ref string_builder_flush() is a no-op while this is non-zero. It
+	 * should be initialized to zero.
+	 */
+	unsigned int hold;
 };
 
+/**
+ * Minimum number of buffered characters before @ref string_builder_flush()
+ * calls @ref string_builder::write.
+ */
+#define STRING_BUILDER_FLUSH_SIZE 4096
+
 /**
  * Null-terminate and return a string from a @ref string_builder.
  *
@@ -70,6 +101,53 @@ struct string_builder {
  */
 bool string_builder_finalize(struct string_builder *sb, char **ret);
 
+/**
+ * Maximum capacity of the per-thread buffer kept by @ref
+ * string_builder_release_scratch(). Larger buffers are freed instead.
+ */
+#define STRING_BUILDER_SCRATCH_MAX_CAPACITY (1024 * 1024)
+
+/**
+ * Initialize a @ref string_builder with the calling thread's scratch buffer.
+ *
+ * This takes the buffer left by the last @ref string_builder_release_scratch()
+ * or @ref string_builder_finalize_scratch() on this thread, so a string built
+ * on every call (e.g., a formatted object) doesn't have to grow a new buffer
+ * from nothing each time. Until it is released, a nested call gets a new empty
+ * buffer.
+ *
+ * The string builder must be released with @ref
+ * string_builder_release_scratch() or @ref string_builder_finalize_scratch()
+ * instead of freeing @ref string_builder::str.
+ *
+ * @param[out] sb String builder to initialize. Fields other than the buffer
+ * are zeroed.
+ */
+void string_builder_init_scratch(struct string_builder *sb);
+
+/**
+ * Give the buffer of a @ref string_builder initialized with @ref
+ * string_builder_init_scratch() back to the calling thread.
+ *
+ * @param[in] sb String builder. It must not be used afterwards.
+ */
+void string_builder_release_scratch(struct string_builder *sb);
+
+/**
+ * Return a copy of the string in a @ref string_builder initialized with @ref
+ * string_builder_init_scratch() and release its buffer.
+ *
+ * The copy is allocated with exactly enough room for the string. The buffer is
+ * released whether or not this succeeds.
+ *
+ * @param[in] sb String builder. It must not be used afterwards.
+ * @param[out] ret Returned null-terminated string. It must be freed with @c
+ * free().
+ * @return @c true on success, @c false on error (if we couldn't allocate
+ * memory).
+ */
+bool string_builder_finalize_scratch(struct string_builder *sb, char **ret);
+
 /**
  * Resize the buffer of a @ref string_builder.
  *
@@ -144,6 +222,23 @@ bool string_builder_appendf(struct string_builder *sb, const char *format, ...)
 bool string_builder_vappendf(struct string_builder *sb, const char *format,
 			     va_list ap);
 
+/**
+ * Write out the buffered contents of a @ref string_builder.
+ *
+ * If @ref string_builder::write is set and @ref string_builder::hold is zero,
+ * then this passes the contents of the buffer to the callback and empties the
+ * buffer. Unless @p force is @c true, this only happens once at least @ref
+ * STRING_BUILDER_FLUSH_SIZE characters are buffered.
+ *
+ * Callers must only flush at points where the text already appended will not be
+ * looked at or rewritten, since offsets into @c str are invalidated.
+ *
+ * @param[in] sb String builder.
+ * @param[in] force Whether to flush regardless of how much is buffered.
+ * @return @c NULL on success, non-@c NULL on error (returned from the callback).
+ */
+struct drgn_error *string_builder_flush(struct string_builder *sb, bool force);
+
 /**
  * Append a newline character to a @ref string_builder if the string isn't empty
  * and doesn't already end in a newline.
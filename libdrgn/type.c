@@ -1,6 +1,7 @@
 // Copyright (c) Facebook, Inc. and its affiliates.
 // SPDX-License-Identifier: GPL-3.0+
 
+#include <pthread.h>
 #include <string.h>
 
 #include "internal.h"
@@ -138,25 +139,75 @@ void drgn_type_thunk_free(struct drgn_type_thunk *thunk)
 	thunk->free_fn(thunk);
 }
 
+static pthread_mutex_t drgn_type_construction_mutex =
+	PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+/* Number of type indexes in concurrent mode. */
+static unsigned int drgn_type_concurrency;
+
+void drgn_type_construction_lock(void)
+{
+	drgn_mutex_lock(&drgn_type_construction_mutex);
+}
+
+void drgn_type_construction_unlock(void)
+{
+	pthread_mutex_unlock(&drgn_type_construction_mutex);
+}
+
+void drgn_type_concurrency_get(void)
+{
+	__atomic_add_fetch(&drgn_type_concurrency, 1, __ATOMIC_SEQ_CST);
+}
+
+void drgn_type_concurrency_put(void)
+{
+	__atomic_sub_fetch(&drgn_type_concurrency, 1, __ATOMIC_SEQ_CST);
+}
+
 struct drgn_error *drgn_lazy_type_evaluate(struct drgn_lazy_type *lazy_type,
 					   struct drgn_qualified_type *qualified_type)
 {
-	if (drgn_lazy_type_is_evaluated(lazy_type)) {
+	struct drgn_error *err;
+	enum drgn_qualifiers qualifiers;
+	bool locked;
+
+	/*
+	 * The type is published with a release store of the qualifiers after
+	 * the type pointer, so this is safe without the lock.
+	 */
+	qualifiers = __atomic_load_n(&lazy_type->qualifiers, __ATOMIC_ACQUIRE);
+	if (qualifiers != (enum drgn_qualifiers)-1) {
 		qualified_type->type = lazy_type->type;
-		qualified_type->qualifiers = lazy_type->qualifiers;
-	} else {
-		struct drgn_error *err;
-		struct drgn_type_thunk *thunk_ptr = lazy_type->thunk;
-		struct drgn_type_thunk thunk = *thunk_ptr;
+		qualified_type->qualifiers = qualifiers;
+		return NULL;
+	}
 
-		err = thunk.evaluate_fn(thunk_ptr, qualified_type);
-		if (err)
-			return err;
-		drgn_lazy_type_init_evaluated(lazy_type, qualified_type->type,
-					      qualified_type->qualifiers);
-		thunk.free_fn(thunk_ptr);
+	locked = __atomic_load_n(&drgn_type_concurrency, __ATOMIC_SEQ_CST);
+	if (locked) {
+		drgn_type_construction_lock();
+		/* Another thread may have evaluated it in the meantime. */
+		if (drgn_lazy_type_is_evaluated(lazy_type)) {
+			qualified_type->type = lazy_type->type;
+			qualified_type->qualifiers = lazy_type->qualifiers;
+			err = NULL;
+			goto out;
+		}
 	}
-	return NULL;
+
+	struct drgn_type_thunk *thunk_ptr = lazy_type->thunk;
+	struct drgn_type_thunk thunk = *thunk_ptr;
+
+	err = thunk.evaluate_fn(thunk_ptr, qualified_type);
+	if (err)
+		goto out;
+	lazy_type->type = qualified_type->type;
+	__atomic_store_n(&lazy_type->qualifiers, qualified_type->qualifiers,
+			 __ATOMIC_RELEASE);
+	thunk.free_fn(thunk_ptr);
+out:
+	if (locked)
+		drgn_type_construction_unlock();
+	return err;
 }
 
 void drgn_lazy_type_deinit(struct drgn_lazy_type *lazy_type)
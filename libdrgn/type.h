@@ -144,6 +144,25 @@ struct drgn_error *drgn_lazy_type_evaluate(struct drgn_lazy_type *lazy_type,
  */
 void drgn_lazy_type_deinit(struct drgn_lazy_type *lazy_type);
 
+/**
+ * Acquire the lock serializing type construction between threads.
+ *
+ * While any @ref drgn_type_index is in concurrent mode (see @ref
+ * drgn_type_index_set_concurrent()), @ref drgn_lazy_type_evaluate() and type
+ * index cache misses hold this lock. It is recursive, and it is the only lock
+ * held while calling type finders and thunks, so they may look up other types.
+ */
+void drgn_type_construction_lock(void);
+
+/** Release the lock acquired by @ref drgn_type_construction_lock(). */
+void drgn_type_construction_unlock(void);
+
+/** Note that a type index entered concurrent mode. */
+void drgn_type_concurrency_get(void);
+
+/** Note that a type index in concurrent mode was destroyed. */
+void drgn_type_concurrency_put(void);
+
 /** @} */
 
 /**
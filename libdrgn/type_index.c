@@ -58,7 +58,7 @@ static struct hash_pair drgn_member_hash_pair(const struct drgn_member_key *key)
 	size_t hash;
 
 	if (key->name)
-		hash = cityhash_size_t(key->name, key->name_len);
+		hash = hash_bytes(key->name, key->name_len);
 	else
 		hash = 0;
 	hash = hash_combine((uintptr_t)key->type, hash);
@@ -75,60 +75,280 @@ static bool drgn_member_eq(const struct drgn_member_key *a,
 DEFINE_HASH_TABLE_FUNCTIONS(drgn_member_map, drgn_member_hash_pair,
 			    drgn_member_eq)
 
+static struct hash_pair
+drgn_enumerator_key_hash(const struct drgn_enumerator_key *key)
+{
+	return hash_pair_from_avalanching_hash(hash_combine((uintptr_t)key->type,
+							    key->value));
+}
+
+static bool drgn_enumerator_key_eq(const struct drgn_enumerator_key *a,
+				   const struct drgn_enumerator_key *b)
+{
+	return a->type == b->type && a->value == b->value;
+}
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_enumerator_map, drgn_enumerator_key_hash,
+			    drgn_enumerator_key_eq)
+
 DEFINE_HASH_TABLE_FUNCTIONS(drgn_type_set, hash_pair_ptr_type,
 			    hash_table_scalar_eq)
 
+DEFINE_VECTOR_FUNCTIONS(drgn_unnamed_member_vector)
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_member_pending_map, hash_pair_ptr_type,
+			    hash_table_scalar_eq)
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_type_layout_map, hash_pair_ptr_type,
+			    hash_table_scalar_eq)
+
+DEFINE_VECTOR(drgn_type_leaf_vector, struct drgn_type_leaf)
+
+static struct hash_pair
+drgn_type_name_key_hash(const struct drgn_type_name_key *key)
+{
+	size_t hash;
+
+	hash = c_string_hash(&key->name).first;
+	if (key->filename)
+		hash = hash_combine(hash, c_string_hash(&key->filename).first);
+	hash = hash_combine(hash, (uintptr_t)key->lang);
+	return hash_pair_from_avalanching_hash(hash);
+}
+
+static bool drgn_type_name_key_eq(const struct drgn_type_name_key *a,
+				  const struct drgn_type_name_key *b)
+{
+	return (a->lang == b->lang && strcmp(a->name, b->name) == 0 &&
+		(a->filename && b->filename ?
+		 strcmp(a->filename, b->filename) == 0 :
+		 a->filename == b->filename));
+}
+
+static struct hash_pair
+drgn_type_finder_memo_key_hash(const struct drgn_type_finder_memo_key *key)
+{
+	size_t hash;
+
+	hash = hash_combine(key->kind, hash_bytes(key->name, key->name_len));
+	if (key->filename)
+		hash = hash_combine(hash, c_string_hash(&key->filename).first);
+	return hash_pair_from_avalanching_hash(hash);
+}
+
+static bool
+drgn_type_finder_memo_key_eq(const struct drgn_type_finder_memo_key *a,
+			     const struct drgn_type_finder_memo_key *b)
+{
+	return (a->kind == b->kind && a->name_len == b->name_len &&
+		memcmp(a->name, b->name, a->name_len) == 0 &&
+		(a->filename && b->filename ?
+		 strcmp(a->filename, b->filename) == 0 :
+		 a->filename == b->filename));
+}
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_type_finder_memo,
+			    drgn_type_finder_memo_key_hash,
+			    drgn_type_finder_memo_key_eq)
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_type_name_map, drgn_type_name_key_hash,
+			    drgn_type_name_key_eq)
+
+static struct hash_pair
+drgn_type_string_key_hash(const struct drgn_qualified_type *key)
+{
+	return hash_pair_from_avalanching_hash(hash_combine((uintptr_t)key->type,
+							    key->qualifiers));
+}
+
+static bool drgn_type_string_key_eq(const struct drgn_qualified_type *a,
+				    const struct drgn_qualified_type *b)
+{
+	return a->type == b->type && a->qualifiers == b->qualifiers;
+}
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_type_string_map, drgn_type_string_key_hash,
+			    drgn_type_string_key_eq)
+
+static void drgn_type_index_read_lock(struct drgn_type_index *tindex)
+{
+	if (tindex->concurrent)
+		pthread_rwlock_rdlock(&tindex->cache_lock);
+}
+
+static void drgn_type_index_write_lock(struct drgn_type_index *tindex)
+{
+	if (tindex->concurrent)
+		pthread_rwlock_wrlock(&tindex->cache_lock);
+}
+
+static void drgn_type_index_cache_unlock(struct drgn_type_index *tindex)
+{
+	if (tindex->concurrent)
+		pthread_rwlock_unlock(&tindex->cache_lock);
+}
+
 void drgn_type_index_init(struct drgn_type_index *tindex)
 {
 	tindex->finders = NULL;
 	memset(tindex->primitive_types, 0, sizeof(tindex->primitive_types));
 	drgn_pointer_type_table_init(&tindex->pointer_types);
 	drgn_array_type_table_init(&tindex->array_types);
+	memset(tindex->pointer_type_cache, 0,
+	       sizeof(tindex->pointer_type_cache));
+	memset(tindex->array_type_cache, 0, sizeof(tindex->array_type_cache));
 	drgn_member_map_init(&tindex->members);
-	drgn_type_set_init(&tindex->members_cached);
+	drgn_member_pending_map_init(&tindex->members_pending);
+	tindex->profile = NULL;
+	drgn_type_name_map_init(&tindex->names);
+	drgn_enumerator_map_init(&tindex->enumerators);
+	drgn_type_set_init(&tindex->enumerators_cached);
+	drgn_type_layout_map_init(&tindex->layouts);
+	drgn_type_string_map_init(&tindex->formatted_type_names);
+	drgn_type_string_map_init(&tindex->formatted_types);
+	drgn_arena_init(&tindex->arena);
+	pthread_rwlock_init(&tindex->cache_lock, NULL);
+	tindex->concurrent = false;
 	tindex->word_size = 0;
 }
 
-static void free_pointer_types(struct drgn_type_index *tindex)
+void drgn_type_index_set_concurrent(struct drgn_type_index *tindex)
 {
-	struct drgn_pointer_type_table_iterator it;
-
-	for (it = drgn_pointer_type_table_first(&tindex->pointer_types);
-	     it.entry; it = drgn_pointer_type_table_next(it))
-		free(*it.entry);
-	drgn_pointer_type_table_deinit(&tindex->pointer_types);
+	if (!tindex->concurrent) {
+		tindex->concurrent = true;
+		drgn_type_concurrency_get();
+	}
 }
 
-static void free_array_types(struct drgn_type_index *tindex)
+static void drgn_type_string_map_free(struct drgn_type_string_map *map)
 {
-	struct drgn_array_type_table_iterator it;
+	struct drgn_type_string_map_iterator it;
 
-	for (it = drgn_array_type_table_first(&tindex->array_types); it.entry;
-	     it = drgn_array_type_table_next(it))
-		free(*it.entry);
-	drgn_array_type_table_deinit(&tindex->array_types);
+	for (it = drgn_type_string_map_first(map); it.entry;
+	     it = drgn_type_string_map_next(it))
+		free(it.entry->value);
+	drgn_type_string_map_deinit(map);
+}
+
+static void drgn_type_finder_destroy(struct drgn_type_finder *finder)
+{
+	struct drgn_type_finder_memo_iterator it;
+
+	/* The name and filename are allocated together. */
+	for (it = drgn_type_finder_memo_first(&finder->memo); it.entry;
+	     it = drgn_type_finder_memo_next(it))
+		free((char *)it.entry->key.name);
+	drgn_type_finder_memo_deinit(&finder->memo);
+	free(finder);
 }
 
 void drgn_type_index_deinit(struct drgn_type_index *tindex)
 {
 	struct drgn_type_finder *finder;
-
+	struct drgn_member_pending_map_iterator it;
+	struct drgn_type_layout_map_iterator layout_it;
+
+	drgn_type_string_map_free(&tindex->formatted_types);
+	drgn_type_string_map_free(&tindex->formatted_type_names);
+	drgn_type_index_flush_names(tindex);
+	for (layout_it = drgn_type_layout_map_first(&tindex->layouts);
+	     layout_it.entry;
+	     layout_it = drgn_type_layout_map_next(layout_it)) {
+		free(layout_it.entry->value->leaves);
+		free(layout_it.entry->value);
+	}
+	drgn_type_layout_map_deinit(&tindex->layouts);
+	drgn_type_name_map_deinit(&tindex->names);
+	drgn_type_set_deinit(&tindex->enumerators_cached);
+	drgn_enumerator_map_deinit(&tindex->enumerators);
 	drgn_member_map_deinit(&tindex->members);
-	drgn_type_set_deinit(&tindex->members_cached);
-	free_array_types(tindex);
-	free_pointer_types(tindex);
+	for (it = drgn_member_pending_map_first(&tindex->members_pending);
+	     it.entry; it = drgn_member_pending_map_next(it))
+		drgn_unnamed_member_vector_deinit(&it.entry->value);
+	drgn_member_pending_map_deinit(&tindex->members_pending);
+	drgn_array_type_table_deinit(&tindex->array_types);
+	drgn_pointer_type_table_deinit(&tindex->pointer_types);
+	drgn_arena_deinit(&tindex->arena);
+	pthread_rwlock_destroy(&tindex->cache_lock);
+	if (tindex->concurrent)
+		drgn_type_concurrency_put();
 
 	finder = tindex->finders;
 	while (finder) {
 		struct drgn_type_finder *next = finder->next;
 
-		free(finder);
+		drgn_type_finder_destroy(finder);
 		finder = next;
 	}
 }
 
+size_t drgn_type_index_memory_usage(struct drgn_type_index *tindex)
+{
+	struct drgn_member_pending_map_iterator pending_it;
+	struct drgn_type_name_map_iterator name_it;
+	struct drgn_type_layout_map_iterator layout_it;
+	struct drgn_type_string_map *string_maps[] = {
+		&tindex->formatted_type_names, &tindex->formatted_types,
+	};
+	struct drgn_type_string_map_iterator string_it;
+	struct drgn_type_finder *finder;
+	struct drgn_type_finder_memo_iterator memo_it;
+	size_t size, i;
+
+	drgn_type_index_lock(tindex);
+	drgn_type_index_read_lock(tindex);
+	size = (drgn_pointer_type_table_memory_usage(&tindex->pointer_types) +
+		drgn_array_type_table_memory_usage(&tindex->array_types) +
+		drgn_member_map_memory_usage(&tindex->members) +
+		drgn_member_pending_map_memory_usage(&tindex->members_pending) +
+		drgn_enumerator_map_memory_usage(&tindex->enumerators) +
+		drgn_type_set_memory_usage(&tindex->enumerators_cached) +
+		drgn_type_name_map_memory_usage(&tindex->names) +
+		drgn_type_layout_map_memory_usage(&tindex->layouts) +
+		drgn_arena_memory_usage(&tindex->arena));
+	for (i = 0; i < ARRAY_SIZE(string_maps); i++) {
+		size += drgn_type_string_map_memory_usage(string_maps[i]);
+		for (string_it = drgn_type_string_map_first(string_maps[i]);
+		     string_it.entry;
+		     string_it = drgn_type_string_map_next(string_it))
+			size += strlen(string_it.entry->value) + 1;
+	}
+	for (pending_it = drgn_member_pending_map_first(&tindex->members_pending);
+	     pending_it.entry;
+	     pending_it = drgn_member_pending_map_next(pending_it))
+		size += drgn_unnamed_member_vector_memory_usage(&pending_it.entry->value);
+	/* The name and filename are allocated together. */
+	for (name_it = drgn_type_name_map_first(&tindex->names); name_it.entry;
+	     name_it = drgn_type_name_map_next(name_it)) {
+		size += strlen(name_it.entry->key.name) + 1;
+		if (name_it.entry->key.filename)
+			size += strlen(name_it.entry->key.filename) + 1;
+	}
+	for (layout_it = drgn_type_layout_map_first(&tindex->layouts);
+	     layout_it.entry;
+	     layout_it = drgn_type_layout_map_next(layout_it)) {
+		size += (sizeof(*layout_it.entry->value) +
+			 layout_it.entry->value->num_leaves *
+			 sizeof(layout_it.entry->value->leaves[0]));
+	}
+	for (finder = tindex->finders; finder; finder = finder->next) {
+		size += drgn_type_finder_memo_memory_usage(&finder->memo);
+		for (memo_it = drgn_type_finder_memo_first(&finder->memo);
+		     memo_it.entry;
+		     memo_it = drgn_type_finder_memo_next(memo_it)) {
+			size += memo_it.entry->key.name_len + 1;
+			if (memo_it.entry->key.filename)
+				size += strlen(memo_it.entry->key.filename) + 1;
+		}
+	}
+	drgn_type_index_cache_unlock(tindex);
+	drgn_type_index_unlock(tindex);
+	return size;
+}
+
 struct drgn_error *drgn_type_index_add_finder(struct drgn_type_index *tindex,
-					      drgn_type_find_fn fn, void *arg)
+					      drgn_type_find_fn fn, void *arg,
+					      bool memoize)
 {
 	struct drgn_type_finder *finder;
 
@@ -137,8 +357,14 @@ struct drgn_error *drgn_type_index_add_finder(struct drgn_type_index *tindex,
 		return &drgn_enomem;
 	finder->fn = fn;
 	finder->arg = arg;
+	finder->memoize = memoize;
+	drgn_type_finder_memo_init(&finder->memo);
+	/* Finders are only called with this lock held. */
+	drgn_type_index_lock(tindex);
 	finder->next = tindex->finders;
 	tindex->finders = finder;
+	drgn_type_index_flush_names(tindex);
+	drgn_type_index_unlock(tindex);
 	return NULL;
 }
 
@@ -146,9 +372,12 @@ void drgn_type_index_remove_finder(struct drgn_type_index *tindex)
 {
 	struct drgn_type_finder *finder;
 
+	drgn_type_index_lock(tindex);
 	finder = tindex->finders->next;
-	free(tindex->finders);
+	drgn_type_finder_destroy(tindex->finders);
 	tindex->finders = finder;
+	drgn_type_index_flush_names(tindex);
+	drgn_type_index_unlock(tindex);
 }
 
 /* Default long and unsigned long are 64 bits. */
@@ -242,6 +471,35 @@ drgn_type_index_find_parsed_internal(struct drgn_type_index *tindex,
 
 	finder = tindex->finders;
 	while (finder) {
+		struct drgn_type_finder_memo_entry entry = {
+			.key = {
+				.kind = kind,
+				.name = name,
+				.name_len = name_len,
+				.filename = filename,
+			},
+		};
+		struct hash_pair hp;
+		size_t filename_size;
+		char *buf;
+
+		if (finder->memoize) {
+			struct drgn_type_finder_memo_iterator it;
+
+			hp = drgn_type_finder_memo_hash(&entry.key);
+			it = drgn_type_finder_memo_search_hashed(&finder->memo,
+								 &entry.key,
+								 hp);
+			if (it.entry) {
+				if (it.entry->value.type) {
+					*ret = it.entry->value;
+					return NULL;
+				}
+				finder = finder->next;
+				continue;
+			}
+		}
+
 		err = finder->fn(kind, name, name_len, filename, finder->arg,
 				 ret);
 		if (!err) {
@@ -249,19 +507,49 @@ drgn_type_index_find_parsed_internal(struct drgn_type_index *tindex,
 				return drgn_error_create(DRGN_ERROR_TYPE,
 							 "type find callback returned wrong kind of type");
 			}
-			return NULL;
-		}
-		if (err != &drgn_not_found)
+			entry.value = *ret;
+		} else if (err == &drgn_not_found) {
+			entry.value.type = NULL;
+			entry.value.qualifiers = 0;
+		} else {
 			return err;
+		}
+
+		/*
+		 * The finder may have looked up types itself, so search again
+		 * when inserting. Memoizing is only an optimization, so
+		 * failures are ignored.
+		 */
+		if (finder->memoize) {
+			filename_size = filename ? strlen(filename) + 1 : 0;
+			buf = malloc(name_len + 1 + filename_size);
+			if (buf) {
+				memcpy(buf, name, name_len);
+				buf[name_len] = '\0';
+				entry.key.name = buf;
+				if (filename) {
+					memcpy(buf + name_len + 1, filename,
+					       filename_size);
+					entry.key.filename = buf + name_len + 1;
+				}
+				if (drgn_type_finder_memo_insert_hashed(&finder->memo,
+									&entry,
+									hp,
+									NULL) != 1)
+					free(buf);
+			}
+		}
+		if (!err)
+			return NULL;
 		finder = finder->next;
 	}
 	return &drgn_not_found;
 }
 
-struct drgn_error *
-drgn_type_index_find_primitive(struct drgn_type_index *tindex,
-			       enum drgn_primitive_type type,
-			       struct drgn_type **ret)
+static struct drgn_error *
+drgn_type_index_find_primitive_slow(struct drgn_type_index *tindex,
+				    enum drgn_primitive_type type,
+				    struct drgn_type **ret)
 {
 	struct drgn_error *err;
 	struct drgn_qualified_type qualified_type;
@@ -269,6 +557,7 @@ drgn_type_index_find_primitive(struct drgn_type_index *tindex,
 	const char * const *spellings;
 	size_t i;
 
+	/* Another thread may have found it in the meantime. */
 	if (tindex->primitive_types[type]) {
 		*ret = tindex->primitive_types[type];
 		return NULL;
@@ -358,10 +647,98 @@ drgn_type_index_find_primitive(struct drgn_type_index *tindex,
 	*ret = &default_primitive_types[type];
 
 out:
-	tindex->primitive_types[type] = *ret;
+	__atomic_store_n(&tindex->primitive_types[type], *ret,
+			 __ATOMIC_RELEASE);
 	return NULL;
 }
 
+struct drgn_error *
+drgn_type_index_find_primitive(struct drgn_type_index *tindex,
+			       enum drgn_primitive_type type,
+			       struct drgn_type **ret)
+{
+	struct drgn_error *err;
+
+	*ret = __atomic_load_n(&tindex->primitive_types[type],
+			       __ATOMIC_ACQUIRE);
+	if (*ret)
+		return NULL;
+
+	drgn_type_index_lock(tindex);
+	err = drgn_type_index_find_primitive_slow(tindex, type, ret);
+	drgn_type_index_unlock(tindex);
+	return err;
+}
+
+void drgn_type_index_flush_names(struct drgn_type_index *tindex)
+{
+	struct drgn_type_name_map_iterator it;
+
+	drgn_type_index_write_lock(tindex);
+	/* The name and filename are allocated together. */
+	for (it = drgn_type_name_map_first(&tindex->names); it.entry;
+	     it = drgn_type_name_map_next(it))
+		free((char *)it.entry->key.name);
+	drgn_type_name_map_clear(&tindex->names);
+	drgn_type_index_cache_unlock(tindex);
+}
+
+struct drgn_error *drgn_type_index_find(struct drgn_type_index *tindex,
+					const char *name, const char *filename,
+					const struct drgn_language *lang,
+					struct drgn_qualified_type *ret)
+{
+	struct drgn_error *err;
+	struct drgn_type_name_map_entry entry = {
+		.key = {
+			.name = name,
+			.filename = filename,
+			.lang = lang,
+		},
+	};
+	struct drgn_type_name_map_iterator it;
+	size_t name_size, filename_size;
+	char *buf;
+
+	drgn_type_index_read_lock(tindex);
+	it = drgn_type_name_map_search(&tindex->names, &entry.key);
+	if (it.entry)
+		*ret = it.entry->value;
+	drgn_type_index_cache_unlock(tindex);
+	if (it.entry)
+		return NULL;
+
+	drgn_type_index_lock(tindex);
+	err = lang->find_type(tindex, name, filename, ret);
+	if (err)
+		goto out;
+
+	/*
+	 * Don't use the search above for the insertion: a finder may have
+	 * looked up types itself, and another thread may have inserted the
+	 * same name. Caching is only an optimization, so failures are ignored.
+	 */
+	name_size = strlen(name) + 1;
+	filename_size = filename ? strlen(filename) + 1 : 0;
+	buf = malloc(name_size + filename_size);
+	if (!buf)
+		goto out;
+	memcpy(buf, name, name_size);
+	entry.key.name = buf;
+	if (filename) {
+		memcpy(buf + name_size, filename, filename_size);
+		entry.key.filename = buf + name_size;
+	}
+	entry.value = *ret;
+	drgn_type_index_write_lock(tindex);
+	if (drgn_type_name_map_insert(&tindex->names, &entry, NULL) != 1)
+		free(buf);
+	drgn_type_index_cache_unlock(tindex);
+out:
+	drgn_type_index_unlock(tindex);
+	return err;
+}
+
 struct drgn_error *
 drgn_type_index_find_parsed(struct drgn_type_index *tindex,
 			    enum drgn_type_kind kind, const char *name,
@@ -389,12 +766,33 @@ drgn_type_index_find_parsed(struct drgn_type_index *tindex,
 	}
 }
 
+static struct drgn_type *
+drgn_derived_type_cache_load(struct drgn_type **cache, struct hash_pair hp)
+{
+	return __atomic_load_n(&cache[hp.first &
+				      (DRGN_DERIVED_TYPE_CACHE_SIZE - 1)],
+			       __ATOMIC_ACQUIRE);
+}
+
+/*
+ * The release store makes sure that a thread which loads the type sees it fully
+ * initialized.
+ */
+static void drgn_derived_type_cache_store(struct drgn_type **cache,
+					  struct hash_pair hp,
+					  struct drgn_type *type)
+{
+	__atomic_store_n(&cache[hp.first & (DRGN_DERIVED_TYPE_CACHE_SIZE - 1)],
+			 type, __ATOMIC_RELEASE);
+}
+
 struct drgn_error *
 drgn_type_index_pointer_type(struct drgn_type_index *tindex,
 			     struct drgn_qualified_type referenced_type,
 			     const struct drgn_language *lang,
 			     struct drgn_type **ret)
 {
+	struct drgn_error *err = NULL;
 	const struct drgn_pointer_type_key key = {
 		.type = referenced_type.type,
 		.qualifiers = referenced_type.qualifiers,
@@ -410,23 +808,121 @@ drgn_type_index_pointer_type(struct drgn_type_index *tindex,
 	}
 
 	hp = drgn_pointer_type_table_hash(&key);
+	type = drgn_derived_type_cache_load(tindex->pointer_type_cache, hp);
+	if (type) {
+		struct drgn_pointer_type_key cached_key =
+			drgn_pointer_type_entry_to_key(&type);
+
+		if (drgn_pointer_type_key_eq(&cached_key, &key))
+			goto out;
+	}
+	drgn_type_index_read_lock(tindex);
 	it = drgn_pointer_type_table_search_hashed(&tindex->pointer_types, &key,
 						   hp);
-	if (it.entry) {
-		type = *it.entry;
+	type = it.entry ? *it.entry : NULL;
+	drgn_type_index_cache_unlock(tindex);
+	if (type) {
+		drgn_derived_type_cache_store(tindex->pointer_type_cache, hp,
+					      type);
 		goto out;
 	}
 
-	type = malloc(sizeof(*type));
-	if (!type)
-		return &drgn_enomem;
+	drgn_type_index_lock(tindex);
+	/* Another thread may have created it in the meantime. */
+	it = drgn_pointer_type_table_search_hashed(&tindex->pointer_types, &key,
+						   hp);
+	if (it.entry) {
+		type = *it.entry;
+		goto cache;
+	}
+	type = drgn_arena_alloc(&tindex->arena, sizeof(*type));
+	if (!type) {
+		err = &drgn_enomem;
+		goto unlock;
+	}
 	drgn_pointer_type_init(type, tindex->word_size, referenced_type,
 			       key.lang);
+	drgn_type_index_write_lock(tindex);
 	if (drgn_pointer_type_table_insert_searched(&tindex->pointer_types,
-						    &type, hp, NULL) == -1) {
-		free(type);
-		return &drgn_enomem;
+						    &type, hp, NULL) == -1)
+		err = &drgn_enomem;
+	drgn_type_index_cache_unlock(tindex);
+	if (err)
+		goto unlock;
+cache:
+	drgn_derived_type_cache_store(tindex->pointer_type_cache, hp, type);
+unlock:
+	drgn_type_index_unlock(tindex);
+	if (err)
+		return err;
+out:
+	*ret = type;
+	return NULL;
+}
+
+static struct drgn_error *
+drgn_type_index_cached_array_type(struct drgn_type_index *tindex,
+				  const struct drgn_array_type_key *key,
+				  struct drgn_qualified_type element_type,
+				  struct drgn_type **ret)
+{
+	struct drgn_error *err = NULL;
+	struct drgn_array_type_table_iterator it;
+	struct drgn_type *type;
+	struct hash_pair hp;
+
+	hp = drgn_array_type_table_hash(key);
+	type = drgn_derived_type_cache_load(tindex->array_type_cache, hp);
+	if (type) {
+		struct drgn_array_type_key cached_key =
+			drgn_array_type_entry_to_key(&type);
+
+		if (drgn_array_type_key_eq(&cached_key, key))
+			goto out;
 	}
+	drgn_type_index_read_lock(tindex);
+	it = drgn_array_type_table_search_hashed(&tindex->array_types, key,
+						 hp);
+	type = it.entry ? *it.entry : NULL;
+	drgn_type_index_cache_unlock(tindex);
+	if (type) {
+		drgn_derived_type_cache_store(tindex->array_type_cache, hp,
+					      type);
+		goto out;
+	}
+
+	drgn_type_index_lock(tindex);
+	/* Another thread may have created it in the meantime. */
+	it = drgn_array_type_table_search_hashed(&tindex->array_types, key,
+						 hp);
+	if (it.entry) {
+		type = *it.entry;
+		goto cache;
+	}
+	type = drgn_arena_alloc(&tindex->arena, sizeof(*type));
+	if (!type) {
+		err = &drgn_enomem;
+		goto unlock;
+	}
+	if (key->is_complete) {
+		drgn_array_type_init(type, key->length, element_type,
+				     key->lang);
+	} else {
+		drgn_array_type_init_incomplete(type, element_type, key->lang);
+	}
+	drgn_type_index_write_lock(tindex);
+	if (drgn_array_type_table_insert_searched(&tindex->array_types, &type,
+						  hp, NULL) == -1)
+		err = &drgn_enomem;
+	drgn_type_index_cache_unlock(tindex);
+	if (err)
+		goto unlock;
+cache:
+	drgn_derived_type_cache_store(tindex->array_type_cache, hp, type);
+unlock:
+	drgn_type_index_unlock(tindex);
+	if (err)
+		return err;
 out:
 	*ret = type;
 	return NULL;
@@ -445,30 +941,9 @@ drgn_type_index_array_type(struct drgn_type_index *tindex, uint64_t length,
 		.length = length,
 		.lang = lang ? lang : drgn_type_language(element_type.type),
 	};
-	struct drgn_array_type_table_iterator it;
-	struct drgn_type *type;
-	struct hash_pair hp;
 
-	hp = drgn_array_type_table_hash(&key);
-	it = drgn_array_type_table_search_hashed(&tindex->array_types, &key,
-						 hp);
-	if (it.entry) {
-		type = *it.entry;
-		goto out;
-	}
-
-	type = malloc(sizeof(*type));
-	if (!type)
-		return &drgn_enomem;
-	drgn_array_type_init(type, length, element_type, key.lang);
-	if (drgn_array_type_table_insert_searched(&tindex->array_types, &type,
-						  hp, NULL) == -1) {
-		free(type);
-		return &drgn_enomem;
-	}
-out:
-	*ret = type;
-	return NULL;
+	return drgn_type_index_cached_array_type(tindex, &key, element_type,
+						 ret);
 }
 
 struct drgn_error *
@@ -483,47 +958,33 @@ drgn_type_index_incomplete_array_type(struct drgn_type_index *tindex,
 		.is_complete = false,
 		.lang = lang ? lang : drgn_type_language(element_type.type),
 	};
-	struct drgn_array_type_table_iterator it;
-	struct drgn_type *type;
-	struct hash_pair hp;
 
-	hp = drgn_array_type_table_hash(&key);
-	it = drgn_array_type_table_search_hashed(&tindex->array_types, &key,
-						 hp);
-	if (it.entry) {
-		type = *it.entry;
-		goto out;
-	}
-
-	type = malloc(sizeof(*type));
-	if (!type)
-		return &drgn_enomem;
-	drgn_array_type_init_incomplete(type, element_type, key.lang);
-	if (drgn_array_type_table_insert_searched(&tindex->array_types, &type,
-						  hp, NULL) == -1) {
-		free(type);
-		return &drgn_enomem;
-	}
-out:
-	*ret = type;
-	return NULL;
+	return drgn_type_index_cached_array_type(tindex, &key, element_type,
+						 ret);
 }
 
+/*
+ * Add the named members of a type to the member cache and queue its unnamed
+ * members to be flattened later. This doesn't evaluate any member types.
+ */
 static struct drgn_error *
 drgn_type_index_cache_members(struct drgn_type_index *tindex,
 			      struct drgn_type *outer_type,
-			      struct drgn_type *type, uint64_t bit_offset)
+			      struct drgn_type *type, uint64_t bit_offset,
+			      struct drgn_unnamed_member_vector *pending)
 {
-	struct drgn_error *err;
 	struct drgn_type_member *members;
-	size_t num_members, i;
+	size_t i;
 
 	if (!drgn_type_has_members(type))
 		return NULL;
 
 	members = drgn_type_members(type);
-	num_members = drgn_type_num_members(type);
-	for (i = 0; i < num_members; i++) {
+	/*
+	 * Queue unnamed members in reverse so that they are flattened in
+	 * declaration order.
+	 */
+	for (i = drgn_type_num_members(type); i-- > 0;) {
 		struct drgn_type_member *member;
 
 		member = &members[i];
@@ -547,27 +1008,24 @@ drgn_type_index_cache_members(struct drgn_type_index *tindex,
 						   NULL) == -1)
 				return &drgn_enomem;
 		} else {
-			struct drgn_qualified_type member_type;
+			struct drgn_unnamed_member *unnamed;
 
-			err = drgn_member_type(member, &member_type);
-			if (err)
-				return err;
-			err = drgn_type_index_cache_members(tindex, outer_type,
-							    member_type.type,
-							    bit_offset +
-							    member->bit_offset);
-			if (err)
-				return err;
+			unnamed = drgn_unnamed_member_vector_append_entry(pending);
+			if (!unnamed)
+				return &drgn_enomem;
+			unnamed->member = member;
+			unnamed->bit_offset = bit_offset + member->bit_offset;
 		}
 	}
 	return NULL;
 }
 
-struct drgn_error *drgn_type_index_find_member(struct drgn_type_index *tindex,
-					       struct drgn_type *type,
-					       const char *member_name,
-					       size_t member_name_len,
-					       struct drgn_member_value **ret)
+static struct drgn_error *
+drgn_type_index_find_member_impl(struct drgn_type_index *tindex,
+				 struct drgn_type *type,
+				 const char *member_name,
+				 size_t member_name_len,
+				 struct drgn_member_value *ret)
 {
 	struct drgn_error *err;
 	const struct drgn_member_key key = {
@@ -575,48 +1033,550 @@ struct drgn_error *drgn_type_index_find_member(struct drgn_type_index *tindex,
 		.name = member_name,
 		.name_len = member_name_len,
 	};
-	struct hash_pair hp, cached_hp;
+	struct hash_pair hp, pending_hp;
 	struct drgn_member_map_iterator it;
+	struct drgn_member_pending_map_iterator pending_it;
+	struct drgn_unnamed_member_vector *pending;
 
 	hp = drgn_member_map_hash(&key);
+	drgn_type_index_read_lock(tindex);
 	it = drgn_member_map_search_hashed(&tindex->members, &key, hp);
-	if (it.entry) {
-		*ret = &it.entry->value;
+	if (it.entry)
+		*ret = it.entry->value;
+	drgn_type_index_cache_unlock(tindex);
+	if (it.entry)
 		return NULL;
-	}
 
 	/*
 	 * Cache miss. One of the following is true:
 	 *
 	 * 1. The type isn't a structure, union, or class, which is a type
 	 *    error.
-	 * 2. The type hasn't been cached, which means we need to cache it and
-	 *    check again.
-	 * 3. The type has already been cached, which means the member doesn't
-	 *    exist.
+	 * 2. The type hasn't been cached, which means we need to cache its
+	 *    named members and check again.
+	 * 3. The member is inside of an unnamed member which hasn't been
+	 *    flattened yet, which means we need to flatten unnamed members
+	 *    until we find it.
+	 * 4. The type has been completely cached, which means the member
+	 *    doesn't exist.
 	 */
 	if (!drgn_type_has_members(key.type)) {
 		return drgn_type_error("'%s' is not a structure, union, or class",
 				       type);
 	}
-	cached_hp = drgn_type_set_hash(&key.type);
-	if (drgn_type_set_search_hashed(&tindex->members_cached, &key.type,
-					cached_hp).entry)
-		return drgn_error_member_not_found(type, member_name);
 
-	err = drgn_type_index_cache_members(tindex, key.type, key.type, 0);
+	drgn_type_index_lock(tindex);
+	pending_hp = drgn_member_pending_map_hash(&key.type);
+	pending_it = drgn_member_pending_map_search_hashed(&tindex->members_pending,
+							   &key.type,
+							   pending_hp);
+	if (pending_it.entry) {
+		pending = &pending_it.entry->value;
+	} else {
+		struct drgn_member_pending_map_entry entry = {
+			.key = key.type,
+			.value = VECTOR_INIT,
+		};
+
+		if (drgn_member_pending_map_insert_searched(&tindex->members_pending,
+							    &entry, pending_hp,
+							    &pending_it) == -1) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		pending = &pending_it.entry->value;
+		drgn_type_index_write_lock(tindex);
+		err = drgn_type_index_cache_members(tindex, key.type, key.type,
+						    0, pending);
+		drgn_type_index_cache_unlock(tindex);
+		if (err)
+			goto out;
+	}
+
+	for (;;) {
+		struct drgn_unnamed_member next;
+		struct drgn_qualified_type member_type;
+
+		it = drgn_member_map_search_hashed(&tindex->members, &key, hp);
+		if (it.entry) {
+			*ret = it.entry->value;
+			err = NULL;
+			goto out;
+		}
+
+		if (!pending->size)
+			break;
+		next = *drgn_unnamed_member_vector_pop(pending);
+		err = drgn_member_type(next.member, &member_type);
+		if (err) {
+			/* Put it back so that a later lookup can retry. */
+			pending->size++;
+			goto out;
+		}
+		drgn_type_index_write_lock(tindex);
+		err = drgn_type_index_cache_members(tindex, key.type,
+						    member_type.type,
+						    next.bit_offset, pending);
+		drgn_type_index_cache_unlock(tindex);
+		if (err)
+			goto out;
+	}
+
+	err = drgn_error_member_not_found(type, member_name);
+out:
+	drgn_type_index_unlock(tindex);
+	return err;
+}
+
+struct drgn_error *drgn_type_index_find_member(struct drgn_type_index *tindex,
+					       struct drgn_type *type,
+					       const char *member_name,
+					       size_t member_name_len,
+					       struct drgn_member_value *ret)
+{
+	struct drgn_error *err;
+	uint64_t start_ns;
+
+	start_ns = drgn_profile_begin(tindex->profile);
+	err = drgn_type_index_find_member_impl(tindex, type, member_name,
+					       member_name_len, ret);
+	drgn_profile_end(tindex->profile, member_lookups, start_ns);
+	return err;
+}
+
+/*
+ * Enumerated types with fewer enumerators than this are searched linearly
+ * instead of being indexed.
+ */
+#define DRGN_ENUMERATOR_INDEX_MIN 16
+
+struct drgn_error *
+drgn_type_index_find_enumerator(struct drgn_type_index *tindex,
+				struct drgn_type *type, uint64_t value,
+				const struct drgn_type_enumerator **ret)
+{
+	struct drgn_error *err;
+	struct drgn_type_enumerator *enumerators;
+	size_t num_enumerators, i;
+	struct drgn_enumerator_key key = {
+		.type = type,
+		.value = value,
+	};
+	struct hash_pair hp, cached_hp;
+	struct drgn_enumerator_map_iterator it;
+
+	enumerators = drgn_type_enumerators(type);
+	num_enumerators = drgn_type_num_enumerators(type);
+	/* uvalue and svalue share storage, so comparing uvalue works for both. */
+	if (num_enumerators < DRGN_ENUMERATOR_INDEX_MIN) {
+		for (i = 0; i < num_enumerators; i++) {
+			if (enumerators[i].uvalue == value) {
+				*ret = &enumerators[i];
+				return NULL;
+			}
+		}
+		return &drgn_not_found;
+	}
+
+	hp = drgn_enumerator_map_hash(&key);
+	drgn_type_index_read_lock(tindex);
+	it = drgn_enumerator_map_search_hashed(&tindex->enumerators, &key, hp);
+	if (it.entry)
+		*ret = it.entry->value;
+	drgn_type_index_cache_unlock(tindex);
+	if (it.entry)
+		return NULL;
+
+	drgn_type_index_lock(tindex);
+	cached_hp = drgn_type_set_hash(&type);
+	if (drgn_type_set_search_hashed(&tindex->enumerators_cached, &type,
+					cached_hp).entry) {
+		err = &drgn_not_found;
+		goto out;
+	}
+
+	drgn_type_index_write_lock(tindex);
+	for (i = 0; i < num_enumerators; i++) {
+		struct drgn_enumerator_map_entry entry = {
+			.key = {
+				.type = type,
+				.value = enumerators[i].uvalue,
+			},
+			.value = &enumerators[i],
+		};
+
+		/* This keeps the first enumerator for duplicate values. */
+		if (drgn_enumerator_map_insert(&tindex->enumerators, &entry,
+					       NULL) == -1) {
+			drgn_type_index_cache_unlock(tindex);
+			err = &drgn_enomem;
+			goto out;
+		}
+	}
+	drgn_type_index_cache_unlock(tindex);
+	if (drgn_type_set_insert_searched(&tindex->enumerators_cached, &type,
+					  cached_hp, NULL) == -1) {
+		err = &drgn_enomem;
+		goto out;
+	}
+
+	it = drgn_enumerator_map_search_hashed(&tindex->enumerators, &key, hp);
+	if (it.entry) {
+		*ret = it.entry->value;
+		err = NULL;
+	} else {
+		err = &drgn_not_found;
+	}
+out:
+	drgn_type_index_unlock(tindex);
+	return err;
+}
+
+/* Types with more scalar leaves than this are not flattened. */
+#define DRGN_TYPE_LAYOUT_MAX_LEAVES 4096
+
+/* Return whether a scalar of the given kind and size can be read. */
+static bool drgn_type_leaf_is_supported(enum drgn_object_kind kind,
+					uint64_t bit_size)
+{
+	switch (kind) {
+	case DRGN_OBJECT_SIGNED:
+	case DRGN_OBJECT_UNSIGNED:
+		return bit_size && bit_size <= 64;
+	case DRGN_OBJECT_FLOAT:
+		return bit_size == 32 || bit_size == 64;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Merge the layout of a member or element at the given offset into the layout
+ * being computed.
+ */
+static struct drgn_error *
+drgn_type_layout_append(struct drgn_type_layout *layout,
+			struct drgn_type_leaf_vector *leaves,
+			const struct drgn_type_layout *child,
+			uint64_t bit_offset)
+{
+	size_t i;
+
+	if (child->alignment > layout->alignment)
+		layout->alignment = child->alignment;
+	if (child->has_bit_fields)
+		layout->has_bit_fields = true;
+	if (!layout->flattened)
+		return NULL;
+	if (!child->flattened ||
+	    child->num_leaves > DRGN_TYPE_LAYOUT_MAX_LEAVES - leaves->size) {
+		layout->flattened = false;
+		return NULL;
+	}
+	if (!drgn_type_leaf_vector_reserve(leaves,
+					   leaves->size + child->num_leaves))
+		return &drgn_enomem;
+	for (i = 0; i < child->num_leaves; i++) {
+		struct drgn_type_leaf *leaf = &leaves->data[leaves->size++];
+
+		*leaf = child->leaves[i];
+		leaf->bit_offset += bit_offset;
+	}
+	return NULL;
+}
+
+static struct drgn_error *
+drgn_compound_type_layout(struct drgn_type_index *tindex,
+			  struct drgn_type *underlying_type,
+			  struct drgn_type_layout *layout,
+			  struct drgn_type_leaf_vector *leaves)
+{
+	struct drgn_error *err;
+	struct drgn_type_member *members;
+	size_t num_members, i;
+
+	members = drgn_type_members(underlying_type);
+	num_members = drgn_type_num_members(underlying_type);
+	for (i = 0; i < num_members; i++) {
+		struct drgn_qualified_type member_type;
+		const struct drgn_type_layout *child;
+		struct drgn_type_leaf *leaf;
+
+		err = drgn_member_type(&members[i], &member_type);
+		if (err)
+			return err;
+		/* Flexible array members don't have a size. */
+		if (!drgn_type_is_complete(member_type.type)) {
+			layout->flattened = false;
+			continue;
+		}
+		err = drgn_type_index_layout(tindex, member_type.type, &child);
+		if (err)
+			return err;
+		if (!members[i].bit_field_size) {
+			err = drgn_type_layout_append(layout, leaves, child,
+						      members[i].bit_offset);
+			if (err)
+				return err;
+			continue;
+		}
+
+		layout->has_bit_fields = true;
+		if (child->alignment > layout->alignment)
+			layout->alignment = child->alignment;
+		if (!layout->flattened)
+			continue;
+		if (!child->flattened || child->num_leaves != 1 ||
+		    child->leaves[0].kind == DRGN_OBJECT_FLOAT ||
+		    !drgn_type_leaf_is_supported(child->leaves[0].kind,
+						 members[i].bit_field_size) ||
+		    leaves->size >= DRGN_TYPE_LAYOUT_MAX_LEAVES) {
+			layout->flattened = false;
+			continue;
+		}
+		leaf = drgn_type_leaf_vector_append_entry(leaves);
+		if (!leaf)
+			return &drgn_enomem;
+		leaf->type = child->leaves[0].type;
+		leaf->kind = child->leaves[0].kind;
+		leaf->bit_offset = members[i].bit_offset;
+		leaf->bit_size = members[i].bit_field_size;
+	}
+	/* Union members overlap, so they can't be flattened. */
+	if (drgn_type_kind(underlying_type) == DRGN_TYPE_UNION)
+		layout->flattened = false;
+	return NULL;
+}
+
+static struct drgn_error *
+drgn_array_type_layout(struct drgn_type_index *tindex,
+		       struct drgn_type *underlying_type,
+		       struct drgn_type_layout *layout,
+		       struct drgn_type_leaf_vector *leaves)
+{
+	struct drgn_error *err;
+	const struct drgn_type_layout *child;
+	uint64_t length, num_leaves, i;
+
+	length = drgn_type_length(underlying_type);
+	if (!length)
+		return NULL;
+	err = drgn_type_index_layout(tindex,
+				     drgn_type_type(underlying_type).type,
+				     &child);
 	if (err)
 		return err;
+	if (__builtin_mul_overflow(child->num_leaves, length, &num_leaves) ||
+	    num_leaves > DRGN_TYPE_LAYOUT_MAX_LEAVES)
+		layout->flattened = false;
+	/*
+	 * The first element is always appended for the alignment and bit field
+	 * flag. After that, only the leaves matter.
+	 */
+	for (i = 0; i < length; i++) {
+		err = drgn_type_layout_append(layout, leaves, child,
+					      i * child->size * 8);
+		if (err)
+			return err;
+		if (!layout->flattened || !child->num_leaves)
+			break;
+	}
+	return NULL;
+}
 
-	if (drgn_type_set_insert_searched(&tindex->members_cached, &key.type,
-					  cached_hp, NULL) == -1)
-		return &drgn_enomem;
+static struct drgn_error *
+drgn_type_layout_compute(struct drgn_type_index *tindex,
+			 struct drgn_type *type,
+			 struct drgn_type_layout *layout,
+			 struct drgn_type_leaf_vector *leaves)
+{
+	struct drgn_error *err;
+	struct drgn_type *underlying_type;
+	uint64_t bit_size;
+	enum drgn_object_kind kind;
+	struct drgn_type_leaf *leaf;
 
-	it = drgn_member_map_search_hashed(&tindex->members, &key, hp);
-	if (it.entry) {
-		*ret = &it.entry->value;
+	/* This also ensures that no offset in the type overflows. */
+	err = drgn_type_bit_size(type, &bit_size);
+	if (err)
+		return err;
+	layout->size = bit_size / 8;
+	layout->alignment = 1;
+	layout->has_bit_fields = false;
+	layout->flattened = true;
+
+	underlying_type = drgn_underlying_type(type);
+	switch (drgn_type_kind(underlying_type)) {
+	case DRGN_TYPE_INT:
+	case DRGN_TYPE_BOOL:
+	case DRGN_TYPE_FLOAT:
+	case DRGN_TYPE_ENUM:
+	case DRGN_TYPE_POINTER:
+		if (layout->size > 1)
+			layout->alignment = layout->size;
+		kind = drgn_type_object_kind(type);
+		if (!drgn_type_leaf_is_supported(kind, bit_size)) {
+			layout->flattened = false;
+			return NULL;
+		}
+		leaf = drgn_type_leaf_vector_append_entry(leaves);
+		if (!leaf)
+			return &drgn_enomem;
+		leaf->type = type;
+		leaf->kind = kind;
+		leaf->bit_offset = 0;
+		leaf->bit_size = bit_size;
+		return NULL;
+	case DRGN_TYPE_COMPLEX:
+		if (layout->size > 1)
+			layout->alignment = layout->size / 2;
+		layout->flattened = false;
+		return NULL;
+	case DRGN_TYPE_STRUCT:
+	case DRGN_TYPE_UNION:
+	case DRGN_TYPE_CLASS:
+		return drgn_compound_type_layout(tindex, underlying_type,
+						 layout, leaves);
+	case DRGN_TYPE_ARRAY:
+		return drgn_array_type_layout(tindex, underlying_type, layout,
+					      leaves);
+	default:
+		UNREACHABLE();
+	}
+}
+
+struct drgn_error *drgn_type_index_layout(struct drgn_type_index *tindex,
+					  struct drgn_type *type,
+					  const struct drgn_type_layout **ret)
+{
+	struct drgn_error *err;
+	struct hash_pair hp;
+	struct drgn_type_layout_map_iterator it;
+	struct drgn_type_layout_map_entry entry;
+	struct drgn_type_leaf_vector leaves;
+	int insert_ret;
+
+	hp = drgn_type_layout_map_hash(&type);
+	drgn_type_index_read_lock(tindex);
+	it = drgn_type_layout_map_search_hashed(&tindex->layouts, &type, hp);
+	if (it.entry)
+		*ret = it.entry->value;
+	drgn_type_index_cache_unlock(tindex);
+	if (it.entry)
 		return NULL;
+
+	drgn_type_index_lock(tindex);
+	/* Another thread may have computed it while we were waiting. */
+	it = drgn_type_layout_map_search_hashed(&tindex->layouts, &type, hp);
+	if (it.entry) {
+		*ret = it.entry->value;
+		err = NULL;
+		goto out;
+	}
+
+	entry.key = type;
+	entry.value = malloc(sizeof(*entry.value));
+	if (!entry.value) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	drgn_type_leaf_vector_init(&leaves);
+	err = drgn_type_layout_compute(tindex, type, entry.value, &leaves);
+	if (err) {
+		drgn_type_leaf_vector_deinit(&leaves);
+		free(entry.value);
+		goto out;
+	}
+	if (entry.value->flattened) {
+		drgn_type_leaf_vector_shrink_to_fit(&leaves);
+		entry.value->num_leaves = leaves.size;
+		entry.value->leaves = leaves.data;
+	} else {
+		drgn_type_leaf_vector_deinit(&leaves);
+		entry.value->num_leaves = 0;
+		entry.value->leaves = NULL;
+	}
+
+	drgn_type_index_write_lock(tindex);
+	insert_ret = drgn_type_layout_map_insert_searched(&tindex->layouts,
+							  &entry, hp, NULL);
+	drgn_type_index_cache_unlock(tindex);
+	if (insert_ret == -1) {
+		free(entry.value->leaves);
+		free(entry.value);
+		err = &drgn_enomem;
+		goto out;
 	}
+	*ret = entry.value;
+	err = NULL;
+out:
+	drgn_type_index_unlock(tindex);
+	return err;
+}
 
-	return drgn_error_member_not_found(type, member_name);
+static struct drgn_error *
+drgn_type_index_format_cached(struct drgn_type_index *tindex,
+			      struct drgn_type_string_map *map,
+			      struct drgn_qualified_type qualified_type,
+			      bool definition, const char **ret)
+{
+	struct drgn_error *err;
+	const struct drgn_language *lang;
+	struct hash_pair hp;
+	struct drgn_type_string_map_iterator it;
+	struct drgn_type_string_map_entry entry;
+	int insert_ret;
+
+	hp = drgn_type_string_map_hash(&qualified_type);
+	drgn_type_index_read_lock(tindex);
+	it = drgn_type_string_map_search_hashed(map, &qualified_type, hp);
+	if (it.entry)
+		*ret = it.entry->value;
+	drgn_type_index_cache_unlock(tindex);
+	if (it.entry)
+		return NULL;
+
+	/*
+	 * Formatting only looks at the type, so it doesn't need any lock. If
+	 * another thread formats the same type concurrently, the first one to
+	 * insert wins.
+	 */
+	lang = drgn_type_language(qualified_type.type);
+	entry.key = qualified_type;
+	if (definition)
+		err = lang->format_type(qualified_type, &entry.value);
+	else
+		err = lang->format_type_name(qualified_type, &entry.value);
+	if (err)
+		return err;
+
+	drgn_type_index_write_lock(tindex);
+	insert_ret = drgn_type_string_map_insert_hashed(map, &entry, hp, &it);
+	if (insert_ret >= 0)
+		*ret = it.entry->value;
+	drgn_type_index_cache_unlock(tindex);
+	if (insert_ret != 1)
+		free(entry.value);
+	if (insert_ret == -1)
+		return &drgn_enomem;
+	return NULL;
+}
+
+struct drgn_error *
+drgn_type_index_format_type_name(struct drgn_type_index *tindex,
+				 struct drgn_qualified_type qualified_type,
+				 const char **ret)
+{
+	return drgn_type_index_format_cached(tindex,
+					     &tindex->formatted_type_names,
+					     qualified_type, false, ret);
+}
+
+struct drgn_error *
+drgn_type_index_format_type(struct drgn_type_index *tindex,
+			    struct drgn_qualified_type qualified_type,
+			    const char **ret)
+{
+	return drgn_type_index_format_cached(tindex, &tindex->formatted_types,
+					     qualified_type, true, ret);
 }
@@ -13,11 +13,15 @@
 #define DRGN_TYPE_INDEX_H
 
 #include <elfutils/libdw.h>
+#include <pthread.h>
 
+#include "arena.h"
 #include "drgn.h"
 #include "hash_table.h"
 #include "language.h"
+#include "profile.h"
 #include "type.h"
+#include "vector.h"
 
 /**
  * @ingroup Internals
@@ -77,6 +81,12 @@ DEFINE_HASH_TABLE_TYPE(drgn_pointer_type_table, struct drgn_type *,
 DEFINE_HASH_TABLE_TYPE(drgn_array_type_table, struct drgn_type *,
 		       drgn_array_type_entry_to_key)
 
+/**
+ * Number of slots in each of @ref drgn_type_index::pointer_type_cache and @ref
+ * drgn_type_index::array_type_cache. This must be a power of two.
+ */
+#define DRGN_DERIVED_TYPE_CACHE_SIZE 256
+
 /** <tt>(type, member name)</tt> pair. */
 struct drgn_member_key {
 	struct drgn_type *type;
@@ -90,6 +100,66 @@ struct drgn_member_value {
 	uint64_t bit_offset, bit_field_size;
 };
 
+/** <tt>(type, value)</tt> pair. */
+struct drgn_enumerator_key {
+	struct drgn_type *type;
+	/** Enumerator value. Signed values are converted to @c uint64_t. */
+	uint64_t value;
+};
+
+/**
+ * Unnamed member whose members haven't been added to @ref
+ * drgn_type_index::members yet.
+ */
+struct drgn_unnamed_member {
+	struct drgn_type_member *member;
+	/** Offset in bits of the containing type in the outer type. */
+	uint64_t bit_offset;
+};
+
+/** Scalar component of a @ref drgn_type_layout. */
+struct drgn_type_leaf {
+	/** Type of the leaf. This may be a typedef or enumerated type. */
+	struct drgn_type *type;
+	/** Kind of object that the leaf is read as. */
+	enum drgn_object_kind kind;
+	/** Offset in bits from the beginning of the containing type. */
+	uint64_t bit_offset;
+	/** Size in bits. This is the bit field size for bit fields. */
+	uint64_t bit_size;
+};
+
+/**
+ * Precomputed layout of a type.
+ *
+ * See @ref drgn_type_index_layout().
+ */
+struct drgn_type_layout {
+	/** Size of the type in bytes, as returned by @ref drgn_type_sizeof(). */
+	uint64_t size;
+	/**
+	 * Alignment of the type in bytes.
+	 *
+	 * The debugging information doesn't include alignment, so this is
+	 * estimated as the size of the largest scalar in the type.
+	 */
+	uint64_t alignment;
+	/** Whether the type contains a bit field. */
+	bool has_bit_fields;
+	/**
+	 * Whether @ref drgn_type_layout::leaves covers the whole type.
+	 *
+	 * This is @c false if the type contains a union, a complex type, or an
+	 * incomplete array, or if it has too many leaves. In that case, the
+	 * leaves are not recorded.
+	 */
+	bool flattened;
+	/** Number of leaves. */
+	size_t num_leaves;
+	/** Scalar leaves of the type in order of increasing offset. */
+	struct drgn_type_leaf *leaves;
+};
+
 #ifdef DOXYGEN
 /**
  * @struct drgn_member_map
@@ -98,22 +168,83 @@ struct drgn_member_value {
  *
  * The key is a @ref drgn_member_key, and the value is a @ref drgn_member_value.
  *
+ * @struct drgn_enumerator_map
+ *
+ * Map of enumerated type values to the first enumerator with that value.
+ *
  * @struct drgn_type_set
  *
  * Set of types compared by address.
+ *
+ * @struct drgn_unnamed_member_vector
+ *
+ * Vector of @ref drgn_unnamed_member.
+ *
+ * @struct drgn_member_pending_map
+ *
+ * Map from a type compared by address to the unnamed members which still need
+ * to be flattened into @ref drgn_type_index::members.
+ *
+ * @struct drgn_type_layout_map
+ *
+ * Map from a type compared by address to its @ref drgn_type_layout.
  */
 #else
 DEFINE_HASH_MAP_TYPE(drgn_member_map, struct drgn_member_key,
 		      struct drgn_member_value)
+DEFINE_HASH_MAP_TYPE(drgn_enumerator_map, struct drgn_enumerator_key,
+		     const struct drgn_type_enumerator *)
 DEFINE_HASH_SET_TYPE(drgn_type_set, struct drgn_type *)
+DEFINE_VECTOR_TYPE(drgn_unnamed_member_vector, struct drgn_unnamed_member)
+DEFINE_HASH_MAP_TYPE(drgn_member_pending_map, struct drgn_type *,
+		      struct drgn_unnamed_member_vector)
+DEFINE_HASH_MAP_TYPE(drgn_type_layout_map, struct drgn_type *,
+		     struct drgn_type_layout *)
 #endif
 
+/** Arguments of a @ref drgn_type_index_find() call. */
+struct drgn_type_name_key {
+	const char *name;
+	/** Filename, or @c NULL. */
+	const char *filename;
+	const struct drgn_language *lang;
+};
+
+DEFINE_HASH_MAP_TYPE(drgn_type_name_map, struct drgn_type_name_key,
+		     struct drgn_qualified_type);
+
+/** Map from a qualified type compared by reference to a formatted string. */
+DEFINE_HASH_MAP_TYPE(drgn_type_string_map, struct drgn_qualified_type, char *);
+
+/** Arguments of a call to a @ref drgn_type_finder. */
+struct drgn_type_finder_memo_key {
+	enum drgn_type_kind kind;
+	const char *name;
+	size_t name_len;
+	/** Filename, or @c NULL. */
+	const char *filename;
+};
+
+/**
+ * Map from the arguments of a call to a @ref drgn_type_finder to its result. A
+ * @c NULL type means that the type was not found.
+ */
+DEFINE_HASH_MAP_TYPE(drgn_type_finder_memo, struct drgn_type_finder_memo_key,
+		     struct drgn_qualified_type);
+
 /** Registered callback in a @ref drgn_type_index. */
 struct drgn_type_finder {
 	/** The callback. */
 	drgn_type_find_fn fn;
 	/** Argument to pass to @ref drgn_type_finder::fn. */
 	void *arg;
+	/** Whether results of @ref fn are memoized in @ref memo. */
+	bool memoize;
+	/**
+	 * Results of previous calls to @ref fn, including types that weren't
+	 * found. The key strings are owned by the map.
+	 */
+	struct drgn_type_finder_memo memo;
 	/** Next callback to try. */
 	struct drgn_type_finder *next;
 };
@@ -130,6 +261,15 @@ struct drgn_type_finder {
  * drgn_type_index_incomplete_array_type() create derived types. Any type
  * returned by these is valid until the type index is destroyed with @ref
  * drgn_type_index_destroy().
+ *
+ * By default, a type index may only be used by one thread at a time. After
+ * @ref drgn_type_index_set_concurrent(), lookups may be done from multiple
+ * threads. Lookups which hit the caches only take @ref cache_lock for reading.
+ * Pointer and array type lookups which hit @ref pointer_type_cache or @ref
+ * array_type_cache don't take any lock.
+ * Misses are serialized by @ref drgn_type_construction_lock(), and they hold
+ * @ref cache_lock for writing only while modifying a cache. Adding and removing
+ * finders must still not race with lookups.
  */
 struct drgn_type_index {
 	/** Callbacks for finding types. */
@@ -142,13 +282,69 @@ struct drgn_type_index {
 	struct drgn_pointer_type_table pointer_types;
 	/** Cache of created array types. */
 	struct drgn_array_type_table array_types;
+	/**
+	 * Direct-mapped caches in front of @ref pointer_types and @ref
+	 * array_types, indexed by the low bits of the key hash.
+	 *
+	 * Created types are never modified or freed until the type index is
+	 * destroyed, so a slot can be read with an acquire load and no lock,
+	 * and the type's key compared with the one being looked up. Racing
+	 * stores to a slot are harmless, since any type stored is valid.
+	 */
+	struct drgn_type *pointer_type_cache[DRGN_DERIVED_TYPE_CACHE_SIZE];
+	struct drgn_type *array_type_cache[DRGN_DERIVED_TYPE_CACHE_SIZE];
 	/** Cache for @ref drgn_type_index_find_member(). */
 	struct drgn_member_map members;
+	/** Profiling state of the program, or @c NULL. */
+	struct drgn_profile *profile;
 	/**
-	 * Set of types which have been already cached in @ref
+	 * Types whose named members have been cached in @ref
 	 * drgn_type_index::members.
+	 *
+	 * Members of unnamed members are only added when a lookup doesn't find
+	 * a member otherwise, so each type maps to the unnamed members that
+	 * haven't been flattened yet. An empty vector means that the type has
+	 * been completely cached.
+	 */
+	struct drgn_member_pending_map members_pending;
+	/** Cache for @ref drgn_type_index_find_enumerator(). */
+	struct drgn_enumerator_map enumerators;
+	/**
+	 * Set of types which have been already cached in @ref
+	 * drgn_type_index::enumerators.
 	 */
-	struct drgn_type_set members_cached;
+	struct drgn_type_set enumerators_cached;
+	/**
+	 * Cache of successful @ref drgn_type_index_find() calls, including
+	 * derived types, so that type names don't need to be parsed again.
+	 * The key strings are owned by the map.
+	 */
+	struct drgn_type_name_map names;
+	/** Cache for @ref drgn_type_index_layout(). */
+	struct drgn_type_layout_map layouts;
+	/**
+	 * Cache for @ref drgn_type_index_format_type_name(). The strings are
+	 * owned by the map.
+	 */
+	struct drgn_type_string_map formatted_type_names;
+	/**
+	 * Cache for @ref drgn_type_index_format_type(). The strings are owned
+	 * by the map.
+	 */
+	struct drgn_type_string_map formatted_types;
+	/** Memory for created pointer and array types. */
+	struct drgn_arena arena;
+	/**
+	 * Lock protecting the caches in concurrent mode.
+	 *
+	 * This protects @ref pointer_types, @ref array_types, @ref members,
+	 * @ref names, @ref enumerators, @ref layouts, @ref
+	 * formatted_type_names, and @ref formatted_types. Everything else is
+	 * only accessed with @ref drgn_type_construction_lock() held.
+	 */
+	pthread_rwlock_t cache_lock;
+	/** Whether the type index may be used from multiple threads. */
+	bool concurrent;
 	/**
 	 * Size of a pointer in bytes.
 	 *
@@ -167,9 +363,49 @@ void drgn_type_index_init(struct drgn_type_index *tindex);
 /** Deinitialize a @ref drgn_type_index. */
 void drgn_type_index_deinit(struct drgn_type_index *tindex);
 
-/** @sa drgn_program_add_type_finder() */
+/**
+ * Get the number of bytes allocated by a @ref drgn_type_index for its caches
+ * and created types.
+ */
+size_t drgn_type_index_memory_usage(struct drgn_type_index *tindex);
+
+/**
+ * Allow a @ref drgn_type_index to be used from multiple threads.
+ *
+ * This cannot be undone. It must be called before the type index is shared
+ * between threads.
+ */
+void drgn_type_index_set_concurrent(struct drgn_type_index *tindex);
+
+/**
+ * Serialize with cache misses in a @ref drgn_type_index.
+ *
+ * This is a no-op unless the type index is in concurrent mode. It is used to
+ * protect state that is only reached through type finders, like debugging
+ * information caches.
+ */
+static inline void drgn_type_index_lock(struct drgn_type_index *tindex)
+{
+	if (tindex->concurrent)
+		drgn_type_construction_lock();
+}
+
+/** Release the lock acquired by @ref drgn_type_index_lock(). */
+static inline void drgn_type_index_unlock(struct drgn_type_index *tindex)
+{
+	if (tindex->concurrent)
+		drgn_type_construction_unlock();
+}
+
+/**
+ * @sa drgn_program_add_type_finder()
+ *
+ * @param[in] memoize Whether to remember the results of @p fn. @sa
+ * drgn_program_add_memoized_type_finder()
+ */
 struct drgn_error *drgn_type_index_add_finder(struct drgn_type_index *tindex,
-					      drgn_type_find_fn fn, void *arg);
+					      drgn_type_find_fn fn, void *arg,
+					      bool memoize);
 
 /**
  * Remove the most recently added type finding callback.
@@ -210,6 +446,8 @@ drgn_type_index_find_parsed(struct drgn_type_index *tindex,
  * Find a type in a @ref drgn_type_index.
  *
  * The returned type is valid for the lifetime of the @ref drgn_type_index.
+ * Successful results are cached until @ref drgn_type_index_flush_names() is
+ * called or a finder is added or removed.
  *
  * @param[in] tindex Type index.
  * @param[in] name Name of the type.
@@ -219,13 +457,18 @@ drgn_type_index_find_parsed(struct drgn_type_index *tindex,
  * @param[out] ret Returned type.
  * @return @c NULL on success, non-@c NULL on error.
  */
-static inline struct drgn_error *
-drgn_type_index_find(struct drgn_type_index *tindex, const char *name,
-		     const char *filename, const struct drgn_language *lang,
-		     struct drgn_qualified_type *ret)
-{
-	return lang->find_type(tindex, name, filename, ret);
-}
+struct drgn_error *drgn_type_index_find(struct drgn_type_index *tindex,
+					const char *name, const char *filename,
+					const struct drgn_language *lang,
+					struct drgn_qualified_type *ret);
+
+/**
+ * Forget the cached results of @ref drgn_type_index_find().
+ *
+ * This must be called when the types returned by the finders may have changed
+ * (e.g., because more debugging information was loaded).
+ */
+void drgn_type_index_flush_names(struct drgn_type_index *tindex);
 
 /**
  * Create a pointer type.
@@ -303,7 +546,10 @@ drgn_type_index_incomplete_array_type(struct drgn_type_index *tindex,
  * This matches the members of the type itself as well as the members of any
  * unnamed members of the type.
  *
- * This caches all members of @p type for subsequent calls.
+ * The named members of @p type are cached on the first call. Unnamed members
+ * are only evaluated and flattened into the cache when a member isn't found
+ * otherwise, so looking up the direct members of a large type doesn't
+ * evaluate the types of any of its members.
  *
  * @param[in] tindex Type index.
  * @param[in] type Compound type to search in.
@@ -316,7 +562,68 @@ struct drgn_error *drgn_type_index_find_member(struct drgn_type_index *tindex,
 					       struct drgn_type *type,
 					       const char *member_name,
 					       size_t member_name_len,
-					       struct drgn_member_value **ret);
+					       struct drgn_member_value *ret);
+
+/**
+ * Find the enumerator of an enumerated type with a given value.
+ *
+ * If more than one enumerator has the value, this finds the first one. Large
+ * types are indexed on the first call; small types are searched linearly.
+ *
+ * @param[in] tindex Type index.
+ * @param[in] type Complete enumerated type.
+ * @param[in] value Value to find. If @p type is signed, this is the signed
+ * value converted to @c uint64_t.
+ * @param[out] ret Returned enumerator.
+ * @return @c NULL on success, @ref drgn_not_found if no enumerator has the
+ * value, non-@c NULL on other errors.
+ */
+struct drgn_error *
+drgn_type_index_find_enumerator(struct drgn_type_index *tindex,
+				struct drgn_type *type, uint64_t value,
+				const struct drgn_type_enumerator **ret);
+
+/**
+ * Get the precomputed layout of a type.
+ *
+ * The layout is computed the first time it is requested and is valid for the
+ * lifetime of the @ref drgn_type_index.
+ *
+ * @param[in] tindex Type index.
+ * @param[in] type Complete type with a size.
+ * @param[out] ret Returned layout.
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *drgn_type_index_layout(struct drgn_type_index *tindex,
+					  struct drgn_type *type,
+					  const struct drgn_type_layout **ret);
+
+/**
+ * Get the name of a type, like @ref drgn_format_type_name(), using a cache.
+ *
+ * The type must be valid for the lifetime of the @ref drgn_type_index (i.e., it
+ * must have been created by the type index or be kept alive by the program).
+ *
+ * @param[in] tindex Type index.
+ * @param[in] qualified_type Type to format.
+ * @param[out] ret Returned string. It is valid for the lifetime of the @ref
+ * drgn_type_index and must not be freed.
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *
+drgn_type_index_format_type_name(struct drgn_type_index *tindex,
+				 struct drgn_qualified_type qualified_type,
+				 const char **ret);
+
+/**
+ * Get the definition of a type, like @ref drgn_format_type(), using a cache.
+ *
+ * @sa drgn_type_index_format_type_name()
+ */
+struct drgn_error *
+drgn_type_index_format_type(struct drgn_type_index *tindex,
+			    struct drgn_qualified_type qualified_type,
+			    const char **ret);
 
 /** @} */
 
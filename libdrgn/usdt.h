@@ -0,0 +1,47 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Userspace statically defined tracing probes.
+ *
+ * See @ref USDT.
+ */
+
+#ifndef DRGN_USDT_H
+#define DRGN_USDT_H
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup USDT USDT probes
+ *
+ * Static probe points for tracing libdrgn.
+ *
+ * If libdrgn is built with <tt>sys/sdt.h</tt> (from SystemTap), each probe
+ * point is a single @c nop which tools like bpftrace and perf can attach to,
+ * e.g., <tt>bpftrace -e 'usdt:_drgn.*.so:drgn:memory_read { ... }'</tt>.
+ * Otherwise, the probes compile to nothing, and their arguments are not
+ * evaluated. With probes, the arguments are evaluated even when nothing is
+ * attached, so they should be cheap and must not have side effects.
+ *
+ * Operations with a latency have a @c _begin probe and an @c _end probe so
+ * that the tracer can time them, except for memory reads, which libdrgn
+ * already times for @ref drgn_memory_stats.
+ *
+ * @{
+ */
+
+#ifdef WITH_USDT
+#include <sys/sdt.h>
+
+/** Fire the USDT probe @c drgn:name with the given arguments. */
+#define DRGN_PROBE(name, ...) STAP_PROBEV(drgn, name, ##__VA_ARGS__)
+#else
+#define DRGN_PROBE(name, ...) do {} while (0)
+#endif
+
+/** @} */
+
+#endif /* DRGN_USDT_H */
@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #ifdef NDEBUG
 #define UNREACHABLE() __builtin_unreachable()
@@ -178,4 +179,22 @@ static inline void *malloc64(uint64_t size)
 	return malloc(size);
 }
 
+/** Get the current time of the monotonic clock in nanoseconds. */
+static inline uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Get the CPU time used by all threads of the process in nanoseconds. */
+static inline uint64_t process_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 #endif /* DRGN_UTIL_H */
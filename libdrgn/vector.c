@@ -60,3 +60,45 @@ bool vector_reserve_for_append(size_t size, size_t entry_size, void **data,
 	*capacity = new_capacity;
 	return true;
 }
+
+bool small_vector_do_reserve(size_t new_capacity, size_t size,
+			     size_t entry_size, void **data, size_t *capacity,
+			     void *inline_data)
+{
+	size_t bytes;
+	void *new_data;
+
+	if (*data != inline_data) {
+		return vector_do_reserve(new_capacity, entry_size, data,
+					 capacity);
+	}
+	if (new_capacity <= *capacity)
+		return true;
+	if (__builtin_mul_overflow(new_capacity, entry_size, &bytes))
+		return false;
+	new_data = malloc(bytes);
+	if (!new_data)
+		return false;
+	memcpy(new_data, inline_data, size * entry_size);
+	*data = new_data;
+	*capacity = new_capacity;
+	return true;
+}
+
+bool small_vector_reserve_for_append(size_t size, size_t entry_size,
+				     void **data, size_t *capacity,
+				     void *inline_data)
+{
+	size_t new_capacity;
+
+	if (*data != inline_data) {
+		return vector_reserve_for_append(size, entry_size, data,
+						 capacity);
+	}
+	if (size < *capacity)
+		return true;
+	if (__builtin_mul_overflow(2U, *capacity, &new_capacity))
+		return false;
+	return small_vector_do_reserve(new_capacity, size, entry_size, data,
+				       capacity, inline_data);
+}
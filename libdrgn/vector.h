@@ -29,6 +29,9 @@
  * interface is prefixed with a given name; the interface documented here uses
  * the example name @c vector.
  *
+ * @ref DEFINE_SMALL_VECTOR() defines a vector with room for a few entries
+ * inside the vector itself, for short-lived vectors that are usually small.
+ *
  * @{
  */
 
@@ -95,6 +98,9 @@ bool vector_reserve(struct vector *vector, size_t capacity);
  */
 void vector_shrink_to_fit(struct vector *vector);
 
+/** Get the number of bytes allocated for @ref vector::data. */
+size_t vector_memory_usage(struct vector *vector);
+
 /**
  * Append to a @ref vector.
  *
@@ -133,6 +139,12 @@ void vector_do_shrink_to_fit(size_t size, size_t entry_size, void **data,
 			     size_t *capacity);
 bool vector_reserve_for_append(size_t size, size_t entry_size, void **data,
 			       size_t *capacity);
+bool small_vector_do_reserve(size_t new_capacity, size_t size,
+			     size_t entry_size, void **data, size_t *capacity,
+			     void *inline_data);
+bool small_vector_reserve_for_append(size_t size, size_t entry_size,
+				     void **data, size_t *capacity,
+				     void *inline_data);
 
 /**
  * Define a vector type without defining its functions.
@@ -191,6 +203,12 @@ static void vector##_shrink_to_fit(struct vector *vector)			\
 				(void **)&vector->data, &vector->capacity);	\
 }										\
 										\
+__attribute__((unused))								\
+static size_t vector##_memory_usage(struct vector *vector)			\
+{										\
+	return vector->capacity * sizeof(*vector->data);			\
+}										\
+										\
 static vector##_entry_type *vector##_append_entry(struct vector *vector)	\
 {										\
 	if (!vector_reserve_for_append(vector->size, sizeof(*vector->data),	\
@@ -232,6 +250,128 @@ static vector##_entry_type *vector##_pop(struct vector *vector)			\
 DEFINE_VECTOR_TYPE(vector, entry_type)		\
 DEFINE_VECTOR_FUNCTIONS(vector)
 
+/**
+ * Define a vector interface with inline storage for a number of entries.
+ *
+ * This defines the same interface as @ref DEFINE_VECTOR(), but the vector
+ * starts out using an array of @p inline_capacity entries embedded in the
+ * vector, and only allocates memory once it grows past that. This avoids
+ * allocating at all for vectors that are usually small.
+ *
+ * Because @c data points into the vector itself while it is inline, the vector
+ * must be initialized with <tt>vector_init()</tt> (there is no static
+ * initializer), must not be copied or moved, and its @c data must not be
+ * returned or freed directly. Use <tt>vector_steal()</tt> to get a heap
+ * allocated array instead:
+ *
+ * @code{.c}
+ * // Return a copy of the entries (or the heap array, if it was already
+ * // allocated) that must be freed with free(), and deinitialize the vector.
+ * // On failure, the vector is unchanged.
+ * bool vector_steal(struct vector *vector, entry_type **ret);
+ * @endcode
+ *
+ * <tt>vector_memory_usage()</tt> only counts memory allocated outside of the
+ * vector, and <tt>vector_shrink_to_fit()</tt> is not defined.
+ *
+ * @param[in] vector Name of the type to define.
+ * @param[in] entry_type Type of entries in the vector.
+ * @param[in] inline_capacity Number of entries stored inline. Must be
+ * non-zero.
+ */
+#define DEFINE_SMALL_VECTOR(vector, entry_type, inline_capacity)		\
+typedef typeof(entry_type) vector##_entry_type;					\
+										\
+struct vector {									\
+	vector##_entry_type *data;						\
+	size_t size;								\
+	size_t capacity;							\
+	vector##_entry_type inline_data[inline_capacity];			\
+};										\
+										\
+__attribute__((unused))								\
+static void vector##_init(struct vector *vector)				\
+{										\
+	vector->data = vector->inline_data;					\
+	vector->size = 0;							\
+	vector->capacity = inline_capacity;					\
+}										\
+										\
+__attribute__((unused))								\
+static void vector##_deinit(struct vector *vector)				\
+{										\
+	if (vector->data != vector->inline_data)				\
+		free(vector->data);						\
+}										\
+										\
+__attribute__((unused))								\
+static bool vector##_reserve(struct vector *vector, size_t capacity)		\
+{										\
+	return small_vector_do_reserve(capacity, vector->size,			\
+				       sizeof(*vector->data),			\
+				       (void **)&vector->data,			\
+				       &vector->capacity,			\
+				       vector->inline_data);			\
+}										\
+										\
+__attribute__((unused))								\
+static size_t vector##_memory_usage(struct vector *vector)			\
+{										\
+	if (vector->data == vector->inline_data)				\
+		return 0;							\
+	return vector->capacity * sizeof(*vector->data);			\
+}										\
+										\
+static vector##_entry_type *vector##_append_entry(struct vector *vector)	\
+{										\
+	if (!small_vector_reserve_for_append(vector->size,			\
+					     sizeof(*vector->data),		\
+					     (void **)&vector->data,		\
+					     &vector->capacity,			\
+					     vector->inline_data))		\
+		return NULL;							\
+	return &vector->data[vector->size++];					\
+}										\
+										\
+__attribute__((unused))								\
+static bool vector##_append(struct vector *vector,				\
+			    const vector##_entry_type *entry)			\
+{										\
+	vector##_entry_type *new_entry;						\
+										\
+	new_entry = vector##_append_entry(vector);				\
+	if (!new_entry)								\
+		return false;							\
+	memcpy(new_entry, entry, sizeof(*entry));				\
+	return true;								\
+}										\
+										\
+__attribute__((unused))								\
+static vector##_entry_type *vector##_pop(struct vector *vector)			\
+{										\
+	return &vector->data[--vector->size];					\
+}										\
+										\
+__attribute__((unused))								\
+static bool vector##_steal(struct vector *vector, vector##_entry_type **ret)	\
+{										\
+	vector##_entry_type *data;						\
+										\
+	if (vector->data != vector->inline_data) {				\
+		vector_do_shrink_to_fit(vector->size, sizeof(*vector->data),	\
+					(void **)&vector->data,			\
+					&vector->capacity);			\
+		*ret = vector->data;						\
+		return true;							\
+	}									\
+	data = malloc(vector->size ? vector->size * sizeof(*data) : 1);		\
+	if (!data)								\
+		return false;							\
+	memcpy(data, vector->data, vector->size * sizeof(*data));		\
+	*ret = data;								\
+	return true;								\
+}
+
 /**
  * Empty vector initializer.
  *
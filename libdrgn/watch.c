@@ -0,0 +1,186 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+#include "memory_reader.h"
+#include "program.h"
+#include "watch.h"
+
+struct drgn_watch_sort_entry {
+	uint64_t address;
+	uint64_t size;
+	size_t index;
+};
+
+static int drgn_watch_sort_entry_cmp(const void *_a, const void *_b)
+{
+	const struct drgn_watch_sort_entry *a = _a, *b = _b;
+
+	if (a->address != b->address)
+		return a->address < b->address ? -1 : 1;
+	if (a->index != b->index)
+		return a->index < b->index ? -1 : 1;
+	return 0;
+}
+
+/* Whether a range starting at address should be read with the previous one. */
+static bool drgn_watch_coalesce(uint64_t end, uint64_t address)
+{
+	uint64_t page_mask = ~(DRGN_MEMORY_CACHE_PAGE_SIZE - 1);
+
+	if (address <= end)
+		return true;
+	return (address - end <= DRGN_WATCH_MAX_GAP ||
+		(address & page_mask) == ((end - 1) & page_mask));
+}
+
+struct drgn_error *drgn_watch_create(struct drgn_program *prog,
+				     const uint64_t *addresses,
+				     const uint64_t *sizes, size_t num_items,
+				     struct drgn_watch **ret)
+{
+	struct drgn_error *err;
+	struct drgn_watch *watch;
+	struct drgn_watch_sort_entry *sorted;
+	uint64_t start = 0, end = 0;
+	size_t buf_size = 0, i;
+
+	for (i = 0; i < num_items; i++) {
+		if (!sizes[i] || sizes[i] > SIZE_MAX ||
+		    sizes[i] - 1 > UINT64_MAX - addresses[i]) {
+			return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+						 "invalid watch range");
+		}
+	}
+
+	watch = calloc(1, sizeof(*watch));
+	if (!watch)
+		return &drgn_enomem;
+	watch->prog = prog;
+	watch->num_items = num_items;
+	sorted = malloc_array(max(num_items, (size_t)1), sizeof(*sorted));
+	watch->offsets = malloc_array(max(num_items, (size_t)1),
+				      sizeof(*watch->offsets));
+	watch->sizes = malloc_array(max(num_items, (size_t)1),
+				    sizeof(*watch->sizes));
+	watch->changed = malloc_array(max(num_items, (size_t)1),
+				      sizeof(*watch->changed));
+	/* There can't be more reads than ranges. */
+	watch->requests = malloc_array(max(num_items, (size_t)1),
+				       sizeof(*watch->requests));
+	watch->request_offsets = malloc_array(max(num_items, (size_t)1),
+					      sizeof(*watch->request_offsets));
+	if (!sorted || !watch->offsets || !watch->sizes || !watch->changed ||
+	    !watch->requests || !watch->request_offsets) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	for (i = 0; i < num_items; i++) {
+		sorted[i].address = addresses[i];
+		sorted[i].size = watch->sizes[i] = sizes[i];
+		sorted[i].index = i;
+	}
+	qsort(sorted, num_items, sizeof(*sorted), drgn_watch_sort_entry_cmp);
+
+	/*
+	 * Coalesce the sorted ranges into reads. end is one past the last byte
+	 * of the current read, or 0 if it ends at the top of the address space.
+	 */
+	for (i = 0; i < num_items; i++) {
+		uint64_t item_end = sorted[i].address + sorted[i].size;
+		struct drgn_memory_read_request *request;
+
+		if (watch->num_requests &&
+		    (!end || drgn_watch_coalesce(end, sorted[i].address))) {
+			request = &watch->requests[watch->num_requests - 1];
+			if (end && (!item_end || item_end > end)) {
+				buf_size += (item_end ? item_end : 0) - end;
+				end = item_end;
+				request->count = end - start;
+			}
+		} else {
+			request = &watch->requests[watch->num_requests];
+			watch->request_offsets[watch->num_requests++] =
+				buf_size;
+			start = sorted[i].address;
+			end = item_end;
+			request->address = start;
+			request->count = sorted[i].size;
+			request->physical = false;
+			buf_size += sorted[i].size;
+		}
+		watch->offsets[sorted[i].index] =
+			(watch->request_offsets[watch->num_requests - 1] +
+			 (sorted[i].address - start));
+	}
+
+	watch->buf_size = buf_size;
+	watch->buf = malloc(max(buf_size, (size_t)1));
+	watch->prev = malloc(max(buf_size, (size_t)1));
+	if (!watch->buf || !watch->prev) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	free(sorted);
+	*ret = watch;
+	return NULL;
+
+err:
+	free(sorted);
+	drgn_watch_destroy(watch);
+	return err;
+}
+
+void drgn_watch_destroy(struct drgn_watch *watch)
+{
+	if (watch) {
+		free(watch->prev);
+		free(watch->buf);
+		free(watch->request_offsets);
+		free(watch->requests);
+		free(watch->changed);
+		free(watch->sizes);
+		free(watch->offsets);
+		free(watch);
+	}
+}
+
+struct drgn_error *drgn_watch_sample(struct drgn_watch *watch,
+				     const size_t **changed_ret,
+				     size_t *num_changed_ret)
+{
+	struct drgn_error *err;
+	size_t num_changed = 0, i;
+	char *tmp;
+
+	/* Cached pages of a running program may be stale. */
+	if (watch->prog->flags & DRGN_PROGRAM_IS_LIVE)
+		drgn_program_invalidate_memory_cache(watch->prog);
+	/* Read into the older buffer to keep the latest sample on error. */
+	for (i = 0; i < watch->num_requests; i++) {
+		watch->requests[i].buf = (watch->prev +
+					  watch->request_offsets[i]);
+	}
+	err = drgn_program_read_memory_batch(watch->prog, watch->requests,
+					     watch->num_requests);
+	if (err)
+		return err;
+	tmp = watch->buf;
+	watch->buf = watch->prev;
+	watch->prev = tmp;
+
+	for (i = 0; i < watch->num_items; i++) {
+		if (!watch->sampled ||
+		    memcmp(watch->buf + watch->offsets[i],
+			   watch->prev + watch->offsets[i],
+			   watch->sizes[i]) != 0)
+			watch->changed[num_changed++] = i;
+	}
+	watch->sampled = true;
+	*changed_ret = watch->changed;
+	*num_changed_ret = num_changed;
+	return NULL;
+}
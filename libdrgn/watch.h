@@ -0,0 +1,112 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Watching memory for changes.
+ *
+ * See @ref Watches.
+ */
+
+#ifndef DRGN_WATCH_H
+#define DRGN_WATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct drgn_memory_read_request;
+struct drgn_program;
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup Watches Watches
+ *
+ * Repeatedly sampling ranges of memory.
+ *
+ * A watch is created once for a set of ranges (e.g., the values of objects
+ * that are monitored on a live kernel). Ranges which are in the same page or
+ * close together are coalesced into one read, so each sample is a single
+ * batch of a minimal number of reads, and only the ranges whose contents
+ * changed since the previous sample are reported.
+ *
+ * @{
+ */
+
+/** Ranges further apart than this in different pages are read separately. */
+#define DRGN_WATCH_MAX_GAP 64
+
+/** Set of memory ranges which are sampled together. */
+struct drgn_watch {
+	/** Program that the ranges are in. */
+	struct drgn_program *prog;
+	/** Number of watched ranges. */
+	size_t num_items;
+	/** Offset of each watched range in @ref buf. */
+	size_t *offsets;
+	/** Size of each watched range. */
+	uint64_t *sizes;
+	/** Coalesced reads. */
+	struct drgn_memory_read_request *requests;
+	/** Offset of each read in @ref buf. */
+	size_t *request_offsets;
+	size_t num_requests;
+	/** Contents of the ranges from the latest sample. */
+	char *buf;
+	/** Contents of the ranges from the sample before that. */
+	char *prev;
+	/** Size of @ref buf and @ref prev. */
+	size_t buf_size;
+	/** Indices of the ranges which changed in the latest sample. */
+	size_t *changed;
+	/** Whether the ranges have been sampled yet. */
+	bool sampled;
+};
+
+/**
+ * Create a @ref drgn_watch.
+ *
+ * @param[in] addresses Virtual address of each range.
+ * @param[in] sizes Size of each range.
+ * @param[in] num_items Number of ranges.
+ * @param[out] ret Returned watch. It must be freed with @ref
+ * drgn_watch_destroy().
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *drgn_watch_create(struct drgn_program *prog,
+				     const uint64_t *addresses,
+				     const uint64_t *sizes, size_t num_items,
+				     struct drgn_watch **ret);
+
+/** Free a @ref drgn_watch. */
+void drgn_watch_destroy(struct drgn_watch *watch);
+
+/**
+ * Read the ranges of a @ref drgn_watch again.
+ *
+ * If the program is running, its memory read cache is invalidated first so
+ * that the ranges are read from memory.
+ *
+ * @param[out] changed_ret Returned indices of the ranges whose contents changed
+ * since the previous sample, in increasing order. Every range is included on
+ * the first sample. This is valid until the next sample.
+ * @param[out] num_changed_ret Returned number of changed ranges.
+ * @return @c NULL on success, non-@c NULL on error (e.g., if any of the ranges
+ * fault). On error, the previous sample is kept.
+ */
+struct drgn_error *drgn_watch_sample(struct drgn_watch *watch,
+				     const size_t **changed_ret,
+				     size_t *num_changed_ret);
+
+/** Get the contents of a range from the latest sample of a @ref drgn_watch. */
+static inline const char *drgn_watch_data(const struct drgn_watch *watch,
+					  size_t i)
+{
+	return watch->buf + watch->offsets[i];
+}
+
+/** @} */
+
+#endif /* DRGN_WATCH_H */
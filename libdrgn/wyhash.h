@@ -0,0 +1,122 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/*
+ * wyhash, a fast non-cryptographic hash function by Wang Yi, which mostly
+ * works by multiplying 64-bit words into 128-bit products. This follows the
+ * final version 4 of the reference implementation. It is only used for
+ * in-memory hash tables, so its values are never persisted and the algorithm
+ * may change.
+ */
+
+#ifndef DRGN_WYHASH_H
+#define DRGN_WYHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __SIZEOF_INT128__
+
+static inline void wyhash_mum(uint64_t *a, uint64_t *b)
+{
+	unsigned __int128 r = (unsigned __int128)*a * *b;
+
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+}
+
+static inline uint64_t wyhash_mix(uint64_t a, uint64_t b)
+{
+	wyhash_mum(&a, &b);
+	return a ^ b;
+}
+
+static inline uint64_t wyhash_read64(const uint8_t *p)
+{
+	return ((uint64_t)p[0] |
+		((uint64_t)p[1] <<  8) |
+		((uint64_t)p[2] << 16) |
+		((uint64_t)p[3] << 24) |
+		((uint64_t)p[4] << 32) |
+		((uint64_t)p[5] << 40) |
+		((uint64_t)p[6] << 48) |
+		((uint64_t)p[7] << 56));
+}
+
+static inline uint64_t wyhash_read32(const uint8_t *p)
+{
+	return ((uint64_t)p[0] |
+		((uint64_t)p[1] <<  8) |
+		((uint64_t)p[2] << 16) |
+		((uint64_t)p[3] << 24));
+}
+
+/* Read 1-3 bytes. */
+static inline uint64_t wyhash_read_small(const uint8_t *p, size_t len)
+{
+	return (((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) |
+		p[len - 1]);
+}
+
+static const uint64_t wyhash_secret[4] = {
+	UINT64_C(0x2d358dccaa6c78a5),
+	UINT64_C(0x8bb84b93962eacc9),
+	UINT64_C(0x4b33a62ed433d4a3),
+	UINT64_C(0x4d5a2da51de1aa47),
+};
+
+static inline uint64_t wyhash64(const void *data, size_t len, uint64_t seed)
+{
+	const uint8_t *p = data;
+	uint64_t a, b;
+
+	seed ^= wyhash_mix(seed ^ wyhash_secret[0], wyhash_secret[1]);
+	if (__builtin_expect(len <= 16, 1)) {
+		if (__builtin_expect(len >= 4, 1)) {
+			size_t shift = (len >> 3) << 2;
+
+			a = (wyhash_read32(p) << 32) | wyhash_read32(p + shift);
+			b = ((wyhash_read32(p + len - 4) << 32) |
+			     wyhash_read32(p + len - 4 - shift));
+		} else if (__builtin_expect(len > 0, 1)) {
+			a = wyhash_read_small(p, len);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t i = len;
+
+		if (__builtin_expect(i > 48, 0)) {
+			uint64_t see1 = seed, see2 = seed;
+
+			do {
+				seed = wyhash_mix(wyhash_read64(p) ^ wyhash_secret[1],
+						  wyhash_read64(p + 8) ^ seed);
+				see1 = wyhash_mix(wyhash_read64(p + 16) ^ wyhash_secret[2],
+						  wyhash_read64(p + 24) ^ see1);
+				see2 = wyhash_mix(wyhash_read64(p + 32) ^ wyhash_secret[3],
+						  wyhash_read64(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (__builtin_expect(i > 48, 1));
+			seed ^= see1 ^ see2;
+		}
+		while (__builtin_expect(i > 16, 0)) {
+			seed = wyhash_mix(wyhash_read64(p) ^ wyhash_secret[1],
+					  wyhash_read64(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = wyhash_read64(p + i - 16);
+		b = wyhash_read64(p + i - 8);
+	}
+	a ^= wyhash_secret[1];
+	b ^= seed;
+	wyhash_mum(&a, &b);
+	return wyhash_mix(a ^ wyhash_secret[0] ^ len, b ^ wyhash_secret[1]);
+}
+
+#endif /* __SIZEOF_INT128__ */
+
+#endif /* DRGN_WYHASH_H */
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+# Microbenchmarks for the core operations of the Python bindings: memory reads,
+# type and member lookups, and creating, reading, and formatting objects. Each
+# benchmark prints one line in a fixed order, so that the output of two builds
+# can be compared directly. The C equivalents are run by "make bench" in
+# libdrgn. E.g.:
+# scripts/bench_core.py -n 100000
+
+import argparse
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+
+import drgn  # noqa: E402
+
+
+def bench(name, n, func, repeat):
+    # Report the best of several runs, which is much more stable than the mean.
+    best = float("inf")
+    for _ in range(repeat):
+        start = time.perf_counter()
+        func()
+        best = min(best, time.perf_counter() - start)
+    print(f"{name}: {best * 1e9 / n:.1f} ns/op")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="benchmark core operations")
+    parser.add_argument(
+        "-n",
+        type=int,
+        default=100000,
+        help="number of operations per benchmark (default: 100000)",
+    )
+    parser.add_argument(
+        "-r",
+        "--repeat",
+        type=int,
+        default=5,
+        help="number of runs of each benchmark (default: 5)",
+    )
+    args = parser.parse_args()
+    n = args.n
+    repeat = args.repeat
+
+    memory = os.urandom(1 << 20)
+
+    def read_fn(address, count, offset, physical):
+        return memory[offset : offset + count]
+
+    int_type = drgn.int_type("int", 4, True)
+    point_type = drgn.struct_type(
+        "point",
+        8,
+        (drgn.TypeMember(int_type, "x", 0), drgn.TypeMember(int_type, "y", 32)),
+    )
+
+    def type_find(kind, name, filename):
+        if kind == drgn.TypeKind.STRUCT and name == "point":
+            return point_type
+        return None
+
+    prog = drgn.Program(drgn.host_platform)
+    prog.add_memory_segment(0x10000, len(memory), read_fn)
+    prog.add_type_finder(type_find)
+    addresses = [0x10000 + (i * 4104) % (len(memory) - 8) for i in range(n)]
+    obj = drgn.Object(prog, point_type, address=0x10000)
+
+    bench("Program.read(8)", n, lambda: [prog.read(a, 8) for a in addresses], repeat)
+    bench(
+        "Program.read_u64()",
+        n,
+        lambda: [prog.read_u64(a) for a in addresses],
+        repeat,
+    )
+    bench(
+        "Program.try_read() fault",
+        n,
+        lambda: [prog.try_read(8, 8) for _ in addresses],
+        repeat,
+    )
+    bench(
+        "Program.type('struct point')",
+        n,
+        lambda: [prog.type("struct point") for _ in addresses],
+        repeat,
+    )
+    bench(
+        "Program.type('unsigned long')",
+        n,
+        lambda: [prog.type("unsigned long") for _ in addresses],
+        repeat,
+    )
+    bench(
+        "Program.member_path(point, 'y')",
+        n,
+        lambda: [prog.member_path(point_type, "y") for _ in addresses],
+        repeat,
+    )
+    bench(
+        "Object(point, address=...)",
+        n,
+        lambda: [drgn.Object(prog, point_type, address=a) for a in addresses],
+        repeat,
+    )
+    bench("Object.y", n, lambda: [obj.y for _ in addresses], repeat)
+    bench("int(Object.y)", n, lambda: [int(obj.y) for _ in addresses], repeat)
+    bench(
+        "Object.format_()",
+        n // 10 or 1,
+        lambda: [obj.format_() for _ in range(n // 10 or 1)],
+        repeat,
+    )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+# Measure the time and memory used to load and index debugging information,
+# e.g.: scripts/bench_debug_info.py /usr/lib/debug/lib/modules/$(uname -r)/vmlinux
+
+import argparse
+import os
+import resource
+import time
+
+import drgn
+
+
+def max_rss_kib():
+    return resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="benchmark loading debugging information"
+    )
+    parser.add_argument("files", metavar="FILE", nargs="+", help="ELF file to load")
+    args = parser.parse_args()
+
+    # Make sure that the numbers don't depend on the state of the cache.
+    os.environ["DRGN_DWARF_INDEX_CACHE_DIR"] = ""
+
+    prog = drgn.Program()
+    rss_before = max_rss_kib()
+    start = time.perf_counter()
+    prog.load_debug_info(args.files)
+    elapsed = time.perf_counter() - start
+    rss_after = max_rss_kib()
+    print(f"time: {elapsed:.3f} s")
+    print(
+        f"max RSS: {rss_after / 1024:.1f} MiB "
+        f"(+{(rss_after - rss_before) / 1024:.1f} MiB)"
+    )
+
+    stats = prog.debug_info_stats()
+    for phase in ("report", "read", "index", "cache_write"):
+        line = f"{phase}: {stats[phase + '_ns'] / 1e9:.3f} s"
+        if phase + "_cpu_ns" in stats:
+            line += f" ({stats[phase + '_cpu_ns'] / 1e9:.3f} s CPU)"
+        print(line)
+    print(
+        f"{stats['modules']} modules, {stats['cus']} CUs, {stats['dies']} DIEs, "
+        f"{stats['debug_info_bytes'] / (1024 * 1024):.1f} MiB of .debug_info"
+    )
+    slowest = sorted(
+        stats["module_stats"], key=lambda m: m["read_ns"] + m["index_ns"], reverse=True
+    )
+    for module in slowest[:5]:
+        print(
+            f"  {module['name']}: read {module['read_ns'] / 1e9:.3f} s, "
+            f"index {module['index_ns'] / 1e9:.3f} s"
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+# Microbenchmarks for looking up interned pointer and array types, which
+# address_of_(), casts, and pointer arithmetic do for almost every object, e.g.:
+# scripts/bench_derived_types.py -n 1000000
+
+import argparse
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+
+import drgn  # noqa: E402
+
+
+def bench(name, n, func):
+    start = time.perf_counter()
+    func()
+    elapsed = time.perf_counter() - start
+    print(f"{name}: {elapsed * 1e9 / n:.1f} ns/lookup")
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="benchmark pointer and array type lookups"
+    )
+    parser.add_argument(
+        "-n", type=int, default=1000000, help="number of lookups (default: 1000000)"
+    )
+    parser.add_argument(
+        "-t",
+        "--types",
+        type=int,
+        default=64,
+        help="number of distinct referenced types (default: 64)",
+    )
+    args = parser.parse_args()
+    n = args.n
+
+    prog = drgn.Program(drgn.host_platform)
+    prog.add_memory_segment(0, 1 << 32, lambda *args: bytes(args[1]))
+    int_type = drgn.int_type("int", 4, True)
+    struct_types = [
+        drgn.struct_type(f"s{i}", 4, (drgn.TypeMember(int_type, "x"),))
+        for i in range(args.types)
+    ]
+    objects = [
+        drgn.Object(prog, struct_types[i % len(struct_types)], address=8 * i)
+        for i in range(min(n, 100000))
+    ]
+    rounds = max(n // len(objects), 1)
+    count = rounds * len(objects)
+
+    def address_of():
+        for _ in range(rounds):
+            for obj in objects:
+                obj.address_of_()
+
+    def member_address_of():
+        for _ in range(rounds):
+            for obj in objects:
+                obj.x.address_of_()
+
+    def pointer_type():
+        for _ in range(rounds):
+            for obj in objects:
+                prog.pointer_type(obj.type_)
+
+    bench("address_of_()", count, address_of)
+    bench("x.address_of_()", count, member_address_of)
+    bench("Program.pointer_type()", count, pointer_type)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+# Measure DWARF indexing throughput and its scaling with the number of threads
+# on a synthetic corpus generated by tests/dwarfcorpus.py (or on a given file).
+# Each run loads the file in a fresh child process so that the peak RSS of each
+# run is measured separately. E.g.:
+# scripts/bench_dwarf_index.py --cus 4000 --relocatable -j 16
+
+import argparse
+import json
+import os
+import sys
+import tempfile
+import time
+import traceback
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+
+import drgn  # noqa: E402
+from tests.dwarfcorpus import generate_dwarf_corpus  # noqa: E402
+
+
+def run(path, num_threads):
+    # Returns the wall time, the statistics, and the peak RSS in KiB of loading
+    # path with the given number of threads.
+    r, w = os.pipe()
+    pid = os.fork()
+    if pid == 0:
+        status = 1
+        try:
+            os.close(r)
+            drgn.set_num_threads(num_threads)
+            prog = drgn.Program()
+            start = time.perf_counter()
+            prog.load_debug_info([path])
+            elapsed = time.perf_counter() - start
+            stats = prog.debug_info_stats()
+            with os.fdopen(w, "w") as f:
+                json.dump({"time": elapsed, "index_ns": stats["index_ns"]}, f)
+            status = 0
+        except BaseException:
+            traceback.print_exc()
+        finally:
+            os._exit(status)
+    os.close(w)
+    with os.fdopen(r) as f:
+        output = f.read()
+    _, status, rusage = os.wait4(pid, 0)
+    if not output:
+        sys.exit(f"child failed with status {status}")
+    result = json.loads(output)
+    return result["time"], result["index_ns"] / 1e9, rusage.ru_maxrss
+
+
+def main():
+    parser = argparse.ArgumentParser(description="benchmark DWARF indexing")
+    parser.add_argument(
+        "file", metavar="FILE", nargs="?", help="ELF file to load instead of a corpus"
+    )
+    parser.add_argument(
+        "--cus", type=int, default=1000, help="number of CUs (default: 1000)"
+    )
+    parser.add_argument(
+        "--types",
+        type=int,
+        default=512,
+        help="number of shared structure types (default: 512)",
+    )
+    parser.add_argument(
+        "--members",
+        type=int,
+        default=8,
+        help="number of members of each structure type (default: 8)",
+    )
+    parser.add_argument(
+        "--functions",
+        type=int,
+        default=64,
+        help="number of functions in each CU (default: 64)",
+    )
+    parser.add_argument(
+        "--variables",
+        type=int,
+        default=32,
+        help="number of variables in each CU (default: 32)",
+    )
+    parser.add_argument(
+        "--no-strp",
+        dest="strp",
+        action="store_false",
+        help="store names inline instead of in .debug_str",
+    )
+    parser.add_argument(
+        "--compress", action="store_true", help="compress the debug sections"
+    )
+    parser.add_argument(
+        "--relocatable",
+        action="store_true",
+        help="generate a relocatable file with .rela.debug_info",
+    )
+    parser.add_argument(
+        "-o", "--output", help="also save the generated corpus to this file"
+    )
+    parser.add_argument(
+        "-j",
+        "--threads",
+        type=int,
+        default=os.cpu_count(),
+        help="maximum number of threads (default: number of CPUs)",
+    )
+    parser.add_argument(
+        "-r",
+        "--repeat",
+        type=int,
+        default=3,
+        help="number of runs for each number of threads (default: 3)",
+    )
+    args = parser.parse_args()
+
+    # Make sure that the numbers don't depend on the state of the cache.
+    os.environ["DRGN_DWARF_INDEX_CACHE_DIR"] = ""
+
+    num_dies = None
+    with tempfile.TemporaryDirectory() as tmp:
+        if args.file is None:
+            start = time.perf_counter()
+            data, num_dies = generate_dwarf_corpus(
+                args.cus,
+                types=args.types,
+                members=args.members,
+                functions=args.functions,
+                variables=args.variables,
+                strp=args.strp,
+                compress=args.compress,
+                relocatable=args.relocatable,
+            )
+            print(
+                f"generated {args.cus} CUs, {num_dies} DIEs, "
+                f"{len(data) / (1024 * 1024):.1f} MiB in "
+                f"{time.perf_counter() - start:.1f} s"
+            )
+            path = args.output or os.path.join(tmp, "corpus")
+            with open(path, "wb") as f:
+                f.write(data)
+            del data
+        else:
+            path = args.file
+
+        thread_counts = []
+        num_threads = 1
+        while num_threads < args.threads:
+            thread_counts.append(num_threads)
+            num_threads *= 2
+        thread_counts.append(args.threads)
+
+        base_index_time = None
+        for num_threads in thread_counts:
+            # Report the best of several runs, which is much more stable than
+            # the mean.
+            results = [run(path, num_threads) for _ in range(args.repeat)]
+            elapsed = min(result[0] for result in results)
+            index_time = min(result[1] for result in results)
+            max_rss = max(result[2] for result in results)
+            if base_index_time is None:
+                base_index_time = index_time
+            line = (
+                f"{num_threads} threads: {elapsed:.3f} s total, "
+                f"{index_time:.3f} s index "
+                f"({base_index_time / index_time:.2f}x)"
+            )
+            if num_dies is not None:
+                rate = num_dies / index_time / num_threads
+                line += f", {rate / 1e6:.2f} M DIEs/s/thread"
+            line += f", max RSS {max_rss / 1024:.1f} MiB"
+            print(line)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,303 @@
+#!/usr/bin/env python3
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+# Benchmark the core Linux kernel helpers against the running kernel through
+# /proc/kcore. This must be run as root. It first creates a reproducible
+# population of processes, files, sockets, and cgroups so that the numbers are
+# comparable between runs, then times each helper and prints one line per
+# benchmark. With --json, the results are also written as a JSON document. This
+# is normally run in a virtual machine on several kernels by vmtest.bench, but it
+# works on any machine, e.g.:
+# sudo scripts/bench_linux_helpers.py --tasks 2000 --json results.json
+
+import argparse
+import json
+import os
+import resource
+import signal
+import socket
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+
+import drgn  # noqa: E402
+from drgn import cast  # noqa: E402
+from drgn.helpers.linux.cgroup import (  # noqa: E402
+    cgroup_path,
+    css_for_each_descendant_pre,
+)
+from drgn.helpers.linux.fs import d_path, for_each_file  # noqa: E402
+from drgn.helpers.linux.list import list_for_each_entry  # noqa: E402
+from drgn.helpers.linux.mm import for_each_page  # noqa: E402
+from drgn.helpers.linux.pid import find_task, for_each_task  # noqa: E402
+from drgn.helpers.linux.tcp import sk_tcpstate  # noqa: E402
+from tests.helpers.linux import (  # noqa: E402
+    fork_and_pause,
+    mount,
+    proc_state,
+    wait_until,
+)
+
+CGROUP2_MOUNT = "/sys/fs/cgroup"
+
+
+class Population:
+    # The processes, files, sockets, and cgroups that the helpers walk. All of
+    # them are released by close().
+    def __init__(self, args, tmp):
+        self.pids = []
+        self.files = []
+        self.sockets = []
+        self.cgroups = []
+        try:
+            self._create(args, tmp)
+        except BaseException:
+            self.close()
+            raise
+
+    def _create(self, args, tmp):
+        soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+        needed = args.open_files + 3 * args.sockets + 64
+        if soft < needed:
+            resource.setrlimit(resource.RLIMIT_NOFILE, (min(needed, hard), hard))
+
+        for i in range(args.tasks):
+            self.pids.append(fork_and_pause())
+        for pid in self.pids:
+            wait_until(lambda: proc_state(pid) == "S")
+
+        # Files in a tree of directories, some of which are kept open.
+        for i in range(args.files):
+            dir = os.path.join(tmp, f"dir{i % 16}", f"sub{i % 256}")
+            os.makedirs(dir, exist_ok=True)
+            path = os.path.join(dir, f"file{i}")
+            if i < args.open_files:
+                self.files.append(open(path, "wb"))
+            else:
+                open(path, "wb").close()
+
+        # Connected TCP sockets over loopback and UNIX socket pairs.
+        listener = socket.socket()
+        self.sockets.append(listener)
+        listener.bind(("127.0.0.1", 0))
+        listener.listen(args.sockets)
+        for i in range(args.sockets):
+            client = socket.create_connection(listener.getsockname())
+            self.sockets.append(client)
+            self.sockets.append(listener.accept()[0])
+            self.sockets.extend(socket.socketpair())
+
+        if args.cgroups and self._mount_cgroup2():
+            # A tree with a fanout of 4 and the tasks spread over its leaves.
+            parents = [CGROUP2_MOUNT]
+            for i in range(args.cgroups):
+                path = os.path.join(parents[i // 4], f"drgn-bench{i}")
+                os.mkdir(path)
+                self.cgroups.append(path)
+                parents.append(path)
+            leaves = self.cgroups[-(len(self.cgroups) * 3 // 4 or 1) :]
+            for i, pid in enumerate(self.pids):
+                path = os.path.join(leaves[i % len(leaves)], "cgroup.procs")
+                with open(path, "w") as f:
+                    f.write(str(pid))
+
+    @staticmethod
+    def _mount_cgroup2():
+        if os.path.exists(os.path.join(CGROUP2_MOUNT, "cgroup.controllers")):
+            return True
+        try:
+            mount("cgroup2", CGROUP2_MOUNT, "cgroup2", 0, "")
+        except OSError:
+            return False
+        return True
+
+    def close(self):
+        for pid in self.pids:
+            os.kill(pid, signal.SIGKILL)
+            os.waitpid(pid, 0)
+        self.pids.clear()
+        for file in self.files:
+            file.close()
+        self.files.clear()
+        for sock in self.sockets:
+            sock.close()
+        self.sockets.clear()
+        for path in reversed(self.cgroups):
+            os.rmdir(path)
+        self.cgroups.clear()
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="benchmark Linux kernel helpers on the running kernel"
+    )
+    parser.add_argument(
+        "--tasks", type=int, default=1000, help="number of processes (default: 1000)"
+    )
+    parser.add_argument(
+        "--files",
+        type=int,
+        default=10000,
+        help="number of files to create (default: 10000)",
+    )
+    parser.add_argument(
+        "--open-files",
+        type=int,
+        default=1000,
+        help="number of files to keep open (default: 1000)",
+    )
+    parser.add_argument(
+        "--sockets",
+        type=int,
+        default=256,
+        help="number of TCP connections and UNIX socket pairs (default: 256)",
+    )
+    parser.add_argument(
+        "--cgroups",
+        type=int,
+        default=64,
+        help="number of cgroups if cgroup v2 is available (default: 64)",
+    )
+    parser.add_argument(
+        "-r",
+        "--repeat",
+        type=int,
+        default=5,
+        help="number of runs of each benchmark (default: 5)",
+    )
+    parser.add_argument("--json", metavar="FILE", help="also write results to FILE")
+    args = parser.parse_args()
+    args.open_files = min(args.open_files, args.files)
+
+    results = []
+
+    def bench(name, func, repeat=args.repeat):
+        # Report the best of several runs, which is much more stable than the
+        # mean. func returns the number of items it processed.
+        best = float("inf")
+        for _ in range(repeat):
+            start = time.perf_counter()
+            count = func()
+            best = min(best, time.perf_counter() - start)
+        results.append(
+            {
+                "name": name,
+                "count": count,
+                "seconds": best,
+                "ns_per_item": best * 1e9 / count if count else None,
+            }
+        )
+        line = f"{name}: {best * 1e3:.1f} ms ({count} items"
+        if count:
+            line += f", {best * 1e9 / count:.0f} ns/item"
+        print(line + ")", flush=True)
+
+    with tempfile.TemporaryDirectory(prefix="drgn-bench-") as tmp:
+        population = Population(args, tmp)
+        num_cgroups = len(population.cgroups)
+        try:
+            prog = drgn.Program()
+
+            def load():
+                prog.set_kernel()
+                prog.load_debug_info(main=True)
+                return 1
+
+            bench("load_debug_info", load, repeat=1)
+            task = find_task(prog, os.getpid())
+            children = [find_task(prog, pid) for pid in population.pids]
+
+            bench("for_each_task", lambda: sum(1 for _ in for_each_task(prog)))
+            bench(
+                "list_for_each_entry tasks",
+                lambda: sum(
+                    1
+                    for _ in list_for_each_entry(
+                        "struct task_struct",
+                        prog["init_task"].tasks.address_of_(),
+                        "tasks",
+                    )
+                ),
+            )
+            bench(
+                "list_for_each_entry super_blocks",
+                lambda: sum(
+                    1
+                    for _ in list_for_each_entry(
+                        "struct super_block",
+                        prog["super_blocks"].address_of_(),
+                        "s_list",
+                    )
+                ),
+            )
+            bench("for_each_page", lambda: sum(1 for _ in for_each_page(prog)))
+
+            def files():
+                count = 0
+                for fd, file in for_each_file(task):
+                    d_path(file.f_path.address_of_())
+                    count += 1
+                return count
+
+            bench("for_each_file and d_path", files)
+
+            fds = [
+                sock.fileno()
+                for sock in population.sockets
+                if sock.family == socket.AF_INET
+            ]
+
+            def sockets():
+                fdt = task.files.fdt.read_()
+                for fd in fds:
+                    sk_tcpstate(cast("struct socket *", fdt.fd[fd].private_data).sk)
+                return len(fds)
+
+            bench("sk_tcpstate", sockets)
+
+            def stack_traces():
+                for child in children:
+                    prog.stack_trace(child)
+                return len(children)
+
+            bench("stack_trace", stack_traces)
+
+            if num_cgroups:
+
+                def cgroups():
+                    count = 0
+                    for css in css_for_each_descendant_pre(
+                        prog["cgrp_dfl_root"].cgrp.self.address_of_()
+                    ):
+                        cgroup_path(css.cgroup)
+                        count += 1
+                    return count
+
+                bench("css_for_each_descendant_pre and cgroup_path", cgroups)
+        finally:
+            population.close()
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(
+                {
+                    "kernel": os.uname().release,
+                    "population": {
+                        "tasks": args.tasks,
+                        "files": args.files,
+                        "open_files": args.open_files,
+                        "sockets": args.sockets,
+                        "cgroups": num_cgroups,
+                    },
+                    "results": results,
+                },
+                f,
+                indent=2,
+            )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+# Microbenchmarks for deserializing integers from memory, comparing the
+# byte-aligned fast paths to the general bit field path, e.g.:
+# scripts/bench_serialize.py -n 1000000
+
+import argparse
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+
+import drgn  # noqa: E402
+from tests.libdrgn import deserialize_bits_array  # noqa: E402
+
+
+def bench(name, n, func):
+    start = time.perf_counter()
+    func()
+    elapsed = time.perf_counter() - start
+    print(f"{name}: {elapsed * 1e9 / n:.1f} ns/element")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="benchmark deserializing integers")
+    parser.add_argument(
+        "-n", type=int, default=1000000, help="number of elements (default: 1000000)"
+    )
+    args = parser.parse_args()
+    n = args.n
+
+    buf = os.urandom(8 * n + 8)
+    for bit_size in (8, 16, 32, 64):
+        bench(
+            f"deserialize_bits_array({bit_size} bits, aligned)",
+            n,
+            lambda: deserialize_bits_array(buf, n, 0, 64, bit_size, True),
+        )
+        bench(
+            f"deserialize_bits_array({bit_size} bits, unaligned)",
+            n,
+            lambda: deserialize_bits_array(buf, n, 1, 64, bit_size, True),
+        )
+
+    def read_fn(address, count, offset, physical):
+        return buf[offset : offset + count]
+
+    prog = drgn.Program(drgn.host_platform)
+    prog.add_memory_segment(0, len(buf), read_fn)
+    int_type = drgn.int_type("int", 4, True)
+    bit_field_type = drgn.struct_type(
+        None, 4, (drgn.TypeMember(int_type, "x", 1, 30),)
+    )
+    n_objects = min(n, 100000)
+    bench(
+        "int(Object(int))",
+        n_objects,
+        lambda: [
+            int(drgn.Object(prog, int_type, address=8 * i)) for i in range(n_objects)
+        ],
+    )
+    bench(
+        "int(Object(int : 30).x)",
+        n_objects,
+        lambda: [
+            int(drgn.Object(prog, bit_field_type, address=8 * i).x)
+            for i in range(n_objects)
+        ],
+    )
+    addresses = range(0, 8 * n, 8)
+    struct_type = drgn.struct_type(None, 8, (drgn.TypeMember(int_type, "x"),))
+    bench(
+        "read_field_array(int)",
+        n,
+        lambda: prog.read_field_array(struct_type, "x", addresses),
+    )
+    bench(
+        "read_field_array(int : 30)",
+        n,
+        lambda: prog.read_field_array(bit_field_type, "x", addresses),
+    )
+
+
+if __name__ == "__main__":
+    main()
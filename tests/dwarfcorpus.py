@@ -0,0 +1,521 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+# Generator for large synthetic DWARF corpora, for benchmarking the DWARF index
+# without real vmlinux files. tests.dwarfwriter builds one CU from a tree of
+# DwarfDie objects, which is convenient for tests but far too slow for millions
+# of DIEs. This writes the encoding directly instead.
+#
+# The corpus is shaped like a kernel build: every CU includes a prefix of a set
+# of shared header structure types, so most of the type DIEs are duplicated
+# across CUs, plus its own enumeration, functions, and variables. Structure j
+# embeds structure j - 1 and has pointers to earlier structures, so the type
+# graph is as deep as the number of types. The encoding of the shared types
+# only depends on how many of them a CU includes, so it is generated once and
+# copied into each CU.
+#
+# All names are generated from the CU and DIE numbers, so two corpora generated
+# with the same parameters are identical.
+
+import struct
+
+from tests.dwarf import DW_AT, DW_ATE, DW_FORM, DW_LANG, DW_OP, DW_TAG
+from tests.dwarfwriter import (
+    _append_sleb128,
+    _append_uleb128,
+    _compress_debug_section,
+)
+from tests.elf import ET, PT, SHT
+from tests.elfwriter import ElfSection, create_elf_file
+
+# Abbreviation codes. Every CU uses the same abbreviation table.
+_ABBREV_COMPILE_UNIT = 1
+_ABBREV_BASE_TYPE = 2
+_ABBREV_POINTER_TYPE = 3
+_ABBREV_STRUCTURE_TYPE = 4
+_ABBREV_MEMBER = 5
+_ABBREV_TYPEDEF = 6
+_ABBREV_ENUMERATION_TYPE = 7
+_ABBREV_ENUMERATOR = 8
+_ABBREV_SUBPROGRAM = 9
+_ABBREV_FORMAL_PARAMETER = 10
+_ABBREV_VARIABLE = 11
+
+# Number of shared types declared in each header file.
+_TYPES_PER_HEADER = 64
+
+_TEXT_ADDRESS = 0xFFFF0000
+_FUNCTION_SIZE = 64
+_DATA_ADDRESS = 0x1FFFF0000
+
+_R_X86_64_64 = 1
+_R_X86_64_32 = 10
+
+_u16 = struct.Struct("<H")
+_u32 = struct.Struct("<I")
+_u64 = struct.Struct("<Q")
+_sym = struct.Struct("<IBBHQQ")
+_rela = struct.Struct("<QQq")
+
+
+def _compile_abbrevs(name_form):
+    abbrevs = [
+        (
+            _ABBREV_COMPILE_UNIT,
+            DW_TAG.compile_unit,
+            True,
+            [
+                (DW_AT.name, name_form),
+                (DW_AT.comp_dir, name_form),
+                (DW_AT.language, DW_FORM.data1),
+                (DW_AT.stmt_list, DW_FORM.sec_offset),
+                (DW_AT.low_pc, DW_FORM.addr),
+                (DW_AT.high_pc, DW_FORM.data8),
+            ],
+        ),
+        (
+            _ABBREV_BASE_TYPE,
+            DW_TAG.base_type,
+            False,
+            [
+                (DW_AT.name, name_form),
+                (DW_AT.byte_size, DW_FORM.data1),
+                (DW_AT.encoding, DW_FORM.data1),
+            ],
+        ),
+        (
+            _ABBREV_POINTER_TYPE,
+            DW_TAG.pointer_type,
+            False,
+            [(DW_AT.byte_size, DW_FORM.data1), (DW_AT.type, DW_FORM.ref4)],
+        ),
+        (
+            _ABBREV_STRUCTURE_TYPE,
+            DW_TAG.structure_type,
+            True,
+            [
+                (DW_AT.name, name_form),
+                (DW_AT.byte_size, DW_FORM.udata),
+                (DW_AT.decl_file, DW_FORM.udata),
+                (DW_AT.decl_line, DW_FORM.udata),
+            ],
+        ),
+        (
+            _ABBREV_MEMBER,
+            DW_TAG.member,
+            False,
+            [
+                (DW_AT.name, name_form),
+                (DW_AT.type, DW_FORM.ref4),
+                (DW_AT.data_member_location, DW_FORM.udata),
+            ],
+        ),
+        (
+            _ABBREV_TYPEDEF,
+            DW_TAG.typedef,
+            False,
+            [
+                (DW_AT.name, name_form),
+                (DW_AT.type, DW_FORM.ref4),
+                (DW_AT.decl_file, DW_FORM.udata),
+            ],
+        ),
+        (
+            _ABBREV_ENUMERATION_TYPE,
+            DW_TAG.enumeration_type,
+            True,
+            [
+                (DW_AT.name, name_form),
+                (DW_AT.type, DW_FORM.ref4),
+                (DW_AT.byte_size, DW_FORM.data1),
+                (DW_AT.decl_file, DW_FORM.udata),
+            ],
+        ),
+        (
+            _ABBREV_ENUMERATOR,
+            DW_TAG.enumerator,
+            False,
+            [(DW_AT.name, name_form), (DW_AT.const_value, DW_FORM.sdata)],
+        ),
+        (
+            _ABBREV_SUBPROGRAM,
+            DW_TAG.subprogram,
+            True,
+            [
+                (DW_AT.name, name_form),
+                (DW_AT.external, DW_FORM.flag_present),
+                (DW_AT.type, DW_FORM.ref4),
+                (DW_AT.decl_file, DW_FORM.udata),
+                (DW_AT.decl_line, DW_FORM.udata),
+                (DW_AT.low_pc, DW_FORM.addr),
+                (DW_AT.high_pc, DW_FORM.data8),
+            ],
+        ),
+        (
+            _ABBREV_FORMAL_PARAMETER,
+            DW_TAG.formal_parameter,
+            False,
+            [(DW_AT.name, name_form), (DW_AT.type, DW_FORM.ref4)],
+        ),
+        (
+            _ABBREV_VARIABLE,
+            DW_TAG.variable,
+            False,
+            [
+                (DW_AT.name, name_form),
+                (DW_AT.external, DW_FORM.flag_present),
+                (DW_AT.type, DW_FORM.ref4),
+                (DW_AT.decl_file, DW_FORM.udata),
+                (DW_AT.location, DW_FORM.exprloc),
+            ],
+        ),
+    ]
+    buf = bytearray()
+    for code, tag, children, attribs in abbrevs:
+        _append_uleb128(buf, code)
+        _append_uleb128(buf, tag)
+        buf.append(children)
+        for name, form in attribs:
+            _append_uleb128(buf, name)
+            _append_uleb128(buf, form)
+        buf.extend(b"\0\0")
+    buf.append(0)
+    return buf
+
+
+class _StringTable:
+    def __init__(self):
+        self.data = bytearray(1)
+        self._offsets = {"": 0}
+
+    def add(self, s):
+        offset = self._offsets.get(s)
+        if offset is None:
+            offset = self._offsets[s] = len(self.data)
+            self.data.extend(s.encode())
+            self.data.append(0)
+        return offset
+
+
+class _UnitWriter:
+    # Writes a chunk of .debug_info starting at a given offset in its unit.
+    # Fields that need a relocation in a relocatable file are recorded as fixups
+    # of (offset in chunk, section name, size, value). The value is also written
+    # in place, so the fixups can be ignored otherwise.
+    def __init__(self, strings, base=0):
+        self.buf = bytearray()
+        self.fixups = []
+        self.strings = strings
+        self.base = base
+        self.num_dies = 0
+
+    def offset(self):
+        return self.base + len(self.buf)
+
+    def die(self, code):
+        if code:
+            self.num_dies += 1
+        _append_uleb128(self.buf, code)
+
+    def name(self, s):
+        if self.strings is None:
+            self.buf.extend(s.encode())
+            self.buf.append(0)
+        else:
+            self.fixup(".debug_str", 4, self.strings.add(s))
+
+    def fixup(self, section, size, value):
+        self.fixups.append((len(self.buf), section, size, value))
+        self.buf.extend(value.to_bytes(size, "little"))
+
+    def data1(self, value):
+        self.buf.append(value)
+
+    def data8(self, value):
+        self.buf.extend(_u64.pack(value))
+
+    def udata(self, value):
+        _append_uleb128(self.buf, value)
+
+    def sdata(self, value):
+        _append_sleb128(self.buf, value)
+
+    def ref4(self, offset):
+        self.buf.extend(_u32.pack(offset))
+
+    def extend(self, other):
+        start = len(self.buf)
+        self.buf.extend(other.buf)
+        self.fixups.extend(
+            (start + offset, section, size, value)
+            for offset, section, size, value in other.fixups
+        )
+        self.num_dies += other.num_dies
+
+
+def _struct_size(j, members):
+    return 8 + 8 * (members - 1) * (j + 1)
+
+
+def _compile_shared_types(strings, base, num_types, members):
+    # Types shared by every CU that includes the first num_types structures.
+    # Returns the writer and the unit offsets of DIEs that the rest of the CU
+    # refers to.
+    w = _UnitWriter(strings, base)
+    offsets = {}
+    for name, size, encoding in (
+        ("int", 4, DW_ATE.signed),
+        ("unsigned long", 8, DW_ATE.unsigned),
+        ("char", 1, DW_ATE.signed_char),
+    ):
+        offsets[name] = w.offset()
+        w.die(_ABBREV_BASE_TYPE)
+        w.name(name)
+        w.data1(size)
+        w.data1(encoding)
+    offsets["char *"] = w.offset()
+    w.die(_ABBREV_POINTER_TYPE)
+    w.data1(8)
+    w.ref4(offsets["char"])
+
+    struct_offsets = []
+    pointer_offsets = []
+    for j in range(num_types):
+        struct_offsets.append(w.offset())
+        w.die(_ABBREV_STRUCTURE_TYPE)
+        w.name(f"corpus_struct_{j}")
+        w.udata(_struct_size(j, members))
+        w.udata(2 + j // _TYPES_PER_HEADER)
+        w.udata(1 + 10 * (j % _TYPES_PER_HEADER))
+
+        w.die(_ABBREV_MEMBER)
+        w.name("base")
+        w.ref4(struct_offsets[j - 1] if j else offsets["unsigned long"])
+        w.udata(0)
+        location = _struct_size(j - 1, members) if j else 8
+        for k in range(1, members):
+            if k % 4 == 1 and j:
+                type_offset = pointer_offsets[j - 1]
+            elif k % 4 == 2 and j:
+                type_offset = pointer_offsets[j // 2]
+            elif k % 4 == 3:
+                type_offset = offsets["char *"]
+            else:
+                type_offset = offsets["unsigned long"]
+            w.die(_ABBREV_MEMBER)
+            w.name(f"field_{k}")
+            w.ref4(type_offset)
+            w.udata(location)
+            location += 8
+        w.die(0)
+
+        pointer_offsets.append(w.offset())
+        w.die(_ABBREV_POINTER_TYPE)
+        w.data1(8)
+        w.ref4(struct_offsets[j])
+
+        if j % 4 == 0:
+            w.die(_ABBREV_TYPEDEF)
+            w.name(f"corpus_struct_{j}_t")
+            w.ref4(struct_offsets[j])
+            w.udata(2 + j // _TYPES_PER_HEADER)
+    offsets["pointers"] = pointer_offsets
+    return w, offsets
+
+
+def _compile_line_header(cu_name, num_headers):
+    buf = bytearray()
+    buf.extend(b"\0\0\0\0")  # unit_length
+    buf.extend(_u16.pack(4))  # version
+    buf.extend(b"\0\0\0\0")  # header_length
+    buf.append(1)  # minimum_instruction_length
+    buf.append(1)  # maximum_operations_per_instruction
+    buf.append(1)  # default_is_stmt
+    buf.append(1)  # line_base
+    buf.append(1)  # line_range
+    buf.append(1)  # opcode_base
+    buf.extend(b"include/corpus\0")
+    buf.extend(b"include/corpus/uapi\0")
+    buf.append(0)
+    buf.extend(cu_name.encode())
+    buf.extend(b"\0\0\0\0")  # directory index, mtime, size
+    for h in range(num_headers):
+        buf.extend(f"hdr{h}.h".encode())
+        buf.append(0)
+        _append_uleb128(buf, 2 if h % 8 == 7 else 1)  # directory index
+        buf.extend(b"\0\0")  # mtime, size
+    buf.append(0)
+    buf[:4] = _u32.pack(len(buf) - 4)
+    buf[6:10] = _u32.pack(len(buf) - 10)
+    return buf
+
+
+def generate_dwarf_corpus(
+    num_cus=1000,
+    *,
+    types=512,
+    members=8,
+    functions=64,
+    params=3,
+    variables=32,
+    enumerators=16,
+    strp=True,
+    compress=False,
+    relocatable=False,
+):
+    # Return the contents of a little-endian, 64-bit ELF file containing the
+    # corpus and the number of DIEs in it. Each CU includes 1/4, 2/4, 3/4 or all
+    # of the shared types. If relocatable is True, the file is an x86-64 ET_REL
+    # file, like a kernel module, and every reference to another section and
+    # every address is a relocation in .rela.debug_info.
+    assert num_cus < 1000000 and types > 0 and members > 0
+    strings = _StringTable() if strp else None
+    debug_info = bytearray()
+    debug_line = bytearray()
+    fixups = []
+    num_dies = 0
+    shared_types = {}
+    function_index = 0
+    variable_index = 0
+
+    for i in range(num_cus):
+        num_types = max(types * (i % 4 + 1) // 4, 1)
+        num_headers = (num_types - 1) // _TYPES_PER_HEADER + 1
+        cu_name = f"corpus/cu{i:06d}.c"
+        stmt_list = len(debug_line)
+        debug_line.extend(_compile_line_header(cu_name, num_headers))
+
+        w = _UnitWriter(strings)
+        w.buf.extend(b"\0\0\0\0")  # unit_length
+        w.buf.extend(_u16.pack(4))  # version
+        w.fixup(".debug_abbrev", 4, 0)  # debug_abbrev_offset
+        w.data1(8)  # address_size
+
+        w.die(_ABBREV_COMPILE_UNIT)
+        w.name(cu_name)
+        w.name("/usr/src/corpus")
+        w.data1(DW_LANG.C89)
+        w.fixup(".debug_line", 4, stmt_list)
+        w.fixup(".text", 8, _TEXT_ADDRESS + function_index * _FUNCTION_SIZE)
+        w.data8(functions * _FUNCTION_SIZE)
+
+        # The CU name has a fixed length, so the shared types start at the
+        # same offset in every CU.
+        key = (w.offset(), num_types)
+        if key not in shared_types:
+            shared_types[key] = _compile_shared_types(
+                strings, w.offset(), num_types, members
+            )
+        types_writer, offsets = shared_types[key]
+        w.extend(types_writer)
+        pointers = offsets["pointers"]
+
+        w.die(_ABBREV_ENUMERATION_TYPE)
+        w.name(f"cu{i}_state")
+        w.ref4(offsets["int"])
+        w.data1(4)
+        w.udata(1)
+        for k in range(enumerators):
+            w.die(_ABBREV_ENUMERATOR)
+            w.name(f"CU{i}_STATE_{k}")
+            w.sdata(k)
+        w.die(0)
+
+        for k in range(functions):
+            w.die(_ABBREV_SUBPROGRAM)
+            w.name(f"cu{i}_func{k}")
+            w.ref4(offsets["int"])
+            w.udata(1)
+            w.udata(1 + 20 * k)
+            w.fixup(".text", 8, _TEXT_ADDRESS + function_index * _FUNCTION_SIZE)
+            w.data8(_FUNCTION_SIZE)
+            for p in range(params):
+                w.die(_ABBREV_FORMAL_PARAMETER)
+                w.name(f"arg{p}")
+                w.ref4(pointers[(k * params + p) % num_types])
+            w.die(0)
+            function_index += 1
+
+        for k in range(variables):
+            w.die(_ABBREV_VARIABLE)
+            w.name(f"cu{i}_var{k}")
+            w.ref4(pointers[(k * 7) % num_types])
+            w.udata(1)
+            w.udata(9)  # exprloc length
+            w.data1(DW_OP.addr)
+            w.fixup(".data", 8, _DATA_ADDRESS + variable_index * 8)
+            variable_index += 1
+        w.die(0)
+
+        w.buf[:4] = _u32.pack(len(w.buf) - 4)
+        fixups.extend(
+            (len(debug_info) + offset, section, size, value)
+            for offset, section, size, value in w.fixups
+        )
+        debug_info.extend(w.buf)
+        num_dies += w.num_dies
+
+    sections = [
+        ElfSection(
+            name=".debug_abbrev",
+            sh_type=SHT.PROGBITS,
+            data=_compile_abbrevs(DW_FORM.strp if strp else DW_FORM.string),
+        ),
+        ElfSection(name=".debug_info", sh_type=SHT.PROGBITS, data=debug_info),
+        ElfSection(name=".debug_line", sh_type=SHT.PROGBITS, data=debug_line),
+        ElfSection(
+            name=".debug_str",
+            sh_type=SHT.PROGBITS,
+            data=strings.data if strp else b"\0",
+        ),
+    ]
+    if compress:
+        sections = [_compress_debug_section(section) for section in sections]
+
+    if relocatable:
+        # Section indices start at 2 after the null section and .shstrtab. The
+        # symbol table has the null symbol and a section symbol for each
+        # section that .debug_info refers to.
+        sections.append(ElfSection(name=".text", sh_type=SHT.NOBITS, data=b""))
+        sections.append(ElfSection(name=".data", sh_type=SHT.NOBITS, data=b""))
+        shndx = {
+            ".debug_abbrev": 2,
+            ".debug_line": 4,
+            ".debug_str": 5,
+            ".text": 6,
+            ".data": 7,
+        }
+        symbols = {name: i + 1 for i, name in enumerate(shndx)}
+        symtab = bytearray(_sym.size)
+        for name in shndx:
+            symtab.extend(_sym.pack(0, 3, 0, shndx[name], 0, 0))  # STT_SECTION
+        rela = bytearray()
+        for offset, section, size, value in fixups:
+            r_type = _R_X86_64_64 if size == 8 else _R_X86_64_32
+            rela.extend(_rela.pack(offset, (symbols[section] << 32) | r_type, value))
+        sections.extend(
+            [
+                ElfSection(
+                    name=".symtab",
+                    sh_type=SHT.SYMTAB,
+                    data=symtab,
+                    sh_link=9,
+                    sh_info=len(symbols) + 1,
+                    sh_entsize=_sym.size,
+                ),
+                ElfSection(name=".strtab", sh_type=SHT.STRTAB, data=b"\0"),
+                ElfSection(
+                    name=".rela.debug_info",
+                    sh_type=SHT.RELA,
+                    data=rela,
+                    sh_link=8,
+                    sh_info=3,
+                    sh_entsize=_rela.size,
+                ),
+            ]
+        )
+        elf_type = ET.REL
+    else:
+        sections.insert(0, ElfSection(p_type=PT.LOAD, vaddr=_TEXT_ADDRESS, data=b""))
+        elf_type = ET.EXEC
+    return create_elf_file(elf_type, sections), num_dies
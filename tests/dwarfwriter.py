@@ -3,6 +3,7 @@
 
 from collections import namedtuple
 import os.path
+import zlib
 
 from tests.elf import ET, PT, SHT
 from tests.elfwriter import ElfSection, create_elf_file
@@ -60,7 +61,7 @@ def _compile_debug_abbrev(cu_die):
     return buf
 
 
-def _compile_debug_info(cu_die, little_endian, bits):
+def _compile_debug_info(cu_die, little_endian, bits, all_die_offsets=None):
     buf = bytearray()
     byteorder = "little" if little_endian else "big"
 
@@ -78,6 +79,8 @@ def _compile_debug_info(cu_die, little_endian, bits):
         nonlocal code, decl_file
         if depth == 1:
             die_offsets.append(len(buf))
+        if all_die_offsets is not None:
+            all_die_offsets[id(die)] = len(buf)
         _append_uleb128(buf, code)
         code += 1
         for attrib in die.attribs:
@@ -90,6 +93,8 @@ def _compile_debug_info(cu_die, little_endian, bits):
                 buf.extend(value.to_bytes(bits // 8, byteorder))
             elif attrib.form == DW_FORM.data1:
                 buf.append(value)
+            elif attrib.form == DW_FORM.data8:
+                buf.extend(value.to_bytes(8, byteorder))
             elif attrib.form == DW_FORM.udata:
                 _append_uleb128(buf, value)
             elif attrib.form == DW_FORM.sdata:
@@ -187,7 +192,132 @@ def _compile_debug_line(cu_die, little_endian):
     return buf
 
 
-def compile_dwarf(dies, little_endian=True, bits=64, *, lang=None):
+def _die_name(die):
+    for attrib in die.attribs:
+        if attrib.name == DW_AT.declaration:
+            return None
+    for attrib in die.attribs:
+        if attrib.name == DW_AT.name:
+            return attrib.value
+    return None
+
+
+def _compile_debug_names(cu_die, die_offsets, little_endian):
+    byteorder = "little" if little_endian else "big"
+
+    # (name, tag, DIE, parent DIE)
+    entries = []
+    for die in cu_die.children or ():
+        name = _die_name(die)
+        if name is not None:
+            entries.append((name, die.tag, die, None))
+        if die.tag == DW_TAG.enumeration_type:
+            for child in die.children or ():
+                child_name = _die_name(child)
+                if child_name is not None:
+                    entries.append(
+                        (child_name, child.tag, child, die if name else None)
+                    )
+
+    abbrevs = {}
+    abbrev_table = bytearray()
+    for name, tag, die, parent in entries:
+        key = (tag, parent is not None)
+        if key not in abbrevs:
+            abbrevs[key] = len(abbrevs) + 1
+            _append_uleb128(abbrev_table, abbrevs[key])
+            _append_uleb128(abbrev_table, tag)
+            _append_uleb128(abbrev_table, 3)  # DW_IDX_die_offset
+            _append_uleb128(abbrev_table, DW_FORM.ref4)
+            _append_uleb128(abbrev_table, 4)  # DW_IDX_parent
+            _append_uleb128(
+                abbrev_table, DW_FORM.ref4 if parent else DW_FORM.flag_present
+            )
+            abbrev_table.extend(b"\0\0")
+    abbrev_table.append(0)
+
+    debug_str = bytearray(1)
+    names = {}
+    for name, tag, die, parent in entries:
+        names.setdefault(name, []).append((tag, die, parent))
+
+    entry_pool = bytearray()
+    entry_offsets = []
+    pool_offsets = {}
+    relocations = []
+    for name, name_entries in names.items():
+        entry_offsets.append((len(debug_str), len(entry_pool)))
+        debug_str.extend(name.encode())
+        debug_str.append(0)
+        for tag, die, parent in name_entries:
+            pool_offsets[id(die)] = len(entry_pool)
+            _append_uleb128(entry_pool, abbrevs[(tag, parent is not None)])
+            entry_pool.extend(die_offsets[id(die)].to_bytes(4, byteorder))
+            if parent is not None:
+                relocations.append((len(entry_pool), parent))
+                entry_pool.extend(b"\0\0\0\0")
+        entry_pool.append(0)
+    for offset, parent in relocations:
+        entry_pool[offset : offset + 4] = pool_offsets[id(parent)].to_bytes(
+            4, byteorder
+        )
+
+    buf = bytearray()
+    buf.extend(b"\0\0\0\0")  # unit_length
+    buf.extend((5).to_bytes(2, byteorder))  # version
+    buf.extend((0).to_bytes(2, byteorder))  # padding
+    buf.extend((1).to_bytes(4, byteorder))  # comp_unit_count
+    buf.extend((0).to_bytes(4, byteorder))  # local_type_unit_count
+    buf.extend((0).to_bytes(4, byteorder))  # foreign_type_unit_count
+    buf.extend((0).to_bytes(4, byteorder))  # bucket_count
+    buf.extend(len(names).to_bytes(4, byteorder))  # name_count
+    buf.extend(len(abbrev_table).to_bytes(4, byteorder))  # abbrev_table_size
+    buf.extend((0).to_bytes(4, byteorder))  # augmentation_string_size
+    buf.extend((0).to_bytes(4, byteorder))  # CU offset
+    for str_offset, entry_offset in entry_offsets:
+        buf.extend(str_offset.to_bytes(4, byteorder))
+    for str_offset, entry_offset in entry_offsets:
+        buf.extend(entry_offset.to_bytes(4, byteorder))
+    buf.extend(abbrev_table)
+    buf.extend(entry_pool)
+    buf[:4] = (len(buf) - 4).to_bytes(4, byteorder)
+    return buf, debug_str
+
+
+def _compile_build_id_note(build_id, little_endian):
+    byteorder = "little" if little_endian else "big"
+    buf = bytearray()
+    buf.extend((4).to_bytes(4, byteorder))  # n_namesz
+    buf.extend(len(build_id).to_bytes(4, byteorder))  # n_descsz
+    buf.extend((3).to_bytes(4, byteorder))  # n_type = NT_GNU_BUILD_ID
+    buf.extend(b"GNU\0")
+    buf.extend(build_id)
+    buf.extend(bytes(-len(build_id) % 4))
+    return buf
+
+
+def _compress_debug_section(section):
+    # GNU .zdebug format: "ZLIB", the big-endian uncompressed size, and the
+    # zlib stream.
+    return ElfSection(
+        name=".z" + section.name[1:],
+        sh_type=section.sh_type,
+        data=b"ZLIB"
+        + len(section.data).to_bytes(8, "big")
+        + zlib.compress(section.data),
+    )
+
+
+def compile_dwarf(
+    dies,
+    little_endian=True,
+    bits=64,
+    *,
+    lang=None,
+    build_id=None,
+    debug_names=False,
+    compress=False,
+):
     if isinstance(dies, DwarfDie):
         dies = (dies,)
     assert all(isinstance(die, DwarfDie) for die in dies)
@@ -199,8 +329,24 @@ def compile_dwarf(dies, little_endian=True, bits=64, *, lang=None):
         cu_attribs.append(DwarfAttrib(DW_AT.language, DW_FORM.data1, lang))
     cu_die = DwarfDie(DW_TAG.compile_unit, cu_attribs, dies)
 
-    return create_elf_file(
-        ET.EXEC,
+    die_offsets = {}
+    debug_info = _compile_debug_info(cu_die, little_endian, bits, die_offsets)
+    debug_str = b"\0"
+    sections = []
+    if debug_names:
+        data, debug_str = _compile_debug_names(cu_die, die_offsets, little_endian)
+        sections.append(
+            ElfSection(name=".debug_names", sh_type=SHT.PROGBITS, data=data)
+        )
+    if build_id is not None:
+        sections.append(
+            ElfSection(
+                name=".note.gnu.build-id",
+                sh_type=SHT.NOTE,
+                data=_compile_build_id_note(build_id, little_endian),
+            )
+        )
+    sections.extend(
         [
             ElfSection(p_type=PT.LOAD, vaddr=0xFFFF0000, data=b"",),
             ElfSection(
@@ -208,18 +354,93 @@ def compile_dwarf(dies, little_endian=True, bits=64, *, lang=None):
                 sh_type=SHT.PROGBITS,
                 data=_compile_debug_abbrev(cu_die),
             ),
+            ElfSection(name=".debug_info", sh_type=SHT.PROGBITS, data=debug_info,),
+            ElfSection(
+                name=".debug_line",
+                sh_type=SHT.PROGBITS,
+                data=_compile_debug_line(cu_die, little_endian),
+            ),
+            ElfSection(name=".debug_str", sh_type=SHT.PROGBITS, data=debug_str,),
+        ]
+    )
+    if compress:
+        sections = [
+            _compress_debug_section(section)
+            if section.name is not None and section.name.startswith(".debug_")
+            else section
+            for section in sections
+        ]
+    return create_elf_file(
+        ET.EXEC,
+        sections,
+        little_endian=little_endian,
+        bits=bits,
+    )
+
+
+def compile_split_dwarf(
+    dies, dwo_name, little_endian=True, bits=64, *, dwo_id=0x12345678
+):
+    # Returns the contents of an executable containing only a skeleton unit
+    # and of the split DWARF file (.dwo) that it refers to.
+    if isinstance(dies, DwarfDie):
+        dies = (dies,)
+    assert all(isinstance(die, DwarfDie) for die in dies)
+    split_cu_die = DwarfDie(
+        DW_TAG.compile_unit,
+        [DwarfAttrib(DW_AT.GNU_dwo_id, DW_FORM.data8, dwo_id)],
+        dies,
+    )
+    skeleton_die = DwarfDie(
+        DW_TAG.compile_unit,
+        [
+            DwarfAttrib(DW_AT.comp_dir, DW_FORM.string, "/usr/src"),
+            DwarfAttrib(DW_AT.GNU_dwo_name, DW_FORM.string, dwo_name),
+            DwarfAttrib(DW_AT.GNU_dwo_id, DW_FORM.data8, dwo_id),
+            DwarfAttrib(DW_AT.stmt_list, DW_FORM.sec_offset, 0),
+        ],
+    )
+    skeleton = create_elf_file(
+        ET.EXEC,
+        [
+            ElfSection(p_type=PT.LOAD, vaddr=0xFFFF0000, data=b""),
+            ElfSection(
+                name=".debug_abbrev",
+                sh_type=SHT.PROGBITS,
+                data=_compile_debug_abbrev(skeleton_die),
+            ),
             ElfSection(
                 name=".debug_info",
                 sh_type=SHT.PROGBITS,
-                data=_compile_debug_info(cu_die, little_endian, bits),
+                data=_compile_debug_info(skeleton_die, little_endian, bits),
             ),
+            # The split unit's file names are in the skeleton's line table.
             ElfSection(
                 name=".debug_line",
                 sh_type=SHT.PROGBITS,
-                data=_compile_debug_line(cu_die, little_endian),
+                data=_compile_debug_line(split_cu_die, little_endian),
+            ),
+            ElfSection(name=".debug_str", sh_type=SHT.PROGBITS, data=b"\0"),
+        ],
+        little_endian=little_endian,
+        bits=bits,
+    )
+    dwo = create_elf_file(
+        ET.REL,
+        [
+            ElfSection(
+                name=".debug_abbrev.dwo",
+                sh_type=SHT.PROGBITS,
+                data=_compile_debug_abbrev(split_cu_die),
+            ),
+            ElfSection(
+                name=".debug_info.dwo",
+                sh_type=SHT.PROGBITS,
+                data=_compile_debug_info(split_cu_die, little_endian, bits),
             ),
-            ElfSection(name=".debug_str", sh_type=SHT.PROGBITS, data=b"\0",),
+            ElfSection(name=".debug_str.dwo", sh_type=SHT.PROGBITS, data=b"\0"),
         ],
         little_endian=little_endian,
         bits=bits,
     )
+    return skeleton, dwo
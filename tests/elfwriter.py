@@ -18,6 +18,9 @@ class ElfSection:
         paddr: int = 0,
         memsz: Optional[int] = None,
         p_align: int = 0,
+        sh_link: int = 0,
+        sh_info: int = 0,
+        sh_entsize: int = 0,
     ):
         self.data = data
         self.name = name
@@ -27,6 +30,9 @@ class ElfSection:
         self.paddr = paddr
         self.memsz = memsz
         self.p_align = p_align
+        self.sh_link = sh_link
+        self.sh_info = sh_info
+        self.sh_entsize = sh_entsize
 
         assert (self.name is not None) or (self.p_type is not None)
         assert (self.name is None) == (self.sh_type is None)
@@ -109,6 +115,11 @@ def create_elf_file(
         if section.p_align:
             padding = section.vaddr % section.p_align - len(buf) % section.p_align
             buf.extend(bytes(padding))
+        elif section.sh_type == SHT.NOTE:
+            # Notes must be 4-byte aligned.
+            buf.extend(bytes(-len(buf) % 4))
+        elif section.sh_type in (SHT.SYMTAB, SHT.RELA):
+            buf.extend(bytes(-len(buf) % 8))
         if section.name is not None:
             shdr_struct.pack_into(
                 buf,
@@ -119,10 +130,19 @@ def create_elf_file(
                 section.vaddr,  # sh_addr
                 len(buf),  # sh_offset
                 len(section.data),  # sh_size
-                0,  # sh_link
-                0,  # sh_info
-                1 if section.p_type is None else bits // 8,  # sh_addralign
-                0,  # sh_entsize
+                section.sh_link,  # sh_link
+                section.sh_info,  # sh_info
+                # sh_addralign
+                (
+                    4
+                    if section.sh_type == SHT.NOTE
+                    else 8
+                    if section.sh_type in (SHT.SYMTAB, SHT.RELA)
+                    else 1
+                )
+                if section.p_type is None
+                else bits // 8,
+                section.sh_entsize,  # sh_entsize
             )
             shdr_offset += shdr_struct.size
         if section.p_type is not None:
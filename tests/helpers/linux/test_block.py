@@ -9,6 +9,7 @@ import sys
 import tempfile
 
 from drgn.helpers.linux.block import (
+    blk_mq_inflight,
     disk_devt,
     disk_name,
     for_each_disk,
@@ -124,3 +125,16 @@ class TestBlock(LinuxHelperTestCase):
         else:
             self.fail("loop partition not found")
         self.assertEqual(part_name(part), os.path.basename(self.loop.name).encode())
+
+    def test_blk_mq_inflight(self):
+        if not self.loop:
+            self.skipTest("could not create loop device")
+        rdev = os.stat(self.loop.fileno()).st_rdev
+        devt = MKDEV(os.major(rdev), os.minor(rdev))
+        for disk in for_each_disk(self.prog):
+            if disk_devt(disk) == devt:
+                break
+        else:
+            self.fail("loop disk not found")
+        # The loop device is idle.
+        self.assertEqual(blk_mq_inflight(disk.queue), [])
@@ -7,8 +7,10 @@ import os
 from drgn.helpers.linux.cgroup import (
     cgroup_name,
     cgroup_path,
+    cgroup_walk,
     css_for_each_child,
     css_for_each_descendant_pre,
+    memcg_usage,
 )
 from drgn.helpers.linux.pid import find_task
 from tests.helpers.linux import LinuxHelperTestCase
@@ -57,3 +59,38 @@ class TestCgroup(LinuxHelperTestCase):
                 )
             )
         )
+
+    def test_cgroup_walk(self):
+        root = self.prog["cgrp_dfl_root"].cgrp.self.address_of_()
+        walked = list(cgroup_walk(root, ["level"]))
+        expected = list(css_for_each_descendant_pre(root))
+        self.assertEqual(
+            [cgrp.value_() for cgrp, _, _, _ in walked],
+            [css.cgroup.value_() for css in expected],
+        )
+        for cgrp, depth, name, (level,) in walked:
+            self.assertEqual(name, cgroup_name(cgrp))
+            self.assertEqual(level, cgrp.level)
+            self.assertEqual(depth, level)
+
+    def test_memcg_usage(self):
+        try:
+            root = self.prog["root_mem_cgroup"]
+        except KeyError:
+            self.skipTest("kernel does not support memory cgroups")
+        table = memcg_usage(self.prog)
+        self.assertEqual(len({len(column) for column in table.values()}), 1)
+        self.assertEqual(table["memcg"][0], root.value_())
+        self.assertEqual(table["depth"][0], 0)
+
+        walked = list(
+            cgroup_walk(root.css.address_of_(), type="struct mem_cgroup")
+        )
+        online = [i for i, flag in enumerate(table["online"]) if flag]
+        self.assertEqual(
+            [table["memcg"][i] for i in online],
+            [memcg.value_() for memcg, _, _, _ in walked],
+        )
+        self.assertEqual(
+            [table["name"][i] for i in online], [name for _, _, name, _ in walked]
+        )
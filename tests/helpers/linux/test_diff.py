@@ -0,0 +1,27 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+import unittest
+
+from drgn.helpers.linux.diff import describe_memory_diff, identify_address
+from tests.helpers.linux.test_slab import PAGE_OFFSET, slab_object, slab_program
+
+
+class TestDiff(unittest.TestCase):
+    def test_identify_address(self):
+        prog, _ = slab_program()
+        self.assertEqual(
+            identify_address(prog, slab_object(2, 1) + 8), "slab object: test+0x8"
+        )
+        self.assertIsNone(identify_address(prog, PAGE_OFFSET))
+
+    def test_describe_memory_diff(self):
+        prog, _ = slab_program()
+        self.assertEqual(
+            list(describe_memory_diff(prog, [(0x100, 8), (0x1040, 64)])),
+            [(0x100, 8, None), (0x1040, 64, "slab object: test+0x0")],
+        )
+        self.assertEqual(
+            list(describe_memory_diff(prog, [(slab_object(1, 1), 8)], physical=False)),
+            [(slab_object(1, 1), 8, "slab object: test+0x0")],
+        )
@@ -3,23 +3,179 @@
 
 import os
 import os.path
+import struct
 import tempfile
+import unittest
 
+from drgn import (
+    Object,
+    TypeMember,
+    int_type,
+    pointer_type,
+    struct_type,
+    void_type,
+)
 from drgn.helpers.linux.fs import (
     d_path,
     dentry_path,
     fget,
     for_each_file,
     for_each_mount,
+    for_each_sb_inode,
     inode_path,
     inode_paths,
     mount_dst,
     path_lookup,
+    sb_inode_table,
 )
 from drgn.helpers.linux.pid import find_task
+from tests import MockMemorySegment, mock_program
 from tests.helpers.linux import LinuxHelperTestCase, MS_BIND, mount, umount
 
 
+void_pointer_type = pointer_type(8, void_type())
+dentry_operations_type = struct_type(
+    "dentry_operations", 8, (TypeMember(void_pointer_type, "d_dname"),)
+)
+qstr_type = struct_type(
+    "qstr",
+    16,
+    (
+        TypeMember(int_type("u32", 4, False), "hash"),
+        TypeMember(int_type("u32", 4, False), "len", 32),
+        TypeMember(pointer_type(8, int_type("unsigned char", 1, False)), "name", 64),
+    ),
+)
+dentry_type = struct_type("dentry", 32, ())
+dentry_type = struct_type(
+    "dentry",
+    32,
+    (
+        TypeMember(pointer_type(8, dentry_type), "d_parent"),
+        TypeMember(qstr_type, "d_name", 64),
+        TypeMember(pointer_type(8, dentry_operations_type), "d_op", 192),
+    ),
+)
+vfsmount_type = struct_type(
+    "vfsmount", 8, (TypeMember(pointer_type(8, dentry_type), "mnt_root"),)
+)
+mount_type = struct_type("mount", 24, ())
+mount_type = struct_type(
+    "mount",
+    24,
+    (
+        TypeMember(pointer_type(8, mount_type), "mnt_parent"),
+        TypeMember(pointer_type(8, dentry_type), "mnt_mountpoint", 64),
+        TypeMember(vfsmount_type, "mnt", 128),
+    ),
+)
+
+
+class TestDentryPath(unittest.TestCase):
+    BASE = 0xFFFF0000
+    # Dentries are at BASE + 32 * i and mounts are at BASE + 0x1000 + 32 * i.
+    # Names are at BASE + 0x2000 + 16 * i.
+    ROOT1, USR, LIB, ROOT2, FOO, PIPE = range(6)
+    MNT1, MNT2 = range(2)
+
+    def dentry(self, i):
+        return self.BASE + 32 * i
+
+    def mount(self, i):
+        return self.BASE + 0x1000 + 32 * i
+
+    def setUp(self):
+        self.buf = bytearray(0x3000)
+        d_op = self.BASE + 0x2800
+        dentries = [
+            (self.ROOT1, b"/", 0),
+            (self.ROOT1, b"usr", 0),
+            (self.USR, b"lib", 0),
+            (self.ROOT2, b"/", 0),
+            (self.ROOT2, b"foo", 0),
+            (self.ROOT2, b"pipe", d_op),
+        ]
+        for i, (parent, name, op) in enumerate(dentries):
+            name_address = self.BASE + 0x2000 + 16 * i
+            struct.pack_into(
+                "<QIIQQ",
+                self.buf,
+                32 * i,
+                self.dentry(parent),
+                0,
+                len(name),
+                name_address,
+                op,
+            )
+            offset = name_address - self.BASE
+            self.buf[offset : offset + len(name)] = name
+        struct.pack_into("<Q", self.buf, d_op - self.BASE, 0xFFFFFFFF81000000)
+        # MNT2 is mounted on /usr/lib.
+        mounts = [
+            (self.MNT1, self.ROOT1, self.ROOT1),
+            (self.MNT1, self.LIB, self.ROOT2),
+        ]
+        for i, (parent, mountpoint, root) in enumerate(mounts):
+            struct.pack_into(
+                "<QQQ",
+                self.buf,
+                0x1000 + 32 * i,
+                self.mount(parent),
+                self.dentry(mountpoint),
+                self.dentry(root),
+            )
+        self.prog = mock_program(
+            segments=[MockMemorySegment(self.buf, virt_addr=self.BASE)],
+            types=[dentry_type, dentry_operations_type, mount_type, vfsmount_type],
+        )
+
+    def dentry_object(self, i):
+        return Object(self.prog, pointer_type(8, dentry_type), value=self.dentry(i))
+
+    def vfsmount_object(self, i):
+        return Object(
+            self.prog, pointer_type(8, vfsmount_type), value=self.mount(i) + 16
+        )
+
+    def assert_paths(self):
+        self.assertEqual(
+            d_path(self.vfsmount_object(self.MNT2), self.dentry_object(self.FOO)),
+            b"/usr/lib/foo",
+        )
+        self.assertEqual(
+            d_path(self.vfsmount_object(self.MNT2), self.dentry_object(self.ROOT2)),
+            b"/usr/lib",
+        )
+        self.assertEqual(
+            d_path(self.vfsmount_object(self.MNT1), self.dentry_object(self.ROOT1)),
+            b"/",
+        )
+        self.assertIsNone(
+            d_path(self.vfsmount_object(self.MNT2), self.dentry_object(self.PIPE))
+        )
+        self.assertEqual(dentry_path(self.dentry_object(self.FOO)), b"foo")
+        self.assertEqual(dentry_path(self.dentry_object(self.LIB)), b"usr/lib")
+        self.assertEqual(dentry_path(self.dentry_object(self.ROOT1)), b"")
+
+    def test_no_cache(self):
+        self.prog.memory_cache_size = 0
+        self.assert_paths()
+
+    def test_cache(self):
+        self.prog.memory_cache_size = 1024 * 1024
+        # Run twice so that the second time uses the cached paths.
+        self.assert_paths()
+        self.assert_paths()
+        # Cached paths must be discarded along with the memory cache.
+        self.buf[0x2000 + 16 * self.USR : 0x2000 + 16 * self.USR + 3] = b"opt"
+        self.prog.invalidate_memory_cache()
+        self.assertEqual(
+            d_path(self.vfsmount_object(self.MNT2), self.dentry_object(self.FOO)),
+            b"/opt/lib/foo",
+        )
+        self.assertEqual(dentry_path(self.dentry_object(self.LIB)), b"opt/lib")
+
+
 class TestFs(LinuxHelperTestCase):
     def test_path_lookup(self):
         with tempfile.NamedTemporaryFile(prefix="drgn-tests-") as f:
@@ -63,6 +219,20 @@ class TestFs(LinuxHelperTestCase):
                     )
                     self.assertIn(inode_path(inode), paths)
 
+    def test_for_each_sb_inode(self):
+        with tempfile.NamedTemporaryFile(prefix="drgn-tests-") as f:
+            f.write(b"x" * 8192)
+            f.flush()
+            inode = path_lookup(self.prog, os.path.abspath(f.name)).dentry.d_inode
+            inode = inode.read_()
+            self.assertIn(inode, for_each_sb_inode(inode.i_sb))
+
+            table = sb_inode_table(inode.i_sb, page_cache=True)
+            i = table["inode"].index(inode.value_())
+            self.assertEqual(table["ino"][i], os.fstat(f.fileno()).st_ino)
+            self.assertEqual(table["nrpages"][i], inode.i_mapping.nrpages.value_())
+            self.assertGreater(table["page_entries"][i], 0)
+
     def test_for_each_mount(self):
         with open("/proc/self/mounts", "rb") as f:
             self.assertEqual(
@@ -0,0 +1,36 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+from drgn.helpers.linux.ftrace import (
+    decode_ftrace_event,
+    ftrace_event_formats,
+    ftrace_events,
+)
+from tests.helpers.linux import LinuxHelperTestCase
+
+
+class TestFtrace(LinuxHelperTestCase):
+    def setUp(self):
+        super().setUp()
+        try:
+            self.prog["global_trace"]
+        except KeyError:
+            self.skipTest("kernel not built with CONFIG_TRACING")
+
+    def test_ftrace_event_formats(self):
+        formats = ftrace_event_formats(self.prog)
+        names = {name for system, name, fields in formats.values()}
+        self.assertIn("sched_switch", names)
+        for system, name, fields in formats.values():
+            self.assertEqual(fields[0][0], "common_type")
+
+    def test_ftrace_events(self):
+        events = ftrace_events(self.prog)
+        timestamps = [timestamp for cpu, timestamp, type, data in events]
+        self.assertEqual(timestamps, sorted(timestamps))
+        formats = ftrace_event_formats(self.prog)
+        for cpu, timestamp, type, data in events:
+            if type in formats:
+                self.assertEqual(
+                    decode_ftrace_event(self.prog, data)["common_type"], type
+                )
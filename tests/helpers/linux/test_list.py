@@ -0,0 +1,218 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+import operator
+import struct
+import unittest
+
+from drgn import (
+    FaultError,
+    Object,
+    TypeMember,
+    int_type,
+    pointer_type,
+    struct_type,
+)
+from drgn.helpers.linux.list import (
+    hlist_for_each,
+    hlist_for_each_entry,
+    list_for_each,
+    list_for_each_entry,
+    list_for_each_entry_reverse,
+    list_for_each_reverse,
+)
+from tests import MockMemorySegment, mock_program
+
+
+list_head_type = struct_type("list_head", 16, ())
+list_head_type = struct_type(
+    "list_head",
+    16,
+    (
+        TypeMember(pointer_type(8, list_head_type), "next"),
+        TypeMember(pointer_type(8, list_head_type), "prev", 64),
+    ),
+)
+hlist_node_type = struct_type("hlist_node", 16, ())
+hlist_node_type = struct_type(
+    "hlist_node",
+    16,
+    (
+        TypeMember(pointer_type(8, hlist_node_type), "next"),
+        TypeMember(pointer_type(8, pointer_type(8, hlist_node_type)), "pprev", 64),
+    ),
+)
+hlist_head_type = struct_type(
+    "hlist_head", 8, (TypeMember(pointer_type(8, hlist_node_type), "first"),)
+)
+entry_type = struct_type(
+    "entry",
+    24,
+    (
+        TypeMember(int_type("int", 4, True), "value"),
+        TypeMember(list_head_type, "node", 64),
+    ),
+)
+hentry_type = struct_type(
+    "hentry",
+    24,
+    (
+        TypeMember(int_type("int", 4, True), "value"),
+        TypeMember(hlist_node_type, "node", 64),
+    ),
+)
+
+BASE = 0xFFFF0000
+# Head at BASE, entries at BASE + 16, BASE + 40, and BASE + 64.
+ENTRIES = [BASE + 16 + 24 * i for i in range(3)]
+
+
+def list_program():
+    nodes = [BASE] + [entry + 8 for entry in ENTRIES]
+    buf = bytearray(16 + 24 * len(ENTRIES))
+    for i, node in enumerate(nodes):
+        struct.pack_into(
+            "<QQ", buf, node - BASE, nodes[(i + 1) % len(nodes)], nodes[i - 1]
+        )
+        if i:
+            struct.pack_into("<i", buf, node - 8 - BASE, i * 10)
+    return mock_program(
+        segments=[MockMemorySegment(bytes(buf), virt_addr=BASE)],
+        types=[list_head_type, entry_type],
+    )
+
+
+def hlist_program():
+    nodes = [entry + 8 for entry in ENTRIES]
+    buf = bytearray(16 + 24 * len(ENTRIES))
+    struct.pack_into("<Q", buf, 0, nodes[0])
+    for i, node in enumerate(nodes):
+        struct.pack_into(
+            "<QQ",
+            buf,
+            node - BASE,
+            nodes[i + 1] if i + 1 < len(nodes) else 0,
+            nodes[i - 1] if i else BASE,
+        )
+        struct.pack_into("<i", buf, node - 8 - BASE, (i + 1) * 10)
+    return mock_program(
+        segments=[MockMemorySegment(bytes(buf), virt_addr=BASE)],
+        types=[hlist_node_type, hlist_head_type, hentry_type],
+    )
+
+
+class TestList(unittest.TestCase):
+    def test_list_for_each(self):
+        prog = list_program()
+        head = Object(prog, pointer_type(8, list_head_type), value=BASE)
+        self.assertEqual(
+            [pos.value_() for pos in list_for_each(head)],
+            [entry + 8 for entry in ENTRIES],
+        )
+        self.assertEqual(
+            [pos.value_() for pos in list_for_each_reverse(head)],
+            [entry + 8 for entry in reversed(ENTRIES)],
+        )
+        self.assertEqual(
+            [pos.type_ for pos in list_for_each(head)],
+            [head.next.type_] * len(ENTRIES),
+        )
+
+    def test_list_for_each_entry(self):
+        prog = list_program()
+        head = Object(prog, pointer_type(8, list_head_type), value=BASE)
+        entries = list(list_for_each_entry("struct entry", head, "node"))
+        self.assertEqual([entry.value_() for entry in entries], ENTRIES)
+        self.assertEqual([entry.value.value_() for entry in entries], [10, 20, 30])
+        self.assertEqual(entries[0].type_, pointer_type(8, prog.type("struct entry")))
+        self.assertEqual(
+            [
+                entry.value_()
+                for entry in list_for_each_entry_reverse(entry_type, head, "node")
+            ],
+            list(reversed(ENTRIES)),
+        )
+
+    def test_list_head_reference(self):
+        prog = list_program()
+        head = Object(prog, list_head_type, address=BASE)
+        self.assertEqual(
+            [pos.value_() for pos in list_for_each(head)],
+            [entry + 8 for entry in ENTRIES],
+        )
+
+    def test_list_empty(self):
+        buf = struct.pack("<QQ", BASE, BASE)
+        prog = mock_program(
+            segments=[MockMemorySegment(buf, virt_addr=BASE)],
+            types=[list_head_type, entry_type],
+        )
+        head = Object(prog, list_head_type, address=BASE)
+        self.assertEqual(list(list_for_each(head)), [])
+        self.assertEqual(list(list_for_each_entry(entry_type, head, "node")), [])
+
+    def test_list_invalid(self):
+        prog = list_program()
+        self.assertRaises(
+            TypeError, list_for_each, Object(prog, int_type("int", 4, True), value=BASE)
+        )
+        head = Object(prog, pointer_type(8, list_head_type), value=BASE)
+        self.assertRaises(LookupError, list_for_each_entry, entry_type, head, "foo")
+
+    def test_list_long(self):
+        # Long enough to be fetched in several batches.
+        n = 300
+        nodes = [BASE + 16 * i for i in range(n + 1)]
+        buf = bytearray(16 * len(nodes))
+        for i, node in enumerate(nodes):
+            struct.pack_into(
+                "<QQ", buf, node - BASE, nodes[(i + 1) % len(nodes)], nodes[i - 1]
+            )
+        prog = mock_program(
+            segments=[MockMemorySegment(bytes(buf), virt_addr=BASE)],
+            types=[list_head_type],
+        )
+        head = Object(prog, list_head_type, address=BASE)
+        self.assertEqual([pos.value_() for pos in list_for_each(head)], nodes[1:])
+        it = list_for_each(head)
+        self.assertEqual(next(it).value_(), nodes[1])
+        self.assertEqual(operator.length_hint(it, -1), -1)
+        self.assertEqual([pos.value_() for pos in it], nodes[2:])
+        self.assertEqual(operator.length_hint(it), 0)
+
+    def test_list_fault(self):
+        # The second entry points to unreadable memory.
+        buf = bytearray(16 * 3)
+        struct.pack_into("<QQ", buf, 0, BASE + 16, BASE + 32)
+        struct.pack_into("<QQ", buf, 16, BASE + 32, BASE)
+        struct.pack_into("<QQ", buf, 32, 0xDEAD0000, BASE + 16)
+        prog = mock_program(
+            segments=[MockMemorySegment(bytes(buf), virt_addr=BASE)],
+            types=[list_head_type],
+        )
+        it = list_for_each(Object(prog, list_head_type, address=BASE))
+        self.assertEqual(next(it).value_(), BASE + 16)
+        self.assertEqual(next(it).value_(), BASE + 32)
+        self.assertEqual(next(it).value_(), 0xDEAD0000)
+        self.assertRaises(FaultError, next, it)
+        self.assertRaises(StopIteration, next, it)
+
+    def test_hlist_for_each(self):
+        prog = hlist_program()
+        head = Object(prog, pointer_type(8, hlist_head_type), value=BASE)
+        self.assertEqual(
+            [pos.value_() for pos in hlist_for_each(head)],
+            [entry + 8 for entry in ENTRIES],
+        )
+        entries = list(hlist_for_each_entry("struct hentry", head, "node"))
+        self.assertEqual([entry.value_() for entry in entries], ENTRIES)
+        self.assertEqual([entry.value.value_() for entry in entries], [10, 20, 30])
+
+    def test_hlist_empty(self):
+        prog = mock_program(
+            segments=[MockMemorySegment(bytes(8), virt_addr=BASE)],
+            types=[hlist_node_type, hlist_head_type, hentry_type],
+        )
+        head = Object(prog, hlist_head_type, address=BASE)
+        self.assertEqual(list(hlist_for_each(head)), [])
+        self.assertEqual(list(hlist_for_each_entry(hentry_type, head, "node")), [])
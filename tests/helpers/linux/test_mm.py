@@ -11,22 +11,223 @@ import struct
 import tempfile
 import unittest
 
-from drgn import FaultError
+from drgn import (
+    FaultError,
+    TypeMember,
+    array_type,
+    int_type,
+    pointer_type,
+    struct_type,
+    union_type,
+    void_type,
+)
 from drgn.helpers.linux.mm import (
     access_process_vm,
     access_remote_vm,
     cmdline,
     environ,
+    for_each_page,
+    page_owner_stacks,
+    page_pfns,
     page_to_pfn,
     pfn_to_page,
     pfn_to_virt,
     pgtable_l5_enabled,
+    task_args,
+    task_rss,
     virt_to_pfn,
+    vm_translation,
+    vmalloc_areas,
+    vmalloc_callers,
 )
 from drgn.helpers.linux.pid import find_task
+from tests import MockMemorySegment, MockObject, mock_program
 from tests.helpers.linux import LinuxHelperTestCase, mlock
 
 
+class TestForEachPage(unittest.TestCase):
+    VMEMMAP = 0xFFFFEA0000000000
+    MAX_PFN = 1500
+    # The memory map for PFNs 512-1023 is not populated.
+    HOLE = range(512, 1024)
+
+    def setUp(self):
+        page_type = struct_type(
+            "page",
+            64,
+            (TypeMember(int_type("unsigned long", 8, False), "flags"),),
+        )
+
+        def pages(start, end):
+            return b"".join(
+                struct.pack("<Q56x", pfn % 4) for pfn in range(start, end)
+            )
+
+        self.prog = mock_program(
+            segments=[
+                MockMemorySegment(pages(0, self.HOLE.start), virt_addr=self.VMEMMAP),
+                MockMemorySegment(
+                    pages(self.HOLE.stop, self.MAX_PFN),
+                    virt_addr=self.VMEMMAP + self.HOLE.stop * 64,
+                ),
+            ],
+            types=[page_type],
+            objects=[
+                MockObject("vmemmap", pointer_type(8, page_type), value=self.VMEMMAP),
+                MockObject(
+                    "max_pfn", int_type("unsigned long", 8, False), value=self.MAX_PFN
+                ),
+            ],
+        )
+        self.pfns = [pfn for pfn in range(self.MAX_PFN) if pfn not in self.HOLE]
+
+    def test_for_each_page(self):
+        self.assertEqual(
+            [page.value_() for page in for_each_page(self.prog)],
+            [self.VMEMMAP + pfn * 64 for pfn in self.pfns],
+        )
+        self.assertEqual(
+            [page.value_() for page in for_each_page(self.prog, 3)],
+            [self.VMEMMAP + pfn * 64 for pfn in self.pfns if pfn % 4 == 3],
+        )
+
+    def test_page_pfns(self):
+        self.assertEqual(list(page_pfns(self.prog)), self.pfns)
+        self.assertEqual(
+            list(page_pfns(self.prog, 2)), [pfn for pfn in self.pfns if pfn & 2]
+        )
+        self.assertEqual(list(page_pfns(self.prog, 4)), [])
+
+
+class TestPageOwner(unittest.TestCase):
+    VMEMMAP = 0xFFFFEA0000000000
+    MAX_PFN = 1024
+    MEM_SECTION = 0xFFFF000000000000
+    PAGE_EXT = 0xFFFF000000100000
+    STACK_POOLS = 0xFFFF000000200000
+    POOL = 0xFFFF000000300000
+    PAGE_OWNER_OPS = 0xFFFF000000400000
+    PAGE_EXT_SIZE = 0xFFFF000000400100
+
+    @staticmethod
+    def handle(pool_index, offset):
+        return pool_index | (offset << 17) | (1 << 27)
+
+    def setUp(self):
+        u16 = int_type("unsigned short", 2, False)
+        u32 = int_type("unsigned int", 4, False)
+        ulong = int_type("unsigned long", 8, False)
+        page_type = struct_type("page", 64, (TypeMember(ulong, "flags"),))
+        page_ext_type = struct_type("page_ext", 8, (TypeMember(ulong, "flags"),))
+        mem_section_type = struct_type(
+            "mem_section",
+            16,
+            (
+                TypeMember(ulong, "section_mem_map"),
+                TypeMember(pointer_type(8, page_ext_type), "page_ext", 64),
+            ),
+        )
+        types = [
+            page_type,
+            page_ext_type,
+            mem_section_type,
+            struct_type(
+                "page_owner",
+                8,
+                (TypeMember(u16, "order"), TypeMember(u32, "handle", 32)),
+            ),
+            struct_type("page_ext_operations", 8, (TypeMember(ulong, "offset"),)),
+            union_type(
+                "handle_parts",
+                4,
+                (
+                    TypeMember(u32, "handle"),
+                    TypeMember(
+                        struct_type(
+                            None,
+                            4,
+                            (
+                                TypeMember(u32, "pool_index", 0, 17),
+                                TypeMember(u32, "offset", 17, 10),
+                                TypeMember(u32, "valid", 27, 1),
+                            ),
+                        )
+                    ),
+                ),
+            ),
+            struct_type(
+                "stack_record",
+                8,
+                (
+                    TypeMember(u32, "size"),
+                    TypeMember(array_type(None, ulong), "entries", 64),
+                ),
+            ),
+        ]
+
+        h1 = self.handle(1, 0)
+        h2 = self.handle(1, 2)
+        # PFN: (allocated, order, handle). PFN 9 was freed.
+        records = {0: (True, 0, h1), 8: (True, 0, h1), 9: (False, 0, h2)}
+        records.update((pfn, (True, 2, h2)) for pfn in range(4, 8))
+        records[600] = (True, 0, h2)
+        page_ext = b"".join(
+            struct.pack(
+                "<QHxxI",
+                2 if records.get(pfn, (False,))[0] else 0,
+                *records.get(pfn, (False, 0, 0))[1:],
+            )
+            for pfn in range(self.MAX_PFN)
+        )
+        pool = struct.pack("<I4x2Q", 2, 0xFFFFFFFF81000010, 0xFFFFFFFF81000020)
+        pool += bytes(32 - len(pool)) + struct.pack("<I4xQ", 1, 0xFFFFFFFF81000030)
+
+        self.prog = mock_program(
+            segments=[
+                MockMemorySegment(bytes(self.MAX_PFN * 64), virt_addr=self.VMEMMAP),
+                MockMemorySegment(
+                    struct.pack("<QQ", 2, self.PAGE_EXT), virt_addr=self.MEM_SECTION
+                ),
+                MockMemorySegment(page_ext, virt_addr=self.PAGE_EXT),
+                MockMemorySegment(
+                    struct.pack("<QQ", 0, self.POOL), virt_addr=self.STACK_POOLS
+                ),
+                MockMemorySegment(pool, virt_addr=self.POOL),
+                MockMemorySegment(struct.pack("<Q", 8), virt_addr=self.PAGE_OWNER_OPS),
+                MockMemorySegment(struct.pack("<Q", 16), virt_addr=self.PAGE_EXT_SIZE),
+            ],
+            types=types,
+            objects=[
+                MockObject("vmemmap", pointer_type(8, page_type), value=self.VMEMMAP),
+                MockObject("max_pfn", ulong, value=self.MAX_PFN),
+                MockObject(
+                    "mem_section",
+                    array_type(1, array_type(1, mem_section_type)),
+                    address=self.MEM_SECTION,
+                ),
+                MockObject("page_ext_size", ulong, address=self.PAGE_EXT_SIZE),
+                MockObject("page_owner_ops", types[4], address=self.PAGE_OWNER_OPS),
+                MockObject("PAGE_EXT_OWNER_ALLOCATED", u32, value=1),
+                MockObject(
+                    "stack_pools",
+                    array_type(2, pointer_type(8, void_type())),
+                    address=self.STACK_POOLS,
+                ),
+            ],
+        )
+        self.h1 = h1
+        self.h2 = h2
+
+    def test_page_owner_stacks(self):
+        self.assertEqual(
+            page_owner_stacks(self.prog),
+            [
+                (self.h2, (0xFFFFFFFF81000030,), 2, 5),
+                (self.h1, (0xFFFFFFFF81000010, 0xFFFFFFFF81000020), 2, 2),
+            ],
+        )
+
+
 class TestMm(LinuxHelperTestCase):
     def test_page_constants(self):
         self.assertEqual(self.prog["PAGE_SIZE"], mmap.PAGESIZE)
@@ -109,6 +310,26 @@ class TestMm(LinuxHelperTestCase):
                 access_process_vm(task, address + 1, len(map) - 2), map[1:-1]
             )
 
+    def test_vm_translation(self):
+        task = find_task(self.prog, os.getpid())
+        translation = vm_translation(task.mm)
+        data = b"hello, world"
+        buf = ctypes.create_string_buffer(data)
+        address = ctypes.addressof(buf)
+        self.assertEqual(access_process_vm(task, address, len(data), translation), data)
+        # The second read uses the cached translation.
+        self.assertEqual(translation.read(address, len(data)), data)
+        self.assertRaises(FaultError, translation.read, 0, 8)
+        with self._pages() as (map, address, _):
+            translation.fill(address, len(map))
+            self.assertEqual(translation.read(address, len(map)), map[:])
+            self.assertEqual(
+                access_remote_vm(task.mm, address + 1, len(map) - 2, translation),
+                map[1:-1],
+            )
+        self.assertEqual(cmdline(task, translation), cmdline(task))
+        self.assertEqual(environ(task, translation), environ(task))
+
     @unittest.skipUnless(platform.machine() == "x86_64", "machine is not x86_64")
     def test_non_canonical_x86_64(self):
         task = find_task(self.prog, os.getpid())
@@ -131,6 +352,69 @@ class TestMm(LinuxHelperTestCase):
         task = find_task(self.prog, os.getpid())
         self.assertEqual(environ(task), proc_environ)
 
+    def test_task_args(self):
+        task = find_task(self.prog, os.getpid())
+        kthreadd = find_task(self.prog, 2)
+        self.assertEqual(
+            task_args(self.prog, [task, kthreadd, task]),
+            [
+                (task, cmdline(task), environ(task)),
+                (kthreadd, None, None),
+                (task, cmdline(task), environ(task)),
+            ],
+        )
+        self.assertEqual(
+            task_args(self.prog, [task], environ=False),
+            [(task, cmdline(task), None)],
+        )
+        pid = os.getpid()
+        for t, args, env in task_args(self.prog):
+            if t.pid == pid:
+                self.assertEqual(args, cmdline(task))
+                self.assertEqual(env, environ(task))
+                break
+        else:
+            self.fail("current task not found")
+
+    def test_task_rss(self):
+        page_size = mmap.PAGESIZE
+        num_pages = 4096
+        with mmap.mmap(-1, num_pages * page_size) as m:
+            for i in range(num_pages):
+                m[i * page_size] = 1
+            table = task_rss(self.prog)
+
+        self.assertEqual(len({len(column) for column in table.values()}), 1)
+        tasks = list(table["task"])
+        task = find_task(self.prog, os.getpid())
+        i = tasks.index(task.value_())
+        self.assertEqual(table["mm"][i], task.mm.value_())
+        self.assertGreaterEqual(table["anon"][i], num_pages)
+        self.assertEqual(
+            table["rss"][i],
+            table["file"][i] + table["anon"][i] + table["shmem"][i],
+        )
+
+        i = tasks.index(find_task(self.prog, 2).value_())
+        self.assertEqual(table["mm"][i], 0)
+        self.assertEqual(table["rss"][i], 0)
+
+    def test_vmalloc_areas(self):
+        table = vmalloc_areas(self.prog)
+        self.assertEqual(len({len(column) for column in table.values()}), 1)
+        self.assertTrue(table["address"])
+        self.assertEqual(table["address"], sorted(table["address"]))
+        self.assertIn("alloc_large_system_hash", table["symbol"])
+        for vm, caller in zip(table["vm"], table["caller"]):
+            if not vm:
+                self.assertEqual(caller, 0)
+
+        callers = vmalloc_callers(self.prog)
+        self.assertEqual(len({len(column) for column in callers.values()}), 1)
+        self.assertEqual(len(set(callers["caller"])), len(callers["caller"]))
+        self.assertEqual(callers["size"], sorted(callers["size"], reverse=True))
+        self.assertIn("alloc_large_system_hash", callers["symbol"])
+
     @unittest.skipUnless(platform.machine() == "x86_64", "machine is not x86_64")
     def test_pgtable_l5_enabled(self):
         with open("/proc/cpuinfo", "r") as f:
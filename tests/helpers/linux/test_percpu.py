@@ -0,0 +1,118 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+import struct
+import unittest
+
+from drgn import (
+    Object,
+    OutOfBoundsError,
+    TypeMember,
+    array_type,
+    int_type,
+    pointer_type,
+    struct_type,
+)
+from drgn.helpers.linux.percpu import (
+    per_cpu_ptr,
+    per_cpu_ptrs,
+    percpu_counter_sum,
+    percpu_sum,
+)
+from tests import MockMemorySegment, MockObject, mock_program
+
+
+int_type_ = int_type("int", 4, True)
+unsigned_long_type = int_type("unsigned long", 8, False)
+cpumask_type = struct_type(
+    "cpumask", 8, (TypeMember(array_type(1, unsigned_long_type), "bits"),)
+)
+percpu_counter_type = struct_type(
+    "percpu_counter",
+    16,
+    (
+        TypeMember(int_type("long long", 8, True), "count"),
+        TypeMember(pointer_type(8, int_type_), "counters", 64),
+    ),
+)
+
+BASE = 0xFFFF0000
+NR_CPUS = 4
+OFFSETS = BASE
+ONLINE_MASK = BASE + 8 * NR_CPUS
+COUNTER = ONLINE_MASK + 8
+# The per-CPU variable is at address PERCPU in the per-CPU area, and the copy
+# for CPU n is at BASE + PERCPU + 16 * n.
+PERCPU = 0x100
+VALUES = [-3, 5, 7, 100]
+ONLINE_CPUS = [0, 1, 3]
+
+
+def percpu_program():
+    buf = bytearray(PERCPU + 16 * NR_CPUS)
+    for cpu, value in enumerate(VALUES):
+        struct.pack_into("<Q", buf, OFFSETS - BASE + 8 * cpu, BASE + 16 * cpu)
+        struct.pack_into("<i", buf, PERCPU + 16 * cpu, value)
+    struct.pack_into(
+        "<Q", buf, ONLINE_MASK - BASE, sum(1 << cpu for cpu in ONLINE_CPUS)
+    )
+    struct.pack_into("<qQ", buf, COUNTER - BASE, 1000, PERCPU)
+    return mock_program(
+        segments=[MockMemorySegment(bytes(buf), virt_addr=BASE)],
+        types=[cpumask_type, percpu_counter_type],
+        objects=[
+            MockObject(
+                "__per_cpu_offset",
+                array_type(NR_CPUS, unsigned_long_type),
+                address=OFFSETS,
+            ),
+            MockObject("__cpu_online_mask", cpumask_type, address=ONLINE_MASK),
+        ],
+    )
+
+
+class TestPercpu(unittest.TestCase):
+    def setUp(self):
+        self.prog = percpu_program()
+        self.ptr = Object(self.prog, pointer_type(8, int_type_), value=PERCPU)
+
+    def test_per_cpu_ptr(self):
+        for cpu, value in enumerate(VALUES):
+            ptr = per_cpu_ptr(self.ptr, cpu)
+            self.assertEqual(ptr.type_, self.ptr.type_)
+            self.assertEqual(ptr.value_(), BASE + PERCPU + 16 * cpu)
+            self.assertEqual(ptr[0].value_(), value)
+        self.assertRaises(OutOfBoundsError, per_cpu_ptr, self.ptr, NR_CPUS)
+
+    def test_per_cpu_ptrs(self):
+        ptrs = per_cpu_ptrs(self.ptr)
+        self.assertEqual(list(ptrs), ONLINE_CPUS)
+        self.assertEqual(
+            {cpu: ptr[0].value_() for cpu, ptr in ptrs.items()},
+            {cpu: VALUES[cpu] for cpu in ONLINE_CPUS},
+        )
+        mask = Object(self.prog, pointer_type(8, cpumask_type), value=ONLINE_MASK)
+        self.assertEqual(list(per_cpu_ptrs(self.ptr, mask)), ONLINE_CPUS)
+
+    def test_percpu_sum(self):
+        self.assertEqual(
+            percpu_sum(self.ptr), sum(VALUES[cpu] for cpu in ONLINE_CPUS)
+        )
+        unsigned_ptr = Object(
+            self.prog, pointer_type(8, int_type("unsigned int", 4, False)), value=PERCPU
+        )
+        self.assertEqual(
+            percpu_sum(unsigned_ptr),
+            sum(VALUES[cpu] & 0xFFFFFFFF for cpu in ONLINE_CPUS),
+        )
+        self.assertRaises(
+            TypeError,
+            percpu_sum,
+            Object(self.prog, pointer_type(8, cpumask_type), value=PERCPU),
+        )
+
+    def test_percpu_counter_sum(self):
+        fbc = Object(self.prog, pointer_type(8, percpu_counter_type), value=COUNTER)
+        self.assertEqual(
+            percpu_counter_sum(fbc), 1000 + sum(VALUES[cpu] for cpu in ONLINE_CPUS)
+        )
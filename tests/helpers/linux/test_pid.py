@@ -4,6 +4,7 @@
 import os
 
 from drgn.helpers.linux.pid import (
+    cache_pids,
     find_pid,
     find_task,
     for_each_pid,
@@ -37,3 +38,33 @@ class TestPid(LinuxHelperTestCase):
     def test_for_each_task(self):
         pid = os.getpid()
         self.assertTrue(any(task.pid == pid for task in for_each_task(self.prog)))
+
+    def test_for_each_task_filter(self):
+        pid = os.getpid()
+        with open("/proc/self/comm", "r") as f:
+            comm = f.read()[:-1]
+        self.assertEqual(
+            [task.pid.value_() for task in for_each_task(self.prog, pid=pid)], [pid]
+        )
+        self.assertIn(
+            pid,
+            [
+                task.pid.value_()
+                for task in for_each_task(
+                    self.prog, comm=comm[:1] + "*", tgid=range(pid, pid + 1)
+                )
+            ],
+        )
+        self.assertEqual(list(for_each_task(self.prog, pid=range(0))), [])
+        self.assertFalse(list(for_each_task(self.prog, comm=comm, state="X")))
+
+    def test_cache_pids(self):
+        pid = os.getpid()
+        cache_pids(self.prog)
+        try:
+            self.assertEqual(find_pid(self.prog, pid).numbers[0].nr, pid)
+            self.assertEqual(find_task(self.prog, pid).pid, pid)
+            self.assertEqual(find_task(self.prog, 2 ** 31 - 1).value_(), 0)
+        finally:
+            self.prog.invalidate_memory_cache()
+        self.assertEqual(find_task(self.prog, pid).pid, pid)
@@ -0,0 +1,143 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+import struct
+import unittest
+
+from drgn import (
+    Object,
+    TypeMember,
+    array_type,
+    int_type,
+    pointer_type,
+    struct_type,
+    void_type,
+)
+from drgn.helpers.linux.idr import idr_find, idr_for_each
+from drgn.helpers.linux.radixtree import radix_tree_for_each, radix_tree_lookup
+from tests import MockMemorySegment, mock_program
+
+
+unsigned_char_type = int_type("unsigned char", 1, False)
+void_pointer_type = pointer_type(8, void_type())
+
+
+def node_type(name):
+    return struct_type(
+        name,
+        552,
+        (
+            TypeMember(unsigned_char_type, "shift"),
+            TypeMember(unsigned_char_type, "offset", 8),
+            TypeMember(unsigned_char_type, "count", 16),
+            TypeMember(unsigned_char_type, "nr_values", 24),
+            TypeMember(array_type(64, void_pointer_type), "slots", 320),
+        ),
+    )
+
+
+xa_node_type = node_type("xa_node")
+radix_tree_node_type = node_type("radix_tree_node")
+xarray_type = struct_type("xarray", 8, (TypeMember(void_pointer_type, "xa_head"),))
+radix_tree_root_type = struct_type(
+    "radix_tree_root",
+    8,
+    (TypeMember(pointer_type(8, radix_tree_node_type), "rnode"),),
+)
+idr_type = struct_type(
+    "idr",
+    16,
+    (
+        TypeMember(xarray_type, "idr_rt"),
+        TypeMember(int_type("unsigned int", 4, False), "idr_base", 64),
+    ),
+)
+
+BASE = 0xFFFF0000
+ROOT_NODE = BASE + 0x1000
+CHILD_NODE = BASE + 0x2000
+
+
+def radix_tree_program(internal_node, root_type):
+    # The root node covers indices 0-4095 and has an entry at index 0, a child
+    # node at slot 1, and a sibling entry at slot 2. The child node has entries
+    # at indices 64 and 69.
+    if internal_node == 2:
+        sibling = 2
+    else:
+        sibling = (ROOT_NODE + 40) | internal_node
+    buf = bytearray(0x3000)
+    struct.pack_into("<Q", buf, 0, ROOT_NODE | internal_node)
+    struct.pack_into("<Q", buf, 8, 100)
+    struct.pack_into("<BBBB", buf, ROOT_NODE - BASE, 6, 0, 3, 0)
+    struct.pack_into(
+        "<QQQ", buf, ROOT_NODE - BASE + 40, 0x1000, CHILD_NODE | internal_node, sibling
+    )
+    struct.pack_into("<BBBB", buf, CHILD_NODE - BASE, 0, 1, 2, 0)
+    struct.pack_into("<Q", buf, CHILD_NODE - BASE + 40, 0x2000)
+    struct.pack_into("<Q", buf, CHILD_NODE - BASE + 40 + 5 * 8, 0x3000)
+    prog = mock_program(
+        segments=[MockMemorySegment(bytes(buf), virt_addr=BASE)],
+        types=[xa_node_type, radix_tree_node_type, xarray_type, idr_type],
+    )
+    return prog, Object(prog, pointer_type(8, root_type), value=BASE)
+
+
+EXPECTED = [(0, 0x1000), (64, 0x2000), (69, 0x3000)]
+
+
+class TestRadixTree(unittest.TestCase):
+    def assert_entries(self, it, expected):
+        entries = list(it)
+        self.assertEqual(
+            [(index, entry.value_()) for index, entry in entries], expected
+        )
+        for _, entry in entries:
+            self.assertEqual(entry.type_, void_pointer_type)
+
+    def test_xarray(self):
+        prog, root = radix_tree_program(2, xarray_type)
+        self.assert_entries(radix_tree_for_each(root), EXPECTED)
+        for index, value in EXPECTED:
+            self.assertEqual(radix_tree_lookup(root, index).value_(), value)
+
+    def test_radix_tree(self):
+        prog, root = radix_tree_program(1, radix_tree_root_type)
+        self.assert_entries(radix_tree_for_each(root), EXPECTED)
+
+    def test_root_entry(self):
+        prog = mock_program(
+            segments=[MockMemorySegment(struct.pack("<Q", 0x1000), virt_addr=BASE)],
+            types=[xa_node_type],
+        )
+        root = Object(prog, xarray_type, address=BASE)
+        self.assert_entries(radix_tree_for_each(root), [(0, 0x1000)])
+
+    def test_empty(self):
+        prog = mock_program(
+            segments=[MockMemorySegment(bytes(8), virt_addr=BASE)],
+            types=[xa_node_type],
+        )
+        root = Object(prog, xarray_type, address=BASE)
+        self.assert_entries(radix_tree_for_each(root), [])
+
+    def test_idr(self):
+        prog, _ = radix_tree_program(2, xarray_type)
+        idr = Object(prog, pointer_type(8, idr_type), value=BASE)
+        self.assert_entries(
+            idr_for_each(idr), [(index + 100, value) for index, value in EXPECTED]
+        )
+        for index, value in EXPECTED:
+            self.assertEqual(idr_find(idr, index + 100).value_(), value)
+
+    def test_idr_for_each_type(self):
+        prog, _ = radix_tree_program(2, xarray_type)
+        idr = Object(prog, idr_type, address=BASE)
+        entries = list(idr_for_each(idr, "unsigned char *"))
+        self.assertEqual(
+            [(index, entry.value_()) for index, entry in entries],
+            [(index + 100, value) for index, value in EXPECTED],
+        )
+        for _, entry in entries:
+            self.assertEqual(entry.type_, pointer_type(8, unsigned_char_type))
+        self.assertRaises(TypeError, idr_for_each, idr, "unsigned char")
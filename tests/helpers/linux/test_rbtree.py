@@ -0,0 +1,146 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+import struct
+import unittest
+
+from drgn import Object, TypeMember, int_type, pointer_type, struct_type
+from drgn.helpers.linux.rbtree import (
+    rb_find,
+    rbtree_inorder_for_each,
+    rbtree_inorder_for_each_entry,
+)
+from tests import MockMemorySegment, mock_program
+
+
+rb_node_type = struct_type("rb_node", 24, ())
+rb_node_type = struct_type(
+    "rb_node",
+    24,
+    (
+        TypeMember(int_type("unsigned long", 8, False), "__rb_parent_color"),
+        TypeMember(pointer_type(8, rb_node_type), "rb_right", 64),
+        TypeMember(pointer_type(8, rb_node_type), "rb_left", 128),
+    ),
+)
+rb_root_type = struct_type(
+    "rb_root", 8, (TypeMember(pointer_type(8, rb_node_type), "rb_node"),)
+)
+entry_type = struct_type(
+    "entry",
+    32,
+    (
+        TypeMember(int_type("int", 4, True), "key"),
+        TypeMember(int_type("unsigned int", 4, False), "ukey", 32),
+        TypeMember(rb_node_type, "node", 64),
+    ),
+)
+
+BASE = 0xFFFF0000
+KEYS = list(range(-3, 4))
+# Root at BASE, entry i at BASE + 8 + 32 * i.
+ENTRIES = [BASE + 8 + 32 * i for i in range(len(KEYS))]
+
+
+def rbtree_program(keys=KEYS):
+    buf = bytearray(8 + 32 * len(keys))
+
+    def build(lo, hi, parent):
+        if lo >= hi:
+            return 0
+        mid = (lo + hi) // 2
+        node = ENTRIES[mid] + 8
+        struct.pack_into(
+            "<IIQQQ",
+            buf,
+            ENTRIES[mid] - BASE,
+            keys[mid] & 0xFFFFFFFF,
+            keys[mid] & 0xFFFFFFFF,
+            parent,
+            build(mid + 1, hi, node),
+            build(lo, mid, node),
+        )
+        return node
+
+    struct.pack_into("<Q", buf, 0, build(0, len(keys), 0))
+    return mock_program(
+        segments=[MockMemorySegment(bytes(buf), virt_addr=BASE)],
+        types=[rb_node_type, rb_root_type, entry_type],
+    )
+
+
+class TestRbtree(unittest.TestCase):
+    def setUp(self):
+        self.prog = rbtree_program()
+        self.root = Object(self.prog, pointer_type(8, rb_root_type), value=BASE)
+
+    def test_rbtree_inorder_for_each(self):
+        self.assertEqual(
+            [node.value_() for node in rbtree_inorder_for_each(self.root)],
+            [entry + 8 for entry in ENTRIES],
+        )
+        self.assertEqual(
+            [
+                node.value_()
+                for node in rbtree_inorder_for_each(
+                    Object(self.prog, rb_root_type, address=BASE)
+                )
+            ],
+            [entry + 8 for entry in ENTRIES],
+        )
+
+    def test_rbtree_inorder_for_each_entry(self):
+        entries = list(
+            rbtree_inorder_for_each_entry("struct entry", self.root, "node")
+        )
+        self.assertEqual([entry.value_() for entry in entries], ENTRIES)
+        self.assertEqual([entry.key.value_() for entry in entries], KEYS)
+        self.assertEqual(entries[0].type_, pointer_type(8, entry_type))
+
+    def test_rbtree_empty(self):
+        prog = mock_program(
+            segments=[MockMemorySegment(bytes(8), virt_addr=BASE)],
+            types=[rb_node_type, rb_root_type, entry_type],
+        )
+        root = Object(prog, rb_root_type, address=BASE)
+        self.assertEqual(list(rbtree_inorder_for_each(root)), [])
+        self.assertEqual(
+            list(rbtree_inorder_for_each_entry(entry_type, root, "node")), []
+        )
+        self.assertFalse(rb_find(entry_type, root, "node", 0, "key"))
+
+    def test_rb_find(self):
+        for i, key in enumerate(KEYS):
+            self.assertEqual(
+                rb_find(entry_type, self.root, "node", key, "key").value_(),
+                ENTRIES[i],
+            )
+            self.assertEqual(
+                rb_find(
+                    entry_type,
+                    self.root,
+                    "node",
+                    key,
+                    lambda key, entry: key - entry.key.value_(),
+                ).value_(),
+                ENTRIES[i],
+            )
+        for key in (-4, 4, 2 ** 63, -(2 ** 63)):
+            entry = rb_find(entry_type, self.root, "node", key, "key")
+            self.assertFalse(entry)
+            self.assertEqual(entry.type_, pointer_type(8, entry_type))
+
+    def test_rb_find_unsigned(self):
+        keys = [0, 1, 2, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF]
+        prog = rbtree_program(keys)
+        root = Object(prog, rb_root_type, address=BASE)
+        for i, key in enumerate(keys):
+            self.assertEqual(
+                rb_find(entry_type, root, "node", key, "ukey").value_(), ENTRIES[i]
+            )
+        self.assertFalse(rb_find(entry_type, root, "node", -1, "ukey"))
+        self.assertFalse(rb_find(entry_type, root, "node", 2 ** 32, "ukey"))
+
+    def test_rb_find_invalid(self):
+        self.assertRaises(TypeError, rb_find, entry_type, self.root, "node", 0, "node")
+        self.assertRaises(LookupError, rb_find, entry_type, self.root, "node", 0, "foo")
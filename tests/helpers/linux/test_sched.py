@@ -7,7 +7,11 @@ import signal
 import unittest
 
 from drgn.helpers.linux.pid import find_task
-from drgn.helpers.linux.sched import task_state_to_char
+from drgn.helpers.linux.sched import (
+    runqueue_snapshot,
+    task_snapshot,
+    task_state_to_char,
+)
 from tests.helpers.linux import (
     LinuxHelperTestCase,
     fork_and_pause,
@@ -41,6 +45,51 @@ class TestSched(LinuxHelperTestCase):
 
         os.waitpid(pid, 0)
 
+    def test_task_snapshot(self):
+        pid = os.getpid()
+        snapshot = {
+            entry[0]: entry[1:]
+            for entry in task_snapshot(
+                self.prog, ("pid", "task", "tgid", "comm", "state")
+            )
+        }
+        task = find_task(self.prog, pid)
+        self.assertEqual(
+            snapshot[pid],
+            (
+                task,
+                task.tgid.value_(),
+                task.comm.string_(),
+                task_state_to_char(task),
+            ),
+        )
+        self.assertIn(1, snapshot)
+        self.assertRaises(ValueError, task_snapshot, self.prog, ("foo",))
+
+    def test_runqueue_snapshot(self):
+        cpu = min(os.sched_getaffinity(0))
+        old_affinity = os.sched_getaffinity(0)
+        os.sched_setaffinity(0, (cpu,))
+        try:
+            cpus, tasks = runqueue_snapshot(self.prog)
+        finally:
+            os.sched_setaffinity(0, old_affinity)
+
+        self.assertEqual(len({len(column) for column in cpus.values()}), 1)
+        self.assertEqual(len({len(column) for column in tasks.values()}), 1)
+        self.assertIn(cpu, cpus["cpu"])
+
+        task = find_task(self.prog, os.getpid()).value_()
+        rows = [i for i, address in enumerate(tasks["task"]) if address == task]
+        self.assertEqual(len(rows), 1)
+        i = rows[0]
+        self.assertEqual(tasks["cpu"][i], cpu)
+        self.assertEqual(tasks["class"][i], "fair")
+        self.assertTrue(tasks["current"][i])
+        self.assertIsNotNone(tasks["vruntime"][i])
+        self.assertIsNone(tasks["deadline"][i])
+        self.assertEqual(cpus["curr"][cpus["cpu"].index(cpu)], task)
+
     @unittest.skip("GCC 10 breaks THREAD_SIZE object finder")
     def test_thread_size(self):
         # As far as I can tell, there's no way to query this value from
@@ -0,0 +1,220 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+import struct
+import unittest
+
+from drgn import (
+    Object,
+    TypeMember,
+    array_type,
+    int_type,
+    pointer_type,
+    struct_type,
+    void_type,
+)
+from drgn.helpers.linux.slab import (
+    find_containing_slab_cache,
+    slab_cache_for_each_allocated_object,
+)
+from tests import MockMemorySegment, MockObject, mock_program
+
+
+char_type = int_type("char", 1, True)
+unsigned_int_type = int_type("unsigned int", 4, False)
+unsigned_long_type = int_type("unsigned long", 8, False)
+void_pointer_type = pointer_type(8, void_type())
+
+PG_SLAB = 9
+page_type = struct_type(
+    "page",
+    64,
+    (
+        TypeMember(unsigned_long_type, "flags"),
+        TypeMember(void_pointer_type, "slab_cache", 64),
+        TypeMember(void_pointer_type, "freelist", 128),
+        TypeMember(unsigned_int_type, "objects", 208, 15),
+    ),
+)
+kmem_cache_cpu_type = struct_type(
+    "kmem_cache_cpu",
+    16,
+    (
+        TypeMember(pointer_type(8, void_pointer_type), "freelist"),
+        TypeMember(pointer_type(8, page_type), "page", 64),
+    ),
+)
+object_type = struct_type("object", 64, (TypeMember(unsigned_long_type, "value"),))
+cpumask_type = struct_type(
+    "cpumask", 8, (TypeMember(array_type(1, unsigned_long_type), "bits"),)
+)
+
+
+def kmem_cache_type(hardened):
+    members = [
+        TypeMember(pointer_type(8, kmem_cache_cpu_type), "cpu_slab"),
+        TypeMember(unsigned_int_type, "size", 64),
+        TypeMember(unsigned_int_type, "offset", 96),
+        TypeMember(pointer_type(8, char_type), "name", 192),
+    ]
+    if hardened:
+        members.append(TypeMember(unsigned_long_type, "random", 128))
+    return struct_type("kmem_cache", 32, members)
+
+
+VMEMMAP = 0xFFFFEA0000000000
+PAGE_OFFSET = 0xFFFF888000000000
+BASE = 0xFFFF0000
+KMEM_CACHE = BASE
+OTHER_KMEM_CACHE = BASE + 0x40
+PER_CPU_OFFSET = BASE + 0x100
+ONLINE_MASK = BASE + 0x180
+CACHE_NAME = BASE + 0x280
+CPU_SLAB = 0x40
+OBJECT_SIZE = 64
+FREEPTR_OFFSET = 8
+RANDOM = 0x0123456789ABCDEF
+
+
+def slab_object(pfn, i):
+    return PAGE_OFFSET + (pfn << 12) + i * OBJECT_SIZE
+
+
+def slab_program(hardened=False):
+    def encode(ptr, next):
+        if not hardened:
+            return next
+        ptr_addr = ptr + FREEPTR_OFFSET
+        swabbed = int.from_bytes(ptr_addr.to_bytes(8, "little"), "big")
+        return next ^ RANDOM ^ swabbed
+
+    # PFN 0 is not a slab, PFNs 1 and 2 are slabs of the cache, and PFN 3 is a
+    # slab of another cache. Slab 1 has objects 1 and 3 free. Slab 2 is CPU
+    # 0's slab, and object 0 is on CPU 0's freelist.
+    slabs = {1: (KMEM_CACHE, [1, 3]), 2: (KMEM_CACHE, []), 3: (OTHER_KMEM_CACHE, [])}
+    pages = bytearray(64 * 4)
+    slab_memory = bytearray(4 << 12)
+    for pfn, (cache, free) in slabs.items():
+        freelist = [slab_object(pfn, i) for i in free]
+        struct.pack_into(
+            "<QQQQ",
+            pages,
+            pfn * 64,
+            1 << PG_SLAB,
+            cache,
+            freelist[0] if freelist else 0,
+            4 << 16,
+        )
+        for i, ptr in enumerate(freelist):
+            next = freelist[i + 1] if i + 1 < len(freelist) else 0
+            struct.pack_into(
+                "<Q",
+                slab_memory,
+                ptr - PAGE_OFFSET + FREEPTR_OFFSET,
+                encode(ptr, next),
+            )
+    cpu_freelist = slab_object(2, 0)
+    struct.pack_into(
+        "<Q",
+        slab_memory,
+        cpu_freelist - PAGE_OFFSET + FREEPTR_OFFSET,
+        encode(cpu_freelist, 0),
+    )
+
+    buf = bytearray(0x300)
+    struct.pack_into(
+        "<QIIQ", buf, KMEM_CACHE - BASE, CPU_SLAB, OBJECT_SIZE, FREEPTR_OFFSET, RANDOM
+    )
+    for cpu in range(2):
+        struct.pack_into(
+            "<Q",
+            buf,
+            PER_CPU_OFFSET - BASE + 8 * cpu,
+            BASE + 0x200 + 16 * cpu - CPU_SLAB,
+        )
+    struct.pack_into("<Q", buf, KMEM_CACHE - BASE + 24, CACHE_NAME)
+    buf[CACHE_NAME - BASE : CACHE_NAME - BASE + 5] = b"test\0"
+    struct.pack_into("<Q", buf, ONLINE_MASK - BASE, 0b11)
+    struct.pack_into("<QQ", buf, 0x200, cpu_freelist, VMEMMAP + 2 * 64)
+
+    kmem_cache = kmem_cache_type(hardened)
+    prog = mock_program(
+        segments=[
+            MockMemorySegment(bytes(pages), virt_addr=VMEMMAP),
+            MockMemorySegment(bytes(slab_memory), virt_addr=PAGE_OFFSET),
+            MockMemorySegment(bytes(buf), virt_addr=BASE),
+        ],
+        types=[page_type, kmem_cache, kmem_cache_cpu_type, object_type, cpumask_type],
+        objects=[
+            MockObject("vmemmap", pointer_type(8, page_type), value=VMEMMAP),
+            MockObject("max_pfn", unsigned_long_type, value=4),
+            MockObject("PAGE_OFFSET", unsigned_long_type, value=PAGE_OFFSET),
+            MockObject("PG_slab", int_type("int", 4, True), value=PG_SLAB),
+            MockObject(
+                "__per_cpu_offset",
+                array_type(2, unsigned_long_type),
+                address=PER_CPU_OFFSET,
+            ),
+            MockObject("__cpu_online_mask", cpumask_type, address=ONLINE_MASK),
+        ],
+    )
+    return prog, Object(prog, pointer_type(8, kmem_cache), value=KMEM_CACHE)
+
+
+class TestSlab(unittest.TestCase):
+    def assert_objects(self, hardened):
+        prog, cache = slab_program(hardened)
+        objects = list(slab_cache_for_each_allocated_object(cache, "struct object"))
+        self.assertEqual(
+            [obj.value_() for obj in objects],
+            [
+                slab_object(1, 0),
+                slab_object(1, 2),
+                slab_object(2, 1),
+                slab_object(2, 2),
+                slab_object(2, 3),
+            ],
+        )
+        self.assertEqual(objects[0].type_, pointer_type(8, object_type))
+        self.assertEqual(
+            [
+                obj.value_()
+                for obj in slab_cache_for_each_allocated_object(
+                    cache, object_type, cpu_freelists=False
+                )
+            ],
+            [slab_object(1, 0), slab_object(1, 2)]
+            + [slab_object(2, i) for i in range(4)],
+        )
+
+    def test_slab_cache_for_each_allocated_object(self):
+        self.assert_objects(False)
+
+    def test_freelist_hardened(self):
+        self.assert_objects(True)
+
+    def test_not_slub(self):
+        prog, _ = slab_program()
+        slab_kmem_cache_type = struct_type(
+            "kmem_cache", 8, (TypeMember(unsigned_int_type, "size"),)
+        )
+        cache = Object(prog, pointer_type(8, slab_kmem_cache_type), value=KMEM_CACHE)
+        self.assertRaises(
+            ValueError, slab_cache_for_each_allocated_object, cache, object_type
+        )
+
+    def test_find_containing_slab_cache(self):
+        prog, cache = slab_program()
+        self.assertEqual(
+            find_containing_slab_cache(prog, slab_object(1, 2) + 8).value_(),
+            KMEM_CACHE,
+        )
+        self.assertEqual(
+            find_containing_slab_cache(
+                prog, Object(prog, "void *", value=slab_object(3, 0))
+            ).value_(),
+            OTHER_KMEM_CACHE,
+        )
+        # PFN 0 is not a slab, and BASE is not directly mapped.
+        self.assertFalse(find_containing_slab_cache(prog, PAGE_OFFSET))
+        self.assertFalse(find_containing_slab_cache(prog, BASE))
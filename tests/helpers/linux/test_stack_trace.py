@@ -38,3 +38,52 @@ class TestStackTrace(LinuxHelperTestCase):
         # pt_regs *.
         task = find_task(self.prog, os.getpid())
         self.prog.stack_trace(cast("struct pt_regs *", task.stack))
+
+    def test_stack_traces(self):
+        pid = fork_and_pause()
+        wait_until(lambda: proc_state(pid) == "S")
+        traces = self.prog.stack_traces([pid, find_task(self.prog, pid), 2 ** 31])
+        self.assertEqual(list(traces), [pid])
+        self.assertIn("schedule", str(traces[pid]))
+        all_traces = self.prog.stack_traces()
+        self.assertIn(pid, all_traces)
+        # The current task is running, so it is skipped.
+        self.assertNotIn(os.getpid(), all_traces)
+        os.kill(pid, signal.SIGKILL)
+        os.waitpid(pid, 0)
+
+    def test_stack_trace_groups(self):
+        pids = [fork_and_pause() for _ in range(2)]
+        for pid in pids:
+            wait_until(lambda: proc_state(pid) == "S")
+        groups = self.prog.stack_trace_groups(pids)
+        self.assertEqual(sorted(tid for _, tids in groups for tid in tids), pids)
+        for trace, tids in groups:
+            self.assertIn("schedule", str(trace))
+        for pid in pids:
+            os.kill(pid, signal.SIGKILL)
+            os.waitpid(pid, 0)
+
+    def test_frame_pointer_unwinding(self):
+        pid = fork_and_pause()
+        wait_until(lambda: proc_state(pid) == "S")
+        self.prog.frame_pointer_unwinding = True
+        try:
+            self.assertIn("schedule", str(self.prog.stack_trace(pid)))
+        finally:
+            self.prog.frame_pointer_unwinding = False
+        os.kill(pid, signal.SIGKILL)
+        os.waitpid(pid, 0)
+
+    def test_source(self):
+        pid = fork_and_pause()
+        wait_until(lambda: proc_state(pid) == "S")
+        trace = self.prog.stack_trace(pid)
+        filename, line, column = trace[0].source()
+        self.assertTrue(filename)
+        self.assertGreater(line, 0)
+        self.assertEqual(
+            self.prog.source_lines([trace[0].pc, 0]), [(filename, line, column), None]
+        )
+        os.kill(pid, signal.SIGKILL)
+        os.waitpid(pid, 0)
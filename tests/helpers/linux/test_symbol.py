@@ -0,0 +1,67 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+import array
+
+import drgn
+from tests.helpers.linux import LinuxHelperTestCase
+
+
+class TestSymbol(LinuxHelperTestCase):
+    def test_symbol_by_address(self):
+        for name in ("schedule", "do_exit", "init_task", "jiffies"):
+            sym = self.prog.symbol(name)
+            self.assertEqual(self.prog.symbol(sym.address).name, name)
+            if sym.size > 1:
+                self.assertEqual(
+                    self.prog.symbol(sym.address + sym.size - 1).address,
+                    sym.address,
+                )
+
+    def test_symbol_by_address_repeated(self):
+        # Alternate between two symbols to exercise the last-hit cache.
+        a = self.prog.symbol("schedule")
+        b = self.prog.symbol("do_exit")
+        for _ in range(3):
+            self.assertEqual(self.prog.symbol(a.address).name, "schedule")
+            self.assertEqual(self.prog.symbol(b.address).name, "do_exit")
+
+    def test_symbol_by_name(self):
+        sym = self.prog.symbol("schedule")
+        self.assertEqual(sym.name, "schedule")
+        self.assertEqual(sym.address, self.prog["schedule"].address_)
+        self.assertRaises(LookupError, self.prog.symbol, "drgn_no_such_symbol")
+
+    def test_symbol_no_debug_info(self):
+        # Without debugging information, symbols come from /proc/kallsyms.
+        prog = drgn.Program()
+        prog.set_kernel()
+        sym = prog.symbol("schedule")
+        self.assertEqual(sym.address, self.prog.symbol("schedule").address)
+        self.assertGreater(sym.size, 0)
+        self.assertEqual(prog.symbol(sym.address).name, "schedule")
+        self.assertEqual(prog.symbol(sym.address + sym.size - 1).name, "schedule")
+
+    def test_symbolize(self):
+        schedule = self.prog.symbol("schedule")
+        do_exit = self.prog.symbol("do_exit")
+        addresses = [do_exit.address, schedule.address, 0, schedule.address]
+        if schedule.size > 1:
+            addresses.append(schedule.address + schedule.size - 1)
+        for arg in (addresses, array.array("Q", addresses)):
+            syms = self.prog.symbolize(arg)
+            self.assertEqual(len(syms), len(addresses))
+            self.assertEqual(syms[0], do_exit)
+            self.assertEqual(syms[1], schedule)
+            self.assertIsNone(syms[2])
+            for sym in syms[3:]:
+                self.assertIs(sym, syms[1])
+        self.assertEqual(self.prog.symbolize([]), [])
+        self.assertRaises(TypeError, self.prog.symbolize, array.array("i", [0]))
+
+    def test_symbol_by_address_interned(self):
+        schedule = self.prog.symbol("schedule")
+        sym = self.prog.symbol(schedule.address)
+        self.assertEqual(sym, schedule)
+        self.assertIs(self.prog.symbol(schedule.address), sym)
+        self.assertIs(self.prog.symbolize([schedule.address])[0], sym)
@@ -7,7 +7,7 @@ import socket
 from drgn import cast
 from drgn.helpers.linux.fs import fget
 from drgn.helpers.linux.pid import find_task
-from drgn.helpers.linux.tcp import sk_tcpstate
+from drgn.helpers.linux.tcp import sk_tcpstate, tcp_for_each_sock, tcp_sock_table
 from tests.helpers.linux import LinuxHelperTestCase, create_socket
 
 
@@ -29,3 +29,27 @@ class TestTcp(LinuxHelperTestCase):
                 file = fget(task, sock2.fileno())
                 sk = cast("struct socket *", file.private_data).sk
                 self.assertEqual(sk_tcpstate(sk), self.prog["TCP_ESTABLISHED"])
+
+    def test_tcp_for_each_sock(self):
+        with create_socket() as sock:
+            sock.bind(("127.0.0.1", 0))
+            sock.listen()
+            port = sock.getsockname()[1]
+            task = find_task(self.prog, os.getpid())
+            file = fget(task, sock.fileno())
+            sk = cast("struct socket *", file.private_data).sk.read_()
+            with socket.create_connection(("127.0.0.1", port)) as client:
+                self.assertIn(sk, tcp_for_each_sock(self.prog))
+
+                table = tcp_sock_table(self.prog)
+                rows = list(zip(*table.values()))
+                columns = list(table)
+                listener = rows[table["sock"].index(sk.value_())]
+                self.assertEqual(listener[columns.index("sport")], port)
+                self.assertEqual(
+                    listener[columns.index("saddr")], bytes([127, 0, 0, 1])
+                )
+                self.assertEqual(
+                    listener[columns.index("state")], self.prog["TCP_LISTEN"]
+                )
+                self.assertIn(client.getsockname()[1], table["sport"])
@@ -0,0 +1,36 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+import os
+import signal
+import time
+
+from drgn.helpers.linux.pid import find_task
+from drgn.helpers.linux.timer import pending_timers
+from tests.helpers.linux import (
+    LinuxHelperTestCase,
+    fork_and_pause,
+    proc_state,
+    wait_until,
+)
+
+
+class TestTimer(LinuxHelperTestCase):
+    def test_pending_timers(self):
+        pid = fork_and_pause(lambda: time.sleep(1000))
+        try:
+            wait_until(lambda: proc_state(pid) == "S")
+            task = find_task(self.prog, pid)
+            table = pending_timers(self.prog)
+            self.assertEqual(len(set(map(len, table.values()))), 1)
+            self.assertLessEqual(set(table["type"]), {"timer_list", "hrtimer"})
+            # The child's nanosleep() is an hrtimer_sleeper owned by it.
+            i = table["owner"].index(task.value_())
+            self.assertEqual(table["type"][i], "hrtimer")
+            self.assertEqual(table["symbol"][i], "hrtimer_wakeup")
+            self.assertEqual(
+                table["function"][i], self.prog.symbol("hrtimer_wakeup").address
+            )
+        finally:
+            os.kill(pid, signal.SIGKILL)
+            os.waitpid(pid, 0)
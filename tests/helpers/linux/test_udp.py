@@ -0,0 +1,25 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+import os
+import socket
+
+from drgn import cast
+from drgn.helpers.linux.fs import fget
+from drgn.helpers.linux.pid import find_task
+from drgn.helpers.linux.udp import udp_for_each_sock, udp_sock_table
+from tests.helpers.linux import LinuxHelperTestCase, create_socket
+
+
+class TestUdp(LinuxHelperTestCase):
+    def test_udp_for_each_sock(self):
+        with create_socket(socket.AF_INET, socket.SOCK_DGRAM) as sock:
+            sock.bind(("127.0.0.1", 0))
+            file = fget(find_task(self.prog, os.getpid()), sock.fileno())
+            sk = cast("struct socket *", file.private_data).sk.read_()
+            self.assertIn(sk, udp_for_each_sock(self.prog))
+
+            table = udp_sock_table(self.prog)
+            i = table["sock"].index(sk.value_())
+            self.assertEqual(table["sport"][i], sock.getsockname()[1])
+            self.assertEqual(table["family"][i], socket.AF_INET)
@@ -184,6 +184,26 @@ class C_TOKEN(enum.IntEnum):
     RBRACKET = auto()
     ASTERISK = auto()
     DOT = auto()
+    ARROW = auto()
+    AMPERSAND = auto()
+    PLUS = auto()
+    MINUS = auto()
+    SLASH = auto()
+    PERCENT = auto()
+    TILDE = auto()
+    EXCLAMATION = auto()
+    LSHIFT = auto()
+    RSHIFT = auto()
+    LT = auto()
+    LE = auto()
+    GT = auto()
+    GE = auto()
+    EQ = auto()
+    NE = auto()
+    CARET = auto()
+    PIPE = auto()
+    AND_AND = auto()
+    OR_OR = auto()
     NUMBER = auto()
     IDENTIFIER = auto()
 
@@ -273,3 +293,27 @@ def deserialize_bits(buf, bit_offset, bit_size, little_endian):
     return _drgn_cdll.drgn_test_deserialize_bits(
         c_buf, bit_offset, bit_size, little_endian
     )
+
+
+_drgn_cdll.drgn_test_deserialize_bits_array.restype = None
+_drgn_cdll.drgn_test_deserialize_bits_array.argtypes = [
+    ctypes.POINTER(ctypes.c_uint64),
+    ctypes.c_void_p,
+    ctypes.c_size_t,
+    ctypes.c_uint64,
+    ctypes.c_uint64,
+    ctypes.c_uint8,
+    ctypes.c_bool,
+]
+
+
+def deserialize_bits_array(buf, n, bit_offset, bit_stride, bit_size, little_endian):
+    assert n == 0 or (
+        bit_offset + (n - 1) * bit_stride + bit_size + 7
+    ) // 8 <= len(buf)
+    c_buf = (ctypes.c_char * len(buf)).from_buffer_copy(buf)
+    ret = (ctypes.c_uint64 * n)()
+    _drgn_cdll.drgn_test_deserialize_bits_array(
+        ret, c_buf, n, bit_offset, bit_stride, bit_size, little_endian
+    )
+    return list(ret)
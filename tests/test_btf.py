@@ -0,0 +1,220 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+import struct
+import tempfile
+import unittest
+
+from drgn import (
+    Object,
+    Program,
+    Qualifiers,
+    TypeEnumerator,
+    TypeMember,
+    array_type,
+    enum_type,
+    int_type,
+    pointer_type,
+    struct_type,
+    typedef_type,
+)
+from tests import MOCK_PLATFORM, point_type
+
+
+BTF_KIND_INT = 1
+BTF_KIND_PTR = 2
+BTF_KIND_ARRAY = 3
+BTF_KIND_STRUCT = 4
+BTF_KIND_ENUM = 6
+BTF_KIND_FWD = 7
+BTF_KIND_TYPEDEF = 8
+BTF_KIND_CONST = 10
+BTF_KIND_FUNC = 12
+BTF_KIND_FUNC_PROTO = 13
+
+
+class BtfWriter:
+    def __init__(self):
+        self._types = []
+        self._strings = bytearray(b"\0")
+
+    def _str(self, s):
+        if not s:
+            return 0
+        off = len(self._strings)
+        self._strings.extend(s.encode() + b"\0")
+        return off
+
+    def add(self, kind, name, vlen, size_or_type, extra=b"", kind_flag=False):
+        info = (kind << 24) | vlen | (kind_flag << 31)
+        self._types.append(
+            struct.pack("<III", self._str(name), info, size_or_type) + extra
+        )
+        return len(self._types)
+
+    def int(self, name, size, signed):
+        return self.add(
+            BTF_KIND_INT, name, 0, size, struct.pack("<I", (signed << 24) | size * 8)
+        )
+
+    def struct(self, name, size, members, kind_flag=False):
+        extra = b"".join(
+            struct.pack("<III", self._str(member_name), type_id, offset)
+            for member_name, type_id, offset in members
+        )
+        return self.add(BTF_KIND_STRUCT, name, len(members), size, extra, kind_flag)
+
+    def enum(self, name, size, enumerators):
+        extra = b"".join(
+            struct.pack("<Ii", self._str(enumerator_name), value)
+            for enumerator_name, value in enumerators
+        )
+        return self.add(BTF_KIND_ENUM, name, len(enumerators), size, extra)
+
+    def func_proto(self, return_type, params):
+        extra = b"".join(
+            struct.pack("<II", self._str(param_name), type_id)
+            for param_name, type_id in params
+        )
+        return self.add(BTF_KIND_FUNC_PROTO, None, len(params), return_type, extra)
+
+    def build(self):
+        types = b"".join(self._types)
+        return (
+            struct.pack(
+                "<HBBIIIII",
+                0xEB9F,
+                1,
+                0,
+                24,
+                0,
+                len(types),
+                len(types),
+                len(self._strings),
+            )
+            + types
+            + self._strings
+        )
+
+
+def btf_program(data):
+    prog = Program(MOCK_PLATFORM)
+    with tempfile.NamedTemporaryFile() as f:
+        f.write(data)
+        f.flush()
+        prog.load_btf(f.name)
+    return prog
+
+
+class TestBtf(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        btf = BtfWriter()
+        int_id = btf.int("int", 4, True)
+        btf.struct("point", 8, [("x", int_id, 0), ("y", int_id, 32)])
+        node_ptr_id = btf.add(BTF_KIND_PTR, None, 0, int_id + 3)
+        const_int_id = btf.add(BTF_KIND_CONST, None, 0, int_id)
+        btf.struct("node", 16, [("next", node_ptr_id, 0), ("value", const_int_id, 64)])
+        btf.add(BTF_KIND_TYPEDEF, "point_t", 0, int_id + 1)
+        btf.enum("color", 4, [("RED", 0), ("GREEN", 1), ("BLUE", 2)])
+        btf.add(BTF_KIND_FWD, "opaque", 0, 0)
+        btf.struct(
+            "small",
+            1,
+            [("x", int_id, (4 << 24) | 0), ("y", int_id, (4 << 24) | 4)],
+            kind_flag=True,
+        )
+        array_id = btf.add(
+            BTF_KIND_ARRAY, None, 0, 0, struct.pack("<III", int_id, int_id, 0)
+        )
+        btf.struct("flex", 4, [("len", int_id, 0), ("data", array_id, 32)])
+        proto_id = btf.func_proto(int_id, [("a", int_id), ("b", int_id)])
+        btf.add(BTF_KIND_FUNC, "add", 1, proto_id)
+        cls.data = btf.build()
+
+    def setUp(self):
+        self.prog = btf_program(self.data)
+
+    def test_struct(self):
+        self.assertEqual(self.prog.type("struct point"), point_type)
+
+    def test_self_referential_struct(self):
+        node = self.prog.type("struct node")
+        self.assertEqual(node.members[0].type.type, node)
+        self.assertEqual(
+            node.members[1].type, int_type("int", 4, True, Qualifiers.CONST)
+        )
+
+    def test_typedef(self):
+        self.assertEqual(
+            self.prog.type("point_t"), typedef_type("point_t", point_type)
+        )
+
+    def test_enum(self):
+        color_type = enum_type(
+            "color",
+            int_type("unsigned int", 4, False),
+            (
+                TypeEnumerator("RED", 0),
+                TypeEnumerator("GREEN", 1),
+                TypeEnumerator("BLUE", 2),
+            ),
+        )
+        self.assertEqual(self.prog.type("enum color"), color_type)
+        self.assertEqual(
+            self.prog.constant("GREEN"), Object(self.prog, color_type, value=1)
+        )
+
+    def test_forward_declaration(self):
+        self.assertFalse(self.prog.type("struct opaque").is_complete())
+
+    def test_bit_fields(self):
+        self.assertEqual(
+            self.prog.type("struct small"),
+            struct_type(
+                "small",
+                1,
+                (
+                    TypeMember(int_type("int", 4, True), "x", 0, 4),
+                    TypeMember(int_type("int", 4, True), "y", 4, 4),
+                ),
+            ),
+        )
+
+    def test_flexible_array(self):
+        self.assertEqual(
+            self.prog.type("struct flex").members[1].type,
+            array_type(None, int_type("int", 4, True)),
+        )
+
+    def test_function_without_kallsyms(self):
+        self.assertRaisesRegex(
+            LookupError, "could not find address of 'add'", self.prog.function, "add"
+        )
+
+    def test_not_found(self):
+        self.assertRaises(LookupError, self.prog.type, "struct nonexistent")
+        self.assertRaises(LookupError, self.prog.type, "union point")
+        self.assertRaises(LookupError, self.prog.type, "struct point", "point.c")
+
+    def test_pointer_size(self):
+        self.assertEqual(
+            self.prog.type("struct node").members[0].type,
+            pointer_type(8, self.prog.type("struct node")),
+        )
+
+    def test_invalid(self):
+        self.assertRaisesRegex(
+            Exception, "invalid BTF magic", btf_program, b"\0" * len(self.data)
+        )
+        self.assertRaisesRegex(
+            Exception, "BTF header is truncated", btf_program, self.data[:8]
+        )
+
+    def test_load_twice(self):
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(self.data)
+            f.flush()
+            self.assertRaisesRegex(
+                ValueError, "already loaded", self.prog.load_btf, f.name
+            )
@@ -1,14 +1,18 @@
 # Copyright (c) Facebook, Inc. and its affiliates.
 # SPDX-License-Identifier: GPL-3.0+
 
+import os
 import os.path
 import re
 import tempfile
 import unittest
+import unittest.mock
 
 from drgn import (
+    FindNameFlags,
     FindObjectFlags,
     Language,
+    MissingDebugInfoError,
     Object,
     Program,
     ProgramFlags,
@@ -39,7 +43,13 @@ from tests import (
     point_type,
 )
 from tests.dwarf import DW_AT, DW_ATE, DW_FORM, DW_LANG, DW_TAG
-from tests.dwarfwriter import compile_dwarf, DwarfDie, DwarfAttrib
+from tests.dwarfcorpus import generate_dwarf_corpus
+from tests.dwarfwriter import (
+    compile_dwarf,
+    compile_split_dwarf,
+    DwarfDie,
+    DwarfAttrib,
+)
 
 
 bool_die = DwarfDie(
@@ -2096,3 +2106,508 @@ class TestProgram(unittest.TestCase):
         )
         self.assertFalse(dwarf_program(dies)["x"].prog_.flags & ProgramFlags.IS_LIVE)
         self.assertEqual(dwarf_program(dies)["x"].type_.name, "int")
+
+    def test_names(self):
+        prog = dwarf_program(
+            (
+                int_die,
+                DwarfDie(
+                    DW_TAG.structure_type,
+                    (
+                        DwarfAttrib(DW_AT.name, DW_FORM.string, "point"),
+                        DwarfAttrib(DW_AT.byte_size, DW_FORM.data1, 0),
+                    ),
+                ),
+                DwarfDie(
+                    DW_TAG.variable,
+                    (
+                        DwarfAttrib(DW_AT.name, DW_FORM.string, "point_count"),
+                        DwarfAttrib(DW_AT.type, DW_FORM.ref4, 0),
+                    ),
+                ),
+                DwarfDie(
+                    DW_TAG.variable,
+                    (
+                        DwarfAttrib(DW_AT.name, DW_FORM.string, "points_max"),
+                        DwarfAttrib(DW_AT.type, DW_FORM.ref4, 0),
+                    ),
+                ),
+                DwarfDie(
+                    DW_TAG.subprogram,
+                    (DwarfAttrib(DW_AT.name, DW_FORM.string, "print_point"),),
+                ),
+            )
+        )
+        self.assertEqual(
+            prog.names(),
+            ["int", "point", "point_count", "points_max", "print_point"],
+        )
+        self.assertEqual(prog.names("point"), ["point", "point_count", "points_max"])
+        self.assertEqual(prog.names("points_max_"), [])
+        self.assertEqual(
+            prog.names("p", flags=FindNameFlags.OBJECT),
+            ["point_count", "points_max", "print_point"],
+        )
+        self.assertEqual(
+            prog.names(flags=FindNameFlags.TYPE | FindNameFlags.TAG),
+            ["int", "point"],
+        )
+        self.assertEqual(
+            prog.names(glob="*_*"), ["point_count", "points_max", "print_point"]
+        )
+        self.assertEqual(prog.names(glob="point?*"), ["point_count", "points_max"])
+        self.assertEqual(prog.names("pr", glob="point*"), [])
+        self.assertRaises(ValueError, prog.names, flags=FindNameFlags(0))
+
+
+class TestIndexCache(unittest.TestCase):
+    def setUp(self):
+        self.cache_dir = tempfile.TemporaryDirectory()
+        self.addCleanup(self.cache_dir.cleanup)
+        patcher = unittest.mock.patch.dict(
+            os.environ, {"DRGN_DWARF_INDEX_CACHE_DIR": self.cache_dir.name}
+        )
+        patcher.start()
+        self.addCleanup(patcher.stop)
+        self.build_id = bytes.fromhex("0123456789abcdef")
+        self.cache_path = os.path.join(self.cache_dir.name, "0123456789abcdef.idx")
+
+    def test_cache(self):
+        for i in range(2):
+            prog = dwarf_program(base_type_dies, build_id=self.build_id)
+            self.assertEqual(prog.type("int"), int_type("int", 4, True))
+            self.assertEqual(prog.type("_Bool").name, "_Bool")
+            self.assertEqual(os.listdir(self.cache_dir.name), ["0123456789abcdef.idx"])
+
+    def test_invalid_cache(self):
+        with open(self.cache_path, "wb") as f:
+            f.write(b"DRGNIDX\0garbage")
+        prog = dwarf_program(base_type_dies, build_id=self.build_id)
+        self.assertEqual(prog.type("int"), int_type("int", 4, True))
+        self.assertGreater(os.path.getsize(self.cache_path), 16)
+
+    def test_no_build_id(self):
+        prog = dwarf_program(base_type_dies)
+        self.assertEqual(prog.type("int"), int_type("int", 4, True))
+        self.assertEqual(os.listdir(self.cache_dir.name), [])
+
+    def test_disabled(self):
+        with unittest.mock.patch.dict(os.environ, {"DRGN_DWARF_INDEX_CACHE_DIR": ""}):
+            prog = dwarf_program(base_type_dies, build_id=self.build_id)
+        self.assertEqual(prog.type("int"), int_type("int", 4, True))
+        self.assertEqual(os.listdir(self.cache_dir.name), [])
+
+
+class TestDebugNames(unittest.TestCase):
+    @staticmethod
+    def enum_die(name, *enumerators):
+        attribs = [
+            DwarfAttrib(DW_AT.type, DW_FORM.ref4, 0),
+            DwarfAttrib(DW_AT.byte_size, DW_FORM.data1, 4),
+        ]
+        if name is not None:
+            attribs.insert(0, DwarfAttrib(DW_AT.name, DW_FORM.string, name))
+        return DwarfDie(
+            DW_TAG.enumeration_type,
+            attribs,
+            [
+                DwarfDie(
+                    DW_TAG.enumerator,
+                    [
+                        DwarfAttrib(DW_AT.name, DW_FORM.string, enumerator),
+                        DwarfAttrib(DW_AT.const_value, DW_FORM.data1, i),
+                    ],
+                )
+                for i, enumerator in enumerate(enumerators)
+            ],
+        )
+
+    x_die = DwarfDie(
+        DW_TAG.variable,
+        [
+            DwarfAttrib(DW_AT.name, DW_FORM.string, "x"),
+            DwarfAttrib(DW_AT.type, DW_FORM.ref4, 0),
+            DwarfAttrib(
+                DW_AT.location,
+                DW_FORM.exprloc,
+                b"\x03\x04\x03\x02\x01\xff\xff\xff\xff",
+            ),
+        ],
+    )
+
+    def assert_indexed(self, prog):
+        self.assertEqual(prog.type("int"), int_type("int", 4, True))
+        self.assertEqual(
+            prog.type("enum color"),
+            enum_type(
+                "color",
+                int_type("int", 4, True),
+                (
+                    TypeEnumerator("RED", 0),
+                    TypeEnumerator("GREEN", 1),
+                    TypeEnumerator("BLUE", 2),
+                ),
+            ),
+        )
+        self.assertEqual(prog["GREEN"].value_(), 1)
+        self.assertEqual(prog["x"].address_, 0xFFFFFFFF01020304)
+
+    def test_debug_names(self):
+        dies = [
+            int_die,
+            self.enum_die("color", "RED", "GREEN", "BLUE"),
+            DwarfDie(
+                DW_TAG.structure_type,
+                [
+                    DwarfAttrib(DW_AT.name, DW_FORM.string, "point"),
+                    DwarfAttrib(DW_AT.declaration, DW_FORM.flag_present, True),
+                ],
+            ),
+            self.x_die,
+        ]
+        for debug_names in (False, True):
+            with self.subTest(debug_names=debug_names):
+                prog = dwarf_program(dies, debug_names=debug_names)
+                self.assert_indexed(prog)
+
+    def test_anonymous_enum(self):
+        # The enumerators of an anonymous enum type don't have a parent in the
+        # name index, so the unit must be scanned instead.
+        dies = [
+            int_die,
+            self.enum_die("color", "RED", "GREEN", "BLUE"),
+            self.enum_die(None, "ZERO", "ONE"),
+            self.x_die,
+        ]
+        for debug_names in (False, True):
+            with self.subTest(debug_names=debug_names):
+                prog = dwarf_program(dies, debug_names=debug_names)
+                self.assert_indexed(prog)
+                self.assertEqual(prog["ONE"].value_(), 1)
+
+
+class TestBackgroundLoading(unittest.TestCase):
+    def test_wait(self):
+        prog = Program()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(compile_dwarf(base_type_dies))
+            f.flush()
+            prog.load_debug_info([f.name], background=True)
+            prog.wait_for_debug_info()
+        self.assertEqual(prog.type("int"), int_type("int", 4, True))
+        # There is nothing left to wait for.
+        prog.wait_for_debug_info()
+
+    def test_lookup_waits(self):
+        prog = Program()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(compile_dwarf(base_type_dies))
+            f.flush()
+            prog.load_debug_info([f.name], background=True)
+            self.assertEqual(prog.type("int"), int_type("int", 4, True))
+        prog.wait_for_debug_info()
+
+    def test_missing_debug_info(self):
+        prog = Program()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(b"not an ELF file")
+            f.flush()
+            prog.load_debug_info([f.name], background=True)
+            self.assertRaises(MissingDebugInfoError, prog.wait_for_debug_info)
+
+
+class TestDebugInfoStats(unittest.TestCase):
+    def test_stats(self):
+        prog = Program()
+        self.assertEqual(prog.debug_info_stats()["modules"], 0)
+        progress = []
+        prog.set_debug_info_progress(
+            lambda stats, done, total: progress.append((stats, done, total))
+        )
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(compile_dwarf(base_type_dies))
+            f.flush()
+            prog.load_debug_info([f.name])
+            stats = prog.debug_info_stats()
+            self.assertEqual(stats["modules"], 1)
+            self.assertEqual(stats["cus"], 1)
+            self.assertGreater(stats["dies"], 0)
+            self.assertGreater(stats["debug_info_bytes"], 0)
+            module_stats = stats["module_stats"]
+            self.assertEqual(len(module_stats), 1)
+            self.assertEqual(module_stats[0]["name"], f.name)
+            self.assertEqual(module_stats[0]["dies"], stats["dies"])
+            self.assertFalse(module_stats[0]["cached"])
+            self.assertEqual(progress, [(module_stats[0], 1, 1)])
+
+    def test_progress_background(self):
+        prog = Program()
+        prog.set_debug_info_progress(lambda stats, done, total: None)
+        self.assertRaises(ValueError, prog.load_debug_info, [], background=True)
+        prog.set_debug_info_progress(None)
+        prog.load_debug_info([], background=True)
+        prog.wait_for_debug_info()
+
+
+class TestSharedDebugInfo(unittest.TestCase):
+    def test_share(self):
+        prog1 = Program()
+        prog2 = Program()
+        prog2.share_debug_info(prog1)
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(
+                compile_dwarf(base_type_dies, build_id=b"\x01\x23\x45", compress=True)
+            )
+            f.flush()
+            prog1.load_debug_info([f.name])
+            prog2.load_debug_info([f.name])
+        # The shared file must outlive the program that opened it.
+        del prog1
+        self.assertEqual(prog2.type("int"), int_type("int", 4, True))
+
+    def test_share_self(self):
+        prog = Program()
+        prog.share_debug_info(prog)
+        self.assertRaises(TypeError, prog.share_debug_info, None)
+
+
+class TestCompressedSections(unittest.TestCase):
+    def test_zdebug(self):
+        prog = Program()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(compile_dwarf(base_type_dies, compress=True))
+            f.flush()
+            prog.load_debug_info([f.name])
+        self.assertEqual(prog.type("int"), int_type("int", 4, True))
+
+
+class TestDwarfCorpus(unittest.TestCase):
+    def load(self, **kwds):
+        data, _ = generate_dwarf_corpus(
+            4, types=8, members=3, functions=2, variables=2, enumerators=2, **kwds
+        )
+        prog = Program()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(data)
+            f.flush()
+            prog.load_debug_info([f.name])
+        self.assertEqual(prog.type("struct corpus_struct_1").size, 40)
+        self.assertEqual(
+            prog.type("struct corpus_struct_1").members[0].type.tag,
+            "corpus_struct_0",
+        )
+        self.assertEqual(prog.type("corpus_struct_4_t").type.tag, "corpus_struct_4")
+        self.assertEqual(prog["CU2_STATE_1"].value_(), 1)
+        self.assertEqual(
+            prog["cu3_var0"].type_, prog.type("struct corpus_struct_0 *")
+        )
+        return prog
+
+    def test_corpus(self):
+        prog = self.load()
+        self.assertEqual(prog["cu3_func1"].address_, 0xFFFF0000 + 7 * 64)
+
+    def test_string_names(self):
+        self.load(strp=False)
+
+    def test_compressed(self):
+        self.load(compress=True)
+
+    def test_relocatable(self):
+        self.load(relocatable=True)
+
+
+class TestSplitDwarf(unittest.TestCase):
+    def test_lazy(self):
+        prog = Program()
+        with tempfile.TemporaryDirectory() as dir:
+            dwo_path = os.path.join(dir, "test.dwo")
+            skeleton, dwo = compile_split_dwarf(base_type_dies, dwo_path)
+            with open(dwo_path, "wb") as f:
+                f.write(dwo)
+            with tempfile.NamedTemporaryFile(dir=dir) as f:
+                f.write(skeleton)
+                f.flush()
+                prog.load_debug_info([f.name])
+                # Only the skeleton unit is indexed until a lookup misses.
+                self.assertEqual(prog.debug_info_stats()["modules"], 1)
+                self.assertEqual(prog.type("int"), int_type("int", 4, True))
+                module_stats = prog.debug_info_stats()["module_stats"]
+                self.assertEqual(len(module_stats), 2)
+                self.assertEqual(module_stats[1]["name"], dwo_path)
+
+    def test_missing_dwo(self):
+        prog = Program()
+        with tempfile.TemporaryDirectory() as dir:
+            skeleton, dwo = compile_split_dwarf(
+                base_type_dies, os.path.join(dir, "missing.dwo")
+            )
+            with tempfile.NamedTemporaryFile(dir=dir) as f:
+                f.write(skeleton)
+                f.flush()
+                prog.load_debug_info([f.name])
+                self.assertRaises(LookupError, prog.type, "int")
+
+
+class TestFindCache(unittest.TestCase):
+    def test_not_found_invalidated(self):
+        prog = Program()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(compile_dwarf(base_type_dies))
+            f.flush()
+            prog.load_debug_info([f.name])
+        for i in range(2):
+            self.assertRaises(LookupError, prog.type, "struct foo")
+            self.assertEqual(prog.type("int"), int_type("int", 4, True))
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(
+                compile_dwarf(
+                    DwarfDie(
+                        DW_TAG.structure_type,
+                        [
+                            DwarfAttrib(DW_AT.name, DW_FORM.string, "foo"),
+                            DwarfAttrib(DW_AT.byte_size, DW_FORM.data1, 0),
+                        ],
+                    )
+                )
+            )
+            f.flush()
+            prog.load_debug_info([f.name])
+        self.assertEqual(prog.type("struct foo"), struct_type("foo", 0, ()))
+
+    def test_variable(self):
+        prog = Program()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(
+                compile_dwarf(
+                    (
+                        int_die,
+                        DwarfDie(
+                            DW_TAG.variable,
+                            (
+                                DwarfAttrib(DW_AT.name, DW_FORM.string, "x"),
+                                DwarfAttrib(DW_AT.type, DW_FORM.ref4, 0),
+                                DwarfAttrib(
+                                    DW_AT.location,
+                                    DW_FORM.exprloc,
+                                    b"\x03\x04\x03\x02\x01\xff\xff\xff\xff",
+                                ),
+                            ),
+                        ),
+                        DwarfDie(
+                            DW_TAG.variable,
+                            (
+                                DwarfAttrib(DW_AT.name, DW_FORM.string, "y"),
+                                DwarfAttrib(DW_AT.type, DW_FORM.ref4, 0),
+                            ),
+                        ),
+                    )
+                )
+            )
+            f.flush()
+            prog.load_debug_info([f.name])
+        for i in range(2):
+            self.assertEqual(prog["x"], Object(prog, "int", address=0xFFFFFFFF01020304))
+            self.assertRaisesRegex(
+                LookupError, "could not find address", prog.variable, "y"
+            )
+            self.assertRaises(LookupError, prog.variable, "z")
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(
+                compile_dwarf(
+                    (
+                        int_die,
+                        DwarfDie(
+                            DW_TAG.variable,
+                            (
+                                DwarfAttrib(DW_AT.name, DW_FORM.string, "z"),
+                                DwarfAttrib(DW_AT.type, DW_FORM.ref4, 0),
+                                DwarfAttrib(
+                                    DW_AT.location,
+                                    DW_FORM.exprloc,
+                                    b"\x03\x00\x10\x00\x00\x00\x00\x00\x00",
+                                ),
+                            ),
+                        ),
+                    )
+                )
+            )
+            f.flush()
+            prog.load_debug_info([f.name])
+        self.assertEqual(prog["z"], Object(prog, "int", address=0x1000))
+        self.assertEqual(prog["x"], Object(prog, "int", address=0xFFFFFFFF01020304))
+
+
+class TestTypeDeduplication(unittest.TestCase):
+    @staticmethod
+    def struct_dies(var_name, member_type_die):
+        return [
+            DwarfDie(
+                DW_TAG.structure_type,
+                [
+                    DwarfAttrib(DW_AT.name, DW_FORM.string, "point"),
+                    DwarfAttrib(DW_AT.byte_size, DW_FORM.data1, 8),
+                ],
+                [
+                    DwarfDie(
+                        DW_TAG.member,
+                        [
+                            DwarfAttrib(DW_AT.name, DW_FORM.string, "x"),
+                            DwarfAttrib(DW_AT.data_member_location, DW_FORM.data1, 0),
+                            DwarfAttrib(DW_AT.type, DW_FORM.ref4, 1),
+                        ],
+                    ),
+                    DwarfDie(
+                        DW_TAG.member,
+                        [
+                            DwarfAttrib(DW_AT.name, DW_FORM.string, "y"),
+                            DwarfAttrib(DW_AT.data_member_location, DW_FORM.data1, 4),
+                            DwarfAttrib(DW_AT.type, DW_FORM.ref4, 1),
+                        ],
+                    ),
+                ],
+            ),
+            member_type_die,
+            DwarfDie(
+                DW_TAG.variable,
+                [
+                    DwarfAttrib(DW_AT.name, DW_FORM.string, var_name),
+                    DwarfAttrib(DW_AT.type, DW_FORM.ref4, 0),
+                    DwarfAttrib(
+                        DW_AT.location,
+                        DW_FORM.exprloc,
+                        b"\x03\x04\x03\x02\x01\xff\xff\xff\xff",
+                    ),
+                ],
+            ),
+        ]
+
+    def load(self, *dies):
+        prog = Program()
+        files = []
+        try:
+            for die_list in dies:
+                f = tempfile.NamedTemporaryFile()
+                files.append(f)
+                f.write(compile_dwarf(die_list))
+                f.flush()
+            prog.load_debug_info([f.name for f in files])
+        finally:
+            for f in files:
+                f.close()
+        return prog
+
+    def test_identical(self):
+        prog = self.load(
+            self.struct_dies("a", int_die), self.struct_dies("b", int_die)
+        )
+        self.assertEqual(prog["a"].type_, point_type)
+        self.assertEqual(prog["a"].type_._ptr, prog["b"].type_._ptr)
+
+    def test_different_member_type(self):
+        prog = self.load(
+            self.struct_dies("a", int_die), self.struct_dies("b", unsigned_int_die)
+        )
+        self.assertEqual(prog["a"].type_, point_type)
+        self.assertNotEqual(prog["a"].type_._ptr, prog["b"].type_._ptr)
+        self.assertEqual(prog["b"].x.type_, int_type("unsigned int", 4, False))
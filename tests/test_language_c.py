@@ -583,6 +583,42 @@ class TestLexer(unittest.TestCase):
         ]
         self.assertEqual([token.kind for token in self.lex(s)], tokens)
 
+    def test_operators(self):
+        s = "-> & + - / % ~ ! << >> < <= > >= == != ^ | && ||"
+        tokens = [
+            C_TOKEN.ARROW,
+            C_TOKEN.AMPERSAND,
+            C_TOKEN.PLUS,
+            C_TOKEN.MINUS,
+            C_TOKEN.SLASH,
+            C_TOKEN.PERCENT,
+            C_TOKEN.TILDE,
+            C_TOKEN.EXCLAMATION,
+            C_TOKEN.LSHIFT,
+            C_TOKEN.RSHIFT,
+            C_TOKEN.LT,
+            C_TOKEN.LE,
+            C_TOKEN.GT,
+            C_TOKEN.GE,
+            C_TOKEN.EQ,
+            C_TOKEN.NE,
+            C_TOKEN.CARET,
+            C_TOKEN.PIPE,
+            C_TOKEN.AND_AND,
+            C_TOKEN.OR_OR,
+        ]
+        self.assertEqual([token.kind for token in self.lex(s)], tokens)
+        self.assertEqual(
+            [token.kind for token in self.lex("a->b-1")],
+            [
+                C_TOKEN.IDENTIFIER,
+                C_TOKEN.ARROW,
+                C_TOKEN.IDENTIFIER,
+                C_TOKEN.MINUS,
+                C_TOKEN.NUMBER,
+            ],
+        )
+
     def test_keywords(self):
         s = """void char short int long signed unsigned _Bool float double
         _Complex const restrict volatile _Atomic struct union enum"""
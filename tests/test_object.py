@@ -1,9 +1,14 @@
 # Copyright (c) Facebook, Inc. and its affiliates.
 # SPDX-License-Identifier: GPL-3.0+
 
+import collections.abc
+import io
+import json
 import math
 import operator
+import pickle
 import struct
+import tempfile
 
 from drgn import (
     FaultError,
@@ -18,6 +23,7 @@ from drgn import (
     container_of,
     enum_type,
     float_type,
+    format_objects,
     function_type,
     int_type,
     pointer_type,
@@ -89,6 +95,25 @@ class TestInit(ObjectTestCase):
             address=0,
         )
 
+    def test_arguments(self):
+        self.assertEqual(
+            Object(prog=self.prog, type="int", value=1),
+            Object(self.prog, "int", 1),
+        )
+        self.assertRaisesRegex(TypeError, "must be Program", Object, None, "int", 1)
+        self.assertRaisesRegex(
+            TypeError, "missing required argument 'prog'", Object, type="int"
+        )
+        self.assertRaisesRegex(
+            TypeError, "at most 3 positional", Object, self.prog, "int", 0, 0
+        )
+        self.assertRaisesRegex(
+            TypeError, "invalid keyword", Object, self.prog, "int", val=0
+        )
+        self.assertRaisesRegex(
+            TypeError, "given by name", Object, self.prog, "int", type="int"
+        )
+
     def test_integer_address(self):
         self.assertRaises(TypeError, Object, self.prog, "int", address="NULL")
 
@@ -302,6 +327,132 @@ class TestReference(ObjectTestCase):
         obj = Object(prog, "int [2][2][2]", address=0xFFFF0000)
         self.assertEqual(obj.value_(), [[[0, 1], [2, 3]], [[4, 5], [6, 7]]])
 
+    def test_member_value(self):
+        segment = (
+            (99).to_bytes(4, "little")
+            + (-1).to_bytes(4, "little", signed=True)
+            + (12345).to_bytes(4, "little")
+            + (0).to_bytes(4, "little")
+        )
+        prog = mock_program(
+            segments=[MockMemorySegment(segment, virt_addr=0xFFFF0000),],
+            types=[point_type, line_segment_type],
+        )
+
+        obj = Object(prog, "struct line_segment", address=0xFFFF0000)
+        self.assertEqual(obj.member_value_("a"), {"x": 99, "y": -1})
+        self.assertEqual(obj.a.member_value_("y"), -1)
+        ptr = Object(prog, "struct point *", value=0xFFFF0008)
+        self.assertEqual(ptr.member_value_("x"), 12345)
+        self.assertRaises(LookupError, obj.member_value_, "c")
+
+        self.assertEqual(
+            obj.read_members_("b", "a"), ({"x": 12345, "y": 0}, {"x": 99, "y": -1})
+        )
+        self.assertEqual(ptr.read_members_("y", "x"), (0, 12345))
+        self.assertEqual(obj.read_().read_members_("a"), ({"x": 99, "y": -1},))
+        self.assertEqual(obj.read_members_(), ())
+        self.assertRaises(LookupError, obj.read_members_, "a", "c")
+
+    def test_getattr_cached(self):
+        segment = b"".join(i.to_bytes(4, "little") for i in range(4))
+        prog = mock_program(
+            segments=[MockMemorySegment(segment, virt_addr=0xFFFF0000),],
+            types=[point_type, line_segment_type],
+        )
+        obj = Object(prog, "struct line_segment", address=0xFFFF0000)
+        ptr = Object(prog, "struct point *", value=0xFFFF0008)
+        # Repeat so that the second iteration hits the per-type member
+        # cache.
+        for _ in range(2):
+            self.assertEqual(obj.a.y, Object(prog, "int", address=0xFFFF0004))
+            self.assertEqual(obj.b.x.value_(), 2)
+            self.assertEqual(ptr.y.value_(), 3)
+            self.assertEqual(getattr(obj, "".join(["b"])).y.value_(), 3)
+            self.assertRaises(AttributeError, getattr, obj, "c")
+        self.assertRaises(TypeError, obj.read_members_, 1)
+        self.assertRaises(
+            FaultError,
+            Object(prog, "struct point", address=0xFFFF0010).read_members_,
+            "x",
+        )
+
+    def test_lazy_value(self):
+        segment = bytearray()
+        for i in range(10):
+            segment.extend(i.to_bytes(4, "little"))
+        prog = mock_program(
+            segments=[MockMemorySegment(segment, virt_addr=0xFFFF0000),],
+            types=[point_type, line_segment_type],
+        )
+
+        # Only the elements which are accessed are read.
+        value = Object(prog, "int [100]", address=0xFFFF0000).value_(lazy=True)
+        self.assertIsInstance(value, collections.abc.Sequence)
+        self.assertEqual(len(value), 100)
+        self.assertEqual(value[3], 3)
+        self.assertEqual(value[-91], 9)
+        self.assertRaises(FaultError, value.__getitem__, 10)
+        self.assertRaises(IndexError, value.__getitem__, 100)
+
+        value = Object(prog, "int [2][5]", address=0xFFFF0000).value_(lazy=True)
+        self.assertEqual(
+            [list(row) for row in value], [[0, 1, 2, 3, 4], [5, 6, 7, 8, 9]]
+        )
+
+        value = Object(prog, "struct line_segment", address=0xFFFF0000).value_(
+            lazy=True
+        )
+        self.assertIsInstance(value, collections.abc.Mapping)
+        self.assertEqual(len(value), 2)
+        self.assertEqual(list(value), ["a", "b"])
+        self.assertIn("b", value)
+        self.assertNotIn("c", value)
+        self.assertEqual(value["b"]["y"], 3)
+        self.assertRaises(KeyError, value.__getitem__, "c")
+        self.assertIsNone(value.get("c"))
+        self.assertEqual(
+            {key: dict(member) for key, member in value.items()},
+            {"a": {"x": 0, "y": 1}, "b": {"x": 2, "y": 3}},
+        )
+
+        self.assertEqual(Object(prog, "int", value=5).value_(lazy=True), 5)
+
+    def test_buffer(self):
+        segment = bytearray()
+        for i in range(10):
+            segment.extend(i.to_bytes(4, "little"))
+        prog = mock_program(
+            segments=[MockMemorySegment(segment, virt_addr=0xFFFF0000),],
+            types=[point_type],
+        )
+
+        obj = Object(prog, "int [10]", address=0xFFFF0000)
+        view = memoryview(obj)
+        self.assertTrue(view.readonly)
+        self.assertEqual(view.tobytes(), bytes(segment))
+        self.assertEqual(list(view.cast("i")), list(range(10)))
+
+        self.assertEqual(memoryview(obj.read_()).tobytes(), bytes(segment))
+        self.assertEqual(
+            memoryview(Object(prog, point_type, value={"x": 1, "y": 2})).tobytes(),
+            struct.pack("<ii", 1, 2),
+        )
+
+        self.assertRaisesRegex(
+            TypeError,
+            "'int' does not support the buffer protocol",
+            memoryview,
+            obj[0],
+        )
+        self.assertRaisesRegex(
+            BufferError,
+            "not byte-aligned",
+            memoryview,
+            Object(prog, point_type, address=0xFFFF0000, bit_offset=1),
+        )
+        self.assertRaises(FaultError, memoryview, Object(prog, "int [10]", address=0))
+
     def test_void(self):
         obj = Object(self.prog, void_type(), address=0)
         self.assertIs(obj.prog_, self.prog)
@@ -1328,6 +1479,13 @@ class TestCOperators(ObjectTestCase):
         self.assertTrue(incomplete == incomplete)
         self.assertTrue(incomplete == ptr0)
 
+        # References to the same pointer are equal without reading it.
+        ref = Object(self.prog, "int *", address=0xFFFF0000)
+        self.assertTrue(ref == ref)
+        self.assertTrue(ref == Object(self.prog, "float *", address=0xFFFF0000))
+        self.assertFalse(ref != ref)
+        self.assertRaises(FaultError, operator.eq, ref, ptr0)
+
         self.assertRaises(
             TypeError,
             operator.eq,
@@ -1603,6 +1761,59 @@ class TestCOperators(ObjectTestCase):
                 SyntaxError, error, container_of, obj, type_, member_designator
             )
 
+    def test_member_path(self):
+        path = self.prog.member_path(line_segment_type, "b.y")
+        self.assertEqual(path.container_type, line_segment_type)
+        self.assertEqual(path.designator, "b.y")
+        self.assertEqual(path.type, int_type("int", 4, True))
+        self.assertEqual(path.bit_offset, 96)
+        self.assertEqual(path.bit_field_size, 0)
+
+        segment = Object(
+            self.prog,
+            line_segment_type,
+            value={"a": {"x": 1, "y": 2}, "b": {"x": 3, "y": 4}},
+        )
+        self.assertEqual(path.apply(segment), self.int(4))
+
+        obj = path.apply(0xFFFF0000)
+        self.assertEqual(obj.address_, 0xFFFF000C)
+        self.assertEqual(obj.type_, int_type("int", 4, True))
+
+        ptr = Object(self.prog, pointer_type(8, line_segment_type), value=0xFFFF0000)
+        self.assertEqual(path.apply(ptr).address_, 0xFFFF000C)
+        obj = Object(self.prog, line_segment_type, address=0xFFFF0000)
+        self.assertEqual(path.apply(obj).address_, 0xFFFF000C)
+
+        polygon_type = struct_type(
+            "polygon", 0, (TypeMember(array_type(None, point_type), "points"),)
+        )
+        path = self.prog.member_path(polygon_type, "points[3].y")
+        self.assertEqual(path.bit_offset, 224)
+        self.assertEqual(path.apply(0xFFFF0000).address_, 0xFFFF001C)
+
+        small_point_type = struct_type(
+            "small_point",
+            1,
+            (
+                TypeMember(int_type("int", 4, True), "x", 0, 4),
+                TypeMember(int_type("int", 4, True), "y", 4, 4),
+            ),
+        )
+        path = self.prog.member_path(small_point_type, "y")
+        self.assertEqual(path.bit_offset, 4)
+        self.assertEqual(path.bit_field_size, 4)
+        obj = path.apply(0xFFFF0000)
+        self.assertEqual(obj.bit_offset_, 4)
+        self.assertEqual(obj.bit_field_size_, 4)
+
+        self.assertRaisesRegex(
+            LookupError, "has no member", self.prog.member_path, point_type, "z"
+        )
+        self.assertRaisesRegex(
+            TypeError, "is not an array", self.prog.member_path, point_type, "x[0]"
+        )
+
 
 class TestCPretty(ObjectTestCase):
     def test_int(self):
@@ -1613,6 +1824,19 @@ class TestCPretty(ObjectTestCase):
             str(Object(self.prog, "const int", value=-99)), "(const int)-99"
         )
 
+    def test_type_name_cache(self):
+        # Formatted type names are cached per type and qualifiers.
+        for _ in range(2):
+            self.assertEqual(str(Object(self.prog, "int", value=1)), "(int)1")
+            self.assertEqual(
+                str(Object(self.prog, "volatile int", value=1)), "(volatile int)1"
+            )
+            self.assertEqual(
+                repr(Object(self.prog, "const int", value=1)),
+                "Object(prog, 'const int', value=1)",
+            )
+            self.assertEqual(self.prog.type("const int").type_name(), "const int")
+
     def test_char(self):
         obj = Object(self.prog, "char", value=65)
         self.assertEqual(str(obj), "(char)65")
@@ -1809,6 +2033,188 @@ class TestCPretty(ObjectTestCase):
 }""",
         )
 
+    def test_read_once(self):
+        segment = b"".join(i.to_bytes(4, "little") for i in range(1, 2 ** 19 + 1))
+        reads = []
+
+        def read_fn(address, count, offset, physical):
+            reads.append(count)
+            return segment[offset : offset + count]
+
+        prog = mock_program(types=[point_type])
+        prog.add_memory_segment(0xFFFF0000, len(segment), read_fn)
+
+        ptr = Object(prog, "struct point *", value=0xFFFF0000)
+        self.assertEqual(
+            str(ptr),
+            """\
+*(struct point *)0xffff0000 = {
+	.x = (int)1,
+	.y = (int)2,
+}""",
+        )
+        self.assertEqual(reads, [8])
+
+        # Arrays that are too large to read at once are read in chunks.
+        del reads[:]
+        obj = Object(prog, "int [524288]", address=0xFFFF0000)
+        self.assertEqual(
+            obj.format_(columns=80),
+            Object(
+                prog, "int [524288]", value=list(range(1, 2 ** 19 + 1))
+            ).format_(columns=80),
+        )
+        self.assertLessEqual(len(reads), 4)
+
+    def test_limits(self):
+        segment = b"".join(i.to_bytes(4, "little") for i in range(1, 65537))
+        reads = []
+
+        def read_fn(address, count, offset, physical):
+            reads.append(count)
+            return segment[offset : offset + count]
+
+        prog = mock_program(types=[point_type, line_segment_type])
+        prog.add_memory_segment(0xFFFF0000, len(segment), read_fn)
+
+        obj = Object(prog, "int [65536]", address=0xFFFF0000)
+        self.assertEqual(
+            obj.format_(max_elements=3), "(int [65536]){ 1, 2, 3, ... }"
+        )
+        self.assertEqual(sum(reads), 12)
+        self.assertEqual(
+            obj.format_(max_elements=2, elements_same_line=False),
+            """\
+(int [65536]){
+	1,
+	2,
+	...
+}""",
+        )
+        self.assertLess(len(obj.format_(max_bytes=100)), 200)
+
+        obj = Object(prog, "struct line_segment", address=0xFFFF0000)
+        self.assertEqual(
+            obj.format_(max_depth=1, member_type_names=False),
+            """\
+(struct line_segment){
+	.a = {...},
+	.b = {...},
+}""",
+        )
+        self.assertEqual(obj.format_(max_depth=2), str(obj))
+
+    def test_follow_pointers(self):
+        node_type = struct_type(
+            "node",
+            16,
+            (
+                TypeMember(int_type("int", 4, True), "value"),
+                TypeMember(lambda: pointer_type(8, node_type), "next", 64),
+            ),
+        )
+        segment = bytearray(
+            struct.pack("<i4xQ", 1, 0xFFFF0010)
+            + struct.pack("<i4xQ", 2, 0xFFFF0020)
+            + struct.pack("<i4xQ", 3, 0)
+        )
+        prog = mock_program(
+            segments=[MockMemorySegment(segment, virt_addr=0xFFFF0000)],
+            types=[node_type],
+        )
+        obj = Object(prog, node_type, address=0xFFFF0000)
+
+        def format_(**kwds):
+            return obj.format_(member_type_names=False, members_same_line=True, **kwds)
+
+        self.assertEqual(format_(), "(struct node){ .value = 1, .next = 0xffff0010 }")
+        self.assertEqual(
+            format_(follow_pointers=1),
+            "(struct node){ .value = 1, .next = *0xffff0010 = "
+            "{ .value = 2, .next = 0xffff0020 } }",
+        )
+        # NULL pointers aren't followed.
+        expected = (
+            "(struct node){ .value = 1, .next = *0xffff0010 = "
+            "{ .value = 2, .next = *0xffff0020 = { .value = 3, .next = 0x0 } } }"
+        )
+        self.assertEqual(format_(follow_pointers=3), expected)
+        self.assertEqual(
+            format_(follow_pointers=3, max_dereference_bytes=16),
+            format_(follow_pointers=1),
+        )
+        # Changing the layout doesn't change what is shown.
+        self.assertEqual(
+            obj.format_(follow_pointers=3, member_type_names=False, columns=40),
+            """\
+(struct node){
+	.value = 1,
+	.next = *0xffff0010 = {
+		.value = 2,
+		.next = *0xffff0020 = {
+			.value = 3,
+			.next = 0x0,
+		},
+	},
+}""",
+        )
+
+        # Make a cycle.
+        segment[40:48] = (0xFFFF0000).to_bytes(8, "little")
+        self.assertEqual(
+            format_(follow_pointers=10),
+            "(struct node){ .value = 1, .next = *0xffff0010 = "
+            "{ .value = 2, .next = *0xffff0020 = "
+            "{ .value = 3, .next = 0xffff0000 /* shown above */ } } }",
+        )
+
+    def test_format_objects(self):
+        segment = b"".join(struct.pack("<i", i) for i in range(100))
+        prog = mock_program(
+            segments=[MockMemorySegment(segment, virt_addr=0xFFFF0000)]
+        )
+        objs = [
+            Object(prog, "int", address=0xFFFF0000 + 4 * i) for i in range(100)
+        ]
+        self.assertEqual(format_objects([]), [])
+        self.assertEqual(format_objects(objs), [str(obj) for obj in objs])
+        self.assertEqual(
+            format_objects(objs, type_name=False),
+            [str(i) for i in range(100)],
+        )
+        self.assertRaises(
+            FaultError, format_objects, objs + [Object(prog, "int", address=0)]
+        )
+        self.assertRaises(
+            ValueError, format_objects, [objs[0], Object(self.prog, "int", 0)]
+        )
+        self.assertRaises(TypeError, format_objects, [1])
+        self.assertRaises(TypeError, format_objects, objs, file=io.StringIO())
+
+    def test_format_file(self):
+        obj = Object(self.prog, "int [4096]", value=list(range(1, 4097)))
+        expected = obj.format_(columns=80)
+
+        chunks = []
+        self.assertIsNone(obj.format_(columns=80, file=chunks.append))
+        self.assertGreater(len(chunks), 1)
+        self.assertEqual("".join(chunks), expected)
+
+        f = io.StringIO()
+        obj.format_(columns=80, file=f)
+        self.assertEqual(f.getvalue(), expected)
+
+        with tempfile.TemporaryFile() as f:
+            obj.format_(columns=80, file=f.fileno())
+            f.seek(0)
+            self.assertEqual(f.read().decode(), expected)
+
+        def write(s):
+            raise ZeroDivisionError
+
+        self.assertRaises(ZeroDivisionError, obj.format_, file=write)
+        self.assertRaises(TypeError, obj.format_, file=object())
+
     def test_bit_field(self):
         segment = b"\x07\x10\x5e\x5f\x1f\0\0\0"
         prog = mock_program(
@@ -1924,6 +2330,22 @@ class TestCPretty(ObjectTestCase):
             r'(char *)0xffff0020 = "\"escape\tme\\"',
         )
 
+    def test_long_c_string(self):
+        # Long enough to be read in more than one chunk, with characters that
+        # need to be escaped on either side of the chunk boundaries.
+        string = b"".join(b"%03d\x01\x7f\"" % i for i in range(200))
+        prog = mock_program(
+            segments=[MockMemorySegment(string + b"\0", virt_addr=0xFFFF0000)]
+        )
+        expected = "".join(r'%03d\x01\x7f\"' % i for i in range(200))
+        self.assertEqual(
+            str(Object(prog, "char *", value=0xFFFF0000)),
+            f'(char *)0xffff0000 = "{expected}"',
+        )
+        obj = Object(prog, f"char [{len(string)}]", address=0xFFFF0000)
+        self.assertEqual(obj.format_(type_name=False), f'"{expected}"')
+        self.assertEqual(obj.read_().format_(type_name=False), f'"{expected}"')
+
     def test_basic_array(self):
         segment = bytearray()
         for i in range(5):
@@ -2198,6 +2620,46 @@ class TestCPretty(ObjectTestCase):
         obj = Object(prog, "struct empty [2]", address=0)
         self.assertEqual(str(obj), "(struct empty [2]){}")
 
+    def test_array_zeroes_flattened(self):
+        segment = bytearray(24)
+        prog = mock_program(
+            segments=[MockMemorySegment(segment, virt_addr=0xFFFF0000),]
+        )
+        type_ = struct_type(
+            "foo",
+            8,
+            (
+                TypeMember(float_type("float", 4), "f"),
+                TypeMember(int_type("int", 4, True), "x", 32, 4),
+                TypeMember(int_type("int", 4, True), "y", 36, 28),
+            ),
+        )
+        obj = Object(prog, array_type(3, type_), address=0xFFFF0000)
+
+        segment[8:12] = struct.pack("<f", -0.0)
+        self.assertEqual(str(obj), "(struct foo [3]){}")
+
+        segment[4] = 0xF
+        self.assertEqual(
+            str(obj),
+            """\
+(struct foo [3]){
+	{
+		.f = (float)0.0,
+		.x = (int)-1,
+		.y = (int)0,
+	},
+}""",
+        )
+        self.assertEqual(
+            obj.value_(),
+            [
+                {"f": 0.0, "x": -1, "y": 0},
+                {"f": -0.0, "x": 0, "y": 0},
+                {"f": 0.0, "x": 0, "y": 0},
+            ],
+        )
+
     def test_char_array(self):
         segment = bytearray(16)
         prog = mock_program(
@@ -2227,6 +2689,157 @@ class TestCPretty(ObjectTestCase):
         self.assertEqual(str(obj), "(void (void))0xffff0000")
 
 
+class TestCJson(ObjectTestCase):
+    def setUp(self):
+        super().setUp()
+        self.prog = mock_program(
+            segments=[
+                MockMemorySegment(
+                    struct.pack("<4i", 1, 2, 3, 4), virt_addr=0xFFFF0000
+                ),
+            ],
+            types=[point_type, line_segment_type],
+        )
+
+    def json(self, obj, **kwds):
+        return json.loads(obj.json_(**kwds))
+
+    def test_int(self):
+        self.assertEqual(
+            self.json(Object(self.prog, "int", address=0xFFFF0004)),
+            {"type": "int", "address": 0xFFFF0004, "value": 2},
+        )
+        self.assertEqual(
+            self.json(Object(self.prog, "long", value=-1)),
+            {"type": "long", "address": None, "value": -1},
+        )
+        self.assertEqual(
+            self.json(Object(self.prog, "_Bool", value=True)),
+            {"type": "_Bool", "address": None, "value": True},
+        )
+
+    def test_float(self):
+        self.assertEqual(
+            self.json(Object(self.prog, "double", value=1.5)),
+            {"type": "double", "address": None, "value": 1.5},
+        )
+        self.assertEqual(
+            self.json(Object(self.prog, "double", value=math.inf)),
+            {"type": "double", "address": None, "value": None},
+        )
+
+    def test_enum(self):
+        self.assertEqual(
+            self.json(Object(self.prog, color_type, value=1)),
+            {"type": "enum color", "address": None, "value": 1, "enumerator": "GREEN"},
+        )
+        self.assertEqual(
+            self.json(Object(self.prog, color_type, value=5)),
+            {"type": "enum color", "address": None, "value": 5},
+        )
+
+    def test_pointer(self):
+        self.assertEqual(
+            self.json(Object(self.prog, "struct point *", value=0xFFFF0000)),
+            {"type": "struct point *", "address": None, "value": 0xFFFF0000},
+        )
+
+    def test_compound(self):
+        def member(name, type, address, value):
+            return {"name": name, "type": type, "address": address, "value": value}
+
+        obj = Object(self.prog, "struct line_segment", address=0xFFFF0000)
+        self.assertEqual(
+            self.json(obj),
+            {
+                "type": "struct line_segment",
+                "address": 0xFFFF0000,
+                "value": [
+                    member(
+                        "a",
+                        "struct point",
+                        0xFFFF0000,
+                        [
+                            member("x", "int", 0xFFFF0000, 1),
+                            member("y", "int", 0xFFFF0004, 2),
+                        ],
+                    ),
+                    member(
+                        "b",
+                        "struct point",
+                        0xFFFF0008,
+                        [
+                            member("x", "int", 0xFFFF0008, 3),
+                            member("y", "int", 0xFFFF000C, 4),
+                        ],
+                    ),
+                ],
+            },
+        )
+
+        type_ = struct_type(
+            "foo",
+            8,
+            (
+                TypeMember(int_type("int", 4, True), "bf", 0, 4),
+                TypeMember(
+                    union_type(
+                        None, 4, (TypeMember(int_type("int", 4, True), "u", 0),)
+                    ),
+                    None,
+                    32,
+                ),
+            ),
+        )
+        self.assertEqual(
+            self.json(Object(self.prog, type_, address=0xFFFF0000))["value"],
+            [member("bf", "int", None, 1), member("u", "int", 0xFFFF0004, 2)],
+        )
+
+    def test_array(self):
+        obj = Object(self.prog, "int [4]", address=0xFFFF0000)
+        self.assertEqual(
+            self.json(obj)["value"],
+            [
+                {"type": "int", "address": 0xFFFF0000 + 4 * i, "value": i + 1}
+                for i in range(4)
+            ],
+        )
+        self.assertEqual(
+            self.json(Object(self.prog, "int [2]", value=[5, 6]))["value"],
+            [
+                {"type": "int", "address": None, "value": 5},
+                {"type": "int", "address": None, "value": 6},
+            ],
+        )
+
+    def test_limits(self):
+        obj = Object(self.prog, "int [4]", address=0xFFFF0000)
+        value = self.json(obj, max_elements=2)
+        self.assertEqual([element["value"] for element in value["value"]], [1, 2])
+        self.assertTrue(value["truncated"])
+
+        obj = Object(self.prog, "struct line_segment", address=0xFFFF0000)
+        value = self.json(obj, max_depth=1)
+        self.assertEqual(
+            value["value"][0],
+            {
+                "name": "a",
+                "type": "struct point",
+                "address": 0xFFFF0000,
+                "value": None,
+                "truncated": True,
+            },
+        )
+        self.assertNotIn("truncated", value)
+        self.assertEqual(self.json(obj, max_depth=2), self.json(obj))
+
+        obj = Object(self.prog, "int [4096]", value=list(range(4096)))
+        value = self.json(obj, max_bytes=1000)
+        self.assertTrue(value["truncated"])
+        self.assertLess(len(value["value"]), 4096)
+
+
 class TestGenericOperators(ObjectTestCase):
     def setUp(self):
         super().setUp()
@@ -2402,6 +3015,34 @@ class TestGenericOperators(ObjectTestCase):
         )
         self.assertRaisesRegex(AttributeError, "no attribute", getattr, obj, "x")
 
+    def test_unnamed_member_lazy(self):
+        evaluated = []
+
+        def unnamed_type():
+            evaluated.append(True)
+            return struct_type(None, 4, (TypeMember(int_type("int", 4, True), "z"),))
+
+        obj = Object(
+            self.prog,
+            struct_type(
+                "foo",
+                12,
+                (
+                    TypeMember(int_type("int", 4, True), "x"),
+                    TypeMember(unnamed_type, None, 32),
+                    TypeMember(int_type("int", 4, True), "y", 64),
+                ),
+            ),
+            address=0xFFFF0000,
+        )
+        self.assertEqual(obj.y, Object(self.prog, "int", address=0xFFFF0008))
+        self.assertFalse(evaluated)
+        self.assertEqual(obj.z, Object(self.prog, "int", address=0xFFFF0004))
+        self.assertTrue(evaluated)
+        self.assertRaisesRegex(
+            LookupError, "'struct foo' has no member 'w'", obj.member_, "w"
+        )
+
     def test_bit_field_member(self):
         segment = b"\x07\x10\x5e\x5f\x1f\0\0\0"
         prog = mock_program(
@@ -2524,3 +3165,35 @@ class TestSpecialMethods(ObjectTestCase):
             iter,
             Object(self.prog, "int []", address=0),
         )
+
+    def test_pickle(self):
+        prog = mock_program(
+            segments=[MockMemorySegment(b"\x01\x00\x00\x00\x02\x00\x00\x00", 0)],
+            types=[point_type],
+        )
+        self.assertIs(pickle.loads(pickle.dumps(prog)), prog)
+        type_ = prog.type("struct point")
+        self.assertIs(pickle.loads(pickle.dumps(type_)), type_)
+        obj = Object(prog, "struct point", address=0)
+        for value in [
+            obj,
+            obj.read_(),
+            obj.y,
+            obj.address_of_(),
+            Object(prog, "int", value=-1),
+            Object(prog, "const double", value=1.5),
+            Object(prog, "unsigned int", value=5, bit_field_size=3),
+            Object(prog, "int [2]", value=[3, 4]),
+        ]:
+            self.assertEqual(pickle.loads(pickle.dumps(value)), value)
+
+        self.assertRaisesRegex(
+            TypeError,
+            "anonymous",
+            pickle.dumps,
+            Object(prog, struct_type(None, 4, ()), address=0),
+        )
+        other = mock_program()
+        self.assertRaises(ValueError, setattr, other, "pickle_id", prog.pickle_id)
+        other.pickle_id = prog.pickle_id + 1
+        self.assertIs(pickle.loads(pickle.dumps(other)), other)
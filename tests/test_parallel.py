@@ -0,0 +1,51 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+import os
+import unittest
+
+from drgn import Object
+import drgn.parallel
+from tests import MockMemorySegment, mock_program, point_type
+
+
+class TestParallel(unittest.TestCase):
+    def test_map(self):
+        self.assertEqual(
+            drgn.parallel.map(lambda x: x * 2, range(100), processes=4),
+            [x * 2 for x in range(100)],
+        )
+        self.assertEqual(drgn.parallel.map(lambda x: x, [], processes=4), [])
+        self.assertEqual(
+            drgn.parallel.map(lambda x: x + 1, range(10), processes=1),
+            list(range(1, 11)),
+        )
+
+    def test_children(self):
+        pids = set(drgn.parallel.map(lambda x: os.getpid(), range(8), processes=2))
+        self.assertNotIn(os.getpid(), pids)
+
+    def test_imap_objects(self):
+        prog = mock_program(
+            segments=[MockMemorySegment(bytes(range(64)), virt_addr=0)],
+            types=[point_type],
+        )
+        objects = [Object(prog, "struct point", address=8 * i) for i in range(8)]
+        self.assertEqual(
+            list(
+                drgn.parallel.imap(
+                    lambda obj: obj.y, objects, processes=2, chunksize=3
+                )
+            ),
+            [obj.y for obj in objects],
+        )
+
+    def test_exception(self):
+        def f(x):
+            if x == 5:
+                raise ValueError("five")
+            return x
+
+        self.assertRaisesRegex(
+            ValueError, "five", drgn.parallel.map, f, range(10), processes=2
+        )
@@ -1,10 +1,18 @@
 # Copyright (c) Facebook, Inc. and its affiliates.
 # SPDX-License-Identifier: GPL-3.0+
 
+import array
+import concurrent.futures
 import ctypes
 import itertools
+import lzma
+import mmap
 import os
+import socket
+import struct
 import tempfile
+import threading
+import time
 import unittest
 import unittest.mock
 
@@ -18,16 +26,23 @@ from drgn import (
     Program,
     ProgramFlags,
     Qualifiers,
+    TypeEnumerator,
+    TypeKind,
+    TypeMember,
     array_type,
     bool_type,
+    enum_type,
     float_type,
     function_type,
     host_platform,
     int_type,
     pointer_type,
+    set_background_reads,
+    struct_type,
     typedef_type,
     void_type,
 )
+from drgn.helpers import memoize
 from tests import (
     DEFAULT_LANGUAGE,
     MOCK_32BIT_PLATFORM,
@@ -36,6 +51,7 @@ from tests import (
     MockObject,
     ObjectTestCase,
     color_type,
+    line_segment_type,
     mock_program,
     option_type,
     pid_type,
@@ -68,6 +84,81 @@ class TestProgram(unittest.TestCase):
             os.getpid(),
         )
 
+    def test_set_pid_proc_pid_mem(self):
+        for value in ["0", "1"]:
+            with self.subTest(DRGN_USE_PROC_PID_MEM=value):
+                with unittest.mock.patch.dict(
+                    os.environ, {"DRGN_USE_PROC_PID_MEM": value}
+                ):
+                    prog = Program()
+                    prog.set_pid(os.getpid())
+                data = b"hello, world!"
+                buf = ctypes.create_string_buffer(data)
+                self.assertEqual(prog.read(ctypes.addressof(buf), len(data)), data)
+                self.assertRaises(FaultError, prog.read, 0, 8)
+
+    def test_set_pid_maps(self):
+        prog = Program()
+        prog.set_pid(os.getpid())
+        self.assertRaises(FaultError, prog.read, 0, 8)
+        self.assertRaises(FaultError, prog.read, 0, 8)
+        self.assertGreaterEqual(prog.stats()["process_map_faults"], 1)
+
+        data = b"hello, world!" * 1000
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(data)
+            f.flush()
+            with mmap.mmap(f.fileno(), 0, prot=mmap.PROT_READ):
+                with open("/proc/self/maps") as maps:
+                    for line in maps:
+                        if line.rstrip("\n").endswith(" " + f.name):
+                            address = int(line.partition("-")[0], 16)
+                            break
+                    else:
+                        self.fail("mapping not found")
+                # The mapping is newer than the map that drgn read.
+                prog.invalidate_memory_cache()
+                prog.reset_stats()
+                self.assertEqual(prog.read(address, len(data)), data)
+                self.assertEqual(prog.stats()["process_file_bytes"], len(data))
+
+    def test_read_limit(self):
+        prog = Program()
+        self.assertIsNone(prog.max_read_bytes_per_second)
+        self.assertIsNone(prog.max_reads_per_second)
+        self.assertRaises(ValueError, setattr, prog, "max_reads_per_second", 0)
+        prog.max_read_bytes_per_second = 1 << 20
+        prog.max_reads_per_second = 10
+        self.assertEqual(prog.max_read_bytes_per_second, 1 << 20)
+        self.assertEqual(prog.max_reads_per_second, 10)
+        prog.max_read_bytes_per_second = None
+        self.assertIsNone(prog.max_read_bytes_per_second)
+        self.assertEqual(prog.max_reads_per_second, 10)
+
+    def test_read_limit_pid(self):
+        data = b"hello, world!" * 1000
+        buf = ctypes.create_string_buffer(data)
+        address = ctypes.addressof(buf)
+        prog = Program()
+        prog.set_pid(os.getpid())
+        prog.max_reads_per_second = 10
+        # One read of a page serves the other small reads of it.
+        for i in range(10):
+            self.assertEqual(prog.read(address + i, 1), data[i : i + 1])
+        self.assertGreaterEqual(prog.stats()["coalesced_reads"], 9)
+        self.assertEqual(prog.read(address + 5000, 8), data[5000:5008])
+        self.assertGreaterEqual(prog.stats()["throttle_waits"], 1)
+
+        prog.max_reads_per_second = None
+        prog.reset_stats()
+        self.assertEqual(prog.read(address, 1), data[:1])
+        self.assertEqual(prog.stats()["coalesced_reads"], 0)
+
+    def test_set_background_reads(self):
+        self.assertFalse(set_background_reads(True))
+        self.assertTrue(set_background_reads(False))
+        self.assertFalse(set_background_reads(False))
+
     def test_lookup_error(self):
         prog = mock_program()
         self.assertRaisesRegex(
@@ -130,6 +221,48 @@ class TestProgram(unittest.TestCase):
     def test_debug_info(self):
         Program().load_debug_info([])
 
+    def test_epoch(self):
+        prog = mock_program()
+        epoch = prog.epoch
+        self.assertEqual(prog.epoch, epoch)
+        prog.bump_epoch()
+        self.assertEqual(prog.epoch, epoch + 1)
+
+    def test_epoch_interval(self):
+        prog = mock_program()
+        self.assertIsNone(prog.epoch_interval)
+        prog.epoch_interval = 0.001
+        self.assertEqual(prog.epoch_interval, 0.001)
+        # The interval only applies to running programs.
+        epoch = prog.epoch
+        time.sleep(0.01)
+        self.assertEqual(prog.epoch, epoch)
+        prog.epoch_interval = None
+        self.assertIsNone(prog.epoch_interval)
+        self.assertRaises(ValueError, setattr, prog, "epoch_interval", 0)
+        self.assertRaises(ValueError, setattr, prog, "epoch_interval", -1.0)
+        self.assertRaises(AttributeError, delattr, prog, "epoch_interval")
+
+    def test_memoize(self):
+        calls = []
+
+        @memoize
+        def helper(prog, x, y=0):
+            calls.append((x, y))
+            return x + y
+
+        prog = mock_program()
+        self.assertEqual(helper(prog, 1), 1)
+        self.assertEqual(helper(prog, 1), 1)
+        self.assertEqual(helper(prog, 1, y=2), 3)
+        self.assertEqual(helper(prog, 1, y=2), 3)
+        self.assertEqual(calls, [(1, 0), (1, 2)])
+        self.assertEqual(helper(mock_program(), 1), 1)
+        self.assertEqual(calls, [(1, 0), (1, 2), (1, 0)])
+        prog.bump_epoch()
+        self.assertEqual(helper(prog, 1), 1)
+        self.assertEqual(calls, [(1, 0), (1, 2), (1, 0), (1, 0)])
+
     def test_language(self):
         self.assertEqual(Program().language, DEFAULT_LANGUAGE)
 
@@ -167,6 +300,296 @@ class TestMemory(unittest.TestCase):
             MOCK_32BIT_PLATFORM, segments=[MockMemorySegment(data, 0xFFFF0000, 0xA0)],
         )
 
+    def test_read_unsigned_array(self):
+        data = bytes(range(1, 17))
+        for word_size in [8, 4]:
+            for byteorder in ["little", "big"]:
+                flags = PlatformFlags(0)
+                if word_size == 8:
+                    flags |= PlatformFlags.IS_64_BIT
+                if byteorder == "little":
+                    flags |= PlatformFlags.IS_LITTLE_ENDIAN
+                prog = mock_program(
+                    Platform(Architecture.UNKNOWN, flags),
+                    segments=[MockMemorySegment(data, 0xFFFF0000, 0xA0)],
+                )
+                for size, typecode in [(1, "B"), (2, "H"), (4, "I"), (8, "Q")]:
+                    read_fn = getattr(prog, f"read_u{8 * size}_array")
+                    count = len(data) // size
+                    values = array.array(
+                        typecode,
+                        [
+                            int.from_bytes(data[i : i + size], byteorder)
+                            for i in range(0, len(data), size)
+                        ],
+                    )
+                    self.assertEqual(read_fn(0xFFFF0000, count), values)
+                    self.assertEqual(read_fn(0xA0, count, True), values)
+                    self.assertEqual(read_fn(0xFFFF0000, 0), array.array(typecode))
+                    if size == word_size:
+                        self.assertEqual(
+                            prog.read_word_array(0xFFFF0000, count),
+                            array.array("Q", values),
+                        )
+                self.assertRaises(ValueError, prog.read_u32_array, 0xFFFF0000, -1)
+                self.assertRaises(FaultError, prog.read_u64_array, 0xFFFF0000, 3)
+
+    def test_memory_cache_readahead(self):
+        data = bytes(range(256)) * 16 * 64
+        reads = []
+
+        def read_fn(address, count, offset, physical):
+            reads.append((address, count))
+            return data[offset : offset + count]
+
+        prog = Program(MOCK_PLATFORM)
+        prog.add_memory_segment(0xFFFF0000, len(data), read_fn)
+        prog.memory_cache_size = 1024 * 1024
+        for i in range(34):
+            self.assertEqual(
+                prog.read(0xFFFF0000 + 4096 * i, 8), data[4096 * i : 4096 * i + 8],
+            )
+        self.assertEqual(
+            reads,
+            [
+                (0xFFFF0000, 4096),
+                (0xFFFF1000, 32 * 4096),
+                (0xFFFF0000 + 33 * 4096, 4096),
+            ],
+        )
+
+    def test_memory_segment_block_size(self):
+        data = bytes(range(256)) * 16 * 64
+        reads = []
+
+        def read_fn(address, count, offset, physical):
+            reads.append((address, count))
+            return data[offset : offset + count]
+
+        prog = Program(MOCK_PLATFORM)
+        prog.add_memory_segment(0xFFFF0000, len(data), read_fn, block_size=65536)
+        self.assertGreater(prog.memory_cache_size, 0)
+        for address in (0xFFFF5008, 0xFFFF1000, 0xFFFFF000, 0xFFFF0000 + 0x12345):
+            offset = address - 0xFFFF0000
+            self.assertEqual(prog.read(address, 8), data[offset : offset + 8])
+        self.assertEqual(
+            reads, [(0xFFFF0000, 65536), (0xFFFF0000 + 0x10000, 65536)],
+        )
+        self.assertRaises(
+            ValueError,
+            prog.add_memory_segment,
+            0,
+            4096,
+            read_fn,
+            block_size=100,
+        )
+
+    def test_read_threads(self):
+        data = bytes(range(256)) * 64
+        prog = Program(MOCK_PLATFORM)
+        prog.add_memory_segment(
+            0xFFFF0000,
+            len(data),
+            lambda address, count, offset, physical: data[offset : offset + count],
+        )
+        prog.memory_cache_size = 4096 * 4
+
+        def read(i):
+            return prog.read(0xFFFF0000 + 97 * i, 8) == data[97 * i : 97 * i + 8]
+
+        with concurrent.futures.ThreadPoolExecutor(max_workers=8) as executor:
+            self.assertTrue(all(executor.map(read, range(160))))
+
+    def test_format_threads(self):
+        data = b"".join(
+            i.to_bytes(4, "little") + (-i).to_bytes(4, "little", signed=True)
+            for i in range(256)
+        )
+        prog = Program(MOCK_PLATFORM)
+        # The callback needs the GIL while format_() holds the memory reader
+        # lock, and value_() needs that lock while holding the GIL.
+        prog.add_memory_segment(
+            0xFFFF0000,
+            len(data),
+            lambda address, count, offset, physical: data[offset : offset + count],
+        )
+
+        objects = [
+            Object(prog, point_type, address=0xFFFF0000 + 8 * i) for i in range(256)
+        ]
+        expected = [str(obj) for obj in objects]
+
+        def format(i):
+            if i % 2:
+                return objects[i].y.value_() == -i
+            return str(objects[i]) == expected[i]
+
+        with concurrent.futures.ThreadPoolExecutor(max_workers=8) as executor:
+            self.assertTrue(all(executor.map(format, range(256))))
+
+    def test_lookup_threads(self):
+        types = [
+            struct_type(f"s{i}", 8, (TypeMember(int_type("int", 4, True), f"x{i}"),))
+            for i in range(64)
+        ]
+        data = b"".join(i.to_bytes(8, "little") for i in range(64))
+        prog = mock_program(
+            segments=[MockMemorySegment(data, 0xFFFF0000)], types=types
+        )
+
+        def lookup(i):
+            # format_() looks up members with the GIL released while other
+            # threads parse new types with it held.
+            type_ = prog.type(f"struct s{i % 64}")
+            obj = Object(prog, type_, address=0xFFFF0000 + 8 * (i % 64))
+            return (
+                getattr(obj, f"x{i % 64}").value_() == i % 64
+                and obj.format_() == str(obj)
+            )
+
+        with concurrent.futures.ThreadPoolExecutor(max_workers=8) as executor:
+            self.assertTrue(all(executor.map(lookup, range(256))))
+
+    def test_stats(self):
+        data = b"hello, world"
+        prog = mock_program(segments=[MockMemorySegment(data, 0xFFFF0000)])
+        stats = prog.stats()
+        self.assertEqual(stats["reads"], 0)
+        self.assertEqual(stats["read_bytes"], 0)
+        prog.read(0xFFFF0000, 5)
+        prog.read(0xFFFF0007, 5)
+        stats = prog.stats()
+        self.assertEqual(stats["reads"], 2)
+        self.assertEqual(stats["read_bytes"], 10)
+        self.assertEqual(stats["cache_hits"], 0)
+        prog.reset_stats()
+        self.assertEqual(prog.stats()["reads"], 0)
+
+    def test_memory_usage(self):
+        data = bytes(4096)
+        prog = mock_program(segments=[MockMemorySegment(data, 0xFFFF0000)])
+        usage = prog.memory_usage()
+        self.assertEqual(usage["memory_cache"], 0)
+        self.assertEqual(usage["total"], sum(usage.values()) - usage["total"])
+        self.assertGreater(usage["memory_segments"], 0)
+
+        prog.memory_cache_size = 4096 * 4
+        prog.read(0xFFFF0000, 5)
+        self.assertGreaterEqual(prog.memory_usage()["memory_cache"], 4096 * 4)
+
+        prog.pointer_type(int_type("int", 4, True))
+        self.assertGreater(
+            prog.memory_usage()["type_index"], usage["type_index"]
+        )
+
+    def test_read_batch(self):
+        data = b"hello, world"
+        prog = mock_program(segments=[MockMemorySegment(data, 0xFFFF0000, 0xA0)])
+        self.assertEqual(prog.read_batch([]), [])
+        self.assertEqual(
+            prog.read_batch(
+                [
+                    (0xFFFF0007, 5),
+                    (0xFFFF0000, 5),
+                    (0xFFFF0002, 3),
+                    (0xA0, 5, True),
+                    (0xFFFF0005, 0),
+                ]
+            ),
+            [b"world", b"hello", b"llo", b"hello", b""],
+        )
+        self.assertRaises(FaultError, prog.read_batch, [(0xFFFF0000, 4), (0x0, 4)])
+        self.assertRaises(ValueError, prog.read_batch, [(0xFFFF0000, -1)])
+        self.assertRaises(TypeError, prog.read_batch, [0xFFFF0000])
+
+    def test_read_into(self):
+        data = b"hello, world"
+        prog = mock_program(segments=[MockMemorySegment(data, 0xFFFF0000, 0xA0)])
+        buf = bytearray(5)
+        prog.read_into(buf, 0xFFFF0007)
+        self.assertEqual(buf, b"world")
+        prog.read_into(memoryview(buf)[1:4], 0xA0, True)
+        self.assertEqual(buf, b"wheld")
+        self.assertRaises(FaultError, prog.read_into, buf, 0x0)
+        self.assertRaises(TypeError, prog.read_into, b"hello", 0xFFFF0000)
+
+    def test_read_view(self):
+        data = b"hello, world"
+        prog = mock_program(segments=[MockMemorySegment(data, 0xFFFF0000, 0xA0)])
+        view = prog.read_view(0xFFFF0007, 5)
+        self.assertTrue(view.readonly)
+        self.assertEqual(bytes(view), b"world")
+        self.assertEqual(bytes(prog.read_view(0xA0, 5, True)), b"hello")
+        self.assertRaises(FaultError, prog.read_view, 0x0, 5)
+        self.assertRaises(ValueError, prog.read_view, 0xFFFF0000, -1)
+
+    def test_prefetch_python_segment(self):
+        reads = []
+
+        def read_fn(address, count, offset, physical):
+            reads.append((address, count))
+            return bytes(count)
+
+        prog = Program(MOCK_PLATFORM)
+        prog.add_memory_segment(0xFFFF0000, 8192, read_fn)
+        # Python callbacks are never called from the prefetch thread.
+        prog.prefetch(0xFFFF0000, 8192)
+        prog.prefetch_many([(0xFFFF0000, 4096), (0xFFFF1000, 4096, False)])
+        prog.prefetch_many(iter([]))
+        self.assertEqual(reads, [])
+        self.assertRaises(ValueError, prog.prefetch, 0xFFFF0000, -1)
+        self.assertRaises(ValueError, prog.prefetch_many, [(0xFFFF0000, -1)])
+        self.assertRaises(TypeError, prog.prefetch_many, [0xFFFF0000])
+
+    def test_watch(self):
+        data = bytearray(8192)
+        reads = []
+
+        def read_fn(address, count, offset, physical):
+            reads.append((address, count))
+            return bytes(data[offset : offset + count])
+
+        prog = Program(MOCK_PLATFORM)
+        prog.memory_cache_size = 0
+        prog.add_memory_segment(0xFFFF0000, len(data), read_fn)
+        int_type = prog.int_type("int", 4, True)
+        watch = prog.watch(
+            [
+                Object(prog, int_type, address=0xFFFF1000),
+                Object(prog, int_type, address=0xFFFF0010),
+                Object(prog, int_type, address=0xFFFF0100),
+            ]
+        )
+        self.assertEqual(len(watch), 3)
+        self.assertEqual(
+            watch.sample(),
+            [
+                (0, Object(prog, int_type, value=0)),
+                (1, Object(prog, int_type, value=0)),
+                (2, Object(prog, int_type, value=0)),
+            ],
+        )
+        # The objects in the same page are read together.
+        self.assertEqual(sorted(reads), [(0xFFFF0010, 0xF4), (0xFFFF1000, 4)])
+        self.assertEqual(watch.sample(), [])
+
+        data[0x100:0x104] = (7).to_bytes(4, "little")
+        data[0x1002] = 1
+        self.assertEqual(
+            watch.sample(),
+            [
+                (0, Object(prog, int_type, value=0x10000)),
+                (2, Object(prog, int_type, value=7)),
+            ],
+        )
+        self.assertEqual(watch.sample(), [])
+
+        self.assertRaises(ValueError, prog.watch, [Object(prog, int_type, 1)])
+        self.assertRaises(TypeError, prog.watch, [0xFFFF0000])
+        self.assertRaises(
+            FaultError, prog.watch([Object(prog, int_type, address=0)]).sample
+        )
+
     def test_bad_address(self):
         data = b"hello, world!"
         prog = mock_program(segments=[MockMemorySegment(data, 0xFFFF0000)])
@@ -177,6 +600,22 @@ class TestMemory(unittest.TestCase):
             FaultError, "could not find memory segment", prog.read, 0xFFFF0000, 4, True
         )
 
+    def test_try_read(self):
+        data = b"hello, world!"
+        prog = mock_program(segments=[MockMemorySegment(data, 0xFFFF0000, 0xA0)])
+        self.assertEqual(prog.try_read(0xFFFF0000, 5), b"hello")
+        self.assertEqual(prog.try_read(0xA7, 5, physical=True), b"world")
+        self.assertIsNone(prog.try_read(0xDEADBEEF, 4))
+        self.assertIsNone(prog.try_read(0xFFFF0000, len(data) + 1))
+        self.assertIsNone(prog.try_read(0xFFFF0000, 4, True))
+        self.assertRaises(ValueError, prog.try_read, 0xFFFF0000, -1)
+
+        def read_fn(address, count, offset, physical):
+            raise ZeroDivisionError()
+
+        prog.add_memory_segment(0x10000, 8, read_fn)
+        self.assertRaises(ZeroDivisionError, prog.try_read, 0x10000, 8)
+
     def test_segment_overflow(self):
         data = b"hello, world!"
         prog = mock_program(segments=[MockMemorySegment(data, 0xFFFF0000)])
@@ -352,6 +791,359 @@ class TestMemory(unittest.TestCase):
             8,
         )
 
+    def test_memory_cache(self):
+        data = bytearray(8192)
+        data[:12] = b"hello, world"
+        reads = []
+
+        def read_fn(address, count, offset, physical):
+            reads.append((address, count))
+            return bytes(data[offset : offset + count])
+
+        prog = Program(MOCK_PLATFORM)
+        prog.add_memory_segment(0xFFFF0000, len(data), read_fn)
+        self.assertEqual(prog.memory_cache_size, 0)
+        prog.memory_cache_size = 8192 + 100
+        self.assertEqual(prog.memory_cache_size, 8192)
+
+        self.assertEqual(prog.read(0xFFFF0000, 5), b"hello")
+        self.assertEqual(prog.read(0xFFFF0007, 5), b"world")
+        self.assertEqual(reads, [(0xFFFF0000, 4096)])
+
+        data[:5] = b"HELLO"
+        self.assertEqual(prog.read(0xFFFF0000, 5), b"hello")
+        prog.invalidate_memory_cache()
+        self.assertEqual(prog.read(0xFFFF0000, 5), b"HELLO")
+        self.assertEqual(len(reads), 2)
+
+        # Reads straddling a page boundary are served from both pages.
+        self.assertEqual(prog.read(0xFFFF0FFE, 4), bytes(4))
+        self.assertEqual(reads[2:], [(0xFFFF1000, 4096)])
+
+        prog.memory_cache_size = 0
+        self.assertEqual(prog.read(0xFFFF0000, 5), b"HELLO")
+        self.assertEqual(reads[3:], [(0xFFFF0000, 5)])
+
+    def test_read_field_array(self):
+        data = bytearray()
+        for i in range(4):
+            data.extend(i.to_bytes(4, "little"))
+            data.extend((-i).to_bytes(4, "little", signed=True))
+        bits_type = struct_type(
+            "bits",
+            8,
+            (
+                TypeMember(int_type("unsigned int", 4, False), "x", 0, 4),
+                TypeMember(int_type("int", 4, True), "y", 36, 3),
+            ),
+        )
+        prog = mock_program(
+            segments=[MockMemorySegment(data, virt_addr=0xFFFF0000)],
+            types=[point_type, bits_type, line_segment_type],
+        )
+        addresses = [0xFFFF0000 + 8 * i for i in range(4)]
+
+        self.assertEqual(
+            prog.read_field_array("struct point", "y", addresses),
+            array.array("q", [0, -1, -2, -3]),
+        )
+        self.assertEqual(
+            prog.read_field_array(point_type, "x", addresses),
+            array.array("q", [0, 1, 2, 3]),
+        )
+        self.assertEqual(
+            prog.read_field_array("struct bits", "x", addresses),
+            array.array("Q", [0, 1, 2, 3]),
+        )
+        self.assertEqual(
+            prog.read_field_array("struct bits", "y", addresses),
+            array.array("q", [0, -1, -1, -1]),
+        )
+        self.assertEqual(
+            prog.read_field_array("struct line_segment", "b.x", addresses[:3]),
+            array.array("q", [1, 2, 3]),
+        )
+        self.assertEqual(
+            prog.read_field_array("struct point", "x", []), array.array("q")
+        )
+
+        self.assertRaisesRegex(
+            TypeError,
+            "cannot read array of 'struct point' members",
+            prog.read_field_array,
+            "struct line_segment",
+            "a",
+            addresses,
+        )
+        self.assertRaises(FaultError, prog.read_field_array, "struct point", "x", [0])
+
+    def test_snapshot(self):
+        data = bytearray(16)
+        data[:8] = (1).to_bytes(4, "little") + (2).to_bytes(4, "little")
+        reads = []
+
+        def read_fn(address, count, offset, physical):
+            reads.append((address, count))
+            return bytes(data[offset : offset + count])
+
+        prog = Program(MOCK_PLATFORM)
+        prog.add_memory_segment(0xFFFF0000, len(data), read_fn)
+        obj = Object(prog, point_type, address=0xFFFF0000)
+        self.assertIs(obj.snapshot_(), obj)
+        self.assertEqual(reads, [(0xFFFF0000, 8)])
+
+        data[:8] = bytes(8)
+        self.assertEqual(obj.x.value_(), 1)
+        self.assertEqual(obj.y.value_(), 2)
+        self.assertEqual(obj.value_(), {"x": 1, "y": 2})
+        self.assertEqual(len(reads), 1)
+        self.assertEqual(prog.stats()["snapshot_hits"], 3)
+
+        # Reads outside of the snapshot still go to memory.
+        self.assertEqual(prog.read(0xFFFF0004, 8), bytes(8))
+        self.assertEqual(reads[1:], [(0xFFFF0004, 8)])
+
+        prog.invalidate_memory_cache()
+        self.assertEqual(obj.x.value_(), 0)
+        self.assertEqual(len(reads), 3)
+
+        self.assertIsNone(Object(prog, "int", value=1).snapshot_().address_)
+
+    def test_memory_trace(self):
+        data = bytearray(range(256)) * 32
+
+        def read_fn(address, count, offset, physical):
+            return bytes(data[offset : offset + count])
+
+        prog = Program(MOCK_PLATFORM)
+        prog.add_memory_segment(0xFFFF0000, len(data), read_fn)
+        prog.add_memory_segment(0xA0, len(data), read_fn, True)
+        self.assertRaises(ValueError, prog.stop_recording_memory)
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, "trace")
+            prog.record_memory(path)
+            self.assertRaises(ValueError, prog.record_memory, path)
+            prog.read(0xFFFF0000, 16)
+            prog.read(0xFFFF0000, 16)
+            prog.read(0xFFFF0100, 16)
+            prog.read(0xA0, 8, True)
+            self.assertIsNone(prog.try_read(0x8, 8))
+            data[0x104:0x108] = b"abcd"
+            prog.read(0xFFFF0104, 4)
+            prog.read(0xFFFF1000, 4096)
+            prog.stop_recording_memory()
+            # The repeated read is only stored once.
+            self.assertLess(os.path.getsize(path), 512 + 4096)
+
+            replay = Program()
+            replay.set_memory_trace(path)
+        self.assertEqual(replay.platform, MOCK_PLATFORM)
+        self.assertFalse(replay.flags & ProgramFlags.IS_LIVE)
+        self.assertEqual(replay.read(0xFFFF0000, 16), data[:16])
+        self.assertEqual(replay.read(0xA0, 8, True), data[:8])
+        # The most recent data wins where reads overlap.
+        self.assertEqual(replay.read(0xFFFF0100, 16), data[0x100:0x110])
+        self.assertEqual(replay.read(0xFFFF1000, 4096), data[0x1000:0x2000])
+        self.assertRaises(FaultError, replay.read, 0xFFFF0010, 1)
+        self.assertRaises(FaultError, replay.read, 0x8, 8)
+        self.assertRaises(FaultError, replay.read, 0xA8, 1, True)
+        self.assertRaises(ValueError, replay.set_memory_trace, path)
+
+    def test_memory_trace_pages(self):
+        data = bytearray(range(256)) * 32
+
+        def read_fn(address, count, offset, physical):
+            return bytes(data[offset : offset + count])
+
+        prog = Program(MOCK_PLATFORM)
+        prog.add_memory_segment(0xFFFF0000, len(data), read_fn)
+        prog.add_memory_segment(0xA0, len(data), read_fn, True)
+        self.assertRaises(ValueError, prog.record_memory_range, 0xA0, 1, True)
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, "trace")
+            prog.record_memory(path)
+            self.assertRaises(ValueError, prog.record_memory_range, 0xA0, 1, True)
+            prog.stop_recording_memory()
+
+            prog.record_memory(path, pages=True)
+            prog.read(0xFFFF0010, 4)
+            prog.record_memory_range(0, 16, True)
+            # The pages are read when recording stops.
+            data[0x20:0x24] = b"abcd"
+            prog.stop_recording_memory()
+
+            replay = Program()
+            replay.set_memory_trace(path)
+        # The whole page is recorded, not just the read.
+        self.assertEqual(replay.read(0xFFFF0000, 4096), data[:4096])
+        self.assertRaises(FaultError, replay.read, 0xFFFF1000, 1)
+        # Pages are clipped to the segments.
+        self.assertEqual(replay.read(0xA0, 4096 - 0xA0, True), data[: 4096 - 0xA0])
+        self.assertRaises(FaultError, replay.read, 0x9F, 1, True)
+        self.assertRaises(FaultError, replay.read, 0x1000, 1, True)
+
+    def test_invalid_memory_trace(self):
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(b"not a trace")
+            f.flush()
+            self.assertRaisesRegex(
+                ValueError,
+                "not a drgn memory trace",
+                Program().set_memory_trace,
+                f.name,
+            )
+        self.assertRaisesRegex(
+            ValueError,
+            "program memory is not initialized",
+            Program(MOCK_PLATFORM).record_memory,
+            "/dev/null",
+        )
+
+    def test_search_memory(self):
+        data = bytearray(4 * 4096)
+        for offset in (0x10, 0x1800, 0x2FFC, 0x3003):
+            data[offset : offset + 5] = b"magic"
+        data[0x3100:0x3105] = b"MAGIC"
+
+        def read_fn(address, count, offset, physical):
+            # The second page is unreadable.
+            if offset < 0x2000 and offset + count > 0x1000:
+                raise FaultError("bad page", address)
+            return bytes(data[offset : offset + count])
+
+        prog = Program(MOCK_PLATFORM)
+        # The match at 0x2FFC spans two contiguous segments.
+        prog.add_memory_segment(0xA0000, 0x3000, read_fn, True)
+        prog.add_memory_segment(
+            0xA3000,
+            0x1000,
+            lambda address, count, offset, physical: read_fn(
+                address, count, offset + 0x3000, physical
+            ),
+            True,
+        )
+        prog.add_memory_segment(0xFFFF0000, len(data), read_fn)
+
+        self.assertEqual(
+            list(prog.search_memory(b"magic")), [0xA0010, 0xA2FFC, 0xA3003]
+        )
+        self.assertEqual(
+            list(prog.search_memory(b"magic", physical=False)),
+            [0xFFFF0010, 0xFFFF2FFC, 0xFFFF3003],
+        )
+        self.assertEqual(
+            list(prog.search_memory(b"magic", mask=b"\xdf" * 5)),
+            [0xA0010, 0xA2FFC, 0xA3003, 0xA3100],
+        )
+        self.assertEqual(
+            list(prog.search_memory(b"magic", alignment=4)), [0xA0010, 0xA2FFC]
+        )
+        self.assertEqual(list(prog.search_memory(b"nothing")), [])
+        self.assertEqual(list(Program().search_memory(b"magic")), [])
+
+        self.assertRaisesRegex(ValueError, "empty", prog.search_memory, b"")
+        self.assertRaisesRegex(
+            ValueError, "longer than", prog.search_memory, bytes(4097)
+        )
+        self.assertRaisesRegex(
+            ValueError, "same length", prog.search_memory, b"magic", mask=b"\xff"
+        )
+        self.assertRaisesRegex(
+            ValueError, "power of two", prog.search_memory, b"magic", alignment=3
+        )
+
+    def test_pointer_index(self):
+        data = bytearray(0x2000)
+
+        def write_word(offset, value):
+            data[offset : offset + 8] = value.to_bytes(8, "little")
+
+        write_word(0x0, 0xFFFF1000)
+        write_word(0x8, 0xFFFF1008)
+        write_word(0x1FF8, 0xFFFF1000)
+        # Not in a segment.
+        write_word(0x10, 0x12345678)
+        # Not aligned.
+        write_word(0x21, 0xFFFF1000)
+
+        prog = mock_program(segments=[MockMemorySegment(data, virt_addr=0xFFFF0000)])
+        index = prog.build_pointer_index()
+        self.assertEqual(len(index), 3)
+        self.assertEqual(
+            index.find(0xFFFF1000), [(0xFFFF0000, 0xFFFF1000), (0xFFFF1FF8, 0xFFFF1000)]
+        )
+        self.assertEqual(
+            index.find(0xFFFF1000, 16),
+            [
+                (0xFFFF0000, 0xFFFF1000),
+                (0xFFFF1FF8, 0xFFFF1000),
+                (0xFFFF0008, 0xFFFF1008),
+            ],
+        )
+        self.assertEqual(index.find(0xFFFF1001, 7), [])
+        self.assertEqual(index.find(0xFFFF1000, 0), [])
+
+        index = prog.build_pointer_index([(0xFFFF1000, 0x1000)])
+        self.assertEqual(index.find(0, 2 ** 64 - 1), [(0xFFFF1FF8, 0xFFFF1000)])
+
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, "index")
+            prog.build_pointer_index().save(path)
+            loaded = prog.load_pointer_index(path)
+            self.assertEqual(len(loaded), 3)
+            self.assertEqual(loaded.find(0xFFFF1008), [(0xFFFF0008, 0xFFFF1008)])
+            self.assertRaisesRegex(
+                ValueError,
+                "word size does not match",
+                Program(MOCK_32BIT_PLATFORM).load_pointer_index,
+                path,
+            )
+            with open(path, "wb") as f:
+                f.write(b"not an index")
+            self.assertRaisesRegex(
+                ValueError, "not a drgn pointer index", prog.load_pointer_index, path
+            )
+
+        self.assertRaisesRegex(
+            ValueError, "platform is not known", Program().build_pointer_index
+        )
+        self.assertRaises(ValueError, prog.build_pointer_index, [(0xFFFF0000, 0)])
+
+    def test_hash_memory(self):
+        data = bytearray(0x3000)
+        good = mock_program(
+            segments=[MockMemorySegment(bytes(data), virt_addr=0xFFFF0000, phys_addr=0)]
+        )
+        data[0x10] = 1
+        data[0x2000] = 1
+        bad = mock_program(
+            segments=[
+                MockMemorySegment(bytes(data), virt_addr=0xFFFF0000, phys_addr=0),
+                # Only readable in one of the programs.
+                MockMemorySegment(bytes(0x800), phys_addr=0x3000),
+            ]
+        )
+
+        hashes = good.hash_memory()
+        self.assertEqual(len(hashes), 3)
+        self.assertTrue(hashes.physical)
+        self.assertEqual(hashes.diff(hashes), [])
+        self.assertEqual(
+            hashes.diff(bad.hash_memory()), [(0x0, 0x1000), (0x2000, 0x1800)]
+        )
+
+        virtual = good.hash_memory(physical=False, ranges=[(0xFFFF0008, 0x2000)])
+        self.assertFalse(virtual.physical)
+        self.assertEqual(len(virtual), 3)
+        self.assertEqual(
+            virtual.diff(bad.hash_memory(False, [(0xFFFF1000, 0x2000)])),
+            [(0xFFFF0008, 0xFF8), (0xFFFF2000, 0x1000)],
+        )
+
+        self.assertRaisesRegex(ValueError, "physical and virtual", hashes.diff, virtual)
+        self.assertRaises(TypeError, hashes.diff, None)
+        self.assertRaises(ValueError, good.hash_memory, ranges=[(0, 0)])
+
 
 class TestTypes(unittest.TestCase):
     def test_invalid_finder(self):
@@ -372,6 +1164,77 @@ class TestTypes(unittest.TestCase):
         prog.add_type_finder(lambda kind, name, filename: None)
         self.assertRaises(LookupError, prog.type, "struct foo")
 
+    def test_enumerator(self):
+        prog = mock_program(types=[color_type])
+        self.assertEqual(prog.enumerator("enum color", 1), TypeEnumerator("GREEN", 1))
+        self.assertIsNone(prog.enumerator(color_type, 3))
+        self.assertIsNone(prog.enumerator(color_type, -1))
+        self.assertRaisesRegex(
+            TypeError, "not an enumerated type", prog.enumerator, "int", 0
+        )
+        self.assertRaisesRegex(
+            TypeError, "incomplete", prog.enumerator, enum_type("foo"), 0
+        )
+
+        big_type = enum_type(
+            "big",
+            int_type("int", 4, True),
+            [TypeEnumerator(f"E{i}", i - 50) for i in range(100)]
+            + [TypeEnumerator("DUP", 0)],
+        )
+        self.assertEqual(prog.enumerator(big_type, -50), TypeEnumerator("E0", -50))
+        self.assertEqual(prog.enumerator(big_type, 0), TypeEnumerator("E50", 0))
+        self.assertIsNone(prog.enumerator(big_type, 50))
+        self.assertEqual(str(Object(prog, big_type, value=-1)), "(enum big)E49")
+        self.assertEqual(str(Object(prog, big_type, value=50)), "(enum big)50")
+
+    def test_cached(self):
+        calls = []
+
+        def finder(kind, name, filename):
+            calls.append(name)
+            if kind == TypeKind.STRUCT and name == "point":
+                return point_type
+
+        prog = mock_program()
+        prog.add_type_finder(finder)
+        self.assertEqual(prog.type("struct point *"), pointer_type(8, point_type))
+        self.assertEqual(prog.type("struct point *"), pointer_type(8, point_type))
+        self.assertEqual(calls, ["point"])
+
+        # Adding a finder invalidates the cache, but the first finder's
+        # result was memoized.
+        prog.add_type_finder(lambda kind, name, filename: None)
+        self.assertEqual(prog.type("struct point *"), pointer_type(8, point_type))
+        self.assertEqual(calls, ["point"])
+
+    def test_not_memoized(self):
+        calls = []
+
+        def finder(kind, name, filename):
+            calls.append(name)
+            if kind == TypeKind.STRUCT and name == "point":
+                return point_type
+
+        prog = mock_program()
+        prog.add_type_finder(finder, memoize=False)
+        self.assertEqual(prog.type("struct point *"), pointer_type(8, point_type))
+        prog.add_type_finder(lambda kind, name, filename: None)
+        self.assertEqual(prog.type("struct point *"), pointer_type(8, point_type))
+        self.assertEqual(calls, ["point", "point"])
+
+    def test_memoized_not_found(self):
+        calls = []
+
+        def finder(kind, name, filename):
+            calls.append(name)
+
+        prog = mock_program()
+        prog.add_type_finder(finder)
+        self.assertRaises(LookupError, prog.type, "struct foo")
+        self.assertRaises(LookupError, prog.type, "struct foo")
+        self.assertEqual(calls, ["foo"])
+
     def test_default_primitive_types(self):
         def spellings(tokens, num_optional=0):
             for i in range(len(tokens) - num_optional, len(tokens) + 1):
@@ -489,6 +1352,34 @@ class TestTypes(unittest.TestCase):
         prog = mock_program(types=[pid_type])
         self.assertEqual(prog.type("pid_t"), pid_type)
 
+    def test_canonical_wrapper(self):
+        prog = mock_program(types=[point_type])
+        type_ = prog.type("struct point")
+        self.assertIs(prog.type("struct point"), type_)
+        self.assertIs(type_.members, prog.type("struct point").members)
+        self.assertIs(Object(prog, type_, address=0).type_, type_)
+        self.assertIsNot(prog.type("const struct point"), type_)
+        self.assertEqual(
+            prog.type("const struct point"), point_type.qualified(Qualifiers.CONST)
+        )
+
+    def test_profile_stats(self):
+        prog = mock_program(types=[point_type])
+        self.assertFalse(prog.profiling)
+        prog.type("struct point")
+        self.assertEqual(prog.profile_stats()["type_finds"], (0, 0))
+        prog.profiling = True
+        self.assertTrue(prog.profiling)
+        obj = Object(prog, prog.type("struct point"), address=0)
+        obj.x
+        stats = prog.profile_stats()
+        self.assertEqual(stats["type_finds"][0], 1)
+        self.assertGreaterEqual(stats["member_lookups"][0], 1)
+        self.assertGreaterEqual(stats["objects"][0], 2)
+        prog.profiling = False
+        prog.type("struct point")
+        self.assertEqual(prog.profile_stats()["type_finds"][0], 1)
+
     def test_pointer(self):
         prog = mock_program()
         self.assertEqual(prog.type("int *"), pointer_type(8, int_type("int", 4, True)))
@@ -597,6 +1488,34 @@ class TestObjects(ObjectTestCase):
         self.assertRaises(LookupError, prog.object, "foo")
         self.assertFalse("foo" in prog)
 
+    def test_memoized(self):
+        calls = []
+
+        def finder(prog, name, flags, filename):
+            calls.append(name)
+            if name == "foo":
+                return Object(prog, "int", value=calls.count(name))
+
+        prog = mock_program()
+        prog.add_object_finder(finder)
+        self.assertEqual(prog["foo"], Object(prog, "int", value=1))
+        self.assertEqual(prog["foo"], Object(prog, "int", value=1))
+        self.assertRaises(LookupError, prog.object, "bar")
+        self.assertRaises(LookupError, prog.object, "bar")
+        self.assertEqual(calls, ["foo", "bar"])
+
+    def test_not_memoized(self):
+        calls = []
+
+        def finder(prog, name, flags, filename):
+            calls.append(name)
+            return Object(prog, "int", value=len(calls))
+
+        prog = mock_program()
+        prog.add_object_finder(finder, memoize=False)
+        self.assertEqual(prog["foo"], Object(prog, "int", value=1))
+        self.assertEqual(prog["foo"], Object(prog, "int", value=2))
+
     def test_constant(self):
         mock_obj = MockObject("PAGE_SIZE", int_type("int", 4, True), value=4096)
         prog = mock_program(objects=[mock_obj])
@@ -632,6 +1551,122 @@ class TestObjects(ObjectTestCase):
         self.assertTrue("counter" in prog)
 
 
+class TestEval(ObjectTestCase):
+    def setUp(self):
+        super().setUp()
+        data = struct.pack("<4iQ", 1, 2, 3, 4, 0xFFFF0000)
+        self.prog = mock_program(
+            segments=[MockMemorySegment(data, 0xFFFF0000)],
+            types=[line_segment_type, pid_type],
+            objects=[
+                MockObject("segment", line_segment_type, address=0xFFFF0000),
+                MockObject(
+                    "segment_ptr",
+                    pointer_type(8, line_segment_type),
+                    address=0xFFFF0010,
+                ),
+            ],
+        )
+
+    def test_member(self):
+        self.assertEqual(
+            self.prog.eval("segment.a.y"),
+            Object(self.prog, "int", address=0xFFFF0004),
+        )
+        self.assertEqual(
+            self.prog.eval("segment_ptr->b.x"),
+            Object(self.prog, "int", address=0xFFFF0008),
+        )
+        self.assertEqual(
+            self.prog.eval("*segment_ptr"),
+            Object(self.prog, line_segment_type, address=0xFFFF0000),
+        )
+        self.assertEqual(
+            self.prog.eval("&segment.b"),
+            Object(self.prog, pointer_type(8, point_type), value=0xFFFF0008),
+        )
+
+    def test_variables(self):
+        ptr = self.prog["segment_ptr"]
+        self.assertEqual(
+            self.prog.eval("p->b.y", p=ptr),
+            Object(self.prog, "int", address=0xFFFF000C),
+        )
+        # The compiled expression is cached, but the variables are not.
+        self.assertEqual(
+            self.prog.eval("p->b.y", p=ptr + 1),
+            Object(self.prog, "int", address=0xFFFF001C),
+        )
+        # Variables shadow objects in the program.
+        self.assertEqual(self.prog.eval("segment", segment=ptr), ptr)
+        self.assertRaises(TypeError, self.prog.eval, "x", x=1)
+        self.assertRaises(
+            ValueError,
+            self.prog.eval,
+            "x",
+            x=Object(mock_program(), "int", value=1),
+        )
+
+    def test_cast(self):
+        self.assertEqual(
+            self.prog.eval("(unsigned long)segment_ptr"),
+            Object(self.prog, "unsigned long", value=0xFFFF0000),
+        )
+        self.assertEqual(
+            self.prog.eval("((int *)segment_ptr)[3]"),
+            Object(self.prog, "int", address=0xFFFF000C),
+        )
+        self.assertEqual(
+            self.prog.eval("(pid_t)segment.a.y"),
+            Object(self.prog, pid_type, value=2),
+        )
+        self.assertEqual(
+            self.prog.eval("(struct point *)&segment.b"),
+            Object(self.prog, pointer_type(8, point_type), value=0xFFFF0008),
+        )
+
+    def test_arithmetic(self):
+        for expr, value in (
+            ("segment.a.x + segment.b.y * 2", 9),
+            ("1 + 2 * 3 - 0x10", -9),
+            ("(1 + 2) * 3", 9),
+            ("1 << 4 | 1", 17),
+            ("10 - 3 - 2", 5),
+            ("-~1 % 3", 2),
+        ):
+            with self.subTest(expr=expr):
+                self.assertEqual(
+                    self.prog.eval(expr), Object(self.prog, "int", value=value)
+                )
+
+    def test_logical(self):
+        for expr, value in (
+            ("segment.a.x < segment.a.y && !0", 1),
+            ("1 == 2 || 3 != 3", 0),
+            # The right-hand side is not evaluated.
+            ("0 && *(int *)0", 0),
+            ("1 || *(int *)0", 1),
+        ):
+            with self.subTest(expr=expr):
+                self.assertEqual(
+                    self.prog.eval(expr), Object(self.prog, "int", value=value)
+                )
+
+    def test_errors(self):
+        for expr in (
+            "segment.",
+            "segment->",
+            "1 +",
+            "(1",
+            "segment[0",
+            "segment = 1",
+            "1 2",
+        ):
+            with self.subTest(expr=expr):
+                self.assertRaises(SyntaxError, self.prog.eval, expr)
+        self.assertRaises(LookupError, self.prog.eval, "foo + 1")
+
+
 class TestCoreDump(unittest.TestCase):
     def test_not_core_dump(self):
         prog = Program()
@@ -691,6 +1726,24 @@ class TestCoreDump(unittest.TestCase):
         self.assertEqual(prog.read(0xFFFF0000, len(data)), data)
         self.assertEqual(prog.read(0xA0, len(data), physical=True), data)
 
+    def test_read_view(self):
+        data = b"hello, world"
+        prog = Program()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(
+                create_elf_file(
+                    ET.CORE, [ElfSection(p_type=PT.LOAD, vaddr=0xFFFF0000, data=data,),]
+                )
+            )
+            f.flush()
+            prog.set_core_dump(f.name)
+        view = prog.read_view(0xFFFF0007, 5)
+        self.assertTrue(view.readonly)
+        self.assertEqual(bytes(view), b"world")
+        self.assertEqual(bytes(prog.read_view(0xFFFF0000, len(data))), data)
+        del prog
+        self.assertEqual(bytes(view), b"world")
+
     def test_zero_fill(self):
         data = b"hello, world"
         prog = Program()
@@ -711,3 +1764,169 @@ class TestCoreDump(unittest.TestCase):
             f.flush()
             prog.set_core_dump(f.name)
         self.assertEqual(prog.read(0xFFFF0000, len(data) + 4), data + bytes(4))
+
+    def test_nt_file(self):
+        data = b"hello, world"
+        with tempfile.NamedTemporaryFile() as mapped:
+            mapped.write(b"\0" * 4096 + data)
+            mapped.flush()
+            path = mapped.name.encode() + b"\0"
+            # One mapping of the second page of the file.
+            desc = struct.pack("<5Q", 1, 4096, 0xFFFF0000, 0xFFFF1000, 1) + path
+            note = struct.pack("<3I", 5, len(desc), 0x46494C45) + b"CORE\0\0\0\0"
+            note += desc + bytes(-len(desc) % 4)
+            prog = Program()
+            with tempfile.NamedTemporaryFile() as f:
+                f.write(
+                    create_elf_file(
+                        ET.CORE,
+                        [
+                            ElfSection(p_type=PT.NOTE, data=note),
+                            ElfSection(
+                                p_type=PT.LOAD,
+                                vaddr=0xFFFF0000,
+                                data=b"",
+                                memsz=0x1000,
+                            ),
+                        ],
+                    )
+                )
+                f.flush()
+                prog.set_core_dump(f.name)
+            self.assertEqual(prog.read(0xFFFF0000, len(data)), data)
+            self.assertEqual(prog.read(0xFFFF0000 + len(data), 4), bytes(4))
+
+    def test_xz(self):
+        data = b"hello, world"
+        core = create_elf_file(
+            ET.CORE, [ElfSection(p_type=PT.LOAD, vaddr=0xFFFF0000, data=data,),]
+        )
+        # Split the core dump between two streams so that it has two frames.
+        half = len(core) // 2
+        prog = Program()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(lzma.compress(core[:half]) + lzma.compress(core[half:]))
+            f.flush()
+            prog.set_core_dump(f.name)
+        self.assertEqual(prog.read(0xFFFF0000, len(data)), data)
+        stats = prog.stats()
+        self.assertGreater(stats["decompressions"], 0)
+        self.assertGreaterEqual(stats["decompressed_bytes"], len(data))
+
+    def test_prefetch(self):
+        data = bytes(range(256)) * 64
+        prog = Program()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(
+                create_elf_file(
+                    ET.CORE,
+                    [ElfSection(p_type=PT.LOAD, vaddr=0xFFFF0000, data=data)],
+                )
+            )
+            f.flush()
+            prog.set_core_dump(f.name)
+        prog.prefetch(0xFFFF0000, len(data))
+        # The pages are read in the background, so wait for them.
+        deadline = time.monotonic() + 10
+        while (
+            prog.stats()["cache_readaheads"] == 0 and time.monotonic() < deadline
+        ):
+            time.sleep(0.01)
+        prog.reset_stats()
+        self.assertEqual(prog.read(0xFFFF1000, 8), data[0x1000:0x1008])
+        self.assertEqual(prog.stats()["cache_misses"], 0)
+
+
+class FakeGdbStub:
+    # Minimal GDB remote protocol target serving memory from a dict mapping
+    # addresses to bytes.
+    def __init__(self, segments, no_ack=True):
+        self.segments = segments
+        self.no_ack = no_ack
+        self.listener = socket.socket()
+        self.listener.bind(("127.0.0.1", 0))
+        self.listener.listen(1)
+        self.address = "127.0.0.1:%d" % self.listener.getsockname()[1]
+        self.thread = threading.Thread(target=self._serve, daemon=True)
+        self.thread.start()
+
+    def _read(self, address, size):
+        for start, data in self.segments.items():
+            if start <= address and address + size <= start + len(data):
+                return data[address - start : address - start + size]
+        return None
+
+    def _respond(self, payload):
+        if payload == b"qSupported":
+            response = b"PacketSize=100"
+            if self.no_ack:
+                response += b";QStartNoAckMode+"
+        elif payload == b"QStartNoAckMode":
+            response = b"OK"
+        elif payload.startswith(b"m"):
+            address, size = (int(x, 16) for x in payload[1:].split(b","))
+            data = self._read(address, size)
+            response = b"E01" if data is None else data.hex().encode()
+        else:
+            response = b""
+        return b"$%s#%02x" % (response, sum(response) & 0xFF)
+
+    def _serve(self):
+        conn = self.listener.accept()[0]
+        ack = True
+        buf = b""
+        with conn:
+            while True:
+                data = conn.recv(4096)
+                if not data:
+                    return
+                buf += data
+                while b"#" in buf:
+                    start = buf.find(b"$")
+                    end = buf.find(b"#", start)
+                    if start < 0 or end < 0 or len(buf) < end + 3:
+                        break
+                    payload = buf[start + 1 : end]
+                    buf = buf[end + 3 :]
+                    if ack:
+                        conn.sendall(b"+")
+                    conn.sendall(self._respond(payload))
+                    if payload == b"QStartNoAckMode":
+                        ack = False
+
+    def close(self):
+        self.listener.close()
+
+
+class TestRemote(unittest.TestCase):
+    def _test_read(self, no_ack):
+        data = bytes(range(256)) * 16
+        stub = FakeGdbStub({0xFFFF0000: data}, no_ack=no_ack)
+        self.addCleanup(stub.close)
+        prog = Program()
+        prog.set_remote(stub.address)
+        self.assertEqual(prog.read(0xFFFF0000, len(data)), data)
+        self.assertEqual(
+            prog.read_batch([(0xFFFF0000, 4), (0xFFFF0100, 4)]),
+            [data[:4], data[0x100:0x104]],
+        )
+        self.assertRaises(FaultError, prog.read, 0x1000, 4)
+        stats = prog.stats()
+        self.assertGreater(stats["remote_packets"], 0)
+        self.assertGreaterEqual(stats["remote_bytes"], len(data))
+
+    def test_read(self):
+        self._test_read(True)
+
+    def test_read_ack(self):
+        self._test_read(False)
+
+    def test_connect_error(self):
+        listener = socket.socket()
+        listener.bind(("127.0.0.1", 0))
+        address = "127.0.0.1:%d" % listener.getsockname()[1]
+        listener.close()
+        self.assertRaises(OSError, Program().set_remote, address)
+
+    def test_invalid_address(self):
+        self.assertRaises(ValueError, Program().set_remote, "foo")
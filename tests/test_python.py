@@ -24,3 +24,13 @@ class TestModule(unittest.TestCase):
         from_extension = {name for name in dir(_drgn) if not name.startswith("_")}
         self.assertEqual(from_extension - set(dir(drgn)), set())
         self.assertEqual(from_extension - set(drgn.__all__), set())
+
+    def test_num_threads(self):
+        try:
+            drgn.set_num_threads(2)
+            self.assertEqual(drgn.get_num_threads(), 2)
+            drgn.set_num_threads(0)
+            self.assertGreaterEqual(drgn.get_num_threads(), 1)
+            self.assertRaises(ValueError, drgn.set_num_threads, -1)
+        finally:
+            drgn.set_num_threads(0)
@@ -3,7 +3,7 @@
 
 import unittest
 
-from tests.libdrgn import deserialize_bits, serialize_bits
+from tests.libdrgn import deserialize_bits, deserialize_bits_array, serialize_bits
 
 
 VALUE = 12345678912345678989
@@ -64,3 +64,32 @@ class TestSerialize(unittest.TestCase):
                     buf = bytearray([0xFF] * len(expected1))
                     serialize_bits(buf, bit_offset, value, bit_size, little_endian)
                     self.assertEqual(buf, expected1)
+
+    def test_deserialize_array(self):
+        n = 5
+        for bit_size in (3, 8, 13, 16, 32, 64):
+            for bit_offset in (0, 5):
+                for bit_stride in (bit_size, 64, 72, 96):
+                    if bit_stride < bit_size:
+                        continue
+                    for little_endian in [True, False]:
+                        buf = bytearray(
+                            (bit_offset + n * bit_stride + bit_size + 7) // 8
+                        )
+                        expected = []
+                        for i in range(n):
+                            value = (VALUE >> i) & ((1 << bit_size) - 1)
+                            serialize_bits(
+                                buf,
+                                bit_offset + i * bit_stride,
+                                value,
+                                bit_size,
+                                little_endian,
+                            )
+                            expected.append(value)
+                        self.assertEqual(
+                            deserialize_bits_array(
+                                buf, n, bit_offset, bit_stride, bit_size, little_endian
+                            ),
+                            expected,
+                        )
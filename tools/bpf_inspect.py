@@ -10,24 +10,24 @@ unavailable via kernel API.
 import argparse
 import sys
 
-from drgn.helpers import enum_type_to_class
+from drgn.helpers import enum_type_to_class, memoize
 from drgn.helpers.linux import (
     bpf_map_for_each,
     bpf_prog_for_each,
+    btf_type_name,
     hlist_for_each_entry,
 )
 
 
-BpfMapType = enum_type_to_class(prog.type("enum bpf_map_type"), "BpfMapType")
-BpfProgType = enum_type_to_class(prog.type("enum bpf_prog_type"), "BpfProgType")
-BpfAttachType = enum_type_to_class(prog.type("enum bpf_attach_type"), "BpfAttachType")
+# The enum classes are built on first use so that each subcommand only looks up
+# the types that it needs.
+@memoize
+def enum_class(prog, type_name, class_name):
+    return enum_type_to_class(prog.type(type_name), class_name)
 
 
 def get_btf_name(btf, btf_id):
-    type_ = btf.types[btf_id]
-    if type_.name_off < btf.hdr.str_len:
-        return btf.strings[type_.name_off].address_of_().string_().decode()
-    return ""
+    return btf_type_name(btf, btf_id) or ""
 
 
 def get_prog_btf_name(bpf_prog):
@@ -46,9 +46,8 @@ def attach_type_to_tramp(attach_type):
     # bpf_tramp_prog_type is available since linux kernel 5.5, this code should
     # be called only after checking for bpf_prog.aux.trampoline to be present
     # though so no error checking here.
-    BpfProgTrampType = enum_type_to_class(
-        prog.type("enum bpf_tramp_prog_type"), "BpfProgTrampType"
-    )
+    BpfProgTrampType = enum_class(prog, "enum bpf_tramp_prog_type", "BpfProgTrampType")
+    BpfAttachType = enum_class(prog, "enum bpf_attach_type", "BpfAttachType")
 
     at = BpfAttachType(attach_type)
 
@@ -100,7 +99,9 @@ def get_tramp_progs(bpf_prog):
 def list_bpf_progs(args):
     for bpf_prog in bpf_prog_for_each(prog):
         id_ = bpf_prog.aux.id.value_()
-        type_ = BpfProgType(bpf_prog.type).name
+        type_ = enum_class(prog, "enum bpf_prog_type", "BpfProgType")(
+            bpf_prog.type
+        ).name
         name = get_prog_name(bpf_prog)
 
         linked = ", ".join([get_linked_func(p) for p in get_tramp_progs(bpf_prog)])
@@ -113,7 +114,9 @@ def list_bpf_progs(args):
 def list_bpf_maps(args):
     for map_ in bpf_map_for_each(prog):
         id_ = map_.id.value_()
-        type_ = BpfMapType(map_.map_type).name
+        type_ = enum_class(prog, "enum bpf_map_type", "BpfMapType")(
+            map_.map_type
+        ).name
         name = map_.name.string_().decode()
 
         print(f"{id_:>6}: {type_:32} {name}")
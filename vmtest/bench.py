@@ -0,0 +1,115 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+# Run scripts/bench_linux_helpers.py in a virtual machine on one or more
+# kernels and collect the results as JSON. drgn must already be built in place
+# (e.g., with python3 setup.py build_ext -i).
+
+import argparse
+import json
+import os
+import shlex
+import subprocess
+import sys
+import tempfile
+from typing import Any, Dict, List, Optional, Sequence
+
+from vmtest.resolver import KernelResolver
+from vmtest.vm import VM_OUTPUT_DIR, install_vmlinux_precommand, run_in_vm
+
+
+def _drgn_revision() -> Optional[str]:
+    try:
+        return subprocess.run(
+            ["git", "describe", "--always", "--dirty"],
+            stdout=subprocess.PIPE,
+            stderr=subprocess.DEVNULL,
+            check=True,
+            universal_newlines=True,
+        ).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def run_benchmarks(
+    *, vmlinux: str, vmlinuz: str, build_dir: str, bench_args: Sequence[str] = ()
+) -> Dict[str, Any]:
+    with tempfile.TemporaryDirectory(prefix="drgn-vmtest-bench-") as output_dir:
+        os.chmod(output_dir, 0o777)
+        output = os.path.join(VM_OUTPUT_DIR, "results.json")
+        quoted_args = " ".join(shlex.quote(arg) for arg in bench_args)
+        command = fr"""cd {shlex.quote(os.getcwd())} &&
+	{shlex.quote(sys.executable)} -B scripts/bench_linux_helpers.py \
+		--json {shlex.quote(output)} {quoted_args}"""
+        command = install_vmlinux_precommand(command, vmlinux)
+        returncode = run_in_vm(
+            command, vmlinuz=vmlinuz, build_dir=build_dir, output_dir=output_dir
+        )
+        if returncode != 0:
+            raise Exception(f"benchmark in VM returned {returncode}")
+        with open(os.path.join(output_dir, "results.json"), "r") as f:
+            return json.load(f)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description="run Linux kernel helper benchmarks in vmtest virtual machines",
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter,
+    )
+    parser.add_argument(
+        "-d",
+        "--directory",
+        default="build/vmtest",
+        help="directory for build artifacts and downloaded kernels",
+    )
+    parser.add_argument(
+        "-k",
+        "--kernel",
+        action="append",
+        default=argparse.SUPPRESS,
+        help="kernel to benchmark; may be given multiple times "
+        "(default: latest available kernel)",
+    )
+    parser.add_argument(
+        "-o",
+        "--output",
+        default=argparse.SUPPRESS,
+        help="file to write the JSON results to (default: DIRECTORY/bench.json)",
+    )
+    parser.add_argument(
+        "bench_args",
+        metavar="ARG",
+        nargs=argparse.REMAINDER,
+        help="arguments for scripts/bench_linux_helpers.py",
+    )
+    args = parser.parse_args()
+
+    revision = _drgn_revision()
+    results: List[Dict[str, Any]] = []
+    failed = False
+    with KernelResolver(
+        getattr(args, "kernel", ["*"]), download_dir=args.directory
+    ) as resolver:
+        for kernel in resolver:
+            print(f"benchmarking Linux {kernel.release}", file=sys.stderr)
+            try:
+                result = run_benchmarks(
+                    vmlinux=kernel.vmlinux,
+                    vmlinuz=kernel.vmlinuz,
+                    build_dir=args.directory,
+                    bench_args=args.bench_args,
+                )
+            except Exception as e:
+                print(f"error: Linux {kernel.release}: {e}", file=sys.stderr)
+                failed = True
+                continue
+            result["drgn"] = revision
+            results.append(result)
+
+    # The VM console also goes to standard output, so the results always go to
+    # a file.
+    output = getattr(args, "output", os.path.join(args.directory, "bench.json"))
+    with open(output, "w") as f:
+        json.dump(results, f, indent=2)
+    print(f"wrote results to {output}", file=sys.stderr)
+    sys.exit(1 if failed else 0)
@@ -9,6 +9,7 @@ import shutil
 import socket
 import subprocess
 import tempfile
+from typing import Optional
 
 from util import nproc, out_of_date
 
@@ -55,7 +56,7 @@ cd /
 # for hard link") (in v4.8), overlayfs doesn't handle hard links correctly,
 # which breaks some tests.
 "$BUSYBOX" mount -t tmpfs -o nosuid,nodev tmpfs /tmp
-
+{mount_output}
 "$BUSYBOX" hostname "$HOSTNAME"
 "$BUSYBOX" ip link set lo up
 
@@ -136,11 +137,25 @@ def _build_onoatimehack(dir: str) -> str:
     return onoatimehack_so
 
 
+# Directory in the VM where the output directory passed to run_in_vm() is
+# mounted.
+VM_OUTPUT_DIR = "/mnt/output"
+
+_MOUNT_OUTPUT_TEMPLATE = r"""
+"$BUSYBOX" mkdir -m 755 {output}
+"$BUSYBOX" mount -t 9p -o trans=virtio,version=9p2000.L output {output}
+"""
+
+
 class LostVMError(Exception):
     pass
 
 
-def run_in_vm(command: str, *, vmlinuz: str, build_dir: str) -> int:
+def run_in_vm(
+    command: str, *, vmlinuz: str, build_dir: str, output_dir: Optional[str] = None
+) -> int:
+    # If output_dir is given, it is mounted read-write at VM_OUTPUT_DIR in the
+    # VM so that the command can return files to the host.
     # multidevs was added in QEMU 4.2.0.
     if (
         "multidevs"
@@ -170,7 +185,13 @@ def run_in_vm(command: str, *, vmlinuz: str, build_dir: str) -> int:
         with open(init, "w") as init_file:
             init_file.write(
                 _INIT_TEMPLATE.format(
-                    busybox=shlex.quote(busybox), command=shlex.quote(command)
+                    busybox=shlex.quote(busybox),
+                    command=shlex.quote(command),
+                    mount_output=_MOUNT_OUTPUT_TEMPLATE.format(
+                        output=shlex.quote(VM_OUTPUT_DIR)
+                    )
+                    if output_dir is not None
+                    else "",
                 )
             )
         os.chmod(init, 0o755)
@@ -190,6 +211,15 @@ def run_in_vm(command: str, *, vmlinuz: str, build_dir: str) -> int:
                 "-virtfs",
                 f"local,id=root,path=/,mount_tag=/dev/root,security_model=none,readonly{multidevs}",
 
+                *(
+                    [
+                        "-virtfs",
+                        f"local,id=output,path={output_dir},mount_tag=output,security_model=none",
+                    ]
+                    if output_dir is not None
+                    else []
+                ),
+
                 "-device", "virtio-serial",
                 "-chardev", f"socket,id=vmtest,path={socket_path}",
                 "-device",